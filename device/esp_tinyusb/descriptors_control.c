@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include "esp_log.h"
 #include "esp_check.h"
@@ -11,7 +12,7 @@
 #include "descriptors_control.h"
 #include "usb_descriptors.h"
 
-#define MAX_DESC_BUF_SIZE 32               // Max length of string descriptor (can be extended, USB supports lengths up to 255 bytes)
+#define MAX_DESC_CHARS 126                 // Max UTF-16 code units of string descriptor, bLength is one byte: (255 - 2) / 2
 
 static const char *TAG = "tusb_desc";
 
@@ -34,12 +35,124 @@ typedef struct {
     const tusb_desc_device_qualifier_t *qualifier;            /*!< Pointer to Qualifier descriptor */
     uint8_t *other_speed;               /*!< Pointer for other speed configuration descriptor */
 #endif // TUD_OPT_HIGH_SPEED
-    const char *str[USB_STRING_DESCRIPTOR_ARRAY_SIZE];  /*!< Pointer to array of UTF-8 strings */
+    uint16_t *str[USB_STRING_DESCRIPTOR_ARRAY_SIZE];    /*!< String descriptors encoded in UTF-16, NULL if the string is not set */
     int str_count;                      /*!< Number of descriptors in str */
 } tinyusb_descriptor_config_t;
 
 static tinyusb_descriptor_config_t s_desc_cfg;
 
+// =============================================================================
+// STRING DESCRIPTORS
+// =============================================================================
+
+/**
+ * @brief Decode UTF-8 string to UTF-16 code units
+ *
+ * Invalid sequences, overlong encodings and surrogates are replaced by U+FFFD.
+ * The output is cut before the first character that does not fit, a surrogate pair is never split.
+ *
+ * @param[in]  str     Null terminated UTF-8 string
+ * @param[out] out     UTF-16 code units
+ * @param[in]  out_max Size of out in code units
+ * @param[out] cut     The string did not fit in out
+ * @return Number of code units written to out
+ */
+static size_t utf8_to_utf16(const char *str, uint16_t *out, size_t out_max, bool *cut)
+{
+    static const uint32_t min_cp[] = { 0, 0, 0x80, 0x800, 0x10000 }; // Smallest code point of each sequence length
+    const uint8_t *s = (const uint8_t *)str;
+    size_t n = 0;
+    *cut = false;
+    while (*s) {
+        uint32_t cp;
+        size_t len;
+        if (s[0] < 0x80) {
+            cp = s[0];
+            len = 1;
+        } else if ((s[0] & 0xE0) == 0xC0) {
+            cp = s[0] & 0x1F;
+            len = 2;
+        } else if ((s[0] & 0xF0) == 0xE0) {
+            cp = s[0] & 0x0F;
+            len = 3;
+        } else if ((s[0] & 0xF8) == 0xF0) {
+            cp = s[0] & 0x07;
+            len = 4;
+        } else {
+            cp = 0xFFFD; // Continuation byte or invalid lead byte
+            len = 1;
+        }
+        for (size_t i = 1; i < len; i++) {
+            if ((s[i] & 0xC0) != 0x80) {
+                // Truncated sequence, also stops at the terminating null
+                cp = 0xFFFD;
+                len = i;
+                break;
+            }
+            cp = (cp << 6) | (s[i] & 0x3F);
+        }
+        if (len > 1 && (cp < min_cp[len] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))) {
+            cp = 0xFFFD;
+        }
+
+        const size_t units = (cp > 0xFFFF) ? 2 : 1;
+        if (n + units > out_max) {
+            *cut = true;
+            break;
+        }
+        if (units == 2) {
+            cp -= 0x10000;
+            out[n++] = 0xD800 | (cp >> 10);
+            out[n++] = 0xDC00 | (cp & 0x3FF);
+        } else {
+            out[n++] = cp;
+        }
+        s += len;
+    }
+    return n;
+}
+
+/**
+ * @brief Encode string descriptor
+ *
+ * Index 0 holds the LANGID array: the first two bytes of the string are copied as they are.
+ *
+ * @param[in] str     UTF-8 string
+ * @param[in] str_idx String descriptor index
+ * @return String descriptor allocated to its length, NULL if out of memory
+ */
+static uint16_t *str_desc_encode(const char *str, int str_idx)
+{
+    uint16_t desc[1 + MAX_DESC_CHARS];
+    size_t chr_count;
+    if (str_idx == 0) {
+        memcpy(&desc[1], str, 2);
+        chr_count = 1;
+    } else {
+        bool cut;
+        chr_count = utf8_to_utf16(str, &desc[1], MAX_DESC_CHARS, &cut);
+        if (cut) {
+            ESP_LOGW(TAG, "String descriptor %d is truncated to %d UTF-16 characters", str_idx, MAX_DESC_CHARS);
+        }
+    }
+    // First byte is length in bytes (including header), second byte is descriptor type (TUSB_DESC_STRING)
+    desc[0] = (TUSB_DESC_STRING << 8) | (2 * chr_count + 2);
+
+    uint16_t *encoded = malloc((1 + chr_count) * sizeof(uint16_t));
+    if (encoded) {
+        memcpy(encoded, desc, (1 + chr_count) * sizeof(uint16_t));
+    }
+    return encoded;
+}
+
+static void str_desc_free(void)
+{
+    for (int i = 0; i < USB_STRING_DESCRIPTOR_ARRAY_SIZE; i++) {
+        free(s_desc_cfg.str[i]);
+        s_desc_cfg.str[i] = NULL;
+    }
+}
+
 // =============================================================================
 // CALLBACKS
 // =============================================================================
@@ -117,6 +230,8 @@ uint8_t const *tud_descriptor_other_speed_configuration_cb(uint8_t index)
 /**
  * @brief Invoked when received GET STRING DESCRIPTOR request
  *
+ * The descriptors are encoded when they are set, so this only returns a pointer and is reentrant.
+ *
  * @param[in] index   Index of required descriptor
  * @param[in] langid  Language of the descriptor
  * @return Pointer to UTF-16 string descriptor
@@ -124,37 +239,16 @@ uint8_t const *tud_descriptor_other_speed_configuration_cb(uint8_t index)
 uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid)
 {
     (void) langid; // Unused, this driver supports only one language in string descriptors
-    assert(s_desc_cfg.str);
-    uint8_t chr_count;
-    static uint16_t _desc_str[MAX_DESC_BUF_SIZE];
-
-    if (index == 0) {
-        memcpy(&_desc_str[1], s_desc_cfg.str[0], 2);
-        chr_count = 1;
-    } else {
-        if (index >= USB_STRING_DESCRIPTOR_ARRAY_SIZE) {
-            ESP_LOGW(TAG, "String index (%u) is out of bounds, check your string descriptor", index);
-            return NULL;
-        }
-
-        if (s_desc_cfg.str[index] == NULL) {
-            ESP_LOGW(TAG, "String index (%u) points to NULL, check your string descriptor", index);
-            return NULL;
-        }
-
-        const char *str = s_desc_cfg.str[index];
-        chr_count = strnlen(str, MAX_DESC_BUF_SIZE - 1); // Buffer len - header
-
-        // Convert ASCII string into UTF-16
-        for (uint8_t i = 0; i < chr_count; i++) {
-            _desc_str[1 + i] = str[i];
-        }
+    if (index >= USB_STRING_DESCRIPTOR_ARRAY_SIZE) {
+        ESP_LOGW(TAG, "String index (%u) is out of bounds, check your string descriptor", index);
+        return NULL;
     }
 
-    // First byte is length in bytes (including header), second byte is descriptor type (TUSB_DESC_STRING)
-    _desc_str[0] = (TUSB_DESC_STRING << 8 ) | (2 * chr_count + 2);
-
-    return _desc_str;
+    if (s_desc_cfg.str[index] == NULL) {
+        ESP_LOGW(TAG, "String index (%u) points to NULL, check your string descriptor", index);
+        return NULL;
+    }
+    return s_desc_cfg.str[index];
 }
 
 // =============================================================================
@@ -180,7 +274,7 @@ esp_err_t tinyusb_set_descriptors(const tinyusb_config_t *config)
     if (config->configuration_descriptor == NULL) {
         // Default configuration descriptor must be provided for the following classes
 #if (CFG_TUD_HID > 0 || CFG_TUD_MIDI > 0 || CFG_TUD_ECM_RNDIS > 0 || CFG_TUD_DFU > 0 || CFG_TUD_DFU_RUNTIME > 0 || CFG_TUD_BTH > 0)
-        ESP_GOTO_ON_FALSE(config->configuration_descriptor, ESP_ERR_INVALID_ARG, fail, TAG, "Configuration descriptor must be provided for this device");
+        ESP_GOTO_ON_FALSE(config->configuration_descriptor, ESP_ERR_INVALID_ARG, fail, TAG, "Configuration descriptor must be provided for this device, see tinyusb_desc_build()");
 #else
         ESP_LOGW(TAG, "No FullSpeed configuration descriptor provided, using default.");
         s_desc_cfg.cfg = descriptor_fs_cfg_default;
@@ -194,7 +288,7 @@ esp_err_t tinyusb_set_descriptors(const tinyusb_config_t *config)
     if (config->hs_configuration_descriptor == NULL) {
         // Default configuration descriptor must be provided for the following classes
 #if (CFG_TUD_HID > 0 || CFG_TUD_MIDI > 0 || CFG_TUD_ECM_RNDIS > 0 || CFG_TUD_DFU > 0 || CFG_TUD_DFU_RUNTIME > 0 || CFG_TUD_BTH > 0)
-        ESP_GOTO_ON_FALSE(config->hs_configuration_descriptor, ESP_ERR_INVALID_ARG, fail, TAG, "HighSpeed configuration descriptor must be provided for this device");
+        ESP_GOTO_ON_FALSE(config->hs_configuration_descriptor, ESP_ERR_INVALID_ARG, fail, TAG, "HighSpeed configuration descriptor must be provided for this device, see tinyusb_desc_build()");
 #else
         ESP_LOGW(TAG, "No HighSpeed configuration descriptor provided, using default.");
         s_desc_cfg.hs_cfg = descriptor_hs_cfg_default;
@@ -236,7 +330,12 @@ esp_err_t tinyusb_set_descriptors(const tinyusb_config_t *config)
     }
 
     ESP_GOTO_ON_FALSE(s_desc_cfg.str_count <= USB_STRING_DESCRIPTOR_ARRAY_SIZE, ESP_ERR_NOT_SUPPORTED, fail, TAG, "String descriptors exceed limit");
-    memcpy(s_desc_cfg.str, pstr_desc, s_desc_cfg.str_count * sizeof(pstr_desc[0]));
+    for (int i = 0; i < s_desc_cfg.str_count; i++) {
+        if (pstr_desc[i]) {
+            s_desc_cfg.str[i] = str_desc_encode(pstr_desc[i], i);
+            ESP_GOTO_ON_FALSE(s_desc_cfg.str[i], ESP_ERR_NO_MEM, fail, TAG, "String descriptor memory allocation error");
+        }
+    }
 
     ESP_LOGI(TAG, "\n"
              "┌─────────────────────────────────┐\n"
@@ -273,20 +372,27 @@ esp_err_t tinyusb_set_descriptors(const tinyusb_config_t *config)
     return ESP_OK;
 
 fail:
+    str_desc_free();
 #if (TUD_OPT_HIGH_SPEED)
     free(s_desc_cfg.other_speed);
 #endif // TUD_OPT_HIGH_SPEED
     return ret;
 }
 
-void tinyusb_set_str_descriptor(const char *str, int str_idx)
+esp_err_t tinyusb_set_str_descriptor(const char *str, int str_idx)
 {
     assert(str_idx < USB_STRING_DESCRIPTOR_ARRAY_SIZE);
-    s_desc_cfg.str[str_idx] = str;
+    uint16_t *encoded = str_desc_encode(str, str_idx);
+    ESP_RETURN_ON_FALSE(encoded, ESP_ERR_NO_MEM, TAG, "String descriptor memory allocation error");
+    uint16_t *old = s_desc_cfg.str[str_idx];
+    s_desc_cfg.str[str_idx] = encoded;
+    free(old);
+    return ESP_OK;
 }
 
 void tinyusb_free_descriptors(void)
 {
+    str_desc_free();
 #if (TUD_OPT_HIGH_SPEED)
     assert(s_desc_cfg.other_speed);
     free(s_desc_cfg.other_speed);
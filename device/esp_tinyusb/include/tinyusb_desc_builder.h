@@ -0,0 +1,113 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Interface types supported by the configuration descriptor builder
+ *
+ * The TinyUSB class driver of the interface must be enabled in menuconfig.
+ */
+typedef enum {
+    TINYUSB_DESC_ITF_CDC_ACM,   /*!< CDC-ACM: IAD, communication and data interface, interrupt notification and bulk IN/OUT endpoints */
+    TINYUSB_DESC_ITF_MSC,       /*!< Mass storage: bulk IN/OUT endpoints */
+    TINYUSB_DESC_ITF_HID,       /*!< HID: interrupt IN endpoint and optional interrupt OUT endpoint */
+    TINYUSB_DESC_ITF_MIDI,      /*!< MIDI: audio control and MIDI streaming interface, bulk IN/OUT endpoints */
+    TINYUSB_DESC_ITF_VENDOR,    /*!< Vendor specific: bulk IN/OUT endpoints */
+    TINYUSB_DESC_ITF_ECM,       /*!< CDC-ECM network: IAD, communication and data interface, interrupt notification and bulk IN/OUT endpoints */
+    TINYUSB_DESC_ITF_NCM,       /*!< CDC-NCM network: IAD, communication and data interface, interrupt notification and bulk IN/OUT endpoints */
+    TINYUSB_DESC_ITF_DFU_RT,    /*!< DFU runtime: no endpoints */
+    TINYUSB_DESC_ITF_DFU,       /*!< DFU mode: one alternate setting, no endpoints */
+    TINYUSB_DESC_ITF_UVC,       /*!< USB video class: IAD, video control and video streaming interface, bulk or isochronous IN endpoint */
+    TINYUSB_DESC_ITF_UAC,       /*!< USB audio class 2.0: IAD, audio control interface, speaker and/or microphone streaming interface as set in menuconfig */
+} tinyusb_desc_itf_type_t;
+
+/**
+ * @brief Configuration of one function (one or more interfaces) in the configuration descriptor
+ */
+typedef struct {
+    tinyusb_desc_itf_type_t type;               /*!< Interface type */
+    uint8_t str_idx;                            /*!< Index of the interface string descriptor, 0 for none */
+    union {
+        struct {
+            uint8_t protocol;                   /*!< Boot protocol: HID_ITF_PROTOCOL_NONE, _KEYBOARD or _MOUSE */
+            uint16_t report_desc_len;           /*!< Length of the HID report descriptor */
+            uint8_t ep_size;                    /*!< Interrupt endpoint size, up to 64 bytes */
+            uint8_t poll_ms;                    /*!< Polling interval in milliseconds, rounded down to power of two for HighSpeed */
+            bool out_ep;                        /*!< Add interrupt OUT endpoint */
+        } hid;                                  /*!< TINYUSB_DESC_ITF_HID configuration */
+        struct {
+            uint8_t mac_str_idx;                /*!< Index of the MAC address string descriptor, 0 to use the one of tinyusb_net */
+        } net;                                  /*!< TINYUSB_DESC_ITF_ECM and TINYUSB_DESC_ITF_NCM configuration */
+        struct {
+            uint8_t attr;                       /*!< DFU attributes: DFU_ATTR_... bits */
+            uint16_t detach_timeout_ms;         /*!< Detach timeout */
+            uint16_t xfer_size;                 /*!< Maximum DFU transfer size */
+        } dfu_rt;                               /*!< TINYUSB_DESC_ITF_DFU_RT configuration */
+        struct {
+            uint8_t attr;                       /*!< DFU attributes: DFU_ATTR_... bits */
+            uint16_t detach_timeout_ms;         /*!< Detach timeout */
+            uint16_t xfer_size;                 /*!< FullSpeed DFU transfer size, up to CONFIG_TINYUSB_DFU_BUFSIZE */
+            uint16_t hs_xfer_size;              /*!< HighSpeed DFU transfer size, up to CONFIG_TINYUSB_DFU_BUFSIZE. 0 for xfer_size */
+        } dfu;                                  /*!< TINYUSB_DESC_ITF_DFU configuration */
+        struct {
+            const struct tinyusb_uvc_config *config; /*!< Format and frames, the same configuration as for tinyusb_uvc_init() */
+        } uvc;                                  /*!< TINYUSB_DESC_ITF_UVC configuration */
+    };
+} tinyusb_desc_itf_config_t;
+
+/**
+ * @brief Configuration descriptors generated by tinyusb_desc_build()
+ */
+typedef struct {
+    uint8_t *fs_cfg;            /*!< FullSpeed configuration descriptor, pass it as configuration_descriptor to tinyusb_driver_install() */
+    uint8_t *hs_cfg;            /*!< HighSpeed configuration descriptor, pass it as hs_configuration_descriptor. NULL if the target is not HighSpeed capable */
+    uint8_t itf_count;          /*!< Number of interfaces */
+    uint8_t ep_count;           /*!< Number of endpoint numbers used, excluding EP0 */
+    bool iad;                   /*!< Some function uses Interface Association Descriptor, so device class must be TUSB_CLASS_MISC, MISC_SUBCLASS_COMMON, MISC_PROTOCOL_IAD */
+} tinyusb_desc_cfg_t;
+
+/**
+ * @brief Build FullSpeed and HighSpeed configuration descriptors from a list of functions
+ *
+ * Interface numbers and endpoint numbers are assigned in order of the list, starting with interface 0 and endpoint 1.
+ * Bulk endpoints are 64 bytes for FullSpeed and 512 bytes for HighSpeed, interrupt intervals are converted to
+ * HighSpeed microframes. Both descriptors have the same length, as required by tinyusb_driver_install().
+ *
+ * The descriptors are built once, call it before tinyusb_driver_install() and keep them until the driver is uninstalled.
+ *
+ * @param[in]  itfs         Functions in the configuration
+ * @param[in]  itf_num      Number of functions
+ * @param[in]  attributes   Configuration attributes: TUSB_DESC_CONFIG_ATT_... bits
+ * @param[in]  power_ma     Maximum power consumption in mA
+ * @param[out] cfg          Generated descriptors, free them by tinyusb_desc_free()
+ * @return
+ *    - ESP_OK                  Descriptors built
+ *    - ESP_ERR_INVALID_ARG     Invalid function configuration
+ *    - ESP_ERR_NOT_SUPPORTED   TinyUSB class driver of a function is not enabled or there are not enough endpoints
+ *    - ESP_ERR_NO_MEM          Out of memory
+ */
+esp_err_t tinyusb_desc_build(const tinyusb_desc_itf_config_t *itfs, size_t itf_num, uint8_t attributes, uint16_t power_ma, tinyusb_desc_cfg_t *cfg);
+
+/**
+ * @brief Free configuration descriptors generated by tinyusb_desc_build()
+ *
+ * @param[in] cfg Generated descriptors
+ */
+void tinyusb_desc_free(tinyusb_desc_cfg_t *cfg);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,69 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Firmware download finished callback
+ *
+ * Called in the DFU OTA task after manifestation. On success the new image is set as the boot partition,
+ * the app restarts to boot it, e.g. by esp_restart().
+ *
+ * @param[in] result    ESP_OK if the image was written and verified, error code otherwise
+ * @param[in] arg       User argument from tinyusb_dfu_ota_config_t
+ */
+typedef void (*tinyusb_dfu_ota_done_cb_t)(esp_err_t result, void *arg);
+
+/**
+ * @brief Configuration of the DFU OTA bridge
+ */
+typedef struct {
+    const char *partition_label;            /*!< Label of the OTA partition to write, NULL for the next update partition */
+    tinyusb_dfu_ota_done_cb_t done_cb;      /*!< Download finished. Can be NULL */
+    void *arg;                              /*!< User argument of done_cb */
+} tinyusb_dfu_ota_config_t;
+
+/**
+ * @brief Initialize the DFU OTA bridge
+ *
+ * Firmware downloaded in DFU mode is written to the OTA partition by a dedicated task, not in TinyUSB task:
+ * while one block is written, the next one is received to the second buffer. The task erases the partition
+ * ahead of the incoming blocks in 64 KB steps whenever it has no block to write. The image is verified and set as
+ * the boot partition at manifestation. The DFU interface descriptor can be generated by tinyusb_desc_build()
+ * with TINYUSB_DESC_ITF_DFU, larger transfer sizes (CONFIG_TINYUSB_DFU_BUFSIZE) need less blocks.
+ *
+ * @note The bridge defines TinyUSB DFU callbacks tud_dfu_*_cb(), the app must not define them.
+ *
+ * @param[in] config Bridge configuration
+ * @return
+ *    - ESP_OK                  Bridge initialized
+ *    - ESP_ERR_INVALID_ARG     config is NULL
+ *    - ESP_ERR_NOT_FOUND       Partition not found
+ *    - ESP_ERR_INVALID_STATE   Already initialized
+ *    - ESP_ERR_NO_MEM          Not enough memory for the buffers or the task
+ */
+esp_err_t tinyusb_dfu_ota_init(const tinyusb_dfu_ota_config_t *config);
+
+/**
+ * @brief Deinitialize the DFU OTA bridge
+ *
+ * A download in progress is aborted.
+ *
+ * @return
+ *    - ESP_OK                  Bridge deinitialized
+ *    - ESP_ERR_INVALID_STATE   Not initialized
+ */
+esp_err_t tinyusb_dfu_ota_deinit(void);
+
+#ifdef __cplusplus
+}
+#endif
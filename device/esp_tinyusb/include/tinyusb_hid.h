@@ -0,0 +1,124 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Merge callback of the HID report queue
+ *
+ * Called with the queue locked, must be short and must not block.
+ *
+ * @param[in]    report_id  Report ID of both reports
+ * @param[inout] pending    Last queued report, not yet sent
+ * @param[in]    report     New report
+ * @param[in]    len        Length of both reports
+ * @param[in]    arg        User argument from tinyusb_hid_queue_config_t
+ * @return true if the new report was merged into the pending one, false to queue it separately
+ */
+typedef bool (*tinyusb_hid_merge_cb_t)(uint8_t report_id, uint8_t *pending, const uint8_t *report, uint16_t len, void *arg);
+
+/**
+ * @brief Configuration of the HID report queue
+ */
+typedef struct {
+    uint8_t instance;                   /*!< HID instance, less than CONFIG_TINYUSB_HID_COUNT */
+    uint16_t report_len_max;            /*!< Longest report without the report ID, up to CFG_TUD_HID_EP_BUFSIZE - 1 */
+    uint8_t queue_len;                  /*!< Number of reports waiting for the endpoint, at least 2 to merge while a report is being sent */
+    tinyusb_hid_merge_cb_t merge_cb;    /*!< Merges relative reports, e.g. tinyusb_hid_merge_mouse(). NULL to queue every report */
+    void *arg;                          /*!< User argument of merge_cb */
+    bool remote_wakeup;                 /*!< Signal remote wakeup when a report is queued while the bus is suspended */
+} tinyusb_hid_queue_config_t;
+
+/**
+ * @brief Statistics of the HID report queue
+ */
+typedef struct {
+    uint32_t sent;                      /*!< Reports passed to TinyUSB */
+    uint32_t merged;                    /*!< Reports merged into a pending one */
+    uint32_t dropped;                   /*!< Pending reports replaced by a newer one, because the queue was full */
+} tinyusb_hid_queue_stats_t;
+
+/**
+ * @brief Initialize the report queue of a HID instance
+ *
+ * Reports go out as soon as the IN endpoint is free, the next one is sent from tud_hid_report_complete_cb(),
+ * so the app does not have to poll tud_hid_n_ready(). A report of the same report ID as the last queued one is
+ * handed to merge_cb first, so relative reports (mouse movement, for example) are accumulated until the next poll
+ * slot instead of being lost. When the queue is full, the last queued report is replaced: the newest state always
+ * goes out.
+ *
+ * @note The queue defines tud_hid_report_complete_cb(), the app must not define it.
+ *
+ * @param[in] config Queue configuration
+ * @return
+ *    - ESP_OK                  Queue initialized
+ *    - ESP_ERR_INVALID_ARG     Invalid configuration
+ *    - ESP_ERR_INVALID_STATE   Queue of the instance already initialized
+ *    - ESP_ERR_NO_MEM          Not enough memory for the queue
+ */
+esp_err_t tinyusb_hid_queue_init(const tinyusb_hid_queue_config_t *config);
+
+/**
+ * @brief Deinitialize the report queue of a HID instance
+ *
+ * Reports not sent yet are discarded. Must not be called while another task calls tinyusb_hid_queue_send()
+ * for the same instance.
+ *
+ * @param[in] instance HID instance
+ * @return
+ *    - ESP_OK                  Queue deinitialized
+ *    - ESP_ERR_INVALID_STATE   Queue not initialized
+ */
+esp_err_t tinyusb_hid_queue_deinit(uint8_t instance);
+
+/**
+ * @brief Queue a report
+ *
+ * Returns immediately, the report is copied. It is merged, queued, or sent right away if the endpoint is free.
+ *
+ * @param[in] instance  HID instance
+ * @param[in] report_id Report ID, 0 if the report descriptor has no report IDs
+ * @param[in] report    Report without the report ID
+ * @param[in] len       Length of the report, up to report_len_max
+ * @return
+ *    - ESP_OK                  Report queued or merged
+ *    - ESP_ERR_INVALID_ARG     Invalid report
+ *    - ESP_ERR_INVALID_STATE   Queue not initialized
+ */
+esp_err_t tinyusb_hid_queue_send(uint8_t instance, uint8_t report_id, const void *report, uint16_t len);
+
+/**
+ * @brief Get statistics of the report queue
+ *
+ * @param[in]  instance HID instance
+ * @param[out] stats    Statistics
+ * @param[in]  reset    Reset the counters after reading
+ * @return
+ *    - ESP_OK                  Statistics read
+ *    - ESP_ERR_INVALID_ARG     stats is NULL
+ *    - ESP_ERR_INVALID_STATE   Queue not initialized
+ */
+esp_err_t tinyusb_hid_queue_get_stats(uint8_t instance, tinyusb_hid_queue_stats_t *stats, bool reset);
+
+/**
+ * @brief Merge callback for the boot protocol mouse report (hid_mouse_report_t)
+ *
+ * Adds up movement, wheel and pan while the buttons stay the same. Reports with changed buttons,
+ * or movement exceeding the int8_t range are queued separately, so no click or step is lost.
+ */
+bool tinyusb_hid_merge_mouse(uint8_t report_id, uint8_t *pending, const uint8_t *report, uint16_t len, void *arg);
+
+#ifdef __cplusplus
+}
+#endif
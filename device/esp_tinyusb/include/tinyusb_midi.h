@@ -0,0 +1,152 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief USB-MIDI 1.0 event packet
+ */
+typedef struct {
+    uint8_t header;                     /*!< Cable number (upper nibble) and Code Index Number (lower nibble) */
+    uint8_t midi[3];                    /*!< MIDI message, padded with zeros */
+} tinyusb_midi_event_t;
+
+/**
+ * @brief Event of a channel voice message, e.g. TINYUSB_MIDI_EVENT(0, 0xB0 | channel, controller, value)
+ *
+ * The Code Index Number of channel voice messages equals the upper nibble of the status byte.
+ */
+#define TINYUSB_MIDI_EVENT(cable, status, data1, data2) \
+    ((tinyusb_midi_event_t) { .header = (uint8_t)(((cable) << 4) | (((status) >> 4) & 0x0F)), .midi = { (status), (data1), (data2) } })
+
+/**
+ * @brief Events received callback
+ *
+ * Called in TinyUSB task with the events of one OUT transfer. USB-MIDI 1.0 events carry no time,
+ * so all events of the transfer share the time of its reception.
+ *
+ * @param[in] itf           MIDI interface
+ * @param[in] events        Received events, valid only during the callback
+ * @param[in] count         Number of events
+ * @param[in] timestamp_us  Time of reception, esp_timer_get_time()
+ * @param[in] arg           User argument from tinyusb_midi_config_t
+ */
+typedef void (*tinyusb_midi_rx_cb_t)(uint8_t itf, const tinyusb_midi_event_t *events, size_t count, int64_t timestamp_us, void *arg);
+
+/**
+ * @brief SysEx data received callback
+ *
+ * Called in TinyUSB task with the SysEx bytes of consecutive events, unpacked from the event packets.
+ * A long message comes in several parts, the first one starts with 0xF0.
+ *
+ * @param[in] itf           MIDI interface
+ * @param[in] cable         Cable number
+ * @param[in] data          SysEx bytes, valid only during the callback
+ * @param[in] len           Number of bytes
+ * @param[in] end           The last byte is 0xF7, the message is complete
+ * @param[in] timestamp_us  Time of reception, esp_timer_get_time()
+ * @param[in] arg           User argument from tinyusb_midi_config_t
+ */
+typedef void (*tinyusb_midi_sysex_cb_t)(uint8_t itf, uint8_t cable, const uint8_t *data, size_t len, bool end, int64_t timestamp_us, void *arg);
+
+/**
+ * @brief Configuration of the MIDI driver
+ */
+typedef struct {
+    tinyusb_midi_rx_cb_t rx_cb;         /*!< Events received. Can be NULL to ignore received events */
+    tinyusb_midi_sysex_cb_t sysex_cb;   /*!< SysEx received. NULL to pass SysEx events to rx_cb */
+    void *arg;                          /*!< User argument of the callbacks */
+} tinyusb_midi_config_t;
+
+/**
+ * @brief Initialize the MIDI driver
+ *
+ * The driver claims all MIDI functions of the configuration instead of TinyUSB MIDI class driver, the MIDI interfaces
+ * are numbered in the order of the configuration descriptor. The function descriptor can be generated
+ * by tinyusb_desc_build() with TINYUSB_DESC_ITF_MIDI.
+ *
+ * Written events are collected in a buffer of CONFIG_TINYUSB_MIDI_TX_BUFSIZE bytes. As soon as the IN endpoint
+ * is free, all collected events up to the endpoint size (64 or 512 bytes) go out in one packet, so a dense stream
+ * costs one transfer per packet instead of one per event. Received packets are delivered to the callbacks
+ * at once, while the next packet is being received to the second buffer.
+ *
+ * @note The driver registers TinyUSB application class driver and replaces tud_midi_*() API, the app must not call it.
+ *
+ * @param[in] config Driver configuration
+ * @return
+ *    - ESP_OK                  Driver initialized
+ *    - ESP_ERR_INVALID_ARG     config is NULL
+ *    - ESP_ERR_INVALID_STATE   Already initialized
+ *    - ESP_ERR_NO_MEM          Out of memory
+ */
+esp_err_t tinyusb_midi_init(const tinyusb_midi_config_t *config);
+
+/**
+ * @brief Deinitialize the MIDI driver and free its buffers
+ *
+ * Call it after tinyusb_driver_uninstall(), or while the device is not mounted.
+ *
+ * @return
+ *    - ESP_OK                  Driver deinitialized
+ *    - ESP_ERR_INVALID_STATE   Not initialized or an interface is in use
+ */
+esp_err_t tinyusb_midi_deinit(void);
+
+/**
+ * @brief Check if the host configured the MIDI interface
+ *
+ * @param[in] itf MIDI interface
+ * @return true if events can be sent
+ */
+bool tinyusb_midi_mounted(uint8_t itf);
+
+/**
+ * @brief Write events
+ *
+ * Returns immediately, the events are copied to the TX buffer as long as there is space.
+ *
+ * @param[in] itf       MIDI interface
+ * @param[in] events    Events to send
+ * @param[in] count     Number of events
+ * @return Number of events written, 0 if the interface is not configured by the host
+ */
+size_t tinyusb_midi_write(uint8_t itf, const tinyusb_midi_event_t *events, size_t count);
+
+/**
+ * @brief Write SysEx data
+ *
+ * The bytes are packed to SysEx events directly in the TX buffer. A message may be written in parts: 0xF0 starts it,
+ * 0xF7 ends it. Bytes are taken in groups of three, so the bytes after the last full group are taken
+ * only if they end the message, the app passes them again with the next part.
+ *
+ * @param[in] itf       MIDI interface
+ * @param[in] cable     Cable number
+ * @param[in] data      SysEx bytes
+ * @param[in] len       Number of bytes
+ * @return Number of bytes taken, 0 if the interface is not configured by the host
+ */
+size_t tinyusb_midi_sysex_write(uint8_t itf, uint8_t cable, const uint8_t *data, size_t len);
+
+/**
+ * @brief Get free space of the TX buffer
+ *
+ * @param[in] itf MIDI interface
+ * @return Number of events tinyusb_midi_write() accepts, 0 if the interface is not configured by the host
+ */
+size_t tinyusb_midi_write_available(uint8_t itf);
+
+#ifdef __cplusplus
+}
+#endif
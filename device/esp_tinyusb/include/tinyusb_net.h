@@ -7,6 +7,8 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
 #include "tinyusb_types.h"
 #include "esp_err.h"
 #include "sdkconfig.h"
@@ -17,6 +19,19 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Maximum number of fragments of one packet sent by tinyusb_net_send_frags_async()
+ */
+#define TINYUSB_NET_TX_FRAGS_MAX    (4)
+
+/**
+ * @brief Fragment of a packet, e.g. one pbuf of lwIP pbuf chain
+ */
+typedef struct {
+    const void *data;                         /*!< Fragment data */
+    uint16_t len;                             /*!< Fragment length */
+} tinyusb_net_frag_t;
+
 /**
  * @brief On receive callback type
  */
@@ -47,8 +62,37 @@ typedef struct {
                                                */
     tusb_net_init_cb_t on_init_callback;      /*!< TinyUSB init network callback */
     void *user_context;                       /*!< User context to be passed to any of the callback */
+    bool recv_loan;                           /*!< Loan the receive buffer to the app instead of reusing it after on_recv_callback returns.
+                                               *    - the buffer stays valid until tinyusb_net_recv_done() is called, from any task
+                                               *    - so the packet can be processed (e.g. by lwIP) without a copy and without blocking TinyUSB task
+                                               *    - next packet is not delivered until the buffer is returned
+                                               */
+    struct {
+        uint16_t ntb_in_size;                 /*!< Datagram bytes aggregated into one IN NTB (device to host), 0: CONFIG_TINYUSB_NET_NCM_NTB_SIZE.
+                                               *    Smaller NTBs are sent sooner, bigger ones carry more datagrams per transfer.
+                                               *    A datagram bigger than this is sent alone.
+                                               */
+        uint8_t ntb_in_max_datagrams;         /*!< Datagrams aggregated into one IN NTB, 0: CONFIG_TINYUSB_NET_NCM_MAX_DATAGRAMS */
+    } ncm;                                    /*!< NCM mode only. OUT NTB sizes are set by the build and advertised to the host */
 } tinyusb_net_config_t;
 
+/**
+ * @brief Statistics of the network driver
+ */
+typedef struct {
+    uint32_t tx_packets;                      /*!< Packets passed to TinyUSB */
+    uint64_t tx_bytes;                        /*!< Data of tx_packets */
+    uint32_t rx_packets;                      /*!< Packets received from TinyUSB */
+    uint64_t rx_bytes;                        /*!< Data of rx_packets */
+    uint32_t tx_drop_queue_full;              /*!< Async sends rejected, CONFIG_TINYUSB_NET_TX_QUEUE_SIZE packets were queued */
+    uint32_t tx_drop_timeout;                 /*!< Sync sends timed out */
+    uint32_t tx_drop_disconnected;            /*!< Sends rejected and queued packets dropped, the device was not connected */
+    uint32_t rx_drop_no_callback;             /*!< Packets received without on_recv_callback */
+    uint32_t rx_drop_app;                     /*!< Packets on_recv_callback returned an error for */
+    uint32_t tx_ntb;                          /*!< NCM: IN NTBs filled, counted as runs of packets passed to TinyUSB without a break */
+    uint8_t tx_ntb_fill_pct;                  /*!< NCM: Average datagram bytes of tx_ntb in percent of ntb_in_size */
+} tinyusb_net_stats_t;
+
 /**
  * @brief Initialize TinyUSB NET driver
  *
@@ -63,15 +107,17 @@ esp_err_t tinyusb_net_init(tinyusb_usbdev_t usb_dev, const tinyusb_net_config_t
  *
  * @note It is possible to use sync and async send interchangeably.
  * This function needs some synchronization primitives, so using sync mode (even once) uses more heap
+ * @note The packet goes through the same TX queue as the async ones. If the queue is full or USB cannot
+ * accept more data, the caller waits (up to the timeout) instead of the packet being dropped.
  *
  * @param[in] buffer            USB send data
  * @param[in] len               Send data len
  * @param[in] buff_free_arg     Pointer to be passed to the free_tx_buffer() callback
- * @param[in] timeout           Send data len
+ * @param[in] timeout           Timeout for the whole send, including waiting for a free slot in the TX queue
  * @return  ESP_OK on success == packet has been consumed by tusb and would be eventually freed
  *                              by free_tx_buffer() callback (if non null)
  *          ESP_ERR_TIMEOUT on timeout
- *          ESP_ERR_INVALID_STATE if tusb not initialized, ESP_ERR_NO_MEM on alloc failure
+ *          ESP_ERR_INVALID_STATE if tusb not initialized or the device was disconnected, ESP_ERR_NO_MEM on alloc failure
  */
 esp_err_t tinyusb_net_send_sync(void *buffer, uint16_t len, void *buff_free_arg, TickType_t  timeout);
 
@@ -80,8 +126,8 @@ esp_err_t tinyusb_net_send_sync(void *buffer, uint16_t len, void *buff_free_arg,
  *
  * @note If using asynchronous sends, you must free the buffer using free_tx_buffer() callback.
  * @note It is possible to use sync and async send interchangeably.
- * @note Async flavor of the send is useful when the USB stack runs faster than the caller,
- * since we have no control over the transmitted packets, if they get accepted or discarded.
+ * @note Async flavor of the send is useful when the USB stack runs faster than the caller.
+ * Queued packets wait until USB accepts them, they are only discarded if the device gets disconnected.
  *
  * @param[in] buffer            USB send data
  * @param[in] len               Send data len
@@ -89,9 +135,47 @@ esp_err_t tinyusb_net_send_sync(void *buffer, uint16_t len, void *buff_free_arg,
  * @return  ESP_OK on success == packet has been consumed by tusb and will be freed
  *                              by free_tx_buffer() callback (if non null)
  *          ESP_ERR_INVALID_STATE if tusb not initialized
+ *          ESP_ERR_NO_MEM if CONFIG_TINYUSB_NET_TX_QUEUE_SIZE packets are already queued
  */
 esp_err_t tinyusb_net_send_async(void *buffer, uint16_t len, void *buff_free_arg);
 
+/**
+ * @brief TinyUSB NET driver send fragmented packet asynchronously
+ *
+ * Fragments are copied one after another right into the USB transfer buffer, so a chained packet
+ * (e.g. lwIP pbuf chain) does not have to be copied to a contiguous buffer first.
+ * The fragments must stay valid until the free_tx_buffer() callback is called, the array itself is copied.
+ *
+ * @param[in] frags             Fragments of the packet, in order
+ * @param[in] frag_num          Number of fragments, up to TINYUSB_NET_TX_FRAGS_MAX
+ * @param[in] buff_free_arg     Pointer to be passed to the free_tx_buffer() callback
+ * @return  Same as tinyusb_net_send_async()
+ *          ESP_ERR_INVALID_ARG if there are no or too many fragments
+ */
+esp_err_t tinyusb_net_send_frags_async(const tinyusb_net_frag_t *frags, size_t frag_num, void *buff_free_arg);
+
+/**
+ * @brief Return the receive buffer loaned to the app
+ *
+ * Only used with recv_loan enabled in tinyusb_net_config_t. TinyUSB continues with the next received packet.
+ *
+ * @param[in] buffer            Buffer passed to on_recv_callback()
+ * @return  ESP_OK on success
+ *          ESP_ERR_INVALID_ARG if the buffer is not the one loaned
+ */
+esp_err_t tinyusb_net_recv_done(void *buffer);
+
+/**
+ * @brief Get statistics of the network driver
+ *
+ * @param[out] stats Statistics
+ * @param[in]  reset Reset the statistics after reading
+ * @return  ESP_OK on success
+ *          ESP_ERR_INVALID_ARG if stats is NULL
+ *          ESP_ERR_NOT_SUPPORTED if CONFIG_TINYUSB_NET_STATS is disabled
+ */
+esp_err_t tinyusb_net_get_stats(tinyusb_net_stats_t *stats, bool reset);
+
 #endif // (CONFIG_TINYUSB_NET_MODE_NONE != 1)
 
 #ifdef __cplusplus
@@ -0,0 +1,65 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Bus power events
+ */
+typedef enum {
+    TINYUSB_POWER_EVENT_SUSPEND,            /*!< Host suspended the bus */
+    TINYUSB_POWER_EVENT_RESUME,             /*!< Bus resumed by the host or by remote wakeup */
+} tinyusb_power_event_t;
+
+/**
+ * @brief Bus power event callback
+ *
+ * Called in TinyUSB task. On suspend the callback runs before the power locks are released,
+ * on resume after they are taken again, so the app may save and restore the state of its peripherals there.
+ *
+ * @param[in] event             Event
+ * @param[in] remote_wakeup_en  Host allows the device to wake it up by tinyusb_power_remote_wakeup()
+ * @param[in] arg               User argument from tinyusb_power_register_callback()
+ */
+typedef void (*tinyusb_power_cb_t)(tinyusb_power_event_t event, bool remote_wakeup_en, void *arg);
+
+/**
+ * @brief Register bus power event callback
+ *
+ * Suspend handling defines TinyUSB callbacks tud_suspend_cb() and tud_resume_cb(), the app gets the events here.
+ *
+ * @param[in] cb    Callback, NULL to unregister
+ * @param[in] arg   User argument of the callback
+ * @return
+ *    - ESP_OK                  Callback registered
+ */
+esp_err_t tinyusb_power_register_callback(tinyusb_power_cb_t cb, void *arg);
+
+/**
+ * @brief Wake up the suspended host
+ *
+ * Signals remote wakeup, the host then resumes the bus. The power locks are taken right away,
+ * so the device stays awake until the bus is resumed. Reports queued by tinyusb_hid_queue_send() go out
+ * after the resume.
+ *
+ * @return
+ *    - ESP_OK                  Remote wakeup signalled
+ *    - ESP_ERR_INVALID_STATE   Bus is not suspended
+ *    - ESP_ERR_NOT_SUPPORTED   Host did not enable remote wakeup, or the configuration descriptor
+ *                              lacks TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP
+ */
+esp_err_t tinyusb_power_remote_wakeup(void);
+
+#ifdef __cplusplus
+}
+#endif
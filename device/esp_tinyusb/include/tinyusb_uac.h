@@ -0,0 +1,131 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TINYUSB_UAC_SAMPLE_RATES_MAX    (8)
+
+/**
+ * @brief Sample rate changed callback
+ *
+ * Called in TinyUSB task when the host selects a new sample rate, the app should reconfigure its I2S clock.
+ *
+ * @param[in] sample_rate   New sample rate in Hz
+ * @param[in] arg           User argument from tinyusb_uac_config_t
+ */
+typedef void (*tinyusb_uac_rate_cb_t)(uint32_t sample_rate, void *arg);
+
+/**
+ * @brief Speaker mute or volume changed callback
+ *
+ * Called in TinyUSB task.
+ *
+ * @param[in] mute          Speaker is muted
+ * @param[in] volume        Volume in 1/256 dB, from -90 dB to 0 dB
+ * @param[in] arg           User argument from tinyusb_uac_config_t
+ */
+typedef void (*tinyusb_uac_volume_cb_t)(bool mute, int16_t volume, void *arg);
+
+/**
+ * @brief Stream started or stopped callback
+ *
+ * Called in TinyUSB task when the host selects the streaming or the zero bandwidth alternate setting.
+ *
+ * @param[in] speaker       true for the speaker (OUT) stream, false for the microphone (IN) stream
+ * @param[in] active        Stream started
+ * @param[in] arg           User argument from tinyusb_uac_config_t
+ */
+typedef void (*tinyusb_uac_stream_cb_t)(bool speaker, bool active, void *arg);
+
+/**
+ * @brief Configuration of the UAC 2.0 device
+ *
+ * Channel count, sample size and the maximum sample rate are set in menuconfig, because TinyUSB sizes
+ * the audio endpoints and buffers at compile time.
+ */
+typedef struct {
+    const uint32_t *sample_rates;       /*!< Supported sample rates in Hz, the first one is the default, up to CONFIG_TINYUSB_UAC_MAX_SAMPLE_RATE */
+    uint8_t sample_rate_num;            /*!< Number of sample rates, up to TINYUSB_UAC_SAMPLE_RATES_MAX */
+    tinyusb_uac_rate_cb_t rate_cb;      /*!< Sample rate changed. Can be NULL */
+    tinyusb_uac_volume_cb_t volume_cb;  /*!< Speaker mute or volume changed. Can be NULL */
+    tinyusb_uac_stream_cb_t stream_cb;  /*!< Stream started or stopped. Can be NULL */
+    void *arg;                          /*!< User argument of the callbacks */
+} tinyusb_uac_config_t;
+
+/**
+ * @brief Initialize the UAC 2.0 device
+ *
+ * The audio function descriptor is generated by tinyusb_desc_build() with TINYUSB_DESC_ITF_UAC.
+ * The speaker uses an asynchronous isochronous OUT endpoint with explicit feedback: the feedback follows the fill level
+ * of the speaker buffer, which is drained by the app at the rate of its I2S clock. The speaker and microphone buffers
+ * hold CONFIG_TINYUSB_UAC_LATENCY_MS of audio at the maximum sample rate.
+ *
+ * @param[in] config UAC configuration
+ * @return
+ *    - ESP_OK                  UAC initialized
+ *    - ESP_ERR_INVALID_ARG     Invalid configuration
+ *    - ESP_ERR_INVALID_STATE   Already initialized
+ */
+esp_err_t tinyusb_uac_init(const tinyusb_uac_config_t *config);
+
+/**
+ * @brief Deinitialize the UAC 2.0 device
+ *
+ * @return
+ *    - ESP_OK                  UAC deinitialized
+ *    - ESP_ERR_INVALID_STATE   Not initialized
+ */
+esp_err_t tinyusb_uac_deinit(void);
+
+/**
+ * @brief Get current sample rate
+ *
+ * @return Sample rate in Hz
+ */
+uint32_t tinyusb_uac_get_sample_rate(void);
+
+/**
+ * @brief Read speaker samples
+ *
+ * Copies interleaved samples from the endpoint buffer, read them straight into the I2S DMA buffer
+ * (e.g. from the I2S on_sent callback or the task refilling it) to avoid a further copy.
+ *
+ * @param[out] buf  Destination buffer
+ * @param[in]  len  Buffer size in bytes, multiple of the frame size (channels * bytes per sample)
+ * @return Number of bytes read
+ */
+size_t tinyusb_uac_speaker_read(void *buf, size_t len);
+
+/**
+ * @brief Get number of speaker bytes available for tinyusb_uac_speaker_read()
+ *
+ * @return Number of bytes
+ */
+size_t tinyusb_uac_speaker_available(void);
+
+/**
+ * @brief Write microphone samples
+ *
+ * Copies interleaved samples to the endpoint buffer, from which TinyUSB sends one (micro)frame of samples per packet.
+ *
+ * @param[in] buf   Samples
+ * @param[in] len   Number of bytes, multiple of the frame size (channels * bytes per sample)
+ * @return Number of bytes written, less than len if the buffer is full
+ */
+size_t tinyusb_uac_mic_write(const void *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
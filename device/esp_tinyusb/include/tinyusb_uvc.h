@@ -0,0 +1,139 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Video format of the UVC stream
+ */
+typedef enum {
+    TINYUSB_UVC_FORMAT_YUY2,        /*!< Uncompressed YUV 4:2:2, 16 bits per pixel */
+    TINYUSB_UVC_FORMAT_MJPEG,       /*!< Motion JPEG */
+} tinyusb_uvc_format_t;
+
+/**
+ * @brief Frame size and rate offered to the host
+ */
+typedef struct {
+    uint16_t width;                 /*!< Frame width in pixels */
+    uint16_t height;                /*!< Frame height in pixels */
+    uint8_t fps;                    /*!< Frame rate */
+} tinyusb_uvc_frame_t;
+
+/**
+ * @brief Streaming started callback
+ *
+ * Called in TinyUSB task, when the host commits streaming parameters. The app should start producing frames of
+ * the selected size and submit them with tinyusb_uvc_submit_frame().
+ *
+ * @param[in] frame     Frame selected by the host
+ * @param[in] arg       User argument from tinyusb_uvc_config_t
+ */
+typedef void (*tinyusb_uvc_start_cb_t)(const tinyusb_uvc_frame_t *frame, void *arg);
+
+/**
+ * @brief Frame sent callback
+ *
+ * Called in TinyUSB task, when the frame submitted by tinyusb_uvc_submit_frame() was sent and its buffer can be reused.
+ *
+ * @param[in] buf       Frame buffer
+ * @param[in] arg       User argument from tinyusb_uvc_config_t
+ */
+typedef void (*tinyusb_uvc_frame_done_cb_t)(const uint8_t *buf, void *arg);
+
+/**
+ * @brief Configuration of the UVC device
+ */
+typedef struct tinyusb_uvc_config {
+    tinyusb_uvc_format_t format;            /*!< Video format */
+    const tinyusb_uvc_frame_t *frames;      /*!< Frames offered to the host, the first one is the default */
+    uint8_t frame_num;                      /*!< Number of frames */
+    tinyusb_uvc_start_cb_t start_cb;        /*!< Streaming started. Can be NULL */
+    tinyusb_uvc_frame_done_cb_t frame_done_cb; /*!< Frame sent. Can be NULL */
+    void *arg;                              /*!< User argument of the callbacks */
+} tinyusb_uvc_config_t;
+
+/**
+ * @brief Statistics of the UVC stream
+ */
+typedef struct {
+    uint32_t frames;                /*!< Frames sent */
+    uint64_t bytes;                 /*!< Bytes of frames sent, without payload headers */
+    float fps;                      /*!< Achieved frame rate */
+    uint32_t bytes_per_sec;         /*!< Achieved bandwidth */
+} tinyusb_uvc_stats_t;
+
+/**
+ * @brief Initialize the UVC device
+ *
+ * The configuration descriptor with the video control and video streaming interfaces is generated
+ * by tinyusb_desc_build() with TINYUSB_DESC_ITF_UVC from the same configuration, which must stay valid.
+ * Format and frame negotiation (probe and commit) is done by TinyUSB video class driver.
+ *
+ * @param[in] config UVC configuration
+ * @return
+ *    - ESP_OK                  UVC initialized
+ *    - ESP_ERR_INVALID_ARG     Invalid configuration
+ *    - ESP_ERR_INVALID_STATE   Already initialized
+ */
+esp_err_t tinyusb_uvc_init(const tinyusb_uvc_config_t *config);
+
+/**
+ * @brief Deinitialize the UVC device
+ *
+ * @return
+ *    - ESP_OK                  UVC deinitialized
+ *    - ESP_ERR_INVALID_STATE   Not initialized
+ */
+esp_err_t tinyusb_uvc_deinit(void);
+
+/**
+ * @brief Submit a frame
+ *
+ * The frame is not copied: TinyUSB splits it into payloads and fills the endpoint buffer with the payload header and
+ * data straight from buf. The buffer, e.g. camera or JPEG encoder output, must stay valid until frame_done_cb.
+ *
+ * @param[in] buf   Frame data
+ * @param[in] len   Frame length, YUY2: width * height * 2, MJPEG: length of the JPEG image
+ * @return
+ *    - ESP_OK                  Frame submitted
+ *    - ESP_ERR_INVALID_ARG     Invalid arguments
+ *    - ESP_ERR_INVALID_STATE   The host is not streaming or the previous frame is still being sent
+ */
+esp_err_t tinyusb_uvc_submit_frame(const uint8_t *buf, size_t len);
+
+/**
+ * @brief Check if the host is streaming
+ *
+ * @return true if the host committed streaming parameters and the stream is active
+ */
+bool tinyusb_uvc_streaming(void);
+
+/**
+ * @brief Get statistics of the UVC stream
+ *
+ * Frame rate and bandwidth are computed over the time since the last reset.
+ *
+ * @param[out] stats    Statistics
+ * @param[in]  reset    Reset the statistics after reading
+ * @return
+ *    - ESP_OK                  Statistics read
+ *    - ESP_ERR_INVALID_ARG     stats is NULL
+ */
+esp_err_t tinyusb_uvc_get_stats(tinyusb_uvc_stats_t *stats, bool reset);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,115 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TINYUSB_VENDOR_STREAM_BUF_NUM_MAX   (8)
+
+/**
+ * @brief Completion callback of the vendor stream
+ *
+ * Called in TinyUSB task.
+ *
+ * @param[in] buf   Buffer of the transfer
+ * @param[in] len   IN: number of bytes sent, 0 if the buffer was dropped on bus reset.
+ *                  OUT: number of bytes received
+ * @param[in] arg   User argument from tinyusb_vendor_stream_config_t
+ */
+typedef void (*tinyusb_vendor_stream_cb_t)(uint8_t *buf, size_t len, void *arg);
+
+/**
+ * @brief Configuration of the vendor stream
+ */
+typedef struct {
+    uint8_t itf;                            /*!< Number of the vendor specific interface with bulk endpoints in the configuration descriptor */
+    size_t xfer_size;                       /*!< Size of each buffer = maximum size of a transfer, multiple of the endpoint size, up to 65024 bytes */
+    uint8_t buf_num;                        /*!< Number of buffers per direction, 2 for ping-pong, up to TINYUSB_VENDOR_STREAM_BUF_NUM_MAX */
+    tinyusb_vendor_stream_cb_t in_done_cb;  /*!< IN transfer completed, the buffer is free again. Can be NULL */
+    tinyusb_vendor_stream_cb_t out_cb;      /*!< OUT transfer received. The buffer belongs to the app until tinyusb_vendor_stream_out_release(). NULL if the interface has no OUT endpoint */
+    void *arg;                              /*!< User argument of the callbacks */
+} tinyusb_vendor_stream_config_t;
+
+/**
+ * @brief Initialize the vendor stream
+ *
+ * Allocates buf_num DMA capable buffers per direction. The stream claims the vendor specific interface itf
+ * instead of TinyUSB vendor class driver, so its endpoints transfer straight from and to the buffers without FIFO copies.
+ * The interface descriptor can be generated by tinyusb_desc_build() with TINYUSB_DESC_ITF_VENDOR.
+ *
+ * OUT transfers are received to free buffers as long as the app releases them, so with two buffers one is being filled
+ * by USB while the app processes the other. IN buffers are sent in order of submission.
+ *
+ * @note The stream registers TinyUSB application class driver by usbd_app_driver_get_cb(), the app must not define it.
+ *
+ * @param[in] config Stream configuration
+ * @return
+ *    - ESP_OK                  Stream initialized
+ *    - ESP_ERR_INVALID_ARG     Invalid configuration
+ *    - ESP_ERR_INVALID_STATE   Already initialized
+ *    - ESP_ERR_NO_MEM          Out of memory
+ */
+esp_err_t tinyusb_vendor_stream_init(const tinyusb_vendor_stream_config_t *config);
+
+/**
+ * @brief Deinitialize the vendor stream and free its buffers
+ *
+ * Call it after tinyusb_driver_uninstall(), or while the device is not mounted.
+ *
+ * @return
+ *    - ESP_OK                  Stream deinitialized
+ *    - ESP_ERR_INVALID_STATE   Not initialized or the interface is in use
+ */
+esp_err_t tinyusb_vendor_stream_deinit(void);
+
+/**
+ * @brief Get free IN buffer
+ *
+ * The buffer has xfer_size bytes. It belongs to the app until it is submitted by tinyusb_vendor_stream_in_submit().
+ *
+ * @param[in] timeout_ticks Time to wait for a buffer to be sent
+ * @return Buffer, NULL on timeout
+ */
+uint8_t *tinyusb_vendor_stream_in_get_buf(TickType_t timeout_ticks);
+
+/**
+ * @brief Submit IN buffer
+ *
+ * The data are sent when all previously submitted buffers are sent. If len is a multiple of the endpoint size
+ * and smaller than the host read request, the host waits for more data, so such transfers should be xfer_size long.
+ *
+ * @param[in] buf   Buffer from tinyusb_vendor_stream_in_get_buf()
+ * @param[in] len   Number of bytes to send, 1..xfer_size
+ * @return
+ *    - ESP_OK                  Buffer submitted
+ *    - ESP_ERR_INVALID_ARG     Not a stream buffer or invalid length, the buffer still belongs to the app
+ *    - ESP_ERR_INVALID_STATE   Interface is not configured by the host, the buffer was returned to the free buffers
+ */
+esp_err_t tinyusb_vendor_stream_in_submit(uint8_t *buf, size_t len);
+
+/**
+ * @brief Release OUT buffer passed to out_cb
+ *
+ * The buffer is used for the next OUT transfer.
+ *
+ * @param[in] buf Buffer from out_cb
+ * @return
+ *    - ESP_OK                  Buffer released
+ *    - ESP_ERR_INVALID_ARG     Not a stream OUT buffer owned by the app
+ */
+esp_err_t tinyusb_vendor_stream_out_release(uint8_t *buf);
+
+#ifdef __cplusplus
+}
+#endif
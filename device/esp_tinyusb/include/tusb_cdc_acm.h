@@ -28,6 +28,8 @@ extern "C" {
 typedef enum {
     TINYUSB_CDC_ACM_0 = 0x0,
     TINYUSB_CDC_ACM_1,
+    TINYUSB_CDC_ACM_2,
+    TINYUSB_CDC_ACM_3,
     TINYUSB_CDC_ACM_MAX
 } tinyusb_cdcacm_itf_t;
 
@@ -83,6 +85,33 @@ typedef struct {
  */
 typedef void(*tusb_cdcacm_callback_t)(int itf, cdcacm_event_t *event);
 
+/**
+ * @brief Callback of framed receive, invoked once per message
+ *
+ * Called from TinyUSB task. The message points to the RX buffer of the port if it is contiguous there,
+ * it is valid only during the callback. The port must not be read from the callback.
+ *
+ * @param[in] itf       Index of CDC interface
+ * @param[in] msg       Message including the delimiter
+ * @param[in] len       Length of the message
+ * @param[in] truncated The message was longer than max_len, this is the first max_len bytes of it or the next part
+ * @param[in] arg       User argument
+ */
+typedef void (*tusb_cdcacm_frame_cb_t)(int itf, const uint8_t *msg, size_t len, bool truncated, void *arg);
+
+/**
+ * @brief Framed receive configuration
+ *
+ * The delimiter is set as wanted character of the interface. With rx_buf_size, the RX buffer is searched for messages
+ * only when a delimiter arrives, not on each USB packet. Without it, data are read to an internal buffer of max_len bytes.
+ */
+typedef struct {
+    tusb_cdcacm_frame_cb_t frame_cb;    /*!< Callback of complete messages. NULL disables framed receive */
+    char delimiter;                     /*!< Character ending each message, e.g. '\n' for lines */
+    size_t max_len;                     /*!< Maximum message length including the delimiter. Must not exceed rx_buf_size if it is set */
+    void *arg;                          /*!< User argument of frame_cb */
+} tinyusb_cdcacm_framing_config_t;
+
 /*********************************************************************** Callbacks and events*/
 /* Other structs
    ********************************************************************* */
@@ -98,6 +127,9 @@ typedef struct {
     tusb_cdcacm_callback_t callback_rx_wanted_char; /*!< Pointer to the function with the `tusb_cdcacm_callback_t` type that will be handled as a callback */
     tusb_cdcacm_callback_t callback_line_state_changed; /*!< Pointer to the function with the `tusb_cdcacm_callback_t` type that will be handled as a callback */
     tusb_cdcacm_callback_t callback_line_coding_changed; /*!< Pointer to the function with the `tusb_cdcacm_callback_t` type that will be handled as a callback */
+    size_t rx_buf_size; /*!< RX buffer of this port in bytes, added to the TinyUSB FIFO of CONFIG_TINYUSB_CDC_RX_BUFSIZE. 0 for the FIFO only */
+    size_t tx_buf_size; /*!< TX buffer of this port in bytes, added to the TinyUSB FIFO of CONFIG_TINYUSB_CDC_TX_BUFSIZE. 0 for the FIFO only */
+    tinyusb_cdcacm_framing_config_t framing; /*!< Deliver delimited messages to a callback, the port is not read otherwise. Disabled if frame_cb is NULL */
 } tinyusb_config_cdcacm_t;
 
 /*********************************************************************** Other structs*/
@@ -161,6 +193,21 @@ size_t tinyusb_cdcacm_write_queue_char(tinyusb_cdcacm_itf_t itf, char ch);
  */
 size_t tinyusb_cdcacm_write_queue(tinyusb_cdcacm_itf_t itf, const uint8_t *in_buf, size_t in_size);
 
+/**
+ * @brief Write data to CDC interface, wait for free space in write buffer if needed
+ *
+ * Unlike tinyusb_cdcacm_write_queue(), data which do not fit in the write buffer are not dropped:
+ * the buffer is flushed and the caller sleeps until an IN transfer completes, then writes the rest.
+ * The written data are flushed before returning.
+ *
+ * @param[in] itf             Index of CDC interface
+ * @param[in] in_buf          Data
+ * @param[in] in_size         Data size in bytes
+ * @param[in] timeout_ticks   Timeout for writing all the data
+ * @return size_t - amount of queued bytes, less than in_size on timeout
+ */
+size_t tinyusb_cdcacm_write(tinyusb_cdcacm_itf_t itf, const uint8_t *in_buf, size_t in_size, uint32_t timeout_ticks);
+
 /**
  * @brief Flush data in write buffer of CDC interface
  *
@@ -190,6 +237,23 @@ esp_err_t tinyusb_cdcacm_write_flush(tinyusb_cdcacm_itf_t itf, uint32_t timeout_
  */
 esp_err_t tinyusb_cdcacm_read(tinyusb_cdcacm_itf_t itf, uint8_t *out_buf, size_t out_buf_sz, size_t *rx_data_size);
 
+/**
+ * @brief Receive data from CDC interface, wait for data if there are none
+ *
+ * The caller sleeps until the data are received, there is no need to poll tinyusb_cdcacm_read() or
+ * to handle CDC_EVENT_RX. All data available are returned, up to out_buf_sz.
+ *
+ * @param[in] itf           Index of CDC interface
+ * @param[out] out_buf      Data buffer
+ * @param[in] out_buf_sz    Data buffer size in bytes
+ * @param[out] rx_data_size Number of bytes written to out_buf
+ * @param[in] timeout_ticks Timeout for waiting for the first byte
+ * @return - ESP_OK                 Some data received
+ *         - ESP_ERR_TIMEOUT        No data received in time
+ *         - ESP_ERR_INVALID_STATE  Interface is not initialized
+ */
+esp_err_t tinyusb_cdcacm_read_wait(tinyusb_cdcacm_itf_t itf, uint8_t *out_buf, size_t out_buf_sz, size_t *rx_data_size, uint32_t timeout_ticks);
+
 /**
  * @brief Check if the CDC interface is initialized
  *
@@ -59,6 +59,14 @@ extern "C" {
 #   define CONFIG_TINYUSB_VENDOR_COUNT 0
 #endif
 
+#ifndef CONFIG_TINYUSB_UAC_ENABLED
+#   define CONFIG_TINYUSB_UAC_ENABLED 0
+#endif
+
+#ifndef CONFIG_TINYUSB_UVC_ENABLED
+#   define CONFIG_TINYUSB_UVC_ENABLED 0
+#endif
+
 #ifndef CONFIG_TINYUSB_NET_MODE_ECM_RNDIS
 #   define CONFIG_TINYUSB_NET_MODE_ECM_RNDIS 0
 #endif
@@ -122,6 +130,10 @@ extern "C" {
 
 #define CFG_TUSB_OS                 OPT_OS_FREERTOS
 
+#ifdef CONFIG_TINYUSB_TASK_QUEUE_SIZE
+#   define CFG_TUD_TASK_QUEUE_SZ    CONFIG_TINYUSB_TASK_QUEUE_SIZE
+#endif
+
 /* USB DMA on some MCUs can only access a specific SRAM region with restriction on alignment.
  * Tinyusb use follows macros to declare transferring memory so that they can be put
  * into those specific section.
@@ -134,8 +146,13 @@ extern "C" {
 #endif
 
 #ifndef CFG_TUSB_MEM_ALIGN
+#if CONFIG_CACHE_L1_CACHE_LINE_SIZE
+// Class buffers, e.g. of MSC, are passed to media drivers with DMA, which need them cache line aligned
+#   define CFG_TUSB_MEM_ALIGN       TU_ATTR_ALIGNED(CONFIG_CACHE_L1_CACHE_LINE_SIZE)
+#else
 #   define CFG_TUSB_MEM_ALIGN       TU_ATTR_ALIGNED(4)
 #endif
+#endif
 
 #ifndef CFG_TUD_ENDPOINT0_SIZE
 #define CFG_TUD_ENDPOINT0_SIZE      64
@@ -167,6 +184,62 @@ extern "C" {
 // Number of BTH ISO alternatives
 #define CFG_TUD_BTH_ISO_ALT_COUNT   CONFIG_TINYUSB_BTH_ISO_ALT_COUNT
 
+// Audio function: speaker with feedback endpoint and/or microphone, see tinyusb_uac.c for the descriptor
+#if CONFIG_TINYUSB_UAC_ENABLED
+#define TINYUSB_UAC_SPK_CH          CONFIG_TINYUSB_UAC_SPEAKER_CHANNELS
+#define TINYUSB_UAC_MIC_CH          CONFIG_TINYUSB_UAC_MIC_CHANNELS
+#if (TINYUSB_UAC_SPK_CH == 0) && (TINYUSB_UAC_MIC_CH == 0)
+#error "UAC needs speaker or microphone channels"
+#endif
+// Samples of one FullSpeed frame at the maximum rate, plus one for asynchronous rate adaptation.
+// HighSpeed microframes carry 1/8 of it, see tinyusb_uac.c
+#define TINYUSB_UAC_EP_SIZE(ch)     ((CONFIG_TINYUSB_UAC_MAX_SAMPLE_RATE / 1000 + 1) * (ch) * CONFIG_TINYUSB_UAC_SAMPLE_BYTES)
+#define TINYUSB_UAC_LATENCY_SIZE(ch) (CONFIG_TINYUSB_UAC_MAX_SAMPLE_RATE / 1000 * CONFIG_TINYUSB_UAC_LATENCY_MS * (ch) * CONFIG_TINYUSB_UAC_SAMPLE_BYTES)
+#define TINYUSB_UAC_BUF_SIZE(ch)    (TINYUSB_UAC_LATENCY_SIZE(ch) > 4 * TINYUSB_UAC_EP_SIZE(ch) ? TINYUSB_UAC_LATENCY_SIZE(ch) : 4 * TINYUSB_UAC_EP_SIZE(ch))
+
+#define CFG_TUD_AUDIO_FUNC_1_DESC_LEN       (34 + (TINYUSB_UAC_SPK_CH ? 97 + 4 * (TINYUSB_UAC_SPK_CH + 1) : 0) + (TINYUSB_UAC_MIC_CH ? 84 : 0))
+#define CFG_TUD_AUDIO_FUNC_1_N_AS_INT       ((TINYUSB_UAC_SPK_CH > 0) + (TINYUSB_UAC_MIC_CH > 0))
+#define CFG_TUD_AUDIO_FUNC_1_CTRL_BUF_SZ    64
+#if TINYUSB_UAC_SPK_CH
+#define CFG_TUD_AUDIO_ENABLE_EP_OUT                 1
+#define CFG_TUD_AUDIO_ENABLE_FEEDBACK_EP            1
+#define CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_RX  CONFIG_TINYUSB_UAC_SAMPLE_BYTES
+#define CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_RX          TINYUSB_UAC_SPK_CH
+#define CFG_TUD_AUDIO_FUNC_1_EP_OUT_SZ_MAX          TINYUSB_UAC_EP_SIZE(TINYUSB_UAC_SPK_CH)
+#define CFG_TUD_AUDIO_FUNC_1_EP_OUT_SW_BUF_SZ       TINYUSB_UAC_BUF_SIZE(TINYUSB_UAC_SPK_CH)
+#endif
+#if TINYUSB_UAC_MIC_CH
+#define CFG_TUD_AUDIO_ENABLE_EP_IN                  1
+#define CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX  CONFIG_TINYUSB_UAC_SAMPLE_BYTES
+#define CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX          TINYUSB_UAC_MIC_CH
+#define CFG_TUD_AUDIO_FUNC_1_EP_IN_SZ_MAX           TINYUSB_UAC_EP_SIZE(TINYUSB_UAC_MIC_CH)
+#define CFG_TUD_AUDIO_FUNC_1_EP_IN_SW_BUF_SZ        TINYUSB_UAC_BUF_SIZE(TINYUSB_UAC_MIC_CH)
+#endif
+#endif // CONFIG_TINYUSB_UAC_ENABLED
+
+// Video streaming endpoint
+#if CONFIG_TINYUSB_UVC_TRANSFER_BULK
+#   define CFG_TUD_VIDEO_STREAMING_BULK          1
+#   define CFG_TUD_VIDEO_STREAMING_EP_BUFSIZE    (TUD_OPT_HIGH_SPEED ? 512 : 64)
+#elif CONFIG_TINYUSB_UVC_TRANSFER_ISOC
+#   define CFG_TUD_VIDEO_STREAMING_BULK          0
+#   define CFG_TUD_VIDEO_STREAMING_EP_BUFSIZE    CONFIG_TINYUSB_UVC_ISOC_EP_SIZE
+#endif
+
+// NCM transfer block size and number
+#ifdef CONFIG_TINYUSB_NET_NCM_NTB_SIZE
+#   define CFG_TUD_NCM_IN_NTB_MAX_SIZE  CONFIG_TINYUSB_NET_NCM_NTB_SIZE
+#   define CFG_TUD_NCM_OUT_NTB_MAX_SIZE CONFIG_TINYUSB_NET_NCM_NTB_SIZE
+#endif
+#ifdef CONFIG_TINYUSB_NET_NCM_NTB_NUM
+#   define CFG_TUD_NCM_IN_NTB_N         CONFIG_TINYUSB_NET_NCM_NTB_NUM
+#   define CFG_TUD_NCM_OUT_NTB_N        CONFIG_TINYUSB_NET_NCM_NTB_NUM
+#endif
+#ifdef CONFIG_TINYUSB_NET_NCM_MAX_DATAGRAMS
+#   define CFG_TUD_NCM_IN_MAX_DATAGRAMS_PER_NTB  CONFIG_TINYUSB_NET_NCM_MAX_DATAGRAMS
+#   define CFG_TUD_NCM_OUT_MAX_DATAGRAMS_PER_NTB CONFIG_TINYUSB_NET_NCM_MAX_DATAGRAMS
+#endif
+
 // Enabled device class driver
 #define CFG_TUD_CDC                 CONFIG_TINYUSB_CDC_COUNT
 #define CFG_TUD_MSC                 CONFIG_TINYUSB_MSC_ENABLED
@@ -178,6 +251,9 @@ extern "C" {
 #define CFG_TUD_DFU                 CONFIG_TINYUSB_DFU_MODE_DFU
 #define CFG_TUD_DFU_RUNTIME         CONFIG_TINYUSB_DFU_MODE_DFU_RUNTIME
 #define CFG_TUD_BTH                 CONFIG_TINYUSB_BTH_ENABLED
+#define CFG_TUD_AUDIO               CONFIG_TINYUSB_UAC_ENABLED
+#define CFG_TUD_VIDEO               CONFIG_TINYUSB_UVC_ENABLED
+#define CFG_TUD_VIDEO_STREAMING     CONFIG_TINYUSB_UVC_ENABLED
 
 #ifdef __cplusplus
 }
@@ -10,8 +10,27 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
 
+/**
+ * @brief What to drop when the buffered console is full
+ */
+typedef enum {
+    TUSB_CONSOLE_DROP_NEWEST,   /*!< Drop the new output, the ring keeps the oldest lines */
+    TUSB_CONSOLE_DROP_OLDEST,   /*!< Drop the oldest whole lines to fit the new output */
+} tusb_console_drop_policy_t;
+
+/**
+ * @brief Configuration of the buffered console
+ */
+typedef struct {
+    int cdc_intf;                           /*!< Interface number of TinyUSB's CDC */
+    size_t buf_size;                        /*!< Size of the output ring in bytes */
+    tusb_console_drop_policy_t drop_policy; /*!< What to drop when the ring is full */
+} tusb_console_buffered_config_t;
+
 /**
  * @brief Redirect output to the USB serial
  * @param cdc_intf - interface number of TinyUSB's CDC
@@ -20,6 +39,28 @@ extern "C" {
  */
 esp_err_t esp_tusb_init_console(int cdc_intf);
 
+/**
+ * @brief Redirect output to the USB serial through a ring buffer
+ *
+ * stdout and stderr are copied to the ring and never block: when the ring is full, output is dropped according to
+ * drop_policy and counted. A task with priority CONFIG_TINYUSB_CONSOLE_TASK_PRIORITY sends the ring to the host in
+ * large chunks, while the host has the port open. stdin reads from the CDC as with esp_tusb_init_console().
+ *
+ * @param config - buffered console configuration
+ *
+ * @return esp_err_t - ESP_OK, ESP_ERR_INVALID_ARG, ESP_ERR_NO_MEM, ESP_FAIL or an error code
+ */
+esp_err_t esp_tusb_init_console_buffered(const tusb_console_buffered_config_t *config);
+
+/**
+ * @brief Get number of bytes dropped by the buffered console
+ *
+ * @param reset - reset the counter after reading
+ *
+ * @return Number of dropped bytes
+ */
+size_t esp_tusb_console_get_dropped(bool reset);
+
 /**
  * @brief Switch log to the default output
  * @param cdc_intf - interface number of TinyUSB's CDC
@@ -76,6 +76,21 @@ typedef struct {
     const esp_vfs_fat_mount_config_t mount_config; /*!< FATFS mount config */
 } tinyusb_msc_spiflash_config_t;
 
+/**
+ * @brief Storage backend of one logical unit (LUN)
+ *
+ * All functions get the context passed to tinyusb_msc_storage_add_lun().
+ * They are called from TinyUSB task, or from the storage task of the LUN with CONFIG_TINYUSB_MSC_ASYNC_IO.
+ */
+typedef struct {
+    uint32_t (*get_sector_count)(void *ctx);        /*!< Get number of sectors of the media */
+    uint32_t (*get_sector_size)(void *ctx);         /*!< Get sector size of the media, in bytes */
+    esp_err_t (*read)(void *ctx, uint32_t lba, uint32_t offset, size_t size, void *dest);          /*!< Read size bytes at lba * sector size + offset */
+    esp_err_t (*write)(void *ctx, uint32_t lba, uint32_t offset, size_t size, const void *src);    /*!< Write whole sectors. NULL for read-only media */
+    esp_err_t (*sync)(void *ctx);                   /*!< Write data held by the backend to the media. Optional */
+    void (*deinit)(void *ctx);                      /*!< Called by tinyusb_msc_storage_deinit(), must sync the media. Optional */
+} tinyusb_msc_storage_backend_t;
+
 /**
  * @brief Register storage type spiflash with tinyusb driver
  *
@@ -97,9 +112,99 @@ esp_err_t tinyusb_msc_storage_init_spiflash(const tinyusb_msc_spiflash_config_t
  */
 esp_err_t tinyusb_msc_storage_init_sdmmc(const tinyusb_msc_sdmmc_config_t *config);
 #endif
+/**
+ * @brief Add a logical unit (LUN) served by a custom backend
+ *
+ * The storage must be initialized by tinyusb_msc_storage_init_spiflash() or tinyusb_msc_storage_init_sdmmc() first,
+ * which registers LUN 0. LUNs must be added before the host enumerates the device,
+ * up to CONFIG_TINYUSB_MSC_LUN_MAX.
+ *
+ * @param[in]  backend Backend functions, the structure is copied
+ * @param[in]  ctx     Context passed to the backend functions
+ * @param[out] lun     Number of the new LUN. Can be NULL
+ * @return esp_err_t
+ *       - ESP_OK, if success;
+ *       - ESP_ERR_INVALID_ARG, if a mandatory backend function is missing;
+ *       - ESP_ERR_INVALID_STATE, if the storage is not initialized;
+ *       - ESP_ERR_NO_MEM, if all LUNs are used or there was no memory to allocate storage components;
+ */
+esp_err_t tinyusb_msc_storage_add_lun(const tinyusb_msc_storage_backend_t *backend, void *ctx, uint8_t *lun);
+
+/**
+ * @brief Add a logical unit (LUN) served by a wear-levelling partition in SPI flash
+ *
+ * @param[in]  wl_handle Wear-levelling handle of the partition
+ * @param[out] lun       Number of the new LUN. Can be NULL
+ * @return See tinyusb_msc_storage_add_lun()
+ */
+esp_err_t tinyusb_msc_storage_add_lun_spiflash(wl_handle_t wl_handle, uint8_t *lun);
+
+#if SOC_SDMMC_HOST_SUPPORTED
+/**
+ * @brief Add a logical unit (LUN) served by an SD card
+ *
+ * @param[in]  card Initialized card
+ * @param[out] lun  Number of the new LUN. Can be NULL
+ * @return See tinyusb_msc_storage_add_lun()
+ */
+esp_err_t tinyusb_msc_storage_add_lun_sdmmc(const sdmmc_card_t *card, uint8_t *lun);
+#endif
+
+/**
+ * @brief Configuration of RAM disk
+ */
+typedef struct {
+    uint8_t *buffer;                /*!< Memory of the disk, sector_count * sector_size bytes. NULL to allocate it */
+    uint32_t sector_count;          /*!< Number of sectors */
+    uint32_t sector_size;           /*!< Sector size, in bytes. Usually 512 */
+    uint32_t heap_caps;             /*!< Capabilities of allocated memory, e.g. MALLOC_CAP_SPIRAM. 0 for MALLOC_CAP_DEFAULT */
+} tinyusb_msc_ramdisk_config_t;
+
+/**
+ * @brief Add a logical unit (LUN) served from RAM, e.g. a scratch disk in PSRAM
+ *
+ * Allocated memory is zeroed, so the host has to format the disk. The content is lost on deinit.
+ *
+ * @param[in]  config RAM disk configuration
+ * @param[out] lun    Number of the new LUN. Can be NULL
+ * @return See tinyusb_msc_storage_add_lun()
+ */
+esp_err_t tinyusb_msc_storage_add_lun_ramdisk(const tinyusb_msc_ramdisk_config_t *config, uint8_t *lun);
+
+/**
+ * @brief Configuration of read-only compressed image
+ *
+ * Image is a disk image split into blocks which are compressed independently with raw deflate.
+ * All fields are little endian:
+ * - header: magic "MSCZ", u16 version 1, u16 sector size, u32 sector count, u32 block size, u32 block count
+ * - block count + 1 u32 offsets of compressed blocks from the image start, the last one is the image end
+ * - compressed blocks. A block whose compressed size equals its size is stored uncompressed
+ *
+ * Image is created from a disk image by tools/mkmscimage.py.
+ */
+typedef struct {
+    const void *image;              /*!< Image, e.g. partition mapped by esp_partition_mmap() or embedded file. Must stay valid until deinit */
+    size_t image_size;              /*!< Size of the image, in bytes */
+    uint8_t cache_blocks;           /*!< Number of decompressed blocks kept in memory. 0 for default 4 */
+} tinyusb_msc_image_config_t;
+
+/**
+ * @brief Add a read-only logical unit (LUN) served from compressed image
+ *
+ * Blocks are decompressed on demand with ROM inflate into an LRU cache of decompressed blocks.
+ *
+ * @param[in]  config Image configuration
+ * @param[out] lun    Number of the new LUN. Can be NULL
+ * @return See tinyusb_msc_storage_add_lun()
+ *       - ESP_ERR_INVALID_VERSION, if the image has wrong magic or version;
+ *       - ESP_ERR_INVALID_SIZE, if the image is truncated;
+ */
+esp_err_t tinyusb_msc_storage_add_lun_image(const tinyusb_msc_image_config_t *config, uint8_t *lun);
+
 /**
  * @brief Deregister storage with tinyusb driver and frees the memory
  *
+ * All LUNs are removed.
  */
 void tinyusb_msc_storage_deinit(void);
 
@@ -123,6 +228,130 @@ esp_err_t tinyusb_msc_register_callback(tinyusb_msc_event_type_t event_type,
  */
 esp_err_t tinyusb_msc_unregister_callback(tinyusb_msc_event_type_t event_type);
 
+/**
+ * @brief Switchover configuration of LUN 0 between the host and the application
+ */
+typedef struct {
+    bool keep_fs_cache;             /*!< FatFS stays registered in VFS while the host has the storage. If the host wrote nothing
+                                         in the meantime, tinyusb_msc_storage_mount() does not read the volume again and the FAT
+                                         and directory caches stay valid. Files must be closed before tinyusb_msc_storage_unmount() */
+    uint32_t log_first_sector;      /*!< First sector of the log region, e.g. of a contiguous file preallocated by the application */
+    uint32_t log_sector_count;      /*!< Length of the log region in sectors. 0: No log region.
+                                         With a log region the host gets LUN 0 read-only */
+    uint32_t log_offset;            /*!< Bytes already in the log region, tinyusb_msc_storage_log_write() appends after them */
+} tinyusb_msc_storage_switch_config_t;
+
+/**
+ * @brief Configure switchover of LUN 0 between the host and the application
+ *
+ * Can be called again to move or remove the log region.
+ *
+ * @param[in] config Switchover configuration
+ * @return esp_err_t
+ *       - ESP_OK, if success;
+ *       - ESP_ERR_INVALID_ARG, if the log region is out of the media;
+ *       - ESP_ERR_INVALID_STATE, if the storage is not initialized;
+ *       - ESP_ERR_NOT_SUPPORTED, if the log region is set on read-only storage;
+ *       - ESP_ERR_NO_MEM, if the log buffer could not be allocated;
+ */
+esp_err_t tinyusb_msc_storage_config_switch(const tinyusb_msc_storage_switch_config_t *config);
+
+/**
+ * @brief Append data to the log region of LUN 0
+ *
+ * Works both while the host has the storage and while it is mounted by the application.
+ * The partially filled last sector is kept in RAM and written again by the next append,
+ * whole sectors are written directly from data.
+ * The host sees the appended data once it reads the sectors again, its caches are not invalidated.
+ *
+ * @param[in] data Data to append
+ * @param[in] size Length of data
+ * @return esp_err_t
+ *       - ESP_OK, if success;
+ *       - ESP_ERR_INVALID_STATE, if there is no log region;
+ *       - ESP_ERR_INVALID_SIZE, if the data do not fit into the rest of the log region;
+ *       - Error of the storage backend;
+ */
+esp_err_t tinyusb_msc_storage_log_write(const void *data, size_t size);
+
+/**
+ * @brief Get write generation of a LUN
+ *
+ * The generation is incremented by each WRITE10 of the host, equal values mean the host did not write in between.
+ *
+ * @param[in] lun Number of the LUN
+ * @return Write generation, 0 for a LUN that does not exist
+ */
+uint32_t tinyusb_msc_storage_get_write_generation(uint8_t lun);
+
+#define TINYUSB_MSC_LATENCY_BUCKETS (16) /*!< Number of buckets of a latency histogram */
+
+/**
+ * @brief Media operations with latency histogram
+ */
+typedef enum {
+    TINYUSB_MSC_MEDIA_READ,         /*!< Backend read */
+    TINYUSB_MSC_MEDIA_WRITE,        /*!< Backend write, including erases done within the write */
+    TINYUSB_MSC_MEDIA_ERASE,        /*!< Erase of wear levelling of SPI flash storage */
+    TINYUSB_MSC_MEDIA_OP_NUM,
+} tinyusb_msc_media_op_t;
+
+/**
+ * @brief Latency histogram with power-of-two buckets
+ *
+ * Bucket 0 counts latencies below 32 us, bucket i latencies from 16 us << i to 32 us << i.
+ * The last bucket counts all longer ones.
+ */
+typedef struct {
+    uint32_t count[TINYUSB_MSC_LATENCY_BUCKETS]; /*!< Number of operations per bucket */
+    uint32_t max_us;                /*!< Longest operation */
+    uint64_t total_us;              /*!< Sum of the latencies */
+} tinyusb_msc_latency_hist_t;
+
+/**
+ * @brief Statistics of one LUN
+ */
+typedef struct {
+    uint64_t read_bytes;            /*!< Data of READ10 chunks passed to TinyUSB */
+    uint64_t write_bytes;           /*!< Data of WRITE10 chunks accepted from TinyUSB */
+    uint32_t read_calls;            /*!< READ10 callbacks, each handles up to CONFIG_TINYUSB_MSC_BUFSIZE */
+    uint32_t write_calls;           /*!< WRITE10 callbacks, each handles up to CONFIG_TINYUSB_MSC_BUFSIZE */
+    uint32_t busy_calls;            /*!< READ10/WRITE10 callbacks which returned busy, TinyUSB invokes them again */
+    uint32_t read_errors;           /*!< Failed reads reported to the host */
+    uint32_t write_errors;          /*!< Failed writes reported to the host */
+    uint32_t other_cmds;            /*!< Other SCSI commands handled by tud_msc_scsi_cb() */
+    uint64_t usb_block_us;          /*!< Time the TinyUSB task spent in READ10, WRITE10 and SCSI callbacks */
+    uint32_t usb_block_max_us;      /*!< Longest callback */
+    tinyusb_msc_latency_hist_t media[TINYUSB_MSC_MEDIA_OP_NUM]; /*!< Latency of the media accesses */
+} tinyusb_msc_storage_stats_t;
+
+/**
+ * @brief Get statistics of a LUN
+ *
+ * Media accesses of the application, e.g. through tinyusb_msc_storage_mount(), are counted too.
+ *
+ * @param[in]  lun   Number of the LUN
+ * @param[out] stats Statistics
+ * @param[in]  reset Reset the statistics after reading
+ * @return esp_err_t
+ *       - ESP_OK, if success;
+ *       - ESP_ERR_INVALID_ARG, if stats is NULL or the LUN does not exist;
+ *       - ESP_ERR_NOT_SUPPORTED, if CONFIG_TINYUSB_MSC_STATS is disabled;
+ */
+esp_err_t tinyusb_msc_storage_get_stats(uint8_t lun, tinyusb_msc_storage_stats_t *stats, bool reset);
+
+/**
+ * @brief Register "msc_stats" console command
+ *
+ * The command prints the statistics of all LUNs, "msc_stats -r" resets them afterwards.
+ *
+ * @return esp_err_t
+ *       - ESP_OK, if success;
+ *       - ESP_ERR_NOT_SUPPORTED, if CONFIG_TINYUSB_MSC_STATS_CONSOLE is disabled;
+ *       - Error of esp_console_cmd_register();
+ */
+esp_err_t tinyusb_msc_storage_register_console_cmd(void);
+
 /**
  * @brief Mount the storage partition locally on the firmware application.
  *
@@ -130,7 +359,8 @@ esp_err_t tinyusb_msc_unregister_callback(tinyusb_msc_event_type_t event_type);
  * Connect POSIX and C standard library IO function with FATFS.
  * Mounts the partition.
  * This API is used by the firmware application. If the storage partition is
- * mounted by this API, host (PC) can't access the storage via MSC.
+ * mounted by this API, host (PC) can't access the storage via MSC, it sees no medium in LUN 0.
+ * With keep_fs_cache of tinyusb_msc_storage_config_switch() the volume is read again only if the host wrote to it.
  * When this function is called from the tinyusb callback functions, care must be taken
  * so as to make sure that user callbacks must be completed within a
  * specific time. Otherwise, MSC device may re-appear again on Host.
@@ -138,6 +368,7 @@ esp_err_t tinyusb_msc_unregister_callback(tinyusb_msc_event_type_t event_type);
  * @param base_path  path prefix where FATFS should be registered
  * @return esp_err_t
  *       - ESP_OK, if success;
+ *       - ESP_ERR_INVALID_STATE if the storage is not initialized
  *       - ESP_ERR_NOT_FOUND if the maximum count of volumes is already mounted
  *       - ESP_ERR_NO_MEM if not enough memory or too many VFSes already registered;
  */
@@ -149,6 +380,7 @@ esp_err_t tinyusb_msc_storage_mount(const char *base_path);
  * Unmount the partition. Unregister diskio driver.
  * Unregister the SPI flash partition.
  * Finally, Un-register FATFS from VFS.
+ * With keep_fs_cache of tinyusb_msc_storage_config_switch() FATFS stays registered and only the media is synced.
  * After this function is called, storage device can be seen (recognized) by host (PC).
  * When this function is called from the tinyusb callback functions, care must be taken
  * so as to make sure that user callbacks must be completed within a specific time.
@@ -156,19 +388,19 @@ esp_err_t tinyusb_msc_storage_mount(const char *base_path);
  *
  * @return esp_err_t
  *      - ESP_OK on success
- *      - ESP_ERR_INVALID_STATE if FATFS is not registered in VFS
+ *      - ESP_ERR_INVALID_STATE if the storage is not mounted
  */
 esp_err_t tinyusb_msc_storage_unmount(void);
 
 /**
- * @brief Get number of sectors in storage media
+ * @brief Get number of sectors in storage media of LUN 0
  *
  * @return usable size, in bytes
  */
 uint32_t tinyusb_msc_storage_get_sector_count(void);
 
 /**
- * @brief Get sector size of storage media
+ * @brief Get sector size of storage media of LUN 0
  *
  * @return sector count
  */
@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
 
 #ifdef __cplusplus
@@ -34,6 +36,31 @@ esp_err_t tusb_run_task(void);
  */
 esp_err_t tusb_stop_task(void);
 
+/**
+ * @brief Statistics of the default TinyUSB task
+ *
+ * The task processes all queued events in one run of tud_task(), so the number of events queued
+ * during one run is the upper bound of the event queue depth.
+ */
+typedef struct {
+    uint32_t runs;              /*!< Number of tud_task() runs which processed some events */
+    uint32_t events;            /*!< Number of events queued to the task, including deferred function calls */
+    uint32_t max_run_events;    /*!< Maximum number of events queued during one run */
+    uint32_t max_run_time_us;   /*!< Maximum time from queuing the first event until the end of the run, i.e. ISR-to-task latency plus handling */
+    uint64_t total_run_time_us; /*!< Sum of the run times */
+} tusb_task_stats_t;
+
+/**
+ * @brief Get statistics of the default TinyUSB task
+ *
+ * @param[out] stats  Statistics
+ * @param[in]  reset  Reset the statistics after reading
+ * @retval ESP_OK read statistics successfully
+ * @retval ESP_ERR_INVALID_ARG stats is NULL
+ * @retval ESP_ERR_NOT_SUPPORTED CONFIG_TINYUSB_TASK_STATS is disabled or TinyUSB is older than 0.15
+ */
+esp_err_t tusb_task_get_stats(tusb_task_stats_t *stats, bool reset);
+
 #ifdef __cplusplus
 }
 #endif
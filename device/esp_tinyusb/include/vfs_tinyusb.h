@@ -22,6 +22,10 @@ extern "C" {
  * Know limitation:
  * In case there are multiple CDC interfaces in the system, only one of them can be registered to VFS.
  *
+ * The file is opened in non-blocking mode. Clear O_NONBLOCK with fcntl() to make read() wait for data.
+ * With CONFIG_VFS_SUPPORT_SELECT the file can be waited for with select(), together with sockets and other files.
+ * It is readable when data are received and writable when there is free space in the write buffers.
+ *
  * @param[in] cdc_intf Interface number of TinyUSB's CDC
  * @param[in] path     Path where the CDC will be registered, `/dev/tusb_cdc` will be used if left NULL.
  * @return esp_err_t ESP_OK or ESP_FAIL
@@ -17,7 +17,9 @@ extern "C" {
 /**
  * @brief Parse tinyusb configuration and prepare the device configuration pointer list to configure tinyusb driver
  *
- * @attention All descriptors passed to this function must exist for the duration of USB device lifetime
+ * String descriptors are encoded from UTF-8 to UTF-16 here, the strings are not used afterwards.
+ *
+ * @attention All other descriptors passed to this function must exist for the duration of USB device lifetime
  *
  * @param[in] config tinyusb stack specific configuration
  * @retval ESP_ERR_INVALID_ARG Default configuration descriptor is provided only for CDC, MSC and NCM classes
@@ -29,12 +31,14 @@ esp_err_t tinyusb_set_descriptors(const tinyusb_config_t *config);
 /**
  * @brief Set specific string descriptor
  *
- * @attention The descriptor passed to this function must exist for the duration of USB device lifetime
+ * The string is encoded to UTF-16 and replaces the previous descriptor of the index.
  *
  * @param[in] str     UTF-8 string
  * @param[in] str_idx String descriptor index
+ * @retval ESP_ERR_NO_MEM Memory allocation error
+ * @retval ESP_OK         String descriptor set
  */
-void tinyusb_set_str_descriptor(const char *str, int str_idx);
+esp_err_t tinyusb_set_str_descriptor(const char *str, int str_idx);
 
 /**
  * @brief Free memory allocated during tinyusb_set_descriptors
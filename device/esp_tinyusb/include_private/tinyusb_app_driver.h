@@ -0,0 +1,29 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "sdkconfig.h"
+#include "tusb.h"
+#include "device/usbd_pvt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// TinyUSB application class drivers of esp_tinyusb modules, registered together by usbd_app_driver_get_cb() in tinyusb.c
+
+#if CONFIG_TINYUSB_VENDOR_STREAM
+extern const usbd_class_driver_t tinyusb_vendor_stream_driver;
+#endif
+
+#if CONFIG_TINYUSB_MIDI_BATCH
+extern const usbd_class_driver_t tinyusb_midi_driver;
+#endif
+
+#ifdef __cplusplus
+}
+#endif
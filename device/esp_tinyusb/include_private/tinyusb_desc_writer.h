@@ -0,0 +1,55 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Writer of class specific descriptors built at runtime
+ *
+ * With dst NULL the fields are only counted, so the same code gives the descriptor length.
+ */
+typedef struct {
+    uint8_t *dst;                   /*!< Destination buffer, NULL when only counting */
+    size_t len;                     /*!< Number of bytes written or counted */
+} desc_writer_t;
+
+static inline void desc_put_u8(desc_writer_t *w, uint8_t v)
+{
+    if (w->dst) {
+        w->dst[w->len] = v;
+    }
+    w->len++;
+}
+
+static inline void desc_put_u16(desc_writer_t *w, uint16_t v)
+{
+    desc_put_u8(w, v & 0xFF);
+    desc_put_u8(w, v >> 8);
+}
+
+static inline void desc_put_u32(desc_writer_t *w, uint32_t v)
+{
+    desc_put_u16(w, v & 0xFFFF);
+    desc_put_u16(w, v >> 16);
+}
+
+static inline void desc_put_bytes(desc_writer_t *w, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        desc_put_u8(w, data[i]);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,20 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Send reports queued while the bus was suspended, called on bus resume
+ */
+void tinyusb_hid_queue_resume(void);
+
+#ifdef __cplusplus
+}
+#endif
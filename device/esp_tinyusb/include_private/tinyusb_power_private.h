@@ -0,0 +1,32 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize suspend handling, called by tinyusb_driver_install()
+ *
+ * @param[in] external_phy  USB uses an external PHY, so its VM input is the resume wakeup pin
+ * @return - ESP_OK             Initialized
+ *         - ESP_ERR_NO_MEM     Not enough memory for power locks
+ */
+esp_err_t tinyusb_power_init(bool external_phy);
+
+/**
+ * @brief Deinitialize suspend handling, called by tinyusb_driver_uninstall()
+ */
+void tinyusb_power_deinit(void);
+
+#ifdef __cplusplus
+}
+#endif
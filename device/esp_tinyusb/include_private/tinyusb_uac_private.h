@@ -0,0 +1,38 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Interfaces and endpoint numbers of the audio function
+#define TINYUSB_UAC_ITF_NUM     (1 + CFG_TUD_AUDIO_FUNC_1_N_AS_INT)
+#define TINYUSB_UAC_EP_NUM      (CFG_TUD_AUDIO_FUNC_1_N_AS_INT)
+
+/**
+ * @brief Write descriptors of the audio function: IAD, audio control and audio streaming interfaces
+ *
+ * The speaker uses OUT endpoint ep_num and feedback IN endpoint 0x80 | ep_num,
+ * the microphone uses the next IN endpoint.
+ *
+ * @param[in]  itf_num  Number of the audio control interface, the audio streaming interfaces follow
+ * @param[in]  ep_num   First endpoint number
+ * @param[in]  str_idx  Index of the interface string descriptor
+ * @param[in]  hs       Build HighSpeed descriptor
+ * @param[out] dst      Destination buffer, NULL to get the length only
+ * @return Length of the descriptors, CFG_TUD_AUDIO_FUNC_1_DESC_LEN
+ */
+size_t tinyusb_uac_desc(uint8_t itf_num, uint8_t ep_num, uint8_t str_idx, bool hs, uint8_t *dst);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,43 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "tinyusb_uvc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Check UVC configuration used for descriptors
+ *
+ * @param[in] config UVC configuration
+ * @return - ESP_OK                 Valid configuration
+ *         - ESP_ERR_INVALID_ARG    No frames or invalid frame
+ */
+esp_err_t tinyusb_uvc_check_config(const tinyusb_uvc_config_t *config);
+
+/**
+ * @brief Write descriptors of the UVC function: IAD, video control and video streaming interface
+ *
+ * @param[in]  config   UVC configuration
+ * @param[in]  itf_num  Number of the video control interface, the video streaming interface follows
+ * @param[in]  ep_in    Address of the streaming IN endpoint
+ * @param[in]  str_idx  Index of the interface string descriptor
+ * @param[in]  hs       Build HighSpeed descriptor
+ * @param[out] dst      Destination buffer, NULL to get the length only
+ * @return Length of the descriptors
+ */
+size_t tinyusb_uvc_desc(const tinyusb_uvc_config_t *config, uint8_t itf_num, uint8_t ep_in, uint8_t str_idx, bool hs, uint8_t *dst);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,68 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "tusb_cdc_acm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Wait until data are received on CDC-ACM interface
+ *
+ * Woken up from tud_cdc_rx_cb(), so it may return also when the data were already read by someone else.
+ *
+ * @param[in] itf     Index of CDC interface
+ * @param[in] timeout Timeout in ticks
+ * @return - ESP_OK                 Data received
+ *         - ESP_ERR_TIMEOUT        No data received in time
+ *         - ESP_ERR_INVALID_STATE  Interface is not initialized
+ */
+esp_err_t tinyusb_cdcacm_wait_rx(tinyusb_cdcacm_itf_t itf, TickType_t timeout);
+
+/**
+ * @brief Get the next received character without removing it
+ *
+ * @param[in]  itf Index of CDC interface
+ * @param[out] ch  Next character
+ * @return true if a character is available
+ */
+bool tinyusb_cdcacm_peek(tinyusb_cdcacm_itf_t itf, uint8_t *ch);
+
+/**
+ * @brief Get free space of the write buffers, the port buffer and TinyUSB FIFO
+ *
+ * @param[in] itf Index of CDC interface
+ * @return Number of bytes tinyusb_cdcacm_write_queue() accepts, 0 if the interface is not initialized
+ */
+size_t tinyusb_cdcacm_write_available(tinyusb_cdcacm_itf_t itf);
+
+/**
+ * @brief Callback invoked from TinyUSB task after data were received or an IN transfer completed
+ */
+typedef void (*tinyusb_cdcacm_io_cb_t)(tinyusb_cdcacm_itf_t itf);
+
+/**
+ * @brief Set callback of received data and completed IN transfers, used by VFS select()
+ *
+ * The callback is invoked after the blocking readers and flush are woken up.
+ *
+ * @param[in] itf Index of CDC interface
+ * @param[in] cb  Callback, NULL removes it
+ * @return - ESP_OK                 Callback set
+ *         - ESP_ERR_INVALID_STATE  Interface is not initialized
+ */
+esp_err_t tinyusb_cdcacm_set_io_cb(tinyusb_cdcacm_itf_t itf, tinyusb_cdcacm_io_cb_t cb);
+
+#ifdef __cplusplus
+}
+#endif
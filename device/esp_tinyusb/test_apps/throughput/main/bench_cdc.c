@@ -0,0 +1,112 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "soc/soc_caps.h"
+#if SOC_USB_OTG_SUPPORTED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "unity.h"
+#include "tinyusb.h"
+#include "tusb_cdc_acm.h"
+#include "bench_common.h"
+
+#define CDC_ITF             TINYUSB_CDC_ACM_0
+#define CDC_CMD_LEN_MAX     (32)
+
+static uint8_t s_buf[BENCH_CHUNK_SIZE];
+static SemaphoreHandle_t s_rx_sem;
+
+static void cdc_rx_callback(int itf, cdcacm_event_t *event)
+{
+    xSemaphoreGive(s_rx_sem);
+}
+
+// Receive one command line, the rest of the read data is dropped: the host waits for a reply before sending more
+static void cdc_read_cmd(char *cmd)
+{
+    size_t len = 0;
+    while (true) {
+        size_t rx_size = 0;
+        tinyusb_cdcacm_read(CDC_ITF, s_buf, sizeof(s_buf), &rx_size);
+        for (size_t i = 0; i < rx_size; i++) {
+            if (s_buf[i] == '\n') {
+                cmd[len] = '\0';
+                return;
+            }
+            if (len < CDC_CMD_LEN_MAX - 1) {
+                cmd[len++] = (char)s_buf[i];
+            }
+        }
+        if (rx_size == 0) {
+            xSemaphoreTake(s_rx_sem, portMAX_DELAY);
+        }
+    }
+}
+
+static void cdc_reply(const char *reply)
+{
+    tinyusb_cdcacm_write(CDC_ITF, (const uint8_t *)reply, strlen(reply), portMAX_DELAY);
+    tinyusb_cdcacm_write_flush(CDC_ITF, portMAX_DELAY);
+}
+
+/**
+ * @brief CDC-ACM throughput benchmark
+ *
+ * This is not a 'standard' testcase, as it never exits. The host sends commands terminated by '\n':
+ * - 'SINK <bytes>': the device replies 'GO\n', reads and drops the bytes, then replies 'DONE\n'
+ * - 'SOURCE <bytes>': the device sends the bytes
+ */
+TEST_CASE("bench_cdc", "[esp_tinyusb][bench_cdc]")
+{
+    const tinyusb_desc_itf_config_t itfs[] = {
+        { .type = TINYUSB_DESC_ITF_CDC_ACM },
+    };
+    bench_install(itfs, 1);
+
+    const tinyusb_config_cdcacm_t acm_cfg = {
+        .usb_dev = TINYUSB_USBDEV_0,
+        .cdc_port = CDC_ITF,
+        .rx_buf_size = BENCH_CHUNK_SIZE,
+        .tx_buf_size = BENCH_CHUNK_SIZE,
+        .callback_rx = &cdc_rx_callback,
+    };
+    s_rx_sem = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL(s_rx_sem);
+    TEST_ASSERT_EQUAL(ESP_OK, tusb_cdc_acm_init(&acm_cfg));
+    memset(s_buf, 0x55, sizeof(s_buf));
+
+    char cmd[CDC_CMD_LEN_MAX];
+    while (true) {
+        cdc_read_cmd(cmd);
+        if (strncmp(cmd, "SINK ", 5) == 0) {
+            size_t left = strtoul(cmd + 5, NULL, 10);
+            cdc_reply("GO\n");
+            while (left) {
+                size_t rx_size = 0;
+                tinyusb_cdcacm_read(CDC_ITF, s_buf, MIN(left, sizeof(s_buf)), &rx_size);
+                if (rx_size == 0) {
+                    xSemaphoreTake(s_rx_sem, portMAX_DELAY);
+                }
+                left -= rx_size;
+            }
+            cdc_reply("DONE\n");
+        } else if (strncmp(cmd, "SOURCE ", 7) == 0) {
+            size_t left = strtoul(cmd + 7, NULL, 10);
+            while (left) {
+                left -= tinyusb_cdcacm_write(CDC_ITF, s_buf, MIN(left, sizeof(s_buf)), portMAX_DELAY);
+            }
+            tinyusb_cdcacm_write_flush(CDC_ITF, portMAX_DELAY);
+        } else {
+            cdc_reply("ERROR\n");
+        }
+    }
+}
+
+#endif // SOC_USB_OTG_SUPPORTED
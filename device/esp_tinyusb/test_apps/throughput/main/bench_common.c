@@ -0,0 +1,73 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "soc/soc_caps.h"
+#if SOC_USB_OTG_SUPPORTED
+
+#include <stdio.h>
+#include "unity.h"
+#include "tinyusb.h"
+#include "bench_common.h"
+
+static tusb_desc_device_t s_device_descriptor = {
+    .bLength = sizeof(tusb_desc_device_t),
+    .bDescriptorType = TUSB_DESC_DEVICE,
+    .bcdUSB = 0x0200,
+    .bMaxPacketSize0 = CFG_TUD_ENDPOINT0_SIZE,
+    .idVendor = USB_ESPRESSIF_VID,
+    .idProduct = BENCH_PID,
+    .bcdDevice = 0x0100,
+    .iManufacturer = 0x01,
+    .iProduct = 0x02,
+    .iSerialNumber = 0x03,
+    .bNumConfigurations = 0x01
+};
+
+#if (TUD_OPT_HIGH_SPEED)
+static tusb_desc_device_qualifier_t s_device_qualifier = {
+    .bLength = sizeof(tusb_desc_device_qualifier_t),
+    .bDescriptorType = TUSB_DESC_DEVICE_QUALIFIER,
+    .bcdUSB = 0x0200,
+    .bMaxPacketSize0 = CFG_TUD_ENDPOINT0_SIZE,
+    .bNumConfigurations = 0x01,
+    .bReserved = 0
+};
+#endif // TUD_OPT_HIGH_SPEED
+
+static tinyusb_desc_cfg_t s_desc_cfg;
+
+void bench_install(const tinyusb_desc_itf_config_t *itfs, size_t itf_num)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, tinyusb_desc_build(itfs, itf_num, 0, 500, &s_desc_cfg));
+    if (s_desc_cfg.iad) {
+        s_device_descriptor.bDeviceClass = TUSB_CLASS_MISC;
+        s_device_descriptor.bDeviceSubClass = MISC_SUBCLASS_COMMON;
+        s_device_descriptor.bDeviceProtocol = MISC_PROTOCOL_IAD;
+    }
+#if (TUD_OPT_HIGH_SPEED)
+    s_device_qualifier.bDeviceClass = s_device_descriptor.bDeviceClass;
+    s_device_qualifier.bDeviceSubClass = s_device_descriptor.bDeviceSubClass;
+    s_device_qualifier.bDeviceProtocol = s_device_descriptor.bDeviceProtocol;
+#endif // TUD_OPT_HIGH_SPEED
+
+    const tinyusb_config_t tusb_cfg = {
+        .device_descriptor = &s_device_descriptor,
+        .string_descriptor = NULL,
+        .string_descriptor_count = 0,
+        .external_phy = false,
+#if (TUD_OPT_HIGH_SPEED)
+        .fs_configuration_descriptor = s_desc_cfg.fs_cfg,
+        .hs_configuration_descriptor = s_desc_cfg.hs_cfg,
+        .qualifier_descriptor = &s_device_qualifier,
+#else
+        .configuration_descriptor = s_desc_cfg.fs_cfg,
+#endif // TUD_OPT_HIGH_SPEED
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, tinyusb_driver_install(&tusb_cfg));
+    printf("bench: ready\n");
+}
+
+#endif // SOC_USB_OTG_SUPPORTED
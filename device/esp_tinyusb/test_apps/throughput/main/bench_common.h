@@ -0,0 +1,31 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include "tinyusb_desc_builder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BENCH_PID           (0x4010) // The host script finds the benchmark device by Espressif VID and this PID
+#define BENCH_CHUNK_SIZE    (16 * 1024)
+
+/**
+ * @brief Install TinyUSB with a device built of the interfaces
+ *
+ * Prints 'bench: ready' when done, the host script waits for it.
+ *
+ * @param[in] itfs      Functions of the configuration descriptor
+ * @param[in] itf_num   Number of functions
+ */
+void bench_install(const tinyusb_desc_itf_config_t *itfs, size_t itf_num);
+
+#ifdef __cplusplus
+}
+#endif
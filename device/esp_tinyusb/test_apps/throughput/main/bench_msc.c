@@ -0,0 +1,76 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "soc/soc_caps.h"
+#if SOC_USB_OTG_SUPPORTED
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_partition.h"
+#include "wear_levelling.h"
+#include "unity.h"
+#include "tinyusb.h"
+#include "tusb_msc_storage.h"
+#include "bench_common.h"
+#if CONFIG_BENCH_MSC_SDMMC
+#include "driver/sdmmc_host.h"
+#include "sdmmc_cmd.h"
+#endif
+
+/**
+ * @brief MSC throughput benchmark
+ *
+ * This is not a 'standard' testcase, as it never exits. Each storage backend is exposed as one LUN:
+ * - LUN 0: wear-levelling partition 'storage' in SPI flash
+ * - LUN 1: RAM disk of CONFIG_BENCH_MSC_RAMDISK_KB
+ * - LUN 2: SD card, if CONFIG_BENCH_MSC_SDMMC is enabled
+ *
+ * The host reads and writes the raw block devices, the content is not preserved.
+ */
+TEST_CASE("bench_msc", "[esp_tinyusb][bench_msc]")
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_FAT, "storage");
+    TEST_ASSERT_NOT_NULL(part);
+    wl_handle_t wl_handle;
+    TEST_ASSERT_EQUAL(ESP_OK, wl_mount(part, &wl_handle));
+    const tinyusb_msc_spiflash_config_t spiflash_cfg = {
+        .wl_handle = wl_handle,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, tinyusb_msc_storage_init_spiflash(&spiflash_cfg));
+    printf("bench: lun 0 spiflash\n");
+
+    const tinyusb_msc_ramdisk_config_t ramdisk_cfg = {
+        .sector_count = CONFIG_BENCH_MSC_RAMDISK_KB * 2,
+        .sector_size = 512,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, tinyusb_msc_storage_add_lun_ramdisk(&ramdisk_cfg, NULL));
+    printf("bench: lun 1 ramdisk\n");
+
+#if CONFIG_BENCH_MSC_SDMMC
+    static sdmmc_card_t card;
+    sdmmc_host_t host = SDMMC_HOST_DEFAULT();
+    host.max_freq_khz = SDMMC_FREQ_HIGHSPEED;
+    sdmmc_slot_config_t slot_config = SDMMC_SLOT_CONFIG_DEFAULT();
+    slot_config.width = CONFIG_BENCH_MSC_SDMMC_WIDTH;
+    TEST_ASSERT_EQUAL(ESP_OK, sdmmc_host_init());
+    TEST_ASSERT_EQUAL(ESP_OK, sdmmc_host_init_slot(host.slot, &slot_config));
+    TEST_ASSERT_EQUAL(ESP_OK, sdmmc_card_init(&host, &card));
+    TEST_ASSERT_EQUAL(ESP_OK, tinyusb_msc_storage_add_lun_sdmmc(&card, NULL));
+    printf("bench: lun 2 sdmmc\n");
+#endif // CONFIG_BENCH_MSC_SDMMC
+
+    const tinyusb_desc_itf_config_t itfs[] = {
+        { .type = TINYUSB_DESC_ITF_MSC },
+    };
+    bench_install(itfs, 1);
+
+    while (true) {
+        vTaskDelay(portMAX_DELAY);
+    }
+}
+
+#endif // SOC_USB_OTG_SUPPORTED
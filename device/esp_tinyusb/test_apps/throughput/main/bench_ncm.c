@@ -0,0 +1,155 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "soc/soc_caps.h"
+#if SOC_USB_OTG_SUPPORTED
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "lwip/inet.h"
+#include "iperf.h"
+#include "unity.h"
+#include "tinyusb.h"
+#include "tinyusb_net.h"
+#include "bench_common.h"
+
+#define NCM_CMD_LEN_MAX     (64)
+
+static esp_netif_t *s_netif;
+
+static esp_err_t netif_transmit(void *h, void *buffer, size_t len)
+{
+    // lwIP frees the pbuf after the call, the synchronous send copies it to the NTB
+    if (tinyusb_net_send_sync(buffer, len, NULL, pdMS_TO_TICKS(100)) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static void netif_free_rx_buffer(void *h, void *buffer)
+{
+    tinyusb_net_recv_done(buffer);
+}
+
+static esp_err_t ncm_recv_callback(void *buffer, uint16_t len, void *ctx)
+{
+    // The buffer is loaned to lwIP until netif_free_rx_buffer()
+    if (esp_netif_receive(s_netif, buffer, len, buffer) != ESP_OK) {
+        tinyusb_net_recv_done(buffer);
+    }
+    return ESP_OK;
+}
+
+static void ncm_netif_init(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, esp_netif_init());
+    TEST_ASSERT_EQUAL(ESP_OK, esp_event_loop_create_default());
+
+    // Default AP netif: 192.168.4.1 with DHCP server, so the host gets 192.168.4.2
+    esp_netif_inherent_config_t base_cfg = ESP_NETIF_INHERENT_DEFAULT_WIFI_AP();
+    base_cfg.if_desc = "usb_ncm";
+    const esp_netif_config_t netif_cfg = {
+        .base = &base_cfg,
+        .driver = NULL,
+        .stack = ESP_NETIF_NETSTACK_DEFAULT_WIFI_AP,
+    };
+    s_netif = esp_netif_new(&netif_cfg);
+    TEST_ASSERT_NOT_NULL(s_netif);
+    const esp_netif_driver_ifconfig_t driver_cfg = {
+        .handle = (void *)1, // Not used, must not be NULL
+        .transmit = netif_transmit,
+        .driver_free_rx_buffer = netif_free_rx_buffer,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, esp_netif_set_driver_config(s_netif, &driver_cfg));
+    const uint8_t mac[6] = { 0x02, 0x02, 0x11, 0x22, 0x33, 0x01 };
+    TEST_ASSERT_EQUAL(ESP_OK, esp_netif_set_mac(s_netif, (uint8_t *)mac));
+    esp_netif_action_start(s_netif, NULL, 0, NULL);
+    esp_netif_action_connected(s_netif, NULL, 0, NULL);
+}
+
+// Console is polled: stdin does not block
+static void console_read_line(char *line, size_t size)
+{
+    size_t len = 0;
+    while (true) {
+        const int c = getchar();
+        if (c == EOF) {
+            clearerr(stdin);
+            vTaskDelay(pdMS_TO_TICKS(10));
+        } else if (c == '\n' || c == '\r') {
+            if (len) {
+                line[len] = '\0';
+                return;
+            }
+        } else if (len < size - 1) {
+            line[len++] = (char)c;
+        }
+    }
+}
+
+static void iperf_run(uint32_t flag, uint32_t dst_ip, uint32_t time_s)
+{
+    iperf_cfg_t cfg = {
+        .flag = flag | IPERF_FLAG_TCP,
+        .type = IPERF_IP_TYPE_IPV4,
+        .destination_ip4 = dst_ip,
+        .source_ip4 = 0,
+        .dport = CONFIG_BENCH_NCM_IPERF_PORT,
+        .sport = CONFIG_BENCH_NCM_IPERF_PORT,
+        .interval = time_s,
+        .time = time_s,
+        .len_send_buf = 0,
+        .bw_lim = IPERF_DEFAULT_NO_BW_LIMIT,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, iperf_start(&cfg));
+}
+
+/**
+ * @brief NCM throughput benchmark
+ *
+ * This is not a 'standard' testcase, as it never exits. The device runs an iperf TCP server for the host,
+ * the host sends commands on the console to measure the other direction:
+ * - 'iperf_client <host IP> <seconds>': the device runs iperf TCP client against the host
+ */
+TEST_CASE("bench_ncm", "[esp_tinyusb][bench_ncm]")
+{
+    ncm_netif_init();
+    const tinyusb_net_config_t net_cfg = {
+        .mac_addr = { 0x02, 0x02, 0x11, 0x22, 0x33, 0x02 },
+        .on_recv_callback = ncm_recv_callback,
+        .recv_loan = true,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, tinyusb_net_init(TINYUSB_USBDEV_0, &net_cfg));
+
+    const tinyusb_desc_itf_config_t itfs[] = {
+        { .type = TINYUSB_DESC_ITF_NCM },
+    };
+    bench_install(itfs, 1);
+    iperf_run(IPERF_FLAG_SERVER, 0, 3600);
+
+    char cmd[NCM_CMD_LEN_MAX];
+    while (true) {
+        console_read_line(cmd, sizeof(cmd));
+        char ip[16];
+        unsigned time_s;
+        if (sscanf(cmd, "iperf_client %15s %u", ip, &time_s) == 2) {
+            iperf_stop();
+            vTaskDelay(pdMS_TO_TICKS(100));
+            iperf_run(IPERF_FLAG_CLIENT, inet_addr(ip), time_s);
+            vTaskDelay(pdMS_TO_TICKS((time_s + 1) * 1000));
+            iperf_stop();
+            vTaskDelay(pdMS_TO_TICKS(100));
+            printf("bench: iperf client done\n");
+            iperf_run(IPERF_FLAG_SERVER, 0, 3600);
+        }
+    }
+}
+
+#endif // SOC_USB_OTG_SUPPORTED
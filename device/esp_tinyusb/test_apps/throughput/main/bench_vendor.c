@@ -0,0 +1,73 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "soc/soc_caps.h"
+#if SOC_USB_OTG_SUPPORTED
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "unity.h"
+#include "tinyusb.h"
+#include "tinyusb_vendor_stream.h"
+#include "bench_common.h"
+
+#define VENDOR_BUF_NUM      (4)
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+} vendor_rx_t;
+
+static QueueHandle_t s_rx_queue;
+
+static void vendor_out_cb(uint8_t *buf, size_t len, void *arg)
+{
+    // Called in TinyUSB task, the loopback task waits for a free IN buffer instead
+    const vendor_rx_t rx = {
+        .buf = buf,
+        .len = len,
+    };
+    if (xQueueSend(s_rx_queue, &rx, 0) != pdTRUE) {
+        tinyusb_vendor_stream_out_release(buf);
+    }
+}
+
+/**
+ * @brief Vendor specific bulk loopback benchmark
+ *
+ * This is not a 'standard' testcase, as it never exits. Every OUT transfer is sent back in an IN transfer
+ * of the same length. Transfers are BENCH_CHUNK_SIZE long, so the host writes and reads chunks of this size.
+ */
+TEST_CASE("bench_vendor", "[esp_tinyusb][bench_vendor]")
+{
+    s_rx_queue = xQueueCreate(VENDOR_BUF_NUM, sizeof(vendor_rx_t));
+    TEST_ASSERT_NOT_NULL(s_rx_queue);
+    const tinyusb_vendor_stream_config_t stream_cfg = {
+        .itf = 0,
+        .xfer_size = BENCH_CHUNK_SIZE,
+        .buf_num = VENDOR_BUF_NUM,
+        .out_cb = vendor_out_cb,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, tinyusb_vendor_stream_init(&stream_cfg));
+
+    const tinyusb_desc_itf_config_t itfs[] = {
+        { .type = TINYUSB_DESC_ITF_VENDOR },
+    };
+    bench_install(itfs, 1);
+
+    vendor_rx_t rx;
+    while (xQueueReceive(s_rx_queue, &rx, portMAX_DELAY) == pdTRUE) {
+        uint8_t *tx = tinyusb_vendor_stream_in_get_buf(portMAX_DELAY);
+        memcpy(tx, rx.buf, rx.len);
+        tinyusb_vendor_stream_out_release(rx.buf);
+        if (tinyusb_vendor_stream_in_submit(tx, rx.len) == ESP_ERR_INVALID_ARG) {
+            TEST_FAIL_MESSAGE("IN buffer not submitted");
+        }
+    }
+}
+
+#endif // SOC_USB_OTG_SUPPORTED
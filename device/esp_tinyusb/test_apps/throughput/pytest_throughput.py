@@ -0,0 +1,297 @@
+# SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Apache-2.0
+
+import json
+import mmap
+import os
+import shutil
+import subprocess
+import threading
+from time import sleep, perf_counter
+
+import pytest
+from pytest_embedded_idf.dut import IdfDut
+from serial import Serial
+from serial.tools.list_ports import comports
+import usb.core
+import usb.util
+
+VID = 0x303A
+PID = 0x4010                    # BENCH_PID of the test app
+CHUNK_SIZE = 16 * 1024          # BENCH_CHUNK_SIZE of the test app
+CDC_BYTES = 16 * 1024 * 1024
+VENDOR_BYTES = 64 * 1024 * 1024
+MSC_BYTES_MAX = 16 * 1024 * 1024
+NCM_DEVICE_IP = '192.168.4.1'
+NCM_HOST_IP = '192.168.4.2'     # Given by DHCP server of the device
+NCM_IPERF_PORT = 5001           # CONFIG_BENCH_NCM_IPERF_PORT of the test app
+NCM_IPERF_TIME = 10
+ENUMERATION_TIME = 3
+
+RESULTS_FILE = os.environ.get('TINYUSB_BENCH_RESULTS', 'throughput_results.json')
+_results = {}
+
+
+def mbps(nbytes: int, seconds: float) -> float:
+    return round(nbytes / seconds / 1e6, 3)
+
+
+def start_bench(dut: IdfDut, tag: str) -> None:
+    dut.expect_exact('Press ENTER to see the list of tests.')
+    dut.write(f'[{tag}]')
+    dut.expect_exact('bench: ready')
+    sleep(ENUMERATION_TIME)  # Some time for the OS to enumerate our USB device
+
+
+def record(dut: IdfDut, name: str, result: dict) -> None:
+    '''
+    Store the result and rewrite the JSON file, so the results of passed benchmarks are kept if a later one fails
+    '''
+    mode = 'dma' if dut.app.sdkconfig.get('TINYUSB_MODE_DMA') else 'slave'
+    key = f'{dut.target}_{mode}'
+    _results.setdefault(key, {'target': dut.target, 'mode': mode})[name] = result
+    print(f'{key} {name}: {result}')
+    with open(RESULTS_FILE, 'w') as f:
+        json.dump(_results, f, indent=2)
+
+
+# CDC-ACM
+def cdc_find_port() -> str:
+    ports = [port for port, _, hwid in comports() if f'{VID:04X}:{PID:04X}' in hwid]
+    if len(ports) != 1:
+        raise Exception('TinyUSB benchmark COM port not found')
+    return ports[0]
+
+
+def cdc_host_to_device(cdc: Serial, nbytes: int) -> float:
+    chunk = bytes(CHUNK_SIZE)
+    start = perf_counter()
+    cdc.write(f'SINK {nbytes}\n'.encode())
+    assert cdc.readline() == b'GO\n'
+    for _ in range(nbytes // CHUNK_SIZE):
+        cdc.write(chunk)
+    assert cdc.readline() == b'DONE\n'
+    return mbps(nbytes, perf_counter() - start)
+
+
+def cdc_device_to_host(cdc: Serial, nbytes: int) -> float:
+    start = perf_counter()
+    cdc.write(f'SOURCE {nbytes}\n'.encode())
+    received = 0
+    while received < nbytes:
+        data = cdc.read(min(CHUNK_SIZE, nbytes - received))
+        if not data:
+            raise Exception(f'CDC timeout after {received} bytes')
+        received += len(data)
+    return mbps(nbytes, perf_counter() - start)
+
+
+# MSC
+def msc_find_disks() -> dict:
+    '''
+    Find block devices of the benchmark device in sysfs, indexed by LUN
+    '''
+    disks = {}
+    for name in os.listdir('/sys/block'):
+        device = f'/sys/block/{name}/device'
+        try:
+            with open(f'{device}/vendor') as f:
+                vendor = f.read().strip()
+        except OSError:
+            continue
+        if vendor != 'TinyUSB' or 'usb' not in os.path.realpath(device):
+            continue
+        lun = int(os.path.basename(os.path.realpath(device)).split(':')[-1])
+        with open(f'/sys/block/{name}/size') as f:
+            size = int(f.read()) * 512
+        disks[lun] = (f'/dev/{name}', size)
+    return disks
+
+
+def msc_sequential(path: str, size: int) -> dict:
+    '''
+    Write and read the raw block device with O_DIRECT, so the page cache does not hide the device speed
+    '''
+    nbytes = min(size, MSC_BYTES_MAX) // CHUNK_SIZE * CHUNK_SIZE
+    buf = mmap.mmap(-1, CHUNK_SIZE)  # Page aligned, as O_DIRECT requires
+    buf.write(os.urandom(CHUNK_SIZE))
+    fd = os.open(path, os.O_RDWR | os.O_DIRECT | os.O_SYNC)
+    try:
+        start = perf_counter()
+        for offset in range(0, nbytes, CHUNK_SIZE):
+            os.pwritev(fd, [buf], offset)
+        write = mbps(nbytes, perf_counter() - start)
+        start = perf_counter()
+        for offset in range(0, nbytes, CHUNK_SIZE):
+            os.preadv(fd, [buf], offset)
+        read = mbps(nbytes, perf_counter() - start)
+    finally:
+        os.close(fd)
+    return {'bytes': nbytes, 'write_MBps': write, 'read_MBps': read}
+
+
+# NCM
+def iperf_mbps(output: str) -> float:
+    '''
+    Throughput from iperf 2 CSV report (-y C), the last field of the last line is bits per second
+    '''
+    lines = [line for line in output.splitlines() if line.count(',') >= 8]
+    if not lines:
+        raise Exception(f'No iperf report in: {output}')
+    return round(int(lines[-1].split(',')[-1]) / 8e6, 3)
+
+
+# Vendor
+def vendor_loopback(nbytes: int) -> float:
+    dev = usb.core.find(idVendor=VID, idProduct=PID)
+    if dev is None:
+        raise ValueError('Device not found')
+    intf = dev.get_active_configuration()[(0, 0)]
+    ep_in = usb.util.find_descriptor(intf, custom_match=lambda e:
+                                     usb.util.endpoint_direction(e.bEndpointAddress) == usb.util.ENDPOINT_IN)
+    ep_out = usb.util.find_descriptor(intf, custom_match=lambda e:
+                                      usb.util.endpoint_direction(e.bEndpointAddress) == usb.util.ENDPOINT_OUT)
+    chunk = os.urandom(CHUNK_SIZE)
+    count = nbytes // CHUNK_SIZE
+    errors = []
+
+    def writer() -> None:
+        try:
+            for _ in range(count):
+                ep_out.write(chunk, 5000)
+        except usb.core.USBError as e:
+            errors.append(e)
+
+    start = perf_counter()
+    thread = threading.Thread(target=writer)
+    thread.start()
+    for i in range(count):
+        data = ep_in.read(CHUNK_SIZE, 5000)
+        if i == 0 and bytes(data) != chunk:
+            errors.append(Exception('Loopback data mismatch'))
+    elapsed = perf_counter() - start
+    thread.join()
+    usb.util.dispose_resources(dev)
+    if errors:
+        raise errors[0]
+    return mbps(nbytes, elapsed)
+
+
+@pytest.mark.esp32s2
+@pytest.mark.esp32s3
+@pytest.mark.esp32p4
+@pytest.mark.usb_benchmark
+def test_usb_device_throughput_cdc(dut: IdfDut) -> None:
+    '''
+    Running the benchmarks locally:
+    1. Build the test app for your DUT, e.g. `idf-build-apps build -p . --target esp32s3`,
+       build directories are build_<target>_dma and build_<target>_slave
+    2. Connect you DUT to your test runner (local machine) with USB port and flashing port
+    3. Run `pytest --target esp32s3 -m usb_benchmark --build-dir build_esp32s3_dma`
+    4. Results are written to throughput_results.json, or to the file in TINYUSB_BENCH_RESULTS
+
+    Test procedure:
+    1. Run the CDC benchmark on the DUT
+    2. Send CDC_BYTES to the device and wait for its reply
+    3. Request CDC_BYTES from the device
+    '''
+    start_bench(dut, 'bench_cdc')
+    with Serial(cdc_find_port(), timeout=5) as cdc:
+        record(dut, 'cdc', {
+            'bytes': CDC_BYTES,
+            'host_to_device_MBps': cdc_host_to_device(cdc, CDC_BYTES),
+            'device_to_host_MBps': cdc_device_to_host(cdc, CDC_BYTES),
+        })
+
+
+@pytest.mark.esp32s2
+@pytest.mark.esp32s3
+@pytest.mark.esp32p4
+@pytest.mark.usb_benchmark
+def test_usb_device_throughput_msc(dut: IdfDut) -> None:
+    '''
+    Test procedure:
+    1. Run the MSC benchmark on the DUT, one LUN per storage backend
+    2. Write and read each LUN sequentially, up to MSC_BYTES_MAX
+
+    Important note: The raw block devices are overwritten, root access to them is needed.
+    '''
+    dut.expect_exact('Press ENTER to see the list of tests.')
+    dut.write('[bench_msc]')
+    backends = {}
+    while True:
+        match = dut.expect(r'bench: (lun (\d+) (\w+)|ready)')
+        if match[1] == b'ready':
+            break
+        backends[int(match[2])] = match[3].decode()
+    sleep(ENUMERATION_TIME)
+
+    disks = msc_find_disks()
+    assert sorted(disks) == sorted(backends), f'Expected LUNs {backends}, found {disks}'
+    record(dut, 'msc', {backends[lun]: msc_sequential(*disks[lun]) for lun in sorted(disks)})
+
+
+@pytest.mark.esp32s2
+@pytest.mark.esp32s3
+@pytest.mark.esp32p4
+@pytest.mark.usb_benchmark
+def test_usb_device_throughput_ncm(dut: IdfDut) -> None:
+    '''
+    Test procedure:
+    1. Run the NCM benchmark on the DUT, the device runs iperf TCP server
+    2. Wait until the host gets NCM_HOST_IP from the device
+    3. Run iperf client on the host
+    4. Run iperf server on the host and let the device run iperf client
+
+    Important note: iperf 2 must be installed on the host. The host must configure the NCM interface by DHCP,
+                    as NetworkManager does by default.
+    '''
+    iperf = shutil.which('iperf')
+    if iperf is None:
+        pytest.skip('iperf 2 is not installed')
+    start_bench(dut, 'bench_ncm')
+    for _ in range(20):
+        if subprocess.run(['ping', '-c', '1', '-W', '1', NCM_DEVICE_IP], capture_output=True).returncode == 0:
+            break
+    else:
+        raise Exception(f'Device {NCM_DEVICE_IP} not reachable, is the NCM interface configured by DHCP?')
+
+    client = subprocess.run([iperf, '-c', NCM_DEVICE_IP, '-p', str(NCM_IPERF_PORT), '-t', str(NCM_IPERF_TIME), '-y', 'C'],
+                            capture_output=True, text=True, timeout=NCM_IPERF_TIME + 20)
+    host_to_device = iperf_mbps(client.stdout)
+
+    server = subprocess.Popen([iperf, '-s', '-p', str(NCM_IPERF_PORT), '-B', NCM_HOST_IP, '-y', 'C'],
+                              stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True)
+    try:
+        sleep(1)
+        dut.write(f'iperf_client {NCM_HOST_IP} {NCM_IPERF_TIME}')
+        dut.expect_exact('bench: iperf client done', timeout=NCM_IPERF_TIME + 20)
+    finally:
+        server.terminate()
+    device_to_host = iperf_mbps(server.communicate(timeout=5)[0])
+
+    record(dut, 'ncm', {
+        'tool': 'iperf2 TCP',
+        'host_to_device_MBps': host_to_device,
+        'device_to_host_MBps': device_to_host,
+    })
+
+
+@pytest.mark.esp32s2
+@pytest.mark.esp32s3
+@pytest.mark.esp32p4
+@pytest.mark.usb_benchmark
+def test_usb_device_throughput_vendor(dut: IdfDut) -> None:
+    '''
+    Test procedure:
+    1. Run the vendor loopback benchmark on the DUT
+    2. Write VENDOR_BYTES in CHUNK_SIZE transfers and read them back at the same time
+
+    Important note: On Windows you must manually assign a driver the device, otherwise it will never be configured.
+                    On Linux this is automatic
+    '''
+    start_bench(dut, 'bench_vendor')
+    record(dut, 'vendor', {
+        'bytes': VENDOR_BYTES,
+        'loopback_MBps': vendor_loopback(VENDOR_BYTES),
+    })
@@ -15,6 +15,10 @@
 #include "descriptors_control.h"
 #include "tusb.h"
 #include "tusb_tasks.h"
+#include "tinyusb_app_driver.h"
+#if CONFIG_TINYUSB_POWER_MGMT
+#include "tinyusb_power_private.h"
+#endif
 
 const static char *TAG = "TinyUSB";
 static usb_phy_handle_t phy_hdl;
@@ -55,6 +59,10 @@ esp_err_t tinyusb_driver_install(const tinyusb_config_t *config)
     // Descriptors config
     ESP_RETURN_ON_ERROR(tinyusb_set_descriptors(config), TAG, "Descriptors config failed");
 
+#if CONFIG_TINYUSB_POWER_MGMT
+    ESP_RETURN_ON_ERROR(tinyusb_power_init(config->external_phy), TAG, "Power management init failed");
+#endif
+
     // Init
 #if !CONFIG_TINYUSB_INIT_IN_DEFAULT_TASK
     ESP_RETURN_ON_FALSE(tusb_init(), ESP_FAIL, TAG, "Init TinyUSB stack failed");
@@ -69,5 +77,25 @@ esp_err_t tinyusb_driver_install(const tinyusb_config_t *config)
 esp_err_t tinyusb_driver_uninstall()
 {
     tinyusb_free_descriptors();
+#if CONFIG_TINYUSB_POWER_MGMT
+    tinyusb_power_deinit();
+#endif
     return usb_del_phy(phy_hdl);
 }
+
+#if CONFIG_TINYUSB_VENDOR_STREAM || CONFIG_TINYUSB_MIDI_BATCH
+usbd_class_driver_t const *usbd_app_driver_get_cb(uint8_t *driver_count)
+{
+    // TinyUSB takes one array of drivers, each of them opens only its own interfaces
+    static usbd_class_driver_t s_app_drivers[2];
+    uint8_t count = 0;
+#if CONFIG_TINYUSB_VENDOR_STREAM
+    s_app_drivers[count++] = tinyusb_vendor_stream_driver;
+#endif
+#if CONFIG_TINYUSB_MIDI_BATCH
+    s_app_drivers[count++] = tinyusb_midi_driver;
+#endif
+    *driver_count = count;
+    return s_app_drivers;
+}
+#endif // CONFIG_TINYUSB_VENDOR_STREAM || CONFIG_TINYUSB_MIDI_BATCH
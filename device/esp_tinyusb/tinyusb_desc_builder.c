@@ -0,0 +1,351 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_check.h"
+#include "tusb.h"
+#include "usb_descriptors.h"
+#include "tinyusb_desc_builder.h"
+#if CFG_TUD_VIDEO
+#include "tinyusb_uvc_private.h"
+#endif
+#if CFG_TUD_AUDIO
+#include "tinyusb_uac_private.h"
+#endif
+
+static const char *TAG = "tusb_desc_builder";
+
+#define BULK_EP_SIZE_FS     64
+#define BULK_EP_SIZE_HS     512
+#define CDC_NOTIF_EP_SIZE   8
+#define NET_NOTIF_EP_SIZE   64
+
+/**
+ * @brief Interface and endpoint numbers used by one function
+ */
+typedef struct {
+    uint8_t itf_num;    /*!< Number of interfaces */
+    uint8_t ep_num;     /*!< Number of endpoint numbers */
+    bool iad;           /*!< Function uses Interface Association Descriptor */
+} function_layout_t;
+
+static esp_err_t function_layout(const tinyusb_desc_itf_config_t *itf, function_layout_t *layout)
+{
+    switch (itf->type) {
+#if CFG_TUD_CDC
+    case TINYUSB_DESC_ITF_CDC_ACM:
+        *layout = (function_layout_t) { .itf_num = 2, .ep_num = 2, .iad = true };
+        return ESP_OK;
+#endif
+#if CFG_TUD_MSC
+    case TINYUSB_DESC_ITF_MSC:
+        *layout = (function_layout_t) { .itf_num = 1, .ep_num = 1 };
+        return ESP_OK;
+#endif
+#if CFG_TUD_HID
+    case TINYUSB_DESC_ITF_HID:
+        ESP_RETURN_ON_FALSE(itf->hid.ep_size && itf->hid.ep_size <= 64 && itf->hid.poll_ms,
+                            ESP_ERR_INVALID_ARG, TAG, "HID endpoint size must be 1..64 and polling interval non-zero");
+        *layout = (function_layout_t) { .itf_num = 1, .ep_num = 1 };
+        return ESP_OK;
+#endif
+#if CFG_TUD_MIDI
+    case TINYUSB_DESC_ITF_MIDI:
+        *layout = (function_layout_t) { .itf_num = 2, .ep_num = 1 };
+        return ESP_OK;
+#endif
+#if CFG_TUD_VENDOR
+    case TINYUSB_DESC_ITF_VENDOR:
+        *layout = (function_layout_t) { .itf_num = 1, .ep_num = 1 };
+        return ESP_OK;
+#endif
+#if CFG_TUD_ECM_RNDIS
+    case TINYUSB_DESC_ITF_ECM:
+        ESP_RETURN_ON_FALSE(itf->net.mac_str_idx, ESP_ERR_INVALID_ARG, TAG, "ECM needs MAC address string index");
+        *layout = (function_layout_t) { .itf_num = 2, .ep_num = 2, .iad = true };
+        return ESP_OK;
+#endif
+#if CFG_TUD_NCM
+    case TINYUSB_DESC_ITF_NCM:
+        *layout = (function_layout_t) { .itf_num = 2, .ep_num = 2, .iad = true };
+        return ESP_OK;
+#endif
+#if CFG_TUD_DFU_RUNTIME
+    case TINYUSB_DESC_ITF_DFU_RT:
+        *layout = (function_layout_t) { .itf_num = 1, .ep_num = 0 };
+        return ESP_OK;
+#endif
+#if CFG_TUD_DFU
+    case TINYUSB_DESC_ITF_DFU:
+        ESP_RETURN_ON_FALSE(itf->dfu.xfer_size > 0 && itf->dfu.xfer_size <= CFG_TUD_DFU_XFER_BUFSIZE &&
+                            itf->dfu.hs_xfer_size <= CFG_TUD_DFU_XFER_BUFSIZE,
+                            ESP_ERR_INVALID_ARG, TAG, "DFU transfer size must be 1 to %d", CFG_TUD_DFU_XFER_BUFSIZE);
+        *layout = (function_layout_t) { .itf_num = 1, .ep_num = 0 };
+        return ESP_OK;
+#endif
+#if CFG_TUD_VIDEO
+    case TINYUSB_DESC_ITF_UVC:
+        ESP_RETURN_ON_ERROR(tinyusb_uvc_check_config(itf->uvc.config), TAG, "UVC");
+        *layout = (function_layout_t) { .itf_num = 2, .ep_num = 1, .iad = true };
+        return ESP_OK;
+#endif
+#if CFG_TUD_AUDIO
+    case TINYUSB_DESC_ITF_UAC:
+        *layout = (function_layout_t) { .itf_num = TINYUSB_UAC_ITF_NUM, .ep_num = TINYUSB_UAC_EP_NUM, .iad = true };
+        return ESP_OK;
+#endif
+    default:
+        ESP_LOGE(TAG, "Interface type %d is not enabled in menuconfig", itf->type);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+}
+
+#if CFG_TUD_HID
+/**
+ * @brief HID interrupt endpoint bInterval
+ *
+ * FullSpeed interval is in frames (ms), HighSpeed interval is 2^(bInterval-1) microframes (125 us).
+ */
+static uint8_t hid_interval(uint8_t poll_ms, bool hs)
+{
+    if (!hs) {
+        return poll_ms;
+    }
+    uint8_t interval = 4; // 2^3 microframes = 1 ms
+    while (poll_ms > 1 && interval < 16) {
+        poll_ms >>= 1;
+        interval++;
+    }
+    return interval;
+}
+#endif
+
+/**
+ * @brief Write descriptor of one function
+ *
+ * @param[in]  itf      Function configuration
+ * @param[in]  hs       Build HighSpeed descriptor
+ * @param[in]  itf_num  First interface number of the function
+ * @param[in]  ep_num   First endpoint number of the function
+ * @param[out] dst      Destination buffer, NULL to get the length only
+ * @return Length of the descriptor
+ */
+static size_t function_desc(const tinyusb_desc_itf_config_t *itf, bool hs, uint8_t itf_num, uint8_t ep_num, uint8_t *dst)
+{
+    const uint16_t bulk_size = hs ? BULK_EP_SIZE_HS : BULK_EP_SIZE_FS;
+    switch (itf->type) {
+#if CFG_TUD_CDC
+    case TINYUSB_DESC_ITF_CDC_ACM: {
+        const uint8_t desc[] = {
+            TUD_CDC_DESCRIPTOR(itf_num, itf->str_idx, 0x80 | ep_num, CDC_NOTIF_EP_SIZE, ep_num + 1, 0x80 | (ep_num + 1), bulk_size)
+        };
+        if (dst) {
+            memcpy(dst, desc, sizeof(desc));
+        }
+        return sizeof(desc);
+    }
+#endif
+#if CFG_TUD_MSC
+    case TINYUSB_DESC_ITF_MSC: {
+        const uint8_t desc[] = {
+            TUD_MSC_DESCRIPTOR(itf_num, itf->str_idx, ep_num, 0x80 | ep_num, bulk_size)
+        };
+        if (dst) {
+            memcpy(dst, desc, sizeof(desc));
+        }
+        return sizeof(desc);
+    }
+#endif
+#if CFG_TUD_HID
+    case TINYUSB_DESC_ITF_HID: {
+        const uint8_t interval = hid_interval(itf->hid.poll_ms, hs);
+        if (itf->hid.out_ep) {
+            const uint8_t desc[] = {
+                TUD_HID_INOUT_DESCRIPTOR(itf_num, itf->str_idx, itf->hid.protocol, itf->hid.report_desc_len,
+                                         ep_num, 0x80 | ep_num, itf->hid.ep_size, interval)
+            };
+            if (dst) {
+                memcpy(dst, desc, sizeof(desc));
+            }
+            return sizeof(desc);
+        }
+        const uint8_t desc[] = {
+            TUD_HID_DESCRIPTOR(itf_num, itf->str_idx, itf->hid.protocol, itf->hid.report_desc_len,
+                               0x80 | ep_num, itf->hid.ep_size, interval)
+        };
+        if (dst) {
+            memcpy(dst, desc, sizeof(desc));
+        }
+        return sizeof(desc);
+    }
+#endif
+#if CFG_TUD_MIDI
+    case TINYUSB_DESC_ITF_MIDI: {
+        const uint8_t desc[] = {
+            TUD_MIDI_DESCRIPTOR(itf_num, itf->str_idx, ep_num, 0x80 | ep_num, bulk_size)
+        };
+        if (dst) {
+            memcpy(dst, desc, sizeof(desc));
+        }
+        return sizeof(desc);
+    }
+#endif
+#if CFG_TUD_VENDOR
+    case TINYUSB_DESC_ITF_VENDOR: {
+        const uint8_t desc[] = {
+            TUD_VENDOR_DESCRIPTOR(itf_num, itf->str_idx, ep_num, 0x80 | ep_num, bulk_size)
+        };
+        if (dst) {
+            memcpy(dst, desc, sizeof(desc));
+        }
+        return sizeof(desc);
+    }
+#endif
+#if CFG_TUD_ECM_RNDIS
+    case TINYUSB_DESC_ITF_ECM: {
+        const uint8_t desc[] = {
+            TUD_CDC_ECM_DESCRIPTOR(itf_num, itf->str_idx, itf->net.mac_str_idx, 0x80 | ep_num, NET_NOTIF_EP_SIZE,
+                                   ep_num + 1, 0x80 | (ep_num + 1), bulk_size, CFG_TUD_NET_MTU)
+        };
+        if (dst) {
+            memcpy(dst, desc, sizeof(desc));
+        }
+        return sizeof(desc);
+    }
+#endif
+#if CFG_TUD_NCM
+    case TINYUSB_DESC_ITF_NCM: {
+        const uint8_t mac_str_idx = itf->net.mac_str_idx ? itf->net.mac_str_idx : tusb_get_mac_string_id();
+        const uint8_t desc[] = {
+            TUD_CDC_NCM_DESCRIPTOR(itf_num, itf->str_idx, mac_str_idx, 0x80 | ep_num, NET_NOTIF_EP_SIZE,
+                                   ep_num + 1, 0x80 | (ep_num + 1), bulk_size, CFG_TUD_NET_MTU)
+        };
+        if (dst) {
+            memcpy(dst, desc, sizeof(desc));
+        }
+        return sizeof(desc);
+    }
+#endif
+#if CFG_TUD_DFU_RUNTIME
+    case TINYUSB_DESC_ITF_DFU_RT: {
+        const uint8_t desc[] = {
+            TUD_DFU_RT_DESCRIPTOR(itf_num, itf->str_idx, itf->dfu_rt.attr, itf->dfu_rt.detach_timeout_ms, itf->dfu_rt.xfer_size)
+        };
+        if (dst) {
+            memcpy(dst, desc, sizeof(desc));
+        }
+        return sizeof(desc);
+    }
+#endif
+#if CFG_TUD_DFU
+    case TINYUSB_DESC_ITF_DFU: {
+        const uint16_t xfer_size = (hs && itf->dfu.hs_xfer_size) ? itf->dfu.hs_xfer_size : itf->dfu.xfer_size;
+        const uint8_t desc[] = {
+            TUD_DFU_DESCRIPTOR(itf_num, 1, itf->str_idx, itf->dfu.attr, itf->dfu.detach_timeout_ms, xfer_size)
+        };
+        if (dst) {
+            memcpy(dst, desc, sizeof(desc));
+        }
+        return sizeof(desc);
+    }
+#endif
+#if CFG_TUD_VIDEO
+    case TINYUSB_DESC_ITF_UVC:
+        return tinyusb_uvc_desc(itf->uvc.config, itf_num, 0x80 | ep_num, itf->str_idx, hs, dst);
+#endif
+#if CFG_TUD_AUDIO
+    case TINYUSB_DESC_ITF_UAC:
+        return tinyusb_uac_desc(itf_num, ep_num, itf->str_idx, hs, dst);
+#endif
+    default:
+        return 0; // Rejected by function_layout()
+    }
+}
+
+/**
+ * @brief Write configuration descriptor for one speed
+ */
+static void config_desc(const tinyusb_desc_itf_config_t *itfs, size_t itf_num, uint8_t attributes, uint16_t power_ma,
+                        uint8_t itf_count, uint16_t total_len, bool hs, uint8_t *dst)
+{
+    const uint8_t header[] = {
+        // Configuration number, interface count, string index, total length, attribute, power in mA
+        TUD_CONFIG_DESCRIPTOR(1, itf_count, 0, total_len, attributes, power_ma)
+    };
+    memcpy(dst, header, sizeof(header));
+    dst += sizeof(header);
+
+    uint8_t itf_idx = 0;
+    uint8_t ep_idx = 1;
+    for (size_t i = 0; i < itf_num; i++) {
+        function_layout_t layout;
+        function_layout(&itfs[i], &layout);
+        dst += function_desc(&itfs[i], hs, itf_idx, ep_idx, dst);
+        itf_idx += layout.itf_num;
+        ep_idx += layout.ep_num;
+    }
+}
+
+esp_err_t tinyusb_desc_build(const tinyusb_desc_itf_config_t *itfs, size_t itf_num, uint8_t attributes, uint16_t power_ma, tinyusb_desc_cfg_t *cfg)
+{
+    ESP_RETURN_ON_FALSE(itfs && itf_num && cfg, ESP_ERR_INVALID_ARG, TAG, "Invalid arguments");
+    ESP_RETURN_ON_FALSE(power_ma <= 500, ESP_ERR_INVALID_ARG, TAG, "Power consumption must be up to 500 mA");
+    memset(cfg, 0, sizeof(tinyusb_desc_cfg_t));
+
+    // Validate functions and count interfaces, endpoints and length
+    size_t itf_count = 0;
+    size_t ep_count = 0;
+    size_t total_len = TUD_CONFIG_DESC_LEN;
+    bool iad = false;
+    for (size_t i = 0; i < itf_num; i++) {
+        function_layout_t layout;
+        ESP_RETURN_ON_ERROR(function_layout(&itfs[i], &layout), TAG, "Function %u", (unsigned)i);
+        // Endpoint and interface numbers are not known yet, but they do not change the length
+        total_len += function_desc(&itfs[i], false, 0, 1, NULL);
+        itf_count += layout.itf_num;
+        ep_count += layout.ep_num;
+        iad |= layout.iad;
+    }
+    ESP_RETURN_ON_FALSE(itf_count <= CFG_TUD_INTERFACE_MAX, ESP_ERR_NOT_SUPPORTED, TAG,
+                        "Too many interfaces (%u), TinyUSB supports %d", (unsigned)itf_count, CFG_TUD_INTERFACE_MAX);
+#ifdef TUP_DCD_ENDPOINT_MAX
+    ESP_RETURN_ON_FALSE(ep_count < TUP_DCD_ENDPOINT_MAX, ESP_ERR_NOT_SUPPORTED, TAG,
+                        "Too many endpoints (%u), controller supports %d", (unsigned)ep_count, TUP_DCD_ENDPOINT_MAX - 1);
+#endif
+    ESP_RETURN_ON_FALSE(total_len <= UINT16_MAX, ESP_ERR_INVALID_ARG, TAG, "Configuration descriptor too long");
+
+    cfg->fs_cfg = malloc(total_len);
+    ESP_RETURN_ON_FALSE(cfg->fs_cfg, ESP_ERR_NO_MEM, TAG, "Not enough memory for configuration descriptor");
+    config_desc(itfs, itf_num, attributes, power_ma, itf_count, total_len, false, cfg->fs_cfg);
+#if (TUD_OPT_HIGH_SPEED)
+    cfg->hs_cfg = malloc(total_len);
+    if (cfg->hs_cfg == NULL) {
+        tinyusb_desc_free(cfg);
+        ESP_LOGE(TAG, "Not enough memory for HighSpeed configuration descriptor");
+        return ESP_ERR_NO_MEM;
+    }
+    config_desc(itfs, itf_num, attributes, power_ma, itf_count, total_len, true, cfg->hs_cfg);
+#endif // TUD_OPT_HIGH_SPEED
+
+    cfg->itf_count = itf_count;
+    cfg->ep_count = ep_count;
+    cfg->iad = iad;
+    ESP_LOGD(TAG, "Configuration descriptor: %u interfaces, %u endpoints, %u bytes",
+             (unsigned)itf_count, (unsigned)ep_count, (unsigned)total_len);
+    return ESP_OK;
+}
+
+void tinyusb_desc_free(tinyusb_desc_cfg_t *cfg)
+{
+    if (cfg == NULL) {
+        return;
+    }
+    free(cfg->fs_cfg);
+    free(cfg->hs_cfg);
+    memset(cfg, 0, sizeof(tinyusb_desc_cfg_t));
+}
@@ -0,0 +1,347 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "tusb.h"
+#include "tinyusb_dfu_ota.h"
+
+#define DFU_OTA_BUF_NUM         (2)
+#define DFU_OTA_QUEUE_SIZE      (DFU_OTA_BUF_NUM + 2)       // Blocks, manifestation and abort or stop
+#define DFU_OTA_ERASE_STEP      (64 * 1024)                 // Flash block erase, faster than 16 sector erases
+#define DFU_OTA_SECTOR_SIZE     (4 * 1024)
+#define DFU_OTA_BUSY_POLL_MS    (1)
+#define DFU_OTA_MANIFEST_POLL_MS (100)
+
+typedef enum {
+    JOB_BLOCK,
+    JOB_MANIFEST,
+    JOB_ABORT,
+    JOB_STOP,
+} dfu_job_type_t;
+
+typedef struct {
+    dfu_job_type_t type;
+    uint8_t buf;
+    uint16_t len;
+    uint32_t offset;
+} dfu_job_t;
+
+typedef struct {
+    bool initialized;
+    tinyusb_dfu_ota_config_t cfg;
+    const esp_partition_t *partition;
+    portMUX_TYPE lock;                      // Protects buffer states, the pending finish and the status
+    QueueHandle_t jobs;
+    TaskHandle_t task;
+    TaskHandle_t stopper;                   // Task waiting for the DFU OTA task to finish
+    uint8_t *bufs[DFU_OTA_BUF_NUM];
+    bool buf_busy[DFU_OTA_BUF_NUM];
+    bool finish_pending;                    // Both buffers busy, the block is finished once one is written
+    uint8_t status;                         // DFU status of the download, DFU_STATUS_OK until an error
+    uint32_t offset;                        // Offset of the next block, TinyUSB task only
+    // DFU OTA task only
+    esp_ota_handle_t ota;
+    bool ota_active;
+    uint32_t erased;                        // Partition is erased up to this offset
+} dfu_ota_t;
+
+static const char *TAG = "tusb_dfu_ota";
+static dfu_ota_t s_dfu = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+//--------------------------------------------------------------------+
+// DFU OTA task
+//--------------------------------------------------------------------+
+static esp_err_t erase_up_to(uint32_t end)
+{
+    end = (end + DFU_OTA_SECTOR_SIZE - 1) & ~(DFU_OTA_SECTOR_SIZE - 1);
+    if (end > s_dfu.partition->size) {
+        end = s_dfu.partition->size;
+    }
+    if (end <= s_dfu.erased) {
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_ERROR(esp_partition_erase_range(s_dfu.partition, s_dfu.erased, end - s_dfu.erased), TAG, "Erase failed");
+    s_dfu.erased = end;
+    return ESP_OK;
+}
+
+static void ota_abort(void)
+{
+    if (s_dfu.ota_active) {
+        esp_ota_abort(s_dfu.ota);
+        s_dfu.ota_active = false;
+    }
+}
+
+static uint8_t write_block(const dfu_job_t *job)
+{
+    if (job->offset == 0) {
+        // First block of a new download
+        ota_abort();
+        s_dfu.erased = 0;
+        // Sequential writes mode does not erase, the partition is erased by erase_up_to()
+        if (esp_ota_begin(s_dfu.partition, OTA_WITH_SEQUENTIAL_WRITES, &s_dfu.ota) != ESP_OK) {
+            ESP_LOGE(TAG, "OTA begin failed");
+            return DFU_STATUS_ERR_WRITE;
+        }
+        s_dfu.ota_active = true;
+    }
+    if (!s_dfu.ota_active) {
+        return DFU_STATUS_ERR_NOTDONE;
+    }
+    if (job->offset + job->len > s_dfu.partition->size) {
+        ESP_LOGE(TAG, "Image larger than partition %s", s_dfu.partition->label);
+        return DFU_STATUS_ERR_ADDRESS;
+    }
+    if (erase_up_to(job->offset + job->len) != ESP_OK) {
+        return DFU_STATUS_ERR_ERASE;
+    }
+    if (esp_ota_write_with_offset(s_dfu.ota, s_dfu.bufs[job->buf], job->len, job->offset) != ESP_OK) {
+        ESP_LOGE(TAG, "Write at 0x%" PRIx32 " failed", job->offset);
+        return DFU_STATUS_ERR_WRITE;
+    }
+    return DFU_STATUS_OK;
+}
+
+static void block_done(const dfu_job_t *job, uint8_t result)
+{
+    portENTER_CRITICAL(&s_dfu.lock);
+    s_dfu.buf_busy[job->buf] = false;
+    if (s_dfu.status == DFU_STATUS_OK) {
+        s_dfu.status = result;
+    }
+    const uint8_t status = s_dfu.status;
+    const bool finish = s_dfu.finish_pending;
+    s_dfu.finish_pending = false;
+    portEXIT_CRITICAL(&s_dfu.lock);
+    if (finish) {
+        tud_dfu_finish_flashing(status);
+    }
+}
+
+static void manifest(void)
+{
+    portENTER_CRITICAL(&s_dfu.lock);
+    uint8_t status = s_dfu.status;
+    portEXIT_CRITICAL(&s_dfu.lock);
+
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+    if (status == DFU_STATUS_OK && s_dfu.ota_active) {
+        s_dfu.ota_active = false;
+        ret = esp_ota_end(s_dfu.ota); // Verifies the image
+        if (ret == ESP_OK) {
+            ret = esp_ota_set_boot_partition(s_dfu.partition);
+        }
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Image verification failed: %s", esp_err_to_name(ret));
+            status = DFU_STATUS_ERR_VERIFY;
+        }
+    } else {
+        ota_abort();
+        status = (status == DFU_STATUS_OK) ? DFU_STATUS_ERR_NOTDONE : status;
+    }
+    tud_dfu_finish_flashing(status);
+    if (s_dfu.cfg.done_cb) {
+        s_dfu.cfg.done_cb(ret, s_dfu.cfg.arg);
+    }
+}
+
+static void dfu_ota_task(void *arg)
+{
+    (void)arg;
+    dfu_job_t job;
+    bool running = true;
+    while (running) {
+        // Erase ahead of the incoming blocks while there is nothing to write
+        const bool erase_ahead = s_dfu.ota_active && s_dfu.erased < s_dfu.partition->size;
+        if (xQueueReceive(s_dfu.jobs, &job, erase_ahead ? 0 : portMAX_DELAY) != pdTRUE) {
+            if (erase_up_to(s_dfu.erased + DFU_OTA_ERASE_STEP) != ESP_OK) {
+                ota_abort();
+                portENTER_CRITICAL(&s_dfu.lock);
+                s_dfu.status = DFU_STATUS_ERR_ERASE;
+                portEXIT_CRITICAL(&s_dfu.lock);
+            }
+            continue;
+        }
+        switch (job.type) {
+        case JOB_BLOCK:
+            block_done(&job, write_block(&job));
+            break;
+        case JOB_MANIFEST:
+            manifest();
+            break;
+        case JOB_ABORT:
+            ota_abort();
+            break;
+        case JOB_STOP:
+            ota_abort();
+            running = false;
+            break;
+        }
+    }
+    xTaskNotifyGive(s_dfu.stopper);
+    vTaskDelete(NULL);
+}
+
+static void post_job(dfu_job_type_t type)
+{
+    const dfu_job_t job = { .type = type };
+    xQueueSend(s_dfu.jobs, &job, portMAX_DELAY);
+}
+
+//--------------------------------------------------------------------+
+// TinyUSB callbacks
+//--------------------------------------------------------------------+
+uint32_t tud_dfu_get_timeout_cb(uint8_t alt, uint8_t state)
+{
+    (void)alt;
+    return (state == DFU_MANIFEST) ? DFU_OTA_MANIFEST_POLL_MS : DFU_OTA_BUSY_POLL_MS;
+}
+
+void tud_dfu_download_cb(uint8_t alt, uint16_t block_num, uint8_t const *data, uint16_t length)
+{
+    (void)alt;
+    if (!s_dfu.initialized) {
+        tud_dfu_finish_flashing(DFU_STATUS_ERR_TARGET);
+        return;
+    }
+    int buf = -1;
+    portENTER_CRITICAL(&s_dfu.lock);
+    if (block_num == 0) {
+        s_dfu.offset = 0;
+        s_dfu.status = DFU_STATUS_OK;
+    }
+    uint8_t status = s_dfu.status;
+    for (int i = 0; i < DFU_OTA_BUF_NUM && status == DFU_STATUS_OK; i++) {
+        if (!s_dfu.buf_busy[i]) {
+            s_dfu.buf_busy[i] = true;
+            buf = i;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_dfu.lock);
+    if (buf < 0) {
+        // A block is finished only when a buffer is free for the next one, so this happens on errors only
+        tud_dfu_finish_flashing(status != DFU_STATUS_OK ? status : DFU_STATUS_ERR_UNKNOWN);
+        return;
+    }
+
+    memcpy(s_dfu.bufs[buf], data, length);
+    const dfu_job_t job = { .type = JOB_BLOCK, .buf = buf, .len = length, .offset = s_dfu.offset };
+    s_dfu.offset += length;
+    xQueueSend(s_dfu.jobs, &job, portMAX_DELAY);
+
+    // Let the host send the next block while this one is written, if there is a buffer for it
+    bool finish = false;
+    portENTER_CRITICAL(&s_dfu.lock);
+    for (int i = 0; i < DFU_OTA_BUF_NUM; i++) {
+        finish |= !s_dfu.buf_busy[i];
+    }
+    s_dfu.finish_pending = !finish;
+    status = s_dfu.status;
+    portEXIT_CRITICAL(&s_dfu.lock);
+    if (finish) {
+        tud_dfu_finish_flashing(status);
+    }
+}
+
+void tud_dfu_manifest_cb(uint8_t alt)
+{
+    (void)alt;
+    if (!s_dfu.initialized) {
+        tud_dfu_finish_flashing(DFU_STATUS_ERR_TARGET);
+        return;
+    }
+    post_job(JOB_MANIFEST);
+}
+
+uint16_t tud_dfu_upload_cb(uint8_t alt, uint16_t block_num, uint8_t *data, uint16_t length)
+{
+    (void)alt;
+    (void)block_num;
+    (void)data;
+    (void)length;
+    return 0; // Upload is not supported
+}
+
+void tud_dfu_abort_cb(uint8_t alt)
+{
+    (void)alt;
+    if (s_dfu.initialized) {
+        post_job(JOB_ABORT);
+    }
+}
+
+//--------------------------------------------------------------------+
+// API
+//--------------------------------------------------------------------+
+esp_err_t tinyusb_dfu_ota_init(const tinyusb_dfu_ota_config_t *config)
+{
+    ESP_RETURN_ON_FALSE(config, ESP_ERR_INVALID_ARG, TAG, "Config can't be NULL");
+    ESP_RETURN_ON_FALSE(!s_dfu.initialized, ESP_ERR_INVALID_STATE, TAG, "DFU OTA already initialized");
+    const esp_partition_t *partition = config->partition_label ?
+                                       esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, config->partition_label) :
+                                       esp_ota_get_next_update_partition(NULL);
+    ESP_RETURN_ON_FALSE(partition, ESP_ERR_NOT_FOUND, TAG, "OTA partition not found");
+
+    esp_err_t ret = ESP_OK;
+    memset(s_dfu.bufs, 0, sizeof(s_dfu.bufs));
+    s_dfu.jobs = NULL;
+    for (int i = 0; i < DFU_OTA_BUF_NUM; i++) {
+        s_dfu.bufs[i] = malloc(CFG_TUD_DFU_XFER_BUFSIZE);
+        ESP_GOTO_ON_FALSE(s_dfu.bufs[i], ESP_ERR_NO_MEM, fail, TAG, "No memory for DFU buffers");
+        s_dfu.buf_busy[i] = false;
+    }
+    s_dfu.jobs = xQueueCreate(DFU_OTA_QUEUE_SIZE, sizeof(dfu_job_t));
+    ESP_GOTO_ON_FALSE(s_dfu.jobs, ESP_ERR_NO_MEM, fail, TAG, "No memory for DFU queue");
+    s_dfu.cfg = *config;
+    s_dfu.partition = partition;
+    s_dfu.finish_pending = false;
+    s_dfu.status = DFU_STATUS_OK;
+    s_dfu.ota_active = false;
+    ESP_GOTO_ON_FALSE(xTaskCreate(dfu_ota_task, "TinyUSB DFU", CONFIG_TINYUSB_DFU_OTA_TASK_STACK_SIZE, NULL,
+                                  CONFIG_TINYUSB_DFU_OTA_TASK_PRIORITY, &s_dfu.task) == pdPASS,
+                      ESP_ERR_NO_MEM, fail, TAG, "Can't create DFU OTA task");
+    s_dfu.initialized = true;
+    ESP_LOGI(TAG, "DFU writes partition %s at 0x%" PRIx32, partition->label, partition->address);
+    return ESP_OK;
+
+fail:
+    if (s_dfu.jobs) {
+        vQueueDelete(s_dfu.jobs);
+    }
+    for (int i = 0; i < DFU_OTA_BUF_NUM; i++) {
+        free(s_dfu.bufs[i]);
+        s_dfu.bufs[i] = NULL;
+    }
+    return ret;
+}
+
+esp_err_t tinyusb_dfu_ota_deinit(void)
+{
+    ESP_RETURN_ON_FALSE(s_dfu.initialized, ESP_ERR_INVALID_STATE, TAG, "DFU OTA not initialized");
+    s_dfu.initialized = false;
+    s_dfu.stopper = xTaskGetCurrentTaskHandle();
+    post_job(JOB_STOP);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    vQueueDelete(s_dfu.jobs);
+    for (int i = 0; i < DFU_OTA_BUF_NUM; i++) {
+        free(s_dfu.bufs[i]);
+        s_dfu.bufs[i] = NULL;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,225 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "tusb.h"
+#include "tinyusb_hid.h"
+#include "tinyusb_hid_private.h"
+
+typedef struct {
+    uint8_t report_id;
+    uint16_t len;
+    uint8_t *data;
+} hid_report_slot_t;
+
+typedef struct {
+    tinyusb_hid_queue_config_t cfg;
+    portMUX_TYPE lock;              // Protects the queue, the flags and the statistics
+    hid_report_slot_t *slots;
+    uint8_t head;
+    uint8_t count;
+    bool busy;                      // The head report is being passed to TinyUSB
+    bool retry;                     // Endpoint completed while busy, try again
+    tinyusb_hid_queue_stats_t stats;
+} hid_queue_t;
+
+static const char *TAG = "tusb_hid";
+static hid_queue_t *s_queue[CFG_TUD_HID];
+static portMUX_TYPE s_queue_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline hid_report_slot_t *queue_slot(hid_queue_t *q, uint8_t pos)
+{
+    return &q->slots[(q->head + pos) % q->cfg.queue_len];
+}
+
+// Send the head of the queue if the endpoint is free, called by the app and from the completion callback
+static void queue_kick(hid_queue_t *q)
+{
+    bool again;
+    do {
+        portENTER_CRITICAL(&q->lock);
+        if (q->busy) {
+            q->retry = true;
+            portEXIT_CRITICAL(&q->lock);
+            return;
+        }
+        if (q->count == 0) {
+            portEXIT_CRITICAL(&q->lock);
+            return;
+        }
+        q->busy = true;
+        q->retry = false;
+        const hid_report_slot_t *slot = queue_slot(q, 0);
+        portEXIT_CRITICAL(&q->lock);
+
+        // TinyUSB copies the report to its endpoint buffer, the slot is free once this returns
+        const bool sent = tud_hid_n_ready(q->cfg.instance) &&
+                          tud_hid_n_report(q->cfg.instance, slot->report_id, slot->data, slot->len);
+
+        portENTER_CRITICAL(&q->lock);
+        q->busy = false;
+        if (sent) {
+            q->head = (q->head + 1) % q->cfg.queue_len;
+            q->count--;
+            q->stats.sent++;
+        }
+        again = q->retry;
+        portEXIT_CRITICAL(&q->lock);
+    } while (again);
+}
+
+//--------------------------------------------------------------------+
+// TinyUSB callbacks
+//--------------------------------------------------------------------+
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint16_t len)
+{
+    (void)report;
+    (void)len;
+    hid_queue_t *q = instance < CFG_TUD_HID ? s_queue[instance] : NULL;
+    if (q) {
+        queue_kick(q);
+    }
+}
+
+void tinyusb_hid_queue_resume(void)
+{
+    for (int i = 0; i < CFG_TUD_HID; i++) {
+        hid_queue_t *q = s_queue[i];
+        if (q) {
+            queue_kick(q);
+        }
+    }
+}
+
+//--------------------------------------------------------------------+
+// API
+//--------------------------------------------------------------------+
+esp_err_t tinyusb_hid_queue_init(const tinyusb_hid_queue_config_t *config)
+{
+    ESP_RETURN_ON_FALSE(config, ESP_ERR_INVALID_ARG, TAG, "Config can't be NULL");
+    ESP_RETURN_ON_FALSE(config->instance < CFG_TUD_HID, ESP_ERR_INVALID_ARG, TAG, "Invalid HID instance");
+    ESP_RETURN_ON_FALSE(config->report_len_max > 0 && config->report_len_max < CFG_TUD_HID_EP_BUFSIZE,
+                        ESP_ERR_INVALID_ARG, TAG, "Report length must be 1 to %d", CFG_TUD_HID_EP_BUFSIZE - 1);
+    ESP_RETURN_ON_FALSE(config->queue_len > 0, ESP_ERR_INVALID_ARG, TAG, "Queue length can't be 0");
+    ESP_RETURN_ON_FALSE(!s_queue[config->instance], ESP_ERR_INVALID_STATE, TAG, "HID queue already initialized");
+
+    // Queue object, slots and report data in one allocation
+    const size_t slots_size = config->queue_len * sizeof(hid_report_slot_t);
+    hid_queue_t *q = calloc(1, sizeof(hid_queue_t) + slots_size + config->queue_len * config->report_len_max);
+    ESP_RETURN_ON_FALSE(q, ESP_ERR_NO_MEM, TAG, "No memory for HID queue");
+    q->cfg = *config;
+    q->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    q->slots = (hid_report_slot_t *)(q + 1);
+    uint8_t *data = (uint8_t *)q->slots + slots_size;
+    for (int i = 0; i < config->queue_len; i++) {
+        q->slots[i].data = data + i * config->report_len_max;
+    }
+
+    portENTER_CRITICAL(&s_queue_lock);
+    s_queue[config->instance] = q;
+    portEXIT_CRITICAL(&s_queue_lock);
+    return ESP_OK;
+}
+
+esp_err_t tinyusb_hid_queue_deinit(uint8_t instance)
+{
+    ESP_RETURN_ON_FALSE(instance < CFG_TUD_HID && s_queue[instance], ESP_ERR_INVALID_STATE, TAG, "HID queue not initialized");
+    portENTER_CRITICAL(&s_queue_lock);
+    hid_queue_t *q = s_queue[instance];
+    s_queue[instance] = NULL;
+    portEXIT_CRITICAL(&s_queue_lock);
+    free(q);
+    return ESP_OK;
+}
+
+esp_err_t tinyusb_hid_queue_send(uint8_t instance, uint8_t report_id, const void *report, uint16_t len)
+{
+    hid_queue_t *q = instance < CFG_TUD_HID ? s_queue[instance] : NULL;
+    ESP_RETURN_ON_FALSE(q, ESP_ERR_INVALID_STATE, TAG, "HID queue not initialized");
+    ESP_RETURN_ON_FALSE(report && len > 0 && len <= q->cfg.report_len_max, ESP_ERR_INVALID_ARG, TAG, "Invalid report");
+
+    portENTER_CRITICAL(&q->lock);
+    // The head is read by queue_kick() while busy, merge only into a report nobody else is reading
+    const bool tail_free = q->count > 1 || (q->count == 1 && !q->busy);
+    hid_report_slot_t *tail = q->count ? queue_slot(q, q->count - 1) : NULL;
+    if (tail_free && q->cfg.merge_cb && tail->report_id == report_id && tail->len == len &&
+            q->cfg.merge_cb(report_id, tail->data, report, len, q->cfg.arg)) {
+        q->stats.merged++;
+    } else if (q->count < q->cfg.queue_len) {
+        hid_report_slot_t *slot = queue_slot(q, q->count);
+        slot->report_id = report_id;
+        slot->len = len;
+        memcpy(slot->data, report, len);
+        q->count++;
+    } else if (tail_free) {
+        tail->report_id = report_id;
+        tail->len = len;
+        memcpy(tail->data, report, len);
+        q->stats.dropped++;
+    } else {
+        // Only the report being sent is queued, so the queue length is 1: the new one is dropped
+        q->stats.dropped++;
+    }
+    portEXIT_CRITICAL(&q->lock);
+
+    if (tud_suspended()) {
+        // The report goes out from tinyusb_hid_queue_resume() once the host resumes the bus
+        if (q->cfg.remote_wakeup) {
+            tud_remote_wakeup();
+        }
+        return ESP_OK;
+    }
+    queue_kick(q);
+    return ESP_OK;
+}
+
+esp_err_t tinyusb_hid_queue_get_stats(uint8_t instance, tinyusb_hid_queue_stats_t *stats, bool reset)
+{
+    hid_queue_t *q = instance < CFG_TUD_HID ? s_queue[instance] : NULL;
+    ESP_RETURN_ON_FALSE(q, ESP_ERR_INVALID_STATE, TAG, "HID queue not initialized");
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "Stats can't be NULL");
+    portENTER_CRITICAL(&q->lock);
+    *stats = q->stats;
+    if (reset) {
+        memset(&q->stats, 0, sizeof(q->stats));
+    }
+    portEXIT_CRITICAL(&q->lock);
+    return ESP_OK;
+}
+
+static inline bool add_int8(int8_t *acc, int8_t val)
+{
+    const int sum = *acc + val;
+    if (sum > INT8_MAX || sum < INT8_MIN) {
+        return false;
+    }
+    *acc = (int8_t)sum;
+    return true;
+}
+
+bool tinyusb_hid_merge_mouse(uint8_t report_id, uint8_t *pending, const uint8_t *report, uint16_t len, void *arg)
+{
+    (void)report_id;
+    (void)arg;
+    hid_mouse_report_t merged;
+    hid_mouse_report_t next;
+    if (len != sizeof(hid_mouse_report_t)) {
+        return false;
+    }
+    memcpy(&merged, pending, sizeof(merged));
+    memcpy(&next, report, sizeof(next));
+    if (merged.buttons != next.buttons ||
+            !add_int8(&merged.x, next.x) || !add_int8(&merged.y, next.y) ||
+            !add_int8(&merged.wheel, next.wheel) || !add_int8(&merged.pan, next.pan)) {
+        return false;
+    }
+    memcpy(pending, &merged, sizeof(merged));
+    return true;
+}
@@ -0,0 +1,475 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "tusb.h"
+#include "tinyusb_app_driver.h"
+#include "tinyusb_midi.h"
+
+#if CONFIG_CACHE_L1_CACHE_LINE_SIZE
+// Cache synchronization of DMA buffers works on whole cache lines
+#define MIDI_BUF_ALIGN      (CONFIG_CACHE_L1_CACHE_LINE_SIZE)
+#else
+#define MIDI_BUF_ALIGN      (4)
+#endif
+#define MIDI_EP_SIZE_MAX    (TUD_OPT_HIGH_SPEED ? 512 : 64)
+#define MIDI_TX_BUF_SIZE    (CONFIG_TINYUSB_MIDI_TX_BUFSIZE & ~3) // Whole events only
+#define MIDI_EVENT_SIZE     (sizeof(tinyusb_midi_event_t))
+
+// Code Index Numbers of SysEx events
+#define MIDI_CIN_SYSEX_START    (0x4) // Starts or continues, 3 bytes
+#define MIDI_CIN_SYSEX_END_1    (0x5) // Ends with 1 byte, also single byte System Common message
+#define MIDI_CIN_SYSEX_END_3    (0x7) // Ends with 3 bytes
+#define MIDI_SYSEX_END          (0xF7)
+
+typedef struct {
+    bool opened;
+    uint8_t ep_in;                  // 0 if the interface is not configured
+    uint8_t ep_out;
+    uint16_t ep_in_size;
+    uint16_t ep_out_size;
+    bool in_busy;                   // IN transfer in progress or being started
+    uint8_t out_cur;                // Buffer of the OUT transfer in progress
+    uint8_t *in_buf;
+    uint8_t *out_buf[2];
+    uint8_t *tx_buf;                // Ring of events waiting for the IN endpoint
+    size_t tx_head;
+    size_t tx_count;
+    uint8_t sysex[MIDI_EP_SIZE_MAX / 4 * 3]; // SysEx bytes of one OUT transfer
+} midi_itf_t;
+
+typedef struct {
+    bool initialized;
+    tinyusb_midi_config_t cfg;
+    portMUX_TYPE lock;              // Protects endpoints, the TX ring and busy flags
+    uint8_t rhport;
+    midi_itf_t itf[CFG_TUD_MIDI];
+} midi_obj_t;
+
+static const char *TAG = "tusb_midi";
+static midi_obj_t s_midi = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static inline midi_itf_t *midi_get(uint8_t itf)
+{
+    return (s_midi.initialized && itf < CFG_TUD_MIDI) ? &s_midi.itf[itf] : NULL;
+}
+
+//--------------------------------------------------------------------+
+// IN
+//--------------------------------------------------------------------+
+// Called with the lock taken, len must fit the free space
+static void tx_put(midi_itf_t *m, const void *data, size_t len)
+{
+    const size_t tail = (m->tx_head + m->tx_count) % MIDI_TX_BUF_SIZE;
+    const size_t first = MIN(len, MIDI_TX_BUF_SIZE - tail);
+    memcpy(m->tx_buf + tail, data, first);
+    memcpy(m->tx_buf, (const uint8_t *)data + first, len - first);
+    m->tx_count += len;
+}
+
+/**
+ * @brief Send the collected events, up to one packet
+ *
+ * Called only by the owner of in_busy: the writer which set it or the completion of the previous transfer.
+ */
+static void in_start_next(midi_itf_t *m)
+{
+    portENTER_CRITICAL(&s_midi.lock);
+    const uint8_t ep_in = m->ep_in;
+    const size_t head = m->tx_head;
+    const size_t len = MIN(m->tx_count, m->ep_in_size);
+    if (ep_in == 0 || len == 0) {
+        m->in_busy = false;
+        portEXIT_CRITICAL(&s_midi.lock);
+        return;
+    }
+    portEXIT_CRITICAL(&s_midi.lock);
+
+    // Writers only append, the events being copied stay in place
+    const size_t first = MIN(len, MIDI_TX_BUF_SIZE - head);
+    memcpy(m->in_buf, m->tx_buf + head, first);
+    memcpy(m->in_buf + first, m->tx_buf, len - first);
+
+    portENTER_CRITICAL(&s_midi.lock);
+    if (m->ep_in != ep_in) {
+        portEXIT_CRITICAL(&s_midi.lock);
+        return; // Bus reset meanwhile, the ring was cleared
+    }
+    m->tx_head = (head + len) % MIDI_TX_BUF_SIZE;
+    m->tx_count -= len;
+    portEXIT_CRITICAL(&s_midi.lock);
+
+    if (!usbd_edpt_xfer(s_midi.rhport, ep_in, m->in_buf, len)) {
+        ESP_LOGW(TAG, "IN transfer not started, %u bytes dropped", (unsigned)len);
+        portENTER_CRITICAL(&s_midi.lock);
+        m->in_busy = false;
+        portEXIT_CRITICAL(&s_midi.lock);
+    }
+}
+
+// Called after the writer released the lock
+static void in_kick(midi_itf_t *m)
+{
+    portENTER_CRITICAL(&s_midi.lock);
+    const bool start = !m->in_busy && m->ep_in && m->tx_count;
+    if (start) {
+        m->in_busy = true;
+    }
+    portEXIT_CRITICAL(&s_midi.lock);
+    if (start) {
+        in_start_next(m);
+    }
+}
+
+bool tinyusb_midi_mounted(uint8_t itf)
+{
+    const midi_itf_t *m = midi_get(itf);
+    return m && m->ep_in;
+}
+
+size_t tinyusb_midi_write_available(uint8_t itf)
+{
+    midi_itf_t *m = midi_get(itf);
+    if (!m) {
+        return 0;
+    }
+    portENTER_CRITICAL(&s_midi.lock);
+    const size_t available = m->ep_in ? (MIDI_TX_BUF_SIZE - m->tx_count) / MIDI_EVENT_SIZE : 0;
+    portEXIT_CRITICAL(&s_midi.lock);
+    return available;
+}
+
+size_t tinyusb_midi_write(uint8_t itf, const tinyusb_midi_event_t *events, size_t count)
+{
+    midi_itf_t *m = midi_get(itf);
+    if (!m || !events) {
+        return 0;
+    }
+    portENTER_CRITICAL(&s_midi.lock);
+    size_t written = 0;
+    if (m->ep_in) {
+        written = MIN(count, (MIDI_TX_BUF_SIZE - m->tx_count) / MIDI_EVENT_SIZE);
+        tx_put(m, events, written * MIDI_EVENT_SIZE);
+    }
+    portEXIT_CRITICAL(&s_midi.lock);
+    in_kick(m);
+    return written;
+}
+
+size_t tinyusb_midi_sysex_write(uint8_t itf, uint8_t cable, const uint8_t *data, size_t len)
+{
+    midi_itf_t *m = midi_get(itf);
+    if (!m || !data) {
+        return 0;
+    }
+    size_t taken = 0;
+    portENTER_CRITICAL(&s_midi.lock);
+    size_t space = m->ep_in ? (MIDI_TX_BUF_SIZE - m->tx_count) / MIDI_EVENT_SIZE : 0;
+    while (taken < len && space) {
+        size_t n = MIN(len - taken, 3);
+        size_t end = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (data[taken + i] == MIDI_SYSEX_END) {
+                end = i + 1;
+                break;
+            }
+        }
+        if (end) {
+            n = end;
+        } else if (n < 3) {
+            break; // Wait for the rest of the group
+        }
+        tinyusb_midi_event_t event = {
+            .header = (uint8_t)((cable << 4) | (end ? MIDI_CIN_SYSEX_START + n : MIDI_CIN_SYSEX_START)),
+        };
+        memcpy(event.midi, data + taken, n);
+        tx_put(m, &event, sizeof(event));
+        taken += n;
+        space--;
+    }
+    portEXIT_CRITICAL(&s_midi.lock);
+    in_kick(m);
+    return taken;
+}
+
+//--------------------------------------------------------------------+
+// OUT
+//--------------------------------------------------------------------+
+static void out_arm(midi_itf_t *m)
+{
+    if (m->ep_out && !usbd_edpt_xfer(s_midi.rhport, m->ep_out, m->out_buf[m->out_cur], m->ep_out_size)) {
+        ESP_LOGW(TAG, "OUT transfer not started");
+    }
+}
+
+static inline bool is_sysex(const tinyusb_midi_event_t *event)
+{
+    const uint8_t cin = event->header & 0x0F;
+    return (cin >= MIDI_CIN_SYSEX_START && cin <= MIDI_CIN_SYSEX_END_3) &&
+           (cin != MIDI_CIN_SYSEX_END_1 || event->midi[0] == MIDI_SYSEX_END);
+}
+
+/**
+ * @brief Deliver the events of one OUT transfer
+ *
+ * Runs of other events are passed to rx_cb in place, SysEx bytes are collected and passed to sysex_cb,
+ * so the callbacks see the events in order of reception.
+ */
+static void rx_dispatch(uint8_t itf, midi_itf_t *m, const uint8_t *buf, size_t len)
+{
+    const int64_t now = esp_timer_get_time();
+    const tinyusb_midi_event_t *events = (const tinyusb_midi_event_t *)buf;
+    const size_t count = len / MIDI_EVENT_SIZE;
+    const tinyusb_midi_rx_cb_t rx_cb = s_midi.cfg.rx_cb;
+    const tinyusb_midi_sysex_cb_t sysex_cb = s_midi.cfg.sysex_cb;
+    size_t run = 0;                 // First event of the run not passed to rx_cb yet
+    size_t sysex_len = 0;
+    uint8_t sysex_cable = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const tinyusb_midi_event_t *event = &events[i];
+        const uint8_t cin = event->header & 0x0F;
+        const bool sysex = sysex_cb && is_sysex(event);
+        if (sysex || cin < 2) {
+            // The run ends here. Code Index Numbers 0 and 1 are reserved, such events are dropped
+            if (rx_cb && i > run) {
+                rx_cb(itf, &events[run], i - run, now, s_midi.cfg.arg);
+            }
+            run = i + 1;
+        }
+        if (sysex_len && (!sysex || sysex_cable != event->header >> 4)) {
+            sysex_cb(itf, sysex_cable, m->sysex, sysex_len, false, now, s_midi.cfg.arg);
+            sysex_len = 0;
+        }
+        if (sysex) {
+            const size_t n = cin == MIDI_CIN_SYSEX_START ? 3 : cin - MIDI_CIN_SYSEX_START;
+            memcpy(&m->sysex[sysex_len], event->midi, n);
+            sysex_len += n;
+            sysex_cable = event->header >> 4;
+            if (cin != MIDI_CIN_SYSEX_START) {
+                sysex_cb(itf, sysex_cable, m->sysex, sysex_len, true, now, s_midi.cfg.arg);
+                sysex_len = 0;
+            }
+        }
+    }
+    if (sysex_len) {
+        sysex_cb(itf, sysex_cable, m->sysex, sysex_len, false, now, s_midi.cfg.arg);
+    }
+    if (rx_cb && count > run) {
+        rx_cb(itf, &events[run], count - run, now, s_midi.cfg.arg);
+    }
+}
+
+//--------------------------------------------------------------------+
+// Class driver
+//--------------------------------------------------------------------+
+static void midi_init(void)
+{
+}
+
+#if (TUSB_VERSION_MAJOR > 0 || TUSB_VERSION_MINOR >= 17)
+static bool midi_deinit(void)
+{
+    return true;
+}
+#endif
+
+static void midi_reset(uint8_t rhport)
+{
+    (void)rhport;
+    // Endpoints are closed: drop events waiting for the IN endpoint
+    portENTER_CRITICAL(&s_midi.lock);
+    for (int i = 0; i < CFG_TUD_MIDI; i++) {
+        midi_itf_t *m = &s_midi.itf[i];
+        m->opened = false;
+        m->ep_in = 0;
+        m->ep_out = 0;
+        m->in_busy = false;
+        m->tx_head = 0;
+        m->tx_count = 0;
+    }
+    portEXIT_CRITICAL(&s_midi.lock);
+}
+
+static uint16_t midi_open(uint8_t rhport, tusb_desc_interface_t const *desc_itf, uint16_t max_len)
+{
+    // MIDI function: audio control interface followed by MIDI streaming interface
+    if (!s_midi.initialized ||
+            desc_itf->bInterfaceClass != TUSB_CLASS_AUDIO ||
+            desc_itf->bInterfaceSubClass != AUDIO_SUBCLASS_CONTROL ||
+            desc_itf->bInterfaceProtocol != AUDIO_FUNC_PROTOCOL_CODE_UNDEF) {
+        return 0;
+    }
+    const uint8_t *p_desc = (const uint8_t *)desc_itf;
+    const uint8_t *desc_end = p_desc + max_len;
+    p_desc = tu_desc_next(p_desc);
+    while (p_desc < desc_end && tu_desc_type(p_desc) == TUSB_DESC_CS_INTERFACE) {
+        p_desc = tu_desc_next(p_desc);
+    }
+    const tusb_desc_interface_t *desc_ms = (const tusb_desc_interface_t *)p_desc;
+    if (p_desc >= desc_end || tu_desc_type(p_desc) != TUSB_DESC_INTERFACE ||
+            desc_ms->bInterfaceClass != TUSB_CLASS_AUDIO ||
+            desc_ms->bInterfaceSubClass != AUDIO_SUBCLASS_MIDI_STREAMING) {
+        return 0; // Audio function, let TinyUSB audio driver open it
+    }
+
+    midi_itf_t *m = NULL;
+    for (int i = 0; i < CFG_TUD_MIDI && !m; i++) {
+        m = s_midi.itf[i].opened ? NULL : &s_midi.itf[i];
+    }
+    if (m == NULL) {
+        ESP_LOGE(TAG, "More than %d MIDI interfaces", CFG_TUD_MIDI);
+        return 0;
+    }
+
+    uint8_t ep_in = 0;
+    uint8_t ep_out = 0;
+    uint16_t ep_in_size = 0;
+    uint16_t ep_out_size = 0;
+    uint8_t found = 0;
+    p_desc = tu_desc_next(p_desc);
+    while (found < desc_ms->bNumEndpoints && p_desc < desc_end) {
+        if (tu_desc_type(p_desc) == TUSB_DESC_ENDPOINT) {
+            const tusb_desc_endpoint_t *desc_ep = (const tusb_desc_endpoint_t *)p_desc;
+            const uint16_t mps = tu_edpt_packet_size(desc_ep);
+            if (desc_ep->bmAttributes.xfer != TUSB_XFER_BULK || mps > MIDI_EP_SIZE_MAX || mps % MIDI_EVENT_SIZE) {
+                ESP_LOGE(TAG, "Endpoint 0x%02x must be bulk up to %d bytes", desc_ep->bEndpointAddress, MIDI_EP_SIZE_MAX);
+                return 0;
+            }
+            TU_ASSERT(usbd_edpt_open(rhport, desc_ep), 0);
+            if (tu_edpt_dir(desc_ep->bEndpointAddress) == TUSB_DIR_IN) {
+                ep_in = desc_ep->bEndpointAddress;
+                ep_in_size = mps;
+            } else {
+                ep_out = desc_ep->bEndpointAddress;
+                ep_out_size = mps;
+            }
+            found++;
+        }
+        p_desc = tu_desc_next(p_desc);
+    }
+    // Skip class specific endpoint descriptor of the last endpoint
+    while (p_desc < desc_end && tu_desc_type(p_desc) == TUSB_DESC_CS_ENDPOINT) {
+        p_desc = tu_desc_next(p_desc);
+    }
+
+    portENTER_CRITICAL(&s_midi.lock);
+    s_midi.rhport = rhport;
+    m->opened = true;
+    m->ep_in = ep_in;
+    m->ep_out = ep_out;
+    m->ep_in_size = ep_in_size;
+    m->ep_out_size = ep_out_size;
+    m->out_cur = 0;
+    portEXIT_CRITICAL(&s_midi.lock);
+    out_arm(m);
+    return (uint16_t)(p_desc - (const uint8_t *)desc_itf);
+}
+
+static bool midi_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const *request)
+{
+    (void)rhport;
+    (void)stage;
+    (void)request;
+    return false; // MIDI has no class requests
+}
+
+static bool midi_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
+{
+    (void)rhport;
+    if (result != XFER_RESULT_SUCCESS) {
+        ESP_LOGW(TAG, "Transfer on endpoint 0x%02x failed (%d)", ep_addr, result);
+        xferred_bytes = 0;
+    }
+    for (uint8_t itf = 0; itf < CFG_TUD_MIDI; itf++) {
+        midi_itf_t *m = &s_midi.itf[itf];
+        if (ep_addr == m->ep_in) {
+            in_start_next(m);
+            return true;
+        }
+        if (ep_addr == m->ep_out) {
+            // Receive to the other buffer while the callbacks process this one
+            const uint8_t *buf = m->out_buf[m->out_cur];
+            m->out_cur ^= 1;
+            out_arm(m);
+            rx_dispatch(itf, m, buf, xferred_bytes);
+            return true;
+        }
+    }
+    return false;
+}
+
+const usbd_class_driver_t tinyusb_midi_driver = {
+#if CFG_TUSB_DEBUG >= 2
+    .name = "MIDI_BATCH",
+#endif
+    .init = midi_init,
+#if (TUSB_VERSION_MAJOR > 0 || TUSB_VERSION_MINOR >= 17)
+    .deinit = midi_deinit,
+#endif
+    .reset = midi_reset,
+    .open = midi_open,
+    .control_xfer_cb = midi_control_xfer_cb,
+    .xfer_cb = midi_xfer_cb,
+};
+
+//--------------------------------------------------------------------+
+// Init
+//--------------------------------------------------------------------+
+static void free_bufs(void)
+{
+    for (int i = 0; i < CFG_TUD_MIDI; i++) {
+        midi_itf_t *m = &s_midi.itf[i];
+        heap_caps_free(m->in_buf);
+        heap_caps_free(m->out_buf[0]);
+        heap_caps_free(m->out_buf[1]);
+        free(m->tx_buf);
+    }
+    memset(s_midi.itf, 0, sizeof(s_midi.itf));
+}
+
+esp_err_t tinyusb_midi_init(const tinyusb_midi_config_t *config)
+{
+    ESP_RETURN_ON_FALSE(config, ESP_ERR_INVALID_ARG, TAG, "Config can't be NULL");
+    ESP_RETURN_ON_FALSE(!s_midi.initialized, ESP_ERR_INVALID_STATE, TAG, "Already initialized");
+
+    s_midi.cfg = *config;
+    // Endpoint buffers are used by USB DMA directly
+    const size_t size = (MIDI_EP_SIZE_MAX + MIDI_BUF_ALIGN - 1) & ~(MIDI_BUF_ALIGN - 1);
+    for (int i = 0; i < CFG_TUD_MIDI; i++) {
+        midi_itf_t *m = &s_midi.itf[i];
+        m->in_buf = heap_caps_aligned_alloc(MIDI_BUF_ALIGN, size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        m->out_buf[0] = heap_caps_aligned_alloc(MIDI_BUF_ALIGN, size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        m->out_buf[1] = heap_caps_aligned_alloc(MIDI_BUF_ALIGN, size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        m->tx_buf = malloc(MIDI_TX_BUF_SIZE);
+        if (!m->in_buf || !m->out_buf[0] || !m->out_buf[1] || !m->tx_buf) {
+            free_bufs();
+            ESP_LOGE(TAG, "Not enough memory for buffers");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    s_midi.initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t tinyusb_midi_deinit(void)
+{
+    ESP_RETURN_ON_FALSE(s_midi.initialized, ESP_ERR_INVALID_STATE, TAG, "Not initialized");
+    for (int i = 0; i < CFG_TUD_MIDI; i++) {
+        ESP_RETURN_ON_FALSE(!s_midi.itf[i].opened, ESP_ERR_INVALID_STATE, TAG, "Interface is configured");
+    }
+    s_midi.initialized = false;
+    free_bufs();
+    return ESP_OK;
+}
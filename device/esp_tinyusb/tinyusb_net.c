@@ -4,118 +4,368 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 #include "freertos/FreeRTOS.h"
-#include "freertos/event_groups.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "tinyusb_net.h"
 #include "descriptors_control.h"
 #include "usb_descriptors.h"
 #include "device/usbd_pvt.h"
 #include "esp_check.h"
+#include "esp_timer.h"
 
 #define MAC_ADDR_LEN 6
 
+typedef enum {
+    PACKET_QUEUED,                  // Waiting in the TX queue
+    PACKET_SENDING,                 // Taken from the queue by TinyUSB task
+    PACKET_DONE,                    // Sync packet only: result is valid
+} packet_state_t;
+
 typedef struct packet {
-    void *buffer;
+    struct packet *next;            // Next packet in the TX queue or in the free list
+    tinyusb_net_frag_t frags[TINYUSB_NET_TX_FRAGS_MAX];
+    uint8_t frag_num;
     void *buff_free_arg;
-    uint16_t len;
+    uint16_t len;                   // Total length of all fragments
+    packet_state_t state;
+    bool sync;                      // Sent by tinyusb_net_send_sync(), the sender waits for the result
+    SemaphoreHandle_t done;         // Given when a sync packet is done, created on first sync use of the slot
     esp_err_t result;
 } packet_t;
 
 struct tinyusb_net_handle {
     bool initialized;
-    SemaphoreHandle_t buffer_sema;
-    EventGroupHandle_t  tx_flags;
     tusb_net_rx_cb_t    rx_cb;
     tusb_net_free_tx_cb_t tx_buff_free_cb;
     tusb_net_init_cb_t init_cb;
+    bool rx_loan;
+    const uint8_t *rx_loaned;       // Receive buffer loaned to the app, renewed by tinyusb_net_recv_done()
     char mac_str[2 * MAC_ADDR_LEN + 1];
     void *ctx;
-    packet_t *packet_to_send;
+    // TX queue: packets are taken from a pool, so sending does not allocate
+    portMUX_TYPE tx_lock;           // Protects the TX queue, the free list and tx_scheduled
+    SemaphoreHandle_t tx_slots;     // Counts free packets in the pool, sync senders wait on it
+    esp_timer_handle_t tx_retry_timer;
+    packet_t *tx_free;
+    packet_t *tx_head;
+    packet_t *tx_tail;
+    bool tx_scheduled;              // do_send_queued() is deferred to TinyUSB task or the retry timer runs
+    packet_t tx_pool[CONFIG_TINYUSB_NET_TX_QUEUE_SIZE];
+#if CONFIG_TINYUSB_NET_MODE_NCM
+    // IN NTB being filled, accessed only from TinyUSB task
+    uint16_t ntb_in_size;
+    uint8_t ntb_in_max_datagrams;
+    uint32_t ntb_bytes;             // Datagram bytes passed to TinyUSB since the NTB was started
+    uint8_t ntb_datagrams;
+#endif
+#if CONFIG_TINYUSB_NET_STATS
+    portMUX_TYPE stats_lock;        // Updated from TinyUSB task and the senders
+    tinyusb_net_stats_t stats;
+    uint64_t stats_ntb_bytes;       // Datagram bytes of stats.tx_ntb
+#endif
 };
 
-const static int TX_FINISHED_BIT = BIT0;
-static struct tinyusb_net_handle s_net_obj = { };
+// Time to retry sending when all NTBs (transfer buffers) are on the bus
+#define TX_RETRY_US 250
+
+static struct tinyusb_net_handle s_net_obj = {
+    .tx_lock = portMUX_INITIALIZER_UNLOCKED,
+#if CONFIG_TINYUSB_NET_STATS
+    .stats_lock = portMUX_INITIALIZER_UNLOCKED,
+#endif
+};
 static const char *TAG = "tusb_net";
 
-static void do_send_sync(void *ctx)
+#if CONFIG_TINYUSB_NET_STATS
+#define NET_STATS_ADD(field, n) do {                \
+        portENTER_CRITICAL(&s_net_obj.stats_lock);  \
+        s_net_obj.stats.field += (n);               \
+        portEXIT_CRITICAL(&s_net_obj.stats_lock);   \
+    } while (0)
+#else
+#define NET_STATS_ADD(field, n) do {} while (0)
+#endif
+
+#if CONFIG_TINYUSB_NET_MODE_NCM
+/**
+ * @brief Close the IN NTB being filled, the next datagram starts a new one
+ *
+ * TinyUSB closes NTBs itself, so this is where aggregation of this driver stops:
+ * the queue is empty, TinyUSB cannot take more data or the runtime limits are reached.
+ */
+static void ntb_close(void)
 {
-    (void) ctx;
-    if (xSemaphoreTake(s_net_obj.buffer_sema, 0) != pdTRUE || s_net_obj.packet_to_send == NULL) {
+    if (s_net_obj.ntb_datagrams == 0) {
         return;
     }
+#if CONFIG_TINYUSB_NET_STATS
+    portENTER_CRITICAL(&s_net_obj.stats_lock);
+    s_net_obj.stats.tx_ntb++;
+    s_net_obj.stats_ntb_bytes += s_net_obj.ntb_bytes;
+    portEXIT_CRITICAL(&s_net_obj.stats_lock);
+#endif
+    s_net_obj.ntb_bytes = 0;
+    s_net_obj.ntb_datagrams = 0;
+}
+#endif // CONFIG_TINYUSB_NET_MODE_NCM
 
-    packet_t *packet = s_net_obj.packet_to_send;
-    if (tud_network_can_xmit(packet->len)) {
-        tud_network_xmit(packet, packet->len);
-        packet->result = ESP_OK;
+static packet_t *packet_alloc(TickType_t timeout)
+{
+    if (xSemaphoreTake(s_net_obj.tx_slots, timeout) != pdTRUE) {
+        return NULL;
+    }
+    portENTER_CRITICAL(&s_net_obj.tx_lock);
+    packet_t *packet = s_net_obj.tx_free;
+    s_net_obj.tx_free = packet->next;
+    portEXIT_CRITICAL(&s_net_obj.tx_lock);
+    return packet;
+}
+
+static void packet_free(packet_t *packet)
+{
+    portENTER_CRITICAL(&s_net_obj.tx_lock);
+    packet->next = s_net_obj.tx_free;
+    s_net_obj.tx_free = packet;
+    portEXIT_CRITICAL(&s_net_obj.tx_lock);
+    xSemaphoreGive(s_net_obj.tx_slots);
+}
+
+/**
+ * @brief Finish the packet taken from the queue
+ *
+ * Async packets return to the pool, sync sender is woken up and frees the packet itself.
+ */
+static void packet_done(packet_t *packet, esp_err_t result)
+{
+    if (packet->sync) {
+        packet->result = result;
+        portENTER_CRITICAL(&s_net_obj.tx_lock);
+        packet->state = PACKET_DONE;
+        portEXIT_CRITICAL(&s_net_obj.tx_lock);
+        xSemaphoreGive(packet->done);
     } else {
-        packet->result = ESP_FAIL;
+        if (result != ESP_OK && s_net_obj.tx_buff_free_cb) {
+            s_net_obj.tx_buff_free_cb(packet->buff_free_arg, s_net_obj.ctx);
+        }
+        packet_free(packet);
     }
-    xSemaphoreGive(s_net_obj.buffer_sema);
-    xEventGroupSetBits(s_net_obj.tx_flags, TX_FINISHED_BIT);
 }
 
-static void do_send_async(void *ctx)
+/**
+ * @brief Send queued packets, executed in TinyUSB task
+ *
+ * One deferred call drains the whole queue; in NCM mode all the datagrams which fit
+ * are aggregated into the NTB being filled, while the previous NTB is on the bus.
+ * When TinyUSB cannot accept the next packet, it stays at the head of the queue and sending
+ * is retried from tx_retry_timer. Packets are only dropped when the device is not connected.
+ */
+static void do_send_queued(void *ctx)
 {
-    packet_t *packet = ctx;
-    if (tud_network_can_xmit(packet->len)) {
-        tud_network_xmit(packet, packet->len);
-    } else if (s_net_obj.tx_buff_free_cb) {
-        ESP_LOGW(TAG, "Packet cannot be accepted on USB interface, dropping");
-        s_net_obj.tx_buff_free_cb(packet->buff_free_arg, s_net_obj.ctx);
+    (void) ctx;
+    while (true) {
+        portENTER_CRITICAL(&s_net_obj.tx_lock);
+        packet_t *packet = s_net_obj.tx_head;
+        if (packet == NULL) {
+            s_net_obj.tx_scheduled = false;
+            portEXIT_CRITICAL(&s_net_obj.tx_lock);
+#if CONFIG_TINYUSB_NET_MODE_NCM
+            ntb_close();
+#endif
+            return;
+        }
+        const uint16_t len = packet->len;
+        portEXIT_CRITICAL(&s_net_obj.tx_lock);
+
+#if CONFIG_TINYUSB_NET_MODE_NCM
+        if (s_net_obj.ntb_datagrams && (s_net_obj.ntb_datagrams >= s_net_obj.ntb_in_max_datagrams ||
+                                        s_net_obj.ntb_bytes + len > s_net_obj.ntb_in_size)) {
+            // Pending USB events are processed before the next call, so TinyUSB sends this NTB first
+            ntb_close();
+            usbd_defer_func(do_send_queued, NULL, false);
+            return;
+        }
+#endif
+        const bool ready = tud_ready();
+        if (ready && !tud_network_can_xmit(len)) {
+#if CONFIG_TINYUSB_NET_MODE_NCM
+            ntb_close();
+#endif
+            // tx_scheduled stays set, so the senders do not defer another call
+            esp_timer_start_once(s_net_obj.tx_retry_timer, TX_RETRY_US);
+            return;
+        }
+
+        portENTER_CRITICAL(&s_net_obj.tx_lock);
+        if (s_net_obj.tx_head != packet) {
+            // Sync sender has timed out and taken its packet back meanwhile
+            portEXIT_CRITICAL(&s_net_obj.tx_lock);
+            continue;
+        }
+        s_net_obj.tx_head = packet->next;
+        packet->state = PACKET_SENDING;
+        portEXIT_CRITICAL(&s_net_obj.tx_lock);
+
+        if (ready) {
+            tud_network_xmit(packet, len); // Calls tud_network_xmit_cb() before it returns
+            packet_done(packet, ESP_OK);
+#if CONFIG_TINYUSB_NET_MODE_NCM
+            s_net_obj.ntb_bytes += len;
+            s_net_obj.ntb_datagrams++;
+#endif
+#if CONFIG_TINYUSB_NET_STATS
+            portENTER_CRITICAL(&s_net_obj.stats_lock);
+            s_net_obj.stats.tx_packets++;
+            s_net_obj.stats.tx_bytes += len;
+            portEXIT_CRITICAL(&s_net_obj.stats_lock);
+#endif
+        } else {
+            ESP_LOGW(TAG, "Device not connected, dropping packet");
+            NET_STATS_ADD(tx_drop_disconnected, 1);
+            packet_done(packet, ESP_ERR_INVALID_STATE);
+        }
     }
-    free(packet);
 }
 
-esp_err_t tinyusb_net_send_async(void *buffer, uint16_t len, void *buff_free_arg)
+static void tx_retry_timer_cb(void *arg)
+{
+    (void) arg;
+    usbd_defer_func(do_send_queued, NULL, false);
+}
+
+static void packet_enqueue(packet_t *packet)
+{
+    packet->next = NULL;
+    packet->state = PACKET_QUEUED;
+
+    portENTER_CRITICAL(&s_net_obj.tx_lock);
+    if (s_net_obj.tx_head) {
+        s_net_obj.tx_tail->next = packet;
+    } else {
+        s_net_obj.tx_head = packet;
+    }
+    s_net_obj.tx_tail = packet;
+    const bool schedule = !s_net_obj.tx_scheduled;
+    s_net_obj.tx_scheduled = true;
+    portEXIT_CRITICAL(&s_net_obj.tx_lock);
+
+    if (schedule) {
+        usbd_defer_func(do_send_queued, NULL, false);
+    }
+}
+
+/**
+ * @brief Remove the packet from the TX queue
+ *
+ * @return true if the packet was still queued, false if TinyUSB task has taken it already
+ */
+static bool packet_dequeue(packet_t *packet)
+{
+    bool removed = false;
+    portENTER_CRITICAL(&s_net_obj.tx_lock);
+    if (packet->state == PACKET_QUEUED) {
+        packet_t *prev = NULL;
+        for (packet_t *p = s_net_obj.tx_head; p != packet; p = p->next) {
+            prev = p;
+        }
+        if (prev) {
+            prev->next = packet->next;
+        } else {
+            s_net_obj.tx_head = packet->next;
+        }
+        if (s_net_obj.tx_tail == packet) {
+            s_net_obj.tx_tail = prev;
+        }
+        removed = true;
+    }
+    portEXIT_CRITICAL(&s_net_obj.tx_lock);
+    return removed;
+}
+
+esp_err_t tinyusb_net_send_frags_async(const tinyusb_net_frag_t *frags, size_t frag_num, void *buff_free_arg)
 {
     if (!tud_ready()) {
+        NET_STATS_ADD(tx_drop_disconnected, 1);
         return ESP_ERR_INVALID_STATE;
     }
+    ESP_RETURN_ON_FALSE(frags && frag_num > 0 && frag_num <= TINYUSB_NET_TX_FRAGS_MAX, ESP_ERR_INVALID_ARG, TAG, "Invalid fragments");
+    size_t len = 0;
+    for (size_t i = 0; i < frag_num; i++) {
+        len += frags[i].len;
+    }
+    ESP_RETURN_ON_FALSE(len <= UINT16_MAX, ESP_ERR_INVALID_SIZE, TAG, "Packet too long");
 
-    packet_t *packet = calloc(1, sizeof(packet_t));
+    packet_t *packet = packet_alloc(0);
+    if (packet == NULL) {
+        NET_STATS_ADD(tx_drop_queue_full, 1);
+        ESP_LOGE(TAG, "TX queue is full");
+        return ESP_ERR_NO_MEM;
+    }
+
+    memcpy(packet->frags, frags, frag_num * sizeof(tinyusb_net_frag_t));
+    packet->frag_num = frag_num;
     packet->len = len;
-    packet->buffer = buffer;
     packet->buff_free_arg = buff_free_arg;
-    ESP_RETURN_ON_FALSE(packet, ESP_ERR_NO_MEM, TAG, "Failed to allocate packet to send");
-    usbd_defer_func(do_send_async, packet, false);
+    packet->sync = false;
+    packet_enqueue(packet);
     return ESP_OK;
 }
 
+esp_err_t tinyusb_net_send_async(void *buffer, uint16_t len, void *buff_free_arg)
+{
+    const tinyusb_net_frag_t frag = {
+        .data = buffer,
+        .len = len,
+    };
+    return tinyusb_net_send_frags_async(&frag, 1, buff_free_arg);
+}
+
 esp_err_t tinyusb_net_send_sync(void *buffer, uint16_t len, void *buff_free_arg, TickType_t  timeout)
 {
     if (!tud_ready()) {
+        NET_STATS_ADD(tx_drop_disconnected, 1);
         return ESP_ERR_INVALID_STATE;
     }
 
-    // Lazy init the flags and semaphores, as they might not be needed (if async approach is used)
-    if (!s_net_obj.tx_flags) {
-        s_net_obj.tx_flags = xEventGroupCreate();
-        ESP_RETURN_ON_FALSE(s_net_obj.tx_flags, ESP_ERR_NO_MEM, TAG, "Failed to allocate event flags");
-    }
-    if (!s_net_obj.buffer_sema) {
-        s_net_obj.buffer_sema = xSemaphoreCreateBinary();
-        ESP_RETURN_ON_FALSE(s_net_obj.buffer_sema, ESP_ERR_NO_MEM, TAG, "Failed to allocate buffer semaphore");
+    // Wait for a free slot in the TX queue, this is where the backpressure applies
+    const TickType_t start = xTaskGetTickCount();
+    packet_t *packet = packet_alloc(timeout);
+    if (packet == NULL) {
+        NET_STATS_ADD(tx_drop_timeout, 1);
+        return ESP_ERR_TIMEOUT;
     }
 
-    packet_t packet = {
-        .buffer = buffer,
-        .len = len,
-        .buff_free_arg = buff_free_arg
-    };
-    s_net_obj.packet_to_send = &packet;
-    xSemaphoreGive(s_net_obj.buffer_sema);  // now the packet is ready, let's mark it available to tusb send
-
-    // to execute the send function in tinyUSB task context
-    usbd_defer_func(do_send_sync, NULL, false);  // arg=NULL -> sync send, we keep the packet inside the object
+    // Lazy init the semaphore, as it might not be needed (if async approach is used)
+    if (packet->done == NULL) {
+        packet->done = xSemaphoreCreateBinary();
+        if (packet->done == NULL) {
+            packet_free(packet);
+            ESP_LOGE(TAG, "Failed to allocate packet semaphore");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    SemaphoreHandle_t done = packet->done;
+    packet->frags[0].data = buffer;
+    packet->frags[0].len = len;
+    packet->frag_num = 1;
+    packet->len = len;
+    packet->buff_free_arg = buff_free_arg;
+    packet->sync = true;
+    packet_enqueue(packet);
 
-    // wait wor completion with defined timeout
-    EventBits_t bits = xEventGroupWaitBits(s_net_obj.tx_flags, TX_FINISHED_BIT, pdTRUE, pdTRUE, timeout);
-    xSemaphoreTake(s_net_obj.buffer_sema, portMAX_DELAY);   // if tusb sending already started, we have wait before ditching the packet
-    s_net_obj.packet_to_send = NULL;        // invalidate the argument
-    if (bits & TX_FINISHED_BIT) {   // If transaction finished, return error code
-        return packet.result;
+    // Wait for completion within the rest of the timeout
+    const TickType_t elapsed = xTaskGetTickCount() - start;
+    if (xSemaphoreTake(done, timeout > elapsed ? timeout - elapsed : 0) != pdTRUE) {
+        if (packet_dequeue(packet)) {
+            packet_free(packet);
+            NET_STATS_ADD(tx_drop_timeout, 1);
+            return ESP_ERR_TIMEOUT;
+        }
+        // If tusb sending already started, we have to wait before ditching the packet
+        xSemaphoreTake(done, portMAX_DELAY);
     }
-    return ESP_ERR_TIMEOUT;
+    const esp_err_t ret = packet->result;
+    packet_free(packet);
+    return ret;
 }
 
 esp_err_t tinyusb_net_init(tinyusb_usbdev_t usb_dev, const tinyusb_net_config_t *cfg)
@@ -123,32 +373,131 @@ esp_err_t tinyusb_net_init(tinyusb_usbdev_t usb_dev, const tinyusb_net_config_t
     (void) usb_dev;
 
     ESP_RETURN_ON_FALSE(s_net_obj.initialized == false, ESP_ERR_INVALID_STATE, TAG, "TinyUSB Net class is already initialized");
+#if CONFIG_TINYUSB_NET_MODE_NCM
+    ESP_RETURN_ON_FALSE(cfg->ncm.ntb_in_size <= CONFIG_TINYUSB_NET_NCM_NTB_SIZE, ESP_ERR_INVALID_ARG, TAG,
+                        "ncm.ntb_in_size exceeds CONFIG_TINYUSB_NET_NCM_NTB_SIZE");
+    ESP_RETURN_ON_FALSE(cfg->ncm.ntb_in_max_datagrams <= CONFIG_TINYUSB_NET_NCM_MAX_DATAGRAMS, ESP_ERR_INVALID_ARG, TAG,
+                        "ncm.ntb_in_max_datagrams exceeds CONFIG_TINYUSB_NET_NCM_MAX_DATAGRAMS");
+    s_net_obj.ntb_in_size = cfg->ncm.ntb_in_size ? cfg->ncm.ntb_in_size : CONFIG_TINYUSB_NET_NCM_NTB_SIZE;
+    s_net_obj.ntb_in_max_datagrams = cfg->ncm.ntb_in_max_datagrams ? cfg->ncm.ntb_in_max_datagrams : CONFIG_TINYUSB_NET_NCM_MAX_DATAGRAMS;
+    s_net_obj.ntb_bytes = 0;
+    s_net_obj.ntb_datagrams = 0;
+#endif
+#if CONFIG_TINYUSB_NET_STATS
+    memset(&s_net_obj.stats, 0, sizeof(s_net_obj.stats));
+    s_net_obj.stats_ntb_bytes = 0;
+#endif
 
     // the semaphore and event flags are initialized only if needed
     s_net_obj.rx_cb = cfg->on_recv_callback;
     s_net_obj.init_cb = cfg->on_init_callback;
     s_net_obj.tx_buff_free_cb = cfg->free_tx_buffer;
     s_net_obj.ctx = cfg->user_context;
+    s_net_obj.rx_loan = cfg->recv_loan;
+
+    s_net_obj.tx_head = NULL;
+    s_net_obj.tx_free = NULL;
+    for (int i = 0; i < CONFIG_TINYUSB_NET_TX_QUEUE_SIZE; i++) {
+        s_net_obj.tx_pool[i].next = s_net_obj.tx_free;
+        s_net_obj.tx_free = &s_net_obj.tx_pool[i];
+    }
+    s_net_obj.tx_slots = xSemaphoreCreateCounting(CONFIG_TINYUSB_NET_TX_QUEUE_SIZE, CONFIG_TINYUSB_NET_TX_QUEUE_SIZE);
+    ESP_RETURN_ON_FALSE(s_net_obj.tx_slots, ESP_ERR_NO_MEM, TAG, "Failed to allocate TX queue semaphore");
+    const esp_timer_create_args_t timer_args = {
+        .callback = tx_retry_timer_cb,
+        .name = "tusb_net_tx",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &s_net_obj.tx_retry_timer);
+    if (ret != ESP_OK) {
+        vSemaphoreDelete(s_net_obj.tx_slots);
+        s_net_obj.tx_slots = NULL;
+        ESP_LOGE(TAG, "Failed to create TX retry timer");
+        return ret;
+    }
 
     const uint8_t *mac = &cfg->mac_addr[0];
     snprintf(s_net_obj.mac_str, sizeof(s_net_obj.mac_str), "%02X%02X%02X%02X%02X%02X",
              mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
     uint8_t mac_id = tusb_get_mac_string_id();
     // Pass it to Descriptor control module
-    tinyusb_set_str_descriptor(s_net_obj.mac_str, mac_id);
+    ret = tinyusb_set_str_descriptor(s_net_obj.mac_str, mac_id);
+    if (ret != ESP_OK) {
+        esp_timer_delete(s_net_obj.tx_retry_timer);
+        vSemaphoreDelete(s_net_obj.tx_slots);
+        s_net_obj.tx_slots = NULL;
+        ESP_LOGE(TAG, "Failed to set MAC string descriptor");
+        return ret;
+    }
 
     s_net_obj.initialized = true;
 
     return ESP_OK;
 }
 
+static void do_recv_renew(void *ctx)
+{
+    (void) ctx;
+    tud_network_recv_renew();
+}
+
+esp_err_t tinyusb_net_recv_done(void *buffer)
+{
+    ESP_RETURN_ON_FALSE(buffer && buffer == s_net_obj.rx_loaned, ESP_ERR_INVALID_ARG, TAG, "Buffer is not loaned");
+    s_net_obj.rx_loaned = NULL;
+    // to execute the renew in tinyUSB task context
+    usbd_defer_func(do_recv_renew, NULL, false);
+    return ESP_OK;
+}
+
+esp_err_t tinyusb_net_get_stats(tinyusb_net_stats_t *stats, bool reset)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "stats is NULL");
+#if CONFIG_TINYUSB_NET_STATS
+    portENTER_CRITICAL(&s_net_obj.stats_lock);
+    *stats = s_net_obj.stats;
+    const uint64_t ntb_bytes = s_net_obj.stats_ntb_bytes;
+    if (reset) {
+        memset(&s_net_obj.stats, 0, sizeof(s_net_obj.stats));
+        s_net_obj.stats_ntb_bytes = 0;
+    }
+    portEXIT_CRITICAL(&s_net_obj.stats_lock);
+#if CONFIG_TINYUSB_NET_MODE_NCM
+    if (stats->tx_ntb) {
+        stats->tx_ntb_fill_pct = ntb_bytes * 100 / ((uint64_t)stats->tx_ntb * s_net_obj.ntb_in_size);
+    }
+#else
+    (void) ntb_bytes;
+#endif
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
 //--------------------------------------------------------------------+
 // tinyusb callbacks
 //--------------------------------------------------------------------+
 bool tud_network_recv_cb(const uint8_t *src, uint16_t size)
 {
-    if (s_net_obj.rx_cb) {
-        s_net_obj.rx_cb((void *)src, size, s_net_obj.ctx);
+#if CONFIG_TINYUSB_NET_STATS
+    portENTER_CRITICAL(&s_net_obj.stats_lock);
+    s_net_obj.stats.rx_packets++;
+    s_net_obj.stats.rx_bytes += size;
+    if (s_net_obj.rx_cb == NULL) {
+        s_net_obj.stats.rx_drop_no_callback++;
+    }
+    portEXIT_CRITICAL(&s_net_obj.stats_lock);
+#endif
+    if (s_net_obj.rx_loan && s_net_obj.rx_cb) {
+        // The buffer is not renewed here, TinyUSB holds the next packet until the app returns this one
+        s_net_obj.rx_loaned = src;
+        if (s_net_obj.rx_cb((void *)src, size, s_net_obj.ctx) != ESP_OK) {
+            NET_STATS_ADD(rx_drop_app, 1);
+        }
+        return true;
+    }
+    if (s_net_obj.rx_cb && s_net_obj.rx_cb((void *)src, size, s_net_obj.ctx) != ESP_OK) {
+        NET_STATS_ADD(rx_drop_app, 1);
     }
     tud_network_recv_renew();
     return true;
@@ -159,7 +508,11 @@ uint16_t tud_network_xmit_cb(uint8_t *dst, void *ref, uint16_t arg)
     packet_t *packet = ref;
     uint16_t len = arg;
 
-    memcpy(dst, packet->buffer, packet->len);
+    // Fragments are gathered right into the USB transfer buffer (NTB in NCM mode), the only copy of the data
+    for (int i = 0; i < packet->frag_num; i++) {
+        memcpy(dst, packet->frags[i].data, packet->frags[i].len);
+        dst += packet->frags[i].len;
+    }
     if (s_net_obj.tx_buff_free_cb) {
         s_net_obj.tx_buff_free_cb(packet->buff_free_arg, s_net_obj.ctx);
     }
@@ -168,6 +521,7 @@ uint16_t tud_network_xmit_cb(uint8_t *dst, void *ref, uint16_t arg)
 
 void tud_network_init_cb(void)
 {
+    s_net_obj.rx_loaned = NULL;     // Receive buffers have been reset by TinyUSB
     if (s_net_obj.init_cb) {
         s_net_obj.init_cb(s_net_obj.ctx);
     }
@@ -0,0 +1,169 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "tusb.h"
+#include "tinyusb_power.h"
+#include "tinyusb_power_private.h"
+#if CONFIG_TINYUSB_HID_REPORT_QUEUE
+#include "tinyusb_hid_private.h"
+#endif
+#if CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "driver/gpio.h"
+#include "soc/usb_pins.h"
+#endif
+
+#if CONFIG_PM_ENABLE && (CONFIG_IDF_TARGET_ESP32S2 || CONFIG_IDF_TARGET_ESP32S3)
+// Resume signalling drives K state, D- goes high. The pad of the internal PHY is GPIO19
+#define POWER_WAKEUP_SUPPORTED  1
+#define POWER_INT_PHY_DM_GPIO   (19)
+#endif
+
+typedef struct {
+    portMUX_TYPE lock;              // Protects the flags
+    bool locked;                    // Power locks are taken, the bus is active
+    tinyusb_power_cb_t cb;
+    void *cb_arg;
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_handle_t no_sleep;  // Light sleep stops USB controller clock
+    esp_pm_lock_handle_t apb_max;   // USB controller needs APB at full frequency
+#endif
+#if POWER_WAKEUP_SUPPORTED
+    gpio_num_t wakeup_gpio;
+#endif
+} power_obj_t;
+
+static const char *TAG = "tusb_power";
+static power_obj_t s_power = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static void power_locks_take(void)
+{
+    portENTER_CRITICAL(&s_power.lock);
+    const bool take = !s_power.locked;
+    s_power.locked = true;
+    portEXIT_CRITICAL(&s_power.lock);
+    if (!take) {
+        return;
+    }
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_acquire(s_power.apb_max);
+    esp_pm_lock_acquire(s_power.no_sleep);
+#endif
+#if POWER_WAKEUP_SUPPORTED
+    gpio_wakeup_disable(s_power.wakeup_gpio);
+#endif
+}
+
+static void power_locks_give(void)
+{
+    portENTER_CRITICAL(&s_power.lock);
+    const bool give = s_power.locked;
+    s_power.locked = false;
+    portEXIT_CRITICAL(&s_power.lock);
+    if (!give) {
+        return;
+    }
+#if POWER_WAKEUP_SUPPORTED
+    // Wake up from light sleep on resume signalling, USB controller then reports the resume
+    gpio_wakeup_enable(s_power.wakeup_gpio, GPIO_INTR_HIGH_LEVEL);
+    esp_sleep_enable_gpio_wakeup();
+#endif
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_release(s_power.no_sleep);
+    esp_pm_lock_release(s_power.apb_max);
+#endif
+}
+
+//--------------------------------------------------------------------+
+// TinyUSB callbacks
+//--------------------------------------------------------------------+
+void tud_suspend_cb(bool remote_wakeup_en)
+{
+    ESP_LOGD(TAG, "Suspended, remote wakeup %s", remote_wakeup_en ? "enabled" : "disabled");
+    if (s_power.cb) {
+        s_power.cb(TINYUSB_POWER_EVENT_SUSPEND, remote_wakeup_en, s_power.cb_arg);
+    }
+    power_locks_give();
+}
+
+void tud_resume_cb(void)
+{
+    power_locks_take();
+    ESP_LOGD(TAG, "Resumed");
+    if (s_power.cb) {
+        s_power.cb(TINYUSB_POWER_EVENT_RESUME, false, s_power.cb_arg);
+    }
+#if CONFIG_TINYUSB_HID_REPORT_QUEUE
+    // Reports queued while suspended were not sent, the endpoints are free
+    tinyusb_hid_queue_resume();
+#endif
+}
+
+//--------------------------------------------------------------------+
+// API
+//--------------------------------------------------------------------+
+esp_err_t tinyusb_power_register_callback(tinyusb_power_cb_t cb, void *arg)
+{
+    portENTER_CRITICAL(&s_power.lock);
+    s_power.cb = cb;
+    s_power.cb_arg = arg;
+    portEXIT_CRITICAL(&s_power.lock);
+    return ESP_OK;
+}
+
+esp_err_t tinyusb_power_remote_wakeup(void)
+{
+    ESP_RETURN_ON_FALSE(tud_suspended(), ESP_ERR_INVALID_STATE, TAG, "Bus is not suspended");
+    // Resume signalling runs with the locks taken, the resume callback finds them taken already
+    power_locks_take();
+    if (!tud_remote_wakeup()) {
+        // The bus stays suspended, no suspend callback would give the locks back
+        power_locks_give();
+        ESP_LOGE(TAG, "Remote wakeup not enabled by the host");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return ESP_OK;
+}
+
+esp_err_t tinyusb_power_init(bool external_phy)
+{
+#if CONFIG_PM_ENABLE
+    ESP_RETURN_ON_ERROR(esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "tusb", &s_power.no_sleep), TAG, "PM lock create failed");
+    if (esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "tusb", &s_power.apb_max) != ESP_OK) {
+        esp_pm_lock_delete(s_power.no_sleep);
+        ESP_LOGE(TAG, "PM lock create failed");
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+#if POWER_WAKEUP_SUPPORTED
+    s_power.wakeup_gpio = external_phy ? USBPHY_VM_NUM : POWER_INT_PHY_DM_GPIO;
+#else
+    (void)external_phy;
+#endif
+    s_power.locked = false;
+    // The bus is active until the host suspends it
+    power_locks_take();
+    return ESP_OK;
+}
+
+void tinyusb_power_deinit(void)
+{
+    power_locks_give();
+#if POWER_WAKEUP_SUPPORTED
+    gpio_wakeup_disable(s_power.wakeup_gpio);
+#endif
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_delete(s_power.no_sleep);
+    esp_pm_lock_delete(s_power.apb_max);
+#endif
+}
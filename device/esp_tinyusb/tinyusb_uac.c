@@ -0,0 +1,455 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_check.h"
+#include "tusb.h"
+#include "tinyusb_uac.h"
+#include "tinyusb_uac_private.h"
+#include "tinyusb_desc_writer.h"
+
+// TinyUSB computes the feedback value from the FIFO level since 0.16, older versions get the nominal rate
+#define FEEDBACK_PARAMS_SUPPORTED (TUSB_VERSION_MAJOR > 0 || TUSB_VERSION_MINOR >= 16)
+
+#define UAC_SPK_CH              TINYUSB_UAC_SPK_CH
+#define UAC_MIC_CH              TINYUSB_UAC_MIC_CH
+#define UAC_SAMPLE_BYTES        CONFIG_TINYUSB_UAC_SAMPLE_BYTES
+
+// Entity IDs
+#define UAC_ENTITY_CLOCK        0x04
+#define UAC_ENTITY_SPK_IT       0x01
+#define UAC_ENTITY_SPK_FU       0x02
+#define UAC_ENTITY_SPK_OT       0x03
+#define UAC_ENTITY_MIC_IT       0x11
+#define UAC_ENTITY_MIC_OT       0x13
+
+// Volume range in 1/256 dB
+#define UAC_VOLUME_MIN          (-90 * 256)
+#define UAC_VOLUME_MAX          0
+#define UAC_VOLUME_RES          256
+
+// Lengths of the class specific descriptors
+#define AC_HEADER_LEN           9
+#define AC_CLOCK_LEN            8
+#define AC_IT_LEN               17
+#define AC_FU_LEN(ch)           (6 + 4 * ((ch) + 1))
+#define AC_OT_LEN               12
+#define AS_GENERAL_LEN          16
+#define AS_FORMAT_LEN           6
+#define AS_ISO_EP_LEN           8
+
+// Samples of one (micro)frame at the maximum rate, plus one for asynchronous rate adaptation
+#define UAC_EP_SIZE(ch, hs)     ((CONFIG_TINYUSB_UAC_MAX_SAMPLE_RATE / ((hs) ? 8000 : 1000) + 1) * (ch) * UAC_SAMPLE_BYTES)
+
+typedef struct {
+    bool initialized;
+    tinyusb_uac_config_t cfg;
+    uint32_t sample_rates[TINYUSB_UAC_SAMPLE_RATES_MAX];
+    uint32_t sample_rate;
+    bool mute;
+    int16_t volume;
+    uint8_t itf_num;                // Audio control interface, set when the descriptor is built
+} uac_obj_t;
+
+static const char *TAG = "tusb_uac";
+static uac_obj_t s_uac;
+
+//--------------------------------------------------------------------+
+// Descriptors
+//--------------------------------------------------------------------+
+static void put_interface(desc_writer_t *w, uint8_t itf_num, uint8_t alt, uint8_t ep_num, uint8_t subclass, uint8_t str_idx)
+{
+    desc_put_u8(w, 9);
+    desc_put_u8(w, TUSB_DESC_INTERFACE);
+    desc_put_u8(w, itf_num);
+    desc_put_u8(w, alt);
+    desc_put_u8(w, ep_num);
+    desc_put_u8(w, TUSB_CLASS_AUDIO);
+    desc_put_u8(w, subclass);
+    desc_put_u8(w, AUDIO_INT_PROTOCOL_CODE_V2);
+    desc_put_u8(w, str_idx);
+}
+
+static void put_terminal_in(desc_writer_t *w, uint8_t id, uint16_t type, uint8_t channels)
+{
+    desc_put_u8(w, AC_IT_LEN);
+    desc_put_u8(w, TUSB_DESC_CS_INTERFACE);
+    desc_put_u8(w, AUDIO_CS_AC_INTERFACE_INPUT_TERMINAL);
+    desc_put_u8(w, id);
+    desc_put_u16(w, type);
+    desc_put_u8(w, 0);                      // bAssocTerminal
+    desc_put_u8(w, UAC_ENTITY_CLOCK);       // bCSourceID
+    desc_put_u8(w, channels);               // bNrChannels
+    desc_put_u32(w, 0);                     // bmChannelConfig: non-predefined spatial positions
+    desc_put_u8(w, 0);                      // iChannelNames
+    desc_put_u16(w, 0);                     // bmControls
+    desc_put_u8(w, 0);                      // iTerminal
+}
+
+static void put_terminal_out(desc_writer_t *w, uint8_t id, uint16_t type, uint8_t source)
+{
+    desc_put_u8(w, AC_OT_LEN);
+    desc_put_u8(w, TUSB_DESC_CS_INTERFACE);
+    desc_put_u8(w, AUDIO_CS_AC_INTERFACE_OUTPUT_TERMINAL);
+    desc_put_u8(w, id);
+    desc_put_u16(w, type);
+    desc_put_u8(w, 0);                      // bAssocTerminal
+    desc_put_u8(w, source);                 // bSourceID
+    desc_put_u8(w, UAC_ENTITY_CLOCK);       // bCSourceID
+    desc_put_u16(w, 0);                     // bmControls
+    desc_put_u8(w, 0);                      // iTerminal
+}
+
+/**
+ * @brief Audio streaming interface with zero bandwidth alternate 0 and streaming alternate 1
+ */
+static void put_streaming(desc_writer_t *w, uint8_t itf_num, uint8_t terminal, uint8_t channels, uint8_t ep, uint16_t ep_size,
+                          uint8_t ep_fb, bool hs)
+{
+    put_interface(w, itf_num, 0, 0, AUDIO_SUBCLASS_STREAMING, 0);
+    put_interface(w, itf_num, 1, ep_fb ? 2 : 1, AUDIO_SUBCLASS_STREAMING, 0);
+
+    desc_put_u8(w, AS_GENERAL_LEN);
+    desc_put_u8(w, TUSB_DESC_CS_INTERFACE);
+    desc_put_u8(w, AUDIO_CS_AS_INTERFACE_AS_GENERAL);
+    desc_put_u8(w, terminal);               // bTerminalLink
+    desc_put_u8(w, 0);                      // bmControls
+    desc_put_u8(w, AUDIO_FORMAT_TYPE_I);
+    desc_put_u32(w, AUDIO_DATA_FORMAT_TYPE_I_PCM);
+    desc_put_u8(w, channels);
+    desc_put_u32(w, 0);                     // bmChannelConfig
+    desc_put_u8(w, 0);                      // iChannelNames
+
+    desc_put_u8(w, AS_FORMAT_LEN);
+    desc_put_u8(w, TUSB_DESC_CS_INTERFACE);
+    desc_put_u8(w, AUDIO_CS_AS_INTERFACE_FORMAT_TYPE);
+    desc_put_u8(w, AUDIO_FORMAT_TYPE_I);
+    desc_put_u8(w, UAC_SAMPLE_BYTES);       // bSubslotSize
+    desc_put_u8(w, UAC_SAMPLE_BYTES * 8);   // bBitResolution
+
+    desc_put_u8(w, 7);
+    desc_put_u8(w, TUSB_DESC_ENDPOINT);
+    desc_put_u8(w, ep);
+    desc_put_u8(w, TUSB_XFER_ISOCHRONOUS | TUSB_ISO_EP_ATT_ASYNCHRONOUS);
+    desc_put_u16(w, ep_size);
+    desc_put_u8(w, 1);                      // bInterval: every (micro)frame
+
+    desc_put_u8(w, AS_ISO_EP_LEN);
+    desc_put_u8(w, TUSB_DESC_CS_ENDPOINT);
+    desc_put_u8(w, AUDIO_CS_EP_SUBTYPE_GENERAL);
+    desc_put_u8(w, 0);                      // bmAttributes
+    desc_put_u8(w, 0);                      // bmControls
+    desc_put_u8(w, 0);                      // bLockDelayUnits
+    desc_put_u16(w, 0);                     // wLockDelay
+
+    if (ep_fb) {
+        desc_put_u8(w, 7);
+        desc_put_u8(w, TUSB_DESC_ENDPOINT);
+        desc_put_u8(w, ep_fb);
+        desc_put_u8(w, TUSB_XFER_ISOCHRONOUS | TUSB_ISO_EP_ATT_EXPLICIT_FB);
+        desc_put_u16(w, 4);
+        desc_put_u8(w, hs ? 4 : 1);         // bInterval: 1 ms
+    }
+}
+
+size_t tinyusb_uac_desc(uint8_t itf_num, uint8_t ep_num, uint8_t str_idx, bool hs, uint8_t *dst)
+{
+    const uint16_t ac_total_len = AC_HEADER_LEN + AC_CLOCK_LEN +
+                                  (UAC_SPK_CH ? AC_IT_LEN + AC_FU_LEN(UAC_SPK_CH) + AC_OT_LEN : 0) +
+                                  (UAC_MIC_CH ? AC_IT_LEN + AC_OT_LEN : 0);
+    desc_writer_t w = { .dst = dst };
+    uint8_t itf_next = itf_num + 1;
+    s_uac.itf_num = itf_num;
+
+    // Interface association
+    desc_put_u8(&w, 8);
+    desc_put_u8(&w, TUSB_DESC_INTERFACE_ASSOCIATION);
+    desc_put_u8(&w, itf_num);
+    desc_put_u8(&w, TINYUSB_UAC_ITF_NUM);
+    desc_put_u8(&w, TUSB_CLASS_AUDIO);
+    desc_put_u8(&w, AUDIO_FUNCTION_SUBCLASS_UNDEFINED);
+    desc_put_u8(&w, AUDIO_FUNC_PROTOCOL_CODE_V2);
+    desc_put_u8(&w, str_idx);
+
+    // Audio control: clock source shared by all terminals
+    put_interface(&w, itf_num, 0, 0, AUDIO_SUBCLASS_CONTROL, str_idx);
+    desc_put_u8(&w, AC_HEADER_LEN);
+    desc_put_u8(&w, TUSB_DESC_CS_INTERFACE);
+    desc_put_u8(&w, AUDIO_CS_AC_INTERFACE_HEADER);
+    desc_put_u16(&w, 0x0200);               // bcdADC
+    desc_put_u8(&w, UAC_SPK_CH && UAC_MIC_CH ? AUDIO_FUNC_HEADSET : (UAC_SPK_CH ? AUDIO_FUNC_DESKTOP_SPEAKER : AUDIO_FUNC_MICROPHONE));
+    desc_put_u16(&w, ac_total_len);
+    desc_put_u8(&w, 0);                     // bmControls
+
+    desc_put_u8(&w, AC_CLOCK_LEN);
+    desc_put_u8(&w, TUSB_DESC_CS_INTERFACE);
+    desc_put_u8(&w, AUDIO_CS_AC_INTERFACE_CLOCK_SOURCE);
+    desc_put_u8(&w, UAC_ENTITY_CLOCK);
+    desc_put_u8(&w, AUDIO_CLOCK_SOURCE_ATT_INT_PRO_CLK);
+    desc_put_u8(&w, (AUDIO_CTRL_RW << AUDIO_CLOCK_SOURCE_CTRL_SAM_FREQ_POS) | (AUDIO_CTRL_R << AUDIO_CLOCK_SOURCE_CTRL_CLK_VAL_POS));
+    desc_put_u8(&w, 0);                     // bAssocTerminal
+    desc_put_u8(&w, 0);                     // iClockSource
+
+#if UAC_SPK_CH
+    // Speaker: USB streaming -> feature unit with master mute and volume -> speaker
+    put_terminal_in(&w, UAC_ENTITY_SPK_IT, AUDIO_TERM_TYPE_USB_STREAMING, UAC_SPK_CH);
+    desc_put_u8(&w, AC_FU_LEN(UAC_SPK_CH));
+    desc_put_u8(&w, TUSB_DESC_CS_INTERFACE);
+    desc_put_u8(&w, AUDIO_CS_AC_INTERFACE_FEATURE_UNIT);
+    desc_put_u8(&w, UAC_ENTITY_SPK_FU);
+    desc_put_u8(&w, UAC_ENTITY_SPK_IT);     // bSourceID
+    desc_put_u32(&w, (AUDIO_CTRL_RW << AUDIO_FEATURE_UNIT_CTRL_MUTE_POS) | (AUDIO_CTRL_RW << AUDIO_FEATURE_UNIT_CTRL_VOLUME_POS));
+    for (int i = 0; i < UAC_SPK_CH; i++) {
+        desc_put_u32(&w, 0);                // bmaControls of each channel
+    }
+    desc_put_u8(&w, 0);                     // iFeature
+    put_terminal_out(&w, UAC_ENTITY_SPK_OT, AUDIO_TERM_TYPE_OUT_GENERIC_SPEAKER, UAC_ENTITY_SPK_FU);
+#endif
+#if UAC_MIC_CH
+    // Microphone -> USB streaming
+    put_terminal_in(&w, UAC_ENTITY_MIC_IT, AUDIO_TERM_TYPE_IN_GENERIC_MIC, UAC_MIC_CH);
+    put_terminal_out(&w, UAC_ENTITY_MIC_OT, AUDIO_TERM_TYPE_USB_STREAMING, UAC_ENTITY_MIC_IT);
+#endif
+
+#if UAC_SPK_CH
+    put_streaming(&w, itf_next++, UAC_ENTITY_SPK_IT, UAC_SPK_CH, ep_num, UAC_EP_SIZE(UAC_SPK_CH, hs), 0x80 | ep_num, hs);
+    ep_num++;
+#endif
+#if UAC_MIC_CH
+    put_streaming(&w, itf_next++, UAC_ENTITY_MIC_OT, UAC_MIC_CH, 0x80 | ep_num, UAC_EP_SIZE(UAC_MIC_CH, hs), 0, hs);
+#endif
+    assert(w.len == CFG_TUD_AUDIO_FUNC_1_DESC_LEN);
+    return w.len;
+}
+
+//--------------------------------------------------------------------+
+// TinyUSB audio class callbacks
+//--------------------------------------------------------------------+
+static bool is_speaker_itf(uint8_t itf)
+{
+    return UAC_SPK_CH && itf == s_uac.itf_num + 1;
+}
+
+static void stream_changed(uint8_t itf, bool active)
+{
+    const bool speaker = is_speaker_itf(itf);
+    ESP_LOGD(TAG, "%s stream %s", speaker ? "Speaker" : "Microphone", active ? "started" : "stopped");
+    if (s_uac.cfg.stream_cb) {
+        s_uac.cfg.stream_cb(speaker, active, s_uac.cfg.arg);
+    }
+}
+
+bool tud_audio_set_itf_cb(uint8_t rhport, tusb_control_request_t const *p_request)
+{
+    (void)rhport;
+    const uint8_t itf = tu_u16_low(p_request->wIndex);
+    const uint8_t alt = tu_u16_low(p_request->wValue);
+    if (alt == 0 || !s_uac.initialized) {
+        return true;
+    }
+#if UAC_SPK_CH && !FEEDBACK_PARAMS_SUPPORTED
+    if (is_speaker_itf(itf)) {
+        // Nominal samples per (micro)frame, 16.16 for HighSpeed and 10.14 for FullSpeed
+        const uint32_t fb = (tud_speed_get() == TUSB_SPEED_HIGH) ? (uint32_t)(((uint64_t)s_uac.sample_rate << 16) / 8000) :
+                            (uint32_t)(((uint64_t)s_uac.sample_rate << 14) / 1000);
+        tud_audio_fb_set(fb);
+    }
+#endif
+    stream_changed(itf, true);
+    return true;
+}
+
+bool tud_audio_set_itf_close_EP_cb(uint8_t rhport, tusb_control_request_t const *p_request)
+{
+    (void)rhport;
+    const uint8_t itf = tu_u16_low(p_request->wIndex);
+    const uint8_t alt = tu_u16_low(p_request->wValue);
+    if (alt == 0 && s_uac.initialized) {
+        stream_changed(itf, false);
+    }
+    return true;
+}
+
+#if UAC_SPK_CH && FEEDBACK_PARAMS_SUPPORTED
+void tud_audio_feedback_params_cb(uint8_t func_id, uint8_t alt_itf, audio_feedback_params_t *feedback_param)
+{
+    (void)func_id;
+    (void)alt_itf;
+    // The app drains the speaker FIFO at its I2S clock rate, so the FIFO level tracks the clock drift
+    feedback_param->method = AUDIO_FEEDBACK_METHOD_FIFO_COUNT;
+    feedback_param->sample_freq = s_uac.sample_rate;
+}
+#endif
+
+static bool clock_get_request(uint8_t rhport, tusb_control_request_t const *p_request)
+{
+    const uint8_t ctrl = tu_u16_high(p_request->wValue);
+    if (ctrl == AUDIO_CS_CTRL_SAM_FREQ && p_request->bRequest == AUDIO_CS_REQ_CUR) {
+        const uint32_t cur = s_uac.sample_rate;
+        return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, (void *)&cur, sizeof(cur));
+    }
+    if (ctrl == AUDIO_CS_CTRL_SAM_FREQ && p_request->bRequest == AUDIO_CS_REQ_RANGE) {
+        // wNumSubRanges followed by (dMIN, dMAX, dRES) of each discrete rate
+        uint8_t range[2 + TINYUSB_UAC_SAMPLE_RATES_MAX * 12];
+        desc_writer_t w = { .dst = range };
+        desc_put_u16(&w, s_uac.cfg.sample_rate_num);
+        for (int i = 0; i < s_uac.cfg.sample_rate_num; i++) {
+            desc_put_u32(&w, s_uac.sample_rates[i]);
+            desc_put_u32(&w, s_uac.sample_rates[i]);
+            desc_put_u32(&w, 0);
+        }
+        return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, range, w.len);
+    }
+    if (ctrl == AUDIO_CS_CTRL_CLK_VALID && p_request->bRequest == AUDIO_CS_REQ_CUR) {
+        const uint8_t valid = 1;
+        return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, (void *)&valid, sizeof(valid));
+    }
+    return false;
+}
+
+static bool feature_get_request(uint8_t rhport, tusb_control_request_t const *p_request)
+{
+    const uint8_t ctrl = tu_u16_high(p_request->wValue);
+    if (ctrl == AUDIO_FU_CTRL_MUTE && p_request->bRequest == AUDIO_CS_REQ_CUR) {
+        const uint8_t mute = s_uac.mute;
+        return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, (void *)&mute, sizeof(mute));
+    }
+    if (ctrl == AUDIO_FU_CTRL_VOLUME && p_request->bRequest == AUDIO_CS_REQ_CUR) {
+        const int16_t volume = s_uac.volume;
+        return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, (void *)&volume, sizeof(volume));
+    }
+    if (ctrl == AUDIO_FU_CTRL_VOLUME && p_request->bRequest == AUDIO_CS_REQ_RANGE) {
+        uint8_t range[8];
+        desc_writer_t w = { .dst = range };
+        desc_put_u16(&w, 1);
+        desc_put_u16(&w, (uint16_t)UAC_VOLUME_MIN);
+        desc_put_u16(&w, UAC_VOLUME_MAX);
+        desc_put_u16(&w, UAC_VOLUME_RES);
+        return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, range, w.len);
+    }
+    return false;
+}
+
+bool tud_audio_get_req_entity_cb(uint8_t rhport, tusb_control_request_t const *p_request)
+{
+    if (!s_uac.initialized) {
+        return false;
+    }
+    switch (tu_u16_high(p_request->wIndex)) {
+    case UAC_ENTITY_CLOCK:
+        return clock_get_request(rhport, p_request);
+    case UAC_ENTITY_SPK_FU:
+        return feature_get_request(rhport, p_request);
+    default:
+        return false;
+    }
+}
+
+bool tud_audio_set_req_entity_cb(uint8_t rhport, tusb_control_request_t const *p_request, uint8_t *buf)
+{
+    (void)rhport;
+    if (!s_uac.initialized || p_request->bRequest != AUDIO_CS_REQ_CUR) {
+        return false;
+    }
+    const uint8_t entity = tu_u16_high(p_request->wIndex);
+    const uint8_t ctrl = tu_u16_high(p_request->wValue);
+
+    if (entity == UAC_ENTITY_CLOCK && ctrl == AUDIO_CS_CTRL_SAM_FREQ && p_request->wLength == sizeof(uint32_t)) {
+        const uint32_t rate = tu_unaligned_read32(buf);
+        bool supported = false;
+        for (int i = 0; i < s_uac.cfg.sample_rate_num; i++) {
+            supported |= (s_uac.sample_rates[i] == rate);
+        }
+        if (!supported) {
+            ESP_LOGW(TAG, "Unsupported sample rate %" PRIu32, rate);
+            return false;
+        }
+        s_uac.sample_rate = rate;
+        if (s_uac.cfg.rate_cb) {
+            s_uac.cfg.rate_cb(rate, s_uac.cfg.arg);
+        }
+        return true;
+    }
+    if (entity == UAC_ENTITY_SPK_FU && (ctrl == AUDIO_FU_CTRL_MUTE || ctrl == AUDIO_FU_CTRL_VOLUME)) {
+        if (ctrl == AUDIO_FU_CTRL_MUTE && p_request->wLength == 1) {
+            s_uac.mute = buf[0];
+        } else if (ctrl == AUDIO_FU_CTRL_VOLUME && p_request->wLength == sizeof(int16_t)) {
+            s_uac.volume = (int16_t)tu_unaligned_read16(buf);
+        } else {
+            return false;
+        }
+        if (s_uac.cfg.volume_cb) {
+            s_uac.cfg.volume_cb(s_uac.mute, s_uac.volume, s_uac.cfg.arg);
+        }
+        return true;
+    }
+    return false;
+}
+
+//--------------------------------------------------------------------+
+// Public API
+//--------------------------------------------------------------------+
+uint32_t tinyusb_uac_get_sample_rate(void)
+{
+    return s_uac.sample_rate;
+}
+
+size_t tinyusb_uac_speaker_read(void *buf, size_t len)
+{
+#if UAC_SPK_CH
+    return tud_audio_read(buf, len > UINT16_MAX ? UINT16_MAX : len);
+#else
+    return 0;
+#endif
+}
+
+size_t tinyusb_uac_speaker_available(void)
+{
+#if UAC_SPK_CH
+    return tud_audio_available();
+#else
+    return 0;
+#endif
+}
+
+size_t tinyusb_uac_mic_write(const void *buf, size_t len)
+{
+#if UAC_MIC_CH
+    return tud_audio_write(buf, len > UINT16_MAX ? UINT16_MAX : len);
+#else
+    return 0;
+#endif
+}
+
+esp_err_t tinyusb_uac_init(const tinyusb_uac_config_t *config)
+{
+    ESP_RETURN_ON_FALSE(config && config->sample_rates && config->sample_rate_num, ESP_ERR_INVALID_ARG, TAG, "No sample rates");
+    ESP_RETURN_ON_FALSE(config->sample_rate_num <= TINYUSB_UAC_SAMPLE_RATES_MAX, ESP_ERR_INVALID_ARG, TAG,
+                        "Up to %d sample rates", TINYUSB_UAC_SAMPLE_RATES_MAX);
+    ESP_RETURN_ON_FALSE(!s_uac.initialized, ESP_ERR_INVALID_STATE, TAG, "Already initialized");
+    for (int i = 0; i < config->sample_rate_num; i++) {
+        ESP_RETURN_ON_FALSE(config->sample_rates[i] && config->sample_rates[i] <= CONFIG_TINYUSB_UAC_MAX_SAMPLE_RATE,
+                            ESP_ERR_INVALID_ARG, TAG, "Sample rate %" PRIu32 " above CONFIG_TINYUSB_UAC_MAX_SAMPLE_RATE", config->sample_rates[i]);
+    }
+    s_uac.cfg = *config;
+    memcpy(s_uac.sample_rates, config->sample_rates, config->sample_rate_num * sizeof(uint32_t));
+    s_uac.cfg.sample_rates = s_uac.sample_rates;
+    s_uac.sample_rate = config->sample_rates[0];
+    s_uac.mute = false;
+    s_uac.volume = UAC_VOLUME_MAX;
+    s_uac.initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t tinyusb_uac_deinit(void)
+{
+    ESP_RETURN_ON_FALSE(s_uac.initialized, ESP_ERR_INVALID_STATE, TAG, "Not initialized");
+    s_uac.initialized = false;
+    return ESP_OK;
+}
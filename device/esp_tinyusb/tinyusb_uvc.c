@@ -0,0 +1,323 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "tusb.h"
+#include "tinyusb_uvc.h"
+#include "tinyusb_uvc_private.h"
+#include "tinyusb_desc_writer.h"
+
+#define UVC_CLOCK_FREQUENCY     27000000
+#define UVC_BCD                 0x0150
+#define UVC_ENTITY_CAMERA       1
+#define UVC_ENTITY_OUTPUT       2
+#define UVC_FRAME_INTERVAL(fps) (10000000 / (fps)) // In 100 ns units
+
+typedef struct {
+    bool initialized;
+    tinyusb_uvc_config_t cfg;
+    portMUX_TYPE lock;              // Protects the statistics and the frame in progress
+    const uint8_t *frame_buf;       // Frame being sent, NULL if none
+    size_t frame_len;
+    uint32_t frames;
+    uint64_t bytes;
+    int64_t stats_start_us;
+} uvc_obj_t;
+
+static const char *TAG = "tusb_uvc";
+static uvc_obj_t s_uvc = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+//--------------------------------------------------------------------+
+// Descriptors
+//--------------------------------------------------------------------+
+// Lengths of the class specific descriptors
+#define VC_HEADER_LEN           13
+#define VC_CAMERA_TERM_LEN      18
+#define VC_OUTPUT_TERM_LEN      9
+#define VS_INPUT_HEADER_LEN     14
+#define VS_FMT_UNCOMPR_LEN      27
+#define VS_FMT_MJPEG_LEN        11
+#define VS_FRAME_LEN            30  // One discrete frame interval
+#define VS_COLOR_MATCHING_LEN   6
+
+static void put_interface(desc_writer_t *w, uint8_t itf_num, uint8_t alt, uint8_t ep_num, uint8_t subclass, uint8_t str_idx)
+{
+    desc_put_u8(w, 9);
+    desc_put_u8(w, TUSB_DESC_INTERFACE);
+    desc_put_u8(w, itf_num);
+    desc_put_u8(w, alt);
+    desc_put_u8(w, ep_num);
+    desc_put_u8(w, TUSB_CLASS_VIDEO);
+    desc_put_u8(w, subclass);
+    desc_put_u8(w, 0x01);                        // bInterfaceProtocol: PC_PROTOCOL_15
+    desc_put_u8(w, str_idx);
+}
+
+static void put_frame(desc_writer_t *w, const tinyusb_uvc_config_t *config, uint8_t idx)
+{
+    const tinyusb_uvc_frame_t *frame = &config->frames[idx];
+    const uint32_t frame_size = (uint32_t)frame->width * frame->height * 2; // YUY2 size, upper bound for MJPEG
+    const uint32_t bit_rate = frame_size * 8 * frame->fps;
+
+    desc_put_u8(w, VS_FRAME_LEN);
+    desc_put_u8(w, TUSB_DESC_CS_INTERFACE);
+    desc_put_u8(w, config->format == TINYUSB_UVC_FORMAT_MJPEG ? VIDEO_CS_ITF_VS_FRAME_MJPEG : VIDEO_CS_ITF_VS_FRAME_UNCOMPRESSED);
+    desc_put_u8(w, idx + 1);                     // bFrameIndex
+    desc_put_u8(w, 0);                           // bmCapabilities
+    desc_put_u16(w, frame->width);
+    desc_put_u16(w, frame->height);
+    desc_put_u32(w, bit_rate);                   // dwMinBitRate
+    desc_put_u32(w, bit_rate);                   // dwMaxBitRate
+    desc_put_u32(w, frame_size);                 // dwMaxVideoFrameBufferSize
+    desc_put_u32(w, UVC_FRAME_INTERVAL(frame->fps)); // dwDefaultFrameInterval
+    desc_put_u8(w, 1);                           // bFrameIntervalType: one discrete interval
+    desc_put_u32(w, UVC_FRAME_INTERVAL(frame->fps));
+}
+
+esp_err_t tinyusb_uvc_check_config(const tinyusb_uvc_config_t *config)
+{
+    ESP_RETURN_ON_FALSE(config && config->frames && config->frame_num, ESP_ERR_INVALID_ARG, TAG, "No frames");
+    ESP_RETURN_ON_FALSE(config->format == TINYUSB_UVC_FORMAT_YUY2 || config->format == TINYUSB_UVC_FORMAT_MJPEG,
+                        ESP_ERR_INVALID_ARG, TAG, "Invalid format");
+    for (int i = 0; i < config->frame_num; i++) {
+        ESP_RETURN_ON_FALSE(config->frames[i].width && config->frames[i].height && config->frames[i].fps,
+                            ESP_ERR_INVALID_ARG, TAG, "Invalid frame %d", i);
+    }
+    return ESP_OK;
+}
+
+size_t tinyusb_uvc_desc(const tinyusb_uvc_config_t *config, uint8_t itf_num, uint8_t ep_in, uint8_t str_idx, bool hs, uint8_t *dst)
+{
+    static const uint8_t guid_yuy2[16] = {
+        'Y', 'U', 'Y', '2', 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+    };
+    const bool mjpeg = (config->format == TINYUSB_UVC_FORMAT_MJPEG);
+    const size_t vs_total_len = VS_INPUT_HEADER_LEN + (mjpeg ? VS_FMT_MJPEG_LEN : VS_FMT_UNCOMPR_LEN) +
+                                config->frame_num * VS_FRAME_LEN + VS_COLOR_MATCHING_LEN;
+    desc_writer_t w = { .dst = dst };
+
+    // Interface association
+    desc_put_u8(&w, 8);
+    desc_put_u8(&w, TUSB_DESC_INTERFACE_ASSOCIATION);
+    desc_put_u8(&w, itf_num);
+    desc_put_u8(&w, 2);                          // bInterfaceCount
+    desc_put_u8(&w, TUSB_CLASS_VIDEO);
+    desc_put_u8(&w, VIDEO_SUBCLASS_INTERFACE_COLLECTION);
+    desc_put_u8(&w, 0x00);                       // bFunctionProtocol: PC_PROTOCOL_UNDEFINED
+    desc_put_u8(&w, str_idx);
+
+    // Video control: camera terminal connected to streaming output terminal
+    put_interface(&w, itf_num, 0, 0, VIDEO_SUBCLASS_CONTROL, str_idx);
+    desc_put_u8(&w, VC_HEADER_LEN);
+    desc_put_u8(&w, TUSB_DESC_CS_INTERFACE);
+    desc_put_u8(&w, VIDEO_CS_ITF_VC_HEADER);
+    desc_put_u16(&w, UVC_BCD);
+    desc_put_u16(&w, VC_HEADER_LEN + VC_CAMERA_TERM_LEN + VC_OUTPUT_TERM_LEN);
+    desc_put_u32(&w, UVC_CLOCK_FREQUENCY);
+    desc_put_u8(&w, 1);                          // bInCollection
+    desc_put_u8(&w, itf_num + 1);                // baInterfaceNr: video streaming
+
+    desc_put_u8(&w, VC_CAMERA_TERM_LEN);
+    desc_put_u8(&w, TUSB_DESC_CS_INTERFACE);
+    desc_put_u8(&w, VIDEO_CS_ITF_VC_INPUT_TERMINAL);
+    desc_put_u8(&w, UVC_ENTITY_CAMERA);
+    desc_put_u16(&w, VIDEO_ITT_CAMERA);
+    desc_put_u8(&w, 0);                          // bAssocTerminal
+    desc_put_u8(&w, 0);                          // iTerminal
+    desc_put_u16(&w, 0);                         // wObjectiveFocalLengthMin
+    desc_put_u16(&w, 0);                         // wObjectiveFocalLengthMax
+    desc_put_u16(&w, 0);                         // wOcularFocalLength
+    desc_put_u8(&w, 3);                          // bControlSize
+    desc_put_u8(&w, 0);                          // bmControls: none
+    desc_put_u16(&w, 0);
+
+    desc_put_u8(&w, VC_OUTPUT_TERM_LEN);
+    desc_put_u8(&w, TUSB_DESC_CS_INTERFACE);
+    desc_put_u8(&w, VIDEO_CS_ITF_VC_OUTPUT_TERMINAL);
+    desc_put_u8(&w, UVC_ENTITY_OUTPUT);
+    desc_put_u16(&w, VIDEO_TT_STREAMING);
+    desc_put_u8(&w, 0);                          // bAssocTerminal
+    desc_put_u8(&w, UVC_ENTITY_CAMERA);          // bSourceID
+    desc_put_u8(&w, 0);                          // iTerminal
+
+    // Video streaming, bulk endpoint is in alternate setting 0, isochronous endpoint in alternate setting 1
+    put_interface(&w, itf_num + 1, 0, CFG_TUD_VIDEO_STREAMING_BULK ? 1 : 0, VIDEO_SUBCLASS_STREAMING, str_idx);
+    desc_put_u8(&w, VS_INPUT_HEADER_LEN);
+    desc_put_u8(&w, TUSB_DESC_CS_INTERFACE);
+    desc_put_u8(&w, VIDEO_CS_ITF_VS_INPUT_HEADER);
+    desc_put_u8(&w, 1);                          // bNumFormats
+    desc_put_u16(&w, vs_total_len);
+    desc_put_u8(&w, ep_in);
+    desc_put_u8(&w, 0);                          // bmInfo
+    desc_put_u8(&w, UVC_ENTITY_OUTPUT);          // bTerminalLink
+    desc_put_u8(&w, 0);                          // bStillCaptureMethod
+    desc_put_u8(&w, 0);                          // bTriggerSupport
+    desc_put_u8(&w, 0);                          // bTriggerUsage
+    desc_put_u8(&w, 1);                          // bControlSize
+    desc_put_u8(&w, 0);                          // bmaControls
+
+    if (mjpeg) {
+        desc_put_u8(&w, VS_FMT_MJPEG_LEN);
+        desc_put_u8(&w, TUSB_DESC_CS_INTERFACE);
+        desc_put_u8(&w, VIDEO_CS_ITF_VS_FORMAT_MJPEG);
+        desc_put_u8(&w, 1);                      // bFormatIndex
+        desc_put_u8(&w, config->frame_num);
+        desc_put_u8(&w, 0);                      // bmFlags: variable size samples
+    } else {
+        desc_put_u8(&w, VS_FMT_UNCOMPR_LEN);
+        desc_put_u8(&w, TUSB_DESC_CS_INTERFACE);
+        desc_put_u8(&w, VIDEO_CS_ITF_VS_FORMAT_UNCOMPRESSED);
+        desc_put_u8(&w, 1);                      // bFormatIndex
+        desc_put_u8(&w, config->frame_num);
+        desc_put_bytes(&w, guid_yuy2, sizeof(guid_yuy2));
+        desc_put_u8(&w, 16);                     // bBitsPerPixel
+    }
+    desc_put_u8(&w, 1);                          // bDefaultFrameIndex
+    desc_put_u8(&w, 0);                          // bAspectRatioX
+    desc_put_u8(&w, 0);                          // bAspectRatioY
+    desc_put_u8(&w, 0);                          // bmInterlaceFlags
+    desc_put_u8(&w, 0);                          // bCopyProtect
+
+    for (int i = 0; i < config->frame_num; i++) {
+        put_frame(&w, config, i);
+    }
+
+    desc_put_u8(&w, VS_COLOR_MATCHING_LEN);
+    desc_put_u8(&w, TUSB_DESC_CS_INTERFACE);
+    desc_put_u8(&w, VIDEO_CS_ITF_VS_COLORFORMAT);
+    desc_put_u8(&w, VIDEO_COLOR_PRIMARIES_BT709);
+    desc_put_u8(&w, VIDEO_COLOR_XFER_CH_BT709);
+    desc_put_u8(&w, VIDEO_COLOR_COEF_SMPTE170M);
+
+#if !CFG_TUD_VIDEO_STREAMING_BULK
+    put_interface(&w, itf_num + 1, 1, 1, VIDEO_SUBCLASS_STREAMING, str_idx);
+#endif
+    desc_put_u8(&w, 7);
+    desc_put_u8(&w, TUSB_DESC_ENDPOINT);
+    desc_put_u8(&w, ep_in);
+#if CFG_TUD_VIDEO_STREAMING_BULK
+    desc_put_u8(&w, TUSB_XFER_BULK);
+    desc_put_u16(&w, hs ? 512 : 64);
+    desc_put_u8(&w, 0);                          // bInterval
+#else
+    desc_put_u8(&w, TUSB_XFER_ISOCHRONOUS | TUSB_ISO_EP_ATT_ASYNCHRONOUS);
+    desc_put_u16(&w, CFG_TUD_VIDEO_STREAMING_EP_BUFSIZE);
+    desc_put_u8(&w, 1);                          // bInterval: every (micro)frame
+#endif
+    return w.len;
+}
+
+//--------------------------------------------------------------------+
+// TinyUSB video class callbacks
+//--------------------------------------------------------------------+
+int tud_video_commit_cb(uint_fast8_t ctl_idx, uint_fast8_t stm_idx, video_probe_and_commit_control_t const *parameters)
+{
+    (void)ctl_idx;
+    (void)stm_idx;
+    if (!s_uvc.initialized || parameters->bFrameIndex == 0 || parameters->bFrameIndex > s_uvc.cfg.frame_num) {
+        return VIDEO_ERROR_OUT_OF_RANGE;
+    }
+    const tinyusb_uvc_frame_t *frame = &s_uvc.cfg.frames[parameters->bFrameIndex - 1];
+    ESP_LOGI(TAG, "Streaming %ux%u at %u fps", frame->width, frame->height, frame->fps);
+    if (s_uvc.cfg.start_cb) {
+        s_uvc.cfg.start_cb(frame, s_uvc.cfg.arg);
+    }
+    return VIDEO_ERROR_NONE;
+}
+
+void tud_video_frame_xfer_complete_cb(uint_fast8_t ctl_idx, uint_fast8_t stm_idx)
+{
+    (void)ctl_idx;
+    (void)stm_idx;
+    portENTER_CRITICAL(&s_uvc.lock);
+    const uint8_t *buf = s_uvc.frame_buf;
+    s_uvc.frames++;
+    s_uvc.bytes += s_uvc.frame_len;
+    s_uvc.frame_buf = NULL;
+    portEXIT_CRITICAL(&s_uvc.lock);
+    if (buf && s_uvc.cfg.frame_done_cb) {
+        s_uvc.cfg.frame_done_cb(buf, s_uvc.cfg.arg);
+    }
+}
+
+//--------------------------------------------------------------------+
+// Public API
+//--------------------------------------------------------------------+
+bool tinyusb_uvc_streaming(void)
+{
+    return s_uvc.initialized && tud_video_n_streaming(0, 0);
+}
+
+esp_err_t tinyusb_uvc_submit_frame(const uint8_t *buf, size_t len)
+{
+    ESP_RETURN_ON_FALSE(buf && len, ESP_ERR_INVALID_ARG, TAG, "Invalid frame");
+    ESP_RETURN_ON_FALSE(tinyusb_uvc_streaming(), ESP_ERR_INVALID_STATE, TAG, "Not streaming");
+
+    portENTER_CRITICAL(&s_uvc.lock);
+    const bool busy = (s_uvc.frame_buf != NULL);
+    if (!busy) {
+        s_uvc.frame_buf = buf;
+        s_uvc.frame_len = len;
+    }
+    portEXIT_CRITICAL(&s_uvc.lock);
+    ESP_RETURN_ON_FALSE(!busy, ESP_ERR_INVALID_STATE, TAG, "Previous frame is being sent");
+
+    // TinyUSB keeps the pointer and builds each payload from header and frame data
+    if (!tud_video_n_frame_xfer(0, 0, (void *)buf, len)) {
+        portENTER_CRITICAL(&s_uvc.lock);
+        s_uvc.frame_buf = NULL;
+        portEXIT_CRITICAL(&s_uvc.lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ESP_OK;
+}
+
+esp_err_t tinyusb_uvc_get_stats(tinyusb_uvc_stats_t *stats, bool reset)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "Stats can't be NULL");
+    const int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_uvc.lock);
+    const int64_t elapsed_us = now - s_uvc.stats_start_us;
+    stats->frames = s_uvc.frames;
+    stats->bytes = s_uvc.bytes;
+    if (reset) {
+        s_uvc.frames = 0;
+        s_uvc.bytes = 0;
+        s_uvc.stats_start_us = now;
+    }
+    portEXIT_CRITICAL(&s_uvc.lock);
+
+    stats->fps = elapsed_us > 0 ? stats->frames * 1e6f / elapsed_us : 0;
+    stats->bytes_per_sec = elapsed_us > 0 ? (uint32_t)(stats->bytes * 1000000 / elapsed_us) : 0;
+    return ESP_OK;
+}
+
+esp_err_t tinyusb_uvc_init(const tinyusb_uvc_config_t *config)
+{
+    ESP_RETURN_ON_FALSE(!s_uvc.initialized, ESP_ERR_INVALID_STATE, TAG, "Already initialized");
+    ESP_RETURN_ON_ERROR(tinyusb_uvc_check_config(config), TAG, "Invalid configuration");
+    s_uvc.cfg = *config;
+    s_uvc.frame_buf = NULL;
+    s_uvc.frames = 0;
+    s_uvc.bytes = 0;
+    s_uvc.stats_start_us = esp_timer_get_time();
+    s_uvc.initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t tinyusb_uvc_deinit(void)
+{
+    ESP_RETURN_ON_FALSE(s_uvc.initialized, ESP_ERR_INVALID_STATE, TAG, "Not initialized");
+    s_uvc.initialized = false;
+    return ESP_OK;
+}
@@ -0,0 +1,412 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "tusb.h"
+#include "tinyusb_app_driver.h"
+#include "tinyusb_vendor_stream.h"
+
+#if CONFIG_CACHE_L1_CACHE_LINE_SIZE
+// Cache synchronization of DMA buffers works on whole cache lines
+#define STREAM_BUF_ALIGN    (CONFIG_CACHE_L1_CACHE_LINE_SIZE)
+#else
+#define STREAM_BUF_ALIGN    (4)
+#endif
+#define STREAM_XFER_SIZE_MAX (65024) // usbd_edpt_xfer() transfers up to 65535 bytes, rounded down to HighSpeed bulk packets
+
+typedef enum {
+    BUF_FREE,                       // IN: waiting for tinyusb_vendor_stream_in_get_buf(), OUT: waiting for OUT transfer
+    BUF_APP,                        // Owned by the app
+    BUF_QUEUED,                     // IN only: submitted, waiting for previous transfers
+    BUF_BUSY,                       // Transfer in progress
+} buf_state_t;
+
+typedef struct {
+    uint8_t *data;
+    uint16_t len;
+    buf_state_t state;
+} stream_buf_t;
+
+typedef struct {
+    bool initialized;
+    tinyusb_vendor_stream_config_t cfg;
+    portMUX_TYPE lock;              // Protects endpoints, buffer states, the IN queue and busy flags
+    SemaphoreHandle_t in_free;      // Counts free IN buffers
+    uint8_t rhport;
+    uint8_t ep_in;                  // 0 if the interface is not configured
+    uint8_t ep_out;
+    bool in_busy;                   // IN transfer in progress or being started
+    bool out_busy;
+    uint8_t in_cur;
+    uint8_t out_cur;
+    uint8_t in_queue[TINYUSB_VENDOR_STREAM_BUF_NUM_MAX];
+    uint8_t in_queue_head;
+    uint8_t in_queue_count;
+    stream_buf_t in[TINYUSB_VENDOR_STREAM_BUF_NUM_MAX];
+    stream_buf_t out[TINYUSB_VENDOR_STREAM_BUF_NUM_MAX];
+} vendor_stream_t;
+
+static const char *TAG = "tusb_vendor_stream";
+static vendor_stream_t s_stream = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static int find_buf(const stream_buf_t *bufs, const uint8_t *data, buf_state_t state)
+{
+    for (int i = 0; i < s_stream.cfg.buf_num; i++) {
+        if (bufs[i].data == data && bufs[i].state == state) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+//--------------------------------------------------------------------+
+// IN
+//--------------------------------------------------------------------+
+static void in_complete(uint8_t idx, size_t len)
+{
+    portENTER_CRITICAL(&s_stream.lock);
+    s_stream.in[idx].state = BUF_FREE;
+    portEXIT_CRITICAL(&s_stream.lock);
+    xSemaphoreGive(s_stream.in_free);
+    if (s_stream.cfg.in_done_cb) {
+        s_stream.cfg.in_done_cb(s_stream.in[idx].data, len, s_stream.cfg.arg);
+    }
+}
+
+/**
+ * @brief Start transfer of the first queued IN buffer
+ *
+ * Called only by the owner of in_busy: the submitter which set it or the completion of the previous transfer.
+ */
+static void in_start_next(void)
+{
+    while (true) {
+        portENTER_CRITICAL(&s_stream.lock);
+        if (s_stream.in_queue_count == 0 || s_stream.ep_in == 0) {
+            s_stream.in_busy = false;
+            portEXIT_CRITICAL(&s_stream.lock);
+            return;
+        }
+        const uint8_t idx = s_stream.in_queue[s_stream.in_queue_head];
+        s_stream.in_queue_head = (s_stream.in_queue_head + 1) % s_stream.cfg.buf_num;
+        s_stream.in_queue_count--;
+        s_stream.in[idx].state = BUF_BUSY;
+        s_stream.in_cur = idx;
+        const uint8_t ep_in = s_stream.ep_in;
+        portEXIT_CRITICAL(&s_stream.lock);
+
+        if (usbd_edpt_xfer(s_stream.rhport, ep_in, s_stream.in[idx].data, s_stream.in[idx].len)) {
+            return;
+        }
+        ESP_LOGW(TAG, "IN transfer not started");
+        in_complete(idx, 0);
+    }
+}
+
+uint8_t *tinyusb_vendor_stream_in_get_buf(TickType_t timeout_ticks)
+{
+    if (!s_stream.initialized || xSemaphoreTake(s_stream.in_free, timeout_ticks) != pdTRUE) {
+        return NULL;
+    }
+    uint8_t *data = NULL;
+    portENTER_CRITICAL(&s_stream.lock);
+    for (int i = 0; i < s_stream.cfg.buf_num; i++) {
+        if (s_stream.in[i].state == BUF_FREE) {
+            s_stream.in[i].state = BUF_APP;
+            data = s_stream.in[i].data;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_stream.lock);
+    return data;
+}
+
+esp_err_t tinyusb_vendor_stream_in_submit(uint8_t *buf, size_t len)
+{
+    ESP_RETURN_ON_FALSE(s_stream.initialized, ESP_ERR_INVALID_STATE, TAG, "Not initialized");
+    ESP_RETURN_ON_FALSE(len && len <= s_stream.cfg.xfer_size, ESP_ERR_INVALID_ARG, TAG, "Invalid length");
+
+    portENTER_CRITICAL(&s_stream.lock);
+    const int idx = find_buf(s_stream.in, buf, BUF_APP);
+    if (idx < 0) {
+        portEXIT_CRITICAL(&s_stream.lock);
+        ESP_LOGE(TAG, "Not an IN buffer owned by the app");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_stream.ep_in == 0) {
+        s_stream.in[idx].state = BUF_FREE;
+        portEXIT_CRITICAL(&s_stream.lock);
+        xSemaphoreGive(s_stream.in_free);
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_stream.in[idx].len = len;
+    s_stream.in[idx].state = BUF_QUEUED;
+    s_stream.in_queue[(s_stream.in_queue_head + s_stream.in_queue_count) % s_stream.cfg.buf_num] = idx;
+    s_stream.in_queue_count++;
+    const bool start = !s_stream.in_busy;
+    s_stream.in_busy = true;
+    portEXIT_CRITICAL(&s_stream.lock);
+
+    if (start) {
+        in_start_next();
+    }
+    return ESP_OK;
+}
+
+//--------------------------------------------------------------------+
+// OUT
+//--------------------------------------------------------------------+
+static void out_arm(void)
+{
+    portENTER_CRITICAL(&s_stream.lock);
+    if (s_stream.out_busy || s_stream.ep_out == 0) {
+        portEXIT_CRITICAL(&s_stream.lock);
+        return;
+    }
+    int free_idx = -1;
+    for (int i = 0; i < s_stream.cfg.buf_num; i++) {
+        if (s_stream.out[i].state == BUF_FREE) {
+            free_idx = i;
+            break;
+        }
+    }
+    if (free_idx < 0) {
+        portEXIT_CRITICAL(&s_stream.lock);
+        return; // Re-armed by tinyusb_vendor_stream_out_release()
+    }
+    s_stream.out[free_idx].state = BUF_BUSY;
+    s_stream.out_busy = true;
+    s_stream.out_cur = free_idx;
+    const uint8_t ep_out = s_stream.ep_out;
+    portEXIT_CRITICAL(&s_stream.lock);
+
+    if (!usbd_edpt_xfer(s_stream.rhport, ep_out, s_stream.out[free_idx].data, s_stream.cfg.xfer_size)) {
+        ESP_LOGW(TAG, "OUT transfer not started");
+        portENTER_CRITICAL(&s_stream.lock);
+        s_stream.out[free_idx].state = BUF_FREE;
+        s_stream.out_busy = false;
+        portEXIT_CRITICAL(&s_stream.lock);
+    }
+}
+
+esp_err_t tinyusb_vendor_stream_out_release(uint8_t *buf)
+{
+    ESP_RETURN_ON_FALSE(s_stream.initialized, ESP_ERR_INVALID_STATE, TAG, "Not initialized");
+    portENTER_CRITICAL(&s_stream.lock);
+    const int idx = find_buf(s_stream.out, buf, BUF_APP);
+    if (idx >= 0) {
+        s_stream.out[idx].state = BUF_FREE;
+    }
+    portEXIT_CRITICAL(&s_stream.lock);
+    ESP_RETURN_ON_FALSE(idx >= 0, ESP_ERR_INVALID_ARG, TAG, "Not an OUT buffer owned by the app");
+    out_arm();
+    return ESP_OK;
+}
+
+//--------------------------------------------------------------------+
+// Class driver
+//--------------------------------------------------------------------+
+static void stream_init(void)
+{
+}
+
+#if (TUSB_VERSION_MAJOR > 0 || TUSB_VERSION_MINOR >= 17)
+static bool stream_deinit(void)
+{
+    return true;
+}
+#endif
+
+static void stream_reset(uint8_t rhport)
+{
+    (void)rhport;
+    bool dropped[TINYUSB_VENDOR_STREAM_BUF_NUM_MAX] = { false };
+
+    // Endpoints are closed: drop queued and sent IN buffers, return the receiving OUT buffer
+    portENTER_CRITICAL(&s_stream.lock);
+    s_stream.ep_in = 0;
+    s_stream.ep_out = 0;
+    for (int i = 0; i < s_stream.cfg.buf_num; i++) {
+        if (s_stream.in[i].state == BUF_QUEUED || s_stream.in[i].state == BUF_BUSY) {
+            s_stream.in[i].state = BUF_APP; // in_complete() frees it
+            dropped[i] = true;
+        }
+        if (s_stream.out[i].state == BUF_BUSY) {
+            s_stream.out[i].state = BUF_FREE;
+        }
+    }
+    s_stream.in_queue_count = 0;
+    s_stream.in_busy = false;
+    s_stream.out_busy = false;
+    portEXIT_CRITICAL(&s_stream.lock);
+
+    for (int i = 0; i < s_stream.cfg.buf_num; i++) {
+        if (dropped[i]) {
+            in_complete(i, 0);
+        }
+    }
+}
+
+static uint16_t stream_open(uint8_t rhport, tusb_desc_interface_t const *desc_itf, uint16_t max_len)
+{
+    if (!s_stream.initialized ||
+            desc_itf->bInterfaceClass != TUSB_CLASS_VENDOR_SPECIFIC ||
+            desc_itf->bInterfaceNumber != s_stream.cfg.itf) {
+        return 0; // Not our interface, let other drivers open it
+    }
+
+    const uint8_t *p_desc = (const uint8_t *)desc_itf;
+    const uint8_t *desc_end = p_desc + max_len;
+    p_desc = tu_desc_next(p_desc);
+    uint8_t ep_in = 0;
+    uint8_t ep_out = 0;
+    uint8_t found = 0;
+    while (found < desc_itf->bNumEndpoints && p_desc < desc_end) {
+        if (tu_desc_type(p_desc) == TUSB_DESC_ENDPOINT) {
+            const tusb_desc_endpoint_t *desc_ep = (const tusb_desc_endpoint_t *)p_desc;
+            const uint16_t mps = tu_edpt_packet_size(desc_ep);
+            if (desc_ep->bmAttributes.xfer != TUSB_XFER_BULK || s_stream.cfg.xfer_size % mps) {
+                ESP_LOGE(TAG, "Endpoint 0x%02x must be bulk with transfer size multiple of %u", desc_ep->bEndpointAddress, mps);
+                return 0;
+            }
+            TU_ASSERT(usbd_edpt_open(rhport, desc_ep), 0);
+            if (tu_edpt_dir(desc_ep->bEndpointAddress) == TUSB_DIR_IN) {
+                ep_in = desc_ep->bEndpointAddress;
+            } else {
+                ep_out = desc_ep->bEndpointAddress;
+            }
+            found++;
+        }
+        p_desc = tu_desc_next(p_desc);
+    }
+    if (ep_out && s_stream.cfg.out_cb == NULL) {
+        ESP_LOGW(TAG, "Interface %u has OUT endpoint, but out_cb is not set", s_stream.cfg.itf);
+        ep_out = 0;
+    }
+
+    portENTER_CRITICAL(&s_stream.lock);
+    s_stream.rhport = rhport;
+    s_stream.ep_in = ep_in;
+    s_stream.ep_out = ep_out;
+    portEXIT_CRITICAL(&s_stream.lock);
+    out_arm();
+    return (uint16_t)(p_desc - (const uint8_t *)desc_itf);
+}
+
+static bool stream_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const *request)
+{
+    (void)rhport;
+    (void)stage;
+    (void)request;
+    return false; // Stall class and vendor requests to the interface
+}
+
+static bool stream_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
+{
+    (void)rhport;
+    if (result != XFER_RESULT_SUCCESS) {
+        ESP_LOGW(TAG, "Transfer on endpoint 0x%02x failed (%d)", ep_addr, result);
+        xferred_bytes = 0;
+    }
+    if (ep_addr == s_stream.ep_in) {
+        in_complete(s_stream.in_cur, xferred_bytes);
+        in_start_next();
+    } else if (ep_addr == s_stream.ep_out) {
+        const uint8_t idx = s_stream.out_cur;
+        portENTER_CRITICAL(&s_stream.lock);
+        s_stream.out[idx].state = BUF_APP;
+        s_stream.out_busy = false;
+        portEXIT_CRITICAL(&s_stream.lock);
+        // Receive to the other buffer while the app processes this one
+        out_arm();
+        if (xferred_bytes) {
+            s_stream.cfg.out_cb(s_stream.out[idx].data, xferred_bytes, s_stream.cfg.arg);
+        } else {
+            tinyusb_vendor_stream_out_release(s_stream.out[idx].data);
+        }
+    }
+    return true;
+}
+
+const usbd_class_driver_t tinyusb_vendor_stream_driver = {
+#if CFG_TUSB_DEBUG >= 2
+    .name = "VENDOR_STREAM",
+#endif
+    .init = stream_init,
+#if (TUSB_VERSION_MAJOR > 0 || TUSB_VERSION_MINOR >= 17)
+    .deinit = stream_deinit,
+#endif
+    .reset = stream_reset,
+    .open = stream_open,
+    .control_xfer_cb = stream_control_xfer_cb,
+    .xfer_cb = stream_xfer_cb,
+};
+
+//--------------------------------------------------------------------+
+// Init
+//--------------------------------------------------------------------+
+static void free_bufs(void)
+{
+    for (int i = 0; i < TINYUSB_VENDOR_STREAM_BUF_NUM_MAX; i++) {
+        heap_caps_free(s_stream.in[i].data);
+        heap_caps_free(s_stream.out[i].data);
+    }
+    if (s_stream.in_free) {
+        vSemaphoreDelete(s_stream.in_free);
+    }
+    memset(s_stream.in, 0, sizeof(s_stream.in));
+    memset(s_stream.out, 0, sizeof(s_stream.out));
+    s_stream.in_free = NULL;
+}
+
+esp_err_t tinyusb_vendor_stream_init(const tinyusb_vendor_stream_config_t *config)
+{
+    ESP_RETURN_ON_FALSE(config, ESP_ERR_INVALID_ARG, TAG, "Config can't be NULL");
+    ESP_RETURN_ON_FALSE(!s_stream.initialized, ESP_ERR_INVALID_STATE, TAG, "Already initialized");
+    ESP_RETURN_ON_FALSE(config->buf_num && config->buf_num <= TINYUSB_VENDOR_STREAM_BUF_NUM_MAX,
+                        ESP_ERR_INVALID_ARG, TAG, "Number of buffers must be 1..%d", TINYUSB_VENDOR_STREAM_BUF_NUM_MAX);
+    ESP_RETURN_ON_FALSE(config->xfer_size && config->xfer_size <= STREAM_XFER_SIZE_MAX && config->xfer_size % 64 == 0,
+                        ESP_ERR_INVALID_ARG, TAG, "Transfer size must be multiple of 64 up to %d bytes", STREAM_XFER_SIZE_MAX);
+
+    s_stream.cfg = *config;
+    s_stream.in_free = xSemaphoreCreateCounting(config->buf_num, config->buf_num);
+    ESP_RETURN_ON_FALSE(s_stream.in_free, ESP_ERR_NO_MEM, TAG, "Not enough memory for semaphore");
+    // Buffers are used by USB DMA directly
+    const size_t size = (config->xfer_size + STREAM_BUF_ALIGN - 1) & ~(STREAM_BUF_ALIGN - 1);
+    for (int i = 0; i < config->buf_num; i++) {
+        s_stream.in[i].data = heap_caps_aligned_alloc(STREAM_BUF_ALIGN, size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        s_stream.out[i].data = heap_caps_aligned_alloc(STREAM_BUF_ALIGN, size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        if (s_stream.in[i].data == NULL || s_stream.out[i].data == NULL) {
+            free_bufs();
+            ESP_LOGE(TAG, "Not enough memory for buffers");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    s_stream.ep_in = 0;
+    s_stream.ep_out = 0;
+    s_stream.in_busy = false;
+    s_stream.out_busy = false;
+    s_stream.in_queue_head = 0;
+    s_stream.in_queue_count = 0;
+    s_stream.initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t tinyusb_vendor_stream_deinit(void)
+{
+    ESP_RETURN_ON_FALSE(s_stream.initialized, ESP_ERR_INVALID_STATE, TAG, "Not initialized");
+    ESP_RETURN_ON_FALSE(s_stream.ep_in == 0 && s_stream.ep_out == 0, ESP_ERR_INVALID_STATE, TAG, "Interface is configured");
+    s_stream.initialized = false;
+    free_bufs();
+    return ESP_OK;
+}
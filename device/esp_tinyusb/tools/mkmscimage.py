@@ -0,0 +1,64 @@
+#!/usr/bin/env python
+#
+# SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""
+Create compressed image for tinyusb_msc_storage_add_lun_image() from a raw disk image.
+
+Example:
+    mkmscimage.py --block-size 4096 disk.img disk.mscz
+"""
+
+import argparse
+import struct
+import zlib
+
+MAGIC = 0x5A43534D  # "MSCZ"
+VERSION = 1
+HEADER = '<IHHIII'
+
+
+def compress_block(block: bytes) -> bytes:
+    # Raw deflate without zlib header, as expected by ROM inflate
+    compressor = zlib.compressobj(9, zlib.DEFLATED, -15)
+    data = compressor.compress(block) + compressor.flush()
+    return data if len(data) < len(block) else block
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('input', help='Raw disk image, e.g. FAT image')
+    parser.add_argument('output', help='Compressed image')
+    parser.add_argument('--sector-size', type=int, default=512, help='Sector size reported to the host (default 512)')
+    parser.add_argument('--block-size', type=int, default=4096,
+                        help='Size of independently compressed blocks, multiple of the sector size (default 4096)')
+    args = parser.parse_args()
+
+    if args.block_size % args.sector_size:
+        parser.error('block size must be a multiple of the sector size')
+    with open(args.input, 'rb') as f:
+        disk = f.read()
+    if len(disk) % args.sector_size:
+        parser.error('disk image size must be a multiple of the sector size')
+
+    blocks = [compress_block(disk[i:i + args.block_size]) for i in range(0, len(disk), args.block_size)]
+    header = struct.pack(HEADER, MAGIC, VERSION, args.sector_size, len(disk) // args.sector_size, args.block_size, len(blocks))
+    offset = len(header) + (len(blocks) + 1) * 4
+    offsets = []
+    for block in blocks:
+        offsets.append(offset)
+        offset += len(block)
+    offsets.append(offset)
+
+    with open(args.output, 'wb') as f:
+        f.write(header)
+        f.write(struct.pack('<%dI' % len(offsets), *offsets))
+        for block in blocks:
+            f.write(block)
+    print('{}: {} bytes -> {} bytes, {} blocks'.format(args.output, len(disk), offset, len(blocks)))
+
+
+if __name__ == '__main__':
+    main()
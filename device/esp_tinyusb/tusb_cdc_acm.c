@@ -5,13 +5,17 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 #include "esp_check.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "tusb.h"
 #include "tusb_cdc_acm.h"
+#include "tusb_cdc_acm_private.h"
 #include "cdc.h"
 #include "sdkconfig.h"
 
@@ -24,11 +28,30 @@ static portMUX_TYPE cdc_acm_lock = portMUX_INITIALIZER_UNLOCKED;
 #define CDC_ACM_ENTER_CRITICAL()   portENTER_CRITICAL(&cdc_acm_lock)
 #define CDC_ACM_EXIT_CRITICAL()    portEXIT_CRITICAL(&cdc_acm_lock)
 
+/**
+ * @brief Buffer extending TinyUSB FIFO of one direction, sized per port at runtime
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t size;                    /*!< 0 if the port uses TinyUSB FIFO only */
+    size_t head;
+    size_t count;
+    SemaphoreHandle_t mutex;        /*!< Taken by TinyUSB task too, TinyUSB FIFO calls can't be made in a critical section */
+} cdcacm_ring_t;
+
 typedef struct {
     tusb_cdcacm_callback_t callback_rx;
     tusb_cdcacm_callback_t callback_rx_wanted_char;
     tusb_cdcacm_callback_t callback_line_state_changed;
     tusb_cdcacm_callback_t callback_line_coding_changed;
+    SemaphoreHandle_t rx_sem;       /*!< Given on each reception, wakes up blocking readers */
+    SemaphoreHandle_t tx_done_sem;  /*!< Given on each completed IN transfer, wakes up flush */
+    tinyusb_cdcacm_io_cb_t io_cb;   /*!< Invoked after reception and completed IN transfer, wakes up VFS select() */
+    cdcacm_ring_t rx;               /*!< Filled from TinyUSB RX FIFO, read before it */
+    cdcacm_ring_t tx;               /*!< Written when TinyUSB TX FIFO is full, drained to it on each IN transfer */
+    tinyusb_cdcacm_framing_config_t framing; /*!< Framed receive, disabled if frame_cb is NULL */
+    uint8_t *frame_buf;             /*!< Message wrapped in the RX buffer, or read from TinyUSB FIFO without RX buffer */
+    size_t frame_len;               /*!< Bytes in frame_buf read from TinyUSB FIFO */
 } esp_tusb_cdcacm_t; /*!< CDC_ACM object */
 
 static const char *TAG = "tusb_cdc_acm";
@@ -42,6 +65,327 @@ static inline esp_tusb_cdcacm_t *get_acm(tinyusb_cdcacm_itf_t itf)
     return (esp_tusb_cdcacm_t *)(cdc_inst->subclass_obj);
 }
 
+/* Port buffers
+   ********************************************************************* */
+
+/**
+ * @brief Move data from TinyUSB RX FIFO to the RX buffer, so TinyUSB can receive the next packets
+ *
+ * Must be called with rx.mutex taken.
+ */
+static void rx_fill(int itf, cdcacm_ring_t *rx)
+{
+    while (rx->count < rx->size && tud_cdc_n_available(itf)) {
+        const size_t tail = (rx->head + rx->count) % rx->size;
+        const size_t n = tud_cdc_n_read(itf, rx->buf + tail, MIN(rx->size - rx->count, rx->size - tail));
+        if (n == 0) {
+            break;
+        }
+        rx->count += n;
+    }
+}
+
+static size_t rx_read(int itf, esp_tusb_cdcacm_t *acm, uint8_t *out_buf, size_t out_buf_sz)
+{
+    cdcacm_ring_t *rx = &acm->rx;
+    if (rx->size == 0) {
+        return tud_cdc_n_read(itf, out_buf, out_buf_sz);
+    }
+    size_t read = 0;
+    xSemaphoreTake(rx->mutex, portMAX_DELAY);
+    rx_fill(itf, rx);
+    while (read < out_buf_sz && rx->count) {
+        const size_t n = MIN(MIN(out_buf_sz - read, rx->count), rx->size - rx->head);
+        memcpy(out_buf + read, rx->buf + rx->head, n);
+        rx->head = (rx->head + n) % rx->size;
+        rx->count -= n;
+        read += n;
+    }
+    rx_fill(itf, rx);
+    xSemaphoreGive(rx->mutex);
+    return read;
+}
+
+static size_t rx_available(int itf, esp_tusb_cdcacm_t *acm)
+{
+    // TinyUSB FIFO is checked without the mutex, reading count alone is atomic
+    return acm->rx.count + tud_cdc_n_available(itf);
+}
+
+/**
+ * @brief Move data from the TX buffer to TinyUSB TX FIFO
+ *
+ * Must be called with tx.mutex taken.
+ */
+static void tx_drain(int itf, cdcacm_ring_t *tx)
+{
+    while (tx->count) {
+        const size_t n = tud_cdc_n_write(itf, tx->buf + tx->head, MIN(tx->count, tx->size - tx->head));
+        if (n == 0) {
+            break;
+        }
+        tx->head = (tx->head + n) % tx->size;
+        tx->count -= n;
+    }
+}
+
+static size_t tx_write(int itf, esp_tusb_cdcacm_t *acm, const uint8_t *in_buf, size_t in_size)
+{
+    cdcacm_ring_t *tx = &acm->tx;
+    if (tx->size == 0) {
+        return tud_cdc_n_write(itf, in_buf, MIN(in_size, tud_cdc_n_write_available(itf)));
+    }
+    size_t written = 0;
+    xSemaphoreTake(tx->mutex, portMAX_DELAY);
+    tx_drain(itf, tx);
+    if (tx->count == 0) {
+        // Keep the order: TinyUSB FIFO directly only when nothing waits in the buffer
+        written = tud_cdc_n_write(itf, in_buf, MIN(in_size, tud_cdc_n_write_available(itf)));
+    }
+    while (written < in_size && tx->count < tx->size) {
+        const size_t tail = (tx->head + tx->count) % tx->size;
+        const size_t n = MIN(MIN(in_size - written, tx->size - tx->count), tx->size - tail);
+        memcpy(tx->buf + tail, in_buf + written, n);
+        tx->count += n;
+        written += n;
+    }
+    xSemaphoreGive(tx->mutex);
+    return written;
+}
+
+static void tx_flush(int itf, esp_tusb_cdcacm_t *acm)
+{
+    if (acm->tx.size) {
+        xSemaphoreTake(acm->tx.mutex, portMAX_DELAY);
+        tx_drain(itf, &acm->tx);
+        xSemaphoreGive(acm->tx.mutex);
+    }
+    tud_cdc_n_write_flush(itf);
+}
+
+static size_t tx_occupied(int itf, esp_tusb_cdcacm_t *acm)
+{
+    return acm->tx.count + CFG_TUD_CDC_TX_BUFSIZE - tud_cdc_n_write_available(itf);
+}
+
+/*********************************************************************** Port buffers*/
+/* Framed receive
+   ********************************************************************* */
+
+/**
+ * @brief Pass messages in the RX buffer to frame_cb and remove them
+ *
+ * Contiguous messages are passed in place, only a message wrapping around the end of the buffer is copied.
+ */
+static void frame_from_ring(int itf, esp_tusb_cdcacm_t *acm)
+{
+    cdcacm_ring_t *rx = &acm->rx;
+    const tinyusb_cdcacm_framing_config_t *framing = &acm->framing;
+    xSemaphoreTake(rx->mutex, portMAX_DELAY);
+    rx_fill(itf, rx);
+    while (rx->count) {
+        // Search the part up to the end of the buffer, then the wrapped part
+        const size_t first = MIN(rx->count, rx->size - rx->head);
+        const uint8_t *delim = memchr(rx->buf + rx->head, framing->delimiter, first);
+        size_t len = delim ? (size_t)(delim - (rx->buf + rx->head)) + 1 : 0;
+        if (delim == NULL && first < rx->count) {
+            delim = memchr(rx->buf, framing->delimiter, rx->count - first);
+            len = delim ? first + (size_t)(delim - rx->buf) + 1 : 0;
+        }
+        const bool truncated = (delim == NULL || len > framing->max_len);
+        if (truncated) {
+            if (rx->count < framing->max_len) {
+                break; // Wait for the rest of the message
+            }
+            len = framing->max_len;
+        }
+        if (len <= first) {
+            framing->frame_cb(itf, rx->buf + rx->head, len, truncated, framing->arg);
+        } else {
+            memcpy(acm->frame_buf, rx->buf + rx->head, first);
+            memcpy(acm->frame_buf + first, rx->buf, len - first);
+            framing->frame_cb(itf, acm->frame_buf, len, truncated, framing->arg);
+        }
+        rx->head = (rx->head + len) % rx->size;
+        rx->count -= len;
+        rx_fill(itf, rx);
+    }
+    xSemaphoreGive(rx->mutex);
+}
+
+/**
+ * @brief Assemble messages from TinyUSB FIFO in frame_buf and pass them to frame_cb
+ */
+static void frame_from_fifo(int itf, esp_tusb_cdcacm_t *acm)
+{
+    const tinyusb_cdcacm_framing_config_t *framing = &acm->framing;
+    size_t searched = acm->frame_len; // Kept bytes do not contain the delimiter
+    while (true) {
+        acm->frame_len += tud_cdc_n_read(itf, acm->frame_buf + acm->frame_len, framing->max_len - acm->frame_len);
+        if (acm->frame_len == 0) {
+            break;
+        }
+        const uint8_t *delim = memchr(acm->frame_buf + searched, framing->delimiter, acm->frame_len - searched);
+        const bool truncated = (delim == NULL);
+        if (truncated && acm->frame_len < framing->max_len) {
+            break; // Wait for the rest of the message
+        }
+        const size_t len = truncated ? acm->frame_len : (size_t)(delim - acm->frame_buf) + 1;
+        framing->frame_cb(itf, acm->frame_buf, len, truncated, framing->arg);
+        acm->frame_len -= len;
+        memmove(acm->frame_buf, acm->frame_buf + len, acm->frame_len);
+        searched = 0;
+    }
+}
+
+static void frame_process(int itf, esp_tusb_cdcacm_t *acm)
+{
+    if (acm->rx.size) {
+        frame_from_ring(itf, acm);
+    } else {
+        frame_from_fifo(itf, acm);
+    }
+}
+
+/*********************************************************************** Framed receive*/
+
+static tusb_cdcacm_callback_t get_callback(esp_tusb_cdcacm_t *acm, cdcacm_event_type_t event_type)
+{
+    tusb_cdcacm_callback_t cb = NULL;
+    CDC_ACM_ENTER_CRITICAL();
+    switch (event_type) {
+    case CDC_EVENT_RX:
+        cb = acm->callback_rx;
+        break;
+    case CDC_EVENT_RX_WANTED_CHAR:
+        cb = acm->callback_rx_wanted_char;
+        break;
+    case CDC_EVENT_LINE_STATE_CHANGED:
+        cb = acm->callback_line_state_changed;
+        break;
+    case CDC_EVENT_LINE_CODING_CHANGED:
+        cb = acm->callback_line_coding_changed;
+        break;
+    default:
+        break;
+    }
+    CDC_ACM_EXIT_CRITICAL();
+    return cb;
+}
+
+#if CONFIG_TINYUSB_CDC_EVENT_TASK
+#define CDCACM_EVENT_ITF_FLUSH (-1) // Marker item, the task notifies s_event_task_stopper when it gets it
+
+typedef struct {
+    int itf;                        // TINYUSB_CDC_ACM_MAX stops the task, CDCACM_EVENT_ITF_FLUSH flushes it
+    cdcacm_event_t event;
+    cdc_line_coding_t line_coding;  // Copy of the line coding, the event points to it
+} cdcacm_event_item_t;
+
+static QueueHandle_t s_event_queue;
+static TaskHandle_t s_event_task;
+static TaskHandle_t s_event_task_stopper;
+static int s_event_task_users;      // Number of initialized CDC-ACM interfaces
+
+/**
+ * @brief Task calling CDC-ACM callbacks of the application, so they do not block TinyUSB task
+ */
+static void cdcacm_event_task(void *arg)
+{
+    (void) arg;
+    cdcacm_event_item_t item;
+    while (xQueueReceive(s_event_queue, &item, portMAX_DELAY) == pdTRUE && item.itf != TINYUSB_CDC_ACM_MAX) {
+        if (item.itf == CDCACM_EVENT_ITF_FLUSH) {
+            xTaskNotifyGive(s_event_task_stopper);
+            continue;
+        }
+        // The callback could be unregistered since the event was queued
+        esp_tusb_cdcacm_t *acm = get_acm(item.itf);
+        tusb_cdcacm_callback_t cb = acm ? get_callback(acm, item.event.type) : NULL;
+        if (cb) {
+            if (item.event.type == CDC_EVENT_LINE_CODING_CHANGED) {
+                item.event.line_coding_changed_data.p_line_coding = &item.line_coding;
+            }
+            cb(item.itf, &item.event);
+        }
+    }
+    xTaskNotifyGive(s_event_task_stopper);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t cdcacm_event_task_start(void)
+{
+    if (s_event_task_users++ > 0) {
+        return ESP_OK;
+    }
+    s_event_queue = xQueueCreate(CONFIG_TINYUSB_CDC_EVENT_QUEUE_SIZE, sizeof(cdcacm_event_item_t));
+    if (s_event_queue == NULL) {
+        goto fail;
+    }
+    if (xTaskCreate(cdcacm_event_task, "TinyUSB CDC", CONFIG_TINYUSB_CDC_EVENT_TASK_STACK_SIZE, NULL,
+                    CONFIG_TINYUSB_CDC_EVENT_TASK_PRIORITY, &s_event_task) != pdPASS) {
+        vQueueDelete(s_event_queue);
+        goto fail;
+    }
+    return ESP_OK;
+fail:
+    s_event_queue = NULL;
+    s_event_task_users--;
+    return ESP_ERR_NO_MEM;
+}
+
+/**
+ * @brief Release the task by a deinitialized interface
+ *
+ * Returns after the task finished the queued events and the callback in progress, so none of them uses the object
+ * of the interface. The task is stopped with the last interface.
+ */
+static void cdcacm_event_task_stop(void)
+{
+    if (s_event_task_users == 0) {
+        return;
+    }
+    const bool last = --s_event_task_users == 0;
+    const cdcacm_event_item_t marker = {
+        .itf = last ? TINYUSB_CDC_ACM_MAX : CDCACM_EVENT_ITF_FLUSH,
+    };
+    s_event_task_stopper = xTaskGetCurrentTaskHandle();
+    xQueueSend(s_event_queue, &marker, portMAX_DELAY);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (last) {
+        vQueueDelete(s_event_queue);
+        s_event_queue = NULL;
+        s_event_task = NULL;
+    }
+}
+#endif // CONFIG_TINYUSB_CDC_EVENT_TASK
+
+/**
+ * @brief Pass the event to the application callback, directly or through the CDC-ACM callback task
+ */
+static void cdcacm_dispatch(int itf, const cdcacm_event_t *event)
+{
+    esp_tusb_cdcacm_t *acm = get_acm(itf);
+    // The interface could be detached by tusb_cdc_acm_deinit() since the TinyUSB callback got it
+    tusb_cdcacm_callback_t cb = acm ? get_callback(acm, event->type) : NULL;
+    if (cb == NULL) {
+        return;
+    }
+#if CONFIG_TINYUSB_CDC_EVENT_TASK
+    cdcacm_event_item_t item = {
+        .itf = itf,
+        .event = *event,
+    };
+    if (event->type == CDC_EVENT_LINE_CODING_CHANGED) {
+        item.line_coding = *event->line_coding_changed_data.p_line_coding;
+    }
+    if (xQueueSend(s_event_queue, &item, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "CDC-ACM event queue is full, event %d of CDC no.%d dropped", event->type, itf);
+    }
+#else
+    cb(itf, (cdcacm_event_t *)event);
+#endif // CONFIG_TINYUSB_CDC_EVENT_TASK
+}
 
 /* TinyUSB callbacks
    ********************************************************************* */
@@ -65,19 +409,14 @@ void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts)
         }
     }
     if (acm) {
-        CDC_ACM_ENTER_CRITICAL();
-        tusb_cdcacm_callback_t cb = acm->callback_line_state_changed;
-        CDC_ACM_EXIT_CRITICAL();
-        if (cb) {
-            cdcacm_event_t event = {
-                .type = CDC_EVENT_LINE_STATE_CHANGED,
-                .line_state_changed_data = {
-                    .dtr = dtr,
-                    .rts = rts
-                }
-            };
-            cb(itf, &event);
-        }
+        cdcacm_event_t event = {
+            .type = CDC_EVENT_LINE_STATE_CHANGED,
+            .line_state_changed_data = {
+                .dtr = dtr,
+                .rts = rts
+            }
+        };
+        cdcacm_dispatch(itf, &event);
     }
 }
 
@@ -86,14 +425,40 @@ void tud_cdc_rx_cb(uint8_t itf)
 {
     esp_tusb_cdcacm_t *acm = get_acm(itf);
     if (acm) {
-        CDC_ACM_ENTER_CRITICAL();
-        tusb_cdcacm_callback_t cb = acm->callback_rx;
-        CDC_ACM_EXIT_CRITICAL();
-        if (cb) {
-            cdcacm_event_t event = {
-                .type = CDC_EVENT_RX
-            };
-            cb(itf, &event);
+        if (acm->rx.size) {
+            xSemaphoreTake(acm->rx.mutex, portMAX_DELAY);
+            rx_fill(itf, &acm->rx);
+            xSemaphoreGive(acm->rx.mutex);
+        }
+        // The RX buffer is searched when the delimiter arrives, here only for messages longer than max_len
+        if (acm->framing.frame_cb && (acm->rx.size == 0 || rx_available(itf, acm) >= acm->framing.max_len)) {
+            frame_process(itf, acm);
+        }
+        xSemaphoreGive(acm->rx_sem);
+        if (acm->io_cb) {
+            acm->io_cb(itf);
+        }
+        cdcacm_event_t event = {
+            .type = CDC_EVENT_RX
+        };
+        cdcacm_dispatch(itf, &event);
+    }
+}
+
+/* Invoked when IN transfer of CDC interface completed */
+void tud_cdc_tx_complete_cb(uint8_t itf)
+{
+    esp_tusb_cdcacm_t *acm = get_acm(itf);
+    if (acm) {
+        if (acm->tx.size) {
+            // TinyUSB flushes the FIFO after this callback
+            xSemaphoreTake(acm->tx.mutex, portMAX_DELAY);
+            tx_drain(itf, &acm->tx);
+            xSemaphoreGive(acm->tx.mutex);
+        }
+        xSemaphoreGive(acm->tx_done_sem);
+        if (acm->io_cb) {
+            acm->io_cb(itf);
         }
     }
 }
@@ -103,18 +468,13 @@ void tud_cdc_line_coding_cb(uint8_t itf, cdc_line_coding_t const *p_line_coding)
 {
     esp_tusb_cdcacm_t *acm = get_acm(itf);
     if (acm) {
-        CDC_ACM_ENTER_CRITICAL();
-        tusb_cdcacm_callback_t cb = acm->callback_line_coding_changed;
-        CDC_ACM_EXIT_CRITICAL();
-        if (cb) {
-            cdcacm_event_t event = {
-                .type = CDC_EVENT_LINE_CODING_CHANGED,
-                .line_coding_changed_data = {
-                    .p_line_coding = p_line_coding,
-                }
-            };
-            cb(itf, &event);
-        }
+        cdcacm_event_t event = {
+            .type = CDC_EVENT_LINE_CODING_CHANGED,
+            .line_coding_changed_data = {
+                .p_line_coding = p_line_coding,
+            }
+        };
+        cdcacm_dispatch(itf, &event);
     }
 }
 
@@ -122,19 +482,17 @@ void tud_cdc_line_coding_cb(uint8_t itf, cdc_line_coding_t const *p_line_coding)
 void tud_cdc_rx_wanted_cb(uint8_t itf, char wanted_char)
 {
     esp_tusb_cdcacm_t *acm = get_acm(itf);
+    if (acm && acm->framing.frame_cb) {
+        frame_process(itf, acm);
+    }
     if (acm) {
-        CDC_ACM_ENTER_CRITICAL();
-        tusb_cdcacm_callback_t cb = acm->callback_rx_wanted_char;
-        CDC_ACM_EXIT_CRITICAL();
-        if (cb) {
-            cdcacm_event_t event = {
-                .type = CDC_EVENT_RX_WANTED_CHAR,
-                .rx_wanted_char_data = {
-                    .wanted_char = wanted_char,
-                }
-            };
-            cb(itf, &event);
-        }
+        cdcacm_event_t event = {
+            .type = CDC_EVENT_RX_WANTED_CHAR,
+            .rx_wanted_char_data = {
+                .wanted_char = wanted_char,
+            }
+        };
+        cdcacm_dispatch(itf, &event);
     }
 }
 
@@ -219,39 +577,131 @@ esp_err_t tinyusb_cdcacm_read(tinyusb_cdcacm_itf_t itf, uint8_t *out_buf, size_t
     esp_tusb_cdcacm_t *acm = get_acm(itf);
     ESP_RETURN_ON_FALSE(acm, ESP_ERR_INVALID_STATE, TAG, "Interface is not initialized. Use `tinyusb_cdc_init` for initialization");
 
-    if (tud_cdc_n_available(itf) == 0) {
+    if (rx_available(itf, acm) == 0) {
         *rx_data_size = 0;
     } else {
-        *rx_data_size = tud_cdc_n_read(itf, out_buf, out_buf_sz);
+        *rx_data_size = rx_read(itf, acm, out_buf, out_buf_sz);
     }
     return ESP_OK;
 }
 
+esp_err_t tinyusb_cdcacm_read_wait(tinyusb_cdcacm_itf_t itf, uint8_t *out_buf, size_t out_buf_sz, size_t *rx_data_size, uint32_t timeout_ticks)
+{
+    esp_tusb_cdcacm_t *acm = get_acm(itf);
+    ESP_RETURN_ON_FALSE(acm, ESP_ERR_INVALID_STATE, TAG, "Interface is not initialized. Use `tinyusb_cdc_init` for initialization");
+
+    *rx_data_size = 0;
+    const uint32_t ticks_start = xTaskGetTickCount();
+    while (rx_available(itf, acm) == 0) {
+        const uint32_t ticks_elapsed = xTaskGetTickCount() - ticks_start;
+        if (ticks_elapsed >= timeout_ticks) {
+            return ESP_ERR_TIMEOUT;
+        }
+        // Woken up by tud_cdc_rx_cb(), the data might be taken by another reader meanwhile, so check again
+        const TickType_t wait = (timeout_ticks == portMAX_DELAY) ? portMAX_DELAY : timeout_ticks - ticks_elapsed;
+        if (xSemaphoreTake(acm->rx_sem, wait) != pdTRUE) {
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+    *rx_data_size = rx_read(itf, acm, out_buf, out_buf_sz);
+    return ESP_OK;
+}
+
+esp_err_t tinyusb_cdcacm_wait_rx(tinyusb_cdcacm_itf_t itf, TickType_t timeout)
+{
+    esp_tusb_cdcacm_t *acm = get_acm(itf);
+    ESP_RETURN_ON_FALSE(acm, ESP_ERR_INVALID_STATE, TAG, "Interface is not initialized. Use `tinyusb_cdc_init` for initialization");
+
+    if (rx_available(itf, acm)) {
+        return ESP_OK;
+    }
+    return xSemaphoreTake(acm->rx_sem, timeout) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+bool tinyusb_cdcacm_peek(tinyusb_cdcacm_itf_t itf, uint8_t *ch)
+{
+    esp_tusb_cdcacm_t *acm = get_acm(itf);
+    if (!acm) { // non-initialized
+        return false;
+    }
+    if (acm->rx.size == 0) {
+        return tud_cdc_n_peek(itf, ch);
+    }
+    xSemaphoreTake(acm->rx.mutex, portMAX_DELAY);
+    rx_fill(itf, &acm->rx);
+    const bool available = acm->rx.count > 0;
+    if (available) {
+        *ch = acm->rx.buf[acm->rx.head];
+    }
+    xSemaphoreGive(acm->rx.mutex);
+    return available;
+}
+
+esp_err_t tinyusb_cdcacm_set_io_cb(tinyusb_cdcacm_itf_t itf, tinyusb_cdcacm_io_cb_t cb)
+{
+    esp_tusb_cdcacm_t *acm = get_acm(itf);
+    ESP_RETURN_ON_FALSE(acm, ESP_ERR_INVALID_STATE, TAG, "Interface is not initialized. Use `tinyusb_cdc_init` for initialization");
+    acm->io_cb = cb;
+    return ESP_OK;
+}
+
+size_t tinyusb_cdcacm_write_available(tinyusb_cdcacm_itf_t itf)
+{
+    esp_tusb_cdcacm_t *acm = get_acm(itf);
+    if (!acm) { // non-initialized
+        return 0;
+    }
+    return acm->tx.size - acm->tx.count + tud_cdc_n_write_available(itf);
+}
+
 size_t tinyusb_cdcacm_write_queue_char(tinyusb_cdcacm_itf_t itf, char ch)
 {
-    if (!get_acm(itf)) { // non-initialized
+    esp_tusb_cdcacm_t *acm = get_acm(itf);
+    if (!acm) { // non-initialized
         return 0;
     }
-    return tud_cdc_n_write_char(itf, ch);
+    return tx_write(itf, acm, (const uint8_t *)&ch, 1);
 }
 
 size_t tinyusb_cdcacm_write_queue(tinyusb_cdcacm_itf_t itf, const uint8_t *in_buf, size_t in_size)
 {
-    if (!get_acm(itf)) { // non-initialized
+    esp_tusb_cdcacm_t *acm = get_acm(itf);
+    if (!acm) { // non-initialized
         return 0;
     }
-    const uint32_t size_available = tud_cdc_n_write_available(itf);
-    return tud_cdc_n_write(itf, in_buf, MIN(in_size, size_available));
+    return tx_write(itf, acm, in_buf, in_size);
 }
 
-static uint32_t tud_cdc_n_write_occupied(tinyusb_cdcacm_itf_t itf)
+size_t tinyusb_cdcacm_write(tinyusb_cdcacm_itf_t itf, const uint8_t *in_buf, size_t in_size, uint32_t timeout_ticks)
 {
-    return CFG_TUD_CDC_TX_BUFSIZE - tud_cdc_n_write_available(itf);
+    esp_tusb_cdcacm_t *acm = get_acm(itf);
+    if (!acm) { // non-initialized
+        return 0;
+    }
+
+    size_t written = 0;
+    const uint32_t ticks_start = xTaskGetTickCount();
+    while (1) {
+        written += tx_write(itf, acm, in_buf + written, in_size - written);
+        tx_flush(itf, acm);
+        if (written == in_size) {
+            break;
+        }
+        // Write buffer is full, wait until an IN transfer completes and frees some space
+        const uint32_t ticks_elapsed = xTaskGetTickCount() - ticks_start;
+        if (ticks_elapsed >= timeout_ticks ||
+                xSemaphoreTake(acm->tx_done_sem, timeout_ticks - ticks_elapsed) != pdTRUE) {
+            ESP_LOGW(TAG, "Write timed out, %u of %u bytes written", (unsigned)written, (unsigned)in_size);
+            break;
+        }
+    }
+    return written;
 }
 
 esp_err_t tinyusb_cdcacm_write_flush(tinyusb_cdcacm_itf_t itf, uint32_t timeout_ticks)
 {
-    if (!get_acm(itf)) { // non-initialized
+    esp_tusb_cdcacm_t *acm = get_acm(itf);
+    if (!acm) { // non-initialized
         return ESP_FAIL;
     }
 
@@ -259,50 +709,101 @@ esp_err_t tinyusb_cdcacm_write_flush(tinyusb_cdcacm_itf_t itf, uint32_t timeout_
         // It might take some time until TinyUSB flushes the endpoint
         // Since this call is non-blocking, we don't wait for flush finished,
         // We only inform the user by returning ESP_ERR_NOT_FINISHED
-        tud_cdc_n_write_flush(itf);
-        if (tud_cdc_n_write_occupied(itf)) {
+        tx_flush(itf, acm);
+        if (tx_occupied(itf, acm)) {
             return ESP_ERR_NOT_FINISHED;
         }
     } else { // trying during the timeout
-        uint32_t ticks_start = xTaskGetTickCount();
-        uint32_t ticks_now = ticks_start;
+        const uint32_t ticks_start = xTaskGetTickCount();
         while (1) { // loop until success or until the time runs out
-            ticks_now = xTaskGetTickCount();
-            tud_cdc_n_write_flush(itf);
-            if (tud_cdc_n_write_occupied(itf) == 0) {
+            tx_flush(itf, acm);
+            if (tx_occupied(itf, acm) == 0) {
                 break; // All data flushed
             }
-            if ( (ticks_now - ticks_start) > timeout_ticks ) { // Time is up
+            const uint32_t ticks_elapsed = xTaskGetTickCount() - ticks_start;
+            // Each completed IN transfer frees some FIFO space, so wait for it instead of polling
+            if (ticks_elapsed >= timeout_ticks ||
+                    xSemaphoreTake(acm->tx_done_sem, timeout_ticks - ticks_elapsed) != pdTRUE) { // Time is up
                 ESP_LOGW(TAG, "Flush failed");
                 return ESP_ERR_TIMEOUT;
             }
-            vTaskDelay(1);
         }
     }
     return ESP_OK;
 }
 
-static esp_err_t alloc_obj(tinyusb_cdcacm_itf_t itf)
+static void free_sems(esp_tusb_cdcacm_t *acm)
+{
+    SemaphoreHandle_t sems[] = { acm->rx_sem, acm->tx_done_sem, acm->rx.mutex, acm->tx.mutex };
+    for (size_t i = 0; i < sizeof(sems) / sizeof(sems[0]); i++) {
+        if (sems[i]) {
+            vSemaphoreDelete(sems[i]);
+        }
+    }
+}
+
+static esp_err_t alloc_obj(tinyusb_cdcacm_itf_t itf, size_t rx_buf_size, size_t tx_buf_size, const tinyusb_cdcacm_framing_config_t *framing)
 {
     esp_tusb_cdc_t *cdc_inst = tinyusb_cdc_get_intf(itf);
     if (cdc_inst == NULL) {
         return ESP_FAIL;
     }
-    cdc_inst->subclass_obj = calloc(1, sizeof(esp_tusb_cdcacm_t));
-    if (cdc_inst->subclass_obj == NULL) {
+    // Port buffers and frame buffer follow the object in the same allocation
+    const size_t frame_buf_size = framing->frame_cb ? framing->max_len : 0;
+    esp_tusb_cdcacm_t *acm = calloc(1, sizeof(esp_tusb_cdcacm_t) + rx_buf_size + tx_buf_size + frame_buf_size);
+    if (acm == NULL) {
         return ESP_FAIL;
     }
+    acm->rx_sem = xSemaphoreCreateBinary();
+    acm->tx_done_sem = xSemaphoreCreateBinary();
+    bool ok = acm->rx_sem && acm->tx_done_sem;
+    if (rx_buf_size) {
+        acm->rx.buf = (uint8_t *)(acm + 1);
+        acm->rx.size = rx_buf_size;
+        acm->rx.mutex = xSemaphoreCreateMutex();
+        ok &= acm->rx.mutex != NULL;
+    }
+    if (tx_buf_size) {
+        acm->tx.buf = (uint8_t *)(acm + 1) + rx_buf_size;
+        acm->tx.size = tx_buf_size;
+        acm->tx.mutex = xSemaphoreCreateMutex();
+        ok &= acm->tx.mutex != NULL;
+    }
+    if (frame_buf_size) {
+        acm->framing = *framing;
+        acm->frame_buf = (uint8_t *)(acm + 1) + rx_buf_size + tx_buf_size;
+    }
+    if (!ok) {
+        free_sems(acm);
+        free(acm);
+        return ESP_FAIL;
+    }
+    cdc_inst->subclass_obj = acm;
     return ESP_OK;
 }
 
-static esp_err_t obj_free(tinyusb_cdcacm_itf_t itf)
+/**
+ * @brief Detach the object from the interface, no new events of the interface are dispatched
+ *
+ * @return Object of the interface, NULL if the interface is not initialized
+ */
+static esp_tusb_cdcacm_t *obj_detach(tinyusb_cdcacm_itf_t itf)
 {
     esp_tusb_cdc_t *cdc_inst = tinyusb_cdc_get_intf(itf);
-    if (cdc_inst == NULL || cdc_inst->subclass_obj == NULL) {
-        return ESP_FAIL;
+    if (cdc_inst == NULL) {
+        return NULL;
     }
-    free(cdc_inst->subclass_obj);
-    return ESP_OK;
+    CDC_ACM_ENTER_CRITICAL();
+    esp_tusb_cdcacm_t *acm = cdc_inst->subclass_obj;
+    cdc_inst->subclass_obj = NULL;
+    CDC_ACM_EXIT_CRITICAL();
+    return acm;
+}
+
+static void obj_free(esp_tusb_cdcacm_t *acm)
+{
+    free_sems(acm);
+    free(acm);
 }
 
 esp_err_t tusb_cdc_acm_init(const tinyusb_config_cdcacm_t *cfg)
@@ -316,8 +817,21 @@ esp_err_t tusb_cdc_acm_init(const tinyusb_config_cdcacm_t *cfg)
         .cdc_subclass.comm_subclass = CDC_COMM_SUBCLASS_ABSTRACT_CONTROL_MODEL
     };
 
+    if (cfg->framing.frame_cb) {
+        // A message wrapping around the end of the RX buffer must fit in it
+        ESP_RETURN_ON_FALSE(cfg->framing.max_len, ESP_ERR_INVALID_ARG, TAG, "framing.max_len must be set");
+        ESP_RETURN_ON_FALSE(cfg->rx_buf_size == 0 || cfg->framing.max_len <= cfg->rx_buf_size, ESP_ERR_INVALID_SIZE,
+                            TAG, "framing.max_len exceeds rx_buf_size");
+    }
     ESP_RETURN_ON_ERROR(tinyusb_cdc_init(itf, &cdc_cfg), TAG, "tinyusb_cdc_init failed");
-    ESP_GOTO_ON_ERROR(alloc_obj(itf), fail, TAG, "alloc_obj failed");
+    ESP_GOTO_ON_ERROR(alloc_obj(itf, cfg->rx_buf_size, cfg->tx_buf_size, &cfg->framing), fail, TAG, "alloc_obj failed");
+#if CONFIG_TINYUSB_CDC_EVENT_TASK
+    ESP_GOTO_ON_ERROR(cdcacm_event_task_start(), fail_task, TAG, "Failed to start CDC-ACM callback task");
+#endif
+
+    if (cfg->framing.frame_cb) {
+        tud_cdc_n_set_wanted_char(itf, cfg->framing.delimiter);
+    }
 
     /* Callbacks setting up*/
     if (cfg->callback_rx) {
@@ -334,6 +848,10 @@ esp_err_t tusb_cdc_acm_init(const tinyusb_config_cdcacm_t *cfg)
     }
 
     return ESP_OK;
+#if CONFIG_TINYUSB_CDC_EVENT_TASK
+fail_task:
+    obj_free(obj_detach(itf));
+#endif
 fail:
     tinyusb_cdc_deinit(itf);
     return ret;
@@ -342,7 +860,13 @@ fail:
 esp_err_t tusb_cdc_acm_deinit(int itf)
 {
     esp_err_t ret = ESP_OK;
-    ESP_RETURN_ON_ERROR(obj_free(itf), TAG, "obj_free failed");
+    esp_tusb_cdcacm_t *acm = obj_detach(itf);
+    ESP_RETURN_ON_FALSE(acm, ESP_FAIL, TAG, "obj_free failed");
+#if CONFIG_TINYUSB_CDC_EVENT_TASK
+    // The task finishes the events of the interface queued before it was detached
+    cdcacm_event_task_stop();
+#endif
+    obj_free(acm);
     ESP_RETURN_ON_ERROR(tinyusb_cdc_deinit(itf), TAG, "tinyusb_cdc_deinit failed");
     return ret;
 }
@@ -7,16 +7,38 @@
 
 #include <stdio.h>
 #include <stdio_ext.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/errno.h>
+#include <sys/fcntl.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_vfs.h"
 #include "cdc.h"
 #include "tusb_console.h"
 #include "tinyusb.h"
+#include "tusb_cdc_acm.h"
+#include "tusb_cdc_acm_private.h"
 #include "vfs_tinyusb.h"
 #include "esp_check.h"
 
 #define STRINGIFY(s) STRINGIFY2(s)
 #define STRINGIFY2(s) #s
 
+#define CONSOLE_LOG_PATH    "/dev/tusb_log"
+#define CONSOLE_CHUNK_SIZE  (CONFIG_TINYUSB_CDC_TX_BUFSIZE)
+#define CONSOLE_RETRY_MS    (10) // Polling interval while the host has not opened the port or the CDC FIFO is full
+
+#if CONFIG_NEWLIB_STDOUT_LINE_ENDING_CRLF
+#   define CONSOLE_EOL "\r\n"
+#elif CONFIG_NEWLIB_STDOUT_LINE_ENDING_CR
+#   define CONSOLE_EOL "\r"
+#else
+#   define CONSOLE_EOL "\n"
+#endif
+
 static const char *TAG = "tusb_console";
 
 typedef struct {
@@ -27,6 +49,22 @@ typedef struct {
 
 static console_handle_t con;
 
+typedef struct {
+    tusb_console_buffered_config_t cfg;
+    portMUX_TYPE lock;              // Protects the positions and the counter
+    uint8_t *ring;
+    uint8_t *chunk;                 // Copy of the ring being written to the CDC, the writers may overwrite the ring meanwhile
+    uint64_t head;                  // Total bytes written, ring index = pos % buf_size
+    uint64_t tail;                  // Total bytes sent or dropped
+    size_t dropped;
+    TaskHandle_t task;
+    TaskHandle_t stopper;           // Task waiting for the console task to finish
+    volatile bool running;
+} console_log_t;
+
+static console_log_t *s_log;
+static portMUX_TYPE s_log_lock = portMUX_INITIALIZER_UNLOCKED;
+
 
 /**
  * @brief Reopen standard streams using a new path
@@ -99,6 +137,243 @@ static esp_err_t restore_std_streams(FILE **f_in, FILE **f_out, FILE **f_err)
     return ESP_OK;
 }
 
+//--------------------------------------------------------------------+
+// Buffered console
+//--------------------------------------------------------------------+
+static void ring_copy_in(console_log_t *log, uint64_t pos, const uint8_t *data, size_t len)
+{
+    const size_t idx = pos % log->cfg.buf_size;
+    const size_t first = MIN(len, log->cfg.buf_size - idx);
+    memcpy(log->ring + idx, data, first);
+    memcpy(log->ring, data + first, len - first);
+}
+
+static void ring_copy_out(console_log_t *log, uint64_t pos, uint8_t *data, size_t len)
+{
+    const size_t idx = pos % log->cfg.buf_size;
+    const size_t first = MIN(len, log->cfg.buf_size - idx);
+    memcpy(data, log->ring + idx, first);
+    memcpy(data + first, log->ring, len - first);
+}
+
+/**
+ * @brief Drop the oldest data until len bytes are free, up to the end of a line
+ *
+ * Must be called with the lock taken.
+ */
+static void ring_drop_oldest(console_log_t *log, size_t len)
+{
+    uint64_t tail = log->head - log->cfg.buf_size + len;
+    while (tail != log->head && log->ring[(tail - 1) % log->cfg.buf_size] != '\n') {
+        tail++;
+    }
+    log->dropped += tail - log->tail;
+    log->tail = tail;
+}
+
+/**
+ * @brief Append data to the ring, without blocking
+ *
+ * @return true if the ring was empty, and the console task has to be woken up
+ */
+static bool ring_put(console_log_t *log, const uint8_t *data, size_t len)
+{
+    bool was_empty = false;
+    portENTER_CRITICAL(&log->lock);
+    if (len > log->cfg.buf_size) {
+        // Keep the end of the output with DROP_OLDEST, nothing with DROP_NEWEST
+        const size_t skip = (log->cfg.drop_policy == TUSB_CONSOLE_DROP_OLDEST) ? len - log->cfg.buf_size : len;
+        log->dropped += skip;
+        data += skip;
+        len -= skip;
+    }
+    if (len > log->cfg.buf_size - (log->head - log->tail)) {
+        if (log->cfg.drop_policy == TUSB_CONSOLE_DROP_OLDEST) {
+            ring_drop_oldest(log, len);
+        } else {
+            log->dropped += len;
+            len = 0;
+        }
+    }
+    if (len) {
+        was_empty = (log->head == log->tail);
+        ring_copy_in(log, log->head, data, len);
+        log->head += len;
+    }
+    portEXIT_CRITICAL(&log->lock);
+    return was_empty;
+}
+
+static ssize_t console_log_write(int fd, const void *data, size_t size)
+{
+    (void)fd;
+    console_log_t *log = s_log;
+    if (log == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+    // Line endings are translated here, so the task sends the ring unchanged
+    const char *data_c = (const char *)data;
+    bool wake = false;
+    size_t done = 0;
+    while (done < size) {
+        const char *nl = memchr(data_c + done, '\n', size - done);
+        const size_t run = (nl ? (size_t)(nl - data_c) : size) - done;
+        wake |= ring_put(log, (const uint8_t *)data_c + done, run);
+        done += run;
+        if (nl) {
+            wake |= ring_put(log, (const uint8_t *)CONSOLE_EOL, strlen(CONSOLE_EOL));
+            done++;
+        }
+    }
+    if (wake) {
+        xTaskNotifyGive(log->task);
+    }
+    return size;
+}
+
+static int console_log_open(const char *path, int flags, int mode)
+{
+    (void)path;
+    (void)flags;
+    (void)mode;
+    return 0;
+}
+
+static int console_log_close(int fd)
+{
+    (void)fd;
+    return 0;
+}
+
+static int console_log_fstat(int fd, struct stat *st)
+{
+    (void)fd;
+    memset(st, 0, sizeof(*st));
+    st->st_mode = S_IFCHR;
+    return 0;
+}
+
+static void console_log_task(void *arg)
+{
+    console_log_t *log = (console_log_t *)arg;
+    const int itf = log->cfg.cdc_intf;
+    TickType_t wait = portMAX_DELAY;
+    while (log->running) {
+        ulTaskNotifyTake(pdTRUE, wait);
+        wait = portMAX_DELAY;
+        while (log->running) {
+            // While the port is closed, TinyUSB would overwrite its FIFO: leave the data in the ring
+            const size_t avail = tud_cdc_n_connected(itf) ? tinyusb_cdcacm_write_available(itf) : 0;
+            portENTER_CRITICAL(&log->lock);
+            const uint64_t pos = log->tail;
+            const size_t len = MIN(MIN(log->head - pos, avail), CONSOLE_CHUNK_SIZE);
+            ring_copy_out(log, pos, log->chunk, len);
+            const bool more = (log->head - pos) > len;
+            portEXIT_CRITICAL(&log->lock);
+            if (len == 0) {
+                wait = more ? pdMS_TO_TICKS(CONSOLE_RETRY_MS) : portMAX_DELAY;
+                break;
+            }
+            const size_t sent = tinyusb_cdcacm_write_queue(itf, log->chunk, len);
+            portENTER_CRITICAL(&log->lock);
+            // The writers may have dropped the chunk meanwhile with DROP_OLDEST
+            if (pos + sent > log->tail) {
+                log->tail = pos + sent;
+            }
+            portEXIT_CRITICAL(&log->lock);
+        }
+        tinyusb_cdcacm_write_flush(itf, 0);
+    }
+    xTaskNotifyGive(log->stopper);
+    vTaskDelete(NULL);
+}
+
+static void console_log_free(console_log_t *log)
+{
+    if (log->task) {
+        log->stopper = xTaskGetCurrentTaskHandle();
+        log->running = false;
+        xTaskNotifyGive(log->task);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    free(log);
+}
+
+esp_err_t esp_tusb_init_console_buffered(const tusb_console_buffered_config_t *config)
+{
+    ESP_RETURN_ON_FALSE(config, ESP_ERR_INVALID_ARG, TAG, "Config can't be NULL");
+    ESP_RETURN_ON_FALSE(config->buf_size > 0, ESP_ERR_INVALID_ARG, TAG, "Buffer size can't be 0");
+    ESP_RETURN_ON_FALSE(!s_log, ESP_ERR_INVALID_STATE, TAG, "Buffered console already initialized");
+
+    console_log_t *log = calloc(1, sizeof(console_log_t) + config->buf_size + CONSOLE_CHUNK_SIZE);
+    ESP_RETURN_ON_FALSE(log, ESP_ERR_NO_MEM, TAG, "No memory for buffered console");
+    log->cfg = *config;
+    log->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    log->ring = (uint8_t *)(log + 1);
+    log->chunk = log->ring + config->buf_size;
+    log->running = true;
+    if (xTaskCreate(console_log_task, "TinyUSB console", CONFIG_TINYUSB_CONSOLE_TASK_STACK_SIZE, log,
+                    CONFIG_TINYUSB_CONSOLE_TASK_PRIORITY, &log->task) != pdPASS) {
+        free(log);
+        ESP_LOGE(TAG, "Can't create console task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    const esp_vfs_t vfs = {
+        .flags = ESP_VFS_FLAG_DEFAULT,
+        .close = &console_log_close,
+        .fstat = &console_log_fstat,
+        .open = &console_log_open,
+        .write = &console_log_write,
+    };
+    esp_err_t ret = esp_vfs_register(CONSOLE_LOG_PATH, &vfs, NULL);
+    ESP_GOTO_ON_ERROR(ret, fail, TAG, "Can't register console VFS");
+    ret = esp_vfs_tusb_cdc_register(config->cdc_intf, NULL);
+    ESP_GOTO_ON_ERROR(ret, fail_vfs, TAG, "");
+    portENTER_CRITICAL(&s_log_lock);
+    s_log = log;
+    portEXIT_CRITICAL(&s_log_lock);
+    // stdin keeps reading the CDC directly, stdout and stderr go through the ring
+    ret = redirect_std_streams_to(&con.in, NULL, NULL, VFS_TUSB_PATH_DEFAULT);
+    if (ret == ESP_OK) {
+        ret = redirect_std_streams_to(NULL, &con.out, &con.err, CONSOLE_LOG_PATH);
+    }
+    ESP_GOTO_ON_ERROR(ret, fail_redirect, TAG, "Failed to redirect STD streams");
+    return ESP_OK;
+
+fail_redirect:
+    restore_std_streams(con.in ? &con.in : NULL, con.out ? &con.out : NULL, con.err ? &con.err : NULL);
+    memset(&con, 0, sizeof(con));
+    portENTER_CRITICAL(&s_log_lock);
+    s_log = NULL;
+    portEXIT_CRITICAL(&s_log_lock);
+    esp_vfs_tusb_cdc_unregister(NULL);
+fail_vfs:
+    esp_vfs_unregister(CONSOLE_LOG_PATH);
+fail:
+    console_log_free(log);
+    return ret;
+}
+
+size_t esp_tusb_console_get_dropped(bool reset)
+{
+    size_t dropped = 0;
+    portENTER_CRITICAL(&s_log_lock);
+    console_log_t *log = s_log;
+    if (log) {
+        dropped = log->dropped;
+        if (reset) {
+            log->dropped = 0;
+        }
+    }
+    portEXIT_CRITICAL(&s_log_lock);
+    return dropped;
+}
+
+//--------------------------------------------------------------------+
+// API
+//--------------------------------------------------------------------+
 esp_err_t esp_tusb_init_console(int cdc_intf)
 {
     /* Registering TUSB at VFS */
@@ -111,5 +386,13 @@ esp_err_t esp_tusb_deinit_console(int cdc_intf)
 {
     ESP_RETURN_ON_ERROR(restore_std_streams(&con.in, &con.out, &con.err), TAG, "Failed to restore STD streams");
     esp_vfs_tusb_cdc_unregister(NULL);
+    if (s_log) {
+        portENTER_CRITICAL(&s_log_lock);
+        console_log_t *log = s_log;
+        s_log = NULL;
+        portEXIT_CRITICAL(&s_log_lock);
+        esp_vfs_unregister(CONSOLE_LOG_PATH);
+        console_log_free(log);
+    }
     return ESP_OK;
 }
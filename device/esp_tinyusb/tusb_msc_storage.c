@@ -5,9 +5,23 @@
  */
 
 #include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "esp_log.h"
 #include "esp_err.h"
 #include "esp_check.h"
+#include "esp_assert.h"
+#include "esp_heap_caps.h"
+#if CONFIG_TINYUSB_MSC_SPIFLASH_WRITE_CACHE || CONFIG_TINYUSB_MSC_STATS
+#include "esp_timer.h"
+#endif
+#if CONFIG_TINYUSB_MSC_STATS_CONSOLE
+#include <stdio.h>
+#include "esp_console.h"
+#endif
 #include "diskio_impl.h"
 #include "diskio_wl.h"
 #include "wear_levelling.h"
@@ -15,219 +29,1624 @@
 #include "vfs_fat_internal.h"
 #include "tinyusb.h"
 #include "class/msc/msc_device.h"
+#include "miniz.h"
 #include "tusb_msc_storage.h"
 #if CONFIG_TINYUSB_MSC_SOC_SDMMC_HOST_ENABLED
 #include "diskio_sdmmc.h"
 #endif
 
-static const char *TAG = "tinyusb_msc_storage";
+static const char *TAG = "tinyusb_msc_storage";
+
+typedef struct msc_lun_s msc_lun_t;
+
+#if CONFIG_TINYUSB_MSC_STATS
+typedef struct {
+    portMUX_TYPE lock;              // Updated from TinyUSB task, storage task, esp_timer task and the application
+    tinyusb_msc_storage_stats_t data;
+} msc_stats_t;
+#endif
+
+#if CONFIG_TINYUSB_MSC_ASYNC_IO
+// READ10/WRITE10 can be completed from another task by tud_msc_async_io_done() since TinyUSB 0.18.
+// Older versions call the callbacks again until they do not return 0 (busy)
+#define MSC_ASYNC_IO_DONE_SUPPORTED (TUSB_VERSION_MAJOR > 0 || TUSB_VERSION_MINOR >= 18)
+#define MSC_ASYNC_BUF_NUM           (2)
+#define MSC_ASYNC_BUF_SIZE          (CONFIG_TINYUSB_MSC_ASYNC_BUF_SIZE)
+#if CONFIG_CACHE_L1_CACHE_LINE_SIZE
+// Media drivers with DMA (SDMMC) use the buffers directly only if they are cache line aligned
+#define MSC_ASYNC_BUF_ALIGN         (CONFIG_CACHE_L1_CACHE_LINE_SIZE)
+#else
+#define MSC_ASYNC_BUF_ALIGN         (4)
+#endif
+ESP_STATIC_ASSERT(MSC_ASYNC_BUF_SIZE >= CONFIG_TINYUSB_MSC_BUFSIZE, "Storage task buffers must hold a whole READ10/WRITE10 chunk");
+
+typedef enum {
+    MSC_ASYNC_REQ_FREE,
+    MSC_ASYNC_REQ_PENDING,          // Queued to the storage task or executed by it
+    MSC_ASYNC_REQ_DONE,             // Read data are in the buffer
+} msc_async_req_state_t;
+
+typedef struct {
+    msc_async_req_state_t state;
+    bool write;
+    bool usb_waiting;               // READ10/WRITE10 returned TUD_MSC_RET_ASYNC, the storage task completes it
+    bool discard;                   // Read data are stale because of a later write
+    uint8_t lun;
+    uint32_t lba;
+    uint32_t offset;
+    uint64_t addr;                  // Byte address of lba and offset
+    uint32_t size;                  // Reads fetch up to MSC_ASYNC_BUF_SIZE, more than one READ10 chunk
+    esp_err_t result;
+    uint8_t *data;                  // Staging buffer, or TinyUSB buffer of a direct request
+    void *usb_buf;                  // TinyUSB buffer the read data are copied to when usb_waiting
+    uint32_t usb_offset;            // Offset of the READ10 chunk in data
+    uint32_t usb_len;               // Length of the READ10/WRITE10 chunk
+} msc_async_req_t;
+
+typedef struct {
+    TaskHandle_t task;
+    msc_lun_t *lun;                 // LUN served by the task, each LUN has its own task
+    QueueHandle_t requests;         // Requests in the order of commands, NULL stops the task
+    SemaphoreHandle_t lock;         // Protects the requests and write_error
+    SemaphoreHandle_t progress;     // Given by the storage task after each request
+    SemaphoreHandle_t stopped;      // Given by the storage task before it exits
+    esp_err_t write_error;          // First failure of a completed write, reported by the next command
+    msc_async_req_t buf[MSC_ASYNC_BUF_NUM]; // Double-buffered writes and read-ahead
+#if MSC_ASYNC_IO_DONE_SUPPORTED
+    msc_async_req_t direct;         // Request using TinyUSB buffer when all staging buffers are busy
+#endif
+} msc_async_t;
+#endif // CONFIG_TINYUSB_MSC_ASYNC_IO
+
+#if CONFIG_TINYUSB_MSC_SPIFLASH_WRITE_CACHE
+#define MSC_FLASH_CACHE_BLOCK_SIZE  (4096) // SPI flash erase sector, multiple of any WL sector size
+
+/**
+ * @brief Write-back cache of one flash erase block
+ *
+ * Consecutive writes are gathered into one contiguous range of the block,
+ * which is then written with one erase of the whole block.
+ */
+typedef struct {
+    SemaphoreHandle_t lock;         // Protects the cache, it is flushed from esp_timer task too
+    esp_timer_handle_t idle_timer;  // Flushes the cache when there are no writes for a while
+    size_t addr;                    // Address of the cached erase block
+    size_t start;                   // Start of the cached range, offset in the block
+    size_t end;                     // End of the cached range, offset in the block. 0 for empty cache
+    uint8_t data[MSC_FLASH_CACHE_BLOCK_SIZE];
+} msc_flash_cache_t;
+#endif // CONFIG_TINYUSB_MSC_SPIFLASH_WRITE_CACHE
+
+/**
+ * @brief Context of SPI flash backend
+ */
+typedef struct {
+    wl_handle_t wl_handle;
+#if CONFIG_TINYUSB_MSC_SPIFLASH_WRITE_CACHE
+    msc_flash_cache_t cache;
+#endif
+#if CONFIG_TINYUSB_MSC_STATS
+    msc_stats_t *stats;             // Statistics of the LUN, erases are measured by the backend
+#endif
+} msc_spiflash_t;
+
+struct msc_lun_s {
+    tinyusb_msc_storage_backend_t backend;
+    void *ctx;                      // Context of the backend
+    volatile uint32_t write_gen;    // Incremented by each WRITE10 of the host
+#if CONFIG_TINYUSB_MSC_STATS
+    msc_stats_t stats;
+#endif
+#if CONFIG_TINYUSB_MSC_ASYNC_IO
+    msc_async_t *async;
+#endif
+};
+
+/**
+ * @brief Append-only log region of LUN 0, written by the application while the host has the storage
+ */
+typedef struct {
+    uint32_t first_sector;
+    uint32_t sector_count;          // 0: No log region
+    uint64_t pos;                   // Bytes in the region, the next append starts here
+    uint8_t *tail;                  // Content of the sector at pos, written again by each append
+} msc_log_t;
+
+typedef struct {
+    msc_lun_t luns[CONFIG_TINYUSB_MSC_LUN_MAX];
+    uint8_t lun_count;
+    tusb_msc_callback_t callback_mount_changed;
+    tusb_msc_callback_t callback_premount_changed;
+    int max_files;
+    bool format_if_mount_failed;
+    size_t allocation_unit_size;
+    SemaphoreHandle_t switch_lock;  // Serializes mount, unmount and log writes
+    volatile bool is_fat_mounted;   // LUN 0 is mounted by the application, the host sees no medium
+    bool keep_fs_cache;             // FatFS stays registered while the host has the storage
+    FATFS *fs;                      // FatFS of LUN 0, NULL if not registered
+    BYTE pdrv;
+    char *base_path;
+    uint32_t expose_write_gen;      // Write generation of LUN 0 when it was exposed to the host
+    msc_log_t log;
+} tinyusb_msc_storage_handle_s; /*!< MSC object */
+
+/* handle of tinyusb driver connected to application */
+static tinyusb_msc_storage_handle_s *s_storage_handle;
+
+static inline int64_t msc_stats_start(void)
+{
+#if CONFIG_TINYUSB_MSC_STATS
+    return esp_timer_get_time();
+#else
+    return 0;
+#endif
+}
+
+#if CONFIG_TINYUSB_MSC_STATS
+static void msc_stats_hist_add(tinyusb_msc_latency_hist_t *hist, uint32_t us)
+{
+    // Bucket of 2^n us is n - 4, so bucket 0 holds everything below 32 us
+    const int order = us ? 31 - __builtin_clz(us) : 0;
+    const int bucket = MIN(MAX(order - 4, 0), TINYUSB_MSC_LATENCY_BUCKETS - 1);
+    hist->count[bucket]++;
+    hist->max_us = MAX(hist->max_us, us);
+    hist->total_us += us;
+}
+
+/**
+ * @brief Add latency of a media access started at start to the statistics
+ */
+static void msc_stats_media(msc_stats_t *stats, tinyusb_msc_media_op_t op, int64_t start)
+{
+    if (stats == NULL) {
+        return;
+    }
+    const uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+    portENTER_CRITICAL_SAFE(&stats->lock);
+    msc_stats_hist_add(&stats->data.media[op], us);
+    portEXIT_CRITICAL_SAFE(&stats->lock);
+}
+#else
+#define msc_stats_media(stats, op, start) ((void)(start))
+#endif
+
+static uint32_t _get_sector_count_spiflash(void *ctx)
+{
+    msc_spiflash_t *flash = (msc_spiflash_t *)ctx;
+    uint32_t result = 0;
+    assert(flash->wl_handle != WL_INVALID_HANDLE);
+    size_t size = wl_sector_size(flash->wl_handle);
+    if (size == 0) {
+        ESP_LOGW(TAG, "WL Sector size is zero !!!");
+        result = 0;
+    } else {
+        result = (uint32_t)(wl_size(flash->wl_handle) / size);
+    }
+    return result;
+}
+
+static uint32_t _get_sector_size_spiflash(void *ctx)
+{
+    msc_spiflash_t *flash = (msc_spiflash_t *)ctx;
+    assert(flash->wl_handle != WL_INVALID_HANDLE);
+    return (uint32_t)wl_sector_size(flash->wl_handle);
+}
+
+static esp_err_t _read_sector_spiflash(void *ctx,
+                                       uint32_t lba,
+                                       uint32_t offset,
+                                       size_t size,
+                                       void *dest)
+{
+    msc_spiflash_t *flash = (msc_spiflash_t *)ctx;
+    const size_t sector_size = wl_sector_size(flash->wl_handle);
+    size_t temp = 0;
+    size_t addr = 0; // Address of the data to be read, relative to the beginning of the partition.
+    ESP_RETURN_ON_FALSE(!__builtin_umul_overflow(lba, sector_size, &temp), ESP_ERR_INVALID_SIZE, TAG, "overflow lba %lu sector_size %u", lba, sector_size);
+    ESP_RETURN_ON_FALSE(!__builtin_uadd_overflow(temp, offset, &addr), ESP_ERR_INVALID_SIZE, TAG, "overflow addr %u offset %lu", temp, offset);
+#if CONFIG_TINYUSB_MSC_SPIFLASH_WRITE_CACHE
+    msc_flash_cache_t *cache = &flash->cache;
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    esp_err_t ret = wl_read(flash->wl_handle, addr, dest, size);
+    if (ret == ESP_OK && cache->end) {
+        // Cached data are newer than the flash content
+        const size_t cached_start = MAX(cache->addr + cache->start, addr);
+        const size_t cached_end = MIN(cache->addr + cache->end, addr + size);
+        if (cached_start < cached_end) {
+            memcpy((uint8_t *)dest + (cached_start - addr), cache->data + (cached_start - cache->addr), cached_end - cached_start);
+        }
+    }
+    xSemaphoreGive(cache->lock);
+    return ret;
+#else
+    return wl_read(flash->wl_handle, addr, dest, size);
+#endif
+}
+
+static esp_err_t _erase_spiflash(msc_spiflash_t *flash, size_t addr, size_t size)
+{
+    const int64_t start = msc_stats_start();
+    const esp_err_t ret = wl_erase_range(flash->wl_handle, addr, size);
+    msc_stats_media(flash->stats, TINYUSB_MSC_MEDIA_ERASE, start);
+    return ret;
+}
+
+#if CONFIG_TINYUSB_MSC_SPIFLASH_WRITE_CACHE
+/**
+ * @brief Write the cached erase block to flash, the cache must be locked
+ *
+ * The parts of the block out of the cached range are read from flash first.
+ * The cache is empty afterwards, even if the write failed.
+ */
+static esp_err_t _flash_cache_flush_locked(msc_spiflash_t *flash)
+{
+    esp_err_t ret = ESP_OK;
+    msc_flash_cache_t *cache = &flash->cache;
+    const wl_handle_t wl_handle = flash->wl_handle;
+    if (cache->end == 0) {
+        return ESP_OK;
+    }
+    if (cache->start > 0) {
+        ESP_GOTO_ON_ERROR(wl_read(wl_handle, cache->addr, cache->data, cache->start), exit, TAG, "Failed to read");
+    }
+    if (cache->end < MSC_FLASH_CACHE_BLOCK_SIZE) {
+        ESP_GOTO_ON_ERROR(wl_read(wl_handle, cache->addr + cache->end, cache->data + cache->end, MSC_FLASH_CACHE_BLOCK_SIZE - cache->end),
+                          exit, TAG, "Failed to read");
+    }
+    ESP_GOTO_ON_ERROR(_erase_spiflash(flash, cache->addr, MSC_FLASH_CACHE_BLOCK_SIZE), exit, TAG, "Failed to erase");
+    ret = wl_write(wl_handle, cache->addr, cache->data, MSC_FLASH_CACHE_BLOCK_SIZE);
+exit:
+    cache->end = 0;
+    return ret;
+}
+
+static void _flash_cache_idle_cb(void *arg)
+{
+    msc_spiflash_t *flash = (msc_spiflash_t *)arg;
+    xSemaphoreTake(flash->cache.lock, portMAX_DELAY);
+    const esp_err_t ret = _flash_cache_flush_locked(flash);
+    xSemaphoreGive(flash->cache.lock);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Flush of write cache failed");
+    }
+}
+#endif // CONFIG_TINYUSB_MSC_SPIFLASH_WRITE_CACHE
+
+static esp_err_t _write_sector_spiflash(void *ctx,
+                                        uint32_t lba,
+                                        uint32_t offset,
+                                        size_t size,
+                                        const void *src)
+{
+    msc_spiflash_t *flash = (msc_spiflash_t *)ctx;
+    // Overflow and alignment of the address are checked by msc_storage_write_sector()
+    size_t addr = (size_t)lba * wl_sector_size(flash->wl_handle) + offset;
+#if CONFIG_TINYUSB_MSC_SPIFLASH_WRITE_CACHE
+    esp_err_t ret = ESP_OK;
+    msc_flash_cache_t *cache = &flash->cache;
+    const uint8_t *data = src;
+    xSemaphoreTake(cache->lock, portMAX_DELAY);
+    while (size > 0) {
+        const size_t block = addr & ~(size_t)(MSC_FLASH_CACHE_BLOCK_SIZE - 1);
+        const size_t start = addr - block;
+        const size_t len = MIN(size, MSC_FLASH_CACHE_BLOCK_SIZE - start);
+        // Only a contiguous range is cached, a write elsewhere flushes it first
+        if (cache->end && (block != cache->addr || start > cache->end || start + len < cache->start)) {
+            ESP_GOTO_ON_ERROR(_flash_cache_flush_locked(flash), exit, TAG, "Failed to flush write cache");
+        }
+        if (cache->end == 0) {
+            cache->addr = block;
+            cache->start = start;
+            cache->end = start + len;
+        } else {
+            cache->start = MIN(cache->start, start);
+            cache->end = MAX(cache->end, start + len);
+        }
+        memcpy(cache->data + start, data, len);
+        if (cache->start == 0 && cache->end == MSC_FLASH_CACHE_BLOCK_SIZE) {
+            ESP_GOTO_ON_ERROR(_flash_cache_flush_locked(flash), exit, TAG, "Failed to write block");
+        }
+        addr += len;
+        data += len;
+        size -= len;
+    }
+exit:
+    esp_timer_stop(cache->idle_timer);
+    if (cache->end) {
+        esp_timer_start_once(cache->idle_timer, CONFIG_TINYUSB_MSC_SPIFLASH_WRITE_CACHE_IDLE_MS * 1000);
+    }
+    xSemaphoreGive(cache->lock);
+    return ret;
+#else
+    ESP_RETURN_ON_ERROR(_erase_spiflash(flash, addr, size),
+                        TAG, "Failed to erase");
+    return wl_write(flash->wl_handle, addr, src, size);
+#endif
+}
+
+static esp_err_t _sync_spiflash(void *ctx)
+{
+#if CONFIG_TINYUSB_MSC_SPIFLASH_WRITE_CACHE
+    msc_spiflash_t *flash = (msc_spiflash_t *)ctx;
+    xSemaphoreTake(flash->cache.lock, portMAX_DELAY);
+    const esp_err_t ret = _flash_cache_flush_locked(flash);
+    xSemaphoreGive(flash->cache.lock);
+    return ret;
+#else
+    return ESP_OK;
+#endif
+}
+
+static void _deinit_spiflash(void *ctx)
+{
+    msc_spiflash_t *flash = (msc_spiflash_t *)ctx;
+#if CONFIG_TINYUSB_MSC_SPIFLASH_WRITE_CACHE
+    esp_timer_stop(flash->cache.idle_timer);
+    if (_sync_spiflash(flash) != ESP_OK) {
+        ESP_LOGE(TAG, "Flush of write cache failed before deinit");
+    }
+    esp_timer_delete(flash->cache.idle_timer);
+    vSemaphoreDelete(flash->cache.lock);
+#endif
+    free(flash);
+}
+
+static const tinyusb_msc_storage_backend_t s_spiflash_backend = {
+    .get_sector_count = _get_sector_count_spiflash,
+    .get_sector_size = _get_sector_size_spiflash,
+    .read = _read_sector_spiflash,
+    .write = _write_sector_spiflash,
+    .sync = _sync_spiflash,
+    .deinit = _deinit_spiflash,
+};
+
+/**
+ * @brief Create context of SPI flash backend
+ */
+static esp_err_t _create_spiflash(wl_handle_t wl_handle, msc_spiflash_t **flash_ret)
+{
+    msc_spiflash_t *flash = calloc(1, sizeof(msc_spiflash_t));
+    ESP_RETURN_ON_FALSE(flash, ESP_ERR_NO_MEM, TAG, "could not allocate spiflash storage");
+    flash->wl_handle = wl_handle;
+#if CONFIG_TINYUSB_MSC_SPIFLASH_WRITE_CACHE
+    esp_err_t ret = ESP_OK;
+    msc_flash_cache_t *cache = &flash->cache;
+    ESP_GOTO_ON_FALSE(wl_sector_size(wl_handle) <= MSC_FLASH_CACHE_BLOCK_SIZE, ESP_ERR_NOT_SUPPORTED, fail, TAG, "WL sector larger than write cache");
+    cache->lock = xSemaphoreCreateMutex();
+    ESP_GOTO_ON_FALSE(cache->lock, ESP_ERR_NO_MEM, fail, TAG, "could not allocate write cache lock");
+    const esp_timer_create_args_t timer_args = {
+        .callback = _flash_cache_idle_cb,
+        .arg = flash,
+        .name = "tusb_msc_flush",
+    };
+    ESP_GOTO_ON_ERROR(esp_timer_create(&timer_args, &cache->idle_timer), fail, TAG, "could not create write cache timer");
+#endif
+    *flash_ret = flash;
+    return ESP_OK;
+
+#if CONFIG_TINYUSB_MSC_SPIFLASH_WRITE_CACHE
+fail:
+    if (cache->lock) {
+        vSemaphoreDelete(cache->lock);
+    }
+    free(flash);
+    return ret;
+#endif
+}
+
+#if CONFIG_TINYUSB_MSC_SOC_SDMMC_HOST_ENABLED
+
+static uint32_t _get_sector_count_sdmmc(void *ctx)
+{
+    const sdmmc_card_t *card = (const sdmmc_card_t *)ctx;
+    assert(card);
+    return (uint32_t)card->csd.capacity;
+}
+
+static uint32_t _get_sector_size_sdmmc(void *ctx)
+{
+    const sdmmc_card_t *card = (const sdmmc_card_t *)ctx;
+    assert(card);
+    return (uint32_t)card->csd.sector_size;
+}
+
+static esp_err_t _read_sector_sdmmc(void *ctx,
+                                    uint32_t lba,
+                                    uint32_t offset,
+                                    size_t size,
+                                    void *dest)
+{
+    const sdmmc_card_t *card = (const sdmmc_card_t *)ctx;
+    return sdmmc_read_sectors(card, dest, lba, size / card->csd.sector_size);
+}
+
+static esp_err_t _write_sector_sdmmc(void *ctx,
+                                     uint32_t lba,
+                                     uint32_t offset,
+                                     size_t size,
+                                     const void *src)
+{
+    const sdmmc_card_t *card = (const sdmmc_card_t *)ctx;
+    return sdmmc_write_sectors(card, src, lba, size / card->csd.sector_size);
+}
+
+static const tinyusb_msc_storage_backend_t s_sdmmc_backend = {
+    .get_sector_count = _get_sector_count_sdmmc,
+    .get_sector_size = _get_sector_size_sdmmc,
+    .read = _read_sector_sdmmc,
+    .write = _write_sector_sdmmc,
+};
+#endif
+
+/**
+ * @brief Context of RAM disk backend
+ */
+typedef struct {
+    uint8_t *data;
+    uint32_t sector_count;
+    uint32_t sector_size;
+    bool owned;                     // Memory is allocated by the backend
+} msc_ramdisk_t;
+
+static uint32_t _get_sector_count_ramdisk(void *ctx)
+{
+    return ((msc_ramdisk_t *)ctx)->sector_count;
+}
+
+static uint32_t _get_sector_size_ramdisk(void *ctx)
+{
+    return ((msc_ramdisk_t *)ctx)->sector_size;
+}
+
+static esp_err_t _read_sector_ramdisk(void *ctx, uint32_t lba, uint32_t offset, size_t size, void *dest)
+{
+    msc_ramdisk_t *disk = (msc_ramdisk_t *)ctx;
+    const uint64_t addr = (uint64_t)lba * disk->sector_size + offset;
+    ESP_RETURN_ON_FALSE(addr + size <= (uint64_t)disk->sector_count * disk->sector_size, ESP_ERR_INVALID_SIZE, TAG, "read out of ramdisk");
+    memcpy(dest, disk->data + addr, size);
+    return ESP_OK;
+}
+
+static esp_err_t _write_sector_ramdisk(void *ctx, uint32_t lba, uint32_t offset, size_t size, const void *src)
+{
+    msc_ramdisk_t *disk = (msc_ramdisk_t *)ctx;
+    const uint64_t addr = (uint64_t)lba * disk->sector_size + offset;
+    ESP_RETURN_ON_FALSE(addr + size <= (uint64_t)disk->sector_count * disk->sector_size, ESP_ERR_INVALID_SIZE, TAG, "write out of ramdisk");
+    memcpy(disk->data + addr, src, size);
+    return ESP_OK;
+}
+
+static void _deinit_ramdisk(void *ctx)
+{
+    msc_ramdisk_t *disk = (msc_ramdisk_t *)ctx;
+    if (disk->owned) {
+        free(disk->data);
+    }
+    free(disk);
+}
+
+static const tinyusb_msc_storage_backend_t s_ramdisk_backend = {
+    .get_sector_count = _get_sector_count_ramdisk,
+    .get_sector_size = _get_sector_size_ramdisk,
+    .read = _read_sector_ramdisk,
+    .write = _write_sector_ramdisk,
+    .deinit = _deinit_ramdisk,
+};
+
+#define MSC_IMAGE_MAGIC             (0x5A43534D) // "MSCZ"
+#define MSC_IMAGE_VERSION           (1)
+#define MSC_IMAGE_CACHE_BLOCKS      (4)          // Default size of the LRU of decompressed blocks
+
+/**
+ * @brief Header of compressed image, followed by block_count + 1 offsets of compressed blocks
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t sector_size;
+    uint32_t sector_count;
+    uint32_t block_size;            // Decompressed size of each block, multiple of sector_size
+    uint32_t block_count;
+} msc_image_header_t;
+
+typedef struct {
+    uint32_t block;                 // Index of the decompressed block, UINT32_MAX for none
+    uint32_t last_use;              // Value of use_counter at the last access
+    uint8_t *data;
+} msc_image_cache_t;
+
+/**
+ * @brief Context of read-only compressed image backend
+ *
+ * Blocks are decompressed on demand into a small LRU cache, so sequential reads
+ * decompress each block once and random reads stay within one block decompression.
+ * The backend is not reentrant, each LUN is read from one task only.
+ */
+typedef struct {
+    const uint8_t *image;
+    msc_image_header_t header;
+    tinfl_decompressor *inflator;   // Too large for the stack of TinyUSB task
+    uint32_t use_counter;
+    uint8_t cache_num;
+    msc_image_cache_t cache[];
+} msc_image_t;
+
+static uint32_t _get_sector_count_image(void *ctx)
+{
+    return ((msc_image_t *)ctx)->header.sector_count;
+}
+
+static uint32_t _get_sector_size_image(void *ctx)
+{
+    return ((msc_image_t *)ctx)->header.sector_size;
+}
+
+static uint32_t _image_block_offset(const msc_image_t *img, uint32_t block)
+{
+    uint32_t offset;
+    memcpy(&offset, img->image + sizeof(msc_image_header_t) + block * sizeof(uint32_t), sizeof(offset));
+    return offset;
+}
+
+static esp_err_t _image_decompress(msc_image_t *img, uint32_t block, uint8_t *dest)
+{
+    const uint64_t disk_size = (uint64_t)img->header.sector_count * img->header.sector_size;
+    const size_t expected = MIN(img->header.block_size, disk_size - (uint64_t)block * img->header.block_size);
+    const uint32_t start = _image_block_offset(img, block);
+    size_t in_len = _image_block_offset(img, block + 1) - start;
+    if (in_len == expected) {
+        // Block did not compress, it is stored as is
+        memcpy(dest, img->image + start, expected);
+        return ESP_OK;
+    }
+    size_t out_len = expected;
+    tinfl_init(img->inflator);
+    const tinfl_status status = tinfl_decompress(img->inflator, img->image + start, &in_len, dest, dest, &out_len,
+                                                 TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+    ESP_RETURN_ON_FALSE(status == TINFL_STATUS_DONE && out_len == expected, ESP_ERR_INVALID_CRC, TAG,
+                        "block %lu of image is corrupted", block);
+    return ESP_OK;
+}
+
+/**
+ * @brief Get decompressed block from the LRU cache, decompress it if it is not there
+ */
+static esp_err_t _image_get_block(msc_image_t *img, uint32_t block, const uint8_t **data)
+{
+    msc_image_cache_t *victim = &img->cache[0];
+    img->use_counter++;
+    for (int i = 0; i < img->cache_num; i++) {
+        msc_image_cache_t *entry = &img->cache[i];
+        if (entry->block == block) {
+            entry->last_use = img->use_counter;
+            *data = entry->data;
+            return ESP_OK;
+        }
+        if (entry->last_use < victim->last_use) {
+            victim = entry;
+        }
+    }
+    victim->block = UINT32_MAX;
+    victim->last_use = 0;
+    ESP_RETURN_ON_ERROR(_image_decompress(img, block, victim->data), TAG, "");
+    victim->block = block;
+    victim->last_use = img->use_counter;
+    *data = victim->data;
+    return ESP_OK;
+}
+
+static esp_err_t _read_sector_image(void *ctx, uint32_t lba, uint32_t offset, size_t size, void *dest)
+{
+    msc_image_t *img = (msc_image_t *)ctx;
+    const uint32_t block_size = img->header.block_size;
+    uint64_t addr = (uint64_t)lba * img->header.sector_size + offset;
+    ESP_RETURN_ON_FALSE(addr + size <= (uint64_t)img->header.sector_count * img->header.sector_size,
+                        ESP_ERR_INVALID_SIZE, TAG, "read out of image");
+    uint8_t *out = dest;
+    while (size > 0) {
+        const uint32_t block_offset = addr % block_size;
+        const size_t len = MIN(size, block_size - block_offset);
+        const uint8_t *data;
+        ESP_RETURN_ON_ERROR(_image_get_block(img, addr / block_size, &data), TAG, "");
+        memcpy(out, data + block_offset, len);
+        out += len;
+        addr += len;
+        size -= len;
+    }
+    return ESP_OK;
+}
+
+static void _deinit_image(void *ctx)
+{
+    msc_image_t *img = (msc_image_t *)ctx;
+    for (int i = 0; i < img->cache_num; i++) {
+        free(img->cache[i].data);
+    }
+    free(img->inflator);
+    free(img);
+}
+
+static const tinyusb_msc_storage_backend_t s_image_backend = {
+    .get_sector_count = _get_sector_count_image,
+    .get_sector_size = _get_sector_size_image,
+    .read = _read_sector_image,
+    .deinit = _deinit_image,
+};
+
+/**
+ * @brief Check header and block offsets of compressed image
+ */
+static esp_err_t _image_check(const uint8_t *image, size_t image_size, msc_image_header_t *header)
+{
+    ESP_RETURN_ON_FALSE(image_size >= sizeof(msc_image_header_t), ESP_ERR_INVALID_SIZE, TAG, "image too small");
+    memcpy(header, image, sizeof(msc_image_header_t));
+    ESP_RETURN_ON_FALSE(header->magic == MSC_IMAGE_MAGIC && header->version == MSC_IMAGE_VERSION,
+                        ESP_ERR_INVALID_VERSION, TAG, "not an MSC image");
+    const uint64_t disk_size = (uint64_t)header->sector_count * header->sector_size;
+    ESP_RETURN_ON_FALSE(header->sector_size && header->block_size && header->block_size % header->sector_size == 0 &&
+                        header->block_count == (disk_size + header->block_size - 1) / header->block_size,
+                        ESP_ERR_INVALID_ARG, TAG, "invalid image geometry");
+    const uint64_t table_end = sizeof(msc_image_header_t) + ((uint64_t)header->block_count + 1) * sizeof(uint32_t);
+    ESP_RETURN_ON_FALSE(table_end <= image_size, ESP_ERR_INVALID_SIZE, TAG, "image truncated");
+
+    uint32_t prev = table_end;
+    for (uint32_t i = 0; i <= header->block_count; i++) {
+        uint32_t offset;
+        memcpy(&offset, image + sizeof(msc_image_header_t) + i * sizeof(uint32_t), sizeof(offset));
+        ESP_RETURN_ON_FALSE(offset >= prev && offset <= image_size, ESP_ERR_INVALID_SIZE, TAG, "invalid offset of block %lu", i);
+        prev = offset;
+    }
+    return ESP_OK;
+}
+
+static msc_lun_t *msc_storage_get_lun(uint8_t lun)
+{
+    if (s_storage_handle == NULL || lun >= s_storage_handle->lun_count) {
+        return NULL;
+    }
+    return &s_storage_handle->luns[lun];
+}
+
+static esp_err_t msc_storage_read_sector(msc_lun_t *msc_lun,
+        uint32_t lba,
+        uint32_t offset,
+        size_t size,
+        void *dest)
+{
+    const int64_t start = msc_stats_start();
+    const esp_err_t ret = (msc_lun->backend.read)(msc_lun->ctx, lba, offset, size, dest);
+    msc_stats_media(&msc_lun->stats, TINYUSB_MSC_MEDIA_READ, start);
+    return ret;
+}
+
+static esp_err_t msc_storage_write_sector(msc_lun_t *msc_lun,
+        uint32_t lba,
+        uint32_t offset,
+        size_t size,
+        const void *src)
+{
+    ESP_RETURN_ON_FALSE(msc_lun->backend.write, ESP_ERR_NOT_SUPPORTED, TAG, "storage is read-only");
+    size_t sector_size = (msc_lun->backend.get_sector_size)(msc_lun->ctx);
+    size_t temp = 0;
+    size_t addr = 0; // Address of the data to be read, relative to the beginning of the partition.
+    ESP_RETURN_ON_FALSE(!__builtin_umul_overflow(lba, sector_size, &temp), ESP_ERR_INVALID_SIZE, TAG, "overflow lba %lu sector_size %u", lba, sector_size);
+    ESP_RETURN_ON_FALSE(!__builtin_uadd_overflow(temp, offset, &addr), ESP_ERR_INVALID_SIZE, TAG, "overflow addr %u offset %lu", temp, offset);
+
+    if (addr % sector_size != 0 || size % sector_size != 0) {
+        ESP_LOGE(TAG, "Invalid Argument lba(%lu) offset(%lu) size(%u) sector_size(%u)", lba, offset, size, sector_size);
+        return ESP_ERR_INVALID_ARG;
+    }
+    const int64_t start = msc_stats_start();
+    const esp_err_t ret = (msc_lun->backend.write)(msc_lun->ctx, lba, offset, size, src);
+    msc_stats_media(&msc_lun->stats, TINYUSB_MSC_MEDIA_WRITE, start);
+    return ret;
+}
+
+/**
+ * @brief Set sense data of failed READ10/WRITE10
+ *
+ * @return TinyUSB return value of failed READ10/WRITE10
+ */
+static int32_t msc_storage_io_failed(uint8_t lun, bool write)
+{
+#if CONFIG_TINYUSB_MSC_STATS
+    msc_lun_t *msc_lun = msc_storage_get_lun(lun);
+    if (msc_lun) {
+        portENTER_CRITICAL(&msc_lun->stats.lock);
+        if (write) {
+            msc_lun->stats.data.write_errors++;
+        } else {
+            msc_lun->stats.data.read_errors++;
+        }
+        portEXIT_CRITICAL(&msc_lun->stats.lock);
+    }
+#endif
+    // MEDIUM ERROR, WRITE ERROR or UNRECOVERED READ ERROR
+    tud_msc_set_sense(lun, SCSI_SENSE_MEDIUM_ERROR, write ? 0x0C : 0x11, 0x00);
+    return -1;
+}
+
+#if CONFIG_TINYUSB_MSC_ASYNC_IO
+/**
+ * @brief Storage task executing queued requests of one LUN
+ *
+ * Requests are executed in the order of commands, so reads always see the data of preceding writes.
+ */
+static void msc_async_task(void *arg)
+{
+    msc_async_t *async = (msc_async_t *)arg;
+    msc_async_req_t *req;
+
+    while (xQueueReceive(async->requests, &req, portMAX_DELAY) == pdTRUE && req != NULL) {
+        const esp_err_t err = req->write ?
+                              msc_storage_write_sector(async->lun, req->lba, req->offset, req->size, req->data) :
+                              msc_storage_read_sector(async->lun, req->lba, req->offset, req->size, req->data);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "%s of lun %u lba %lu failed: 0x%x", req->write ? "Write" : "Read", req->lun, req->lba, err);
+        }
+
+        xSemaphoreTake(async->lock, portMAX_DELAY);
+        const bool usb_waiting = req->usb_waiting;
+        const uint32_t usb_len = req->usb_len;
+        req->result = err;
+        req->usb_waiting = false;
+        if (req->write) {
+            // A write-behind error has nobody to report to, the next command fails
+            if (err != ESP_OK && !usb_waiting && async->write_error == ESP_OK) {
+                async->write_error = err;
+            }
+            req->state = MSC_ASYNC_REQ_FREE;
+        } else if (usb_waiting) {
+            if (req->data != req->usb_buf) {
+                memcpy(req->usb_buf, req->data + req->usb_offset, usb_len);
+            }
+            // The rest of the fetched data serves the following READ10 chunks
+            const bool consumed = (err != ESP_OK || req->discard || req->usb_offset + usb_len == req->size);
+            req->state = consumed ? MSC_ASYNC_REQ_FREE : MSC_ASYNC_REQ_DONE;
+        } else {
+            req->state = req->discard ? MSC_ASYNC_REQ_FREE : MSC_ASYNC_REQ_DONE;
+        }
+        xSemaphoreGive(async->lock);
+        xSemaphoreGive(async->progress);
+
+#if MSC_ASYNC_IO_DONE_SUPPORTED
+        if (usb_waiting) {
+            tud_msc_async_io_done(err == ESP_OK ? (int32_t)usb_len : msc_storage_io_failed(req->lun, req->write), false);
+        }
+#endif
+    }
+
+    xSemaphoreGive(async->stopped);
+    vTaskDelete(NULL);
+}
+
+static msc_async_req_t *msc_async_get_free(msc_async_t *async)
+{
+    for (int i = 0; i < MSC_ASYNC_BUF_NUM; i++) {
+        if (async->buf[i].state == MSC_ASYNC_REQ_FREE) {
+            return &async->buf[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Find read request whose data contain the given range
+ */
+static msc_async_req_t *msc_async_find_read(msc_async_t *async, uint64_t addr, uint32_t size)
+{
+    for (int i = 0; i < MSC_ASYNC_BUF_NUM; i++) {
+        msc_async_req_t *req = &async->buf[i];
+        if (req->state != MSC_ASYNC_REQ_FREE && !req->write && !req->discard &&
+                addr >= req->addr && addr + size <= req->addr + req->size) {
+            return req;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Drop read-ahead data, they are not valid after a write or are not requested
+ */
+static void msc_async_discard_reads(msc_async_t *async)
+{
+    for (int i = 0; i < MSC_ASYNC_BUF_NUM; i++) {
+        msc_async_req_t *req = &async->buf[i];
+        if (req->write) {
+            continue;
+        }
+        if (req->state == MSC_ASYNC_REQ_DONE) {
+            req->state = MSC_ASYNC_REQ_FREE;
+        } else if (req->state == MSC_ASYNC_REQ_PENDING) {
+            req->discard = true;
+        }
+    }
+}
+
+static void msc_async_submit(msc_async_t *async, msc_async_req_t *req, bool write, uint8_t lun,
+                             uint32_t lba, uint32_t offset, uint32_t size)
+{
+    const msc_lun_t *msc_lun = async->lun;
+    req->state = MSC_ASYNC_REQ_PENDING;
+    req->lun = lun;
+    req->write = write;
+    req->usb_waiting = false;
+    req->discard = false;
+    req->lba = lba;
+    req->offset = offset;
+    req->addr = (uint64_t)lba * (msc_lun->backend.get_sector_size)(msc_lun->ctx) + offset;
+    req->size = size;
+    req->result = ESP_OK;
+    // The queue holds all requests, it never blocks
+    xQueueSend(async->requests, &req, portMAX_DELAY);
+}
+
+/**
+ * @brief Queue multi-sector read of a whole staging buffer starting at addr, limited by the end of the media
+ *
+ * @param min_size Size that must be read at least, the READ10 chunk
+ */
+static void msc_async_fetch(msc_async_t *async, msc_async_req_t *req, uint8_t lun, uint64_t addr, uint32_t min_size)
+{
+    const msc_lun_t *msc_lun = async->lun;
+    const uint32_t sector_size = (msc_lun->backend.get_sector_size)(msc_lun->ctx);
+    const uint64_t media_size = (uint64_t)(msc_lun->backend.get_sector_count)(msc_lun->ctx) * sector_size;
+    uint32_t size = min_size;
+    if (addr % sector_size == 0) {
+        size = MIN(MSC_ASYNC_BUF_SIZE, media_size - addr) / sector_size * sector_size;
+        size = MAX(size, min_size);
+    }
+    msc_async_submit(async, req, false, lun, addr / sector_size, addr % sector_size, size);
+}
+
+/**
+ * @brief Start reading the data following the given request, if they are within the media and not read yet
+ */
+static void msc_async_read_ahead(msc_async_t *async, uint8_t lun, const msc_async_req_t *prev)
+{
+    const msc_lun_t *msc_lun = async->lun;
+    const uint64_t next = prev->addr + prev->size;
+    const uint64_t media_size = (uint64_t)(msc_lun->backend.get_sector_count)(msc_lun->ctx) *
+                                (msc_lun->backend.get_sector_size)(msc_lun->ctx);
+    if (next + prev->size > media_size || msc_async_find_read(async, next, 1)) {
+        return;
+    }
+    msc_async_req_t *req = msc_async_get_free(async);
+    if (req) {
+        msc_async_fetch(async, req, lun, next, prev->size);
+    }
+}
+
+static int32_t msc_async_read10(msc_lun_t *msc_lun, uint8_t lun, uint32_t lba, uint32_t offset, void *buffer, uint32_t bufsize)
+{
+    msc_async_t *async = msc_lun->async;
+    const uint64_t addr = (uint64_t)lba * (msc_lun->backend.get_sector_size)(msc_lun->ctx) + offset;
+    xSemaphoreTake(async->lock, portMAX_DELAY);
+    if (async->write_error != ESP_OK) {
+        async->write_error = ESP_OK;
+        xSemaphoreGive(async->lock);
+        return msc_storage_io_failed(lun, true);
+    }
+
+    msc_async_req_t *req = msc_async_find_read(async, addr, bufsize);
+    if (req == NULL) {
+        msc_async_discard_reads(async);
+        req = msc_async_get_free(async);
+        if (req) {
+            // Read more than requested, the following READ10 chunks are served from the buffer
+            msc_async_fetch(async, req, lun, addr, bufsize);
+        } else {
+#if MSC_ASYNC_IO_DONE_SUPPORTED
+            // Both buffers hold writes, read directly to TinyUSB buffer after them
+            req = &async->direct;
+            req->data = buffer;
+            msc_async_submit(async, req, false, lun, lba, offset, bufsize);
+#else
+            xSemaphoreGive(async->lock);
+            return 0; // Busy, TinyUSB invokes the callback again
+#endif
+        }
+    }
+
+    const uint32_t buf_offset = addr - req->addr;
+    if (req->state == MSC_ASYNC_REQ_DONE) {
+        const esp_err_t err = req->result;
+        memcpy(buffer, req->data + buf_offset, bufsize);
+        if (buf_offset + bufsize == req->size) {
+            req->state = MSC_ASYNC_REQ_FREE;
+        }
+        if (err == ESP_OK) {
+            msc_async_read_ahead(async, lun, req);
+        } else {
+            req->state = MSC_ASYNC_REQ_FREE;
+        }
+        xSemaphoreGive(async->lock);
+        return err == ESP_OK ? (int32_t)bufsize : msc_storage_io_failed(lun, false);
+    }
+
+#if MSC_ASYNC_IO_DONE_SUPPORTED
+    req->usb_waiting = true;
+    req->usb_buf = buffer;
+    req->usb_offset = buf_offset;
+    req->usb_len = bufsize;
+    if (req != &async->direct) {
+        msc_async_read_ahead(async, lun, req);
+    }
+    xSemaphoreGive(async->lock);
+    return TUD_MSC_RET_ASYNC;
+#else
+    msc_async_read_ahead(async, lun, req);
+    xSemaphoreGive(async->lock);
+    return 0;
+#endif
+}
+
+static int32_t msc_async_write10(msc_lun_t *msc_lun, uint8_t lun, uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t bufsize)
+{
+    msc_async_t *async = msc_lun->async;
+    xSemaphoreTake(async->lock, portMAX_DELAY);
+    if (async->write_error != ESP_OK) {
+        async->write_error = ESP_OK;
+        xSemaphoreGive(async->lock);
+        return msc_storage_io_failed(lun, true);
+    }
+
+    msc_async_discard_reads(async);
+    msc_async_req_t *req = msc_async_get_free(async);
+    if (req == NULL) {
+#if MSC_ASYNC_IO_DONE_SUPPORTED
+        // Write directly from TinyUSB buffer, the command completes after the media access
+        req = &async->direct;
+        req->data = buffer;
+        msc_async_submit(async, req, true, lun, lba, offset, bufsize);
+        req->usb_waiting = true;
+        req->usb_len = bufsize;
+        xSemaphoreGive(async->lock);
+        return TUD_MSC_RET_ASYNC;
+#else
+        xSemaphoreGive(async->lock);
+        return 0; // Busy, TinyUSB invokes the callback again
+#endif
+    }
+
+    // Write-behind: TinyUSB receives the next chunk while this one is written
+    memcpy(req->data, buffer, bufsize);
+    msc_async_submit(async, req, true, lun, lba, offset, bufsize);
+    xSemaphoreGive(async->lock);
+    return bufsize;
+}
+
+/**
+ * @brief Wait until all queued writes reach the media
+ *
+ * @return ESP_OK or the first error of the writes, which is cleared
+ */
+static esp_err_t msc_async_flush(msc_async_t *async)
+{
+    while (true) {
+        bool pending = false;
+        xSemaphoreTake(async->lock, portMAX_DELAY);
+        for (int i = 0; i < MSC_ASYNC_BUF_NUM; i++) {
+            pending |= (async->buf[i].state == MSC_ASYNC_REQ_PENDING && async->buf[i].write);
+        }
+        const esp_err_t err = async->write_error;
+        if (!pending) {
+            async->write_error = ESP_OK;
+        }
+        xSemaphoreGive(async->lock);
+        if (!pending) {
+            return err;
+        }
+        xSemaphoreTake(async->progress, portMAX_DELAY);
+    }
+}
+
+static void msc_async_free(msc_async_t *async)
+{
+    if (async->requests) {
+        vQueueDelete(async->requests);
+    }
+    if (async->lock) {
+        vSemaphoreDelete(async->lock);
+    }
+    if (async->progress) {
+        vSemaphoreDelete(async->progress);
+    }
+    if (async->stopped) {
+        vSemaphoreDelete(async->stopped);
+    }
+    for (int i = 0; i < MSC_ASYNC_BUF_NUM; i++) {
+        heap_caps_free(async->buf[i].data);
+    }
+    free(async);
+}
+
+static esp_err_t msc_async_start(msc_lun_t *msc_lun)
+{
+    esp_err_t ret = ESP_OK;
+    msc_async_t *async = calloc(1, sizeof(msc_async_t));
+    ESP_RETURN_ON_FALSE(async, ESP_ERR_NO_MEM, TAG, "could not allocate storage task context");
+    async->lun = msc_lun;
+    // Each request is queued at most once, with the direct request and the stop request the queue never blocks
+    async->requests = xQueueCreate(MSC_ASYNC_BUF_NUM + 2, sizeof(msc_async_req_t *));
+    async->lock = xSemaphoreCreateMutex();
+    async->progress = xSemaphoreCreateBinary();
+    async->stopped = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(async->requests && async->lock && async->progress && async->stopped, ESP_ERR_NO_MEM, fail, TAG, "could not allocate storage task sync");
+    for (int i = 0; i < MSC_ASYNC_BUF_NUM; i++) {
+        async->buf[i].data = heap_caps_aligned_alloc(MSC_ASYNC_BUF_ALIGN, MSC_ASYNC_BUF_SIZE, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        ESP_GOTO_ON_FALSE(async->buf[i].data, ESP_ERR_NO_MEM, fail, TAG, "could not allocate storage buffers");
+    }
+    xTaskCreatePinnedToCore(msc_async_task, "TinyUSB MSC", CONFIG_TINYUSB_MSC_ASYNC_TASK_STACK_SIZE, async,
+                            CONFIG_TINYUSB_MSC_ASYNC_TASK_PRIORITY, &async->task, tskNO_AFFINITY);
+    ESP_GOTO_ON_FALSE(async->task, ESP_FAIL, fail, TAG, "create storage task failed");
+    msc_lun->async = async;
+    return ESP_OK;
+
+fail:
+    msc_async_free(async);
+    return ret;
+}
+
+static void msc_async_stop(msc_lun_t *msc_lun)
+{
+    msc_async_t *async = msc_lun->async;
+    if (async == NULL) {
+        return;
+    }
+    if (msc_async_flush(async) != ESP_OK) {
+        ESP_LOGW(TAG, "Queued writes failed before deinit");
+    }
+    // Stop request is queued after all pending requests, so they are executed first
+    msc_async_req_t *stop = NULL;
+    xQueueSend(async->requests, &stop, portMAX_DELAY);
+    xSemaphoreTake(async->stopped, portMAX_DELAY);
+    msc_lun->async = NULL;
+    msc_async_free(async);
+}
+#endif // CONFIG_TINYUSB_MSC_ASYNC_IO
+
+/**
+ * @brief Write all data held by the storage layer to the media of the LUN
+ *
+ * @return ESP_OK or the first error of the deferred writes
+ */
+static esp_err_t msc_storage_sync(msc_lun_t *msc_lun)
+{
+    esp_err_t ret = ESP_OK;
+#if CONFIG_TINYUSB_MSC_ASYNC_IO
+    ret = msc_async_flush(msc_lun->async);
+#endif
+    if (msc_lun->backend.sync) {
+        const esp_err_t err = (msc_lun->backend.sync)(msc_lun->ctx);
+        ret = (ret == ESP_OK) ? err : ret;
+    }
+    return ret;
+}
+
+uint32_t tinyusb_msc_storage_get_sector_count(void)
+{
+    assert(s_storage_handle && s_storage_handle->lun_count);
+    msc_lun_t *msc_lun = &s_storage_handle->luns[0];
+    return (msc_lun->backend.get_sector_count)(msc_lun->ctx);
+}
 
-typedef struct {
-    union {
-        wl_handle_t wl_handle;
-#if CONFIG_TINYUSB_MSC_SOC_SDMMC_HOST_ENABLED
-        const sdmmc_card_t *card;
+uint32_t tinyusb_msc_storage_get_sector_size(void)
+{
+    assert(s_storage_handle && s_storage_handle->lun_count);
+    msc_lun_t *msc_lun = &s_storage_handle->luns[0];
+    return (msc_lun->backend.get_sector_size)(msc_lun->ctx);
+}
+
+/* Storage mounted by the application
+   ********************************************************************* */
+
+/**
+ * @brief Write sectors of LUN 0 on behalf of the application
+ *
+ * Read-ahead data of the storage task might be older than the written sectors, they are dropped.
+ */
+static esp_err_t msc_storage_app_write(msc_lun_t *msc_lun, uint32_t lba, size_t size, const void *src)
+{
+    const esp_err_t ret = msc_storage_write_sector(msc_lun, lba, 0, size, src);
+#if CONFIG_TINYUSB_MSC_ASYNC_IO
+    if (msc_lun->async) {
+        xSemaphoreTake(msc_lun->async->lock, portMAX_DELAY);
+        msc_async_discard_reads(msc_lun->async);
+        xSemaphoreGive(msc_lun->async->lock);
+    }
 #endif
-    };
-    uint32_t (*sector_count)(void);
-    uint32_t (*sector_size)(void);
-    esp_err_t (*read)(size_t sector_size, uint32_t lba, uint32_t offset, size_t size, void *dest);
-    esp_err_t (*write)(size_t sector_size, size_t addr, uint32_t lba, uint32_t offset, size_t size, const void *src);
-    tusb_msc_callback_t callback_mount_changed;
-    tusb_msc_callback_t callback_premount_changed;
-    int max_files;
-} tinyusb_msc_storage_handle_s; /*!< MSC object */
+    return ret;
+}
 
-/* handle of tinyusb driver connected to application */
-static tinyusb_msc_storage_handle_s *s_storage_handle;
+static DSTATUS msc_diskio_status(BYTE pdrv)
+{
+    (void) pdrv;
+    // Without STA_NOINIT FatFS reuses the mounted volume and its caches
+    return (s_storage_handle && s_storage_handle->is_fat_mounted) ? 0 : STA_NOINIT;
+}
 
-static uint32_t _get_sector_count_spiflash(void)
+static DRESULT msc_diskio_read(BYTE pdrv, BYTE *buff, uint32_t sector, UINT count)
 {
-    uint32_t result = 0;
-    assert(s_storage_handle->wl_handle != WL_INVALID_HANDLE);
-    size_t size = wl_sector_size(s_storage_handle->wl_handle);
-    if (size == 0) {
-        ESP_LOGW(TAG, "WL Sector size is zero !!!");
-        result = 0;
-    } else {
-        result = (uint32_t)(wl_size(s_storage_handle->wl_handle) / size);
+    msc_lun_t *msc_lun = msc_storage_get_lun(0);
+    if (msc_diskio_status(pdrv) != 0 || msc_lun == NULL) {
+        return RES_NOTRDY;
     }
-    return result;
+    const size_t sector_size = (msc_lun->backend.get_sector_size)(msc_lun->ctx);
+    return msc_storage_read_sector(msc_lun, sector, 0, count * sector_size, buff) == ESP_OK ? RES_OK : RES_ERROR;
 }
 
-static uint32_t _get_sector_size_spiflash(void)
+static DRESULT msc_diskio_write(BYTE pdrv, const BYTE *buff, uint32_t sector, UINT count)
 {
-    assert(s_storage_handle->wl_handle != WL_INVALID_HANDLE);
-    return (uint32_t)wl_sector_size(s_storage_handle->wl_handle);
+    msc_lun_t *msc_lun = msc_storage_get_lun(0);
+    if (msc_diskio_status(pdrv) != 0 || msc_lun == NULL) {
+        return RES_NOTRDY;
+    }
+    if (msc_lun->backend.write == NULL) {
+        return RES_WRPRT;
+    }
+    const size_t sector_size = (msc_lun->backend.get_sector_size)(msc_lun->ctx);
+    return msc_storage_app_write(msc_lun, sector, count * sector_size, buff) == ESP_OK ? RES_OK : RES_ERROR;
 }
 
-static esp_err_t _read_sector_spiflash(size_t sector_size,
-                                       uint32_t lba,
-                                       uint32_t offset,
-                                       size_t size,
-                                       void *dest)
+static DRESULT msc_diskio_ioctl(BYTE pdrv, BYTE cmd, void *buff)
 {
-    size_t temp = 0;
-    size_t addr = 0; // Address of the data to be read, relative to the beginning of the partition.
-    ESP_RETURN_ON_FALSE(!__builtin_umul_overflow(lba, sector_size, &temp), ESP_ERR_INVALID_SIZE, TAG, "overflow lba %lu sector_size %u", lba, sector_size);
-    ESP_RETURN_ON_FALSE(!__builtin_uadd_overflow(temp, offset, &addr), ESP_ERR_INVALID_SIZE, TAG, "overflow addr %u offset %lu", temp, offset);
-    return wl_read(s_storage_handle->wl_handle, addr, dest, size);
+    msc_lun_t *msc_lun = msc_storage_get_lun(0);
+    if (msc_lun == NULL) {
+        return RES_NOTRDY;
+    }
+    switch (cmd) {
+    case CTRL_SYNC:
+        return msc_storage_sync(msc_lun) == ESP_OK ? RES_OK : RES_ERROR;
+    case GET_SECTOR_COUNT:
+        *((DWORD *) buff) = (msc_lun->backend.get_sector_count)(msc_lun->ctx);
+        return RES_OK;
+    case GET_SECTOR_SIZE:
+        *((WORD *) buff) = (msc_lun->backend.get_sector_size)(msc_lun->ctx);
+        return RES_OK;
+    case GET_BLOCK_SIZE:
+        *((DWORD *) buff) = 1;
+        return RES_OK;
+    default:
+        return RES_PARERR;
+    }
 }
 
-static esp_err_t _write_sector_spiflash(size_t sector_size,
-                                        size_t addr,
-                                        uint32_t lba,
-                                        uint32_t offset,
-                                        size_t size,
-                                        const void *src)
+static const ff_diskio_impl_t s_msc_diskio = {
+    .init = msc_diskio_status,
+    .status = msc_diskio_status,
+    .read = msc_diskio_read,
+    .write = msc_diskio_write,
+    .ioctl = msc_diskio_ioctl,
+};
+
+static void msc_mount_changed(tinyusb_msc_event_type_t type, bool is_mounted)
 {
-    ESP_RETURN_ON_ERROR(wl_erase_range(s_storage_handle->wl_handle, addr, size),
-                        TAG, "Failed to erase");
-    return wl_write(s_storage_handle->wl_handle, addr, src, size);
+    tusb_msc_callback_t cb = (type == TINYUSB_MSC_EVENT_MOUNT_CHANGED) ?
+                             s_storage_handle->callback_mount_changed : s_storage_handle->callback_premount_changed;
+    if (cb) {
+        tinyusb_msc_event_t event = {
+            .type = type,
+            .mount_changed_data = {
+                .is_mounted = is_mounted,
+            },
+        };
+        cb(&event);
+    }
 }
 
-#if CONFIG_TINYUSB_MSC_SOC_SDMMC_HOST_ENABLED
+/**
+ * @brief Unmount FatFS of LUN 0 and unregister it from VFS and diskio
+ */
+static void msc_fat_release(void)
+{
+    const char drv[3] = {(char)('0' + s_storage_handle->pdrv), ':', 0};
+    f_mount(NULL, drv, 0);
+    ff_diskio_unregister(s_storage_handle->pdrv);
+    esp_vfs_fat_unregister_path(s_storage_handle->base_path);
+    free(s_storage_handle->base_path);
+    s_storage_handle->base_path = NULL;
+    s_storage_handle->fs = NULL;
+}
 
-static uint32_t _get_sector_count_sdmmc(void)
+static esp_err_t msc_fat_format(const char *drv)
 {
-    assert(s_storage_handle->card);
-    return (uint32_t)s_storage_handle->card->csd.capacity;
+    msc_lun_t *msc_lun = msc_storage_get_lun(0);
+    const size_t sector_size = (msc_lun->backend.get_sector_size)(msc_lun->ctx);
+    const size_t workbuf_size = MAX(FF_MAX_SS, sector_size);
+    void *workbuf = malloc(workbuf_size);
+    ESP_RETURN_ON_FALSE(workbuf, ESP_ERR_NO_MEM, TAG, "could not allocate format buffer");
+    const size_t alloc_unit_size = esp_vfs_fat_get_allocation_unit_size(sector_size, s_storage_handle->allocation_unit_size);
+    const MKFS_PARM opt = {(BYTE)(FM_ANY | FM_SFD), 0, 0, 0, alloc_unit_size};
+    const FRESULT res = f_mkfs(drv, &opt, workbuf, workbuf_size);
+    free(workbuf);
+    ESP_RETURN_ON_FALSE(res == FR_OK, ESP_FAIL, TAG, "f_mkfs failed (%d)", res);
+    return ESP_OK;
 }
 
-static uint32_t _get_sector_size_sdmmc(void)
+/**
+ * @brief Register FatFS of LUN 0 at base_path and mount it
+ */
+static esp_err_t msc_fat_register(const char *base_path)
 {
-    assert(s_storage_handle->card);
-    return (uint32_t)s_storage_handle->card->csd.sector_size;
+    esp_err_t ret = ESP_OK;
+    ESP_RETURN_ON_ERROR(ff_diskio_get_drive(&s_storage_handle->pdrv), TAG, "the maximum count of volumes is already mounted");
+    const char drv[3] = {(char)('0' + s_storage_handle->pdrv), ':', 0};
+    ff_diskio_register(s_storage_handle->pdrv, &s_msc_diskio);
+    s_storage_handle->base_path = strdup(base_path);
+    ESP_GOTO_ON_FALSE(s_storage_handle->base_path, ESP_ERR_NO_MEM, fail_diskio, TAG, "could not allocate base path");
+    ESP_GOTO_ON_ERROR(esp_vfs_fat_register(base_path, drv, s_storage_handle->max_files, &s_storage_handle->fs),
+                      fail_diskio, TAG, "esp_vfs_fat_register failed");
+
+    FRESULT res = f_mount(s_storage_handle->fs, drv, 1);
+    if (res == FR_NO_FILESYSTEM && s_storage_handle->format_if_mount_failed) {
+        ESP_LOGW(TAG, "Failed to mount storage (%d), formatting", res);
+        ESP_GOTO_ON_ERROR(msc_fat_format(drv), fail, TAG, "");
+        res = f_mount(s_storage_handle->fs, drv, 1);
+    }
+    ESP_GOTO_ON_FALSE(res == FR_OK, ESP_FAIL, fail, TAG, "Failed to mount storage (%d)", res);
+    return ESP_OK;
+
+fail:
+    msc_fat_release();
+    return ret;
+
+fail_diskio:
+    ff_diskio_unregister(s_storage_handle->pdrv);
+    free(s_storage_handle->base_path);
+    s_storage_handle->base_path = NULL;
+    s_storage_handle->fs = NULL;
+    return ret;
 }
 
-static esp_err_t _read_sector_sdmmc(size_t sector_size,
-                                    uint32_t lba,
-                                    uint32_t offset,
-                                    size_t size,
-                                    void *dest)
+esp_err_t tinyusb_msc_storage_config_switch(const tinyusb_msc_storage_switch_config_t *config)
 {
-    return sdmmc_read_sectors(s_storage_handle->card, dest, lba, size / sector_size);
+    esp_err_t ret = ESP_OK;
+    ESP_RETURN_ON_FALSE(config, ESP_ERR_INVALID_ARG, TAG, "config is NULL");
+    ESP_RETURN_ON_FALSE(s_storage_handle && s_storage_handle->lun_count, ESP_ERR_INVALID_STATE, TAG, "storage is not initialized");
+    msc_lun_t *msc_lun = &s_storage_handle->luns[0];
+    const uint32_t sector_count = (msc_lun->backend.get_sector_count)(msc_lun->ctx);
+    const size_t sector_size = (msc_lun->backend.get_sector_size)(msc_lun->ctx);
+    if (config->log_sector_count) {
+        ESP_RETURN_ON_FALSE(msc_lun->backend.write, ESP_ERR_NOT_SUPPORTED, TAG, "storage is read-only");
+        ESP_RETURN_ON_FALSE(config->log_first_sector < sector_count &&
+                            config->log_sector_count <= sector_count - config->log_first_sector &&
+                            config->log_offset <= (uint64_t)config->log_sector_count * sector_size,
+                            ESP_ERR_INVALID_ARG, TAG, "log region out of the media");
+    }
+
+    xSemaphoreTake(s_storage_handle->switch_lock, portMAX_DELAY);
+    msc_log_t *log = &s_storage_handle->log;
+    heap_caps_free(log->tail);
+    memset(log, 0, sizeof(msc_log_t));
+    s_storage_handle->keep_fs_cache = config->keep_fs_cache;
+    if (config->log_sector_count) {
+        // Appends rewrite the partially filled sector, it is read once here
+        log->tail = heap_caps_malloc(sector_size, MALLOC_CAP_DMA);
+        ESP_GOTO_ON_FALSE(log->tail, ESP_ERR_NO_MEM, exit, TAG, "could not allocate log buffer");
+        log->pos = config->log_offset;
+        const uint64_t pos_sector = log->pos / sector_size;
+        if (log->pos % sector_size) {
+            ESP_GOTO_ON_ERROR(msc_storage_read_sector(msc_lun, config->log_first_sector + pos_sector, 0, sector_size, log->tail),
+                              fail, TAG, "could not read log tail");
+        } else {
+            memset(log->tail, 0, sector_size);
+        }
+        log->first_sector = config->log_first_sector;
+        log->sector_count = config->log_sector_count;
+    }
+    goto exit;
+
+fail:
+    heap_caps_free(log->tail);
+    memset(log, 0, sizeof(msc_log_t));
+exit:
+    xSemaphoreGive(s_storage_handle->switch_lock);
+    return ret;
 }
 
-static esp_err_t _write_sector_sdmmc(size_t sector_size,
-                                     size_t addr,
-                                     uint32_t lba,
-                                     uint32_t offset,
-                                     size_t size,
-                                     const void *src)
+esp_err_t tinyusb_msc_storage_log_write(const void *data, size_t size)
 {
-    return sdmmc_write_sectors(s_storage_handle->card, src, lba, size / sector_size);
+    esp_err_t ret = ESP_OK;
+    ESP_RETURN_ON_FALSE(data || size == 0, ESP_ERR_INVALID_ARG, TAG, "data is NULL");
+    ESP_RETURN_ON_FALSE(s_storage_handle && s_storage_handle->lun_count, ESP_ERR_INVALID_STATE, TAG, "storage is not initialized");
+    msc_lun_t *msc_lun = &s_storage_handle->luns[0];
+    const size_t sector_size = (msc_lun->backend.get_sector_size)(msc_lun->ctx);
+
+    xSemaphoreTake(s_storage_handle->switch_lock, portMAX_DELAY);
+    msc_log_t *log = &s_storage_handle->log;
+    ESP_GOTO_ON_FALSE(log->sector_count, ESP_ERR_INVALID_STATE, exit, TAG, "no log region");
+    ESP_GOTO_ON_FALSE(size <= (uint64_t)log->sector_count * sector_size - log->pos, ESP_ERR_INVALID_SIZE, exit, TAG, "log region is full");
+
+    const uint8_t *src = (const uint8_t *)data;
+    while (size) {
+        const uint32_t lba = log->first_sector + log->pos / sector_size;
+        const size_t tail_len = log->pos % sector_size;
+        if (tail_len == 0 && size >= sector_size) {
+            // Whole sectors are written from the caller's buffer
+            const size_t len = size / sector_size * sector_size;
+            ESP_GOTO_ON_ERROR(msc_storage_app_write(msc_lun, lba, len, src), exit, TAG, "log write failed");
+            src += len;
+            size -= len;
+            log->pos += len;
+            continue;
+        }
+        const size_t len = MIN(sector_size - tail_len, size);
+        memcpy(log->tail + tail_len, src, len);
+        ESP_GOTO_ON_ERROR(msc_storage_app_write(msc_lun, lba, sector_size, log->tail), exit, TAG, "log write failed");
+        src += len;
+        size -= len;
+        log->pos += len;
+        if (log->pos % sector_size == 0) {
+            memset(log->tail, 0, sector_size);
+        }
+    }
+
+exit:
+    xSemaphoreGive(s_storage_handle->switch_lock);
+    return ret;
 }
-#endif
 
-static esp_err_t msc_storage_read_sector(uint32_t lba,
-        uint32_t offset,
-        size_t size,
-        void *dest)
+esp_err_t tinyusb_msc_storage_mount(const char *base_path)
 {
-    assert(s_storage_handle);
-    size_t sector_size = tinyusb_msc_storage_get_sector_size();
-    return (s_storage_handle->read)(sector_size, lba, offset, size, dest);
+    esp_err_t ret = ESP_OK;
+    ESP_RETURN_ON_FALSE(base_path, ESP_ERR_INVALID_ARG, TAG, "base_path is NULL");
+    ESP_RETURN_ON_FALSE(s_storage_handle && s_storage_handle->lun_count, ESP_ERR_INVALID_STATE, TAG, "storage is not initialized");
+    xSemaphoreTake(s_storage_handle->switch_lock, portMAX_DELAY);
+    if (s_storage_handle->is_fat_mounted) {
+        goto exit;
+    }
+    msc_mount_changed(TINYUSB_MSC_EVENT_PREMOUNT_CHANGED, false);
+
+    msc_lun_t *msc_lun = &s_storage_handle->luns[0];
+    // The host sees no medium from now on, its writes must reach the media before FatFS reads it
+    s_storage_handle->is_fat_mounted = true;
+    if (msc_storage_sync(msc_lun) != ESP_OK) {
+        ESP_LOGW(TAG, "Deferred writes of the host failed");
+    }
+
+    if (s_storage_handle->fs && strcmp(s_storage_handle->base_path, base_path) != 0) {
+        msc_fat_release();
+    }
+    if (s_storage_handle->fs == NULL) {
+        ret = msc_fat_register(base_path);
+    } else if (msc_lun->write_gen != s_storage_handle->expose_write_gen) {
+        // The host changed the media, cached FAT and directory sectors are stale
+        const char drv[3] = {(char)('0' + s_storage_handle->pdrv), ':', 0};
+        const FRESULT res = f_mount(s_storage_handle->fs, drv, 1);
+        if (res != FR_OK) {
+            ESP_LOGE(TAG, "Failed to mount storage (%d)", res);
+            msc_fat_release();
+            ret = ESP_FAIL;
+        }
+    }
+    // else: Nothing was written by the host while it had the storage, FatFS continues with its caches
+
+    if (ret != ESP_OK) {
+        s_storage_handle->is_fat_mounted = false;
+    }
+    msc_mount_changed(TINYUSB_MSC_EVENT_MOUNT_CHANGED, s_storage_handle->is_fat_mounted);
+exit:
+    xSemaphoreGive(s_storage_handle->switch_lock);
+    return ret;
 }
 
-static esp_err_t msc_storage_write_sector(uint32_t lba,
-        uint32_t offset,
-        size_t size,
-        const void *src)
+esp_err_t tinyusb_msc_storage_unmount(void)
 {
-    assert(s_storage_handle);
-    size_t sector_size = tinyusb_msc_storage_get_sector_size();
-    size_t temp = 0;
-    size_t addr = 0; // Address of the data to be read, relative to the beginning of the partition.
-    ESP_RETURN_ON_FALSE(!__builtin_umul_overflow(lba, sector_size, &temp), ESP_ERR_INVALID_SIZE, TAG, "overflow lba %lu sector_size %u", lba, sector_size);
-    ESP_RETURN_ON_FALSE(!__builtin_uadd_overflow(temp, offset, &addr), ESP_ERR_INVALID_SIZE, TAG, "overflow addr %u offset %lu", temp, offset);
+    esp_err_t ret = ESP_OK;
+    ESP_RETURN_ON_FALSE(s_storage_handle && s_storage_handle->lun_count, ESP_ERR_INVALID_STATE, TAG, "storage is not initialized");
+    xSemaphoreTake(s_storage_handle->switch_lock, portMAX_DELAY);
+    ESP_GOTO_ON_FALSE(s_storage_handle->is_fat_mounted, ESP_ERR_INVALID_STATE, exit, TAG, "storage is not mounted");
+    msc_mount_changed(TINYUSB_MSC_EVENT_PREMOUNT_CHANGED, true);
 
-    if (addr % sector_size != 0 || size % sector_size != 0) {
-        ESP_LOGE(TAG, "Invalid Argument lba(%lu) offset(%lu) size(%u) sector_size(%u)", lba, offset, size, sector_size);
-        return ESP_ERR_INVALID_ARG;
+    msc_lun_t *msc_lun = &s_storage_handle->luns[0];
+    if (msc_storage_sync(msc_lun) != ESP_OK) {
+        ESP_LOGW(TAG, "Sync of the storage failed");
+    }
+    if (!s_storage_handle->keep_fs_cache) {
+        msc_fat_release();
     }
-    return (s_storage_handle->write)(sector_size, addr, lba, offset, size, src);
+    s_storage_handle->expose_write_gen = msc_lun->write_gen;
+    s_storage_handle->is_fat_mounted = false;
+
+    msc_mount_changed(TINYUSB_MSC_EVENT_MOUNT_CHANGED, false);
+exit:
+    xSemaphoreGive(s_storage_handle->switch_lock);
+    return ret;
 }
 
-uint32_t tinyusb_msc_storage_get_sector_count(void)
+bool tinyusb_msc_storage_in_use_by_usb_host(void)
 {
-    assert(s_storage_handle);
-    return (s_storage_handle->sector_count)();
+    return s_storage_handle && !s_storage_handle->is_fat_mounted;
 }
 
-uint32_t tinyusb_msc_storage_get_sector_size(void)
+uint32_t tinyusb_msc_storage_get_write_generation(uint8_t lun)
 {
-    assert(s_storage_handle);
-    return (s_storage_handle->sector_size)();
+    msc_lun_t *msc_lun = msc_storage_get_lun(lun);
+    return msc_lun ? msc_lun->write_gen : 0;
 }
+/*********************************************************************** Storage mounted by the application*/
 
-esp_err_t tinyusb_msc_storage_init_spiflash(const tinyusb_msc_spiflash_config_t *config)
+/**
+ * @brief Allocate storage handle and set it up from the common part of the configurations
+ */
+static esp_err_t msc_storage_new(const esp_vfs_fat_mount_config_t *mount_config,
+                                 tusb_msc_callback_t callback_mount_changed,
+                                 tusb_msc_callback_t callback_premount_changed)
 {
     assert(!s_storage_handle);
-    s_storage_handle = (tinyusb_msc_storage_handle_s *)malloc(sizeof(tinyusb_msc_storage_handle_s));
+    s_storage_handle = (tinyusb_msc_storage_handle_s *)calloc(1, sizeof(tinyusb_msc_storage_handle_s));
     ESP_RETURN_ON_FALSE(s_storage_handle, ESP_ERR_NO_MEM, TAG, "could not allocate new handle for storage");
-    s_storage_handle->sector_count = &_get_sector_count_spiflash;
-    s_storage_handle->sector_size = &_get_sector_size_spiflash;
-    s_storage_handle->read = &_read_sector_spiflash;
-    s_storage_handle->write = &_write_sector_spiflash;
-    s_storage_handle->wl_handle = config->wl_handle;
     // In case the user does not set mount_config.max_files
     // and for backward compatibility with versions <1.4.2
     // max_files is set to 2
-    const int max_files = config->mount_config.max_files;
+    const int max_files = mount_config->max_files;
     s_storage_handle->max_files = max_files > 0 ? max_files : 2;
+    s_storage_handle->format_if_mount_failed = mount_config->format_if_mount_failed;
+    s_storage_handle->allocation_unit_size = mount_config->allocation_unit_size;
+    s_storage_handle->switch_lock = xSemaphoreCreateMutex();
+    if (s_storage_handle->switch_lock == NULL) {
+        free(s_storage_handle);
+        s_storage_handle = NULL;
+        ESP_LOGE(TAG, "could not allocate storage lock");
+        return ESP_ERR_NO_MEM;
+    }
 
     /* Callbacks setting up*/
-    if (config->callback_mount_changed) {
-        tinyusb_msc_register_callback(TINYUSB_MSC_EVENT_MOUNT_CHANGED, config->callback_mount_changed);
+    if (callback_mount_changed) {
+        tinyusb_msc_register_callback(TINYUSB_MSC_EVENT_MOUNT_CHANGED, callback_mount_changed);
     } else {
         tinyusb_msc_unregister_callback(TINYUSB_MSC_EVENT_MOUNT_CHANGED);
     }
-    if (config->callback_premount_changed) {
-        tinyusb_msc_register_callback(TINYUSB_MSC_EVENT_PREMOUNT_CHANGED, config->callback_premount_changed);
+    if (callback_premount_changed) {
+        tinyusb_msc_register_callback(TINYUSB_MSC_EVENT_PREMOUNT_CHANGED, callback_premount_changed);
     } else {
         tinyusb_msc_unregister_callback(TINYUSB_MSC_EVENT_PREMOUNT_CHANGED);
     }
+    return ESP_OK;
+}
+
+esp_err_t tinyusb_msc_storage_add_lun(const tinyusb_msc_storage_backend_t *backend, void *ctx, uint8_t *lun)
+{
+    ESP_RETURN_ON_FALSE(backend && backend->get_sector_count && backend->get_sector_size && backend->read,
+                        ESP_ERR_INVALID_ARG, TAG, "invalid backend");
+    ESP_RETURN_ON_FALSE(s_storage_handle, ESP_ERR_INVALID_STATE, TAG, "storage is not initialized");
+    ESP_RETURN_ON_FALSE(s_storage_handle->lun_count < CONFIG_TINYUSB_MSC_LUN_MAX, ESP_ERR_NO_MEM, TAG, "no free LUN");
+
+    msc_lun_t *msc_lun = &s_storage_handle->luns[s_storage_handle->lun_count];
+    msc_lun->backend = *backend;
+    msc_lun->ctx = ctx;
+#if CONFIG_TINYUSB_MSC_STATS
+    portMUX_INITIALIZE(&msc_lun->stats.lock);
+    memset(&msc_lun->stats.data, 0, sizeof(msc_lun->stats.data));
+#endif
+#if CONFIG_TINYUSB_MSC_ASYNC_IO
+    ESP_RETURN_ON_ERROR(msc_async_start(msc_lun), TAG, "could not start storage task");
+#endif
+    if (lun) {
+        *lun = s_storage_handle->lun_count;
+    }
+    s_storage_handle->lun_count++;
+    return ESP_OK;
+}
 
+esp_err_t tinyusb_msc_storage_add_lun_spiflash(wl_handle_t wl_handle, uint8_t *lun)
+{
+    msc_spiflash_t *flash = NULL;
+    ESP_RETURN_ON_ERROR(_create_spiflash(wl_handle, &flash), TAG, "");
+    const esp_err_t ret = tinyusb_msc_storage_add_lun(&s_spiflash_backend, flash, lun);
+    if (ret != ESP_OK) {
+        _deinit_spiflash(flash);
+        return ret;
+    }
+#if CONFIG_TINYUSB_MSC_STATS
+    flash->stats = &s_storage_handle->luns[s_storage_handle->lun_count - 1].stats;
+#endif
     return ESP_OK;
 }
 
 #if CONFIG_TINYUSB_MSC_SOC_SDMMC_HOST_ENABLED
-esp_err_t tinyusb_msc_storage_init_sdmmc(const tinyusb_msc_sdmmc_config_t *config)
+esp_err_t tinyusb_msc_storage_add_lun_sdmmc(const sdmmc_card_t *card, uint8_t *lun)
 {
-    assert(!s_storage_handle);
-    s_storage_handle = (tinyusb_msc_storage_handle_s *)malloc(sizeof(tinyusb_msc_storage_handle_s));
-    ESP_RETURN_ON_FALSE(s_storage_handle, ESP_ERR_NO_MEM, TAG, "could not allocate new handle for storage");
-    s_storage_handle->sector_count = &_get_sector_count_sdmmc;
-    s_storage_handle->sector_size = &_get_sector_size_sdmmc;
-    s_storage_handle->read = &_read_sector_sdmmc;
-    s_storage_handle->write = &_write_sector_sdmmc;
-    s_storage_handle->card = config->card;
-    // In case the user does not set mount_config.max_files
-    // and for backward compatibility with versions <1.4.2
-    // max_files is set to 2
-    const int max_files = config->mount_config.max_files;
-    s_storage_handle->max_files = max_files > 0 ? max_files : 2;
+    ESP_RETURN_ON_FALSE(card, ESP_ERR_INVALID_ARG, TAG, "card is NULL");
+    return tinyusb_msc_storage_add_lun(&s_sdmmc_backend, (void *)card, lun);
+}
+#endif
 
-    /* Callbacks setting up*/
-    if (config->callback_mount_changed) {
-        tinyusb_msc_register_callback(TINYUSB_MSC_EVENT_MOUNT_CHANGED, config->callback_mount_changed);
-    } else {
-        tinyusb_msc_unregister_callback(TINYUSB_MSC_EVENT_MOUNT_CHANGED);
-    }
-    if (config->callback_premount_changed) {
-        tinyusb_msc_register_callback(TINYUSB_MSC_EVENT_PREMOUNT_CHANGED, config->callback_premount_changed);
-    } else {
-        tinyusb_msc_unregister_callback(TINYUSB_MSC_EVENT_PREMOUNT_CHANGED);
+esp_err_t tinyusb_msc_storage_add_lun_ramdisk(const tinyusb_msc_ramdisk_config_t *config, uint8_t *lun)
+{
+    esp_err_t ret = ESP_OK;
+    ESP_RETURN_ON_FALSE(config && config->sector_count && config->sector_size, ESP_ERR_INVALID_ARG, TAG, "invalid ramdisk geometry");
+    msc_ramdisk_t *disk = calloc(1, sizeof(msc_ramdisk_t));
+    ESP_RETURN_ON_FALSE(disk, ESP_ERR_NO_MEM, TAG, "could not allocate ramdisk");
+    disk->sector_count = config->sector_count;
+    disk->sector_size = config->sector_size;
+    disk->data = config->buffer;
+    if (disk->data == NULL) {
+        const uint32_t caps = config->heap_caps ? config->heap_caps : MALLOC_CAP_DEFAULT;
+        disk->data = heap_caps_calloc(config->sector_count, config->sector_size, caps);
+        disk->owned = true;
+        ESP_GOTO_ON_FALSE(disk->data, ESP_ERR_NO_MEM, fail, TAG, "could not allocate ramdisk memory");
     }
+    ESP_GOTO_ON_ERROR(tinyusb_msc_storage_add_lun(&s_ramdisk_backend, disk, lun), fail, TAG, "");
+    return ESP_OK;
+
+fail:
+    _deinit_ramdisk(disk);
+    return ret;
+}
+
+esp_err_t tinyusb_msc_storage_add_lun_image(const tinyusb_msc_image_config_t *config, uint8_t *lun)
+{
+    esp_err_t ret = ESP_OK;
+    msc_image_header_t header;
+    ESP_RETURN_ON_FALSE(config && config->image, ESP_ERR_INVALID_ARG, TAG, "image is NULL");
+    ESP_RETURN_ON_ERROR(_image_check(config->image, config->image_size, &header), TAG, "");
 
+    const uint8_t cache_num = config->cache_blocks ? config->cache_blocks : MSC_IMAGE_CACHE_BLOCKS;
+    msc_image_t *img = calloc(1, sizeof(msc_image_t) + cache_num * sizeof(msc_image_cache_t));
+    ESP_RETURN_ON_FALSE(img, ESP_ERR_NO_MEM, TAG, "could not allocate image");
+    img->image = config->image;
+    img->header = header;
+    img->cache_num = cache_num;
+    img->inflator = malloc(sizeof(tinfl_decompressor));
+    ESP_GOTO_ON_FALSE(img->inflator, ESP_ERR_NO_MEM, fail, TAG, "could not allocate decompressor");
+    for (int i = 0; i < cache_num; i++) {
+        img->cache[i].block = UINT32_MAX;
+        img->cache[i].data = malloc(header.block_size);
+        ESP_GOTO_ON_FALSE(img->cache[i].data, ESP_ERR_NO_MEM, fail, TAG, "could not allocate image cache");
+    }
+    ESP_GOTO_ON_ERROR(tinyusb_msc_storage_add_lun(&s_image_backend, img, lun), fail, TAG, "");
     return ESP_OK;
+
+fail:
+    _deinit_image(img);
+    return ret;
+}
+
+esp_err_t tinyusb_msc_storage_init_spiflash(const tinyusb_msc_spiflash_config_t *config)
+{
+    ESP_RETURN_ON_ERROR(msc_storage_new(&config->mount_config, config->callback_mount_changed, config->callback_premount_changed),
+                        TAG, "");
+    const esp_err_t ret = tinyusb_msc_storage_add_lun_spiflash(config->wl_handle, NULL);
+    if (ret != ESP_OK) {
+        tinyusb_msc_storage_deinit();
+    }
+    return ret;
+}
+
+#if CONFIG_TINYUSB_MSC_SOC_SDMMC_HOST_ENABLED
+esp_err_t tinyusb_msc_storage_init_sdmmc(const tinyusb_msc_sdmmc_config_t *config)
+{
+    ESP_RETURN_ON_ERROR(msc_storage_new(&config->mount_config, config->callback_mount_changed, config->callback_premount_changed),
+                        TAG, "");
+    const esp_err_t ret = tinyusb_msc_storage_add_lun_sdmmc(config->card, NULL);
+    if (ret != ESP_OK) {
+        tinyusb_msc_storage_deinit();
+    }
+    return ret;
 }
 #endif
 
 void tinyusb_msc_storage_deinit(void)
 {
     assert(s_storage_handle);
+    if (s_storage_handle->fs) {
+        msc_fat_release();
+    }
+    heap_caps_free(s_storage_handle->log.tail);
+    vSemaphoreDelete(s_storage_handle->switch_lock);
+    for (int i = 0; i < s_storage_handle->lun_count; i++) {
+        msc_lun_t *msc_lun = &s_storage_handle->luns[i];
+#if CONFIG_TINYUSB_MSC_ASYNC_IO
+        msc_async_stop(msc_lun);
+#endif
+        if (msc_lun->backend.deinit) {
+            (msc_lun->backend.deinit)(msc_lun->ctx);
+        } else if (msc_lun->backend.sync && (msc_lun->backend.sync)(msc_lun->ctx) != ESP_OK) {
+            ESP_LOGE(TAG, "Sync of lun %d failed before deinit", i);
+        }
+    }
     free(s_storage_handle);
     s_storage_handle = NULL;
 }
@@ -265,6 +1684,87 @@ esp_err_t tinyusb_msc_unregister_callback(tinyusb_msc_event_type_t event_type)
     }
 }
 
+esp_err_t tinyusb_msc_storage_get_stats(uint8_t lun, tinyusb_msc_storage_stats_t *stats, bool reset)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "stats can't be NULL");
+#if CONFIG_TINYUSB_MSC_STATS
+    msc_lun_t *msc_lun = msc_storage_get_lun(lun);
+    ESP_RETURN_ON_FALSE(msc_lun, ESP_ERR_INVALID_ARG, TAG, "no lun %u", lun);
+    portENTER_CRITICAL(&msc_lun->stats.lock);
+    *stats = msc_lun->stats.data;
+    if (reset) {
+        memset(&msc_lun->stats.data, 0, sizeof(msc_lun->stats.data));
+    }
+    portEXIT_CRITICAL(&msc_lun->stats.lock);
+    return ESP_OK;
+#else
+    (void) lun;
+    (void) reset;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif // CONFIG_TINYUSB_MSC_STATS
+}
+
+#if CONFIG_TINYUSB_MSC_STATS_CONSOLE
+static void msc_stats_print_hist(const char *name, const tinyusb_msc_latency_hist_t *hist)
+{
+    uint32_t count = 0;
+    for (int i = 0; i < TINYUSB_MSC_LATENCY_BUCKETS; i++) {
+        count += hist->count[i];
+    }
+    if (count == 0) {
+        return;
+    }
+    printf("  %-5s %8lu ops, avg %lu us, max %lu us\n", name, (unsigned long)count,
+           (unsigned long)(hist->total_us / count), (unsigned long)hist->max_us);
+    for (int i = 0; i < TINYUSB_MSC_LATENCY_BUCKETS; i++) {
+        if (hist->count[i]) {
+            if (i < TINYUSB_MSC_LATENCY_BUCKETS - 1) {
+                printf("    < %8lu us: %lu\n", 32UL << i, (unsigned long)hist->count[i]);
+            } else {
+                printf("    >= %7lu us: %lu\n", 16UL << i, (unsigned long)hist->count[i]);
+            }
+        }
+    }
+}
+
+static int msc_stats_cmd(int argc, char **argv)
+{
+    const bool reset = (argc > 1 && strcmp(argv[1], "-r") == 0);
+    static const char *const op_names[TINYUSB_MSC_MEDIA_OP_NUM] = {"read", "write", "erase"};
+    for (uint8_t lun = 0; msc_storage_get_lun(lun); lun++) {
+        tinyusb_msc_storage_stats_t stats;
+        if (tinyusb_msc_storage_get_stats(lun, &stats, reset) != ESP_OK) {
+            return 1;
+        }
+        printf("LUN %u: read %llu bytes in %lu calls, write %llu bytes in %lu calls, %lu busy, %lu other commands\n",
+               lun, stats.read_bytes, (unsigned long)stats.read_calls, stats.write_bytes, (unsigned long)stats.write_calls,
+               (unsigned long)stats.busy_calls, (unsigned long)stats.other_cmds);
+        printf("  errors: %lu read, %lu write; TinyUSB task blocked %llu us, max %lu us\n",
+               (unsigned long)stats.read_errors, (unsigned long)stats.write_errors,
+               stats.usb_block_us, (unsigned long)stats.usb_block_max_us);
+        for (int op = 0; op < TINYUSB_MSC_MEDIA_OP_NUM; op++) {
+            msc_stats_print_hist(op_names[op], &stats.media[op]);
+        }
+    }
+    return 0;
+}
+#endif // CONFIG_TINYUSB_MSC_STATS_CONSOLE
+
+esp_err_t tinyusb_msc_storage_register_console_cmd(void)
+{
+#if CONFIG_TINYUSB_MSC_STATS_CONSOLE
+    const esp_console_cmd_t cmd = {
+        .command = "msc_stats",
+        .help = "Print MSC storage statistics of all LUNs, -r resets them",
+        .hint = "[-r]",
+        .func = msc_stats_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif // CONFIG_TINYUSB_MSC_STATS_CONSOLE
+}
+
 
 /* TinyUSB MSC callbacks
    ********************************************************************* */
@@ -273,7 +1773,27 @@ esp_err_t tinyusb_msc_unregister_callback(tinyusb_msc_event_type_t event_type)
 /** User can add and use more codes as per the need of the application **/
 #define SCSI_CODE_ASC_MEDIUM_NOT_PRESENT 0x3A /** SCSI ASC code for 'MEDIUM NOT PRESENT' **/
 #define SCSI_CODE_ASC_INVALID_COMMAND_OPERATION_CODE 0x20 /** SCSI ASC code for 'INVALID COMMAND OPERATION CODE' **/
+#define SCSI_CODE_ASC_LOGICAL_UNIT_NOT_SUPPORTED 0x25 /** SCSI ASC code for 'LOGICAL UNIT NOT SUPPORTED' **/
 #define SCSI_CODE_ASCQ 0x00
+#define SCSI_CMD_SYNCHRONIZE_CACHE_10 0x35 /** SCSI SYNCHRONIZE CACHE (10) command **/
+
+/**
+ * @brief Check if the LUN is mounted by the application, the host must not access it
+ */
+static bool msc_storage_app_owned(uint8_t lun)
+{
+    return lun == 0 && s_storage_handle && s_storage_handle->is_fat_mounted;
+}
+
+// Invoked when received GET_MAX_LUN request, required for multiple LUNs implementation
+uint8_t tud_msc_get_maxlun_cb(void)
+{
+    // Number of LUNs, TinyUSB reports it minus one to the host
+    if (s_storage_handle == NULL || s_storage_handle->lun_count == 0) {
+        return 1;
+    }
+    return s_storage_handle->lun_count;
+}
 
 // Invoked when received SCSI_CMD_INQUIRY
 // Application fill vendor id, product id and revision with string up to 8, 16, 4 characters respectively
@@ -293,7 +1813,10 @@ void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16
 // return true allowing host to read/write this LUN e.g SD card inserted
 bool tud_msc_test_unit_ready_cb(uint8_t lun)
 {
-    (void) lun;
+    if (msc_storage_get_lun(lun) == NULL || msc_storage_app_owned(lun)) {
+        tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, SCSI_CODE_ASC_MEDIUM_NOT_PRESENT, SCSI_CODE_ASCQ);
+        return false;
+    }
     return true;
 }
 
@@ -301,35 +1824,136 @@ bool tud_msc_test_unit_ready_cb(uint8_t lun)
 // Application update block count and block size
 void tud_msc_capacity_cb(uint8_t lun, uint32_t *block_count, uint16_t *block_size)
 {
-    (void) lun;
+    msc_lun_t *msc_lun = msc_storage_get_lun(lun);
+    if (msc_lun == NULL) {
+        *block_count = 0;
+        *block_size = 0;
+        return;
+    }
 
-    uint32_t sec_count = tinyusb_msc_storage_get_sector_count();
-    uint32_t sec_size = tinyusb_msc_storage_get_sector_size();
+    uint32_t sec_count = (msc_lun->backend.get_sector_count)(msc_lun->ctx);
+    uint32_t sec_size = (msc_lun->backend.get_sector_size)(msc_lun->ctx);
     *block_count = sec_count;
     *block_size  = (uint16_t)sec_size;
 }
 
+// Invoked to check if device is writable as part of SCSI WRITE10
+bool tud_msc_is_writable_cb(uint8_t lun)
+{
+    msc_lun_t *msc_lun = msc_storage_get_lun(lun);
+    // The host gets a read-only view while the application appends to the log region
+    return msc_lun && msc_lun->backend.write && !(lun == 0 && s_storage_handle->log.sector_count);
+}
+
 // Invoked when received Start Stop Unit command
 // - Start = 0 : stopped power mode, if load_eject = 1 : unload disk storage
 // - Start = 1 : active mode, if load_eject = 1 : load disk storage
 bool tud_msc_start_stop_cb(uint8_t lun, uint8_t power_condition, bool start, bool load_eject)
 {
-    (void) lun;
     (void) power_condition;
+    msc_lun_t *msc_lun = msc_storage_get_lun(lun);
+    if (msc_lun && !start && load_eject) {
+        // Deferred writes must reach the media before the medium is removed
+        return msc_storage_sync(msc_lun) == ESP_OK;
+    }
     return true;
 }
 
+#if CONFIG_TINYUSB_MSC_STATS
+/**
+ * @brief Account a READ10, WRITE10 or other SCSI command callback started at start
+ *
+ * @param scsi_cmd SCSI_CMD_READ_10, SCSI_CMD_WRITE_10 or the command of tud_msc_scsi_cb()
+ * @param ret      Return value of the callback
+ */
+static void msc_stats_usb(uint8_t lun, uint8_t scsi_cmd, int32_t ret, uint32_t bufsize, int64_t start)
+{
+    msc_lun_t *msc_lun = msc_storage_get_lun(lun);
+    if (msc_lun == NULL) {
+        return;
+    }
+    const uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+    tinyusb_msc_storage_stats_t *data = &msc_lun->stats.data;
+    portENTER_CRITICAL(&msc_lun->stats.lock);
+    data->usb_block_us += us;
+    data->usb_block_max_us = MAX(data->usb_block_max_us, us);
+    if (scsi_cmd != SCSI_CMD_READ_10 && scsi_cmd != SCSI_CMD_WRITE_10) {
+        data->other_cmds++;
+    } else if (ret == 0) {
+        data->busy_calls++;
+    } else if (ret != -1) {
+        // Done, or completed later by the storage task
+        if (scsi_cmd == SCSI_CMD_READ_10) {
+            data->read_calls++;
+            data->read_bytes += bufsize;
+        } else {
+            data->write_calls++;
+            data->write_bytes += bufsize;
+        }
+    }
+    portEXIT_CRITICAL(&msc_lun->stats.lock);
+}
+#else
+#define msc_stats_usb(lun, scsi_cmd, ret, bufsize, start) ((void)(start))
+#endif
+
+static int32_t msc_read10(uint8_t lun, uint32_t lba, uint32_t offset, void *buffer, uint32_t bufsize)
+{
+    msc_lun_t *msc_lun = msc_storage_get_lun(lun);
+    if (msc_lun == NULL) {
+        tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_CODE_ASC_LOGICAL_UNIT_NOT_SUPPORTED, SCSI_CODE_ASCQ);
+        return -1;
+    }
+    if (msc_storage_app_owned(lun)) {
+        tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, SCSI_CODE_ASC_MEDIUM_NOT_PRESENT, SCSI_CODE_ASCQ);
+        return -1;
+    }
+#if CONFIG_TINYUSB_MSC_ASYNC_IO
+    return msc_async_read10(msc_lun, lun, lba, offset, buffer, bufsize);
+#else
+    esp_err_t err = msc_storage_read_sector(msc_lun, lba, offset, bufsize, buffer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "msc_storage_read_sector failed: 0x%x", err);
+        return msc_storage_io_failed(lun, false);
+    }
+    return bufsize;
+#endif
+}
+
 // Invoked when received SCSI READ10 command
 // - Address = lba * BLOCK_SIZE + offset
 // - Application fill the buffer (up to bufsize) with address contents and return number of read byte.
 int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void *buffer, uint32_t bufsize)
 {
-    esp_err_t err = msc_storage_read_sector(lba, offset, bufsize, buffer);
+    const int64_t start = msc_stats_start();
+    const int32_t ret = msc_read10(lun, lba, offset, buffer, bufsize);
+    msc_stats_usb(lun, SCSI_CMD_READ_10, ret, bufsize, start);
+    return ret;
+}
+
+static int32_t msc_write10(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t bufsize)
+{
+    msc_lun_t *msc_lun = msc_storage_get_lun(lun);
+    if (msc_lun == NULL) {
+        tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_CODE_ASC_LOGICAL_UNIT_NOT_SUPPORTED, SCSI_CODE_ASCQ);
+        return -1;
+    }
+    if (msc_storage_app_owned(lun)) {
+        tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, SCSI_CODE_ASC_MEDIUM_NOT_PRESENT, SCSI_CODE_ASCQ);
+        return -1;
+    }
+    // Counted before the media access: a failed write may have changed the media too
+    msc_lun->write_gen++;
+#if CONFIG_TINYUSB_MSC_ASYNC_IO
+    return msc_async_write10(msc_lun, lun, lba, offset, buffer, bufsize);
+#else
+    esp_err_t err = msc_storage_write_sector(msc_lun, lba, offset, bufsize, buffer);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "msc_storage_read_sector failed: 0x%x", err);
-        return 0;
+        ESP_LOGE(TAG, "msc_storage_write_sector failed: 0x%x", err);
+        return msc_storage_io_failed(lun, true);
     }
     return bufsize;
+#endif
 }
 
 // Invoked when received SCSI WRITE10 command
@@ -337,12 +1961,10 @@ int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void *buff
 // - Application write data from buffer to address contents (up to bufsize) and return number of written byte.
 int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t bufsize)
 {
-    esp_err_t err = msc_storage_write_sector(lba, offset, bufsize, buffer);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "msc_storage_write_sector failed: 0x%x", err);
-        return 0;
-    }
-    return bufsize;
+    const int64_t start = msc_stats_start();
+    const int32_t ret = msc_write10(lun, lba, offset, buffer, bufsize);
+    msc_stats_usb(lun, SCSI_CMD_WRITE_10, ret, bufsize, start);
+    return ret;
 }
 
 /**
@@ -364,6 +1986,8 @@ int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t *
 int32_t tud_msc_scsi_cb(uint8_t lun, uint8_t const scsi_cmd[16], void *buffer, uint16_t bufsize)
 {
     int32_t ret;
+    msc_lun_t *msc_lun = msc_storage_get_lun(lun);
+    const int64_t start = msc_stats_start();
 
     switch (scsi_cmd[0]) {
     case SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL:
@@ -372,18 +1996,34 @@ int32_t tud_msc_scsi_cb(uint8_t lun, uint8_t const scsi_cmd[16], void *buffer, u
         the storage media/partition. */
         ret = 0;
         break;
+    case SCSI_CMD_SYNCHRONIZE_CACHE_10:
+        // Blocks TinyUSB task until the deferred writes are done
+        if (msc_lun && msc_storage_sync(msc_lun) != ESP_OK) {
+            msc_storage_io_failed(lun, true);
+            ret = -1;
+            break;
+        }
+        ret = 0;
+        break;
     default:
         ESP_LOGW(TAG, "tud_msc_scsi_cb() invoked: %d", scsi_cmd[0]);
         tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_CODE_ASC_INVALID_COMMAND_OPERATION_CODE, SCSI_CODE_ASCQ);
         ret = -1;
         break;
     }
+    msc_stats_usb(lun, scsi_cmd[0], ret, bufsize, start);
     return ret;
 }
 
 // Invoked when device is unmounted
 void tud_umount_cb(void)
 {
+    // The host is gone, do not keep its writes in the storage layer
+    for (uint8_t lun = 0; msc_storage_get_lun(lun); lun++) {
+        if (msc_storage_sync(msc_storage_get_lun(lun)) != ESP_OK) {
+            ESP_LOGE(TAG, "Flush of deferred writes of lun %u failed", lun);
+        }
+    }
     // TODO: provide a callback for the user to learn about this event
 }
 
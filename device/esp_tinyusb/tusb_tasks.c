@@ -1,15 +1,18 @@
 /*
- * SPDX-FileCopyrightText: 2020-2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2020-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <string.h>
+#include <sys/param.h>
 #include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "esp_log.h"
 #include "esp_check.h"
+#include "esp_timer.h"
 #include "tinyusb.h"
 #include "tusb_tasks.h"
 
@@ -21,6 +24,52 @@ const static int INIT_OK = BIT0;
 const static int INIT_FAILED = BIT1;
 #endif
 
+// tud_event_hook_cb() is available since TinyUSB 0.15
+#define TASK_STATS_SUPPORTED (CONFIG_TINYUSB_TASK_STATS && (TUSB_VERSION_MAJOR > 0 || TUSB_VERSION_MINOR >= 15))
+
+#if TASK_STATS_SUPPORTED
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_run_events;       // Events queued since the last run
+static int64_t s_run_start;         // Time the first of them was queued
+static tusb_task_stats_t s_stats;
+
+/* Invoked when an event is queued to the TinyUSB task, possibly from USB ISR */
+void tud_event_hook_cb(uint8_t rhport, uint32_t eventid, bool in_isr)
+{
+    (void) rhport;
+    (void) eventid;
+    (void) in_isr;
+    const int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL_SAFE(&s_stats_lock);
+    if (s_run_events++ == 0) {
+        s_run_start = now;
+    }
+    portEXIT_CRITICAL_SAFE(&s_stats_lock);
+}
+
+/**
+ * @brief Account the events processed by the last tud_task() run
+ *
+ * tud_task() returns when the event queue is empty, so all events queued so far have been processed.
+ */
+static void task_stats_update(void)
+{
+    const int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_stats_lock);
+    const uint32_t events = s_run_events;
+    if (events) {
+        const uint32_t run_time = now - s_run_start;
+        s_run_events = 0;
+        s_stats.runs++;
+        s_stats.events += events;
+        s_stats.max_run_events = MAX(s_stats.max_run_events, events);
+        s_stats.max_run_time_us = MAX(s_stats.max_run_time_us, run_time);
+        s_stats.total_run_time_us += run_time;
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+#endif // TASK_STATS_SUPPORTED
+
 /**
  * @brief This top level thread processes all usb events and invokes callbacks
  */
@@ -39,6 +88,9 @@ static void tusb_device_task(void *arg)
 #endif // CONFIG_TINYUSB_INIT_IN_DEFAULT_TASK
     while (1) { // RTOS forever loop
         tud_task();
+#if TASK_STATS_SUPPORTED
+        task_stats_update();
+#endif
     }
 }
 
@@ -75,3 +127,20 @@ esp_err_t tusb_stop_task(void)
     s_tusb_tskh = NULL;
     return ESP_OK;
 }
+
+esp_err_t tusb_task_get_stats(tusb_task_stats_t *stats, bool reset)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "stats can't be NULL");
+#if TASK_STATS_SUPPORTED
+    portENTER_CRITICAL(&s_stats_lock);
+    *stats = s_stats;
+    if (reset) {
+        memset(&s_stats, 0, sizeof(s_stats));
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+    return ESP_OK;
+#else
+    (void) reset;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif // TASK_STATS_SUPPORTED
+}
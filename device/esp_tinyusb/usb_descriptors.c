@@ -125,6 +125,16 @@ enum {
     ITF_NUM_CDC1_DATA,
 #endif
 
+#if CFG_TUD_CDC > 2
+    ITF_NUM_CDC2,
+    ITF_NUM_CDC2_DATA,
+#endif
+
+#if CFG_TUD_CDC > 3
+    ITF_NUM_CDC3,
+    ITF_NUM_CDC3_DATA,
+#endif
+
 #if CFG_TUD_MSC
     ITF_NUM_MSC,
 #endif
@@ -167,6 +177,16 @@ enum {
     EPNUM_1_CDC,
 #endif
 
+#if CFG_TUD_CDC > 2
+    EPNUM_2_CDC_NOTIF,
+    EPNUM_2_CDC,
+#endif
+
+#if CFG_TUD_CDC > 3
+    EPNUM_3_CDC_NOTIF,
+    EPNUM_3_CDC,
+#endif
+
 #if CFG_TUD_MSC
     EPNUM_MSC,
 #endif
@@ -224,6 +244,16 @@ uint8_t const descriptor_fs_cfg_default[] = {
     TUD_CDC_DESCRIPTOR(ITF_NUM_CDC1, STRID_CDC_INTERFACE, 0x80 | EPNUM_1_CDC_NOTIF, 8, EPNUM_1_CDC, 0x80 | EPNUM_1_CDC, 64),
 #endif
 
+#if CFG_TUD_CDC > 2
+    // Interface number, string index, EP notification address and size, EP data address (out, in) and size.
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC2, STRID_CDC_INTERFACE, 0x80 | EPNUM_2_CDC_NOTIF, 8, EPNUM_2_CDC, 0x80 | EPNUM_2_CDC, 64),
+#endif
+
+#if CFG_TUD_CDC > 3
+    // Interface number, string index, EP notification address and size, EP data address (out, in) and size.
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC3, STRID_CDC_INTERFACE, 0x80 | EPNUM_3_CDC_NOTIF, 8, EPNUM_3_CDC, 0x80 | EPNUM_3_CDC, 64),
+#endif
+
 #if CFG_TUD_MSC
     // Interface number, string index, EP Out & EP In address, EP size
     TUD_MSC_DESCRIPTOR(ITF_NUM_MSC, STRID_MSC_INTERFACE, EPNUM_MSC, 0x80 | EPNUM_MSC, 64),
@@ -260,6 +290,16 @@ uint8_t const descriptor_hs_cfg_default[] = {
     TUD_CDC_DESCRIPTOR(ITF_NUM_CDC1, STRID_CDC_INTERFACE, 0x80 | EPNUM_1_CDC_NOTIF, 8, EPNUM_1_CDC, 0x80 | EPNUM_1_CDC, 512),
 #endif
 
+#if CFG_TUD_CDC > 2
+    // Interface number, string index, EP notification address and size, EP data address (out, in) and size.
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC2, STRID_CDC_INTERFACE, 0x80 | EPNUM_2_CDC_NOTIF, 8, EPNUM_2_CDC, 0x80 | EPNUM_2_CDC, 512),
+#endif
+
+#if CFG_TUD_CDC > 3
+    // Interface number, string index, EP notification address and size, EP data address (out, in) and size.
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC3, STRID_CDC_INTERFACE, 0x80 | EPNUM_3_CDC_NOTIF, 8, EPNUM_3_CDC, 0x80 | EPNUM_3_CDC, 512),
+#endif
+
 #if CFG_TUD_MSC
     // Interface number, string index, EP Out & EP In address, EP size
     TUD_MSC_DESCRIPTOR(ITF_NUM_MSC, STRID_MSC_INTERFACE, EPNUM_MSC, 0x80 | EPNUM_MSC, 512),
@@ -8,6 +8,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdio_ext.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/errno.h>
 #include <sys/fcntl.h>
@@ -19,6 +20,7 @@
 #include "esp_vfs_dev.h"
 #include "tinyusb.h"
 #include "tusb_cdc_acm.h"
+#include "tusb_cdc_acm_private.h"
 #include "vfs_tinyusb.h"
 #include "sdkconfig.h"
 
@@ -52,14 +54,33 @@ const static char *TAG = "tusb_vfs";
 #   define DEFAULT_RX_MODE ESP_LINE_ENDINGS_LF
 #endif
 
+#ifdef CONFIG_VFS_SUPPORT_SELECT
+/**
+ * @brief Pending select() call
+ */
+typedef struct vfstusb_select_s {
+    struct vfstusb_select_s *next;
+    esp_vfs_select_sem_t sem;
+    fd_set *readfds;            // Sets of the select() call, ready fd is added from TinyUSB task
+    fd_set *writefds;
+    bool read;                  // fd was set in readfds of the call
+    bool write;                 // fd was set in writefds of the call
+} vfstusb_select_t;
+#endif // CONFIG_VFS_SUPPORT_SELECT
+
 typedef struct {
     _lock_t write_lock;
     _lock_t read_lock;
     esp_line_endings_t tx_mode; // Newline conversion mode when transmitting
     esp_line_endings_t rx_mode; // Newline conversion mode when receiving
     uint32_t flags;
+    bool rx_pending_cr;         // CR received at the end of the last read, in CRLF mode it depends on the next character
     char vfs_path[VFS_TUSB_MAX_PATH];
     int cdc_intf;
+#ifdef CONFIG_VFS_SUPPORT_SELECT
+    _lock_t select_lock;
+    vfstusb_select_t *selects;  // Pending select() calls
+#endif
 } vfs_tinyusb_t;
 
 static vfs_tinyusb_t s_vfstusb;
@@ -104,6 +125,9 @@ static void vfstusb_deinit(void)
 {
     _lock_close(&(s_vfstusb.write_lock));
     _lock_close(&(s_vfstusb.read_lock));
+#ifdef CONFIG_VFS_SUPPORT_SELECT
+    _lock_close(&(s_vfstusb.select_lock));
+#endif
     memset(&s_vfstusb, 0, sizeof(s_vfstusb));
 }
 
@@ -111,39 +135,62 @@ static int tusb_open(const char *path, int flags, int mode)
 {
     (void) mode;
     (void) path;
-    s_vfstusb.flags = flags | O_NONBLOCK; // for now only non-blocking mode is implemented
+    s_vfstusb.flags = flags | O_NONBLOCK; // non-blocking by default, blocking mode can be set by fcntl()
     return 0;
 }
 
+/**
+ * @brief Line ending to be written instead of '\n' in the current TX mode
+ */
+static const char *tx_line_ending(size_t *len)
+{
+    switch (s_vfstusb.tx_mode) {
+    case ESP_LINE_ENDINGS_CRLF:
+        *len = 2;
+        return "\r\n";
+    case ESP_LINE_ENDINGS_CR:
+        *len = 1;
+        return "\r";
+    default:
+        *len = 1;
+        return "\n";
+    }
+}
+
 static ssize_t tusb_write(int fd, const void *data, size_t size)
 {
     FD_CHECK(fd, -1);
     size_t written_sz = 0;
     const char *data_c = (const char *)data;
+    const int itf = s_vfstusb.cdc_intf;
     _lock_acquire(&(s_vfstusb.write_lock));
-    for (size_t i = 0; i < size; i++) {
-        int c = data_c[i];
-        if (c != '\n') {
-            if (!tinyusb_cdcacm_write_queue_char(s_vfstusb.cdc_intf, c)) {
+    if (!tusb_cdc_acm_initialized(itf)) {
+        goto finish;
+    }
+    size_t eol_len;
+    const char *eol = tx_line_ending(&eol_len);
+    // Data between the newlines are queued in one go, only the newlines are translated
+    while (written_sz < size) {
+        const char *nl = memchr(data_c + written_sz, '\n', size - written_sz);
+        const size_t run = (nl ? (size_t)(nl - data_c) : size) - written_sz;
+        if (run) {
+            const size_t queued = tinyusb_cdcacm_write_queue(itf, (const uint8_t *)data_c + written_sz, run);
+            written_sz += queued;
+            if (queued < run) {
                 break; // can't write anymore
             }
-        } else {
-            if (s_vfstusb.tx_mode == ESP_LINE_ENDINGS_CRLF || s_vfstusb.tx_mode == ESP_LINE_ENDINGS_CR) {
-                char cr = '\r';
-                if (!tinyusb_cdcacm_write_queue_char(s_vfstusb.cdc_intf, cr)) {
-                    break; // can't write anymore
-                }
-            }
-            if (s_vfstusb.tx_mode == ESP_LINE_ENDINGS_CRLF || s_vfstusb.tx_mode == ESP_LINE_ENDINGS_LF) {
-                char lf = '\n';
-                if (!tinyusb_cdcacm_write_queue_char(s_vfstusb.cdc_intf, lf)) {
-                    break; // can't write anymore
-                }
-            }
+        }
+        if (nl == NULL) {
+            break;
+        }
+        if (tinyusb_cdcacm_write_available(itf) < eol_len ||
+                tinyusb_cdcacm_write_queue(itf, (const uint8_t *)eol, eol_len) < eol_len) {
+            break; // can't write anymore, the line ending is written as a whole or not at all
         }
         written_sz++;
     }
-    tud_cdc_n_write_flush(s_vfstusb.cdc_intf);
+    tinyusb_cdcacm_write_flush(itf, 0);
+finish:
     _lock_release(&(s_vfstusb.write_lock));
     return written_sz;
 }
@@ -154,48 +201,73 @@ static int tusb_close(int fd)
     return 0;
 }
 
+/**
+ * @brief Convert line endings of received data from configured mode to LF, in place
+ *
+ * In CRLF mode, CR at the end of the data is not passed and rx_pending_cr is set instead.
+ *
+ * @return Length of the converted data
+ */
+static size_t rx_convert(char *data_c, size_t len)
+{
+    const char *cr = (s_vfstusb.rx_mode == ESP_LINE_ENDINGS_LF) ? NULL : memchr(data_c, '\r', len);
+    if (cr == NULL) {
+        return len;
+    }
+    size_t out = cr - data_c;
+    for (size_t i = out; i < len; i++) {
+        char c = data_c[i];
+        if (c == '\r') {
+            if (s_vfstusb.rx_mode == ESP_LINE_ENDINGS_CR) {
+                c = '\n'; // Change CRs to newlines
+            } else if (i + 1 == len) {
+                s_vfstusb.rx_pending_cr = true; // Next character is not received yet
+                break;
+            } else if (data_c[i + 1] == '\n') {
+                c = '\n'; // CRLF sequence
+                i++;
+            }
+        }
+        data_c[out++] = c;
+    }
+    return out;
+}
+
 static ssize_t tusb_read(int fd, void *data, size_t size)
 {
     FD_CHECK(fd, -1);
     char *data_c = (char *) data;
     size_t received = 0;
+    const int itf = s_vfstusb.cdc_intf;
     _lock_acquire(&(s_vfstusb.read_lock));
 
-    if (tud_cdc_n_available(s_vfstusb.cdc_intf) == 0) {
-        goto finish;
-    }
-    while (received < size) {
-        int c = tud_cdc_n_read_char(s_vfstusb.cdc_intf);
-        if ( c == NONE) { // if data ends
-            break;
-        }
-
-        // Handle line endings. From configured mode -> LF mode
-        if (s_vfstusb.rx_mode == ESP_LINE_ENDINGS_CR) {
-            // Change CRs to newlines
-            if (c == '\r') {
-                c = '\n';
-            }
-        } else if (s_vfstusb.rx_mode == ESP_LINE_ENDINGS_CRLF) {
-            if (c == '\r') {
-                uint8_t next_char = NONE;
-                // Check if next char is newline. If yes, we got CRLF sequence
-                tud_cdc_n_peek(s_vfstusb.cdc_intf, &next_char);
+    while (size > 0) {
+        if (s_vfstusb.rx_pending_cr) {
+            // Resolve CR from the last read before any data following it
+            uint8_t next_char;
+            if (tinyusb_cdcacm_peek(itf, &next_char)) {
                 if (next_char == '\n') {
-                    c = tud_cdc_n_read_char(s_vfstusb.cdc_intf); // Remove '\n' from the fifo
+                    size_t removed;
+                    tinyusb_cdcacm_read(itf, &next_char, 1, &removed); // Remove '\n' from the fifo
                 }
+                data_c[received++] = (next_char == '\n') ? '\n' : '\r';
+                s_vfstusb.rx_pending_cr = false;
             }
         }
-
-        data_c[received] = (char) c;
-        ++received;
-        if (c == '\n') {
+        if (!s_vfstusb.rx_pending_cr && received < size) {
+            size_t len = 0;
+            tinyusb_cdcacm_read(itf, (uint8_t *)data_c + received, size - received, &len);
+            received += rx_convert(data_c + received, len);
+        }
+        if (received > 0 || (s_vfstusb.flags & O_NONBLOCK)) {
+            break;
+        }
+        if (tinyusb_cdcacm_wait_rx(itf, portMAX_DELAY) != ESP_OK) {
             break;
         }
     }
-finish:
     _lock_release(&(s_vfstusb.read_lock));
-    if (received > 0) {
+    if (received > 0 || size == 0) {
         return received;
     }
     errno = EWOULDBLOCK;
@@ -229,6 +301,90 @@ static int tusb_fcntl(int fd, int cmd, int arg)
     return result;
 }
 
+#ifdef CONFIG_VFS_SUPPORT_SELECT
+/**
+ * @brief Add fd to the sets of a select() call if it became ready and wake up the call
+ *
+ * Must be called with select_lock taken.
+ */
+static void tusb_select_check(vfstusb_select_t *sel)
+{
+    const int itf = s_vfstusb.cdc_intf;
+    bool triggered = false;
+    uint8_t ch;
+    if (sel->read && !FD_ISSET(0, sel->readfds) && tinyusb_cdcacm_peek(itf, &ch)) {
+        FD_SET(0, sel->readfds);
+        triggered = true;
+    }
+    if (sel->write && !FD_ISSET(0, sel->writefds) && tinyusb_cdcacm_write_available(itf) > 0) {
+        FD_SET(0, sel->writefds);
+        triggered = true;
+    }
+    if (triggered) {
+        esp_vfs_select_triggered(sel->sem);
+    }
+}
+
+/**
+ * @brief Data received or IN transfer completed, invoked from TinyUSB task
+ */
+static void tusb_select_io_cb(tinyusb_cdcacm_itf_t itf)
+{
+    (void) itf;
+    _lock_acquire(&(s_vfstusb.select_lock));
+    for (vfstusb_select_t *sel = s_vfstusb.selects; sel; sel = sel->next) {
+        tusb_select_check(sel);
+    }
+    _lock_release(&(s_vfstusb.select_lock));
+}
+
+static esp_err_t tusb_start_select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
+                                   esp_vfs_select_sem_t select_sem, void **end_select_args)
+{
+    *end_select_args = NULL;
+    vfstusb_select_t *sel = calloc(1, sizeof(vfstusb_select_t));
+    if (sel == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    sel->sem = select_sem;
+    sel->readfds = readfds;
+    sel->writefds = writefds;
+    sel->read = nfds > 0 && FD_ISSET(0, readfds);
+    sel->write = nfds > 0 && FD_ISSET(0, writefds);
+    // Only the ready fd is returned, it is set again when it becomes ready
+    FD_ZERO(readfds);
+    FD_ZERO(writefds);
+    FD_ZERO(exceptfds);
+
+    _lock_acquire(&(s_vfstusb.select_lock));
+    sel->next = s_vfstusb.selects;
+    s_vfstusb.selects = sel;
+    // Data received before the call are not notified again
+    tusb_select_check(sel);
+    _lock_release(&(s_vfstusb.select_lock));
+    *end_select_args = sel;
+    return ESP_OK;
+}
+
+static esp_err_t tusb_end_select(void *end_select_args)
+{
+    vfstusb_select_t *sel = (vfstusb_select_t *)end_select_args;
+    if (sel == NULL) {
+        return ESP_OK;
+    }
+    _lock_acquire(&(s_vfstusb.select_lock));
+    for (vfstusb_select_t **it = &s_vfstusb.selects; *it; it = &(*it)->next) {
+        if (*it == sel) {
+            *it = sel->next;
+            break;
+        }
+    }
+    _lock_release(&(s_vfstusb.select_lock));
+    free(sel);
+    return ESP_OK;
+}
+#endif // CONFIG_VFS_SUPPORT_SELECT
+
 esp_err_t esp_vfs_tusb_cdc_unregister(char const *path)
 {
     ESP_LOGD(TAG, "Unregistering CDC-VFS driver");
@@ -250,6 +406,9 @@ esp_err_t esp_vfs_tusb_cdc_unregister(char const *path)
         ESP_LOGE(TAG, "Can't unregister CDC-VFS driver from '%s' (err: 0x%x)", s_vfstusb.vfs_path, res);
     } else {
         ESP_LOGD(TAG, "Unregistered CDC-VFS driver");
+#ifdef CONFIG_VFS_SUPPORT_SELECT
+        tinyusb_cdcacm_set_io_cb(s_vfstusb.cdc_intf, NULL);
+#endif
         vfstusb_deinit();
     }
     return res;
@@ -277,12 +436,19 @@ esp_err_t esp_vfs_tusb_cdc_register(int cdc_intf, char const *path)
         .open = &tusb_open,
         .read = &tusb_read,
         .write = &tusb_write,
+#ifdef CONFIG_VFS_SUPPORT_SELECT
+        .start_select = &tusb_start_select,
+        .end_select = &tusb_end_select,
+#endif
     };
 
     res = esp_vfs_register(s_vfstusb.vfs_path, &vfs, NULL);
     if (res != ESP_OK) {
         ESP_LOGE(TAG, "Can't register CDC-VFS driver (err: %x)", res);
     } else {
+#ifdef CONFIG_VFS_SUPPORT_SELECT
+        tinyusb_cdcacm_set_io_cb(cdc_intf, tusb_select_io_cb);
+#endif
         ESP_LOGD(TAG, "CDC-VFS registered (%s)", s_vfstusb.vfs_path);
     }
     return res;
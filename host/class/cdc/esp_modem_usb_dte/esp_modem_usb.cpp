@@ -4,8 +4,13 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/timers.h"
 #include "esp_log.h"
 #include "esp_modem_config.h"
 #include "esp_modem_usb_config.h"
@@ -19,6 +24,11 @@
 
 static const char *TAG = "usb_terminal";
 
+// Space for one more IN transfer after coalesced RX data: maximum bulk packet size and IN buffer append alignment
+#define USB_TERM_RX_APPEND_MARGIN (512 + 64)
+// Default time for which written data are gathered in OUT transfers
+#define USB_TERM_TX_COALESCE_US   (1000)
+
 /**
  * @brief USB Host task
  *
@@ -45,14 +55,21 @@ static void usb_host_task(void *arg)
 }
 
 namespace esp_modem {
-class UsbTerminal : public Terminal, private CdcAcmDevice {
+/**
+ * @brief USB modem device shared by its terminals
+ *
+ * USB Host and CDC-ACM drivers are installed once per modem. The primary terminal opens the USB device,
+ * the secondary terminal is opened on top of the already opened USB device: it does not wait for the connection
+ * and it shares the control transfer with the primary terminal. RX of both terminals is dispatched by the CDC-ACM driver task.
+ */
+class UsbModem {
 public:
-    explicit UsbTerminal(const esp_modem_dte_config *config, int term_idx): buffer_size(config->dte_buffer_size)
+    explicit UsbModem(const esp_modem_dte_config *config):
+        usb_config(*static_cast<const struct esp_modem_usb_term_config *>(config->extension_config)),
+        buffer_size(config->dte_buffer_size), task_stack_size(config->task_stack_size), task_priority(config->task_priority), gone(false)
     {
-        const struct esp_modem_usb_term_config *usb_config = (struct esp_modem_usb_term_config *)(config->extension_config);
-
         // Install USB Host driver (if not already installed)
-        if (usb_config->install_usb_host && !usb_host_lib_task) {
+        if (usb_config.install_usb_host && !usb_host_lib_task) {
             usb_host_config_t host_config = {};
             host_config.skip_phy_setup = false;
             host_config.intr_flags = ESP_INTR_FLAG_LEVEL1;
@@ -60,7 +77,7 @@ public:
             ESP_MODEM_THROW_IF_ERROR(usb_host_install(&host_config), "USB Host install failed");
             ESP_LOGD(TAG, "USB Host installed");
             ESP_MODEM_THROW_IF_FALSE(
-                pdTRUE == xTaskCreatePinnedToCore(usb_host_task, "usb_host", 4096, NULL, config->task_priority + 1, &usb_host_lib_task, usb_config->xCoreID),
+                pdTRUE == xTaskCreatePinnedToCore(usb_host_task, "usb_host", 4096, NULL, config->task_priority + 1, &usb_host_lib_task, usb_config.xCoreID),
                 "USB host task failed");
         }
 
@@ -68,40 +85,70 @@ public:
         const cdc_acm_host_driver_config_t esp_modem_cdc_acm_driver_config = {
             .driver_task_stack_size = config->task_stack_size,
             .driver_task_priority = config->task_priority,
-            .xCoreID = (BaseType_t)usb_config->xCoreID,
+            .xCoreID = (BaseType_t)usb_config.xCoreID,
             .new_dev_cb = NULL, // We don't forward this information to user. User can poll USB Host Lib.
         };
 
         // Silently continue on error: CDC-ACM driver might be already installed
         cdc_acm_host_install(&esp_modem_cdc_acm_driver_config);
+    }
+
+    const struct esp_modem_usb_term_config usb_config;
+    const size_t buffer_size;
+    const size_t task_stack_size;
+    const int task_priority;
+    std::atomic<bool> gone; // DEVICE_GONE is reported once per modem, not by each of its terminals
+
+private:
+    UsbModem(const UsbModem &copy) = delete;
+    UsbModem &operator=(const UsbModem &copy) = delete;
+    static TaskHandle_t usb_host_lib_task; // Reused by multiple devices or between reconnections
+};
+TaskHandle_t UsbModem::usb_host_lib_task = nullptr;
+
+class UsbTerminal : public Terminal, private CdcAcmDevice {
+public:
+    explicit UsbTerminal(std::shared_ptr<UsbModem> usb_modem, int term_idx): modem(std::move(usb_modem)), buffer_size(modem->buffer_size)
+    {
+        const struct esp_modem_usb_term_config *usb_config = &modem->usb_config;
+        pipelined = usb_config->tx_transfers_num > 0;
+        coalesced = usb_config->tx_coalesce_bytes > 0;
+        ESP_MODEM_THROW_IF_FALSE(!coalesced || pipelined, "TX coalescing requires tx_transfers_num > 0");
+        if (usb_config->rx_coalesce_bytes > 0) {
+            rx_coalesce_create(usb_config->rx_coalesce_timeout_ms);
+        }
 
-        // Open CDC-ACM device
+        // Open CDC-ACM device. Coalesced RX data are kept in the IN buffer, so it must fit them and one more IN transfer
+        const size_t in_buffer_size = usb_config->rx_coalesce_bytes > 0 ? usb_config->rx_coalesce_bytes + USB_TERM_RX_APPEND_MARGIN : buffer_size;
         const cdc_acm_host_device_config_t esp_modem_cdc_acm_device_config = {
             .connection_timeout_ms = usb_config->timeout_ms,
-            .out_buffer_size = config->dte_buffer_size,
-            .in_buffer_size = config->dte_buffer_size,
+            .out_buffer_size = buffer_size,
+            .in_buffer_size = in_buffer_size,
             .event_cb = handle_notif,
             .data_cb = handle_rx,
-            .user_arg = this
+            .user_arg = this,
+            .out_transfers_num = usb_config->tx_transfers_num,
+            .reconnect = usb_config->reconnect,
+            .tx_coalesce_size = std::min(usb_config->tx_coalesce_bytes, buffer_size),
+            .tx_coalesce_us = usb_config->tx_coalesce_us ? usb_config->tx_coalesce_us : USB_TERM_TX_COALESCE_US,
         };
 
         // Determine Terminal interface index
         const uint8_t intf_idx = term_idx == 0 ? usb_config->interface_idx : usb_config->secondary_interface_idx;
 
-        if (usb_config->cdc_compliant) {
-            ESP_MODEM_THROW_IF_ERROR(
-                this->CdcAcmDevice::open(usb_config->vid, usb_config->pid, intf_idx, &esp_modem_cdc_acm_device_config),
-                "USB Device open failed");
-        } else {
-            ESP_MODEM_THROW_IF_ERROR(
-                this->CdcAcmDevice::open_vendor_specific(usb_config->vid, usb_config->pid, intf_idx, &esp_modem_cdc_acm_device_config),
-                "USB Device open failed");
+        const esp_err_t err = usb_config->cdc_compliant ?
+                              this->CdcAcmDevice::open(usb_config->vid, usb_config->pid, intf_idx, &esp_modem_cdc_acm_device_config) :
+                              this->CdcAcmDevice::open_vendor_specific(usb_config->vid, usb_config->pid, intf_idx, &esp_modem_cdc_acm_device_config);
+        if (err != ESP_OK) {
+            rx_coalesce_delete();
         }
+        ESP_MODEM_THROW_IF_ERROR(err, "USB Device open failed");
     };
 
     ~UsbTerminal()
     {
         this->CdcAcmDevice::close();
+        rx_coalesce_delete();
     };
 
     void start() override
@@ -117,6 +164,10 @@ public:
     int write(uint8_t *data, size_t len) override
     {
         ESP_LOG_BUFFER_HEXDUMP(TAG, data, len, ESP_LOG_DEBUG);
+        // Gathered writes return when the data are copied to an OUT transfer, so they take the blocking path below
+        if (pipelined && !coalesced) {
+            return write_pipelined(data, len);
+        }
         uint8_t *ptr = data;
         size_t remain = len;
         while (remain > 0) {
@@ -143,13 +194,190 @@ private:
     UsbTerminal &operator=(const UsbTerminal &copy) = delete;
     bool operator== (const UsbTerminal &param) const = delete;
     bool operator!= (const UsbTerminal &param) const = delete;
-    static TaskHandle_t usb_host_lib_task; // Reused by multiple devices or between reconnections
+
+    /**
+     * @brief Copy data directly to free OUT transfers and submit them without waiting for the transmission
+     *
+     * The data are split by the size of the transfer buffers. This only waits if all transfers are in flight,
+     * so the bus stays busy while esp_modem prepares next data. A transmission that failed since the previous write
+     * fails this write, as a blocking write would have failed.
+     *
+     * @return Number of bytes submitted, -1 if no data were submitted or a previous transmission failed
+     */
+    int write_pipelined(const uint8_t *data, size_t len)
+    {
+        if (tx_error.exchange(ESP_OK) != ESP_OK) {
+            return -1;
+        }
+        size_t remain = len;
+        while (remain > 0) {
+            uint8_t *buf;
+            size_t buf_size;
+            if (this->CdcAcmDevice::tx_buffer_get(&buf, &buf_size) != ESP_OK) {
+                break;
+            }
+            const size_t batch = std::min(buf_size, remain);
+            memcpy(buf, data, batch);
+            if (this->CdcAcmDevice::tx_buffer_submit(buf, batch, handle_tx_done, this) != ESP_OK) {
+                break;
+            }
+            remain -= batch;
+            data += batch;
+        }
+        return remain == len ? -1 : static_cast<int>(len - remain);
+    }
+
+    /**
+     * @brief TX done callback of pipelined writes
+     *
+     * Disconnection is reported by handle_notif() and cancelled transmissions were stopped by this terminal,
+     * other errors are returned by the next write_pipelined().
+     */
+    static void handle_tx_done(esp_err_t status, size_t data_len, void *user_arg)
+    {
+        switch (status) {
+        case ESP_OK:
+            break;
+        case ESP_ERR_NOT_FOUND:
+            ESP_LOGD(TAG, "USB transmission failed, device disconnected");
+            break;
+        case ESP_ERR_INVALID_STATE:
+            ESP_LOGD(TAG, "USB transmission cancelled");
+            break;
+        default:
+            ESP_LOGW(TAG, "USB transmission failed, %zu bytes sent", data_len);
+            static_cast<UsbTerminal *>(user_arg)->tx_error = status;
+            break;
+        }
+    }
+
+    void rx_coalesce_create(uint32_t timeout_ms)
+    {
+        const TickType_t timeout_ticks = pdMS_TO_TICKS(timeout_ms ? timeout_ms : 10);
+        rx_mutex = xSemaphoreCreateMutex();
+        rx_timer = xTimerCreate("usb_term_rx", timeout_ticks ? timeout_ticks : 1, pdFALSE, this, handle_rx_timeout);
+        if (rx_mutex && rx_timer) {
+            xTaskCreatePinnedToCore(rx_idle_task, "usb_term_rx", modem->task_stack_size, this, modem->task_priority,
+                                    &rx_task, modem->usb_config.xCoreID);
+        }
+        if (rx_task == nullptr) {
+            rx_coalesce_delete();
+        }
+        ESP_MODEM_THROW_IF_FALSE(rx_timer != nullptr, "RX coalescing failed");
+    }
+
+    void rx_coalesce_delete()
+    {
+        if (rx_timer) {
+            xTimerDelete(rx_timer, portMAX_DELAY);
+            // Wait until the timer task processed the deletion, so handle_rx_timeout() is not running
+            xTimerPendFunctionCall([](void *task, uint32_t /*unused*/) {
+                xTaskNotifyGive(static_cast<TaskHandle_t>(task));
+            }, xTaskGetCurrentTaskHandle(), 0, portMAX_DELAY);
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            rx_timer = nullptr;
+        }
+        if (rx_task) {
+            // The task notifies back and deletes itself, so rx_pending_deliver() is not running
+            rx_task_owner = xTaskGetCurrentTaskHandle();
+            xTaskNotifyGive(rx_task);
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            rx_task = nullptr;
+        }
+        if (rx_mutex) {
+            vSemaphoreDelete(rx_mutex);
+            rx_mutex = nullptr;
+        }
+    }
+
+    /**
+     * @brief Deliver coalesced RX data to esp_modem
+     *
+     * @note rx_mutex must be taken
+     * @return true: esp_modem processed the data, false: esp_modem expects more data appended to the delivered data
+     */
+    bool rx_pending_deliver()
+    {
+        const bool processed = on_read ? on_read(const_cast<uint8_t *>(rx_pending), rx_pending_len) : true;
+        // Not processed: esp_modem expects only the new data next time, they will be appended after rx_pending by CDC-ACM driver
+        rx_pending = processed ? nullptr : rx_pending + rx_pending_len;
+        rx_pending_len = 0;
+        return processed;
+    }
+
+    /**
+     * @brief Coalesce received data in the IN buffer of CDC-ACM driver
+     *
+     * The data are kept in the IN buffer by returning false to CDC-ACM driver, so the next data are appended without copying.
+     * They are delivered when rx_coalesce_bytes are buffered, the terminator is received or in handle_rx_timeout().
+     */
+    bool handle_rx_coalesce(const uint8_t *data, size_t data_len)
+    {
+        const struct esp_modem_usb_term_config *usb_config = &modem->usb_config;
+        xSemaphoreTake(rx_mutex, portMAX_DELAY);
+        // Appended data directly follow the pending data, unless the IN buffer was reset by CDC-ACM driver
+        if (rx_pending == nullptr || rx_flush || data != rx_pending + rx_pending_len) {
+            rx_pending = data;
+        }
+        rx_pending_len = (data + data_len) - rx_pending;
+
+        // Data delivered by the idle timeout are still in the IN buffer, deliver new data immediately so the buffer is flushed
+        const bool deliver = rx_flush || rx_pending_len >= usb_config->rx_coalesce_bytes ||
+                             (usb_config->rx_terminator >= 0 && memchr(data, usb_config->rx_terminator, data_len) != nullptr);
+        rx_flush = false;
+        bool processed = false;
+        if (deliver) {
+            xTimerStop(rx_timer, 0);
+            processed = rx_pending_deliver();
+        } else {
+            xTimerReset(rx_timer, 0);
+        }
+        xSemaphoreGive(rx_mutex);
+        return processed;
+    }
+
+    /**
+     * @brief RX idle timer callback
+     *
+     * Runs in the timer task, which must not block in esp_modem. The data are delivered by rx_idle_task().
+     */
+    static void handle_rx_timeout(TimerHandle_t timer)
+    {
+        auto *this_terminal = static_cast<UsbTerminal *>(pvTimerGetTimerID(timer));
+        xTaskNotifyGive(this_terminal->rx_task);
+    }
+
+    /**
+     * @brief Deliver coalesced RX data after RX idle timeout
+     *
+     * The task exits when notified by rx_coalesce_delete().
+     */
+    static void rx_idle_task(void *arg)
+    {
+        auto *this_terminal = static_cast<UsbTerminal *>(arg);
+        while (true) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            if (this_terminal->rx_task_owner) {
+                break;
+            }
+            xSemaphoreTake(this_terminal->rx_mutex, portMAX_DELAY);
+            if (this_terminal->rx_pending_len > 0) {
+                ESP_LOGD(TAG, "RX idle, delivering %zu bytes", this_terminal->rx_pending_len);
+                this_terminal->rx_flush = this_terminal->rx_pending_deliver();
+            }
+            xSemaphoreGive(this_terminal->rx_mutex);
+        }
+        xTaskNotifyGive(this_terminal->rx_task_owner);
+        vTaskDelete(NULL);
+    }
 
     static bool handle_rx(const uint8_t *data, size_t data_len, void *user_arg)
     {
         ESP_LOG_BUFFER_HEXDUMP(TAG, data, data_len, ESP_LOG_DEBUG);
         auto *this_terminal = static_cast<UsbTerminal *>(user_arg);
-        if (data_len > 0 && this_terminal->on_read) {
+        if (data_len > 0 && this_terminal->rx_timer) {
+            return this_terminal->handle_rx_coalesce(data, data_len);
+        } else if (data_len > 0 && this_terminal->on_read) {
             return this_terminal->on_read((uint8_t *)data, data_len);
         } else {
             ESP_LOGD(TAG, "Unhandled RX data");
@@ -168,12 +396,20 @@ private:
             ESP_LOGD(TAG, "Ignored USB event %d", event->type);
             break;
         case CDC_ACM_HOST_DEVICE_DISCONNECTED:
+            if (this_terminal->modem->usb_config.reconnect) {
+                // The device stays open in standby, buffers and the DTE are kept until the modem is connected again
+                ESP_LOGW(TAG, "USB terminal disconnected, waiting for reconnection");
+                break;
+            }
             ESP_LOGW(TAG, "USB terminal disconnected");
-            if (this_terminal->on_error) {
+            if (!this_terminal->modem->gone.exchange(true) && this_terminal->on_error) {
                 this_terminal->on_error(terminal_error::DEVICE_GONE);
             }
             this_terminal->close();
             break;
+        case CDC_ACM_HOST_DEVICE_RECONNECTED:
+            ESP_LOGI(TAG, "USB terminal reconnected");
+            break;
         case CDC_ACM_HOST_ERROR:
             ESP_LOGE(TAG, "Unexpected CDC-ACM error: %d.", event->data.error);
             if (this_terminal->on_error) {
@@ -184,14 +420,34 @@ private:
             abort();
         }
     }
+    std::shared_ptr<UsbModem> modem;
     size_t buffer_size;
+    bool pipelined;
+    std::atomic<esp_err_t> tx_error{ESP_OK}; // Pipelined writes only: Transmission failed since the last write
+    bool coalesced;                        // Writes are gathered in OUT transfers by CDC-ACM driver, e.g. CMUX frames of all channels
+    SemaphoreHandle_t rx_mutex = nullptr;  // Protects RX coalescing state, rx_idle_task() delivers data after RX idle timeout
+    TimerHandle_t rx_timer = nullptr;      // RX idle timer, nullptr if RX coalescing is disabled
+    TaskHandle_t rx_task = nullptr;        // Task of rx_idle_task()
+    volatile TaskHandle_t rx_task_owner = nullptr; // Task waiting in rx_coalesce_delete() for rx_idle_task() to exit
+    const uint8_t *rx_pending = nullptr;   // Start of received data not delivered to esp_modem
+    size_t rx_pending_len = 0;             // Length of received data not delivered to esp_modem
+    bool rx_flush = false;                 // Delivered data are in the IN buffer, it is flushed with next received data
 };
-TaskHandle_t UsbTerminal::usb_host_lib_task = nullptr;
 
-std::unique_ptr<Terminal> create_usb_terminal(const esp_modem_dte_config *config, int term_idx)
+std::shared_ptr<UsbModem> create_usb_modem(const esp_modem_dte_config *config)
 {
     TRY_CATCH_RET_NULL(
-        return std::make_unique<UsbTerminal>(config, term_idx);
+        return std::make_shared<UsbModem>(config);
+    )
+}
+
+std::unique_ptr<Terminal> create_usb_terminal(const std::shared_ptr<UsbModem> &modem, int term_idx)
+{
+    if (modem == nullptr) {
+        return nullptr;
+    }
+    TRY_CATCH_RET_NULL(
+        return std::make_unique<UsbTerminal>(modem, term_idx);
     )
 }
 } // namespace esp_modem
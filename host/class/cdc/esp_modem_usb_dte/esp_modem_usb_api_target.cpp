@@ -23,10 +23,11 @@ std::shared_ptr<DTE> create_usb_dte(const dte_config *config)
 
     // *INDENT-OFF*
     TRY_CATCH_RET_NULL(
-        auto primary_term = create_usb_terminal(config);
+        auto modem = create_usb_modem(config);
+        auto primary_term = create_usb_terminal(modem);
         auto *usb_config = static_cast<struct esp_modem_usb_term_config *>(config->extension_config);
         if (usb_config->secondary_interface_idx > -1) {
-            auto secondary_term = create_usb_terminal(config, 1);
+            auto secondary_term = create_usb_terminal(modem, 1);
             return std::make_shared<DTE>(config, std::move(primary_term), std::move(secondary_term));
         }
         return std::make_shared<DTE>(config, std::move(primary_term));
@@ -21,6 +21,17 @@ struct esp_modem_usb_term_config {
     int xCoreID;                 /*!< Core affinity of created tasks: CDC-ACM driver task and optional USB Host task */
     bool cdc_compliant;          /*!< Treat the USB device as CDC-compliant. Read CDC-ACM driver documentation for more details */
     bool install_usb_host;       /*!< Flag whether USB Host driver should be installed */
+    int tx_transfers_num;        /*!< Number of OUT transfers of dte_buffer_size in flight. Writes return without waiting for the USB transfers,
+                                      a failed transmission fails the next write. 0: Each write waits until its data are transmitted */
+    bool reconnect;              /*!< Keep the terminals when the modem is disconnected, DEVICE_GONE is not reported.
+                                      When the same modem is connected again, the terminals are rebound to it and continue */
+    size_t rx_coalesce_bytes;    /*!< Received data are coalesced and delivered to esp_modem when this many bytes are buffered.
+                                      0: Data of every USB transfer are delivered, RX coalescing is disabled */
+    uint32_t rx_coalesce_timeout_ms; /*!< Coalesced data are delivered after this idle time in [ms]. 0: Default 10 ms */
+    int rx_terminator;           /*!< Coalesced data are delivered when this byte is received, e.g. '\n' for AT responses. -1: No terminator */
+    size_t tx_coalesce_bytes;    /*!< Written data are gathered in OUT transfers and sent when this many bytes are gathered, at most dte_buffer_size.
+                                      Requires tx_transfers_num > 0. 0: Each write is sent in its own transfers, TX coalescing is disabled */
+    uint32_t tx_coalesce_us;     /*!< Gathered data are sent at latest this long in [us] after the first write. 0: Default 1000 us */
 };
 
 /**
@@ -37,6 +48,23 @@ struct esp_modem_usb_term_config {
         .extension_config = &_usb_config              \
     }
 
+/**
+ * @brief Size of CMUX frame in bytes without information field: 2 flags, address, control, 2 length bytes and FCS
+ */
+#define ESP_MODEM_USB_CMUX_FRAME_OVERHEAD (7)
+
+/**
+ * @brief DTE buffer size for CMUX over one USB interface
+ *
+ * The buffer fits the given number of frames with the modem's maximum frame size N1, rounded up to 512 bytes,
+ * a multiple of bulk Maximum Packet Size in Full and High speed.
+ *
+ * @param[in] _n1     Maximum size of CMUX information field (N1), negotiated with the modem. Default N1 of basic mode is 127
+ * @param[in] _frames Number of frames in one USB transfer
+ */
+#define ESP_MODEM_USB_CMUX_DTE_BUFFER_SIZE(_n1, _frames) \
+    (((((_frames) * ((_n1) + ESP_MODEM_USB_CMUX_FRAME_OVERHEAD)) + 511) / 512) * 512)
+
 /**
  * @brief ESP Modem USB Default Configuration
  *
@@ -55,7 +83,14 @@ struct esp_modem_usb_term_config {
         .timeout_ms = 0,                                             \
         .xCoreID = 0,                                                \
         .cdc_compliant = false,                                      \
-        .install_usb_host = true                                     \
+        .install_usb_host = true,                                    \
+        .tx_transfers_num = 4,                                       \
+        .reconnect = false,                                          \
+        .rx_coalesce_bytes = 0,                                      \
+        .rx_coalesce_timeout_ms = 0,                                 \
+        .rx_terminator = -1,                                         \
+        .tx_coalesce_bytes = 0,                                      \
+        .tx_coalesce_us = 0                                          \
     }
 #define ESP_MODEM_DEFAULT_USB_CONFIG(_vid, _pid, _intf) ESP_MODEM_DEFAULT_USB_CONFIG_DUAL(_vid, _pid, _intf, -1)
 
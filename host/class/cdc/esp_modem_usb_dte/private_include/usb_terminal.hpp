@@ -1,5 +1,5 @@
 /*
- * SPDX-FileCopyrightText: 2022-2023 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2022-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
@@ -10,12 +10,24 @@
 struct esp_modem_dte_config;
 
 namespace esp_modem {
+class UsbModem;
+
 /**
- * @brief Create a usb terminal object
+ * @brief Create a usb modem object shared by terminals of one modem
  *
  * @param[in] config    DTE USB configuration
+ * @return std::shared_ptr<UsbModem>
+ */
+std::shared_ptr<UsbModem> create_usb_modem(const esp_modem_dte_config *config);
+
+/**
+ * @brief Create a usb terminal object
+ *
+ * The primary terminal must be created first, it opens the USB device.
+ *
+ * @param[in] modem     USB modem of the terminal
  * @param[in] term_idx  Terminal index. 0: primary terminal, 1: secondary terminal.
  * @return std::unique_ptr<Terminal>
  */
-std::unique_ptr<Terminal> create_usb_terminal(const esp_modem_dte_config *config, int term_idx = 0);
+std::unique_ptr<Terminal> create_usb_terminal(const std::shared_ptr<UsbModem> &modem, int term_idx = 0);
 }  // namespace esp_modem
@@ -11,16 +11,33 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include "freertos/event_groups.h"
+#include "freertos/ringbuf.h"
 #include "soc/soc_caps.h"
 #include "esp_log.h"
 #include "esp_check.h"
 #include "esp_system.h"
+#include "esp_idf_version.h"
+#include "sdkconfig.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_timer.h"
+#endif
 
 #include "usb/usb_host.h"
 #include "usb/cdc_acm_host.h"
 #include "cdc_host_descriptor_parsing.h"
 #include "cdc_host_types.h"
+#include "cdc_host_framing.h"
+#include "cdc_host_attr.h"
+#if USB_HOST_SHARED_CLIENT_ENABLED
+#define USB_HOST_CLIENT_DRIVER  CDC_ACM
+#include "usb/usb_host_client_macros.h"
+#else
+#include "usb_host_client_fallback.h"
+#endif
 
 static const char *TAG = "cdc_acm";
 
@@ -28,6 +45,15 @@ static const char *TAG = "cdc_acm";
 #define CDC_ACM_CTRL_TRANSFER_SIZE (64)   // All standard CTRL requests and responses fit in this size
 #define CDC_ACM_CTRL_TIMEOUT_MS    (5000) // Every CDC device should be able to respond to CTRL transfer in 5 seconds
 
+// RX append alignment
+// For targets that must sync internal memory through L1CACHE, data_buffer of IN transfer must stay aligned to cache line.
+// The appended data are received at aligned offset and then moved to the end of the already received data.
+#if SOC_CACHE_INTERNAL_MEM_VIA_L1CACHE
+#define CDC_ACM_IN_APPEND_ALIGN    (CONFIG_CACHE_L1_CACHE_LINE_SIZE)
+#else
+#define CDC_ACM_IN_APPEND_ALIGN    (1)
+#endif
+
 // CDC-ACM spinlock
 static portMUX_TYPE cdc_acm_lock = portMUX_INITIALIZER_UNLOCKED;
 #define CDC_ACM_ENTER_CRITICAL()   portENTER_CRITICAL(&cdc_acm_lock)
@@ -36,6 +62,10 @@ static portMUX_TYPE cdc_acm_lock = portMUX_INITIALIZER_UNLOCKED;
 // CDC-ACM events
 #define CDC_ACM_TEARDOWN          BIT0
 #define CDC_ACM_TEARDOWN_COMPLETE BIT1
+#define CDC_ACM_NEW_DEV           BIT2
+
+// Maximum number of USB devices on the bus, limited by USB device address
+#define CDC_ACM_MAX_USB_DEVICES   (127)
 
 // CDC-ACM check macros
 #define CDC_ACM_CHECK(cond, ret_val) ({                                     \
@@ -58,10 +88,21 @@ typedef struct {
     EventGroupHandle_t event_group;
     cdc_acm_new_dev_callback_t new_dev_cb;
     SLIST_HEAD(list_dev, cdc_dev_s) cdc_devices_list;   /*!< List of open pseudo devices */
+    bool shared_client;                                 /*!< Registered to usb_host_shared_client, which handles the events */
 } cdc_acm_obj_t;
 
 static cdc_acm_obj_t *p_cdc_acm_obj = NULL;
 
+#if USB_HOST_SHARED_CLIENT_ENABLED
+// Bus suspend and resume hooks
+static esp_err_t cdc_acm_pm_suspend(void *arg);
+static esp_err_t cdc_acm_pm_resume(void *arg);
+static const usb_host_pm_ops_t cdc_acm_pm_ops = {
+    .suspend = cdc_acm_pm_suspend,
+    .resume = cdc_acm_pm_resume,
+};
+#endif
+
 /**
  * @brief Default CDC-ACM driver configuration
  *
@@ -92,6 +133,15 @@ static void notif_xfer_cb(usb_transfer_t *transfer);
  */
 static void in_xfer_cb(usb_transfer_t *transfer);
 
+/**
+ * @brief Data received callback of IN transfer ring
+ *
+ * Used instead of in_xfer_cb() if more IN transfers are queued at once
+ *
+ * @param[in] transfer Transfer that triggered the callback
+ */
+static void in_ring_xfer_cb(usb_transfer_t *transfer);
+
 /**
  * @brief Data send callback
  *
@@ -101,6 +151,15 @@ static void in_xfer_cb(usb_transfer_t *transfer);
  */
 static void out_xfer_cb(usb_transfer_t *transfer);
 
+/**
+ * @brief Asynchronous data send callback
+ *
+ * Used for bulk OUT transfers from the asynchronous TX pool
+ *
+ * @param[in] transfer Transfer that triggered the callback
+ */
+static void out_async_xfer_cb(usb_transfer_t *transfer);
+
 /**
  * @brief USB Host Client event callback
  *
@@ -137,18 +196,172 @@ static esp_err_t send_cdc_request(cdc_dev_t *cdc_dev, bool in_transfer, cdc_requ
  *
  * @param[in] cdc_dev Pointer to CDC device
  */
-static void cdc_acm_reset_in_transfer(cdc_dev_t *cdc_dev)
+static void CDC_ACM_DATA_PATH_ATTR cdc_acm_reset_in_transfer(cdc_dev_t *cdc_dev)
 {
     assert(cdc_dev->data.in_xfer);
     usb_transfer_t *transfer = cdc_dev->data.in_xfer;
     uint8_t **ptr = (uint8_t **)(&(transfer->data_buffer));
     *ptr = cdc_dev->data.in_data_buffer_base;
+    cdc_dev->data.in_data_len = 0;
     transfer->num_bytes = transfer->data_buffer_size;
     // This is a hotfix for IDF changes, where 'transfer->data_buffer_size' does not contain actual buffer length,
     // but *allocated* buffer length, which can be larger if CONFIG_HEAP_POISONING_COMPREHENSIVE is enabled
     transfer->num_bytes -= transfer->data_buffer_size % cdc_dev->data.in_mps;
 }
 
+/**
+ * @brief Get time for statistics
+ *
+ * @return Time in microseconds
+ */
+static int64_t CDC_ACM_DATA_PATH_ATTR cdc_acm_stats_time_us(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return esp_timer_get_time();
+#endif
+}
+
+/**
+ * @brief Get time histogram bucket
+ *
+ * Bucket 0: < bucket0_us, bucket i: <bucket0_us * 2^(i-1); bucket0_us * 2^i), last bucket: everything above
+ *
+ * @param[in] time_us    Measured time
+ * @param[in] bucket0_us Upper limit of the first bucket
+ * @return Index of histogram bucket
+ */
+static unsigned CDC_ACM_DATA_PATH_ATTR cdc_acm_stats_bucket(int64_t time_us, uint32_t bucket0_us)
+{
+    unsigned bucket = 0;
+    int64_t time = time_us / bucket0_us;
+    while (time > 0 && bucket < CDC_ACM_HOST_STATS_HIST_BUCKETS - 1) {
+        time >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/**
+ * @brief Account finished bulk transfer in statistics
+ *
+ * @param[in] cdc_dev  Pointer to CDC device
+ * @param[in] transfer Finished data transfer
+ */
+static void CDC_ACM_DATA_PATH_ATTR cdc_acm_stats_transfer_done(cdc_dev_t *cdc_dev, const usb_transfer_t *transfer)
+{
+    CDC_ACM_ENTER_CRITICAL();
+    if (transfer->status == USB_TRANSFER_STATUS_COMPLETED) {
+        if (transfer->bEndpointAddress & USB_B_ENDPOINT_ADDRESS_EP_DIR_MASK) {
+            cdc_dev->stats.transfers_in++;
+            cdc_dev->stats.bytes_in += transfer->actual_num_bytes;
+        } else {
+            cdc_dev->stats.transfers_out++;
+            cdc_dev->stats.bytes_out += transfer->actual_num_bytes;
+        }
+    } else if (transfer->status < CDC_ACM_HOST_STATS_XFER_STATUS_NUM) {
+        cdc_dev->stats.transfer_errors[transfer->status]++;
+    }
+    CDC_ACM_EXIT_CRITICAL();
+}
+
+/**
+ * @brief Call data received callback and account its duration in statistics
+ *
+ * If framing is used, the data are passed to the framer instead, it calls the frame received callback for each frame.
+ *
+ * @param[in] cdc_dev  Pointer to CDC device
+ * @param[in] data     Received data
+ * @param[in] data_len Length of received data
+ * @return Return value of data received callback
+ */
+static bool CDC_ACM_DATA_PATH_ATTR cdc_acm_data_cb_call(cdc_dev_t *cdc_dev, uint8_t *data, size_t data_len)
+{
+    const int64_t start = cdc_acm_stats_time_us();
+    CLIENT_TRACE(DELIVER, cdc_dev->data.in_xfer->bEndpointAddress, data_len, cdc_dev);
+    CLIENT_TRACE(CALLBACK_ENTER, cdc_dev->data.in_xfer->bEndpointAddress, 0, cdc_dev);
+    const bool data_processed = cdc_dev->data.framer.cb ?
+                                cdc_framer_process(&cdc_dev->data.framer, data, data_len) :
+                                cdc_dev->data.in_cb(data, data_len, cdc_dev->cb_arg);
+    CLIENT_TRACE(CALLBACK_EXIT, cdc_dev->data.in_xfer->bEndpointAddress, 0, cdc_dev);
+    const unsigned bucket = cdc_acm_stats_bucket(cdc_acm_stats_time_us() - start, 16);
+    CDC_ACM_ENTER_CRITICAL();
+    cdc_dev->stats.rx_cb_histogram[bucket]++;
+    CDC_ACM_EXIT_CRITICAL();
+    return data_processed;
+}
+
+/**
+ * @brief Get number of bytes waiting in RX ring buffer
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ * @return Number of bytes
+ */
+static size_t CDC_ACM_DATA_PATH_ATTR cdc_acm_rx_ring_get_len(cdc_dev_t *cdc_dev)
+{
+    UBaseType_t len = 0;
+    vRingbufferGetInfo(cdc_dev->data.rx_ring, NULL, NULL, NULL, NULL, &len);
+    return len;
+}
+
+/**
+ * @brief Notify user about RX ring buffer watermark
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ * @param[in] type    CDC_ACM_HOST_RX_HIGH_WATERMARK or CDC_ACM_HOST_RX_LOW_WATERMARK
+ * @param[in] len     Number of bytes waiting in RX ring buffer
+ */
+static void CDC_ACM_DATA_PATH_ATTR cdc_acm_rx_ring_watermark_notify(cdc_dev_t *cdc_dev, cdc_acm_host_dev_event_t type, size_t len)
+{
+    if (cdc_dev->notif.cb) {
+        const cdc_acm_host_dev_event_data_t watermark_event = {
+            .type = type,
+            .data.rx_buffered = len,
+        };
+        cdc_dev->notif.cb(&watermark_event, cdc_dev->cb_arg);
+    }
+}
+
+/**
+ * @brief Store received data in RX ring buffer
+ *
+ * The IN transfer is submitted again only if the ring buffer can accept the whole next transfer.
+ * Otherwise the reception is paused and cdc_acm_host_data_rx_read() resumes it.
+ *
+ * @param[in] cdc_dev  Pointer to CDC device
+ * @param[in] transfer Completed IN transfer
+ * @return true  The IN transfer can be submitted again
+ * @return false The reception is paused
+ */
+static bool CDC_ACM_DATA_PATH_ATTR cdc_acm_rx_ring_push(cdc_dev_t *cdc_dev, usb_transfer_t *transfer)
+{
+    if (transfer->actual_num_bytes > 0) {
+        // The ring buffer has always enough space, it was checked before the transfer was submitted
+        const BaseType_t sent = xRingbufferSend(cdc_dev->data.rx_ring, transfer->data_buffer, transfer->actual_num_bytes, 0);
+        assert(sent == pdTRUE);
+        (void)sent;
+    }
+
+    const size_t len = cdc_acm_rx_ring_get_len(cdc_dev);
+    if (cdc_dev->data.rx_high_watermark && !cdc_dev->data.rx_above_watermark && len >= cdc_dev->data.rx_high_watermark) {
+        cdc_dev->data.rx_above_watermark = true;
+        cdc_acm_rx_ring_watermark_notify(cdc_dev, CDC_ACM_HOST_RX_HIGH_WATERMARK, len);
+    }
+
+    bool resubmit;
+    CDC_ACM_ENTER_CRITICAL();
+    resubmit = (xRingbufferGetCurFreeSize(cdc_dev->data.rx_ring) >= (size_t)transfer->num_bytes);
+    cdc_dev->data.rx_paused = !resubmit;
+    CDC_ACM_EXIT_CRITICAL();
+    if (!resubmit) {
+        ESP_LOGD(TAG, "RX ring buffer full, pausing BULK IN");
+    }
+    return resubmit;
+}
+
 /**
  * @brief CDC-ACM driver handling task
  *
@@ -182,14 +395,19 @@ static void cdc_acm_client_task(void *arg)
  *
  * This function will cancel ongoing transfer a reset its endpoint to ready state.
  *
- * @param[in] dev_hdl USB device handle
+ * @param[in] cdc_dev Pointer to CDC device
  * @param[in] transfer Transfer to be cancelled
  * @return esp_err_t
  */
-static esp_err_t cdc_acm_reset_transfer_endpoint(usb_device_handle_t dev_hdl, usb_transfer_t *transfer)
+static esp_err_t cdc_acm_reset_transfer_endpoint(cdc_dev_t *cdc_dev, usb_transfer_t *transfer)
 {
-    assert(dev_hdl);
+    assert(cdc_dev);
     assert(transfer);
+    usb_device_handle_t dev_hdl = cdc_dev->dev_hdl;
+
+    CDC_ACM_ENTER_CRITICAL();
+    cdc_dev->stats.endpoint_resets++;
+    CDC_ACM_EXIT_CRITICAL();
 
     ESP_RETURN_ON_ERROR(usb_host_endpoint_halt(dev_hdl, transfer->bEndpointAddress), TAG,);
     ESP_RETURN_ON_ERROR(usb_host_endpoint_flush(dev_hdl, transfer->bEndpointAddress), TAG,);
@@ -198,39 +416,67 @@ static esp_err_t cdc_acm_reset_transfer_endpoint(usb_device_handle_t dev_hdl, us
 }
 
 /**
- * @brief Start CDC device
+ * @brief Start polling of BULK IN endpoint
  *
- * After this call, USB host peripheral will continuously poll IN endpoints.
+ * The BULK IN transfer is not submitted if the reception is paused by full RX ring buffer.
  *
- * @param cdc_dev
- * @param[in] event_cb  Device event callback
- * @param[in] in_cb     Data received callback
- * @param[in] user_arg  Optional user's argument, that will be passed to the callbacks
+ * @param[in] cdc_dev Pointer to CDC device
  * @return esp_err_t
  */
-static esp_err_t cdc_acm_start(cdc_dev_t *cdc_dev, cdc_acm_host_dev_callback_t event_cb, cdc_acm_data_callback_t in_cb, void *user_arg)
+static esp_err_t cdc_acm_data_in_submit(cdc_dev_t *cdc_dev)
+{
+    if (cdc_dev->data.in_xfer && !cdc_dev->data.rx_paused) {
+        ESP_LOGD(TAG, "Submitting poll for BULK IN transfer");
+        ESP_RETURN_ON_ERROR(CLIENT_TRANSFER_SUBMIT(cdc_dev->data.in_xfer), TAG,);
+        for (int i = 0; i < cdc_dev->data.in_ring_num; i++) {
+            ESP_RETURN_ON_ERROR(CLIENT_TRANSFER_SUBMIT(cdc_dev->data.in_ring[i]), TAG,);
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Cancel polling of IN endpoints and asynchronous transmissions in flight
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ */
+static void cdc_acm_transfers_cancel(cdc_dev_t *cdc_dev)
+{
+    if (cdc_dev->data.in_xfer) {
+        ESP_ERROR_CHECK(cdc_acm_reset_transfer_endpoint(cdc_dev, cdc_dev->data.in_xfer));
+    }
+    if (cdc_dev->notif.xfer != NULL) {
+        ESP_ERROR_CHECK(cdc_acm_reset_transfer_endpoint(cdc_dev, cdc_dev->notif.xfer));
+    }
+    if ((cdc_dev->data.out_pool != NULL) && (uxQueueMessagesWaiting(cdc_dev->data.out_pool_free) < (UBaseType_t)cdc_dev->data.out_pool_num)) {
+        ESP_ERROR_CHECK(cdc_acm_reset_transfer_endpoint(cdc_dev, cdc_dev->data.out_pool[0]));
+    }
+}
+
+/**
+ * @brief Claim CDC interfaces and start polling their IN endpoints
+ *
+ * The BULK IN transfer is not submitted if the reception is paused by full RX ring buffer.
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ * @return esp_err_t
+ */
+static esp_err_t cdc_acm_interfaces_claim(cdc_dev_t *cdc_dev)
 {
     esp_err_t ret = ESP_OK;
+    bool notif_claimed = false;
     assert(cdc_dev);
 
-    CDC_ACM_ENTER_CRITICAL();
-    cdc_dev->notif.cb = event_cb;
-    cdc_dev->data.in_cb = in_cb;
-    cdc_dev->cb_arg = user_arg;
-    CDC_ACM_EXIT_CRITICAL();
-
     // Claim data interface and start polling its IN endpoint
-    ESP_GOTO_ON_ERROR(
+    ESP_RETURN_ON_ERROR(
         usb_host_interface_claim(
             p_cdc_acm_obj->cdc_acm_client_hdl,
             cdc_dev->dev_hdl,
             cdc_dev->data.intf_desc->bInterfaceNumber,
             cdc_dev->data.intf_desc->bAlternateSetting),
-        err, TAG, "Could not claim interface");
-    if (cdc_dev->data.in_xfer) {
-        ESP_LOGD(TAG, "Submitting poll for BULK IN transfer");
-        ESP_ERROR_CHECK(usb_host_transfer_submit(cdc_dev->data.in_xfer));
-    }
+        TAG, "Could not claim interface");
+    // Submit fails e.g. if the device was disconnected again, this also runs on reconnection from the client task
+    ESP_GOTO_ON_ERROR(cdc_acm_data_in_submit(cdc_dev), err, TAG, "Could not submit BULK IN transfer");
 
     // If notification are supported, claim its interface and start polling its IN endpoint
     if (cdc_dev->notif.xfer) {
@@ -242,25 +488,74 @@ static esp_err_t cdc_acm_start(cdc_dev_t *cdc_dev, cdc_acm_host_dev_callback_t e
                     cdc_dev->notif.intf_desc->bInterfaceNumber,
                     cdc_dev->notif.intf_desc->bAlternateSetting),
                 err, TAG, "Could not claim interface");
+            notif_claimed = true;
         }
         ESP_LOGD(TAG, "Submitting poll for INTR IN transfer");
-        ESP_ERROR_CHECK(usb_host_transfer_submit(cdc_dev->notif.xfer));
+        ESP_GOTO_ON_ERROR(CLIENT_TRANSFER_SUBMIT(cdc_dev->notif.xfer), err, TAG, "Could not submit INTR IN transfer");
     }
-
-    // Everything OK, add the device into list and return
-    CDC_ACM_ENTER_CRITICAL();
-    SLIST_INSERT_HEAD(&p_cdc_acm_obj->cdc_devices_list, cdc_dev, list_entry);
-    CDC_ACM_EXIT_CRITICAL();
     return ret;
 
 err:
-    usb_host_interface_release(p_cdc_acm_obj->cdc_acm_client_hdl, cdc_dev->dev_hdl, cdc_dev->data.intf_desc->bInterfaceNumber);
-    if (cdc_dev->notif.xfer && (cdc_dev->notif.intf_desc != cdc_dev->data.intf_desc)) {
+    // IN transfers submitted so far are cancelled, the interfaces cannot be released with transfers in flight
+    if (cdc_dev->data.in_xfer) {
+        cdc_acm_reset_transfer_endpoint(cdc_dev, cdc_dev->data.in_xfer);
+    }
+    if (notif_claimed) {
         usb_host_interface_release(p_cdc_acm_obj->cdc_acm_client_hdl, cdc_dev->dev_hdl, cdc_dev->notif.intf_desc->bInterfaceNumber);
     }
+    usb_host_interface_release(p_cdc_acm_obj->cdc_acm_client_hdl, cdc_dev->dev_hdl, cdc_dev->data.intf_desc->bInterfaceNumber);
     return ret;
 }
 
+/**
+ * @brief Cancel all transfers of CDC device and release its interfaces
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ */
+static void cdc_acm_interfaces_release(cdc_dev_t *cdc_dev)
+{
+    assert(cdc_dev);
+
+    // Cancel polling of BULK IN and INTERRUPT IN and asynchronous transmissions that are still in flight
+    cdc_acm_transfers_cancel(cdc_dev);
+
+    // Release all interfaces
+    ESP_ERROR_CHECK(usb_host_interface_release(p_cdc_acm_obj->cdc_acm_client_hdl, cdc_dev->dev_hdl, cdc_dev->data.intf_desc->bInterfaceNumber));
+    if ((cdc_dev->notif.intf_desc != NULL) && (cdc_dev->notif.intf_desc != cdc_dev->data.intf_desc)) {
+        ESP_ERROR_CHECK(usb_host_interface_release(p_cdc_acm_obj->cdc_acm_client_hdl, cdc_dev->dev_hdl, cdc_dev->notif.intf_desc->bInterfaceNumber));
+    }
+}
+
+/**
+ * @brief Start CDC device
+ *
+ * After this call, USB host peripheral will continuously poll IN endpoints.
+ *
+ * @param cdc_dev
+ * @param[in] event_cb  Device event callback
+ * @param[in] in_cb     Data received callback
+ * @param[in] user_arg  Optional user's argument, that will be passed to the callbacks
+ * @return esp_err_t
+ */
+static esp_err_t cdc_acm_start(cdc_dev_t *cdc_dev, cdc_acm_host_dev_callback_t event_cb, cdc_acm_data_callback_t in_cb, void *user_arg)
+{
+    assert(cdc_dev);
+
+    CDC_ACM_ENTER_CRITICAL();
+    cdc_dev->notif.cb = event_cb;
+    cdc_dev->data.in_cb = in_cb;
+    cdc_dev->cb_arg = user_arg;
+    CDC_ACM_EXIT_CRITICAL();
+
+    ESP_RETURN_ON_ERROR(cdc_acm_interfaces_claim(cdc_dev), TAG,);
+
+    // Everything OK, add the device into list and return
+    CDC_ACM_ENTER_CRITICAL();
+    SLIST_INSERT_HEAD(&p_cdc_acm_obj->cdc_devices_list, cdc_dev, list_entry);
+    CDC_ACM_EXIT_CRITICAL();
+    return ESP_OK;
+}
+
 static void cdc_acm_transfers_free(cdc_dev_t *cdc_dev);
 /**
  * @brief Helper function that releases resources claimed by CDC device
@@ -273,11 +568,91 @@ static void cdc_acm_transfers_free(cdc_dev_t *cdc_dev);
 static void cdc_acm_device_remove(cdc_dev_t *cdc_dev)
 {
     assert(cdc_dev);
+    cdc_tx_coalescer_deinit(&cdc_dev->data.tx_coalescer);
     cdc_acm_transfers_free(cdc_dev);
-    free(cdc_dev->cdc_func_desc);
+    if (cdc_dev->data.rx_ring) {
+        CLIENT_MEM_FREE(BUFFER, cdc_dev->data.rx_ring_size);
+        vRingbufferDelete(cdc_dev->data.rx_ring);
+    }
+    if (cdc_dev->reconnect.serial) {
+        CLIENT_FREE(DESCRIPTOR, cdc_dev->reconnect.serial, strlen(cdc_dev->reconnect.serial) + 1);
+    }
     // We don't check the error code of usb_host_device_close, as the close might fail, if someone else is still using the device (not all interfaces are released)
-    usb_host_device_close(p_cdc_acm_obj->cdc_acm_client_hdl, cdc_dev->dev_hdl); // Gracefully continue on error
-    free(cdc_dev);
+    if (cdc_dev->dev_hdl) {
+        CLIENT_DEVICE_CLOSE(p_cdc_acm_obj->cdc_acm_client_hdl, cdc_dev->dev_hdl); // Gracefully continue on error
+    }
+    CLIENT_FREE(CONTROL, cdc_dev, sizeof(cdc_dev_t));
+}
+
+/**
+ * @brief Check if USB device matches requested VID/PID and serial number
+ *
+ * @param[in] dev_hdl USB device handle
+ * @param[in] vid     Vendor ID or CDC_HOST_ANY_VID
+ * @param[in] pid     Product ID or CDC_HOST_ANY_PID
+ * @param[in] serial  Serial number string or NULL for any
+ * @return true: The device matches
+ */
+static bool cdc_acm_usb_device_matches(usb_device_handle_t dev_hdl, uint16_t vid, uint16_t pid, const char *serial)
+{
+    const usb_device_desc_t *device_desc;
+    ESP_ERROR_CHECK(usb_host_get_device_descriptor(dev_hdl, &device_desc));
+    if ((vid != device_desc->idVendor && vid != CDC_HOST_ANY_VID) ||
+            (pid != device_desc->idProduct && pid != CDC_HOST_ANY_PID)) {
+        return false;
+    }
+    if (serial == NULL) {
+        return true;
+    }
+
+    // Serial number string descriptor is in UTF-16LE, compare it with ASCII string
+    usb_device_info_t dev_info;
+    if (usb_host_device_info(dev_hdl, &dev_info) != ESP_OK || dev_info.str_desc_serial_num == NULL) {
+        return false;
+    }
+    const usb_str_desc_t *serial_desc = dev_info.str_desc_serial_num;
+    const size_t serial_len = (serial_desc->bLength - USB_STANDARD_DESC_SIZE) / 2;
+    for (size_t i = 0; i < serial_len; i++) {
+        if (serial[i] == '\0' || serial_desc->wData[i] != (uint8_t)serial[i]) {
+            return false;
+        }
+    }
+    return serial[serial_len] == '\0';
+}
+
+/**
+ * @brief Get serial number of USB device
+ *
+ * @param[in]  dev_hdl    USB device handle
+ * @param[out] serial_ret Allocated serial number string (ASCII), NULL if the device has no serial number or the serial number is not ASCII
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_NO_MEM: Not enough memory for the string
+ */
+static esp_err_t cdc_acm_usb_device_serial_get(usb_device_handle_t dev_hdl, char **serial_ret)
+{
+    *serial_ret = NULL;
+    usb_device_info_t dev_info;
+    if (usb_host_device_info(dev_hdl, &dev_info) != ESP_OK || dev_info.str_desc_serial_num == NULL) {
+        return ESP_OK;
+    }
+    const usb_str_desc_t *serial_desc = dev_info.str_desc_serial_num;
+    const size_t serial_len = (serial_desc->bLength - USB_STANDARD_DESC_SIZE) / 2;
+    char *serial = CLIENT_MALLOC(DESCRIPTOR, serial_len + 1);
+    if (serial == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t i = 0; i < serial_len; i++) {
+        if (serial_desc->wData[i] == 0 || serial_desc->wData[i] >= 0x80) {
+            ESP_LOGW(TAG, "Serial number is not ASCII, only VID and PID are checked");
+            CLIENT_FREE(DESCRIPTOR, serial, serial_len + 1);
+            return ESP_OK;
+        }
+        serial[i] = (char)serial_desc->wData[i];
+    }
+    serial[serial_len] = '\0';
+    *serial_ret = serial;
+    return ESP_OK;
 }
 
 /**
@@ -285,21 +660,22 @@ static void cdc_acm_device_remove(cdc_dev_t *cdc_dev)
  *
  * This function has two regular return paths:
  * 1. USB device with matching VID/PID is already opened by this driver: allocate new CDC device on top of the already opened USB device.
- * 2. USB device with matching VID/PID is NOT opened by this driver yet: poll USB connected devices until it is found.
+ * 2. USB device with matching VID/PID is NOT opened by this driver yet: check USB connected devices every time a new device is connected, until it is found.
  *
  * @note This function will block for timeout_ms, if the device is not enumerated at the moment of calling this function.
  * @param[in] vid Vendor ID
  * @param[in] pid Product ID
+ * @param[in] serial Serial number string, NULL for any
  * @param[in] timeout_ms Connection timeout [ms]
  * @param[out] dev CDC-ACM device
  * @return esp_err_t
  */
-static esp_err_t cdc_acm_find_and_open_usb_device(uint16_t vid, uint16_t pid, int timeout_ms, cdc_dev_t **dev)
+static esp_err_t cdc_acm_find_and_open_usb_device(uint16_t vid, uint16_t pid, const char *serial, int timeout_ms, cdc_dev_t **dev)
 {
     assert(p_cdc_acm_obj);
     assert(dev);
 
-    *dev = calloc(1, sizeof(cdc_dev_t));
+    *dev = CLIENT_CALLOC(CONTROL, 1, sizeof(cdc_dev_t));
     if (*dev == NULL) {
         return ESP_ERR_NO_MEM;
     }
@@ -308,24 +684,24 @@ static esp_err_t cdc_acm_find_and_open_usb_device(uint16_t vid, uint16_t pid, in
     ESP_LOGD(TAG, "Checking list of opened USB devices");
     cdc_dev_t *cdc_dev;
     SLIST_FOREACH(cdc_dev, &p_cdc_acm_obj->cdc_devices_list, list_entry) {
-        const usb_device_desc_t *device_desc;
-        ESP_ERROR_CHECK(usb_host_get_device_descriptor(cdc_dev->dev_hdl, &device_desc));
-        if ((vid == device_desc->idVendor || vid == CDC_HOST_ANY_VID) &&
-                (pid == device_desc->idProduct || pid == CDC_HOST_ANY_PID)) {
+        if (cdc_dev->dev_hdl && cdc_acm_usb_device_matches(cdc_dev->dev_hdl, vid, pid, serial)) { // Skip devices in standby
             // Return path 1:
             (*dev)->dev_hdl = cdc_dev->dev_hdl;
             return ESP_OK;
         }
     }
 
-    // Second, poll connected devices until new device is connected or timeout
+    // Second, check connected devices until new device is connected or timeout
     TickType_t timeout_ticks = (timeout_ms == 0) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
     TimeOut_t connection_timeout;
     vTaskSetTimeOutState(&connection_timeout);
 
     do {
+        // Clear the new device flag before checking the devices, so we do not miss device connected during the check
+        xEventGroupClearBits(p_cdc_acm_obj->event_group, CDC_ACM_NEW_DEV);
+
         ESP_LOGD(TAG, "Checking list of connected USB devices");
-        uint8_t dev_addr_list[10];
+        uint8_t dev_addr_list[CDC_ACM_MAX_USB_DEVICES];
         int num_of_devices;
         ESP_ERROR_CHECK(usb_host_device_addr_list_fill(sizeof(dev_addr_list), dev_addr_list, &num_of_devices));
 
@@ -333,25 +709,24 @@ static esp_err_t cdc_acm_find_and_open_usb_device(uint16_t vid, uint16_t pid, in
         for (int i = 0; i < num_of_devices; i++) {
             usb_device_handle_t current_device;
             // Open USB device
-            if (usb_host_device_open(p_cdc_acm_obj->cdc_acm_client_hdl, dev_addr_list[i], &current_device) != ESP_OK) {
+            if (CLIENT_DEVICE_OPEN(p_cdc_acm_obj->cdc_acm_client_hdl, dev_addr_list[i], &current_device) != ESP_OK) {
                 continue; // In case we failed to open this device, continue with next one in the list
             }
             assert(current_device);
-            const usb_device_desc_t *device_desc;
-            ESP_ERROR_CHECK(usb_host_get_device_descriptor(current_device, &device_desc));
-            if ((vid == device_desc->idVendor || vid == CDC_HOST_ANY_VID) &&
-                    (pid == device_desc->idProduct || pid == CDC_HOST_ANY_PID)) {
+            if (cdc_acm_usb_device_matches(current_device, vid, pid, serial)) {
                 // Return path 2:
                 (*dev)->dev_hdl = current_device;
                 return ESP_OK;
             }
-            usb_host_device_close(p_cdc_acm_obj->cdc_acm_client_hdl, current_device);
+            CLIENT_DEVICE_CLOSE(p_cdc_acm_obj->cdc_acm_client_hdl, current_device);
         }
-        vTaskDelay(pdMS_TO_TICKS(50));
+
+        // Wait until a new device is connected, instead of polling the device list
+        xEventGroupWaitBits(p_cdc_acm_obj->event_group, CDC_ACM_NEW_DEV, pdFALSE, pdFALSE, timeout_ticks);
     } while (xTaskCheckForTimeOut(&connection_timeout, &timeout_ticks) == pdFALSE);
 
     // Timeout was reached, clean-up
-    free(*dev);
+    CLIENT_FREE(CONTROL, *dev, sizeof(cdc_dev_t));
     *dev = NULL;
     return ESP_ERR_NOT_FOUND;
 }
@@ -364,18 +739,23 @@ esp_err_t cdc_acm_host_install(const cdc_acm_host_driver_config_t *driver_config
     if (driver_config == NULL) {
         driver_config = &cdc_acm_driver_config_default;
     }
+#if !USB_HOST_SHARED_CLIENT_ENABLED
+    CDC_ACM_CHECK(!driver_config->shared_client, ESP_ERR_NOT_SUPPORTED);
+#endif
 
     // Allocate all we need for this driver
     esp_err_t ret;
-    cdc_acm_obj_t *cdc_acm_obj = heap_caps_calloc(1, sizeof(cdc_acm_obj_t), MALLOC_CAP_DEFAULT);
+    cdc_acm_obj_t *cdc_acm_obj = CLIENT_CALLOC(CONTROL, 1, sizeof(cdc_acm_obj_t));
     EventGroupHandle_t event_group = xEventGroupCreate();
     SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
     TaskHandle_t driver_task_h = NULL;
-    xTaskCreatePinnedToCore(
-        cdc_acm_client_task, "USB-CDC", driver_config->driver_task_stack_size, NULL,
-        driver_config->driver_task_priority, &driver_task_h, driver_config->xCoreID);
+    if (!driver_config->shared_client) {
+        xTaskCreatePinnedToCore(
+            cdc_acm_client_task, "USB-CDC", driver_config->driver_task_stack_size, NULL,
+            driver_config->driver_task_priority, &driver_task_h, driver_config->xCoreID);
+    }
 
-    if (cdc_acm_obj == NULL || driver_task_h == NULL || event_group == NULL || mutex == NULL) {
+    if (cdc_acm_obj == NULL || (driver_task_h == NULL && !driver_config->shared_client) || event_group == NULL || mutex == NULL) {
         ret = ESP_ERR_NO_MEM;
         goto err;
     }
@@ -388,7 +768,14 @@ esp_err_t cdc_acm_host_install(const cdc_acm_host_driver_config_t *driver_config
         .async.client_event_callback = usb_event_cb,
         .async.callback_arg = NULL
     };
-    ESP_GOTO_ON_ERROR(usb_host_client_register(&client_config, &usb_client), err, TAG, "Failed to register USB host client");
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    if (driver_config->shared_client) {
+        ESP_GOTO_ON_ERROR(usb_host_shared_client_register(usb_event_cb, NULL, &usb_client), err, TAG, "Failed to register to shared USB host client");
+    } else
+#endif
+    {
+        ESP_GOTO_ON_ERROR(usb_host_client_register(&client_config, &usb_client), err, TAG, "Failed to register USB host client");
+    }
 
     // Initialize CDC-ACM driver structure
     SLIST_INIT(&(cdc_acm_obj->cdc_devices_list));
@@ -396,6 +783,7 @@ esp_err_t cdc_acm_host_install(const cdc_acm_host_driver_config_t *driver_config
     cdc_acm_obj->open_close_mutex = mutex;
     cdc_acm_obj->cdc_acm_client_hdl = usb_client;
     cdc_acm_obj->new_dev_cb = driver_config->new_dev_cb;
+    cdc_acm_obj->shared_client = driver_config->shared_client;
 
     // Between 1st call of this function and following section, another task might try to install this driver:
     // Make sure that there is only one instance of this driver in the system
@@ -409,15 +797,28 @@ esp_err_t cdc_acm_host_install(const cdc_acm_host_driver_config_t *driver_config
         p_cdc_acm_obj = cdc_acm_obj;
     }
     CDC_ACM_EXIT_CRITICAL();
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    // Only fails if the driver is registered already, which the check above excludes
+    ESP_ERROR_CHECK(usb_host_pm_register(USB_HOST_PM_DRIVER_CDC_ACM, &cdc_acm_pm_ops, NULL));
+#endif
 
     // Everything OK: Start CDC-Driver task and return
-    xTaskNotifyGive(driver_task_h);
+    if (driver_task_h) {
+        xTaskNotifyGive(driver_task_h);
+    }
     return ESP_OK;
 
 client_err:
-    usb_host_client_deregister(usb_client);
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    if (driver_config->shared_client) {
+        usb_host_shared_client_deregister(usb_event_cb, NULL);
+    } else
+#endif
+    {
+        usb_host_client_deregister(usb_client);
+    }
 err: // Clean-up
-    free(cdc_acm_obj);
+    CLIENT_FREE(CONTROL, cdc_acm_obj, sizeof(cdc_acm_obj_t));
     if (event_group) {
         vEventGroupDelete(event_group);
     }
@@ -441,28 +842,44 @@ esp_err_t cdc_acm_host_uninstall()
 
     xSemaphoreTake(p_cdc_acm_obj->open_close_mutex, portMAX_DELAY); // Wait for all open/close calls to finish
 
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    // Fails if a suspend hook is waiting for open_close_mutex. Otherwise no hook can run from this point
+    ESP_GOTO_ON_ERROR(usb_host_pm_deregister(USB_HOST_PM_DRIVER_CDC_ACM), unblock, TAG, "Bus suspend or resume in progress");
+#endif
+
     CDC_ACM_ENTER_CRITICAL();
     if (SLIST_EMPTY(&p_cdc_acm_obj->cdc_devices_list)) { // Check that device list is empty (all devices closed)
         p_cdc_acm_obj = NULL; // NULL static driver pointer: No open/close calls form this point
     } else {
         ret = ESP_ERR_INVALID_STATE;
         CDC_ACM_EXIT_CRITICAL();
+#if USB_HOST_SHARED_CLIENT_ENABLED
+        usb_host_pm_register(USB_HOST_PM_DRIVER_CDC_ACM, &cdc_acm_pm_ops, NULL);
+#endif
         goto unblock;
     }
     CDC_ACM_EXIT_CRITICAL();
 
-    // Signal to CDC task to stop, unblock it and wait for its deletion
-    xEventGroupSetBits(cdc_acm_obj->event_group, CDC_ACM_TEARDOWN);
-    usb_host_client_unblock(cdc_acm_obj->cdc_acm_client_hdl);
-    ESP_GOTO_ON_FALSE(
-        xEventGroupWaitBits(cdc_acm_obj->event_group, CDC_ACM_TEARDOWN_COMPLETE, pdFALSE, pdFALSE, pdMS_TO_TICKS(100)),
-        ESP_ERR_NOT_FINISHED, unblock, TAG,);
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    if (cdc_acm_obj->shared_client) {
+        // No task of our own, the shared client stops calling us once deregistered
+        ESP_ERROR_CHECK(usb_host_shared_client_deregister(usb_event_cb, NULL));
+    } else
+#endif
+    {
+        // Signal to CDC task to stop, unblock it and wait for its deletion
+        xEventGroupSetBits(cdc_acm_obj->event_group, CDC_ACM_TEARDOWN);
+        usb_host_client_unblock(cdc_acm_obj->cdc_acm_client_hdl);
+        ESP_GOTO_ON_FALSE(
+            xEventGroupWaitBits(cdc_acm_obj->event_group, CDC_ACM_TEARDOWN_COMPLETE, pdFALSE, pdFALSE, pdMS_TO_TICKS(100)),
+            ESP_ERR_NOT_FINISHED, unblock, TAG,);
+    }
 
     // Free remaining resources and return
     vEventGroupDelete(cdc_acm_obj->event_group);
     xSemaphoreGive(cdc_acm_obj->open_close_mutex);
     vSemaphoreDelete(cdc_acm_obj->open_close_mutex);
-    free(cdc_acm_obj);
+    CLIENT_FREE(CONTROL, cdc_acm_obj, sizeof(cdc_acm_obj_t));
     return ESP_OK;
 
 unblock:
@@ -478,21 +895,83 @@ esp_err_t cdc_acm_host_register_new_dev_callback(cdc_acm_new_dev_callback_t new_
     return ESP_OK;
 }
 
+esp_err_t cdc_acm_host_get_new_dev_callback(cdc_acm_new_dev_callback_t *new_dev_cb_ret)
+{
+    CDC_ACM_CHECK(new_dev_cb_ret, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(p_cdc_acm_obj, ESP_ERR_INVALID_STATE);
+    CDC_ACM_ENTER_CRITICAL();
+    *new_dev_cb_ret = p_cdc_acm_obj->new_dev_cb;
+    CDC_ACM_EXIT_CRITICAL();
+    return ESP_OK;
+}
+
 /**
- * @brief Free USB transfers used by this device
+ * @brief Check if CTRL transfer of CDC device is used by another CDC device
+ *
+ * All CDC devices (interfaces) of one USB device share one CTRL transfer and its mutex,
+ * so the requests of all interfaces are serialized in one EP0 queue.
  *
- * @note There can be no transfers in flight, at the moment of calling this function.
  * @param[in] cdc_dev Pointer to CDC device
+ * @return true: Another CDC device in the list uses the CTRL transfer
  */
-static void cdc_acm_transfers_free(cdc_dev_t *cdc_dev)
+static bool cdc_acm_ctrl_is_shared(const cdc_dev_t *cdc_dev)
 {
-    assert(cdc_dev);
-    if (cdc_dev->notif.xfer != NULL) {
-        usb_host_transfer_free(cdc_dev->notif.xfer);
+    bool shared = false;
+    cdc_dev_t *other;
+    CDC_ACM_ENTER_CRITICAL();
+    SLIST_FOREACH(other, &p_cdc_acm_obj->cdc_devices_list, list_entry) {
+        if (other != cdc_dev && other->ctrl_transfer == cdc_dev->ctrl_transfer) {
+            shared = true;
+            break;
+        }
+    }
+    CDC_ACM_EXIT_CRITICAL();
+    return shared;
+}
+
+/**
+ * @brief Find CDC device opened on the same USB device
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ * @return CDC device with the same USB device handle, NULL if there is none
+ */
+static cdc_dev_t *cdc_acm_sibling_find(const cdc_dev_t *cdc_dev)
+{
+    cdc_dev_t *other;
+    CDC_ACM_ENTER_CRITICAL();
+    SLIST_FOREACH(other, &p_cdc_acm_obj->cdc_devices_list, list_entry) {
+        if (other != cdc_dev && other->dev_hdl == cdc_dev->dev_hdl && other->ctrl_transfer) {
+            break;
+        }
+    }
+    CDC_ACM_EXIT_CRITICAL();
+    return other;
+}
+
+/**
+ * @brief Free USB transfers used by this device
+ *
+ * @note There can be no transfers in flight, at the moment of calling this function.
+ * @param[in] cdc_dev Pointer to CDC device
+ */
+static void cdc_acm_transfers_free(cdc_dev_t *cdc_dev)
+{
+    assert(cdc_dev);
+    if (cdc_dev->notif.xfer != NULL) {
+        CLIENT_TRANSFER_FREE(cdc_dev->notif.xfer);
     }
     if (cdc_dev->data.in_xfer != NULL) {
         cdc_acm_reset_in_transfer(cdc_dev);
-        usb_host_transfer_free(cdc_dev->data.in_xfer);
+        CLIENT_TRANSFER_FREE(cdc_dev->data.in_xfer);
+    }
+    if (cdc_dev->data.in_ring != NULL) {
+        for (int i = 0; i < cdc_dev->data.in_ring_num; i++) {
+            CLIENT_TRANSFER_FREE(cdc_dev->data.in_ring[i]);
+        }
+        CLIENT_FREE(CONTROL, cdc_dev->data.in_ring, cdc_dev->data.in_ring_alloc_num * sizeof(usb_transfer_t *));
+        cdc_dev->data.in_ring = NULL;
+        cdc_dev->data.in_ring_num = 0;
+        cdc_dev->data.in_ring_alloc_num = 0;
     }
     if (cdc_dev->data.out_xfer != NULL) {
         if (cdc_dev->data.out_xfer->context != NULL) {
@@ -501,16 +980,30 @@ static void cdc_acm_transfers_free(cdc_dev_t *cdc_dev)
         if (cdc_dev->data.out_mux != NULL) {
             vSemaphoreDelete(cdc_dev->data.out_mux);
         }
-        usb_host_transfer_free(cdc_dev->data.out_xfer);
+        CLIENT_TRANSFER_FREE(cdc_dev->data.out_xfer);
+    }
+    if (cdc_dev->data.out_pool != NULL) {
+        for (int i = 0; i < cdc_dev->data.out_pool_num; i++) {
+            CLIENT_TRANSFER_FREE(cdc_dev->data.out_pool[i]);
+        }
+        CLIENT_FREE(CONTROL, cdc_dev->data.out_pool, cdc_dev->data.out_pool_alloc_num * sizeof(usb_transfer_t *));
+        CLIENT_FREE(CONTROL, cdc_dev->data.out_pool_ctx, cdc_dev->data.out_pool_alloc_num * sizeof(cdc_tx_xfer_ctx_t));
+        cdc_dev->data.out_pool = NULL;
+        cdc_dev->data.out_pool_num = 0;
+        cdc_dev->data.out_pool_alloc_num = 0;
     }
-    if (cdc_dev->ctrl_transfer != NULL) {
+    if (cdc_dev->data.out_pool_free != NULL) {
+        vQueueDelete(cdc_dev->data.out_pool_free);
+        cdc_dev->data.out_pool_free = NULL;
+    }
+    if (cdc_dev->ctrl_transfer != NULL && !cdc_acm_ctrl_is_shared(cdc_dev)) {
         if (cdc_dev->ctrl_transfer->context != NULL) {
             vSemaphoreDelete((SemaphoreHandle_t)cdc_dev->ctrl_transfer->context);
         }
         if (cdc_dev->ctrl_mux != NULL) {
             vSemaphoreDelete(cdc_dev->ctrl_mux);
         }
-        usb_host_transfer_free(cdc_dev->ctrl_transfer);
+        CLIENT_TRANSFER_FREE(cdc_dev->ctrl_transfer);
     }
 }
 
@@ -521,14 +1014,16 @@ static void cdc_acm_transfers_free(cdc_dev_t *cdc_dev)
  * @param[in] notif_ep_desc Pointer to notification EP descriptor
  * @param[in] in_ep_desc-   Pointer to data IN EP descriptor
  * @param[in] in_buf_len    Length of data IN buffer
+ * @param[in] in_xfer_num   Number of IN transfers queued at once
  * @param[in] out_ep_desc   Pointer to data OUT EP descriptor
  * @param[in] out_buf_len   Length of data OUT buffer
+ * @param[in] out_pool_num  Number of OUT transfers for asynchronous TX
  * @return
  *     - ESP_OK:            Success
  *     - ESP_ERR_NO_MEM:    Not enough memory for transfers and semaphores allocation
  *     - ESP_ERR_NOT_FOUND: IN or OUT endpoints were not found in the selected interface
  */
-static esp_err_t cdc_acm_transfers_allocate(cdc_dev_t *cdc_dev, const usb_ep_desc_t *notif_ep_desc, const usb_ep_desc_t *in_ep_desc, size_t in_buf_len, const usb_ep_desc_t *out_ep_desc, size_t out_buf_len)
+static esp_err_t cdc_acm_transfers_allocate(cdc_dev_t *cdc_dev, const usb_ep_desc_t *notif_ep_desc, const usb_ep_desc_t *in_ep_desc, size_t in_buf_len, int in_xfer_num, const usb_ep_desc_t *out_ep_desc, size_t out_buf_len, int out_pool_num)
 {
     assert(in_ep_desc);
     assert(out_ep_desc);
@@ -537,7 +1032,7 @@ static esp_err_t cdc_acm_transfers_allocate(cdc_dev_t *cdc_dev, const usb_ep_des
     // 1. Setup notification transfer if it is supported
     if (notif_ep_desc) {
         ESP_GOTO_ON_ERROR(
-            usb_host_transfer_alloc(USB_EP_DESC_GET_MPS(notif_ep_desc), 0, &cdc_dev->notif.xfer),
+            CLIENT_TRANSFER_ALLOC(USB_EP_DESC_GET_MPS(notif_ep_desc), 0, &cdc_dev->notif.xfer),
             err, TAG,);
         cdc_dev->notif.xfer->device_handle = cdc_dev->dev_hdl;
         cdc_dev->notif.xfer->bEndpointAddress = notif_ep_desc->bEndpointAddress;
@@ -546,23 +1041,29 @@ static esp_err_t cdc_acm_transfers_allocate(cdc_dev_t *cdc_dev, const usb_ep_des
         cdc_dev->notif.xfer->num_bytes = USB_EP_DESC_GET_MPS(notif_ep_desc);
     }
 
-    // 2. Setup control transfer
-    ESP_GOTO_ON_ERROR(
-        usb_host_transfer_alloc(CDC_ACM_CTRL_TRANSFER_SIZE, 0, &cdc_dev->ctrl_transfer),
-        err, TAG,);
-    cdc_dev->ctrl_transfer->timeout_ms = 1000;
-    cdc_dev->ctrl_transfer->bEndpointAddress = 0;
-    cdc_dev->ctrl_transfer->device_handle = cdc_dev->dev_hdl;
-    cdc_dev->ctrl_transfer->callback = out_xfer_cb;
-    cdc_dev->ctrl_transfer->context = xSemaphoreCreateBinary();
-    ESP_GOTO_ON_FALSE(cdc_dev->ctrl_transfer->context, ESP_ERR_NO_MEM, err, TAG,);
-    cdc_dev->ctrl_mux = xSemaphoreCreateMutex();
-    ESP_GOTO_ON_FALSE(cdc_dev->ctrl_mux, ESP_ERR_NO_MEM, err, TAG,);
+    // 2. Setup control transfer, shared by all CDC devices of the USB device
+    const cdc_dev_t *sibling = cdc_acm_sibling_find(cdc_dev);
+    if (sibling) {
+        cdc_dev->ctrl_transfer = sibling->ctrl_transfer;
+        cdc_dev->ctrl_mux = sibling->ctrl_mux;
+    } else {
+        ESP_GOTO_ON_ERROR(
+            CLIENT_TRANSFER_ALLOC(CDC_ACM_CTRL_TRANSFER_SIZE, 0, &cdc_dev->ctrl_transfer),
+            err, TAG,);
+        cdc_dev->ctrl_transfer->timeout_ms = 1000;
+        cdc_dev->ctrl_transfer->bEndpointAddress = 0;
+        cdc_dev->ctrl_transfer->device_handle = cdc_dev->dev_hdl;
+        cdc_dev->ctrl_transfer->callback = out_xfer_cb;
+        cdc_dev->ctrl_transfer->context = xSemaphoreCreateBinary();
+        ESP_GOTO_ON_FALSE(cdc_dev->ctrl_transfer->context, ESP_ERR_NO_MEM, err, TAG,);
+        cdc_dev->ctrl_mux = xSemaphoreCreateMutex();
+        ESP_GOTO_ON_FALSE(cdc_dev->ctrl_mux, ESP_ERR_NO_MEM, err, TAG,);
+    }
 
     // 3. Setup IN data transfer (if it is required (in_buf_len > 0))
     if (in_buf_len != 0) {
         ESP_GOTO_ON_ERROR(
-            usb_host_transfer_alloc(in_buf_len, 0, &cdc_dev->data.in_xfer),
+            CLIENT_TRANSFER_ALLOC(in_buf_len, 0, &cdc_dev->data.in_xfer),
             err, TAG,
         );
         assert(cdc_dev->data.in_xfer);
@@ -573,12 +1074,34 @@ static esp_err_t cdc_acm_transfers_allocate(cdc_dev_t *cdc_dev, const usb_ep_des
         cdc_dev->data.in_xfer->context = cdc_dev;
         cdc_dev->data.in_mps = USB_EP_DESC_GET_MPS(in_ep_desc);
         cdc_dev->data.in_data_buffer_base = cdc_dev->data.in_xfer->data_buffer;
+
+        // Ring of IN transfers: the first one is in_xfer, the others are queued behind it
+        if (in_xfer_num > 1) {
+            cdc_dev->data.in_xfer->callback = in_ring_xfer_cb;
+            cdc_dev->data.in_ring = CLIENT_CALLOC(CONTROL, in_xfer_num - 1, sizeof(usb_transfer_t *));
+            ESP_GOTO_ON_FALSE(cdc_dev->data.in_ring, ESP_ERR_NO_MEM, err, TAG,);
+            cdc_dev->data.in_ring_alloc_num = in_xfer_num - 1;
+            for (int i = 0; i < in_xfer_num - 1; i++) {
+                usb_transfer_t *transfer;
+                ESP_GOTO_ON_ERROR(
+                    CLIENT_TRANSFER_ALLOC(in_buf_len, 0, &transfer),
+                    err, TAG,
+                );
+                cdc_dev->data.in_ring[i] = transfer;
+                cdc_dev->data.in_ring_num++;
+                transfer->callback = in_ring_xfer_cb;
+                transfer->num_bytes = cdc_dev->data.in_xfer->num_bytes;
+                transfer->bEndpointAddress = in_ep_desc->bEndpointAddress;
+                transfer->device_handle = cdc_dev->dev_hdl;
+                transfer->context = cdc_dev;
+            }
+        }
     }
 
     // 4. Setup OUT bulk transfer (if it is required (out_buf_len > 0))
     if (out_buf_len != 0) {
         ESP_GOTO_ON_ERROR(
-            usb_host_transfer_alloc(out_buf_len, 0, &cdc_dev->data.out_xfer),
+            CLIENT_TRANSFER_ALLOC(out_buf_len, 0, &cdc_dev->data.out_xfer),
             err, TAG,
         );
         assert(cdc_dev->data.out_xfer);
@@ -590,6 +1113,30 @@ static esp_err_t cdc_acm_transfers_allocate(cdc_dev_t *cdc_dev, const usb_ep_des
         cdc_dev->data.out_xfer->bEndpointAddress = out_ep_desc->bEndpointAddress;
         cdc_dev->data.out_xfer->callback = out_xfer_cb;
     }
+
+    // 5. Setup pool of OUT bulk transfers for asynchronous TX (if it is required (out_pool_num > 0))
+    if (out_pool_num > 0) {
+        cdc_dev->data.out_pool = CLIENT_CALLOC(CONTROL, out_pool_num, sizeof(usb_transfer_t *));
+        cdc_dev->data.out_pool_ctx = CLIENT_CALLOC(CONTROL, out_pool_num, sizeof(cdc_tx_xfer_ctx_t));
+        cdc_dev->data.out_pool_alloc_num = out_pool_num;
+        cdc_dev->data.out_pool_free = xQueueCreate(out_pool_num, sizeof(usb_transfer_t *));
+        ESP_GOTO_ON_FALSE(cdc_dev->data.out_pool && cdc_dev->data.out_pool_ctx && cdc_dev->data.out_pool_free, ESP_ERR_NO_MEM, err, TAG,);
+        for (int i = 0; i < out_pool_num; i++) {
+            usb_transfer_t *transfer;
+            ESP_GOTO_ON_ERROR(
+                CLIENT_TRANSFER_ALLOC(out_buf_len, 0, &transfer),
+                err, TAG,
+            );
+            cdc_dev->data.out_pool[i] = transfer;
+            cdc_dev->data.out_pool_num++;
+            cdc_dev->data.out_pool_ctx[i].cdc_dev = cdc_dev;
+            transfer->device_handle = cdc_dev->dev_hdl;
+            transfer->bEndpointAddress = out_ep_desc->bEndpointAddress;
+            transfer->callback = out_async_xfer_cb;
+            transfer->context = &cdc_dev->data.out_pool_ctx[i];
+            xQueueSend(cdc_dev->data.out_pool_free, &transfer, 0);
+        }
+    }
     return ESP_OK;
 
 err:
@@ -603,11 +1150,29 @@ esp_err_t cdc_acm_host_open(uint16_t vid, uint16_t pid, uint8_t interface_idx, c
     CDC_ACM_CHECK(p_cdc_acm_obj, ESP_ERR_INVALID_STATE);
     CDC_ACM_CHECK(dev_config, ESP_ERR_INVALID_ARG);
     CDC_ACM_CHECK(cdc_hdl_ret, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(dev_config->out_transfers_num >= 0, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(dev_config->in_transfers_num >= 0, ESP_ERR_INVALID_ARG);
+    if (dev_config->rx_ring_size) {
+        // Received data are passed either to the ring buffer or to data_cb. The ring buffer works with single IN transfer
+        CDC_ACM_CHECK((dev_config->data_cb == NULL) && (dev_config->in_transfers_num <= 1), ESP_ERR_INVALID_ARG);
+        CDC_ACM_CHECK(dev_config->rx_low_watermark <= dev_config->rx_high_watermark, ESP_ERR_INVALID_ARG);
+    }
+    if (dev_config->framing != CDC_ACM_FRAMING_NONE) {
+        // Frames are delivered to frame_cb only. Frames spanning more transfers need receive buffer append, so single IN transfer must be used
+        CDC_ACM_CHECK(dev_config->frame_cb && (dev_config->data_cb == NULL) && (dev_config->rx_ring_size == 0), ESP_ERR_INVALID_ARG);
+        CDC_ACM_CHECK(dev_config->in_transfers_num <= 1, ESP_ERR_INVALID_ARG);
+        CDC_ACM_CHECK(dev_config->framing <= CDC_ACM_FRAMING_LENGTH_PREFIX, ESP_ERR_INVALID_ARG);
+    }
+    CDC_ACM_CHECK((dev_config->out_transfers_num == 0) || (dev_config->out_buffer_size > 0), ESP_ERR_INVALID_ARG);
+    if (dev_config->tx_coalesce_size) {
+        // Coalesced data are sent by transfers of the OUT pool
+        CDC_ACM_CHECK((dev_config->out_transfers_num > 0) && (dev_config->tx_coalesce_size <= dev_config->out_buffer_size), ESP_ERR_INVALID_ARG);
+    }
 
     xSemaphoreTake(p_cdc_acm_obj->open_close_mutex, portMAX_DELAY);
     // Find underlying USB device
     cdc_dev_t *cdc_dev;
-    ret =  cdc_acm_find_and_open_usb_device(vid, pid, dev_config->connection_timeout_ms, &cdc_dev);
+    ret =  cdc_acm_find_and_open_usb_device(vid, pid, dev_config->serial_number, dev_config->connection_timeout_ms, &cdc_dev);
     if (ESP_OK != ret) {
         goto exit;
     }
@@ -631,17 +1196,46 @@ esp_err_t cdc_acm_host_open(uint16_t vid, uint16_t pid, uint8_t interface_idx, c
     if (cdc_info.notif_intf) {
         cdc_dev->comm_protocol = (cdc_comm_protocol_t)cdc_dev->notif.intf_desc->bInterfaceProtocol;
     }
-    cdc_dev->cdc_func_desc = cdc_info.func;
-    cdc_dev->cdc_func_desc_cnt = cdc_info.func_cnt;
+    cdc_dev->cdc_func = cdc_info.func;
+
+    // Remember the USB device, so the same device is found on reconnection
+    if (dev_config->reconnect) {
+        cdc_dev->reconnect.enabled = true;
+        cdc_dev->reconnect.vid = device_desc->idVendor;
+        cdc_dev->reconnect.pid = device_desc->idProduct;
+        cdc_dev->reconnect.interface_idx = interface_idx;
+        ESP_GOTO_ON_ERROR(cdc_acm_usb_device_serial_get(cdc_dev->dev_hdl, &cdc_dev->reconnect.serial), err, TAG, "Not enough memory for serial number");
+    }
 
     // The following line is here for backward compatibility with v1.0.*
     // where fixed size of IN buffer (equal to IN Maximum Packet Size) was used
-    const size_t in_buf_size = (dev_config->data_cb && (dev_config->in_buffer_size == 0)) ? USB_EP_DESC_GET_MPS(cdc_info.in_ep) : dev_config->in_buffer_size;
+    const bool rx_enabled = dev_config->data_cb || dev_config->rx_ring_size || dev_config->frame_cb;
+    const size_t in_buf_size = (rx_enabled && (dev_config->in_buffer_size == 0)) ? USB_EP_DESC_GET_MPS(cdc_info.in_ep) : dev_config->in_buffer_size;
+
+    // Create RX ring buffer, it must be able to accept at least one whole IN transfer
+    if (dev_config->rx_ring_size) {
+        ESP_GOTO_ON_FALSE(dev_config->rx_ring_size >= in_buf_size, ESP_ERR_INVALID_ARG, err, TAG, "RX ring buffer smaller than IN buffer");
+        cdc_dev->data.rx_ring = xRingbufferCreate(dev_config->rx_ring_size, RINGBUF_TYPE_BYTEBUF);
+        ESP_GOTO_ON_FALSE(cdc_dev->data.rx_ring, ESP_ERR_NO_MEM, err, TAG, "Not enough memory for RX ring buffer");
+        cdc_dev->data.rx_ring_size = dev_config->rx_ring_size;
+        CLIENT_MEM_ALLOC(BUFFER, cdc_dev->data.rx_ring_size);
+        cdc_dev->data.rx_high_watermark = dev_config->rx_high_watermark;
+        cdc_dev->data.rx_low_watermark = dev_config->rx_low_watermark;
+    }
+
+    if (dev_config->framing != CDC_ACM_FRAMING_NONE) {
+        cdc_framer_init(&cdc_dev->data.framer, dev_config->framing, dev_config->frame_cb, dev_config->user_arg);
+    }
 
     // Allocate USB transfers, claim CDC interfaces and return CDC-ACM handle
     ESP_GOTO_ON_ERROR(
-        cdc_acm_transfers_allocate(cdc_dev, cdc_info.notif_ep, cdc_info.in_ep, in_buf_size, cdc_info.out_ep, dev_config->out_buffer_size),
+        cdc_acm_transfers_allocate(cdc_dev, cdc_info.notif_ep, cdc_info.in_ep, in_buf_size, dev_config->in_transfers_num, cdc_info.out_ep, dev_config->out_buffer_size, dev_config->out_transfers_num),
         err, TAG,);
+    if (dev_config->tx_coalesce_size) {
+        ESP_GOTO_ON_ERROR(
+            cdc_tx_coalescer_init(&cdc_dev->data.tx_coalescer, (cdc_acm_dev_hdl_t)cdc_dev, dev_config->tx_coalesce_size, dev_config->tx_coalesce_us),
+            err, TAG, "Not enough memory for TX coalescer");
+    }
     ESP_GOTO_ON_ERROR(cdc_acm_start(cdc_dev, dev_config->event_cb, dev_config->data_cb, dev_config->user_arg), err, TAG,);
     *cdc_hdl_ret = (cdc_acm_dev_hdl_t)cdc_dev;
     xSemaphoreGive(p_cdc_acm_obj->open_close_mutex);
@@ -683,20 +1277,12 @@ esp_err_t cdc_acm_host_close(cdc_acm_dev_hdl_t cdc_hdl)
     // No user callbacks from this point
     cdc_dev->notif.cb = NULL;
     cdc_dev->data.in_cb = NULL;
+    cdc_dev->data.framer.cb = NULL;
     CDC_ACM_EXIT_CRITICAL();
 
-    // Cancel polling of BULK IN and INTERRUPT IN
-    if (cdc_dev->data.in_xfer) {
-        ESP_ERROR_CHECK(cdc_acm_reset_transfer_endpoint(cdc_dev->dev_hdl, cdc_dev->data.in_xfer));
-    }
-    if (cdc_dev->notif.xfer != NULL) {
-        ESP_ERROR_CHECK(cdc_acm_reset_transfer_endpoint(cdc_dev->dev_hdl, cdc_dev->notif.xfer));
-    }
-
-    // Release all interfaces
-    ESP_ERROR_CHECK(usb_host_interface_release(p_cdc_acm_obj->cdc_acm_client_hdl, cdc_dev->dev_hdl, cdc_dev->data.intf_desc->bInterfaceNumber));
-    if ((cdc_dev->notif.intf_desc != NULL) && (cdc_dev->notif.intf_desc != cdc_dev->data.intf_desc)) {
-        ESP_ERROR_CHECK(usb_host_interface_release(p_cdc_acm_obj->cdc_acm_client_hdl, cdc_dev->dev_hdl, cdc_dev->notif.intf_desc->bInterfaceNumber));
+    // Device in standby has no claimed interfaces and no transfers in flight
+    if (cdc_dev->dev_hdl) {
+        cdc_acm_interfaces_release(cdc_dev);
     }
 
     CDC_ACM_ENTER_CRITICAL();
@@ -712,6 +1298,10 @@ void cdc_acm_host_desc_print(cdc_acm_dev_hdl_t cdc_hdl)
 {
     assert(cdc_hdl);
     cdc_dev_t *cdc_dev = (cdc_dev_t *)cdc_hdl;
+    if (cdc_dev->dev_hdl == NULL) {
+        ESP_LOGW(TAG, "Device is in standby, descriptors are not available");
+        return;
+    }
 
     const usb_device_desc_t *device_desc;
     const usb_config_desc_t *config_desc;
@@ -731,7 +1321,7 @@ void cdc_acm_host_desc_print(cdc_acm_dev_hdl_t cdc_hdl)
  * @return true Transfer completed
  * @return false Transfer NOT completed
  */
-static bool cdc_acm_is_transfer_completed(usb_transfer_t *transfer)
+static bool CDC_ACM_DATA_PATH_ATTR cdc_acm_is_transfer_completed(usb_transfer_t *transfer)
 {
     cdc_dev_t *cdc_dev = (cdc_dev_t *)transfer->context;
     bool completed = false;
@@ -761,36 +1351,56 @@ static bool cdc_acm_is_transfer_completed(usb_transfer_t *transfer)
     return completed;
 }
 
-static void in_xfer_cb(usb_transfer_t *transfer)
+static void CDC_ACM_DATA_PATH_ATTR in_xfer_cb(usb_transfer_t *transfer)
 {
+    CLIENT_TRACE_COMPLETE(transfer);
     ESP_LOGD(TAG, "in xfer cb");
     cdc_dev_t *cdc_dev = (cdc_dev_t *)transfer->context;
+    cdc_acm_stats_transfer_done(cdc_dev, transfer);
 
     if (!cdc_acm_is_transfer_completed(transfer)) {
         return;
     }
 
-    if (cdc_dev->data.in_cb) {
-        const bool data_processed = cdc_dev->data.in_cb(transfer->data_buffer, transfer->actual_num_bytes, cdc_dev->cb_arg);
+    if (cdc_dev->data.rx_ring) {
+        if (!cdc_acm_rx_ring_push(cdc_dev, transfer)) {
+            return; // Reception paused, cdc_acm_host_data_rx_read() will submit the transfer again
+        }
+    } else if (cdc_dev->data.in_cb || cdc_dev->data.framer.cb) {
+        // Appended data must directly follow the data that were not processed yet
+        uint8_t *data = cdc_dev->data.in_data_buffer_base + cdc_dev->data.in_data_len;
+        if (data != transfer->data_buffer) {
+            memmove(data, transfer->data_buffer, transfer->actual_num_bytes);
+        }
+        const bool data_processed = cdc_acm_data_cb_call(cdc_dev, data, transfer->actual_num_bytes);
 
         // Information for developers:
         // In order to save RAM and CPU time, the application can indicate that the received data was not processed and that the application expects more data.
         // In this case, the next received data must be appended to the existing buffer.
         // Since the data_buffer in usb_transfer_t is a constant pointer, we must cast away to const qualifier.
         if (!data_processed) {
-#if !SOC_CACHE_INTERNAL_MEM_VIA_L1CACHE
-            // In case the received data was not processed, the next RX data must be appended to current buffer
+            // In case the received data was not processed, the next RX data must be appended to current buffer.
+            // Framer keeps only the incomplete frame, frames delivered before it are dropped from the buffer
+            if (cdc_dev->data.framer.cb) {
+                cdc_dev->data.in_data_len = cdc_framer_move_incomplete(&cdc_dev->data.framer, cdc_dev->data.in_data_buffer_base, data + transfer->actual_num_bytes);
+            } else {
+                cdc_dev->data.in_data_len += transfer->actual_num_bytes;
+            }
+            const size_t offset = ((cdc_dev->data.in_data_len + CDC_ACM_IN_APPEND_ALIGN - 1) / CDC_ACM_IN_APPEND_ALIGN) * CDC_ACM_IN_APPEND_ALIGN;
             uint8_t **ptr = (uint8_t **)(&(transfer->data_buffer));
-            *ptr += transfer->actual_num_bytes;
+            *ptr = cdc_dev->data.in_data_buffer_base + offset;
 
-            // Calculate remaining space in the buffer. Attention: pointer arithmetic!
-            size_t space_left = transfer->data_buffer_size - (transfer->data_buffer - cdc_dev->data.in_data_buffer_base);
+            // Calculate remaining space in the buffer
+            const size_t space_left = (offset < transfer->data_buffer_size) ? (transfer->data_buffer_size - offset) : 0;
             uint16_t mps = cdc_dev->data.in_mps;
             transfer->num_bytes = (space_left / mps) * mps; // Round down to MPS for next transfer
 
             if (transfer->num_bytes == 0) {
                 // The IN buffer cannot accept more data, inform the user and reset the buffer
                 ESP_LOGW(TAG, "IN buffer overflow");
+                CDC_ACM_ENTER_CRITICAL();
+                cdc_dev->stats.rx_overflows++;
+                CDC_ACM_EXIT_CRITICAL();
                 cdc_dev->serial_state.bOverRun = true;
                 if (cdc_dev->notif.cb) {
                     const cdc_acm_host_dev_event_data_t serial_state_event = {
@@ -801,24 +1411,42 @@ static void in_xfer_cb(usb_transfer_t *transfer)
                 }
 
                 cdc_acm_reset_in_transfer(cdc_dev);
+                cdc_framer_reset(&cdc_dev->data.framer); // The incomplete frame was dropped
                 cdc_dev->serial_state.bOverRun = false;
             }
-#else
-            // For targets that must sync internal memory through L1CACHE, we cannot change the data_buffer
-            // because it would lead to unaligned cache sync, which is not allowed
-            ESP_LOGW(TAG, "RX buffer append is not yet supported on ESP32-P4!");
-#endif
         } else {
             cdc_acm_reset_in_transfer(cdc_dev);
         }
     }
 
     ESP_LOGD(TAG, "Submitting poll for BULK IN transfer");
-    usb_host_transfer_submit(cdc_dev->data.in_xfer);
+    CLIENT_TRANSFER_SUBMIT(cdc_dev->data.in_xfer);
+}
+
+static void CDC_ACM_DATA_PATH_ATTR in_ring_xfer_cb(usb_transfer_t *transfer)
+{
+    CLIENT_TRACE_COMPLETE(transfer);
+    ESP_LOGD(TAG, "in ring xfer cb");
+    cdc_dev_t *cdc_dev = (cdc_dev_t *)transfer->context;
+    cdc_acm_stats_transfer_done(cdc_dev, transfer);
+
+    if (!cdc_acm_is_transfer_completed(transfer)) {
+        return;
+    }
+
+    // The other transfers of the ring are already receiving next data, so they cannot be appended to this transfer.
+    // The return value of the callback is ignored and the transfer is queued again at the end of the ring
+    if (cdc_dev->data.in_cb) {
+        cdc_acm_data_cb_call(cdc_dev, transfer->data_buffer, transfer->actual_num_bytes);
+    }
+
+    ESP_LOGD(TAG, "Submitting poll for BULK IN transfer");
+    CLIENT_TRANSFER_SUBMIT(transfer);
 }
 
 static void notif_xfer_cb(usb_transfer_t *transfer)
 {
+    CLIENT_TRACE_COMPLETE(transfer);
     ESP_LOGD(TAG, "notif xfer cb");
     cdc_dev_t *cdc_dev = (cdc_dev_t *)transfer->context;
 
@@ -846,6 +1474,9 @@ static void notif_xfer_cb(usb_transfer_t *transfer)
             }
             break;
         }
+        case USB_CDC_NOTIF_CONNECTION_SPEED_CHANGE:
+            ESP_LOGD(TAG, "Connection speed changed"); // Sent by CDC-NCM/ECM devices together with network connection
+            break;
         case USB_CDC_NOTIF_RESPONSE_AVAILABLE: // Encapsulated commands not implemented - fallthrough
         default:
             ESP_LOGW(TAG, "Unsupported notification type 0x%02X", notif->bNotificationCode);
@@ -855,35 +1486,239 @@ static void notif_xfer_cb(usb_transfer_t *transfer)
 
         // Start polling for new data again
         ESP_LOGD(TAG, "Submitting poll for INTR IN transfer");
-        usb_host_transfer_submit(cdc_dev->notif.xfer);
+        CLIENT_TRANSFER_SUBMIT(cdc_dev->notif.xfer);
     }
 }
 
-static void out_xfer_cb(usb_transfer_t *transfer)
+static void CDC_ACM_DATA_PATH_ATTR out_xfer_cb(usb_transfer_t *transfer)
 {
+    CLIENT_TRACE_COMPLETE(transfer);
     ESP_LOGD(TAG, "out/ctrl xfer cb");
     assert(transfer->context);
     xSemaphoreGive((SemaphoreHandle_t)transfer->context);
 }
 
+static void CDC_ACM_DATA_PATH_ATTR out_async_xfer_cb(usb_transfer_t *transfer)
+{
+    CLIENT_TRACE_COMPLETE(transfer);
+    ESP_LOGD(TAG, "out async xfer cb");
+    cdc_tx_xfer_ctx_t *ctx = (cdc_tx_xfer_ctx_t *)transfer->context;
+    assert(ctx);
+    cdc_acm_stats_transfer_done(ctx->cdc_dev, transfer);
+
+    esp_err_t status = ESP_OK;
+    if (transfer->status == USB_TRANSFER_STATUS_NO_DEVICE) {
+        status = ESP_ERR_NOT_FOUND;
+    } else if (transfer->status == USB_TRANSFER_STATUS_CANCELED) {
+        status = ESP_ERR_INVALID_STATE;
+    } else if (transfer->status != USB_TRANSFER_STATUS_COMPLETED || transfer->actual_num_bytes != transfer->num_bytes) {
+        ESP_LOGW(TAG, "Bulk OUT transfer error");
+        status = ESP_ERR_INVALID_RESPONSE;
+    }
+
+    // Return the transfer to the pool before calling the user, so the callback can submit new data
+    const cdc_acm_tx_callback_t tx_cb = ctx->cb;
+    void *const cb_arg = ctx->cb_arg;
+    const size_t data_len = transfer->actual_num_bytes;
+    xQueueSend(ctx->cdc_dev->data.out_pool_free, &transfer, 0);
+    if (tx_cb) {
+        tx_cb(status, data_len, cb_arg);
+    }
+}
+
+/**
+ * @brief Put CDC device to standby after its USB device was disconnected
+ *
+ * Transfers, RX ring buffer and statistics of the device are kept.
+ * Descriptors of the disconnected USB device are freed by USB Host Library, so they are parsed again on reconnection.
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ */
+static void cdc_acm_standby(cdc_dev_t *cdc_dev)
+{
+    ESP_LOGD(TAG, "Device in standby, waiting for reconnection");
+    cdc_acm_interfaces_release(cdc_dev);
+    CLIENT_DEVICE_CLOSE(p_cdc_acm_obj->cdc_acm_client_hdl, cdc_dev->dev_hdl); // Gracefully continue on error, the USB device can be shared by more CDC devices
+
+    CDC_ACM_ENTER_CRITICAL();
+    cdc_dev->dev_hdl = NULL;
+    cdc_dev->data.intf_desc = NULL;
+    cdc_dev->notif.intf_desc = NULL;
+    CDC_ACM_EXIT_CRITICAL();
+    memset(&cdc_dev->cdc_func, 0, sizeof(cdc_dev->cdc_func));
+}
+
+/**
+ * @brief Set USB device handle in all transfers of CDC device
+ *
+ * @param[in] cdc_dev Pointer to CDC device
+ * @param[in] dev_hdl USB device handle
+ */
+static void cdc_acm_transfers_device_set(cdc_dev_t *cdc_dev, usb_device_handle_t dev_hdl)
+{
+    cdc_dev->ctrl_transfer->device_handle = dev_hdl;
+    if (cdc_dev->notif.xfer) {
+        cdc_dev->notif.xfer->device_handle = dev_hdl;
+    }
+    if (cdc_dev->data.in_xfer) {
+        cdc_dev->data.in_xfer->device_handle = dev_hdl;
+    }
+    for (int i = 0; i < cdc_dev->data.in_ring_num; i++) {
+        cdc_dev->data.in_ring[i]->device_handle = dev_hdl;
+    }
+    if (cdc_dev->data.out_xfer) {
+        cdc_dev->data.out_xfer->device_handle = dev_hdl;
+    }
+    for (int i = 0; i < cdc_dev->data.out_pool_num; i++) {
+        cdc_dev->data.out_pool[i]->device_handle = dev_hdl;
+    }
+}
+
+/**
+ * @brief Check that transfer can be used with endpoint of reconnected device
+ *
+ * @param[in] transfer Transfer of CDC device, can be NULL
+ * @param[in] ep_desc  Endpoint descriptor of reconnected device, can be NULL
+ * @return true: The transfer is not used or its endpoint is the same
+ */
+static bool cdc_acm_transfer_ep_matches(const usb_transfer_t *transfer, const usb_ep_desc_t *ep_desc)
+{
+    return (transfer == NULL) || (ep_desc && (ep_desc->bEndpointAddress == transfer->bEndpointAddress));
+}
+
+/**
+ * @brief Rebind CDC device in standby to reconnected USB device
+ *
+ * The transfers are reused, so the reconnected device must have the same endpoints.
+ *
+ * @param[in] cdc_dev Pointer to CDC device in standby
+ * @param[in] dev_hdl Handle of reconnected USB device
+ * @return esp_err_t
+ */
+static esp_err_t cdc_acm_rebind(cdc_dev_t *cdc_dev, usb_device_handle_t dev_hdl)
+{
+    esp_err_t ret;
+    const usb_config_desc_t *config_desc;
+    const usb_device_desc_t *device_desc;
+    ESP_RETURN_ON_ERROR(usb_host_get_device_descriptor(dev_hdl, &device_desc), TAG,);
+    ESP_RETURN_ON_ERROR(usb_host_get_active_config_descriptor(dev_hdl, &config_desc), TAG,);
+
+    cdc_parsed_info_t cdc_info;
+    ESP_RETURN_ON_ERROR(
+        cdc_parse_interface_descriptor(device_desc, config_desc, cdc_dev->reconnect.interface_idx, &cdc_info),
+        TAG, "Could not parse reconnected device");
+
+    usb_transfer_t *out_xfer = cdc_dev->data.out_xfer ? cdc_dev->data.out_xfer : (cdc_dev->data.out_pool ? cdc_dev->data.out_pool[0] : NULL);
+    const bool in_mps_matches = (cdc_dev->data.in_xfer == NULL) || (USB_EP_DESC_GET_MPS(cdc_info.in_ep) == cdc_dev->data.in_mps);
+    ESP_GOTO_ON_FALSE(
+        cdc_acm_transfer_ep_matches(cdc_dev->data.in_xfer, cdc_info.in_ep) && in_mps_matches &&
+        cdc_acm_transfer_ep_matches(out_xfer, cdc_info.out_ep) &&
+        cdc_acm_transfer_ep_matches(cdc_dev->notif.xfer, cdc_info.notif_ep),
+        ESP_ERR_NOT_SUPPORTED, err, TAG, "Endpoints of reconnected device changed");
+
+    // Data that were not processed before the disconnection are dropped
+    if (cdc_dev->data.in_xfer) {
+        cdc_acm_reset_in_transfer(cdc_dev);
+        cdc_framer_reset(&cdc_dev->data.framer);
+    }
+    cdc_acm_transfers_device_set(cdc_dev, dev_hdl);
+    cdc_dev->cdc_func = cdc_info.func;
+    CDC_ACM_ENTER_CRITICAL();
+    // The RX ring buffer could be read in standby, resume the reception here as cdc_acm_host_data_rx_read() did not
+    if (cdc_dev->data.rx_paused && (xRingbufferGetCurFreeSize(cdc_dev->data.rx_ring) >= (size_t)cdc_dev->data.in_xfer->num_bytes)) {
+        cdc_dev->data.rx_paused = false;
+    }
+    cdc_dev->data.intf_desc = cdc_info.data_intf;
+    cdc_dev->notif.intf_desc = cdc_info.notif_intf;
+    cdc_dev->dev_hdl = dev_hdl;
+    CDC_ACM_EXIT_CRITICAL();
+
+    ret = cdc_acm_interfaces_claim(cdc_dev);
+    if (ret != ESP_OK) {
+        CDC_ACM_ENTER_CRITICAL();
+        cdc_dev->dev_hdl = NULL;
+        cdc_dev->data.intf_desc = NULL;
+        cdc_dev->notif.intf_desc = NULL;
+        CDC_ACM_EXIT_CRITICAL();
+        memset(&cdc_dev->cdc_func, 0, sizeof(cdc_dev->cdc_func));
+        goto err;
+    }
+    return ESP_OK;
+
+err:
+    return ret;
+}
+
+/**
+ * @brief Rebind CDC devices in standby to newly connected USB device
+ *
+ * @param[in] dev_addr Address of the new USB device
+ */
+static void cdc_acm_reconnect(uint8_t dev_addr)
+{
+    // Open the new device only if some CDC device waits for reconnection
+    cdc_dev_t *cdc_dev;
+    bool standby = false;
+    CDC_ACM_ENTER_CRITICAL();
+    SLIST_FOREACH(cdc_dev, &p_cdc_acm_obj->cdc_devices_list, list_entry) {
+        standby |= (cdc_dev->dev_hdl == NULL);
+    }
+    CDC_ACM_EXIT_CRITICAL();
+    if (!standby) {
+        return;
+    }
+
+    usb_device_handle_t dev_hdl;
+    if (CLIENT_DEVICE_OPEN(p_cdc_acm_obj->cdc_acm_client_hdl, dev_addr, &dev_hdl) != ESP_OK) {
+        return;
+    }
+
+    // All CDC devices in standby on this USB device share the device handle, same as in cdc_acm_find_and_open_usb_device()
+    bool rebound = false;
+    cdc_dev_t *tcdc_dev;
+    SLIST_FOREACH_SAFE(cdc_dev, &p_cdc_acm_obj->cdc_devices_list, list_entry, tcdc_dev) {
+        if (cdc_dev->dev_hdl || !cdc_acm_usb_device_matches(dev_hdl, cdc_dev->reconnect.vid, cdc_dev->reconnect.pid, cdc_dev->reconnect.serial)) {
+            continue;
+        }
+        if (cdc_acm_rebind(cdc_dev, dev_hdl) != ESP_OK) {
+            ESP_LOGW(TAG, "Could not rebind reconnected device");
+            continue;
+        }
+        rebound = true;
+        ESP_LOGD(TAG, "Device reconnected");
+        if (cdc_dev->notif.cb) {
+            const cdc_acm_host_dev_event_data_t reconn_event = {
+                .type = CDC_ACM_HOST_DEVICE_RECONNECTED,
+                .data.cdc_hdl = (cdc_acm_dev_hdl_t) cdc_dev,
+            };
+            cdc_dev->notif.cb(&reconn_event, cdc_dev->cb_arg);
+        }
+    }
+    if (!rebound) {
+        CLIENT_DEVICE_CLOSE(p_cdc_acm_obj->cdc_acm_client_hdl, dev_hdl);
+    }
+}
+
 static void usb_event_cb(const usb_host_client_event_msg_t *event_msg, void *arg)
 {
     switch (event_msg->event) {
     case USB_HOST_CLIENT_EVENT_NEW_DEV:
         // Guard p_cdc_acm_obj->new_dev_cb from concurrent access
         ESP_LOGD(TAG, "New device connected");
+        xEventGroupSetBits(p_cdc_acm_obj->event_group, CDC_ACM_NEW_DEV); // Wake up cdc_acm_host_open() waiting for the device
+        cdc_acm_reconnect(event_msg->new_dev.address);
         CDC_ACM_ENTER_CRITICAL();
         cdc_acm_new_dev_callback_t _new_dev_cb = p_cdc_acm_obj->new_dev_cb;
         CDC_ACM_EXIT_CRITICAL();
 
         if (_new_dev_cb) {
             usb_device_handle_t new_dev;
-            if (usb_host_device_open(p_cdc_acm_obj->cdc_acm_client_hdl, event_msg->new_dev.address, &new_dev) != ESP_OK) {
+            if (CLIENT_DEVICE_OPEN(p_cdc_acm_obj->cdc_acm_client_hdl, event_msg->new_dev.address, &new_dev) != ESP_OK) {
                 break;
             }
             assert(new_dev);
             _new_dev_cb(new_dev);
-            usb_host_device_close(p_cdc_acm_obj->cdc_acm_client_hdl, new_dev);
+            CLIENT_DEVICE_CLOSE(p_cdc_acm_obj->cdc_acm_client_hdl, new_dev);
         }
 
         break;
@@ -894,7 +1729,13 @@ static void usb_event_cb(const usb_host_client_event_msg_t *event_msg, void *arg
         cdc_dev_t *tcdc_dev;
         // We are using 'SAFE' version of 'SLIST_FOREACH' which enables user to close the disconnected device in the callback
         SLIST_FOREACH_SAFE(cdc_dev, &p_cdc_acm_obj->cdc_devices_list, list_entry, tcdc_dev) {
-            if (cdc_dev->dev_hdl == event_msg->dev_gone.dev_hdl && cdc_dev->notif.cb) {
+            if (cdc_dev->dev_hdl != event_msg->dev_gone.dev_hdl) {
+                continue;
+            }
+            if (cdc_dev->reconnect.enabled) {
+                cdc_acm_standby(cdc_dev);
+            }
+            if (cdc_dev->notif.cb) {
                 // The suddenly disconnected device was opened by this driver: inform user about this
                 const cdc_acm_host_dev_event_data_t disconn_event = {
                     .type = CDC_ACM_HOST_DEVICE_DISCONNECTED,
@@ -905,12 +1746,75 @@ static void usb_event_cb(const usb_host_client_event_msg_t *event_msg, void *arg
         }
         break;
     }
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(6, 0, 0)
+    case USB_HOST_CLIENT_EVENT_DEV_SUSPENDED:
+    case USB_HOST_CLIENT_EVENT_DEV_RESUMED:
+        // Transfers are stopped and submitted again by the suspend and resume hooks
+        break;
+#endif
     default:
         assert(false);
         break;
     }
 }
 
+#if USB_HOST_SHARED_CLIENT_ENABLED
+/**
+ * @brief Stop all transfers of open CDC devices before bus suspend
+ *
+ * Interfaces stay claimed. New transmissions are refused until resume, a blocking transmission in progress finishes first.
+ */
+static esp_err_t cdc_acm_pm_suspend(void *arg)
+{
+    xSemaphoreTake(p_cdc_acm_obj->open_close_mutex, portMAX_DELAY);
+    cdc_dev_t *cdc_dev;
+    SLIST_FOREACH(cdc_dev, &p_cdc_acm_obj->cdc_devices_list, list_entry) {
+        if (cdc_dev->dev_hdl == NULL) {
+            continue; // Device in standby has no transfers in flight
+        }
+        CDC_ACM_ENTER_CRITICAL();
+        cdc_dev->suspended = true;
+        CDC_ACM_EXIT_CRITICAL();
+        xSemaphoreTake(cdc_dev->data.out_mux, portMAX_DELAY);
+        xSemaphoreGive(cdc_dev->data.out_mux);
+        cdc_acm_transfers_cancel(cdc_dev);
+    }
+    xSemaphoreGive(p_cdc_acm_obj->open_close_mutex);
+    return ESP_OK;
+}
+
+/**
+ * @brief Start polling of IN endpoints stopped by cdc_acm_pm_suspend()
+ */
+static esp_err_t cdc_acm_pm_resume(void *arg)
+{
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(p_cdc_acm_obj->open_close_mutex, portMAX_DELAY);
+    cdc_dev_t *cdc_dev;
+    SLIST_FOREACH(cdc_dev, &p_cdc_acm_obj->cdc_devices_list, list_entry) {
+        if (!cdc_dev->suspended) {
+            continue;
+        }
+        CDC_ACM_ENTER_CRITICAL();
+        cdc_dev->suspended = false;
+        // The RX ring buffer could be read while suspended, cdc_acm_host_data_rx_read() did not resume the reception
+        if (cdc_dev->data.rx_paused && (xRingbufferGetCurFreeSize(cdc_dev->data.rx_ring) >= (size_t)cdc_dev->data.in_xfer->num_bytes)) {
+            cdc_dev->data.rx_paused = false;
+        }
+        CDC_ACM_EXIT_CRITICAL();
+        esp_err_t err = cdc_acm_data_in_submit(cdc_dev);
+        if (err == ESP_OK && cdc_dev->notif.xfer) {
+            err = CLIENT_TRANSFER_SUBMIT(cdc_dev->notif.xfer);
+        }
+        if (err != ESP_OK && ret == ESP_OK) {
+            ret = err;
+        }
+    }
+    xSemaphoreGive(p_cdc_acm_obj->open_close_mutex);
+    return ret;
+}
+#endif // USB_HOST_SHARED_CLIENT_ENABLED
+
 esp_err_t cdc_acm_host_data_tx_blocking(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data, size_t data_len, uint32_t timeout_ms)
 {
     esp_err_t ret;
@@ -919,12 +1823,22 @@ esp_err_t cdc_acm_host_data_tx_blocking(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t
     CDC_ACM_CHECK(data && (data_len > 0), ESP_ERR_INVALID_ARG);
     CDC_ACM_CHECK(cdc_dev->data.out_xfer, ESP_ERR_NOT_SUPPORTED); // Device was opened as read-only.
     CDC_ACM_CHECK(data_len <= cdc_dev->data.out_xfer->data_buffer_size, ESP_ERR_INVALID_SIZE);
+    CDC_ACM_CHECK(cdc_dev->dev_hdl, ESP_ERR_INVALID_STATE); // Device is in standby, waiting for reconnection
+    const int64_t start = cdc_acm_stats_time_us();
 
     // Take OUT mutex and fill the OUT transfer
     BaseType_t taken = xSemaphoreTake(cdc_dev->data.out_mux, pdMS_TO_TICKS(timeout_ms));
     if (taken != pdTRUE) {
         return ESP_ERR_TIMEOUT;
     }
+    // Checked with the OUT mutex taken, bus suspend waits for transmission in progress by taking it
+    ESP_GOTO_ON_FALSE(!cdc_dev->suspended, ESP_ERR_INVALID_STATE, unblock, TAG, "Bus is suspended");
+
+    if (cdc_dev->data.tx_coalescer.size) {
+        // Small writes are gathered in a transfer of the OUT pool, the data are sent later
+        ret = cdc_tx_coalescer_write(&cdc_dev->data.tx_coalescer, data, data_len, timeout_ms);
+        goto unblock;
+    }
 
     ESP_LOGD(TAG, "Submitting BULK OUT transfer");
     SemaphoreHandle_t transfer_finished_semaphore = (SemaphoreHandle_t)cdc_dev->data.out_xfer->context;
@@ -933,26 +1847,203 @@ esp_err_t cdc_acm_host_data_tx_blocking(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t
     memcpy(cdc_dev->data.out_xfer->data_buffer, data, data_len);
     cdc_dev->data.out_xfer->num_bytes = data_len;
     cdc_dev->data.out_xfer->timeout_ms = timeout_ms;
-    ESP_GOTO_ON_ERROR(usb_host_transfer_submit(cdc_dev->data.out_xfer), unblock, TAG,);
+    ESP_GOTO_ON_ERROR(CLIENT_TRANSFER_SUBMIT(cdc_dev->data.out_xfer), unblock, TAG,);
 
     // Wait for OUT transfer completion
     taken = xSemaphoreTake(transfer_finished_semaphore, pdMS_TO_TICKS(timeout_ms));
     if (!taken) {
-        cdc_acm_reset_transfer_endpoint(cdc_dev->dev_hdl, cdc_dev->data.out_xfer); // Resetting the endpoint will cause all in-progress transfers to complete
+        cdc_acm_reset_transfer_endpoint(cdc_dev, cdc_dev->data.out_xfer); // Resetting the endpoint will cause all in-progress transfers to complete
         ESP_LOGW(TAG, "TX transfer timeout");
         ret = ESP_ERR_TIMEOUT;
         goto unblock;
     }
 
+    cdc_acm_stats_transfer_done(cdc_dev, cdc_dev->data.out_xfer);
     ESP_GOTO_ON_FALSE(cdc_dev->data.out_xfer->status == USB_TRANSFER_STATUS_COMPLETED, ESP_ERR_INVALID_RESPONSE, unblock, TAG, "Bulk OUT transfer error");
     ESP_GOTO_ON_FALSE(cdc_dev->data.out_xfer->actual_num_bytes == data_len, ESP_ERR_INVALID_RESPONSE, unblock, TAG, "Incorrect number of bytes transferred");
     ret = ESP_OK;
 
 unblock:
     xSemaphoreGive(cdc_dev->data.out_mux);
+    const unsigned bucket = cdc_acm_stats_bucket(cdc_acm_stats_time_us() - start, 1000);
+    CDC_ACM_ENTER_CRITICAL();
+    cdc_dev->stats.tx_wait_histogram[bucket]++;
+    CDC_ACM_EXIT_CRITICAL();
     return ret;
 }
 
+esp_err_t cdc_acm_host_tx_buffer_get(cdc_acm_dev_hdl_t cdc_hdl, uint32_t timeout_ms, uint8_t **buf_ret, size_t *buf_size_ret)
+{
+    CDC_ACM_CHECK(cdc_hdl && buf_ret, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = (cdc_dev_t *)cdc_hdl;
+    CDC_ACM_CHECK(cdc_dev->data.out_pool, ESP_ERR_NOT_SUPPORTED); // Device was opened without OUT transfer pool
+
+    // Take a free transfer from the pool
+    usb_transfer_t *transfer;
+    if (xQueueReceive(cdc_dev->data.out_pool_free, &transfer, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    cdc_tx_xfer_ctx_t *ctx = (cdc_tx_xfer_ctx_t *)transfer->context;
+    ctx->claimed = true;
+    *buf_ret = transfer->data_buffer;
+    if (buf_size_ret) {
+        *buf_size_ret = transfer->data_buffer_size;
+    }
+    return ESP_OK;
+}
+
+esp_err_t cdc_acm_host_tx_buffer_submit(cdc_acm_dev_hdl_t cdc_hdl, uint8_t *buf, size_t data_len, cdc_acm_tx_callback_t tx_cb, void *user_arg)
+{
+    esp_err_t ret;
+    CDC_ACM_CHECK(cdc_hdl && buf, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = (cdc_dev_t *)cdc_hdl;
+    CDC_ACM_CHECK(cdc_dev->data.out_pool, ESP_ERR_NOT_SUPPORTED); // Device was opened without OUT transfer pool
+
+    // Find the claimed transfer that owns this buffer
+    usb_transfer_t *transfer = NULL;
+    for (int i = 0; i < cdc_dev->data.out_pool_num; i++) {
+        if (cdc_dev->data.out_pool[i]->data_buffer == buf) {
+            transfer = cdc_dev->data.out_pool[i];
+            break;
+        }
+    }
+    CDC_ACM_CHECK(transfer, ESP_ERR_INVALID_ARG);
+    cdc_tx_xfer_ctx_t *ctx = (cdc_tx_xfer_ctx_t *)transfer->context;
+    CDC_ACM_CHECK(ctx->claimed, ESP_ERR_INVALID_STATE);
+    CDC_ACM_CHECK(data_len <= transfer->data_buffer_size, ESP_ERR_INVALID_SIZE);
+    ctx->claimed = false;
+
+    if (data_len == 0) {
+        // Nothing to send, just give the buffer back to the pool
+        xQueueSend(cdc_dev->data.out_pool_free, &transfer, 0);
+        return ESP_OK;
+    }
+
+    ESP_LOGD(TAG, "Submitting async BULK OUT transfer");
+    ctx->cb = tx_cb;
+    ctx->cb_arg = user_arg;
+    transfer->num_bytes = data_len;
+    ret = (cdc_dev->dev_hdl && !cdc_dev->suspended) ? CLIENT_TRANSFER_SUBMIT(transfer) : ESP_ERR_INVALID_STATE; // Device in standby or suspended bus cannot transmit
+    if (ret != ESP_OK) {
+        xQueueSend(cdc_dev->data.out_pool_free, &transfer, 0); // Give the transfer back to the pool
+    }
+    return ret;
+}
+
+esp_err_t cdc_acm_host_data_tx_async(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data, size_t data_len, uint32_t timeout_ms, cdc_acm_tx_callback_t tx_cb, void *user_arg)
+{
+    CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = (cdc_dev_t *)cdc_hdl;
+    CDC_ACM_CHECK(data && (data_len > 0), ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(cdc_dev->data.out_pool, ESP_ERR_NOT_SUPPORTED); // Device was opened without OUT transfer pool
+    CDC_ACM_CHECK(data_len <= cdc_dev->data.out_pool[0]->data_buffer_size, ESP_ERR_INVALID_SIZE);
+
+    uint8_t *buf;
+    const esp_err_t ret = cdc_acm_host_tx_buffer_get(cdc_hdl, timeout_ms, &buf, NULL);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    memcpy(buf, data, data_len);
+    return cdc_acm_host_tx_buffer_submit(cdc_hdl, buf, data_len, tx_cb, user_arg);
+}
+
+esp_err_t cdc_acm_host_tx_flush(cdc_acm_dev_hdl_t cdc_hdl, uint32_t timeout_ms)
+{
+    CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = (cdc_dev_t *)cdc_hdl;
+    CDC_ACM_CHECK(cdc_dev->data.tx_coalescer.size, ESP_ERR_NOT_SUPPORTED); // Device was opened without TX coalescing
+
+    // Writers must not append to the buffer while it is flushed
+    if (xSemaphoreTake(cdc_dev->data.out_mux, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    const esp_err_t ret = cdc_tx_coalescer_flush(&cdc_dev->data.tx_coalescer, timeout_ms);
+    xSemaphoreGive(cdc_dev->data.out_mux);
+    return ret;
+}
+
+esp_err_t cdc_acm_host_tx_cancel(cdc_acm_dev_hdl_t cdc_hdl)
+{
+    CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = (cdc_dev_t *)cdc_hdl;
+    CDC_ACM_CHECK(cdc_dev->data.out_pool, ESP_ERR_NOT_SUPPORTED); // Device was opened without asynchronous TX
+
+    // Device in standby has no transfers in flight
+    if (cdc_dev->dev_hdl == NULL || uxQueueMessagesWaiting(cdc_dev->data.out_pool_free) == (UBaseType_t)cdc_dev->data.out_pool_num) {
+        return ESP_OK;
+    }
+    return cdc_acm_reset_transfer_endpoint(cdc_dev, cdc_dev->data.out_pool[0]);
+}
+
+esp_err_t cdc_acm_host_data_rx_read(cdc_acm_dev_hdl_t cdc_hdl, uint8_t *data, size_t data_len, size_t *read_len, uint32_t timeout_ms)
+{
+    CDC_ACM_CHECK(cdc_hdl && data && (data_len > 0) && read_len, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = (cdc_dev_t *)cdc_hdl;
+    CDC_ACM_CHECK(cdc_dev->data.rx_ring, ESP_ERR_NOT_SUPPORTED); // Device was opened without RX ring buffer
+    *read_len = 0;
+
+    // Wait for data. The data can wrap around the end of the ring buffer, so we might need to read twice
+    size_t chunk_len;
+    uint8_t *chunk = xRingbufferReceiveUpTo(cdc_dev->data.rx_ring, &chunk_len, pdMS_TO_TICKS(timeout_ms), data_len);
+    if (!chunk) {
+        return ESP_ERR_TIMEOUT;
+    }
+    memcpy(data, chunk, chunk_len);
+    vRingbufferReturnItem(cdc_dev->data.rx_ring, chunk);
+    *read_len = chunk_len;
+    if (*read_len < data_len) {
+        chunk = xRingbufferReceiveUpTo(cdc_dev->data.rx_ring, &chunk_len, 0, data_len - *read_len);
+        if (chunk) {
+            memcpy(data + *read_len, chunk, chunk_len);
+            vRingbufferReturnItem(cdc_dev->data.rx_ring, chunk);
+            *read_len += chunk_len;
+        }
+    }
+
+    // Notify the user that the ring buffer was emptied below low watermark
+    const size_t len = cdc_acm_rx_ring_get_len(cdc_dev);
+    if (cdc_dev->data.rx_above_watermark && len <= cdc_dev->data.rx_low_watermark) {
+        cdc_dev->data.rx_above_watermark = false;
+        cdc_acm_rx_ring_watermark_notify(cdc_dev, CDC_ACM_HOST_RX_LOW_WATERMARK, len);
+    }
+
+    // Resume paused reception if the ring buffer can accept the whole IN transfer again. Device in standby resumes it on reconnection, suspended bus on resume
+    bool resume = false;
+    CDC_ACM_ENTER_CRITICAL();
+    if (cdc_dev->data.rx_paused && cdc_dev->dev_hdl && !cdc_dev->suspended && (xRingbufferGetCurFreeSize(cdc_dev->data.rx_ring) >= (size_t)cdc_dev->data.in_xfer->num_bytes)) {
+        cdc_dev->data.rx_paused = false;
+        resume = true;
+    }
+    CDC_ACM_EXIT_CRITICAL();
+    if (resume) {
+        ESP_LOGD(TAG, "Resuming BULK IN");
+        CLIENT_TRANSFER_SUBMIT(cdc_dev->data.in_xfer);
+    }
+    return ESP_OK;
+}
+
+esp_err_t cdc_acm_host_get_stats(cdc_acm_dev_hdl_t cdc_hdl, cdc_acm_host_stats_t *stats_ret)
+{
+    CDC_ACM_CHECK(cdc_hdl && stats_ret, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = (cdc_dev_t *)cdc_hdl;
+
+    CDC_ACM_ENTER_CRITICAL();
+    *stats_ret = cdc_dev->stats;
+    CDC_ACM_EXIT_CRITICAL();
+    return ESP_OK;
+}
+
+esp_err_t cdc_acm_host_reset_stats(cdc_acm_dev_hdl_t cdc_hdl)
+{
+    CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
+    cdc_dev_t *cdc_dev = (cdc_dev_t *)cdc_hdl;
+
+    CDC_ACM_ENTER_CRITICAL();
+    memset(&cdc_dev->stats, 0, sizeof(cdc_acm_host_stats_t));
+    CDC_ACM_EXIT_CRITICAL();
+    return ESP_OK;
+}
+
 esp_err_t cdc_acm_host_line_coding_get(cdc_acm_dev_hdl_t cdc_hdl, cdc_acm_line_coding_t *line_coding)
 {
     CDC_ACM_CHECK(line_coding, ESP_ERR_INVALID_ARG);
@@ -1007,6 +2098,7 @@ esp_err_t cdc_acm_host_send_custom_request(cdc_acm_dev_hdl_t cdc_hdl, uint8_t bm
         CDC_ACM_CHECK(data, ESP_ERR_INVALID_ARG);
     }
     CDC_ACM_CHECK(cdc_dev->ctrl_transfer->data_buffer_size >= wLength, ESP_ERR_INVALID_SIZE);
+    CDC_ACM_CHECK(cdc_dev->dev_hdl, ESP_ERR_INVALID_STATE); // Device is in standby, waiting for reconnection
 
     esp_err_t ret;
 
@@ -1031,13 +2123,13 @@ esp_err_t cdc_acm_host_send_custom_request(cdc_acm_dev_hdl_t cdc_hdl, uint8_t bm
 
     cdc_dev->ctrl_transfer->num_bytes = wLength + sizeof(usb_setup_packet_t);
     ESP_GOTO_ON_ERROR(
-        usb_host_transfer_submit_control(p_cdc_acm_obj->cdc_acm_client_hdl, cdc_dev->ctrl_transfer),
+        CLIENT_TRANSFER_SUBMIT_CONTROL(p_cdc_acm_obj->cdc_acm_client_hdl, cdc_dev->ctrl_transfer),
         unblock, TAG, "CTRL transfer failed");
 
     taken = xSemaphoreTake((SemaphoreHandle_t)cdc_dev->ctrl_transfer->context, pdMS_TO_TICKS(CDC_ACM_CTRL_TIMEOUT_MS));
     if (!taken) {
         // Transfer was not finished, error in USB LIB. Reset the endpoint
-        cdc_acm_reset_transfer_endpoint(cdc_dev->dev_hdl, cdc_dev->ctrl_transfer);
+        cdc_acm_reset_transfer_endpoint(cdc_dev, cdc_dev->ctrl_transfer);
         ret = ESP_ERR_TIMEOUT;
         goto unblock;
     }
@@ -1059,6 +2151,7 @@ unblock:
 static esp_err_t send_cdc_request(cdc_dev_t *cdc_dev, bool in_transfer, cdc_request_code_t request, uint8_t *data, uint16_t data_len, uint16_t value)
 {
     CDC_ACM_CHECK(cdc_dev, ESP_ERR_INVALID_ARG);
+    CDC_ACM_CHECK(cdc_dev->dev_hdl, ESP_ERR_INVALID_STATE); // Interface descriptors are not available in standby
     CDC_ACM_CHECK(cdc_dev->notif.intf_desc, ESP_ERR_NOT_SUPPORTED);
 
     uint8_t req_type = USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIP_INTERFACE;
@@ -1089,16 +2182,8 @@ esp_err_t cdc_acm_host_cdc_desc_get(cdc_acm_dev_hdl_t cdc_hdl, cdc_desc_subtype_
     CDC_ACM_CHECK(cdc_hdl, ESP_ERR_INVALID_ARG);
     CDC_ACM_CHECK(desc_type < USB_CDC_DESC_SUBTYPE_MAX, ESP_ERR_INVALID_ARG);
     cdc_dev_t *cdc_dev = (cdc_dev_t *)cdc_hdl;
-    esp_err_t ret = ESP_ERR_NOT_FOUND;
-    *desc_out = NULL;
-
-    for (int i = 0; i < cdc_dev->cdc_func_desc_cnt; i++) {
-        const cdc_header_desc_t *_desc = (const cdc_header_desc_t *)((*(cdc_dev->cdc_func_desc))[i]);
-        if (_desc->bDescriptorSubtype == desc_type) {
-            ret = ESP_OK;
-            *desc_out = (const usb_standard_desc_t *)_desc;
-            break;
-        }
-    }
-    return ret;
+
+    // Functional descriptors were parsed at open, so this is a table lookup
+    *desc_out = cdc_dev->cdc_func.desc[desc_type];
+    return *desc_out ? ESP_OK : ESP_ERR_NOT_FOUND;
 }
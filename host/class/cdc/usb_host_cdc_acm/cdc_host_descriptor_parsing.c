@@ -66,14 +66,15 @@ static bool cdc_parse_is_cdc_compliant(const usb_device_desc_t *device_desc, con
 /**
  * @brief Parse CDC functional descriptors
  *
- * @attention The driver must take care of memory freeing
+ * The descriptors are stored in a table indexed by subtype, so later lookups do not walk the Configuration descriptor.
+ *
  * @param[in] intf_desc   Pointer to Notification interface descriptor
  * @param[in] total_len   wTotalLength of the Configuration descriptor
  * @param[in] desc_offset Offset of the intf_desc in the Configuration descriptor in bytes
- * @param[out] desc_cnt   Number of Functional descriptors found
- * @return Pointer to array of pointers to Functional descriptors
+ * @param[out] func_table Functional descriptors found
+ * @return Number of Functional descriptors found
  */
-static cdc_func_array_t *cdc_parse_functional_descriptors(const usb_intf_desc_t *intf_desc, uint16_t total_len, int desc_offset, int *desc_cnt)
+static int cdc_parse_functional_descriptors(const usb_intf_desc_t *intf_desc, uint16_t total_len, int desc_offset, cdc_func_table_t *func_table)
 {
     // CDC specific descriptors should be right after CDC-Communication interface descriptor
     // Note: That's why we use usb_parse_next_descriptor instead of usb_parse_next_descriptor_of_type.
@@ -83,31 +84,15 @@ static cdc_func_array_t *cdc_parse_functional_descriptors(const usb_intf_desc_t
     const usb_standard_desc_t *cdc_desc = (const usb_standard_desc_t *)intf_desc;
     while ((cdc_desc = usb_parse_next_descriptor(cdc_desc, total_len, &intf_offset))) {
         if (cdc_desc->bDescriptorType != ((USB_CLASS_COMM << 4) | USB_B_DESCRIPTOR_TYPE_INTERFACE )) {
-            if (func_desc_cnt == 0) {
-                return NULL; // There are no CDC specific descriptors
-            } else {
-                break;       // We found all CDC specific descriptors
-            }
+            break; // We found all CDC specific descriptors
+        }
+        const uint8_t subtype = ((const cdc_header_desc_t *)cdc_desc)->bDescriptorSubtype;
+        if (subtype < USB_CDC_DESC_SUBTYPE_MAX && func_table->desc[subtype] == NULL) {
+            func_table->desc[subtype] = cdc_desc;
         }
         func_desc_cnt++;
     }
-
-    // Allocate memory for the functional descriptors pointers
-    cdc_func_array_t *func_desc = malloc(func_desc_cnt * (sizeof(usb_standard_desc_t *)));
-    if (!func_desc) {
-        ESP_LOGD(TAG, "Out of mem for functional descriptors");
-        return NULL;
-    }
-
-    // Save the descriptors
-    intf_offset = desc_offset; // Reset the offset counter
-    cdc_desc = (const usb_standard_desc_t *)intf_desc;
-    for (int i = 0; i < func_desc_cnt; i++) {
-        cdc_desc = (const usb_standard_desc_t *)usb_parse_next_descriptor(cdc_desc, total_len, &intf_offset);
-        (*func_desc)[i] = cdc_desc;
-    }
-    *desc_cnt = func_desc_cnt;
-    return func_desc;
+    return func_desc_cnt;
 }
 
 esp_err_t cdc_parse_interface_descriptor(const usb_device_desc_t *device_desc, const usb_config_desc_t *config_desc, uint8_t intf_idx, cdc_parsed_info_t *info_ret)
@@ -142,7 +127,7 @@ esp_err_t cdc_parse_interface_descriptor(const usb_device_desc_t *device_desc, c
     const bool cdc_compliant = cdc_parse_is_cdc_compliant(device_desc, config_desc, intf_idx);
     if (cdc_compliant) {
         info_ret->notif_intf = first_intf_desc; // We make sure that intf_desc is set for CDC compliant devices that use EP0 as notification element
-        info_ret->func = cdc_parse_functional_descriptors(first_intf_desc, config_desc->wTotalLength, desc_offset, &info_ret->func_cnt);
+        info_ret->func_cnt = cdc_parse_functional_descriptors(first_intf_desc, config_desc->wTotalLength, desc_offset, &info_ret->func);
     }
 
     if (!info_ret->data_intf && cdc_compliant) {
@@ -0,0 +1,207 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "cdc_host_framing.h"
+#include "cdc_host_attr.h"
+
+static const char *TAG = "cdc_framing";
+
+// SLIP special characters, RFC 1055
+#define SLIP_END            0xC0
+#define SLIP_ESC            0xDB
+#define SLIP_ESC_END        0xDC
+#define SLIP_ESC_ESC        0xDD
+
+// HDLC-like framing special characters and FCS, RFC 1662
+#define HDLC_FLAG           0x7E
+#define HDLC_ESC            0x7D
+#define HDLC_ESC_XOR        0x20
+#define HDLC_FCS_INIT       0xFFFF
+#define HDLC_FCS_GOOD       0xF0B8
+#define HDLC_FCS_SIZE       2
+
+// COBS frame delimiter
+#define COBS_DELIMITER      0x00
+
+// Length-prefixed frames: 2-byte big-endian length
+#define LENGTH_PREFIX_SIZE  2
+
+void cdc_framer_init(cdc_framer_t *framer, cdc_acm_framing_t type, cdc_acm_frame_callback_t cb, void *cb_arg)
+{
+    framer->type = type;
+    framer->cb = cb;
+    framer->cb_arg = cb_arg;
+    framer->frame_start = NULL;
+}
+
+void CDC_ACM_DATA_PATH_ATTR cdc_framer_reset(cdc_framer_t *framer)
+{
+    framer->frame_start = NULL;
+}
+
+uint16_t CDC_ACM_DATA_PATH_ATTR cdc_framer_fcs16(uint16_t fcs, const uint8_t *data, size_t len)
+{
+    while (len--) {
+        fcs ^= *data++;
+        for (int i = 0; i < 8; i++) {
+            fcs = (fcs & 1) ? (fcs >> 1) ^ 0x8408 : (fcs >> 1);
+        }
+    }
+    return fcs;
+}
+
+/**
+ * @brief Remove escaping of SLIP or HDLC frame in place
+ *
+ * @param[inout] frame Frame without delimiters
+ * @param[in]    len   Length of the frame
+ * @param[in]    type  CDC_ACM_FRAMING_SLIP or CDC_ACM_FRAMING_HDLC
+ * @return Length of decoded frame or -1 on invalid escape sequence
+ */
+static int CDC_ACM_DATA_PATH_ATTR cdc_framer_unescape(uint8_t *frame, size_t len, cdc_acm_framing_t type)
+{
+    const uint8_t esc = (type == CDC_ACM_FRAMING_SLIP) ? SLIP_ESC : HDLC_ESC;
+    size_t out = 0;
+    for (size_t in = 0; in < len; in++) {
+        uint8_t c = frame[in];
+        if (c == esc) {
+            if (++in >= len) {
+                return -1;
+            }
+            c = frame[in];
+            if (type == CDC_ACM_FRAMING_HDLC) {
+                c ^= HDLC_ESC_XOR;
+            } else if (c == SLIP_ESC_END) {
+                c = SLIP_END;
+            } else if (c == SLIP_ESC_ESC) {
+                c = SLIP_ESC;
+            } else {
+                return -1;
+            }
+        }
+        frame[out++] = c;
+    }
+    return out;
+}
+
+/**
+ * @brief Decode COBS frame in place
+ *
+ * @param[inout] frame Frame without delimiter
+ * @param[in]    len   Length of the frame
+ * @return Length of decoded frame or -1 on invalid frame
+ */
+static int CDC_ACM_DATA_PATH_ATTR cdc_framer_cobs_decode(uint8_t *frame, size_t len)
+{
+    size_t in = 0;
+    size_t out = 0;
+    while (in < len) {
+        const uint8_t code = frame[in++];
+        if (code == 0 || in + code - 1 > len) {
+            return -1;
+        }
+        for (unsigned i = 1; i < code; i++) {
+            frame[out++] = frame[in++];
+        }
+        if (code != 0xFF && in < len) {
+            frame[out++] = 0;
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief Decode frame in place and pass it to the user
+ *
+ * @param[in]    framer Framer
+ * @param[inout] frame  Encoded frame without delimiters
+ * @param[in]    len    Length of the encoded frame
+ */
+static void CDC_ACM_DATA_PATH_ATTR cdc_framer_deliver(cdc_framer_t *framer, uint8_t *frame, size_t len)
+{
+    if (len == 0) {
+        return; // Empty frames between delimiters are not delivered
+    }
+
+    int decoded_len;
+    switch (framer->type) {
+    case CDC_ACM_FRAMING_SLIP:
+        decoded_len = cdc_framer_unescape(frame, len, CDC_ACM_FRAMING_SLIP);
+        break;
+    case CDC_ACM_FRAMING_HDLC:
+        decoded_len = cdc_framer_unescape(frame, len, CDC_ACM_FRAMING_HDLC);
+        if (decoded_len <= HDLC_FCS_SIZE || cdc_framer_fcs16(HDLC_FCS_INIT, frame, decoded_len) != HDLC_FCS_GOOD) {
+            decoded_len = -1;
+        } else {
+            decoded_len -= HDLC_FCS_SIZE;
+        }
+        break;
+    case CDC_ACM_FRAMING_COBS:
+        decoded_len = cdc_framer_cobs_decode(frame, len);
+        break;
+    default:
+        decoded_len = len;
+        break;
+    }
+
+    if (decoded_len < 0) {
+        ESP_LOGD(TAG, "Invalid frame dropped");
+        return;
+    }
+    if (framer->cb) {
+        framer->cb(frame, decoded_len, framer->cb_arg);
+    }
+}
+
+bool CDC_ACM_DATA_PATH_ATTR cdc_framer_process(cdc_framer_t *framer, uint8_t *data, size_t data_len)
+{
+    uint8_t *const end = data + data_len;
+    uint8_t *start = framer->frame_start ? framer->frame_start : data;
+
+    if (framer->type == CDC_ACM_FRAMING_LENGTH_PREFIX) {
+        while (end - start >= LENGTH_PREFIX_SIZE) {
+            const size_t len = ((size_t)start[0] << 8) | start[1];
+            if ((size_t)(end - start - LENGTH_PREFIX_SIZE) < len) {
+                break; // Incomplete frame
+            }
+            cdc_framer_deliver(framer, start + LENGTH_PREFIX_SIZE, len);
+            start += LENGTH_PREFIX_SIZE + len;
+        }
+    } else {
+        uint8_t delimiter;
+        switch (framer->type) {
+        case CDC_ACM_FRAMING_SLIP: delimiter = SLIP_END; break;
+        case CDC_ACM_FRAMING_HDLC: delimiter = HDLC_FLAG; break;
+        default: delimiter = COBS_DELIMITER; break;
+        }
+
+        // Data of incomplete frame before 'data' were already searched for delimiter
+        uint8_t *scan = data;
+        uint8_t *delimiter_ptr;
+        while ((delimiter_ptr = memchr(scan, delimiter, end - scan)) != NULL) {
+            cdc_framer_deliver(framer, start, delimiter_ptr - start);
+            start = scan = delimiter_ptr + 1;
+        }
+    }
+
+    framer->frame_start = (start < end) ? start : NULL;
+    return framer->frame_start == NULL;
+}
+
+size_t CDC_ACM_DATA_PATH_ATTR cdc_framer_move_incomplete(cdc_framer_t *framer, uint8_t *buf, const uint8_t *data_end)
+{
+    if (framer->frame_start == NULL) {
+        return 0;
+    }
+    const size_t len = data_end - framer->frame_start;
+    if (framer->frame_start != buf) {
+        memmove(buf, framer->frame_start, len);
+        framer->frame_start = buf;
+    }
+    return len;
+}
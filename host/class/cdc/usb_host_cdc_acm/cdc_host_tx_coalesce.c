@@ -0,0 +1,236 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "cdc_host_tx_coalesce.h"
+#include "cdc_host_attr.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#endif
+
+static const char *TAG = "cdc_tx_coalesce";
+
+// Protects buffer ownership and counters of all coalescers against the deadline timer and the TX done callback
+static portMUX_TYPE coalesce_lock = portMUX_INITIALIZER_UNLOCKED;
+#define COALESCE_ENTER_CRITICAL()   portENTER_CRITICAL(&coalesce_lock)
+#define COALESCE_EXIT_CRITICAL()    portEXIT_CRITICAL(&coalesce_lock)
+
+static int64_t cdc_tx_coalescer_time_us(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return esp_timer_get_time();
+#endif
+}
+
+/**
+ * @brief Transmission of coalesced data finished, called from USB Host context
+ */
+static void CDC_ACM_DATA_PATH_ATTR cdc_tx_coalescer_done(esp_err_t status, size_t data_len, void *user_arg)
+{
+    cdc_tx_coalescer_t *coalescer = (cdc_tx_coalescer_t *)user_arg;
+    COALESCE_ENTER_CRITICAL();
+    if (status != ESP_OK && coalescer->error == ESP_OK) {
+        coalescer->error = status;
+    }
+    coalescer->in_flight--;
+    const bool flushed = coalescer->flush_waiting && (coalescer->in_flight == 0);
+    COALESCE_EXIT_CRITICAL();
+    if (flushed) {
+        xSemaphoreGive(coalescer->flushed);
+    }
+}
+
+/**
+ * @brief Submit TX buffer
+ *
+ * @note in_flight must be incremented by the caller, together with taking the buffer
+ */
+static esp_err_t cdc_tx_coalescer_submit(cdc_tx_coalescer_t *coalescer, uint8_t *buf, size_t len)
+{
+    const esp_err_t ret = cdc_acm_host_tx_buffer_submit(coalescer->cdc_hdl, buf, len, cdc_tx_coalescer_done, coalescer);
+    if (ret != ESP_OK) {
+        COALESCE_ENTER_CRITICAL();
+        coalescer->in_flight--;
+        COALESCE_EXIT_CRITICAL();
+    }
+    return ret;
+}
+
+/**
+ * @brief Take buffered data for submission
+ *
+ * @param[in]  coalescer Coalescer
+ * @param[out] len       Number of buffered bytes
+ * @return Buffer to be submitted, NULL if no data are buffered
+ */
+static uint8_t *cdc_tx_coalescer_take(cdc_tx_coalescer_t *coalescer, size_t *len)
+{
+    COALESCE_ENTER_CRITICAL();
+    uint8_t *buf = coalescer->buf;
+    *len = coalescer->len;
+    if (buf) {
+        coalescer->buf = NULL;
+        coalescer->in_flight++;
+    }
+    COALESCE_EXIT_CRITICAL();
+    return buf;
+}
+
+#if !CONFIG_IDF_TARGET_LINUX
+/**
+ * @brief Deadline of buffered data passed, called from esp_timer task
+ *
+ * If a writer is appending to the buffer at the moment, the writer sends it.
+ */
+static void cdc_tx_coalescer_deadline(void *arg)
+{
+    cdc_tx_coalescer_t *coalescer = (cdc_tx_coalescer_t *)arg;
+    size_t len;
+    uint8_t *buf = cdc_tx_coalescer_take(coalescer, &len);
+    if (buf && cdc_tx_coalescer_submit(coalescer, buf, len) != ESP_OK) {
+        ESP_LOGW(TAG, "Coalesced data dropped");
+    }
+}
+#endif
+
+esp_err_t cdc_tx_coalescer_init(cdc_tx_coalescer_t *coalescer, cdc_acm_dev_hdl_t cdc_hdl, size_t size, uint32_t hold_us)
+{
+    memset(coalescer, 0, sizeof(cdc_tx_coalescer_t));
+    coalescer->cdc_hdl = cdc_hdl;
+    coalescer->size = size;
+    coalescer->hold_us = hold_us;
+    coalescer->flushed = xSemaphoreCreateBinary();
+    if (coalescer->flushed == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+#if !CONFIG_IDF_TARGET_LINUX
+    // Host tests have no esp_timer, the deadline is checked on the next write there
+    if (hold_us) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = cdc_tx_coalescer_deadline,
+            .arg = coalescer,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "cdc_tx_coalesce",
+        };
+        if (esp_timer_create(&timer_args, &coalescer->timer) != ESP_OK) {
+            vSemaphoreDelete(coalescer->flushed);
+            coalescer->flushed = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+    }
+#endif
+    return ESP_OK;
+}
+
+void cdc_tx_coalescer_deinit(cdc_tx_coalescer_t *coalescer)
+{
+#if !CONFIG_IDF_TARGET_LINUX
+    if (coalescer->timer) {
+        esp_timer_stop(coalescer->timer); // The timer might not be running, ignore the error
+        esp_timer_delete(coalescer->timer);
+        coalescer->timer = NULL;
+    }
+#endif
+    if (coalescer->flushed) {
+        vSemaphoreDelete(coalescer->flushed);
+        coalescer->flushed = NULL;
+    }
+    coalescer->buf = NULL; // The buffer belongs to the OUT transfer pool, which is freed together with the device
+}
+
+esp_err_t cdc_tx_coalescer_write(cdc_tx_coalescer_t *coalescer, const uint8_t *data, size_t data_len, uint32_t timeout_ms)
+{
+    esp_err_t ret;
+
+    // Take the buffer, so the deadline timer does not send it while the data are appended
+    COALESCE_ENTER_CRITICAL();
+    uint8_t *buf = coalescer->buf;
+    size_t len = coalescer->len;
+    coalescer->buf = NULL;
+    if (buf && (len + data_len > coalescer->buf_size)) {
+        coalescer->in_flight++; // The data do not fit, send the buffer first
+    }
+    COALESCE_EXIT_CRITICAL();
+
+    if (buf && (len + data_len > coalescer->buf_size)) {
+        ret = cdc_tx_coalescer_submit(coalescer, buf, len);
+        buf = NULL;
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    if (buf == NULL) {
+        ret = cdc_acm_host_tx_buffer_get(coalescer->cdc_hdl, timeout_ms, &buf, &coalescer->buf_size);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        len = 0;
+        coalescer->deadline_us = cdc_tx_coalescer_time_us() + coalescer->hold_us;
+#if !CONFIG_IDF_TARGET_LINUX
+        if (coalescer->timer) {
+            esp_timer_stop(coalescer->timer); // Deadline of previous buffer, which was already sent
+            esp_timer_start_once(coalescer->timer, coalescer->hold_us);
+        }
+#endif
+    }
+
+    memcpy(buf + len, data, data_len);
+    len += data_len;
+
+    // Give the buffer back, unless it is full enough or its deadline passed while the data were appended
+    COALESCE_ENTER_CRITICAL();
+    const bool send = (len >= coalescer->size) ||
+                      (coalescer->hold_us && (cdc_tx_coalescer_time_us() >= coalescer->deadline_us));
+    if (send) {
+        coalescer->in_flight++;
+    } else {
+        coalescer->buf = buf;
+        coalescer->len = len;
+    }
+    COALESCE_EXIT_CRITICAL();
+
+    return send ? cdc_tx_coalescer_submit(coalescer, buf, len) : ESP_OK;
+}
+
+esp_err_t cdc_tx_coalescer_flush(cdc_tx_coalescer_t *coalescer, uint32_t timeout_ms)
+{
+    size_t len;
+    uint8_t *buf = cdc_tx_coalescer_take(coalescer, &len);
+    if (buf) {
+        const esp_err_t ret = cdc_tx_coalescer_submit(coalescer, buf, len);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    // Transmissions finish in order, so waiting for the last one covers all
+    xSemaphoreTake(coalescer->flushed, 0); // Drop a give of a flush that timed out
+    COALESCE_ENTER_CRITICAL();
+    const bool done = (coalescer->in_flight == 0);
+    coalescer->flush_waiting = !done;
+    COALESCE_EXIT_CRITICAL();
+    if (!done) {
+        const BaseType_t taken = xSemaphoreTake(coalescer->flushed, pdMS_TO_TICKS(timeout_ms));
+        COALESCE_ENTER_CRITICAL();
+        coalescer->flush_waiting = false;
+        COALESCE_EXIT_CRITICAL();
+        if (taken != pdTRUE) {
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+
+    COALESCE_ENTER_CRITICAL();
+    const esp_err_t ret = coalescer->error;
+    coalescer->error = ESP_OK;
+    COALESCE_EXIT_CRITICAL();
+    return ret;
+}
@@ -32,6 +32,8 @@ typedef struct {
         usb_transfer_t *in_xfer;
         uint8_t in_bEndpointAddress;
         uint8_t out_bEndpointAddress;
+        int in_ring_num;        // Number of IN transfers queued behind in_xfer
+        int out_pool_num;       // Number of OUT transfers for asynchronous TX
     } data;
     struct {
         usb_transfer_t *xfer;
@@ -85,6 +87,7 @@ static esp_err_t _test_create_cmock_expectations(uint8_t dev_address, uint8_t in
     // Check, if IN data transfer is allocated
     if (dev_config->in_buffer_size) {
         cdc_dev_expects->data.in_xfer = reinterpret_cast<usb_transfer_t *>(&data_in_xfer);
+        cdc_dev_expects->data.in_ring_num = (dev_config->in_transfers_num > 1) ? dev_config->in_transfers_num - 1 : 0;
     } else {
         cdc_dev_expects->data.in_xfer = nullptr;
     }
@@ -92,6 +95,7 @@ static esp_err_t _test_create_cmock_expectations(uint8_t dev_address, uint8_t in
     // Check if OUT data transfer is allocated
     if (dev_config->out_buffer_size) {
         cdc_dev_expects->data.out_xfer = reinterpret_cast<usb_transfer_t *>(&data_out_xfer);
+        cdc_dev_expects->data.out_pool_num = dev_config->out_transfers_num;
     } else {
         cdc_dev_expects->data.out_xfer = nullptr;
     }
@@ -174,14 +178,18 @@ esp_err_t test_cdc_acm_host_open(uint8_t dev_address, uint16_t vid, uint16_t pid
         usb_host_transfer_alloc_ExpectAnyArgsAndReturn(ESP_OK);
     }
 
-    //  Setup IN data transfer
+    //  Setup IN data transfer and the IN transfers queued behind it
     if (dev_config->in_buffer_size) {
-        usb_host_transfer_alloc_ExpectAnyArgsAndReturn(ESP_OK);
+        for (int i = 0; i < 1 + p_cdc_dev_expects->data.in_ring_num; i++) {
+            usb_host_transfer_alloc_ExpectAnyArgsAndReturn(ESP_OK);
+        }
     }
 
-    // Setup OUT bulk transfer
+    // Setup OUT bulk transfer and the pool of OUT transfers for asynchronous TX
     if (dev_config->out_buffer_size) {
-        usb_host_transfer_alloc_ExpectAnyArgsAndReturn(ESP_OK);
+        for (int i = 0; i < 1 + p_cdc_dev_expects->data.out_pool_num; i++) {
+            usb_host_transfer_alloc_ExpectAnyArgsAndReturn(ESP_OK);
+        }
     }
 
     // Register callback
@@ -193,6 +201,11 @@ esp_err_t test_cdc_acm_host_open(uint8_t dev_address, uint16_t vid, uint16_t pid
     // Make sure that the interface_index has been claimed
     test_usb_host_interface_claim(interface_index);
 
+    // All IN transfers are submitted together with the data interface claim
+    for (int i = 0; i < p_cdc_dev_expects->data.in_ring_num; i++) {
+        usb_host_transfer_submit_ExpectAnyArgsAndReturn(ESP_OK);
+    }
+
     // Claim notification interface (if supported)
     if (p_cdc_dev_expects->notif.xfer) {
         test_usb_host_interface_claim(interface_index);
@@ -231,15 +244,19 @@ esp_err_t test_cdc_acm_host_close(cdc_acm_dev_hdl_t *cdc_hdl, uint8_t interface_
         p_cdc_dev_expects->notif.xfer = nullptr;
     }
 
-    // Free in transfer
+    // Free in transfers
     if (p_cdc_dev_expects->data.in_xfer) {
-        usb_host_transfer_free_ExpectAnyArgsAndReturn(ESP_OK);
+        for (int i = 0; i < 1 + p_cdc_dev_expects->data.in_ring_num; i++) {
+            usb_host_transfer_free_ExpectAnyArgsAndReturn(ESP_OK);
+        }
         p_cdc_dev_expects->data.in_xfer = nullptr;
     }
 
-    // Free out transfer
+    // Free out transfers
     if (p_cdc_dev_expects->data.out_xfer) {
-        usb_host_transfer_free_ExpectAnyArgsAndReturn(ESP_OK);
+        for (int i = 0; i < 1 + p_cdc_dev_expects->data.out_pool_num; i++) {
+            usb_host_transfer_free_ExpectAnyArgsAndReturn(ESP_OK);
+        }
         p_cdc_dev_expects->data.out_xfer = nullptr;
     }
 
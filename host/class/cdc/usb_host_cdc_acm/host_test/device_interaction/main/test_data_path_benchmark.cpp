@@ -0,0 +1,175 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <catch2/catch_test_macros.hpp>
+#include "test_benchmark.hpp"
+
+#include "descriptors/cdc_descriptors.hpp"
+#include "usb/cdc_acm_host.h"
+#include "mock_add_usb_device.h"
+#include "common_test_fixtures.hpp"
+#include "cdc_host_types.h"
+
+extern "C" {
+#include "Mockusb_host.h"
+}
+
+/**
+ * Data path benchmark
+ *
+ * A mocked device is opened with the fixtures, then the USB Host transfer submission is stubbed:
+ * - RX: Submitted IN transfers are queued. The benchmark completes them with synthetic data and calls their callback,
+ *   that is the driver's IN callback, which calls data_cb and submits the transfer again
+ * - TX: Submitted OUT transfers complete immediately, within the submit call
+ *
+ * Time and allocations are measured per transfer, the stubbed USB Host calls are included.
+ */
+
+namespace {
+
+std::deque<usb_transfer_t *> pending_in; // Submitted IN transfers, in order of submission
+size_t rx_bytes;
+
+constexpr int benchmark_iterations = 100000;
+
+// CP210x: bulk IN and OUT endpoint, no notification endpoint
+constexpr uint8_t device_address = 0;
+constexpr uint8_t interface_index = 0;
+constexpr uint16_t vid = 0x10C4, pid = 0xEA60;
+
+esp_err_t benchmark_submit(usb_transfer_t *transfer, int call_count)
+{
+    if (transfer->bEndpointAddress & USB_B_ENDPOINT_ADDRESS_EP_DIR_MASK) {
+        pending_in.push_back(transfer);
+        return ESP_OK;
+    }
+    transfer->status = USB_TRANSFER_STATUS_COMPLETED;
+    transfer->actual_num_bytes = transfer->num_bytes;
+    transfer->callback(transfer);
+    return ESP_OK;
+}
+
+bool benchmark_rx_cb(const uint8_t *data, size_t data_len, void *user_arg)
+{
+    rx_bytes += data_len;
+    return true;
+}
+
+enum class path {
+    rx,
+    tx_blocking,
+    tx_async,
+};
+
+struct benchmark_case {
+    const char *name;
+    path data_path;
+    size_t transfer_size;
+    int in_transfers_num;
+};
+
+const benchmark_case cases[] = {
+    {"RX data_cb",           path::rx,          64,  0},
+    {"RX data_cb",           path::rx,          512, 0},
+    {"RX 4 IN transfers",    path::rx,          64,  4},
+    {"RX 4 IN transfers",    path::rx,          512, 4},
+    {"TX blocking",          path::tx_blocking, 64,  0},
+    {"TX blocking",          path::tx_blocking, 512, 0},
+    {"TX async",             path::tx_async,    64,  0},
+    {"TX async",             path::tx_async,    512, 0},
+};
+
+void run_benchmark(const benchmark_case &bench)
+{
+    cdc_acm_dev_hdl_t dev = nullptr;
+    const cdc_acm_host_device_config_t dev_config = {
+        .connection_timeout_ms = 1000,
+        .out_buffer_size = 512,
+        .in_buffer_size = 512,
+        .event_cb = nullptr,
+        .data_cb = benchmark_rx_cb,
+        .user_arg = nullptr,
+        .out_transfers_num = (bench.data_path == path::tx_async) ? 4 : 0,
+        .in_transfers_num = bench.in_transfers_num,
+    };
+    REQUIRE(ESP_OK == test_cdc_acm_host_open(device_address, vid, pid, interface_index, &dev_config, &dev));
+
+    // IN transfers were submitted during opening, queue them for completion
+    cdc_dev_t *cdc_dev = dev;
+    pending_in.clear();
+    pending_in.push_back(cdc_dev->data.in_xfer);
+    for (int i = 0; i < cdc_dev->data.in_ring_num; i++) {
+        pending_in.push_back(cdc_dev->data.in_ring[i]);
+    }
+    usb_host_transfer_submit_Stub(benchmark_submit);
+
+    static uint8_t tx_data[512];
+    int errors = 0;
+    rx_bytes = 0;
+    test_benchmark_meter meter;
+    meter.start();
+    for (int i = 0; i < benchmark_iterations; i++) {
+        switch (bench.data_path) {
+        case path::rx: {
+            usb_transfer_t *transfer = pending_in.front();
+            pending_in.pop_front();
+            transfer->status = USB_TRANSFER_STATUS_COMPLETED;
+            transfer->actual_num_bytes = bench.transfer_size;
+            transfer->callback(transfer);
+            break;
+        }
+        case path::tx_blocking:
+            errors += (cdc_acm_host_data_tx_blocking(dev, tx_data, bench.transfer_size, 100) != ESP_OK);
+            break;
+        case path::tx_async:
+            errors += (cdc_acm_host_data_tx_async(dev, tx_data, bench.transfer_size, 100, nullptr, nullptr) != ESP_OK);
+            break;
+        }
+    }
+    meter.stop();
+    REQUIRE(errors == 0);
+
+    cdc_acm_host_stats_t stats;
+    REQUIRE(ESP_OK == cdc_acm_host_get_stats(dev, &stats));
+    if (bench.data_path == path::rx) {
+        REQUIRE(rx_bytes == bench.transfer_size * benchmark_iterations);
+        REQUIRE(stats.transfers_in == benchmark_iterations);
+    } else {
+        REQUIRE(stats.bytes_out == bench.transfer_size * benchmark_iterations);
+    }
+
+    // Back to checked submissions for closing
+    usb_host_transfer_submit_AddCallback(benchmark_submit);
+    REQUIRE(ESP_OK == test_cdc_acm_host_close(&dev, interface_index));
+
+    const double seconds = meter.seconds();
+    printf("%-18s %4zu bytes: %6.0f ns/transfer, %.2f alloc (%zu bytes)/transfer, %7.1f MB/s\n",
+           bench.name,
+           bench.transfer_size,
+           seconds * 1e9 / benchmark_iterations,
+           static_cast<double>(meter.allocs) / benchmark_iterations,
+           meter.alloc_bytes / benchmark_iterations,
+           bench.transfer_size * benchmark_iterations / seconds / 1e6);
+}
+
+} // namespace
+
+TEST_CASE("Data path benchmark", "[.][benchmark]")
+{
+    usb_host_mock_dev_list_init();
+    REQUIRE(ESP_OK == usb_host_mock_add_device(device_address, (const usb_device_desc_t *)cp210x_device_desc,
+            (const usb_config_desc_t *)cp210x_config_desc));
+
+    REQUIRE(ESP_OK == test_cdc_acm_host_install(nullptr));
+    for (const benchmark_case &bench : cases) {
+        run_benchmark(bench);
+    }
+    REQUIRE(ESP_OK == test_cdc_acm_host_uninstall());
+}
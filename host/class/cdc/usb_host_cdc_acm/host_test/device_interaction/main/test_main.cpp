@@ -5,15 +5,19 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <catch2/catch_session.hpp>
 #include <catch2/catch_test_macros.hpp>
 
 
 extern "C" void app_main(void)
 {
-    int argc = 1;
-    const char *argv[2] = {
+    // app_main() has no command line, test specification (e.g. "[benchmark]") can be passed in environment variable
+    const char *test_spec = getenv("CATCH_TEST_SPEC");
+    int argc = test_spec ? 2 : 1;
+    const char *argv[3] = {
         "target_test_main",
+        test_spec,
         NULL
     };
 
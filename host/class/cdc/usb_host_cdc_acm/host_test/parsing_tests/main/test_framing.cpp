@@ -0,0 +1,173 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include "cdc_host_framing.h"
+
+typedef std::vector<uint8_t> bytes_t;
+
+static void frame_cb(const uint8_t *frame, size_t frame_len, void *user_arg)
+{
+    std::vector<bytes_t> *frames = static_cast<std::vector<bytes_t> *>(user_arg);
+    frames->emplace_back(frame, frame + frame_len);
+}
+
+/**
+ * @brief Pass stream to framer in chunks, the way in_xfer_cb() does it
+ *
+ * If the framer needs more data, the incomplete frame is moved to the start of the buffer and the next chunk is appended behind it,
+ * otherwise the buffer is reset
+ */
+static std::vector<bytes_t> run_framer(cdc_acm_framing_t type, const bytes_t &stream, size_t chunk_size)
+{
+    std::vector<bytes_t> frames;
+    cdc_framer_t framer;
+    cdc_framer_init(&framer, type, frame_cb, &frames);
+
+    uint8_t buffer[128];
+    size_t buffer_len = 0;
+    for (size_t pos = 0; pos < stream.size(); pos += chunk_size) {
+        const size_t len = std::min(chunk_size, stream.size() - pos);
+        REQUIRE(buffer_len + len <= sizeof(buffer));
+        memcpy(buffer + buffer_len, stream.data() + pos, len);
+        if (cdc_framer_process(&framer, buffer + buffer_len, len)) {
+            buffer_len = 0;
+        } else {
+            buffer_len = cdc_framer_move_incomplete(&framer, buffer, buffer + buffer_len + len);
+        }
+    }
+    return frames;
+}
+
+static bytes_t hdlc_encode(const bytes_t &payload)
+{
+    bytes_t frame = payload;
+    const uint16_t fcs = cdc_framer_fcs16(0xFFFF, payload.data(), payload.size()) ^ 0xFFFF;
+    frame.push_back(fcs & 0xFF);
+    frame.push_back(fcs >> 8);
+
+    bytes_t encoded = {0x7E};
+    for (uint8_t c : frame) {
+        if (c == 0x7E || c == 0x7D) {
+            encoded.push_back(0x7D);
+            encoded.push_back(c ^ 0x20);
+        } else {
+            encoded.push_back(c);
+        }
+    }
+    encoded.push_back(0x7E);
+    return encoded;
+}
+
+SCENARIO("Framing of received data", "[framing]")
+{
+    const bytes_t payload_1 = {0x01, 0xC0, 0x02, 0xDB, 0x7E, 0x7D, 0x00, 0x03};
+    const bytes_t payload_2 = {0x00, 0x00, 0xAA};
+    const size_t chunk_size = GENERATE(1, 3, 7, 64);
+
+    GIVEN("SLIP frames") {
+        const bytes_t stream = {
+            0xC0, 0x01, 0xDB, 0xDC, 0x02, 0xDB, 0xDD, 0x7E, 0x7D, 0x00, 0x03, 0xC0,
+            0x00, 0x00, 0xAA, 0xC0,
+            0xAB, 0xDB, 0x01, 0xC0, // Invalid escape sequence
+        };
+        const std::vector<bytes_t> frames = run_framer(CDC_ACM_FRAMING_SLIP, stream, chunk_size);
+        REQUIRE(frames.size() == 2);
+        REQUIRE(frames[0] == payload_1);
+        REQUIRE(frames[1] == payload_2);
+    }
+
+    GIVEN("HDLC frames") {
+        bytes_t stream = hdlc_encode(payload_1);
+        const bytes_t frame_2 = hdlc_encode(payload_2);
+        stream.insert(stream.end(), frame_2.begin() + 1, frame_2.end()); // Frames can share the flag
+        bytes_t corrupted = hdlc_encode(payload_2);
+        corrupted[2] ^= 0x01; // FCS error
+        stream.insert(stream.end(), corrupted.begin(), corrupted.end());
+
+        const std::vector<bytes_t> frames = run_framer(CDC_ACM_FRAMING_HDLC, stream, chunk_size);
+        REQUIRE(frames.size() == 2);
+        REQUIRE(frames[0] == payload_1);
+        REQUIRE(frames[1] == payload_2);
+    }
+
+    GIVEN("COBS frames") {
+        const bytes_t stream = {
+            0x07, 0x01, 0xC0, 0x02, 0xDB, 0x7E, 0x7D, 0x02, 0x03, 0x00,
+            0x01, 0x01, 0x02, 0xAA, 0x00,
+            0x05, 0x01, 0x00, // Frame ends in the middle of a block
+        };
+        const std::vector<bytes_t> frames = run_framer(CDC_ACM_FRAMING_COBS, stream, chunk_size);
+        REQUIRE(frames.size() == 2);
+        REQUIRE(frames[0] == payload_1);
+        REQUIRE(frames[1] == payload_2);
+    }
+
+    GIVEN("Length-prefixed frames") {
+        bytes_t stream = {0x00, (uint8_t)payload_1.size()};
+        stream.insert(stream.end(), payload_1.begin(), payload_1.end());
+        stream.push_back(0x00);
+        stream.push_back((uint8_t)payload_2.size());
+        stream.insert(stream.end(), payload_2.begin(), payload_2.end());
+
+        const std::vector<bytes_t> frames = run_framer(CDC_ACM_FRAMING_LENGTH_PREFIX, stream, chunk_size);
+        REQUIRE(frames.size() == 2);
+        REQUIRE(frames[0] == payload_1);
+        REQUIRE(frames[1] == payload_2);
+    }
+}
+
+SCENARIO("Framing of long stream", "[framing]")
+{
+    // The stream is many times longer than the buffer of run_framer(), no frame ends at a chunk boundary
+    const size_t frames_num = 200;
+    const size_t chunk_size = GENERATE(7, 16, 64);
+    std::vector<bytes_t> payloads;
+    for (size_t i = 0; i < frames_num; i++) {
+        payloads.push_back({(uint8_t)i, 0xC0, 0x7E, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, (uint8_t)(i * 3), 0xAA});
+    }
+
+    GIVEN("HDLC frames") {
+        bytes_t stream;
+        for (const bytes_t &payload : payloads) {
+            const bytes_t frame = hdlc_encode(payload);
+            stream.insert(stream.end(), frame.begin(), frame.end());
+        }
+        REQUIRE(run_framer(CDC_ACM_FRAMING_HDLC, stream, chunk_size) == payloads);
+    }
+
+    GIVEN("SLIP frames") {
+        bytes_t stream;
+        for (const bytes_t &payload : payloads) {
+            for (uint8_t c : payload) {
+                if (c == 0xC0) {
+                    stream.insert(stream.end(), {0xDB, 0xDC});
+                } else if (c == 0xDB) {
+                    stream.insert(stream.end(), {0xDB, 0xDD});
+                } else {
+                    stream.push_back(c);
+                }
+            }
+            stream.push_back(0xC0);
+        }
+        REQUIRE(run_framer(CDC_ACM_FRAMING_SLIP, stream, chunk_size) == payloads);
+    }
+
+    GIVEN("Length-prefixed frames") {
+        bytes_t stream;
+        for (const bytes_t &payload : payloads) {
+            stream.insert(stream.end(), {0x00, (uint8_t)payload.size()});
+            stream.insert(stream.end(), payload.begin(), payload.end());
+        }
+        REQUIRE(run_framer(CDC_ACM_FRAMING_LENGTH_PREFIX, stream, chunk_size) == payloads);
+    }
+}
@@ -0,0 +1,141 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include "usb/usb_helpers.h"
+#include "test_benchmark.hpp"
+
+#include "descriptors/cdc_descriptors.hpp"
+#include "descriptors/cypress_rfa.hpp"
+#include "descriptors/stm32_device.hpp"
+#include "cdc_host_descriptor_parsing.h"
+#include "usb/cdc_acm_host.h"
+
+/**
+ * Descriptor parsing benchmark
+ *
+ * Times cdc_parse_interface_descriptor(), that runs in cdc_acm_host_open() before the first USB transfer,
+ * for every interface of every device in the corpus. Interfaces that are not usable by CDC driver are parsed too,
+ * as they cost the same linear scan of the configuration descriptor.
+ */
+
+namespace {
+
+struct corpus_entry {
+    const char *name;
+    const uint8_t *dev_desc;
+    const uint8_t *cfg_desc;
+};
+
+const corpus_entry corpus[] = {
+    {"FTDI FS", ftdi_device_desc_fs_hs, ftdi_config_desc_fs},
+    {"FTDI HS", ftdi_device_desc_fs_hs, ftdi_config_desc_hs},
+    {"TTL232", ttl232_device_desc, ttl232_config_desc},
+    {"CP210x", cp210x_device_desc, cp210x_config_desc},
+    {"CH340", ch340_device_desc, ch340_config_desc},
+    {"Premium Cord FS", premium_cord_device_desc_fs, premium_cord_config_desc_fs},
+    {"Premium Cord HS", premium_cord_device_desc_hs, premium_cord_config_desc_hs},
+    {"i-tec FS", i_tec_device_desc_fs, i_tec_config_desc_fs},
+    {"i-tec HS", i_tec_device_desc_hs, i_tec_config_desc_hs},
+    {"AXAGON FS 1", axagon_device_desc_fs_hs, axagon_config_desc_fs_1},
+    {"AXAGON FS 2", axagon_device_desc_fs_hs, axagon_config_desc_fs_2},
+    {"AXAGON HS 1", axagon_device_desc_fs_hs, axagon_config_desc_hs_1},
+    {"AXAGON HS 2", axagon_device_desc_fs_hs, axagon_config_desc_hs_2},
+    {"SIM7070G FS", sim7070G_device_desc_fs_hs, sim7070G_config_desc_fs},
+    {"SIM7070G HS", sim7070G_device_desc_fs_hs, sim7070G_config_desc_hs},
+    {"BG96 FS", bg96_device_desc_fs_hs, bg96_config_desc_fs},
+    {"BG96 HS", bg96_device_desc_fs_hs, bg96_config_desc_hs},
+    {"SIM7000E FS", sim7000e_device_desc_fs_hs, sim7000e_config_desc_fs},
+    {"SIM7000E HS", sim7000e_device_desc_fs_hs, sim7000e_config_desc_hs},
+    {"SIM7600E FS", sim7600e_device_desc_fs_hs, sim7600e_config_desc_fs},
+    {"SIM7600E HS", sim7600e_device_desc_fs_hs, sim7600e_config_desc_hs},
+    {"SIM7080G FS", sim7080g_device_desc_fs_hs, sim7080g_config_desc_fs},
+    {"SIM7080G HS", sim7080g_device_desc_fs_hs, sim7080g_config_desc_hs},
+    {"SIMA7672E FS", sima7672e_device_desc_fs_hs, sima7672e_config_desc_fs},
+    {"SIMA7672E HS", sima7672e_device_desc_fs_hs, sima7672e_config_desc_hs},
+    {"Rapoo", rapoo_device_desc, rapoo_config_desc},
+    {"CSR FS", csr_device_desc_fs_hs, csr_config_desc_fs},
+    {"CSR HS", csr_device_desc_fs_hs, csr_config_desc_hs},
+    {"TinyUSB composite", tusb_composite_device_desc, tusb_composite_config_desc},
+    {"TinyUSB console", tusb_console_device_desc, tusb_console_config_desc},
+    {"TinyUSB HID", tusb_hid_device_desc, tusb_hid_config_desc},
+    {"TinyUSB MIDI", tusb_midi_device_desc, tusb_midi_config_desc},
+    {"TinyUSB MSC", tusb_msc_device_desc, tusb_msc_config_desc},
+    {"TinyUSB NCM", tusb_ncm_device_desc, tusb_ncm_config_desc},
+    {"TinyUSB serial FS", tusb_serial_device_device_desc_fs_hs, tusb_serial_device_config_desc_fs},
+    {"TinyUSB serial HS", tusb_serial_device_device_desc_fs_hs, tusb_serial_device_config_desc_hs},
+    {"TinyUSB dual serial FS", tusb_serial_device_dual_device_desc_fs_hs, tusb_serial_device_dual_config_desc_fs},
+    {"TinyUSB dual serial HS", tusb_serial_device_dual_device_desc_fs_hs, tusb_serial_device_dual_config_desc_hs},
+    {"Cypress RFA", cypress_rfa::dev_desc, cypress_rfa::cfg_desc},
+    {"STM32", stm32_device::dev_desc, stm32_device::cfg_desc},
+};
+
+constexpr int benchmark_iterations = 1000;
+
+/**
+ * @brief List numbers of all interfaces in the configuration
+ *
+ * Interface descriptors are walked instead of trusting bNumInterfaces, which is wrong in some descriptors of the corpus
+ */
+std::vector<uint8_t> list_interfaces(const usb_config_desc_t *cfg)
+{
+    std::vector<uint8_t> intfs;
+    int offset = 0;
+    const usb_standard_desc_t *desc = reinterpret_cast<const usb_standard_desc_t *>(cfg);
+    while ((desc = usb_parse_next_descriptor_of_type(desc, cfg->wTotalLength, USB_B_DESCRIPTOR_TYPE_INTERFACE, &offset))) {
+        const usb_intf_desc_t *intf_desc = reinterpret_cast<const usb_intf_desc_t *>(desc);
+        if (intf_desc->bAlternateSetting == 0) {
+            intfs.push_back(intf_desc->bInterfaceNumber);
+        }
+    }
+    return intfs;
+}
+
+void run_benchmark(const corpus_entry &entry)
+{
+    const usb_device_desc_t *dev = reinterpret_cast<const usb_device_desc_t *>(entry.dev_desc);
+    const usb_config_desc_t *cfg = reinterpret_cast<const usb_config_desc_t *>(entry.cfg_desc);
+    const std::vector<uint8_t> intfs = list_interfaces(cfg);
+
+    size_t usable = 0;
+    test_benchmark_meter meter;
+    meter.start();
+    for (int i = 0; i < benchmark_iterations; i++) {
+        for (uint8_t intf : intfs) {
+            cdc_parsed_info_t parsed_result = {};
+            if (cdc_parse_interface_descriptor(dev, cfg, intf, &parsed_result) == ESP_OK) {
+                usable++;
+            }
+        }
+    }
+    meter.stop();
+
+    REQUIRE(usable % benchmark_iterations == 0); // Parsing result does not depend on previous parsing
+
+    const double seconds = meter.seconds();
+    const size_t parses = intfs.size() * benchmark_iterations;
+    printf("%-22s %4u bytes, %2zu intf (%zu usable): parse %6.0f ns/intf, %.1f alloc (%zu bytes)/intf, %5.2f M parses/s\n",
+           entry.name,
+           cfg->wTotalLength,
+           intfs.size(),
+           usable / benchmark_iterations,
+           seconds * 1e9 / parses,
+           static_cast<double>(meter.allocs) / parses,
+           meter.alloc_bytes / parses,
+           parses / seconds / 1e6);
+}
+
+} // namespace
+
+TEST_CASE("Descriptor parsing benchmark", "[.][benchmark]")
+{
+    for (const corpus_entry &entry : corpus) {
+        run_benchmark(entry);
+    }
+}
@@ -6,6 +6,20 @@
 
 #pragma once
 
+#include "cdc_host_descriptor_parsing.h"
+
+/**
+ * @brief Count CDC specific descriptors in the table of parsing result
+ */
+static inline int cdc_func_table_count(const cdc_func_table_t &func)
+{
+    int count = 0;
+    for (const usb_standard_desc_t *desc : func.desc) {
+        count += (desc != nullptr);
+    }
+    return count;
+}
+
 /**
  * @brief Helper to check parsing result of CDC compliant devices
  *
@@ -21,7 +35,7 @@
     REQUIRE((parsed_result).data_intf != nullptr); \
     REQUIRE((parsed_result).in_ep != nullptr); \
     REQUIRE((parsed_result).out_ep != nullptr); \
-    REQUIRE((parsed_result).func != nullptr); \
+    REQUIRE(cdc_func_table_count((parsed_result).func) > 0); \
     REQUIRE((parsed_result).func_cnt == nb_of_cdc_specific);
 
 /**
@@ -36,7 +50,7 @@
     REQUIRE((parsed_result).data_intf != nullptr); \
     REQUIRE((parsed_result).in_ep != nullptr); \
     REQUIRE((parsed_result).out_ep != nullptr); \
-    REQUIRE((parsed_result).func == nullptr); \
+    REQUIRE(cdc_func_table_count((parsed_result).func) == 0); \
     REQUIRE((parsed_result).func_cnt == 0);
 
 /**
@@ -51,5 +65,5 @@
     REQUIRE((parsed_result).data_intf != nullptr); \
     REQUIRE((parsed_result).in_ep != nullptr); \
     REQUIRE((parsed_result).out_ep != nullptr); \
-    REQUIRE((parsed_result).func == nullptr); \
+    REQUIRE(cdc_func_table_count((parsed_result).func) == 0); \
     REQUIRE((parsed_result).func_cnt == 0);
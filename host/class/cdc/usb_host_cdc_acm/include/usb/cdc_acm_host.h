@@ -11,6 +11,15 @@
 #include "usb/usb_types_cdc.h"
 #include "esp_err.h"
 
+#ifdef __cplusplus
+#include <atomic>
+#include <future>
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define CDC_ACM_HOST_COROUTINES 1 // C++20 coroutines are available, CdcAcmDevice::tx() can be awaited
+#endif
+#endif
+
 // Pass these to cdc_acm_host_open() to signal that you don't care about VID/PID of the opened device
 #define CDC_HOST_ANY_VID (0)
 #define CDC_HOST_ANY_PID (0)
@@ -29,7 +38,10 @@ typedef enum {
     CDC_ACM_HOST_ERROR,
     CDC_ACM_HOST_SERIAL_STATE,
     CDC_ACM_HOST_NETWORK_CONNECTION,
-    CDC_ACM_HOST_DEVICE_DISCONNECTED
+    CDC_ACM_HOST_DEVICE_DISCONNECTED,
+    CDC_ACM_HOST_RX_HIGH_WATERMARK,
+    CDC_ACM_HOST_RX_LOW_WATERMARK,
+    CDC_ACM_HOST_DEVICE_RECONNECTED
 } cdc_acm_host_dev_event_t;
 
 /**
@@ -42,7 +54,8 @@ typedef struct {
         int error;                         //!< Error code from USB Host
         cdc_acm_uart_state_t serial_state; //!< Serial (UART) state
         bool network_connected;            //!< Network connection event
-        cdc_acm_dev_hdl_t cdc_hdl;         //!< Disconnection event
+        cdc_acm_dev_hdl_t cdc_hdl;         //!< Disconnection and reconnection events
+        size_t rx_buffered;                //!< RX watermark events: Number of bytes in RX ring buffer
     } data;
 } cdc_acm_host_dev_event_data_t;
 
@@ -67,6 +80,40 @@ typedef void (*cdc_acm_new_dev_callback_t)(usb_device_handle_t usb_dev);
  */
 typedef bool (*cdc_acm_data_callback_t)(const uint8_t *data, size_t data_len, void *user_arg);
 
+/**
+ * @brief Data transmitted callback type
+ *
+ * Called from USB Host context when asynchronous transmission finished, it must not block.
+ *
+ * @param[in] status   ESP_OK: All data were sent. ESP_ERR_INVALID_RESPONSE: Transfer error or not all data were sent.
+ *                     ESP_ERR_NOT_FOUND: The device was disconnected. ESP_ERR_INVALID_STATE: The transmission was cancelled
+ * @param[in] data_len Number of bytes that were actually sent
+ * @param[in] user_arg User's argument passed to the TX function
+ */
+typedef void (*cdc_acm_tx_callback_t)(esp_err_t status, size_t data_len, void *user_arg);
+
+/**
+ * @brief Framing of received data
+ */
+typedef enum {
+    CDC_ACM_FRAMING_NONE = 0,          /**< No framing, received data are passed to data_cb */
+    CDC_ACM_FRAMING_SLIP,              /**< SLIP, frames delimited by 0xC0 (RFC 1055) */
+    CDC_ACM_FRAMING_HDLC,              /**< HDLC-like framing delimited by 0x7E with 16-bit FCS (RFC 1662). FCS is checked and removed */
+    CDC_ACM_FRAMING_COBS,              /**< COBS, frames delimited by 0x00 */
+    CDC_ACM_FRAMING_LENGTH_PREFIX,     /**< 2-byte big-endian length followed by frame data */
+} cdc_acm_framing_t;
+
+/**
+ * @brief Frame received callback type
+ *
+ * Called from USB Host context for each complete and valid frame. Invalid frames are dropped.
+ *
+ * @param[in] frame     Decoded frame, points into the driver's IN buffer and is valid only during the callback
+ * @param[in] frame_len Length of the decoded frame
+ * @param[in] user_arg  User's argument passed to open function
+ */
+typedef void (*cdc_acm_frame_callback_t)(const uint8_t *frame, size_t frame_len, void *user_arg);
+
 /**
  * @brief Device event callback type
  *
@@ -84,6 +131,8 @@ typedef struct {
     unsigned driver_task_priority;         /**< Priority of the driver's task */
     int  xCoreID;                          /**< Core affinity of the driver's task */
     cdc_acm_new_dev_callback_t new_dev_cb; /**< New USB device connected callback. Can be NULL. */
+    bool shared_client;                    /**< Register to the client of usb_host_shared_client component instead of an own USB Host client.
+                                                Its task handles the events, so the driver's task is not created */
 } cdc_acm_host_driver_config_t;
 
 /**
@@ -97,8 +146,54 @@ typedef struct {
     cdc_acm_host_dev_callback_t event_cb; /**< Device's event callback function. Can be NULL */
     cdc_acm_data_callback_t data_cb;      /**< Device's data RX callback function. Can be NULL for write-only devices */
     void *user_arg;                       /**< User's argument that will be passed to the callbacks */
+    int out_transfers_num;                /**< Number of OUT transfers of out_buffer_size for cdc_acm_host_data_tx_async().
+                                               Set to 0 if asynchronous transmission is not used */
+    int in_transfers_num;                 /**< Number of IN transfers of in_buffer_size queued at once, so reception continues
+                                               while the data callback runs. 0 or 1: Single IN transfer.
+                                               With more transfers, return value of data_cb is ignored (data cannot be appended) */
+    size_t rx_ring_size;                  /**< Size of RX ring buffer for cdc_acm_host_data_rx_read(), at least in_buffer_size.
+                                               Set to 0 to pass received data to data_cb. If set, data_cb must be NULL */
+    size_t rx_high_watermark;             /**< CDC_ACM_HOST_RX_HIGH_WATERMARK event is sent when RX ring buffer holds this many bytes. 0: No watermark events */
+    size_t rx_low_watermark;              /**< CDC_ACM_HOST_RX_LOW_WATERMARK event is sent when RX ring buffer is read down to this many bytes after high watermark */
+    const char *serial_number;            /**< Open only the device with this serial number string (ASCII). NULL: Any serial number */
+    cdc_acm_framing_t framing;            /**< Framing of received data. If set, frames are delivered to frame_cb and data_cb must be NULL.
+                                               Only the incomplete frame is kept in the IN buffer, so the largest encoded frame
+                                               plus one maximum packet must fit in in_buffer_size, regardless of the stream length */
+    cdc_acm_frame_callback_t frame_cb;    /**< Frame received callback, required if framing is used */
+    bool reconnect;                       /**< Keep the device open when it is disconnected. When the same device (VID, PID and serial number)
+                                               is connected again, it is rebound to this handle, CDC_ACM_HOST_DEVICE_RECONNECTED event is sent
+                                               and reception continues. Closing the device on CDC_ACM_HOST_DEVICE_DISCONNECTED event cancels the reconnection */
+    size_t tx_coalesce_size;              /**< Gather data of cdc_acm_host_data_tx_blocking() in transfers of the OUT pool and send them when they reach
+                                               this size, at most out_buffer_size. Multiples of OUT Maximum Packet Size keep packets full.
+                                               Requires out_transfers_num > 0. 0: Each write is sent in its own transfer */
+    uint32_t tx_coalesce_us;              /**< Gathered data are sent at latest this long after the first write to the transfer.
+                                               0: Only when tx_coalesce_size is reached or on cdc_acm_host_tx_flush() */
 } cdc_acm_host_device_config_t;
 
+// Number of buckets in time histograms of cdc_acm_host_stats_t
+#define CDC_ACM_HOST_STATS_HIST_BUCKETS    (8)
+// Size of transfer_errors array of cdc_acm_host_stats_t, indexed by usb_transfer_status_t
+#define CDC_ACM_HOST_STATS_XFER_STATUS_NUM (USB_TRANSFER_STATUS_NO_DEVICE + 1)
+
+/**
+ * @brief CDC-ACM device statistics
+ *
+ * The counters are accumulated since the device was opened or since last cdc_acm_host_reset_stats() call
+ */
+typedef struct {
+    uint64_t bytes_in;                 /**< Number of received bytes */
+    uint64_t bytes_out;                /**< Number of sent bytes */
+    uint32_t transfers_in;             /**< Number of completed bulk IN transfers */
+    uint32_t transfers_out;            /**< Number of completed bulk OUT transfers */
+    uint32_t rx_overflows;             /**< Number of IN buffer overflows, reported by bOverRun in CDC_ACM_HOST_SERIAL_STATE event */
+    uint32_t endpoint_resets;          /**< Number of endpoint resets, done on TX timeout, device closing and bus suspend */
+    uint32_t transfer_errors[CDC_ACM_HOST_STATS_XFER_STATUS_NUM]; /**< Number of not completed bulk transfers, indexed by usb_transfer_status_t */
+    uint32_t tx_wait_histogram[CDC_ACM_HOST_STATS_HIST_BUCKETS];  /**< Histogram of cdc_acm_host_data_tx_blocking() duration.
+                                                                       Bucket 0: < 1 ms, bucket i: <2^(i-1); 2^i) ms, last bucket: >= 64 ms */
+    uint32_t rx_cb_histogram[CDC_ACM_HOST_STATS_HIST_BUCKETS];    /**< Histogram of data received callback duration.
+                                                                       Bucket 0: < 16 us, bucket i: <16 * 2^(i-1); 16 * 2^i) us, last bucket: >= 1024 us */
+} cdc_acm_host_stats_t;
+
 /**
  * @brief Install CDC-ACM driver
  *
@@ -136,6 +231,19 @@ esp_err_t cdc_acm_host_uninstall(void);
  */
 esp_err_t cdc_acm_host_register_new_dev_callback(cdc_acm_new_dev_callback_t new_dev_cb);
 
+/**
+ * @brief Get registered new USB device callback
+ *
+ * Lets a component that temporarily registers its own callback call the previous one and restore it afterwards.
+ *
+ * @param[out] new_dev_cb_ret Registered new device callback, NULL if there is none
+ * @return
+ *   - ESP_OK: Success
+ *   - ESP_ERR_INVALID_ARG: new_dev_cb_ret is NULL
+ *   - ESP_ERR_INVALID_STATE: The CDC driver is not installed
+ */
+esp_err_t cdc_acm_host_get_new_dev_callback(cdc_acm_new_dev_callback_t *new_dev_cb_ret);
+
 /**
  * @brief Open CDC-ACM device
  *
@@ -143,6 +251,7 @@ esp_err_t cdc_acm_host_register_new_dev_callback(cdc_acm_new_dev_callback_t new_
  *
  * Use CDC_HOST_ANY_* macros to signal that you don't care about the device's VID and PID. In this case, first USB device will be opened.
  * It is recommended to use this feature if only one device can ever be in the system (there is no USB HUB connected).
+ * To select one of several devices with the same VID and PID, set serial_number in dev_config.
  *
  * @param[in] vid           Device's Vendor ID, set to CDC_HOST_ANY_VID for any
  * @param[in] pid           Device's Product ID, set to CDC_HOST_ANY_PID for any
@@ -178,6 +287,9 @@ esp_err_t cdc_acm_host_close(cdc_acm_dev_hdl_t cdc_hdl);
 /**
  * @brief Transmit data - blocking mode
  *
+ * If the device was opened with tx_coalesce_size, the data are appended to the data of previous calls and this function returns
+ * without waiting for the transmission. Errors of the transmission are returned by cdc_acm_host_tx_flush().
+ *
  * @param cdc_hdl CDC handle obtained from cdc_acm_host_open()
  * @param[in] data       Data to be sent
  * @param[in] data_len   Data length
@@ -186,6 +298,142 @@ esp_err_t cdc_acm_host_close(cdc_acm_dev_hdl_t cdc_hdl);
  */
 esp_err_t cdc_acm_host_data_tx_blocking(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data, size_t data_len, uint32_t timeout_ms);
 
+/**
+ * @brief Transmit data - asynchronous mode
+ *
+ * The data are copied to a free OUT transfer of the device's pool and submitted, this function does not wait for the transmission.
+ * Several transmissions can be in flight, up to out_transfers_num, so back-to-back writes keep the bus busy.
+ * The transmissions are sent in order of this function calls.
+ *
+ * @param cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @param[in] data       Data to be sent
+ * @param[in] data_len   Data length, up to out_buffer_size
+ * @param[in] timeout_ms Timeout in [ms] for waiting for a free OUT transfer
+ * @param[in] tx_cb      Callback called when the transmission finished. Can be NULL
+ * @param[in] user_arg   User's argument passed to tx_cb
+ * @return
+ *   - ESP_OK: Success - data submitted
+ *   - ESP_ERR_INVALID_ARG: Invalid input arguments
+ *   - ESP_ERR_NOT_SUPPORTED: The device was opened without OUT transfers for asynchronous mode
+ *   - ESP_ERR_INVALID_SIZE: data_len is larger than out_buffer_size
+ *   - ESP_ERR_TIMEOUT: No OUT transfer was freed within timeout_ms
+ *   - Else: USB lib error
+ */
+esp_err_t cdc_acm_host_data_tx_async(cdc_acm_dev_hdl_t cdc_hdl, const uint8_t *data, size_t data_len, uint32_t timeout_ms, cdc_acm_tx_callback_t tx_cb, void *user_arg);
+
+/**
+ * @brief Get a free transmit buffer for zero-copy transmission
+ *
+ * The buffer belongs to a transfer from the asynchronous TX pool and is DMA capable.
+ * Fill it in place and send it with cdc_acm_host_tx_buffer_submit().
+ * Every buffer obtained by this function must be submitted, otherwise it is not returned to the pool.
+ *
+ * @param cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @param[in]  timeout_ms   Timeout in [ms] for waiting for a free buffer
+ * @param[out] buf_ret      Transmit buffer
+ * @param[out] buf_size_ret Size of the transmit buffer, at least out_buffer_size. Can be NULL
+ * @return
+ *   - ESP_OK: Success
+ *   - ESP_ERR_INVALID_ARG: Invalid input arguments
+ *   - ESP_ERR_NOT_SUPPORTED: The device was opened without OUT transfers for asynchronous mode
+ *   - ESP_ERR_TIMEOUT: No buffer was freed within timeout_ms
+ */
+esp_err_t cdc_acm_host_tx_buffer_get(cdc_acm_dev_hdl_t cdc_hdl, uint32_t timeout_ms, uint8_t **buf_ret, size_t *buf_size_ret);
+
+/**
+ * @brief Submit transmit buffer obtained from cdc_acm_host_tx_buffer_get()
+ *
+ * The buffer must not be accessed after this call. It is returned to the pool when the transmission finished.
+ *
+ * @param cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @param[in] buf      Transmit buffer
+ * @param[in] data_len Number of bytes in the buffer to send. 0: The buffer is returned to the pool without transmission
+ * @param[in] tx_cb    Callback called when the transmission finished. Can be NULL
+ * @param[in] user_arg User's argument passed to tx_cb
+ * @return
+ *   - ESP_OK: Success - data submitted
+ *   - ESP_ERR_INVALID_ARG: Invalid input arguments or buf does not belong to this device
+ *   - ESP_ERR_INVALID_STATE: The buffer was not obtained by cdc_acm_host_tx_buffer_get()
+ *   - ESP_ERR_INVALID_SIZE: data_len is larger than the buffer size
+ *   - Else: USB lib error
+ */
+esp_err_t cdc_acm_host_tx_buffer_submit(cdc_acm_dev_hdl_t cdc_hdl, uint8_t *buf, size_t data_len, cdc_acm_tx_callback_t tx_cb, void *user_arg);
+
+/**
+ * @brief Send data gathered by TX coalescing and wait for the transmissions
+ *
+ * Data of cdc_acm_host_data_tx_async() and cdc_acm_host_tx_buffer_submit() are not ordered with the gathered data,
+ * flush the gathered data before using them. Gathered data that were not flushed are dropped by cdc_acm_host_close().
+ *
+ * @param cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @param[in] timeout_ms Timeout in [ms]
+ * @return
+ *   - ESP_OK: Success - all gathered data were sent
+ *   - ESP_ERR_INVALID_ARG: Invalid input arguments
+ *   - ESP_ERR_NOT_SUPPORTED: The device was opened without tx_coalesce_size
+ *   - ESP_ERR_TIMEOUT: The transmissions did not finish within timeout_ms
+ *   - ESP_ERR_INVALID_RESPONSE, ESP_ERR_NOT_FOUND or ESP_ERR_INVALID_STATE: A transmission of gathered data since the last flush failed, see cdc_acm_tx_callback_t
+ *   - Else: USB lib error
+ */
+esp_err_t cdc_acm_host_tx_flush(cdc_acm_dev_hdl_t cdc_hdl, uint32_t timeout_ms);
+
+/**
+ * @brief Cancel asynchronous transmissions in flight
+ *
+ * Transmissions of cdc_acm_host_data_tx_async() and cdc_acm_host_tx_buffer_submit() are cancelled
+ * and their TX done callbacks are called with error status. The function does not wait for the callbacks.
+ *
+ * @param cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @return
+ *   - ESP_OK: Success - no transmission is in flight or all were cancelled
+ *   - ESP_ERR_INVALID_ARG: Invalid input arguments
+ *   - ESP_ERR_NOT_SUPPORTED: The device was opened without OUT transfers for asynchronous mode
+ *   - Else: USB lib error
+ */
+esp_err_t cdc_acm_host_tx_cancel(cdc_acm_dev_hdl_t cdc_hdl);
+
+/**
+ * @brief Read received data from RX ring buffer
+ *
+ * Blocks until at least one byte is received or timeout. If the RX ring buffer was full, the reception is resumed.
+ * CDC_ACM_HOST_RX_LOW_WATERMARK event is sent from this function's context.
+ *
+ * @param cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @param[out] data       Buffer for received data
+ * @param[in]  data_len   Size of the buffer
+ * @param[out] read_len   Number of bytes read
+ * @param[in]  timeout_ms Timeout in [ms] for waiting for data
+ * @return
+ *   - ESP_OK: Success
+ *   - ESP_ERR_INVALID_ARG: Invalid input arguments
+ *   - ESP_ERR_NOT_SUPPORTED: The device was opened without RX ring buffer
+ *   - ESP_ERR_TIMEOUT: No data were received within timeout_ms
+ */
+esp_err_t cdc_acm_host_data_rx_read(cdc_acm_dev_hdl_t cdc_hdl, uint8_t *data, size_t data_len, size_t *read_len, uint32_t timeout_ms);
+
+/**
+ * @brief Get statistics of CDC device
+ *
+ * Can be called from any task, also while transferring data.
+ *
+ * @param cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @param[out] stats_ret Device statistics
+ * @return
+ *   - ESP_OK: Success
+ *   - ESP_ERR_INVALID_ARG: cdc_hdl or stats_ret is NULL
+ */
+esp_err_t cdc_acm_host_get_stats(cdc_acm_dev_hdl_t cdc_hdl, cdc_acm_host_stats_t *stats_ret);
+
+/**
+ * @brief Reset statistics of CDC device
+ *
+ * @param cdc_hdl CDC handle obtained from cdc_acm_host_open()
+ * @return
+ *   - ESP_OK: Success
+ *   - ESP_ERR_INVALID_ARG: cdc_hdl is NULL
+ */
+esp_err_t cdc_acm_host_reset_stats(cdc_acm_dev_hdl_t cdc_hdl);
+
 /**
  * @brief SetLineCoding function
  *
@@ -304,6 +552,126 @@ public:
         return cdc_acm_host_data_tx_blocking(this->cdc_hdl, data, len, timeout_ms);
     }
 
+    inline esp_err_t tx_async(const uint8_t *data, size_t len, cdc_acm_tx_callback_t tx_cb, void *user_arg, uint32_t timeout_ms = 100)
+    {
+        return cdc_acm_host_data_tx_async(this->cdc_hdl, data, len, timeout_ms, tx_cb, user_arg);
+    }
+
+    /**
+     * @brief Send data asynchronously and get the result from a future
+     *
+     * The data are copied to an OUT transfer, so the buffer can be reused immediately.
+     * The device must be opened with out_transfers_num > 0.
+     *
+     * @return Future with ESP_OK when all data were sent, or with error of the submission or transmission
+     */
+    inline std::future<esp_err_t> tx_async(const uint8_t *data, size_t len, uint32_t timeout_ms = 100)
+    {
+        std::promise<esp_err_t> *promise = new std::promise<esp_err_t>();
+        std::future<esp_err_t> future = promise->get_future();
+        const esp_err_t err = this->tx_async(data, len, tx_promise_cb, promise, timeout_ms);
+        if (err != ESP_OK) {
+            promise->set_value(err);
+            delete promise;
+        }
+        return future;
+    }
+
+#ifdef CDC_ACM_HOST_COROUTINES
+    /**
+     * @brief Awaitable asynchronous transmission
+     *
+     * The coroutine is suspended until the transmission finishes, it is resumed from USB Host context.
+     * One task can so serve many devices, but the resumed coroutine must not block.
+     */
+    class TxAwaiter {
+    public:
+        TxAwaiter(CdcAcmDevice &dev, const uint8_t *data, size_t len, uint32_t timeout_ms)
+            : dev(dev), data(data), len(len), timeout_ms(timeout_ms), status(ESP_OK), completed(false) {}
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            this->handle = handle;
+            // resume_cb() can set the status before tx_async() returns, so the status is written here only on failure
+            const esp_err_t ret = this->dev.tx_async(this->data, this->len, resume_cb, this, this->timeout_ms);
+            if (ret != ESP_OK) {
+                this->status = ret;
+                return false; // Submission failed, continue immediately
+            }
+            // The transmission could have finished already, then the coroutine continues without suspension
+            return !this->completed.exchange(true);
+        }
+
+        esp_err_t await_resume() const noexcept
+        {
+            return this->status;
+        }
+
+    private:
+        static void resume_cb(esp_err_t status, size_t /* data_len */, void *user_arg)
+        {
+            TxAwaiter *self = static_cast<TxAwaiter *>(user_arg);
+            self->status = status;
+            if (self->completed.exchange(true)) {
+                self->handle.resume(); // The coroutine is suspended
+            }
+        }
+
+        CdcAcmDevice &dev;
+        const uint8_t *data;
+        size_t len;
+        uint32_t timeout_ms;
+        esp_err_t status;
+        std::atomic<bool> completed; // Set by the first of await_suspend() and resume_cb(), the second one resumes
+        std::coroutine_handle<> handle;
+    };
+
+    /**
+     * @brief Send data asynchronously in a coroutine: esp_err_t err = co_await dev.tx(data, len);
+     *
+     * The device must be opened with out_transfers_num > 0.
+     */
+    inline TxAwaiter tx(const uint8_t *data, size_t len, uint32_t timeout_ms = 100)
+    {
+        return TxAwaiter(*this, data, len, timeout_ms);
+    }
+#endif
+
+    inline esp_err_t tx_buffer_get(uint8_t **buf, size_t *buf_size, uint32_t timeout_ms = 100)
+    {
+        return cdc_acm_host_tx_buffer_get(this->cdc_hdl, timeout_ms, buf, buf_size);
+    }
+
+    inline esp_err_t tx_buffer_submit(uint8_t *buf, size_t len, cdc_acm_tx_callback_t tx_cb = NULL, void *user_arg = NULL)
+    {
+        return cdc_acm_host_tx_buffer_submit(this->cdc_hdl, buf, len, tx_cb, user_arg);
+    }
+
+    inline esp_err_t tx_flush(uint32_t timeout_ms = 100)
+    {
+        return cdc_acm_host_tx_flush(this->cdc_hdl, timeout_ms);
+    }
+
+    inline esp_err_t rx_read(uint8_t *data, size_t len, size_t *read_len, uint32_t timeout_ms = 100)
+    {
+        return cdc_acm_host_data_rx_read(this->cdc_hdl, data, len, read_len, timeout_ms);
+    }
+
+    inline esp_err_t get_stats(cdc_acm_host_stats_t *stats)
+    {
+        return cdc_acm_host_get_stats(this->cdc_hdl, stats);
+    }
+
+    inline esp_err_t reset_stats()
+    {
+        return cdc_acm_host_reset_stats(this->cdc_hdl);
+    }
+
     inline esp_err_t open(uint16_t vid, uint16_t pid, uint8_t interface_idx, const cdc_acm_host_device_config_t *dev_config)
     {
         return cdc_acm_host_open(vid, pid, interface_idx, dev_config, &this->cdc_hdl);
@@ -349,6 +717,13 @@ public:
     }
 
 private:
+    static void tx_promise_cb(esp_err_t status, size_t /* data_len */, void *user_arg)
+    {
+        std::promise<esp_err_t> *promise = static_cast<std::promise<esp_err_t> *>(user_arg);
+        promise->set_value(status);
+        delete promise;
+    }
+
     CdcAcmDevice &operator= (const CdcAcmDevice &Copy);
     bool operator== (const CdcAcmDevice &param) const;
     bool operator!= (const CdcAcmDevice &param) const;
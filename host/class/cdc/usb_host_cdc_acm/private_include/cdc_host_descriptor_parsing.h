@@ -8,8 +8,16 @@
 #include <stdint.h>
 #include "esp_err.h"
 #include "usb/usb_types_ch9.h"
+#include "usb/usb_types_cdc.h"
 
-typedef const usb_standard_desc_t *cdc_func_array_t[]; // Array of pointers to const usb_standard_desc_t
+/**
+ * @brief CDC Functional descriptors of an interface, indexed by bDescriptorSubtype
+ *
+ * Only the first descriptor of each subtype is kept. Entries point into the Configuration descriptor, NULL if not present.
+ */
+typedef struct {
+    const usb_standard_desc_t *desc[USB_CDC_DESC_SUBTYPE_MAX];
+} cdc_func_table_t;
 
 typedef struct {
     const usb_ep_desc_t *notif_ep;
@@ -17,8 +25,8 @@ typedef struct {
     const usb_ep_desc_t *out_ep;
     const usb_intf_desc_t *notif_intf;
     const usb_intf_desc_t *data_intf;
-    cdc_func_array_t *func;
-    int func_cnt;
+    cdc_func_table_t func;
+    int func_cnt;                 // Number of CDC Functional descriptors found, including subtypes that are not in func table
 } cdc_parsed_info_t;
 
 #ifdef __cplusplus
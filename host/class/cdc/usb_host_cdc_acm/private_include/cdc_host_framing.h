@@ -0,0 +1,83 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "usb/cdc_acm_host.h" // For framing types
+
+typedef struct {
+    cdc_acm_framing_t type;            // Framing of received data
+    cdc_acm_frame_callback_t cb;       // Frame received callback
+    void *cb_arg;                      // Argument of the frame received callback
+    uint8_t *frame_start;              // Start of incomplete frame in IN buffer, NULL if there is no incomplete frame
+} cdc_framer_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize framer
+ *
+ * @param[out] framer Framer to initialize
+ * @param[in]  type   Framing of received data
+ * @param[in]  cb     Frame received callback
+ * @param[in]  cb_arg Argument of the frame received callback
+ */
+void cdc_framer_init(cdc_framer_t *framer, cdc_acm_framing_t type, cdc_acm_frame_callback_t cb, void *cb_arg);
+
+/**
+ * @brief Drop incomplete frame
+ *
+ * Must be called when the IN buffer was reset while a frame was incomplete
+ *
+ * @param[in] framer Framer
+ */
+void cdc_framer_reset(cdc_framer_t *framer);
+
+/**
+ * @brief Find and deliver frames in received data
+ *
+ * The frames are decoded in place, so the frame callback gets pointer into the IN buffer.
+ * If the data end with an incomplete frame, it is moved to the start of the IN buffer by cdc_framer_move_incomplete()
+ * and the next data must be appended behind it (receive buffer append).
+ *
+ * @param[in] framer   Framer
+ * @param[in] data     Received data. If previous call returned false, the data must directly follow the incomplete frame
+ * @param[in] data_len Length of received data
+ * @return true  All data were processed, the IN buffer can be reset
+ * @return false The data end with an incomplete frame, the next data must be appended
+ */
+bool cdc_framer_process(cdc_framer_t *framer, uint8_t *data, size_t data_len);
+
+/**
+ * @brief Move incomplete frame to the start of the IN buffer
+ *
+ * Frames that were delivered are dropped from the IN buffer, so a continuous stream of frames does not overflow it.
+ *
+ * @param[in] framer   Framer
+ * @param[in] buf      Start of the IN buffer
+ * @param[in] data_end End of the data passed to the last cdc_framer_process() call
+ * @return Length of the incomplete frame, the next data must be appended at buf + returned length
+ */
+size_t cdc_framer_move_incomplete(cdc_framer_t *framer, uint8_t *buf, const uint8_t *data_end);
+
+/**
+ * @brief Calculate 16-bit Frame Check Sequence of HDLC frame
+ *
+ * @see RFC 1662, Appendix C.2
+ * @param[in] fcs  Initial FCS value, 0xFFFF for new frame
+ * @param[in] data Data
+ * @param[in] len  Length of data
+ * @return Updated FCS value. FCS of frame that includes its (complemented, little-endian) FCS equals 0xF0B8
+ */
+uint16_t cdc_framer_fcs16(uint16_t fcs, const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
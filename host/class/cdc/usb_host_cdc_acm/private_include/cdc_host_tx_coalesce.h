@@ -0,0 +1,97 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_timer.h"
+#endif
+#include "usb/cdc_acm_host.h" // For CDC-ACM handle and TX buffer functions
+
+typedef struct {
+    cdc_acm_dev_hdl_t cdc_hdl;         // Device whose OUT transfer pool is used
+    size_t size;                       // Buffered data are sent when they reach this size. 0: Coalescing is not used
+    uint32_t hold_us;                  // Buffered data are sent at latest this long after the first write. 0: No deadline
+    uint8_t *buf;                      // TX buffer being filled, NULL if no data are buffered or a writer is appending to it
+    size_t buf_size;                   // Size of TX buffers of the pool
+    size_t len;                        // Number of bytes in buf
+    int64_t deadline_us;               // Time by which the data in buf must be sent
+    uint32_t in_flight;                // Number of submitted transmissions that did not finish yet
+    bool flush_waiting;                // A flush waits for in_flight to drop to 0
+    esp_err_t error;                   // First transmission error since the last flush
+    SemaphoreHandle_t flushed;         // Given when in_flight drops to 0 while a flush waits
+#if !CONFIG_IDF_TARGET_LINUX
+    esp_timer_handle_t timer;          // Deadline timer, NULL if hold_us is 0
+#endif
+} cdc_tx_coalescer_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize TX coalescer
+ *
+ * @param[out] coalescer Coalescer to initialize
+ * @param[in]  cdc_hdl   CDC device, opened with OUT transfer pool
+ * @param[in]  size      Buffered data are sent when they reach this size, at most the size of TX buffers
+ * @param[in]  hold_us   Buffered data are sent at latest this long after the first write. 0: No deadline
+ * @return
+ *   - ESP_OK: Success
+ *   - ESP_ERR_NO_MEM: Not enough memory for semaphore or timer
+ */
+esp_err_t cdc_tx_coalescer_init(cdc_tx_coalescer_t *coalescer, cdc_acm_dev_hdl_t cdc_hdl, size_t size, uint32_t hold_us);
+
+/**
+ * @brief Free resources of TX coalescer
+ *
+ * Buffered data are dropped. Can be called for zero-initialized coalescer.
+ *
+ * @param[in] coalescer Coalescer
+ */
+void cdc_tx_coalescer_deinit(cdc_tx_coalescer_t *coalescer);
+
+/**
+ * @brief Append data to buffered data
+ *
+ * The buffer is sent if the data reached the size threshold or its deadline passed. If the data do not fit in the buffer,
+ * the buffer is sent first and the data are written to a new one.
+ *
+ * @note Writers and flushes must be serialized by the caller
+ * @param[in] coalescer  Coalescer
+ * @param[in] data       Data to be sent
+ * @param[in] data_len   Data length, at most the size of TX buffers
+ * @param[in] timeout_ms Timeout in [ms] for waiting for a free TX buffer
+ * @return
+ *   - ESP_OK: Data were buffered or submitted
+ *   - ESP_ERR_TIMEOUT: No TX buffer was freed within timeout_ms
+ *   - Else: USB lib error, the buffered data were dropped
+ */
+esp_err_t cdc_tx_coalescer_write(cdc_tx_coalescer_t *coalescer, const uint8_t *data, size_t data_len, uint32_t timeout_ms);
+
+/**
+ * @brief Send buffered data and wait until all coalesced transmissions finished
+ *
+ * @note Writers and flushes must be serialized by the caller
+ * @param[in] coalescer  Coalescer
+ * @param[in] timeout_ms Timeout in [ms]
+ * @return
+ *   - ESP_OK: All data were sent
+ *   - ESP_ERR_TIMEOUT: Transmissions did not finish within timeout_ms
+ *   - ESP_ERR_INVALID_RESPONSE, ESP_ERR_NOT_FOUND or ESP_ERR_INVALID_STATE: A transmission since the last flush failed
+ *   - Else: USB lib error, the buffered data were dropped
+ */
+esp_err_t cdc_tx_coalescer_flush(cdc_tx_coalescer_t *coalescer, uint32_t timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -7,16 +7,31 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <sys/queue.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "freertos/ringbuf.h"
 
 #include "usb/usb_host.h"      // For USB device handle and transfers
 #include "usb/cdc_acm_host.h"  // For callback types
 #include "usb/usb_types_cdc.h" // For protocol and serial state
+#include "cdc_host_framing.h"  // For framer of received data
+#include "cdc_host_tx_coalesce.h" // For coalescing of small writes
+#include "cdc_host_descriptor_parsing.h" // For table of functional descriptors
 
 typedef struct cdc_dev_s cdc_dev_t;
+
+// Context of OUT transfer from the asynchronous TX pool
+typedef struct {
+    cdc_dev_t *cdc_dev;                   // CDC device that owns this transfer
+    cdc_acm_tx_callback_t cb;             // User's callback of the transmission in flight. Can be NULL
+    void *cb_arg;                         // Argument of the user's callback
+    bool claimed;                         // Buffer of this transfer was given to the user by cdc_acm_host_tx_buffer_get()
+} cdc_tx_xfer_ctx_t;
+
 struct cdc_dev_s {
     usb_device_handle_t dev_hdl;          // USB device handle
     void *cb_arg;                         // Common argument for user's callbacks (data IN and Notification)
@@ -26,8 +41,25 @@ struct cdc_dev_s {
         cdc_acm_data_callback_t in_cb;    // User's callback for async (non-blocking) data IN
         uint16_t in_mps;                  // IN endpoint Maximum Packet Size
         uint8_t *in_data_buffer_base;     // Pointer to IN data buffer in usb_transfer_t
+        size_t in_data_len;               // Length of received data that were not processed by the user and are kept in the IN buffer
+        usb_transfer_t **in_ring;         // IN transfers queued behind in_xfer, NULL if only in_xfer is used
+        int in_ring_num;                  // Number of allocated transfers in in_ring
+        int in_ring_alloc_num;            // Number of entries allocated in in_ring
+        RingbufHandle_t rx_ring;          // RX ring buffer for cdc_acm_host_data_rx_read(), NULL if not used
+        size_t rx_ring_size;              // Size of rx_ring in bytes
+        size_t rx_high_watermark;         // RX ring buffer level for CDC_ACM_HOST_RX_HIGH_WATERMARK event, 0 if not used
+        size_t rx_low_watermark;          // RX ring buffer level for CDC_ACM_HOST_RX_LOW_WATERMARK event
+        bool rx_above_watermark;          // High watermark was reported, low watermark was not reported yet
+        bool rx_paused;                   // IN transfer is not submitted because RX ring buffer is full
+        cdc_framer_t framer;              // Framer of received data, framer.cb is NULL if framing is not used
         const usb_intf_desc_t *intf_desc; // Pointer to data interface descriptor
         SemaphoreHandle_t out_mux;        // OUT mutex
+        usb_transfer_t **out_pool;        // Pool of OUT transfers for asynchronous TX, NULL if not used
+        cdc_tx_xfer_ctx_t *out_pool_ctx;  // Contexts of the OUT pool transfers
+        int out_pool_num;                 // Number of allocated OUT pool transfers
+        int out_pool_alloc_num;           // Number of entries allocated in out_pool and out_pool_ctx
+        QueueHandle_t out_pool_free;      // Queue of free OUT pool transfers
+        cdc_tx_coalescer_t tx_coalescer;  // Coalescer of small writes, tx_coalescer.size is 0 if coalescing is not used
     } data;
 
     struct {
@@ -36,12 +68,20 @@ struct cdc_dev_s {
         cdc_acm_host_dev_callback_t cb;   // User's callback for device events
     } notif;                              // Structure with Notif pipe data
 
-    usb_transfer_t *ctrl_transfer;        // CTRL (endpoint 0) transfer
-    SemaphoreHandle_t ctrl_mux;           // CTRL mutex
+    usb_transfer_t *ctrl_transfer;        // CTRL (endpoint 0) transfer, shared by all CDC devices of the USB device
+    SemaphoreHandle_t ctrl_mux;           // CTRL mutex, shared together with ctrl_transfer
     cdc_acm_uart_state_t serial_state;    // Serial State
     cdc_comm_protocol_t comm_protocol;
     cdc_data_protocol_t data_protocol;
-    int cdc_func_desc_cnt;                // Number of CDC Functional descriptors in following array
-    const usb_standard_desc_t *(*cdc_func_desc)[]; // Pointer to array of pointers to const usb_standard_desc_t
+    cdc_func_table_t cdc_func;            // CDC Functional descriptors by subtype, parsed at open
+    cdc_acm_host_stats_t stats;           // Statistics, protected by CDC-ACM critical section
+    bool suspended;                       // IN polling is stopped by bus suspend and TX is refused until resume. Protected by CDC-ACM critical section
+    struct {
+        bool enabled;                     // Keep this device in standby when the USB device is disconnected
+        uint16_t vid;                     // VID of the USB device
+        uint16_t pid;                     // PID of the USB device
+        char *serial;                     // Serial number of the USB device (ASCII), NULL if it has no serial number
+        uint8_t interface_idx;            // Index of the CDC interface
+    } reconnect;                          // Identification of the USB device for reconnection. dev_hdl is NULL in standby
     SLIST_ENTRY(cdc_dev_s) list_entry;
 };
@@ -0,0 +1,187 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "soc/soc_caps.h"
+#if SOC_USB_OTG_SUPPORTED
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "usb/cdc_acm_host.h"
+
+/*
+ * Loopback benchmark against the TinyUSB echo device of mock_device_app (or any device that sends back received data).
+ * Each configuration is measured in two phases:
+ * - Throughput: Data are written back-to-back for BENCHMARK_PHASE_MS. TX is the sent data, RX the echoed data.
+ *   The echo device drops data it cannot send back, so RX can be lower than TX.
+ * - Latency: Each chunk is written after the echo of the previous one, the round trip time of each chunk is a sample.
+ */
+
+#define BENCHMARK_PHASE_MS        (2000)
+#define BENCHMARK_LATENCY_SAMPLES (500)
+#define BENCHMARK_TIMEOUT_MS      (1000)
+#define BENCHMARK_OUT_TRANSFERS   (4)
+#define BENCHMARK_IN_TRANSFERS    (4)
+#define RESULT_PREFIX             "cdc_benchmark_result: " // Parsed by pytest_usb_host_cdc.py
+
+typedef enum {
+    TX_BLOCKING,   // cdc_acm_host_data_tx_blocking()
+    TX_ASYNC,      // cdc_acm_host_data_tx_async() with BENCHMARK_OUT_TRANSFERS in flight
+} tx_mode_t;
+
+typedef struct {
+    const char *name;
+    tx_mode_t tx_mode;
+    int in_transfers_num;
+    size_t write_size;      // Size of each write
+    size_t buffer_size;     // Size of IN and OUT transfers
+} benchmark_config_t;
+
+static const benchmark_config_t benchmark_configs[] = {
+    { "blocking",       TX_BLOCKING, 0, 64,   64   },
+    { "blocking",       TX_BLOCKING, 0, 64,   512  },
+    { "blocking",       TX_BLOCKING, 0, 512,  512  },
+    { "blocking",       TX_BLOCKING, 0, 512,  2048 },
+    { "blocking",       TX_BLOCKING, 0, 2048, 2048 },
+    { "async",          TX_ASYNC,    0, 64,   64   },
+    { "async",          TX_ASYNC,    0, 64,   512  },
+    { "async",          TX_ASYNC,    0, 512,  512  },
+    { "async",          TX_ASYNC,    0, 512,  2048 },
+    { "async",          TX_ASYNC,    0, 2048, 2048 },
+    { "async_multi_rx", TX_ASYNC,    BENCHMARK_IN_TRANSFERS, 64,   64   },
+    { "async_multi_rx", TX_ASYNC,    BENCHMARK_IN_TRANSFERS, 64,   512  },
+    { "async_multi_rx", TX_ASYNC,    BENCHMARK_IN_TRANSFERS, 512,  512  },
+    { "async_multi_rx", TX_ASYNC,    BENCHMARK_IN_TRANSFERS, 512,  2048 },
+    { "async_multi_rx", TX_ASYNC,    BENCHMARK_IN_TRANSFERS, 2048, 2048 },
+};
+
+static struct {
+    volatile size_t rx_len;     // Received bytes of the current latency chunk
+    volatile size_t echo_len;   // Size of the current latency chunk, 0: Throughput phase
+    SemaphoreHandle_t echoed;   // Given when the whole latency chunk was received
+    uint32_t rtt_us[BENCHMARK_LATENCY_SAMPLES];
+} bench;
+
+void test_install_cdc_driver(void); // Defined in test_cdc_acm_host.c
+
+static bool benchmark_rx_cb(const uint8_t *data, size_t data_len, void *arg)
+{
+    if (bench.echo_len) {
+        bench.rx_len += data_len;
+        if (bench.rx_len >= bench.echo_len) {
+            bench.echo_len = 0;
+            xSemaphoreGive(bench.echoed);
+        }
+    }
+    return true;
+}
+
+static esp_err_t benchmark_write(cdc_acm_dev_hdl_t cdc_dev, const benchmark_config_t *config, const uint8_t *data)
+{
+    if (config->tx_mode == TX_ASYNC) {
+        return cdc_acm_host_data_tx_async(cdc_dev, data, config->write_size, BENCHMARK_TIMEOUT_MS, NULL, NULL);
+    }
+    return cdc_acm_host_data_tx_blocking(cdc_dev, data, config->write_size, BENCHMARK_TIMEOUT_MS);
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    const uint32_t x = *(const uint32_t *)a;
+    const uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void benchmark_run(const benchmark_config_t *config)
+{
+    static uint8_t chunk[2048];
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(chunk), config->write_size);
+    for (size_t i = 0; i < config->write_size; i++) {
+        chunk[i] = i;
+    }
+
+    cdc_acm_dev_hdl_t cdc_dev = NULL;
+    const cdc_acm_host_device_config_t dev_config = {
+        .connection_timeout_ms = 500,
+        .out_buffer_size = config->buffer_size,
+        .in_buffer_size = config->buffer_size,
+        .data_cb = benchmark_rx_cb,
+        .out_transfers_num = (config->tx_mode == TX_ASYNC) ? BENCHMARK_OUT_TRANSFERS : 0,
+        .in_transfers_num = config->in_transfers_num,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_open(0x303A, 0x4002, 0, &dev_config, &cdc_dev)); // 0x303A:0x4002 (TinyUSB Dual CDC device)
+    vTaskDelay(10);
+
+    // Throughput
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_reset_stats(cdc_dev));
+    const int64_t start_us = esp_timer_get_time();
+    const int64_t end_us = start_us + BENCHMARK_PHASE_MS * 1000LL;
+    while (esp_timer_get_time() < end_us) {
+        TEST_ASSERT_EQUAL(ESP_OK, benchmark_write(cdc_dev, config, chunk));
+    }
+    cdc_acm_host_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_get_stats(cdc_dev, &stats));
+    const double seconds = (esp_timer_get_time() - start_us) / 1e6;
+    const double tx_mbps = stats.bytes_out / seconds / 1e6;
+    const double rx_mbps = stats.bytes_in / seconds / 1e6;
+    vTaskDelay(pdMS_TO_TICKS(100)); // Let the echo of the written data drain, so it does not count in the latency phase
+
+    // Latency
+    size_t samples = 0;
+    for (int i = 0; i < BENCHMARK_LATENCY_SAMPLES; i++) {
+        xSemaphoreTake(bench.echoed, 0); // Drop a give of a chunk that timed out
+        bench.rx_len = 0;
+        bench.echo_len = config->write_size;
+        const int64_t chunk_start_us = esp_timer_get_time();
+        if (benchmark_write(cdc_dev, config, chunk) != ESP_OK ||
+                xSemaphoreTake(bench.echoed, pdMS_TO_TICKS(BENCHMARK_TIMEOUT_MS)) != pdTRUE) {
+            bench.echo_len = 0;
+            printf("CDC-ACM loopback timeout\n");
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+        bench.rtt_us[samples++] = esp_timer_get_time() - chunk_start_us;
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_close(cdc_dev));
+    TEST_ASSERT_GREATER_THAN_MESSAGE(0, samples, "No chunk was echoed");
+
+    qsort(bench.rtt_us, samples, sizeof(bench.rtt_us[0]), compare_u32);
+    const uint32_t p50_us = bench.rtt_us[samples / 2];
+    const uint32_t p99_us = bench.rtt_us[samples * 99 / 100];
+
+    printf("| %-14s | %4u | %4u | %8.3f | %8.3f | %8" PRIu32 " | %8" PRIu32 " |\n",
+           config->name, (unsigned)config->write_size, (unsigned)config->buffer_size, tx_mbps, rx_mbps, p50_us, p99_us);
+    printf(RESULT_PREFIX "{\"mode\": \"%s\", \"write_size\": %u, \"buffer_size\": %u, \"tx_mbps\": %.3f, \"rx_mbps\": %.3f, "
+           "\"rtt_p50_us\": %" PRIu32 ", \"rtt_p99_us\": %" PRIu32 ", \"lost\": %u}\n",
+           config->name, (unsigned)config->write_size, (unsigned)config->buffer_size, tx_mbps, rx_mbps, p50_us, p99_us,
+           (unsigned)(BENCHMARK_LATENCY_SAMPLES - samples));
+}
+
+/* Loopback throughput and latency of blocking TX, async TX and multi-transfer RX, swept over write and buffer sizes */
+TEST_CASE("loopback_benchmark", "[cdc_acm_benchmark]")
+{
+    bench.echoed = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL(bench.echoed);
+    test_install_cdc_driver();
+
+    printf("Loopback benchmark, %d ms throughput phase, %d latency samples\n", BENCHMARK_PHASE_MS, BENCHMARK_LATENCY_SAMPLES);
+    printf("| Mode           | Size | Buf  | TX MB/s  | RX MB/s  | p50 [us] | p99 [us] |\n");
+    for (size_t i = 0; i < sizeof(benchmark_configs) / sizeof(benchmark_configs[0]); i++) {
+        benchmark_run(&benchmark_configs[i]);
+    }
+
+    // Clean-up
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_uninstall());
+    vSemaphoreDelete(bench.echoed);
+    vTaskDelay(20); // Short delay to allow task to be cleaned up
+}
+
+#endif // SOC_USB_OTG_SUPPORTED
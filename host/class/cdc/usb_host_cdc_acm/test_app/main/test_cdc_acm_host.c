@@ -158,6 +158,14 @@ static bool handle_rx_advanced(const uint8_t *data, size_t data_len, void *arg)
     return *process_data;
 }
 
+static void handle_tx_done(esp_err_t status, size_t data_len, void *arg)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, status);
+    TEST_ASSERT_EQUAL(sizeof(tx_buf), data_len);
+    int *nb_of_tx_done = (int *)arg;
+    (*nb_of_tx_done)++;
+}
+
 static void notif_cb(const cdc_acm_host_dev_event_data_t *event, void *user_ctx)
 {
     switch (event->type) {
@@ -230,6 +238,237 @@ TEST_CASE("read_write", "[cdc_acm]")
     vTaskDelay(20); // Short delay to allow task to be cleaned up
 }
 
+/* Asynchronous TX: several transmissions in flight, each finished with a callback */
+TEST_CASE("tx_async", "[cdc_acm]")
+{
+    nb_of_responses = 0;
+    int nb_of_tx_done = 0;
+    cdc_acm_dev_hdl_t cdc_dev = NULL;
+
+    test_install_cdc_driver();
+
+    const cdc_acm_host_device_config_t dev_config = {
+        .connection_timeout_ms = 500,
+        .out_buffer_size = 64,
+        .event_cb = notif_cb,
+        .data_cb = handle_rx,
+        .user_arg = tx_buf,
+        .out_transfers_num = 3,
+    };
+
+    printf("Opening CDC-ACM device\n");
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_open(0x303A, 0x4002, 0, &dev_config, &cdc_dev)); // 0x303A:0x4002 (TinyUSB Dual CDC device)
+    TEST_ASSERT_NOT_NULL(cdc_dev);
+    vTaskDelay(10);
+
+    // Blocking TX is still available
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_data_tx_blocking(cdc_dev, tx_buf, sizeof(tx_buf), 1000));
+    vTaskDelay(100);
+
+    // Submit more transmissions than the number of OUT transfers, so we must wait for free transfers
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_data_tx_async(cdc_dev, tx_buf, sizeof(tx_buf), 1000, handle_tx_done, &nb_of_tx_done));
+        vTaskDelay(20); // The echo device responds to each transmission separately
+    }
+    vTaskDelay(100); // Wait until transmissions and responses are processed
+    TEST_ASSERT_EQUAL(5, nb_of_tx_done);
+    TEST_ASSERT_EQUAL(6, nb_of_responses);
+
+    // Zero-copy TX: fill the driver's buffer in place
+    uint8_t *buf;
+    size_t buf_size;
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_tx_buffer_get(cdc_dev, 1000, &buf, &buf_size));
+    TEST_ASSERT_GREATER_OR_EQUAL(64, buf_size);
+    memcpy(buf, tx_buf, sizeof(tx_buf));
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_tx_buffer_submit(cdc_dev, buf, sizeof(tx_buf), handle_tx_done, &nb_of_tx_done));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, cdc_acm_host_tx_buffer_submit(cdc_dev, buf, sizeof(tx_buf), NULL, NULL)); // Already submitted
+    vTaskDelay(100);
+    TEST_ASSERT_EQUAL(6, nb_of_tx_done);
+    TEST_ASSERT_EQUAL(7, nb_of_responses);
+
+    // Claimed buffer can be given back without transmission
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_tx_buffer_get(cdc_dev, 1000, &buf, NULL));
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_tx_buffer_submit(cdc_dev, buf, 0, NULL, NULL));
+
+    // Transmission of too much data
+    uint8_t too_long[65] = {0};
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, cdc_acm_host_data_tx_async(cdc_dev, too_long, sizeof(too_long), 1000, NULL, NULL));
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_close(cdc_dev));
+
+    // Asynchronous TX on device opened without OUT transfer pool
+    cdc_acm_host_device_config_t dev_config_sync = dev_config;
+    dev_config_sync.out_transfers_num = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_open(0x303A, 0x4002, 0, &dev_config_sync, &cdc_dev));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, cdc_acm_host_data_tx_async(cdc_dev, tx_buf, sizeof(tx_buf), 1000, NULL, NULL));
+
+    // Clean-up
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_close(cdc_dev));
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_uninstall());
+    vTaskDelay(20); // Short delay to allow task to be cleaned up
+}
+
+/* Ring of IN transfers: reception does not depend on data callback latency */
+TEST_CASE("rx_ring", "[cdc_acm]")
+{
+    nb_of_responses = 0;
+    cdc_acm_dev_hdl_t cdc_dev = NULL;
+
+    test_install_cdc_driver();
+
+    const cdc_acm_host_device_config_t dev_config = {
+        .connection_timeout_ms = 500,
+        .out_buffer_size = 64,
+        .in_buffer_size = 64,
+        .event_cb = notif_cb,
+        .data_cb = handle_rx,
+        .user_arg = tx_buf,
+        .in_transfers_num = 3,
+    };
+
+    printf("Opening CDC-ACM device\n");
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_open(0x303A, 0x4002, 0, &dev_config, &cdc_dev)); // 0x303A:0x4002 (TinyUSB Dual CDC device)
+    TEST_ASSERT_NOT_NULL(cdc_dev);
+    vTaskDelay(10);
+
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_data_tx_blocking(cdc_dev, tx_buf, sizeof(tx_buf), 1000));
+        vTaskDelay(5); // The echo device responds to each transmission separately
+    }
+    vTaskDelay(100); // Wait until responses are processed
+    TEST_ASSERT_EQUAL(10, nb_of_responses);
+
+    // Clean-up: all queued IN transfers are cancelled
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_close(cdc_dev));
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_uninstall());
+    vTaskDelay(20); // Short delay to allow task to be cleaned up
+}
+
+/* Device statistics: transferred data and timing */
+TEST_CASE("stats", "[cdc_acm]")
+{
+    nb_of_responses = 0;
+    cdc_acm_dev_hdl_t cdc_dev = NULL;
+
+    test_install_cdc_driver();
+
+    const cdc_acm_host_device_config_t dev_config = {
+        .connection_timeout_ms = 500,
+        .out_buffer_size = 64,
+        .event_cb = notif_cb,
+        .data_cb = handle_rx,
+        .user_arg = tx_buf,
+    };
+
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_open(0x303A, 0x4002, 0, &dev_config, &cdc_dev)); // 0x303A:0x4002 (TinyUSB Dual CDC device)
+    TEST_ASSERT_NOT_NULL(cdc_dev);
+    vTaskDelay(10);
+
+    const int tx_num = 3;
+    for (int i = 0; i < tx_num; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_data_tx_blocking(cdc_dev, tx_buf, sizeof(tx_buf), 1000));
+        vTaskDelay(10);
+    }
+    vTaskDelay(100); // Wait until responses are processed
+    TEST_ASSERT_EQUAL(tx_num, nb_of_responses);
+
+    cdc_acm_host_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_get_stats(cdc_dev, &stats));
+    TEST_ASSERT_EQUAL(tx_num, stats.transfers_out);
+    TEST_ASSERT_EQUAL(tx_num * sizeof(tx_buf), stats.bytes_out);
+    TEST_ASSERT_EQUAL(tx_num, stats.transfers_in);
+    TEST_ASSERT_EQUAL(tx_num * sizeof(tx_buf), stats.bytes_in);
+    TEST_ASSERT_EQUAL(0, stats.rx_overflows);
+    TEST_ASSERT_EQUAL(0, stats.endpoint_resets);
+    uint32_t tx_waits = 0;
+    uint32_t rx_cbs = 0;
+    for (int i = 0; i < CDC_ACM_HOST_STATS_HIST_BUCKETS; i++) {
+        tx_waits += stats.tx_wait_histogram[i];
+        rx_cbs += stats.rx_cb_histogram[i];
+    }
+    TEST_ASSERT_EQUAL(tx_num, tx_waits);
+    TEST_ASSERT_EQUAL(tx_num, rx_cbs);
+
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_reset_stats(cdc_dev));
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_get_stats(cdc_dev, &stats));
+    TEST_ASSERT_EQUAL(0, stats.transfers_out);
+    TEST_ASSERT_EQUAL(0, stats.bytes_in);
+
+    // Clean-up
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_close(cdc_dev));
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_uninstall());
+    vTaskDelay(20); // Short delay to allow task to be cleaned up
+}
+
+/* TX coalescing: small writes are sent together */
+TEST_CASE("tx_coalesce", "[cdc_acm]")
+{
+    nb_of_responses = 0;
+    cdc_acm_dev_hdl_t cdc_dev = NULL;
+
+    test_install_cdc_driver();
+
+    cdc_acm_host_device_config_t dev_config = {
+        .connection_timeout_ms = 500,
+        .out_buffer_size = 64,
+        .event_cb = notif_cb,
+        .data_cb = handle_rx,
+        .user_arg = tx_buf,
+        .out_transfers_num = 2,
+        .tx_coalesce_size = 4 * sizeof(tx_buf),
+    };
+
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_open(0x303A, 0x4002, 0, &dev_config, &cdc_dev)); // 0x303A:0x4002 (TinyUSB Dual CDC device)
+    TEST_ASSERT_NOT_NULL(cdc_dev);
+    vTaskDelay(10);
+
+    // Data are kept until flush
+    cdc_acm_host_stats_t stats;
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_data_tx_blocking(cdc_dev, tx_buf, sizeof(tx_buf), 1000));
+    }
+    vTaskDelay(50);
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_get_stats(cdc_dev, &stats));
+    TEST_ASSERT_EQUAL(0, stats.transfers_out);
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_tx_flush(cdc_dev, 1000));
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_get_stats(cdc_dev, &stats));
+    TEST_ASSERT_EQUAL(1, stats.transfers_out);
+    TEST_ASSERT_EQUAL(3 * sizeof(tx_buf), stats.bytes_out);
+
+    // Data are sent when they reach the size threshold
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_data_tx_blocking(cdc_dev, tx_buf, sizeof(tx_buf), 1000));
+    }
+    vTaskDelay(50);
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_get_stats(cdc_dev, &stats));
+    TEST_ASSERT_EQUAL(2, stats.transfers_out);
+    TEST_ASSERT_EQUAL(7 * sizeof(tx_buf), stats.bytes_out);
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_tx_flush(cdc_dev, 1000)); // Nothing gathered
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_close(cdc_dev));
+
+    // Data are sent on deadline
+    dev_config.tx_coalesce_us = 10000;
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_open(0x303A, 0x4002, 0, &dev_config, &cdc_dev));
+    vTaskDelay(10);
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_data_tx_blocking(cdc_dev, tx_buf, sizeof(tx_buf), 1000));
+    vTaskDelay(50);
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_get_stats(cdc_dev, &stats));
+    TEST_ASSERT_EQUAL(1, stats.transfers_out);
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_close(cdc_dev));
+
+    // Coalescing needs the OUT transfer pool
+    dev_config.out_transfers_num = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, cdc_acm_host_open(0x303A, 0x4002, 0, &dev_config, &cdc_dev));
+    dev_config.out_transfers_num = 2;
+    dev_config.tx_coalesce_size = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_open(0x303A, 0x4002, 0, &dev_config, &cdc_dev));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, cdc_acm_host_tx_flush(cdc_dev, 1000));
+
+    // Clean-up
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_close(cdc_dev));
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_uninstall());
+    vTaskDelay(20); // Short delay to allow task to be cleaned up
+}
+
 TEST_CASE("cdc_specific_commands", "[cdc_acm]")
 {
     cdc_acm_dev_hdl_t cdc_dev = NULL;
@@ -410,6 +649,67 @@ TEST_CASE("sudden_disconnection", "[cdc_acm]")
     vTaskDelay(20); // Short delay to allow task to be cleaned up
 }
 
+static bool reconnect_handle_rx(const uint8_t *data, size_t data_len, void *arg)
+{
+    nb_of_responses++;
+    TEST_ASSERT_EQUAL_STRING_LEN(data, tx_buf, data_len);
+    return true;
+}
+
+static void reconnect_notif_cb(const cdc_acm_host_dev_event_data_t *event, void *user_ctx)
+{
+    switch (event->type) {
+    case CDC_ACM_HOST_DEVICE_DISCONNECTED:
+        printf("Disconnection event\n");
+        xTaskNotifyGive(user_ctx); // The device is kept open in reconnect mode
+        break;
+    case CDC_ACM_HOST_DEVICE_RECONNECTED:
+        printf("Reconnection event\n");
+        xTaskNotifyGive(user_ctx);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Test that device opened in reconnect mode survives disconnection and continues with the same handle */
+TEST_CASE("reconnect", "[cdc_acm]")
+{
+    nb_of_responses = 0;
+    test_install_cdc_driver();
+
+    cdc_acm_dev_hdl_t cdc_dev;
+    const cdc_acm_host_device_config_t dev_config = {
+        .connection_timeout_ms = 1000,
+        .out_buffer_size = 64,
+        .event_cb = reconnect_notif_cb,
+        .data_cb = reconnect_handle_rx,
+        .user_arg = xTaskGetCurrentTaskHandle(),
+        .reconnect = true,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_open(0x303A, 0x4002, 0, &dev_config, &cdc_dev));
+    TEST_ASSERT_NOT_NULL(cdc_dev);
+
+    force_conn_state(false, pdMS_TO_TICKS(10));                        // Simulate device disconnection
+    TEST_ASSERT_EQUAL(1, ulTaskNotifyTake(false, pdMS_TO_TICKS(100))); // CDC_ACM_HOST_DEVICE_DISCONNECTED
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, cdc_acm_host_data_tx_blocking(cdc_dev, tx_buf, sizeof(tx_buf), 100));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, cdc_acm_host_set_control_line_state(cdc_dev, true, false));
+
+    force_conn_state(true, pdMS_TO_TICKS(50));                          // Connect the device again
+    TEST_ASSERT_EQUAL(1, ulTaskNotifyTake(false, pdMS_TO_TICKS(1000))); // CDC_ACM_HOST_DEVICE_RECONNECTED
+
+    // The device is rebound to the same handle: data are echoed again
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_set_control_line_state(cdc_dev, true, false));
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_data_tx_blocking(cdc_dev, tx_buf, sizeof(tx_buf), 1000));
+    vTaskDelay(100); // Wait until the response is processed
+    TEST_ASSERT_EQUAL(1, nb_of_responses);
+
+    // Clean-up
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_close(cdc_dev));
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_uninstall());
+    vTaskDelay(20); // Short delay to allow task to be cleaned up
+}
+
 /**
  * @brief CDC-ACM error handling test
  *
@@ -451,6 +751,12 @@ TEST_CASE("error_handling", "[cdc_acm]")
     TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, cdc_acm_host_open(0x303A, 0x1234, 0, &dev_config, &cdc_dev)); // 0x303A:0x1234 this device is not connected to USB Host
     TEST_ASSERT_NULL(cdc_dev);
 
+    // Open device with non-existent serial number
+    dev_config.serial_number = "NON-EXISTENT";
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, cdc_acm_host_open(0x303A, 0x4002, 0, &dev_config, &cdc_dev));
+    TEST_ASSERT_NULL(cdc_dev);
+    dev_config.serial_number = NULL;
+
     // Open regular device
     TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_open(0x303A, 0x4002, 0, &dev_config, &cdc_dev));
     TEST_ASSERT_NOT_NULL(cdc_dev);
@@ -591,11 +897,7 @@ TEST_CASE("rx_buffer", "[cdc_acm]")
     TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_data_tx_blocking(cdc_dev, tx_data, sizeof(tx_data), 1000));
     vTaskDelay(5);
 
-#ifdef CONFIG_IDF_TARGET_ESP32P4    // RX buffer append is not yet supported on ESP32-P4
-    TEST_ASSERT_FALSE_MESSAGE(rx_overflow, "RX overflow");
-#else
     TEST_ASSERT_TRUE_MESSAGE(rx_overflow, "RX did not overflow");
-#endif
     rx_overflow = false;
 
     // 4. Send more data to the EP: Expect no error
@@ -610,6 +912,75 @@ TEST_CASE("rx_buffer", "[cdc_acm]")
     vTaskDelay(20); // Short delay to allow task to be cleaned up
 }
 
+static void rx_watermark_cb(const cdc_acm_host_dev_event_data_t *event, void *user_ctx)
+{
+    int *watermark_events = (int *)user_ctx;
+    switch (event->type) {
+    case CDC_ACM_HOST_RX_HIGH_WATERMARK:
+        watermark_events[0]++;
+        break;
+    case CDC_ACM_HOST_RX_LOW_WATERMARK:
+        watermark_events[1]++;
+        break;
+    default:
+        break;
+    }
+}
+
+/* RX ring buffer: received data are read by the user, reception is paused when the ring buffer is full */
+TEST_CASE("rx_ring_buffer", "[cdc_acm]")
+{
+    test_install_cdc_driver();
+    int watermark_events[2] = {0}; // High, Low
+
+    cdc_acm_dev_hdl_t cdc_dev;
+    const cdc_acm_host_device_config_t dev_config = {
+        .connection_timeout_ms = 500,
+        .out_buffer_size = 64,
+        .in_buffer_size = 64,
+        .event_cb = rx_watermark_cb,
+        .data_cb = NULL,
+        .user_arg = watermark_events,
+        .rx_ring_size = 256,
+        .rx_high_watermark = 128,
+        .rx_low_watermark = 0,
+    };
+
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_open(0x303A, 0x4002, 0, &dev_config, &cdc_dev));
+    TEST_ASSERT_NOT_NULL(cdc_dev);
+
+    // 1. Nothing received yet
+    uint8_t rx_data[512];
+    size_t rx_len;
+    TEST_ASSERT_EQUAL(ESP_ERR_TIMEOUT, cdc_acm_host_data_rx_read(cdc_dev, rx_data, sizeof(rx_data), &rx_len, 10));
+
+    // 2. Send more data than fits into the ring buffer: reception is paused, but no data is lost
+    uint8_t tx_data[64];
+    for (int i = 0; i < sizeof(tx_data); i++) {
+        tx_data[i] = i;
+    }
+    const int tx_num = 6;
+    for (int i = 0; i < tx_num; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_data_tx_blocking(cdc_dev, tx_data, sizeof(tx_data), 1000));
+        vTaskDelay(5);
+    }
+    TEST_ASSERT_EQUAL(1, watermark_events[0]);
+
+    // 3. Read all data
+    size_t total_len = 0;
+    while (cdc_acm_host_data_rx_read(cdc_dev, rx_data, sizeof(tx_data), &rx_len, 100) == ESP_OK) {
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(tx_data + (total_len % sizeof(tx_data)), rx_data, rx_len);
+        total_len += rx_len;
+    }
+    TEST_ASSERT_EQUAL(tx_num * sizeof(tx_data), total_len);
+    TEST_ASSERT_EQUAL(1, watermark_events[1]);
+
+    // Clean-up
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_close(cdc_dev));
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_uninstall());
+    vTaskDelay(20); // Short delay to allow task to be cleaned up
+}
+
 TEST_CASE("functional_descriptor", "[cdc_acm]")
 {
     test_install_cdc_driver();
@@ -1,11 +1,17 @@
 # SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
 # SPDX-License-Identifier: Apache-2.0
 
+import json
+import os
 from typing import Tuple
 
 import pytest
 from pytest_embedded_idf.dut import IdfDut
 
+BENCHMARK_RESULT_PREFIX = 'cdc_benchmark_result: '  # RESULT_PREFIX of test_cdc_acm_benchmark.c
+BENCHMARK_ROW_TIMEOUT = 60
+BENCHMARK_RESULTS_FILE = os.environ.get('CDC_BENCHMARK_RESULTS', 'cdc_benchmark_results.json')
+
 
 @pytest.mark.esp32s2
 @pytest.mark.esp32s3
@@ -25,3 +31,40 @@ def test_usb_host_cdc(dut: Tuple[IdfDut, IdfDut]) -> None:
 
     ## 2 Run CDC test
     host.run_all_single_board_cases(group='cdc_acm')
+
+
+@pytest.mark.esp32s2
+@pytest.mark.esp32s3
+@pytest.mark.esp32p4
+@pytest.mark.usb_host
+@pytest.mark.parametrize('count', [
+    2,
+], indirect=True)
+def test_usb_host_cdc_benchmark(dut: Tuple[IdfDut, IdfDut]) -> None:
+    '''
+    Steps:
+    1. Prepare the echo USB device
+    2. Run the loopback benchmark on the host, one result per configuration
+    3. Store the results in BENCHMARK_RESULTS_FILE, so runs before and after a driver change can be compared
+    '''
+    device = dut[0]
+    host = dut[1]
+
+    device.expect_exact('Press ENTER to see the list of tests.')
+    device.write('[cdc_acm_device]')
+    device.expect_exact('USB initialization DONE')
+
+    host.expect_exact('Press ENTER to see the list of tests.')
+    host.write('[cdc_acm_benchmark]')
+    results = []
+    while True:
+        line = host.expect(rf'({BENCHMARK_RESULT_PREFIX}.*|\d+ Tests \d+ Failures \d+ Ignored)', timeout=BENCHMARK_ROW_TIMEOUT).group(1).decode()
+        if not line.startswith(BENCHMARK_RESULT_PREFIX):
+            break
+        result = json.loads(line[len(BENCHMARK_RESULT_PREFIX):])
+        results.append(result)
+        print(f'{host.target} CDC-ACM benchmark: {result}')
+    assert line.split()[2] == '0', 'Test case failed'
+
+    with open(BENCHMARK_RESULTS_FILE, 'w') as f:
+        json.dump({host.target: results}, f, indent=2)
@@ -0,0 +1,534 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "usb/usb_types_ch9.h"
+#include "usb/usb_types_cdc.h"
+#include "usb/cdc_acm_host.h"
+#include "usb/cdc_ncm_host.h"
+#include "cdc_ncm_ntb.h"
+
+static const char *TAG = "cdc_ncm";
+
+#define CDC_NCM_NTB_DEFAULT_SIZE      (2048)
+#define CDC_NCM_NTB_OUT_DEFAULT_NUM   (2)
+#define CDC_NCM_ECM_BUFFER_SIZE       (1536)  // Multiple of Full-speed and High-speed MPS that can hold an Ethernet frame
+#define CDC_NCM_MAX_SEGMENT_SIZE      (1514)  // Ethernet frame without FCS
+#define CDC_NCM_PAD_MPS               (64)    // Transfers of multiple of this size are padded, so no ZLP is needed in both FS and HS
+#define CDC_NCM_NTB16_FORMAT          (1 << 0)
+
+// Ethernet packet filter bits of SET_ETHERNET_PACKET_FILTER request
+#define CDC_NCM_PACKET_FILTER_ALL_MULTICAST (1 << 1)
+#define CDC_NCM_PACKET_FILTER_DIRECTED      (1 << 2)
+#define CDC_NCM_PACKET_FILTER_BROADCAST     (1 << 3)
+
+// Response of GET_NTB_PARAMETERS request, USB CDC NCM specification v1.0, table 6-3
+typedef struct {
+    uint16_t wLength;
+    uint16_t bmNtbFormatsSupported;
+    uint32_t dwNtbInMaxSize;
+    uint16_t wNdpInDivisor;
+    uint16_t wNdpInPayloadRemainder;
+    uint16_t wNdpInAlignment;
+    uint16_t wReserved;
+    uint32_t dwNtbOutMaxSize;
+    uint16_t wNdpOutDivisor;
+    uint16_t wNdpOutPayloadRemainder;
+    uint16_t wNdpOutAlignment;
+    uint16_t wNtbOutMaxDatagrams;
+} __attribute__((packed)) cdc_ncm_ntb_parameters_t;
+
+// Ethernet Networking Functional Descriptor, USB CDC ECM specification v1.2, table 3
+typedef struct {
+    uint8_t bFunctionLength;
+    uint8_t bDescriptorType;
+    uint8_t bDescriptorSubtype;
+    uint8_t iMACAddress;
+    uint32_t bmEthernetStatistics;
+    uint16_t wMaxSegmentSize;
+    uint16_t wNumberMCFilters;
+    uint8_t bNumberPowerFilters;
+} __attribute__((packed)) cdc_ncm_eth_desc_t;
+
+typedef struct cdc_ncm_dev_s cdc_ncm_dev_t;
+
+// esp_netif driver glue, esp_netif_driver_base_t must be the first member
+typedef struct {
+    esp_netif_driver_base_t base;
+    cdc_ncm_dev_t *ncm_dev;
+} cdc_ncm_netif_glue_t;
+
+struct cdc_ncm_dev_s {
+    cdc_acm_dev_hdl_t cdc_hdl;            // Underlying CDC device
+    uint8_t interface_idx;                // Communication Class interface of the network function
+    bool ncm;                             // Frames are carried in NTBs (CDC-NCM), one frame per transfer otherwise (CDC-ECM)
+    volatile bool started;                // Device is configured, received data are processed
+    bool link_up;                         // Network connection state
+    bool mac_valid;                       // MAC address was read from the device
+    uint8_t mac[6];                       // MAC address of the device
+    size_t max_segment_size;              // Maximum Ethernet frame length
+    cdc_ncm_host_dev_callback_t event_cb; // User's callback for device events
+    cdc_ncm_host_rx_callback_t rx_cb;     // User's callback for received frames
+    void *user_arg;                       // Argument of user's callbacks
+    cdc_ncm_netif_glue_t netif_glue;      // esp_netif glue, netif_glue.base.netif is NULL if not attached
+    struct {
+        const uint8_t *start;             // Start of the incomplete NTB in the IN buffer
+        size_t len;                       // Received length of the incomplete NTB, 0 if there is none
+    } rx;
+    struct {
+        SemaphoreHandle_t mux;            // Protects all members of tx
+        SemaphoreHandle_t idle;           // Given by the last transmission finished after the device was stopped
+        cdc_ncm_ntb_params_t params;      // NTB parameters of the device
+        cdc_ncm_ntb_builder_t builder;    // NTB being filled
+        uint8_t *buf;                     // Buffer of NTB being filled, NULL if there is none
+        int in_flight;                    // Number of transfers in flight
+        uint16_t sequence;                // Sequence number of next NTB
+    } tx;
+};
+
+/**
+ * @brief Send class specific request to the Communication Class interface
+ */
+static esp_err_t cdc_ncm_class_request(cdc_ncm_dev_t *ncm_dev, bool in_transfer, uint8_t request, uint16_t value, uint16_t data_len, uint8_t *data)
+{
+    const uint8_t req_type = USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIP_INTERFACE |
+                             (in_transfer ? USB_BM_REQUEST_TYPE_DIR_IN : USB_BM_REQUEST_TYPE_DIR_OUT);
+    return cdc_acm_host_send_custom_request(ncm_dev->cdc_hdl, req_type, request, value, ncm_dev->interface_idx, data_len, data);
+}
+
+/**
+ * @brief Pass received frame to esp_netif or to the user
+ */
+static void cdc_ncm_frame_received(const uint8_t *frame, size_t frame_len, void *arg)
+{
+    cdc_ncm_dev_t *ncm_dev = (cdc_ncm_dev_t *)arg;
+    esp_netif_t *netif = ncm_dev->netif_glue.base.netif;
+    if (netif) {
+        // The TCP/IP stack keeps the buffer until it is freed by cdc_ncm_netif_free_rx_buffer()
+        uint8_t *buf = malloc(frame_len);
+        if (buf == NULL) {
+            ESP_LOGW(TAG, "Not enough memory for received frame");
+            return;
+        }
+        memcpy(buf, frame, frame_len);
+        esp_netif_receive(netif, buf, frame_len, buf);
+    } else if (ncm_dev->rx_cb) {
+        ncm_dev->rx_cb(frame, frame_len, ncm_dev->user_arg);
+    }
+}
+
+static bool cdc_ncm_data_cb(const uint8_t *data, size_t data_len, void *arg)
+{
+    cdc_ncm_dev_t *ncm_dev = (cdc_ncm_dev_t *)arg;
+    if (!ncm_dev->started) {
+        return true; // Drop data received before the device is configured
+    }
+    if (!ncm_dev->ncm) {
+        cdc_ncm_frame_received(data, data_len, ncm_dev);
+        return true;
+    }
+
+    // CDC-ACM driver appends the next transfer right after the incomplete NTB and passes only the new data.
+    // Data at other address mean that the IN buffer was reset and the incomplete NTB is lost
+    const uint8_t *ntb = data;
+    size_t ntb_len = data_len;
+    if (ncm_dev->rx.len > 0 && data == ncm_dev->rx.start + ncm_dev->rx.len) {
+        ntb = ncm_dev->rx.start;
+        ntb_len += ncm_dev->rx.len;
+    }
+
+    const esp_err_t ret = cdc_ncm_ntb_parse(ntb, ntb_len, cdc_ncm_frame_received, ncm_dev);
+    if (ret == ESP_ERR_INVALID_SIZE) {
+        // NTB continues in the next transfer, append it
+        ncm_dev->rx.start = ntb;
+        ncm_dev->rx.len = ntb_len;
+        return false;
+    }
+    ncm_dev->rx.len = 0;
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Malformed NTB");
+    }
+    return true;
+}
+
+static void cdc_ncm_event_cb(const cdc_acm_host_dev_event_data_t *event, void *user_ctx)
+{
+    cdc_ncm_dev_t *ncm_dev = (cdc_ncm_dev_t *)user_ctx;
+    esp_netif_t *netif = ncm_dev->netif_glue.base.netif;
+    cdc_ncm_host_dev_event_t ncm_event;
+
+    switch (event->type) {
+    case CDC_ACM_HOST_NETWORK_CONNECTION:
+        ncm_dev->link_up = event->data.network_connected;
+        ESP_LOGD(TAG, "Link %s", ncm_dev->link_up ? "up" : "down");
+        if (netif) {
+            if (ncm_dev->link_up) {
+                esp_netif_action_connected(netif, NULL, 0, NULL);
+            } else {
+                esp_netif_action_disconnected(netif, NULL, 0, NULL);
+            }
+        }
+        ncm_event = ncm_dev->link_up ? CDC_NCM_HOST_LINK_UP : CDC_NCM_HOST_LINK_DOWN;
+        break;
+    case CDC_ACM_HOST_DEVICE_DISCONNECTED:
+        ncm_dev->link_up = false;
+        if (netif) {
+            esp_netif_action_disconnected(netif, NULL, 0, NULL);
+        }
+        ncm_event = CDC_NCM_HOST_DEVICE_DISCONNECTED;
+        break;
+    case CDC_ACM_HOST_ERROR:
+        ESP_LOGW(TAG, "Transfer error %d", event->data.error);
+        return;
+    default:
+        return;
+    }
+
+    if (ncm_dev->event_cb) {
+        ncm_dev->event_cb(ncm_dev, ncm_event, ncm_dev->user_arg);
+    }
+}
+
+/**
+ * @brief Start new NTB in a free OUT buffer
+ *
+ * @note tx.mux must be taken
+ * @return true: NTB started, false: All buffers are in use
+ */
+static bool cdc_ncm_ntb_start(cdc_ncm_dev_t *ncm_dev)
+{
+    uint8_t *buf;
+    size_t buf_size;
+    if (cdc_acm_host_tx_buffer_get(ncm_dev->cdc_hdl, 0, &buf, &buf_size) != ESP_OK) {
+        return false;
+    }
+    cdc_ncm_ntb_init(&ncm_dev->tx.builder, buf, buf_size, &ncm_dev->tx.params);
+    ncm_dev->tx.buf = buf;
+    return true;
+}
+
+static void cdc_ncm_tx_done(esp_err_t status, size_t data_len, void *user_arg);
+
+/**
+ * @brief Submit buffer from the OUT pool
+ *
+ * @note tx.mux must be taken
+ */
+static void cdc_ncm_buffer_submit(cdc_ncm_dev_t *ncm_dev, uint8_t *buf, size_t len)
+{
+    // The buffer goes back to the pool if the submission fails
+    if (cdc_acm_host_tx_buffer_submit(ncm_dev->cdc_hdl, buf, len, cdc_ncm_tx_done, ncm_dev) == ESP_OK) {
+        ncm_dev->tx.in_flight++;
+    } else {
+        ESP_LOGW(TAG, "Could not submit OUT transfer");
+    }
+}
+
+/**
+ * @brief Finish the NTB being filled and submit it
+ *
+ * @note tx.mux must be taken
+ */
+static void cdc_ncm_ntb_submit(cdc_ncm_dev_t *ncm_dev)
+{
+    const size_t ntb_len = cdc_ncm_ntb_finish(&ncm_dev->tx.builder, ncm_dev->tx.sequence++, CDC_NCM_PAD_MPS);
+    uint8_t *buf = ncm_dev->tx.buf;
+    ncm_dev->tx.buf = NULL;
+    cdc_ncm_buffer_submit(ncm_dev, buf, ntb_len);
+}
+
+static void cdc_ncm_tx_done(esp_err_t status, size_t data_len, void *user_arg)
+{
+    cdc_ncm_dev_t *ncm_dev = (cdc_ncm_dev_t *)user_arg;
+    if (status != ESP_OK) {
+        ESP_LOGD(TAG, "OUT transfer failed: %s", esp_err_to_name(status));
+    }
+
+    xSemaphoreTake(ncm_dev->tx.mux, portMAX_DELAY);
+    ncm_dev->tx.in_flight--;
+    if (ncm_dev->tx.buf && ncm_dev->tx.builder.num > 0) {
+        cdc_ncm_ntb_submit(ncm_dev); // Send frames aggregated while the bus was busy
+    }
+    if (!ncm_dev->started && ncm_dev->tx.in_flight == 0) {
+        xSemaphoreGive(ncm_dev->tx.idle); // cdc_ncm_host_close() waits for this
+    }
+    xSemaphoreGive(ncm_dev->tx.mux);
+}
+
+esp_err_t cdc_ncm_host_transmit(cdc_ncm_dev_hdl_t ncm_hdl, const uint8_t *frame, size_t frame_len)
+{
+    ESP_RETURN_ON_FALSE(ncm_hdl && frame && frame_len > 0, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    cdc_ncm_dev_t *ncm_dev = (cdc_ncm_dev_t *)ncm_hdl;
+    ESP_RETURN_ON_FALSE(frame_len <= ncm_dev->max_segment_size, ESP_ERR_INVALID_SIZE, TAG, "Frame too large");
+    esp_err_t ret = ESP_OK;
+
+    xSemaphoreTake(ncm_dev->tx.mux, portMAX_DELAY);
+    if (!ncm_dev->ncm) {
+        // CDC-ECM: One frame per transfer
+        uint8_t *buf;
+        ESP_GOTO_ON_FALSE(cdc_acm_host_tx_buffer_get(ncm_dev->cdc_hdl, 0, &buf, NULL) == ESP_OK, ESP_ERR_NO_MEM, unlock, TAG, "TX buffers full");
+        memcpy(buf, frame, frame_len);
+        size_t len = frame_len;
+        if ((len % CDC_NCM_PAD_MPS) == 0) {
+            buf[len++] = 0; // Terminate the transfer by short packet, the buffer is larger than maximum segment size
+        }
+        cdc_ncm_buffer_submit(ncm_dev, buf, len);
+        goto unlock;
+    }
+
+    // CDC-NCM: Add the frame to NTB
+    ESP_GOTO_ON_FALSE(ncm_dev->tx.buf || cdc_ncm_ntb_start(ncm_dev), ESP_ERR_NO_MEM, unlock, TAG, "TX buffers full");
+    if (!cdc_ncm_ntb_add(&ncm_dev->tx.builder, frame, frame_len)) {
+        // The NTB is full, send it and continue with new one
+        cdc_ncm_ntb_submit(ncm_dev);
+        ESP_GOTO_ON_FALSE(cdc_ncm_ntb_start(ncm_dev), ESP_ERR_NO_MEM, unlock, TAG, "TX buffers full");
+        const bool added = cdc_ncm_ntb_add(&ncm_dev->tx.builder, frame, frame_len);
+        assert(added); // Empty NTB can hold frame of maximum segment size, it was checked in cdc_ncm_host_open()
+        (void)added;
+    }
+
+    // If the bus is idle, there is no reason to wait for more frames
+    if (ncm_dev->tx.in_flight == 0) {
+        cdc_ncm_ntb_submit(ncm_dev);
+    }
+
+unlock:
+    xSemaphoreGive(ncm_dev->tx.mux);
+    return ret;
+}
+
+/**
+ * @brief Read MAC address from string descriptor referenced by Ethernet Networking Functional Descriptor
+ */
+static esp_err_t cdc_ncm_mac_read(cdc_ncm_dev_t *ncm_dev, uint8_t string_idx)
+{
+    // The MAC address is a string of 12 hexadecimal digits in UTF-16LE
+    uint8_t str_desc[2 + 12 * 2];
+    ESP_RETURN_ON_ERROR(
+        cdc_acm_host_send_custom_request(ncm_dev->cdc_hdl,
+                                         USB_BM_REQUEST_TYPE_DIR_IN | USB_BM_REQUEST_TYPE_TYPE_STANDARD | USB_BM_REQUEST_TYPE_RECIP_DEVICE,
+                                         USB_B_REQUEST_GET_DESCRIPTOR, (USB_B_DESCRIPTOR_TYPE_STRING << 8) | string_idx, 0x0409,
+                                         sizeof(str_desc), str_desc),
+        TAG, "Could not get MAC address string");
+    ESP_RETURN_ON_FALSE(str_desc[0] == sizeof(str_desc) && str_desc[1] == USB_B_DESCRIPTOR_TYPE_STRING, ESP_ERR_INVALID_RESPONSE, TAG, "Invalid MAC address string");
+
+    for (int i = 0; i < 12; i++) {
+        const char c = (char)str_desc[2 + i * 2];
+        uint8_t nibble;
+        if (c >= '0' && c <= '9') {
+            nibble = c - '0';
+        } else if (c >= 'A' && c <= 'F') {
+            nibble = c - 'A' + 10;
+        } else if (c >= 'a' && c <= 'f') {
+            nibble = c - 'a' + 10;
+        } else {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        ncm_dev->mac[i / 2] = (i % 2) ? (ncm_dev->mac[i / 2] | nibble) : (nibble << 4);
+    }
+    ncm_dev->mac_valid = true;
+    return ESP_OK;
+}
+
+/**
+ * @brief Read NTB parameters of CDC-NCM device and set size of IN NTB
+ */
+static esp_err_t cdc_ncm_ntb_configure(cdc_ncm_dev_t *ncm_dev, size_t ntb_in_size, size_t ntb_out_size)
+{
+    cdc_ncm_ntb_parameters_t ntb_params;
+    ESP_RETURN_ON_ERROR(
+        cdc_ncm_class_request(ncm_dev, true, USB_CDC_REQ_GET_NTB_PARAMETERS, 0, sizeof(ntb_params), (uint8_t *)&ntb_params),
+        TAG, "Could not get NTB parameters");
+    ESP_RETURN_ON_FALSE(ntb_params.bmNtbFormatsSupported & CDC_NCM_NTB16_FORMAT, ESP_ERR_NOT_SUPPORTED, TAG, "NTB16 not supported");
+    ESP_LOGD(TAG, "NTB IN max %"PRIu32", OUT max %"PRIu32", OUT divisor %u",
+             ntb_params.dwNtbInMaxSize, ntb_params.dwNtbOutMaxSize, ntb_params.wNdpOutDivisor);
+
+    // Received NTBs must fit in the IN buffer
+    if (ntb_params.dwNtbInMaxSize > ntb_in_size) {
+        uint32_t in_size = ntb_in_size;
+        ESP_RETURN_ON_ERROR(
+            cdc_ncm_class_request(ncm_dev, false, USB_CDC_REQ_SET_NTB_INPUT_SIZE, 0, sizeof(in_size), (uint8_t *)&in_size),
+            TAG, "Could not set NTB input size");
+    }
+
+    ncm_dev->tx.params = (cdc_ncm_ntb_params_t) {
+        .max_size = (ntb_params.dwNtbOutMaxSize && ntb_params.dwNtbOutMaxSize < ntb_out_size) ? ntb_params.dwNtbOutMaxSize : ntb_out_size,
+        .divisor = ntb_params.wNdpOutDivisor,
+        .remainder = ntb_params.wNdpOutPayloadRemainder,
+        .ndp_alignment = ntb_params.wNdpOutAlignment,
+        .max_datagrams = ntb_params.wNtbOutMaxDatagrams,
+    };
+
+    // Check that one frame of maximum segment size fits in an NTB, including headers, alignment and padding
+    const size_t overhead = CDC_NCM_NTH16_SIZE + CDC_NCM_NDP16_HEADER_SIZE + 2 * CDC_NCM_NDP16_ENTRY_SIZE +
+                            ncm_dev->tx.params.divisor + ncm_dev->tx.params.ndp_alignment + 4 + 1;
+    ESP_RETURN_ON_FALSE(ncm_dev->tx.params.max_size >= ncm_dev->max_segment_size + overhead, ESP_ERR_INVALID_ARG, TAG, "OUT NTB too small for maximum segment size");
+    return ESP_OK;
+}
+
+esp_err_t cdc_ncm_host_open(uint16_t vid, uint16_t pid, uint8_t interface_idx, const cdc_ncm_host_device_config_t *dev_config, cdc_ncm_dev_hdl_t *ncm_hdl_ret)
+{
+    esp_err_t ret;
+    ESP_RETURN_ON_FALSE(dev_config && ncm_hdl_ret, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(dev_config->ntb_out_num == 0 || dev_config->ntb_out_num >= 2, ESP_ERR_INVALID_ARG, TAG, "At least 2 OUT NTBs needed");
+    const size_t ntb_in_size = dev_config->ntb_in_size ? dev_config->ntb_in_size : CDC_NCM_NTB_DEFAULT_SIZE;
+    const size_t ntb_out_size = dev_config->ntb_out_size ? dev_config->ntb_out_size : CDC_NCM_NTB_DEFAULT_SIZE;
+
+    cdc_ncm_dev_t *ncm_dev = calloc(1, sizeof(cdc_ncm_dev_t));
+    ESP_RETURN_ON_FALSE(ncm_dev, ESP_ERR_NO_MEM, TAG, "Not enough memory");
+    ncm_dev->tx.mux = xSemaphoreCreateMutex();
+    ncm_dev->tx.idle = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(ncm_dev->tx.mux && ncm_dev->tx.idle, ESP_ERR_NO_MEM, err, TAG, "Not enough memory");
+    ncm_dev->interface_idx = interface_idx;
+    ncm_dev->event_cb = dev_config->event_cb;
+    ncm_dev->rx_cb = dev_config->rx_cb;
+    ncm_dev->user_arg = dev_config->user_arg;
+    ncm_dev->netif_glue.ncm_dev = ncm_dev;
+
+    // Buffers are large enough for both NTBs and single frames, so the device can be opened before we know its type
+    const cdc_acm_host_device_config_t acm_config = {
+        .connection_timeout_ms = dev_config->connection_timeout_ms,
+        .out_buffer_size = (ntb_out_size > CDC_NCM_ECM_BUFFER_SIZE) ? ntb_out_size : CDC_NCM_ECM_BUFFER_SIZE,
+        .in_buffer_size = (ntb_in_size > CDC_NCM_ECM_BUFFER_SIZE) ? ntb_in_size : CDC_NCM_ECM_BUFFER_SIZE,
+        .event_cb = cdc_ncm_event_cb,
+        .data_cb = cdc_ncm_data_cb,
+        .user_arg = ncm_dev,
+        .out_transfers_num = dev_config->ntb_out_num ? dev_config->ntb_out_num : CDC_NCM_NTB_OUT_DEFAULT_NUM,
+    };
+    ESP_GOTO_ON_ERROR(cdc_acm_host_open(vid, pid, interface_idx, &acm_config, &ncm_dev->cdc_hdl), err, TAG, "Could not open device");
+
+    // Network functions have Ethernet Networking Functional Descriptor, NCM data interface uses NTB protocol
+    const cdc_ncm_eth_desc_t *eth_desc;
+    ESP_GOTO_ON_ERROR(
+        cdc_acm_host_cdc_desc_get(ncm_dev->cdc_hdl, USB_CDC_DESC_SUBTYPE_ETH, (const usb_standard_desc_t **)&eth_desc),
+        err, TAG, "Not a CDC-NCM/ECM device");
+    cdc_data_protocol_t data_protocol;
+    cdc_acm_host_protocols_get(ncm_dev->cdc_hdl, NULL, &data_protocol);
+    ncm_dev->ncm = (data_protocol == USB_CDC_DATA_PROTOCOL_NCM);
+    ncm_dev->max_segment_size = (eth_desc->wMaxSegmentSize && eth_desc->wMaxSegmentSize < CDC_NCM_MAX_SEGMENT_SIZE) ? eth_desc->wMaxSegmentSize : CDC_NCM_MAX_SEGMENT_SIZE;
+    ESP_LOGD(TAG, "Opening CDC-%s device", ncm_dev->ncm ? "NCM" : "ECM");
+
+    if (eth_desc->iMACAddress == 0 || cdc_ncm_mac_read(ncm_dev, eth_desc->iMACAddress) != ESP_OK) {
+        ESP_LOGW(TAG, "Device does not provide MAC address");
+    }
+    if (ncm_dev->ncm) {
+        ESP_GOTO_ON_ERROR(cdc_ncm_ntb_configure(ncm_dev, ntb_in_size, ntb_out_size), err, TAG,);
+    }
+
+    // Packet filter is optional, some devices do not implement it
+    const uint16_t filter = CDC_NCM_PACKET_FILTER_DIRECTED | CDC_NCM_PACKET_FILTER_BROADCAST | CDC_NCM_PACKET_FILTER_ALL_MULTICAST;
+    if (cdc_ncm_class_request(ncm_dev, false, USB_CDC_REQ_SET_ETHERNET_PACKET_FILTER, filter, 0, NULL) != ESP_OK) {
+        ESP_LOGD(TAG, "Could not set packet filter");
+    }
+
+    ncm_dev->started = true;
+    *ncm_hdl_ret = ncm_dev;
+    return ESP_OK;
+
+err:
+    if (ncm_dev->cdc_hdl) {
+        cdc_acm_host_close(ncm_dev->cdc_hdl);
+    }
+    if (ncm_dev->tx.mux) {
+        vSemaphoreDelete(ncm_dev->tx.mux);
+    }
+    if (ncm_dev->tx.idle) {
+        vSemaphoreDelete(ncm_dev->tx.idle);
+    }
+    free(ncm_dev);
+    *ncm_hdl_ret = NULL;
+    return ret;
+}
+
+esp_err_t cdc_ncm_host_close(cdc_ncm_dev_hdl_t ncm_hdl)
+{
+    ESP_RETURN_ON_FALSE(ncm_hdl, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    cdc_ncm_dev_t *ncm_dev = (cdc_ncm_dev_t *)ncm_hdl;
+    ncm_dev->started = false;
+
+    // Give back the NTB being filled
+    xSemaphoreTake(ncm_dev->tx.mux, portMAX_DELAY);
+    if (ncm_dev->tx.buf) {
+        cdc_acm_host_tx_buffer_submit(ncm_dev->cdc_hdl, ncm_dev->tx.buf, 0, NULL, NULL);
+        ncm_dev->tx.buf = NULL;
+    }
+    const bool in_flight = ncm_dev->tx.in_flight > 0;
+    xSemaphoreGive(ncm_dev->tx.mux);
+
+    // Cancel transmissions in flight and wait for all their callbacks, they use this device
+    if (in_flight) {
+        ESP_RETURN_ON_ERROR(cdc_acm_host_tx_cancel(ncm_dev->cdc_hdl), TAG, "Could not cancel transmissions");
+        xSemaphoreTake(ncm_dev->tx.idle, portMAX_DELAY);
+    }
+
+    ESP_RETURN_ON_ERROR(cdc_acm_host_close(ncm_dev->cdc_hdl), TAG,);
+    vSemaphoreDelete(ncm_dev->tx.mux);
+    vSemaphoreDelete(ncm_dev->tx.idle);
+    free(ncm_dev);
+    return ESP_OK;
+}
+
+esp_err_t cdc_ncm_host_get_mac(cdc_ncm_dev_hdl_t ncm_hdl, uint8_t mac[6])
+{
+    ESP_RETURN_ON_FALSE(ncm_hdl && mac, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    cdc_ncm_dev_t *ncm_dev = (cdc_ncm_dev_t *)ncm_hdl;
+    if (!ncm_dev->mac_valid) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    memcpy(mac, ncm_dev->mac, sizeof(ncm_dev->mac));
+    return ESP_OK;
+}
+
+static esp_err_t cdc_ncm_netif_transmit(void *h, void *buffer, size_t len)
+{
+    return cdc_ncm_host_transmit((cdc_ncm_dev_hdl_t)h, buffer, len);
+}
+
+static void cdc_ncm_netif_free_rx_buffer(void *h, void *buffer)
+{
+    free(buffer);
+}
+
+static esp_err_t cdc_ncm_netif_post_attach(esp_netif_t *esp_netif, esp_netif_iodriver_handle args)
+{
+    cdc_ncm_netif_glue_t *glue = (cdc_ncm_netif_glue_t *)args;
+    cdc_ncm_dev_t *ncm_dev = glue->ncm_dev;
+
+    const esp_netif_driver_ifconfig_t driver_ifconfig = {
+        .handle = ncm_dev,
+        .transmit = cdc_ncm_netif_transmit,
+        .driver_free_rx_buffer = cdc_ncm_netif_free_rx_buffer,
+    };
+    ESP_RETURN_ON_ERROR(esp_netif_set_driver_config(esp_netif, &driver_ifconfig), TAG, "Could not set netif driver config");
+    if (ncm_dev->mac_valid) {
+        esp_netif_set_mac(esp_netif, ncm_dev->mac);
+    }
+
+    // Received frames are passed to esp_netif from this point
+    glue->base.netif = esp_netif;
+    esp_netif_action_start(esp_netif, NULL, 0, NULL);
+    if (ncm_dev->link_up) {
+        esp_netif_action_connected(esp_netif, NULL, 0, NULL);
+    }
+    return ESP_OK;
+}
+
+esp_netif_iodriver_handle cdc_ncm_host_get_netif_glue(cdc_ncm_dev_hdl_t ncm_hdl)
+{
+    if (ncm_hdl == NULL) {
+        return NULL;
+    }
+    cdc_ncm_dev_t *ncm_dev = (cdc_ncm_dev_t *)ncm_hdl;
+    ncm_dev->netif_glue.base.post_attach = cdc_ncm_netif_post_attach;
+    return &ncm_dev->netif_glue;
+}
@@ -0,0 +1,169 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "cdc_ncm_ntb.h"
+
+// All NTB fields are little-endian
+static inline uint16_t get_le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)get_le16(p) | ((uint32_t)get_le16(p + 2) << 16);
+}
+
+static inline void put_le16(uint8_t *p, uint16_t val)
+{
+    p[0] = (uint8_t)val;
+    p[1] = (uint8_t)(val >> 8);
+}
+
+static inline void put_le32(uint8_t *p, uint32_t val)
+{
+    put_le16(p, (uint16_t)val);
+    put_le16(p + 2, (uint16_t)(val >> 16));
+}
+
+esp_err_t cdc_ncm_ntb_parse(const uint8_t *ntb, size_t ntb_len, cdc_ncm_datagram_cb_t cb, void *cb_arg)
+{
+    if (ntb_len < CDC_NCM_NTH16_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (get_le32(ntb) != CDC_NCM_NTH16_SIGNATURE || get_le16(ntb + 4) != CDC_NCM_NTH16_SIZE) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    // wBlockLength 0: NTB is terminated by short packet
+    size_t block_len = get_le16(ntb + 8);
+    if (block_len == 0) {
+        block_len = ntb_len;
+    }
+    if (ntb_len < block_len) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // Go through the NDP chain. The number of NDPs is limited, so malformed NTB cannot make a loop
+    size_t ndp_index = get_le16(ntb + 10);
+    for (int ndp_cnt = 0; ndp_index != 0; ndp_cnt++) {
+        if (ndp_cnt == CDC_NCM_NTB_MAX_NDPS || (ndp_index % 4) || (ndp_index + CDC_NCM_NDP16_HEADER_SIZE > block_len)) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        const uint8_t *ndp = ntb + ndp_index;
+        const size_t ndp_len = get_le16(ndp + 4);
+        if (get_le32(ndp) != CDC_NCM_NDP16_SIGNATURE || ndp_len < CDC_NCM_NDP16_HEADER_SIZE + 2 * CDC_NCM_NDP16_ENTRY_SIZE || ndp_index + ndp_len > block_len) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+
+        // Datagram pointers are terminated by zero entry
+        for (size_t entry = CDC_NCM_NDP16_HEADER_SIZE; entry + CDC_NCM_NDP16_ENTRY_SIZE <= ndp_len; entry += CDC_NCM_NDP16_ENTRY_SIZE) {
+            const size_t datagram_index = get_le16(ndp + entry);
+            const size_t datagram_len = get_le16(ndp + entry + 2);
+            if (datagram_index == 0 || datagram_len == 0) {
+                break;
+            }
+            if (datagram_index + datagram_len > block_len) {
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            cb(ntb + datagram_index, datagram_len, cb_arg);
+        }
+        ndp_index = get_le16(ndp + 6);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Round offset up to next position that gives the remainder after division by divisor
+ */
+static size_t ntb_align(size_t offset, size_t divisor, size_t remainder)
+{
+    if (divisor == 0) {
+        return offset;
+    }
+    remainder %= divisor;
+    const size_t current = offset % divisor;
+    return offset + ((remainder + divisor - current) % divisor);
+}
+
+void cdc_ncm_ntb_init(cdc_ncm_ntb_builder_t *builder, uint8_t *buf, size_t size, const cdc_ncm_ntb_params_t *params)
+{
+    builder->buf = buf;
+    builder->size = (params->max_size && params->max_size < size) ? params->max_size : size;
+    if (builder->size > UINT16_MAX) {
+        builder->size = UINT16_MAX; // NTB16 uses 16-bit offsets
+    }
+    builder->len = CDC_NCM_NTH16_SIZE;
+    builder->params = *params;
+    builder->num = 0;
+}
+
+/**
+ * @brief Get offset of NDP16 after the datagrams
+ */
+static size_t ntb_ndp_index(const cdc_ncm_ntb_builder_t *builder, size_t len)
+{
+    const size_t alignment = builder->params.ndp_alignment > 4 ? builder->params.ndp_alignment : 4;
+    return ntb_align(len, alignment, 0);
+}
+
+bool cdc_ncm_ntb_add(cdc_ncm_ntb_builder_t *builder, const uint8_t *datagram, size_t datagram_len)
+{
+    const unsigned max_datagrams = (builder->params.max_datagrams && builder->params.max_datagrams < CDC_NCM_NTB_MAX_DATAGRAMS) ?
+                                   builder->params.max_datagrams : CDC_NCM_NTB_MAX_DATAGRAMS;
+    if (builder->num == max_datagrams) {
+        return false;
+    }
+
+    // The datagram, NDP with one more entry and the terminating entry, and possible padding byte must fit
+    const size_t index = ntb_align(builder->len, builder->params.divisor, builder->params.remainder);
+    const size_t ndp_index = ntb_ndp_index(builder, index + datagram_len);
+    const size_t ndp_len = CDC_NCM_NDP16_HEADER_SIZE + (builder->num + 2) * CDC_NCM_NDP16_ENTRY_SIZE;
+    if (ndp_index + ndp_len + 1 > builder->size) {
+        return false;
+    }
+
+    memset(builder->buf + builder->len, 0, index - builder->len);
+    memcpy(builder->buf + index, datagram, datagram_len);
+    builder->datagrams[builder->num][0] = (uint16_t)index;
+    builder->datagrams[builder->num][1] = (uint16_t)datagram_len;
+    builder->num++;
+    builder->len = index + datagram_len;
+    return true;
+}
+
+size_t cdc_ncm_ntb_finish(cdc_ncm_ntb_builder_t *builder, uint16_t sequence, uint16_t mps)
+{
+    uint8_t *buf = builder->buf;
+    const size_t ndp_index = ntb_ndp_index(builder, builder->len);
+    const size_t ndp_len = CDC_NCM_NDP16_HEADER_SIZE + (builder->num + 1) * CDC_NCM_NDP16_ENTRY_SIZE;
+    memset(buf + builder->len, 0, ndp_index - builder->len);
+
+    // NDP16 with datagram pointers and terminating zero entry
+    uint8_t *ndp = buf + ndp_index;
+    put_le32(ndp, CDC_NCM_NDP16_SIGNATURE);
+    put_le16(ndp + 4, (uint16_t)ndp_len);
+    put_le16(ndp + 6, 0);
+    for (unsigned i = 0; i < builder->num; i++) {
+        put_le16(ndp + CDC_NCM_NDP16_HEADER_SIZE + i * CDC_NCM_NDP16_ENTRY_SIZE, builder->datagrams[i][0]);
+        put_le16(ndp + CDC_NCM_NDP16_HEADER_SIZE + i * CDC_NCM_NDP16_ENTRY_SIZE + 2, builder->datagrams[i][1]);
+    }
+    put_le32(ndp + ndp_len - CDC_NCM_NDP16_ENTRY_SIZE, 0);
+
+    size_t ntb_len = ndp_index + ndp_len;
+    if (mps && (ntb_len % mps) == 0) {
+        buf[ntb_len++] = 0; // Space for the padding byte is reserved in cdc_ncm_ntb_add()
+    }
+
+    // NTH16
+    put_le32(buf, CDC_NCM_NTH16_SIGNATURE);
+    put_le16(buf + 4, CDC_NCM_NTH16_SIZE);
+    put_le16(buf + 6, sequence);
+    put_le16(buf + 8, (uint16_t)ntb_len);
+    put_le16(buf + 10, (uint16_t)ndp_index);
+    return ntb_len;
+}
@@ -0,0 +1,173 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "cdc_ncm_ntb.h"
+
+static const std::string datagram_a = "Hello";
+static const std::string datagram_b = "NCM world!";
+static const std::vector<std::string> datagrams_all = {datagram_a, datagram_b};
+
+// Offsets of the NTB built by ntb_make()
+#define DATAGRAM_A_INDEX (12)
+#define DATAGRAM_B_INDEX (20)
+#define NDP_INDEX        (32)
+#define NTB_LEN          (NDP_INDEX + CDC_NCM_NDP16_HEADER_SIZE + 3 * CDC_NCM_NDP16_ENTRY_SIZE)
+
+static void put_le16(std::vector<uint8_t> &ntb, size_t offset, uint16_t val)
+{
+    ntb[offset] = (uint8_t)val;
+    ntb[offset + 1] = (uint8_t)(val >> 8);
+}
+
+static void put_le32(std::vector<uint8_t> &ntb, size_t offset, uint32_t val)
+{
+    put_le16(ntb, offset, (uint16_t)val);
+    put_le16(ntb, offset + 2, (uint16_t)(val >> 16));
+}
+
+/**
+ * @brief Make NTB16 with datagram_a and datagram_b followed by NDP16 with terminating zero entry
+ */
+static std::vector<uint8_t> ntb_make()
+{
+    std::vector<uint8_t> ntb(NTB_LEN, 0);
+    put_le32(ntb, 0, CDC_NCM_NTH16_SIGNATURE);
+    put_le16(ntb, 4, CDC_NCM_NTH16_SIZE);
+    put_le16(ntb, 6, 1); // wSequence
+    put_le16(ntb, 8, NTB_LEN);
+    put_le16(ntb, 10, NDP_INDEX);
+    memcpy(&ntb[DATAGRAM_A_INDEX], datagram_a.data(), datagram_a.size());
+    memcpy(&ntb[DATAGRAM_B_INDEX], datagram_b.data(), datagram_b.size());
+
+    put_le32(ntb, NDP_INDEX, CDC_NCM_NDP16_SIGNATURE);
+    put_le16(ntb, NDP_INDEX + 4, CDC_NCM_NDP16_HEADER_SIZE + 3 * CDC_NCM_NDP16_ENTRY_SIZE);
+    put_le16(ntb, NDP_INDEX + 6, 0); // wNextNdpIndex
+    put_le16(ntb, NDP_INDEX + 8, DATAGRAM_A_INDEX);
+    put_le16(ntb, NDP_INDEX + 10, datagram_a.size());
+    put_le16(ntb, NDP_INDEX + 12, DATAGRAM_B_INDEX);
+    put_le16(ntb, NDP_INDEX + 14, datagram_b.size());
+    return ntb;
+}
+
+static void datagram_collect(const uint8_t *datagram, size_t datagram_len, void *arg)
+{
+    std::vector<std::string> *datagrams = static_cast<std::vector<std::string> *>(arg);
+    datagrams->emplace_back(reinterpret_cast<const char *>(datagram), datagram_len);
+}
+
+SCENARIO("NTB16 parsing", "[ncm][ntb]")
+{
+    std::vector<uint8_t> ntb = ntb_make();
+    std::vector<std::string> datagrams;
+
+    GIVEN("Complete NTB") {
+        REQUIRE(ESP_OK == cdc_ncm_ntb_parse(ntb.data(), ntb.size(), datagram_collect, &datagrams));
+        REQUIRE(datagrams == datagrams_all);
+    }
+
+    GIVEN("NTB split over transfers") {
+        // Every prefix is reported as incomplete without passing any datagram
+        for (size_t len = 0; len < ntb.size(); len++) {
+            REQUIRE(ESP_ERR_INVALID_SIZE == cdc_ncm_ntb_parse(ntb.data(), len, datagram_collect, &datagrams));
+        }
+        REQUIRE(datagrams.empty());
+
+        // Parsing from the start of the accumulated data gives the datagrams once the whole NTB is received
+        REQUIRE(ESP_OK == cdc_ncm_ntb_parse(ntb.data(), ntb.size(), datagram_collect, &datagrams));
+        REQUIRE(datagrams == datagrams_all);
+    }
+
+    GIVEN("NTB terminated by short packet") {
+        put_le16(ntb, 8, 0); // wBlockLength 0: The NTB ends with the transfer
+        REQUIRE(ESP_OK == cdc_ncm_ntb_parse(ntb.data(), ntb.size(), datagram_collect, &datagrams));
+        REQUIRE(datagrams == datagrams_all);
+    }
+
+    GIVEN("Bad wNdpIndex") {
+        SECTION("Not aligned to 4 bytes") {
+            put_le16(ntb, 10, NDP_INDEX + 2);
+        }
+        SECTION("NDP past the end of the block") {
+            put_le16(ntb, 10, NTB_LEN);
+        }
+        SECTION("NDP header crossing the end of the block") {
+            put_le16(ntb, 10, NTB_LEN - 4);
+        }
+        REQUIRE(ESP_ERR_INVALID_RESPONSE == cdc_ncm_ntb_parse(ntb.data(), ntb.size(), datagram_collect, &datagrams));
+        REQUIRE(datagrams.empty());
+    }
+
+    GIVEN("Datagram past the end of the block") {
+        put_le16(ntb, NDP_INDEX + 14, NTB_LEN - DATAGRAM_B_INDEX + 1);
+        REQUIRE(ESP_ERR_INVALID_RESPONSE == cdc_ncm_ntb_parse(ntb.data(), ntb.size(), datagram_collect, &datagrams));
+
+        // Datagrams before the malformed one were delivered
+        REQUIRE(datagrams == std::vector<std::string> {datagram_a});
+    }
+
+    GIVEN("Zero length datagram pointer") {
+        // Zero wDatagramLength terminates the list, the following entry is ignored
+        put_le16(ntb, NDP_INDEX + 10, 0);
+        REQUIRE(ESP_OK == cdc_ncm_ntb_parse(ntb.data(), ntb.size(), datagram_collect, &datagrams));
+        REQUIRE(datagrams.empty());
+    }
+
+    GIVEN("Zero datagram index") {
+        put_le16(ntb, NDP_INDEX + 12, 0);
+        REQUIRE(ESP_OK == cdc_ncm_ntb_parse(ntb.data(), ntb.size(), datagram_collect, &datagrams));
+        REQUIRE(datagrams == std::vector<std::string> {datagram_a});
+    }
+}
+
+SCENARIO("NTB16 building", "[ncm][ntb]")
+{
+    const cdc_ncm_ntb_params_t params = {
+        .max_size = 512,
+        .divisor = 4,
+        .remainder = 2, // Ethernet payload after 14 bytes of header is aligned to 4 bytes
+        .ndp_alignment = 4,
+        .max_datagrams = 0,
+    };
+    std::vector<uint8_t> buf(1024);
+    cdc_ncm_ntb_builder_t builder;
+    cdc_ncm_ntb_init(&builder, buf.data(), buf.size(), &params);
+    std::vector<std::string> datagrams;
+
+    GIVEN("NTB with two datagrams") {
+        REQUIRE(cdc_ncm_ntb_add(&builder, reinterpret_cast<const uint8_t *>(datagram_a.data()), datagram_a.size()));
+        REQUIRE(cdc_ncm_ntb_add(&builder, reinterpret_cast<const uint8_t *>(datagram_b.data()), datagram_b.size()));
+        const size_t ntb_len = cdc_ncm_ntb_finish(&builder, 7, 64);
+
+        THEN("The datagrams are aligned and the NTB is parsed back") {
+            REQUIRE(builder.datagrams[0][0] % 4 == 2);
+            REQUIRE(builder.datagrams[1][0] % 4 == 2);
+            REQUIRE(ESP_OK == cdc_ncm_ntb_parse(buf.data(), ntb_len, datagram_collect, &datagrams));
+            REQUIRE(datagrams == datagrams_all);
+        }
+    }
+
+    GIVEN("NTB full of datagrams") {
+        const std::vector<uint8_t> frame(100, 0xA5);
+        unsigned num = 0;
+        while (cdc_ncm_ntb_add(&builder, frame.data(), frame.size())) {
+            num++;
+        }
+        const size_t ntb_len = cdc_ncm_ntb_finish(&builder, 0, 64);
+
+        THEN("The NTB fits in maximum size and is not a multiple of MPS") {
+            REQUIRE(num > 0);
+            REQUIRE(ntb_len <= params.max_size);
+            REQUIRE(ntb_len % 64 != 0);
+            REQUIRE(ESP_OK == cdc_ncm_ntb_parse(buf.data(), ntb_len, datagram_collect, &datagrams));
+            REQUIRE(datagrams.size() == num);
+        }
+    }
+}
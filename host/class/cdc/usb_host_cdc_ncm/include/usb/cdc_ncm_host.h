@@ -0,0 +1,140 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_netif_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cdc_ncm_dev_s *cdc_ncm_dev_hdl_t;
+
+/**
+ * @brief CDC-NCM/ECM Device Event types to upper layer
+ *
+ */
+typedef enum {
+    CDC_NCM_HOST_LINK_UP,              /**< Network cable connected (NetworkConnection notification) */
+    CDC_NCM_HOST_LINK_DOWN,            /**< Network cable disconnected */
+    CDC_NCM_HOST_DEVICE_DISCONNECTED,  /**< USB device disconnected, the device should be closed */
+} cdc_ncm_host_dev_event_t;
+
+/**
+ * @brief Device event callback type
+ *
+ * @param[in] ncm_hdl  CDC-NCM device handle
+ * @param[in] event    Device event
+ * @param[in] user_arg User's argument passed to cdc_ncm_host_open()
+ */
+typedef void (*cdc_ncm_host_dev_callback_t)(cdc_ncm_dev_hdl_t ncm_hdl, cdc_ncm_host_dev_event_t event, void *user_arg);
+
+/**
+ * @brief Ethernet frame received callback type
+ *
+ * The frame is valid only during the callback.
+ *
+ * @param[in] frame     Received Ethernet frame
+ * @param[in] frame_len Length of the frame
+ * @param[in] user_arg  User's argument passed to cdc_ncm_host_open()
+ */
+typedef void (*cdc_ncm_host_rx_callback_t)(const uint8_t *frame, size_t frame_len, void *user_arg);
+
+/**
+ * @brief Configuration structure of CDC-NCM/ECM device
+ *
+ */
+typedef struct {
+    uint32_t connection_timeout_ms;        /**< Timeout for USB device connection in [ms] */
+    size_t ntb_in_size;                    /**< Size of IN NCM Transfer Block (NTB). Larger NTBs carry more frames per transfer.
+                                                0: Default size of 2048 bytes. Ignored for CDC-ECM devices */
+    size_t ntb_out_size;                   /**< Size of OUT NTB, limited by the device. 0: Default size of 2048 bytes. Ignored for CDC-ECM devices */
+    int ntb_out_num;                       /**< Number of OUT NTBs, at least 2. Frames are aggregated in an NTB while the previous NTBs are in flight.
+                                                0: Default number of 2 */
+    cdc_ncm_host_dev_callback_t event_cb;  /**< Device's event callback function. Can be NULL */
+    cdc_ncm_host_rx_callback_t rx_cb;      /**< Frame received callback. Can be NULL if the device is attached to esp_netif */
+    void *user_arg;                        /**< User's argument that will be passed to the callbacks */
+} cdc_ncm_host_device_config_t;
+
+/**
+ * @brief Open CDC-NCM or CDC-ECM device
+ *
+ * CDC-ACM driver must be installed by cdc_acm_host_install() before. The device is opened by the CDC-ACM driver,
+ * this driver configures the network function and converts between Ethernet frames and NTBs.
+ *
+ * @param[in]  vid           Device's Vendor ID, set to CDC_HOST_ANY_VID for any
+ * @param[in]  pid           Device's Product ID, set to CDC_HOST_ANY_PID for any
+ * @param[in]  interface_idx Index of the Communication Class interface of the network function
+ * @param[in]  dev_config    Configuration structure of the device
+ * @param[out] ncm_hdl_ret   CDC-NCM device handle
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: Invalid configuration
+ *     - ESP_ERR_NOT_SUPPORTED: The interface is not CDC-NCM/ECM network function or NTB16 is not supported
+ *     - ESP_ERR_NO_MEM: Not enough memory
+ *     - Other errors of cdc_acm_host_open()
+ */
+esp_err_t cdc_ncm_host_open(uint16_t vid, uint16_t pid, uint8_t interface_idx, const cdc_ncm_host_device_config_t *dev_config, cdc_ncm_dev_hdl_t *ncm_hdl_ret);
+
+/**
+ * @brief Close CDC-NCM/ECM device
+ *
+ * Transmissions in flight are cancelled and the function waits until all of them finished.
+ *
+ * @attention esp_netif attached to this device must be destroyed before
+ * @attention Must not be called from callbacks of this device
+ * @param[in] ncm_hdl CDC-NCM device handle
+ * @return esp_err_t
+ */
+esp_err_t cdc_ncm_host_close(cdc_ncm_dev_hdl_t ncm_hdl);
+
+/**
+ * @brief Transmit Ethernet frame
+ *
+ * CDC-NCM: The frame is copied to an NTB. The NTB is sent immediately if the bus is idle,
+ * otherwise more frames are aggregated in the NTB and it is sent when the previous NTB is transmitted.
+ *
+ * @param[in] ncm_hdl   CDC-NCM device handle
+ * @param[in] frame     Ethernet frame without FCS
+ * @param[in] frame_len Length of the frame
+ * @return
+ *     - ESP_OK: The frame is queued for transmission
+ *     - ESP_ERR_INVALID_SIZE: The frame is larger than the maximum segment size of the device
+ *     - ESP_ERR_NO_MEM: All NTBs are full, the frame was dropped
+ */
+esp_err_t cdc_ncm_host_transmit(cdc_ncm_dev_hdl_t ncm_hdl, const uint8_t *frame, size_t frame_len);
+
+/**
+ * @brief Get MAC address from the Ethernet Networking Functional Descriptor
+ *
+ * @param[in]  ncm_hdl CDC-NCM device handle
+ * @param[out] mac     MAC address
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_NOT_FOUND: The device does not provide MAC address
+ */
+esp_err_t cdc_ncm_host_get_mac(cdc_ncm_dev_hdl_t ncm_hdl, uint8_t mac[6]);
+
+/**
+ * @brief Get esp_netif glue of the device
+ *
+ * Attach the glue to esp_netif created with ESP_NETIF_DEFAULT_ETH() configuration:
+ * esp_netif_attach(netif, cdc_ncm_host_get_netif_glue(ncm_hdl)).
+ * Received frames are then passed to the TCP/IP stack instead of rx_cb,
+ * the link state is reported to esp_netif and the MAC address of the device is used.
+ *
+ * @param[in] ncm_hdl CDC-NCM device handle
+ * @return esp_netif driver handle
+ */
+esp_netif_iodriver_handle cdc_ncm_host_get_netif_glue(cdc_ncm_dev_hdl_t ncm_hdl);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,96 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// NCM Transfer Block with 16-bit offsets (NTB16), see USB CDC NCM specification v1.0, chapter 3
+#define CDC_NCM_NTH16_SIGNATURE      (0x484D434E) // "NCMH"
+#define CDC_NCM_NDP16_SIGNATURE      (0x304D434E) // "NCM0", datagrams without CRC
+#define CDC_NCM_NTH16_SIZE           (12)
+#define CDC_NCM_NDP16_HEADER_SIZE    (8)
+#define CDC_NCM_NDP16_ENTRY_SIZE     (4)
+#define CDC_NCM_NTB_MAX_DATAGRAMS    (32)         // Maximum number of datagrams in transmitted NTB
+#define CDC_NCM_NTB_MAX_NDPS         (8)          // Maximum number of NDPs in received NTB
+
+// NTB parameters of the device for transmitted NTBs
+typedef struct {
+    size_t max_size;              // Maximum length of NTB, dwNtbOutMaxSize
+    uint16_t divisor;             // Datagram alignment divisor, wNdpOutDivisor
+    uint16_t remainder;           // Datagram alignment remainder, wNdpOutPayloadRemainder
+    uint16_t ndp_alignment;       // NDP alignment, wNdpOutAlignment
+    uint16_t max_datagrams;       // Maximum number of datagrams in NTB, wNtbOutMaxDatagrams. 0: No limit
+} cdc_ncm_ntb_params_t;
+
+// Builder of transmitted NTB16. The datagrams are copied to the NTB buffer, NDP is placed after the last datagram
+typedef struct {
+    uint8_t *buf;                 // NTB buffer
+    size_t size;                  // Usable size of NTB buffer
+    size_t len;                   // End of the last datagram
+    cdc_ncm_ntb_params_t params;  // NTB parameters of the device
+    unsigned num;                 // Number of datagrams in the NTB
+    uint16_t datagrams[CDC_NCM_NTB_MAX_DATAGRAMS][2]; // Index and length of datagrams
+} cdc_ncm_ntb_builder_t;
+
+typedef void (*cdc_ncm_datagram_cb_t)(const uint8_t *datagram, size_t datagram_len, void *arg);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Parse received NTB16 and pass its datagrams to the callback
+ *
+ * @param[in] ntb     Received NTB
+ * @param[in] ntb_len Number of received bytes
+ * @param[in] cb      Called for each datagram, the datagram points into the NTB
+ * @param[in] cb_arg  Argument of the callback
+ * @return
+ *     - ESP_OK: NTB was parsed
+ *     - ESP_ERR_INVALID_SIZE: NTB is not complete, more data must be received
+ *     - ESP_ERR_INVALID_RESPONSE: NTB is malformed. Datagrams before the malformed part were passed to the callback
+ */
+esp_err_t cdc_ncm_ntb_parse(const uint8_t *ntb, size_t ntb_len, cdc_ncm_datagram_cb_t cb, void *cb_arg);
+
+/**
+ * @brief Start new NTB16 in a buffer
+ *
+ * @param[out] builder NTB builder
+ * @param[in]  buf     NTB buffer
+ * @param[in]  size    Size of NTB buffer, it is limited by max_size of the parameters
+ * @param[in]  params  NTB parameters of the device
+ */
+void cdc_ncm_ntb_init(cdc_ncm_ntb_builder_t *builder, uint8_t *buf, size_t size, const cdc_ncm_ntb_params_t *params);
+
+/**
+ * @brief Add datagram to NTB
+ *
+ * @param[in] builder      NTB builder
+ * @param[in] datagram     Datagram (Ethernet frame)
+ * @param[in] datagram_len Length of the datagram
+ * @return true: The datagram was added, false: The NTB is full
+ */
+bool cdc_ncm_ntb_add(cdc_ncm_ntb_builder_t *builder, const uint8_t *datagram, size_t datagram_len);
+
+/**
+ * @brief Finish NTB: write NTH16 and NDP16
+ *
+ * A padding byte is added if the NTB length is a multiple of mps, so the NTB is terminated by short packet
+ * and no zero length packet is needed.
+ *
+ * @param[in] builder  NTB builder with at least one datagram
+ * @param[in] sequence Sequence number of the NTB
+ * @param[in] mps      Maximum packet size of OUT endpoint
+ * @return Length of the NTB
+ */
+size_t cdc_ncm_ntb_finish(cdc_ncm_ntb_builder_t *builder, uint16_t sequence, uint16_t mps);
+
+#ifdef __cplusplus
+}
+#endif
@@ -36,6 +36,7 @@ public:
      * @brief Set Line Coding method
      *
      * @note Overrides default implementation in CDC-ACM driver
+     * @note Only settings that differ from the last written ones are sent to the device
      * @param[in] line_coding Line Coding structure
      * @return esp_err_t
      */
@@ -45,6 +46,7 @@ public:
      * @brief Set Control Line State method
      *
      * @note Overrides default implementation in CDC-ACM driver
+     * @note Both signals are written in one request, which is skipped if they did not change
      * @note Both signals are active low
      * @param[in] dtr Indicates to DCE if DTE is present or not. This signal corresponds to V.24 signal 108/2 and RS-232 signal Data Terminal Ready.
      * @param[in] rts Carrier control for half duplex modems. This signal corresponds to V.24 signal 105 and RS-232 signal Request To Send.
@@ -52,12 +54,26 @@ public:
      */
     esp_err_t set_control_line_state(bool dtr, bool rts);
 
+    /**
+     * @brief Set hardware flow control
+     *
+     * With RTS/CTS flow control the device stops sending when CTS is deasserted
+     * and deasserts RTS when its RX buffer is full.
+     *
+     * @param[in] rts_cts Enable RTS/CTS flow control
+     * @return esp_err_t
+     */
+    esp_err_t set_flow_control(bool rts_cts);
+
     // List of supported VIDs and PIDs
     static constexpr uint16_t vid = NANJING_QINHENG_MICROE_VID;
     static constexpr std::array<uint16_t, 3> pids = {CH340_PID, CH340_PID_1, CH341_PID};
 
 private:
     const uint8_t intf;
+    uint16_t reg_baud;      // Last written value of baud rate registers, 0 if not written yet
+    uint8_t reg_lcr;        // Last written value of LCR, 0 if not written yet
+    uint16_t reg_modem_out; // Last written value of modem output (DTR, RTS), 0xFFFF if not written yet
 
     // Make open functions from CdcAcmDevice class private
     using CdcAcmDevice::open;
@@ -65,7 +81,24 @@ private:
     using CdcAcmDevice::send_break; // Break is not supported by CH34x
     using CdcAcmDevice::line_coding_get; // Manufacturer doesn't provide enough information to implement this
 
-    // This function comes from official Linux driver
-    static int calculate_baud_divisor(unsigned int baud_rate, unsigned char *factor, unsigned char *divisor);
+    /**
+     * @brief Write two registers in one control request
+     *
+     * @param[in] reg_lo Register written with low byte of value
+     * @param[in] reg_hi Register written with high byte of value
+     * @param[in] value  Register values
+     * @return esp_err_t
+     */
+    esp_err_t write_reg(uint8_t reg_lo, uint8_t reg_hi, uint16_t value);
+
+    /**
+     * @brief Calculate prescaler and divisor registers for baud rate
+     *
+     * @param[in]  baud_rate Baud rate, 50 - 2000000
+     * @param[out] prescaler Value of prescaler register, without bit 7
+     * @param[out] divisor   Value of divisor register
+     * @return 0: Success, -1: The baud rate can't be set
+     */
+    static int calculate_baud_divisor(uint32_t baud_rate, uint8_t *prescaler, uint8_t *divisor);
 };
 } // namespace esp_usb
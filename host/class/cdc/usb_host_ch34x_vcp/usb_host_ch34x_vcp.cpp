@@ -5,6 +5,7 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <inttypes.h>
 #include "usb/vcp_ch34x.hpp"
 #include "usb/usb_types_ch9.h"
 #include "esp_log.h"
@@ -35,6 +36,7 @@
 #define CH34X_CONTROL_OUT 0x10
 #define CH34X_CONTROL_DTR 0x20
 #define CH34X_CONTROL_RTS 0x40
+#define CH34X_CONTROL_UNKNOWN 0xFFFF // Modem output not written yet
 
 // Uart state
 #define CH34X_UART_STATE 0x00
@@ -45,9 +47,15 @@
 #define CH34X_UART_RECV_ERROR 0x02
 #define CH34X_UART_STATE_TRANSIENT_MASK 0x07
 
-//CH34x Baud Rate
-#define CH34x_BAUDRATE_FACTOR 1532620800
-#define CH34x_BAUDRATE_DIVMAX 3
+// Baud rate registers: 0x12 prescaler, 0x13 divisor
+// Baud rate = 48 MHz / 2^(12 - 3 * prescaler - factor) / divisor
+#define CH34x_REG_PRESCALER    0x12
+#define CH34x_REG_DIVISOR      0x13
+#define CH34x_PRESCALER_NO_BUFFER 0x80 // Do not wait for full packet before sending RX data
+#define CH34x_PRESCALER_FACTOR 0x04
+#define CH34x_CLK_RATE         48000000
+#define CH34x_BAUDRATE_MIN     50
+#define CH34x_BAUDRATE_MAX     2000000
 
 // Line Coding Register (LCR)
 #define CH34x_REG_LCR          0x18
@@ -61,12 +69,17 @@
 #define CH34x_LCR_CS7          0x02
 #define CH34x_LCR_CS6          0x01
 #define CH34x_LCR_CS5          0x00
+#define CH34x_REG_LCR2         0x25
+
+// Hardware flow control register
+#define CH34x_REG_FLOW_CTRL    0x27
+#define CH34x_FLOW_CTRL_RTSCTS 0x01
 
 static const char *TAG = "CH34X";
 
 namespace esp_usb {
 CH34x::CH34x(uint16_t pid, const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx)
-    : intf(interface_idx)
+    : intf(interface_idx), reg_baud(0), reg_lcr(0), reg_modem_out(CH34X_CONTROL_UNKNOWN)
 {
     const esp_err_t err = this->open_vendor_specific(vid, pid, this->intf, dev_config);
     if (err != ESP_OK) {
@@ -80,13 +93,15 @@ esp_err_t CH34x::line_coding_set(cdc_acm_line_coding_t *line_coding)
 
     // Baudrate
     if (line_coding->dwDTERate != 0) {
-        uint8_t factor, divisor;
-        if (calculate_baud_divisor(line_coding->dwDTERate, &factor, &divisor) != 0) {
+        uint8_t prescaler, divisor;
+        if (calculate_baud_divisor(line_coding->dwDTERate, &prescaler, &divisor) != 0) {
             return ESP_ERR_INVALID_ARG;
         }
-        uint16_t baud_reg_val = (factor << 8) | divisor;
-        baud_reg_val |= BIT7;
-        ESP_RETURN_ON_ERROR(this->send_custom_request(CH34X_WRITE_REQ, CH34X_CMD_WRITE, 0x1312, baud_reg_val, 0, NULL), TAG, "Set baudrate failed");
+        const uint16_t baud_reg_val = (divisor << 8) | prescaler | CH34x_PRESCALER_NO_BUFFER;
+        if (baud_reg_val != this->reg_baud) {
+            ESP_RETURN_ON_ERROR(this->write_reg(CH34x_REG_PRESCALER, CH34x_REG_DIVISOR, baud_reg_val), TAG, "Set baudrate failed");
+            this->reg_baud = baud_reg_val;
+        }
     }
 
     // Line coding
@@ -137,8 +152,10 @@ esp_err_t CH34x::line_coding_set(cdc_acm_line_coding_t *line_coding)
             return ESP_ERR_INVALID_ARG; // 1.5 stop bits not supported
         }
 
-        ESP_RETURN_ON_ERROR(this->send_custom_request(CH34X_WRITE_REQ, CH34X_CMD_WRITE, 0x2518, lcr, 0, NULL), TAG,
-                            "Set line coding failed");
+        if (lcr != this->reg_lcr) {
+            ESP_RETURN_ON_ERROR(this->write_reg(CH34x_REG_LCR, CH34x_REG_LCR2, lcr), TAG, "Set line coding failed");
+            this->reg_lcr = lcr;
+        }
     }
 
     return ESP_OK;
@@ -153,58 +170,59 @@ esp_err_t CH34x::set_control_line_state(bool dtr, bool rts)
     if (rts) {
         wValue |= CH34X_CONTROL_RTS;
     }
-    return this->send_custom_request(CH34X_WRITE_REQ, CH34X_CMD_MODEM_OUT, wValue, this->intf, 0, NULL);
+    if (wValue == this->reg_modem_out) {
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_ERROR(this->send_custom_request(CH34X_WRITE_REQ, CH34X_CMD_MODEM_OUT, wValue, this->intf, 0, NULL), TAG, "Set modem control failed");
+    this->reg_modem_out = wValue;
+    return ESP_OK;
 }
 
-int CH34x::calculate_baud_divisor(unsigned int baud_rate, unsigned char *factor, unsigned char *divisor)
+esp_err_t CH34x::set_flow_control(bool rts_cts)
 {
-    unsigned char a;
-    unsigned char b;
-    unsigned long c;
+    const uint8_t flow = rts_cts ? CH34x_FLOW_CTRL_RTSCTS : 0;
+    return this->write_reg(CH34x_REG_FLOW_CTRL, CH34x_REG_FLOW_CTRL, (flow << 8) | flow);
+}
 
-    assert(factor);
+esp_err_t CH34x::write_reg(uint8_t reg_lo, uint8_t reg_hi, uint16_t value)
+{
+    // One request writes two registers: low byte of wIndex to reg_lo, high byte to reg_hi
+    return this->send_custom_request(CH34X_WRITE_REQ, CH34X_CMD_WRITE, (reg_hi << 8) | reg_lo, value, 0, NULL);
+}
+
+int CH34x::calculate_baud_divisor(uint32_t baud_rate, uint8_t *prescaler, uint8_t *divisor)
+{
+    assert(prescaler);
     assert(divisor);
 
-    switch (baud_rate) {
-    case 921600:
-        a = 0xf3;
-        b = 7;
-        break;
-    case 307200:
-        a = 0xd9;
-        b = 7;
-        break;
-    default:
-        if (baud_rate > 6000000 / 255) {
-            b = 3;
-            c = 6000000;
-        } else if (baud_rate > 750000 / 255) {
-            b = 2;
-            c = 750000;
-        } else if (baud_rate > 93750 / 255) {
-            b = 1;
-            c = 93750;
-        } else {
-            b = 0;
-            c = 11719;
-        }
+    if (baud_rate < CH34x_BAUDRATE_MIN || baud_rate > CH34x_BAUDRATE_MAX) {
+        return -1; // Can't set required baud rate
+    }
 
-        a = (unsigned char)(c / baud_rate);
-        if (a == 0 || a == 0xFF) {
-            return -1; // Can't set required baud rate
+    // Try all prescalers and both base clock factors, keep the setting with the smallest error.
+    // Lower base clock (factor 0) is preferred on equal error, it makes the receiver more tolerant
+    uint32_t best_error = UINT32_MAX;
+    for (int factor = 0; factor <= 1; factor++) {
+        for (int ps = 3; ps >= 0; ps--) {
+            const uint32_t clk = CH34x_CLK_RATE >> (12 - 3 * ps - factor);
+            uint32_t div = (clk + baud_rate / 2) / baud_rate;
+            const uint32_t div_min = factor ? 9 : 2; // Higher base clock can't be used with small divisors
+            if (div < div_min || div > 255) {
+                continue;
+            }
+            const uint32_t real = clk / div;
+            const uint32_t error = (real > baud_rate) ? real - baud_rate : baud_rate - real;
+            if (error < best_error) {
+                best_error = error;
+                *prescaler = (factor ? CH34x_PRESCALER_FACTOR : 0) | ps;
+                *divisor = 256 - div;
+            }
         }
-        // Deal with integer division
-        const int delta_0 = c / a - baud_rate;
-        const int delta_1 = baud_rate - c / (a + 1);
-        if (delta_0 > delta_1) {
-            a++;
-        }
-        a = 256 - a;
-        break;
     }
-
-    *factor = a;
-    *divisor = b;
+    if (best_error == UINT32_MAX) {
+        return -1;
+    }
+    ESP_LOGD(TAG, "Baudrate required: %" PRIu32 ", prescaler: 0x%02X, divisor: 0x%02X", baud_rate, *prescaler, *divisor);
     return 0;
 }
 }
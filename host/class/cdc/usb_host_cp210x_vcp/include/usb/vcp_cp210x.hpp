@@ -54,6 +54,8 @@ public:
      * @brief Constructor for this CP210x driver
      *
      * @note USB Host library and CDC-ACM driver must be already installed
+     * @note If both data_cb and event_cb are set, line and modem status is embedded in RX data (EMBED_EVENTS)
+     *       and reported as CDC_ACM_HOST_SERIAL_STATE events, without any additional transfers
      *
      * @param[in] pid            PID eg. CP210X_PID
      * @param[in] dev_config     CDC device configuration
@@ -77,6 +79,7 @@ public:
      *
      * @see AN571: CP210x Virtual COM Port Interface chapters 5.5 and 5.7
      * @note Overrides default implementation in CDC-ACM driver
+     * @note Only settings that differ from the last written ones are sent to the device
      * @param[in] line_coding Line Coding structure
      * @return esp_err_t
      */
@@ -87,6 +90,7 @@ public:
      *
      * @see AN571: CP210x Virtual COM Port Interface chapter 5.9
      * @note Overrides default implementation in CDC-ACM driver
+     * @note Both signals are written in one request, which is skipped if they did not change
      * @note Both signals are active low
      * @param[in] dtr Indicates to DCE if DTE is present or not. This signal corresponds to V.24 signal 108/2 and RS-232 signal Data Terminal Ready.
      * @param[in] rts Carrier control for half duplex modems. This signal corresponds to V.24 signal 105 and RS-232 signal Request To Send.
@@ -110,6 +114,61 @@ public:
 
 private:
     const uint8_t intf;
+    uint32_t baudrate; // Last written baud rate, 0 if not written yet
+    uint16_t line_ctl; // Last written value of SET_LINE_CTL, 0 if not written yet
+    uint16_t mhs;      // Last written value of SET_MHS, 0xFFFF if not written yet
+
+    // Embedded events
+    enum class rx_state_t : uint8_t {
+        DATA,           // Received bytes are data
+        ESCAPE,         // Escape character received, next byte is the escape sequence type
+        LSR_DATA_0,     // Next byte is line status, followed by a data byte
+        LSR_DATA_1,     // Next byte is data received with the line status error
+        LSR,            // Next byte is line status
+        MSR,            // Next byte is modem status
+    };
+    const bool embed_events;    // Line and modem status is embedded in RX data, enabled if both data and event callbacks are set
+    const cdc_acm_data_callback_t user_data_cb;
+    const cdc_acm_host_dev_callback_t user_event_cb;
+    void *user_arg;
+    uint16_t uart_state;
+    rx_state_t rx_state;        // State of escape sequence decoder
+    uint8_t lsr;                // Line status of the pending LSR_DATA sequence
+    uint8_t msr;                // Last received modem status
+    const uint8_t *rx_raw_end;  // End of received data that were not processed by user, next data are appended here
+    uint8_t *rx_payload_end;    // End of decoded payload that was not processed by user
+
+    /**
+     * @brief CP210x's RX data handler for embedded events
+     *
+     * With EMBED_EVENTS enabled, CP210x inserts escape sequences in RX data. They are removed and the payload
+     * is compacted in place, line and modem status changes are dispatched as CDC_ACM_HOST_SERIAL_STATE events.
+     * Escape sequences, starting with escape character 0xEC:
+     * - 0xEC 0x00:          Escape character received as data
+     * - 0xEC 0x01 LSR DATA: Data byte received with line status error
+     * - 0xEC 0x02 LSR:      Line status changed
+     * - 0xEC 0x03 MSR:      Modem status changed
+     * Line status: Bit 1 overrun, Bit 2 parity error, Bit 3 framing error, Bit 4 break received
+     * Modem status: Bit 4 CTS, Bit 5 DSR, Bit 6 RI, Bit 7 DCD, lower bits are deltas
+     *
+     * @see AN571: CP210x Virtual COM Port Interface chapter 5.24
+     * @param[in] data     Received data
+     * @param[in] data_len Received data length
+     * @param[in] user_arg Pointer to CP210x class
+     */
+    static bool cp210x_rx(const uint8_t *data, size_t data_len, void *user_arg);
+
+    /**
+     * @brief Dispatch serial state if it has changed
+     *
+     * Errors of line status are reported once, modem lines are kept from the last modem status.
+     *
+     * @param[in] lsr Line status, 0 if not received
+     */
+    void serial_state_update(uint8_t lsr);
+
+    // Just a wrapper to recover user's argument
+    static void cp210x_event(const cdc_acm_host_dev_event_data_t *event, void *user_ctx);
 
     // Make open functions from CdcAcmDevice class private
     using CdcAcmDevice::open;
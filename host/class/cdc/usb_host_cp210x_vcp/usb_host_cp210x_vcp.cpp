@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <string.h>
 #include "usb/vcp_cp210x.hpp"
 #include "usb/usb_types_ch9.h"
 #include "esp_log.h"
@@ -19,12 +20,49 @@
 #define CP210X_READ_REQ  (USB_BM_REQUEST_TYPE_TYPE_VENDOR | USB_BM_REQUEST_TYPE_RECIP_INTERFACE | USB_BM_REQUEST_TYPE_DIR_IN)
 #define CP210X_WRITE_REQ (USB_BM_REQUEST_TYPE_TYPE_VENDOR | USB_BM_REQUEST_TYPE_RECIP_INTERFACE | USB_BM_REQUEST_TYPE_DIR_OUT)
 
+#define CP210X_MHS_DTR     0x0001
+#define CP210X_MHS_RTS     0x0002
+#define CP210X_MHS_MASK    0x0300 // Both DTR and RTS are written
+#define CP210X_MHS_UNKNOWN 0xFFFF // Modem handshaking not written yet
+
+// EMBED_EVENTS: Escape character and the escape sequences it starts, @see AN571 chapter 5.24
+#define CP210X_ESCCHAR         0xEC
+#define CP210X_ESC_ESCCHAR     0x00 // Escape character was received as data
+#define CP210X_ESC_LSR_DATA    0x01 // Line status followed by the received data byte
+#define CP210X_ESC_LSR         0x02 // Line status
+#define CP210X_ESC_MSR         0x03 // Modem status
+
+// Line status
+#define CP210X_LSR_OVERRUN     0x02
+#define CP210X_LSR_PARITY      0x04
+#define CP210X_LSR_FRAME       0x08
+#define CP210X_LSR_BREAK       0x10
+
+// Modem status
+#define CP210X_MSR_DSR         0x20
+#define CP210X_MSR_RING        0x40
+#define CP210X_MSR_DCD         0x80
+
 namespace esp_usb {
 CP210x::CP210x(uint16_t pid, const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx)
-    : intf(interface_idx)
+    : intf(interface_idx), baudrate(0), line_ctl(0), mhs(CP210X_MHS_UNKNOWN),
+      embed_events(dev_config->data_cb && dev_config->event_cb), user_data_cb(dev_config->data_cb),
+      user_event_cb(dev_config->event_cb), user_arg(dev_config->user_arg), uart_state(0),
+      rx_state(rx_state_t::DATA), lsr(0), msr(0), rx_raw_end(nullptr), rx_payload_end(nullptr)
 {
+    cdc_acm_host_device_config_t cp210x_config;
+    memcpy(&cp210x_config, dev_config, sizeof(cdc_acm_host_device_config_t));
+
+    // With embedded events, line and modem status is inserted in RX data
+    // so here we override the RX handler with our own
+    if (this->embed_events) {
+        cp210x_config.data_cb = cp210x_rx;
+        cp210x_config.event_cb = cp210x_event;
+        cp210x_config.user_arg = this;
+    }
+
     esp_err_t err;
-    err = this->open_vendor_specific(vid, pid, this->intf, dev_config);
+    err = this->open_vendor_specific(vid, pid, this->intf, &cp210x_config);
     if (err != ESP_OK) {
         throw (err);
     }
@@ -34,6 +72,13 @@ CP210x::CP210x(uint16_t pid, const cdc_acm_host_device_config_t *dev_config, uin
     if (err != ESP_OK) {
         throw (err);
     }
+
+    if (this->embed_events) {
+        err = this->send_custom_request(CP210X_WRITE_REQ, CP210X_CMD_EMBED_EVENTS, CP210X_ESCCHAR, this->intf, 0, NULL);
+        if (err != ESP_OK) {
+            throw (err);
+        }
+    }
 };
 
 esp_err_t CP210x::line_coding_get(cdc_acm_line_coding_t *line_coding)
@@ -55,21 +100,31 @@ esp_err_t CP210x::line_coding_set(cdc_acm_line_coding_t *line_coding)
 {
     assert(line_coding);
 
-    if (line_coding->dwDTERate != 0) {
+    // Only settings that differ from the last written ones are sent to the device
+    if (line_coding->dwDTERate != 0 && line_coding->dwDTERate != this->baudrate) {
         ESP_RETURN_ON_ERROR(this->send_custom_request(CP210X_WRITE_REQ, CP210X_CMD_SET_BAUDRATE, 0, this->intf, sizeof(line_coding->dwDTERate), (uint8_t *)&line_coding->dwDTERate), "CP210X",);
+        this->baudrate = line_coding->dwDTERate;
     }
 
     if (line_coding->bDataBits != 0) {
         const uint16_t wValue = line_coding->bCharFormat | (line_coding->bParityType << 4) | (line_coding->bDataBits << 8);
-        return this->send_custom_request(CP210X_WRITE_REQ, CP210X_CMD_SET_LINE_CTL, wValue, this->intf, 0, NULL);
+        if (wValue != this->line_ctl) {
+            ESP_RETURN_ON_ERROR(this->send_custom_request(CP210X_WRITE_REQ, CP210X_CMD_SET_LINE_CTL, wValue, this->intf, 0, NULL), "CP210X",);
+            this->line_ctl = wValue;
+        }
     }
     return ESP_OK;
 }
 
 esp_err_t CP210x::set_control_line_state(bool dtr, bool rts)
 {
-    const uint16_t wValue = (uint16_t)dtr | ((uint16_t)rts << 1) | 0x0300;
-    return this->send_custom_request(CP210X_WRITE_REQ, CP210X_CMD_SET_MHS, wValue, this->intf, 0, NULL);
+    const uint16_t wValue = (dtr ? CP210X_MHS_DTR : 0) | (rts ? CP210X_MHS_RTS : 0) | CP210X_MHS_MASK;
+    if (wValue == this->mhs) {
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_ERROR(this->send_custom_request(CP210X_WRITE_REQ, CP210X_CMD_SET_MHS, wValue, this->intf, 0, NULL), "CP210X",);
+    this->mhs = wValue;
+    return ESP_OK;
 }
 
 esp_err_t CP210x::send_break(uint16_t duration_ms)
@@ -78,4 +133,117 @@ esp_err_t CP210x::send_break(uint16_t duration_ms)
     vTaskDelay(pdMS_TO_TICKS(duration_ms));
     return this->send_custom_request(CP210X_WRITE_REQ, CP210X_CMD_SET_BREAK, 0, this->intf, 0, NULL);
 }
+
+void CP210x::serial_state_update(uint8_t lsr)
+{
+    cdc_acm_uart_state_t new_state;
+    new_state.val = 0;
+    new_state.bRxCarrier =  this->msr & CP210X_MSR_DCD;
+    new_state.bTxCarrier =  this->msr & CP210X_MSR_DSR;
+    new_state.bRingSignal = this->msr & CP210X_MSR_RING;
+    new_state.bBreak =      lsr & CP210X_LSR_BREAK;
+    new_state.bFraming =    lsr & CP210X_LSR_FRAME;
+    new_state.bParity =     lsr & CP210X_LSR_PARITY;
+    new_state.bOverRun =    lsr & CP210X_LSR_OVERRUN;
+
+    if (this->uart_state != new_state.val) {
+        cdc_acm_host_dev_event_data_t serial_event;
+        serial_event.type = CDC_ACM_HOST_SERIAL_STATE;
+        serial_event.data.serial_state = new_state;
+        this->user_event_cb(&serial_event, this->user_arg);
+    }
+
+    // Line status reports single events, only the modem status persists
+    new_state.bBreak = 0;
+    new_state.bFraming = 0;
+    new_state.bParity = 0;
+    new_state.bOverRun = 0;
+    this->uart_state = new_state.val;
+}
+
+bool CP210x::cp210x_rx(const uint8_t *data, size_t data_len, void *user_arg)
+{
+    CP210x *this_cp210x = (CP210x *)user_arg;
+
+    // The data are in IN buffer of CDC-ACM driver and escape sequences only shrink them, so they are decoded in place.
+    // If the user didn't process previous data, CDC-ACM driver appends the new data right after them
+    // and the new payload is moved to the end of the previous payload.
+    uint8_t *buf = const_cast<uint8_t *>(data);
+    const bool append = (this_cp210x->rx_payload_end != nullptr) && (data == this_cp210x->rx_raw_end);
+    uint8_t *payload = append ? this_cp210x->rx_payload_end : buf;
+    uint8_t *payload_end = payload;
+
+    // Escape sequences can be split between transfers, so the decoder state is kept in the class
+    for (size_t i = 0; i < data_len; i++) {
+        const uint8_t ch = buf[i];
+        switch (this_cp210x->rx_state) {
+        case rx_state_t::DATA:
+            if (ch == CP210X_ESCCHAR) {
+                this_cp210x->rx_state = rx_state_t::ESCAPE;
+            } else {
+                *payload_end++ = ch;
+            }
+            break;
+        case rx_state_t::ESCAPE:
+            switch (ch) {
+            case CP210X_ESC_ESCCHAR:
+                *payload_end++ = CP210X_ESCCHAR;
+                this_cp210x->rx_state = rx_state_t::DATA;
+                break;
+            case CP210X_ESC_LSR_DATA:
+                this_cp210x->rx_state = rx_state_t::LSR_DATA_0;
+                break;
+            case CP210X_ESC_LSR:
+                this_cp210x->rx_state = rx_state_t::LSR;
+                break;
+            case CP210X_ESC_MSR:
+                this_cp210x->rx_state = rx_state_t::MSR;
+                break;
+            default:
+                ESP_LOGW("CP210x", "Unexpected escape sequence 0x%02X", ch);
+                this_cp210x->rx_state = rx_state_t::DATA;
+                break;
+            }
+            break;
+        case rx_state_t::LSR_DATA_0:
+            this_cp210x->lsr = ch;
+            this_cp210x->rx_state = rx_state_t::LSR_DATA_1;
+            break;
+        case rx_state_t::LSR_DATA_1:
+            // Data byte received with the line status error
+            this_cp210x->serial_state_update(this_cp210x->lsr);
+            *payload_end++ = ch;
+            this_cp210x->rx_state = rx_state_t::DATA;
+            break;
+        case rx_state_t::LSR:
+            this_cp210x->serial_state_update(ch);
+            this_cp210x->rx_state = rx_state_t::DATA;
+            break;
+        case rx_state_t::MSR:
+            this_cp210x->msr = ch;
+            this_cp210x->serial_state_update(0);
+            this_cp210x->rx_state = rx_state_t::DATA;
+            break;
+        }
+    }
+
+    // Dispatch data if any
+    bool processed = !append; // Keep the previous payload if there are no new data
+    if (payload_end != payload) {
+        processed = this_cp210x->user_data_cb(payload, payload_end - payload, this_cp210x->user_arg);
+    }
+    if (processed) {
+        this_cp210x->rx_payload_end = nullptr;
+    } else {
+        this_cp210x->rx_payload_end = payload_end;
+        this_cp210x->rx_raw_end = data + data_len;
+    }
+    return processed;
+}
+
+void CP210x::cp210x_event(const cdc_acm_host_dev_event_data_t *event, void *user_ctx)
+{
+    CP210x *this_cp210x = (CP210x *)user_ctx;
+    this_cp210x->user_event_cb(event, this_cp210x->user_arg);
+}
 }
@@ -14,6 +14,8 @@
 #define FTDI_VID             (0x0403)
 #define FT232_PID            (0x6001)
 #define FT231_PID            (0x6015)
+#define FT2232_PID           (0x6010) // Dual port
+#define FT4232_PID           (0x6011) // Quad port
 
 #define FTDI_CMD_RESET        (0x00)
 #define FTDI_CMD_SET_FLOW     (0x01)
@@ -21,6 +23,12 @@
 #define FTDI_CMD_SET_BAUDRATE (0x03)
 #define FTDI_CMD_SET_LINE_CTL (0x04)
 #define FTDI_CMD_GET_MDMSTS   (0x05) // Modem status
+#define FTDI_CMD_SET_EVENT_CHAR (0x06)
+#define FTDI_CMD_SET_ERROR_CHAR (0x07)
+#define FTDI_CMD_SET_LATENCY_TIMER (0x09)
+#define FTDI_CMD_GET_LATENCY_TIMER (0x0A)
+
+#define FTDI_LATENCY_TIMER_DEFAULT (16) // Latency timer after reset [ms]
 
 namespace esp_usb {
 class FT23x : public CdcAcmDevice {
@@ -32,7 +40,8 @@ public:
      *
      * @param[in] pid            PID eg. FTDI_FT232_PID
      * @param[in] dev_config     CDC device configuration
-     * @param[in] interface_idx  Interface number
+     * @param[in] interface_idx  Interface number. Ports of multi-port devices (FT2232, FT4232) are interfaces 0 - 3.
+     *                           All ports share one USB device and its control endpoint, so they can be opened at the same time
      * @return CdcAcmDevice      Pointer to created and opened FTDI device
      */
     FT23x(uint16_t pid, const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx = 0);
@@ -41,6 +50,7 @@ public:
      * @brief Set Line Coding method
      *
      * @note Overrides default implementation in CDC-ACM driver
+     * @note Only settings that differ from the last written ones are sent to the device
      * @param[in] line_coding Line Coding structure
      * @return esp_err_t
      */
@@ -50,6 +60,7 @@ public:
      * @brief Set Control Line State method
      *
      * @note Overrides default implementation in CDC-ACM driver
+     * @note Both signals are written in one request, which is skipped if they did not change
      * @note Both signals are active low
      * @param[in] dtr Indicates to DCE if DTE is present or not. This signal corresponds to V.24 signal 108/2 and RS-232 signal Data Terminal Ready.
      * @param[in] rts Carrier control for half duplex modems. This signal corresponds to V.24 signal 105 and RS-232 signal Request To Send.
@@ -57,21 +68,84 @@ public:
      */
     esp_err_t set_control_line_state(bool dtr, bool rts);
 
+    /**
+     * @brief Set latency timer
+     *
+     * The device sends received data when its buffer is full, when the event character is received
+     * or when the latency timer expires. Short latency decreases response time of request/response protocols
+     * at the cost of more USB transfers.
+     *
+     * @param[in] latency_ms Latency timer in [ms], 1 - 255. Default value after reset is 16 ms
+     * @return esp_err_t
+     */
+    esp_err_t set_latency_timer(uint8_t latency_ms);
+
+    /**
+     * @brief Get latency timer
+     *
+     * @param[out] latency_ms Latency timer in [ms]
+     * @return esp_err_t
+     */
+    esp_err_t get_latency_timer(uint8_t *latency_ms);
+
+    /**
+     * @brief Set event character
+     *
+     * When enabled, the device sends received data immediately after the event character is received.
+     *
+     * @param[in] event_char Event character
+     * @param[in] enable     Enable the event character
+     * @return esp_err_t
+     */
+    esp_err_t set_event_char(uint8_t event_char, bool enable);
+
+    /**
+     * @brief Set error character
+     *
+     * When enabled, the device inserts the error character to RX data when a parity error is detected.
+     *
+     * @param[in] error_char Error character
+     * @param[in] enable     Enable the error character
+     * @return esp_err_t
+     */
+    esp_err_t set_error_char(uint8_t error_char, bool enable);
+
+    /**
+     * @brief Calculate IN buffer size for a baud rate
+     *
+     * The returned size holds all data received at the baud rate during one latency period,
+     * including status bytes of every packet. Use it as in_buffer_size of cdc_acm_host_device_config_t.
+     *
+     * @param[in] baudrate   Baud rate of the UART, 10 bits per character are assumed
+     * @param[in] latency_ms Latency timer in [ms]
+     * @param[in] mps        Max packet size of IN endpoint: 64 for Full-speed, 512 for High-speed devices
+     * @return IN buffer size: a multiple of mps, at least one packet
+     */
+    static size_t in_buffer_size_calc(uint32_t baudrate, uint8_t latency_ms = FTDI_LATENCY_TIMER_DEFAULT, uint16_t mps = 64);
+
     // List of supported VIDs and PIDs
     static constexpr uint16_t vid = FTDI_VID;
-    static constexpr std::array<uint16_t, 2> pids = {FT232_PID, FT231_PID};
+    static constexpr std::array<uint16_t, 4> pids = {FT232_PID, FT231_PID, FT2232_PID, FT4232_PID};
 
 private:
     const uint8_t intf;
+    const bool multi_port;      // Multi-port devices address the port in wIndex of vendor requests
     const cdc_acm_data_callback_t user_data_cb;
     const cdc_acm_host_dev_callback_t user_event_cb;
     void *user_arg;
     uint16_t uart_state;
+    uint16_t in_mps;            // Max packet size of IN endpoint, every packet starts with status bytes
+    const uint8_t *rx_raw_end;  // End of received data that were not processed by user, next data are appended here
+    uint8_t *rx_payload_end;    // End of compacted payload that was not processed by user
+    uint32_t baudrate;          // Last written baud rate, 0 if not written yet
+    uint16_t line_ctl;          // Last written value of SET_LINE_CTL, 0 if not written yet
+    uint16_t mhs;               // Last written value of SET_MHS, 0xFFFF if not written yet
 
     /**
      * @brief FT23x's RX data handler
      *
-     * First two bytes are status bytes, the RX data start at data[2].
+     * Every packet of max packet size starts with two status bytes. The status bytes are removed and payload
+     * of all packets is compacted in place, so the user gets contiguous RX data also from multi-packet transfers.
      * Coding of status bytes:
      * Byte 0:
      *      Bit 0: Full Speed packet
@@ -96,6 +170,30 @@ private:
      */
     static bool ftdi_rx(const uint8_t *data, size_t data_len, void *user_arg);
 
+    /**
+     * @brief Dispatch serial state if it has changed
+     *
+     * @param[in] status Status bytes of received packet
+     */
+    void serial_state_update(const uint8_t *status);
+
+    /**
+     * @brief Get max packet size of IN endpoint from Configuration descriptor
+     *
+     * @return Max packet size, 64 if the descriptor could not be read
+     */
+    uint16_t in_mps_get();
+
+    /**
+     * @brief Get port index for wIndex of vendor requests
+     *
+     * @return Port index: 1 - 4 for multi-port devices, interface number for single-port devices
+     */
+    uint16_t port_index() const
+    {
+        return this->multi_port ? this->intf + 1 : this->intf;
+    }
+
     // Just a wrapper to recover user's argument
     static void ftdi_event(const cdc_acm_host_dev_event_data_t *event, void *user_ctx);
 
@@ -4,10 +4,12 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <algorithm>
 #include <string.h>
 #include <inttypes.h>
 #include "usb/vcp_ftdi.hpp"
 #include "usb/usb_types_ch9.h"
+#include "usb/usb_helpers.h"
 #include "esp_log.h"
 #include "esp_check.h"
 #include "sdkconfig.h"
@@ -18,11 +20,20 @@
 
 #define FTDI_READ_REQ  (USB_BM_REQUEST_TYPE_TYPE_VENDOR | USB_BM_REQUEST_TYPE_DIR_IN)
 #define FTDI_WRITE_REQ (USB_BM_REQUEST_TYPE_TYPE_VENDOR | USB_BM_REQUEST_TYPE_DIR_OUT)
+#define FTDI_STATUS_LEN (2)  // Every IN packet starts with 2 status bytes
+#define FTDI_CONFIG_DESC_MAX_LEN (56) // Limited by size of CDC-ACM control transfer
+
+// SET_MHS: Line values in low byte, mask of lines to be written in high byte
+#define FTDI_MHS_DTR     (0x0001)
+#define FTDI_MHS_RTS     (0x0002)
+#define FTDI_MHS_MASK    (0x0300) // Both DTR and RTS are written
+#define FTDI_MHS_UNKNOWN (0xFFFF) // Modem handshaking not written yet
 
 namespace esp_usb {
 FT23x::FT23x(uint16_t pid, const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx)
-    : intf(interface_idx), user_data_cb(dev_config->data_cb), user_event_cb(dev_config->event_cb),
-      user_arg(dev_config->user_arg), uart_state(0)
+    : intf(interface_idx), multi_port(pid == FT2232_PID || pid == FT4232_PID), user_data_cb(dev_config->data_cb), user_event_cb(dev_config->event_cb),
+      user_arg(dev_config->user_arg), uart_state(0), in_mps(64), rx_raw_end(nullptr), rx_payload_end(nullptr),
+      baudrate(0), line_ctl(0), mhs(FTDI_MHS_UNKNOWN)
 {
     cdc_acm_host_device_config_t ftdi_config;
     memcpy(&ftdi_config, dev_config, sizeof(cdc_acm_host_device_config_t));
@@ -44,6 +55,7 @@ FT23x::FT23x(uint16_t pid, const cdc_acm_host_device_config_t *dev_config, uint8
     if (err != ESP_OK) {
         throw (err);
     }
+    this->in_mps = in_mps_get();
 
     // FT23x interface must be first reset and configured (115200 8N1)
     err = this->send_custom_request(FTDI_WRITE_REQ, FTDI_CMD_RESET, 0, this->intf + 1, 0, NULL);
@@ -67,55 +79,175 @@ esp_err_t FT23x::line_coding_set(cdc_acm_line_coding_t *line_coding)
 {
     assert(line_coding);
 
-    if (line_coding->dwDTERate != 0) {
+    // Only settings that differ from the last written ones are sent to the device
+    if (line_coding->dwDTERate != 0 && line_coding->dwDTERate != this->baudrate) {
         uint16_t wIndex, wValue;
         calculate_baudrate(line_coding->dwDTERate, &wValue, &wIndex);
+        if (this->multi_port) {
+            wIndex = (wIndex << 8) | this->port_index(); // Divisor bits are in high byte, port in low byte
+        }
         ESP_RETURN_ON_ERROR(this->send_custom_request(FTDI_WRITE_REQ, FTDI_CMD_SET_BAUDRATE, wValue, wIndex, 0, NULL), "FT23x",);
+        this->baudrate = line_coding->dwDTERate;
     }
 
     if (line_coding->bDataBits != 0) {
         const uint16_t wValue = (line_coding->bDataBits) | (line_coding->bParityType << 8) | (line_coding->bCharFormat << 11);
-        return this->send_custom_request(FTDI_WRITE_REQ, FTDI_CMD_SET_LINE_CTL, wValue, this->intf, 0, NULL);
+        if (wValue != this->line_ctl) {
+            ESP_RETURN_ON_ERROR(this->send_custom_request(FTDI_WRITE_REQ, FTDI_CMD_SET_LINE_CTL, wValue, this->port_index(), 0, NULL), "FT23x",);
+            this->line_ctl = wValue;
+        }
     }
     return ESP_OK;
 }
 
 esp_err_t FT23x::set_control_line_state(bool dtr, bool rts)
 {
-    ESP_RETURN_ON_ERROR(this->send_custom_request(FTDI_WRITE_REQ, FTDI_CMD_SET_MHS, dtr ? 0x11 : 0x10, this->intf, 0, NULL), "FT23x",); // DTR
-    return this->send_custom_request(FTDI_WRITE_REQ, FTDI_CMD_SET_MHS, rts ? 0x21 : 0x20, this->intf, 0, NULL); // RTS
+    // DTR and RTS are written in one request
+    const uint16_t wValue = (dtr ? FTDI_MHS_DTR : 0) | (rts ? FTDI_MHS_RTS : 0) | FTDI_MHS_MASK;
+    if (wValue == this->mhs) {
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_ERROR(this->send_custom_request(FTDI_WRITE_REQ, FTDI_CMD_SET_MHS, wValue, this->port_index(), 0, NULL), "FT23x",);
+    this->mhs = wValue;
+    return ESP_OK;
+}
+
+uint16_t FT23x::in_mps_get()
+{
+    uint8_t desc[FTDI_CONFIG_DESC_MAX_LEN] = {0};
+    uint16_t mps = 64;
+
+    // CDC-ACM driver requires the exact length of the response, so get the total length first
+    const uint8_t req_type = USB_BM_REQUEST_TYPE_DIR_IN | USB_BM_REQUEST_TYPE_TYPE_STANDARD | USB_BM_REQUEST_TYPE_RECIP_DEVICE;
+    const uint16_t req_value = USB_B_DESCRIPTOR_TYPE_CONFIGURATION << 8;
+    usb_config_desc_t *config_desc = (usb_config_desc_t *)desc;
+    if (this->send_custom_request(req_type, USB_B_REQUEST_GET_DESCRIPTOR, req_value, 0, sizeof(usb_config_desc_t), desc) != ESP_OK ||
+            this->send_custom_request(req_type, USB_B_REQUEST_GET_DESCRIPTOR, req_value, 0, std::min((size_t)config_desc->wTotalLength, sizeof(desc)), desc) != ESP_OK) {
+        ESP_LOGW("FT23x", "Could not get Configuration descriptor, using max packet size %d", mps);
+        return mps;
+    }
+
+    // Parse only the received part of the descriptor
+    if (config_desc->wTotalLength > sizeof(desc)) {
+        config_desc->wTotalLength = sizeof(desc);
+    }
+    int offset = 0;
+    const usb_intf_desc_t *intf_desc = usb_parse_interface_descriptor(config_desc, this->intf, 0, &offset);
+    if (intf_desc == NULL) {
+        // Interface of this port is not in the received part. All ports of FTDI devices have the same max packet size
+        offset = 0;
+        intf_desc = usb_parse_interface_descriptor(config_desc, 0, 0, &offset);
+    }
+    if (intf_desc == NULL) {
+        return mps;
+    }
+    for (int i = 0; i < intf_desc->bNumEndpoints; i++) {
+        int ep_offset = offset;
+        const usb_ep_desc_t *ep_desc = usb_parse_endpoint_descriptor_by_index(intf_desc, i, config_desc->wTotalLength, &ep_offset);
+        if (ep_desc && USB_EP_DESC_GET_EP_DIR(ep_desc)) {
+            mps = USB_EP_DESC_GET_MPS(ep_desc);
+            break;
+        }
+    }
+    ESP_LOGD("FT23x", "IN max packet size: %d", mps);
+    return mps;
+}
+
+void FT23x::serial_state_update(const uint8_t *status)
+{
+    cdc_acm_uart_state_t new_state;
+    new_state.val = 0;
+    new_state.bRxCarrier =  status[0] & 0x80; // DCD
+    new_state.bTxCarrier =  status[0] & 0x20; // DSR
+    new_state.bBreak =      status[1] & 0x10;
+    new_state.bRingSignal = status[0] & 0x40;
+    new_state.bFraming =    status[1] & 0x08;
+    new_state.bParity =     status[1] & 0x04;
+    new_state.bOverRun =    status[1] & 0x02;
+
+    if (this->uart_state != new_state.val) {
+        cdc_acm_host_dev_event_data_t serial_event;
+        serial_event.type = CDC_ACM_HOST_SERIAL_STATE;
+        serial_event.data.serial_state = new_state;
+        this->user_event_cb(&serial_event, this->user_arg);
+        this->uart_state = new_state.val;
+    }
+}
+
+esp_err_t FT23x::set_latency_timer(uint8_t latency_ms)
+{
+    ESP_RETURN_ON_FALSE(latency_ms != 0, ESP_ERR_INVALID_ARG, "FT23x", "Latency timer must be at least 1 ms");
+    return this->send_custom_request(FTDI_WRITE_REQ, FTDI_CMD_SET_LATENCY_TIMER, latency_ms, this->intf + 1, 0, NULL);
+}
+
+esp_err_t FT23x::get_latency_timer(uint8_t *latency_ms)
+{
+    assert(latency_ms);
+    return this->send_custom_request(FTDI_READ_REQ, FTDI_CMD_GET_LATENCY_TIMER, 0, this->intf + 1, 1, latency_ms);
+}
+
+esp_err_t FT23x::set_event_char(uint8_t event_char, bool enable)
+{
+    return this->send_custom_request(FTDI_WRITE_REQ, FTDI_CMD_SET_EVENT_CHAR, event_char | (enable ? 0x100 : 0), this->intf + 1, 0, NULL);
+}
+
+esp_err_t FT23x::set_error_char(uint8_t error_char, bool enable)
+{
+    return this->send_custom_request(FTDI_WRITE_REQ, FTDI_CMD_SET_ERROR_CHAR, error_char | (enable ? 0x100 : 0), this->intf + 1, 0, NULL);
+}
+
+size_t FT23x::in_buffer_size_calc(uint32_t baudrate, uint8_t latency_ms, uint16_t mps)
+{
+    assert(mps > FTDI_STATUS_LEN);
+    // Bytes received during one latency period, start bit + 8 data bits + stop bit per character
+    const size_t rx_bytes = ((uint64_t)baudrate / 10 * latency_ms + 999) / 1000;
+    const size_t payload_per_packet = mps - FTDI_STATUS_LEN;
+    size_t packets = (rx_bytes + payload_per_packet - 1) / payload_per_packet;
+    if (packets == 0) {
+        packets = 1;
+    }
+    return packets * mps;
 }
 
 bool FT23x::ftdi_rx(const uint8_t *data, size_t data_len, void *user_arg)
 {
     FT23x *this_ftdi = (FT23x *)user_arg;
 
-    // Dispatch serial state if it has changed
-    if (this_ftdi->user_event_cb) {
-        cdc_acm_uart_state_t new_state;
-        new_state.val = 0;
-        new_state.bRxCarrier =  data[0] & 0x80; // DCD
-        new_state.bTxCarrier =  data[0] & 0x20; // DSR
-        new_state.bBreak =      data[1] & 0x10;
-        new_state.bRingSignal = data[0] & 0x40;
-        new_state.bFraming =    data[1] & 0x08;
-        new_state.bParity =     data[1] & 0x04;
-        new_state.bOverRun =    data[1] & 0x02;
-
-        if (this_ftdi->uart_state != new_state.val) {
-            cdc_acm_host_dev_event_data_t serial_event;
-            serial_event.type = CDC_ACM_HOST_SERIAL_STATE;
-            serial_event.data.serial_state = new_state;
-            this_ftdi->user_event_cb(&serial_event, this_ftdi->user_arg);
-            this_ftdi->uart_state = new_state.val;
+    // The data are in IN buffer of CDC-ACM driver, so the payload can be compacted in place.
+    // If the user didn't process previous data, CDC-ACM driver appends the new data right after them
+    // and the new payload is moved to the end of the previous payload.
+    uint8_t *buf = const_cast<uint8_t *>(data);
+    const bool append = (this_ftdi->rx_payload_end != nullptr) && (data == this_ftdi->rx_raw_end);
+    uint8_t *payload = append ? this_ftdi->rx_payload_end : buf + FTDI_STATUS_LEN;
+    uint8_t *payload_end = payload;
+
+    for (size_t offset = 0; offset < data_len; offset += this_ftdi->in_mps) {
+        const size_t packet_len = std::min(data_len - offset, (size_t)this_ftdi->in_mps);
+        if (packet_len < FTDI_STATUS_LEN) {
+            break; // Malformed packet
+        }
+        if (this_ftdi->user_event_cb) {
+            this_ftdi->serial_state_update(&buf[offset]);
+        }
+        const size_t payload_len = packet_len - FTDI_STATUS_LEN;
+        if (payload_end != &buf[offset + FTDI_STATUS_LEN]) {
+            memmove(payload_end, &buf[offset + FTDI_STATUS_LEN], payload_len);
         }
+        payload_end += payload_len;
     }
 
     // Dispatch data if any
-    if (data_len > 2) {
-        return this_ftdi->user_data_cb(&data[2], data_len - 2, this_ftdi->user_arg);
+    bool processed = !append; // Keep the previous payload if there are no new data
+    if (payload_end != payload) {
+        processed = this_ftdi->user_data_cb(payload, payload_end - payload, this_ftdi->user_arg);
+    }
+    if (processed) {
+        this_ftdi->rx_payload_end = nullptr;
+    } else {
+        this_ftdi->rx_payload_end = payload_end;
+        this_ftdi->rx_raw_end = data + data_len;
     }
-    return true;
+    return processed;
 }
 
 void FT23x::ftdi_event(const cdc_acm_host_dev_event_data_t *event, void *user_ctx)
@@ -1,26 +1,109 @@
 /*
- * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2022-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
 
 #pragma once
 
-#include <memory>
-#include <vector>
+#include <stddef.h>
+#include <stdint.h>
 #include "usb/cdc_acm_host.h"
 
 namespace esp_usb {
+namespace vcp_detail {
+/**
+ * @brief Factory method of VCP driver
+ */
+typedef CdcAcmDevice *(*driver_open_t)(uint16_t pid, const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx);
+
+/**
+ * @brief Entry of VID/PID table
+ */
+struct driver_entry {
+    uint16_t vid = 0;                      /*!< VID of the device */
+    uint16_t pid = 0;                      /*!< PID of the device */
+    driver_open_t open = nullptr;          /*!< Factory method of the driver that supports this device */
+};
+
+/**
+ * @brief Lookup of driver entry by VID and PID
+ */
+typedef const driver_entry *(*driver_find_t)(uint16_t vid, uint16_t pid);
+
+/**
+ * @brief Callback of VCP service with opened device
+ *
+ * @param[in] vcp  Opened device, the callee takes ownership and deletes it when no longer needed
+ * @param[in] vid  VID of the device
+ * @param[in] pid  PID of the device
+ * @param[in] arg  User's argument passed to VCP::start()
+ */
+typedef void (*device_callback_t)(CdcAcmDevice *vcp, uint16_t vid, uint16_t pid, void *arg);
+
+template<class T> CdcAcmDevice *
+driver_open(uint16_t pid, const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx)
+{
+    return static_cast<CdcAcmDevice *>(new T(pid, dev_config, interface_idx));
+}
+
+template<class... Drivers> constexpr size_t pid_count()
+{
+    const size_t counts[] = {Drivers::pids.size()...};
+    size_t sum = 0;
+    for (size_t c : counts) {
+        sum += c;
+    }
+    return sum;
+}
+
+template<class T> constexpr void add_entries(driver_entry *entries, size_t &n)
+{
+    static_assert(T::pids.size() != 0, "Every VCP driver must contain array of supported PIDs in 'pids' array");
+    static_assert(T::vid != 0, "Every VCP driver must contain supported VID in'vid' integer");
+    for (size_t i = 0; i < T::pids.size(); i++) {
+        entries[n].vid = T::vid;
+        entries[n].pid = T::pids[i];
+        entries[n].open = &driver_open<T>;
+        n++;
+    }
+}
+
+constexpr uint32_t entry_key(const driver_entry &e)
+{
+    return (static_cast<uint32_t>(e.vid) << 16) | e.pid;
+}
+
+/**
+ * @brief Binary search in sorted VID/PID table
+ */
+const driver_entry *find(const driver_entry *entries, size_t size, uint16_t vid, uint16_t pid);
+} // namespace vcp_detail
+
 /**
  * @brief Virtual COM Port Service Class
  *
  * Virtual COM Port (VCP) service manages drivers to connected VCP devices - typically USB <-> UART converters.
  * In practice, you rarely care about specifics of the devices; you only want uniform interface for them all.
- * VCP service does just that, after you register drivers for various VCP devices, you can just call VCP::open
+ * VCP service does just that, after you select drivers for various VCP devices, you can just call open
  * and the service will load proper driver for device that was just plugged into USB port.
  *
+ * The drivers are selected at compile time with VCP::registry. The registry contains sorted VID/PID table
+ * that is built by the compiler, so no memory is allocated and the driver is found by binary search.
+ *
  * Example usage:
  * \code{.cpp}
+ * using Drivers = VCP::registry<FT23x, CP210x, CH34x>;
+ * auto vcp = Drivers::open(&dev_config);
+ * \endcode
+ *
+ * Instead of opening one device, the VCP service can open every supported device as it is connected:
+ * \code{.cpp}
+ * Drivers::start(&dev_config, device_cb, arg); // device_cb is called with each opened device
+ * \endcode
+ *
+ * The drivers can also be registered at run time:
+ * \code{.cpp}
  * VCP::register_driver<FT23x>();
  * VCP::register_driver<CP210x>();
  * VCP::register_driver<CH34x>();
@@ -31,27 +114,132 @@ namespace esp_usb {
  */
 class VCP {
 public:
+    typedef vcp_detail::driver_open_t driver_open_t;  /*!< Factory method of VCP driver */
+    typedef vcp_detail::driver_entry driver_entry;    /*!< Entry of VID/PID table */
+    typedef vcp_detail::driver_find_t driver_find_t;  /*!< Lookup of driver entry by VID and PID */
+    typedef vcp_detail::device_callback_t device_callback_t; /*!< Callback of VCP service with opened device */
+
     /**
-     * @brief Register VCP driver to VCP service
+     * @brief Compile-time registry of VCP drivers
      *
-     * To fully leverage from VCP service functionalities, you must register VCP drivers first.
      * The driver must contain the following public members/methods;
      * #. vid: Supported VID
      * #. pids: Array of supported PIDs
      * # Constructor with (uint16_t pid, const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx) input parameters
      *
+     * @tparam Drivers VCP driver types
+     */
+    template<class... Drivers> class registry {
+    public:
+        /**
+         * @brief Number of entries in VID/PID table
+         */
+        static constexpr size_t size = vcp_detail::pid_count<Drivers...>();
+
+        /**
+         * @brief Find driver entry of a device
+         *
+         * @param[in] vid VID of the device
+         * @param[in] pid PID of the device
+         * @return Entry of VID/PID table or nullptr if no driver supports the device
+         */
+        static const driver_entry *find(uint16_t vid, uint16_t pid)
+        {
+            static_assert(is_unique(), "VID/PID is supported by more VCP drivers in the registry");
+            return vcp_detail::find(table.entries, size, vid, pid);
+        }
+
+        /**
+         * @brief VCP factory with VID and PID
+         *
+         * @see VCP::open(uint16_t, uint16_t, const cdc_acm_host_device_config_t *, uint8_t)
+         */
+        static CdcAcmDevice *open(uint16_t _vid, uint16_t _pid, const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx = 0)
+        {
+            return VCP::open_driver(find, _vid, _pid, dev_config, interface_idx);
+        }
+
+        /**
+         * @brief VCP factory
+         *
+         * @see VCP::open(const cdc_acm_host_device_config_t *, uint8_t)
+         */
+        static CdcAcmDevice *open(const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx = 0)
+        {
+            const driver_node node = {table.entries, size, nullptr};
+            return VCP::open_any(find, &node, dev_config, interface_idx);
+        }
+
+        /**
+         * @brief Start VCP service with drivers of this registry
+         *
+         * @see VCP::start(const cdc_acm_host_device_config_t *, device_callback_t, void *, uint8_t)
+         */
+        static esp_err_t start(const cdc_acm_host_device_config_t *dev_config, device_callback_t device_cb, void *arg = nullptr, uint8_t interface_idx = 0)
+        {
+            return VCP::start_service(find, dev_config, device_cb, arg, interface_idx);
+        }
+
+    private:
+        friend class VCP;
+        static_assert(sizeof...(Drivers) > 0, "VCP registry must contain at least one driver");
+
+        struct table_t {
+            driver_entry entries[size];
+        };
+
+        static constexpr table_t make_table()
+        {
+            table_t t{};
+            size_t n = 0;
+            int expand[] = {(vcp_detail::add_entries<Drivers>(t.entries, n), 0)...};
+            (void)expand;
+
+            // Insertion sort by VID and PID
+            for (size_t i = 1; i < size; i++) {
+                const driver_entry e = t.entries[i];
+                size_t j = i;
+                for (; j > 0 && vcp_detail::entry_key(t.entries[j - 1]) > vcp_detail::entry_key(e); j--) {
+                    t.entries[j] = t.entries[j - 1];
+                }
+                t.entries[j] = e;
+            }
+            return t;
+        }
+
+        static constexpr bool is_unique()
+        {
+            const table_t t = make_table();
+            for (size_t i = 1; i < size; i++) {
+                if (vcp_detail::entry_key(t.entries[i - 1]) == vcp_detail::entry_key(t.entries[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static constexpr table_t table = make_table();
+    };
+
+    /**
+     * @brief Register VCP driver to VCP service
+     *
+     * Run-time alternative to VCP::registry. The drivers registered by this function are used by VCP::open.
+     * No memory is allocated, registering the same driver again has no effect.
+     *
      * @tparam T VCP driver type
      */
     template<class T> static void
     register_driver(void)
     {
-        static_assert(T::pids.begin() != nullptr, "Every VCP driver must contain array of supported PIDs in 'pids' array");
-        static_assert(T::vid != 0, "Every VCP driver must contain supported VID in'vid' integer");
-        std::vector<uint16_t> pids(T::pids.begin(), T::pids.end()); // Convert array to vector
-        vcp_driver new_driver = vcp_driver([](uint16_t pid, const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx) {
-            return static_cast<CdcAcmDevice *> (new T(pid, dev_config, interface_idx)); // Lambda function: Open factory method
-        }, T::vid, pids);
-        drivers.push_back(new_driver);
+        static driver_node node = {registry<T>::table.entries, registry<T>::size, nullptr};
+        for (const driver_node *n = drivers; n != nullptr; n = n->next) {
+            if (n == &node) {
+                return; // Already registered
+            }
+        }
+        node.next = drivers;
+        drivers = &node;
     }
 
     /**
@@ -66,7 +254,7 @@ public:
      * @param[in] _pid          PID of the device
      * @param[in] dev_config    Configuration of the device
      * @param[in] interface_idx USB interface to use
-     * @return std::shared_ptr<CdcAcmDevice>
+     * @return CdcAcmDevice* or nullptr if no driver supports the device or the device could not be opened
      */
     static CdcAcmDevice *
     open(uint16_t _vid, uint16_t _pid, const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx = 0);
@@ -79,17 +267,63 @@ public:
      *
      * This function will block until a valid VCP device is found or
      * until dev_config->connection_timeout_ms expires. Set timeout to 0 to wait forever.
+     * Already connected devices are checked first, then the function waits for the CDC-ACM new device callback,
+     * so it returns as soon as a supported device is enumerated.
      *
      * @note If there are more USB devices connected, the VCP service will return first successfully opened device
+     * @note The new device callback of CDC-ACM driver is used while waiting and it is restored before return.
+     *       Callback registered by cdc_acm_host_register_new_dev_callback() is still called while waiting.
      * @attention USB Host Library must be installed before calling this function!
      *
      * @param[in] dev_config    Configuration of the device
      * @param[in] interface_idx USB interface to use
-     * @return std::shared_ptr<CdcAcmDevice>
+     * @return CdcAcmDevice* or nullptr on timeout
      */
     static CdcAcmDevice *
     open(const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx = 0);
 
+    /**
+     * @brief Start VCP service
+     *
+     * The service opens every supported device as it is connected and passes it to device_cb.
+     * Devices are matched in the CDC-ACM new device callback and opened by the service task, so no device list is polled.
+     * Devices with the same VID and PID are told apart by their serial number,
+     * so only one such device without serial number can be opened.
+     *
+     * If the CDC-ACM driver is not installed, it is installed with the new device callback, so no device is missed.
+     * Otherwise, only devices connected after this call are opened.
+     *
+     * @note The new device callback of CDC-ACM driver is used by the service.
+     *       Callback registered by cdc_acm_host_register_new_dev_callback() is still called and it is restored by VCP::stop().
+     *       VCP::open() without VID and PID cannot be used while the service runs.
+     * @note Callbacks in dev_config get the same user_arg for all devices, event callbacks can tell the devices apart by cdc_hdl.
+     * @attention USB Host Library must be installed before calling this function!
+     *
+     * @param[in] dev_config    Configuration of the devices, copied by the service
+     * @param[in] device_cb     Called from the service task with every opened device
+     * @param[in] arg           User's argument passed to device_cb
+     * @param[in] interface_idx USB interface to use
+     * @return
+     *     - ESP_OK: Service started
+     *     - ESP_ERR_INVALID_ARG: dev_config or device_cb is NULL
+     *     - ESP_ERR_INVALID_STATE: Service is already running or VCP::open() is waiting for a device
+     *     - ESP_ERR_NO_MEM: Not enough memory for the service task
+     *     - Other: CDC-ACM driver could not be installed
+     */
+    static esp_err_t
+    start(const cdc_acm_host_device_config_t *dev_config, device_callback_t device_cb, void *arg = nullptr, uint8_t interface_idx = 0);
+
+    /**
+     * @brief Stop VCP service
+     *
+     * Devices already passed to device_cb stay open.
+     *
+     * @return
+     *     - ESP_OK: Service stopped
+     *     - ESP_ERR_INVALID_STATE: Service is not running
+     */
+    static esp_err_t stop(void);
+
 private:
     // Default operators
     VCP() = delete; // This driver acts as a service, you can't instantiate it
@@ -99,18 +333,25 @@ private:
     bool operator!= (const VCP &param) = delete;
 
     /**
-     * @brief VCP driver structure
+     * @brief Node of the list of drivers registered by register_driver()
      */
-    typedef struct vcp_driver {
-        CdcAcmDevice *(*open)(uint16_t pid, const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx); /*!< Factory method of this driver */
-        uint16_t vid;                                                                                               /*!< VID this driver supports */
-        std::vector<uint16_t> pids;                                                                                 /*!< List of PIDs this driver supports */
-        vcp_driver(auto open_func, const uint16_t _vid, const std::vector<uint16_t> &_pids): open(open_func), vid(_vid), pids(_pids) {};
-    } vcp_driver;
+    struct driver_node {
+        const driver_entry *entries;           /*!< Sorted VID/PID table of this driver */
+        size_t size;                           /*!< Number of entries */
+        driver_node *next;                     /*!< Next registered driver */
+    };
 
     /**
      * @brief List of registered VCP drivers
      */
-    static std::vector<vcp_driver> drivers;
+    static driver_node *drivers;
+
+    static const driver_entry *find_registered(uint16_t vid, uint16_t pid);
+    static CdcAcmDevice *open_driver(driver_find_t find, uint16_t _vid, uint16_t _pid, const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx);
+    static CdcAcmDevice *open_any(driver_find_t find, const driver_node *nodes, const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx);
+    static esp_err_t start_service(driver_find_t find, const cdc_acm_host_device_config_t *dev_config, device_callback_t device_cb, void *arg, uint8_t interface_idx);
 }; // VCP class
+
+// Definition of the table is needed for C++14, where static constexpr members are not implicitly inline
+template<class... Drivers> constexpr typename VCP::registry<Drivers...>::table_t VCP::registry<Drivers...>::table;
 }  // namespace esp_usb
@@ -1,62 +1,302 @@
 /*
- * SPDX-FileCopyrightText: 2022 Espressif Systems (Shanghai) CO LTD
+ * SPDX-FileCopyrightText: 2022-2024 Espressif Systems (Shanghai) CO LTD
  *
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <new>
 #include <stdexcept>
 #include "usb/vcp.hpp"
+#include "usb/usb_host.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+
+#define VCP_SERVICE_TASK_STACK_SIZE (4096)
+#define VCP_SERVICE_TASK_PRIORITY   (5)
+#define VCP_SERVICE_QUEUE_LEN       (8)  // Devices connected and not opened yet
+#define VCP_SERIAL_MAX_LEN          (64) // Longer serial numbers are not used for matching
 
 static const char *TAG = "VCP service";
 
 namespace esp_usb {
-std::vector<VCP::vcp_driver> VCP::drivers;
-CdcAcmDevice *VCP::open(uint16_t _vid, uint16_t _pid, const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx)
+VCP::driver_node *VCP::drivers = nullptr;
+
+namespace {
+/**
+ * @brief State of VCP::open waiting for a new device
+ */
+struct detect_state_t {
+    TaskHandle_t task;               // Task waiting for the device
+    VCP::driver_find_t find;         // Driver lookup of the waiting open
+    const VCP::driver_entry *found;  // Supported device that was connected, set by new device callback
+};
+
+/**
+ * @brief Connected device to be opened by VCP service task
+ */
+struct service_item_t {
+    const VCP::driver_entry *drv;     // Driver of the device, nullptr: Stop the service task
+    bool has_serial;                  // The device is matched by serial number
+    char serial[VCP_SERIAL_MAX_LEN + 1];
+};
+
+/**
+ * @brief State of running VCP service
+ */
+struct service_state_t {
+    VCP::driver_find_t find;          // Driver lookup of the service
+    QueueHandle_t queue;              // Connected devices, filled by new device callback
+    TaskHandle_t task;                // Service task
+    TaskHandle_t stopping_task;       // Task waiting in VCP::stop() for the service task to exit
+    cdc_acm_host_device_config_t dev_config;
+    uint8_t interface_idx;
+    VCP::device_callback_t device_cb;
+    void *arg;
+};
+
+portMUX_TYPE detect_lock = portMUX_INITIALIZER_UNLOCKED;
+detect_state_t *detect_state = nullptr;
+service_state_t *service_state = nullptr;
+int service_cb_active = 0; // Number of new device callbacks using the service queue
+cdc_acm_new_dev_callback_t app_new_dev_cb = nullptr; // Callback of the application, chained while VCP callback is registered
+
+/**
+ * @brief Register VCP new device callback, the callback registered before is chained and restored by new_dev_cb_unhook()
+ */
+void new_dev_cb_hook(cdc_acm_new_dev_callback_t new_dev_cb)
+{
+    cdc_acm_new_dev_callback_t prev_cb = nullptr;
+    cdc_acm_host_get_new_dev_callback(&prev_cb);
+    app_new_dev_cb = prev_cb;
+    cdc_acm_host_register_new_dev_callback(new_dev_cb);
+}
+
+void new_dev_cb_unhook()
+{
+    cdc_acm_host_register_new_dev_callback(app_new_dev_cb);
+    app_new_dev_cb = nullptr;
+}
+
+void app_new_dev_cb_call(usb_device_handle_t usb_dev)
+{
+    const cdc_acm_new_dev_callback_t cb = app_new_dev_cb;
+    if (cb) {
+        cb(usb_dev);
+    }
+}
+
+/**
+ * @brief New device callback: Wake up VCP::open if the new device is supported
+ *
+ * Called from CDC-ACM driver task, so the device is only looked up here and it is opened by the waiting task.
+ */
+void detect_new_dev_cb(usb_device_handle_t usb_dev)
+{
+    app_new_dev_cb_call(usb_dev);
+    const usb_device_desc_t *device_desc;
+    if (usb_host_get_device_descriptor(usb_dev, &device_desc) != ESP_OK) {
+        return;
+    }
+
+    TaskHandle_t task = nullptr;
+    portENTER_CRITICAL(&detect_lock);
+    if (detect_state && !detect_state->found) {
+        detect_state->found = detect_state->find(device_desc->idVendor, device_desc->idProduct);
+        if (detect_state->found) {
+            task = detect_state->task;
+        }
+    }
+    portEXIT_CRITICAL(&detect_lock);
+
+    if (task) {
+        ESP_LOGD(TAG, "Supported device connected: VID 0x%04X, PID 0x%04X", device_desc->idVendor, device_desc->idProduct);
+        xTaskNotifyGive(task);
+    }
+}
+
+/**
+ * @brief New device callback of VCP service: Queue the device for the service task if it is supported
+ *
+ * Called from CDC-ACM driver task. The serial number is copied, so the service task opens exactly this device.
+ */
+void service_new_dev_cb(usb_device_handle_t usb_dev)
+{
+    app_new_dev_cb_call(usb_dev);
+    const usb_device_desc_t *device_desc;
+    if (usb_host_get_device_descriptor(usb_dev, &device_desc) != ESP_OK) {
+        return;
+    }
+
+    portENTER_CRITICAL(&detect_lock);
+    QueueHandle_t queue = service_state ? service_state->queue : nullptr;
+    const VCP::driver_entry *drv = service_state ? service_state->find(device_desc->idVendor, device_desc->idProduct) : nullptr;
+    if (drv) {
+        service_cb_active++; // The queue is not deleted until this callback returns
+    }
+    portEXIT_CRITICAL(&detect_lock);
+    if (!drv) {
+        return;
+    }
+
+    service_item_t item = {drv, false, {}};
+    usb_device_info_t dev_info;
+    if (usb_host_device_info(usb_dev, &dev_info) == ESP_OK && dev_info.str_desc_serial_num) {
+        const usb_str_desc_t *serial_desc = dev_info.str_desc_serial_num;
+        const size_t serial_len = (serial_desc->bLength - USB_STANDARD_DESC_SIZE) / 2;
+        item.has_serial = (serial_len <= VCP_SERIAL_MAX_LEN);
+        for (size_t i = 0; i < serial_len && item.has_serial; i++) {
+            item.has_serial = (serial_desc->wData[i] != 0 && serial_desc->wData[i] < 0x80); // ASCII only, same as CDC-ACM driver
+            item.serial[i] = (char)serial_desc->wData[i];
+        }
+        item.serial[item.has_serial ? serial_len : 0] = '\0';
+    }
+
+    ESP_LOGD(TAG, "Supported device connected: VID 0x%04X, PID 0x%04X", device_desc->idVendor, device_desc->idProduct);
+    if (xQueueSend(queue, &item, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Too many devices to open, VID 0x%04X, PID 0x%04X dropped", device_desc->idVendor, device_desc->idProduct);
+    }
+    portENTER_CRITICAL(&detect_lock);
+    service_cb_active--;
+    portEXIT_CRITICAL(&detect_lock);
+}
+
+/**
+ * @brief Restore the new device callback and unregister the waiting task, also when an exception is thrown
+ */
+struct detect_guard_t {
+    ~detect_guard_t()
+    {
+        new_dev_cb_unhook();
+        portENTER_CRITICAL(&detect_lock);
+        detect_state = nullptr;
+        portEXIT_CRITICAL(&detect_lock);
+    }
+};
+
+bool cdc_acm_install(cdc_acm_new_dev_callback_t new_dev_cb = nullptr)
 {
     // In case user didn't install CDC-ACM driver, we try to install it here.
-    const esp_err_t err = cdc_acm_host_install(NULL);
+    // With new device callback in the driver configuration, devices enumerated during the installation are reported too
+    cdc_acm_host_driver_config_t driver_config = {
+        .driver_task_stack_size = 4096,
+        .driver_task_priority = 10,
+        .xCoreID = 0,
+        .new_dev_cb = new_dev_cb,
+        .shared_client = false,
+    };
+    const esp_err_t err = cdc_acm_host_install(new_dev_cb ? &driver_config : NULL);
     switch (err) {
-    case ESP_OK: ESP_LOGD(TAG, "CDC-ACM driver installed"); break;
-    case ESP_ERR_INVALID_STATE: ESP_LOGD(TAG, "CDC-ACM driver already installed"); break;
-    default: ESP_LOGE(TAG, "Failed to install CDC-ACM driver"); return nullptr;
-    }
-
-    for (vcp_driver drv : drivers) {
-        if (drv.vid == _vid) {
-            for (uint16_t p : drv.pids) {
-                if (p == _pid) {
-                    try {
-                        return drv.open(_pid, dev_config, interface_idx);
-                    } catch (esp_err_t &e) {
-                        switch (e) {
-                        case ESP_ERR_NO_MEM: throw std::bad_alloc();
-                        case ESP_ERR_NOT_FOUND: // fallthrough
-                        default: return nullptr;
-                        }
-                    }
-                }
-            }
+    case ESP_OK: ESP_LOGD(TAG, "CDC-ACM driver installed"); return true;
+    case ESP_ERR_INVALID_STATE:
+        ESP_LOGD(TAG, "CDC-ACM driver already installed");
+        if (new_dev_cb) {
+            new_dev_cb_hook(new_dev_cb);
+        }
+        return true;
+    default: ESP_LOGE(TAG, "Failed to install CDC-ACM driver"); return false;
+    }
+}
+
+CdcAcmDevice *driver_try_open(const VCP::driver_entry *drv, const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx, esp_err_t &err)
+{
+    try {
+        err = ESP_OK;
+        return drv->open(drv->pid, dev_config, interface_idx);
+    } catch (esp_err_t &e) {
+        if (e == ESP_ERR_NO_MEM) {
+            throw std::bad_alloc();
+        }
+        err = e;
+        return nullptr;
+    }
+}
+
+/**
+ * @brief VCP service task: Open the queued devices and pass them to the user
+ */
+void service_task(void *arg)
+{
+    service_state_t *state = static_cast<service_state_t *>(arg);
+    service_item_t item;
+    while (xQueueReceive(state->queue, &item, portMAX_DELAY) == pdTRUE && item.drv) {
+        // The device is already enumerated, so it is opened without waiting
+        cdc_acm_host_device_config_t config = state->dev_config;
+        config.connection_timeout_ms = 1;
+        config.serial_number = item.has_serial ? item.serial : nullptr;
+        esp_err_t err;
+        CdcAcmDevice *vcp = nullptr;
+        try {
+            vcp = driver_try_open(item.drv, &config, state->interface_idx, err);
+        } catch (std::bad_alloc &e) {
+            err = ESP_ERR_NO_MEM;
+        }
+        if (!vcp) {
+            ESP_LOGW(TAG, "Could not open VID 0x%04X, PID 0x%04X: %s", item.drv->vid, item.drv->pid, esp_err_to_name(err));
+            continue;
+        }
+        state->device_cb(vcp, item.drv->vid, item.drv->pid, state->arg);
+    }
+    xTaskNotifyGive(state->stopping_task);
+    vTaskDelete(NULL);
+}
+} // namespace
+
+const vcp_detail::driver_entry *vcp_detail::find(const driver_entry *entries, size_t size, uint16_t vid, uint16_t pid)
+{
+    const uint32_t key = (static_cast<uint32_t>(vid) << 16) | pid;
+    size_t low = 0;
+    size_t high = size;
+    while (low < high) {
+        const size_t mid = low + (high - low) / 2;
+        const uint32_t mid_key = entry_key(entries[mid]);
+        if (mid_key == key) {
+            return &entries[mid];
+        }
+        if (mid_key < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
     }
     return nullptr;
 }
 
-CdcAcmDevice *VCP::open(const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx)
+const VCP::driver_entry *VCP::find_registered(uint16_t vid, uint16_t pid)
+{
+    for (const driver_node *node = drivers; node != nullptr; node = node->next) {
+        const driver_entry *drv = vcp_detail::find(node->entries, node->size, vid, pid);
+        if (drv) {
+            return drv;
+        }
+    }
+    return nullptr;
+}
+
+CdcAcmDevice *VCP::open_driver(driver_find_t find, uint16_t _vid, uint16_t _pid, const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx)
+{
+    if (!cdc_acm_install()) {
+        return nullptr;
+    }
+
+    const driver_entry *drv = find(_vid, _pid);
+    if (!drv) {
+        return nullptr;
+    }
+    esp_err_t err;
+    return driver_try_open(drv, dev_config, interface_idx, err);
+}
+
+CdcAcmDevice *VCP::open_any(driver_find_t find, const driver_node *nodes, const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx)
 {
     // Setup this function timeout
     TickType_t timeout_ticks = (dev_config->connection_timeout_ms == 0) ? portMAX_DELAY : pdMS_TO_TICKS(dev_config->connection_timeout_ms);
     TimeOut_t connection_timeout;
     vTaskSetTimeOutState(&connection_timeout);
 
-    // In case user didn't install CDC-ACM driver, we try to install it here.
-    esp_err_t err = cdc_acm_host_install(NULL);
-    switch (err) {
-    case ESP_OK: ESP_LOGD(TAG, "CDC-ACM driver installed"); break;
-    case ESP_ERR_INVALID_STATE: ESP_LOGD(TAG, "CDC-ACM driver already installed"); break;
-    default: ESP_LOGE(TAG, "Failed to install CDC-ACM driver"); return nullptr;
+    if (!cdc_acm_install()) {
+        return nullptr;
     }
 
     // dev_config->connection_timeout_ms is normally meant for 1 device,
@@ -64,23 +304,129 @@ CdcAcmDevice *VCP::open(const cdc_acm_host_device_config_t *dev_config, uint8_t
     cdc_acm_host_device_config_t _config = *dev_config;
     _config.connection_timeout_ms = 1;
 
-    // Try opening all registered devices, return on first success
-    do {
-        for (vcp_driver drv : drivers) {
-            for (uint16_t pid : drv.pids) {
-                try {
-                    return drv.open(pid, &_config, interface_idx);
-                } catch (esp_err_t &e) {
-                    switch (e) {
-                    case ESP_ERR_NOT_FOUND: break;
-                    case ESP_ERR_NO_MEM: throw std::bad_alloc();
-                    default: return nullptr;
-                    }
-                }
-            }
+    // Register for new devices before checking the connected ones, so no device is missed
+    detect_state_t state = {xTaskGetCurrentTaskHandle(), find, nullptr};
+    portENTER_CRITICAL(&detect_lock);
+    if (detect_state || service_state) {
+        portEXIT_CRITICAL(&detect_lock);
+        ESP_LOGE(TAG, "Another task is already waiting for VCP device or VCP service is running");
+        return nullptr;
+    }
+    detect_state = &state;
+    portEXIT_CRITICAL(&detect_lock);
+    detect_guard_t guard;
+    ulTaskNotifyTake(pdTRUE, 0); // Clear stale notification
+    new_dev_cb_hook(detect_new_dev_cb);
+
+    // Try opening already connected devices, return on first success
+    CdcAcmDevice *vcp = nullptr;
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    for (const driver_node *node = nodes; node != nullptr && err == ESP_ERR_NOT_FOUND; node = node->next) {
+        for (size_t i = 0; i < node->size && err == ESP_ERR_NOT_FOUND; i++) {
+            vcp = driver_try_open(&node->entries[i], &_config, interface_idx, err);
         }
-        vTaskDelay(pdMS_TO_TICKS(50));
-    } while (xTaskCheckForTimeOut(&connection_timeout, &timeout_ticks) == pdFALSE);
-    return nullptr;
+    }
+
+    // Wait until a supported device is connected
+    while (err == ESP_ERR_NOT_FOUND && xTaskCheckForTimeOut(&connection_timeout, &timeout_ticks) == pdFALSE) {
+        ulTaskNotifyTake(pdTRUE, timeout_ticks);
+        portENTER_CRITICAL(&detect_lock);
+        const driver_entry *found = state.found;
+        state.found = nullptr;
+        portEXIT_CRITICAL(&detect_lock);
+        if (found) {
+            vcp = driver_try_open(found, &_config, interface_idx, err);
+        }
+    }
+    return vcp;
+}
+
+esp_err_t VCP::start_service(driver_find_t find, const cdc_acm_host_device_config_t *dev_config, device_callback_t device_cb, void *arg, uint8_t interface_idx)
+{
+    if (!dev_config || !device_cb) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    service_state_t *state = new (std::nothrow) service_state_t{find, nullptr, nullptr, nullptr, *dev_config, interface_idx, device_cb, arg};
+    if (!state) {
+        return ESP_ERR_NO_MEM;
+    }
+    state->queue = xQueueCreate(VCP_SERVICE_QUEUE_LEN, sizeof(service_item_t));
+    if (!state->queue || xTaskCreate(service_task, "VCP", VCP_SERVICE_TASK_STACK_SIZE, state, VCP_SERVICE_TASK_PRIORITY, &state->task) != pdPASS) {
+        if (state->queue) {
+            vQueueDelete(state->queue);
+        }
+        delete state;
+        return ESP_ERR_NO_MEM;
+    }
+
+    portENTER_CRITICAL(&detect_lock);
+    const bool busy = detect_state || service_state;
+    if (!busy) {
+        service_state = state;
+    }
+    portEXIT_CRITICAL(&detect_lock);
+    if (busy || !cdc_acm_install(service_new_dev_cb)) {
+        if (!busy) {
+            portENTER_CRITICAL(&detect_lock);
+            service_state = nullptr;
+            portEXIT_CRITICAL(&detect_lock);
+        }
+        state->stopping_task = xTaskGetCurrentTaskHandle();
+        const service_item_t stop_item = {nullptr, false, {}};
+        xQueueSend(state->queue, &stop_item, portMAX_DELAY);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        vQueueDelete(state->queue);
+        delete state;
+        return busy ? ESP_ERR_INVALID_STATE : ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t VCP::start(const cdc_acm_host_device_config_t *dev_config, device_callback_t device_cb, void *arg, uint8_t interface_idx)
+{
+    return start_service(find_registered, dev_config, device_cb, arg, interface_idx);
+}
+
+esp_err_t VCP::stop(void)
+{
+    portENTER_CRITICAL(&detect_lock);
+    service_state_t *state = service_state;
+    service_state = nullptr;
+    portEXIT_CRITICAL(&detect_lock);
+    if (!state) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    new_dev_cb_unhook();
+
+    // Wait for the new device callback that could have got the queue before it was unregistered
+    while (true) {
+        portENTER_CRITICAL(&detect_lock);
+        const bool cb_active = service_cb_active != 0;
+        portEXIT_CRITICAL(&detect_lock);
+        if (!cb_active) {
+            break;
+        }
+        vTaskDelay(1);
+    }
+
+    // Devices queued before the stop request are still opened and passed to the user
+    state->stopping_task = xTaskGetCurrentTaskHandle();
+    const service_item_t stop_item = {nullptr, false, {}};
+    xQueueSend(state->queue, &stop_item, portMAX_DELAY);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    vQueueDelete(state->queue);
+    delete state;
+    return ESP_OK;
+}
+
+CdcAcmDevice *VCP::open(uint16_t _vid, uint16_t _pid, const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx)
+{
+    return open_driver(find_registered, _vid, _pid, dev_config, interface_idx);
+}
+
+CdcAcmDevice *VCP::open(const cdc_acm_host_device_config_t *dev_config, uint8_t interface_idx)
+{
+    return open_any(find_registered, drivers, dev_config, interface_idx);
 }
 } // namespace esp_usb
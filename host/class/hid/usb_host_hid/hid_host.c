@@ -14,10 +14,33 @@
 #include "esp_check.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "freertos/semphr.h"
+#include "sdkconfig.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_timer.h"
+#endif
 #include "usb/usb_host.h"
 
 #include "usb/hid_host.h"
+#include "hid_report_desc_cache.h"
+#include "hid_mem_priv.h"
+#if USB_HOST_SHARED_CLIENT_ENABLED
+#define USB_HOST_CLIENT_DRIVER  HID
+#include "usb/usb_host_client_macros.h"
+#else
+#include "usb_host_client_fallback.h"
+#endif
+
+// Functions called from interrupt IN and OUT transfer callbacks, placed in IRAM if CONFIG_HID_HOST_DATA_PATH_IN_IRAM is enabled
+#if CONFIG_HID_HOST_DATA_PATH_IN_IRAM && !CONFIG_IDF_TARGET_LINUX
+#include "esp_attr.h"
+#define HID_DATA_PATH_ATTR IRAM_ATTR
+#else
+#define HID_DATA_PATH_ATTR
+#endif
 
 // HID spinlock
 static portMUX_TYPE hid_lock = portMUX_INITIALIZER_UNLOCKED;
@@ -69,6 +92,48 @@ static const char *TAG = "hid-host";
 
 #define DEFAULT_TIMEOUT_MS  (5000)
 
+// Maximum number of queued asynchronous class requests per device
+#define HID_ASYNC_REQ_QUEUE_MAX  (16)
+
+// Failed reads of a latest report slot before the reading task sleeps, so a preempted producer can finish the write
+#define HID_LATEST_READ_SPINS    (16)
+
+// Size of report slots of event multiplexer if not set in its configuration
+#define HID_MUX_REPORT_SIZE_DEFAULT (64)
+
+// Number of interrupt OUT transfers if not set in device configuration
+#define HID_OUT_XFER_NUM_DEFAULT (2)
+
+// Number of shared control transfers in low-memory mode if not set in driver configuration
+#define HID_CTRL_XFER_NUM_DEFAULT (2)
+
+/*
+* TIP: Usually, we need to allocate 'EP bMaxPacketSize0 + 1' here.
+* To take the size of a report descriptor into a consideration,
+* we need to allocate more here, e.g. 512 bytes.
+*/
+#define HID_CTRL_XFER_SIZE       (512)
+
+/**
+ * @brief Control transfer of the shared pool, used in low-memory mode
+ */
+typedef struct {
+    usb_transfer_t *xfer;                       /**< Control transfer */
+    SemaphoreHandle_t done;                     /**< Control transfer semaphore */
+} hid_ctrl_slot_t;
+
+/**
+ * @brief Asynchronous class request
+ */
+typedef struct hid_async_req {
+    STAILQ_ENTRY(hid_async_req) tailq_entry;
+    struct hid_interface *iface;                /**< Interface of the request, NULL if the interface was closed */
+    hid_host_request_cb_t cb;                   /**< Completion callback */
+    void *cb_arg;                               /**< Completion callback argument */
+    usb_setup_packet_t setup;                   /**< Setup packet of the request */
+    uint8_t data[];                             /**< Data stage of OUT request */
+} hid_async_req_t;
+
 /**
  * @brief HID Device structure.
  *
@@ -77,9 +142,14 @@ typedef struct hid_host_device {
     STAILQ_ENTRY(hid_host_device) tailq_entry;  /**< HID device queue */
     SemaphoreHandle_t device_busy;              /**< HID device main mutex */
     SemaphoreHandle_t ctrl_xfer_done;           /**< Control transfer semaphore */
-    usb_transfer_t *ctrl_xfer;                  /**< Pointer to control transfer buffer */
+    usb_transfer_t *ctrl_xfer;                  /**< Pointer to control transfer buffer.
+                                                     Low-memory mode: taken from the shared pool while the device is locked */
+    bool ctrl_xfer_timed_out;                   /**< Control transfer did not complete, it is kept until the device is uninstalled */
     usb_device_handle_t dev_hdl;                /**< USB device handle */
     uint8_t dev_addr;                           /**< USB device address */
+    usb_transfer_t *async_xfer;                 /**< Control transfer of asynchronous requests */
+    STAILQ_HEAD(async_reqs, hid_async_req) async_reqs_tailq; /**< Queued asynchronous requests, the first one is in flight */
+    size_t async_reqs_num;                      /**< Number of queued asynchronous requests */
 } hid_device_t;
 
 /**
@@ -94,6 +164,87 @@ typedef enum {
     HID_INTERFACE_STATE_MAX
 } hid_iface_state_t;
 
+/**
+ * @brief Slot of the input report queue
+ */
+typedef struct {
+    int64_t timestamp_us;                   /**< Time of reception */
+    size_t len;                             /**< Length of the report */
+    struct hid_interface *iface;            /**< Interface of the report */
+} hid_report_slot_t;
+
+/**
+ * @brief Input report queue of HID Interface
+ *
+ * Single producer (USB client task in in_xfer_done()) and single consumer (user task) ring.
+ * Free running head and tail indexes are accessed atomically, so no lock is needed.
+ */
+typedef struct {
+    unsigned head;                          /**< Next slot written by producer. Accessed atomically */
+    unsigned tail;                          /**< Next slot released by consumer. Accessed atomically */
+    size_t len;                             /**< Number of slots */
+    size_t slot_size;                       /**< Size of report data of one slot */
+    uint32_t overruns;                      /**< Reports dropped because the queue was full. Accessed atomically */
+    SemaphoreHandle_t report_ready;         /**< Given by producer when a report is put to the empty queue */
+    hid_report_slot_t *slots;               /**< Slot information */
+    uint8_t *data;                          /**< Report data, len * slot_size */
+} hid_report_queue_t;
+
+/**
+ * @brief Latest input report of one Report ID
+ *
+ * Seqlock: the producer (USB client task) makes the sequence odd while it writes the slot,
+ * the consumer copies the slot and retries if the sequence was odd or changed meanwhile.
+ */
+typedef struct {
+    uint32_t seq;                           /**< Sequence, odd while the producer writes the slot. Accessed atomically */
+    uint32_t count;                         /**< Number of reports written to the slot */
+    uint32_t read_count;                    /**< Value of count at the last read, accessed by consumer only */
+    int64_t timestamp_us;                   /**< Time of reception */
+    size_t len;                             /**< Length of the report */
+    uint8_t data[];                         /**< Report data */
+} hid_latest_slot_t;
+
+/**
+ * @brief Latest input reports of HID Interface
+ */
+typedef struct {
+    size_t slots_num;                       /**< Number of slots: one per report of the report map, one if there is no map */
+    size_t slot_stride;                     /**< Size of one slot including its data, multiple of 8 */
+    size_t data_size;                       /**< Maximum size of one report */
+    uint8_t *slots;                         /**< Slots hid_latest_slot_t */
+} hid_latest_reports_t;
+
+/**
+ * @brief Event multiplexer of several HID Interfaces
+ *
+ * Reports of all interfaces of the multiplexer are put to one report queue, each slot keeps the interface of its report.
+ */
+typedef struct hid_host_mux {
+    hid_report_queue_t *queue;              /**< Reports of all interfaces */
+    size_t ifaces_num;                      /**< Number of interfaces of the multiplexer, protected by HID spinlock */
+} hid_host_mux_t;
+
+/**
+ * @brief Callback of input reports with one Report ID
+ */
+typedef struct {
+    hid_host_report_cb_t cb;                /**< Report callback */
+    void *cb_arg;                           /**< Report callback argument */
+    bool changes_only;                      /**< Call the callback only if the report differs from the last one */
+    size_t last_len;                        /**< Length of the last report, 0: no report received yet */
+    uint8_t *last;                          /**< Last report, allocated for changes_only callbacks */
+} hid_report_cb_entry_t;
+
+/**
+ * @brief Keyboard key events of HID Interface
+ */
+typedef struct {
+    hid_host_keyboard_cb_t cb;              /**< Key events callback */
+    void *cb_arg;                           /**< Key events callback argument */
+    hid_keyboard_state_t state;             /**< Pressed keys */
+} hid_keyboard_entry_t;
+
 /**
  * @brief HID Interface structure in device to interact with. After HID device opening keeps the interface configuration
  *
@@ -104,15 +255,50 @@ typedef struct hid_interface {
     hid_host_dev_params_t dev_params;       /**< USB device parameters */
     uint8_t ep_in;                          /**< Interrupt IN EP number */
     uint16_t ep_in_mps;                     /**< Interrupt IN max size */
+    uint16_t in_report_size;                /**< Size of input report buffers. Low-memory mode: the largest input report */
+    uint8_t ep_in_interval;                 /**< Interrupt IN bInterval */
+    uint8_t ep_out;                         /**< Interrupt OUT EP number, 0 if the interface has no OUT endpoint */
+    uint16_t ep_out_mps;                    /**< Interrupt OUT max size */
     uint8_t country_code;                   /**< Country code */
     uint16_t report_desc_size;              /**< Size of Report */
     uint8_t *report_desc;                   /**< Pointer to HID Report */
-    usb_transfer_t *in_xfer;                /**< Pointer to IN transfer buffer */
+    hid_report_map_t *report_map;           /**< Compiled HID Report Descriptor */
+    usb_transfer_t **in_xfer;               /**< IN transfers queued at once */
+    int in_xfer_num;                        /**< Number of IN transfers */
+    usb_transfer_t *in_xfer_last;           /**< Last completed IN transfer */
+    hid_report_queue_t *report_queue;       /**< Queue of received input reports, NULL if not used */
+    hid_host_mux_t *mux;                    /**< Event multiplexer receiving input reports, NULL if not used */
+    hid_latest_reports_t *latest;           /**< Latest input report per Report ID, NULL if not used */
+    hid_host_stats_t stats;                 /**< Input report statistics, protected by HID spinlock */
+    usb_transfer_t **out_xfer;              /**< Interrupt OUT transfers */
+    int out_xfer_num;                       /**< Number of interrupt OUT transfers */
+    QueueHandle_t out_xfer_free;            /**< Interrupt OUT transfers ready for use */
+    hid_report_cb_entry_t **report_cbs;     /**< 256 report callbacks by Report ID, entry 0 for devices without Report IDs.
+                                                 NULL if no callback is registered */
+    hid_keyboard_entry_t *keyboard;         /**< Keyboard key events, NULL if no callback is registered */
     hid_host_interface_event_cb_t user_cb;  /**< Interface application callback */
     void *user_cb_arg;                      /**< Interface application callback arg */
     hid_iface_state_t state;                /**< Interface state */
+    bool suspended;                         /**< Interface was stopped by bus suspend, it is started again on resume */
 } hid_iface_t;
 
+// Number of slots of handle lookup tables, power of two. One slot is always kept empty
+#define HID_HANDLE_TABLE_SIZE    (64)
+
+/**
+ * @brief Handle lookup table
+ *
+ * Open addressing hash table with linear probing. Handles are validated in O(1) instead of walking the STAILQ lists.
+ * Protected by HID spinlock.
+ */
+typedef struct {
+    struct {
+        const void *key;                    /**< Handle, NULL: empty slot */
+        void *value;                        /**< Driver object of the handle */
+    } slots[HID_HANDLE_TABLE_SIZE];
+    size_t num;                             /**< Number of used slots */
+} hid_handle_table_t;
+
 /**
  * @brief HID driver default context
  *
@@ -121,12 +307,17 @@ typedef struct hid_interface {
 typedef struct {
     STAILQ_HEAD(devices, hid_host_device) hid_devices_tailq;    /**< STAILQ of HID interfaces */
     STAILQ_HEAD(interfaces, hid_interface) hid_ifaces_tailq;    /**< STAILQ of HID interfaces */
+    hid_handle_table_t devices_table;                           /**< HID devices by USB device handle */
+    hid_handle_table_t ifaces_table;                            /**< Valid HID interface handles */
     usb_host_client_handle_t client_handle;                     /**< Client task handle */
     hid_host_driver_event_cb_t user_cb;                         /**< User application callback */
     void *user_arg;                                             /**< User application callback args */
     bool event_handling_started;                                /**< Events handler started flag */
     SemaphoreHandle_t all_events_handled;                       /**< Events handler semaphore */
     volatile bool end_client_event_handling;                    /**< Client event handling flag */
+    bool shared_client;                                         /**< Registered to usb_host_shared_client, which handles the events */
+    bool low_memory;                                            /**< Low-memory mode */
+    QueueHandle_t ctrl_xfer_pool;                               /**< Shared control transfers hid_ctrl_slot_t, NULL if not in low-memory mode */
 } hid_driver_t;
 
 static hid_driver_t *s_hid_driver;                              /**< Internal pointer to HID driver */
@@ -141,6 +332,8 @@ static esp_err_t hid_host_install_device(uint8_t dev_addr,
 
 static esp_err_t hid_host_uninstall_device(hid_device_t *hid_device);
 
+static esp_err_t hid_report_map_compile(hid_iface_t *iface);
+
 // --------------------------- Internal Logic ----------------------------------
 /**
  * @brief HID class specific request
@@ -172,6 +365,100 @@ static void event_handler_task(void *arg)
     vTaskDelete(NULL);
 }
 
+/**
+ * @brief Get first slot of handle in lookup table
+ *
+ * @param[in] key   Handle
+ * @return Slot index
+ */
+static inline unsigned hid_handle_hash(const void *key)
+{
+    // Fibonacci hashing, low bits of pointers are mostly zero due to alignment
+    const uint32_t h = (uint32_t)(uintptr_t)key * 2654435761U;
+    return (h >> 16) & (HID_HANDLE_TABLE_SIZE - 1);
+}
+
+/**
+ * @brief Find handle in lookup table
+ *
+ * Use only inside critical section
+ *
+ * @param[in] table Lookup table
+ * @param[in] key   Handle
+ * @return Driver object of the handle, NULL if not found
+ */
+static void *hid_handle_table_find(const hid_handle_table_t *table, const void *key)
+{
+    if (NULL == key) {
+        return NULL;
+    }
+    for (unsigned i = hid_handle_hash(key); table->slots[i].key; i = (i + 1) & (HID_HANDLE_TABLE_SIZE - 1)) {
+        if (table->slots[i].key == key) {
+            return table->slots[i].value;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Add handle to lookup table
+ *
+ * Use only inside critical section
+ *
+ * @param[in] table Lookup table
+ * @param[in] key   Handle
+ * @param[in] value Driver object of the handle
+ * @return true on success, false if the table is full
+ */
+static bool hid_handle_table_add(hid_handle_table_t *table, const void *key, void *value)
+{
+    if (table->num == HID_HANDLE_TABLE_SIZE - 1) {
+        return false;
+    }
+    unsigned i = hid_handle_hash(key);
+    while (table->slots[i].key) {
+        i = (i + 1) & (HID_HANDLE_TABLE_SIZE - 1);
+    }
+    table->slots[i].key = key;
+    table->slots[i].value = value;
+    table->num++;
+    return true;
+}
+
+/**
+ * @brief Remove handle from lookup table
+ *
+ * Following entries of the probe sequence are shifted back, so no tombstones are needed.
+ * Use only inside critical section
+ *
+ * @param[in] table Lookup table
+ * @param[in] key   Handle
+ */
+static void hid_handle_table_remove(hid_handle_table_t *table, const void *key)
+{
+    const unsigned mask = HID_HANDLE_TABLE_SIZE - 1;
+    unsigned i = hid_handle_hash(key);
+    while (table->slots[i].key != key) {
+        if (NULL == table->slots[i].key) {
+            return; // Not in the table
+        }
+        i = (i + 1) & mask;
+    }
+
+    unsigned hole = i;
+    for (unsigned j = (i + 1) & mask; table->slots[j].key; j = (j + 1) & mask) {
+        // Move the entry to the hole if the hole lies between its home slot and its current slot
+        const unsigned home = hid_handle_hash(table->slots[j].key);
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            table->slots[hole] = table->slots[j];
+            hole = j;
+        }
+    }
+    table->slots[hole].key = NULL;
+    table->slots[hole].value = NULL;
+    table->num--;
+}
+
 /**
  * @brief Return HID device in devices list by USB device handle
  *
@@ -180,17 +467,10 @@ static void event_handler_task(void *arg)
  */
 static hid_device_t *get_hid_device_by_handle(usb_device_handle_t usb_handle)
 {
-    hid_device_t *device = NULL;
-
     HID_ENTER_CRITICAL();
-    STAILQ_FOREACH(device, &s_hid_driver->hid_devices_tailq, tailq_entry) {
-        if (usb_handle == device->dev_hdl) {
-            HID_EXIT_CRITICAL();
-            return device;
-        }
-    }
+    hid_device_t *device = hid_handle_table_find(&s_hid_driver->devices_table, usb_handle);
     HID_EXIT_CRITICAL();
-    return NULL;
+    return device;
 }
 
 /**
@@ -213,18 +493,10 @@ static inline hid_device_t *get_hid_device_from_context(usb_transfer_t *xfer)
  */
 static inline bool is_interface_in_list(hid_iface_t *iface)
 {
-    hid_iface_t *interface = NULL;
-
     HID_ENTER_CRITICAL();
-    STAILQ_FOREACH(interface, &s_hid_driver->hid_ifaces_tailq, tailq_entry) {
-        if (iface == interface) {
-            HID_EXIT_CRITICAL();
-            return true;
-        }
-    }
-
+    const bool found = (NULL != hid_handle_table_find(&s_hid_driver->ifaces_table, iface));
     HID_EXIT_CRITICAL();
-    return false;
+    return found;
 }
 
 /**
@@ -269,6 +541,35 @@ static inline const usb_ep_desc_t *get_iface_ep_in(const usb_intf_desc_t *iface_
     return NULL;
 }
 
+/**
+ * @brief Returns pointer to first interrupt OUT Endpoint descriptor
+ *
+ * OUT endpoint is optional for HID interfaces, output reports are sent over EP0 without it.
+ *
+ * @see 4.4 Interfaces, p.10 of Device Class Definition for Human Interface Devices (HID) Version 1.11
+ *
+ * @param[in] iface_desc    Pointer to Interface Descriptor
+ * @param[in] total_length  Total length of configuration descriptor
+ * @return usb_ep_desc_t Pointer to EP OUT Descriptor, NULL if not present
+ */
+static inline const usb_ep_desc_t *get_iface_ep_out(const usb_intf_desc_t *iface_desc,
+        const size_t total_length)
+{
+    assert(iface_desc);
+    const usb_ep_desc_t *ep_desc = NULL;
+    for (int i = 0; i < iface_desc->bNumEndpoints; i++) {
+        int ep_offset = 0;
+        ep_desc = usb_parse_endpoint_descriptor_by_index(iface_desc, i, total_length, &ep_offset);
+        if (ep_desc) {
+            if (!USB_EP_DESC_GET_EP_DIR(ep_desc) &&
+                    (USB_EP_DESC_GET_XFERTYPE(ep_desc) == USB_BM_ATTRIBUTES_XFER_INT)) {
+                return ep_desc;
+            }
+        }
+    }
+    return NULL;
+}
+
 /**
  * @brief Check HID interface descriptor present
  *
@@ -336,15 +637,17 @@ static inline void hid_host_user_device_callback(hid_iface_t *iface,
  * @param[in] hid_device    HID device handle
  * @param[in] iface_desc  Pointer to an Interface descriptor
  * @param[in] hid_desc    Pointer to an HID device descriptor
- * @param[in] ep_desc     Pointer to an EP descriptor
+ * @param[in] ep_in_desc  Pointer to an EP IN descriptor
+ * @param[in] ep_out_desc Pointer to an EP OUT descriptor, can be NULL
  * @return esp_err_t
  */
 static esp_err_t hid_host_add_interface(hid_device_t *hid_device,
                                         const usb_intf_desc_t *iface_desc,
                                         const hid_descriptor_t *hid_desc,
-                                        const usb_ep_desc_t *ep_in_desc)
+                                        const usb_ep_desc_t *ep_in_desc,
+                                        const usb_ep_desc_t *ep_out_desc)
 {
-    hid_iface_t *hid_iface = calloc(1, sizeof(hid_iface_t));
+    hid_iface_t *hid_iface = HID_CALLOC(CONTROL, 1, sizeof(hid_iface_t));
 
     HID_RETURN_ON_FALSE(hid_iface,
                         ESP_ERR_NO_MEM,
@@ -372,16 +675,28 @@ static esp_err_t hid_host_add_interface(hid_device_t *hid_device,
                 (ep_in_desc->bmAttributes & USB_B_ENDPOINT_ADDRESS_EP_NUM_MASK) ) {
             hid_iface->ep_in = ep_in_desc->bEndpointAddress;
             hid_iface->ep_in_mps = USB_EP_DESC_GET_MPS(ep_in_desc);
+            hid_iface->ep_in_interval = ep_in_desc->bInterval;
         } else {
             ESP_EARLY_LOGE(TAG, "HID device EP IN %#X configuration error",
                            ep_in_desc->bEndpointAddress);
         }
     }
 
+    if (ep_out_desc) {
+        hid_iface->ep_out = ep_out_desc->bEndpointAddress;
+        hid_iface->ep_out_mps = USB_EP_DESC_GET_MPS(ep_out_desc);
+    }
+
     if (iface_desc && hid_desc && ep_in_desc) {
         hid_iface->state = HID_INTERFACE_STATE_IDLE;
     }
 
+    if (!hid_handle_table_add(&s_hid_driver->ifaces_table, hid_iface, hid_iface)) {
+        HID_EXIT_CRITICAL();
+        HID_FREE(CONTROL, hid_iface, sizeof(hid_iface_t));
+        ESP_LOGE(TAG, "Too many HID interfaces");
+        return ESP_ERR_NO_MEM;
+    }
     STAILQ_INSERT_TAIL(&s_hid_driver->hid_ifaces_tailq, hid_iface, tailq_entry);
     HID_EXIT_CRITICAL();
 
@@ -399,8 +714,9 @@ static esp_err_t hid_host_add_interface(hid_device_t *hid_device,
 static esp_err_t _hid_host_remove_interface(hid_iface_t *iface)
 {
     iface->state = HID_INTERFACE_STATE_NOT_INITIALIZED;
+    hid_handle_table_remove(&s_hid_driver->ifaces_table, iface);
     STAILQ_REMOVE(&s_hid_driver->hid_ifaces_tailq, iface, hid_interface, tailq_entry);
-    free(iface);
+    HID_FREE(CONTROL, iface, sizeof(hid_iface_t));
     return ESP_OK;
 }
 
@@ -467,7 +783,8 @@ static esp_err_t hid_host_interface_list_create(hid_device_t *hid_device,
                     HID_RETURN_ON_ERROR( hid_host_add_interface(hid_device,
                                          iface_desc,
                                          hid_desc,
-                                         ep_in_desc),
+                                         ep_in_desc,
+                                         get_iface_ep_out(iface_desc, total_length)),
                                          "Unable to add HID Interface to the RAM list");
                 }
             }
@@ -494,7 +811,7 @@ static bool hid_host_device_init_attempt(uint8_t dev_addr)
     const usb_config_desc_t *config_desc = NULL;
     hid_device_t *hid_device = NULL;
 
-    if (usb_host_device_open(s_hid_driver->client_handle, dev_addr, &dev_hdl) == ESP_OK) {
+    if (CLIENT_DEVICE_OPEN(s_hid_driver->client_handle, dev_addr, &dev_hdl) == ESP_OK) {
         if (usb_host_get_active_config_descriptor(dev_hdl, &config_desc) == ESP_OK) {
             is_hid_device = hid_interface_present(config_desc);
         }
@@ -507,7 +824,7 @@ static bool hid_host_device_init_attempt(uint8_t dev_addr)
         // Create Interfaces list for a possibility to claim Interface
         ESP_ERROR_CHECK( hid_host_interface_list_create(hid_device, config_desc) );
     } else {
-        usb_host_device_close(s_hid_driver->client_handle, dev_hdl);
+        CLIENT_DEVICE_CLOSE(s_hid_driver->client_handle, dev_hdl);
         ESP_LOGW(TAG, "No HID device at USB port %d", dev_addr);
     }
 
@@ -566,697 +883,2303 @@ static void client_event_cb(const usb_host_client_event_msg_t *event, void *arg)
 }
 
 /**
- * @brief HID Host claim Interface and prepare transfer, change state to READY
+ * @brief Get time for report timestamps and statistics
  *
- * @param[in] iface       Pointer to Interface structure,
- * @return esp_err_t
+ * @return Time in microseconds
  */
-static esp_err_t hid_host_interface_claim_and_prepare_transfer(hid_iface_t *iface)
+static int64_t HID_DATA_PATH_ATTR hid_report_time_us(void)
 {
-    HID_RETURN_ON_ERROR( usb_host_interface_claim( s_hid_driver->client_handle,
-                         iface->parent->dev_hdl,
-                         iface->dev_params.iface_num, 0),
-                         "Unable to claim Interface");
-
-    HID_RETURN_ON_ERROR( usb_host_transfer_alloc(iface->ep_in_mps, 0, &iface->in_xfer),
-                         "Unable to allocate transfer buffer for EP IN");
-
-    // Change state
-    iface->state = HID_INTERFACE_STATE_READY;
-    return ESP_OK;
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return esp_timer_get_time();
+#endif
 }
 
 /**
- * @brief HID Host release Interface and free transfer, change state to IDLE
+ * @brief Get time histogram bucket
  *
- * @param[in] iface       Pointer to Interface structure,
- * @return esp_err_t
+ * Bucket 0: < bucket0_us, bucket i: <bucket0_us * 2^(i-1); bucket0_us * 2^i), last bucket: everything above
+ *
+ * @param[in] time_us    Measured time
+ * @param[in] bucket0_us Upper limit of the first bucket
+ * @return Index of histogram bucket
  */
-static esp_err_t hid_host_interface_release_and_free_transfer(hid_iface_t *iface)
+static unsigned HID_DATA_PATH_ATTR hid_stats_bucket(int64_t time_us, uint32_t bucket0_us)
 {
-    HID_RETURN_ON_INVALID_ARG(iface);
-    HID_RETURN_ON_INVALID_ARG(iface->parent);
-
-    HID_RETURN_ON_FALSE(is_interface_in_list(iface),
-                        ESP_ERR_NOT_FOUND,
-                        "Interface handle not found");
-
-    HID_RETURN_ON_ERROR( usb_host_interface_release(s_hid_driver->client_handle,
-                         iface->parent->dev_hdl,
-                         iface->dev_params.iface_num),
-                         "Unable to release HID Interface");
-
-    ESP_ERROR_CHECK( usb_host_transfer_free(iface->in_xfer) );
-
-    // Change state
-    iface->state = HID_INTERFACE_STATE_IDLE;
-    return ESP_OK;
+    unsigned bucket = 0;
+    int64_t time = time_us / bucket0_us;
+    while (time > 0 && bucket < HID_HOST_STATS_HIST_BUCKETS - 1) {
+        time >>= 1;
+        bucket++;
+    }
+    return bucket;
 }
 
 /**
- * @brief Disable active interface
+ * @brief Account received input report in statistics
+ *
+ * Interval longer than 1.5 polling interval is counted as late, the polls that fit in it as missed.
  *
  * @param[in] iface       Pointer to Interface structure
- * @return esp_err_t
+ * @param[in] now_us      Time of reception
  */
-static esp_err_t hid_host_disable_interface(hid_iface_t *iface)
+static void HID_DATA_PATH_ATTR hid_stats_report_received(hid_iface_t *iface, int64_t now_us)
 {
-    HID_RETURN_ON_INVALID_ARG(iface);
-    HID_RETURN_ON_INVALID_ARG(iface->parent);
-
-    HID_RETURN_ON_FALSE(is_interface_in_list(iface),
-                        ESP_ERR_NOT_FOUND,
-                        "Interface handle not found");
-
-    HID_RETURN_ON_FALSE((HID_INTERFACE_STATE_ACTIVE == iface->state),
-                        ESP_ERR_INVALID_STATE,
-                        "Interface wrong state");
-
-    HID_RETURN_ON_ERROR( usb_host_endpoint_halt(iface->parent->dev_hdl, iface->ep_in),
-                         "Unable to HALT EP");
-    HID_RETURN_ON_ERROR( usb_host_endpoint_flush(iface->parent->dev_hdl, iface->ep_in),
-                         "Unable to FLUSH EP");
-    usb_host_endpoint_clear(iface->parent->dev_hdl, iface->ep_in);
+    hid_host_stats_t *stats = &iface->stats;
 
-    iface->state = HID_INTERFACE_STATE_READY;
-
-    return ESP_OK;
+    HID_ENTER_CRITICAL();
+    if (stats->reports) {
+        const int64_t interval_us = now_us - stats->last_report_us;
+        stats->interval_histogram[hid_stats_bucket(interval_us, 125)]++;
+        stats->interval_sum_us += interval_us;
+        if (stats->interval_min_us == 0 || interval_us < stats->interval_min_us) {
+            stats->interval_min_us = interval_us;
+        }
+        if (interval_us > stats->interval_max_us) {
+            stats->interval_max_us = interval_us;
+        }
+        if (stats->poll_interval_us && 2 * interval_us > 3 * (int64_t)stats->poll_interval_us) {
+            stats->late_reports++;
+            stats->missed_polls += (interval_us + stats->poll_interval_us / 2) / stats->poll_interval_us - 1;
+        }
+    }
+    stats->reports++;
+    stats->last_report_us = now_us;
+    HID_EXIT_CRITICAL();
 }
 
 /**
- * @brief HID IN Transfer complete callback
+ * @brief Get polling interval of interrupt IN endpoint
  *
- * @param[in] transfer  Pointer to transfer data structure
+ * @see 9.6.6 Endpoint, Table 9-13 of USB 2.0 Specification
+ *
+ * @param[in] iface       Pointer to Interface structure
+ * @return Polling interval in microseconds, 0 if unknown
  */
-static void in_xfer_done(usb_transfer_t *in_xfer)
+static uint32_t hid_host_poll_interval_us(hid_iface_t *iface)
 {
-    assert(in_xfer);
-    assert(in_xfer->context);
-
-    hid_iface_t *iface = (hid_iface_t *) in_xfer->context;
-
-    switch (in_xfer->status) {
-    case USB_TRANSFER_STATUS_COMPLETED:
-        // Notify user
-        hid_host_user_interface_callback(iface, HID_HOST_INTERFACE_EVENT_INPUT_REPORT);
-        // Relaunch transfer
-        usb_host_transfer_submit(in_xfer);
-        return;
-    case USB_TRANSFER_STATUS_NO_DEVICE:
-    case USB_TRANSFER_STATUS_CANCELED:
-        // User is notified about device disconnection from usb_event_cb
-        // No need to do anything
-        return;
-    default:
-        // Any other error
-        break;
+    usb_device_info_t dev_info;
+    if (ESP_OK != usb_host_device_info(iface->parent->dev_hdl, &dev_info) || iface->ep_in_interval == 0) {
+        return 0;
     }
-
-    ESP_LOGE(TAG, "Transfer failed, status %d", in_xfer->status);
-    // Notify user about transfer or any other error
-    hid_host_user_interface_callback(iface, HID_HOST_INTERFACE_EVENT_TRANSFER_ERROR);
+    if (USB_SPEED_HIGH == dev_info.speed) {
+        // High-speed: 2^(bInterval-1) microframes, bInterval 1..16
+        return 125U << (MIN(iface->ep_in_interval, 16) - 1);
+    }
+    // Low and Full-speed: bInterval frames
+    return iface->ep_in_interval * 1000U;
 }
 
-/** Lock HID device from other task
+/**
+ * @brief Free input report queue
  *
- * @param[in] hid_device    Pointer to HID device structure
- * @param[in] timeout_ms    Timeout of trying to take the mutex
- * @return esp_err_t
+ * @param[in] queue       Report queue, can be NULL
  */
-static inline esp_err_t hid_device_try_lock(hid_device_t *hid_device, uint32_t timeout_ms)
+static void hid_report_queue_delete(hid_report_queue_t *queue)
 {
-    return ( xSemaphoreTake(hid_device->device_busy, pdMS_TO_TICKS(timeout_ms))
-             ? ESP_OK
-             : ESP_ERR_TIMEOUT );
+    if (NULL == queue) {
+        return;
+    }
+    if (queue->report_ready) {
+        vSemaphoreDelete(queue->report_ready);
+    }
+    HID_FREE(BUFFER, queue->slots, queue->len * sizeof(hid_report_slot_t));
+    HID_FREE(BUFFER, queue->data, queue->len * queue->slot_size);
+    HID_FREE(BUFFER, queue, sizeof(hid_report_queue_t));
 }
 
-/** Unlock HID device from other task
+/**
+ * @brief Allocate input report queue
  *
- * @param[in] hid_device    Pointer to HID device structure
- * @param[in] timeout_ms    Timeout of trying to take the mutex
- * @return esp_err_t
+ * @param[in] len         Number of reports
+ * @param[in] slot_size   Maximum size of one report
+ * @return Report queue, NULL if out of memory
  */
-static inline void hid_device_unlock(hid_device_t *hid_device)
+static hid_report_queue_t *hid_report_queue_create(size_t len, size_t slot_size)
 {
-    xSemaphoreGive(hid_device->device_busy);
+    hid_report_queue_t *queue = HID_CALLOC(BUFFER, 1, sizeof(hid_report_queue_t));
+    if (NULL == queue) {
+        return NULL;
+    }
+    queue->len = len;
+    queue->slot_size = slot_size;
+    queue->report_ready = xSemaphoreCreateBinary();
+    queue->slots = HID_CALLOC(BUFFER, len, sizeof(hid_report_slot_t));
+    queue->data = HID_MALLOC(BUFFER, len * slot_size);
+    if (NULL == queue->report_ready || NULL == queue->slots || NULL == queue->data) {
+        hid_report_queue_delete(queue);
+        return NULL;
+    }
+    return queue;
 }
 
 /**
- * @brief HID Control transfer complete callback
+ * @brief Put received report to the queue, called from the USB client task
  *
- * @param[in] ctrl_xfer  Pointer to transfer data structure
+ * The reader is woken up only when the queue was empty, it takes all reports queued until then in one batch.
+ *
+ * @param[in] queue       Report queue
+ * @param[in] iface       Interface of the report
+ * @param[in] data        Report data
+ * @param[in] len         Length of the report
+ * @param[in] timestamp_us Time of reception
  */
-static void ctrl_xfer_done(usb_transfer_t *ctrl_xfer)
+static void HID_DATA_PATH_ATTR hid_report_queue_push(hid_report_queue_t *queue, hid_iface_t *iface,
+        const uint8_t *data, size_t len, int64_t timestamp_us)
 {
-    assert(ctrl_xfer);
-    hid_device_t *hid_device = (hid_device_t *)ctrl_xfer->context;
-    xSemaphoreGive(hid_device->ctrl_xfer_done);
+    const unsigned head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    const unsigned tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail == queue->len) {
+        // Warn only on the first dropped report, after that the consumer is clearly behind
+        if (__atomic_fetch_add(&queue->overruns, 1, __ATOMIC_RELAXED) == 0) {
+            ESP_LOGW(TAG, "Report queue full, dropping reports");
+        }
+        return;
+    }
+
+    const size_t idx = head % queue->len;
+    len = MIN(len, queue->slot_size);
+    memcpy(queue->data + idx * queue->slot_size, data, len);
+    queue->slots[idx].timestamp_us = timestamp_us;
+    queue->slots[idx].len = len;
+    queue->slots[idx].iface = iface;
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    if (head == tail) {
+        xSemaphoreGive(queue->report_ready);
+    }
 }
 
 /**
- * @brief HID control transfer synchronous.
+ * @brief Wait for reports in the queue, called from the reading task
  *
- * @note  Passes interface and endpoint descriptors to obtain:
-
- *        - interface number, IN endpoint, OUT endpoint, max. packet size
+ * @param[in] queue       Report queue
+ * @param[in] timeout_ms  Time to wait for a report if the queue is empty, 0: do not wait
+ * @return Number of queued reports that were not released yet
+ */
+static size_t hid_report_queue_wait(hid_report_queue_t *queue, uint32_t timeout_ms)
+{
+    const unsigned tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    unsigned head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    if (head == tail && timeout_ms) {
+        // The semaphore may still be given by reports that were already read, clear it and check the queue again before waiting
+        xSemaphoreTake(queue->report_ready, 0);
+        head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            xSemaphoreTake(queue->report_ready, pdMS_TO_TICKS(timeout_ms));
+            head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+        }
+    }
+    return head - tail;
+}
+
+/**
+ * @brief Release the oldest reports of the queue, called from the reading task
  *
- * @param[in] hid_device  Pointer to HID device structure
- * @param[in] ctrl_xfer   Pointer to the Transfer structure
- * @param[in] len         Number of bytes to transfer
- * @param[in] timeout_ms  Timeout in ms
+ * @param[in] queue       Report queue
+ * @param[in] reports_num Number of reports to release
  * @return esp_err_t
  */
-static esp_err_t hid_control_transfer(hid_device_t *hid_device,
-                                      size_t len,
-                                      uint32_t timeout_ms)
+static esp_err_t hid_report_queue_release(hid_report_queue_t *queue, size_t reports_num)
 {
+    const unsigned tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    const unsigned head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    HID_RETURN_ON_FALSE(reports_num <= head - tail,
+                        ESP_ERR_INVALID_ARG,
+                        "Releasing more reports than queued");
 
-    usb_transfer_t *ctrl_xfer = hid_device->ctrl_xfer;
-
-    ctrl_xfer->device_handle = hid_device->dev_hdl;
-    ctrl_xfer->callback = ctrl_xfer_done;
-    ctrl_xfer->context = hid_device;
-    ctrl_xfer->bEndpointAddress = 0;
-    ctrl_xfer->timeout_ms = timeout_ms;
-    ctrl_xfer->num_bytes = len;
-
-    HID_RETURN_ON_ERROR( usb_host_transfer_submit_control(s_hid_driver->client_handle, ctrl_xfer),
-                         "Unable to submit control transfer");
-
-    BaseType_t received = xSemaphoreTake(hid_device->ctrl_xfer_done, pdMS_TO_TICKS(ctrl_xfer->timeout_ms));
+    __atomic_store_n(&queue->tail, tail + reports_num, __ATOMIC_RELEASE);
+    return ESP_OK;
+}
 
-    if (received != pdTRUE) {
-        // Transfer was not finished, error in USB LIB. Reset the endpoint
-        ESP_LOGE(TAG, "Control Transfer Timeout");
+/**
+ * @brief Remove Interface from its event multiplexer
+ *
+ * Use only inside critical section
+ *
+ * @param[in] iface       Pointer to Interface structure
+ */
+static void _hid_host_mux_remove(hid_iface_t *iface)
+{
+    if (iface->mux) {
+        iface->mux->ifaces_num--;
+        iface->mux = NULL;
+    }
+}
 
-        HID_RETURN_ON_ERROR( usb_host_endpoint_halt(hid_device->dev_hdl, ctrl_xfer->bEndpointAddress),
-                             "Unable to HALT EP");
-        HID_RETURN_ON_ERROR( usb_host_endpoint_flush(hid_device->dev_hdl, ctrl_xfer->bEndpointAddress),
-                             "Unable to FLUSH EP");
-        usb_host_endpoint_clear(hid_device->dev_hdl, ctrl_xfer->bEndpointAddress);
-        return ESP_ERR_TIMEOUT;
+/**
+ * @brief Allocate latest input reports
+ *
+ * @param[in] slots_num   Number of slots
+ * @param[in] data_size   Maximum size of one report
+ * @return Latest input reports, NULL if out of memory
+ */
+static hid_latest_reports_t *hid_latest_reports_create(size_t slots_num, size_t data_size)
+{
+    hid_latest_reports_t *latest = HID_CALLOC(BUFFER, 1, sizeof(hid_latest_reports_t));
+    if (NULL == latest) {
+        return NULL;
+    }
+    latest->slots_num = slots_num;
+    latest->slot_stride = (sizeof(hid_latest_slot_t) + data_size + 7) & ~7;
+    latest->data_size = data_size;
+    latest->slots = HID_CALLOC(BUFFER, slots_num, latest->slot_stride);
+    if (NULL == latest->slots) {
+        HID_FREE(BUFFER, latest, sizeof(hid_latest_reports_t));
+        return NULL;
     }
+    return latest;
+}
 
-    ESP_LOG_BUFFER_HEXDUMP(TAG, ctrl_xfer->data_buffer, ctrl_xfer->actual_num_bytes, ESP_LOG_DEBUG);
+/**
+ * @brief Free latest input reports
+ *
+ * @param[in] latest      Latest input reports, can be NULL
+ */
+static void hid_latest_reports_delete(hid_latest_reports_t *latest)
+{
+    if (latest) {
+        HID_FREE(BUFFER, latest->slots, latest->slots_num * latest->slot_stride);
+        HID_FREE(BUFFER, latest, sizeof(hid_latest_reports_t));
+    }
+}
 
-    return ESP_OK;
+/**
+ * @brief Get slot of latest input report by Report ID
+ *
+ * @param[in] iface       Pointer to Interface structure
+ * @param[in] report_id   Report ID, 0 if the device does not use Report IDs
+ * @return Slot of the Report ID, NULL if the report map has no such input report
+ */
+static hid_latest_slot_t *HID_DATA_PATH_ATTR hid_latest_slot_get(hid_iface_t *iface, uint8_t report_id)
+{
+    const hid_report_map_t *map = iface->report_map;
+    size_t idx = 0;
+    if (map) {
+        const uint16_t index = map->input_index[map->uses_report_id ? report_id : 0];
+        if (index == 0) {
+            return NULL;
+        }
+        idx = index - 1;
+    }
+    return (hid_latest_slot_t *)(iface->latest->slots + idx * iface->latest->slot_stride);
 }
 
 /**
- * @brief USB class standard request get descriptor
+ * @brief Overwrite latest input report of its Report ID, called from the USB client task
  *
- * @param[in] hid_device  Pointer to HID device structure
- * @param[in] req         Pointer to a class specific request structure
- * @return esp_err_t
+ * @param[in] iface       Pointer to Interface structure
+ * @param[in] data        Report data
+ * @param[in] len         Length of the report
+ * @param[in] timestamp_us Time of reception
  */
-static esp_err_t usb_class_request_get_descriptor(hid_device_t *hid_device, const hid_class_request_t *req)
+static void HID_DATA_PATH_ATTR hid_latest_report_put(hid_iface_t *iface, const uint8_t *data, size_t len, int64_t timestamp_us)
 {
-    esp_err_t ret;
-    usb_transfer_t *ctrl_xfer = hid_device->ctrl_xfer;
-    const size_t ctrl_size = hid_device->ctrl_xfer->data_buffer_size;
+    if (len == 0) {
+        return;
+    }
+    hid_latest_slot_t *slot = hid_latest_slot_get(iface, data[0]);
+    if (NULL == slot) {
+        return;
+    }
 
-    HID_RETURN_ON_INVALID_ARG(hid_device);
-    HID_RETURN_ON_INVALID_ARG(hid_device->ctrl_xfer);
-    HID_RETURN_ON_INVALID_ARG(req);
-    HID_RETURN_ON_INVALID_ARG(req->data);
+    const uint32_t seq = slot->seq; // The producer is the only writer of the sequence
+    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    len = MIN(len, iface->latest->data_size);
+    memcpy(slot->data, data, len);
+    slot->len = len;
+    slot->timestamp_us = timestamp_us;
+    slot->count++;
+    __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+}
 
-    HID_RETURN_ON_ERROR( hid_device_try_lock(hid_device, DEFAULT_TIMEOUT_MS),
-                         "HID Device is busy by other task");
+/**
+ * @brief HID OUT Transfer complete callback
+ *
+ * The transfer is returned to the pool of free OUT transfers.
+ *
+ * @param[in] out_xfer  Pointer to transfer data structure
+ */
+static void HID_DATA_PATH_ATTR out_xfer_done(usb_transfer_t *out_xfer)
+{
+    assert(out_xfer);
+    CLIENT_TRACE_COMPLETE(out_xfer);
+    assert(out_xfer->context);
 
-    if (ctrl_size < (USB_SETUP_PACKET_SIZE + req->wLength)) {
-        usb_device_info_t dev_info;
-        ESP_ERROR_CHECK(usb_host_device_info(hid_device->dev_hdl, &dev_info));
-        // reallocate the ctrl xfer buffer for new length
-        ESP_LOGD(TAG, "Change HID ctrl xfer size from %d to %d",
-                 (int) ctrl_size,
-                 (int) (USB_SETUP_PACKET_SIZE + req->wLength));
+    hid_iface_t *iface = (hid_iface_t *) out_xfer->context;
 
-        usb_host_transfer_free(hid_device->ctrl_xfer);
-        HID_RETURN_ON_ERROR( usb_host_transfer_alloc(USB_SETUP_PACKET_SIZE + req->wLength,
-                             0,
-                             &hid_device->ctrl_xfer),
-                             "Unable to allocate transfer buffer for EP0");
+    if (out_xfer->status != USB_TRANSFER_STATUS_COMPLETED &&
+            out_xfer->status != USB_TRANSFER_STATUS_CANCELED &&
+            out_xfer->status != USB_TRANSFER_STATUS_NO_DEVICE) {
+        ESP_LOGE(TAG, "OUT transfer failed, status %d", out_xfer->status);
     }
+    xQueueSend(iface->out_xfer_free, &out_xfer, 0);
+}
 
-    usb_setup_packet_t *setup = (usb_setup_packet_t *)ctrl_xfer->data_buffer;
-
-    setup->bmRequestType = USB_BM_REQUEST_TYPE_DIR_IN |
-                           USB_BM_REQUEST_TYPE_TYPE_STANDARD |
-                           USB_BM_REQUEST_TYPE_RECIP_INTERFACE;
-    setup->bRequest = req->bRequest;
-    setup->wValue = req->wValue;
-    setup->wIndex = req->wIndex;
-    setup->wLength = req->wLength;
+/**
+ * @brief Pass input report to the callback registered for its Report ID
+ *
+ * @param[in] iface       Pointer to Interface structure
+ * @param[in] data        Input report
+ * @param[in] len         Length of input report
+ * @return true if the report belongs to a registered callback, even if it was not called because the report did not change
+ */
+static bool HID_DATA_PATH_ATTR hid_report_cb_dispatch(hid_iface_t *iface, const uint8_t *data, size_t len)
+{
+    if (len == 0) {
+        return false;
+    }
 
-    ret = hid_control_transfer(hid_device,
-                               USB_SETUP_PACKET_SIZE + req->wLength,
-                               DEFAULT_TIMEOUT_MS);
+    // Callback of Report ID 0 receives all reports of devices without Report IDs
+    hid_report_cb_entry_t *entry = iface->report_cbs[0] ? iface->report_cbs[0] : iface->report_cbs[data[0]];
+    if (NULL == entry) {
+        return false;
+    }
 
-    if (ESP_OK == ret) {
-        ctrl_xfer->actual_num_bytes -= USB_SETUP_PACKET_SIZE;
-        if (ctrl_xfer->actual_num_bytes <= req->wLength) {
-            memcpy(req->data, ctrl_xfer->data_buffer + USB_SETUP_PACKET_SIZE, ctrl_xfer->actual_num_bytes);
-        } else {
-            ret = ESP_ERR_INVALID_SIZE;
+    if (entry->changes_only) {
+        if (entry->last_len == len && 0 == memcmp(entry->last, data, len)) {
+            return true;
         }
+        len = MIN(len, iface->in_report_size);
+        memcpy(entry->last, data, len);
+        entry->last_len = len;
     }
+    entry->cb(iface, data, len, entry->cb_arg);
+    return true;
+}
 
-    hid_device_unlock(hid_device);
-
-    return ret;
+/**
+ * @brief Pass key events of input report to the keyboard callback
+ *
+ * @param[in] keyboard    Keyboard key events of the Interface
+ * @param[in] iface       Pointer to Interface structure
+ * @param[in] data        Input report
+ * @param[in] len         Length of input report
+ */
+static void HID_DATA_PATH_ATTR hid_keyboard_dispatch(hid_keyboard_entry_t *keyboard, hid_iface_t *iface, const uint8_t *data, size_t len)
+{
+    hid_keyboard_event_t events[HID_KEYBOARD_EVENTS_MAX];
+    const size_t event_num = hid_keyboard_process_report(&keyboard->state, data, len, events);
+    if (event_num) {
+        keyboard->cb(iface, events, event_num, &keyboard->state, keyboard->cb_arg);
+    }
 }
 
 /**
- * @brief HID Host Request Report Descriptor
+ * @brief Free report callback entry
  *
- * @param[in] iface       Pointer to HID Interface configuration structure
- * @return esp_err_t
+ * @param[in] iface       Pointer to Interface structure
+ * @param[in] entry       Report callback entry
  */
-static esp_err_t hid_class_request_report_descriptor(hid_iface_t *iface)
+static void hid_report_cb_entry_free(hid_iface_t *iface, hid_report_cb_entry_t *entry)
 {
-    HID_RETURN_ON_INVALID_ARG(iface);
+    HID_FREE(BUFFER, entry->last, iface->in_report_size);
+    HID_FREE(CONTROL, entry, sizeof(hid_report_cb_entry_t));
+}
 
-    // Get Report Descriptor is possible only in Ready or Active state
-    HID_RETURN_ON_FALSE((HID_INTERFACE_STATE_READY == iface->state) ||
-                        (HID_INTERFACE_STATE_ACTIVE == iface->state),
-                        ESP_ERR_INVALID_STATE,
-                        "Unable to request report descriptor. Interface is not ready");
+/**
+ * @brief Free report callbacks of the Interface
+ *
+ * @param[in] iface       Pointer to Interface structure
+ */
+static void hid_report_cbs_free(hid_iface_t *iface)
+{
+    if (NULL == iface->report_cbs) {
+        return;
+    }
+    for (int i = 0; i < 256; i++) {
+        if (iface->report_cbs[i]) {
+            hid_report_cb_entry_free(iface, iface->report_cbs[i]);
+        }
+    }
+    HID_FREE(CONTROL, iface->report_cbs, 256 * sizeof(hid_report_cb_entry_t *));
+    iface->report_cbs = NULL;
+}
 
-    iface->report_desc = malloc(iface->report_desc_size);
-    HID_RETURN_ON_FALSE(iface->report_desc,
-                        ESP_ERR_NO_MEM,
-                        "Unable to allocate memory");
+/**
+ * @brief HID Host free IN and OUT transfers of the Interface
+ *
+ * @param[in] iface       Pointer to Interface structure
+ */
+static void hid_host_interface_free_transfers(hid_iface_t *iface)
+{
+    if (iface->in_xfer) {
+        for (int i = 0; i < iface->in_xfer_num; i++) {
+            if (iface->in_xfer[i]) {
+                ESP_ERROR_CHECK( CLIENT_TRANSFER_FREE(iface->in_xfer[i]) );
+            }
+        }
+        HID_FREE(CONTROL, iface->in_xfer, iface->in_xfer_num * sizeof(usb_transfer_t *));
+        iface->in_xfer = NULL;
+    }
+    iface->in_xfer_last = NULL;
+    hid_report_queue_delete(iface->report_queue);
+    iface->report_queue = NULL;
+    hid_latest_reports_delete(iface->latest);
+    iface->latest = NULL;
+
+    if (iface->out_xfer) {
+        for (int i = 0; i < iface->out_xfer_num; i++) {
+            if (iface->out_xfer[i]) {
+                ESP_ERROR_CHECK( CLIENT_TRANSFER_FREE(iface->out_xfer[i]) );
+            }
+        }
+        HID_FREE(CONTROL, iface->out_xfer, iface->out_xfer_num * sizeof(usb_transfer_t *));
+        iface->out_xfer = NULL;
+    }
+    if (iface->out_xfer_free) {
+        vQueueDelete(iface->out_xfer_free);
+        iface->out_xfer_free = NULL;
+    }
+}
 
-    const hid_class_request_t get_desc = {
-        .bRequest = USB_B_REQUEST_GET_DESCRIPTOR,
-        .wValue = (HID_CLASS_DESCRIPTOR_TYPE_REPORT << 8),
-        .wIndex = iface->dev_params.iface_num,
-        .wLength = iface->report_desc_size,
-        .data = iface->report_desc
-    };
+/**
+ * @brief Size of the largest input report of the Interface
+ *
+ * @param[in] iface       Pointer to Interface structure with compiled report map
+ * @return Size of the largest input report, including Report ID byte. 0 if there is no input report
+ */
+static size_t hid_report_map_input_size_max(const hid_iface_t *iface)
+{
+    size_t size = 0;
+    for (uint16_t i = 0; i < iface->report_map->report_num; i++) {
+        const hid_report_t *report = &iface->report_map->reports[i];
+        if (HID_REPORT_TYPE_INPUT == report->type) {
+            size = MAX(size, report->len);
+        }
+    }
+    // Boot interfaces may be switched to Boot Protocol with 8 bytes reports
+    if (HID_SUBCLASS_BOOT_INTERFACE == iface->dev_params.sub_class) {
+        size = MAX(size, 8);
+    }
+    return size;
+}
 
-    return usb_class_request_get_descriptor(iface->parent, &get_desc);
+/**
+ * @brief Size of interrupt IN transfer of the Interface
+ *
+ * USB Host accepts only IN transfers of a multiple of max packet size.
+ *
+ * @param[in] iface       Pointer to Interface structure
+ * @return Size of interrupt IN transfer
+ */
+static inline size_t hid_host_in_xfer_size(const hid_iface_t *iface)
+{
+    return (iface->in_report_size + iface->ep_in_mps - 1) / iface->ep_in_mps * iface->ep_in_mps;
 }
 
 /**
- * @brief HID class specific request Set
+ * @brief HID Host claim Interface and prepare transfer, change state to READY
  *
- * @param[in] hid_device Pointer to HID device structure
- * @param[in] req        Pointer to a class specific request structure
+ * @param[in] iface             Pointer to Interface structure,
+ * @param[in] config            Device configuration
  * @return esp_err_t
  */
-static esp_err_t hid_class_request_set(hid_device_t *hid_device,
-                                       const hid_class_request_t *req)
+static esp_err_t hid_host_interface_claim_and_prepare_transfer(hid_iface_t *iface, const hid_host_device_config_t *config)
 {
-    esp_err_t ret;
-    usb_transfer_t *ctrl_xfer = hid_device->ctrl_xfer;
-    HID_RETURN_ON_INVALID_ARG(hid_device);
-    HID_RETURN_ON_INVALID_ARG(hid_device->ctrl_xfer);
+    HID_RETURN_ON_ERROR( usb_host_interface_claim( s_hid_driver->client_handle,
+                         iface->parent->dev_hdl,
+                         iface->dev_params.iface_num, 0),
+                         "Unable to claim Interface");
 
-    HID_RETURN_ON_ERROR( hid_device_try_lock(hid_device, DEFAULT_TIMEOUT_MS),
-                         "HID Device is busy by other task");
+    // Latest reports are kept per Report ID of the report map
+    if (s_hid_driver->low_memory || config->latest_reports) {
+        hid_report_map_compile(iface);
+    }
 
-    usb_setup_packet_t *setup = (usb_setup_packet_t *)ctrl_xfer->data_buffer;
-    setup->bmRequestType = USB_BM_REQUEST_TYPE_DIR_OUT |
-                           USB_BM_REQUEST_TYPE_TYPE_CLASS |
-                           USB_BM_REQUEST_TYPE_RECIP_INTERFACE;
-    setup->bRequest = req->bRequest;
-    setup->wValue = req->wValue;
-    setup->wIndex = req->wIndex;
-    setup->wLength = req->wLength;
+    // Low-memory mode: buffers of input reports are sized to the largest input report of the Report Descriptor.
+    // Only the compiled map is kept, hid_host_get_report_descriptor() requests the Report Descriptor again
+    iface->in_report_size = iface->ep_in_mps;
+    if (s_hid_driver->low_memory) {
+        const size_t input_size = iface->report_map ? hid_report_map_input_size_max(iface) : 0;
+        HID_FREE(DESCRIPTOR, iface->report_desc, iface->report_desc_size);
+        iface->report_desc = NULL;
+        if (input_size) {
+            iface->in_report_size = input_size;
+        } else {
+            ESP_LOGW(TAG, "Input report size unknown, buffers of max packet size are used");
+        }
+    }
 
-    if (req->wLength && req->data) {
-        memcpy(ctrl_xfer->data_buffer + USB_SETUP_PACKET_SIZE, req->data, req->wLength);
+    iface->in_xfer = HID_CALLOC(CONTROL, iface->in_xfer_num, sizeof(usb_transfer_t *));
+    if (NULL == iface->in_xfer) {
+        usb_host_interface_release(s_hid_driver->client_handle, iface->parent->dev_hdl, iface->dev_params.iface_num);
+        ESP_LOGE(TAG, "Unable to allocate IN transfers");
+        return ESP_ERR_NO_MEM;
     }
 
-    ret = hid_control_transfer(hid_device,
-                               USB_SETUP_PACKET_SIZE + setup->wLength,
-                               DEFAULT_TIMEOUT_MS);
+    for (int i = 0; i < iface->in_xfer_num; i++) {
+        esp_err_t ret = CLIENT_TRANSFER_ALLOC(hid_host_in_xfer_size(iface), 0, &iface->in_xfer[i]);
+        if (ESP_OK != ret) {
+            hid_host_interface_free_transfers(iface);
+            usb_host_interface_release(s_hid_driver->client_handle, iface->parent->dev_hdl, iface->dev_params.iface_num);
+            ESP_LOGE(TAG, "Unable to allocate transfer buffer for EP IN");
+            return ret;
+        }
+    }
 
-    hid_device_unlock(hid_device);
+    if (iface->ep_out) {
+        // Pool of OUT transfers, a free transfer is taken for each output report and returned on its completion
+        iface->out_xfer = HID_CALLOC(CONTROL, iface->out_xfer_num, sizeof(usb_transfer_t *));
+        iface->out_xfer_free = xQueueCreate(iface->out_xfer_num, sizeof(usb_transfer_t *));
+        esp_err_t ret = (iface->out_xfer && iface->out_xfer_free) ? ESP_OK : ESP_ERR_NO_MEM;
+        for (int i = 0; ESP_OK == ret && i < iface->out_xfer_num; i++) {
+            ret = CLIENT_TRANSFER_ALLOC(iface->ep_out_mps, 0, &iface->out_xfer[i]);
+            if (ESP_OK == ret) {
+                usb_transfer_t *out_xfer = iface->out_xfer[i];
+                out_xfer->device_handle = iface->parent->dev_hdl;
+                out_xfer->callback = out_xfer_done;
+                out_xfer->context = iface;
+                out_xfer->timeout_ms = DEFAULT_TIMEOUT_MS;
+                out_xfer->bEndpointAddress = iface->ep_out;
+                xQueueSend(iface->out_xfer_free, &out_xfer, 0);
+            }
+        }
+        if (ESP_OK != ret) {
+            hid_host_interface_free_transfers(iface);
+            usb_host_interface_release(s_hid_driver->client_handle, iface->parent->dev_hdl, iface->dev_params.iface_num);
+            ESP_LOGE(TAG, "Unable to allocate transfers for EP OUT");
+            return ret;
+        }
+    }
 
-    return ret;
+    if (config->report_queue_len) {
+        iface->report_queue = hid_report_queue_create(config->report_queue_len, iface->in_report_size);
+        if (NULL == iface->report_queue) {
+            hid_host_interface_free_transfers(iface);
+            usb_host_interface_release(s_hid_driver->client_handle, iface->parent->dev_hdl, iface->dev_params.iface_num);
+            ESP_LOGE(TAG, "Unable to allocate report queue");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    if (config->latest_reports) {
+        if (NULL == iface->report_map) {
+            ESP_LOGW(TAG, "No report map, the latest report of any Report ID is kept");
+        }
+        const size_t slots_num = iface->report_map ? MAX(iface->report_map->report_num, 1) : 1;
+        iface->latest = hid_latest_reports_create(slots_num, iface->in_report_size);
+        if (NULL == iface->latest) {
+            hid_host_interface_free_transfers(iface);
+            usb_host_interface_release(s_hid_driver->client_handle, iface->parent->dev_hdl, iface->dev_params.iface_num);
+            ESP_LOGE(TAG, "Unable to allocate latest reports");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    memset(&iface->stats, 0, sizeof(hid_host_stats_t));
+    iface->stats.poll_interval_us = hid_host_poll_interval_us(iface);
+
+    // Change state
+    iface->state = HID_INTERFACE_STATE_READY;
+    return ESP_OK;
 }
 
 /**
- * @brief HID class specific request Get
+ * @brief HID Host release Interface and free transfer, change state to IDLE
  *
- * @param[in] hid_device    Pointer to HID device structure
- * @param[in] req           Pointer to a class specific request structure
- * @param[out] out_length   Length of the response in data buffer of req struct
+ * @param[in] iface       Pointer to Interface structure,
  * @return esp_err_t
  */
-static esp_err_t hid_class_request_get(hid_device_t *hid_device,
+static esp_err_t hid_host_interface_release_and_free_transfer(hid_iface_t *iface)
+{
+    HID_RETURN_ON_INVALID_ARG(iface);
+    HID_RETURN_ON_INVALID_ARG(iface->parent);
+
+    HID_RETURN_ON_FALSE(is_interface_in_list(iface),
+                        ESP_ERR_NOT_FOUND,
+                        "Interface handle not found");
+
+    HID_RETURN_ON_ERROR( usb_host_interface_release(s_hid_driver->client_handle,
+                         iface->parent->dev_hdl,
+                         iface->dev_params.iface_num),
+                         "Unable to release HID Interface");
+
+    hid_host_interface_free_transfers(iface);
+    hid_report_cbs_free(iface);
+    HID_FREE(CONTROL, iface->keyboard, sizeof(hid_keyboard_entry_t));
+    iface->keyboard = NULL;
+    HID_ENTER_CRITICAL();
+    _hid_host_mux_remove(iface);
+    HID_EXIT_CRITICAL();
+
+    // Change state
+    iface->state = HID_INTERFACE_STATE_IDLE;
+    return ESP_OK;
+}
+
+/**
+ * @brief Disable active interface
+ *
+ * @param[in] iface       Pointer to Interface structure
+ * @return esp_err_t
+ */
+static esp_err_t hid_host_disable_interface(hid_iface_t *iface)
+{
+    HID_RETURN_ON_INVALID_ARG(iface);
+    HID_RETURN_ON_INVALID_ARG(iface->parent);
+
+    HID_RETURN_ON_FALSE(is_interface_in_list(iface),
+                        ESP_ERR_NOT_FOUND,
+                        "Interface handle not found");
+
+    HID_RETURN_ON_FALSE((HID_INTERFACE_STATE_ACTIVE == iface->state),
+                        ESP_ERR_INVALID_STATE,
+                        "Interface wrong state");
+
+    HID_RETURN_ON_ERROR( usb_host_endpoint_halt(iface->parent->dev_hdl, iface->ep_in),
+                         "Unable to HALT EP");
+    HID_RETURN_ON_ERROR( usb_host_endpoint_flush(iface->parent->dev_hdl, iface->ep_in),
+                         "Unable to FLUSH EP");
+    usb_host_endpoint_clear(iface->parent->dev_hdl, iface->ep_in);
+
+    if (iface->ep_out) {
+        // Cancel output reports in flight, their transfers return to the pool
+        HID_RETURN_ON_ERROR( usb_host_endpoint_halt(iface->parent->dev_hdl, iface->ep_out),
+                             "Unable to HALT EP OUT");
+        HID_RETURN_ON_ERROR( usb_host_endpoint_flush(iface->parent->dev_hdl, iface->ep_out),
+                             "Unable to FLUSH EP OUT");
+        usb_host_endpoint_clear(iface->parent->dev_hdl, iface->ep_out);
+    }
+
+    iface->state = HID_INTERFACE_STATE_READY;
+
+    return ESP_OK;
+}
+
+/**
+ * @brief HID IN Transfer complete callback
+ *
+ * @param[in] transfer  Pointer to transfer data structure
+ */
+static void HID_DATA_PATH_ATTR in_xfer_done(usb_transfer_t *in_xfer)
+{
+    assert(in_xfer);
+    CLIENT_TRACE_COMPLETE(in_xfer);
+    assert(in_xfer->context);
+
+    hid_iface_t *iface = (hid_iface_t *) in_xfer->context;
+    int64_t start_us;
+
+    switch (in_xfer->status) {
+    case USB_TRANSFER_STATUS_COMPLETED:
+        start_us = hid_report_time_us();
+        hid_stats_report_received(iface, start_us);
+        // Other transfers stay queued while the user handles this one
+        iface->in_xfer_last = in_xfer;
+        if (iface->report_queue) {
+            hid_report_queue_push(iface->report_queue, iface, in_xfer->data_buffer, in_xfer->actual_num_bytes, start_us);
+        }
+        CLIENT_TRACE(DELIVER, in_xfer->bEndpointAddress, in_xfer->actual_num_bytes, iface);
+        CLIENT_TRACE(CALLBACK_ENTER, in_xfer->bEndpointAddress, 0, iface);
+        // Notify user, reports with registered keyboard or Report ID callback are not passed to the interface callback.
+        // Interfaces keeping the latest reports or in a multiplexer store the report instead of calling the interface callback
+        if (iface->keyboard) {
+            hid_keyboard_dispatch(iface->keyboard, iface, in_xfer->data_buffer, in_xfer->actual_num_bytes);
+        } else if (!iface->report_cbs ||
+                   !hid_report_cb_dispatch(iface, in_xfer->data_buffer, in_xfer->actual_num_bytes)) {
+            if (iface->latest) {
+                hid_latest_report_put(iface, in_xfer->data_buffer, in_xfer->actual_num_bytes, start_us);
+            } else if (iface->mux) {
+                hid_report_queue_push(iface->mux->queue, iface, in_xfer->data_buffer, in_xfer->actual_num_bytes, start_us);
+            } else {
+                hid_host_user_interface_callback(iface, HID_HOST_INTERFACE_EVENT_INPUT_REPORT);
+            }
+        }
+        CLIENT_TRACE(CALLBACK_EXIT, in_xfer->bEndpointAddress, 0, iface);
+        const unsigned bucket = hid_stats_bucket(hid_report_time_us() - start_us, 16);
+        HID_ENTER_CRITICAL();
+        iface->stats.callback_histogram[bucket]++;
+        HID_EXIT_CRITICAL();
+        // Relaunch transfer
+        CLIENT_TRANSFER_SUBMIT(in_xfer);
+        return;
+    case USB_TRANSFER_STATUS_NO_DEVICE:
+    case USB_TRANSFER_STATUS_CANCELED:
+        // User is notified about device disconnection from usb_event_cb
+        // No need to do anything
+        return;
+    default:
+        // Any other error
+        break;
+    }
+
+    ESP_LOGE(TAG, "Transfer failed, status %d", in_xfer->status);
+    HID_ENTER_CRITICAL();
+    iface->stats.transfer_errors++;
+    HID_EXIT_CRITICAL();
+    // Notify user about transfer or any other error
+    hid_host_user_interface_callback(iface, HID_HOST_INTERFACE_EVENT_TRANSFER_ERROR);
+}
+
+/** Lock HID device from other task
+ *
+ * @param[in] hid_device    Pointer to HID device structure
+ * @param[in] timeout_ms    Timeout of trying to take the mutex
+ * @return esp_err_t
+ */
+static inline esp_err_t hid_device_try_lock(hid_device_t *hid_device, uint32_t timeout_ms)
+{
+    if (!xSemaphoreTake(hid_device->device_busy, pdMS_TO_TICKS(timeout_ms))) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    // Low-memory mode: the locked device uses a control transfer of the shared pool
+    if (s_hid_driver->ctrl_xfer_pool && NULL == hid_device->ctrl_xfer) {
+        hid_ctrl_slot_t slot;
+        if (!xQueueReceive(s_hid_driver->ctrl_xfer_pool, &slot, pdMS_TO_TICKS(timeout_ms))) {
+            xSemaphoreGive(hid_device->device_busy);
+            return ESP_ERR_TIMEOUT;
+        }
+        hid_device->ctrl_xfer = slot.xfer;
+        hid_device->ctrl_xfer_done = slot.done;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Return control transfer of the device to the shared pool
+ *
+ * A transfer that did not complete is still owned by USB Host, it is returned when the device is uninstalled.
+ *
+ * @param[in] hid_device    Pointer to HID device structure
+ */
+static void hid_device_ctrl_xfer_put(hid_device_t *hid_device)
+{
+    const hid_ctrl_slot_t slot = {
+        .xfer = hid_device->ctrl_xfer,
+        .done = hid_device->ctrl_xfer_done,
+    };
+    xSemaphoreTake(slot.done, 0); // Late completion of a transfer that timed out
+    xQueueSend(s_hid_driver->ctrl_xfer_pool, &slot, 0);
+    hid_device->ctrl_xfer = NULL;
+    hid_device->ctrl_xfer_done = NULL;
+    hid_device->ctrl_xfer_timed_out = false;
+}
+
+/** Unlock HID device from other task
+ *
+ * @param[in] hid_device    Pointer to HID device structure
+ * @param[in] timeout_ms    Timeout of trying to take the mutex
+ * @return esp_err_t
+ */
+static inline void hid_device_unlock(hid_device_t *hid_device)
+{
+    if (s_hid_driver->ctrl_xfer_pool && hid_device->ctrl_xfer && !hid_device->ctrl_xfer_timed_out) {
+        hid_device_ctrl_xfer_put(hid_device);
+    }
+    xSemaphoreGive(hid_device->device_busy);
+}
+
+/**
+ * @brief HID Control transfer complete callback
+ *
+ * @param[in] ctrl_xfer  Pointer to transfer data structure
+ */
+static void ctrl_xfer_done(usb_transfer_t *ctrl_xfer)
+{
+    assert(ctrl_xfer);
+    CLIENT_TRACE_COMPLETE(ctrl_xfer);
+    hid_device_t *hid_device = (hid_device_t *)ctrl_xfer->context;
+    xSemaphoreGive(hid_device->ctrl_xfer_done);
+}
+
+/**
+ * @brief HID control transfer synchronous.
+ *
+ * @note  Passes interface and endpoint descriptors to obtain:
+
+ *        - interface number, IN endpoint, OUT endpoint, max. packet size
+ *
+ * @param[in] hid_device  Pointer to HID device structure
+ * @param[in] ctrl_xfer   Pointer to the Transfer structure
+ * @param[in] len         Number of bytes to transfer
+ * @param[in] timeout_ms  Timeout in ms
+ * @return esp_err_t
+ */
+static esp_err_t hid_control_transfer(hid_device_t *hid_device,
+                                      size_t len,
+                                      uint32_t timeout_ms)
+{
+
+    usb_transfer_t *ctrl_xfer = hid_device->ctrl_xfer;
+
+    ctrl_xfer->device_handle = hid_device->dev_hdl;
+    ctrl_xfer->callback = ctrl_xfer_done;
+    ctrl_xfer->context = hid_device;
+    ctrl_xfer->bEndpointAddress = 0;
+    ctrl_xfer->timeout_ms = timeout_ms;
+    ctrl_xfer->num_bytes = len;
+
+    HID_RETURN_ON_ERROR( CLIENT_TRANSFER_SUBMIT_CONTROL(s_hid_driver->client_handle, ctrl_xfer),
+                         "Unable to submit control transfer");
+
+    BaseType_t received = xSemaphoreTake(hid_device->ctrl_xfer_done, pdMS_TO_TICKS(ctrl_xfer->timeout_ms));
+
+    if (received != pdTRUE) {
+        // Transfer was not finished, error in USB LIB. Reset the endpoint
+        ESP_LOGE(TAG, "Control Transfer Timeout");
+        hid_device->ctrl_xfer_timed_out = true;
+
+        HID_RETURN_ON_ERROR( usb_host_endpoint_halt(hid_device->dev_hdl, ctrl_xfer->bEndpointAddress),
+                             "Unable to HALT EP");
+        HID_RETURN_ON_ERROR( usb_host_endpoint_flush(hid_device->dev_hdl, ctrl_xfer->bEndpointAddress),
+                             "Unable to FLUSH EP");
+        usb_host_endpoint_clear(hid_device->dev_hdl, ctrl_xfer->bEndpointAddress);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    hid_device->ctrl_xfer_timed_out = false;
+    ESP_LOG_BUFFER_HEXDUMP(TAG, ctrl_xfer->data_buffer, ctrl_xfer->actual_num_bytes, ESP_LOG_DEBUG);
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Convert transfer status to error code of asynchronous request completion
+ *
+ * @param[in] status  Transfer status
+ * @return esp_err_t
+ */
+static esp_err_t hid_async_req_status_to_err(usb_transfer_status_t status)
+{
+    switch (status) {
+    case USB_TRANSFER_STATUS_COMPLETED:
+        return ESP_OK;
+    case USB_TRANSFER_STATUS_STALL:
+        return ESP_ERR_NOT_SUPPORTED;
+    case USB_TRANSFER_STATUS_TIMED_OUT:
+        return ESP_ERR_TIMEOUT;
+    case USB_TRANSFER_STATUS_NO_DEVICE:
+    case USB_TRANSFER_STATUS_CANCELED:
+        return ESP_ERR_INVALID_STATE;
+    default:
+        return ESP_FAIL;
+    }
+}
+
+static void async_ctrl_xfer_done(usb_transfer_t *ctrl_xfer);
+
+/**
+ * @brief Allocated size of asynchronous request, data stage is stored for OUT requests only
+ *
+ * @param[in] req         Asynchronous request
+ * @return Size in bytes
+ */
+static inline size_t hid_async_req_size(const hid_async_req_t *req)
+{
+    return sizeof(hid_async_req_t) + ((req->setup.bmRequestType & USB_BM_REQUEST_TYPE_DIR_IN) ? 0 : req->setup.wLength);
+}
+
+/**
+ * @brief Remove finished asynchronous request from the queue and call its callback
+ *
+ * @param[in] hid_device  Pointer to HID device structure
+ * @param[in] ret         Result of the request
+ * @param[in] data        Received data of IN request
+ * @param[in] data_len    Length of received data
+ * @return true if more requests are queued
+ */
+static bool hid_async_req_finish(hid_device_t *hid_device, esp_err_t ret, const uint8_t *data, size_t data_len)
+{
+    HID_ENTER_CRITICAL();
+    hid_async_req_t *req = STAILQ_FIRST(&hid_device->async_reqs_tailq);
+    STAILQ_REMOVE_HEAD(&hid_device->async_reqs_tailq, tailq_entry);
+    hid_device->async_reqs_num--;
+    const bool more = !STAILQ_EMPTY(&hid_device->async_reqs_tailq);
+    HID_EXIT_CRITICAL();
+
+    if (req->iface && req->cb) {
+        req->cb(req->iface, ret, data, data_len, req->cb_arg);
+    }
+    HID_FREE(CONTROL, req, hid_async_req_size(req));
+    return more;
+}
+
+/**
+ * @brief Submit first queued asynchronous request
+ *
+ * Called when no asynchronous request is in flight. Requests that cannot be submitted are finished with an error.
+ *
+ * @param[in] hid_device  Pointer to HID device structure
+ */
+static void hid_async_req_submit_next(hid_device_t *hid_device)
+{
+    bool more = true;
+    while (more) {
+        HID_ENTER_CRITICAL();
+        hid_async_req_t *req = STAILQ_FIRST(&hid_device->async_reqs_tailq);
+        HID_EXIT_CRITICAL();
+
+        const size_t len = USB_SETUP_PACKET_SIZE + req->setup.wLength;
+        esp_err_t ret = ESP_OK;
+        if (NULL == hid_device->async_xfer || hid_device->async_xfer->data_buffer_size < len) {
+            CLIENT_TRANSFER_FREE(hid_device->async_xfer);
+            hid_device->async_xfer = NULL;
+            ret = CLIENT_TRANSFER_ALLOC(MAX(len, 64), 0, &hid_device->async_xfer);
+        }
+
+        if (ESP_OK == ret) {
+            usb_transfer_t *ctrl_xfer = hid_device->async_xfer;
+            memcpy(ctrl_xfer->data_buffer, &req->setup, USB_SETUP_PACKET_SIZE);
+            if (!(req->setup.bmRequestType & USB_BM_REQUEST_TYPE_DIR_IN)) {
+                memcpy(ctrl_xfer->data_buffer + USB_SETUP_PACKET_SIZE, req->data, req->setup.wLength);
+            }
+            ctrl_xfer->device_handle = hid_device->dev_hdl;
+            ctrl_xfer->callback = async_ctrl_xfer_done;
+            ctrl_xfer->context = hid_device;
+            ctrl_xfer->bEndpointAddress = 0;
+            ctrl_xfer->timeout_ms = DEFAULT_TIMEOUT_MS;
+            ctrl_xfer->num_bytes = len;
+            ret = CLIENT_TRANSFER_SUBMIT_CONTROL(s_hid_driver->client_handle, ctrl_xfer);
+            if (ESP_OK == ret) {
+                return;
+            }
+        }
+
+        ESP_LOGE(TAG, "Unable to submit asynchronous request: %s", esp_err_to_name(ret));
+        more = hid_async_req_finish(hid_device, ret, NULL, 0);
+    }
+}
+
+/**
+ * @brief HID asynchronous control transfer complete callback
+ *
+ * @param[in] ctrl_xfer  Pointer to transfer data structure
+ */
+static void async_ctrl_xfer_done(usb_transfer_t *ctrl_xfer)
+{
+    assert(ctrl_xfer);
+    CLIENT_TRACE_COMPLETE(ctrl_xfer);
+    hid_device_t *hid_device = (hid_device_t *)ctrl_xfer->context;
+    const usb_setup_packet_t *setup = (const usb_setup_packet_t *)ctrl_xfer->data_buffer;
+    const uint8_t *data = NULL;
+    size_t data_len = 0;
+
+    const esp_err_t ret = hid_async_req_status_to_err(ctrl_xfer->status);
+    if (ESP_OK == ret && (setup->bmRequestType & USB_BM_REQUEST_TYPE_DIR_IN)) {
+        data = ctrl_xfer->data_buffer + USB_SETUP_PACKET_SIZE;
+        data_len = ctrl_xfer->actual_num_bytes - USB_SETUP_PACKET_SIZE;
+    }
+
+    if (hid_async_req_finish(hid_device, ret, data, data_len)) {
+        hid_async_req_submit_next(hid_device);
+    }
+}
+
+/**
+ * @brief Queue asynchronous class request
+ *
+ * @param[in] iface       Pointer to Interface structure
+ * @param[in] setup       Setup packet
+ * @param[in] data        Data stage of OUT request, copied to the queue
+ * @param[in] cb          Completion callback
+ * @param[in] cb_arg      Completion callback argument
+ * @return esp_err_t
+ */
+static esp_err_t hid_async_req_queue(hid_iface_t *iface,
+                                     const usb_setup_packet_t *setup,
+                                     const uint8_t *data,
+                                     hid_host_request_cb_t cb,
+                                     void *cb_arg)
+{
+    hid_device_t *hid_device = iface->parent;
+    const size_t data_len = (setup->bmRequestType & USB_BM_REQUEST_TYPE_DIR_IN) ? 0 : setup->wLength;
+    hid_async_req_t *req = HID_MALLOC(CONTROL, sizeof(hid_async_req_t) + data_len);
+
+    HID_RETURN_ON_FALSE(req,
+                        ESP_ERR_NO_MEM,
+                        "Unable to allocate memory");
+
+    req->iface = iface;
+    req->cb = cb;
+    req->cb_arg = cb_arg;
+    req->setup = *setup;
+    if (data_len) {
+        memcpy(req->data, data, data_len);
+    }
+
+    HID_ENTER_CRITICAL();
+    if (hid_device->async_reqs_num == HID_ASYNC_REQ_QUEUE_MAX) {
+        HID_EXIT_CRITICAL();
+        HID_FREE(CONTROL, req, sizeof(hid_async_req_t) + data_len);
+        ESP_LOGE(TAG, "Asynchronous request queue full");
+        return ESP_ERR_NO_MEM;
+    }
+    // The first request is submitted here, the others from the completion callback of the previous one
+    const bool submit = STAILQ_EMPTY(&hid_device->async_reqs_tailq);
+    STAILQ_INSERT_TAIL(&hid_device->async_reqs_tailq, req, tailq_entry);
+    hid_device->async_reqs_num++;
+    HID_EXIT_CRITICAL();
+
+    if (submit) {
+        hid_async_req_submit_next(hid_device);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Drop queued asynchronous requests of the closed interface
+ *
+ * The request in flight stays in the queue without interface, its callback is not called.
+ *
+ * @param[in] iface       Pointer to Interface structure
+ */
+static void hid_async_req_drop_iface(hid_iface_t *iface)
+{
+    hid_device_t *hid_device = iface->parent;
+    if (NULL == hid_device) {
+        return;
+    }
+
+    STAILQ_HEAD(dropped_reqs, hid_async_req) dropped = STAILQ_HEAD_INITIALIZER(dropped);
+
+    HID_ENTER_CRITICAL();
+    hid_async_req_t *req = STAILQ_FIRST(&hid_device->async_reqs_tailq);
+    if (req && req->iface == iface) {
+        req->iface = NULL;
+    }
+    req = req ? STAILQ_NEXT(req, tailq_entry) : NULL;
+    while (req) {
+        hid_async_req_t *next = STAILQ_NEXT(req, tailq_entry);
+        if (req->iface == iface) {
+            STAILQ_REMOVE(&hid_device->async_reqs_tailq, req, hid_async_req, tailq_entry);
+            hid_device->async_reqs_num--;
+            STAILQ_INSERT_TAIL(&dropped, req, tailq_entry);
+        }
+        req = next;
+    }
+    HID_EXIT_CRITICAL();
+
+    // Free outside of the critical section
+    while ((req = STAILQ_FIRST(&dropped)) != NULL) {
+        STAILQ_REMOVE_HEAD(&dropped, tailq_entry);
+        HID_FREE(CONTROL, req, hid_async_req_size(req));
+    }
+}
+
+/**
+ * @brief USB class standard request get descriptor
+ *
+ * @param[in] hid_device  Pointer to HID device structure
+ * @param[in] req         Pointer to a class specific request structure
+ * @return esp_err_t
+ */
+static esp_err_t usb_class_request_get_descriptor(hid_device_t *hid_device, const hid_class_request_t *req)
+{
+    esp_err_t ret;
+
+    HID_RETURN_ON_INVALID_ARG(hid_device);
+    HID_RETURN_ON_INVALID_ARG(req);
+    HID_RETURN_ON_INVALID_ARG(req->data);
+
+    HID_RETURN_ON_ERROR( hid_device_try_lock(hid_device, DEFAULT_TIMEOUT_MS),
+                         "HID Device is busy by other task");
+
+    const size_t ctrl_size = hid_device->ctrl_xfer->data_buffer_size;
+    if (ctrl_size < (USB_SETUP_PACKET_SIZE + req->wLength)) {
+        usb_device_info_t dev_info;
+        ESP_ERROR_CHECK(usb_host_device_info(hid_device->dev_hdl, &dev_info));
+        // reallocate the ctrl xfer buffer for new length
+        ESP_LOGD(TAG, "Change HID ctrl xfer size from %d to %d",
+                 (int) ctrl_size,
+                 (int) (USB_SETUP_PACKET_SIZE + req->wLength));
+
+        // The previous transfer is kept on failure. A transfer of the shared pool goes back to the pool with the new size
+        usb_transfer_t *new_xfer;
+        ret = CLIENT_TRANSFER_ALLOC(USB_SETUP_PACKET_SIZE + req->wLength, 0, &new_xfer);
+        if (ESP_OK != ret) {
+            hid_device_unlock(hid_device);
+            ESP_LOGE(TAG, "Unable to allocate transfer buffer for EP0");
+            return ret;
+        }
+        CLIENT_TRANSFER_FREE(hid_device->ctrl_xfer);
+        hid_device->ctrl_xfer = new_xfer;
+    }
+
+    usb_transfer_t *ctrl_xfer = hid_device->ctrl_xfer;
+    usb_setup_packet_t *setup = (usb_setup_packet_t *)ctrl_xfer->data_buffer;
+
+    setup->bmRequestType = USB_BM_REQUEST_TYPE_DIR_IN |
+                           USB_BM_REQUEST_TYPE_TYPE_STANDARD |
+                           USB_BM_REQUEST_TYPE_RECIP_INTERFACE;
+    setup->bRequest = req->bRequest;
+    setup->wValue = req->wValue;
+    setup->wIndex = req->wIndex;
+    setup->wLength = req->wLength;
+
+    ret = hid_control_transfer(hid_device,
+                               USB_SETUP_PACKET_SIZE + req->wLength,
+                               DEFAULT_TIMEOUT_MS);
+
+    if (ESP_OK == ret) {
+        ctrl_xfer->actual_num_bytes -= USB_SETUP_PACKET_SIZE;
+        if (ctrl_xfer->actual_num_bytes <= req->wLength) {
+            memcpy(req->data, ctrl_xfer->data_buffer + USB_SETUP_PACKET_SIZE, ctrl_xfer->actual_num_bytes);
+        } else {
+            ret = ESP_ERR_INVALID_SIZE;
+        }
+    }
+
+    hid_device_unlock(hid_device);
+
+    return ret;
+}
+
+/**
+ * @brief Request Report Descriptor of claimed Interface
+ *
+ * @param[in] iface       Pointer to HID Interface configuration structure
+ * @return esp_err_t
+ */
+static esp_err_t hid_report_descriptor_request(hid_iface_t *iface)
+{
+    // Same device with the same firmware gives the same Report Descriptor, take it from the cache if possible
+    hid_report_desc_cache_key_t cache_key = {
+        .bInterfaceNumber = iface->dev_params.iface_num,
+        .wReportDescriptorLength = iface->report_desc_size,
+    };
+    const usb_device_desc_t *dev_desc;
+    const bool cacheable = (ESP_OK == usb_host_get_device_descriptor(iface->parent->dev_hdl, &dev_desc));
+    if (cacheable) {
+        cache_key.idVendor = dev_desc->idVendor;
+        cache_key.idProduct = dev_desc->idProduct;
+        cache_key.bcdDevice = dev_desc->bcdDevice;
+    }
+
+    iface->report_desc = HID_MALLOC(DESCRIPTOR, iface->report_desc_size);
+    HID_RETURN_ON_FALSE(iface->report_desc,
+                        ESP_ERR_NO_MEM,
+                        "Unable to allocate memory");
+    if (cacheable && hid_report_desc_cache_get(&cache_key, iface->report_desc)) {
+        return ESP_OK;
+    }
+
+    const hid_class_request_t get_desc = {
+        .bRequest = USB_B_REQUEST_GET_DESCRIPTOR,
+        .wValue = (HID_CLASS_DESCRIPTOR_TYPE_REPORT << 8),
+        .wIndex = iface->dev_params.iface_num,
+        .wLength = iface->report_desc_size,
+        .data = iface->report_desc
+    };
+
+    esp_err_t ret = usb_class_request_get_descriptor(iface->parent, &get_desc);
+    if (ESP_OK != ret) {
+        HID_FREE(DESCRIPTOR, iface->report_desc, iface->report_desc_size);
+        iface->report_desc = NULL;
+    } else if (cacheable) {
+        hid_report_desc_cache_put(&cache_key, iface->report_desc);
+    }
+    return ret;
+}
+
+/**
+ * @brief HID Host Request Report Descriptor
+ *
+ * @param[in] iface       Pointer to HID Interface configuration structure
+ * @return esp_err_t
+ */
+static esp_err_t hid_class_request_report_descriptor(hid_iface_t *iface)
+{
+    HID_RETURN_ON_INVALID_ARG(iface);
+
+    // Get Report Descriptor is possible only in Ready or Active state
+    HID_RETURN_ON_FALSE((HID_INTERFACE_STATE_READY == iface->state) ||
+                        (HID_INTERFACE_STATE_ACTIVE == iface->state),
+                        ESP_ERR_INVALID_STATE,
+                        "Unable to request report descriptor. Interface is not ready");
+
+    return hid_report_descriptor_request(iface);
+}
+
+/**
+ * @brief Compile Report Descriptor of claimed Interface to the report map
+ *
+ * The Report Descriptor is requested if it was not yet.
+ *
+ * @param[in] iface       Pointer to HID Interface configuration structure
+ * @return esp_err_t
+ */
+static esp_err_t hid_report_map_compile(hid_iface_t *iface)
+{
+    if (iface->report_map) {
+        return ESP_OK;
+    }
+    if (NULL == iface->report_desc) {
+        HID_RETURN_ON_ERROR( hid_report_descriptor_request(iface),
+                             "Unable to request report descriptor");
+    }
+    HID_RETURN_ON_ERROR( hid_report_map_create(iface->report_desc, iface->report_desc_size, &iface->report_map),
+                         "Unable to compile report descriptor");
+    return ESP_OK;
+}
+
+/**
+ * @brief Free Report Descriptor and report map of the Interface
+ *
+ * @param[in] iface       Pointer to HID Interface configuration structure
+ */
+static void hid_report_desc_free(hid_iface_t *iface)
+{
+    HID_FREE(DESCRIPTOR, iface->report_desc, iface->report_desc_size);
+    iface->report_desc = NULL;
+    hid_report_map_delete(iface->report_map);
+    iface->report_map = NULL;
+}
+
+/**
+ * @brief HID class specific request Set
+ *
+ * @param[in] hid_device Pointer to HID device structure
+ * @param[in] req        Pointer to a class specific request structure
+ * @return esp_err_t
+ */
+static esp_err_t hid_class_request_set(hid_device_t *hid_device,
+                                       const hid_class_request_t *req)
+{
+    esp_err_t ret;
+    HID_RETURN_ON_INVALID_ARG(hid_device);
+
+    HID_RETURN_ON_ERROR( hid_device_try_lock(hid_device, DEFAULT_TIMEOUT_MS),
+                         "HID Device is busy by other task");
+
+    usb_transfer_t *ctrl_xfer = hid_device->ctrl_xfer;
+
+    usb_setup_packet_t *setup = (usb_setup_packet_t *)ctrl_xfer->data_buffer;
+    setup->bmRequestType = USB_BM_REQUEST_TYPE_DIR_OUT |
+                           USB_BM_REQUEST_TYPE_TYPE_CLASS |
+                           USB_BM_REQUEST_TYPE_RECIP_INTERFACE;
+    setup->bRequest = req->bRequest;
+    setup->wValue = req->wValue;
+    setup->wIndex = req->wIndex;
+    setup->wLength = req->wLength;
+
+    if (req->wLength && req->data) {
+        memcpy(ctrl_xfer->data_buffer + USB_SETUP_PACKET_SIZE, req->data, req->wLength);
+    }
+
+    ret = hid_control_transfer(hid_device,
+                               USB_SETUP_PACKET_SIZE + setup->wLength,
+                               DEFAULT_TIMEOUT_MS);
+
+    hid_device_unlock(hid_device);
+
+    return ret;
+}
+
+/**
+ * @brief HID class specific request Get
+ *
+ * @param[in] hid_device    Pointer to HID device structure
+ * @param[in] req           Pointer to a class specific request structure
+ * @param[out] out_length   Length of the response in data buffer of req struct
+ * @return esp_err_t
+ */
+static esp_err_t hid_class_request_get(hid_device_t *hid_device,
                                        const hid_class_request_t *req,
                                        size_t *out_length)
 {
-    esp_err_t ret;
-    HID_RETURN_ON_INVALID_ARG(hid_device);
-    HID_RETURN_ON_INVALID_ARG(hid_device->ctrl_xfer);
+    esp_err_t ret;
+    HID_RETURN_ON_INVALID_ARG(hid_device);
+
+    HID_RETURN_ON_ERROR( hid_device_try_lock(hid_device, DEFAULT_TIMEOUT_MS),
+                         "HID Device is busy by other task");
+
+    usb_transfer_t *ctrl_xfer = hid_device->ctrl_xfer;
+
+    usb_setup_packet_t *setup = (usb_setup_packet_t *)ctrl_xfer->data_buffer;
+
+    setup->bmRequestType = USB_BM_REQUEST_TYPE_DIR_IN |
+                           USB_BM_REQUEST_TYPE_TYPE_CLASS |
+                           USB_BM_REQUEST_TYPE_RECIP_INTERFACE;
+    setup->bRequest = req->bRequest;
+    setup->wValue = req->wValue;
+    setup->wIndex = req->wIndex;
+    setup->wLength = req->wLength;
+
+    ret = hid_control_transfer(hid_device,
+                               USB_SETUP_PACKET_SIZE + setup->wLength,
+                               DEFAULT_TIMEOUT_MS);
+
+    if (ESP_OK == ret) {
+        // We do not need the setup data, which is still in the transfer data buffer
+        ctrl_xfer->actual_num_bytes -= USB_SETUP_PACKET_SIZE;
+        // Copy data if the size is ok
+        if (ctrl_xfer->actual_num_bytes <= req->wLength) {
+            memcpy(req->data, ctrl_xfer->data_buffer + USB_SETUP_PACKET_SIZE, ctrl_xfer->actual_num_bytes);
+            // return actual num bytes of response
+            if (out_length) {
+                *out_length = ctrl_xfer->actual_num_bytes;
+            }
+        } else {
+            ret = ESP_ERR_INVALID_SIZE;
+        }
+    }
+
+    hid_device_unlock(hid_device);
+
+    return ret;
+}
+
+// ---------------------------- Private ---------------------------------------
+static esp_err_t hid_host_string_descriptor_copy(wchar_t *dest,
+        const usb_str_desc_t *src)
+{
+    if (dest == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (src != NULL) {
+        size_t len = MIN((src->bLength - USB_STANDARD_DESC_SIZE) / 2, HID_STR_DESC_MAX_LENGTH - 1);
+        for (int i = 0; i < len; i++) {
+            dest[i] = (wchar_t) src->wData[i];
+        }
+        // This should be always true, we just check to avoid LoadProhibited exception
+        if (dest != NULL) {
+            dest[len] = 0;
+        }
+    } else {
+        dest[0] = 0;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Delete the shared control transfer pool
+ *
+ * All transfers must have been returned to the pool.
+ *
+ * @param[in] pool       Pool of hid_ctrl_slot_t
+ */
+static void hid_ctrl_pool_delete(QueueHandle_t pool)
+{
+    if (NULL == pool) {
+        return;
+    }
+    hid_ctrl_slot_t slot;
+    while (xQueueReceive(pool, &slot, 0)) {
+        CLIENT_TRANSFER_FREE(slot.xfer);
+        vSemaphoreDelete(slot.done);
+    }
+    vQueueDelete(pool);
+}
+
+/**
+ * @brief Create the shared control transfer pool of low-memory mode
+ *
+ * @param[in]  num       Number of control transfers
+ * @param[out] pool_ret  Pool of hid_ctrl_slot_t
+ * @return esp_err_t
+ */
+static esp_err_t hid_ctrl_pool_create(int num, QueueHandle_t *pool_ret)
+{
+    QueueHandle_t pool = xQueueCreate(num, sizeof(hid_ctrl_slot_t));
+    HID_RETURN_ON_FALSE(pool,
+                        ESP_ERR_NO_MEM,
+                        "Unable to create control transfer pool");
+
+    for (int i = 0; i < num; i++) {
+        hid_ctrl_slot_t slot = {
+            .done = xSemaphoreCreateBinary(),
+        };
+        if (NULL == slot.done || ESP_OK != CLIENT_TRANSFER_ALLOC(HID_CTRL_XFER_SIZE, 0, &slot.xfer)) {
+            if (slot.done) {
+                vSemaphoreDelete(slot.done);
+            }
+            hid_ctrl_pool_delete(pool);
+            ESP_LOGE(TAG, "Unable to allocate control transfer pool");
+            return ESP_ERR_NO_MEM;
+        }
+        xQueueSend(pool, &slot, 0);
+    }
+    *pool_ret = pool;
+    return ESP_OK;
+}
+
+esp_err_t hid_host_install_device(uint8_t dev_addr,
+                                  usb_device_handle_t dev_hdl,
+                                  hid_device_t **hid_device_handle)
+{
+    esp_err_t ret;
+    hid_device_t *hid_device;
+
+    HID_GOTO_ON_FALSE( hid_device = HID_CALLOC(CONTROL, 1, sizeof(hid_device_t)),
+                       ESP_ERR_NO_MEM,
+                       "Unable to allocate memory for HID Device");
+
+    hid_device->dev_addr = dev_addr;
+    hid_device->dev_hdl = dev_hdl;
+    STAILQ_INIT(&hid_device->async_reqs_tailq);
+
+    HID_GOTO_ON_FALSE( hid_device->device_busy =  xSemaphoreCreateMutex(),
+                       ESP_ERR_NO_MEM,
+                       "Unable to create semaphore");
+
+    // Low-memory mode: control transfer and its semaphore are taken from the shared pool on each request
+    if (!s_hid_driver->ctrl_xfer_pool) {
+        HID_GOTO_ON_FALSE( hid_device->ctrl_xfer_done = xSemaphoreCreateBinary(),
+                           ESP_ERR_NO_MEM,
+                           "Unable to create semaphore");
+        HID_GOTO_ON_ERROR(CLIENT_TRANSFER_ALLOC(HID_CTRL_XFER_SIZE, 0, &hid_device->ctrl_xfer),
+                          "Unable to allocate transfer buffer");
+    }
+
+    HID_ENTER_CRITICAL();
+    HID_GOTO_ON_FALSE_CRITICAL( s_hid_driver, ESP_ERR_INVALID_STATE );
+    HID_GOTO_ON_FALSE_CRITICAL( s_hid_driver->client_handle, ESP_ERR_INVALID_STATE );
+    HID_GOTO_ON_FALSE_CRITICAL( hid_handle_table_add(&s_hid_driver->devices_table, dev_hdl, hid_device), ESP_ERR_NO_MEM );
+    STAILQ_INSERT_TAIL(&s_hid_driver->hid_devices_tailq, hid_device, tailq_entry);
+    HID_EXIT_CRITICAL();
+
+    if (hid_device_handle) {
+        *hid_device_handle = hid_device;
+    }
+
+    return ESP_OK;
+
+fail:
+    hid_host_uninstall_device(hid_device);
+    return ret;
+}
+
+esp_err_t hid_host_uninstall_device(hid_device_t *hid_device)
+{
+    HID_RETURN_ON_INVALID_ARG(hid_device);
+
+    if (!s_hid_driver->ctrl_xfer_pool) {
+        HID_RETURN_ON_ERROR( CLIENT_TRANSFER_FREE(hid_device->ctrl_xfer),
+                             "Unable to free transfer buffer for EP0");
+    }
+    // Asynchronous requests of all interfaces were dropped on their closing, the last one finished with NO_DEVICE status
+    HID_RETURN_ON_ERROR( CLIENT_TRANSFER_FREE(hid_device->async_xfer),
+                         "Unable to free asynchronous transfer buffer for EP0");
+    HID_RETURN_ON_ERROR( CLIENT_DEVICE_CLOSE(s_hid_driver->client_handle,
+                         hid_device->dev_hdl),
+                         "Unable to close USB host");
+
+    // Transfer that timed out is not in flight anymore after the device was closed
+    if (s_hid_driver->ctrl_xfer_pool && hid_device->ctrl_xfer) {
+        hid_device_ctrl_xfer_put(hid_device);
+    } else if (hid_device->ctrl_xfer_done) {
+        vSemaphoreDelete(hid_device->ctrl_xfer_done);
+    }
+
+    if (hid_device->device_busy) {
+        vSemaphoreDelete(hid_device->device_busy);
+    }
+
+    ESP_LOGD(TAG, "Remove addr %d device from list",
+             hid_device->dev_addr);
+
+    HID_ENTER_CRITICAL();
+    hid_handle_table_remove(&s_hid_driver->devices_table, hid_device->dev_hdl);
+    STAILQ_REMOVE(&s_hid_driver->hid_devices_tailq, hid_device, hid_host_device, tailq_entry);
+    HID_EXIT_CRITICAL();
+
+    HID_FREE(CONTROL, hid_device, sizeof(hid_device_t));
+    return ESP_OK;
+}
+
+static esp_err_t client_deregister(hid_driver_t *driver)
+{
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    if (driver->shared_client) {
+        return usb_host_shared_client_deregister(client_event_cb, NULL);
+    }
+#endif
+    return usb_host_client_deregister(driver->client_handle);
+}
+
+#if USB_HOST_SHARED_CLIENT_ENABLED
+/**
+ * @brief Stop all active interfaces before bus suspend
+ *
+ * Interfaces stay claimed and their transfers allocated. An interface is marked before it is stopped,
+ * so an interface that failed to stop is started again by hid_pm_resume().
+ *
+ * @param[in] arg  Argument, does not used
+ * @return esp_err_t
+ */
+static esp_err_t hid_pm_suspend(void *arg)
+{
+    esp_err_t ret = ESP_OK;
+    HID_ENTER_CRITICAL();
+    hid_iface_t *iface = STAILQ_FIRST(&s_hid_driver->hid_ifaces_tailq);
+    while (iface != NULL && ret == ESP_OK) {
+        hid_iface_t *next = STAILQ_NEXT(iface, tailq_entry);
+        const bool active = (HID_INTERFACE_STATE_ACTIVE == iface->state);
+        HID_EXIT_CRITICAL();
+
+        if (active) {
+            iface->suspended = true;
+            ret = hid_host_disable_interface(iface);
+        }
+        iface = next;
+
+        HID_ENTER_CRITICAL();
+    }
+    HID_EXIT_CRITICAL();
+    return ret;
+}
+
+/**
+ * @brief Start interfaces stopped by hid_pm_suspend()
+ *
+ * @param[in] arg  Argument, does not used
+ * @return esp_err_t
+ */
+static esp_err_t hid_pm_resume(void *arg)
+{
+    esp_err_t ret = ESP_OK;
+    HID_ENTER_CRITICAL();
+    hid_iface_t *iface = STAILQ_FIRST(&s_hid_driver->hid_ifaces_tailq);
+    while (iface != NULL) {
+        hid_iface_t *next = STAILQ_NEXT(iface, tailq_entry);
+        const bool resume = iface->suspended && (HID_INTERFACE_STATE_READY == iface->state);
+        iface->suspended = false;
+        HID_EXIT_CRITICAL();
+
+        if (resume) {
+            const esp_err_t err = hid_host_device_start((hid_host_device_handle_t)iface);
+            if (err != ESP_OK && ret == ESP_OK) {
+                ret = err;
+            }
+        }
+        iface = next;
+
+        HID_ENTER_CRITICAL();
+    }
+    HID_EXIT_CRITICAL();
+    return ret;
+}
+
+static const usb_host_pm_ops_t hid_pm_ops = {
+    .suspend = hid_pm_suspend,
+    .resume = hid_pm_resume,
+};
+#endif // USB_HOST_SHARED_CLIENT_ENABLED
+
+// ----------------------------- Public ----------------------------------------
+
+esp_err_t hid_host_install(const hid_host_driver_config_t *config)
+{
+    esp_err_t ret;
+
+    HID_RETURN_ON_INVALID_ARG(config);
+    HID_RETURN_ON_INVALID_ARG(config->callback);
+    HID_RETURN_ON_FALSE(config->ctrl_transfers_num >= 0,
+                        ESP_ERR_INVALID_ARG,
+                        "Wrong number of control transfers");
+#if !USB_HOST_SHARED_CLIENT_ENABLED
+    HID_RETURN_ON_FALSE(!config->shared_client,
+                        ESP_ERR_NOT_SUPPORTED,
+                        "usb_host_shared_client component is not in the build");
+#endif
+
+    if ( config->create_background_task && !config->shared_client ) {
+        HID_RETURN_ON_FALSE(config->stack_size != 0,
+                            ESP_ERR_INVALID_ARG,
+                            "Wrong stack size value");
+        HID_RETURN_ON_FALSE(config->task_priority != 0,
+                            ESP_ERR_INVALID_ARG,
+                            "Wrong task priority value");
+    }
+
+    HID_RETURN_ON_FALSE(!s_hid_driver,
+                        ESP_ERR_INVALID_STATE,
+                        "HID Host driver is already installed");
+
+    // Create HID driver structure
+    hid_driver_t *driver = HID_CALLOC(CONTROL, 1, sizeof(hid_driver_t));
+    HID_RETURN_ON_FALSE(driver,
+                        ESP_ERR_NO_MEM,
+                        "Unable to allocate memory");
+
+    driver->user_cb = config->callback;
+    driver->user_arg = config->callback_arg;
+    driver->shared_client = config->shared_client;
+    driver->low_memory = config->low_memory;
+
+    HID_GOTO_ON_ERROR( hid_report_desc_cache_init(config->report_desc_cache_size),
+                       "Unable to create Report Descriptor cache");
+
+    if (driver->low_memory) {
+        HID_GOTO_ON_ERROR( hid_ctrl_pool_create(config->ctrl_transfers_num ? config->ctrl_transfers_num : HID_CTRL_XFER_NUM_DEFAULT,
+                                                &driver->ctrl_xfer_pool),
+                           "Unable to create control transfer pool");
+    }
+
+    usb_host_client_config_t client_config = {
+        .is_synchronous = false,
+        .async.client_event_callback = client_event_cb,
+        .async.callback_arg = NULL,
+        .max_num_event_msg = 10,
+    };
+
+    driver->end_client_event_handling = false;
+    driver->all_events_handled = xSemaphoreCreateBinary();
+    HID_GOTO_ON_FALSE(driver->all_events_handled,
+                      ESP_ERR_NO_MEM,
+                      "Unable to create semaphore");
+
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    if (driver->shared_client) {
+        HID_GOTO_ON_ERROR( usb_host_shared_client_register(client_event_cb, NULL,
+                           &driver->client_handle),
+                           "Unable to register to shared USB Host client");
+    } else
+#endif
+    {
+        HID_GOTO_ON_ERROR( usb_host_client_register(&client_config,
+                           &driver->client_handle),
+                           "Unable to register USB Host client");
+    }
+
+    HID_ENTER_CRITICAL();
+    HID_GOTO_ON_FALSE_CRITICAL(!s_hid_driver, ESP_ERR_INVALID_STATE);
+    s_hid_driver = driver;
+    STAILQ_INIT(&s_hid_driver->hid_devices_tailq);
+    STAILQ_INIT(&s_hid_driver->hid_ifaces_tailq);
+    HID_EXIT_CRITICAL();
+
+    if (config->create_background_task && !driver->shared_client) {
+        BaseType_t task_created = xTaskCreatePinnedToCore(
+                                      event_handler_task,
+                                      "USB HID Host",
+                                      config->stack_size,
+                                      NULL,
+                                      config->task_priority,
+                                      NULL,
+                                      config->core_id);
+        HID_GOTO_ON_FALSE(task_created,
+                          ESP_ERR_NO_MEM,
+                          "Unable to create USB HID Host task");
+    }
+
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    // Only fails if the driver is registered already, which the check of s_hid_driver excludes
+    ESP_ERROR_CHECK( usb_host_pm_register(USB_HOST_PM_DRIVER_HID, &hid_pm_ops, NULL) );
+#endif
+    return ESP_OK;
+
+fail:
+    s_hid_driver = NULL;
+    if (driver->client_handle) {
+        client_deregister(driver);
+    }
+    if (driver->all_events_handled) {
+        vSemaphoreDelete(driver->all_events_handled);
+    }
+    hid_ctrl_pool_delete(driver->ctrl_xfer_pool);
+    hid_report_desc_cache_deinit();
+    HID_FREE(CONTROL, driver, sizeof(hid_driver_t));
+    return ret;
+}
+
+esp_err_t hid_host_uninstall(void)
+{
+    // Make sure hid driver is installed,
+    HID_RETURN_ON_FALSE(s_hid_driver,
+                        ESP_OK,
+                        "HID Host driver was not installed");
+
+    // Make sure that hid driver
+    // not being uninstalled from other task
+    // and no hid device is registered
+    HID_ENTER_CRITICAL();
+    HID_RETURN_ON_FALSE_CRITICAL( !s_hid_driver->end_client_event_handling, ESP_ERR_INVALID_STATE );
+    HID_RETURN_ON_FALSE_CRITICAL( STAILQ_EMPTY(&s_hid_driver->hid_devices_tailq), ESP_ERR_INVALID_STATE );
+    HID_RETURN_ON_FALSE_CRITICAL( STAILQ_EMPTY(&s_hid_driver->hid_ifaces_tailq), ESP_ERR_INVALID_STATE );
+    s_hid_driver->end_client_event_handling = true;
+    HID_EXIT_CRITICAL();
+
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    // Fails if suspend or resume is in progress, its hooks use the driver
+    if (usb_host_pm_deregister(USB_HOST_PM_DRIVER_HID) != ESP_OK) {
+        s_hid_driver->end_client_event_handling = false;
+        return ESP_ERR_INVALID_STATE;
+    }
+#endif
+
+    if (s_hid_driver->event_handling_started) {
+        ESP_ERROR_CHECK( usb_host_client_unblock(s_hid_driver->client_handle) );
+        // In case the event handling started, we must wait until it finishes
+        xSemaphoreTake(s_hid_driver->all_events_handled, portMAX_DELAY);
+    }
+    vSemaphoreDelete(s_hid_driver->all_events_handled);
+    ESP_ERROR_CHECK( client_deregister(s_hid_driver) );
+    hid_ctrl_pool_delete(s_hid_driver->ctrl_xfer_pool);
+    hid_report_desc_cache_deinit();
+    HID_FREE(CONTROL, s_hid_driver, sizeof(hid_driver_t));
+    s_hid_driver = NULL;
+    return ESP_OK;
+}
+
+esp_err_t hid_host_device_open(hid_host_device_handle_t hid_dev_handle,
+                               const hid_host_device_config_t *config)
+{
+    HID_RETURN_ON_FALSE(s_hid_driver,
+                        ESP_ERR_INVALID_STATE,
+                        "HID Driver is not installed");
 
-    usb_transfer_t *ctrl_xfer = hid_device->ctrl_xfer;
+    hid_iface_t *hid_iface = get_iface_by_handle(hid_dev_handle);
 
-    HID_RETURN_ON_ERROR( hid_device_try_lock(hid_device, DEFAULT_TIMEOUT_MS),
-                         "HID Device is busy by other task");
+    HID_RETURN_ON_INVALID_ARG(hid_iface);
 
-    usb_setup_packet_t *setup = (usb_setup_packet_t *)ctrl_xfer->data_buffer;
+    HID_RETURN_ON_FALSE((hid_iface->dev_params.proto >= HID_PROTOCOL_NONE)
+                        && (hid_iface->dev_params.proto < HID_PROTOCOL_MAX),
+                        ESP_ERR_INVALID_ARG,
+                        "HID device protocol not supported");
 
-    setup->bmRequestType = USB_BM_REQUEST_TYPE_DIR_IN |
-                           USB_BM_REQUEST_TYPE_TYPE_CLASS |
-                           USB_BM_REQUEST_TYPE_RECIP_INTERFACE;
-    setup->bRequest = req->bRequest;
-    setup->wValue = req->wValue;
-    setup->wIndex = req->wIndex;
-    setup->wLength = req->wLength;
+    HID_RETURN_ON_FALSE((HID_INTERFACE_STATE_IDLE == hid_iface->state),
+                        ESP_ERR_INVALID_STATE,
+                        "Interface wrong state");
 
-    ret = hid_control_transfer(hid_device,
-                               USB_SETUP_PACKET_SIZE + setup->wLength,
-                               DEFAULT_TIMEOUT_MS);
+    HID_RETURN_ON_FALSE((config->in_transfers_num >= 0),
+                        ESP_ERR_INVALID_ARG,
+                        "Wrong number of IN transfers");
 
-    if (ESP_OK == ret) {
-        // We do not need the setup data, which is still in the transfer data buffer
-        ctrl_xfer->actual_num_bytes -= USB_SETUP_PACKET_SIZE;
-        // Copy data if the size is ok
-        if (ctrl_xfer->actual_num_bytes <= req->wLength) {
-            memcpy(req->data, ctrl_xfer->data_buffer + USB_SETUP_PACKET_SIZE, ctrl_xfer->actual_num_bytes);
-            // return actual num bytes of response
-            if (out_length) {
-                *out_length = ctrl_xfer->actual_num_bytes;
-            }
-        } else {
-            ret = ESP_ERR_INVALID_SIZE;
-        }
+    HID_RETURN_ON_FALSE((config->out_transfers_num >= 0),
+                        ESP_ERR_INVALID_ARG,
+                        "Wrong number of OUT transfers");
+
+    hid_iface->in_xfer_num = config->in_transfers_num ? config->in_transfers_num : 1;
+    hid_iface->out_xfer_num = config->out_transfers_num ? config->out_transfers_num : HID_OUT_XFER_NUM_DEFAULT;
+
+    // Claim interface, allocate xfer and save report callback
+    esp_err_t ret = hid_host_interface_claim_and_prepare_transfer(hid_iface, config);
+    if (ESP_OK != ret) {
+        // Low-memory and latest reports modes compile the Report Descriptor while preparing the transfers
+        hid_report_desc_free(hid_iface);
+        ESP_LOGE(TAG, "Unable to claim interface");
+        return ret;
     }
 
-    hid_device_unlock(hid_device);
+    // Save HID Interface callback
+    hid_iface->user_cb = config->callback;
+    hid_iface->user_cb_arg = config->callback_arg;
 
-    return ret;
+    return ESP_OK;
 }
 
-// ---------------------------- Private ---------------------------------------
-static esp_err_t hid_host_string_descriptor_copy(wchar_t *dest,
-        const usb_str_desc_t *src)
+esp_err_t hid_host_device_close(hid_host_device_handle_t hid_dev_handle)
 {
-    if (dest == NULL) {
-        return ESP_ERR_INVALID_ARG;
+    hid_iface_t *hid_iface = get_iface_by_handle(hid_dev_handle);
+
+    HID_RETURN_ON_INVALID_ARG(hid_iface);
+
+    ESP_LOGD(TAG, "Close addr %d, iface %d, state %d",
+             hid_iface->dev_params.addr,
+             hid_iface->dev_params.iface_num,
+             hid_iface->state);
+
+    if (HID_INTERFACE_STATE_ACTIVE == hid_iface->state) {
+        HID_RETURN_ON_ERROR( hid_host_disable_interface(hid_iface),
+                             "Unable to disable HID Interface");
     }
-    if (src != NULL) {
-        size_t len = MIN((src->bLength - USB_STANDARD_DESC_SIZE) / 2, HID_STR_DESC_MAX_LENGTH - 1);
-        for (int i = 0; i < len; i++) {
-            dest[i] = (wchar_t) src->wData[i];
-        }
-        // This should be always true, we just check to avoid LoadProhibited exception
-        if (dest != NULL) {
-            dest[len] = 0;
-        }
+
+    if (HID_INTERFACE_STATE_READY == hid_iface->state) {
+        HID_RETURN_ON_ERROR( hid_host_interface_release_and_free_transfer(hid_iface),
+                             "Unable to release HID Interface");
+
+        // If the device is closing by user before device detached we need to flush user callback here
+        hid_report_desc_free(hid_iface);
+    }
+
+    if (hid_iface->user_cb && hid_iface->state != HID_INTERFACE_STATE_WAIT_USER_DELETION) {
+        // Let user handle the remove process and wait for next hid_host_device_close() call
+        hid_iface->state = HID_INTERFACE_STATE_WAIT_USER_DELETION;
+        hid_host_user_interface_callback(hid_iface, HID_HOST_INTERFACE_EVENT_DISCONNECTED);
     } else {
-        dest[0] = 0;
+        // Second call
+        hid_iface->user_cb = NULL;
+        hid_iface->user_cb_arg = NULL;
+
+        hid_async_req_drop_iface(hid_iface);
+
+        /* Remove Interface from the list */
+        ESP_LOGD(TAG, "Remove addr %d, iface %d from list",
+                 hid_iface->dev_params.addr,
+                 hid_iface->dev_params.iface_num);
+        HID_ENTER_CRITICAL();
+        _hid_host_remove_interface(hid_iface);
+        HID_EXIT_CRITICAL();
     }
+
     return ESP_OK;
 }
 
-esp_err_t hid_host_install_device(uint8_t dev_addr,
-                                  usb_device_handle_t dev_hdl,
-                                  hid_device_t **hid_device_handle)
+esp_err_t hid_host_handle_events(uint32_t timeout)
 {
-    esp_err_t ret;
-    hid_device_t *hid_device;
+    HID_RETURN_ON_FALSE(s_hid_driver != NULL,
+                        ESP_ERR_INVALID_STATE,
+                        "HID Driver is not installed");
+    HID_RETURN_ON_FALSE(!s_hid_driver->shared_client,
+                        ESP_ERR_INVALID_STATE,
+                        "Events are handled by the shared USB Host client");
 
-    HID_GOTO_ON_FALSE( hid_device = calloc(1, sizeof(hid_device_t)),
-                       ESP_ERR_NO_MEM,
-                       "Unable to allocate memory for HID Device");
+    ESP_LOGD(TAG, "USB HID handling");
+    s_hid_driver->event_handling_started = true;
+    esp_err_t ret = usb_host_client_handle_events(s_hid_driver->client_handle, timeout);
+    if (s_hid_driver->end_client_event_handling) {
+        xSemaphoreGive(s_hid_driver->all_events_handled);
+        return ESP_FAIL;
+    }
+    return ret;
+}
 
-    hid_device->dev_addr = dev_addr;
-    hid_device->dev_hdl = dev_hdl;
+esp_err_t hid_host_device_get_params(hid_host_device_handle_t hid_dev_handle,
+                                     hid_host_dev_params_t *dev_params)
+{
+    hid_iface_t *iface = get_iface_by_handle(hid_dev_handle);
 
-    HID_GOTO_ON_FALSE( hid_device->ctrl_xfer_done = xSemaphoreCreateBinary(),
-                       ESP_ERR_NO_MEM,
-                       "Unable to create semaphore");
-    HID_GOTO_ON_FALSE( hid_device->device_busy =  xSemaphoreCreateMutex(),
-                       ESP_ERR_NO_MEM,
-                       "Unable to create semaphore");
+    HID_RETURN_ON_FALSE(iface,
+                        ESP_ERR_INVALID_STATE,
+                        "HID Interface not found");
 
-    /*
-    * TIP: Usually, we need to allocate 'EP bMaxPacketSize0 + 1' here.
-    * To take the size of a report descriptor into a consideration,
-    * we need to allocate more here, e.g. 512 bytes.
-    */
-    HID_GOTO_ON_ERROR(usb_host_transfer_alloc(512, 0, &hid_device->ctrl_xfer),
-                      "Unable to allocate transfer buffer");
+    HID_RETURN_ON_FALSE(dev_params,
+                        ESP_ERR_INVALID_ARG,
+                        "Wrong argument");
 
-    HID_ENTER_CRITICAL();
-    HID_GOTO_ON_FALSE_CRITICAL( s_hid_driver, ESP_ERR_INVALID_STATE );
-    HID_GOTO_ON_FALSE_CRITICAL( s_hid_driver->client_handle, ESP_ERR_INVALID_STATE );
-    STAILQ_INSERT_TAIL(&s_hid_driver->hid_devices_tailq, hid_device, tailq_entry);
-    HID_EXIT_CRITICAL();
+    memcpy(dev_params, &iface->dev_params, sizeof(hid_host_dev_params_t));
+    return ESP_OK;
+}
 
-    if (hid_device_handle) {
-        *hid_device_handle = hid_device;
-    }
+esp_err_t hid_host_device_get_raw_input_report_data(hid_host_device_handle_t hid_dev_handle,
+        uint8_t *data,
+        size_t data_length_max,
+        size_t *data_length)
+{
+    hid_iface_t *iface = get_iface_by_handle(hid_dev_handle);
 
-    return ESP_OK;
+    HID_RETURN_ON_FALSE(iface,
+                        ESP_ERR_INVALID_STATE,
+                        "HID Interface not found");
 
-fail:
-    hid_host_uninstall_device(hid_device);
-    return ret;
+    HID_RETURN_ON_FALSE(data,
+                        ESP_ERR_INVALID_ARG,
+                        "Wrong argument");
+
+    HID_RETURN_ON_FALSE(data_length,
+                        ESP_ERR_INVALID_ARG,
+                        "Wrong argument");
+
+    HID_RETURN_ON_FALSE(iface->in_xfer_last,
+                        ESP_ERR_INVALID_STATE,
+                        "No input report received");
+
+    size_t copied = (data_length_max >= iface->in_xfer_last->actual_num_bytes)
+                    ? iface->in_xfer_last->actual_num_bytes
+                    : data_length_max;
+    memcpy(data, iface->in_xfer_last->data_buffer, copied);
+    *data_length = copied;
+    return ESP_OK;
 }
 
-esp_err_t hid_host_uninstall_device(hid_device_t *hid_device)
+esp_err_t hid_host_device_get_reports(hid_host_device_handle_t hid_dev_handle,
+                                      hid_host_report_t *reports,
+                                      size_t reports_max,
+                                      size_t *reports_num,
+                                      uint32_t timeout_ms)
 {
-    HID_RETURN_ON_INVALID_ARG(hid_device);
+    hid_iface_t *iface = get_iface_by_handle(hid_dev_handle);
 
-    HID_RETURN_ON_ERROR( usb_host_transfer_free(hid_device->ctrl_xfer),
-                         "Unable to free transfer buffer for EP0");
-    HID_RETURN_ON_ERROR( usb_host_device_close(s_hid_driver->client_handle,
-                         hid_device->dev_hdl),
-                         "Unable to close USB host");
+    HID_RETURN_ON_FALSE(iface,
+                        ESP_ERR_INVALID_STATE,
+                        "HID Interface not found");
 
-    if (hid_device->ctrl_xfer_done) {
-        vSemaphoreDelete(hid_device->ctrl_xfer_done);
+    HID_RETURN_ON_FALSE(reports && reports_num,
+                        ESP_ERR_INVALID_ARG,
+                        "Wrong argument");
+
+    hid_report_queue_t *queue = iface->report_queue;
+    HID_RETURN_ON_FALSE(queue,
+                        ESP_ERR_INVALID_STATE,
+                        "Report queue not configured");
+
+    const unsigned tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    const size_t num = MIN(hid_report_queue_wait(queue, timeout_ms), reports_max);
+    for (size_t i = 0; i < num; i++) {
+        const size_t idx = (tail + i) % queue->len;
+        reports[i].timestamp_us = queue->slots[idx].timestamp_us;
+        reports[i].len = queue->slots[idx].len;
+        reports[i].data = queue->data + idx * queue->slot_size;
     }
+    *reports_num = num;
 
-    if (hid_device->device_busy) {
-        vSemaphoreDelete(hid_device->device_busy);
+    if (num) {
+        // Delivery latency of the oldest report in this batch
+        const unsigned bucket = hid_stats_bucket(hid_report_time_us() - reports[0].timestamp_us, 16);
+        HID_ENTER_CRITICAL();
+        iface->stats.queue_latency_histogram[bucket]++;
+        HID_EXIT_CRITICAL();
     }
+    return (num || reports_max == 0) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
 
-    ESP_LOGD(TAG, "Remove addr %d device from list",
-             hid_device->dev_addr);
+esp_err_t hid_host_device_release_reports(hid_host_device_handle_t hid_dev_handle,
+        size_t reports_num)
+{
+    hid_iface_t *iface = get_iface_by_handle(hid_dev_handle);
 
-    HID_ENTER_CRITICAL();
-    STAILQ_REMOVE(&s_hid_driver->hid_devices_tailq, hid_device, hid_host_device, tailq_entry);
-    HID_EXIT_CRITICAL();
+    HID_RETURN_ON_FALSE(iface && iface->report_queue,
+                        ESP_ERR_INVALID_STATE,
+                        "Report queue not configured");
 
-    free(hid_device);
-    return ESP_OK;
+    return hid_report_queue_release(iface->report_queue, reports_num);
 }
 
-// ----------------------------- Public ----------------------------------------
+uint32_t hid_host_device_get_report_overruns(hid_host_device_handle_t hid_dev_handle)
+{
+    hid_iface_t *iface = get_iface_by_handle(hid_dev_handle);
 
-esp_err_t hid_host_install(const hid_host_driver_config_t *config)
+    if (NULL == iface || NULL == iface->report_queue) {
+        return 0;
+    }
+    return __atomic_load_n(&iface->report_queue->overruns, __ATOMIC_RELAXED);
+}
+
+esp_err_t hid_host_device_get_latest_report(hid_host_device_handle_t hid_dev_handle,
+        uint8_t report_id,
+        uint8_t *data,
+        size_t data_length_max,
+        hid_host_latest_report_info_t *info)
 {
-    esp_err_t ret;
+    hid_iface_t *iface = get_iface_by_handle(hid_dev_handle);
 
-    HID_RETURN_ON_INVALID_ARG(config);
-    HID_RETURN_ON_INVALID_ARG(config->callback);
+    HID_RETURN_ON_FALSE(iface,
+                        ESP_ERR_INVALID_STATE,
+                        "HID Interface not found");
 
-    if ( config->create_background_task ) {
-        HID_RETURN_ON_FALSE(config->stack_size != 0,
-                            ESP_ERR_INVALID_ARG,
-                            "Wrong stack size value");
-        HID_RETURN_ON_FALSE(config->task_priority != 0,
-                            ESP_ERR_INVALID_ARG,
-                            "Wrong task priority value");
-    }
+    HID_RETURN_ON_FALSE(data && info,
+                        ESP_ERR_INVALID_ARG,
+                        "Wrong argument");
 
-    HID_RETURN_ON_FALSE(!s_hid_driver,
+    HID_RETURN_ON_FALSE(iface->latest,
                         ESP_ERR_INVALID_STATE,
-                        "HID Host driver is already installed");
+                        "Latest reports not configured");
+
+    hid_latest_slot_t *slot = hid_latest_slot_get(iface, report_id);
+    HID_RETURN_ON_FALSE(slot,
+                        ESP_ERR_NOT_FOUND,
+                        "No such input report");
+
+    uint32_t count;
+    for (unsigned retries = 0;; retries++) {
+        const uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (!(seq & 1)) {
+            count = slot->count;
+            info->timestamp_us = slot->timestamp_us;
+            info->len = slot->len;
+            memcpy(data, slot->data, MIN(info->len, data_length_max));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq) {
+                break;
+            }
+        }
+        // The producer may have been preempted by this task in the middle of the write
+        if (retries >= HID_LATEST_READ_SPINS) {
+            vTaskDelay(1);
+        }
+    }
+
+    if (0 == count) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    info->len = MIN(info->len, data_length_max);
+    info->new_reports = count - slot->read_count;
+    slot->read_count = count;
+    return ESP_OK;
+}
+
+esp_err_t hid_host_mux_create(const hid_host_mux_config_t *config, hid_host_mux_handle_t *mux_hdl_ret)
+{
+    HID_RETURN_ON_INVALID_ARG(config);
+    HID_RETURN_ON_INVALID_ARG(mux_hdl_ret);
+    HID_RETURN_ON_FALSE(config->queue_len,
+                        ESP_ERR_INVALID_ARG,
+                        "Wrong queue length");
 
-    // Create HID driver structure
-    hid_driver_t *driver = heap_caps_calloc(1, sizeof(hid_driver_t), MALLOC_CAP_DEFAULT);
-    HID_RETURN_ON_FALSE(driver,
+    hid_host_mux_t *mux = HID_CALLOC(CONTROL, 1, sizeof(hid_host_mux_t));
+    HID_RETURN_ON_FALSE(mux,
                         ESP_ERR_NO_MEM,
                         "Unable to allocate memory");
 
-    driver->user_cb = config->callback;
-    driver->user_arg = config->callback_arg;
+    mux->queue = hid_report_queue_create(config->queue_len,
+                                         config->report_size ? config->report_size : HID_MUX_REPORT_SIZE_DEFAULT);
+    if (NULL == mux->queue) {
+        HID_FREE(CONTROL, mux, sizeof(hid_host_mux_t));
+        ESP_LOGE(TAG, "Unable to allocate report queue");
+        return ESP_ERR_NO_MEM;
+    }
+    *mux_hdl_ret = mux;
+    return ESP_OK;
+}
 
-    usb_host_client_config_t client_config = {
-        .is_synchronous = false,
-        .async.client_event_callback = client_event_cb,
-        .async.callback_arg = NULL,
-        .max_num_event_msg = 10,
-    };
+esp_err_t hid_host_mux_delete(hid_host_mux_handle_t mux_hdl)
+{
+    HID_RETURN_ON_INVALID_ARG(mux_hdl);
 
-    driver->end_client_event_handling = false;
-    driver->all_events_handled = xSemaphoreCreateBinary();
-    HID_GOTO_ON_FALSE(driver->all_events_handled,
-                      ESP_ERR_NO_MEM,
-                      "Unable to create semaphore");
+    HID_ENTER_CRITICAL();
+    HID_RETURN_ON_FALSE_CRITICAL( 0 == mux_hdl->ifaces_num, ESP_ERR_INVALID_STATE );
+    HID_EXIT_CRITICAL();
+
+    hid_report_queue_delete(mux_hdl->queue);
+    HID_FREE(CONTROL, mux_hdl, sizeof(hid_host_mux_t));
+    return ESP_OK;
+}
 
-    HID_GOTO_ON_ERROR( usb_host_client_register(&client_config,
-                       &driver->client_handle),
-                       "Unable to register USB Host client");
+esp_err_t hid_host_mux_add(hid_host_mux_handle_t mux_hdl, hid_host_device_handle_t hid_dev_handle)
+{
+    hid_iface_t *iface = get_iface_by_handle(hid_dev_handle);
+
+    HID_RETURN_ON_INVALID_ARG(mux_hdl);
+    HID_RETURN_ON_INVALID_ARG(iface);
 
     HID_ENTER_CRITICAL();
-    HID_GOTO_ON_FALSE_CRITICAL(!s_hid_driver, ESP_ERR_INVALID_STATE);
-    s_hid_driver = driver;
-    STAILQ_INIT(&s_hid_driver->hid_devices_tailq);
-    STAILQ_INIT(&s_hid_driver->hid_ifaces_tailq);
+    // The IN transfer callback reads the multiplexer without lock, it can be changed only before hid_host_device_start()
+    HID_RETURN_ON_FALSE_CRITICAL( HID_INTERFACE_STATE_READY == iface->state, ESP_ERR_INVALID_STATE );
+    HID_RETURN_ON_FALSE_CRITICAL( NULL == iface->mux, ESP_ERR_INVALID_STATE );
+    iface->mux = mux_hdl;
+    mux_hdl->ifaces_num++;
     HID_EXIT_CRITICAL();
+    return ESP_OK;
+}
 
-    if (config->create_background_task) {
-        BaseType_t task_created = xTaskCreatePinnedToCore(
-                                      event_handler_task,
-                                      "USB HID Host",
-                                      config->stack_size,
-                                      NULL,
-                                      config->task_priority,
-                                      NULL,
-                                      config->core_id);
-        HID_GOTO_ON_FALSE(task_created,
-                          ESP_ERR_NO_MEM,
-                          "Unable to create USB HID Host task");
-    }
+esp_err_t hid_host_mux_remove(hid_host_device_handle_t hid_dev_handle)
+{
+    hid_iface_t *iface = get_iface_by_handle(hid_dev_handle);
 
+    HID_RETURN_ON_INVALID_ARG(iface);
+
+    HID_ENTER_CRITICAL();
+    HID_RETURN_ON_FALSE_CRITICAL( HID_INTERFACE_STATE_READY == iface->state, ESP_ERR_INVALID_STATE );
+    _hid_host_mux_remove(iface);
+    HID_EXIT_CRITICAL();
     return ESP_OK;
+}
 
-fail:
-    s_hid_driver = NULL;
-    if (driver->client_handle) {
-        usb_host_client_deregister(driver->client_handle);
-    }
-    if (driver->all_events_handled) {
-        vSemaphoreDelete(driver->all_events_handled);
+esp_err_t hid_host_mux_wait(hid_host_mux_handle_t mux_hdl,
+                            hid_host_mux_event_t *events,
+                            size_t events_max,
+                            size_t *events_num,
+                            uint32_t timeout_ms)
+{
+    HID_RETURN_ON_INVALID_ARG(mux_hdl);
+    HID_RETURN_ON_FALSE(events && events_num,
+                        ESP_ERR_INVALID_ARG,
+                        "Wrong argument");
+
+    hid_report_queue_t *queue = mux_hdl->queue;
+    const unsigned tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    const size_t num = MIN(hid_report_queue_wait(queue, timeout_ms), events_max);
+    for (size_t i = 0; i < num; i++) {
+        const size_t idx = (tail + i) % queue->len;
+        events[i].hid_device_handle = queue->slots[idx].iface;
+        events[i].report.timestamp_us = queue->slots[idx].timestamp_us;
+        events[i].report.len = queue->slots[idx].len;
+        events[i].report.data = queue->data + idx * queue->slot_size;
     }
-    free(driver);
-    return ret;
+    *events_num = num;
+    return (num || events_max == 0) ? ESP_OK : ESP_ERR_TIMEOUT;
 }
 
-esp_err_t hid_host_uninstall(void)
+esp_err_t hid_host_mux_release(hid_host_mux_handle_t mux_hdl, size_t events_num)
 {
-    // Make sure hid driver is installed,
-    HID_RETURN_ON_FALSE(s_hid_driver,
-                        ESP_OK,
-                        "HID Host driver was not installed");
+    HID_RETURN_ON_INVALID_ARG(mux_hdl);
 
-    // Make sure that hid driver
-    // not being uninstalled from other task
-    // and no hid device is registered
-    HID_ENTER_CRITICAL();
-    HID_RETURN_ON_FALSE_CRITICAL( !s_hid_driver->end_client_event_handling, ESP_ERR_INVALID_STATE );
-    HID_RETURN_ON_FALSE_CRITICAL( STAILQ_EMPTY(&s_hid_driver->hid_devices_tailq), ESP_ERR_INVALID_STATE );
-    HID_RETURN_ON_FALSE_CRITICAL( STAILQ_EMPTY(&s_hid_driver->hid_ifaces_tailq), ESP_ERR_INVALID_STATE );
-    s_hid_driver->end_client_event_handling = true;
-    HID_EXIT_CRITICAL();
+    return hid_report_queue_release(mux_hdl->queue, events_num);
+}
 
-    if (s_hid_driver->event_handling_started) {
-        ESP_ERROR_CHECK( usb_host_client_unblock(s_hid_driver->client_handle) );
-        // In case the event handling started, we must wait until it finishes
-        xSemaphoreTake(s_hid_driver->all_events_handled, portMAX_DELAY);
+uint32_t hid_host_mux_get_overruns(hid_host_mux_handle_t mux_hdl)
+{
+    if (NULL == mux_hdl) {
+        return 0;
     }
-    vSemaphoreDelete(s_hid_driver->all_events_handled);
-    ESP_ERROR_CHECK( usb_host_client_deregister(s_hid_driver->client_handle) );
-    free(s_hid_driver);
-    s_hid_driver = NULL;
-    return ESP_OK;
+    return __atomic_load_n(&mux_hdl->queue->overruns, __ATOMIC_RELAXED);
 }
 
-esp_err_t hid_host_device_open(hid_host_device_handle_t hid_dev_handle,
-                               const hid_host_device_config_t *config)
+esp_err_t hid_host_device_send_output_report(hid_host_device_handle_t hid_dev_handle,
+        const uint8_t *data,
+        size_t data_length,
+        uint32_t timeout_ms)
 {
-    HID_RETURN_ON_FALSE(s_hid_driver,
-                        ESP_ERR_INVALID_STATE,
-                        "HID Driver is not installed");
+    hid_iface_t *iface = get_iface_by_handle(hid_dev_handle);
 
-    hid_iface_t *hid_iface = get_iface_by_handle(hid_dev_handle);
+    HID_RETURN_ON_FALSE(iface,
+                        ESP_ERR_INVALID_STATE,
+                        "HID Interface not found");
 
-    HID_RETURN_ON_INVALID_ARG(hid_iface);
+    HID_RETURN_ON_FALSE(iface->ep_out,
+                        ESP_ERR_NOT_SUPPORTED,
+                        "Interface has no OUT endpoint");
 
-    HID_RETURN_ON_FALSE((hid_iface->dev_params.proto >= HID_PROTOCOL_NONE)
-                        && (hid_iface->dev_params.proto < HID_PROTOCOL_MAX),
+    HID_RETURN_ON_FALSE(data && data_length,
                         ESP_ERR_INVALID_ARG,
-                        "HID device protocol not supported");
+                        "Wrong argument");
 
-    HID_RETURN_ON_FALSE((HID_INTERFACE_STATE_IDLE == hid_iface->state),
+    HID_RETURN_ON_FALSE(data_length <= iface->ep_out_mps,
+                        ESP_ERR_INVALID_SIZE,
+                        "Report larger than EP OUT max packet size");
+
+    HID_RETURN_ON_FALSE((HID_INTERFACE_STATE_ACTIVE == iface->state),
                         ESP_ERR_INVALID_STATE,
                         "Interface wrong state");
 
-    // Claim interface, allocate xfer and save report callback
-    HID_RETURN_ON_ERROR( hid_host_interface_claim_and_prepare_transfer(hid_iface),
-                         "Unable to claim interface");
+    usb_transfer_t *out_xfer;
+    HID_RETURN_ON_FALSE(xQueueReceive(iface->out_xfer_free, &out_xfer, pdMS_TO_TICKS(timeout_ms)),
+                        ESP_ERR_TIMEOUT,
+                        "No free OUT transfer");
+
+    memcpy(out_xfer->data_buffer, data, data_length);
+    out_xfer->num_bytes = data_length;
+    esp_err_t ret = CLIENT_TRANSFER_SUBMIT(out_xfer);
+    if (ESP_OK != ret) {
+        xQueueSend(iface->out_xfer_free, &out_xfer, 0);
+        ESP_LOGE(TAG, "Unable to submit OUT transfer");
+    }
+    return ret;
+}
 
-    // Save HID Interface callback
-    hid_iface->user_cb = config->callback;
-    hid_iface->user_cb_arg = config->callback_arg;
+esp_err_t hid_host_device_register_report_callback(hid_host_device_handle_t hid_dev_handle,
+        uint8_t report_id,
+        bool changes_only,
+        hid_host_report_cb_t callback,
+        void *callback_arg)
+{
+    hid_iface_t *iface = get_iface_by_handle(hid_dev_handle);
+
+    HID_RETURN_ON_INVALID_ARG(iface);
+    HID_RETURN_ON_INVALID_ARG(callback);
+
+    // The callbacks are read by in_xfer_done() without lock, so they can be changed only while no transfer is running
+    HID_RETURN_ON_FALSE((HID_INTERFACE_STATE_READY == iface->state),
+                        ESP_ERR_INVALID_STATE,
+                        "Interface must be opened and not started");
+
+    if (NULL == iface->report_cbs) {
+        iface->report_cbs = HID_CALLOC(CONTROL, 256, sizeof(hid_report_cb_entry_t *));
+        HID_RETURN_ON_FALSE(iface->report_cbs,
+                            ESP_ERR_NO_MEM,
+                            "Unable to allocate memory");
+    }
 
+    // Report ID 0 cannot be mixed with other Report IDs
+    bool other_ids = false;
+    for (int i = 1; !other_ids && i < 256; i++) {
+        other_ids = iface->report_cbs[i] && (i != report_id);
+    }
+    HID_RETURN_ON_FALSE(!(report_id == 0 && other_ids) && !(report_id != 0 && iface->report_cbs[0]),
+                        ESP_ERR_INVALID_ARG,
+                        "Report ID 0 is for devices without Report IDs");
+
+    hid_report_cb_entry_t *entry = iface->report_cbs[report_id];
+    if (NULL == entry) {
+        entry = HID_CALLOC(CONTROL, 1, sizeof(hid_report_cb_entry_t));
+        HID_RETURN_ON_FALSE(entry,
+                            ESP_ERR_NO_MEM,
+                            "Unable to allocate memory");
+    }
+    if (changes_only && NULL == entry->last) {
+        entry->last = HID_MALLOC(BUFFER, iface->in_report_size);
+        if (NULL == entry->last) {
+            if (NULL == iface->report_cbs[report_id]) {
+                HID_FREE(CONTROL, entry, sizeof(hid_report_cb_entry_t));
+            }
+            ESP_LOGE(TAG, "Unable to allocate memory");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    entry->cb = callback;
+    entry->cb_arg = callback_arg;
+    entry->changes_only = changes_only;
+    entry->last_len = 0;
+    iface->report_cbs[report_id] = entry;
     return ESP_OK;
 }
 
-esp_err_t hid_host_device_close(hid_host_device_handle_t hid_dev_handle)
+esp_err_t hid_host_device_unregister_report_callback(hid_host_device_handle_t hid_dev_handle,
+        uint8_t report_id)
 {
-    hid_iface_t *hid_iface = get_iface_by_handle(hid_dev_handle);
+    hid_iface_t *iface = get_iface_by_handle(hid_dev_handle);
 
-    HID_RETURN_ON_INVALID_ARG(hid_iface);
+    HID_RETURN_ON_INVALID_ARG(iface);
 
-    ESP_LOGD(TAG, "Close addr %d, iface %d, state %d",
-             hid_iface->dev_params.addr,
-             hid_iface->dev_params.iface_num,
-             hid_iface->state);
+    HID_RETURN_ON_FALSE((HID_INTERFACE_STATE_READY == iface->state),
+                        ESP_ERR_INVALID_STATE,
+                        "Interface must be opened and not started");
 
-    if (HID_INTERFACE_STATE_ACTIVE == hid_iface->state) {
-        HID_RETURN_ON_ERROR( hid_host_disable_interface(hid_iface),
-                             "Unable to disable HID Interface");
-    }
+    hid_report_cb_entry_t *entry = iface->report_cbs ? iface->report_cbs[report_id] : NULL;
+    HID_RETURN_ON_FALSE(entry,
+                        ESP_ERR_NOT_FOUND,
+                        "Report callback not registered");
 
-    if (HID_INTERFACE_STATE_READY == hid_iface->state) {
-        HID_RETURN_ON_ERROR( hid_host_interface_release_and_free_transfer(hid_iface),
-                             "Unable to release HID Interface");
+    iface->report_cbs[report_id] = NULL;
+    hid_report_cb_entry_free(iface, entry);
 
-        // If the device is closing by user before device detached we need to flush user callback here
-        free(hid_iface->report_desc);
-        hid_iface->report_desc = NULL;
+    // Free the table with the last callback, so reports are passed to the interface callback without lookup
+    bool used = false;
+    for (int i = 0; !used && i < 256; i++) {
+        used = (NULL != iface->report_cbs[i]);
+    }
+    if (!used) {
+        hid_report_cbs_free(iface);
     }
+    return ESP_OK;
+}
 
-    if (hid_iface->user_cb && hid_iface->state != HID_INTERFACE_STATE_WAIT_USER_DELETION) {
-        // Let user handle the remove process and wait for next hid_host_device_close() call
-        hid_iface->state = HID_INTERFACE_STATE_WAIT_USER_DELETION;
-        hid_host_user_interface_callback(hid_iface, HID_HOST_INTERFACE_EVENT_DISCONNECTED);
-    } else {
-        // Second call
-        hid_iface->user_cb = NULL;
-        hid_iface->user_cb_arg = NULL;
+esp_err_t hid_host_device_register_keyboard_callback(hid_host_device_handle_t hid_dev_handle,
+        hid_host_keyboard_cb_t callback,
+        void *callback_arg)
+{
+    hid_iface_t *iface = get_iface_by_handle(hid_dev_handle);
 
-        /* Remove Interface from the list */
-        ESP_LOGD(TAG, "Remove addr %d, iface %d from list",
-                 hid_iface->dev_params.addr,
-                 hid_iface->dev_params.iface_num);
-        HID_ENTER_CRITICAL();
-        _hid_host_remove_interface(hid_iface);
-        HID_EXIT_CRITICAL();
-    }
+    HID_RETURN_ON_INVALID_ARG(iface);
+    HID_RETURN_ON_INVALID_ARG(callback);
 
+    // The callback is read by in_xfer_done() without lock, so it can be changed only while no transfer is running
+    HID_RETURN_ON_FALSE((HID_INTERFACE_STATE_READY == iface->state),
+                        ESP_ERR_INVALID_STATE,
+                        "Interface must be opened and not started");
+    HID_RETURN_ON_FALSE((HID_PROTOCOL_KEYBOARD == iface->dev_params.proto),
+                        ESP_ERR_NOT_SUPPORTED,
+                        "Interface is not a keyboard");
+
+    if (NULL == iface->keyboard) {
+        iface->keyboard = HID_MALLOC(CONTROL, sizeof(hid_keyboard_entry_t));
+        HID_RETURN_ON_FALSE(iface->keyboard,
+                            ESP_ERR_NO_MEM,
+                            "Unable to allocate memory");
+    }
+    iface->keyboard->cb = callback;
+    iface->keyboard->cb_arg = callback_arg;
+    hid_keyboard_state_reset(&iface->keyboard->state);
     return ESP_OK;
 }
 
-esp_err_t hid_host_handle_events(uint32_t timeout)
+esp_err_t hid_host_device_unregister_keyboard_callback(hid_host_device_handle_t hid_dev_handle)
 {
-    HID_RETURN_ON_FALSE(s_hid_driver != NULL,
+    hid_iface_t *iface = get_iface_by_handle(hid_dev_handle);
+
+    HID_RETURN_ON_INVALID_ARG(iface);
+
+    HID_RETURN_ON_FALSE((HID_INTERFACE_STATE_READY == iface->state),
                         ESP_ERR_INVALID_STATE,
-                        "HID Driver is not installed");
+                        "Interface must be opened and not started");
+    HID_RETURN_ON_FALSE(iface->keyboard,
+                        ESP_ERR_NOT_FOUND,
+                        "Keyboard callback not registered");
 
-    ESP_LOGD(TAG, "USB HID handling");
-    s_hid_driver->event_handling_started = true;
-    esp_err_t ret = usb_host_client_handle_events(s_hid_driver->client_handle, timeout);
-    if (s_hid_driver->end_client_event_handling) {
-        xSemaphoreGive(s_hid_driver->all_events_handled);
-        return ESP_FAIL;
-    }
-    return ret;
+    HID_FREE(CONTROL, iface->keyboard, sizeof(hid_keyboard_entry_t));
+    iface->keyboard = NULL;
+    return ESP_OK;
 }
 
-esp_err_t hid_host_device_get_params(hid_host_device_handle_t hid_dev_handle,
-                                     hid_host_dev_params_t *dev_params)
+esp_err_t hid_host_device_get_stats(hid_host_device_handle_t hid_dev_handle,
+                                    hid_host_stats_t *stats)
 {
     hid_iface_t *iface = get_iface_by_handle(hid_dev_handle);
 
@@ -1264,18 +3187,17 @@ esp_err_t hid_host_device_get_params(hid_host_device_handle_t hid_dev_handle,
                         ESP_ERR_INVALID_STATE,
                         "HID Interface not found");
 
-    HID_RETURN_ON_FALSE(dev_params,
+    HID_RETURN_ON_FALSE(stats,
                         ESP_ERR_INVALID_ARG,
                         "Wrong argument");
 
-    memcpy(dev_params, &iface->dev_params, sizeof(hid_host_dev_params_t));
+    HID_ENTER_CRITICAL();
+    *stats = iface->stats;
+    HID_EXIT_CRITICAL();
     return ESP_OK;
 }
 
-esp_err_t hid_host_device_get_raw_input_report_data(hid_host_device_handle_t hid_dev_handle,
-        uint8_t *data,
-        size_t data_length_max,
-        size_t *data_length)
+esp_err_t hid_host_device_reset_stats(hid_host_device_handle_t hid_dev_handle)
 {
     hid_iface_t *iface = get_iface_by_handle(hid_dev_handle);
 
@@ -1283,19 +3205,11 @@ esp_err_t hid_host_device_get_raw_input_report_data(hid_host_device_handle_t hid
                         ESP_ERR_INVALID_STATE,
                         "HID Interface not found");
 
-    HID_RETURN_ON_FALSE(data,
-                        ESP_ERR_INVALID_ARG,
-                        "Wrong argument");
-
-    HID_RETURN_ON_FALSE(data_length,
-                        ESP_ERR_INVALID_ARG,
-                        "Wrong argument");
-
-    size_t copied = (data_length_max >= iface->in_xfer->actual_num_bytes)
-                    ? iface->in_xfer->actual_num_bytes
-                    : data_length_max;
-    memcpy(data, iface->in_xfer->data_buffer, copied);
-    *data_length = copied;
+    HID_ENTER_CRITICAL();
+    const uint32_t poll_interval_us = iface->stats.poll_interval_us;
+    memset(&iface->stats, 0, sizeof(hid_host_stats_t));
+    iface->stats.poll_interval_us = poll_interval_us;
+    HID_EXIT_CRITICAL();
     return ESP_OK;
 }
 
@@ -1317,18 +3231,31 @@ esp_err_t hid_host_device_start(hid_host_device_handle_t hid_dev_handle)
                          ESP_ERR_INVALID_STATE,
                          "Interface wrong state");
 
-    // prepare transfer
-    iface->in_xfer->device_handle = iface->parent->dev_hdl;
-    iface->in_xfer->callback = in_xfer_done;
-    iface->in_xfer->context = iface;
-    iface->in_xfer->timeout_ms = DEFAULT_TIMEOUT_MS;
-    iface->in_xfer->bEndpointAddress = iface->ep_in;
-    iface->in_xfer->num_bytes = iface->ep_in_mps;
-
     iface->state = HID_INTERFACE_STATE_ACTIVE;
 
-    // start data transfer
-    return usb_host_transfer_submit(iface->in_xfer);
+    // prepare and start all transfers, so the next one is already queued when one completes
+    for (int i = 0; i < iface->in_xfer_num; i++) {
+        usb_transfer_t *in_xfer = iface->in_xfer[i];
+        in_xfer->device_handle = iface->parent->dev_hdl;
+        in_xfer->callback = in_xfer_done;
+        in_xfer->context = iface;
+        in_xfer->timeout_ms = DEFAULT_TIMEOUT_MS;
+        in_xfer->bEndpointAddress = iface->ep_in;
+        in_xfer->num_bytes = hid_host_in_xfer_size(iface);
+        const esp_err_t ret = CLIENT_TRANSFER_SUBMIT(in_xfer);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Unable to submit IN transfer");
+            // Cancel the transfers submitted so far, so the interface can be started again
+            if (i > 0) {
+                usb_host_endpoint_halt(iface->parent->dev_hdl, iface->ep_in);
+                usb_host_endpoint_flush(iface->parent->dev_hdl, iface->ep_in);
+                usb_host_endpoint_clear(iface->parent->dev_hdl, iface->ep_in);
+            }
+            iface->state = HID_INTERFACE_STATE_READY;
+            return ret;
+        }
+    }
+    return ESP_OK;
 }
 
 esp_err_t hid_host_device_stop(hid_host_device_handle_t hid_dev_handle)
@@ -1364,6 +3291,31 @@ uint8_t *hid_host_get_report_descriptor(hid_host_device_handle_t hid_dev_handle,
     return NULL;
 }
 
+const hid_report_map_t *hid_host_get_report_map(hid_host_device_handle_t hid_dev_handle)
+{
+    hid_iface_t *iface = get_iface_by_handle(hid_dev_handle);
+
+    if (NULL == iface) {
+        return NULL;
+    }
+
+    // Report Descriptor was already compiled, return the map
+    if (iface->report_map) {
+        return iface->report_map;
+    }
+
+    size_t report_desc_len;
+    const uint8_t *report_desc = hid_host_get_report_descriptor(hid_dev_handle, &report_desc_len);
+    if (NULL == report_desc) {
+        return NULL;
+    }
+
+    if (ESP_OK != hid_report_map_compile(iface)) {
+        return NULL;
+    }
+    return iface->report_map;
+}
+
 esp_err_t hid_host_get_device_info(hid_host_device_handle_t hid_dev_handle,
                                    hid_host_dev_info_t *hid_dev_info)
 {
@@ -1489,6 +3441,67 @@ esp_err_t hid_class_request_set_report(hid_host_device_handle_t hid_dev_handle,
     return hid_class_request_set(iface->parent, &set_report);
 }
 
+esp_err_t hid_class_request_set_report_async(hid_host_device_handle_t hid_dev_handle,
+        uint8_t report_type,
+        uint8_t report_id,
+        const uint8_t *report,
+        size_t report_length,
+        hid_host_request_cb_t callback,
+        void *callback_arg)
+{
+    hid_iface_t *iface = get_iface_by_handle(hid_dev_handle);
+
+    HID_RETURN_ON_INVALID_ARG(iface);
+    HID_RETURN_ON_INVALID_ARG(iface->parent);
+    HID_RETURN_ON_FALSE(report || (report_length == 0),
+                        ESP_ERR_INVALID_ARG,
+                        "Wrong argument");
+    HID_RETURN_ON_FALSE(report_length <= UINT16_MAX,
+                        ESP_ERR_INVALID_SIZE,
+                        "Report too long");
+
+    const usb_setup_packet_t setup = {
+        .bmRequestType = USB_BM_REQUEST_TYPE_DIR_OUT |
+        USB_BM_REQUEST_TYPE_TYPE_CLASS |
+        USB_BM_REQUEST_TYPE_RECIP_INTERFACE,
+        .bRequest = HID_CLASS_SPECIFIC_REQ_SET_REPORT,
+        .wValue = (report_type << 8) | report_id,
+        .wIndex = iface->dev_params.iface_num,
+        .wLength = report_length,
+    };
+
+    return hid_async_req_queue(iface, &setup, report, callback, callback_arg);
+}
+
+esp_err_t hid_class_request_get_report_async(hid_host_device_handle_t hid_dev_handle,
+        uint8_t report_type,
+        uint8_t report_id,
+        size_t report_length_max,
+        hid_host_request_cb_t callback,
+        void *callback_arg)
+{
+    hid_iface_t *iface = get_iface_by_handle(hid_dev_handle);
+
+    HID_RETURN_ON_INVALID_ARG(iface);
+    HID_RETURN_ON_INVALID_ARG(iface->parent);
+    HID_RETURN_ON_INVALID_ARG(callback);
+    HID_RETURN_ON_FALSE(report_length_max <= UINT16_MAX,
+                        ESP_ERR_INVALID_SIZE,
+                        "Report too long");
+
+    const usb_setup_packet_t setup = {
+        .bmRequestType = USB_BM_REQUEST_TYPE_DIR_IN |
+        USB_BM_REQUEST_TYPE_TYPE_CLASS |
+        USB_BM_REQUEST_TYPE_RECIP_INTERFACE,
+        .bRequest = HID_CLASS_SPECIFIC_REQ_GET_REPORT,
+        .wValue = (report_type << 8) | report_id,
+        .wIndex = iface->dev_params.iface_num,
+        .wLength = report_length_max,
+    };
+
+    return hid_async_req_queue(iface, &setup, NULL, callback, callback_arg);
+}
+
 esp_err_t hid_class_request_set_idle(hid_host_device_handle_t hid_dev_handle,
                                      uint8_t duration,
                                      uint8_t report_id)
@@ -0,0 +1,96 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "sdkconfig.h"
+
+#include "usb/hid_keyboard.h"
+
+// Called from interrupt IN transfer callback, placed in IRAM if CONFIG_HID_HOST_DATA_PATH_IN_IRAM is enabled
+#if CONFIG_HID_HOST_DATA_PATH_IN_IRAM && !CONFIG_IDF_TARGET_LINUX
+#include "esp_attr.h"
+#define HID_DATA_PATH_ATTR IRAM_ATTR
+#else
+#define HID_DATA_PATH_ATTR
+#endif
+
+#define HID_KEYBOARD_WORDS (sizeof(((hid_keyboard_state_t *)0)->keys) / sizeof(uint32_t))
+
+// Modifiers 0xE0 - 0xE7 are the lowest bits of the last word
+#define HID_KEYBOARD_MODIFIER_WORD  (HID_KEYBOARD_MODIFIER_USAGE >> 5)
+#define HID_KEYBOARD_MODIFIER_SHIFT (HID_KEYBOARD_MODIFIER_USAGE & 31)
+
+void hid_keyboard_state_reset(hid_keyboard_state_t *state)
+{
+    memset(state, 0, sizeof(hid_keyboard_state_t));
+}
+
+/**
+ * @brief Append events of the set bits of a word
+ *
+ * @param[in]  bits     Changed keys of the word
+ * @param[in]  word     Index of the word
+ * @param[in]  pressed  The keys were pressed
+ * @param[in]  modifier Modifier bits after the report
+ * @param[out] events   Next free event
+ * @return Next free event
+ */
+static hid_keyboard_event_t *HID_DATA_PATH_ATTR hid_keyboard_events_add(uint32_t bits, unsigned word, bool pressed, uint8_t modifier,
+        hid_keyboard_event_t *events)
+{
+    while (bits) {
+        const unsigned bit = __builtin_ctz(bits);
+        bits &= bits - 1;
+        events->key_code = (uint8_t)(word * 32 + bit);
+        events->modifier = modifier;
+        events->pressed = pressed;
+        events++;
+    }
+    return events;
+}
+
+size_t HID_DATA_PATH_ATTR hid_keyboard_process_report(hid_keyboard_state_t *state, const uint8_t *report, size_t report_len,
+        hid_keyboard_event_t events[HID_KEYBOARD_EVENTS_MAX])
+{
+    if (report_len < 3) {
+        return 0;
+    }
+    const hid_keyboard_input_report_boot_t *boot = (const hid_keyboard_input_report_boot_t *)report;
+    const size_t key_num = (report_len - 2 < HID_KEYBOARD_KEY_MAX) ? report_len - 2 : HID_KEYBOARD_KEY_MAX;
+
+    hid_keyboard_state_t new_state = {0};
+    new_state.keys[HID_KEYBOARD_MODIFIER_WORD] = (uint32_t)boot->modifier.val << HID_KEYBOARD_MODIFIER_SHIFT;
+    for (size_t i = 0; i < key_num; i++) {
+        const uint8_t key = boot->key[i];
+        if (key == HID_KEY_ROLLOVER) {
+            return 0; // Phantom state: Too many keys pressed, the array does not tell which
+        }
+        if (key > HID_KEY_ERROR_UNDEFINED) {
+            new_state.keys[key >> 5] |= 1UL << (key & 31);
+        }
+    }
+
+    // Changed keys: released ones are set in the old state, pressed ones in the new state
+    uint32_t changed[HID_KEYBOARD_WORDS];
+    uint32_t any_change = 0;
+    for (unsigned w = 0; w < HID_KEYBOARD_WORDS; w++) {
+        changed[w] = state->keys[w] ^ new_state.keys[w];
+        any_change |= changed[w];
+    }
+    if (!any_change) {
+        return 0;
+    }
+
+    hid_keyboard_event_t *next = events;
+    for (unsigned w = 0; w < HID_KEYBOARD_WORDS; w++) {
+        next = hid_keyboard_events_add(changed[w] & state->keys[w], w, false, boot->modifier.val, next);
+    }
+    for (unsigned w = 0; w < HID_KEYBOARD_WORDS; w++) {
+        next = hid_keyboard_events_add(changed[w] & new_state.keys[w], w, true, boot->modifier.val, next);
+    }
+    *state = new_state;
+    return next - events;
+}
@@ -0,0 +1,271 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_check.h"
+#include "freertos/FreeRTOS.h"
+
+#include "usb/hid_host.h"
+#include "hid_report_desc_cache.h"
+#include "hid_mem_priv.h"
+
+// Exported blob: magic, then entries of packed key followed by the Report Descriptor. All fields are little-endian
+#define HID_CACHE_BLOB_MAGIC     (0x31434452)  // "RDC1"
+#define HID_CACHE_BLOB_KEY_SIZE  (9)
+
+static const char *TAG = "hid-desc-cache";
+
+static portMUX_TYPE hid_cache_lock = portMUX_INITIALIZER_UNLOCKED;
+#define HID_CACHE_ENTER_CRITICAL()  portENTER_CRITICAL(&hid_cache_lock)
+#define HID_CACHE_EXIT_CRITICAL()   portEXIT_CRITICAL(&hid_cache_lock)
+
+typedef struct {
+    hid_report_desc_cache_key_t key;
+    uint8_t *report_desc;               // Cached Report Descriptor of key.wReportDescriptorLength bytes
+    uint32_t last_used;                 // Sequence number of last use. 0: Entry is empty
+} hid_cache_slot_t;
+
+static hid_cache_slot_t *hid_cache_slots = NULL; // Protected by critical section
+static size_t hid_cache_num_slots = 0;
+static uint32_t hid_cache_sequence = 0;
+
+static inline bool hid_cache_key_equal(const hid_report_desc_cache_key_t *a, const hid_report_desc_cache_key_t *b)
+{
+    return a->idVendor == b->idVendor &&
+           a->idProduct == b->idProduct &&
+           a->bcdDevice == b->bcdDevice &&
+           a->bInterfaceNumber == b->bInterfaceNumber &&
+           a->wReportDescriptorLength == b->wReportDescriptorLength;
+}
+
+/**
+ * @brief Find slot for an entry
+ *
+ * Must be called from critical section
+ *
+ * @param[in] key         Entry key
+ * @param[in] allow_evict Return empty or least recently used slot if the key is not cached
+ * @return Slot or NULL if not found
+ */
+static hid_cache_slot_t *hid_cache_find(const hid_report_desc_cache_key_t *key, bool allow_evict)
+{
+    hid_cache_slot_t *lru = NULL;
+    for (size_t i = 0; i < hid_cache_num_slots; i++) {
+        hid_cache_slot_t *slot = &hid_cache_slots[i];
+        if (slot->last_used != 0 && hid_cache_key_equal(&slot->key, key)) {
+            return slot;
+        }
+        if (!lru || slot->last_used < lru->last_used) {
+            lru = slot;
+        }
+    }
+    return allow_evict ? lru : NULL;
+}
+
+/**
+ * @brief Store an entry
+ *
+ * @param[in] key         Entry key
+ * @param[in] report_desc Report Descriptor
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_NO_MEM: Not enough memory for the copy
+ *     - ESP_ERR_INVALID_STATE: The cache is disabled
+ */
+static esp_err_t hid_cache_store(const hid_report_desc_cache_key_t *key, const uint8_t *report_desc)
+{
+    // Copy is made outside of critical section, replaced Report Descriptor is freed after it
+    uint8_t *copy = HID_MALLOC(DESCRIPTOR, key->wReportDescriptorLength);
+    ESP_RETURN_ON_FALSE(copy, ESP_ERR_NO_MEM, TAG, "Unable to allocate memory");
+    memcpy(copy, report_desc, key->wReportDescriptorLength);
+
+    HID_CACHE_ENTER_CRITICAL();
+    hid_cache_slot_t *slot = hid_cache_find(key, true);
+    uint8_t *old = NULL;
+    size_t old_len = 0;
+    if (slot) {
+        old = slot->report_desc;
+        old_len = slot->key.wReportDescriptorLength;
+        slot->key = *key;
+        slot->report_desc = copy;
+        slot->last_used = ++hid_cache_sequence;
+        copy = NULL;
+    }
+    HID_CACHE_EXIT_CRITICAL();
+
+    HID_FREE(DESCRIPTOR, old, old_len);
+    HID_FREE(DESCRIPTOR, copy, key->wReportDescriptorLength);
+    return slot ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t hid_report_desc_cache_init(size_t num_entries)
+{
+    if (num_entries == 0) {
+        return ESP_OK;
+    }
+    hid_cache_slot_t *slots = HID_CALLOC(DESCRIPTOR, num_entries, sizeof(hid_cache_slot_t));
+    ESP_RETURN_ON_FALSE(slots, ESP_ERR_NO_MEM, TAG, "Unable to allocate memory");
+
+    HID_CACHE_ENTER_CRITICAL();
+    if (hid_cache_slots) {
+        HID_CACHE_EXIT_CRITICAL();
+        HID_FREE(DESCRIPTOR, slots, num_entries * sizeof(hid_cache_slot_t));
+        return ESP_ERR_INVALID_STATE;
+    }
+    hid_cache_slots = slots;
+    hid_cache_num_slots = num_entries;
+    hid_cache_sequence = 0;
+    HID_CACHE_EXIT_CRITICAL();
+    return ESP_OK;
+}
+
+void hid_report_desc_cache_deinit(void)
+{
+    if (!hid_cache_slots) {
+        return; // Cache is disabled
+    }
+    HID_CACHE_ENTER_CRITICAL();
+    hid_cache_slot_t *slots = hid_cache_slots;
+    const size_t num_slots = hid_cache_num_slots;
+    hid_cache_slots = NULL;
+    hid_cache_num_slots = 0;
+    HID_CACHE_EXIT_CRITICAL();
+
+    for (size_t i = 0; slots && i < num_slots; i++) {
+        HID_FREE(DESCRIPTOR, slots[i].report_desc, slots[i].key.wReportDescriptorLength);
+    }
+    HID_FREE(DESCRIPTOR, slots, num_slots * sizeof(hid_cache_slot_t));
+}
+
+bool hid_report_desc_cache_get(const hid_report_desc_cache_key_t *key, uint8_t *report_desc)
+{
+    if (!hid_cache_slots || key->wReportDescriptorLength == 0) {
+        return false;
+    }
+
+    HID_CACHE_ENTER_CRITICAL();
+    hid_cache_slot_t *slot = hid_cache_find(key, false);
+    if (slot) {
+        memcpy(report_desc, slot->report_desc, key->wReportDescriptorLength);
+        slot->last_used = ++hid_cache_sequence;
+    }
+    HID_CACHE_EXIT_CRITICAL();
+    return slot != NULL;
+}
+
+void hid_report_desc_cache_put(const hid_report_desc_cache_key_t *key, const uint8_t *report_desc)
+{
+    if (hid_cache_slots && key->wReportDescriptorLength) {
+        hid_cache_store(key, report_desc);
+    }
+}
+
+static inline void put_le16(uint8_t *p, uint16_t val)
+{
+    p[0] = (uint8_t)val;
+    p[1] = (uint8_t)(val >> 8);
+}
+
+static inline uint16_t get_le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+esp_err_t hid_host_report_desc_cache_export(uint8_t *blob, size_t *blob_len)
+{
+    ESP_RETURN_ON_FALSE(blob_len, ESP_ERR_INVALID_ARG, TAG, "Invalid arguments");
+    const size_t blob_size = blob ? *blob_len : 0;
+    size_t len = 4;
+
+    HID_CACHE_ENTER_CRITICAL();
+    if (!hid_cache_slots) {
+        HID_CACHE_EXIT_CRITICAL();
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Entries are exported from the least recently used, so the import keeps their order of use
+    uint32_t prev_used = 0;
+    while (true) {
+        const hid_cache_slot_t *next = NULL;
+        for (size_t i = 0; i < hid_cache_num_slots; i++) {
+            const hid_cache_slot_t *slot = &hid_cache_slots[i];
+            if (slot->last_used > prev_used && (!next || slot->last_used < next->last_used)) {
+                next = slot;
+            }
+        }
+        if (!next) {
+            break;
+        }
+        prev_used = next->last_used;
+
+        const size_t entry_len = HID_CACHE_BLOB_KEY_SIZE + next->key.wReportDescriptorLength;
+        if (len + entry_len <= blob_size) {
+            uint8_t *p = blob + len;
+            put_le16(p, next->key.idVendor);
+            put_le16(p + 2, next->key.idProduct);
+            put_le16(p + 4, next->key.bcdDevice);
+            p[6] = next->key.bInterfaceNumber;
+            put_le16(p + 7, next->key.wReportDescriptorLength);
+            memcpy(p + HID_CACHE_BLOB_KEY_SIZE, next->report_desc, next->key.wReportDescriptorLength);
+        }
+        len += entry_len;
+    }
+    HID_CACHE_EXIT_CRITICAL();
+
+    *blob_len = len;
+    if (!blob) {
+        return ESP_OK;
+    }
+    if (len > blob_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    put_le16(blob, HID_CACHE_BLOB_MAGIC & 0xFFFF);
+    put_le16(blob + 2, HID_CACHE_BLOB_MAGIC >> 16);
+    return ESP_OK;
+}
+
+esp_err_t hid_host_report_desc_cache_import(const uint8_t *blob, size_t blob_len)
+{
+    ESP_RETURN_ON_FALSE(blob && blob_len >= 4, ESP_ERR_INVALID_ARG, TAG, "Invalid arguments");
+    ESP_RETURN_ON_FALSE(hid_cache_slots, ESP_ERR_INVALID_STATE, TAG, "Report Descriptor cache is disabled");
+    ESP_RETURN_ON_FALSE(get_le16(blob) == (HID_CACHE_BLOB_MAGIC & 0xFFFF) && get_le16(blob + 2) == (HID_CACHE_BLOB_MAGIC >> 16),
+                        ESP_ERR_INVALID_VERSION, TAG, "Unknown cache blob");
+
+    size_t pos = 4;
+    while (pos < blob_len) {
+        ESP_RETURN_ON_FALSE(pos + HID_CACHE_BLOB_KEY_SIZE <= blob_len, ESP_ERR_INVALID_SIZE, TAG, "Truncated cache blob");
+        const uint8_t *p = blob + pos;
+        const hid_report_desc_cache_key_t key = {
+            .idVendor = get_le16(p),
+            .idProduct = get_le16(p + 2),
+            .bcdDevice = get_le16(p + 4),
+            .bInterfaceNumber = p[6],
+            .wReportDescriptorLength = get_le16(p + 7),
+        };
+        pos += HID_CACHE_BLOB_KEY_SIZE;
+        ESP_RETURN_ON_FALSE(key.wReportDescriptorLength && pos + key.wReportDescriptorLength <= blob_len,
+                            ESP_ERR_INVALID_SIZE, TAG, "Truncated cache blob");
+        ESP_RETURN_ON_ERROR(hid_cache_store(&key, blob + pos), TAG, "Unable to store cache entry");
+        pos += key.wReportDescriptorLength;
+    }
+    return ESP_OK;
+}
+
+esp_err_t hid_host_report_desc_cache_clear(void)
+{
+    HID_CACHE_ENTER_CRITICAL();
+    if (!hid_cache_slots) {
+        HID_CACHE_EXIT_CRITICAL();
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (size_t i = 0; i < hid_cache_num_slots; i++) {
+        hid_cache_slots[i].last_used = 0;
+    }
+    hid_cache_sequence = 0;
+    HID_CACHE_EXIT_CRITICAL();
+    return ESP_OK;
+}
@@ -0,0 +1,390 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_check.h"
+
+#include "usb/hid_report_parser.h"
+
+static const char *TAG = "hid-report";
+
+// HID Report Descriptor items, see 6.2.2 Report Descriptor, p.23 of Device Class Definition for HID Version 1.11
+#define HID_ITEM_LONG           (0xFE)
+#define HID_ITEM_TYPE_MAIN      (0)
+#define HID_ITEM_TYPE_GLOBAL    (1)
+#define HID_ITEM_TYPE_LOCAL     (2)
+
+#define HID_MAIN_INPUT          (0x8)
+#define HID_MAIN_OUTPUT         (0x9)
+#define HID_MAIN_COLLECTION     (0xA)
+#define HID_MAIN_FEATURE        (0xB)
+#define HID_MAIN_END_COLLECTION (0xC)
+
+#define HID_GLOBAL_USAGE_PAGE   (0x0)
+#define HID_GLOBAL_LOGICAL_MIN  (0x1)
+#define HID_GLOBAL_LOGICAL_MAX  (0x2)
+#define HID_GLOBAL_REPORT_SIZE  (0x7)
+#define HID_GLOBAL_REPORT_ID    (0x8)
+#define HID_GLOBAL_REPORT_COUNT (0x9)
+#define HID_GLOBAL_PUSH         (0xA)
+#define HID_GLOBAL_POP          (0xB)
+
+#define HID_LOCAL_USAGE         (0x0)
+#define HID_LOCAL_USAGE_MIN     (0x1)
+#define HID_LOCAL_USAGE_MAX     (0x2)
+
+#define HID_PARSER_STACK_DEPTH  (4)     // Depth of Push/Pop global item stack
+#define HID_PARSER_MAX_USAGES   (32)    // Usages of one Main item, the last usage applies to the remaining fields
+#define HID_PARSER_MAX_BITS     (0xFFFF)
+
+/**
+ * @brief Global items state
+ */
+typedef struct {
+    uint16_t usage_page;
+    int32_t logical_min;
+    int32_t logical_max;
+    uint32_t logical_max_raw;   // Logical Maximum is unsigned if Logical Minimum is not negative
+    uint32_t report_size;
+    uint32_t report_count;
+    uint8_t report_id;
+} hid_parser_global_t;
+
+/**
+ * @brief Local items state, cleared after each Main item
+ */
+typedef struct {
+    uint32_t usages[HID_PARSER_MAX_USAGES];     // Extended usages: usage page in upper 16 bits
+    unsigned usage_num;
+    uint32_t usage_min;
+    uint32_t usage_max;
+    bool usage_min_set;
+    bool usage_max_set;
+} hid_parser_local_t;
+
+/**
+ * @brief Field that is not assigned to its report yet
+ */
+typedef struct {
+    hid_report_field_t field;
+    uint16_t report_index;
+} hid_parser_field_t;
+
+typedef struct {
+    hid_parser_global_t global;
+    hid_parser_global_t stack[HID_PARSER_STACK_DEPTH];
+    unsigned stack_depth;
+    hid_parser_local_t local;
+    hid_report_map_t *map;
+    uint16_t report_bits[HID_REPORT_TYPE_FEATURE][256];   // Current length of each report in bits, 0: Report was not declared
+    hid_parser_field_t *fields;
+    size_t field_num;
+    size_t field_cap;
+} hid_parser_t;
+
+static uint32_t hid_item_unsigned(const uint8_t *data, uint8_t size)
+{
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < size; i++) {
+        value |= (uint32_t)data[i] << (8 * i);
+    }
+    return value;
+}
+
+static int32_t hid_item_signed(const uint8_t *data, uint8_t size)
+{
+    const uint32_t value = hid_item_unsigned(data, size);
+    if (size == 0 || size == 4) {
+        return (int32_t)value;
+    }
+    const uint32_t sign = 1UL << (8 * size - 1);
+    return (int32_t)((value ^ sign) - sign);
+}
+
+/**
+ * @brief Get index of a report, add the report if it was not declared yet
+ */
+static esp_err_t hid_parser_report_get(hid_parser_t *parser, hid_report_type_t type, uint8_t id, uint16_t *index_ret)
+{
+    hid_report_map_t *map = parser->map;
+    for (uint16_t i = 0; i < map->report_num; i++) {
+        if (map->reports[i].type == type && map->reports[i].id == id) {
+            *index_ret = i;
+            return ESP_OK;
+        }
+    }
+    hid_report_t *reports = realloc(map->reports, (map->report_num + 1) * sizeof(hid_report_t));
+    ESP_RETURN_ON_FALSE(reports, ESP_ERR_NO_MEM, TAG, "Not enough memory for reports");
+    map->reports = reports;
+    memset(&reports[map->report_num], 0, sizeof(hid_report_t));
+    reports[map->report_num].type = type;
+    reports[map->report_num].id = id;
+    parser->report_bits[type - 1][id] = id ? 8 : 0; // Report ID byte precedes the data
+    *index_ret = map->report_num++;
+    return ESP_OK;
+}
+
+static esp_err_t hid_parser_field_add(hid_parser_t *parser, const hid_parser_field_t *field)
+{
+    ESP_RETURN_ON_FALSE(parser->field_num < UINT16_MAX, ESP_ERR_INVALID_RESPONSE, TAG, "Too many fields");
+    if (parser->field_num == parser->field_cap) {
+        const size_t cap = parser->field_cap ? parser->field_cap * 2 : 16;
+        hid_parser_field_t *fields = realloc(parser->fields, cap * sizeof(hid_parser_field_t));
+        ESP_RETURN_ON_FALSE(fields, ESP_ERR_NO_MEM, TAG, "Not enough memory for fields");
+        parser->fields = fields;
+        parser->field_cap = cap;
+    }
+    parser->fields[parser->field_num++] = *field;
+    return ESP_OK;
+}
+
+/**
+ * @brief Get usage of n-th field of a Main item
+ *
+ * Usages from the usage list are assigned first, then the usage range. The last usage applies to the remaining fields.
+ */
+static uint32_t hid_parser_usage_get(const hid_parser_local_t *local, unsigned n)
+{
+    if (n < local->usage_num) {
+        return local->usages[n];
+    }
+    if (local->usage_min_set && local->usage_max_set) {
+        const uint32_t usage = local->usage_min + (n - local->usage_num);
+        return usage <= local->usage_max ? usage : local->usage_max;
+    }
+    return local->usage_num ? local->usages[local->usage_num - 1] : 0;
+}
+
+/**
+ * @brief Add fields of Input, Output or Feature Main item to its report
+ */
+static esp_err_t hid_parser_main_data(hid_parser_t *parser, hid_report_type_t type, uint8_t flags)
+{
+    const hid_parser_global_t *global = &parser->global;
+    const hid_parser_local_t *local = &parser->local;
+    uint16_t report_index;
+    ESP_RETURN_ON_ERROR(hid_parser_report_get(parser, type, global->report_id, &report_index), TAG, );
+
+    uint16_t *report_bits = &parser->report_bits[type - 1][global->report_id];
+    const uint64_t item_bits = (uint64_t)global->report_size * global->report_count;
+    ESP_RETURN_ON_FALSE(*report_bits + item_bits <= HID_PARSER_MAX_BITS, ESP_ERR_INVALID_RESPONSE, TAG, "Report too long");
+
+    // Constant data are padding. Fields larger than 32 bits are not supported, they are skipped
+    if ((flags & HID_FIELD_FLAG_CONSTANT) || global->report_size == 0 || global->report_size > 32) {
+        *report_bits += (uint16_t)item_bits;
+        return ESP_OK;
+    }
+
+    // Logical Maximum is treated as unsigned if Logical Minimum is not negative, devices often declare e.g. 0..255 in one byte
+    const int32_t logical_max = global->logical_min >= 0 ? (int32_t)global->logical_max_raw : global->logical_max;
+    for (uint32_t i = 0; i < global->report_count; i++) {
+        uint32_t usage = hid_parser_usage_get(local, (flags & HID_FIELD_FLAG_VARIABLE) ? i : 0);
+        uint32_t usage_max = (flags & HID_FIELD_FLAG_VARIABLE) ? usage : (local->usage_max_set ? local->usage_max : usage);
+        hid_parser_field_t field = {
+            .field = {
+                .usage_page = (uint16_t)(usage >> 16),
+                .usage = (uint16_t)usage,
+                .usage_max = (uint16_t)usage_max,
+                .bit_offset = *report_bits,
+                .bit_size = (uint8_t)global->report_size,
+                .flags = flags,
+                .logical_min = global->logical_min,
+                .logical_max = logical_max,
+            },
+            .report_index = report_index,
+        };
+        ESP_RETURN_ON_ERROR(hid_parser_field_add(parser, &field), TAG, );
+        *report_bits += global->report_size;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Local usage to extended usage: 4-byte usage contains its usage page, otherwise the current usage page is used
+ */
+static uint32_t hid_parser_usage_extend(const hid_parser_t *parser, uint32_t usage, uint8_t size)
+{
+    return size == 4 ? usage : ((uint32_t)parser->global.usage_page << 16) | (usage & 0xFFFF);
+}
+
+static esp_err_t hid_parser_item(hid_parser_t *parser, uint8_t type, uint8_t tag, const uint8_t *data, uint8_t size)
+{
+    hid_parser_global_t *global = &parser->global;
+    hid_parser_local_t *local = &parser->local;
+    const uint32_t value = hid_item_unsigned(data, size);
+    esp_err_t ret = ESP_OK;
+
+    switch (type) {
+    case HID_ITEM_TYPE_MAIN:
+        switch (tag) {
+        case HID_MAIN_INPUT:
+            ret = hid_parser_main_data(parser, HID_REPORT_TYPE_INPUT, (uint8_t)value);
+            break;
+        case HID_MAIN_OUTPUT:
+            ret = hid_parser_main_data(parser, HID_REPORT_TYPE_OUTPUT, (uint8_t)value);
+            break;
+        case HID_MAIN_FEATURE:
+            ret = hid_parser_main_data(parser, HID_REPORT_TYPE_FEATURE, (uint8_t)value);
+            break;
+        default:
+            break; // Collections group the fields, they do not change the report layout
+        }
+        memset(local, 0, sizeof(hid_parser_local_t));
+        break;
+    case HID_ITEM_TYPE_GLOBAL:
+        switch (tag) {
+        case HID_GLOBAL_USAGE_PAGE:
+            global->usage_page = (uint16_t)value;
+            break;
+        case HID_GLOBAL_LOGICAL_MIN:
+            global->logical_min = hid_item_signed(data, size);
+            break;
+        case HID_GLOBAL_LOGICAL_MAX:
+            global->logical_max = hid_item_signed(data, size);
+            global->logical_max_raw = value;
+            break;
+        case HID_GLOBAL_REPORT_SIZE:
+            global->report_size = value;
+            break;
+        case HID_GLOBAL_REPORT_ID:
+            ESP_RETURN_ON_FALSE(value > 0 && value <= UINT8_MAX, ESP_ERR_INVALID_RESPONSE, TAG, "Invalid Report ID");
+            global->report_id = (uint8_t)value;
+            parser->map->uses_report_id = true;
+            break;
+        case HID_GLOBAL_REPORT_COUNT:
+            global->report_count = value;
+            break;
+        case HID_GLOBAL_PUSH:
+            ESP_RETURN_ON_FALSE(parser->stack_depth < HID_PARSER_STACK_DEPTH, ESP_ERR_INVALID_RESPONSE, TAG, "Global stack overflow");
+            parser->stack[parser->stack_depth++] = *global;
+            break;
+        case HID_GLOBAL_POP:
+            ESP_RETURN_ON_FALSE(parser->stack_depth > 0, ESP_ERR_INVALID_RESPONSE, TAG, "Global stack underflow");
+            *global = parser->stack[--parser->stack_depth];
+            break;
+        default:
+            break; // Physical range and units do not change the report layout
+        }
+        break;
+    case HID_ITEM_TYPE_LOCAL:
+        switch (tag) {
+        case HID_LOCAL_USAGE:
+            if (local->usage_num < HID_PARSER_MAX_USAGES) {
+                local->usages[local->usage_num++] = hid_parser_usage_extend(parser, value, size);
+            }
+            break;
+        case HID_LOCAL_USAGE_MIN:
+            local->usage_min = hid_parser_usage_extend(parser, value, size);
+            local->usage_min_set = true;
+            break;
+        case HID_LOCAL_USAGE_MAX:
+            local->usage_max = hid_parser_usage_extend(parser, value, size);
+            local->usage_max_set = true;
+            break;
+        default:
+            break;
+        }
+        break;
+    default:
+        break; // Reserved item type
+    }
+    return ret;
+}
+
+/**
+ * @brief Move the parsed fields to the map, so the fields of each report follow each other
+ */
+static esp_err_t hid_parser_finish(hid_parser_t *parser)
+{
+    hid_report_map_t *map = parser->map;
+    if (parser->field_num) {
+        map->fields = malloc(parser->field_num * sizeof(hid_report_field_t));
+        ESP_RETURN_ON_FALSE(map->fields, ESP_ERR_NO_MEM, TAG, "Not enough memory for fields");
+    }
+    map->field_num = (uint16_t)parser->field_num;
+
+    size_t pos = 0;
+    for (uint16_t r = 0; r < map->report_num; r++) {
+        hid_report_t *report = &map->reports[r];
+        report->fields = &map->fields[pos];
+        for (size_t i = 0; i < parser->field_num; i++) {
+            if (parser->fields[i].report_index == r) {
+                map->fields[pos++] = parser->fields[i].field;
+                report->field_num++;
+            }
+        }
+        report->len = (parser->report_bits[report->type - 1][report->id] + 7) / 8;
+        if (report->type == HID_REPORT_TYPE_INPUT) {
+            map->input_index[report->id] = r + 1;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t hid_report_map_create(const uint8_t *report_desc, size_t report_desc_len, hid_report_map_t **map_ret)
+{
+    esp_err_t ret = ESP_OK;
+    ESP_RETURN_ON_FALSE(report_desc && report_desc_len && map_ret, ESP_ERR_INVALID_ARG, TAG, "Invalid arguments");
+
+    hid_parser_t *parser = calloc(1, sizeof(hid_parser_t));
+    hid_report_map_t *map = calloc(1, sizeof(hid_report_map_t));
+    ESP_GOTO_ON_FALSE(parser && map, ESP_ERR_NO_MEM, fail, TAG, "Not enough memory for parser");
+    parser->map = map;
+
+    size_t pos = 0;
+    while (pos < report_desc_len) {
+        const uint8_t prefix = report_desc[pos];
+        if (prefix == HID_ITEM_LONG) {
+            // Long items are reserved, skip them
+            ESP_GOTO_ON_FALSE(pos + 2 < report_desc_len, ESP_ERR_INVALID_RESPONSE, fail, TAG, "Truncated long item");
+            pos += 3 + report_desc[pos + 1];
+            continue;
+        }
+        const uint8_t size = (prefix & 0x3) == 3 ? 4 : (prefix & 0x3);
+        ESP_GOTO_ON_FALSE(pos + 1 + size <= report_desc_len, ESP_ERR_INVALID_RESPONSE, fail, TAG, "Truncated item at %d", (int)pos);
+        ESP_GOTO_ON_ERROR(hid_parser_item(parser, (prefix >> 2) & 0x3, prefix >> 4, &report_desc[pos + 1], size), fail, TAG, );
+        pos += 1 + size;
+    }
+    ESP_GOTO_ON_ERROR(hid_parser_finish(parser), fail, TAG, );
+    ESP_LOGD(TAG, "Report Descriptor compiled: %d reports, %d fields", map->report_num, map->field_num);
+
+    free(parser->fields);
+    free(parser);
+    *map_ret = map;
+    return ESP_OK;
+
+fail:
+    if (parser) {
+        free(parser->fields);
+    }
+    free(parser);
+    hid_report_map_delete(map);
+    return ret;
+}
+
+void hid_report_map_delete(hid_report_map_t *map)
+{
+    if (map) {
+        free(map->fields);
+        free(map->reports);
+        free(map);
+    }
+}
+
+const hid_report_t *hid_report_map_find(const hid_report_map_t *map, hid_report_type_t type, uint8_t id)
+{
+    if (map == NULL) {
+        return NULL;
+    }
+    for (uint16_t i = 0; i < map->report_num; i++) {
+        if (map->reports[i].type == type && map->reports[i].id == id) {
+            return &map->reports[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,105 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "usb/hid_keyboard.h"
+
+SCENARIO("HID boot keyboard key events")
+{
+    hid_keyboard_state_t state;
+    hid_keyboard_state_reset(&state);
+    hid_keyboard_event_t events[HID_KEYBOARD_EVENTS_MAX];
+
+    GIVEN("No key is pressed") {
+        SECTION("Key press and release") {
+            const uint8_t press[8] = {0, 0, HID_KEY_A, 0, 0, 0, 0, 0};
+            REQUIRE(1 == hid_keyboard_process_report(&state, press, sizeof(press), events));
+            REQUIRE(HID_KEY_A == events[0].key_code);
+            REQUIRE(events[0].pressed);
+            REQUIRE(hid_keyboard_is_pressed(&state, HID_KEY_A));
+
+            // Repeated report does not generate events
+            REQUIRE(0 == hid_keyboard_process_report(&state, press, sizeof(press), events));
+
+            const uint8_t release[8] = {0};
+            REQUIRE(1 == hid_keyboard_process_report(&state, release, sizeof(release), events));
+            REQUIRE(HID_KEY_A == events[0].key_code);
+            REQUIRE_FALSE(events[0].pressed);
+            REQUIRE_FALSE(hid_keyboard_is_pressed(&state, HID_KEY_A));
+        }
+
+        SECTION("Modifiers are reported as keys") {
+            const uint8_t shift_a[8] = {HID_LEFT_SHIFT, 0, HID_KEY_A, 0, 0, 0, 0, 0};
+            REQUIRE(2 == hid_keyboard_process_report(&state, shift_a, sizeof(shift_a), events));
+            REQUIRE(HID_KEY_A == events[0].key_code);
+            REQUIRE(HID_KEYBOARD_MODIFIER_USAGE + 1 == events[1].key_code);
+            REQUIRE(events[1].pressed);
+            REQUIRE(HID_LEFT_SHIFT == events[1].modifier);
+
+            const uint8_t right_gui_a[8] = {HID_RIGHT_GUI, 0, HID_KEY_A, 0, 0, 0, 0, 0};
+            REQUIRE(2 == hid_keyboard_process_report(&state, right_gui_a, sizeof(right_gui_a), events));
+            REQUIRE(HID_KEYBOARD_MODIFIER_USAGE + 1 == events[0].key_code);
+            REQUIRE_FALSE(events[0].pressed);
+            REQUIRE(HID_KEYBOARD_MODIFIER_USAGE + 7 == events[1].key_code);
+            REQUIRE(events[1].pressed);
+            REQUIRE(HID_RIGHT_GUI == events[1].modifier);
+        }
+    }
+
+    GIVEN("Several keys are pressed") {
+        const uint8_t keys[8] = {0, 0, HID_KEY_C, HID_KEY_A, HID_KEY_B, 0, 0, 0};
+        REQUIRE(3 == hid_keyboard_process_report(&state, keys, sizeof(keys), events));
+        REQUIRE(HID_KEY_A == events[0].key_code); // Ascending order of usage, not of the key array
+        REQUIRE(HID_KEY_B == events[1].key_code);
+        REQUIRE(HID_KEY_C == events[2].key_code);
+
+        SECTION("Key order in the array does not matter") {
+            const uint8_t reordered[8] = {0, 0, HID_KEY_B, HID_KEY_C, HID_KEY_A, 0, 0, 0};
+            REQUIRE(0 == hid_keyboard_process_report(&state, reordered, sizeof(reordered), events));
+        }
+
+        SECTION("Released keys are reported before pressed keys") {
+            const uint8_t changed[8] = {0, 0, HID_KEY_ENTER, HID_KEY_A, 0, 0, 0, 0};
+            REQUIRE(3 == hid_keyboard_process_report(&state, changed, sizeof(changed), events));
+            REQUIRE(HID_KEY_B == events[0].key_code);
+            REQUIRE_FALSE(events[0].pressed);
+            REQUIRE(HID_KEY_C == events[1].key_code);
+            REQUIRE_FALSE(events[1].pressed);
+            REQUIRE(HID_KEY_ENTER == events[2].key_code);
+            REQUIRE(events[2].pressed);
+        }
+
+        SECTION("Phantom state keeps the pressed keys") {
+            const uint8_t phantom[8] = {0, 0, HID_KEY_ROLLOVER, HID_KEY_ROLLOVER, HID_KEY_ROLLOVER,
+                                        HID_KEY_ROLLOVER, HID_KEY_ROLLOVER, HID_KEY_ROLLOVER
+                                       };
+            REQUIRE(0 == hid_keyboard_process_report(&state, phantom, sizeof(phantom), events));
+            REQUIRE(hid_keyboard_is_pressed(&state, HID_KEY_A));
+            REQUIRE(hid_keyboard_is_pressed(&state, HID_KEY_B));
+            REQUIRE(hid_keyboard_is_pressed(&state, HID_KEY_C));
+        }
+    }
+
+    GIVEN("Full reports") {
+        SECTION("All keys and modifiers change") {
+            const uint8_t first[8] = {0x0F, 0, HID_KEY_A, HID_KEY_B, HID_KEY_C, HID_KEY_D, HID_KEY_E, HID_KEY_F};
+            const uint8_t second[8] = {0xF0, 0, HID_KEY_1, HID_KEY_2, HID_KEY_3, HID_KEY_4, HID_KEY_5, HID_KEY_6};
+            REQUIRE(10 == hid_keyboard_process_report(&state, first, sizeof(first), events));
+            REQUIRE(20 == hid_keyboard_process_report(&state, second, sizeof(second), events));
+            for (int i = 0; i < 10; i++) {
+                REQUIRE_FALSE(events[i].pressed);
+                REQUIRE(events[i + 10].pressed);
+            }
+        }
+
+        SECTION("Short reports") {
+            const uint8_t short_report[3] = {0, 0, HID_KEY_Z};
+            REQUIRE(1 == hid_keyboard_process_report(&state, short_report, sizeof(short_report), events));
+            REQUIRE(0 == hid_keyboard_process_report(&state, short_report, 2, events));
+        }
+    }
+}
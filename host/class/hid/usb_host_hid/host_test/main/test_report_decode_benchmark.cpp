@@ -0,0 +1,209 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "usb/hid_report_parser.h"
+
+/**
+ * Input report decode benchmark
+ *
+ * Report Descriptors of real devices are compiled and every input report of each descriptor is decoded repeatedly:
+ * the report is looked up by hid_report_map_get_input() and all its fields are extracted with hid_report_field_get().
+ * Time per decoded report and memory of the compiled Report Descriptor are printed.
+ *
+ * Report Descriptors of other devices can be benchmarked by setting HID_BENCHMARK_DESC environment variable
+ * to a colon separated list of paths to raw Report Descriptors, e.g. /sys/class/hidraw/hidraw0/device/report_descriptor on Linux.
+ */
+
+namespace {
+
+// Keyboard with Report IDs: 1 - Keyboard with LEDs, 2 - Consumer Control, 3 - System Control
+const uint8_t keyboard_desc[] = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0x85, 0x01,
+    0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,
+    0x95, 0x01, 0x75, 0x08, 0x81, 0x01,
+    0x95, 0x05, 0x75, 0x01, 0x05, 0x08, 0x19, 0x01, 0x29, 0x05, 0x91, 0x02,
+    0x95, 0x01, 0x75, 0x03, 0x91, 0x01,
+    0x95, 0x06, 0x75, 0x08, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x05, 0x07, 0x19, 0x00, 0x2A, 0xFF, 0x00, 0x81, 0x00,
+    0xC0,
+    0x05, 0x0C, 0x09, 0x01, 0xA1, 0x01, 0x85, 0x02,
+    0x15, 0x00, 0x26, 0xFF, 0x03, 0x19, 0x00, 0x2A, 0xFF, 0x03, 0x75, 0x10, 0x95, 0x02, 0x81, 0x00,
+    0xC0,
+    0x05, 0x01, 0x09, 0x80, 0xA1, 0x01, 0x85, 0x03,
+    0x19, 0x81, 0x29, 0x83, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x03, 0x81, 0x02,
+    0x95, 0x05, 0x81, 0x01,
+    0xC0
+};
+
+// Gaming mouse: 16 buttons, 16-bit X and Y, wheel and AC Pan
+const uint8_t mouse_desc[] = {
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x09, 0x01, 0xA1, 0x00,
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x10, 0x15, 0x00, 0x25, 0x01, 0x95, 0x10, 0x75, 0x01, 0x81, 0x02,
+    0x05, 0x01, 0x16, 0x01, 0x80, 0x26, 0xFF, 0x7F, 0x75, 0x10, 0x95, 0x02, 0x09, 0x30, 0x09, 0x31, 0x81, 0x06,
+    0x15, 0x81, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x01, 0x09, 0x38, 0x81, 0x06,
+    0x05, 0x0C, 0x0A, 0x38, 0x02, 0x95, 0x01, 0x81, 0x06,
+    0xC0, 0xC0
+};
+
+// Gamepad: 4 sticks axes, hat switch, 14 buttons, report counter, 2 triggers and 54 bytes of vendor data (motion sensors, touchpad)
+const uint8_t gamepad_desc[] = {
+    0x05, 0x01, 0x09, 0x05, 0xA1, 0x01, 0x85, 0x01,
+    0x09, 0x30, 0x09, 0x31, 0x09, 0x32, 0x09, 0x35, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x04, 0x81, 0x02,
+    0x09, 0x39, 0x15, 0x00, 0x25, 0x07, 0x35, 0x00, 0x46, 0x3B, 0x01, 0x65, 0x14, 0x75, 0x04, 0x95, 0x01, 0x81, 0x42,
+    0x65, 0x00, 0x05, 0x09, 0x19, 0x01, 0x29, 0x0E, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x0E, 0x81, 0x02,
+    0x06, 0x00, 0xFF, 0x09, 0x20, 0x75, 0x06, 0x95, 0x01, 0x15, 0x00, 0x25, 0x7F, 0x81, 0x02,
+    0x05, 0x01, 0x09, 0x33, 0x09, 0x34, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x02, 0x81, 0x02,
+    0x06, 0x00, 0xFF, 0x09, 0x21, 0x95, 0x36, 0x81, 0x02,
+    0xC0
+};
+
+// Digitizer: 2 - Pen with pressure and tilt, 3 - Touch screen with 2 contacts, 4 - Contact Count Maximum feature
+const uint8_t digitizer_desc[] = {
+    0x05, 0x0D, 0x09, 0x02, 0xA1, 0x01, 0x85, 0x02, 0x09, 0x20, 0xA1, 0x00,
+    0x09, 0x42, 0x09, 0x44, 0x09, 0x45, 0x09, 0x3C, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x04, 0x81, 0x02,
+    0x95, 0x01, 0x81, 0x03,
+    0x09, 0x32, 0x81, 0x02,
+    0x95, 0x02, 0x81, 0x03,
+    0x05, 0x01, 0x09, 0x30, 0x26, 0xFF, 0x7F, 0x35, 0x00, 0x46, 0xD0, 0x3E, 0x65, 0x11, 0x55, 0x0D, 0x75, 0x10, 0x95, 0x01, 0x81, 0x02,
+    0x09, 0x31, 0x46, 0x58, 0x29, 0x81, 0x02,
+    0x05, 0x0D, 0x09, 0x30, 0x26, 0xFF, 0x0F, 0x45, 0x00, 0x65, 0x00, 0x55, 0x00, 0x81, 0x02,
+    0x09, 0x3D, 0x09, 0x3E, 0x15, 0xC4, 0x25, 0x3C, 0x75, 0x08, 0x95, 0x02, 0x81, 0x02,
+    0xC0, 0xC0,
+    0x05, 0x0D, 0x09, 0x04, 0xA1, 0x01, 0x85, 0x03,
+    0x09, 0x22, 0xA1, 0x02,
+    0x09, 0x42, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x01, 0x81, 0x02,
+    0x95, 0x07, 0x81, 0x03,
+    0x09, 0x51, 0x75, 0x08, 0x95, 0x01, 0x25, 0x7F, 0x81, 0x02,
+    0x05, 0x01, 0x26, 0xFF, 0x7F, 0x75, 0x10, 0x09, 0x30, 0x09, 0x31, 0x95, 0x02, 0x81, 0x02,
+    0xC0,
+    0x05, 0x0D, 0x09, 0x22, 0xA1, 0x02,
+    0x09, 0x42, 0x25, 0x01, 0x75, 0x01, 0x95, 0x01, 0x81, 0x02,
+    0x95, 0x07, 0x81, 0x03,
+    0x09, 0x51, 0x75, 0x08, 0x95, 0x01, 0x25, 0x7F, 0x81, 0x02,
+    0x05, 0x01, 0x26, 0xFF, 0x7F, 0x75, 0x10, 0x09, 0x30, 0x09, 0x31, 0x95, 0x02, 0x81, 0x02,
+    0xC0,
+    0x05, 0x0D, 0x09, 0x54, 0x25, 0x7F, 0x75, 0x08, 0x95, 0x01, 0x81, 0x02,
+    0x85, 0x04, 0x09, 0x55, 0x25, 0x0A, 0xB1, 0x02,
+    0xC0
+};
+
+constexpr int benchmark_iterations = 200000;
+
+/**
+ * @brief Memory allocated by hid_report_map_create() for the compiled Report Descriptor
+ */
+size_t report_map_size(const hid_report_map_t *map)
+{
+    return sizeof(hid_report_map_t) + map->report_num * sizeof(hid_report_t) + map->field_num * sizeof(hid_report_field_t);
+}
+
+/**
+ * @brief Compile the Report Descriptor and decode all its input reports
+ *
+ * @return Number of decoded input reports per iteration
+ */
+int benchmark_descriptor(const char *name, const uint8_t *desc, size_t desc_len)
+{
+    hid_report_map_t *map = nullptr;
+    const auto compile_start = std::chrono::steady_clock::now();
+    REQUIRE(ESP_OK == hid_report_map_create(desc, desc_len, &map));
+    const auto compile_stop = std::chrono::steady_clock::now();
+
+    // One report with pseudo-random content for each input report of the descriptor
+    std::vector<std::vector<uint8_t>> reports;
+    size_t fields = 0;
+    uint32_t seed = 1;
+    for (uint16_t i = 0; i < map->report_num; i++) {
+        const hid_report_t *report = &map->reports[i];
+        if (report->type != HID_REPORT_TYPE_INPUT) {
+            continue;
+        }
+        std::vector<uint8_t> data(report->len);
+        for (auto &byte : data) {
+            seed = seed * 1103515245 + 12345;
+            byte = static_cast<uint8_t>(seed >> 16);
+        }
+        if (map->uses_report_id) {
+            data[0] = report->id;
+        }
+        fields += report->field_num;
+        reports.push_back(std::move(data));
+    }
+    REQUIRE_FALSE(reports.empty());
+
+    volatile int32_t sink = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int iteration = 0; iteration < benchmark_iterations; iteration++) {
+        for (const auto &data : reports) {
+            const hid_report_t *report = hid_report_map_get_input(map, data.data(), data.size());
+            int32_t sum = 0;
+            for (uint16_t f = 0; f < report->field_num; f++) {
+                sum += hid_report_field_get(&report->fields[f], data.data());
+            }
+            sink = sink + sum;
+        }
+    }
+    const auto stop = std::chrono::steady_clock::now();
+
+    const double seconds = std::chrono::duration<double>(stop - start).count();
+    const double decoded = static_cast<double>(benchmark_iterations) * reports.size();
+    printf("%s: %.1f ns/report, %.2f ns/field, %zu input reports, %u fields, compile %.1f us, map %zu bytes (descriptor %zu bytes)\n",
+           name,
+           seconds * 1e9 / decoded,
+           fields ? seconds * 1e9 / (decoded * fields / reports.size()) : 0.0,
+           reports.size(),
+           map->field_num,
+           std::chrono::duration<double>(compile_stop - compile_start).count() * 1e6,
+           report_map_size(map),
+           desc_len);
+    hid_report_map_delete(map);
+    return static_cast<int>(reports.size());
+}
+
+} // namespace
+
+TEST_CASE("Report decode benchmark", "[.][benchmark]")
+{
+    SECTION("Keyboard with Consumer and System Control") {
+        REQUIRE(3 == benchmark_descriptor("Keyboard", keyboard_desc, sizeof(keyboard_desc)));
+    }
+
+    SECTION("Gaming mouse") {
+        REQUIRE(1 == benchmark_descriptor("Mouse", mouse_desc, sizeof(mouse_desc)));
+    }
+
+    SECTION("Gamepad") {
+        REQUIRE(1 == benchmark_descriptor("Gamepad", gamepad_desc, sizeof(gamepad_desc)));
+    }
+
+    SECTION("Pen and touch digitizer") {
+        REQUIRE(2 == benchmark_descriptor("Digitizer", digitizer_desc, sizeof(digitizer_desc)));
+    }
+
+    SECTION("Report Descriptors from files") {
+        const char *paths = getenv("HID_BENCHMARK_DESC");
+        if (paths == nullptr) {
+            SKIP("HID_BENCHMARK_DESC is not set");
+        }
+        std::stringstream list(paths);
+        std::string path;
+        while (std::getline(list, path, ':')) {
+            std::ifstream file(path, std::ios::binary);
+            REQUIRE(file.good());
+            const std::vector<uint8_t> desc((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            benchmark_descriptor(path.c_str(), desc.data(), desc.size());
+        }
+    }
+}
@@ -0,0 +1,148 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "usb/hid_report_parser.h"
+
+// Boot mouse: 3 buttons, 5 bits padding, X, Y relative 8-bit signed
+static const uint8_t mouse_desc[] = {
+    0x05, 0x01, 0x09, 0x02, 0xA1, 0x01, 0x09, 0x01, 0xA1, 0x00,
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x03, 0x15, 0x00, 0x25, 0x01,
+    0x95, 0x03, 0x75, 0x01, 0x81, 0x02,     // Input (Data, Var, Abs): buttons
+    0x95, 0x01, 0x75, 0x05, 0x81, 0x03,     // Input (Const): padding
+    0x05, 0x01, 0x09, 0x30, 0x09, 0x31, 0x15, 0x81, 0x25, 0x7F,
+    0x75, 0x08, 0x95, 0x02, 0x81, 0x06,     // Input (Data, Var, Rel): X, Y
+    0xC0, 0xC0
+};
+
+// Boot keyboard: 8 modifier bits, reserved byte, 6 key array, 5 LEDs output
+static const uint8_t keyboard_desc[] = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01,
+    0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01,
+    0x75, 0x01, 0x95, 0x08, 0x81, 0x02,     // Input: modifiers
+    0x95, 0x01, 0x75, 0x08, 0x81, 0x01,     // Input (Const): reserved
+    0x95, 0x05, 0x75, 0x01, 0x05, 0x08, 0x19, 0x01, 0x29, 0x05,
+    0x91, 0x02,                             // Output: LEDs
+    0x95, 0x01, 0x75, 0x03, 0x91, 0x01,     // Output (Const): padding
+    0x95, 0x06, 0x75, 0x08, 0x15, 0x00, 0x26, 0xFF, 0x00,
+    0x05, 0x07, 0x19, 0x00, 0x29, 0xFF,
+    0x81, 0x00,                             // Input (Data, Array): keys
+    0xC0
+};
+
+// Two input reports with Report ID: 1 - 16-bit unsigned value, 2 - 12-bit signed value crossing byte boundary
+static const uint8_t report_id_desc[] = {
+    0x06, 0x00, 0xFF, 0x09, 0x01, 0xA1, 0x01,
+    0x85, 0x01, 0x09, 0x02, 0x15, 0x00, 0x27, 0xFF, 0xFF, 0x00, 0x00,
+    0x75, 0x10, 0x95, 0x01, 0x81, 0x02,
+    0x85, 0x02, 0x09, 0x03, 0x75, 0x04, 0x95, 0x01, 0x81, 0x03,
+    0x16, 0x00, 0xF8, 0x26, 0xFF, 0x07, 0x75, 0x0C, 0x95, 0x01, 0x81, 0x02,
+    0xC0
+};
+
+SCENARIO("HID Report Descriptor parser")
+{
+    hid_report_map_t *map = nullptr;
+
+    GIVEN("Boot mouse Report Descriptor") {
+        REQUIRE(ESP_OK == hid_report_map_create(mouse_desc, sizeof(mouse_desc), &map));
+        REQUIRE_FALSE(map->uses_report_id);
+        REQUIRE(1 == map->report_num);
+        // Padding does not create a field
+        REQUIRE(5 == map->field_num);
+
+        const uint8_t data[] = {0x05, 0xFE, 0x03};
+        const hid_report_t *report = hid_report_map_get_input(map, data, sizeof(data));
+        REQUIRE(report != nullptr);
+        REQUIRE(3 == report->len);
+        REQUIRE(0x09 == report->fields[0].usage_page);
+        REQUIRE(1 == hid_report_field_get(&report->fields[0], data));
+        REQUIRE(0 == hid_report_field_get(&report->fields[1], data));
+        REQUIRE(1 == hid_report_field_get(&report->fields[2], data));
+        REQUIRE(0x30 == report->fields[3].usage);
+        REQUIRE(report->fields[3].flags & HID_FIELD_FLAG_RELATIVE);
+        REQUIRE(-2 == hid_report_field_get(&report->fields[3], data));
+        REQUIRE(3 == hid_report_field_get(&report->fields[4], data));
+
+        SECTION("Short report is rejected") {
+            REQUIRE(nullptr == hid_report_map_get_input(map, data, 2));
+        }
+        hid_report_map_delete(map);
+    }
+
+    GIVEN("Boot keyboard Report Descriptor") {
+        REQUIRE(ESP_OK == hid_report_map_create(keyboard_desc, sizeof(keyboard_desc), &map));
+
+        const hid_report_t *input = hid_report_map_find(map, HID_REPORT_TYPE_INPUT, 0);
+        REQUIRE(input != nullptr);
+        REQUIRE(8 == input->len);
+        REQUIRE(14 == input->field_num);
+        const hid_report_field_t *key = &input->fields[8];
+        REQUIRE(16 == key->bit_offset);
+        REQUIRE_FALSE(key->flags & HID_FIELD_FLAG_VARIABLE);
+        REQUIRE(0 == key->usage);
+        REQUIRE(0xFF == key->usage_max);
+        REQUIRE(255 == key->logical_max);
+
+        const uint8_t data[] = {0x02, 0x00, 0x04, 0xFF, 0x00, 0x00, 0x00, 0x00};
+        REQUIRE(1 == hid_report_field_get(&input->fields[1], data));
+        REQUIRE(4 == hid_report_field_get(&input->fields[8], data));
+        // Unsigned field is not sign extended
+        REQUIRE(255 == hid_report_field_get(&input->fields[9], data));
+
+        const hid_report_t *output = hid_report_map_find(map, HID_REPORT_TYPE_OUTPUT, 0);
+        REQUIRE(output != nullptr);
+        REQUIRE(1 == output->len);
+        REQUIRE(5 == output->field_num);
+        REQUIRE(nullptr == hid_report_map_find(map, HID_REPORT_TYPE_FEATURE, 0));
+        hid_report_map_delete(map);
+    }
+
+    GIVEN("Report Descriptor with Report IDs") {
+        REQUIRE(ESP_OK == hid_report_map_create(report_id_desc, sizeof(report_id_desc), &map));
+        REQUIRE(map->uses_report_id);
+        REQUIRE(2 == map->report_num);
+
+        const uint8_t data1[] = {0x01, 0x34, 0x12};
+        const hid_report_t *report = hid_report_map_get_input(map, data1, sizeof(data1));
+        REQUIRE(report != nullptr);
+        REQUIRE(1 == report->id);
+        REQUIRE(8 == report->fields[0].bit_offset);
+        REQUIRE(0x1234 == hid_report_field_get(&report->fields[0], data1));
+
+        // 12-bit value -2 (0xFFE) at bit offset 12
+        const uint8_t data2[] = {0x02, 0xE0, 0xFF};
+        report = hid_report_map_get_input(map, data2, sizeof(data2));
+        REQUIRE(report != nullptr);
+        REQUIRE(2 == report->id);
+        REQUIRE(12 == report->fields[0].bit_offset);
+        REQUIRE(-2 == hid_report_field_get(&report->fields[0], data2));
+
+        SECTION("Unknown Report ID") {
+            const uint8_t data3[] = {0x03, 0x00, 0x00};
+            REQUIRE(nullptr == hid_report_map_get_input(map, data3, sizeof(data3)));
+        }
+        hid_report_map_delete(map);
+    }
+
+    GIVEN("Malformed Report Descriptor") {
+        SECTION("Truncated item") {
+            const uint8_t desc[] = {0x05, 0x01, 0x26, 0xFF};
+            REQUIRE(ESP_ERR_INVALID_RESPONSE == hid_report_map_create(desc, sizeof(desc), &map));
+        }
+
+        SECTION("Pop without push") {
+            const uint8_t desc[] = {0x05, 0x01, 0xB4};
+            REQUIRE(ESP_ERR_INVALID_RESPONSE == hid_report_map_create(desc, sizeof(desc), &map));
+        }
+
+        SECTION("Invalid arguments") {
+            REQUIRE(ESP_ERR_INVALID_ARG == hid_report_map_create(nullptr, 0, &map));
+            REQUIRE(ESP_ERR_INVALID_ARG == hid_report_map_create(mouse_desc, sizeof(mouse_desc), nullptr));
+        }
+    }
+}
@@ -64,6 +64,13 @@ SCENARIO("HID Host install")
     GIVEN("Full HID Host config, driver not already installed") {
         int mtx;
 
+        SECTION("Config error: negative number of control transfers") {
+            hid_host_driver_config.low_memory = true;
+            hid_host_driver_config.ctrl_transfers_num = -1;
+            // Call the DUT function, expect ESP_ERR_INVALID_ARG
+            REQUIRE(ESP_ERR_INVALID_ARG == hid_host_install(&hid_host_driver_config));
+        }
+
         // Install error: failed to create semaphore
         SECTION("Install error: unable to create semaphore") {
             // We must call xQueueGenericCreate_ExpectAnyArgsAndReturn instead of xSemaphoreCreateBinary_ExpectAnyArgsAndReturn
@@ -143,3 +150,71 @@ SCENARIO("HID Host install")
         }
     }
 }
+
+SCENARIO("HID Host Report Descriptor cache")
+{
+    GIVEN("Report Descriptor cache disabled") {
+        uint8_t blob[16] = {0x52, 0x44, 0x43, 0x31};
+        size_t blob_len = sizeof(blob);
+
+        SECTION("Export error: blob_len is nullptr") {
+            REQUIRE(ESP_ERR_INVALID_ARG == hid_host_report_desc_cache_export(blob, nullptr));
+        }
+
+        SECTION("Export error: cache is disabled") {
+            vPortEnterCritical_Expect();
+            vPortExitCritical_Expect();
+            REQUIRE(ESP_ERR_INVALID_STATE == hid_host_report_desc_cache_export(blob, &blob_len));
+        }
+
+        SECTION("Import error: blob is nullptr") {
+            REQUIRE(ESP_ERR_INVALID_ARG == hid_host_report_desc_cache_import(nullptr, blob_len));
+        }
+
+        SECTION("Import error: cache is disabled") {
+            REQUIRE(ESP_ERR_INVALID_STATE == hid_host_report_desc_cache_import(blob, blob_len));
+        }
+
+        SECTION("Clear error: cache is disabled") {
+            vPortEnterCritical_Expect();
+            vPortExitCritical_Expect();
+            REQUIRE(ESP_ERR_INVALID_STATE == hid_host_report_desc_cache_clear());
+        }
+    }
+}
+
+SCENARIO("HID Host event multiplexer")
+{
+    GIVEN("No multiplexer") {
+        hid_host_mux_config_t mux_config = {
+            .queue_len = 8,
+            .report_size = 0,
+        };
+        hid_host_mux_handle_t mux = nullptr;
+
+        SECTION("Create error: config is nullptr") {
+            REQUIRE(ESP_ERR_INVALID_ARG == hid_host_mux_create(nullptr, &mux));
+        }
+
+        SECTION("Create error: queue length is 0") {
+            mux_config.queue_len = 0;
+            REQUIRE(ESP_ERR_INVALID_ARG == hid_host_mux_create(&mux_config, &mux));
+        }
+
+        SECTION("Create error: unable to create semaphore") {
+            xQueueGenericCreate_ExpectAnyArgsAndReturn(nullptr);
+            REQUIRE(ESP_ERR_NO_MEM == hid_host_mux_create(&mux_config, &mux));
+            REQUIRE(nullptr == mux);
+        }
+
+        SECTION("Wait error: mux is nullptr") {
+            hid_host_mux_event_t events[4];
+            size_t events_num;
+            REQUIRE(ESP_ERR_INVALID_ARG == hid_host_mux_wait(nullptr, events, 4, &events_num, 0));
+        }
+
+        SECTION("Overruns of nullptr mux") {
+            REQUIRE(0 == hid_host_mux_get_overruns(nullptr));
+        }
+    }
+}
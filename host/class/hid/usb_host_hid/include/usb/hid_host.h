@@ -12,6 +12,8 @@
 #include <freertos/FreeRTOS.h>
 
 #include "hid.h"
+#include "hid_report_parser.h"
+#include "hid_keyboard.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -31,6 +33,8 @@ extern "C" {
 
 typedef struct hid_interface *hid_host_device_handle_t;    /**< Device Handle. Handle to a particular HID interface */
 
+typedef struct hid_host_mux *hid_host_mux_handle_t;        /**< Event multiplexer Handle. Input reports of several HID interfaces */
+
 // ------------------------ USB HID Host events --------------------------------
 /**
  * @brief USB HID HOST Device event id
@@ -93,6 +97,56 @@ typedef void (*hid_host_interface_event_cb_t)(hid_host_device_handle_t hid_devic
         const hid_host_interface_event_t event,
         void *arg);
 
+/**
+ * @brief Input report callback of one Report ID.
+ *
+ * Called from the USB Host client task context.
+ *
+ * @param[in] hid_device_handle     HID device handle (HID Interface)
+ * @param[in] data                  Input report, including Report ID byte if the device uses Report IDs
+ * @param[in] data_len              Length of the input report
+ * @param[in] arg                   User argument
+*/
+typedef void (*hid_host_report_cb_t)(hid_host_device_handle_t hid_device_handle,
+                                     const uint8_t *data,
+                                     size_t data_len,
+                                     void *arg);
+
+/**
+ * @brief Keyboard key events callback.
+ *
+ * Called from the USB Host client task context, once per input report that changed the pressed keys.
+ *
+ * @param[in] hid_device_handle     HID device handle (HID Interface)
+ * @param[in] events                Key events of the report, released keys first
+ * @param[in] event_num             Number of key events
+ * @param[in] state                 Keyboard state after the report
+ * @param[in] arg                   User argument
+*/
+typedef void (*hid_host_keyboard_cb_t)(hid_host_device_handle_t hid_device_handle,
+                                       const hid_keyboard_event_t *events,
+                                       size_t event_num,
+                                       const hid_keyboard_state_t *state,
+                                       void *arg);
+
+/**
+ * @brief Asynchronous class request completion callback.
+ *
+ * Called from the USB Host client task context, do not block in it.
+ *
+ * @param[in] hid_device_handle     HID device handle (HID Interface)
+ * @param[in] ret                   Result of the request: ESP_OK, ESP_ERR_NOT_SUPPORTED if the device stalled the request,
+ *                                  ESP_ERR_INVALID_STATE if the device was disconnected, other errors on transfer failure
+ * @param[in] data                  Received data of GET request, NULL for SET request or on failure
+ * @param[in] data_len              Length of received data
+ * @param[in] arg                   User argument
+*/
+typedef void (*hid_host_request_cb_t)(hid_host_device_handle_t hid_device_handle,
+                                      esp_err_t ret,
+                                      const uint8_t *data,
+                                      size_t data_len,
+                                      void *arg);
+
 // ----------------------------- Public ---------------------------------------
 /**
  * @brief HID configuration structure.
@@ -105,6 +159,14 @@ typedef struct {
     BaseType_t core_id;                     /**< Select core on which background task will run or tskNO_AFFINITY  */
     hid_host_driver_event_cb_t callback;    /**< Callback invoked when HID driver event occurs. Must not be NULL. */
     void *callback_arg;                     /**< User provided argument passed to callback */
+    size_t report_desc_cache_size;          /**< Number of Report Descriptors cached by VID, PID, bcdDevice and interface number.
+                                                 Reconnected devices do not request the Report Descriptor again. 0: Cache is disabled */
+    bool shared_client;                     /**< Register to the client of usb_host_shared_client component instead of an own USB Host client.
+                                                 Its task handles the events, so no background task is created and hid_host_handle_events is not used */
+    bool low_memory;                        /**< Low-memory mode for many HID devices: control transfers are shared by all devices,
+                                                 Report Descriptors are compiled on hid_host_device_open() and freed after compiling,
+                                                 input report buffers are sized to the largest input report */
+    int ctrl_transfers_num;                 /**< Number of control transfers shared by all devices in low-memory mode. 0: Default number of 2 */
 } hid_host_driver_config_t;
 
 /**
@@ -113,8 +175,79 @@ typedef struct {
 typedef struct {
     hid_host_interface_event_cb_t callback;     /**< Callback invoked when HID Interface event occurs */
     void *callback_arg;                         /**< User provided argument passed to callback */
+    int in_transfers_num;                       /**< Number of interrupt IN transfers queued at once, so reports are received
+                                                     while the callback runs. 0: Single IN transfer */
+    size_t report_queue_len;                    /**< Number of input reports kept in the report queue for hid_host_device_get_reports().
+                                                     0: Report queue is not used */
+    int out_transfers_num;                      /**< Number of interrupt OUT transfers for hid_host_device_send_output_report(),
+                                                     used only if the interface has an OUT endpoint. 0: Default number of 2 */
+    bool latest_reports;                        /**< Keep only the latest input report per Report ID for hid_host_device_get_latest_report(),
+                                                     instead of HID_HOST_INTERFACE_EVENT_INPUT_REPORT callback per report */
 } hid_host_device_config_t;
 
+/**
+ * @brief Input report from the report queue
+ */
+typedef struct {
+    int64_t timestamp_us;                       /**< Time of reception in microseconds, esp_timer_get_time() */
+    size_t len;                                 /**< Length of the report */
+    const uint8_t *data;                        /**< Report data, valid until released by hid_host_device_release_reports() */
+} hid_host_report_t;
+
+/**
+ * @brief Information of the latest input report
+ */
+typedef struct {
+    int64_t timestamp_us;                       /**< Time of reception in microseconds, esp_timer_get_time() */
+    size_t len;                                 /**< Length of the copied report */
+    uint32_t new_reports;                       /**< Number of reports received since the previous read of the Report ID.
+                                                     0: Same report as the previous read, more than 1: Reports were coalesced */
+} hid_host_latest_report_info_t;
+
+/**
+ * @brief Event multiplexer configuration structure
+ */
+typedef struct {
+    size_t queue_len;                           /**< Number of input reports of all interfaces kept in the multiplexer */
+    size_t report_size;                         /**< Maximum size of one report, longer reports are truncated. 0: 64 bytes */
+} hid_host_mux_config_t;
+
+/**
+ * @brief Input report of an interface of the event multiplexer
+ */
+typedef struct {
+    hid_host_device_handle_t hid_device_handle; /**< Interface of the report. It may have been closed after the report was queued */
+    hid_host_report_t report;                   /**< Input report, valid until released by hid_host_mux_release() */
+} hid_host_mux_event_t;
+
+// Number of buckets in time histograms of hid_host_stats_t
+#define HID_HOST_STATS_HIST_BUCKETS    (8)
+
+/**
+ * @brief HID Interface input report statistics
+ *
+ * The counters are accumulated since the device was opened or since last hid_host_device_reset_stats() call.
+ * Devices NAK the polls when there is nothing to report, so late reports and missed polls are meaningful
+ * for devices that report continuously.
+ */
+typedef struct {
+    uint32_t poll_interval_us;                  /**< Polling interval requested by bInterval of the interrupt IN endpoint */
+    uint32_t reports;                           /**< Number of received input reports */
+    int64_t last_report_us;                     /**< Time of the last received report, esp_timer_get_time() */
+    uint64_t interval_sum_us;                   /**< Sum of intervals between reports, average is interval_sum_us / (reports - 1) */
+    uint32_t interval_min_us;                   /**< Shortest interval between reports */
+    uint32_t interval_max_us;                   /**< Longest interval between reports */
+    uint32_t late_reports;                      /**< Number of reports received later than 1.5 polling interval after the previous one */
+    uint32_t missed_polls;                      /**< Number of polling intervals without report before the late reports */
+    uint32_t transfer_errors;                   /**< Number of failed interrupt IN transfers */
+    uint32_t interval_histogram[HID_HOST_STATS_HIST_BUCKETS];      /**< Histogram of intervals between reports.
+                                                                        Bucket 0: < 125 us, bucket i: <125 * 2^(i-1); 125 * 2^i) us, last bucket: >= 8 ms */
+    uint32_t callback_histogram[HID_HOST_STATS_HIST_BUCKETS];      /**< Histogram of HID_HOST_INTERFACE_EVENT_INPUT_REPORT callback duration.
+                                                                        Bucket 0: < 16 us, bucket i: <16 * 2^(i-1); 16 * 2^i) us, last bucket: >= 1024 us */
+    uint32_t queue_latency_histogram[HID_HOST_STATS_HIST_BUCKETS]; /**< Histogram of time from reception to hid_host_device_get_reports() of the oldest returned report.
+                                                                        Bucket 0: < 16 us, bucket i: <16 * 2^(i-1); 16 * 2^i) us, last bucket: >= 1024 us */
+} hid_host_stats_t;
+
 /**
  * @brief USB HID Host install USB Host HID Class driver
  *
@@ -174,6 +307,8 @@ esp_err_t hid_host_device_get_params(hid_host_device_handle_t hid_dev_handle,
  *
  * This functions should be called after HID Interface device event HID_HOST_INTERFACE_EVENT_INPUT_REPORT
  * to get the actual raw data of input report.
+ * The data are valid only during the event callback, the transfer is queued again after the callback returns.
+ * Use hid_host_device_get_reports() to read reports from another task.
  *
  * @param[in] hid_dev_handle    HID Device handle
  * @param[in] data              Pointer to buffer where the input data will be copied
@@ -187,6 +322,311 @@ esp_err_t hid_host_device_get_raw_input_report_data(hid_host_device_handle_t hid
         size_t data_length_max,
         size_t *data_length);
 
+/**
+ * @brief HID Host get queued input reports
+ *
+ * Reports are queued in order of reception if the device was opened with report_queue_len > 0.
+ * The queue is lock-free for one reading task: the reports stay in the queue until
+ * hid_host_device_release_reports() is called, then their slots are reused for new reports.
+ * If the queue is full, new reports are dropped and counted by hid_host_device_get_report_overruns().
+ *
+ * @param[in]  hid_dev_handle    HID Device handle
+ * @param[out] reports           Array filled with the oldest queued reports
+ * @param[in]  reports_max       Size of the reports array
+ * @param[out] reports_num       Number of reports filled
+ * @param[in]  timeout_ms        Time to wait for a report if the queue is empty, 0: do not wait
+ *
+ * @return
+ *    - ESP_OK: At least one report returned
+ *    - ESP_ERR_TIMEOUT: No report received within the timeout
+ *    - ESP_ERR_INVALID_STATE: Report queue is not configured
+ */
+esp_err_t hid_host_device_get_reports(hid_host_device_handle_t hid_dev_handle,
+                                      hid_host_report_t *reports,
+                                      size_t reports_max,
+                                      size_t *reports_num,
+                                      uint32_t timeout_ms);
+
+/**
+ * @brief HID Host release reports returned by hid_host_device_get_reports()
+ *
+ * The oldest reports_num reports are removed from the queue.
+ *
+ * @param[in] hid_dev_handle    HID Device handle
+ * @param[in] reports_num       Number of reports to release
+ *
+ * @return
+ *    - ESP_OK: Reports released
+ *    - ESP_ERR_INVALID_ARG: More reports than queued
+ *    - ESP_ERR_INVALID_STATE: Report queue is not configured
+ */
+esp_err_t hid_host_device_release_reports(hid_host_device_handle_t hid_dev_handle,
+        size_t reports_num);
+
+/**
+ * @brief HID Host get number of input reports dropped because the report queue was full
+ *
+ * @param[in] hid_dev_handle    HID Device handle
+ *
+ * @return Number of dropped reports since the device was opened
+ */
+uint32_t hid_host_device_get_report_overruns(hid_host_device_handle_t hid_dev_handle);
+
+/**
+ * @brief HID Host get the latest input report of a Report ID
+ *
+ * For devices opened with latest_reports, e.g. joysticks or digitizers reporting absolute values faster than the application
+ * consumes them. Each received report overwrites the previous one with the same Report ID in constant time, the reader copies
+ * the newest one whenever it wants. The slot is protected by a sequence lock: the USB Host client task never waits,
+ * the reader retries if the report was overwritten while copying. Only one task may read the reports of one interface.
+ * If the Report Descriptor could not be compiled, the latest report of any Report ID is returned for Report ID 0.
+ *
+ * @param[in]  hid_dev_handle    HID Device handle
+ * @param[in]  report_id         Report ID, 0 if the device does not use Report IDs
+ * @param[out] data              Buffer for the report, including Report ID byte if the device uses Report IDs
+ * @param[in]  data_length_max   Size of the buffer, longer reports are truncated
+ * @param[out] info              Length, time of reception and number of new reports
+ *
+ * @return
+ *    - ESP_OK: The latest report copied
+ *    - ESP_ERR_NOT_FOUND: No such input report or no report received yet
+ *    - ESP_ERR_INVALID_STATE: The device was not opened with latest_reports
+ */
+esp_err_t hid_host_device_get_latest_report(hid_host_device_handle_t hid_dev_handle,
+        uint8_t report_id,
+        uint8_t *data,
+        size_t data_length_max,
+        hid_host_latest_report_info_t *info);
+
+/**
+ * @brief HID Host create event multiplexer
+ *
+ * Input reports of all interfaces added to the multiplexer are queued in order of reception to one lock-free queue.
+ * One task waits on the multiplexer and reads the reports of all interfaces in batches with hid_host_mux_wait(),
+ * instead of a HID_HOST_INTERFACE_EVENT_INPUT_REPORT callback per report. The USB Host client task never waits for the reading task,
+ * it wakes it up only when the first report is put to the empty queue.
+ *
+ * @param[in]  config           Multiplexer configuration
+ * @param[out] mux_hdl_ret      Multiplexer handle
+ *
+ * @return
+ *    - ESP_OK: Multiplexer created
+ *    - ESP_ERR_INVALID_ARG: Invalid argument or queue length is 0
+ *    - ESP_ERR_NO_MEM: Not enough memory
+ */
+esp_err_t hid_host_mux_create(const hid_host_mux_config_t *config, hid_host_mux_handle_t *mux_hdl_ret);
+
+/**
+ * @brief HID Host delete event multiplexer
+ *
+ * @param[in] mux_hdl           Multiplexer handle
+ *
+ * @return
+ *    - ESP_OK: Multiplexer deleted
+ *    - ESP_ERR_INVALID_STATE: An interface was not removed from the multiplexer
+ */
+esp_err_t hid_host_mux_delete(hid_host_mux_handle_t mux_hdl);
+
+/**
+ * @brief HID Host add interface to event multiplexer
+ *
+ * Must be called after hid_host_device_open() and before hid_host_device_start().
+ * Input reports of the interface are queued to the multiplexer instead of HID_HOST_INTERFACE_EVENT_INPUT_REPORT callback.
+ * Reports with registered keyboard or Report ID callback are passed only to that callback.
+ * The interface is removed from the multiplexer when it is closed.
+ *
+ * @param[in] mux_hdl           Multiplexer handle
+ * @param[in] hid_dev_handle    HID Device handle
+ *
+ * @return
+ *    - ESP_OK: Interface added
+ *    - ESP_ERR_INVALID_STATE: The device is not opened, it was started or it is already in a multiplexer
+ */
+esp_err_t hid_host_mux_add(hid_host_mux_handle_t mux_hdl, hid_host_device_handle_t hid_dev_handle);
+
+/**
+ * @brief HID Host remove interface from its event multiplexer
+ *
+ * Must be called when the device is not started. Reports already queued stay in the multiplexer.
+ *
+ * @param[in] hid_dev_handle    HID Device handle
+ *
+ * @return
+ *    - ESP_OK: Interface removed, or it was not in a multiplexer
+ *    - ESP_ERR_INVALID_STATE: The device is started
+ */
+esp_err_t hid_host_mux_remove(hid_host_device_handle_t hid_dev_handle);
+
+/**
+ * @brief HID Host wait for input reports of the event multiplexer
+ *
+ * Only one task may read the multiplexer. The events stay in the multiplexer until hid_host_mux_release() is called.
+ * If the queue is full, new reports are dropped and counted by hid_host_mux_get_overruns().
+ *
+ * @param[in]  mux_hdl          Multiplexer handle
+ * @param[out] events           Array filled with the oldest queued reports and their interfaces
+ * @param[in]  events_max       Size of the events array
+ * @param[out] events_num       Number of events filled
+ * @param[in]  timeout_ms       Time to wait for a report if the multiplexer is empty, 0: do not wait
+ *
+ * @return
+ *    - ESP_OK: At least one event returned
+ *    - ESP_ERR_TIMEOUT: No report received within the timeout
+ */
+esp_err_t hid_host_mux_wait(hid_host_mux_handle_t mux_hdl,
+                            hid_host_mux_event_t *events,
+                            size_t events_max,
+                            size_t *events_num,
+                            uint32_t timeout_ms);
+
+/**
+ * @brief HID Host release events returned by hid_host_mux_wait()
+ *
+ * @param[in] mux_hdl           Multiplexer handle
+ * @param[in] events_num        Number of events to release
+ *
+ * @return
+ *    - ESP_OK: Events released
+ *    - ESP_ERR_INVALID_ARG: More events than queued
+ */
+esp_err_t hid_host_mux_release(hid_host_mux_handle_t mux_hdl, size_t events_num);
+
+/**
+ * @brief HID Host get number of input reports dropped because the multiplexer was full
+ *
+ * @param[in] mux_hdl           Multiplexer handle
+ *
+ * @return Number of dropped reports since the multiplexer was created
+ */
+uint32_t hid_host_mux_get_overruns(hid_host_mux_handle_t mux_hdl);
+
+/**
+ * @brief HID Host send output report over interrupt OUT endpoint
+ *
+ * The report is copied to a free OUT transfer and submitted, the function does not wait for its completion.
+ * Up to out_transfers_num reports can be in flight, so the rate of output reports is not limited by control transfer latency.
+ * For interfaces without OUT endpoint use hid_class_request_set_report_async() with HID_REPORT_TYPE_OUTPUT.
+ *
+ * @param[in] hid_dev_handle    HID Device handle
+ * @param[in] data              Output report, prefixed with Report ID if the device uses Report IDs
+ * @param[in] data_length       Length of the output report, up to max packet size of the OUT endpoint
+ * @param[in] timeout_ms        Time to wait for a free OUT transfer
+ *
+ * @return
+ *    - ESP_OK: Report submitted
+ *    - ESP_ERR_NOT_SUPPORTED: Interface has no interrupt OUT endpoint
+ *    - ESP_ERR_INVALID_STATE: Interface is not started
+ *    - ESP_ERR_INVALID_SIZE: Report is larger than max packet size of the OUT endpoint
+ *    - ESP_ERR_TIMEOUT: All OUT transfers are in flight
+ */
+esp_err_t hid_host_device_send_output_report(hid_host_device_handle_t hid_dev_handle,
+        const uint8_t *data,
+        size_t data_length,
+        uint32_t timeout_ms);
+
+/**
+ * @brief HID Host register callback of input reports with Report ID
+ *
+ * Input reports with a registered Report ID are passed to its callback instead of
+ * HID_HOST_INTERFACE_EVENT_INPUT_REPORT event, other reports are notified by the event as before.
+ * With changes_only, the driver keeps the last report of the Report ID and calls the callback only
+ * when a different report arrives, devices repeating the same report then do not wake up the application.
+ *
+ * Callbacks can be registered after hid_host_device_open() and before hid_host_device_start().
+ * They are unregistered by hid_host_device_close().
+ *
+ * @param[in] hid_dev_handle    HID Device handle
+ * @param[in] report_id         Report ID, the first byte of the report. 0: device does not use Report IDs,
+ *                              the callback receives all reports. Cannot be combined with other Report IDs
+ * @param[in] changes_only      Call the callback only if the report differs from the last report of this Report ID
+ * @param[in] callback          Report callback
+ * @param[in] callback_arg      Report callback argument
+ *
+ * @return
+ *    - ESP_OK: Callback registered, replaces previous callback of the Report ID
+ *    - ESP_ERR_INVALID_STATE: Interface is not opened or is already started
+ *    - ESP_ERR_INVALID_ARG: Report ID 0 combined with other Report IDs
+ *    - ESP_ERR_NO_MEM: Not enough memory
+ */
+esp_err_t hid_host_device_register_report_callback(hid_host_device_handle_t hid_dev_handle,
+        uint8_t report_id,
+        bool changes_only,
+        hid_host_report_cb_t callback,
+        void *callback_arg);
+
+/**
+ * @brief HID Host unregister callback of input reports with Report ID
+ *
+ * @param[in] hid_dev_handle    HID Device handle
+ * @param[in] report_id         Report ID
+ *
+ * @return
+ *    - ESP_OK: Callback unregistered
+ *    - ESP_ERR_INVALID_STATE: Interface is not opened or is already started
+ *    - ESP_ERR_NOT_FOUND: No callback registered for the Report ID
+ */
+esp_err_t hid_host_device_unregister_report_callback(hid_host_device_handle_t hid_dev_handle,
+        uint8_t report_id);
+
+/**
+ * @brief HID Host register keyboard key events callback
+ *
+ * The driver keeps the pressed keys of the interface and turns every input report in boot keyboard format
+ * (modifier, reserved, 6 keys) into key press and release events, see hid_keyboard_process_report().
+ * Input reports are passed to the callback instead of report callbacks and HID_HOST_INTERFACE_EVENT_INPUT_REPORT event.
+ * Reports that do not change the pressed keys do not call the callback.
+ *
+ * The interface must be a keyboard (Protocol HID_PROTOCOL_KEYBOARD) that sends reports in boot keyboard format,
+ * e.g. in boot protocol set by hid_class_request_set_protocol().
+ * The callback can be registered after hid_host_device_open() and before hid_host_device_start().
+ * It is unregistered by hid_host_device_close().
+ *
+ * @param[in] hid_dev_handle    HID Device handle
+ * @param[in] callback          Key events callback
+ * @param[in] callback_arg      Key events callback argument
+ *
+ * @return
+ *    - ESP_OK: Callback registered, replaces previous callback, no key is pressed
+ *    - ESP_ERR_INVALID_STATE: Interface is not opened or is already started
+ *    - ESP_ERR_NOT_SUPPORTED: Interface is not a keyboard
+ *    - ESP_ERR_NO_MEM: Not enough memory
+ */
+esp_err_t hid_host_device_register_keyboard_callback(hid_host_device_handle_t hid_dev_handle,
+        hid_host_keyboard_cb_t callback,
+        void *callback_arg);
+
+/**
+ * @brief HID Host unregister keyboard key events callback
+ *
+ * @param[in] hid_dev_handle    HID Device handle
+ *
+ * @return
+ *    - ESP_OK: Callback unregistered
+ *    - ESP_ERR_INVALID_STATE: Interface is not opened or is already started
+ *    - ESP_ERR_NOT_FOUND: No callback registered
+ */
+esp_err_t hid_host_device_unregister_keyboard_callback(hid_host_device_handle_t hid_dev_handle);
+
+/**
+ * @brief HID Host get input report statistics
+ *
+ * @param[in]  hid_dev_handle    HID Device handle
+ * @param[out] stats             Interface statistics
+ *
+ * @return esp_err_t
+ */
+esp_err_t hid_host_device_get_stats(hid_host_device_handle_t hid_dev_handle,
+                                    hid_host_stats_t *stats);
+
+/**
+ * @brief HID Host reset input report statistics
+ *
+ * @param[in] hid_dev_handle    HID Device handle
+ *
+ * @return esp_err_t
+ */
+esp_err_t hid_host_device_reset_stats(hid_host_device_handle_t hid_dev_handle);
+
 // ------------------------ USB HID Host driver API ----------------------------
 
 /**
@@ -211,6 +651,9 @@ esp_err_t hid_host_device_stop(hid_host_device_handle_t hid_dev_handle);
 /**
  * @brief HID Host Get Report Descriptor
  *
+ * In low-memory mode the Report Descriptor is freed once it is compiled to the report map. It is requested again
+ * on the next call and the returned pointer is valid until the device is closed.
+ *
  * @param[in] hid_dev_handle   HID Device handle
  * @param[out] report_desc_len Length of report descriptor
  *
@@ -220,6 +663,60 @@ uint8_t *hid_host_get_report_descriptor(hid_host_device_handle_t hid_dev_handle,
                                         size_t *report_desc_len);
 
 
+/**
+ * @brief HID Host Get compiled Report Descriptor
+ *
+ * The Report Descriptor is requested and compiled on the first call, the same map is returned until the device is closed.
+ * In low-memory mode the map is compiled by hid_host_device_open() and the Report Descriptor is freed.
+ * Use hid_report_map_get_input() and hid_report_field_get() to decode received input reports.
+ *
+ * @param[in] hid_dev_handle   HID Device handle
+ *
+ * @return Compiled Report Descriptor, NULL if the Report Descriptor could not be requested or compiled
+ */
+const hid_report_map_t *hid_host_get_report_map(hid_host_device_handle_t hid_dev_handle);
+
+/**
+ * @brief Export Report Descriptor cache
+ *
+ * The blob can be stored, e.g. in NVS, and imported with hid_host_report_desc_cache_import() after restart.
+ *
+ * @param[out]   blob     Buffer for the cache content. NULL to get the required length only
+ * @param[inout] blob_len Length of the buffer, set to the required length
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: blob_len is NULL
+ *     - ESP_ERR_INVALID_SIZE: The buffer is too small, blob_len is set to the required length
+ *     - ESP_ERR_INVALID_STATE: The cache is disabled
+ */
+esp_err_t hid_host_report_desc_cache_export(uint8_t *blob, size_t *blob_len);
+
+/**
+ * @brief Import Report Descriptor cache
+ *
+ * Imported entries are added to the cache. If the cache is full, the least recently used entries are replaced.
+ *
+ * @param[in] blob     Cache content from hid_host_report_desc_cache_export()
+ * @param[in] blob_len Length of the content
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: Invalid blob
+ *     - ESP_ERR_INVALID_VERSION: The blob was not created by hid_host_report_desc_cache_export()
+ *     - ESP_ERR_INVALID_SIZE: The blob is truncated
+ *     - ESP_ERR_INVALID_STATE: The cache is disabled
+ *     - ESP_ERR_NO_MEM: Not enough memory
+ */
+esp_err_t hid_host_report_desc_cache_import(const uint8_t *blob, size_t blob_len);
+
+/**
+ * @brief Remove all entries from Report Descriptor cache
+ *
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_STATE: The cache is disabled
+ */
+esp_err_t hid_host_report_desc_cache_clear(void);
+
 /**
  * @brief HID Host Get device information
  *
@@ -286,6 +783,56 @@ esp_err_t hid_class_request_set_report(hid_host_device_handle_t hid_dev_handle,
                                        uint8_t *report,
                                        size_t report_length);
 
+/**
+* @brief HID class specific request SET REPORT, non-blocking
+*
+* The report is copied and the request is queued to the device. Requests of all interfaces of the device
+* are sent one after another in order of queuing, the callback is called when the request is finished.
+* Requests of a closed interface are dropped without calling the callback.
+*
+* @param[in] hid_dev_handle     HID Device handle
+* @param[in] report_type        Report type
+* @param[in] report_id          Report ID
+* @param[in] report             Pointer to a buffer with report data
+* @param[in] report_length      Report data length
+* @param[in] callback           Completion callback, can be NULL
+* @param[in] callback_arg       Completion callback argument
+*
+* @return
+*    - ESP_OK: Request queued
+*    - ESP_ERR_NO_MEM: Request queue of the device is full or not enough memory
+*/
+esp_err_t hid_class_request_set_report_async(hid_host_device_handle_t hid_dev_handle,
+        uint8_t report_type,
+        uint8_t report_id,
+        const uint8_t *report,
+        size_t report_length,
+        hid_host_request_cb_t callback,
+        void *callback_arg);
+
+/**
+* @brief HID class specific request GET REPORT, non-blocking
+*
+* Same as hid_class_request_set_report_async(), the received report is passed to the callback.
+*
+* @param[in] hid_dev_handle     HID Device handle
+* @param[in] report_type        Report type
+* @param[in] report_id          Report ID
+* @param[in] report_length_max  Maximum length of the report
+* @param[in] callback           Completion callback
+* @param[in] callback_arg       Completion callback argument
+*
+* @return
+*    - ESP_OK: Request queued
+*    - ESP_ERR_NO_MEM: Request queue of the device is full or not enough memory
+*/
+esp_err_t hid_class_request_get_report_async(hid_host_device_handle_t hid_dev_handle,
+        uint8_t report_type,
+        uint8_t report_id,
+        size_t report_length_max,
+        hid_host_request_cb_t callback,
+        void *callback_arg);
+
 /**
  * @brief HID class specific request SET IDLE
  *
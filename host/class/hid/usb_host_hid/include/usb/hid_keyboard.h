@@ -0,0 +1,84 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "hid_usage_keyboard.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HID_KEYBOARD_MODIFIER_USAGE (0xE0)  /**< Usage of the first modifier (Left Control), modifier bit n is usage 0xE0 + n */
+
+/**
+ * @brief Maximum number of key events of one report
+ *
+ * Every key and modifier of the previous report is released and every key and modifier of the new report is pressed
+ */
+#define HID_KEYBOARD_EVENTS_MAX     (2 * (HID_KEYBOARD_KEY_MAX + 8))
+
+/**
+ * @brief Key event
+ */
+typedef struct {
+    uint8_t key_code;                   /**< Usage of Keyboard/Keypad page, modifiers are reported as usages 0xE0 - 0xE7 */
+    uint8_t modifier;                   /**< Modifier bits after the report, HID_LEFT_CONTROL ... HID_RIGHT_GUI */
+    bool pressed;                       /**< true: Key pressed, false: Key released */
+} hid_keyboard_event_t;
+
+/**
+ * @brief State of pressed keys of one keyboard
+ *
+ * One bit per usage of Keyboard/Keypad page, modifiers included.
+ */
+typedef struct {
+    uint32_t keys[256 / 32];            /**< Bitset of pressed keys */
+} hid_keyboard_state_t;
+
+/**
+ * @brief Reset keyboard state, no key is pressed
+ *
+ * @param[out] state Keyboard state
+ */
+void hid_keyboard_state_reset(hid_keyboard_state_t *state);
+
+/**
+ * @brief Update keyboard state with boot keyboard input report and generate key events
+ *
+ * The keys of the report are collected to a bitset that is compared with the state word by word,
+ * so the events are found without comparing the key arrays of both reports.
+ * Released keys are reported before pressed keys, each group in ascending order of usage.
+ * Reports with Phantom state (ErrorRollOver) are ignored, the state is kept until the next valid report.
+ *
+ * @param[inout] state      Keyboard state
+ * @param[in]    report     Input report in boot keyboard format: modifier, reserved, up to 6 keys
+ * @param[in]    report_len Length of the report, shorter than 3 bytes is ignored
+ * @param[out]   events     Key events, HID_KEYBOARD_EVENTS_MAX entries
+ * @return Number of key events
+ */
+size_t hid_keyboard_process_report(hid_keyboard_state_t *state, const uint8_t *report, size_t report_len,
+                                   hid_keyboard_event_t events[HID_KEYBOARD_EVENTS_MAX]);
+
+/**
+ * @brief Check if a key is pressed
+ *
+ * @param[in] state    Keyboard state
+ * @param[in] key_code Usage of Keyboard/Keypad page
+ * @return true if the key is pressed
+ */
+static inline bool hid_keyboard_is_pressed(const hid_keyboard_state_t *state, uint8_t key_code)
+{
+    return (state->keys[key_code >> 5] >> (key_code & 31)) & 1;
+}
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
@@ -0,0 +1,155 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#include "hid.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief HID Main item data flags of a report field
+ *
+ * @see 6.2.2.5 Input, Output, and Feature Items, p.30 of Device Class Definition for Human Interface Devices (HID) Version 1.11
+ */
+#define HID_FIELD_FLAG_CONSTANT     (1 << 0)    /**< Constant (0: Data) */
+#define HID_FIELD_FLAG_VARIABLE     (1 << 1)    /**< Variable (0: Array). Array fields contain index of the usage selected from usage..usage_max */
+#define HID_FIELD_FLAG_RELATIVE     (1 << 2)    /**< Relative (0: Absolute) */
+#define HID_FIELD_FLAG_WRAP         (1 << 3)    /**< Wrap */
+#define HID_FIELD_FLAG_NONLINEAR    (1 << 4)    /**< Non Linear */
+#define HID_FIELD_FLAG_NO_PREFERRED (1 << 5)    /**< No Preferred state */
+#define HID_FIELD_FLAG_NULL_STATE   (1 << 6)    /**< Null state */
+
+/**
+ * @brief Field of a HID report
+ *
+ * One field is created for each Report Count of the Main item. Constant (padding) data do not create fields.
+ */
+typedef struct {
+    uint16_t usage_page;                /**< Usage Page */
+    uint16_t usage;                     /**< Usage. Minimum usage for array fields */
+    uint16_t usage_max;                 /**< Maximum usage for array fields, equal to usage for variable fields */
+    uint16_t bit_offset;                /**< Offset of the field in the report in bits, including Report ID byte */
+    uint8_t bit_size;                   /**< Size of the field in bits, 1 to 32 */
+    uint8_t flags;                      /**< HID_FIELD_FLAG_* */
+    int32_t logical_min;                /**< Logical Minimum */
+    int32_t logical_max;                /**< Logical Maximum */
+} hid_report_field_t;
+
+/**
+ * @brief HID report with its fields
+ */
+typedef struct {
+    hid_report_type_t type;             /**< Report type: input, output or feature */
+    uint8_t id;                         /**< Report ID, 0 if the device does not use Report IDs */
+    uint16_t len;                       /**< Length of the report in bytes, including Report ID byte */
+    uint16_t field_num;                 /**< Number of fields */
+    const hid_report_field_t *fields;   /**< Fields of the report */
+} hid_report_t;
+
+/**
+ * @brief Compiled HID Report Descriptor
+ */
+typedef struct hid_report_map {
+    bool uses_report_id;                /**< Reports are prefixed with Report ID byte */
+    uint16_t report_num;                /**< Number of reports */
+    hid_report_t *reports;              /**< Reports */
+    uint16_t field_num;                 /**< Number of fields of all reports */
+    hid_report_field_t *fields;         /**< Fields of all reports, fields of one report follow each other */
+    uint16_t input_index[256];          /**< Index + 1 of input report by Report ID, 0: No such input report */
+} hid_report_map_t;
+
+/**
+ * @brief Compile HID Report Descriptor to a table of reports and their fields
+ *
+ * @param[in]  report_desc     Report Descriptor
+ * @param[in]  report_desc_len Length of Report Descriptor
+ * @param[out] map_ret         Compiled Report Descriptor, free it with hid_report_map_delete()
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Invalid arguments
+ *    - ESP_ERR_INVALID_RESPONSE: Malformed Report Descriptor
+ *    - ESP_ERR_NO_MEM: Not enough memory
+ */
+esp_err_t hid_report_map_create(const uint8_t *report_desc, size_t report_desc_len, hid_report_map_t **map_ret);
+
+/**
+ * @brief Free compiled HID Report Descriptor
+ *
+ * @param[in] map Compiled Report Descriptor, can be NULL
+ */
+void hid_report_map_delete(hid_report_map_t *map);
+
+/**
+ * @brief Find a report by its type and Report ID
+ *
+ * @param[in] map  Compiled Report Descriptor
+ * @param[in] type Report type
+ * @param[in] id   Report ID, 0 if the device does not use Report IDs
+ * @return Report, NULL if not found
+ */
+const hid_report_t *hid_report_map_find(const hid_report_map_t *map, hid_report_type_t type, uint8_t id);
+
+/**
+ * @brief Get the input report of received data
+ *
+ * The report is looked up by the first byte of the data if the device uses Report IDs.
+ *
+ * @param[in] map      Compiled Report Descriptor
+ * @param[in] data     Received input report
+ * @param[in] data_len Length of received input report
+ * @return Report, NULL if the Report ID is unknown or the data are shorter than the report
+ */
+static inline const hid_report_t *hid_report_map_get_input(const hid_report_map_t *map, const uint8_t *data, size_t data_len)
+{
+    if (data_len == 0) {
+        return NULL;
+    }
+    const uint16_t index = map->input_index[map->uses_report_id ? data[0] : 0];
+    if (index == 0 || map->reports[index - 1].len > data_len) {
+        return NULL;
+    }
+    return &map->reports[index - 1];
+}
+
+/**
+ * @brief Get value of a report field
+ *
+ * The value is sign extended if Logical Minimum of the field is negative.
+ *
+ * @param[in] field  Field of the report
+ * @param[in] report Report data including Report ID byte, at least the length of the report
+ * @return Value of the field
+ */
+static inline int32_t hid_report_field_get(const hid_report_field_t *field, const uint8_t *report)
+{
+    const uint8_t *p = report + (field->bit_offset >> 3);
+    const unsigned shift = field->bit_offset & 7;
+    const unsigned bytes = (shift + field->bit_size + 7) >> 3;
+    uint64_t raw = 0;
+    for (unsigned i = 0; i < bytes; i++) {
+        raw |= (uint64_t)p[i] << (8 * i);
+    }
+    uint32_t value = (uint32_t)(raw >> shift);
+    if (field->bit_size < 32) {
+        value &= (1UL << field->bit_size) - 1;
+        if (field->logical_min < 0 && (value & (1UL << (field->bit_size - 1)))) {
+            value |= ~((1UL << field->bit_size) - 1);
+        }
+    }
+    return (int32_t)value;
+}
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
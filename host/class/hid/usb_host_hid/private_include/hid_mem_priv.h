@@ -0,0 +1,23 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdlib.h>
+
+// Report queues, descriptors and driver structures are accounted in the memory footprint of usb_host_shared_client,
+// and taken from the arenas of its static allocation mode if it is installed. From heap otherwise
+#if USB_HOST_SHARED_CLIENT_ENABLED
+#include "esp_heap_caps.h"
+#include "usb/usb_host_mem.h"
+#define HID_MALLOC(category, size)          usb_host_mem_malloc(USB_HOST_MEM_DRIVER_HID, USB_HOST_MEM_##category, size, MALLOC_CAP_DEFAULT)
+#define HID_CALLOC(category, n, size)       usb_host_mem_calloc(USB_HOST_MEM_DRIVER_HID, USB_HOST_MEM_##category, n, size, MALLOC_CAP_DEFAULT)
+#define HID_FREE(category, ptr, size)       usb_host_mem_free(USB_HOST_MEM_DRIVER_HID, USB_HOST_MEM_##category, ptr, size)
+#else
+#define HID_MALLOC(category, size)          malloc(size)
+#define HID_CALLOC(category, n, size)       calloc(n, size)
+#define HID_FREE(category, ptr, size)       ((void)(size), free(ptr))
+#endif
@@ -0,0 +1,73 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Report Descriptor cache
+ *
+ * Stores Report Descriptors per device and interface.
+ * On reconnection of the same device, the Report Descriptor is taken from the cache without control transfer.
+ */
+
+/**
+ * @brief Key of cached Report Descriptor
+ */
+typedef struct {
+    uint16_t idVendor;                  /**< Vendor ID of the device */
+    uint16_t idProduct;                 /**< Product ID of the device */
+    uint16_t bcdDevice;                 /**< Device release number. Firmware update of the device invalidates the entry */
+    uint8_t bInterfaceNumber;           /**< HID interface number */
+    uint16_t wReportDescriptorLength;   /**< Length of Report Descriptor from HID descriptor */
+} hid_report_desc_cache_key_t;
+
+/**
+ * @brief Initialize Report Descriptor cache
+ *
+ * @param[in] num_entries Number of cache entries. 0 disables the cache
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_NO_MEM: Not enough memory for the cache
+ *     - ESP_ERR_INVALID_STATE: The cache is already initialized
+ */
+esp_err_t hid_report_desc_cache_init(size_t num_entries);
+
+/**
+ * @brief Deinitialize Report Descriptor cache and free all entries
+ */
+void hid_report_desc_cache_deinit(void);
+
+/**
+ * @brief Find cached Report Descriptor
+ *
+ * @param[in]  key         Device and interface
+ * @param[out] report_desc Buffer of wReportDescriptorLength bytes, the cached Report Descriptor is copied to it
+ * @return true if the Report Descriptor is cached and copied
+ */
+bool hid_report_desc_cache_get(const hid_report_desc_cache_key_t *key, uint8_t *report_desc);
+
+/**
+ * @brief Store Report Descriptor
+ *
+ * If the cache is full, the least recently used entry is replaced.
+ *
+ * @param[in] key         Device and interface
+ * @param[in] report_desc Report Descriptor of wReportDescriptorLength bytes, it is copied
+ */
+void hid_report_desc_cache_put(const hid_report_desc_cache_key_t *key, const uint8_t *report_desc);
+
+#ifdef __cplusplus
+}
+#endif
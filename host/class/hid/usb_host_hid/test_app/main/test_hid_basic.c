@@ -19,6 +19,7 @@
 #include "usb/hid_host.h"
 #include "usb/hid_usage_keyboard.h"
 #include "usb/hid_usage_mouse.h"
+#include "usb/usb_host_shared_client.h"
 
 #include "test_hid_basic.h"
 #include "hid_mock_device.h"
@@ -30,6 +31,7 @@ static uint32_t user_arg_value = 0x8A53E0A4; // Just a constant random number
 // IMPORTANT: Interaction is not possible within device/interface callback
 static bool time_to_shutdown = false;
 static bool time_to_stop_polling = false;
+static bool shared_client_installed = false;
 QueueHandle_t hid_host_test_event_queue;
 TaskHandle_t hid_test_task_handle;
 
@@ -219,6 +221,40 @@ void hid_host_test_concurrent(hid_host_device_handle_t hid_device_handle,
     }
 }
 
+void hid_host_test_concurrent_in_transfers(hid_host_device_handle_t hid_device_handle,
+        const hid_host_driver_event_t event,
+        void *arg)
+{
+    hid_host_dev_params_t dev_params;
+    TEST_ASSERT_EQUAL(ESP_OK, hid_host_device_get_params(hid_device_handle, &dev_params));
+    TEST_ASSERT_EQUAL_PTR_MESSAGE(&user_arg_value, arg, "User argument has lost");
+
+    switch (event) {
+    case HID_HOST_DRIVER_EVENT_CONNECTED:
+        printf("USB port %d, interface %d, '%s', '%s'\n",
+               dev_params.addr,
+               dev_params.iface_num,
+               test_hid_sub_class_names[dev_params.sub_class],
+               test_hid_proto_names[dev_params.proto]);
+
+        // Several IN transfers are queued while control requests of other tasks are in progress
+        const hid_host_device_config_t dev_config = {
+            .callback = hid_host_test_interface_callback,
+            .callback_arg = &user_arg_value,
+            .in_transfers_num = 4,
+        };
+
+        TEST_ASSERT_EQUAL(ESP_OK,  hid_host_device_open(hid_device_handle, &dev_config) );
+        TEST_ASSERT_EQUAL(ESP_OK,  hid_host_device_start(hid_device_handle) );
+
+        global_hdl = hid_device_handle;
+        break;
+    default:
+        TEST_FAIL_MESSAGE("HID Driver unhandled event");
+        break;
+    }
+}
+
 void hid_host_test_device_callback_to_queue(hid_host_device_handle_t hid_device_handle,
         const hid_host_driver_event_t event,
         void *arg)
@@ -562,6 +598,17 @@ void test_hid_setup(hid_host_driver_event_cb_t device_callback,
     // Wait for notification from usb_lib_task
     ulTaskNotifyTake(false, 1000);
 
+    if (hid_test_event_handle == HID_TEST_EVENT_HANDLE_SHARED_CLIENT) {
+        const usb_host_shared_client_config_t shared_client_config = {
+            .create_background_task = true,
+            .task_priority = 5,
+            .stack_size = 4096,
+            .core_id = 0,
+        };
+        TEST_ASSERT_EQUAL(ESP_OK, usb_host_shared_client_install(&shared_client_config) );
+        shared_client_installed = true;
+    }
+
     // HID host driver config
     const hid_host_driver_config_t hid_host_driver_config = {
         .create_background_task = (hid_test_event_handle == HID_TEST_EVENT_HANDLE_IN_DRIVER)
@@ -571,7 +618,8 @@ void test_hid_setup(hid_host_driver_event_cb_t device_callback,
         .stack_size = 4096,
         .core_id = 0,
         .callback = device_callback,
-        .callback_arg = (void *) &user_arg_value
+        .callback_arg = (void *) &user_arg_value,
+        .shared_client = shared_client_installed,
     };
 
     TEST_ASSERT_EQUAL(ESP_OK, hid_host_install(&hid_host_driver_config) );
@@ -590,6 +638,10 @@ void test_hid_teardown(void)
     force_conn_state(false, pdMS_TO_TICKS(1000));
     vTaskDelay(50);
     TEST_ASSERT_EQUAL(ESP_OK, hid_host_uninstall() );
+    if (shared_client_installed) {
+        TEST_ASSERT_EQUAL(ESP_OK, usb_host_shared_client_uninstall() );
+        shared_client_installed = false;
+    }
     ulTaskNotifyValueClear(NULL, 1);
     vTaskDelay(20);
 }
@@ -644,6 +696,23 @@ TEST_CASE("multiple_task_access", "[hid_host]")
     // Verify the memory leakage during test environment tearDown()
 }
 
+TEST_CASE("multiple_task_access_with_in_transfers", "[hid_host]")
+{
+    // Install USB and HID driver with 'hid_host_test_concurrent_in_transfers'
+    test_hid_setup(hid_host_test_concurrent_in_transfers, HID_TEST_EVENT_HANDLE_IN_DRIVER);
+    // Wait for USB device appearing for 250 msec
+    vTaskDelay(250);
+    // Refresh the num passed test value
+    test_num_passed = 0;
+    // Start multiple task access to USB device with control requests
+    test_multiple_tasks_access();
+    // Tear down test
+    test_hid_teardown();
+    // Verify how much tests was done
+    TEST_ASSERT_EQUAL(MULTIPLE_TASKS_TASKS_NUM, test_num_passed);
+    // Verify the memory leakage during test environment tearDown()
+}
+
 TEST_CASE("class_specific_requests", "[hid_host]")
 {
     // Create external HID events task
@@ -689,6 +758,24 @@ TEST_CASE("class_specific_requests_with_external_polling_without_polling", "[hid
     // Verify the memory leakage during test environment tearDown()
 }
 
+TEST_CASE("class_specific_requests_with_shared_client", "[hid_host]")
+{
+    // Create external HID events task
+    test_setup_hid_task();
+    // Install USB, shared USB Host client and HID driver registered to it
+    test_hid_setup(hid_host_test_device_callback_to_queue, HID_TEST_EVENT_HANDLE_SHARED_CLIENT);
+    // The shared client must not be uninstalled while HID driver is registered
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, usb_host_shared_client_uninstall());
+    // HID events are handled by the shared client task
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, hid_host_handle_events(0));
+    // All specific control requests will be verified during device connection callback 'hid_host_test_requests_callback'
+    // Wait for test completed for 250 ms
+    vTaskDelay(250);
+    // Tear down test
+    test_hid_teardown();
+    // Verify the memory leakage during test environment tearDown()
+}
+
 TEST_CASE("sudden_disconnect", "[hid_host]")
 {
     // Install USB and HID driver with 'hid_host_test_concurrent'
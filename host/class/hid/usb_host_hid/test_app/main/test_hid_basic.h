@@ -14,7 +14,8 @@ extern "C" {
 
 typedef enum {
     HID_TEST_EVENT_HANDLE_IN_DRIVER = 0,
-    HID_TEST_EVENT_HANDLE_EXTERNAL
+    HID_TEST_EVENT_HANDLE_EXTERNAL,
+    HID_TEST_EVENT_HANDLE_SHARED_CLIENT
 } hid_test_event_handle_t;
 
 // ------------------------ HID Test -------------------------------------------
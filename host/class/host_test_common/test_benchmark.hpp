@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <chrono>
+
+/**
+ * Benchmark scaffolding of host tests
+ *
+ * Time and allocations of the measured code are taken by test_benchmark_meter. Allocations are counted by wrapping
+ * libc allocator of the test executable, so this header defines malloc() and calloc():
+ * It must be included by one source file of the test executable only.
+ */
+
+namespace test_benchmark {
+bool count_allocs;
+size_t allocs;
+size_t alloc_bytes;
+} // namespace test_benchmark
+
+/**
+ * @brief Measurement of time and allocations between start() and stop()
+ */
+class test_benchmark_meter {
+public:
+    void start()
+    {
+        test_benchmark::allocs = 0;
+        test_benchmark::alloc_bytes = 0;
+        test_benchmark::count_allocs = true;
+        start_time = std::chrono::steady_clock::now();
+    }
+
+    void stop()
+    {
+        stop_time = std::chrono::steady_clock::now();
+        test_benchmark::count_allocs = false;
+        allocs = test_benchmark::allocs;
+        alloc_bytes = test_benchmark::alloc_bytes;
+    }
+
+    double seconds() const
+    {
+        return std::chrono::duration<double>(stop_time - start_time).count();
+    }
+
+    size_t allocs = 0;          // Allocations between start() and stop()
+    size_t alloc_bytes = 0;     // Bytes allocated between start() and stop()
+
+private:
+    std::chrono::steady_clock::time_point start_time;
+    std::chrono::steady_clock::time_point stop_time;
+};
+
+extern "C" {
+// The executable's allocator takes precedence over libc's, forward to glibc and count while measuring
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+
+void *malloc(size_t size)
+{
+    if (test_benchmark::count_allocs) {
+        test_benchmark::allocs++;
+        test_benchmark::alloc_bytes += size;
+    }
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    if (test_benchmark::count_allocs) {
+        test_benchmark::allocs++;
+        test_benchmark::alloc_bytes += nmemb * size;
+    }
+    return __libc_calloc(nmemb, size);
+}
+}
@@ -21,31 +21,151 @@ typedef struct {
     uint8_t code_q;
 } scsi_sense_data_t;
 
+#define SCSI_UNMAP_MAX_RANGES 8 // Maximum number of ranges of one UNMAP command
+
+/**
+ * @brief Range of sectors to unmap
+ */
+typedef struct {
+    uint64_t sector_address;
+    uint32_t num_sectors;
+} scsi_unmap_range_t;
+
+/**
+ * @brief Capacity and physical block layout reported by READ CAPACITY(16)
+ */
+typedef struct {
+    uint64_t block_count;       /**< Number of logical blocks */
+    uint32_t block_size;        /**< Logical block size in bytes */
+    uint8_t phys_block_exp;     /**< Logical blocks per physical block exponent, e.g. 3 for 512e drives with 4096 byte physical sectors */
+    uint16_t lowest_aligned_lba; /**< First logical block aligned to a physical block */
+} scsi_capacity16_t;
+
+/*
+ * All commands address a Logical Unit of the device, 0 for single LUN devices.
+ * Each command and the REQUEST SENSE of its failure are atomic, commands from different tasks are interleaved.
+ */
+
 esp_err_t scsi_cmd_read10(msc_host_device_handle_t device,
+                          uint8_t lun,
                           uint8_t *data,
                           uint32_t sector_address,
                           uint32_t num_sectors,
                           uint32_t sector_size);
 
 esp_err_t scsi_cmd_write10(msc_host_device_handle_t device,
+                           uint8_t lun,
                            const uint8_t *data,
                            uint32_t sector_address,
                            uint32_t num_sectors,
                            uint32_t sector_size);
 
+esp_err_t scsi_cmd_read16(msc_host_device_handle_t device,
+                          uint8_t lun,
+                          uint8_t *data,
+                          uint64_t sector_address,
+                          uint32_t num_sectors,
+                          uint32_t sector_size);
+
+esp_err_t scsi_cmd_write16(msc_host_device_handle_t device,
+                           uint8_t lun,
+                           const uint8_t *data,
+                           uint64_t sector_address,
+                           uint32_t num_sectors,
+                           uint32_t sector_size);
+
+/**
+ * @brief Read sectors by READ(10), or by READ(16) if the capacity of the device exceeds 32-bit LBA
+ */
+esp_err_t scsi_cmd_read(msc_host_device_handle_t device,
+                        uint8_t lun,
+                        uint8_t *data,
+                        uint64_t sector_address,
+                        uint32_t num_sectors,
+                        uint32_t sector_size);
+
+/**
+ * @brief Write sectors by WRITE(10), or by WRITE(16) if the capacity of the device exceeds 32-bit LBA
+ */
+esp_err_t scsi_cmd_write(msc_host_device_handle_t device,
+                         uint8_t lun,
+                         const uint8_t *data,
+                         uint64_t sector_address,
+                         uint32_t num_sectors,
+                         uint32_t sector_size);
+
+/**
+ * @brief Write sectors with Force Unit Access, the command completes when the data are on the medium
+ */
+esp_err_t scsi_cmd_write_fua(msc_host_device_handle_t device,
+                             uint8_t lun,
+                             const uint8_t *data,
+                             uint64_t sector_address,
+                             uint32_t num_sectors,
+                             uint32_t sector_size);
+
 esp_err_t scsi_cmd_read_capacity(msc_host_device_handle_t device,
+                                 uint8_t lun,
                                  uint32_t *block_size,
                                  uint32_t *block_count);
 
-esp_err_t scsi_cmd_sense(msc_host_device_handle_t device, scsi_sense_data_t *sense);
+esp_err_t scsi_cmd_read_capacity16(msc_host_device_handle_t device,
+                                   uint8_t lun,
+                                   uint32_t *block_size,
+                                   uint64_t *block_count);
+
+/**
+ * @brief Read capacity and physical block layout by READ CAPACITY(16)
+ *
+ * @return ESP_ERR_NOT_SUPPORTED if the device rejects the command
+ */
+esp_err_t scsi_cmd_read_capacity16_info(msc_host_device_handle_t device, uint8_t lun, scsi_capacity16_t *capacity);
+
+esp_err_t scsi_cmd_sense(msc_host_device_handle_t device, uint8_t lun, scsi_sense_data_t *sense);
+
+esp_err_t scsi_cmd_unit_ready(msc_host_device_handle_t device, uint8_t lun);
+
+/**
+ * @brief Read standard INQUIRY data
+ *
+ * @param[out] removable The Logical Unit has removable medium, can be NULL
+ */
+esp_err_t scsi_cmd_inquiry(msc_host_device_handle_t device, uint8_t lun, bool *removable);
+
+/**
+ * @brief Read Vital Product Data page
+ *
+ * @param[in]    page_code VPD page code
+ * @param[out]   data      VPD page including its 4 byte header
+ * @param[inout] size      Size of the data buffer, on success the size of the page, at most 255 bytes
+ * @return ESP_ERR_NOT_SUPPORTED if the device rejects the page
+ */
+esp_err_t scsi_cmd_inquiry_vpd(msc_host_device_handle_t device, uint8_t lun, uint8_t page_code, uint8_t *data, size_t *size);
 
-esp_err_t scsi_cmd_unit_ready(msc_host_device_handle_t device);
+/**
+ * @brief Unmap up to SCSI_UNMAP_MAX_RANGES ranges of sectors by UNMAP
+ */
+esp_err_t scsi_cmd_unmap(msc_host_device_handle_t device, uint8_t lun, const scsi_unmap_range_t *ranges, size_t range_num);
+
+/**
+ * @brief Unmap sectors by WRITE SAME(16) with UNMAP bit
+ */
+esp_err_t scsi_cmd_write_same16_unmap(msc_host_device_handle_t device,
+                                      uint8_t lun,
+                                      uint64_t sector_address,
+                                      uint32_t num_sectors,
+                                      uint32_t sector_size);
 
-esp_err_t scsi_cmd_inquiry(msc_host_device_handle_t device);
+/**
+ * @brief Write volatile cache of the Logical Unit to the medium by SYNCHRONIZE CACHE(10)
+ *
+ * @return ESP_ERR_NOT_SUPPORTED if the device rejects the command, e.g. it has no write cache
+ */
+esp_err_t scsi_cmd_synchronize_cache(msc_host_device_handle_t device, uint8_t lun);
 
-esp_err_t scsi_cmd_prevent_removal(msc_host_device_handle_t device, bool prevent);
+esp_err_t scsi_cmd_prevent_removal(msc_host_device_handle_t device, uint8_t lun, bool prevent);
 
-esp_err_t scsi_cmd_mode_sense(msc_host_device_handle_t device);
+esp_err_t scsi_cmd_mode_sense(msc_host_device_handle_t device, uint8_t lun);
 
 #ifdef __cplusplus
 }
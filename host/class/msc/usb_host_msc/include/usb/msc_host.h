@@ -46,6 +46,45 @@ typedef struct {
 */
 typedef void (*msc_host_event_cb_t)(const msc_host_event_t *event, void *arg);
 
+/**
+ * @brief Completion callback of asynchronous sector request
+ *
+ * Called from the worker task of the device. The callback can submit new requests, it must not block.
+ *
+ * @param[in] device Handle of MSC device
+ * @param[in] result Result of the request:
+ *                   - ESP_OK: Success
+ *                   - ESP_ERR_INVALID_STATE: Not executed, a previous request failed since the last barrier
+ *                   - Other: Command failed
+ *                   Barrier reports the first error since the previous barrier
+ * @param[in] arg    User argument of the request
+ */
+typedef void (*msc_host_io_cb_t)(msc_host_device_handle_t device, esp_err_t result, void *arg);
+
+/**
+ * @brief Write barrier of a filesystem or block device sync
+ *
+ * Drives with volatile write cache acknowledge writes before the data are on the medium.
+ */
+typedef enum {
+    MSC_HOST_WRITE_BARRIER_SYNC_CACHE = 0,  /**< Sync writes the drive's cache to the medium by SYNCHRONIZE CACHE */
+    MSC_HOST_WRITE_BARRIER_FUA,             /**< Also metadata writes complete on the medium by Force Unit Access: single-sector FatFS writes
+                                                 (FAT and directory sectors) and all writes of a block device */
+    MSC_HOST_WRITE_BARRIER_NONE,            /**< Sync does not flush the drive's cache, durability depends on the drive */
+} msc_host_write_barrier_t;
+
+/**
+ * @brief Configuration of asynchronous sector requests
+ *
+ * Each device gets a worker task executing msc_host_read_sector_async() and msc_host_write_sector_async() requests.
+ */
+typedef struct {
+    int queue_size;                 /**< Number of queued requests per device. 0: Asynchronous requests disabled */
+    size_t stack_size;              /**< Stack size of the worker task, the completion callbacks run on it */
+    unsigned task_priority;         /**< Priority of the worker task */
+    BaseType_t core_id;             /**< Core of the worker task or tskNO_AFFINITY */
+} msc_host_async_io_config_t;
+
 /**
  * @brief MSC configuration structure.
 */
@@ -57,14 +96,41 @@ typedef struct {
     BaseType_t core_id;             /**< Select core on which background task will run or tskNO_AFFINITY  */
     msc_host_event_cb_t callback;   /**< Callback invoked when MSC event occurs. Must not be NULL. */
     void *callback_arg;             /**< User provided argument passed to callback */
+    size_t max_transfer_size;       /**< Maximum size of one bulk transfer of data phase, rounded up to multiple of 512 bytes.
+                                         Larger reads and writes are split. 0: Default size of 4096 bytes */
+    int transfer_pool_size;         /**< Number of data phase transfers preallocated per device and kept in flight. 0: Default number of 2 */
+    msc_host_async_io_config_t async_io; /**< Worker of asynchronous sector requests */
+    int id_cache_size;              /**< Number of devices whose identification is kept after they are uninstalled, looked up by VID, PID and serial number.
+                                         Reinstalled devices skip INQUIRY, GET MAX LUN and VPD pages, and READ CAPACITY of non-removable media.
+                                         0: Identification is not cached */
+    bool shared_client;             /**< Register to the client of usb_host_shared_client component instead of an own USB Host client.
+                                         Its task handles the events, so no background task is created and msc_host_handle_events is not used */
 } msc_host_driver_config_t;
 
+/**
+ * @brief Configuration of one MSC device
+ *
+ * Each device has its own transfers, lock and worker task, so I/O to different devices runs in parallel.
+ * With its own configuration, the worker of each drive can run on a different core,
+ * and a stuck drive fails its commands after transfer_timeout_ms without delaying the other drives.
+ */
+typedef struct {
+    msc_host_async_io_config_t async_io; /**< Worker of asynchronous sector requests of the device.
+                                              queue_size 0: Worker as configured by async_io of msc_host_driver_config_t */
+    uint32_t transfer_timeout_ms;       /**< Time to wait for completion of one transfer. 0: Default timeout of 5000 ms.
+                                             With adaptive_timeout, it is the upper limit of the adaptive timeouts */
+    bool adaptive_timeout;              /**< Derive timeout of each command from its opcode, data size and latency of the previous commands.
+                                             After 3 consecutive timeouts, commands fail at once for a back-off period doubling from 1 s up to 30 s */
+} msc_host_device_config_t;
+
 /**
  * @brief MSC device info.
 */
 typedef struct {
-    uint32_t sector_count;
+    uint64_t sector_count;          /**< Number of sectors. READ(16) and WRITE(16) are used if it exceeds 32-bit LBA. 0: No medium in the Logical Unit */
     uint32_t sector_size;
+    uint32_t physical_sector_size;  /**< Physical sector size reported by READ CAPACITY(16), e.g. 4096 for 512e drives. sector_size if not reported */
+    uint8_t lun_num;                /**< Number of Logical Units of the device, like slots of a card reader */
     uint16_t idProduct;
     uint16_t idVendor;
     wchar_t iManufacturer[MSC_STR_DESC_SIZE];
@@ -72,6 +138,34 @@ typedef struct {
     wchar_t iSerialNumber[MSC_STR_DESC_SIZE];
 } msc_host_device_info_t;
 
+// Number of buckets in latency histograms of msc_host_stats_t
+#define MSC_HOST_STATS_HIST_BUCKETS (12)
+// Size of sense_keys array of msc_host_stats_t, indexed by Sense Key
+#define MSC_HOST_STATS_SENSE_KEY_NUM (16)
+
+/**
+ * @brief MSC device statistics
+ *
+ * The counters are accumulated since the device was installed or since last msc_host_reset_stats() call.
+ * Latency histograms of Bulk-Only Transport phases: Bucket 0: < 125 us, bucket i: <125 * 2^(i-1); 125 * 2^i) us,
+ * last bucket: >= 128 ms. The command phase ends when CBW is sent, the data phase when the last data are transferred
+ * and the status phase when CSW is received. UAS devices account COMMAND IUs, data phases and SENSE IUs instead.
+ */
+typedef struct {
+    uint64_t read_bytes;            /**< Number of bytes read by successful READ commands */
+    uint64_t write_bytes;           /**< Number of bytes written by successful WRITE commands */
+    uint32_t read_cmds;             /**< Number of successful READ commands */
+    uint32_t write_cmds;            /**< Number of successful WRITE commands */
+    uint32_t stalls;                /**< Number of stalled transfers */
+    uint32_t reset_recoveries;      /**< Number of msc_host_reset_recovery() calls, done on failure of status transport or timeout */
+    uint32_t timeouts;              /**< Number of timed out commands */
+    uint32_t bounced_data_phases;   /**< Number of data phases copied through the transfers of the driver, because the buffer was not in DMA capable memory or not aligned */
+    uint32_t sense_keys[MSC_HOST_STATS_SENSE_KEY_NUM];   /**< Number of REQUEST SENSE results, indexed by Sense Key */
+    uint32_t cmd_latency[MSC_HOST_STATS_HIST_BUCKETS];   /**< Histogram of command phase latency */
+    uint32_t data_latency[MSC_HOST_STATS_HIST_BUCKETS];  /**< Histogram of data phase latency */
+    uint32_t status_latency[MSC_HOST_STATS_HIST_BUCKETS]; /**< Histogram of status phase latency */
+} msc_host_stats_t;
+
 /**
  * @brief Install USB Host Mass Storage Class driver
  *
@@ -89,15 +183,33 @@ esp_err_t msc_host_uninstall(void);
 /**
  * @brief Initialization of MSC device.
  *
+ * Different devices can be installed from several tasks at once, so a slow device does not delay the others.
+ *
  * @param[in]  device_address  Device address obtained from MSC callback provided upon connection and enumeration
  * @param[out] device          Mass storage device handle to be used for subsequent calls.
  * @return esp_err_t
  */
 esp_err_t msc_host_install_device(uint8_t device_address, msc_host_device_handle_t *device);
 
+/**
+ * @brief Initialization of MSC device with its own configuration
+ *
+ * @param[in]  device_address  Device address obtained from MSC callback provided upon connection and enumeration
+ * @param[in]  config          Configuration of the device, NULL: Same as msc_host_install_device()
+ * @param[out] device          Mass storage device handle to be used for subsequent calls.
+ * @return
+ *    - ESP_OK: Device installed
+ *    - ESP_ERR_INVALID_ARG: Invalid configuration
+ *    - Other: Installation failed
+ */
+esp_err_t msc_host_install_device_with_config(uint8_t device_address, const msc_host_device_config_t *config,
+                                              msc_host_device_handle_t *device);
+
 /**
  * @brief Deinitialization of MSC device.
  *
+ * Queued asynchronous requests are executed before the device is deinitialized.
+ *
  * @param[in]  device  Device handle obtained from msc_host_install_device function
  * @return esp_err_t
  */
@@ -139,6 +251,60 @@ __attribute__((deprecated("use API from esp_private/msc_scsi_bot.h")));
 esp_err_t msc_host_write_sector(msc_host_device_handle_t device, size_t sector, const void *data, size_t size)
 __attribute__((deprecated("use API from esp_private/msc_scsi_bot.h")));
 
+/**
+ * @brief Queue asynchronous read of sectors
+ *
+ * Requests of the device are executed by its worker task in the order of submission.
+ * The next request is started as soon as the previous one completes, so the device is not idle while requests are queued.
+ *
+ * @note The driver must be installed with async_io.queue_size > 0
+ *
+ * @param[in]  device      Device handle
+ * @param[in]  lun         Logical Unit Number, 0 for single LUN devices
+ * @param[in]  sector      First sector
+ * @param[in]  num_sectors Number of sectors
+ * @param[out] data        Buffer for the data, it must stay valid until the callback is called
+ * @param[in]  callback    Completion callback, can be NULL
+ * @param[in]  arg         User argument of the callback
+ * @return
+ *    - ESP_OK: Request queued
+ *    - ESP_ERR_INVALID_ARG: Invalid arguments
+ *    - ESP_ERR_NOT_SUPPORTED: Asynchronous requests are disabled
+ *    - ESP_ERR_NO_MEM: The request queue is full, the request was not queued
+ */
+esp_err_t msc_host_read_sector_async(msc_host_device_handle_t device, uint8_t lun, uint64_t sector, uint32_t num_sectors,
+                                     void *data, msc_host_io_cb_t callback, void *arg);
+
+/**
+ * @brief Queue asynchronous write of sectors
+ *
+ * Same as msc_host_read_sector_async()
+ *
+ * @param[in] device      Device handle
+ * @param[in] lun         Logical Unit Number, 0 for single LUN devices
+ * @param[in] sector      First sector
+ * @param[in] num_sectors Number of sectors
+ * @param[in] data        Data to be written, it must stay valid until the callback is called
+ * @param[in] callback    Completion callback, can be NULL
+ * @param[in] arg         User argument of the callback
+ * @return See msc_host_read_sector_async()
+ */
+esp_err_t msc_host_write_sector_async(msc_host_device_handle_t device, uint8_t lun, uint64_t sector, uint32_t num_sectors,
+                                      const void *data, msc_host_io_cb_t callback, void *arg);
+
+/**
+ * @brief Queue barrier of asynchronous requests
+ *
+ * The callback is called when all previously queued requests completed, with the first error of them.
+ * When a request fails, following requests are not executed until the barrier, so no write after a failed one reaches the device.
+ *
+ * @param[in] device   Device handle
+ * @param[in] callback Completion callback, can be NULL
+ * @param[in] arg      User argument of the callback
+ * @return See msc_host_read_sector_async()
+ */
+esp_err_t msc_host_io_barrier(msc_host_device_handle_t device, msc_host_io_cb_t callback, void *arg);
+
 /**
  * @brief Handle MSC HOST events.
  *
@@ -151,6 +317,7 @@ __attribute__((deprecated("use API from esp_private/msc_scsi_bot.h")));
  *     - ESP_OK:          All events handled
  *     - ESP_ERR_TIMEOUT: No events handled within the timeout
  *     - ESP_FAIL:        Event handling finished, driver uninstalled. You do not have to call this function further
+ *     - ESP_ERR_INVALID_STATE: Driver not installed, or installed with shared_client
  */
 esp_err_t msc_host_handle_events(uint32_t timeout);
 
@@ -163,6 +330,19 @@ esp_err_t msc_host_handle_events(uint32_t timeout);
  */
 esp_err_t msc_host_get_device_info(msc_host_device_handle_t device, msc_host_device_info_t *info);
 
+/**
+ * @brief Gets information of a Logical Unit.
+ *
+ * Same as msc_host_get_device_info(), sector_count and sector_size are of the selected Logical Unit.
+ * msc_host_get_device_info() reports LUN 0.
+ *
+ * @param[in]  device  Handle to device
+ * @param[in]  lun     Logical Unit Number, less than lun_num of the device
+ * @param[out] info  Structure to be populated with device info
+ * @return esp_err_t
+ */
+esp_err_t msc_host_get_lun_info(msc_host_device_handle_t device, uint8_t lun, msc_host_device_info_t *info);
+
 /**
  * @brief Print configuration descriptor.
  *
@@ -171,6 +351,29 @@ esp_err_t msc_host_get_device_info(msc_host_device_handle_t device, msc_host_dev
  */
 esp_err_t msc_host_print_descriptors(msc_host_device_handle_t device);
 
+/**
+ * @brief Get statistics of MSC device
+ *
+ * Can be called from any task, also while transferring data.
+ *
+ * @param[in]  device    Handle of MSC device
+ * @param[out] stats_ret Device statistics
+ * @return
+ *   - ESP_OK: Success
+ *   - ESP_ERR_INVALID_ARG: device or stats_ret is NULL
+ */
+esp_err_t msc_host_get_stats(msc_host_device_handle_t device, msc_host_stats_t *stats_ret);
+
+/**
+ * @brief Reset statistics of MSC device
+ *
+ * @param[in] device Handle of MSC device
+ * @return
+ *   - ESP_OK: Success
+ *   - ESP_ERR_INVALID_ARG: device is NULL
+ */
+esp_err_t msc_host_reset_stats(msc_host_device_handle_t device);
+
 /**
  * @brief MSC Bulk Only Transport Reset Recovery
  *
@@ -0,0 +1,144 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "usb/msc_host.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct msc_host_blockdev *msc_host_blockdev_handle_t;   /**< Block device of a Logical Unit */
+
+/**
+ * @brief Block device configuration
+ */
+typedef struct {
+    size_t write_batch_size;    /**< Size of the write batch buffer in bytes, rounded down to the block size.
+                                     Sequential writes are collected in it and written by one command. 0: Writes are not batched */
+    msc_host_write_barrier_t write_barrier; /**< Write barrier of msc_host_blockdev_sync() and writes */
+} msc_host_blockdev_config_t;
+
+/**
+ * @brief Geometry of the block device
+ *
+ * Addresses and sizes of all operations must be multiples of block_size.
+ */
+typedef struct {
+    uint64_t disk_size;         /**< Size of the Logical Unit in bytes */
+    uint32_t block_size;        /**< Read, write and erase granularity in bytes, the logical block size of the Logical Unit */
+    size_t write_size;          /**< Recommended size of writes in bytes, the write batch size or block_size */
+    bool erase_supported;       /**< Erased blocks are unmapped, so the device can reclaim them. false: Erase has no effect */
+} msc_host_blockdev_geometry_t;
+
+/**
+ * @brief Open Logical Unit of MSC device as a raw block device
+ *
+ * The block device can host a filesystem other than FatFS, for example LittleFS.
+ *
+ * @note The Logical Unit must not be registered to VFS at the same time
+ * @note Operations of one block device are not thread safe, different block devices can be used concurrently
+ *
+ * @param[in]  device   Device handle obtained from MSC callback provided upon initialization
+ * @param[in]  lun      Logical Unit Number, 0 for single LUN devices
+ * @param[in]  config   Block device configuration, NULL: Default configuration without write batching
+ * @param[out] blockdev Block device handle
+ * @return
+ *    - ESP_OK: Block device opened
+ *    - ESP_ERR_INVALID_ARG: Invalid arguments or LUN
+ *    - ESP_ERR_NOT_FOUND: No medium in the Logical Unit
+ *    - ESP_ERR_NO_MEM: Not enough memory
+ */
+esp_err_t msc_host_blockdev_open(msc_host_device_handle_t device, uint8_t lun, const msc_host_blockdev_config_t *config,
+                                 msc_host_blockdev_handle_t *blockdev);
+
+/**
+ * @brief Close block device
+ *
+ * Batched writes are written to the device first.
+ *
+ * @param[in] blockdev Block device handle
+ * @return
+ *    - ESP_OK: Block device closed
+ *    - ESP_ERR_INVALID_ARG: Invalid argument
+ *    - Other: Writing of batched data failed, the block device is closed anyway
+ */
+esp_err_t msc_host_blockdev_close(msc_host_blockdev_handle_t blockdev);
+
+/**
+ * @brief Get geometry of block device
+ *
+ * @param[in]  blockdev Block device handle
+ * @param[out] geometry Geometry of the block device
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Invalid arguments
+ */
+esp_err_t msc_host_blockdev_get_geometry(msc_host_blockdev_handle_t blockdev, msc_host_blockdev_geometry_t *geometry);
+
+/**
+ * @brief Read from block device
+ *
+ * @param[in]  blockdev Block device handle
+ * @param[in]  addr     Address in bytes
+ * @param[out] data     Buffer of read data
+ * @param[in]  size     Size to read in bytes
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_INVALID_ARG: Invalid arguments or range beyond the end of the device
+ *    - ESP_ERR_INVALID_SIZE: Address or size is not a multiple of block size
+ *    - Other: Command failed
+ */
+esp_err_t msc_host_blockdev_read(msc_host_blockdev_handle_t blockdev, uint64_t addr, void *data, size_t size);
+
+/**
+ * @brief Write to block device
+ *
+ * With write batching, data continuing the previous write are copied to the batch buffer.
+ * The batch is written by one command when it is full, on a non-sequential write, erase or sync.
+ *
+ * @param[in] blockdev Block device handle
+ * @param[in] addr     Address in bytes
+ * @param[in] data     Data to be written
+ * @param[in] size     Size to write in bytes
+ * @return See msc_host_blockdev_read(). Errors of a batched write may be reported by a later call
+ */
+esp_err_t msc_host_blockdev_write(msc_host_blockdev_handle_t blockdev, uint64_t addr, const void *data, size_t size);
+
+/**
+ * @brief Erase blocks of block device
+ *
+ * Erased blocks are unmapped if the device supports it, their content is undefined afterwards.
+ * Magnetic drives and devices without unmapping keep the data, which is not an error.
+ *
+ * @param[in] blockdev Block device handle
+ * @param[in] addr     Address in bytes
+ * @param[in] size     Size to erase in bytes
+ * @return See msc_host_blockdev_read()
+ */
+esp_err_t msc_host_blockdev_erase(msc_host_blockdev_handle_t blockdev, uint64_t addr, uint64_t size);
+
+/**
+ * @brief Write batched data to the device and its cache to the medium
+ *
+ * Depending on the write barrier, the drive's cache is written to the medium by SYNCHRONIZE CACHE.
+ *
+ * @param[in] blockdev Block device handle
+ * @return
+ *    - ESP_OK: All data written
+ *    - ESP_ERR_INVALID_ARG: Invalid argument
+ *    - Other: Command failed
+ */
+esp_err_t msc_host_blockdev_sync(msc_host_blockdev_handle_t blockdev);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
@@ -16,6 +16,35 @@ extern "C" {
 
 typedef struct msc_host_vfs *msc_host_vfs_handle_t;           /**< VFS handle to attached Mass Storage device */
 
+/**
+ * @brief Sector cache between FatFS and the MSC device
+ *
+ * Single-sector accesses, which FatFS uses for FAT, directory and partial file sectors, are kept in LRU cache.
+ * Multi-sector file data bypass the cache. Raw access by msc_host_read_sector() and msc_host_write_sector() is not cached.
+ */
+typedef struct {
+    size_t sector_num;          /**< Number of cached sectors. 0: Cache disabled */
+    size_t read_ahead_sectors;  /**< Number of sectors read by one command on sequential single-sector reads, up to sector_num. 0: No read-ahead */
+    bool write_back;            /**< Keep written sectors in cache until FatFS syncs the volume (f_sync(), fclose()) or they are evicted,
+                                     contiguous sectors are then written by one command. false: Write-through */
+    msc_host_write_barrier_t write_barrier; /**< Write barrier of FatFS sync, applies also with sector_num 0 */
+} msc_host_vfs_cache_config_t;
+
+/**
+ * @brief Formatting configuration
+ *
+ * FatFS writes only the boot sector, FAT and root directory, the data area is not written.
+ * The FAT is zeroed by writes of workbuf_size, so a larger work buffer means fewer and longer WRITE commands.
+ */
+typedef struct {
+    size_t workbuf_size;        /**< Size of the work buffer in DMA capable memory, rounded down to a multiple of the sector size.
+                                     0: MSC_HOST_VFS_FORMAT_WORKBUF_DEFAULT */
+    bool unmap;                 /**< Unmap the whole Logical Unit before formatting, if the device supports UNMAP or WRITE SAME(16).
+                                     The device then discards the old data instead of keeping them as used blocks */
+} msc_host_vfs_format_config_t;
+
+#define MSC_HOST_VFS_FORMAT_WORKBUF_DEFAULT (4096) /**< Work buffer size of msc_host_vfs_format() */
+
 /**
  * @brief Format MSC device.
  *
@@ -30,9 +59,30 @@ typedef struct msc_host_vfs *msc_host_vfs_handle_t;           /**< VFS handle to
  */
 esp_err_t msc_host_vfs_format(msc_host_device_handle_t device, const esp_vfs_fat_mount_config_t *mount_config, const msc_host_vfs_handle_t vfs_handle);
 
+/**
+ * @brief Format MSC device with formatting configuration.
+ *
+ * @param[in] device Device handle obtained from MSC callback provided upon initialization
+ * @param[in] mount_config Mount configuration
+ * @param[in] format_config Formatting configuration. NULL: Same as msc_host_vfs_format()
+ * @param[in] vfs_handle Handle to MSC device associated with registered VFS
+ * @return
+ *    - ESP_OK: Format completed
+ *    - ESP_ERR_INVALID_ARG: Invalid arguments, or work buffer smaller than one sector
+ *    - ESP_ERR_NO_MEM: Not enough DMA capable memory for the work buffer
+ *    - ESP_ERR_MSC_FORMAT_FAILED: Formatting failed
+ */
+esp_err_t msc_host_vfs_format_with_config(msc_host_device_handle_t device,
+                                          const esp_vfs_fat_mount_config_t *mount_config,
+                                          const msc_host_vfs_format_config_t *format_config,
+                                          const msc_host_vfs_handle_t vfs_handle);
+
 /**
  * @brief Register MSC device to Virtual filesystem.
  *
+ * FatFS sync (f_sync(), fsync(), fclose()) writes the drive's cache to the medium by SYNCHRONIZE CACHE.
+ * Logical Unit 0 is registered, see msc_host_vfs_register_lun() for multi-LUN devices.
+ *
  * @param[in]  device  Device handle obtained from MSC callback provided upon initialization
  * @param[in]  base_path Base VFS path to be used to access file storage
  * @param[in]  mount_config Mount configuration.
@@ -45,6 +95,130 @@ esp_err_t msc_host_vfs_register(msc_host_device_handle_t device,
                                 msc_host_vfs_handle_t *vfs_handle);
 
 
+/**
+ * @brief Register MSC device to Virtual filesystem with sector cache.
+ *
+ * @note With write_back cache, written data reach the device when the file is synced or closed.
+ *
+ * @param[in]  device  Device handle obtained from MSC callback provided upon initialization
+ * @param[in]  base_path Base VFS path to be used to access file storage
+ * @param[in]  mount_config Mount configuration.
+ * @param[in]  cache_config Sector cache configuration. NULL: No cache, same as msc_host_vfs_register()
+ * @param[out] vfs_handle Handle to MSC device associated with registered VFS
+ * @return esp_err_t
+ */
+esp_err_t msc_host_vfs_register_with_cache(msc_host_device_handle_t device,
+                                           const char *base_path,
+                                           const esp_vfs_fat_mount_config_t *mount_config,
+                                           const msc_host_vfs_cache_config_t *cache_config,
+                                           msc_host_vfs_handle_t *vfs_handle);
+
+/**
+ * @brief Register Logical Unit of MSC device to Virtual filesystem.
+ *
+ * Each Logical Unit, like a slot of a card reader, is a separate FatFS drive.
+ * Logical Units of one device can be accessed concurrently, their commands are interleaved.
+ *
+ * @param[in]  device  Device handle obtained from MSC callback provided upon initialization
+ * @param[in]  lun     Logical Unit Number, less than lun_num of msc_host_device_info_t
+ * @param[in]  base_path Base VFS path to be used to access file storage
+ * @param[in]  mount_config Mount configuration.
+ * @param[in]  cache_config Sector cache configuration. NULL: No cache
+ * @param[out] vfs_handle Handle to MSC device associated with registered VFS
+ * @return
+ *    - ESP_OK: Logical Unit registered
+ *    - ESP_ERR_INVALID_ARG: Invalid arguments or LUN
+ *    - ESP_ERR_NOT_FOUND: No medium in the Logical Unit
+ *    - Other: Registration or mount failed
+ */
+esp_err_t msc_host_vfs_register_lun(msc_host_device_handle_t device,
+                                    uint8_t lun,
+                                    const char *base_path,
+                                    const esp_vfs_fat_mount_config_t *mount_config,
+                                    const msc_host_vfs_cache_config_t *cache_config,
+                                    msc_host_vfs_handle_t *vfs_handle);
+
+typedef struct msc_host_vfs_extent *msc_host_vfs_extent_handle_t; /**< Handle to preallocated contiguous file */
+
+/**
+ * @brief Contiguous extent of a preallocated file
+ */
+typedef struct {
+    uint8_t lun;                /**< Logical Unit of the file */
+    uint64_t first_sector;      /**< LBA of the first sector of the file */
+    uint32_t sector_num;        /**< Number of preallocated sectors */
+    uint32_t sector_size;       /**< Sector size in bytes */
+    uint64_t written;           /**< Bytes written by msc_host_vfs_extent_write() */
+} msc_host_vfs_extent_info_t;
+
+/**
+ * @brief Create file with preallocated contiguous extent
+ *
+ * The file is created, or truncated if it exists, and its clusters are allocated in one contiguous run by FatFS f_expand().
+ * Data are then written by msc_host_vfs_extent_write() directly to the sectors of the extent, without FatFS, sector cache
+ * or FAT updates, so recording runs by long WRITE commands at the speed of the drive.
+ *
+ * @note The file must not be opened through VFS until msc_host_vfs_extent_close()
+ * @note The sectors can also be written by msc_host_write_sector_async() within the range from msc_host_vfs_extent_get_info()
+ *
+ * @param[in]  vfs_handle Handle to MSC device associated with registered VFS
+ * @param[in]  path       Path of the file, starting with base_path of the VFS
+ * @param[in]  size       Size to preallocate in bytes
+ * @param[out] extent     Handle to the preallocated file
+ * @return
+ *    - ESP_OK: File created and preallocated
+ *    - ESP_ERR_INVALID_ARG: Invalid arguments, or path outside of the VFS
+ *    - ESP_ERR_INVALID_SIZE: Size is 0 or over the maximum file size of FatFS
+ *    - ESP_ERR_NOT_SUPPORTED: FatFS is built without FF_USE_EXPAND
+ *    - ESP_ERR_NO_MEM: Not enough memory
+ *    - ESP_FAIL: The file could not be created, or there is no contiguous free space of the size
+ */
+esp_err_t msc_host_vfs_extent_open(msc_host_vfs_handle_t vfs_handle, const char *path, uint64_t size,
+                                   msc_host_vfs_extent_handle_t *extent);
+
+/**
+ * @brief Write data after the previously written data of the extent
+ *
+ * The data are written by one command per call, split only by the transfer size of the driver.
+ * Size must be a multiple of the sector size, except for the last write, whose last sector is padded by zeros.
+ *
+ * @param[in] extent Handle to the preallocated file
+ * @param[in] data   Data to write. DMA capable buffers are transferred without copying
+ * @param[in] size   Size of data in bytes
+ * @return
+ *    - ESP_OK: Data written
+ *    - ESP_ERR_INVALID_ARG: Invalid arguments
+ *    - ESP_ERR_INVALID_SIZE: Data exceed the extent
+ *    - ESP_ERR_INVALID_STATE: The last write was not a multiple of the sector size
+ *    - Other: Write failed
+ */
+esp_err_t msc_host_vfs_extent_write(msc_host_vfs_extent_handle_t extent, const void *data, size_t size);
+
+/**
+ * @brief Get extent of the preallocated file
+ *
+ * @param[in]  extent Handle to the preallocated file
+ * @param[out] info   Extent of the file
+ * @return
+ *    - ESP_OK: Info filled
+ *    - ESP_ERR_INVALID_ARG: Invalid arguments
+ */
+esp_err_t msc_host_vfs_extent_get_info(msc_host_vfs_extent_handle_t extent, msc_host_vfs_extent_info_t *info);
+
+/**
+ * @brief Truncate the file to written data and close it
+ *
+ * The file size is set to the bytes written by msc_host_vfs_extent_write(), unused clusters of the extent are freed.
+ * The handle is freed even if the file could not be truncated.
+ *
+ * @param[in] extent Handle to the preallocated file
+ * @return
+ *    - ESP_OK: File closed
+ *    - ESP_ERR_INVALID_ARG: Invalid arguments
+ *    - ESP_FAIL: Truncating or closing the file failed
+ */
+esp_err_t msc_host_vfs_extent_close(msc_host_vfs_extent_handle_t extent);
+
 /**
  * @brief Unregister MSC device from Virtual filesystem.
  *
@@ -6,18 +6,123 @@
 
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "usb/msc_host.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef struct usb_disk_cache usb_disk_cache_t;
+
+#define USB_DISK_TRIM_BATCH 4 // Number of pending unmapped ranges, contiguous ranges are merged
+
+/**
+ * @brief Command unmapping sectors freed by FatFS
+ */
+typedef enum {
+    USB_DISK_TRIM_NONE,         /**< Unmapping is not supported */
+    USB_DISK_TRIM_UNMAP,        /**< UNMAP */
+    USB_DISK_TRIM_WRITE_SAME,   /**< WRITE SAME(16) with UNMAP bit */
+} usb_disk_trim_t;
+
+/**
+ * @brief Range of sectors
+ */
+typedef struct {
+    uint64_t sector;        /**< First sector */
+    uint32_t count;         /**< Number of sectors */
+} usb_disk_range_t;
+
 /**
  * @brief Mass storage disk initialization structure
  */
 typedef struct {
     uint32_t block_size;    /**< Block size */
-    uint32_t block_count;   /**< Block count */
+    uint64_t block_count;   /**< Block count, 0 if the Logical Unit has no medium */
+    uint8_t phys_block_exp; /**< Logical blocks per physical block exponent, detected by usb_disk_detect_alignment() */
+    uint16_t aligned_lba;   /**< First logical block aligned to a physical block */
+    uint8_t lun;            /**< Logical Unit Number */
+    bool removable;         /**< Removable medium, reported by INQUIRY */
+    bool write_protected;   /**< The device rejected a write with DATA PROTECT sense key */
+    msc_host_write_barrier_t barrier; /**< Write barrier of CTRL_SYNC */
+    bool sync_cache_rejected; /**< The device rejected SYNCHRONIZE CACHE, it has no volatile write cache */
+    usb_disk_cache_t *cache; /**< Sector cache, NULL if disabled */
+    usb_disk_trim_t trim;   /**< Unmapping command, detected by usb_disk_detect_trim() */
+    uint32_t trim_max_sectors; /**< Maximum sectors of one unmapping command, 0: No limit */
+    uint8_t trim_max_ranges; /**< Maximum ranges of one UNMAP command */
+    uint8_t trim_num;       /**< Number of pending ranges */
+    usb_disk_range_t trim_pending[USB_DISK_TRIM_BATCH]; /**< Ranges freed by FatFS, not unmapped yet */
 } usb_disk_t;
 
+/**
+ * @brief Detect unmapping command of the disk from its VPD pages
+ *
+ * Logical Block Provisioning VPD page tells whether UNMAP or WRITE SAME(16) with UNMAP bit is supported,
+ * Block Limits VPD page limits one command. Devices without VPD pages do not support unmapping.
+ *
+ * @param[in] disk usb_disk_t structure with known block size
+ */
+void usb_disk_detect_trim(usb_disk_t *disk);
+
+/**
+ * @brief Detect physical block size of the disk from READ CAPACITY(16)
+ *
+ * 512e drives have 4096 byte physical sectors, partial writes of a physical sector are read-modify-write in the drive.
+ * Devices without READ CAPACITY(16) are assumed to have physical blocks of the logical block size.
+ *
+ * @param[in] disk usb_disk_t structure with known block size
+ */
+void usb_disk_detect_alignment(usb_disk_t *disk);
+
+/**
+ * @brief Write sectors to the disk, metadata with Force Unit Access if the write barrier of the disk requires it
+ *
+ * @param[in] disk     usb_disk_t structure
+ * @param[in] data     Data to be written
+ * @param[in] sector   First sector
+ * @param[in] count    Number of sectors
+ * @param[in] metadata The sectors are filesystem metadata
+ * @return esp_err_t
+ */
+esp_err_t usb_disk_write_sectors(usb_disk_t *disk, const uint8_t *data, uint64_t sector, uint32_t count, bool metadata);
+
+/**
+ * @brief Write volatile cache of the drive to the medium according to the write barrier of the disk
+ *
+ * Devices rejecting SYNCHRONIZE CACHE have no volatile cache, the command is not sent to them again.
+ *
+ * @param[in] disk usb_disk_t structure
+ * @return esp_err_t
+ */
+esp_err_t usb_disk_sync(usb_disk_t *disk);
+
+/**
+ * @brief Unmap ranges of sectors
+ *
+ * Ranges are split by the limits of the disk. Unmapping is disabled for the disk if a command fails.
+ *
+ * @param[in] disk      usb_disk_t structure
+ * @param[in] ranges    Ranges of sectors
+ * @param[in] range_num Number of ranges
+ * @return
+ *    - ESP_OK: Ranges unmapped
+ *    - ESP_ERR_NOT_SUPPORTED: The disk does not support unmapping
+ *    - Other: Command failed
+ */
+esp_err_t usb_disk_unmap(usb_disk_t *disk, const usb_disk_range_t *ranges, size_t range_num);
+
+/**
+ * @brief Unmap pending ranges freed by FatFS
+ *
+ * @param[in] disk usb_disk_t structure
+ * @return esp_err_t
+ */
+esp_err_t usb_disk_trim_flush(usb_disk_t *disk);
+
 /**
  * @brief Register mass storage disk to fat file system
  *
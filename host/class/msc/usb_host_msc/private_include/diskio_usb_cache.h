@@ -0,0 +1,79 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "diskio_usb.h"
+#include "usb/msc_host_vfs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Create sector cache of the disk
+ *
+ * @param[in] disk   Disk, the cache is attached to disk->cache
+ * @param[in] config Cache configuration, sector_num must not be 0
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_NO_MEM: Not enough memory
+ */
+esp_err_t usb_disk_cache_create(usb_disk_t *disk, const msc_host_vfs_cache_config_t *config);
+
+/**
+ * @brief Write dirty sectors and delete the cache of the disk
+ *
+ * @param[in] disk Disk, can have no cache
+ */
+void usb_disk_cache_delete(usb_disk_t *disk);
+
+/**
+ * @brief Read sectors through the cache
+ *
+ * @param[in]  disk   Disk with cache
+ * @param[out] buff   Data buffer
+ * @param[in]  sector First sector
+ * @param[in]  count  Number of sectors
+ * @return esp_err_t
+ */
+esp_err_t usb_disk_cache_read(usb_disk_t *disk, uint8_t *buff, uint64_t sector, uint32_t count);
+
+/**
+ * @brief Write sectors through the cache
+ *
+ * @param[in] disk   Disk with cache
+ * @param[in] buff   Data buffer
+ * @param[in] sector First sector
+ * @param[in] count  Number of sectors
+ * @return esp_err_t
+ */
+esp_err_t usb_disk_cache_write(usb_disk_t *disk, const uint8_t *buff, uint64_t sector, uint32_t count);
+
+/**
+ * @brief Write dirty sectors to the device
+ *
+ * Contiguous dirty sectors are written by one command.
+ *
+ * @param[in] disk Disk with cache
+ * @return esp_err_t
+ */
+esp_err_t usb_disk_cache_flush(usb_disk_t *disk);
+
+/**
+ * @brief Drop all cached sectors without writing them
+ *
+ * Used when the content of the disk is replaced, e.g. by formatting.
+ *
+ * @param[in] disk Disk, the cache is optional
+ */
+void usb_disk_cache_invalidate(usb_disk_t *disk);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
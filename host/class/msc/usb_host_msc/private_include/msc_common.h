@@ -7,13 +7,30 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <sys/queue.h>
 #include "esp_err.h"
 #include "esp_check.h"
+#include "esp_heap_caps.h"
 #include "diskio_usb.h"
 #include "usb/usb_host.h"
 #include "usb/usb_types_stack.h"
+#include "usb/msc_host.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
+
+// Disk caches and driver structures are accounted in the memory footprint of usb_host_shared_client,
+// and taken from the arenas of its static allocation mode if it is installed. From heap otherwise
+#if USB_HOST_SHARED_CLIENT_ENABLED
+#include "usb/usb_host_mem.h"
+#define MSC_MALLOC(category, size, caps)  usb_host_mem_malloc(USB_HOST_MEM_DRIVER_MSC, USB_HOST_MEM_##category, size, caps)
+#define MSC_CALLOC(category, n, size)     usb_host_mem_calloc(USB_HOST_MEM_DRIVER_MSC, USB_HOST_MEM_##category, n, size, MALLOC_CAP_DEFAULT)
+#define MSC_FREE(category, ptr, size)     usb_host_mem_free(USB_HOST_MEM_DRIVER_MSC, USB_HOST_MEM_##category, ptr, size)
+#else
+#define MSC_MALLOC(category, size, caps)  heap_caps_malloc(size, caps)
+#define MSC_CALLOC(category, n, size)     calloc(n, size)
+#define MSC_FREE(category, ptr, size)     ((void)(size), free(ptr))
+#endif
 
 #ifdef __cplusplus
 extern "C"
@@ -25,22 +42,123 @@ typedef enum {
     MSC_EP_IN
 } msc_endpoint_t;
 
+typedef enum {
+    MSC_TRANSPORT_BOT,  // Bulk-Only Transport
+    MSC_TRANSPORT_UAS,  // USB Attached SCSI
+} msc_transport_t;
+
+#define MSC_UAS_MAX_COMMANDS 4 // Maximum number of UAS commands in flight, each with its own tag
+#define MSC_MAX_LUN_NUM 16     // Bulk-Only Transport addresses up to 16 Logical Units
+
 typedef struct {
-    uint16_t bulk_in_mps;
+    msc_transport_t transport;
+    uint16_t bulk_in_mps;   // Bulk-In, or UAS Data-In pipe
     uint8_t bulk_in_ep;
-    uint8_t bulk_out_ep;
+    uint8_t bulk_out_ep;    // Bulk-Out, or UAS Data-Out pipe
     uint8_t iface_num;
+    uint8_t alt_setting;
+    uint16_t uas_status_mps;
+    uint8_t uas_status_ep;
+    uint8_t uas_cmd_ep;
 } msc_config_t;
 
+/**
+ * @brief Transfer of data phase
+ *
+ * The transfer points to the caller's buffer if the USB DMA can access it, otherwise the data are copied through its own buffer.
+ */
+typedef struct {
+    usb_transfer_t *xfer;
+    uint8_t *buffer;            // Own buffer of the transfer, restored after transfers pointing to the caller's buffer
+} msc_data_xfer_t;
+
+/**
+ * @brief State of UAS transport
+ */
+typedef struct {
+    usb_transfer_t *status_xfer;                    // Status pipe: READ READY, WRITE READY, SENSE and RESPONSE IUs
+    usb_transfer_t *cmd_xfer[MSC_UAS_MAX_COMMANDS]; // Command pipe: COMMAND IU of each tag
+    uint8_t sense[18];                              // Sense data of the last failed command, reported in its SENSE IU
+    uint8_t sense_len;
+} msc_uas_t;
+
+/**
+ * @brief SCSI command of UAS transport
+ */
+typedef struct {
+    const uint8_t *cdb;     // Command Descriptor Block
+    uint8_t cdb_len;
+    uint8_t *data;          // Data buffer. Direction depends on 'ep'. Can be NULL if size is 0
+    size_t size;
+    msc_endpoint_t ep;
+    uint8_t lun;
+} msc_uas_cmd_t;
+
+/**
+ * @brief Timeouts of commands
+ *
+ * Adaptive timeouts expect the latency of a command from the smoothed latency of commands without data
+ * and the smoothed data time per kB of the previous commands.
+ */
+typedef struct {
+    uint32_t cmd_ms;            // Time to wait for completion of one transfer of the command in progress
+    bool adaptive;              // Timeouts are derived from the observed latency
+    bool recovering;            // Reset recovery after a timeout is in progress
+    uint8_t cmd_samples;        // Number of latency samples of commands without data, up to MSC_TIMEOUT_SAMPLES
+    uint8_t data_samples;       // Number of latency samples of data commands, up to MSC_TIMEOUT_SAMPLES
+    uint8_t backoff_shift;      // Adaptive timeout is doubled after each timeout, until a command succeeds
+    uint8_t failures;           // Consecutive timed out commands
+    uint32_t avg_cmd_us;        // Smoothed latency of commands without data
+    uint32_t avg_us_per_kb;     // Smoothed data time per kB
+    uint32_t fail_backoff_ms;   // Commands fail at once for this time after MSC_FAST_FAIL_THRESHOLD timeouts, doubled after each failed probe
+    TickType_t fail_until;      // End of the fast-fail period
+} msc_timeout_t;
+
+typedef struct msc_async msc_async_t;
+
 typedef struct msc_host_device {
     STAILQ_ENTRY(msc_host_device) tailq_entry;
-    SemaphoreHandle_t transfer_done;
+    QueueHandle_t transfer_done;    // Completed transfers
     usb_device_handle_t handle;
-    usb_transfer_t *xfer;
+    usb_transfer_t *xfer;           // Control transfers, CBW and short OUT transfers
+    usb_transfer_t *csw_xfer;       // CSW and short IN transfers
+    msc_data_xfer_t *data_xfer; // Preallocated transfers of data phase
+    int data_xfer_num;
+    msc_uas_t uas;              // UAS transport only
     msc_config_t config;
-    usb_disk_t disk;
+    SemaphoreHandle_t lock;     // Recursive mutex held for one command and its REQUEST SENSE, commands to different LUNs are interleaved
+    uint8_t lun_num;
+    usb_disk_t disk[MSC_MAX_LUN_NUM]; // Logical Units, disk[lun].lun == lun
+    msc_async_t *async;         // Worker of asynchronous requests, NULL if disabled
+    uint32_t transfer_timeout_ms; // Time to wait for completion of one transfer, configured maximum
+    msc_timeout_t timeout;
+    msc_host_stats_t stats;
+    bool suspended;             // Bus is suspended, commands fail with ESP_ERR_INVALID_STATE. Protected by lock
 } msc_device_t;
 
+/**
+ * @brief Get MSC device of the Logical Unit
+ */
+static inline msc_device_t *msc_disk_to_device(usb_disk_t *disk)
+{
+    return __containerof(disk - disk->lun, msc_device_t, disk);
+}
+
+/**
+ * @brief Take exclusive access to the transport of the device
+ *
+ * The lock is recursive, so a sequence of commands can be executed atomically.
+ */
+static inline void msc_device_lock(msc_device_t *device)
+{
+    xSemaphoreTakeRecursive(device->lock, portMAX_DELAY);
+}
+
+static inline void msc_device_unlock(msc_device_t *device)
+{
+    xSemaphoreGiveRecursive(device->lock);
+}
+
 /**
  * @brief Trigger a BULK transfer to device
  *
@@ -54,6 +172,42 @@ typedef struct msc_host_device {
  */
 esp_err_t msc_bulk_transfer(msc_device_t *device_handle, uint8_t *data, size_t size, msc_endpoint_t ep);
 
+/**
+ * @brief Execute Bulk-Only Transport of one command
+ *
+ * Command, data and status transfers are queued at once, the data are split to the data transfers of the device.
+ *
+ * @param[in]    device_handle MSC device handle
+ * @param[in]    cbw           Command Block Wrapper
+ * @param[in]    cbw_len       Length of CBW
+ * @param[inout] data          Data buffer. Direction depends on 'ep'. Can be NULL if size is 0
+ * @param[in]    size          Size of data in bytes
+ * @param[in]    ep            Direction of the data transport
+ * @param[out]   csw           Command Status Wrapper
+ * @param[in]    csw_len       Length of CSW
+ * @param[out]   csw_err       Result of status transport
+ * @return Result of command and data transport
+ */
+esp_err_t msc_bot_transfer(msc_device_t *device_handle, const uint8_t *cbw, size_t cbw_len,
+                           uint8_t *data, size_t size, msc_endpoint_t ep,
+                           uint8_t *csw, size_t csw_len, esp_err_t *csw_err);
+
+/**
+ * @brief Execute USB Attached SCSI commands
+ *
+ * All commands are queued at once with their own tags, so the device can prepare the next command
+ * while the data of the previous one are transferred. The device selects the order of the data phases.
+ *
+ * @param[in] device_handle MSC device handle
+ * @param[in] cmds          Commands
+ * @param[in] num           Number of commands, up to MSC_UAS_MAX_COMMANDS
+ * @return
+ *    - ESP_OK: All commands succeeded
+ *    - ESP_FAIL: A command failed, its sense data are kept in device_handle->uas
+ *    - Other: Transport failed
+ */
+esp_err_t msc_uas_transfer(msc_device_t *device_handle, const msc_uas_cmd_t *cmds, int num);
+
 /**
  * @brief Trigger a CTRL transfer to device
  *
@@ -74,6 +228,24 @@ esp_err_t msc_control_transfer(msc_device_t *device_handle, size_t len);
  */
 esp_err_t clear_feature(msc_device_t *device, uint8_t endpoint);
 
+/**
+ * @brief Start worker task of asynchronous requests of the device
+ *
+ * @param[in] device MSC device handle
+ * @param[in] config Configuration of the worker, queue_size must be greater than 0
+ * @return
+ *    - ESP_OK: Worker started, device->async is set
+ *    - ESP_ERR_NO_MEM: Not enough memory
+ */
+esp_err_t msc_async_start(msc_device_t *device, const msc_host_async_io_config_t *config);
+
+/**
+ * @brief Execute queued asynchronous requests and stop the worker task
+ *
+ * @param[in] device MSC device handle, can have no worker
+ */
+void msc_async_stop(msc_device_t *device);
+
 #define MSC_GOTO_ON_ERROR(exp) ESP_GOTO_ON_ERROR(exp, fail, TAG, "")
 
 #define MSC_GOTO_ON_FALSE(exp, err) ESP_GOTO_ON_FALSE( (exp), err, fail, TAG, "" )
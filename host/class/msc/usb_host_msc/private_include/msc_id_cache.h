@@ -0,0 +1,87 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "diskio_usb.h"
+#include "msc_common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct msc_id_cache msc_id_cache_t;
+
+/**
+ * @brief Identification of a Logical Unit
+ */
+typedef struct {
+    bool valid;                 /**< The Logical Unit was identified */
+    bool removable;             /**< Removable medium, its capacity is read again */
+    uint32_t block_size;        /**< Block size */
+    uint64_t block_count;       /**< Block count */
+    uint8_t phys_block_exp;     /**< Logical blocks per physical block exponent */
+    uint16_t aligned_lba;       /**< First logical block aligned to a physical block */
+    usb_disk_trim_t trim;       /**< Unmapping command */
+    uint32_t trim_max_sectors;  /**< Maximum sectors of one unmapping command */
+    uint8_t trim_max_ranges;    /**< Maximum ranges of one UNMAP command */
+} msc_id_lun_t;
+
+/**
+ * @brief Identification of a device
+ */
+typedef struct {
+    uint8_t lun_num;                    /**< Number of Logical Units */
+    msc_id_lun_t lun[MSC_MAX_LUN_NUM];  /**< Logical Units */
+} msc_id_t;
+
+/**
+ * @brief Create cache of device identification
+ *
+ * Devices are looked up by VID, PID and serial number. The least recently used device is replaced.
+ *
+ * @param[in]  size      Number of cached devices
+ * @param[out] cache_ret Cache
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_NO_MEM: Not enough memory
+ */
+esp_err_t msc_id_cache_create(size_t size, msc_id_cache_t **cache_ret);
+
+/**
+ * @brief Delete cache of device identification
+ *
+ * @param[in] cache Cache, can be NULL
+ */
+void msc_id_cache_delete(msc_id_cache_t *cache);
+
+/**
+ * @brief Find identification of the device
+ *
+ * @param[in]  cache  Cache
+ * @param[in]  device Opened MSC device
+ * @param[out] id     Identification of the device
+ * @return true if the device was identified before. Devices without serial number are never found
+ */
+bool msc_id_cache_find(msc_id_cache_t *cache, const msc_device_t *device, msc_id_t *id);
+
+/**
+ * @brief Store identification of the installed device
+ *
+ * Logical Units without medium are not stored, they are identified again.
+ *
+ * @param[in] cache  Cache
+ * @param[in] device Installed MSC device
+ */
+void msc_id_cache_store(msc_id_cache_t *cache, const msc_device_t *device);
+
+#ifdef __cplusplus
+}
+#endif //__cplusplus
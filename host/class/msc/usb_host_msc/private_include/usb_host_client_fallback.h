@@ -0,0 +1,30 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/**
+ * @brief USB Host Library calls of the driver built without usb_host_shared_client
+ *
+ * Same macros as usb/usb_host_client_macros.h of usb_host_shared_client component, calling the USB Host Library directly.
+ */
+
+#include <stdlib.h>
+#include "usb/usb_host.h"
+
+#define CLIENT_DEVICE_OPEN      usb_host_device_open
+#define CLIENT_DEVICE_CLOSE     usb_host_device_close
+#define CLIENT_TRANSFER_ALLOC   usb_host_transfer_alloc
+#define CLIENT_TRANSFER_FREE    usb_host_transfer_free
+#define CLIENT_TRANSFER_SUBMIT          usb_host_transfer_submit
+#define CLIENT_TRANSFER_SUBMIT_CONTROL  usb_host_transfer_submit_control
+#define CLIENT_TRACE(event, ep, len, id)    ((void)0)
+#define CLIENT_TRACE_COMPLETE(xfer)         ((void)0)
+#define CLIENT_MALLOC(category, size)       malloc(size)
+#define CLIENT_CALLOC(category, n, size)    calloc(n, size)
+#define CLIENT_FREE(category, ptr, size)    ((void)(size), free(ptr))
+#define CLIENT_MEM_ALLOC(category, size)    ((void)0)
+#define CLIENT_MEM_FREE(category, size)     ((void)0)
@@ -4,11 +4,14 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <sys/param.h>
+#include <inttypes.h>
 #include "diskio_impl.h"
 #include "ffconf.h"
 #include "ff.h"
 #include "esp_log.h"
 #include "diskio_usb.h"
+#include "diskio_usb_cache.h"
 #include "msc_scsi_bot.h"
 #include "msc_common.h"
 #include "usb/usb_types_stack.h"
@@ -17,6 +20,198 @@ static usb_disk_t *s_disks[FF_VOLUMES] = { NULL };
 
 static const char *TAG = "diskio_usb";
 
+#define VPD_SUPPORTED_PAGES             0x00
+#define VPD_BLOCK_LIMITS                0xB0
+#define VPD_LOGICAL_BLOCK_PROVISIONING  0xB2
+#define VPD_PAGE_MAX_SIZE               64
+#define VPD_LBPU                        (1 << 7) // UNMAP supported
+#define VPD_LBPWS                       (1 << 6) // WRITE SAME(16) with UNMAP bit supported
+#define USB_DISK_PHYS_BLOCK_EXP_MAX     (7)      // Physical blocks of up to 128 logical blocks
+
+static uint32_t get_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+void usb_disk_detect_trim(usb_disk_t *disk)
+{
+    msc_device_t *dev = msc_disk_to_device(disk);
+    uint8_t page[VPD_PAGE_MAX_SIZE];
+    size_t size = sizeof(page);
+    bool block_limits = false;
+    bool provisioning = false;
+
+    disk->trim = USB_DISK_TRIM_NONE;
+    disk->trim_num = 0;
+    if (scsi_cmd_inquiry_vpd(dev, disk->lun, VPD_SUPPORTED_PAGES, page, &size) != ESP_OK) {
+        return;
+    }
+    for (size_t i = 4; i < size; i++) {
+        block_limits |= (page[i] == VPD_BLOCK_LIMITS);
+        provisioning |= (page[i] == VPD_LOGICAL_BLOCK_PROVISIONING);
+    }
+
+    size = sizeof(page);
+    if (!provisioning || scsi_cmd_inquiry_vpd(dev, disk->lun, VPD_LOGICAL_BLOCK_PROVISIONING, page, &size) != ESP_OK || size < 6) {
+        return;
+    }
+    const bool unmap = page[5] & VPD_LBPU;
+    const bool write_same = page[5] & VPD_LBPWS;
+
+    uint32_t max_sectors = UINT32_MAX;    // Maximum UNMAP LBA count
+    uint32_t max_ranges = UINT32_MAX;     // Maximum UNMAP block descriptor count
+    uint32_t max_write_same = 0;          // Maximum WRITE SAME length, 0: No limit
+    size = sizeof(page);
+    if (block_limits && scsi_cmd_inquiry_vpd(dev, disk->lun, VPD_BLOCK_LIMITS, page, &size) == ESP_OK && size >= 44) {
+        max_sectors = get_be32(&page[20]);
+        max_ranges = get_be32(&page[24]);
+        // Limit above 32-bit Number of Logical Blocks is not needed
+        max_write_same = get_be32(&page[36]) ? UINT32_MAX : get_be32(&page[40]);
+    }
+
+    if (unmap && max_sectors && max_ranges) {
+        disk->trim = USB_DISK_TRIM_UNMAP;
+        disk->trim_max_sectors = (max_sectors == UINT32_MAX) ? 0 : max_sectors;
+        disk->trim_max_ranges = MIN(max_ranges, SCSI_UNMAP_MAX_RANGES);
+    } else if (write_same) {
+        disk->trim = USB_DISK_TRIM_WRITE_SAME;
+        disk->trim_max_sectors = (max_write_same == UINT32_MAX) ? 0 : max_write_same;
+        disk->trim_max_ranges = 1;
+    }
+    ESP_LOGD(TAG, "LUN %d unmapping: %d", disk->lun, disk->trim);
+}
+
+void usb_disk_detect_alignment(usb_disk_t *disk)
+{
+    scsi_capacity16_t capacity;
+
+    disk->phys_block_exp = 0;
+    disk->aligned_lba = 0;
+    if (scsi_cmd_read_capacity16_info(msc_disk_to_device(disk), disk->lun, &capacity) != ESP_OK ||
+            capacity.block_size != disk->block_size) {
+        return;
+    }
+    // FatFS aligns to blocks of up to 32768 sectors, larger exponents are not plausible
+    disk->phys_block_exp = MIN(capacity.phys_block_exp, USB_DISK_PHYS_BLOCK_EXP_MAX);
+    disk->aligned_lba = capacity.lowest_aligned_lba;
+    ESP_LOGD(TAG, "LUN %d physical block %"PRIu32" bytes, aligned from LBA %d", disk->lun,
+             disk->block_size << disk->phys_block_exp, disk->aligned_lba);
+}
+
+esp_err_t usb_disk_write_sectors(usb_disk_t *disk, const uint8_t *data, uint64_t sector, uint32_t count, bool metadata)
+{
+    msc_device_t *dev = msc_disk_to_device(disk);
+    if (metadata && disk->barrier == MSC_HOST_WRITE_BARRIER_FUA) {
+        return scsi_cmd_write_fua(dev, disk->lun, data, sector, count, disk->block_size);
+    }
+    return scsi_cmd_write(dev, disk->lun, data, sector, count, disk->block_size);
+}
+
+esp_err_t usb_disk_sync(usb_disk_t *disk)
+{
+    if (disk->barrier == MSC_HOST_WRITE_BARRIER_NONE || disk->sync_cache_rejected) {
+        return ESP_OK;
+    }
+    const esp_err_t ret = scsi_cmd_synchronize_cache(msc_disk_to_device(disk), disk->lun);
+    if (ret == ESP_ERR_NOT_SUPPORTED) {
+        ESP_LOGD(TAG, "LUN %d has no write cache", disk->lun);
+        disk->sync_cache_rejected = true;
+        return ESP_OK;
+    }
+    return ret;
+}
+
+esp_err_t usb_disk_unmap(usb_disk_t *disk, const usb_disk_range_t *ranges, size_t range_num)
+{
+    msc_device_t *dev = msc_disk_to_device(disk);
+    scsi_unmap_range_t cmd_ranges[SCSI_UNMAP_MAX_RANGES];
+    size_t cmd_range_num = 0;
+    esp_err_t ret = ESP_OK;
+
+    if (disk->trim == USB_DISK_TRIM_NONE) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    // Ranges are split to the maximum size of one command, UNMAP commands carry up to trim_max_ranges of them
+    for (size_t i = 0; i < range_num && ret == ESP_OK; i++) {
+        uint64_t sector = ranges[i].sector;
+        uint32_t count = ranges[i].count;
+        while (count && ret == ESP_OK) {
+            const uint32_t cmd_count = disk->trim_max_sectors ? MIN(count, disk->trim_max_sectors) : count;
+            if (disk->trim == USB_DISK_TRIM_WRITE_SAME) {
+                ret = scsi_cmd_write_same16_unmap(dev, disk->lun, sector, cmd_count, disk->block_size);
+            } else {
+                cmd_ranges[cmd_range_num++] = (scsi_unmap_range_t) {
+                    .sector_address = sector,
+                    .num_sectors = cmd_count,
+                };
+                if (cmd_range_num == disk->trim_max_ranges) {
+                    ret = scsi_cmd_unmap(dev, disk->lun, cmd_ranges, cmd_range_num);
+                    cmd_range_num = 0;
+                }
+            }
+            sector += cmd_count;
+            count -= cmd_count;
+        }
+    }
+    if (cmd_range_num && ret == ESP_OK) {
+        ret = scsi_cmd_unmap(dev, disk->lun, cmd_ranges, cmd_range_num);
+    }
+
+    if (ret != ESP_OK) {
+        // Unmapping is only a hint for the device, freed sectors stay valid
+        ESP_LOGW(TAG, "Unmapping failed (0x%x), disabled for LUN %d", ret, disk->lun);
+        disk->trim = USB_DISK_TRIM_NONE;
+    }
+    return ret;
+}
+
+esp_err_t usb_disk_trim_flush(usb_disk_t *disk)
+{
+    const size_t range_num = disk->trim_num;
+    disk->trim_num = 0;
+    return range_num ? usb_disk_unmap(disk, disk->trim_pending, range_num) : ESP_OK;
+}
+
+static DRESULT usb_disk_trim(usb_disk_t *disk, const DWORD *range)
+{
+    const DWORD start = range[0];
+    const DWORD end = range[1];
+
+    if (end < start) {
+        return RES_PARERR;
+    }
+    if (disk->trim == USB_DISK_TRIM_NONE) {
+        return RES_OK;
+    }
+
+    // FatFS frees each fragment of a cluster chain separately, contiguous fragments are merged
+    usb_disk_range_t *last = disk->trim_num ? &disk->trim_pending[disk->trim_num - 1] : NULL;
+    if (last && last->sector + last->count == start && last->count <= UINT32_MAX - (end - start + 1)) {
+        last->count += end - start + 1;
+        return RES_OK;
+    }
+    if (disk->trim_num == USB_DISK_TRIM_BATCH && usb_disk_trim_flush(disk) != ESP_OK) {
+        return RES_ERROR;
+    }
+    disk->trim_pending[disk->trim_num++] = (usb_disk_range_t) {
+        .sector = start,
+        .count = end - start + 1,
+    };
+    return RES_OK;
+}
+
+static bool usb_disk_trim_overlaps(const usb_disk_t *disk, DWORD sector, UINT count)
+{
+    for (int i = 0; i < disk->trim_num; i++) {
+        const usb_disk_range_t *range = &disk->trim_pending[i];
+        if (sector < (uint64_t)range->sector + range->count && range->sector < (uint64_t)sector + count) {
+            return true;
+        }
+    }
+    return false;
+}
+
 static DSTATUS usb_disk_initialize (BYTE pdrv)
 {
     return RES_OK;
@@ -24,7 +219,10 @@ static DSTATUS usb_disk_initialize (BYTE pdrv)
 
 static DSTATUS usb_disk_status (BYTE pdrv)
 {
-    return RES_OK;
+    assert(pdrv < FF_VOLUMES);
+    assert(s_disks[pdrv]);
+
+    return s_disks[pdrv]->write_protected ? STA_PROTECT : 0;
 }
 
 static DRESULT usb_disk_read (BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
@@ -34,11 +232,12 @@ static DRESULT usb_disk_read (BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
 
     usb_disk_t *disk = s_disks[pdrv];
     size_t sector_size = disk->block_size;
-    msc_device_t *dev = __containerof(disk, msc_device_t, disk);
+    msc_device_t *dev = msc_disk_to_device(disk);
 
-    esp_err_t err = scsi_cmd_read10(dev, buff, sector, count, sector_size);
+    esp_err_t err = disk->cache ? usb_disk_cache_read(disk, buff, sector, count) :
+                    scsi_cmd_read(dev, disk->lun, buff, sector, count, sector_size);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "scsi_cmd_read10 failed (%d)", err);
+        ESP_LOGE(TAG, "scsi_cmd_read failed (%d)", err);
         return RES_ERROR;
     }
 
@@ -51,13 +250,21 @@ static DRESULT usb_disk_write (BYTE pdrv, const BYTE *buff, DWORD sector, UINT c
     assert(s_disks[pdrv]);
 
     usb_disk_t *disk = s_disks[pdrv];
-    size_t sector_size = disk->block_size;
-    msc_device_t *dev = __containerof(disk, msc_device_t, disk);
 
-    esp_err_t err = scsi_cmd_write10(dev, buff, sector, count, sector_size);
+    if (disk->write_protected) {
+        return RES_WRPRT;
+    }
+    // Freed sectors were reallocated, they must be unmapped before the new data are written
+    if (usb_disk_trim_overlaps(disk, sector, count)) {
+        usb_disk_trim_flush(disk);
+    }
+
+    // FatFS writes FAT and directory sectors one by one
+    esp_err_t err = disk->cache ? usb_disk_cache_write(disk, buff, sector, count) :
+                    usb_disk_write_sectors(disk, buff, sector, count, count == 1);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "scsi_cmd_write10 failed (%d)", err);
-        return RES_ERROR;
+        ESP_LOGE(TAG, "scsi_cmd_write failed (%d)", err);
+        return disk->write_protected ? RES_WRPRT : RES_ERROR;
     }
     return RES_OK;
 }
@@ -71,15 +278,32 @@ static DRESULT usb_disk_ioctl (BYTE pdrv, BYTE cmd, void *buff)
 
     switch (cmd) {
     case CTRL_SYNC:
+        if (disk->trim_num) {
+            // Failed unmapping does not lose data, it is not reported to FatFS
+            usb_disk_trim_flush(disk);
+        }
+        if (disk->cache && usb_disk_cache_flush(disk) != ESP_OK) {
+            ESP_LOGE(TAG, "Cache flush failed");
+            return RES_ERROR;
+        }
+        if (usb_disk_sync(disk) != ESP_OK) {
+            ESP_LOGE(TAG, "SYNCHRONIZE CACHE failed");
+            return RES_ERROR;
+        }
         return RES_OK;
     case GET_SECTOR_COUNT:
-        *((DWORD *) buff) = disk->block_count;
+        // FatFS addresses sectors by 32-bit LBA
+        *((DWORD *) buff) = (DWORD)MIN(disk->block_count, UINT32_MAX);
         return RES_OK;
     case GET_SECTOR_SIZE:
         *((WORD *) buff) = disk->block_size;
         return RES_OK;
     case GET_BLOCK_SIZE:
-        return RES_ERROR;
+        // FatFS aligns the volume to physical blocks from LBA 0, drives aligned from another LBA get no alignment
+        *((DWORD *) buff) = disk->aligned_lba ? 1 : (1UL << disk->phys_block_exp);
+        return RES_OK;
+    case CTRL_TRIM:
+        return usb_disk_trim(disk, (const DWORD *)buff);
     }
     return RES_ERROR;
 }
@@ -0,0 +1,290 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "msc_common.h"
+#include "msc_scsi_bot.h"
+#include "diskio_usb_cache.h"
+
+#define CACHE_MIN_RUN_SECTORS 8 // Contiguous dirty sectors written by one command, if read-ahead is shorter
+
+static const char *TAG = "diskio_usb_cache";
+
+typedef struct {
+    uint64_t sector;
+    uint32_t last_used;         // Sequence number of the last access, 0: Empty slot
+    bool dirty;
+    uint8_t *data;
+} cache_slot_t;
+
+struct usb_disk_cache {
+    msc_host_vfs_cache_config_t config;
+    uint32_t seq;               // Sequence number of accesses, for LRU eviction
+    uint64_t next_sector;       // Sector following the last single-sector read, for sequential read detection
+    size_t run_sectors;         // Size of the run buffer in sectors
+    uint8_t *run_buffer;        // Read-ahead and coalesced writes
+    cache_slot_t **victims;     // Slots filled by one read-ahead
+    uint8_t *data;              // Data of all slots
+    cache_slot_t slots[];
+};
+
+static cache_slot_t *cache_find(usb_disk_cache_t *cache, uint64_t sector)
+{
+    for (size_t i = 0; i < cache->config.sector_num; i++) {
+        cache_slot_t *slot = &cache->slots[i];
+        if (slot->last_used && slot->sector == sector) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Check if the sector starts a physical block of the disk
+ */
+static inline bool cache_phys_aligned(const usb_disk_t *disk, uint64_t sector)
+{
+    return sector < disk->aligned_lba || ((sector - disk->aligned_lba) & ((1U << disk->phys_block_exp) - 1)) == 0;
+}
+
+static inline void cache_touch(usb_disk_cache_t *cache, cache_slot_t *slot)
+{
+    slot->last_used = ++cache->seq;
+}
+
+/**
+ * @brief Get empty or least recently used slot
+ */
+static cache_slot_t *cache_lru(usb_disk_cache_t *cache)
+{
+    cache_slot_t *lru = &cache->slots[0];
+    for (size_t i = 0; i < cache->config.sector_num && lru->last_used; i++) {
+        if (cache->slots[i].last_used < lru->last_used) {
+            lru = &cache->slots[i];
+        }
+    }
+    return lru;
+}
+
+/**
+ * @brief Reserve slots for new sectors
+ *
+ * The slots are marked as used, so they are not reserved twice.
+ * Dirty sectors are written before their slots are reused.
+ *
+ * @param[in]  disk  Disk with cache
+ * @param[out] slots Reserved slots
+ * @param[in]  num   Number of slots
+ * @return esp_err_t
+ */
+static esp_err_t cache_reserve(usb_disk_t *disk, cache_slot_t **slots, size_t num)
+{
+    usb_disk_cache_t *cache = disk->cache;
+    bool dirty = false;
+
+    for (size_t i = 0; i < num; i++) {
+        slots[i] = cache_lru(cache);
+        dirty |= slots[i]->dirty;
+        cache_touch(cache, slots[i]);
+    }
+    if (dirty) {
+        MSC_RETURN_ON_ERROR( usb_disk_cache_flush(disk) );
+    }
+    for (size_t i = 0; i < num; i++) {
+        slots[i]->last_used = 0; // Empty until filled, so failed reads leave no stale sectors
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Free the cache and its buffers
+ *
+ * @param[in] disk  Disk the cache was created for
+ * @param[in] cache Cache, its buffers can be NULL
+ */
+static void usb_disk_cache_free(const usb_disk_t *disk, usb_disk_cache_t *cache)
+{
+    MSC_FREE(BUFFER, cache->data, cache->config.sector_num * disk->block_size);
+    MSC_FREE(BUFFER, cache->run_buffer, cache->run_sectors * disk->block_size);
+    MSC_FREE(BUFFER, cache->victims, cache->run_sectors * sizeof(cache_slot_t *));
+    MSC_FREE(BUFFER, cache, sizeof(usb_disk_cache_t) + cache->config.sector_num * sizeof(cache_slot_t));
+}
+
+esp_err_t usb_disk_cache_create(usb_disk_t *disk, const msc_host_vfs_cache_config_t *config)
+{
+    const size_t sector_num = config->sector_num;
+    const size_t run_sectors = MIN(MAX(config->read_ahead_sectors, CACHE_MIN_RUN_SECTORS), sector_num);
+    usb_disk_cache_t *cache = MSC_CALLOC(BUFFER, 1, sizeof(usb_disk_cache_t) + sector_num * sizeof(cache_slot_t));
+    MSC_RETURN_ON_FALSE( cache, ESP_ERR_NO_MEM );
+
+    cache->config = *config;
+    cache->config.read_ahead_sectors = MIN(config->read_ahead_sectors, sector_num);
+    cache->run_sectors = run_sectors;
+    cache->data = MSC_MALLOC(BUFFER, sector_num * disk->block_size, MALLOC_CAP_DEFAULT);
+    cache->run_buffer = MSC_MALLOC(BUFFER, run_sectors * disk->block_size, MALLOC_CAP_DMA);
+    cache->victims = MSC_CALLOC(BUFFER, run_sectors, sizeof(cache_slot_t *));
+    if (!cache->data || !cache->run_buffer || !cache->victims) {
+        usb_disk_cache_free(disk, cache);
+        return ESP_ERR_NO_MEM;
+    }
+    for (size_t i = 0; i < sector_num; i++) {
+        cache->slots[i].data = cache->data + i * disk->block_size;
+    }
+    disk->cache = cache;
+    return ESP_OK;
+}
+
+void usb_disk_cache_delete(usb_disk_t *disk)
+{
+    usb_disk_cache_t *cache = disk->cache;
+    if (cache == NULL) {
+        return;
+    }
+    if (usb_disk_cache_flush(disk) != ESP_OK) {
+        ESP_LOGW(TAG, "Dirty sectors were not written");
+    }
+    disk->cache = NULL;
+    usb_disk_cache_free(disk, cache);
+}
+
+esp_err_t usb_disk_cache_flush(usb_disk_t *disk)
+{
+    usb_disk_cache_t *cache = disk->cache;
+    const uint32_t block_size = disk->block_size;
+
+    while (true) {
+        // Dirty sectors are written in ascending order
+        cache_slot_t *first = NULL;
+        for (size_t i = 0; i < cache->config.sector_num; i++) {
+            cache_slot_t *slot = &cache->slots[i];
+            if (slot->dirty && (first == NULL || slot->sector < first->sector)) {
+                first = slot;
+            }
+        }
+        if (first == NULL) {
+            return ESP_OK;
+        }
+
+        // Contiguous dirty sectors are coalesced to one command. Clean cached sectors complete the physical blocks
+        // of the run, so the drive does not read-modify-write them
+        uint64_t sector = first->sector;
+        while (!cache_phys_aligned(disk, sector) && first->sector - sector + 1 < cache->run_sectors && cache_find(cache, sector - 1)) {
+            sector--;
+        }
+        size_t num = 0;
+        for (cache_slot_t *slot = cache_find(cache, sector); slot && num < cache->run_sectors; slot = cache_find(cache, sector + num)) {
+            if (!slot->dirty && sector + num > first->sector && cache_phys_aligned(disk, sector + num)) {
+                break;
+            }
+            memcpy(cache->run_buffer + num * block_size, slot->data, block_size);
+            num++;
+        }
+        MSC_RETURN_ON_ERROR( scsi_cmd_write(msc_disk_to_device(disk), disk->lun, cache->run_buffer, sector, num, block_size) );
+        for (size_t i = 0; i < num; i++) {
+            cache_find(cache, sector + i)->dirty = false;
+        }
+    }
+}
+
+esp_err_t usb_disk_cache_read(usb_disk_t *disk, uint8_t *buff, uint64_t sector, uint32_t count)
+{
+    usb_disk_cache_t *cache = disk->cache;
+    const uint32_t block_size = disk->block_size;
+
+    if (count > 1) {
+        // File data bypass the cache, data of dirty sectors are newer than on the device
+        MSC_RETURN_ON_ERROR( scsi_cmd_read(msc_disk_to_device(disk), disk->lun, buff, sector, count, block_size) );
+        for (size_t i = 0; i < cache->config.sector_num; i++) {
+            cache_slot_t *slot = &cache->slots[i];
+            if (slot->dirty && slot->sector >= sector && slot->sector < sector + count) {
+                memcpy(buff + (slot->sector - sector) * block_size, slot->data, block_size);
+            }
+        }
+        return ESP_OK;
+    }
+
+    const bool sequential = (sector == cache->next_sector);
+    cache->next_sector = sector + 1;
+    cache_slot_t *slot = cache_find(cache, sector);
+    if (slot) {
+        cache_touch(cache, slot);
+        memcpy(buff, slot->data, block_size);
+        return ESP_OK;
+    }
+
+    // Sequential misses read ahead up to the next cached sector and the end of the disk
+    size_t num = 1;
+    if (sequential && cache->config.read_ahead_sectors > 1 && sector < disk->block_count) {
+        num = MIN(cache->config.read_ahead_sectors, disk->block_count - sector + 1);
+        for (size_t i = 1; i < num; i++) {
+            if (cache_find(cache, sector + i)) {
+                num = i;
+                break;
+            }
+        }
+    }
+
+    MSC_RETURN_ON_ERROR( cache_reserve(disk, cache->victims, num) );
+    MSC_RETURN_ON_ERROR( scsi_cmd_read(msc_disk_to_device(disk), disk->lun, cache->run_buffer, sector, num, block_size) );
+    for (size_t i = 0; i < num; i++) {
+        slot = cache->victims[i];
+        slot->sector = sector + i;
+        slot->dirty = false;
+        memcpy(slot->data, cache->run_buffer + i * block_size, block_size);
+        cache_touch(cache, slot);
+    }
+    cache_touch(cache, cache->victims[0]); // The requested sector is the most recently used
+    memcpy(buff, cache->victims[0]->data, block_size);
+    return ESP_OK;
+}
+
+esp_err_t usb_disk_cache_write(usb_disk_t *disk, const uint8_t *buff, uint64_t sector, uint32_t count)
+{
+    usb_disk_cache_t *cache = disk->cache;
+    const uint32_t block_size = disk->block_size;
+
+    if (count == 1 && cache->config.write_back) {
+        cache_slot_t *slot = cache_find(cache, sector);
+        if (slot == NULL) {
+            MSC_RETURN_ON_ERROR( cache_reserve(disk, &slot, 1) );
+            slot->sector = sector;
+        }
+        memcpy(slot->data, buff, block_size);
+        slot->dirty = true;
+        cache_touch(cache, slot);
+        return ESP_OK;
+    }
+
+    // Write-through, cached copies of the sectors are updated
+    MSC_RETURN_ON_ERROR( usb_disk_write_sectors(disk, buff, sector, count, count == 1) );
+    for (size_t i = 0; i < cache->config.sector_num; i++) {
+        cache_slot_t *slot = &cache->slots[i];
+        if (slot->last_used && slot->sector >= sector && slot->sector < sector + count) {
+            memcpy(slot->data, buff + (slot->sector - sector) * block_size, block_size);
+            slot->dirty = false;
+        }
+    }
+    return ESP_OK;
+}
+
+void usb_disk_cache_invalidate(usb_disk_t *disk)
+{
+    usb_disk_cache_t *cache = disk->cache;
+    if (cache == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < cache->config.sector_num; i++) {
+        cache->slots[i].last_used = 0;
+        cache->slots[i].dirty = false;
+    }
+    cache->next_sector = UINT64_MAX;
+}
@@ -13,17 +13,27 @@
 #include <sys/param.h>
 #include "esp_log.h"
 #include "esp_heap_caps.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include "usb/usb_host.h"
 #include "diskio_usb.h"
 #include "msc_common.h"
 #include "usb/msc_host.h"
 #include "msc_scsi_bot.h"
+#include "msc_id_cache.h"
 #include "usb/usb_types_ch9.h"
 #include "usb/usb_helpers.h"
 #include "soc/soc_memory_layout.h"
+#include "soc/soc_caps.h"
+#if USB_HOST_SHARED_CLIENT_ENABLED
+#define USB_HOST_CLIENT_DRIVER  MSC
+#include "usb/usb_host_client_macros.h"
+#else
+#include "usb_host_client_fallback.h"
+#endif
 
 // MSC driver spin lock
 static portMUX_TYPE msc_lock = portMUX_INITIALIZER_UNLOCKED;
@@ -80,12 +90,96 @@ static portMUX_TYPE msc_lock = portMUX_INITIALIZER_UNLOCKED;
 })
 
 #define DEFAULT_XFER_SIZE   (64) // Transfer size used for all transfers apart from SCSI read/write
+#define DEFAULT_DATA_XFER_SIZE  (4096) // Default size of data phase transfers
+#define DEFAULT_DATA_XFER_NUM   (2)    // Default number of data phase transfers in flight
+
+// Alignment of buffers the USB DMA can access directly. Cache is synced by cache lines on targets with cached internal memory
+#if defined(SOC_CACHE_INTERNAL_MEM_VIA_L1CACHE) && SOC_CACHE_INTERNAL_MEM_VIA_L1CACHE
+#define DMA_BUFFER_ALIGNMENT CONFIG_CACHE_L1_CACHE_LINE_SIZE
+#else
+#define DMA_BUFFER_ALIGNMENT 4
+#endif
 #define WAIT_FOR_READY_TIMEOUT_MS 5000
+#define WAIT_FOR_READY_MIN_DELAY_MS 5   // Delay between TEST UNIT READY commands doubles up to WAIT_FOR_READY_MAX_DELAY_MS
+#define WAIT_FOR_READY_MAX_DELAY_MS 100
+#define DEFAULT_TRANSFER_TIMEOUT_MS 5000
 #define SCSI_COMMAND_SET    0x06
 #define BULK_ONLY_TRANSFER  0x50
+#define USB_ATTACHED_SCSI   0x62
 #define MSC_NO_SENSE        0x00
 #define MSC_NOT_READY       0x02
 #define MSC_UNIT_ATTENTION  0x06
+#define MSC_ASC_MEDIUM_NOT_PRESENT 0x3A
+
+// USB Attached SCSI (UAS) Protocol, Revision 1.0
+#define UAS_PIPE_USAGE_DESC_TYPE    0x24
+#define UAS_PIPE_ID_COMMAND         1
+#define UAS_PIPE_ID_STATUS          2
+#define UAS_PIPE_ID_DATA_IN         3
+#define UAS_PIPE_ID_DATA_OUT        4
+#define UAS_PIPES_ALL               ((1 << UAS_PIPE_ID_COMMAND) | (1 << UAS_PIPE_ID_STATUS) | (1 << UAS_PIPE_ID_DATA_IN) | (1 << UAS_PIPE_ID_DATA_OUT))
+
+#define UAS_IU_ID_COMMAND           0x01
+#define UAS_IU_ID_SENSE             0x03
+#define UAS_IU_ID_RESPONSE          0x04
+#define UAS_IU_ID_TASK_MANAGEMENT   0x05
+#define UAS_IU_ID_READ_READY        0x06
+#define UAS_IU_ID_WRITE_READY       0x07
+
+#define UAS_TMF_LOGICAL_UNIT_RESET  0x08
+#define UAS_RC_TMF_COMPLETE         0x00
+#define UAS_RC_TMF_SUCCEEDED        0x08
+#define UAS_TAG_TASK_MANAGEMENT     (MSC_UAS_MAX_COMMANDS + 1) // Commands use tags 1 to MSC_UAS_MAX_COMMANDS
+
+/**
+ * @brief Information Units of UAS. Multi-byte fields are big-endian
+ *
+ * @see USB Attached SCSI (UAS) Protocol, Chapter 6.2
+ */
+typedef struct __attribute__((packed))
+{
+    uint8_t iu_id;
+    uint8_t reserved_0;
+    uint16_t tag;
+    uint8_t task_attribute;
+    uint8_t reserved_1;
+    uint8_t add_cdb_length;
+    uint8_t reserved_2;
+    uint8_t lun[8];
+    uint8_t cdb[16];
+} uas_command_iu_t;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t iu_id;
+    uint8_t reserved_0;
+    uint16_t tag;
+    uint8_t function;
+    uint8_t reserved_1;
+    uint16_t task_tag;
+    uint8_t lun[8];
+} uas_task_management_iu_t;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t iu_id;
+    uint8_t reserved_0;
+    uint16_t tag;
+    uint16_t status_qualifier;
+    uint8_t status;
+    uint8_t reserved_1[7];
+    uint16_t length;
+    uint8_t sense_data[];
+} uas_sense_iu_t;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t iu_id;
+    uint8_t reserved_0;
+    uint16_t tag;
+    uint8_t additional_info[3];
+    uint8_t response_code;
+} uas_response_iu_t;
 
 static const char *TAG = "USB_MSC";
 typedef struct {
@@ -93,8 +187,13 @@ typedef struct {
     msc_host_event_cb_t user_cb;
     void *user_arg;
     SemaphoreHandle_t all_events_handled;
+    size_t data_xfer_size;
+    int data_xfer_num;
+    msc_host_async_io_config_t async_io;
+    msc_id_cache_t *id_cache;       // Identification of uninstalled devices, NULL if disabled
     volatile bool end_client_event_handling;
     bool event_handling_started;
+    bool shared_client;             // Registered to usb_host_shared_client, which handles the events
     STAILQ_HEAD(devices, msc_host_device) devices_tailq;
 } msc_driver_t;
 
@@ -116,7 +215,7 @@ static inline bool is_in_endpoint(uint8_t endpoint)
     return endpoint & USB_B_ENDPOINT_ADDRESS_EP_DIR_MASK ? true : false;
 }
 
-static const usb_intf_desc_t *find_msc_interface(const usb_config_desc_t *config_desc, size_t *offset)
+static const usb_intf_desc_t *find_msc_interface(const usb_config_desc_t *config_desc, uint8_t protocol, size_t *offset)
 {
     size_t total_length = config_desc->wTotalLength;
     const usb_standard_desc_t *next_desc = (const usb_standard_desc_t *)config_desc;
@@ -129,7 +228,7 @@ static const usb_intf_desc_t *find_msc_interface(const usb_config_desc_t *config
 
         if ( ifc_desc->bInterfaceClass == USB_CLASS_MASS_STORAGE &&
                 ifc_desc->bInterfaceSubClass == SCSI_COMMAND_SET &&
-                ifc_desc->bInterfaceProtocol == BULK_ONLY_TRANSFER ) {
+                ifc_desc->bInterfaceProtocol == protocol ) {
             return ifc_desc;
         }
 
@@ -181,20 +280,34 @@ static esp_err_t msc_mass_reset(msc_host_device_handle_t dev)
     return ESP_OK;
 }
 
+/**
+ * @brief Select alternate setting of the MSC interface
+ *
+ * @param[in] device MSC device handle
+ * @return esp_err_t
+ */
+static esp_err_t msc_set_interface(msc_device_t *device)
+{
+    usb_transfer_t *xfer = device->xfer;
+
+    USB_SETUP_PACKET_INIT_SET_INTERFACE((usb_setup_packet_t *)xfer->data_buffer, device->config.iface_num, device->config.alt_setting);
+    MSC_RETURN_ON_ERROR( msc_control_transfer(device, USB_SETUP_PACKET_SIZE) );
+
+    return ESP_OK;
+}
+
 /**
  * @brief MSC get maximum Logical Unit Number
  *
  * If the device implements 3 LUNs, the returned value is 2. (LUN0, LUN1, LUN2).
  *
- * This driver does not support multiple LUNs yet.
- *
  * @see USB Mass Storage Class – Bulk Only Transport, Chapter 3.2
  *
  * @param[in]  dev MSC device handle
  * @param[out] lun Maximum Logical Unit Number
  * @return esp_err_t
  */
-__attribute__((unused)) static esp_err_t msc_get_max_lun(msc_host_device_handle_t dev, uint8_t *lun)
+static esp_err_t msc_get_max_lun(msc_host_device_handle_t dev, uint8_t *lun)
 {
     msc_device_t *device = (msc_device_t *)dev;
     usb_transfer_t *xfer = device->xfer;
@@ -207,6 +320,71 @@ __attribute__((unused)) static esp_err_t msc_get_max_lun(msc_host_device_handle_
     return ESP_OK;
 }
 
+/**
+ * @brief Extracts pipes of UAS alternate setting
+ *
+ * Each endpoint of the UAS interface is followed by Pipe Usage descriptor, which gives its role.
+ *
+ * @see USB Attached SCSI (UAS) Protocol, Chapter 5.3.3.1
+ *
+ * @param[in]  cfg_desc  Configuration descriptor
+ * @param[in]  ifc_desc  UAS interface descriptor
+ * @param[in]  offset    Offset of the interface descriptor
+ * @param[out] cfg       Obtained configuration
+ * @return
+ *    - ESP_OK: All four pipes were found
+ *    - ESP_ERR_NOT_SUPPORTED: Incomplete UAS interface
+ */
+static esp_err_t extract_uas_config(const usb_config_desc_t *cfg_desc, const usb_intf_desc_t *ifc_desc, size_t offset, msc_config_t *cfg)
+{
+    const size_t total_len = cfg_desc->wTotalLength;
+    const usb_standard_desc_t *next_desc = (const usb_standard_desc_t *)ifc_desc;
+    const usb_ep_desc_t *ep_desc = NULL;
+    unsigned pipes = 0;
+
+    cfg->transport = MSC_TRANSPORT_UAS;
+    cfg->iface_num = ifc_desc->bInterfaceNumber;
+    cfg->alt_setting = ifc_desc->bAlternateSetting;
+
+    while ((next_desc = usb_parse_next_descriptor(next_desc, total_len, (int *)&offset)) &&
+            next_desc->bDescriptorType != USB_B_DESCRIPTOR_TYPE_INTERFACE) {
+        if (next_desc->bDescriptorType == USB_B_DESCRIPTOR_TYPE_ENDPOINT) {
+            ep_desc = (const usb_ep_desc_t *)next_desc;
+            continue;
+        }
+        if (next_desc->bDescriptorType != UAS_PIPE_USAGE_DESC_TYPE || next_desc->bLength < 3 || ep_desc == NULL) {
+            continue;
+        }
+
+        const uint8_t pipe_id = ((const uint8_t *)next_desc)[2];
+        const bool in_pipe = (pipe_id == UAS_PIPE_ID_STATUS || pipe_id == UAS_PIPE_ID_DATA_IN);
+        if (pipe_id < UAS_PIPE_ID_COMMAND || pipe_id > UAS_PIPE_ID_DATA_OUT ||
+                in_pipe != is_in_endpoint(ep_desc->bEndpointAddress)) {
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        switch (pipe_id) {
+        case UAS_PIPE_ID_COMMAND:
+            cfg->uas_cmd_ep = ep_desc->bEndpointAddress;
+            break;
+        case UAS_PIPE_ID_STATUS:
+            cfg->uas_status_ep = ep_desc->bEndpointAddress;
+            cfg->uas_status_mps = ep_desc->wMaxPacketSize;
+            break;
+        case UAS_PIPE_ID_DATA_IN:
+            cfg->bulk_in_ep = ep_desc->bEndpointAddress;
+            cfg->bulk_in_mps = ep_desc->wMaxPacketSize;
+            break;
+        default:
+            cfg->bulk_out_ep = ep_desc->bEndpointAddress;
+            break;
+        }
+        pipes |= 1 << pipe_id;
+        ep_desc = NULL;
+    }
+
+    return pipes == UAS_PIPES_ALL ? ESP_OK : ESP_ERR_NOT_SUPPORTED;
+}
+
 /**
  * @brief Extracts configuration from configuration descriptor.
  *
@@ -214,6 +392,8 @@ __attribute__((unused)) static esp_err_t msc_get_max_lun(msc_host_device_handle_
 
  *        - interface number, IN endpoint, OUT endpoint, max. packet size
  *
+ * UAS alternate setting is preferred, Bulk-Only Transport is used if the device does not provide it.
+ *
  * @param[in]  cfg_desc  Configuration descriptor
  * @param[out] cfg       Obtained configuration
  * @return esp_err_t
@@ -222,12 +402,26 @@ static esp_err_t extract_config_from_descriptor(const usb_config_desc_t *cfg_des
 {
     size_t offset = 0;
     size_t total_len = cfg_desc->wTotalLength;
-    const usb_intf_desc_t *ifc_desc = find_msc_interface(cfg_desc, &offset);
-    assert(ifc_desc);
+
+    const usb_intf_desc_t *uas_desc = find_msc_interface(cfg_desc, USB_ATTACHED_SCSI, &offset);
+    if (uas_desc) {
+        msc_config_t uas_cfg = { 0 };
+        if (extract_uas_config(cfg_desc, uas_desc, offset, &uas_cfg) == ESP_OK) {
+            *cfg = uas_cfg;
+            return ESP_OK;
+        }
+        ESP_LOGW(TAG, "Incomplete UAS interface, using Bulk-Only Transport");
+    }
+
+    offset = 0;
+    const usb_intf_desc_t *ifc_desc = find_msc_interface(cfg_desc, BULK_ONLY_TRANSFER, &offset);
+    MSC_RETURN_ON_FALSE(ifc_desc, ESP_ERR_NOT_SUPPORTED);
     const usb_standard_desc_t *next_desc = (const usb_standard_desc_t *)ifc_desc;
     const usb_ep_desc_t *ep_desc = NULL;
 
+    cfg->transport = MSC_TRANSPORT_BOT;
     cfg->iface_num = ifc_desc->bInterfaceNumber;
+    cfg->alt_setting = ifc_desc->bAlternateSetting;
 
     next_desc = next_endpoint_desc(next_desc, total_len, &offset);
     MSC_RETURN_ON_FALSE(next_desc, ESP_ERR_NOT_SUPPORTED);
@@ -261,66 +455,169 @@ static esp_err_t msc_deinit_device(msc_device_t *dev, bool install_failed)
     STAILQ_REMOVE(&s_msc_driver->devices_tailq, dev, msc_host_device, tailq_entry);
     MSC_EXIT_CRITICAL();
 
+    msc_async_stop(dev);
+
     if (dev->transfer_done) {
-        vSemaphoreDelete(dev->transfer_done);
+        vQueueDelete(dev->transfer_done);
+    }
+    if (dev->lock) {
+        vSemaphoreDelete(dev->lock);
+    }
+    for (int i = 0; dev->data_xfer && i < dev->data_xfer_num; i++) {
+        CLIENT_TRANSFER_FREE(dev->data_xfer[i].xfer);
+    }
+    MSC_FREE(CONTROL, dev->data_xfer, dev->data_xfer_num * sizeof(msc_data_xfer_t));
+    CLIENT_TRANSFER_FREE(dev->uas.status_xfer);
+    for (int i = 0; i < MSC_UAS_MAX_COMMANDS; i++) {
+        CLIENT_TRANSFER_FREE(dev->uas.cmd_xfer[i]);
     }
     if (install_failed) {
         // Error code is unchecked, as it's unknown at what point installation failed.
         usb_host_interface_release(s_msc_driver->client_handle, dev->handle, dev->config.iface_num);
-        usb_host_device_close(s_msc_driver->client_handle, dev->handle);
-        usb_host_transfer_free(dev->xfer);
+        CLIENT_DEVICE_CLOSE(s_msc_driver->client_handle, dev->handle);
+        CLIENT_TRANSFER_FREE(dev->xfer);
+        CLIENT_TRANSFER_FREE(dev->csw_xfer);
     } else {
         MSC_RETURN_ON_ERROR( usb_host_interface_release(s_msc_driver->client_handle, dev->handle, dev->config.iface_num) );
-        MSC_RETURN_ON_ERROR( usb_host_device_close(s_msc_driver->client_handle, dev->handle) );
-        MSC_RETURN_ON_ERROR( usb_host_transfer_free(dev->xfer) );
+        MSC_RETURN_ON_ERROR( CLIENT_DEVICE_CLOSE(s_msc_driver->client_handle, dev->handle) );
+        MSC_RETURN_ON_ERROR( CLIENT_TRANSFER_FREE(dev->xfer) );
+        MSC_RETURN_ON_ERROR( CLIENT_TRANSFER_FREE(dev->csw_xfer) );
     }
 
-    free(dev);
+    MSC_FREE(CONTROL, dev, sizeof(msc_device_t));
     return ESP_OK;
 }
 
-// Some MSC devices requires to change its internal state from non-ready to ready
-static esp_err_t msc_wait_for_ready_state(msc_device_t *dev, size_t timeout_ms)
+/**
+ * @brief Wait until the Logical Unit is ready
+ *
+ * Some MSC devices requires to change its internal state from non-ready to ready.
+ * Most devices are ready at once or within tens of milliseconds, so TEST UNIT READY is repeated
+ * after a short delay, which doubles up to WAIT_FOR_READY_MAX_DELAY_MS for slow devices.
+ */
+static esp_err_t msc_wait_for_ready_state(msc_device_t *dev, uint8_t lun, size_t timeout_ms)
 {
     esp_err_t err;
     scsi_sense_data_t sense;
-    uint32_t trials = MAX(1, timeout_ms / 100);
+    const TickType_t start = xTaskGetTickCount();
+    uint32_t delay_ms = WAIT_FOR_READY_MIN_DELAY_MS;
 
-    do {
-        err = scsi_cmd_unit_ready(dev);
+    while (true) {
+        // TEST UNIT READY and REQUEST SENSE must not be interleaved with commands to other LUNs
+        msc_device_lock(dev);
+        err = scsi_cmd_unit_ready(dev, lun);
         if (err == ESP_OK) {
+            msc_device_unlock(dev);
             return ESP_OK;
         } else {
             // Some MSC devices report 'NOT READY TO READY TRANSITION - MEDIA CHANGED', which isn't cleared until a REQUEST SENSE is performed.
-            MSC_RETURN_ON_ERROR( scsi_cmd_sense(dev, &sense) );
+            const esp_err_t sense_err = scsi_cmd_sense(dev, lun, &sense);
+            msc_device_unlock(dev);
+            MSC_RETURN_ON_ERROR(sense_err);
+            if (dev->lun_num > 1 && sense.key == MSC_NOT_READY && sense.code == MSC_ASC_MEDIUM_NOT_PRESENT) {
+                // Empty slot of a card reader
+                return ESP_ERR_NOT_FOUND;
+            }
             if (sense.key != MSC_NOT_READY &&
                     sense.key != MSC_UNIT_ATTENTION &&
                     sense.key != MSC_NO_SENSE) {
                 return ESP_ERR_MSC_INTERNAL;
             }
         }
-        vTaskDelay( pdMS_TO_TICKS(100) );
-    } while (trials-- && err);
+        if (xTaskGetTickCount() - start >= pdMS_TO_TICKS(timeout_ms)) {
+            return err;
+        }
+        vTaskDelay( MAX(1, pdMS_TO_TICKS(delay_ms)) );
+        delay_ms = MIN(2 * delay_ms, WAIT_FOR_READY_MAX_DELAY_MS);
+    }
+}
+
+/**
+ * @brief Wait for Logical Units in use
+ *
+ * Card readers report empty slots as not ready, so only LUNs with a medium are waited for.
+ * Single LUN devices are always waited for.
+ */
+static esp_err_t msc_wait_for_luns_ready(msc_device_t *dev)
+{
+    for (uint8_t lun = 0; lun < dev->lun_num; lun++) {
+        if (dev->lun_num == 1 || dev->disk[lun].block_count) {
+            MSC_RETURN_ON_ERROR( msc_wait_for_ready_state(dev, lun, WAIT_FOR_READY_TIMEOUT_MS) );
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Identify Logical Unit and read its capacity
+ *
+ * Logical Unit identified before skips INQUIRY and VPD pages. Its capacity is read again only for removable medium.
+ *
+ * @param[in] dev    MSC device handle
+ * @param[in] lun    Logical Unit Number
+ * @param[in] cached Identification of the Logical Unit from the last installation, NULL if not known
+ * @return
+ *    - ESP_OK: Success
+ *    - ESP_ERR_NOT_FOUND: No medium in the Logical Unit of multi-LUN device
+ *    - Other: Command failed
+ */
+static esp_err_t msc_init_lun(msc_device_t *dev, uint8_t lun, const msc_id_lun_t *cached)
+{
+    usb_disk_t *disk = &dev->disk[lun];
+    uint32_t block_size, block_count;
+    uint64_t block_count64;
+
+    if (cached) {
+        disk->removable = cached->removable;
+        disk->trim = cached->trim;
+        disk->trim_max_sectors = cached->trim_max_sectors;
+        disk->trim_max_ranges = cached->trim_max_ranges;
+        disk->phys_block_exp = cached->phys_block_exp;
+        disk->aligned_lba = cached->aligned_lba;
+    } else {
+        MSC_RETURN_ON_ERROR( scsi_cmd_inquiry(dev, lun, &disk->removable) );
+    }
+    MSC_RETURN_ON_ERROR( msc_wait_for_ready_state(dev, lun, WAIT_FOR_READY_TIMEOUT_MS) );
+    if (cached && !cached->removable) {
+        disk->block_size = cached->block_size;
+        disk->block_count = cached->block_count;
+        return ESP_OK;
+    }
+
+    MSC_RETURN_ON_ERROR( scsi_cmd_read_capacity(dev, lun, &block_size, &block_count) );
+    block_count64 = block_count;
+    if (block_count == UINT32_MAX) {
+        // Capacity exceeds 32-bit LBA of READ CAPACITY(10)
+        MSC_RETURN_ON_ERROR( scsi_cmd_read_capacity16(dev, lun, &block_size, &block_count64) );
+    }
 
-    return err;
+    disk->block_size = block_size;
+    disk->block_count = block_count64;
+    if (!cached) {
+        usb_disk_detect_trim(disk);
+        usb_disk_detect_alignment(disk);
+    }
+    return ESP_OK;
 }
 
 static bool is_mass_storage_device(uint8_t dev_addr)
 {
-    size_t dummy = 0;
+    size_t bot_offset = 0;
+    size_t uas_offset = 0;
     bool is_msc_device = false;
     usb_device_handle_t device;
     const usb_config_desc_t *config_desc;
 
-    if ( usb_host_device_open(s_msc_driver->client_handle, dev_addr, &device) == ESP_OK) {
+    if ( CLIENT_DEVICE_OPEN(s_msc_driver->client_handle, dev_addr, &device) == ESP_OK) {
         if ( usb_host_get_active_config_descriptor(device, &config_desc) == ESP_OK ) {
-            if ( find_msc_interface(config_desc, &dummy) ) {
+            if ( find_msc_interface(config_desc, BULK_ONLY_TRANSFER, &bot_offset) ||
+                    find_msc_interface(config_desc, USB_ATTACHED_SCSI, &uas_offset) ) {
                 is_msc_device = true;
             } else {
                 ESP_LOGD(TAG, "Connected USB device is not MSC");
             }
         }
-        usb_host_device_close(s_msc_driver->client_handle, device);
+        CLIENT_DEVICE_CLOSE(s_msc_driver->client_handle, device);
     }
 
     return is_msc_device;
@@ -329,6 +626,7 @@ static bool is_mass_storage_device(uint8_t dev_addr)
 esp_err_t msc_host_handle_events(uint32_t timeout)
 {
     MSC_RETURN_ON_FALSE(s_msc_driver != NULL, ESP_ERR_INVALID_STATE);
+    MSC_RETURN_ON_FALSE(!s_msc_driver->shared_client, ESP_ERR_INVALID_STATE);
 
     ESP_LOGV(TAG, "USB MSC handling");
     s_msc_driver->event_handling_started = true;
@@ -395,22 +693,93 @@ static void client_event_cb(const usb_host_client_event_msg_t *event, void *arg)
     }
 }
 
+#if USB_HOST_SHARED_CLIENT_ENABLED
+/**
+ * @brief Set suspended state of all devices
+ *
+ * The lock of a device is taken, so a command in progress completes before the bus is suspended.
+ * MSC devices have no transfers in flight between commands, there is nothing to resubmit on resume.
+ */
+static void msc_devices_set_suspended(bool suspended)
+{
+    MSC_ENTER_CRITICAL();
+    msc_device_t *dev = STAILQ_FIRST(&s_msc_driver->devices_tailq);
+    while (dev != NULL) {
+        msc_device_t *next = STAILQ_NEXT(dev, tailq_entry);
+        const bool installed = (dev->lock != NULL);
+        MSC_EXIT_CRITICAL();
+
+        if (installed) {
+            msc_device_lock(dev);
+            dev->suspended = suspended;
+            msc_device_unlock(dev);
+        }
+        dev = next;
+
+        MSC_ENTER_CRITICAL();
+    }
+    MSC_EXIT_CRITICAL();
+}
+
+static esp_err_t msc_pm_suspend(void *arg)
+{
+    msc_devices_set_suspended(true);
+    return ESP_OK;
+}
+
+static esp_err_t msc_pm_resume(void *arg)
+{
+    msc_devices_set_suspended(false);
+    return ESP_OK;
+}
+
+static const usb_host_pm_ops_t msc_pm_ops = {
+    .suspend = msc_pm_suspend,
+    .resume = msc_pm_resume,
+};
+#endif // USB_HOST_SHARED_CLIENT_ENABLED
+
+static esp_err_t client_deregister(msc_driver_t *driver)
+{
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    if (driver->shared_client) {
+        return usb_host_shared_client_deregister(client_event_cb, NULL);
+    }
+#endif
+    return usb_host_client_deregister(driver->client_handle);
+}
+
 esp_err_t msc_host_install(const msc_host_driver_config_t *config)
 {
     esp_err_t ret;
 
     MSC_RETURN_ON_INVALID_ARG(config);
     MSC_RETURN_ON_INVALID_ARG(config->callback);
-    if ( config->create_backround_task ) {
+#if !USB_HOST_SHARED_CLIENT_ENABLED
+    MSC_RETURN_ON_FALSE(!config->shared_client, ESP_ERR_NOT_SUPPORTED);
+#endif
+    if ( config->create_backround_task && !config->shared_client ) {
         MSC_RETURN_ON_FALSE(config->stack_size != 0, ESP_ERR_INVALID_ARG);
         MSC_RETURN_ON_FALSE(config->task_priority != 0, ESP_ERR_INVALID_ARG);
     }
+    MSC_RETURN_ON_FALSE(config->transfer_pool_size >= 0, ESP_ERR_INVALID_ARG);
+    MSC_RETURN_ON_FALSE(config->id_cache_size >= 0, ESP_ERR_INVALID_ARG);
+    MSC_RETURN_ON_FALSE(config->async_io.queue_size >= 0, ESP_ERR_INVALID_ARG);
+    if ( config->async_io.queue_size ) {
+        MSC_RETURN_ON_FALSE(config->async_io.stack_size != 0, ESP_ERR_INVALID_ARG);
+        MSC_RETURN_ON_FALSE(config->async_io.task_priority != 0, ESP_ERR_INVALID_ARG);
+    }
     MSC_RETURN_ON_FALSE(!s_msc_driver, ESP_ERR_INVALID_STATE);
 
-    msc_driver_t *driver = calloc(1, sizeof(msc_driver_t));
+    msc_driver_t *driver = MSC_CALLOC(CONTROL, 1, sizeof(msc_driver_t));
     MSC_RETURN_ON_FALSE(driver, ESP_ERR_NO_MEM);
     driver->user_cb = config->callback;
     driver->user_arg = config->callback_arg;
+    // Data transfers are split at multiples of 512 bytes, so each of them is a multiple of MPS
+    driver->data_xfer_size = config->max_transfer_size ? usb_round_up_to_mps(config->max_transfer_size, 512) : DEFAULT_DATA_XFER_SIZE;
+    driver->data_xfer_num = config->transfer_pool_size ? config->transfer_pool_size : DEFAULT_DATA_XFER_NUM;
+    driver->async_io = config->async_io;
+    driver->shared_client = config->shared_client;
 
     usb_host_client_config_t client_config = {
         .async.client_event_callback = client_event_cb,
@@ -421,8 +790,18 @@ esp_err_t msc_host_install(const msc_host_driver_config_t *config)
     driver->end_client_event_handling = false;
     driver->all_events_handled = xSemaphoreCreateBinary();
     MSC_GOTO_ON_FALSE(driver->all_events_handled, ESP_ERR_NO_MEM);
+    if (config->id_cache_size) {
+        MSC_GOTO_ON_ERROR( msc_id_cache_create(config->id_cache_size, &driver->id_cache) );
+    }
 
-    MSC_GOTO_ON_ERROR( usb_host_client_register(&client_config, &driver->client_handle) );
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    if (driver->shared_client) {
+        MSC_GOTO_ON_ERROR( usb_host_shared_client_register(client_event_cb, NULL, &driver->client_handle) );
+    } else
+#endif
+    {
+        MSC_GOTO_ON_ERROR( usb_host_client_register(&client_config, &driver->client_handle) );
+    }
 
     MSC_ENTER_CRITICAL();
     MSC_GOTO_ON_FALSE_CRITICAL(!s_msc_driver, ESP_ERR_INVALID_STATE);
@@ -430,7 +809,7 @@ esp_err_t msc_host_install(const msc_host_driver_config_t *config)
     STAILQ_INIT(&s_msc_driver->devices_tailq);
     MSC_EXIT_CRITICAL();
 
-    if (config->create_backround_task) {
+    if (config->create_backround_task && !driver->shared_client) {
         BaseType_t task_created = xTaskCreatePinnedToCore(
                                       event_handler_task,
                                       "USB MSC",
@@ -442,15 +821,20 @@ esp_err_t msc_host_install(const msc_host_driver_config_t *config)
         MSC_GOTO_ON_FALSE(task_created, ESP_ERR_NO_MEM);
     }
 
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    // Only fails if the driver is registered already, which the check of s_msc_driver excludes
+    ESP_ERROR_CHECK( usb_host_pm_register(USB_HOST_PM_DRIVER_MSC, &msc_pm_ops, NULL) );
+#endif
     return ESP_OK;
 
 fail:
     s_msc_driver = NULL;
-    usb_host_client_deregister(driver->client_handle);
+    client_deregister(driver);
     if (driver->all_events_handled) {
         vSemaphoreDelete(driver->all_events_handled);
     }
-    free(driver);
+    msc_id_cache_delete(driver->id_cache);
+    MSC_FREE(CONTROL, driver, sizeof(msc_driver_t));
     return ret;
 }
 
@@ -466,26 +850,60 @@ esp_err_t msc_host_uninstall(void)
     s_msc_driver->end_client_event_handling = true;
     MSC_EXIT_CRITICAL();
 
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    // Fails if suspend or resume is in progress, its hooks use the driver
+    if (usb_host_pm_deregister(USB_HOST_PM_DRIVER_MSC) != ESP_OK) {
+        s_msc_driver->end_client_event_handling = false;
+        return ESP_ERR_INVALID_STATE;
+    }
+#endif
+
     if (s_msc_driver->event_handling_started) {
         ESP_ERROR_CHECK( usb_host_client_unblock(s_msc_driver->client_handle) );
         // In case the event handling started, we must wait until it finishes
         xSemaphoreTake(s_msc_driver->all_events_handled, portMAX_DELAY);
     }
     vSemaphoreDelete(s_msc_driver->all_events_handled);
-    ESP_ERROR_CHECK( usb_host_client_deregister(s_msc_driver->client_handle) );
-    free(s_msc_driver);
+    ESP_ERROR_CHECK( client_deregister(s_msc_driver) );
+    msc_id_cache_delete(s_msc_driver->id_cache);
+    MSC_FREE(CONTROL, s_msc_driver, sizeof(msc_driver_t));
     s_msc_driver = NULL;
     return ESP_OK;
 }
 
 esp_err_t msc_host_install_device(uint8_t device_address, msc_host_device_handle_t *msc_device_handle)
+{
+    return msc_host_install_device_with_config(device_address, NULL, msc_device_handle);
+}
+
+esp_err_t msc_host_install_device_with_config(uint8_t device_address, const msc_host_device_config_t *config,
+                                              msc_host_device_handle_t *msc_device_handle)
 {
     esp_err_t ret;
-    uint32_t block_size, block_count;
+    uint8_t max_lun = 0;
+    bool lun_found = false;
+    bool cached = false;
+    msc_id_t id;
     const usb_config_desc_t *config_desc;
     msc_device_t *msc_device;
 
-    MSC_GOTO_ON_FALSE( msc_device = calloc(1, sizeof(msc_device_t)), ESP_ERR_NO_MEM );
+    MSC_RETURN_ON_INVALID_ARG(msc_device_handle);
+    if (config) {
+        MSC_RETURN_ON_FALSE(config->async_io.queue_size >= 0, ESP_ERR_INVALID_ARG);
+        if ( config->async_io.queue_size ) {
+            MSC_RETURN_ON_FALSE(config->async_io.stack_size != 0, ESP_ERR_INVALID_ARG);
+            MSC_RETURN_ON_FALSE(config->async_io.task_priority != 0, ESP_ERR_INVALID_ARG);
+        }
+    }
+
+    MSC_GOTO_ON_FALSE( msc_device = MSC_CALLOC(CONTROL, 1, sizeof(msc_device_t)), ESP_ERR_NO_MEM );
+    msc_device->lun_num = 1;
+    msc_device->transfer_timeout_ms = (config && config->transfer_timeout_ms) ? config->transfer_timeout_ms : DEFAULT_TRANSFER_TIMEOUT_MS;
+    msc_device->timeout.cmd_ms = msc_device->transfer_timeout_ms;
+    msc_device->timeout.adaptive = config && config->adaptive_timeout;
+    for (uint8_t lun = 0; lun < MSC_MAX_LUN_NUM; lun++) {
+        msc_device->disk[lun].lun = lun;
+    }
 
     MSC_ENTER_CRITICAL();
     MSC_GOTO_ON_FALSE_CRITICAL( s_msc_driver, ESP_ERR_INVALID_STATE );
@@ -493,22 +911,69 @@ esp_err_t msc_host_install_device(uint8_t device_address, msc_host_device_handle
     STAILQ_INSERT_TAIL(&s_msc_driver->devices_tailq, msc_device, tailq_entry);
     MSC_EXIT_CRITICAL();
 
-    MSC_GOTO_ON_FALSE( msc_device->transfer_done = xSemaphoreCreateBinary(), ESP_ERR_NO_MEM);
-    MSC_GOTO_ON_ERROR( usb_host_device_open(s_msc_driver->client_handle, device_address, &msc_device->handle) );
+    // Completed transfers are queued. CBW, CSW and all data transfers, or UAS status and all commands, can be in flight
+    const int max_in_flight = MAX(s_msc_driver->data_xfer_num + 2, MSC_UAS_MAX_COMMANDS + 1);
+    MSC_GOTO_ON_FALSE( msc_device->transfer_done = xQueueCreate(max_in_flight, sizeof(usb_transfer_t *)), ESP_ERR_NO_MEM);
+    MSC_GOTO_ON_FALSE( msc_device->lock = xSemaphoreCreateRecursiveMutex(), ESP_ERR_NO_MEM);
+    MSC_GOTO_ON_ERROR( CLIENT_DEVICE_OPEN(s_msc_driver->client_handle, device_address, &msc_device->handle) );
     MSC_GOTO_ON_ERROR( usb_host_get_active_config_descriptor(msc_device->handle, &config_desc) );
     MSC_GOTO_ON_ERROR( extract_config_from_descriptor(config_desc, &msc_device->config) );
-    MSC_GOTO_ON_ERROR( usb_host_transfer_alloc(DEFAULT_XFER_SIZE, 0, &msc_device->xfer) );
+    MSC_GOTO_ON_ERROR( CLIENT_TRANSFER_ALLOC(DEFAULT_XFER_SIZE, 0, &msc_device->xfer) );
+    MSC_GOTO_ON_ERROR( CLIENT_TRANSFER_ALLOC(MAX(DEFAULT_XFER_SIZE, msc_device->config.bulk_in_mps), 0, &msc_device->csw_xfer) );
+    MSC_GOTO_ON_FALSE( msc_device->data_xfer = MSC_CALLOC(CONTROL, s_msc_driver->data_xfer_num, sizeof(msc_data_xfer_t)), ESP_ERR_NO_MEM );
+    msc_device->data_xfer_num = s_msc_driver->data_xfer_num;
+    for (int i = 0; i < msc_device->data_xfer_num; i++) {
+        MSC_GOTO_ON_ERROR( CLIENT_TRANSFER_ALLOC(s_msc_driver->data_xfer_size, 0, &msc_device->data_xfer[i].xfer) );
+        msc_device->data_xfer[i].buffer = msc_device->data_xfer[i].xfer->data_buffer;
+    }
+    if (msc_device->config.transport == MSC_TRANSPORT_UAS) {
+        MSC_GOTO_ON_ERROR( CLIENT_TRANSFER_ALLOC(usb_round_up_to_mps(DEFAULT_XFER_SIZE, msc_device->config.uas_status_mps), 0, &msc_device->uas.status_xfer) );
+        for (int i = 0; i < MSC_UAS_MAX_COMMANDS; i++) {
+            MSC_GOTO_ON_ERROR( CLIENT_TRANSFER_ALLOC(sizeof(uas_command_iu_t), 0, &msc_device->uas.cmd_xfer[i]) );
+        }
+    }
     MSC_GOTO_ON_ERROR( usb_host_interface_claim(
                            s_msc_driver->client_handle,
                            msc_device->handle,
-                           msc_device->config.iface_num, 0) );
+                           msc_device->config.iface_num,
+                           msc_device->config.alt_setting) );
+    if (msc_device->config.alt_setting != 0) {
+        MSC_GOTO_ON_ERROR( msc_set_interface(msc_device) );
+    }
+    ESP_LOGD(TAG, "Transport: %s", msc_device->config.transport == MSC_TRANSPORT_UAS ? "UAS" : "BOT");
 
-    MSC_GOTO_ON_ERROR( scsi_cmd_inquiry(msc_device) );
-    MSC_GOTO_ON_ERROR( msc_wait_for_ready_state(msc_device, WAIT_FOR_READY_TIMEOUT_MS) );
-    MSC_GOTO_ON_ERROR( scsi_cmd_read_capacity(msc_device, &block_size, &block_count) );
+    if (s_msc_driver->id_cache) {
+        cached = msc_id_cache_find(s_msc_driver->id_cache, msc_device, &id);
+    }
+    if (cached) {
+        ESP_LOGD(TAG, "Device identified before");
+        max_lun = id.lun_num - 1;
+    } else if (msc_device->config.transport == MSC_TRANSPORT_BOT && msc_get_max_lun(msc_device, &max_lun) != ESP_OK) {
+        // Devices without multiple LUNs may STALL the request
+        max_lun = 0;
+    }
+    msc_device->lun_num = MIN(max_lun + 1, MSC_MAX_LUN_NUM);
+    ESP_LOGD(TAG, "Number of LUNs: %d", msc_device->lun_num);
+
+    for (uint8_t lun = 0; lun < msc_device->lun_num; lun++) {
+        const esp_err_t err = msc_init_lun(msc_device, lun, (cached && id.lun[lun].valid) ? &id.lun[lun] : NULL);
+        if (err == ESP_OK) {
+            lun_found = true;
+        } else {
+            // Only multi-LUN devices can have Logical Units without medium, like empty slots of a card reader
+            MSC_GOTO_ON_FALSE( msc_device->lun_num > 1, err );
+            ESP_LOGW(TAG, "LUN %d not available (0x%x)", lun, err);
+        }
+    }
+    MSC_GOTO_ON_FALSE( lun_found, ESP_ERR_NOT_FOUND );
+    if (s_msc_driver->id_cache) {
+        msc_id_cache_store(s_msc_driver->id_cache, msc_device);
+    }
+    const msc_host_async_io_config_t *async_io = (config && config->async_io.queue_size) ? &config->async_io : &s_msc_driver->async_io;
+    if (async_io->queue_size) {
+        MSC_GOTO_ON_ERROR( msc_async_start(msc_device, async_io) );
+    }
 
-    msc_device->disk.block_size = block_size;
-    msc_device->disk.block_count = block_count;
     *msc_device_handle = msc_device;
 
     return ESP_OK;
@@ -529,7 +994,7 @@ esp_err_t msc_host_read_sector(msc_host_device_handle_t device, size_t sector, v
     MSC_RETURN_ON_INVALID_ARG(device);
     msc_device_t *dev = (msc_device_t *)device;
 
-    return scsi_cmd_read10(dev, data, sector, 1, dev->disk.block_size);
+    return scsi_cmd_read(dev, 0, data, sector, 1, dev->disk[0].block_size);
 }
 
 esp_err_t msc_host_write_sector(msc_host_device_handle_t device, size_t sector, const void *data, size_t size)
@@ -537,7 +1002,7 @@ esp_err_t msc_host_write_sector(msc_host_device_handle_t device, size_t sector,
     MSC_RETURN_ON_INVALID_ARG(device);
     msc_device_t *dev = (msc_device_t *)device;
 
-    return scsi_cmd_write10(dev, data, sector, 1, dev->disk.block_size);
+    return scsi_cmd_write(dev, 0, data, sector, 1, dev->disk[0].block_size);
 }
 
 static void copy_string_desc(wchar_t *dest, const usb_str_desc_t *src)
@@ -559,11 +1024,17 @@ static void copy_string_desc(wchar_t *dest, const usb_str_desc_t *src)
 }
 
 esp_err_t msc_host_get_device_info(msc_host_device_handle_t device, msc_host_device_info_t *info)
+{
+    return msc_host_get_lun_info(device, 0, info);
+}
+
+esp_err_t msc_host_get_lun_info(msc_host_device_handle_t device, uint8_t lun, msc_host_device_info_t *info)
 {
     MSC_RETURN_ON_INVALID_ARG(device);
     MSC_RETURN_ON_INVALID_ARG(info);
 
     msc_device_t *dev = (msc_device_t *)device;
+    MSC_RETURN_ON_FALSE(lun < dev->lun_num, ESP_ERR_INVALID_ARG);
     const usb_device_desc_t *desc;
     usb_device_info_t dev_info;
 
@@ -572,8 +1043,10 @@ esp_err_t msc_host_get_device_info(msc_host_device_handle_t device, msc_host_dev
 
     info->idProduct = desc->idProduct;
     info->idVendor = desc->idVendor;
-    info->sector_size = dev->disk.block_size;
-    info->sector_count = dev->disk.block_count;
+    info->sector_size = dev->disk[lun].block_size;
+    info->physical_sector_size = dev->disk[lun].block_size << dev->disk[lun].phys_block_exp;
+    info->sector_count = dev->disk[lun].block_count;
+    info->lun_num = dev->lun_num;
 
     copy_string_desc(info->iManufacturer, dev_info.str_desc_manufacturer);
     copy_string_desc(info->iProduct, dev_info.str_desc_product);
@@ -582,6 +1055,29 @@ esp_err_t msc_host_get_device_info(msc_host_device_handle_t device, msc_host_dev
     return ESP_OK;
 }
 
+esp_err_t msc_host_get_stats(msc_host_device_handle_t device, msc_host_stats_t *stats_ret)
+{
+    MSC_RETURN_ON_INVALID_ARG(device);
+    MSC_RETURN_ON_INVALID_ARG(stats_ret);
+    msc_device_t *dev = (msc_device_t *)device;
+
+    MSC_ENTER_CRITICAL();
+    *stats_ret = dev->stats;
+    MSC_EXIT_CRITICAL();
+    return ESP_OK;
+}
+
+esp_err_t msc_host_reset_stats(msc_host_device_handle_t device)
+{
+    MSC_RETURN_ON_INVALID_ARG(device);
+    msc_device_t *dev = (msc_device_t *)device;
+
+    MSC_ENTER_CRITICAL();
+    memset(&dev->stats, 0, sizeof(msc_host_stats_t));
+    MSC_EXIT_CRITICAL();
+    return ESP_OK;
+}
+
 esp_err_t msc_host_print_descriptors(msc_host_device_handle_t device)
 {
     msc_device_t *dev = (msc_device_t *)device;
@@ -594,75 +1090,566 @@ esp_err_t msc_host_print_descriptors(msc_host_device_handle_t device)
     return ESP_OK;
 }
 
+/**
+ * @brief Account latency of a command phase in statistics
+ *
+ * Bucket 0: < 125 us, bucket i: <125 * 2^(i-1); 125 * 2^i) us, last bucket: everything above
+ *
+ * @param[out] histogram Latency histogram of the phase
+ * @param[in]  time_us   Measured latency
+ */
+static void msc_stats_latency(uint32_t histogram[MSC_HOST_STATS_HIST_BUCKETS], int64_t time_us)
+{
+    unsigned bucket = 0;
+    int64_t time = time_us / 125;
+    while (time > 0 && bucket < MSC_HOST_STATS_HIST_BUCKETS - 1) {
+        time >>= 1;
+        bucket++;
+    }
+    histogram[bucket]++;
+}
+
+/**
+ * @brief Phases of one Bulk-Only Transport command, each phase is accounted once it ends
+ */
+typedef struct {
+    int64_t phase_start;
+    bool cmd_done;
+    bool data_done;
+    bool status_done;
+} msc_phase_timer_t;
+
+static void msc_phase_timer_update(msc_device_t *device, msc_phase_timer_t *timer, bool cmd_done, bool data_done, bool status_done)
+{
+    const int64_t now = esp_timer_get_time();
+    if (cmd_done && !timer->cmd_done) {
+        timer->cmd_done = true;
+        msc_stats_latency(device->stats.cmd_latency, now - timer->phase_start);
+        timer->phase_start = now;
+    }
+    if (data_done && !timer->data_done) {
+        timer->data_done = true;
+        msc_stats_latency(device->stats.data_latency, now - timer->phase_start);
+        timer->phase_start = now;
+    }
+    if (status_done && !timer->status_done) {
+        timer->status_done = true;
+        msc_stats_latency(device->stats.status_latency, now - timer->phase_start);
+        timer->phase_start = now;
+    }
+}
+
 static void transfer_callback(usb_transfer_t *transfer)
 {
+    CLIENT_TRACE_COMPLETE(transfer);
     msc_device_t *device = (msc_device_t *)transfer->context;
 
     if (transfer->status != USB_TRANSFER_STATUS_COMPLETED) {
         ESP_LOGE("Transfer failed", "Status %d", transfer->status);
+        device->stats.stalls += (transfer->status == USB_TRANSFER_STATUS_STALL);
     }
 
-    xSemaphoreGive(device->transfer_done);
+    xQueueSend(device->transfer_done, &transfer, 0);
 }
 
 static usb_transfer_status_t wait_for_transfer_done(usb_transfer_t *xfer)
 {
     msc_device_t *device = (msc_device_t *)xfer->context;
-    BaseType_t received = xSemaphoreTake(device->transfer_done, pdMS_TO_TICKS(xfer->timeout_ms));
+    usb_transfer_t *done;
+    BaseType_t received = xQueueReceive(device->transfer_done, &done, pdMS_TO_TICKS(xfer->timeout_ms));
     usb_transfer_status_t status = xfer->status;
 
     if (received != pdTRUE) {
         usb_host_endpoint_halt(xfer->device_handle, xfer->bEndpointAddress);
         usb_host_endpoint_flush(xfer->device_handle, xfer->bEndpointAddress);
         usb_host_endpoint_clear(xfer->device_handle, xfer->bEndpointAddress);
-        xSemaphoreTake(device->transfer_done, portMAX_DELAY); // Since we flushed the EP, this should return immediately
+        xQueueReceive(device->transfer_done, &done, portMAX_DELAY); // Since we flushed the EP, this should return immediately
         status = USB_TRANSFER_STATUS_TIMED_OUT;
     }
 
     return status;
 }
 
-esp_err_t msc_bulk_transfer(msc_device_t *device, uint8_t *data, size_t size, msc_endpoint_t ep)
+/**
+ * @brief Point the transfer to a data buffer
+ *
+ * data_buffer and data_buffer_size are const to protect transfers in flight. The transfer is idle here,
+ * so the DMA can access the caller's buffer directly. The original buffer must be restored before the transfer is freed.
+ */
+static inline void transfer_set_buffer(usb_transfer_t *xfer, uint8_t *buffer, size_t buffer_size)
 {
-    esp_err_t ret = ESP_OK;
-    usb_transfer_t *xfer = device->xfer;
-    size_t transfer_size = (ep == MSC_EP_IN) ? usb_round_up_to_mps(size, device->config.bulk_in_mps) : size;
+    *(uint8_t **)&xfer->data_buffer = buffer;
+    *(size_t *)&xfer->data_buffer_size = buffer_size;
+}
 
-    if (xfer->data_buffer_size < transfer_size) {
-        // The allocated buffer is not large enough -> realloc
-        MSC_RETURN_ON_ERROR( usb_host_transfer_free(xfer) );
-        MSC_RETURN_ON_ERROR( usb_host_transfer_alloc(transfer_size, 0, &device->xfer) );
-        xfer = device->xfer;
-    }
+/**
+ * @brief Check that the USB DMA can access the buffer directly
+ *
+ * @param[in] data          Data buffer
+ * @param[in] transfer_size Size of the transfer, it must fit in the buffer
+ * @param[in] size          Size of the buffer
+ */
+static inline bool is_dma_buffer(const uint8_t *data, size_t transfer_size, size_t size)
+{
+    return esp_ptr_dma_capable(data) &&
+           ((uintptr_t)data % DMA_BUFFER_ALIGNMENT) == 0 &&
+           (transfer_size % DMA_BUFFER_ALIGNMENT) == 0 &&
+           transfer_size <= size;
+}
 
-    if (ep == MSC_EP_IN) {
-        xfer->bEndpointAddress = device->config.bulk_in_ep;
-    } else {
-        xfer->bEndpointAddress = device->config.bulk_out_ep;
-        memcpy(xfer->data_buffer, data, size);
+static inline msc_endpoint_t transfer_direction(const usb_transfer_t *xfer)
+{
+    return is_in_endpoint(xfer->bEndpointAddress) ? MSC_EP_IN : MSC_EP_OUT;
+}
+
+static esp_err_t transfer_status_to_err(usb_transfer_status_t status)
+{
+    switch (status) {
+    case USB_TRANSFER_STATUS_COMPLETED:
+        return ESP_OK;
+    case USB_TRANSFER_STATUS_STALL:
+        return ESP_ERR_MSC_STALL;
+    case USB_TRANSFER_STATUS_TIMED_OUT:
+        return ESP_ERR_TIMEOUT;
+    default:
+        return ESP_ERR_MSC_INTERNAL;
     }
+}
 
+static esp_err_t msc_bulk_submit(msc_device_t *device, usb_transfer_t *xfer, uint8_t ep_addr, size_t transfer_size)
+{
+    xfer->bEndpointAddress = ep_addr;
     xfer->num_bytes = transfer_size;
     xfer->device_handle = device->handle;
     xfer->callback = transfer_callback;
-    xfer->timeout_ms = 5000;
+    xfer->timeout_ms = device->timeout.cmd_ms;
     xfer->context = device;
+    return CLIENT_TRANSFER_SUBMIT(xfer);
+}
 
-    MSC_RETURN_ON_ERROR( usb_host_transfer_submit(xfer) );
-    const usb_transfer_status_t status = wait_for_transfer_done(xfer);
-    switch (status) {
-    case USB_TRANSFER_STATUS_COMPLETED:
-        if (ep == MSC_EP_IN) {
-            memcpy(data, xfer->data_buffer, xfer->actual_num_bytes);
+/**
+ * @brief Cancel transfers in flight on the endpoint
+ *
+ * @param[in] device  MSC device handle
+ * @param[in] ep_addr Endpoint address
+ * @param[in] stalled The endpoint is stalled. It is left halted, so the STALL can be cleared by clear_feature()
+ */
+static void msc_bulk_cancel(msc_device_t *device, uint8_t ep_addr, bool stalled)
+{
+    usb_host_endpoint_halt(device->handle, ep_addr);
+    usb_host_endpoint_flush(device->handle, ep_addr);
+    if (!stalled) {
+        usb_host_endpoint_clear(device->handle, ep_addr);
+    }
+}
+
+/**
+ * @brief Pipelined Bulk-Only Transport
+ *
+ * Command, data and status transfers are queued at once, so the device does not wait for the host between the phases.
+ * The data are split to chunks of the data transfer size and all data transfers are kept in flight,
+ * so the next chunk is copied while the previous ones are transferred.
+ * Bulk transfers on one endpoint complete in order, so the status transfer completes after all data transfers.
+ * If the device ends the data phase by a short packet, the status is received by the next data transfer in flight.
+ *
+ * @param[in]    device  MSC device handle
+ * @param[in]    cbw     Command Block Wrapper, NULL for data transport only
+ * @param[in]    cbw_len Length of CBW
+ * @param[inout] data    Data buffer
+ * @param[in]    size    Size of data in bytes, 0 for no data transport
+ * @param[in]    ep      Direction of the data transport
+ * @param[out]   csw     Command Status Wrapper, NULL for no status transport
+ * @param[in]    csw_len Length of CSW
+ * @param[out]   csw_err Result of status transport, can be NULL if csw is NULL
+ * @return Result of command and data transport
+ */
+static esp_err_t msc_bulk_pipeline(msc_device_t *device, const uint8_t *cbw, size_t cbw_len,
+                                   uint8_t *data, size_t size, msc_endpoint_t ep,
+                                   uint8_t *csw, size_t csw_len, esp_err_t *csw_err)
+{
+    const size_t mps = device->config.bulk_in_mps;
+    const size_t chunk_size = s_msc_driver->data_xfer_size;
+    const uint8_t ep_addr[2] = {device->config.bulk_out_ep, device->config.bulk_in_ep}; // Indexed by msc_endpoint_t
+    const bool direct = size && is_dma_buffer(data, (ep == MSC_EP_IN) ? usb_round_up_to_mps(size, mps) : size, size);
+    int in_flight[2] = {0, 0};
+    bool stalled[2] = {false, false};
+    esp_err_t ret = ESP_OK;
+    size_t submit_offset = 0;
+    size_t done_offset = 0;
+    int head = 0; // Next data transfer to submit
+    int data_in_flight = 0;
+    bool data_done = (size == 0);
+    bool csw_submitted = false;
+    bool csw_done = (csw == NULL);
+    bool cbw_done = (cbw == NULL);
+    msc_phase_timer_t timer = {
+        .phase_start = esp_timer_get_time(),
+        .cmd_done = cbw_done,
+        .data_done = data_done,
+        .status_done = csw_done,
+    };
+
+    if (csw_err) {
+        *csw_err = ESP_ERR_MSC_INTERNAL;
+    }
+    device->stats.bounced_data_phases += (size && !direct);
+
+    // 1. Command transport
+    if (cbw) {
+        memcpy(device->xfer->data_buffer, cbw, cbw_len);
+        ret = msc_bulk_submit(device, device->xfer, ep_addr[MSC_EP_OUT], cbw_len);
+        in_flight[MSC_EP_OUT] += (ret == ESP_OK);
+    }
+
+    while (ret == ESP_OK && !(data_done && csw_done)) {
+        msc_phase_timer_update(device, &timer, cbw_done, data_done, csw_done);
+
+        // 2. Data transport: Keep all data transfers in flight
+        while (!data_done && data_in_flight < device->data_xfer_num && submit_offset < size) {
+            usb_transfer_t *xfer = device->data_xfer[head].xfer;
+            const size_t chunk = MIN(size - submit_offset, chunk_size);
+            const size_t transfer_size = (ep == MSC_EP_IN) ? usb_round_up_to_mps(chunk, mps) : chunk;
+            if (direct) {
+                transfer_set_buffer(xfer, data + submit_offset, transfer_size);
+            } else if (ep == MSC_EP_OUT) {
+                memcpy(xfer->data_buffer, data + submit_offset, chunk);
+            }
+            ret = msc_bulk_submit(device, xfer, ep_addr[ep], transfer_size);
+            if (ret != ESP_OK) {
+                break;
+            }
+            head = (head + 1) % device->data_xfer_num;
+            submit_offset += chunk;
+            data_in_flight++;
+            in_flight[ep]++;
         }
-        ret = ESP_OK;
-        break;
-    case USB_TRANSFER_STATUS_STALL:
-        ret = ESP_ERR_MSC_STALL; break;
-    default:
-        ret = ESP_ERR_MSC_INTERNAL; break;
+
+        // 3. Status transport is queued behind the last data transfer
+        if (ret == ESP_OK && !csw_done && !csw_submitted && (submit_offset == size || (data_done && data_in_flight == 0))) {
+            ret = msc_bulk_submit(device, device->csw_xfer, ep_addr[MSC_EP_IN], usb_round_up_to_mps(csw_len, mps));
+            csw_submitted = (ret == ESP_OK);
+            in_flight[MSC_EP_IN] += csw_submitted;
+        }
+        if (ret != ESP_OK) {
+            break;
+        }
+
+        usb_transfer_t *done;
+        if (xQueueReceive(device->transfer_done, &done, pdMS_TO_TICKS(device->timeout.cmd_ms)) != pdTRUE) {
+            ret = ESP_ERR_TIMEOUT; // All transfers in flight are canceled below
+            break;
+        }
+        const msc_endpoint_t done_ep = transfer_direction(done);
+        const esp_err_t done_err = transfer_status_to_err(done->status);
+        in_flight[done_ep]--;
+        stalled[done_ep] |= (done_err == ESP_ERR_MSC_STALL);
+
+        if (done == device->xfer) {
+            ret = done_err;
+            cbw_done = true;
+        } else if (done == device->csw_xfer) {
+            // The device may also end the data phase by the status, remaining data transfers are canceled below
+            *csw_err = done_err;
+            if (done_err == ESP_OK) {
+                memcpy(csw, done->data_buffer, MIN((size_t)done->actual_num_bytes, csw_len));
+            }
+            csw_done = true;
+            data_done = true;
+        } else if (data_done) {
+            // Data transfer behind a short packet received the status, or the device stalled Bulk-In before the status
+            data_in_flight--;
+            if (done_err != ESP_OK || done->actual_num_bytes == csw_len) {
+                *csw_err = done_err;
+                if (done_err == ESP_OK) {
+                    memcpy(csw, done->data_buffer, csw_len);
+                }
+                csw_done = true;
+            }
+        } else {
+            data_in_flight--;
+            if (done_err == ESP_ERR_MSC_STALL && ep == MSC_EP_IN && csw) {
+                // The device ended the data phase by STALL, the status is read after clearing the STALL
+                *csw_err = done_err;
+                csw_done = true;
+                data_done = true;
+                continue;
+            }
+            if (done_err != ESP_OK) {
+                ret = done_err;
+                break;
+            }
+            const size_t chunk = MIN(size - done_offset, chunk_size);
+            if (ep == MSC_EP_IN) {
+                if (!direct) {
+                    memcpy(data + done_offset, done->data_buffer, MIN((size_t)done->actual_num_bytes, chunk));
+                }
+                if (done->actual_num_bytes < done->num_bytes) {
+                    data_done = true; // Short packet ends the data phase
+                }
+            }
+            done_offset += chunk;
+            data_done |= (done_offset == size);
+        }
+    }
+
+    if (ret == ESP_OK) {
+        msc_phase_timer_update(device, &timer, cbw_done, data_done, csw_done);
+    }
+
+    // Transfers still in flight are not needed anymore
+    for (int dir = MSC_EP_OUT; dir <= MSC_EP_IN; dir++) {
+        if (in_flight[dir]) {
+            msc_bulk_cancel(device, ep_addr[dir], stalled[dir]);
+        }
+    }
+    for (int i = in_flight[MSC_EP_OUT] + in_flight[MSC_EP_IN]; i > 0; i--) {
+        usb_transfer_t *done;
+        xQueueReceive(device->transfer_done, &done, portMAX_DELAY); // Since we flushed the EPs, this should return immediately
+    }
+    if (direct) {
+        for (int i = 0; i < device->data_xfer_num; i++) {
+            transfer_set_buffer(device->data_xfer[i].xfer, device->data_xfer[i].buffer, chunk_size);
+        }
+    }
+    return ret;
+}
+
+esp_err_t msc_bot_transfer(msc_device_t *device, const uint8_t *cbw, size_t cbw_len,
+                           uint8_t *data, size_t size, msc_endpoint_t ep,
+                           uint8_t *csw, size_t csw_len, esp_err_t *csw_err)
+{
+    return msc_bulk_pipeline(device, cbw, cbw_len, data, size, ep, csw, csw_len, csw_err);
+}
+
+esp_err_t msc_bulk_transfer(msc_device_t *device, uint8_t *data, size_t size, msc_endpoint_t ep)
+{
+    const size_t transfer_size = (ep == MSC_EP_IN) ? usb_round_up_to_mps(size, device->config.bulk_in_mps) : size;
+    usb_transfer_t *xfer = (ep == MSC_EP_IN) ? device->csw_xfer : device->xfer;
+
+    // Data phase, or transfers larger than the transfer's own buffer, use the data transfers
+    if (transfer_size > xfer->data_buffer_size) {
+        return msc_bulk_pipeline(device, NULL, 0, data, size, ep, NULL, 0, NULL);
+    }
+
+    // CBW, CSW and short commands are copied through the transfer's own buffer
+    if (ep == MSC_EP_OUT) {
+        memcpy(xfer->data_buffer, data, size);
+    }
+    MSC_RETURN_ON_ERROR( msc_bulk_submit(device, xfer, (ep == MSC_EP_IN) ? device->config.bulk_in_ep : device->config.bulk_out_ep, transfer_size) );
+    const esp_err_t ret = transfer_status_to_err(wait_for_transfer_done(xfer));
+    if (ret == ESP_OK && ep == MSC_EP_IN) {
+        memcpy(data, xfer->data_buffer, MIN((size_t)xfer->actual_num_bytes, size));
+    }
+    return ret;
+}
+
+static esp_err_t uas_submit_status(msc_device_t *device)
+{
+    usb_transfer_t *xfer = device->uas.status_xfer;
+    return msc_bulk_submit(device, xfer, device->config.uas_status_ep, xfer->data_buffer_size);
+}
+
+/**
+ * @brief Cancel UAS transfers in flight on the command and status pipes
+ *
+ * @param[in] device           MSC device handle
+ * @param[in] cmd_in_flight    Number of command transfers in flight
+ * @param[in] status_in_flight Status transfer is in flight
+ */
+static void uas_cancel(msc_device_t *device, int cmd_in_flight, bool status_in_flight)
+{
+    if (cmd_in_flight) {
+        msc_bulk_cancel(device, device->config.uas_cmd_ep, false);
+    }
+    if (status_in_flight) {
+        msc_bulk_cancel(device, device->config.uas_status_ep, false);
+    }
+    for (int i = cmd_in_flight + status_in_flight; i > 0; i--) {
+        usb_transfer_t *done;
+        xQueueReceive(device->transfer_done, &done, portMAX_DELAY); // Since we flushed the EPs, this should return immediately
+    }
+}
+
+/**
+ * @brief Reset logical unit of UAS device
+ *
+ * Stalled pipes are cleared and LOGICAL UNIT RESET aborts all commands in the device, so their tags can be used again.
+ *
+ * @see USB Attached SCSI (UAS) Protocol, Chapter 6.2.3
+ *
+ * @param[in] device MSC device handle
+ * @return esp_err_t
+ */
+static esp_err_t uas_reset(msc_device_t *device)
+{
+    const uint8_t pipes[] = {device->config.uas_cmd_ep, device->config.uas_status_ep, device->config.bulk_in_ep, device->config.bulk_out_ep};
+    usb_transfer_t *tm_xfer = device->uas.cmd_xfer[0];
+    uas_task_management_iu_t *tm_iu = (uas_task_management_iu_t *)tm_xfer->data_buffer;
+    int cmd_in_flight = 0;
+    bool status_in_flight = false;
+    esp_err_t ret = ESP_OK;
+
+    // Clear feature will fail if there is not STALL on the pipe, so we don't check the errors here
+    for (int i = 0; i < sizeof(pipes); i++) {
+        clear_feature(device, pipes[i]);
     }
 
+    memset(tm_iu, 0, sizeof(uas_task_management_iu_t));
+    tm_iu->iu_id = UAS_IU_ID_TASK_MANAGEMENT;
+    tm_iu->tag = __builtin_bswap16(UAS_TAG_TASK_MANAGEMENT);
+    tm_iu->function = UAS_TMF_LOGICAL_UNIT_RESET;
+
+    MSC_GOTO_ON_ERROR( uas_submit_status(device) );
+    status_in_flight = true;
+    MSC_GOTO_ON_ERROR( msc_bulk_submit(device, tm_xfer, device->config.uas_cmd_ep, sizeof(uas_task_management_iu_t)) );
+    cmd_in_flight = 1;
+
+    while (status_in_flight || cmd_in_flight) {
+        usb_transfer_t *done;
+        MSC_GOTO_ON_FALSE( xQueueReceive(device->transfer_done, &done, pdMS_TO_TICKS(device->timeout.cmd_ms)) == pdTRUE, ESP_ERR_TIMEOUT );
+        if (done == tm_xfer) {
+            cmd_in_flight = 0;
+            MSC_GOTO_ON_ERROR( transfer_status_to_err(done->status) );
+            continue;
+        }
+
+        status_in_flight = false;
+        MSC_GOTO_ON_ERROR( transfer_status_to_err(done->status) );
+        const uas_response_iu_t *response = (const uas_response_iu_t *)done->data_buffer;
+        if (done->actual_num_bytes < sizeof(uas_response_iu_t) || response->iu_id != UAS_IU_ID_RESPONSE ||
+                __builtin_bswap16(response->tag) != UAS_TAG_TASK_MANAGEMENT) {
+            // IU of an aborted command, wait for the RESPONSE IU
+            MSC_GOTO_ON_ERROR( uas_submit_status(device) );
+            status_in_flight = true;
+            continue;
+        }
+        MSC_GOTO_ON_FALSE( response->response_code == UAS_RC_TMF_COMPLETE || response->response_code == UAS_RC_TMF_SUCCEEDED, ESP_FAIL );
+    }
+
+fail:
+    uas_cancel(device, cmd_in_flight, status_in_flight);
+    return ret;
+}
+
+esp_err_t msc_uas_transfer(msc_device_t *device, const msc_uas_cmd_t *cmds, int num)
+{
+    assert(num > 0 && num <= MSC_UAS_MAX_COMMANDS);
+    esp_err_t cmd_ret[MSC_UAS_MAX_COMMANDS];
+    int cmd_in_flight = 0;
+    bool status_in_flight = false;
+    int outstanding = 0;
+    int ready_tag = 0; // Command whose data phase waits for the command transfers to complete, 0 for none
+    esp_err_t ret = ESP_OK;
+    // Data phases are accounted by msc_bulk_transfer()
+    msc_phase_timer_t timer = {
+        .phase_start = esp_timer_get_time(),
+        .data_done = true,
+    };
+
+    device->uas.sense_len = 0;
+
+    // Status pipe receives READ READY, WRITE READY and SENSE IUs of all commands, one IU per transfer
+    MSC_GOTO_ON_ERROR( uas_submit_status(device) );
+    status_in_flight = true;
+
+    // 1. Command IUs of all commands are queued at once, tags 1 to num
+    for (int i = 0; i < num; i++) {
+        usb_transfer_t *xfer = device->uas.cmd_xfer[i];
+        uas_command_iu_t *iu = (uas_command_iu_t *)xfer->data_buffer;
+        memset(iu, 0, sizeof(uas_command_iu_t));
+        iu->iu_id = UAS_IU_ID_COMMAND;
+        iu->tag = __builtin_bswap16(i + 1);
+        iu->lun[1] = cmds[i].lun; // Single level LUN, peripheral device addressing
+        memcpy(iu->cdb, cmds[i].cdb, MIN(cmds[i].cdb_len, sizeof(iu->cdb)));
+        cmd_ret[i] = ESP_ERR_NOT_FINISHED;
+        MSC_GOTO_ON_ERROR( msc_bulk_submit(device, xfer, device->config.uas_cmd_ep, sizeof(uas_command_iu_t)) );
+        cmd_in_flight++;
+        outstanding++;
+    }
+
+    while (outstanding) {
+        // 2. Data transport: The device selects the command by READ READY or WRITE READY IU.
+        // No other transfer is in flight during the data phase, so the data transfers are used as in BOT data phase
+        if (ready_tag && cmd_in_flight == 0) {
+            const msc_uas_cmd_t *cmd = &cmds[ready_tag - 1];
+            ready_tag = 0;
+            MSC_GOTO_ON_ERROR( msc_bulk_transfer(device, cmd->data, cmd->size, cmd->ep) );
+            timer.phase_start = esp_timer_get_time();
+            MSC_GOTO_ON_ERROR( uas_submit_status(device) );
+            status_in_flight = true;
+            continue;
+        }
+
+        usb_transfer_t *done;
+        MSC_GOTO_ON_FALSE( xQueueReceive(device->transfer_done, &done, pdMS_TO_TICKS(device->timeout.cmd_ms)) == pdTRUE, ESP_ERR_TIMEOUT );
+        if (done != device->uas.status_xfer) {
+            cmd_in_flight--;
+            MSC_GOTO_ON_ERROR( transfer_status_to_err(done->status) );
+            msc_phase_timer_update(device, &timer, cmd_in_flight == 0, true, false);
+            continue;
+        }
+
+        // 3. Status transport
+        status_in_flight = false;
+        MSC_GOTO_ON_ERROR( transfer_status_to_err(done->status) );
+        const uas_sense_iu_t *iu = (const uas_sense_iu_t *)done->data_buffer;
+        const int tag = __builtin_bswap16(iu->tag);
+        MSC_GOTO_ON_FALSE( done->actual_num_bytes >= 4 && tag >= 1 && tag <= num && cmd_ret[tag - 1] == ESP_ERR_NOT_FINISHED,
+                           ESP_ERR_INVALID_RESPONSE );
+        const msc_uas_cmd_t *cmd = &cmds[tag - 1];
+
+        switch (iu->iu_id) {
+        case UAS_IU_ID_READ_READY:
+        case UAS_IU_ID_WRITE_READY:
+            MSC_GOTO_ON_FALSE( cmd->size && cmd->ep == ((iu->iu_id == UAS_IU_ID_READ_READY) ? MSC_EP_IN : MSC_EP_OUT), ESP_ERR_INVALID_RESPONSE );
+            ready_tag = tag;
+            continue; // Status is received again after the data phase
+        case UAS_IU_ID_SENSE:
+            MSC_GOTO_ON_FALSE( done->actual_num_bytes >= sizeof(uas_sense_iu_t), ESP_ERR_INVALID_RESPONSE );
+            timer.status_done = false; // Each command has its own SENSE IU
+            msc_phase_timer_update(device, &timer, true, true, true);
+            cmd_ret[tag - 1] = (iu->status == 0) ? ESP_OK : ESP_FAIL;
+            if (iu->status != 0) {
+                ESP_LOGD(TAG, "UAS command failed: Status 0x%02x", iu->status);
+                device->uas.sense_len = MIN(MIN(__builtin_bswap16(iu->length), done->actual_num_bytes - sizeof(uas_sense_iu_t)),
+                                            sizeof(device->uas.sense));
+                memcpy(device->uas.sense, iu->sense_data, device->uas.sense_len);
+            }
+            break;
+        case UAS_IU_ID_RESPONSE:
+            // The device rejected the COMMAND IU
+            ESP_LOGD(TAG, "UAS command rejected: Response code 0x%02x", ((const uas_response_iu_t *)iu)->response_code);
+            cmd_ret[tag - 1] = ESP_FAIL;
+            break;
+        default:
+            MSC_GOTO_ON_FALSE( false, ESP_ERR_INVALID_RESPONSE );
+        }
+        outstanding--;
+        if (outstanding) {
+            MSC_GOTO_ON_ERROR( uas_submit_status(device) );
+            status_in_flight = true;
+        }
+    }
+
+    // The command transfers completed before the device answered, but their completion may be queued behind the status
+    for (; cmd_in_flight; cmd_in_flight--) {
+        usb_transfer_t *done;
+        MSC_GOTO_ON_FALSE( xQueueReceive(device->transfer_done, &done, pdMS_TO_TICKS(device->timeout.cmd_ms)) == pdTRUE, ESP_ERR_TIMEOUT );
+    }
+
+    for (int i = 0; i < num; i++) {
+        if (cmd_ret[i] != ESP_OK) {
+            return cmd_ret[i];
+        }
+    }
+    return ESP_OK;
+
+fail:
+    uas_cancel(device, cmd_in_flight, status_in_flight);
+    if (outstanding) {
+        // Commands left in the device would overlap tags of the next commands
+        uas_reset(device);
+    }
     return ret;
 }
 
@@ -672,16 +1659,28 @@ esp_err_t msc_control_transfer(msc_device_t *device, size_t len)
     xfer->device_handle = device->handle;
     xfer->bEndpointAddress = 0;
     xfer->callback = transfer_callback;
-    xfer->timeout_ms = 5000;
+    xfer->timeout_ms = device->timeout.cmd_ms;
     xfer->num_bytes = len;
     xfer->context = device;
 
-    MSC_RETURN_ON_ERROR( usb_host_transfer_submit_control(s_msc_driver->client_handle, xfer));
-    return wait_for_transfer_done(xfer) == USB_TRANSFER_STATUS_COMPLETED ? ESP_OK : ESP_ERR_MSC_INTERNAL;
+    MSC_RETURN_ON_ERROR( CLIENT_TRANSFER_SUBMIT_CONTROL(s_msc_driver->client_handle, xfer));
+    const usb_transfer_status_t status = wait_for_transfer_done(xfer);
+    if (status == USB_TRANSFER_STATUS_TIMED_OUT) {
+        return ESP_ERR_TIMEOUT;
+    }
+    return status == USB_TRANSFER_STATUS_COMPLETED ? ESP_OK : ESP_ERR_MSC_INTERNAL;
 }
 
 esp_err_t msc_host_reset_recovery(msc_host_device_handle_t device)
 {
+    ((msc_device_t *)device)->stats.reset_recoveries++;
+
+    if (((msc_device_t *)device)->config.transport == MSC_TRANSPORT_UAS) {
+        ESP_RETURN_ON_ERROR( uas_reset(device), TAG, "Logical unit reset failed" );
+        MSC_RETURN_ON_ERROR( msc_wait_for_luns_ready(device) );
+        return ESP_OK;
+    }
+
     // USB Mass Storage Class – Bulk Only Transport Revision 1.0
     // 5.3.4 Reset Recovery
     // For Reset Recovery the host shall issue in the following order: :
@@ -693,6 +1692,6 @@ esp_err_t msc_host_reset_recovery(msc_host_device_handle_t device)
     // Clear feature will fail if there is not STALL on the endpoint, so we don't check the errors here
     clear_feature(device, device->config.bulk_in_ep);
     clear_feature(device, device->config.bulk_out_ep);
-    MSC_RETURN_ON_ERROR( msc_wait_for_ready_state(device, WAIT_FOR_READY_TIMEOUT_MS) );
+    MSC_RETURN_ON_ERROR( msc_wait_for_luns_ready(device) );
     return ESP_OK;
 }
@@ -0,0 +1,197 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "msc_common.h"
+#include "msc_scsi_bot.h"
+#include "usb/msc_host.h"
+
+static const char *TAG = "USB_MSC_ASYNC";
+
+typedef enum {
+    ASYNC_OP_READ,
+    ASYNC_OP_WRITE,
+    ASYNC_OP_BARRIER,
+    ASYNC_OP_STOP,      // Internal, the worker task exits
+} async_op_t;
+
+typedef struct {
+    async_op_t op;
+    uint8_t lun;
+    uint32_t num_sectors;
+    uint64_t sector;
+    uint8_t *data;
+    msc_host_io_cb_t callback;
+    void *arg;
+} async_request_t;
+
+struct msc_async {
+    QueueHandle_t requests;     // Requests in the order of submission
+    SemaphoreHandle_t stopped;  // Given by the worker task before it exits
+};
+
+static void async_free(msc_async_t *async)
+{
+    if (async->requests) {
+        vQueueDelete(async->requests);
+    }
+    if (async->stopped) {
+        vSemaphoreDelete(async->stopped);
+    }
+    MSC_FREE(CONTROL, async, sizeof(msc_async_t));
+}
+
+/**
+ * @brief Worker task of asynchronous requests
+ *
+ * Requests are executed one after another, so the next command is issued right after the previous one completes.
+ * After a failed request, the following ones are not executed until the next barrier.
+ *
+ * @param[in] arg MSC device handle
+ */
+static void async_worker_task(void *arg)
+{
+    msc_device_t *device = (msc_device_t *)arg;
+    msc_async_t *async = device->async;
+    esp_err_t first_error = ESP_OK; // First error since the last barrier
+    async_request_t req;
+
+    while (xQueueReceive(async->requests, &req, portMAX_DELAY) == pdTRUE && req.op != ASYNC_OP_STOP) {
+        esp_err_t result;
+
+        if (req.op == ASYNC_OP_BARRIER) {
+            result = first_error;
+            first_error = ESP_OK;
+        } else if (first_error != ESP_OK) {
+            result = ESP_ERR_INVALID_STATE;
+        } else {
+            const uint32_t block_size = device->disk[req.lun].block_size;
+            if (req.op == ASYNC_OP_READ) {
+                result = scsi_cmd_read(device, req.lun, req.data, req.sector, req.num_sectors, block_size);
+            } else {
+                result = scsi_cmd_write(device, req.lun, req.data, req.sector, req.num_sectors, block_size);
+            }
+            if (result != ESP_OK) {
+                ESP_LOGE(TAG, "Request of sector %"PRIu64" failed (0x%x), cancelling requests until barrier", req.sector, result);
+                first_error = result;
+            }
+        }
+
+        if (req.callback) {
+            req.callback(device, result, req.arg);
+        }
+    }
+
+    xSemaphoreGive(async->stopped);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t async_submit(msc_host_device_handle_t device, const async_request_t *req)
+{
+    MSC_RETURN_ON_INVALID_ARG(device);
+    msc_device_t *dev = (msc_device_t *)device;
+    MSC_RETURN_ON_FALSE(dev->async, ESP_ERR_NOT_SUPPORTED);
+    if (req->op != ASYNC_OP_BARRIER) {
+        MSC_RETURN_ON_FALSE(req->lun < dev->lun_num && req->data && req->num_sectors, ESP_ERR_INVALID_ARG);
+    }
+
+    // Never block, callbacks running on the worker task can submit requests too
+    if (xQueueSend(dev->async->requests, req, 0) != pdTRUE) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t msc_host_read_sector_async(msc_host_device_handle_t device, uint8_t lun, uint64_t sector, uint32_t num_sectors,
+                                     void *data, msc_host_io_cb_t callback, void *arg)
+{
+    const async_request_t req = {
+        .op = ASYNC_OP_READ,
+        .lun = lun,
+        .num_sectors = num_sectors,
+        .sector = sector,
+        .data = (uint8_t *)data,
+        .callback = callback,
+        .arg = arg,
+    };
+    return async_submit(device, &req);
+}
+
+esp_err_t msc_host_write_sector_async(msc_host_device_handle_t device, uint8_t lun, uint64_t sector, uint32_t num_sectors,
+                                      const void *data, msc_host_io_cb_t callback, void *arg)
+{
+    const async_request_t req = {
+        .op = ASYNC_OP_WRITE,
+        .lun = lun,
+        .num_sectors = num_sectors,
+        .sector = sector,
+        .data = (uint8_t *)data,
+        .callback = callback,
+        .arg = arg,
+    };
+    return async_submit(device, &req);
+}
+
+esp_err_t msc_host_io_barrier(msc_host_device_handle_t device, msc_host_io_cb_t callback, void *arg)
+{
+    const async_request_t req = {
+        .op = ASYNC_OP_BARRIER,
+        .callback = callback,
+        .arg = arg,
+    };
+    return async_submit(device, &req);
+}
+
+esp_err_t msc_async_start(msc_device_t *device, const msc_host_async_io_config_t *config)
+{
+    esp_err_t ret;
+    msc_async_t *async = MSC_CALLOC(CONTROL, 1, sizeof(msc_async_t));
+    MSC_RETURN_ON_FALSE(async, ESP_ERR_NO_MEM);
+
+    MSC_GOTO_ON_FALSE( async->requests = xQueueCreate(config->queue_size, sizeof(async_request_t)), ESP_ERR_NO_MEM );
+    MSC_GOTO_ON_FALSE( async->stopped = xSemaphoreCreateBinary(), ESP_ERR_NO_MEM );
+    device->async = async;
+    BaseType_t task_created = xTaskCreatePinnedToCore(
+                                  async_worker_task,
+                                  "USB MSC IO",
+                                  config->stack_size,
+                                  device,
+                                  config->task_priority,
+                                  NULL,
+                                  config->core_id);
+    MSC_GOTO_ON_FALSE( task_created, ESP_ERR_NO_MEM );
+    return ESP_OK;
+
+fail:
+    device->async = NULL;
+    async_free(async);
+    return ret;
+}
+
+void msc_async_stop(msc_device_t *device)
+{
+    msc_async_t *async = device->async;
+    if (async == NULL) {
+        return;
+    }
+
+    // Stop request is queued after all pending requests, so they are executed first
+    const async_request_t req = {
+        .op = ASYNC_OP_STOP,
+    };
+    xQueueSend(async->requests, &req, portMAX_DELAY);
+    xSemaphoreTake(async->stopped, portMAX_DELAY);
+    device->async = NULL;
+    async_free(async);
+}
@@ -0,0 +1,205 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "msc_common.h"
+#include "msc_scsi_bot.h"
+#include "diskio_usb.h"
+#include "usb/msc_host_blockdev.h"
+
+static const char *TAG = "USB_MSC_BLOCKDEV";
+
+typedef struct msc_host_blockdev {
+    usb_disk_t *disk;
+    uint8_t *batch;             // Write batch buffer, NULL if batching is disabled
+    uint32_t batch_max;         // Capacity of the batch in sectors
+    uint32_t batch_num;         // Number of batched sectors
+    uint64_t batch_sector;      // First batched sector
+} msc_host_blockdev_t;
+
+static esp_err_t blockdev_range(const msc_host_blockdev_t *bdev, uint64_t addr, uint64_t size,
+                                uint64_t *sector, uint64_t *num_sectors)
+{
+    const uint32_t block_size = bdev->disk->block_size;
+    if (addr % block_size || size % block_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *sector = addr / block_size;
+    *num_sectors = size / block_size;
+    if (*sector > bdev->disk->block_count || *num_sectors > bdev->disk->block_count - *sector) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+static bool batch_overlaps(const msc_host_blockdev_t *bdev, uint64_t sector, uint64_t num_sectors)
+{
+    return bdev->batch_num && sector < bdev->batch_sector + bdev->batch_num && bdev->batch_sector < sector + num_sectors;
+}
+
+static esp_err_t batch_flush(msc_host_blockdev_t *bdev)
+{
+    if (bdev->batch_num == 0) {
+        return ESP_OK;
+    }
+    const uint32_t num_sectors = bdev->batch_num;
+    // Batched data are dropped on failure, the error is reported to the caller of this flush
+    bdev->batch_num = 0;
+    return usb_disk_write_sectors(bdev->disk, bdev->batch, bdev->batch_sector, num_sectors, true);
+}
+
+esp_err_t msc_host_blockdev_open(msc_host_device_handle_t device, uint8_t lun, const msc_host_blockdev_config_t *config,
+                                 msc_host_blockdev_handle_t *blockdev)
+{
+    MSC_RETURN_ON_INVALID_ARG(device);
+    MSC_RETURN_ON_INVALID_ARG(blockdev);
+    msc_device_t *dev = (msc_device_t *)device;
+    MSC_RETURN_ON_FALSE(lun < dev->lun_num, ESP_ERR_INVALID_ARG);
+    usb_disk_t *disk = &dev->disk[lun];
+    MSC_RETURN_ON_FALSE(disk->block_count != 0, ESP_ERR_NOT_FOUND);
+
+    msc_host_blockdev_t *bdev = MSC_CALLOC(CONTROL, 1, sizeof(msc_host_blockdev_t));
+    MSC_RETURN_ON_FALSE(bdev, ESP_ERR_NO_MEM);
+    bdev->disk = disk;
+    disk->write_protected = false;
+    disk->sync_cache_rejected = false;
+    disk->barrier = config ? config->write_barrier : MSC_HOST_WRITE_BARRIER_SYNC_CACHE;
+
+    if (config && config->write_batch_size >= disk->block_size) {
+        bdev->batch_max = config->write_batch_size / disk->block_size;
+        bdev->batch = MSC_MALLOC(BUFFER, bdev->batch_max * disk->block_size, MALLOC_CAP_DMA);
+        if (bdev->batch == NULL) {
+            MSC_FREE(CONTROL, bdev, sizeof(msc_host_blockdev_t));
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    *blockdev = bdev;
+    return ESP_OK;
+}
+
+esp_err_t msc_host_blockdev_close(msc_host_blockdev_handle_t blockdev)
+{
+    MSC_RETURN_ON_INVALID_ARG(blockdev);
+
+    const esp_err_t ret = batch_flush(blockdev);
+    MSC_FREE(BUFFER, blockdev->batch, blockdev->batch_max * blockdev->disk->block_size);
+    MSC_FREE(CONTROL, blockdev, sizeof(msc_host_blockdev_t));
+    return ret;
+}
+
+esp_err_t msc_host_blockdev_get_geometry(msc_host_blockdev_handle_t blockdev, msc_host_blockdev_geometry_t *geometry)
+{
+    MSC_RETURN_ON_INVALID_ARG(blockdev);
+    MSC_RETURN_ON_INVALID_ARG(geometry);
+    const usb_disk_t *disk = blockdev->disk;
+
+    geometry->disk_size = disk->block_count * disk->block_size;
+    geometry->block_size = disk->block_size;
+    geometry->write_size = blockdev->batch ? blockdev->batch_max * disk->block_size : disk->block_size;
+    geometry->erase_supported = (disk->trim != USB_DISK_TRIM_NONE);
+    return ESP_OK;
+}
+
+esp_err_t msc_host_blockdev_read(msc_host_blockdev_handle_t blockdev, uint64_t addr, void *data, size_t size)
+{
+    MSC_RETURN_ON_INVALID_ARG(blockdev);
+    MSC_RETURN_ON_INVALID_ARG(data);
+    uint64_t sector, num_sectors;
+    MSC_RETURN_ON_ERROR( blockdev_range(blockdev, addr, size, &sector, &num_sectors) );
+    if (num_sectors == 0) {
+        return ESP_OK;
+    }
+
+    if (batch_overlaps(blockdev, sector, num_sectors)) {
+        MSC_RETURN_ON_ERROR( batch_flush(blockdev) );
+    }
+    usb_disk_t *disk = blockdev->disk;
+    return scsi_cmd_read(msc_disk_to_device(disk), disk->lun, data, sector, num_sectors, disk->block_size);
+}
+
+esp_err_t msc_host_blockdev_write(msc_host_blockdev_handle_t blockdev, uint64_t addr, const void *data, size_t size)
+{
+    MSC_RETURN_ON_INVALID_ARG(blockdev);
+    MSC_RETURN_ON_INVALID_ARG(data);
+    uint64_t sector, num_sectors;
+    MSC_RETURN_ON_ERROR( blockdev_range(blockdev, addr, size, &sector, &num_sectors) );
+    usb_disk_t *disk = blockdev->disk;
+    const uint8_t *src = (const uint8_t *)data;
+
+    if (blockdev->batch == NULL) {
+        return num_sectors ? usb_disk_write_sectors(disk, src, sector, num_sectors, true) : ESP_OK;
+    }
+
+    // Only a write continuing the batch is appended, anything else overwriting batched sectors is written after them
+    if (blockdev->batch_num && sector != blockdev->batch_sector + blockdev->batch_num) {
+        MSC_RETURN_ON_ERROR( batch_flush(blockdev) );
+    }
+    while (num_sectors) {
+        if (blockdev->batch_num == 0 && num_sectors >= blockdev->batch_max) {
+            // Large writes bypass the batch buffer
+            return usb_disk_write_sectors(disk, src, sector, num_sectors, true);
+        }
+        if (blockdev->batch_num == 0) {
+            blockdev->batch_sector = sector;
+        }
+        const uint32_t count = MIN(num_sectors, blockdev->batch_max - blockdev->batch_num);
+        memcpy(blockdev->batch + blockdev->batch_num * disk->block_size, src, count * disk->block_size);
+        blockdev->batch_num += count;
+        src += count * disk->block_size;
+        sector += count;
+        num_sectors -= count;
+        if (blockdev->batch_num == blockdev->batch_max) {
+            MSC_RETURN_ON_ERROR( batch_flush(blockdev) );
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t msc_host_blockdev_erase(msc_host_blockdev_handle_t blockdev, uint64_t addr, uint64_t size)
+{
+    MSC_RETURN_ON_INVALID_ARG(blockdev);
+    uint64_t sector, num_sectors;
+    MSC_RETURN_ON_ERROR( blockdev_range(blockdev, addr, size, &sector, &num_sectors) );
+    usb_disk_t *disk = blockdev->disk;
+
+    // Batched data must not be written over the unmapped sectors later
+    if (batch_overlaps(blockdev, sector, num_sectors)) {
+        MSC_RETURN_ON_ERROR( batch_flush(blockdev) );
+    }
+    while (num_sectors && disk->trim != USB_DISK_TRIM_NONE) {
+        const usb_disk_range_t range = {
+            .sector = sector,
+            .count = MIN(num_sectors, UINT32_MAX),
+        };
+        MSC_RETURN_ON_ERROR( usb_disk_unmap(disk, &range, 1) );
+        sector += range.count;
+        num_sectors -= range.count;
+    }
+    return ESP_OK;
+}
+
+esp_err_t msc_host_blockdev_sync(msc_host_blockdev_handle_t blockdev)
+{
+    MSC_RETURN_ON_INVALID_ARG(blockdev);
+
+    esp_err_t ret = batch_flush(blockdev);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Writing of batched sectors failed (0x%x)", ret);
+        return ret;
+    }
+    ret = usb_disk_sync(blockdev->disk);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "SYNCHRONIZE CACHE failed (0x%x)", ret);
+    }
+    return ret;
+}
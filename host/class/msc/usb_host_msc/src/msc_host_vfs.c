@@ -9,11 +9,13 @@
 #include <string.h>
 #include <sys/param.h>
 #include "msc_common.h"
+#include "diskio_usb_cache.h"
 #include "usb/msc_host_vfs.h"
 #include "diskio_impl.h"
 #include "ffconf.h"
 #include "ff.h"
 #include "esp_idf_version.h"
+#include "esp_heap_caps.h"
 
 #define DRIVE_STR_LEN 3
 
@@ -21,19 +23,47 @@ typedef struct msc_host_vfs {
     char drive[DRIVE_STR_LEN];
     char *base_path;
     uint8_t pdrv;
+    usb_disk_t *disk;
 } msc_host_vfs_t;
 
+typedef struct msc_host_vfs_extent {
+    FIL file;
+    usb_disk_t *disk;
+    uint64_t first_sector;
+    uint32_t sector_num;
+    uint64_t written;
+    bool closed_tail;           // The last write padded a partial sector, no more data can follow
+} msc_host_vfs_extent_t;
+
 static const char *TAG = "MSC VFS";
 
-static esp_err_t msc_format_storage(size_t block_size, size_t allocation_size, const char *drv)
+static esp_err_t msc_format_storage(usb_disk_t *disk, size_t allocation_size, const msc_host_vfs_format_config_t *config, const char *drv)
 {
-    void *workbuf = NULL;
-    const size_t workbuf_size = 4096;
+    const size_t block_size = disk->block_size;
+    const size_t workbuf_size = (config && config->workbuf_size) ? config->workbuf_size / block_size * block_size :
+                                MSC_HOST_VFS_FORMAT_WORKBUF_DEFAULT;
+    MSC_RETURN_ON_FALSE( workbuf_size >= block_size, ESP_ERR_INVALID_ARG );
+
+    // DMA capable work buffer is transferred without copying through the driver's transfers
+    void *workbuf = heap_caps_malloc(workbuf_size, MALLOC_CAP_DMA);
+    MSC_RETURN_ON_FALSE( workbuf, ESP_ERR_NO_MEM );
 
-    MSC_RETURN_ON_FALSE( workbuf = ff_memalloc(workbuf_size), ESP_ERR_NO_MEM );
+    // The old content is gone, pending unmapping and cached sectors are dropped
+    disk->trim_num = 0;
+    usb_disk_cache_invalidate(disk);
+    if (config && config->unmap && disk->trim != USB_DISK_TRIM_NONE) {
+        const usb_disk_range_t volume = {
+            .sector = 0,
+            .count = (uint32_t)MIN(disk->block_count, UINT32_MAX),
+        };
+        if (usb_disk_unmap(disk, &volume, 1) != ESP_OK) {
+            ESP_LOGW(TAG, "Unmapping before formatting failed, data area is kept on the device");
+        }
+    }
 
     // Valid value of cluster size is between sector_size and 128 * sector_size.
-    size_t cluster_size = MIN(MAX(allocation_size, block_size), 128 * block_size);
+    // Clusters of whole physical blocks are not written by read-modify-write in the drive.
+    size_t cluster_size = MIN(MAX(allocation_size, block_size << disk->phys_block_exp), 128 * block_size);
 
 #if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 0, 0)
     FRESULT err = f_mkfs(drv, FM_ANY | FM_SFD, cluster_size, workbuf, workbuf_size);
@@ -53,15 +83,22 @@ static esp_err_t msc_format_storage(size_t block_size, size_t allocation_size, c
 }
 
 esp_err_t msc_host_vfs_format(msc_host_device_handle_t device, const esp_vfs_fat_mount_config_t *mount_config, const msc_host_vfs_handle_t vfs_handle)
+{
+    return msc_host_vfs_format_with_config(device, mount_config, NULL, vfs_handle);
+}
+
+esp_err_t msc_host_vfs_format_with_config(msc_host_device_handle_t device,
+                                          const esp_vfs_fat_mount_config_t *mount_config,
+                                          const msc_host_vfs_format_config_t *format_config,
+                                          const msc_host_vfs_handle_t vfs_handle)
 {
     MSC_RETURN_ON_INVALID_ARG(device);
     MSC_RETURN_ON_INVALID_ARG(mount_config);
     MSC_RETURN_ON_INVALID_ARG(vfs_handle);
 
-    size_t block_size = ((msc_device_t *)device)->disk.block_size;
     size_t alloc_size = mount_config->allocation_unit_size;
 
-    return msc_format_storage(block_size, alloc_size, vfs_handle->drive);
+    return msc_format_storage(vfs_handle->disk, alloc_size, format_config, vfs_handle->drive);
 }
 
 static void dealloc_msc_vfs(msc_host_vfs_t *vfs)
@@ -74,6 +111,25 @@ esp_err_t msc_host_vfs_register(msc_host_device_handle_t device,
                                 const char *base_path,
                                 const esp_vfs_fat_mount_config_t *mount_config,
                                 msc_host_vfs_handle_t *vfs_handle)
+{
+    return msc_host_vfs_register_with_cache(device, base_path, mount_config, NULL, vfs_handle);
+}
+
+esp_err_t msc_host_vfs_register_with_cache(msc_host_device_handle_t device,
+                                           const char *base_path,
+                                           const esp_vfs_fat_mount_config_t *mount_config,
+                                           const msc_host_vfs_cache_config_t *cache_config,
+                                           msc_host_vfs_handle_t *vfs_handle)
+{
+    return msc_host_vfs_register_lun(device, 0, base_path, mount_config, cache_config, vfs_handle);
+}
+
+esp_err_t msc_host_vfs_register_lun(msc_host_device_handle_t device,
+                                    uint8_t lun,
+                                    const char *base_path,
+                                    const esp_vfs_fat_mount_config_t *mount_config,
+                                    const msc_host_vfs_cache_config_t *cache_config,
+                                    msc_host_vfs_handle_t *vfs_handle)
 {
     MSC_RETURN_ON_INVALID_ARG(device);
     MSC_RETURN_ON_INVALID_ARG(base_path);
@@ -83,17 +139,30 @@ esp_err_t msc_host_vfs_register(msc_host_device_handle_t device,
     FATFS *fs = NULL;
     BYTE pdrv;
     bool diskio_registered = false;
+    bool cache_created = false;
     esp_err_t ret = ESP_ERR_MSC_MOUNT_FAILED;
     msc_device_t *dev = (msc_device_t *)device;
-    size_t block_size = dev->disk.block_size;
+    MSC_RETURN_ON_FALSE(lun < dev->lun_num, ESP_ERR_INVALID_ARG);
+    MSC_RETURN_ON_FALSE(dev->disk[lun].block_count != 0, ESP_ERR_NOT_FOUND);
+    usb_disk_t *disk = &dev->disk[lun];
     size_t alloc_size = mount_config->allocation_unit_size;
 
     msc_host_vfs_t *vfs = calloc(1, sizeof(msc_host_vfs_t));
     MSC_RETURN_ON_FALSE(vfs != NULL, ESP_ERR_NO_MEM);
+    vfs->disk = disk;
+    disk->write_protected = false;
+    disk->sync_cache_rejected = false;
+    disk->barrier = cache_config ? cache_config->write_barrier : MSC_HOST_WRITE_BARRIER_SYNC_CACHE;
+
+    if (cache_config && cache_config->sector_num) {
+        MSC_GOTO_ON_FALSE( disk->cache == NULL, ESP_ERR_INVALID_STATE );
+        MSC_GOTO_ON_ERROR( usb_disk_cache_create(disk, cache_config) );
+        cache_created = true;
+    }
 
     MSC_GOTO_ON_ERROR( ff_diskio_get_drive(&pdrv) );
 
-    ff_diskio_register_msc(pdrv, &dev->disk);
+    ff_diskio_register_msc(pdrv, disk);
     char drive[DRIVE_STR_LEN] = {(char)('0' + pdrv), ':', 0};
     diskio_registered = true;
 
@@ -108,7 +177,7 @@ esp_err_t msc_host_vfs_register(msc_host_device_handle_t device,
     if ( fresult != FR_OK) {
         if (mount_config->format_if_mount_failed &&
                 (fresult == FR_NO_FILESYSTEM || fresult == FR_INT_ERR)) {
-            MSC_GOTO_ON_ERROR( msc_format_storage(block_size, alloc_size, drive) );
+            MSC_GOTO_ON_ERROR( msc_format_storage(disk, alloc_size, NULL, drive) );
             MSC_GOTO_ON_FALSE( f_mount(fs, drive, 0) == FR_OK, ESP_ERR_MSC_MOUNT_FAILED );
         } else {
             goto fail;
@@ -126,6 +195,9 @@ fail:
     if (fs) {
         f_mount(NULL, drive, 0);
     }
+    if (cache_created) {
+        usb_disk_cache_delete(disk);
+    }
     dealloc_msc_vfs(vfs);
     return ret;
 }
@@ -136,8 +208,135 @@ esp_err_t msc_host_vfs_unregister(msc_host_vfs_handle_t vfs_handle)
     msc_host_vfs_t *vfs = (msc_host_vfs_t *)vfs_handle;
 
     f_mount(NULL, vfs->drive, 0);
+    if (vfs->disk->trim_num) {
+        usb_disk_trim_flush(vfs->disk);
+    }
+    usb_disk_cache_delete(vfs->disk);
     ff_diskio_unregister(vfs->pdrv);
     esp_vfs_fat_unregister_path(vfs->base_path);
     dealloc_msc_vfs(vfs);
     return ESP_OK;
 }
+
+esp_err_t msc_host_vfs_extent_open(msc_host_vfs_handle_t vfs_handle, const char *path, uint64_t size,
+                                   msc_host_vfs_extent_handle_t *extent)
+{
+    MSC_RETURN_ON_INVALID_ARG(vfs_handle);
+    MSC_RETURN_ON_INVALID_ARG(path);
+    MSC_RETURN_ON_INVALID_ARG(extent);
+#if !FF_USE_EXPAND
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    msc_host_vfs_t *vfs = (msc_host_vfs_t *)vfs_handle;
+    const size_t base_len = strlen(vfs->base_path);
+    MSC_RETURN_ON_FALSE( strncmp(path, vfs->base_path, base_len) == 0 && path[base_len] == '/', ESP_ERR_INVALID_ARG );
+    MSC_RETURN_ON_FALSE( size != 0 && size <= (FSIZE_t) -1, ESP_ERR_INVALID_SIZE );
+
+    esp_err_t ret = ESP_FAIL;
+    bool file_opened = false;
+    char *ff_path = NULL;
+    msc_host_vfs_extent_t *ext = calloc(1, sizeof(msc_host_vfs_extent_t));
+    MSC_RETURN_ON_FALSE( ext, ESP_ERR_NO_MEM );
+    ext->disk = vfs->disk;
+
+    // FatFS path is the drive followed by the path inside the VFS
+    const size_t ff_path_len = strlen(vfs->drive) + strlen(path + base_len) + 1;
+    MSC_GOTO_ON_FALSE( ff_path = malloc(ff_path_len), ESP_ERR_NO_MEM );
+    snprintf(ff_path, ff_path_len, "%s%s", vfs->drive, path + base_len);
+
+    MSC_GOTO_ON_FALSE( f_open(&ext->file, ff_path, FA_WRITE | FA_CREATE_ALWAYS) == FR_OK, ESP_FAIL );
+    file_opened = true;
+    MSC_GOTO_ON_FALSE( f_expand(&ext->file, (FSIZE_t)size, 1) == FR_OK, ESP_FAIL );
+    MSC_GOTO_ON_FALSE( f_sync(&ext->file) == FR_OK, ESP_FAIL );
+
+    // Clusters of the extent may have been freed recently, they must be unmapped before the data are written
+    if (ext->disk->trim_num) {
+        usb_disk_trim_flush(ext->disk);
+    }
+
+    const FATFS *fs = ext->file.obj.fs;
+    ext->first_sector = fs->database + (uint64_t)(ext->file.obj.sclust - 2) * fs->csize;
+    ext->sector_num = (size + ext->disk->block_size - 1) / ext->disk->block_size;
+    free(ff_path);
+    *extent = ext;
+    return ESP_OK;
+
+fail:
+    if (file_opened) {
+        f_close(&ext->file);
+        f_unlink(ff_path);
+    }
+    free(ff_path);
+    free(ext);
+    return ret;
+#endif
+}
+
+esp_err_t msc_host_vfs_extent_write(msc_host_vfs_extent_handle_t extent, const void *data, size_t size)
+{
+    MSC_RETURN_ON_INVALID_ARG(extent);
+    MSC_RETURN_ON_INVALID_ARG(data);
+    msc_host_vfs_extent_t *ext = (msc_host_vfs_extent_t *)extent;
+    usb_disk_t *disk = ext->disk;
+    const uint32_t block_size = disk->block_size;
+
+    MSC_RETURN_ON_FALSE( !ext->closed_tail, ESP_ERR_INVALID_STATE );
+    MSC_RETURN_ON_FALSE( size <= (uint64_t)f_size(&ext->file) - ext->written, ESP_ERR_INVALID_SIZE );
+    if (size == 0) {
+        return ESP_OK;
+    }
+
+    const uint64_t sector = ext->first_sector + ext->written / block_size;
+    const uint32_t full_sectors = size / block_size;
+    const size_t tail = size % block_size;
+    if (full_sectors) {
+        // Cached copies of the sectors are updated, FatFS may have cached them before the clusters were freed
+        MSC_RETURN_ON_ERROR( disk->cache ? usb_disk_cache_write(disk, data, sector, full_sectors) :
+                             usb_disk_write_sectors(disk, data, sector, full_sectors, false) );
+    }
+    if (tail) {
+        uint8_t *last = heap_caps_calloc(1, block_size, MALLOC_CAP_DMA);
+        MSC_RETURN_ON_FALSE( last, ESP_ERR_NO_MEM );
+        memcpy(last, (const uint8_t *)data + (size_t)full_sectors * block_size, tail);
+        const esp_err_t ret = disk->cache ? usb_disk_cache_write(disk, last, sector + full_sectors, 1) :
+                              usb_disk_write_sectors(disk, last, sector + full_sectors, 1, false);
+        free(last);
+        MSC_RETURN_ON_ERROR( ret );
+        ext->closed_tail = true;
+    }
+    ext->written += size;
+    return ESP_OK;
+}
+
+esp_err_t msc_host_vfs_extent_get_info(msc_host_vfs_extent_handle_t extent, msc_host_vfs_extent_info_t *info)
+{
+    MSC_RETURN_ON_INVALID_ARG(extent);
+    MSC_RETURN_ON_INVALID_ARG(info);
+    const msc_host_vfs_extent_t *ext = (const msc_host_vfs_extent_t *)extent;
+
+    info->lun = ext->disk->lun;
+    info->first_sector = ext->first_sector;
+    info->sector_num = ext->sector_num;
+    info->sector_size = ext->disk->block_size;
+    info->written = ext->written;
+    return ESP_OK;
+}
+
+esp_err_t msc_host_vfs_extent_close(msc_host_vfs_extent_handle_t extent)
+{
+    MSC_RETURN_ON_INVALID_ARG(extent);
+    msc_host_vfs_extent_t *ext = (msc_host_vfs_extent_t *)extent;
+
+    // Clusters after the written data are freed, f_close() writes the directory entry and syncs the drive
+    FRESULT fresult = f_lseek(&ext->file, (FSIZE_t)ext->written);
+    if (fresult == FR_OK) {
+        fresult = f_truncate(&ext->file);
+    }
+    const FRESULT close_result = f_close(&ext->file);
+    free(ext);
+    if (fresult != FR_OK || close_result != FR_OK) {
+        ESP_LOGE(TAG, "Closing preallocated file failed: %d, %d", fresult, close_result);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,156 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "usb/usb_host.h"
+#include "msc_common.h"
+#include "msc_id_cache.h"
+
+static const char *TAG = "USB_MSC_ID";
+
+#define ID_SERIAL_MAX_SIZE 64 // Maximum size of Serial Number string descriptor, devices with longer serial numbers are not cached
+
+typedef struct {
+    uint16_t vid;
+    uint16_t pid;
+    uint8_t serial_len;
+    uint8_t serial[ID_SERIAL_MAX_SIZE];     // Serial Number string descriptor
+} id_key_t;
+
+typedef struct {
+    id_key_t key;
+    uint32_t last_use;                      // 0: Empty entry
+    msc_id_t id;
+} id_entry_t;
+
+struct msc_id_cache {
+    SemaphoreHandle_t mutex;                // Devices can be installed from several tasks at once
+    uint32_t use_counter;
+    size_t size;
+    id_entry_t entries[];
+};
+
+static bool get_key(const msc_device_t *device, id_key_t *key)
+{
+    const usb_device_desc_t *desc;
+    usb_device_info_t info;
+
+    if (usb_host_get_device_descriptor(device->handle, &desc) != ESP_OK ||
+            usb_host_device_info(device->handle, &info) != ESP_OK) {
+        return false;
+    }
+    // Devices without serial number cannot be told apart
+    const usb_str_desc_t *serial = info.str_desc_serial_num;
+    if (serial == NULL || serial->bLength <= 2 || serial->bLength > ID_SERIAL_MAX_SIZE) {
+        return false;
+    }
+
+    memset(key, 0, sizeof(id_key_t));
+    key->vid = desc->idVendor;
+    key->pid = desc->idProduct;
+    key->serial_len = serial->bLength;
+    memcpy(key->serial, serial, serial->bLength);
+    return true;
+}
+
+static id_entry_t *find_entry(msc_id_cache_t *cache, const id_key_t *key)
+{
+    for (size_t i = 0; i < cache->size; i++) {
+        id_entry_t *entry = &cache->entries[i];
+        if (entry->last_use && memcmp(&entry->key, key, sizeof(id_key_t)) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t msc_id_cache_create(size_t size, msc_id_cache_t **cache_ret)
+{
+    msc_id_cache_t *cache = MSC_CALLOC(CONTROL, 1, sizeof(msc_id_cache_t) + size * sizeof(id_entry_t));
+    MSC_RETURN_ON_FALSE(cache, ESP_ERR_NO_MEM);
+    cache->mutex = xSemaphoreCreateMutex();
+    if (cache->mutex == NULL) {
+        MSC_FREE(CONTROL, cache, sizeof(msc_id_cache_t) + size * sizeof(id_entry_t));
+        return ESP_ERR_NO_MEM;
+    }
+    cache->size = size;
+    *cache_ret = cache;
+    return ESP_OK;
+}
+
+void msc_id_cache_delete(msc_id_cache_t *cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+    vSemaphoreDelete(cache->mutex);
+    MSC_FREE(CONTROL, cache, sizeof(msc_id_cache_t) + cache->size * sizeof(id_entry_t));
+}
+
+bool msc_id_cache_find(msc_id_cache_t *cache, const msc_device_t *device, msc_id_t *id)
+{
+    id_key_t key;
+    if (!get_key(device, &key)) {
+        return false;
+    }
+
+    xSemaphoreTake(cache->mutex, portMAX_DELAY);
+    id_entry_t *entry = find_entry(cache, &key);
+    if (entry) {
+        entry->last_use = ++cache->use_counter;
+        *id = entry->id;
+    }
+    xSemaphoreGive(cache->mutex);
+    return entry != NULL;
+}
+
+void msc_id_cache_store(msc_id_cache_t *cache, const msc_device_t *device)
+{
+    id_key_t key;
+    if (!get_key(device, &key)) {
+        return;
+    }
+
+    xSemaphoreTake(cache->mutex, portMAX_DELAY);
+    id_entry_t *entry = find_entry(cache, &key);
+    if (entry == NULL) {
+        // Empty entry has the lowest last_use
+        entry = &cache->entries[0];
+        for (size_t i = 1; i < cache->size; i++) {
+            if (cache->entries[i].last_use < entry->last_use) {
+                entry = &cache->entries[i];
+            }
+        }
+        entry->key = key;
+    }
+    entry->last_use = ++cache->use_counter;
+
+    memset(&entry->id, 0, sizeof(msc_id_t));
+    entry->id.lun_num = device->lun_num;
+    for (uint8_t lun = 0; lun < device->lun_num; lun++) {
+        const usb_disk_t *disk = &device->disk[lun];
+        if (disk->block_count == 0) {
+            continue;
+        }
+        entry->id.lun[lun] = (msc_id_lun_t) {
+            .valid = true,
+            .removable = disk->removable,
+            .block_size = disk->block_size,
+            .block_count = disk->block_count,
+            .phys_block_exp = disk->phys_block_exp,
+            .aligned_lba = disk->aligned_lba,
+            .trim = disk->trim,
+            .trim_max_sectors = disk->trim_max_sectors,
+            .trim_max_ranges = disk->trim_max_ranges,
+        };
+    }
+    xSemaphoreGive(cache->mutex);
+}
@@ -12,7 +12,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_check.h"
+#include "esp_timer.h"
 #include "esp_log.h"
 #include "msc_common.h"
 #include "msc_scsi_bot.h"
@@ -33,6 +37,9 @@ static const char *TAG = "USB_MSC_SCSI";
 #define SCSI_CMD_READ10 0x28
 #define SCSI_CMD_READ12 0xA8
 #define SCSI_CMD_READ_CAPACITY 0x25
+#define SCSI_CMD_READ16 0x88
+#define SCSI_CMD_SERVICE_ACTION_IN16 0x9E
+#define SCSI_SA_READ_CAPACITY16 0x10
 #define SCSI_CMD_READ_FORMAT_CAPACITIES 0x23
 #define SCSI_CMD_REQUEST_SENSE 0x03
 #define SCSI_CMD_REZERO 0x01
@@ -43,7 +50,32 @@ static const char *TAG = "USB_MSC_SCSI";
 #define SCSI_CMD_VERIFY 0x2F
 #define SCSI_CMD_WRITE10 0x2A
 #define SCSI_CMD_WRITE12 0xAA
+#define SCSI_CMD_WRITE16 0x8A
 #define SCSI_CMD_WRITE_AND_VERIFY 0x2E
+#define SCSI_CMD_UNMAP 0x42
+#define SCSI_CMD_WRITE_SAME16 0x93
+#define SCSI_CMD_SYNCHRONIZE_CACHE10 0x35
+
+#define SCSI_INQUIRY_EVPD       (1 << 0)
+#define SCSI_INQUIRY_RMB        (1 << 7)
+#define SCSI_WRITE_SAME_UNMAP   (1 << 3)
+#define SCSI_WRITE_FUA          (1 << 3) // Force Unit Access of WRITE(10) and WRITE(16)
+#define SCSI_SENSE_ILLEGAL_REQUEST 0x05
+#define SCSI_SENSE_DATA_PROTECT 0x07
+
+#define READ10_MAX_SECTORS  UINT16_MAX  // Transfer Length of READ10 and WRITE10 commands is 16-bit
+#define UAS_CMD_MAX_SIZE    (64 * 1024) // UAS requests are split to queued commands of this size
+#define LUN_SLICE_MAX_SIZE  (64 * 1024) // Maximum command size of multi-LUN devices, other LUNs wait at most for one command
+
+#define MSC_TIMEOUT_MIN_MS      (500)   // Lower limit of adaptive timeouts, flash drives pause writes for garbage collection
+#define MSC_TIMEOUT_FACTOR      (8)     // Adaptive timeout is a multiple of the expected latency
+#define MSC_TIMEOUT_SAMPLES     (8)     // Commands measured before the timeouts are adaptive
+#define MSC_TIMEOUT_BACKOFF_MAX (4)     // Adaptive timeout is doubled up to 16 times after timeouts
+#define MSC_DATA_SAMPLE_MIN     (4096)  // Smaller data phases are dominated by the command latency
+#define MSC_RECOVERY_TIMEOUT_MS (500)   // Timeout of transfers during reset recovery after a timeout
+#define MSC_FAST_FAIL_THRESHOLD (3)     // Consecutive timeouts before commands fail at once
+#define MSC_FAST_FAIL_MIN_MS    (1000)
+#define MSC_FAST_FAIL_MAX_MS    (30000)
 
 #define IN_DIR   CWB_FLAG_DIRECTION_IN
 #define OUT_DIR  0
@@ -51,15 +83,19 @@ static const char *TAG = "USB_MSC_SCSI";
 #define INQUIRY_VID_SIZE    8
 #define INQUIRY_PID_SIZE    16
 #define INQUIRY_REV_SIZE    4
+#define VPD_HEADER_SIZE     4
+
+#define UNMAP_HEADER_SIZE       8
+#define UNMAP_DESCRIPTOR_SIZE   16
 
 #define CBW_CMD_SIZE(cmd) (sizeof(cmd) - sizeof(msc_cbw_t))
 
-#define CBW_BASE_INIT(dir, cbw_len, data_len)   \
+#define CBW_BASE_INIT(cbw_lun, dir, cbw_len, data_len) \
     .base = {                                   \
         .signature = 0x43425355,                \
-        .tag = ++cbw_tag,                       \
+        .tag = __atomic_add_fetch(&cbw_tag, 1, __ATOMIC_RELAXED), \
         .flags = dir,                           \
-        .lun = 0,                               \
+        .lun = cbw_lun,                         \
         .data_length = data_len,                \
         .cbw_length = cbw_len,                  \
     }
@@ -142,6 +178,25 @@ typedef struct __attribute__((packed))
     uint8_t reserved2[1];
 } cbw_write10_t;
 
+typedef struct __attribute__((packed))
+{
+    msc_cbw_t base;
+    uint8_t opcode;
+    uint8_t flags;
+    uint64_t address;
+    uint32_t length;
+    uint8_t group;
+    uint8_t control;
+} cbw_read16_t;
+
+// READ and WRITE commands of all sizes, WRITE16 has the same layout as READ16
+typedef union {
+    msc_cbw_t base;
+    cbw_read10_t read10;
+    cbw_write10_t write10;
+    cbw_read16_t read16;
+} cbw_read_write_t;
+
 typedef struct __attribute__((packed))
 {
     msc_cbw_t base;
@@ -151,6 +206,27 @@ typedef struct __attribute__((packed))
     uint8_t reserved[6];
 } cbw_read_capacity_t;
 
+typedef struct __attribute__((packed))
+{
+    msc_cbw_t base;
+    uint8_t opcode;
+    uint8_t service_action;
+    uint64_t address;
+    uint32_t allocation_length;
+    uint8_t flags;
+    uint8_t control;
+} cbw_read_capacity16_t;
+
+typedef struct __attribute__((packed))
+{
+    uint64_t block_count;
+    uint32_t block_size;
+    uint8_t protection;
+    uint8_t exponents;          // P_I_EXPONENT, LOGICAL BLOCKS PER PHYSICAL BLOCK EXPONENT
+    uint16_t lowest_aligned;    // LBPME, LBPRZ, LOWEST ALIGNED LOGICAL BLOCK ADDRESS
+    uint8_t reserved[16];
+} cbw_read_capacity16_response_t;
+
 typedef struct __attribute__((packed))
 {
     uint32_t block_count;
@@ -230,7 +306,38 @@ typedef struct __attribute__((packed))
     uint8_t data[36];
 } cbw_inquiry_response_t;
 
-// Unique number based on which MSC protocol pairs request and response
+typedef struct __attribute__((packed))
+{
+    msc_cbw_t base;
+    uint8_t opcode;
+    uint8_t flags;
+    uint8_t reserved[4];
+    uint8_t group;
+    uint16_t parameter_list_length;
+    uint8_t control;
+} cbw_unmap_t;
+
+typedef struct __attribute__((packed))
+{
+    uint16_t data_length;
+    uint16_t block_descriptor_data_length;
+    uint8_t reserved[4];
+} unmap_parameter_header_t;
+
+typedef struct __attribute__((packed))
+{
+    uint64_t address;
+    uint32_t length;
+    uint8_t reserved[4];
+} unmap_block_descriptor_t;
+
+typedef struct __attribute__((packed))
+{
+    unmap_parameter_header_t header;
+    unmap_block_descriptor_t descriptors[SCSI_UNMAP_MAX_RANGES];
+} unmap_parameter_list_t;
+
+// Unique number based on which MSC protocol pairs request and response, commands to several devices can be built at once
 static uint32_t cbw_tag;
 
 static esp_err_t check_csw(msc_csw_t *csw, uint32_t tag)
@@ -247,6 +354,128 @@ static esp_err_t check_csw(msc_csw_t *csw, uint32_t tag)
     return csw_ok ? ESP_OK : ESP_FAIL;
 }
 
+/**
+ * @brief Check if the command waits for the medium
+ *
+ * Flushing, unmapping and formatting take time the command latency does not predict, they get the maximum timeout.
+ */
+static bool scsi_cmd_is_slow(uint8_t opcode)
+{
+    switch (opcode) {
+    case SCSI_CMD_SYNCHRONIZE_CACHE10:
+    case SCSI_CMD_UNMAP:
+    case SCSI_CMD_WRITE_SAME16:
+    case SCSI_CMD_FORMAT_UNIT:
+    case SCSI_CMD_VERIFY:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Set timeout of a command
+ *
+ * @param[in] device MSC device handle
+ * @param[in] opcode Operation code of the command
+ * @param[in] size   Size of data in bytes
+ * @return false if the device is in fast-fail period, the command must fail at once
+ */
+static bool scsi_timeout_begin(msc_device_t *device, uint8_t opcode, size_t size)
+{
+    msc_timeout_t *timeout = &device->timeout;
+
+    if (timeout->recovering) {
+        timeout->cmd_ms = MSC_RECOVERY_TIMEOUT_MS;
+        return true;
+    }
+    timeout->cmd_ms = device->transfer_timeout_ms;
+    if (!timeout->adaptive) {
+        return true;
+    }
+    if (timeout->failures >= MSC_FAST_FAIL_THRESHOLD && (int32_t)(xTaskGetTickCount() - timeout->fail_until) < 0) {
+        return false;
+    }
+    if (scsi_cmd_is_slow(opcode) || timeout->cmd_samples < MSC_TIMEOUT_SAMPLES ||
+            (size && timeout->data_samples < MSC_TIMEOUT_SAMPLES)) {
+        return true;
+    }
+    const uint64_t expected_us = timeout->avg_cmd_us + (uint64_t)size * timeout->avg_us_per_kb / 1024;
+    const uint64_t timeout_ms = MAX(MSC_TIMEOUT_FACTOR * expected_us / 1000, MSC_TIMEOUT_MIN_MS) << timeout->backoff_shift;
+    timeout->cmd_ms = (uint32_t)MIN(timeout_ms, device->transfer_timeout_ms);
+    return true;
+}
+
+/**
+ * @brief Average latency sample with weight 1/8
+ */
+static inline uint32_t scsi_timeout_smooth(uint32_t avg, uint32_t sample, bool first)
+{
+    return first ? sample : (uint32_t)((int64_t)avg + ((int64_t)sample - avg) / 8);
+}
+
+/**
+ * @brief Account result of a command in its timeouts
+ *
+ * Timeout is escalated as follows:
+ * 1. Bulk-Only Transport is out of sync after a timeout, Reset Recovery is done with short timeouts.
+ *    UAS transport already reset the Logical Unit.
+ * 2. Adaptive timeout of the next commands is doubled.
+ * 3. After MSC_FAST_FAIL_THRESHOLD consecutive timeouts, or failed Reset Recovery, commands fail at once for a back-off period.
+ *    The first command after the period probes the device, its timeout doubles the period.
+ * Any answer of the device, also a failed command, ends the escalation.
+ *
+ * @param[in] device   MSC device handle
+ * @param[in] opcode   Operation code of the command
+ * @param[in] size     Size of data in bytes
+ * @param[in] start_us Start time of the command
+ * @param[in] ret      Result of the command
+ * @return Result of the command
+ */
+static esp_err_t scsi_timeout_end(msc_device_t *device, uint8_t opcode, size_t size, int64_t start_us, esp_err_t ret)
+{
+    msc_timeout_t *timeout = &device->timeout;
+
+    if (timeout->recovering) {
+        return ret;
+    }
+    if (ret == ESP_ERR_TIMEOUT) {
+        device->stats.timeouts++;
+        timeout->failures++;
+        timeout->backoff_shift = MIN(timeout->backoff_shift + 1, MSC_TIMEOUT_BACKOFF_MAX);
+        if (device->config.transport == MSC_TRANSPORT_BOT) {
+            timeout->recovering = true;
+            if (msc_host_reset_recovery(device) != ESP_OK) {
+                timeout->failures = MAX(timeout->failures, MSC_FAST_FAIL_THRESHOLD);
+            }
+            timeout->recovering = false;
+        }
+        if (timeout->adaptive && timeout->failures >= MSC_FAST_FAIL_THRESHOLD) {
+            timeout->fail_backoff_ms = timeout->fail_backoff_ms ? MIN(2 * timeout->fail_backoff_ms, MSC_FAST_FAIL_MAX_MS) : MSC_FAST_FAIL_MIN_MS;
+            timeout->fail_until = xTaskGetTickCount() + pdMS_TO_TICKS(timeout->fail_backoff_ms);
+            ESP_LOGW(TAG, "Device does not respond, commands fail for %"PRIu32" ms", timeout->fail_backoff_ms);
+        }
+    } else {
+        timeout->failures = 0;
+        timeout->backoff_shift = 0;
+        timeout->fail_backoff_ms = 0;
+        if (ret == ESP_OK && timeout->adaptive && !scsi_cmd_is_slow(opcode)) {
+            const uint32_t latency_us = (uint32_t)MIN(esp_timer_get_time() - start_us, UINT32_MAX);
+            if (size < MSC_DATA_SAMPLE_MIN) {
+                timeout->avg_cmd_us = scsi_timeout_smooth(timeout->avg_cmd_us, latency_us, timeout->cmd_samples == 0);
+                timeout->cmd_samples += (timeout->cmd_samples < MSC_TIMEOUT_SAMPLES);
+            } else {
+                const uint32_t data_us = latency_us > timeout->avg_cmd_us ? latency_us - timeout->avg_cmd_us : 0;
+                const uint32_t us_per_kb = (uint32_t)((uint64_t)data_us * 1024 / size);
+                timeout->avg_us_per_kb = scsi_timeout_smooth(timeout->avg_us_per_kb, us_per_kb, timeout->data_samples == 0);
+                timeout->data_samples += (timeout->data_samples < MSC_TIMEOUT_SAMPLES);
+            }
+        }
+    }
+    timeout->cmd_ms = device->transfer_timeout_ms;
+    return ret;
+}
+
 /**
  * @brief Execute BOT command
  *
@@ -256,7 +485,7 @@ static esp_err_t check_csw(msc_csw_t *csw, uint32_t tag)
  * 3. Status transport
  * 3.1. Error recovery (in case of error)
  *
- * This function is not 'static' so it could be called from unit test
+ * UAS devices execute the command block of the CBW by USB Attached SCSI transport instead.
  *
  * @see USB Mass Storage Class – Bulk Only Transport, Chapter 5.3
  *
@@ -266,21 +495,28 @@ static esp_err_t check_csw(msc_csw_t *csw, uint32_t tag)
  * @param[in] size   Size of data in bytes
  * @return esp_err_t
  */
-esp_err_t bot_execute_command(msc_device_t *device, msc_cbw_t *cbw, void *data, size_t size)
+static esp_err_t bot_transport_command(msc_device_t *device, msc_cbw_t *cbw, void *data, size_t size)
 {
     msc_csw_t csw;
     msc_endpoint_t ep = (cbw->flags & CWB_FLAG_DIRECTION_IN) ? MSC_EP_IN : MSC_EP_OUT;
 
-    // 1. Command transport
-    MSC_RETURN_ON_ERROR( msc_bulk_transfer(device, (uint8_t *)cbw, CBW_SIZE, MSC_EP_OUT) );
-
-    // 2. Optional data transport
-    if (data) {
-        MSC_RETURN_ON_ERROR( msc_bulk_transfer(device, (uint8_t *)data, size, ep) );
+    esp_err_t err;
+
+    if (device->config.transport == MSC_TRANSPORT_UAS) {
+        const msc_uas_cmd_t cmd = {
+            .cdb = (const uint8_t *)(cbw + 1),
+            .cdb_len = cbw->cbw_length,
+            .data = (uint8_t *)data,
+            .size = data ? size : 0,
+            .ep = ep,
+            .lun = cbw->lun,
+        };
+        return msc_uas_transfer(device, &cmd, 1);
     }
 
-    // 3. Status transport
-    esp_err_t err = msc_bulk_transfer(device, (uint8_t *)&csw, sizeof(msc_csw_t), MSC_EP_IN);
+    // 1. - 3. Command, optional data and status transports are queued at once
+    MSC_RETURN_ON_ERROR( msc_bot_transfer(device, (const uint8_t *)cbw, CBW_SIZE, (uint8_t *)data, data ? size : 0, ep,
+                                          (uint8_t *)&csw, sizeof(msc_csw_t), &err) );
 
     // 3.1 Error recovery
     if (err == ESP_ERR_MSC_STALL) {
@@ -299,6 +535,60 @@ esp_err_t bot_execute_command(msc_device_t *device, msc_cbw_t *cbw, void *data,
     return check_csw(&csw, cbw->tag);
 }
 
+/**
+ * @brief Execute BOT command with timeout of its opcode and size
+ *
+ * This function is not 'static' so it could be called from unit test
+ *
+ * @param[in] device MSC device handle
+ * @param[in] cbw    Command Block Wrapper
+ * @param[in] data   Data (optional)
+ * @param[in] size   Size of data in bytes
+ * @return
+ *    - ESP_ERR_TIMEOUT: The command timed out, or the device is in fast-fail period after repeated timeouts
+ *    - ESP_ERR_INVALID_STATE: The bus is suspended
+ *    - Other: Result of the command
+ */
+esp_err_t bot_execute_command(msc_device_t *device, msc_cbw_t *cbw, void *data, size_t size)
+{
+    const uint8_t opcode = *(const uint8_t *)(cbw + 1);
+    const size_t data_size = data ? size : 0;
+
+    MSC_RETURN_ON_FALSE( !device->suspended, ESP_ERR_INVALID_STATE );
+    MSC_RETURN_ON_FALSE( scsi_timeout_begin(device, opcode, data_size), ESP_ERR_TIMEOUT );
+    const int64_t start_us = esp_timer_get_time();
+    const esp_err_t ret = bot_transport_command(device, cbw, data, size);
+    return scsi_timeout_end(device, opcode, data_size, start_us, ret);
+}
+
+/**
+ * @brief Execute command and get sense data of its failure
+ *
+ * Sense data of the Logical Unit are cleared by the next command to the device,
+ * so the lock of the device is held until REQUEST SENSE finishes.
+ *
+ * @param[in] device MSC device handle
+ * @param[in] cbw    Command Block Wrapper
+ * @param[in] data   Data (optional)
+ * @param[in] size   Size of data in bytes
+ * @return esp_err_t
+ */
+static esp_err_t scsi_execute_command(msc_device_t *device, msc_cbw_t *cbw, void *data, size_t size)
+{
+    msc_device_lock(device);
+    esp_err_t ret = bot_execute_command(device, cbw, data, size);
+
+    // In case of an error, get an error code. Sense data are lost by the recovery after a timeout
+    if (unlikely(ret != ESP_OK && ret != ESP_ERR_TIMEOUT)) {
+        const esp_err_t sense_ret = scsi_cmd_sense(device, cbw->lun, NULL);
+        if (sense_ret != ESP_OK) {
+            ret = sense_ret;
+        }
+    }
+    msc_device_unlock(device);
+    return ret;
+}
+
 static const char *decode_sense_keys(cbw_sense_response_t *sense_response)
 {
     // Only decode WRITE_PROTECTED_MEDIA sense key, other keys are not implemented
@@ -313,70 +603,236 @@ static const char *decode_sense_keys(cbw_sense_response_t *sense_response)
     return "not found, refer to USB Mass Storage Class – UFI Command Specification (Table 51)";
 }
 
+/**
+ * @brief Fill CBW of READ or WRITE command
+ *
+ * @param[out] cbw            Command Block Wrapper
+ * @param[in]  lun            Logical Unit Number
+ * @param[in]  opcode         SCSI_CMD_READ10, SCSI_CMD_WRITE10, SCSI_CMD_READ16 or SCSI_CMD_WRITE16
+ * @param[in]  sector_address Logical Block Address
+ * @param[in]  num_sectors    Transfer Length in sectors
+ * @param[in]  data_length    Transfer Length in bytes
+ * @param[in]  flags          Flags byte of the CDB, e.g. SCSI_WRITE_FUA
+ */
+static void cbw_read_write_init(cbw_read_write_t *cbw, uint8_t lun, uint8_t opcode, uint64_t sector_address, uint32_t num_sectors, uint32_t data_length,
+                                uint8_t flags)
+{
+    switch (opcode) {
+    case SCSI_CMD_READ10:
+        cbw->read10 = (cbw_read10_t) {
+            CBW_BASE_INIT(lun, IN_DIR, CBW_CMD_SIZE(cbw_read10_t), data_length),
+            .opcode = opcode,
+            .flags = flags,
+            .address = __builtin_bswap32((uint32_t)sector_address),
+            .length = __builtin_bswap16((uint16_t)num_sectors),
+        };
+        break;
+    case SCSI_CMD_WRITE10:
+        cbw->write10 = (cbw_write10_t) {
+            CBW_BASE_INIT(lun, OUT_DIR, CBW_CMD_SIZE(cbw_write10_t), data_length),
+            .opcode = opcode,
+            .flags = flags,
+            .address = __builtin_bswap32((uint32_t)sector_address),
+            .length = __builtin_bswap16((uint16_t)num_sectors),
+        };
+        break;
+    default:
+        cbw->read16 = (cbw_read16_t) {
+            CBW_BASE_INIT(lun, (opcode == SCSI_CMD_READ16) ? IN_DIR : OUT_DIR, CBW_CMD_SIZE(cbw_read16_t), data_length),
+            .opcode = opcode,
+            .flags = flags,
+            .address = __builtin_bswap64(sector_address),
+            .length = __builtin_bswap32(num_sectors),
+        };
+        break;
+    }
+}
+
+/**
+ * @brief Execute READ or WRITE commands
+ *
+ * The request is split to commands of the maximum Transfer Length of the opcode.
+ * UAS devices get commands of UAS_CMD_MAX_SIZE and up to MSC_UAS_MAX_COMMANDS commands are queued at once,
+ * so the device prepares the next command while the data of the previous one are transferred.
+ * Each command is split to data transfers of bounded size by msc_bulk_transfer()
+ *
+ * Commands of multi-LUN devices are limited to LUN_SLICE_MAX_SIZE and the device is released between them,
+ * so a long transfer does not block commands to other Logical Units.
+ */
+static esp_err_t scsi_read_write(msc_device_t *device, uint8_t lun, uint8_t opcode, uint8_t flags, uint8_t *data,
+                                 uint64_t sector_address, uint32_t num_sectors, uint32_t sector_size)
+{
+    const bool uas = (device->config.transport == MSC_TRANSPORT_UAS);
+    const bool cdb16 = (opcode == SCSI_CMD_READ16 || opcode == SCSI_CMD_WRITE16);
+    const msc_endpoint_t ep = (opcode == SCSI_CMD_READ10 || opcode == SCSI_CMD_READ16) ? MSC_EP_IN : MSC_EP_OUT;
+    // Data length of one command must fit dCBWDataTransferLength
+    uint32_t max_cmd_sectors = cdb16 ? MAX(UINT32_MAX / sector_size, 1) : READ10_MAX_SECTORS;
+    if (uas) {
+        max_cmd_sectors = MIN(MAX(UAS_CMD_MAX_SIZE / sector_size, 1), max_cmd_sectors);
+    }
+    if (device->lun_num > 1) {
+        max_cmd_sectors = MIN(MAX(LUN_SLICE_MAX_SIZE / sector_size, 1), max_cmd_sectors);
+    }
+    const int max_cmds = uas ? MSC_UAS_MAX_COMMANDS : 1;
+    esp_err_t ret = ESP_OK;
+
+    while (num_sectors && ret == ESP_OK) {
+        cbw_read_write_t cbw[MSC_UAS_MAX_COMMANDS];
+        msc_uas_cmd_t cmds[MSC_UAS_MAX_COMMANDS];
+        int num = 0;
+
+        for (; num < max_cmds && num_sectors; num++) {
+            const uint32_t cmd_sectors = MIN(num_sectors, max_cmd_sectors);
+            cbw_read_write_init(&cbw[num], lun, opcode, sector_address, cmd_sectors, cmd_sectors * sector_size, flags);
+            cmds[num] = (msc_uas_cmd_t) {
+                .cdb = (const uint8_t *)(&cbw[num].base + 1),
+                .cdb_len = cbw[num].base.cbw_length,
+                .data = data,
+                .size = cmd_sectors * sector_size,
+                .ep = ep,
+                .lun = lun,
+            };
+            data += cmd_sectors * sector_size;
+            sector_address += cmd_sectors;
+            num_sectors -= cmd_sectors;
+        }
+
+        if (uas) {
+            size_t size = 0;
+            for (int i = 0; i < num; i++) {
+                size += cmds[i].size;
+            }
+            msc_device_lock(device);
+            if (device->suspended) {
+                ret = ESP_ERR_INVALID_STATE;
+            } else if (scsi_timeout_begin(device, opcode, size)) {
+                const int64_t start_us = esp_timer_get_time();
+                ret = scsi_timeout_end(device, opcode, size, start_us, msc_uas_transfer(device, cmds, num));
+            } else {
+                ret = ESP_ERR_TIMEOUT;
+            }
+            // In case of an error, get an error code
+            if (unlikely(ret != ESP_OK && ret != ESP_ERR_TIMEOUT)) {
+                const esp_err_t sense_ret = scsi_cmd_sense(device, lun, NULL);
+                if (sense_ret != ESP_OK) {
+                    ret = sense_ret;
+                }
+            }
+            msc_device_unlock(device);
+        } else {
+            ret = scsi_execute_command(device, &cbw[0].base, cmds[0].data, cmds[0].size);
+        }
+
+        if (ret == ESP_OK) {
+            for (int i = 0; i < num; i++) {
+                if (ep == MSC_EP_IN) {
+                    device->stats.read_cmds++;
+                    device->stats.read_bytes += cmds[i].size;
+                } else {
+                    device->stats.write_cmds++;
+                    device->stats.write_bytes += cmds[i].size;
+                }
+            }
+        }
+
+        if (num_sectors && device->lun_num > 1) {
+            // Waiting command of another LUN takes the device before the next slice
+            taskYIELD();
+        }
+    }
+    return ret;
+}
 
 esp_err_t scsi_cmd_read10(msc_host_device_handle_t dev,
+                          uint8_t lun,
                           uint8_t *data,
                           uint32_t sector_address,
                           uint32_t num_sectors,
                           uint32_t sector_size)
 {
-    msc_device_t *device = (msc_device_t *)dev;
-    cbw_read10_t cbw = {
-        CBW_BASE_INIT(IN_DIR, CBW_CMD_SIZE(cbw_read10_t), num_sectors * sector_size),
-        .opcode = SCSI_CMD_READ10,
-        .flags = 0, // lun
-        .address = __builtin_bswap32(sector_address),
-        .length = __builtin_bswap16(num_sectors),
-    };
-
-    esp_err_t ret = bot_execute_command(device, &cbw.base, data, num_sectors * sector_size);
-
-    // In case of an error, get an error code
-    if (unlikely(ret != ESP_OK)) {
-        MSC_RETURN_ON_ERROR( scsi_cmd_sense(device, NULL));
-    }
-    return ret;
+    return scsi_read_write((msc_device_t *)dev, lun, SCSI_CMD_READ10, 0, data, sector_address, num_sectors, sector_size);
 }
 
 esp_err_t scsi_cmd_write10(msc_host_device_handle_t dev,
+                           uint8_t lun,
                            const uint8_t *data,
                            uint32_t sector_address,
                            uint32_t num_sectors,
                            uint32_t sector_size)
+{
+    return scsi_read_write((msc_device_t *)dev, lun, SCSI_CMD_WRITE10, 0, (uint8_t *)data, sector_address, num_sectors, sector_size);
+}
+
+esp_err_t scsi_cmd_read16(msc_host_device_handle_t dev,
+                          uint8_t lun,
+                          uint8_t *data,
+                          uint64_t sector_address,
+                          uint32_t num_sectors,
+                          uint32_t sector_size)
+{
+    return scsi_read_write((msc_device_t *)dev, lun, SCSI_CMD_READ16, 0, data, sector_address, num_sectors, sector_size);
+}
+
+esp_err_t scsi_cmd_write16(msc_host_device_handle_t dev,
+                           uint8_t lun,
+                           const uint8_t *data,
+                           uint64_t sector_address,
+                           uint32_t num_sectors,
+                           uint32_t sector_size)
+{
+    return scsi_read_write((msc_device_t *)dev, lun, SCSI_CMD_WRITE16, 0, (uint8_t *)data, sector_address, num_sectors, sector_size);
+}
+
+esp_err_t scsi_cmd_read(msc_host_device_handle_t dev,
+                        uint8_t lun,
+                        uint8_t *data,
+                        uint64_t sector_address,
+                        uint32_t num_sectors,
+                        uint32_t sector_size)
 {
     msc_device_t *device = (msc_device_t *)dev;
-    cbw_write10_t cbw = {
-        CBW_BASE_INIT(OUT_DIR, CBW_CMD_SIZE(cbw_write10_t), num_sectors * sector_size),
-        .opcode = SCSI_CMD_WRITE10,
-        .address = __builtin_bswap32(sector_address),
-        .length = __builtin_bswap16(num_sectors),
-    };
+    MSC_RETURN_ON_FALSE(lun < device->lun_num, ESP_ERR_INVALID_ARG);
+    const uint8_t opcode = (device->disk[lun].block_count >= UINT32_MAX) ? SCSI_CMD_READ16 : SCSI_CMD_READ10;
+    return scsi_read_write(device, lun, opcode, 0, data, sector_address, num_sectors, sector_size);
+}
 
-    esp_err_t ret = bot_execute_command(device, &cbw.base, (void *)data, num_sectors * sector_size);
+esp_err_t scsi_cmd_write(msc_host_device_handle_t dev,
+                         uint8_t lun,
+                         const uint8_t *data,
+                         uint64_t sector_address,
+                         uint32_t num_sectors,
+                         uint32_t sector_size)
+{
+    msc_device_t *device = (msc_device_t *)dev;
+    MSC_RETURN_ON_FALSE(lun < device->lun_num, ESP_ERR_INVALID_ARG);
+    const uint8_t opcode = (device->disk[lun].block_count >= UINT32_MAX) ? SCSI_CMD_WRITE16 : SCSI_CMD_WRITE10;
+    return scsi_read_write(device, lun, opcode, 0, (uint8_t *)data, sector_address, num_sectors, sector_size);
+}
 
-    // In case of an error, get an error code
-    if (unlikely(ret != ESP_OK)) {
-        MSC_RETURN_ON_ERROR( scsi_cmd_sense(device, NULL));
-    }
-    return ret;
+esp_err_t scsi_cmd_write_fua(msc_host_device_handle_t dev,
+                             uint8_t lun,
+                             const uint8_t *data,
+                             uint64_t sector_address,
+                             uint32_t num_sectors,
+                             uint32_t sector_size)
+{
+    msc_device_t *device = (msc_device_t *)dev;
+    MSC_RETURN_ON_FALSE(lun < device->lun_num, ESP_ERR_INVALID_ARG);
+    const uint8_t opcode = (device->disk[lun].block_count >= UINT32_MAX) ? SCSI_CMD_WRITE16 : SCSI_CMD_WRITE10;
+    return scsi_read_write(device, lun, opcode, SCSI_WRITE_FUA, (uint8_t *)data, sector_address, num_sectors, sector_size);
 }
 
-esp_err_t scsi_cmd_read_capacity(msc_host_device_handle_t dev, uint32_t *block_size, uint32_t *block_count)
+esp_err_t scsi_cmd_read_capacity(msc_host_device_handle_t dev, uint8_t lun, uint32_t *block_size, uint32_t *block_count)
 {
     msc_device_t *device = (msc_device_t *)dev;
     cbw_read_capacity_response_t response;
 
     cbw_read_capacity_t cbw = {
-        CBW_BASE_INIT(IN_DIR, CBW_CMD_SIZE(cbw_read_capacity_t), sizeof(response)),
+        CBW_BASE_INIT(lun, IN_DIR, CBW_CMD_SIZE(cbw_read_capacity_t), sizeof(response)),
         .opcode = SCSI_CMD_READ_CAPACITY,
     };
 
-    esp_err_t ret = bot_execute_command(device, &cbw.base, &response, sizeof(response));
-
-    // In case of an error, get an error code
-    if (unlikely(ret != ESP_OK)) {
-        MSC_RETURN_ON_ERROR( scsi_cmd_sense(device, NULL));
-    }
+    esp_err_t ret = scsi_execute_command(device, &cbw.base, &response, sizeof(response));
 
     *block_count = __builtin_bswap32(response.block_count);
     *block_size = __builtin_bswap32(response.block_size);
@@ -384,35 +840,65 @@ esp_err_t scsi_cmd_read_capacity(msc_host_device_handle_t dev, uint32_t *block_s
     return ret;
 }
 
-esp_err_t scsi_cmd_unit_ready(msc_host_device_handle_t dev)
+esp_err_t scsi_cmd_read_capacity16(msc_host_device_handle_t dev, uint8_t lun, uint32_t *block_size, uint64_t *block_count)
+{
+    msc_device_t *device = (msc_device_t *)dev;
+    cbw_read_capacity16_response_t response;
+
+    cbw_read_capacity16_t cbw = {
+        CBW_BASE_INIT(lun, IN_DIR, CBW_CMD_SIZE(cbw_read_capacity16_t), sizeof(response)),
+        .opcode = SCSI_CMD_SERVICE_ACTION_IN16,
+        .service_action = SCSI_SA_READ_CAPACITY16,
+        .allocation_length = __builtin_bswap32(sizeof(response)),
+    };
+
+    esp_err_t ret = scsi_execute_command(device, &cbw.base, &response, sizeof(response));
+
+    *block_count = __builtin_bswap64(response.block_count);
+    *block_size = __builtin_bswap32(response.block_size);
+
+    return ret;
+}
+
+esp_err_t scsi_cmd_unit_ready(msc_host_device_handle_t dev, uint8_t lun)
 {
     msc_device_t *device = (msc_device_t *)dev;
     cbw_unit_ready_t cbw = {
-        CBW_BASE_INIT(IN_DIR, CBW_CMD_SIZE(cbw_unit_ready_t), 0),
+        CBW_BASE_INIT(lun, IN_DIR, CBW_CMD_SIZE(cbw_unit_ready_t), 0),
         .opcode = SCSI_CMD_TEST_UNIT_READY,
     };
 
-    esp_err_t ret = bot_execute_command(device, &cbw.base, NULL, 0);
-
-    // In case of an error, get an error code
-    if (unlikely(ret != ESP_OK)) {
-        MSC_RETURN_ON_ERROR( scsi_cmd_sense(device, NULL));
-    }
+    esp_err_t ret = scsi_execute_command(device, &cbw.base, NULL, 0);
     return ret;
 }
 
-esp_err_t scsi_cmd_sense(msc_host_device_handle_t dev, scsi_sense_data_t *sense)
+esp_err_t scsi_cmd_sense(msc_host_device_handle_t dev, uint8_t lun, scsi_sense_data_t *sense)
 {
     msc_device_t *device = (msc_device_t *)dev;
     cbw_sense_response_t response;
 
     cbw_sense_t cbw = {
-        CBW_BASE_INIT(IN_DIR, CBW_CMD_SIZE(cbw_sense_t), sizeof(response)),
+        CBW_BASE_INIT(lun, IN_DIR, CBW_CMD_SIZE(cbw_sense_t), sizeof(response)),
         .opcode = SCSI_CMD_REQUEST_SENSE,
         .allocation_length = sizeof(response),
     };
 
-    MSC_RETURN_ON_ERROR( bot_execute_command(device, &cbw.base, &response, sizeof(response)) );
+    if (device->config.transport == MSC_TRANSPORT_UAS && device->uas.sense_len) {
+        // UAS device reported sense data of the failed command in its SENSE IU
+        memset(&response, 0, sizeof(response));
+        memcpy(&response, device->uas.sense, MIN(device->uas.sense_len, sizeof(response)));
+        device->uas.sense_len = 0;
+    } else {
+        msc_device_lock(device);
+        const esp_err_t ret = bot_execute_command(device, &cbw.base, &response, sizeof(response));
+        msc_device_unlock(device);
+        MSC_RETURN_ON_ERROR(ret);
+    }
+
+    device->stats.sense_keys[response.sense_key & (MSC_HOST_STATS_SENSE_KEY_NUM - 1)]++;
+    if (response.sense_key == SCSI_SENSE_DATA_PROTECT && lun < MSC_MAX_LUN_NUM) {
+        device->disk[lun].write_protected = true;
+    }
 
     if (sense == NULL) {
         ESP_LOGE(TAG, "Sense error codes: Sense Key 0x%02"PRIx8", ASC: 0x%02"PRIx8", ASCQ: 0x%02"PRIx8"",
@@ -429,61 +915,183 @@ esp_err_t scsi_cmd_sense(msc_host_device_handle_t dev, scsi_sense_data_t *sense)
     return ESP_OK;
 }
 
-esp_err_t scsi_cmd_inquiry(msc_host_device_handle_t dev)
+esp_err_t scsi_cmd_inquiry(msc_host_device_handle_t dev, uint8_t lun, bool *removable)
 {
     msc_device_t *device = (msc_device_t *)dev;
     cbw_inquiry_response_t response = { 0 };
 
     cbw_inquiry_t cbw = {
-        CBW_BASE_INIT(IN_DIR, CBW_CMD_SIZE(cbw_inquiry_t), sizeof(response)),
+        CBW_BASE_INIT(lun, IN_DIR, CBW_CMD_SIZE(cbw_inquiry_t), sizeof(response)),
         .opcode = SCSI_CMD_INQUIRY,
         .allocation_length = sizeof(response),
     };
 
-    esp_err_t ret = bot_execute_command(device, &cbw.base, &response, sizeof(response) );
+    esp_err_t ret = scsi_execute_command(device, &cbw.base, &response, sizeof(response));
+    if (ret == ESP_OK && removable) {
+        *removable = response.data[1] & SCSI_INQUIRY_RMB;
+    }
+    return ret;
+}
 
-    // In case of an error, get an error code
-    if (unlikely(ret != ESP_OK)) {
-        MSC_RETURN_ON_ERROR( scsi_cmd_sense(device, NULL));
+/**
+ * @brief Execute command, which the device may not implement
+ *
+ * Devices reject unsupported commands with ILLEGAL REQUEST, their sense data are read without reporting an error.
+ *
+ * @return ESP_ERR_NOT_SUPPORTED if the device rejects the command
+ */
+static esp_err_t scsi_execute_optional_command(msc_device_t *device, msc_cbw_t *cbw, void *data, size_t size)
+{
+    msc_device_lock(device);
+    esp_err_t ret = bot_execute_command(device, cbw, data, size);
+    if (ret != ESP_OK && ret != ESP_ERR_TIMEOUT) {
+        scsi_sense_data_t sense = { 0 };
+        if (scsi_cmd_sense(device, cbw->lun, &sense) == ESP_OK && sense.key == SCSI_SENSE_ILLEGAL_REQUEST) {
+            ret = ESP_ERR_NOT_SUPPORTED;
+        }
     }
+    msc_device_unlock(device);
     return ret;
 }
 
-esp_err_t scsi_cmd_mode_sense(msc_host_device_handle_t dev)
+/**
+ * @brief Read VPD page of the given size
+ */
+static esp_err_t scsi_inquiry_vpd_page(msc_device_t *device, uint8_t lun, uint8_t page_code, uint8_t *data, uint8_t size)
+{
+    cbw_inquiry_t cbw = {
+        CBW_BASE_INIT(lun, IN_DIR, CBW_CMD_SIZE(cbw_inquiry_t), size),
+        .opcode = SCSI_CMD_INQUIRY,
+        .flags = SCSI_INQUIRY_EVPD,
+        .page_code = page_code,
+        .allocation_length = size,
+    };
+
+    return scsi_execute_optional_command(device, &cbw.base, data, size);
+}
+
+esp_err_t scsi_cmd_inquiry_vpd(msc_host_device_handle_t dev, uint8_t lun, uint8_t page_code, uint8_t *data, size_t *size)
+{
+    msc_device_t *device = (msc_device_t *)dev;
+    MSC_RETURN_ON_FALSE(*size >= VPD_HEADER_SIZE, ESP_ERR_INVALID_SIZE);
+
+    // Data residue of a shorter page fails the command, so the page length is read first
+    MSC_RETURN_ON_ERROR( scsi_inquiry_vpd_page(device, lun, page_code, data, VPD_HEADER_SIZE) );
+    const size_t page_size = MIN(VPD_HEADER_SIZE + ((data[2] << 8) | data[3]), MIN(*size, UINT8_MAX));
+    MSC_RETURN_ON_ERROR( scsi_inquiry_vpd_page(device, lun, page_code, data, page_size) );
+    *size = page_size;
+    return ESP_OK;
+}
+
+esp_err_t scsi_cmd_read_capacity16_info(msc_host_device_handle_t dev, uint8_t lun, scsi_capacity16_t *capacity)
+{
+    msc_device_t *device = (msc_device_t *)dev;
+    cbw_read_capacity16_response_t response;
+
+    cbw_read_capacity16_t cbw = {
+        CBW_BASE_INIT(lun, IN_DIR, CBW_CMD_SIZE(cbw_read_capacity16_t), sizeof(response)),
+        .opcode = SCSI_CMD_SERVICE_ACTION_IN16,
+        .service_action = SCSI_SA_READ_CAPACITY16,
+        .allocation_length = __builtin_bswap32(sizeof(response)),
+    };
+
+    // Devices under 2TB may not implement READ CAPACITY(16)
+    MSC_RETURN_ON_ERROR( scsi_execute_optional_command(device, &cbw.base, &response, sizeof(response)) );
+
+    capacity->block_count = __builtin_bswap64(response.block_count);
+    capacity->block_size = __builtin_bswap32(response.block_size);
+    capacity->phys_block_exp = response.exponents & 0x0F;
+    capacity->lowest_aligned_lba = __builtin_bswap16(response.lowest_aligned) & 0x3FFF;
+    return ESP_OK;
+}
+
+esp_err_t scsi_cmd_unmap(msc_host_device_handle_t dev, uint8_t lun, const scsi_unmap_range_t *ranges, size_t range_num)
+{
+    msc_device_t *device = (msc_device_t *)dev;
+    MSC_RETURN_ON_FALSE(range_num > 0 && range_num <= SCSI_UNMAP_MAX_RANGES, ESP_ERR_INVALID_ARG);
+
+    unmap_parameter_list_t params = { 0 };
+    const uint16_t size = UNMAP_HEADER_SIZE + range_num * UNMAP_DESCRIPTOR_SIZE;
+    params.header.data_length = __builtin_bswap16(size - 2);
+    params.header.block_descriptor_data_length = __builtin_bswap16(range_num * UNMAP_DESCRIPTOR_SIZE);
+    for (size_t i = 0; i < range_num; i++) {
+        params.descriptors[i].address = __builtin_bswap64(ranges[i].sector_address);
+        params.descriptors[i].length = __builtin_bswap32(ranges[i].num_sectors);
+    }
+
+    cbw_unmap_t cbw = {
+        CBW_BASE_INIT(lun, OUT_DIR, CBW_CMD_SIZE(cbw_unmap_t), size),
+        .opcode = SCSI_CMD_UNMAP,
+        .parameter_list_length = __builtin_bswap16(size),
+    };
+
+    return scsi_execute_command(device, &cbw.base, &params, size);
+}
+
+esp_err_t scsi_cmd_write_same16_unmap(msc_host_device_handle_t dev,
+                                      uint8_t lun,
+                                      uint64_t sector_address,
+                                      uint32_t num_sectors,
+                                      uint32_t sector_size)
+{
+    msc_device_t *device = (msc_device_t *)dev;
+    MSC_RETURN_ON_FALSE(num_sectors > 0, ESP_ERR_INVALID_ARG);
+
+    // One block of zeros is written to the unmapped sectors that cannot be deallocated
+    uint8_t *data = MSC_CALLOC(BUFFER, 1, sector_size);
+    MSC_RETURN_ON_FALSE(data, ESP_ERR_NO_MEM);
+
+    // WRITE SAME(16) has the same layout as WRITE(16)
+    cbw_read16_t cbw = {
+        CBW_BASE_INIT(lun, OUT_DIR, CBW_CMD_SIZE(cbw_read16_t), sector_size),
+        .opcode = SCSI_CMD_WRITE_SAME16,
+        .flags = SCSI_WRITE_SAME_UNMAP,
+        .address = __builtin_bswap64(sector_address),
+        .length = __builtin_bswap32(num_sectors),
+    };
+
+    esp_err_t ret = scsi_execute_command(device, &cbw.base, data, sector_size);
+    MSC_FREE(BUFFER, data, sector_size);
+    return ret;
+}
+
+esp_err_t scsi_cmd_synchronize_cache(msc_host_device_handle_t dev, uint8_t lun)
+{
+    msc_device_t *device = (msc_device_t *)dev;
+    // SYNCHRONIZE CACHE(10) has the same layout as WRITE(10), zero address and length flush the whole cache
+    cbw_write10_t cbw = {
+        CBW_BASE_INIT(lun, OUT_DIR, CBW_CMD_SIZE(cbw_write10_t), 0),
+        .opcode = SCSI_CMD_SYNCHRONIZE_CACHE10,
+    };
+
+    return scsi_execute_optional_command(device, &cbw.base, NULL, 0);
+}
+
+esp_err_t scsi_cmd_mode_sense(msc_host_device_handle_t dev, uint8_t lun)
 {
     msc_device_t *device = (msc_device_t *)dev;
     mode_sense_response_t response = { 0 };
 
     mode_sense_t cbw = {
-        CBW_BASE_INIT(IN_DIR, CBW_CMD_SIZE(mode_sense_t), sizeof(response)),
+        CBW_BASE_INIT(lun, IN_DIR, CBW_CMD_SIZE(mode_sense_t), sizeof(response)),
         .opcode = SCSI_CMD_MODE_SENSE,
         .pc_page_code = 0x3F,
         .parameter_list_length = sizeof(response),
     };
 
-    esp_err_t ret = bot_execute_command(device, &cbw.base, &response, sizeof(response) );
-
-    // In case of an error, get an error code
-    if (unlikely(ret != ESP_OK)) {
-        MSC_RETURN_ON_ERROR( scsi_cmd_sense(device, NULL));
-    }
+    esp_err_t ret = scsi_execute_command(device, &cbw.base, &response, sizeof(response));
     return ret;
 }
 
-esp_err_t scsi_cmd_prevent_removal(msc_host_device_handle_t dev, bool prevent)
+esp_err_t scsi_cmd_prevent_removal(msc_host_device_handle_t dev, uint8_t lun, bool prevent)
 {
     msc_device_t *device = (msc_device_t *)dev;
     prevent_allow_medium_removal_t cbw = {
-        CBW_BASE_INIT(OUT_DIR, CBW_CMD_SIZE(prevent_allow_medium_removal_t), 0),
+        CBW_BASE_INIT(lun, OUT_DIR, CBW_CMD_SIZE(prevent_allow_medium_removal_t), 0),
         .opcode = SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL,
         .prevent = (uint8_t) prevent,
     };
 
-    esp_err_t ret = bot_execute_command(device, &cbw.base, NULL, 0);
-
-    // In case of an error, get an error code
-    if (unlikely(ret != ESP_OK)) {
-        MSC_RETURN_ON_ERROR( scsi_cmd_sense(device, NULL));
-    }
+    esp_err_t ret = scsi_execute_command(device, &cbw.base, NULL, 0);
     return ret;
 }
@@ -9,14 +9,19 @@
 #if SOC_USB_OTG_SUPPORTED
 
 #include "unity.h"
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <sys/param.h>
 #include "esp_idf_version.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
 #include "esp_private/msc_scsi_bot.h"
 #include "esp_private/usb_phy.h"
 #include "usb/usb_host.h"
 #include "usb/msc_host_vfs.h"
+#include "usb/msc_host_blockdev.h"
 #include "test_common.h"
 #include "../private_include/msc_common.h"
 
@@ -289,8 +294,8 @@ static void write_read_sectors(void)
     memset(write_data, 0x55, DISK_BLOCK_SIZE);
     memset(read_data, 0, DISK_BLOCK_SIZE);
 
-    ESP_OK_ASSERT( scsi_cmd_write10(device, write_data, 10, 1, DISK_BLOCK_SIZE));
-    ESP_OK_ASSERT( scsi_cmd_read10(device, read_data, 10, 1, DISK_BLOCK_SIZE));
+    ESP_OK_ASSERT( scsi_cmd_write10(device, 0, write_data, 10, 1, DISK_BLOCK_SIZE));
+    ESP_OK_ASSERT( scsi_cmd_read10(device, 0, read_data, 10, 1, DISK_BLOCK_SIZE));
 
     TEST_ASSERT_EQUAL_MEMORY(write_data, read_data, DISK_BLOCK_SIZE);
 }
@@ -301,7 +306,7 @@ static void erase_storage(void)
     memset(data, 0xFF, DISK_BLOCK_SIZE);
 
     for (int block = 0; block < DISK_BLOCK_NUM; block++) {
-        scsi_cmd_write10(device, data, block, 1, DISK_BLOCK_SIZE);
+        scsi_cmd_write10(device, 0, data, block, 1, DISK_BLOCK_SIZE);
     }
 }
 
@@ -312,6 +317,58 @@ TEST_CASE("write_and_read_file", "[usb_msc]")
     msc_teardown();
 }
 
+/**
+ * @brief Sector cache testcase
+ *
+ * The file is written through write-back cache and read back after remounting without the cache,
+ * so the dirty sectors must have been flushed on unmount.
+ */
+TEST_CASE("write_and_read_file_with_cache", "[usb_msc]")
+{
+    const msc_host_vfs_cache_config_t cache_config = {
+        .sector_num = 32,
+        .read_ahead_sectors = 8,
+        .write_back = true,
+    };
+
+    msc_setup();
+    ESP_OK_ASSERT( msc_host_vfs_unregister(vfs_handle) );
+    ESP_OK_ASSERT( msc_host_vfs_register_with_cache(device, "/usb", &mount_config, &cache_config, &vfs_handle) );
+    write_read_file(FILE_NAME);
+    msc_teardown();
+
+    msc_setup();
+    TEST_ASSERT(file_exists(FILE_NAME));
+    write_read_file(FILE_NAME);
+    msc_teardown();
+}
+
+/**
+ * @brief Write barrier testcase
+ *
+ * The file is written with FUA metadata writes and synced through write-back cache,
+ * SYNCHRONIZE CACHE rejected by the device must not fail the sync.
+ */
+TEST_CASE("write_and_read_file_with_fua_barrier", "[usb_msc]")
+{
+    const msc_host_vfs_cache_config_t cache_config = {
+        .sector_num = 32,
+        .write_back = true,
+        .write_barrier = MSC_HOST_WRITE_BARRIER_FUA,
+    };
+
+    msc_setup();
+    ESP_OK_ASSERT( msc_host_vfs_unregister(vfs_handle) );
+    ESP_OK_ASSERT( msc_host_vfs_register_with_cache(device, "/usb", &mount_config, &cache_config, &vfs_handle) );
+    FILE *file = fopen(FILE_NAME, "w");
+    TEST_ASSERT_NOT_NULL(file);
+    TEST_ASSERT_TRUE(fprintf(file, "%s", "barrier") > 0);
+    TEST_ASSERT_EQUAL(0, fsync(fileno(file)));
+    fclose(file);
+    write_read_file(FILE_NAME);
+    msc_teardown();
+}
+
 TEST_CASE("sudden_disconnect", "[usb_msc]")
 {
     msc_setup();
@@ -366,7 +423,7 @@ TEST_CASE("error_recovery_2", "[usb_msc][ignore]")
     // Write to and read from invalid sector
     // Some flash disks will respond with stall, some with error in CSW, some with timeout
     printf("read 10\n");
-    err = scsi_cmd_read10(device, data, UINT32_MAX, 1, DISK_BLOCK_SIZE);
+    err = scsi_cmd_read10(device, 0, data, UINT32_MAX, 1, DISK_BLOCK_SIZE);
     TEST_ASSERT_NOT_EQUAL(ESP_OK, err);
     err = msc_host_reset_recovery(device);
     TEST_ASSERT_EQUAL(ESP_OK, err);
@@ -487,7 +544,8 @@ static void print_device_info(msc_host_device_info_t *info)
     printf("Device info:\n");
     printf("\t Capacity: %llu MB\n", capacity);
     printf("\t Sector size: %"PRIu32"\n", info->sector_size);
-    printf("\t Sector count: %"PRIu32"\n", info->sector_count);
+    printf("\t Sector count: %"PRIu64"\n", info->sector_count);
+    printf("\t LUNs: %d\n", info->lun_num);
     printf("\t PID: 0x%4X \n", info->idProduct);
     printf("\t VID: 0x%4X \n", info->idVendor);
     wprintf(L"\t iProduct: %S \n", info->iProduct);
@@ -511,6 +569,57 @@ TEST_CASE("device_info", "[usb_msc]")
     print_device_info(&info);
 }
 
+/**
+ * @brief USB MSC Logical Unit testcase
+ *
+ * The mock device has one LUN, which is reported by both msc_host_get_device_info() and msc_host_get_lun_info()
+ */
+TEST_CASE("lun_info", "[usb_msc]")
+{
+    msc_host_device_info_t info, lun_info;
+    msc_host_vfs_handle_t lun_vfs_handle;
+
+    msc_setup();
+    ESP_OK_ASSERT( msc_host_get_device_info(device, &info) );
+    TEST_ASSERT_EQUAL(1, info.lun_num);
+    ESP_OK_ASSERT( msc_host_get_lun_info(device, 0, &lun_info) );
+    TEST_ASSERT_EQUAL(info.sector_count, lun_info.sector_count);
+    TEST_ASSERT_EQUAL(info.sector_size, lun_info.sector_size);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, msc_host_get_lun_info(device, info.lun_num, &lun_info));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, msc_host_vfs_register_lun(device, info.lun_num, "/usb1", &mount_config, NULL, &lun_vfs_handle));
+    msc_teardown();
+}
+
+/**
+ * @brief Device statistics
+ *
+ * Write and read one sector and check that the commands and their phases are accounted
+ */
+TEST_CASE("stats", "[usb_msc]")
+{
+    msc_host_stats_t stats;
+    uint32_t cmds = 0;
+
+    msc_setup();
+    ESP_OK_ASSERT( msc_host_reset_stats(device) );
+    write_read_sectors();
+    ESP_OK_ASSERT( msc_host_get_stats(device, &stats) );
+
+    TEST_ASSERT_EQUAL(1, stats.write_cmds);
+    TEST_ASSERT_EQUAL(1, stats.read_cmds);
+    TEST_ASSERT_EQUAL(DISK_BLOCK_SIZE, stats.write_bytes);
+    TEST_ASSERT_EQUAL(DISK_BLOCK_SIZE, stats.read_bytes);
+    for (int i = 0; i < MSC_HOST_STATS_HIST_BUCKETS; i++) {
+        cmds += stats.status_latency[i];
+    }
+    TEST_ASSERT_EQUAL(2, cmds);
+
+    ESP_OK_ASSERT( msc_host_reset_stats(device) );
+    ESP_OK_ASSERT( msc_host_get_stats(device, &stats) );
+    TEST_ASSERT_EQUAL(0, stats.read_cmds);
+    msc_teardown();
+}
+
 /**
  * @brief USB MSC driver with no background task
  *
@@ -554,6 +663,379 @@ TEST_CASE("no_background_task_2", "[usb_msc]")
     msc_test_deinit();
 }
 
+static esp_err_t async_io_result;
+
+static void async_io_cb(msc_host_device_handle_t dev, esp_err_t result, void *arg)
+{
+    if (result != ESP_OK) {
+        async_io_result = result;
+    }
+    xSemaphoreGive((SemaphoreHandle_t)arg);
+}
+
+/**
+ * @brief Asynchronous sector requests
+ *
+ * Queue writes, reads and a barrier from the application task
+ * and make sure that they are completed in the order of submission
+ */
+TEST_CASE("async_sectors_can_be_written_and_read", "[usb_msc]")
+{
+    const int request_num = 4;
+    static uint8_t write_data[4][DISK_BLOCK_SIZE];
+    static uint8_t read_data[4][DISK_BLOCK_SIZE];
+
+    msc_test_init();
+    const msc_host_driver_config_t msc_config = {
+        .create_backround_task = true,
+        .callback = msc_event_cb,
+        .stack_size = 4096,
+        .task_priority = 5,
+        .async_io = {
+            .queue_size = 2 * request_num + 1,
+            .stack_size = 4096,
+            .task_priority = 5,
+        },
+    };
+    ESP_OK_ASSERT( msc_host_install(&msc_config) );
+    msc_test_wait_and_install_device();
+
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(2 * request_num + 1, 0);
+    TEST_ASSERT_NOT_NULL(done);
+    async_io_result = ESP_OK;
+    for (int i = 0; i < request_num; i++) {
+        memset(write_data[i], 0x10 + i, DISK_BLOCK_SIZE);
+        memset(read_data[i], 0, DISK_BLOCK_SIZE);
+        ESP_OK_ASSERT( msc_host_write_sector_async(device, 0, 10 + i, 1, write_data[i], async_io_cb, done) );
+    }
+    for (int i = 0; i < request_num; i++) {
+        ESP_OK_ASSERT( msc_host_read_sector_async(device, 0, 10 + i, 1, read_data[i], async_io_cb, done) );
+    }
+    ESP_OK_ASSERT( msc_host_io_barrier(device, async_io_cb, done) );
+
+    for (int i = 0; i < 2 * request_num + 1; i++) {
+        TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(done, pdMS_TO_TICKS(1000)));
+    }
+    ESP_OK_ASSERT( async_io_result );
+    TEST_ASSERT_EQUAL_MEMORY(write_data, read_data, sizeof(write_data));
+
+    vSemaphoreDelete(done);
+    msc_teardown();
+}
+
+/**
+ * @brief Raw block device
+ *
+ * Write single blocks through the write batch, read them back and check
+ * that a non-sequential write and sync write the batched data
+ */
+TEST_CASE("blockdev_can_be_written_and_read", "[usb_msc]")
+{
+    const int block_num = 4;
+    static uint8_t write_data[4][DISK_BLOCK_SIZE];
+    static uint8_t read_data[4][DISK_BLOCK_SIZE];
+    msc_host_blockdev_handle_t blockdev;
+    msc_host_blockdev_geometry_t geometry;
+    const msc_host_blockdev_config_t blockdev_config = {
+        .write_batch_size = 2 * DISK_BLOCK_SIZE,
+    };
+
+    msc_setup();
+    ESP_OK_ASSERT( msc_host_blockdev_open(device, 0, &blockdev_config, &blockdev) );
+    ESP_OK_ASSERT( msc_host_blockdev_get_geometry(blockdev, &geometry) );
+    TEST_ASSERT_EQUAL(DISK_BLOCK_SIZE, geometry.block_size);
+    TEST_ASSERT_EQUAL(2 * DISK_BLOCK_SIZE, geometry.write_size);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, msc_host_blockdev_write(blockdev, 1, write_data[0], DISK_BLOCK_SIZE));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, msc_host_blockdev_read(blockdev, geometry.disk_size, read_data[0], DISK_BLOCK_SIZE));
+
+    for (int i = 0; i < block_num; i++) {
+        memset(write_data[i], 0x20 + i, DISK_BLOCK_SIZE);
+        ESP_OK_ASSERT( msc_host_blockdev_write(blockdev, (10 + i) * DISK_BLOCK_SIZE, write_data[i], DISK_BLOCK_SIZE) );
+    }
+    memset(read_data, 0, sizeof(read_data));
+    ESP_OK_ASSERT( msc_host_blockdev_read(blockdev, 10 * DISK_BLOCK_SIZE, read_data, sizeof(read_data)) );
+    TEST_ASSERT_EQUAL_MEMORY(write_data, read_data, sizeof(write_data));
+
+    // Batched block is written before the next non-sequential one
+    memset(write_data[0], 0x30, DISK_BLOCK_SIZE);
+    memset(write_data[1], 0x31, DISK_BLOCK_SIZE);
+    ESP_OK_ASSERT( msc_host_blockdev_write(blockdev, 10 * DISK_BLOCK_SIZE, write_data[0], DISK_BLOCK_SIZE) );
+    ESP_OK_ASSERT( msc_host_blockdev_write(blockdev, 12 * DISK_BLOCK_SIZE, write_data[1], DISK_BLOCK_SIZE) );
+    ESP_OK_ASSERT( msc_host_blockdev_sync(blockdev) );
+    ESP_OK_ASSERT( scsi_cmd_read10(device, 0, read_data[0], 10, 1, DISK_BLOCK_SIZE) );
+    ESP_OK_ASSERT( scsi_cmd_read10(device, 0, read_data[1], 12, 1, DISK_BLOCK_SIZE) );
+    TEST_ASSERT_EQUAL_MEMORY(write_data, read_data, 2 * DISK_BLOCK_SIZE);
+
+    ESP_OK_ASSERT( msc_host_blockdev_close(blockdev) );
+    msc_teardown();
+}
+
+/**
+ * @brief Device with its own configuration
+ *
+ * The driver has no asynchronous worker, the device gets its own and a shorter transfer timeout
+ */
+TEST_CASE("install_device_with_config", "[usb_msc]")
+{
+    static uint8_t write_data[DISK_BLOCK_SIZE];
+    static uint8_t read_data[DISK_BLOCK_SIZE];
+    msc_host_event_t app_event;
+    const msc_host_device_config_t invalid_config = {
+        .async_io = {
+            .queue_size = 4,
+        },
+    };
+    const msc_host_device_config_t device_config = {
+        .async_io = {
+            .queue_size = 4,
+            .stack_size = 4096,
+            .task_priority = 5,
+            .core_id = tskNO_AFFINITY,
+        },
+        .transfer_timeout_ms = 1000,
+    };
+
+    msc_test_init();
+    const msc_host_driver_config_t msc_config = {
+        .create_backround_task = true,
+        .callback = msc_event_cb,
+        .stack_size = 4096,
+        .task_priority = 5,
+    };
+    ESP_OK_ASSERT( msc_host_install(&msc_config) );
+    xQueueReceive(app_queue, &app_event, portMAX_DELAY);
+    TEST_ASSERT_EQUAL(MSC_DEVICE_CONNECTED, app_event.event);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, msc_host_install_device_with_config(app_event.device.address, &invalid_config, &device));
+    ESP_OK_ASSERT( msc_host_install_device_with_config(app_event.device.address, &device_config, &device) );
+    ESP_OK_ASSERT( msc_host_vfs_register(device, "/usb", &mount_config, &vfs_handle) );
+
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(3, 0);
+    TEST_ASSERT_NOT_NULL(done);
+    async_io_result = ESP_OK;
+    memset(write_data, 0x42, DISK_BLOCK_SIZE);
+    memset(read_data, 0, DISK_BLOCK_SIZE);
+    ESP_OK_ASSERT( msc_host_write_sector_async(device, 0, 10, 1, write_data, async_io_cb, done) );
+    ESP_OK_ASSERT( msc_host_read_sector_async(device, 0, 10, 1, read_data, async_io_cb, done) );
+    ESP_OK_ASSERT( msc_host_io_barrier(device, async_io_cb, done) );
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(done, pdMS_TO_TICKS(1000)));
+    }
+    ESP_OK_ASSERT( async_io_result );
+    TEST_ASSERT_EQUAL_MEMORY(write_data, read_data, DISK_BLOCK_SIZE);
+
+    vSemaphoreDelete(done);
+    msc_teardown();
+}
+
+#define BENCH_MIN_BYTES     (256 * 1024)        // Data transferred by one measurement, at least BENCH_MIN_OPS transfers
+#define BENCH_MIN_OPS       8
+#define BENCH_AREA_SIZE     (16 * 1024 * 1024)  // Area of random accesses
+#define BENCH_FILE_SIZE     (1024 * 1024)
+#define BENCH_MAX_SIZE      (128 * 1024)
+#define BENCH_MAX_DEPTH     8
+#define BENCH_FILE_NAME     "/usb/BENCH.BIN"
+
+static const size_t bench_sizes[] = {512, 4096, 16384, 65536, BENCH_MAX_SIZE};
+static const int bench_depths[] = {1, 2, 4, BENCH_MAX_DEPTH};
+
+typedef struct {
+    uint32_t block_size;
+    msc_host_blockdev_handle_t blockdev;
+} bench_t;
+
+typedef esp_err_t (*bench_io_t)(const bench_t *bench, bool write, uint64_t sector, uint32_t num_sectors, uint8_t *data);
+
+static int bench_ops(size_t size)
+{
+    return MAX(BENCH_MIN_BYTES / size, BENCH_MIN_OPS);
+}
+
+static void bench_report(const char *layer, const char *config, bool write, bool random, size_t size, int ops, int64_t time_us)
+{
+    const double seconds = time_us / 1000000.0;
+    printf("%-8s %-8s %-5s %-4s %7u B %8.2f MB/s %8.0f IOPS\n", layer, config, write ? "write" : "read", random ? "rand" : "seq",
+           (unsigned)size, (double)size * ops / seconds / (1024 * 1024), ops / seconds);
+}
+
+static esp_err_t bench_raw_io(const bench_t *bench, bool write, uint64_t sector, uint32_t num_sectors, uint8_t *data)
+{
+    return write ? scsi_cmd_write(device, 0, data, sector, num_sectors, bench->block_size) :
+           scsi_cmd_read(device, 0, data, sector, num_sectors, bench->block_size);
+}
+
+static esp_err_t bench_blockdev_io(const bench_t *bench, bool write, uint64_t sector, uint32_t num_sectors, uint8_t *data)
+{
+    const uint64_t addr = sector * bench->block_size;
+    const size_t size = num_sectors * bench->block_size;
+    return write ? msc_host_blockdev_write(bench->blockdev, addr, data, size) :
+           msc_host_blockdev_read(bench->blockdev, addr, data, size);
+}
+
+/**
+ * @brief Sequential and random reads and writes of all sizes within the first area_sectors sectors
+ */
+static void bench_sectors(const char *layer, bench_io_t io, const bench_t *bench, uint8_t *buf, uint64_t area_sectors)
+{
+    for (int write = 1; write >= 0; write--) {
+        for (int random = 0; random <= 1; random++) {
+            for (int i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); i++) {
+                const uint32_t num_sectors = bench_sizes[i] / bench->block_size;
+                if (num_sectors == 0 || num_sectors > area_sectors) {
+                    continue;
+                }
+                const uint64_t slots = area_sectors / num_sectors;
+                const int ops = bench_ops(num_sectors * bench->block_size);
+                srand(1);
+                const int64_t start = esp_timer_get_time();
+                for (int op = 0; op < ops; op++) {
+                    const uint64_t slot = random ? (uint64_t)rand() % slots : op % slots;
+                    ESP_OK_ASSERT( io(bench, write, slot * num_sectors, num_sectors, buf) );
+                }
+                bench_report(layer, "", write, random, num_sectors * bench->block_size, ops, esp_timer_get_time() - start);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Sequential asynchronous reads and writes with up to 'depth' requests in flight
+ */
+static void bench_async(const bench_t *bench, uint8_t *buf, uint64_t area_sectors)
+{
+    for (int write = 1; write >= 0; write--) {
+        for (int d = 0; d < sizeof(bench_depths) / sizeof(bench_depths[0]); d++) {
+            const int depth = bench_depths[d];
+            char config[16];
+            snprintf(config, sizeof(config), "qd %d", depth);
+            for (int i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); i++) {
+                // Requests in flight use their own part of the buffer
+                const uint32_t num_sectors = bench_sizes[i] / bench->block_size / depth;
+                if (num_sectors == 0 || num_sectors > area_sectors) {
+                    continue;
+                }
+                const uint64_t slots = area_sectors / num_sectors;
+                const int ops = bench_ops(num_sectors * bench->block_size);
+                SemaphoreHandle_t free_slots = xSemaphoreCreateCounting(depth, depth);
+                TEST_ASSERT_NOT_NULL(free_slots);
+                async_io_result = ESP_OK;
+                const int64_t start = esp_timer_get_time();
+                for (int op = 0; op < ops; op++) {
+                    uint8_t *data = buf + (op % depth) * num_sectors * bench->block_size;
+                    const uint64_t sector = (op % slots) * num_sectors;
+                    xSemaphoreTake(free_slots, portMAX_DELAY);
+                    ESP_OK_ASSERT( write ? msc_host_write_sector_async(device, 0, sector, num_sectors, data, async_io_cb, free_slots) :
+                                   msc_host_read_sector_async(device, 0, sector, num_sectors, data, async_io_cb, free_slots) );
+                }
+                for (int j = 0; j < depth; j++) {
+                    xSemaphoreTake(free_slots, portMAX_DELAY);
+                }
+                const int64_t time_us = esp_timer_get_time() - start;
+                vSemaphoreDelete(free_slots);
+                ESP_OK_ASSERT( async_io_result );
+                bench_report("async", config, write, false, num_sectors * bench->block_size, ops, time_us);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Sequential and random reads and writes of a file, newlib buffering is disabled to measure FatFS
+ */
+static void bench_file(const char *config, uint8_t *buf, size_t file_size)
+{
+    for (int write = 1; write >= 0; write--) {
+        for (int random = 0; random <= 1; random++) {
+            for (int i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); i++) {
+                const size_t size = bench_sizes[i];
+                if (size > file_size) {
+                    continue;
+                }
+                const size_t slots = file_size / size;
+                const int ops = bench_ops(size);
+                srand(1);
+                const int64_t start = esp_timer_get_time();
+                // Sequential writes create the file, which is then overwritten at random offsets and read
+                FILE *file = fopen(BENCH_FILE_NAME, write ? (random ? "r+" : "w") : "r");
+                TEST_ASSERT_NOT_NULL(file);
+                setvbuf(file, NULL, _IONBF, 0);
+                for (int op = 0; op < ops; op++) {
+                    if (random || op % slots == 0) {
+                        const size_t slot = random ? (size_t)rand() % slots : 0;
+                        TEST_ASSERT_EQUAL(0, fseek(file, slot * size, SEEK_SET));
+                    }
+                    TEST_ASSERT_EQUAL(size, write ? fwrite(buf, 1, size, file) : fread(buf, 1, size, file));
+                }
+                TEST_ASSERT_EQUAL(0, fclose(file));
+                bench_report("fatfs", config, write, random, size, ops, esp_timer_get_time() - start);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Throughput benchmark
+ *
+ * Measures MB/s and IOPS of raw SCSI commands, the block device, asynchronous requests with queue depth
+ * and FatFS files without and with sector cache, for transfer sizes from 512 B to 128 kB.
+ * Runs with the mock device as well as with real drives.
+ *
+ * @warning The filesystem and partition table of the drive are overwritten
+ */
+TEST_CASE("benchmark", "[usb_msc_benchmark][ignore]")
+{
+    const msc_host_vfs_cache_config_t cache_config = {
+        .sector_num = 32,
+        .read_ahead_sectors = 8,
+        .write_back = true,
+    };
+    msc_host_device_info_t info;
+    bench_t bench = { 0 };
+
+    msc_test_init();
+    const msc_host_driver_config_t msc_config = {
+        .create_backround_task = true,
+        .callback = msc_event_cb,
+        .stack_size = 4096,
+        .task_priority = 5,
+        .async_io = {
+            .queue_size = BENCH_MAX_DEPTH,
+            .stack_size = 4096,
+            .task_priority = 5,
+        },
+    };
+    ESP_OK_ASSERT( msc_host_install(&msc_config) );
+    msc_test_wait_and_install_device();
+    ESP_OK_ASSERT( msc_host_vfs_unregister(vfs_handle) );
+    ESP_OK_ASSERT( msc_host_get_device_info(device, &info) );
+    uint8_t *buf = heap_caps_malloc(BENCH_MAX_SIZE, MALLOC_CAP_DMA);
+    TEST_ASSERT_NOT_NULL(buf);
+    for (int i = 0; i < BENCH_MAX_SIZE; i++) {
+        buf[i] = (uint8_t)i;
+    }
+    bench.block_size = info.sector_size;
+    const uint64_t area_sectors = MIN(info.sector_count, BENCH_AREA_SIZE / info.sector_size);
+
+    printf("layer    config   op    acc     size        throughput          rate\n");
+    bench_sectors("raw", bench_raw_io, &bench, buf, area_sectors);
+    ESP_OK_ASSERT( msc_host_blockdev_open(device, 0, NULL, &bench.blockdev) );
+    bench_sectors("blockdev", bench_blockdev_io, &bench, buf, area_sectors);
+    ESP_OK_ASSERT( msc_host_blockdev_close(bench.blockdev) );
+    bench_async(&bench, buf, area_sectors);
+
+    // Raw writes destroyed the filesystem
+    const size_t file_size = MIN(BENCH_FILE_SIZE, info.sector_count * info.sector_size / 4);
+    ESP_OK_ASSERT( msc_host_vfs_register(device, "/usb", &mount_config, &vfs_handle) );
+    ESP_OK_ASSERT( msc_host_vfs_format(device, &mount_config, vfs_handle) );
+    bench_file("no cache", buf, file_size);
+    ESP_OK_ASSERT( msc_host_vfs_unregister(vfs_handle) );
+    ESP_OK_ASSERT( msc_host_vfs_register_with_cache(device, "/usb", &mount_config, &cache_config, &vfs_handle) );
+    bench_file("cache", buf, file_size);
+    unlink(BENCH_FILE_NAME);
+
+    free(buf);
+    msc_teardown();
+}
+
 /**
  * @brief USB MSC Device Mock
  *
@@ -0,0 +1,291 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <cstdint>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "uac_ring_priv.h"
+#include "uac_stage_priv.h"
+#include "test_uac_helpers.hpp"
+
+static std::vector<uint8_t> test_pattern(size_t len, uint8_t seed = 0)
+{
+    std::vector<uint8_t> data(len);
+    for (size_t i = 0; i < len; i++) {
+        data[i] = (uint8_t)(seed + i * 7);
+    }
+    return data;
+}
+
+SCENARIO("Ring buffer copy", "[ring]")
+{
+    uac_ring_t ring = {};
+    REQUIRE(uac_ring_init(&ring, 100) == ESP_OK);
+
+    GIVEN("Empty ring") {
+        REQUIRE(uac_ring_get_len(&ring) == 0);
+        REQUIRE(uac_ring_get_free(&ring) == 100);
+
+        WHEN("Pop from empty ring") {
+            uint8_t buf[10];
+            size_t read = 1;
+            REQUIRE(uac_ring_pop(&ring, buf, sizeof(buf), &read, 0) == ESP_FAIL);
+            REQUIRE(read == 0);
+        }
+
+        WHEN("Ring is filled completely") {
+            const std::vector<uint8_t> data = test_pattern(100);
+            REQUIRE(uac_ring_push(&ring, data.data(), data.size(), 0) == ESP_OK);
+            THEN("No more data fit and all data can be read back") {
+                REQUIRE(uac_ring_get_free(&ring) == 0);
+                REQUIRE(uac_ring_push(&ring, data.data(), 1, 0) == ESP_FAIL);
+                std::vector<uint8_t> out(100);
+                size_t read = 0;
+                REQUIRE(uac_ring_pop(&ring, out.data(), out.size(), &read, 0) == ESP_OK);
+                REQUIRE(read == 100);
+                REQUIRE(out == data);
+                REQUIRE(uac_ring_get_len(&ring) == 0);
+            }
+        }
+
+        WHEN("Data wrap around the end of the ring repeatedly") {
+            // 37 is coprime with 100, so the wrap happens at every position
+            for (int round = 0; round < 300; round++) {
+                const std::vector<uint8_t> data = test_pattern(37, round);
+                REQUIRE(uac_ring_push(&ring, data.data(), data.size(), 0) == ESP_OK);
+                std::vector<uint8_t> out(37);
+                size_t read = 0;
+                REQUIRE(uac_ring_pop(&ring, out.data(), out.size(), &read, 0) == ESP_OK);
+                REQUIRE(read == 37);
+                REQUIRE(out == data);
+            }
+            REQUIRE(uac_ring_get_len(&ring) == 0);
+        }
+
+        WHEN("Ring is flushed") {
+            const std::vector<uint8_t> data = test_pattern(60);
+            REQUIRE(uac_ring_push(&ring, data.data(), data.size(), 0) == ESP_OK);
+            uac_ring_flush(&ring);
+            REQUIRE(uac_ring_get_len(&ring) == 0);
+            REQUIRE(uac_ring_get_free(&ring) == 100);
+        }
+
+        WHEN("Ring is aborted") {
+            uac_ring_abort(&ring);
+            uint8_t buf[10];
+            size_t read = 0;
+            REQUIRE(uac_ring_pop(&ring, buf, sizeof(buf), &read, 10) == ESP_ERR_INVALID_STATE);
+        }
+    }
+
+    uac_ring_deinit(&ring);
+}
+
+SCENARIO("Ring buffer zero-copy access", "[ring]")
+{
+    uac_ring_t ring = {};
+    REQUIRE(uac_ring_init(&ring, 64) == ESP_OK);
+
+    GIVEN("Write position 48 bytes into the ring") {
+        const std::vector<uint8_t> head = test_pattern(48);
+        REQUIRE(uac_ring_push(&ring, head.data(), head.size(), 0) == ESP_OK);
+        uac_ring_read_release(&ring, head.size());
+
+        WHEN("Free space is acquired") {
+            uint8_t *span = nullptr;
+            const size_t len = uac_ring_write_acquire(&ring, &span);
+            THEN("Only the contiguous part up to the end of the ring is returned") {
+                REQUIRE(len == 16);
+                REQUIRE(span == ring.buf + 48);
+            }
+
+            AND_WHEN("Data are written through both spans") {
+                const std::vector<uint8_t> data = test_pattern(40, 3);
+                memcpy(span, data.data(), len);
+                uac_ring_write_commit(&ring, len);
+                REQUIRE(uac_ring_write_acquire(&ring, &span) == 48);
+                REQUIRE(span == ring.buf);
+                memcpy(span, data.data() + len, data.size() - len);
+                uac_ring_write_commit(&ring, data.size() - len);
+
+                THEN("Reader gets them back in two contiguous spans") {
+                    REQUIRE(uac_ring_get_len(&ring) == 40);
+                    const uint8_t *rd_span = nullptr;
+                    REQUIRE(uac_ring_read_acquire(&ring, (uint8_t **)&rd_span) == 16);
+                    REQUIRE(memcmp(rd_span, data.data(), 16) == 0);
+                    uac_ring_read_release(&ring, 16);
+                    REQUIRE(uac_ring_read_acquire(&ring, (uint8_t **)&rd_span) == 24);
+                    REQUIRE(memcmp(rd_span, data.data() + 16, 24) == 0);
+                    uac_ring_read_release(&ring, 24);
+                    REQUIRE(uac_ring_get_len(&ring) == 0);
+                }
+            }
+        }
+    }
+
+    uac_ring_deinit(&ring);
+}
+
+SCENARIO("PCM conversion", "[ring][pcm]")
+{
+    uac_pcm_conv_t conv;
+
+    GIVEN("16-bit stereo to 32-bit stereo") {
+        test_pcm_setup(&conv, 2, false, 2, 4, false, {0, 1});
+        const int16_t src[] = {0x1234, -2, INT16_MIN, INT16_MAX};
+        int32_t dst[4] = {};
+        uac_pcm_convert(&conv, (uint8_t *)dst, (const uint8_t *)src, 2);
+        THEN("Samples are scaled to the full range") {
+            REQUIRE(dst[0] == 0x12340000);
+            REQUIRE(dst[1] == -2 * 65536);
+            REQUIRE(dst[2] == INT32_MIN);
+            REQUIRE(dst[3] == (int32_t)0x7FFF0000);
+        }
+    }
+
+    GIVEN("24-bit packed to 16-bit") {
+        test_pcm_setup(&conv, 3, false, 1, 2, false, {0});
+        const uint8_t src[] = {0x56, 0x34, 0x12, 0x00, 0x00, 0x80};
+        int16_t dst[2] = {};
+        uac_pcm_convert(&conv, (uint8_t *)dst, src, 2);
+        THEN("Least significant bits are truncated") {
+            REQUIRE(dst[0] == 0x1234);
+            REQUIRE(dst[1] == INT16_MIN);
+        }
+    }
+
+    GIVEN("16-bit to float and back") {
+        const int16_t src[] = {INT16_MIN, -16384, 0, 16384};
+        float mid[4] = {};
+        test_pcm_setup(&conv, 2, false, 1, 4, true, {0});
+        uac_pcm_convert(&conv, (uint8_t *)mid, (const uint8_t *)src, 4);
+        THEN("Float samples are in [-1.0; 1.0)") {
+            REQUIRE(mid[0] == -1.0f);
+            REQUIRE(mid[1] == -0.5f);
+            REQUIRE(mid[2] == 0.0f);
+            REQUIRE(mid[3] == 0.5f);
+        }
+        AND_THEN("Converted back, the samples are unchanged") {
+            int16_t back[4] = {};
+            test_pcm_setup(&conv, 4, true, 1, 2, false, {0});
+            uac_pcm_convert(&conv, (uint8_t *)back, (const uint8_t *)mid, 4);
+            REQUIRE(memcmp(back, src, sizeof(src)) == 0);
+        }
+    }
+
+    GIVEN("Float out of range") {
+        test_pcm_setup(&conv, 4, true, 1, 2, false, {0});
+        const float src[] = {2.0f, -3.0f};
+        int16_t dst[2] = {};
+        uac_pcm_convert(&conv, (uint8_t *)dst, (const uint8_t *)src, 2);
+        THEN("Samples are clipped") {
+            REQUIRE(dst[0] == INT16_MAX);
+            REQUIRE(dst[1] == INT16_MIN);
+        }
+    }
+
+    GIVEN("Stereo to mono mix and channel swap") {
+        const int16_t src[] = {1000, 3000, -100, 100};
+        WHEN("Mixed to mono") {
+            test_pcm_setup(&conv, 2, false, 2, 2, false, {UAC_HOST_PCM_CHANNEL_MIX});
+            int16_t dst[2] = {};
+            uac_pcm_convert(&conv, (uint8_t *)dst, (const uint8_t *)src, 2);
+            REQUIRE(dst[0] == 2000);
+            REQUIRE(dst[1] == 0);
+        }
+        WHEN("Channels are swapped and duplicated") {
+            test_pcm_setup(&conv, 2, false, 2, 2, false, {1, 0, 0});
+            int16_t dst[6] = {};
+            uac_pcm_convert(&conv, (uint8_t *)dst, (const uint8_t *)src, 2);
+            const int16_t expected[] = {3000, 1000, 1000, 100, -100, -100};
+            REQUIRE(memcmp(dst, expected, sizeof(expected)) == 0);
+        }
+    }
+}
+
+SCENARIO("PCM conversion through the ring buffer", "[ring][pcm]")
+{
+    // 24-bit stereo frames of 6 bytes do not divide the ring size, so frames straddle the end of the ring
+    uac_ring_t ring = {};
+    REQUIRE(uac_ring_init(&ring, 64) == ESP_OK);
+    uac_pcm_conv_t conv_in;
+    uac_pcm_conv_t conv_out;
+    test_pcm_setup(&conv_in, 2, false, 2, 3, false, {0, 1});
+    test_pcm_setup(&conv_out, 3, false, 2, 2, false, {0, 1});
+
+    int16_t src[8];
+    for (int round = 0; round < 50; round++) {
+        for (int i = 0; i < 8; i++) {
+            src[i] = (int16_t)(round * 1000 - i * 333);
+        }
+        REQUIRE(uac_ring_get_free(&ring) >= 4 * conv_in.dst_frame_size);
+        uac_ring_convert_in(&ring, &conv_in, (const uint8_t *)src, 4);
+        uac_ring_write_commit(&ring, 4 * conv_in.dst_frame_size);
+        REQUIRE(uac_ring_get_len(&ring) == 24);
+
+        int16_t dst[8] = {};
+        uac_ring_convert_out(&ring, &conv_out, (uint8_t *)dst, 4);
+        uac_ring_read_release(&ring, 4 * conv_out.src_frame_size);
+        REQUIRE(memcmp(dst, src, sizeof(src)) == 0);
+    }
+
+    uac_ring_deinit(&ring);
+}
+
+static void test_stage_moved(void *arg)
+{
+    (*static_cast<int *>(arg))++;
+}
+
+SCENARIO("Staging moves data to the destination ring", "[ring][stage]")
+{
+    uac_ring_t dst = {};
+    uac_stage_t stage = {};
+    int moved_calls = 0;
+    REQUIRE(uac_ring_init_caps(&dst, UAC_STAGE_ROUND_UP(256), UAC_STAGE_ALIGN, MALLOC_CAP_DEFAULT) == ESP_OK);
+    REQUIRE(uac_stage_init(&stage, 4 * UAC_STAGE_ALIGN, &dst, test_stage_moved, &moved_calls) == ESP_OK);
+
+    WHEN("Blocks are staged repeatedly") {
+        // The blocks wrap around the end of both rings at changing positions
+        for (int round = 0; round < 20; round++) {
+            const std::vector<uint8_t> data = test_pattern(stage.block, round);
+            uac_ring_copy_in(&stage.ring, 0, data.data(), data.size());
+            uac_ring_write_commit(&stage.ring, data.size());
+            uac_stage_notify(&stage);
+            REQUIRE(uac_ring_wait(&dst, true, data.size(), pdMS_TO_TICKS(1000)) == ESP_OK);
+            std::vector<uint8_t> out(data.size());
+            size_t read = 0;
+            REQUIRE(uac_ring_pop(&dst, out.data(), out.size(), &read, 0) == ESP_OK);
+            REQUIRE(read == data.size());
+            REQUIRE(out == data);
+            REQUIRE(uac_ring_get_len(&stage.ring) == 0);
+        }
+        THEN("The mover reports each move") {
+            // Stopping the mover waits for its last callback
+            uac_stage_deinit(&stage);
+            REQUIRE(moved_calls == 20);
+        }
+    }
+
+    WHEN("Less than a block is staged and flushed") {
+        const std::vector<uint8_t> data = test_pattern(stage.block - 1);
+        uac_ring_copy_in(&stage.ring, 0, data.data(), data.size());
+        uac_ring_write_commit(&stage.ring, data.size());
+        uac_stage_notify(&stage);
+        THEN("The data stay staged until the flush drops them") {
+            vTaskDelay(pdMS_TO_TICKS(10));
+            REQUIRE(uac_ring_get_len(&dst) == 0);
+            uac_stage_flush(&stage);
+            REQUIRE(uac_ring_get_len(&stage.ring) == 0);
+            REQUIRE(moved_calls == 0);
+        }
+    }
+
+    uac_stage_deinit(&stage);
+    REQUIRE(stage.task == NULL);
+    uac_ring_deinit(&dst);
+}
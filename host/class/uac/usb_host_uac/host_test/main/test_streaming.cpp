@@ -0,0 +1,309 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <cstdint>
+#include <numeric>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "usb/usb_types_stack.h"
+#include "usb/uac_host.h"
+#include "uac_types_priv.h"
+#include "test_uac_helpers.hpp"
+
+static std::vector<uint8_t> test_ring_read_all(uac_ring_t *ring)
+{
+    std::vector<uint8_t> data(uac_ring_get_len(ring));
+    uac_ring_copy_out(ring, data.data(), data.size());
+    uac_ring_read_release(ring, data.size());
+    return data;
+}
+
+static std::vector<uint8_t> test_pattern(size_t len)
+{
+    std::vector<uint8_t> data(len);
+    for (size_t i = 0; i < len; i++) {
+        data[i] = (uint8_t)(i * 13 + 1);
+    }
+    return data;
+}
+
+static std::vector<uac_host_rx_span_t> s_spans;
+
+static void test_rx_data_cb(uac_host_device_handle_t uac_device_handle, const uac_host_rx_span_t *spans, size_t num_spans, void *arg)
+{
+    s_spans.assign(spans, spans + num_spans);
+}
+
+SCENARIO("RX stream to the ring buffer", "[streaming][rx]")
+{
+    usb_host_transfer_submit_IgnoreAndReturn(ESP_OK); // Transfers are re-submitted after each callback
+
+    GIVEN("48 kHz 16-bit stereo stream with 4 packets per transfer") {
+        test_stream s(1024, 48000, 4, 1, 4, 200);
+        usb_transfer_t *xfer = s.xfers[0];
+
+        WHEN("Packets of different length are received") {
+            const std::vector<size_t> lengths = {192, 0, 196, 188};
+            const std::vector<uint8_t> data = test_pattern(576);
+            test_xfer_fill_rx(xfer, lengths, data.data());
+            stream_rx_xfer_done(xfer);
+
+            THEN("Data of all packets are in the ring one after another") {
+                REQUIRE(test_ring_read_all(&s.iface.ringbuf) == data);
+                REQUIRE(s.iface.stats.rx_bad_packets == 0);
+                REQUIRE(s.iface.stats.rx_overflow_count == 0);
+            }
+            AND_THEN("Fill level and timing are counted") {
+                REQUIRE(s.iface.stats.fill_hist[576 * UAC_HOST_STATS_FILL_BINS / 1024] == 1);
+                REQUIRE(s.iface.timing.packet_count == 4);
+                REQUIRE(s.iface.timing.sample_count == 576 / 4);
+            }
+        }
+
+        WHEN("One packet has error status") {
+            const std::vector<size_t> lengths = {192, 192, 192, 192};
+            const std::vector<uint8_t> data = test_pattern(768);
+            test_xfer_fill_rx(xfer, lengths, data.data(), 1);
+            stream_rx_xfer_done(xfer);
+
+            THEN("The packet is dropped and counted") {
+                std::vector<uint8_t> expected(data.begin(), data.begin() + 192);
+                expected.insert(expected.end(), data.begin() + 384, data.end());
+                REQUIRE(test_ring_read_all(&s.iface.ringbuf) == expected);
+                REQUIRE(s.iface.stats.rx_bad_packets == 1);
+            }
+        }
+
+        WHEN("Received data do not fit in the ring") {
+            const std::vector<size_t> lengths = {192, 192, 192, 192};
+            const std::vector<uint8_t> data = test_pattern(768);
+            test_xfer_fill_rx(xfer, lengths, data.data());
+            stream_rx_xfer_done(xfer);
+            test_xfer_fill_rx(xfer, lengths, data.data());
+            stream_rx_xfer_done(xfer);
+
+            THEN("The end of the data is dropped in whole samples") {
+                REQUIRE(s.iface.stats.rx_overflow_count == 1);
+                REQUIRE(s.iface.stats.rx_overflow_bytes == 768 - 256);
+                REQUIRE(uac_ring_get_len(&s.iface.ringbuf) == 1024);
+                REQUIRE(s.iface.stats.fill_hist[UAC_HOST_STATS_FILL_BINS - 1] == 1);
+            }
+        }
+
+        WHEN("The transfer fails") {
+            xfer->status = USB_TRANSFER_STATUS_ERROR;
+            stream_rx_xfer_done(xfer);
+            THEN("Error is counted and no data are written") {
+                REQUIRE(s.iface.stats.xfer_errors == 1);
+                REQUIRE(uac_ring_get_len(&s.iface.ringbuf) == 0);
+            }
+        }
+
+        WHEN("The interface is suspended") {
+            s.iface.state = UAC_INTERFACE_STATE_SUSPENDING;
+            const std::vector<size_t> lengths = {192, 192, 192, 192};
+            const std::vector<uint8_t> data = test_pattern(768);
+            test_xfer_fill_rx(xfer, lengths, data.data());
+            stream_rx_xfer_done(xfer);
+            THEN("The transfer is treated as cancelled") {
+                REQUIRE(uac_ring_get_len(&s.iface.ringbuf) == 0);
+                REQUIRE(s.iface.stats.xfer_errors == 0);
+            }
+        }
+    }
+
+    GIVEN("RX stream with PCM conversion from 16-bit stereo to 32-bit mono") {
+        test_stream s(1024, 48000, 4, 1, 2, 192);
+        test_pcm_setup(&s.iface.pcm, 2, false, 2, 4, false, {UAC_HOST_PCM_CHANNEL_MIX});
+        usb_transfer_t *xfer = s.xfers[0];
+
+        const int16_t samples[] = {100, 300, -1000, -2000};
+        test_xfer_fill_rx(xfer, {4, 4}, (const uint8_t *)samples);
+        stream_rx_xfer_done(xfer);
+
+        THEN("The ring holds converted frames") {
+            const std::vector<uint8_t> data = test_ring_read_all(&s.iface.ringbuf);
+            REQUIRE(data.size() == 2 * sizeof(int32_t));
+            const int32_t *out = (const int32_t *)data.data();
+            REQUIRE(out[0] == 200 * 65536);
+            REQUIRE(out[1] == -1500 * 65536);
+        }
+    }
+}
+
+SCENARIO("RX stream to the data callback", "[streaming][rx]")
+{
+    usb_host_transfer_submit_IgnoreAndReturn(ESP_OK);
+
+    test_stream s(0, 48000, 4, 1, 4, 200);
+    std::vector<uac_host_rx_span_t> spans(4);
+    s.iface.rx_data_cb = test_rx_data_cb;
+    s.iface.rx_spans = spans.data();
+    usb_transfer_t *xfer = s.xfers[0];
+
+    const std::vector<uint8_t> data = test_pattern(580);
+    test_xfer_fill_rx(xfer, {192, 0, 196, 192}, data.data(), 3);
+    s_spans.clear();
+    stream_rx_xfer_done(xfer);
+
+    THEN("Received packets are passed in place, empty and bad packets are skipped") {
+        REQUIRE(s_spans.size() == 2);
+        REQUIRE(s_spans[0].data == xfer->data_buffer);
+        REQUIRE(s_spans[0].len == 192);
+        REQUIRE(s_spans[1].data == xfer->data_buffer + 400);
+        REQUIRE(s_spans[1].len == 196);
+        REQUIRE(memcmp(s_spans[1].data, data.data() + 192, 196) == 0);
+        REQUIRE(s.iface.stats.rx_bad_packets == 1);
+    }
+}
+
+SCENARIO("TX stream from the ring buffer", "[streaming][tx]")
+{
+    usb_host_transfer_submit_IgnoreAndReturn(ESP_OK);
+
+    GIVEN("44.1 kHz 16-bit stereo stream with 10 packets per transfer") {
+        test_stream s(4096, 44100, 4, 2, 10, 192, true);
+        const std::vector<uint8_t> data = test_pattern(2000);
+        REQUIRE(uac_ring_push(&s.iface.ringbuf, data.data(), data.size(), 0) == ESP_OK);
+        usb_transfer_t *xfer = s.claim_tx(0);
+
+        WHEN("The transfer completes") {
+            stream_tx_xfer_done(xfer);
+
+            THEN("It is refilled with whole samples due in each frame") {
+                for (int i = 0; i < 9; i++) {
+                    REQUIRE(xfer->isoc_packet_desc[i].num_bytes == 44 * 4);
+                }
+                REQUIRE(xfer->isoc_packet_desc[9].num_bytes == 45 * 4);
+                REQUIRE(xfer->num_bytes == 441 * 4);
+                REQUIRE(memcmp(xfer->data_buffer, data.data(), 441 * 4) == 0);
+                REQUIRE(uac_ring_get_len(&s.iface.ringbuf) == 2000 - 441 * 4);
+                REQUIRE(s.iface.stats.tx_underrun_count == 0);
+                REQUIRE(s.xfer_list[0] == xfer);
+            }
+
+            AND_WHEN("There are not enough data for the next transfer") {
+                xfer->isoc_packet_desc[2].status = USB_TRANSFER_STATUS_ERROR;
+                stream_tx_xfer_done(xfer);
+
+                THEN("Underrun is counted and the transfer returns to the free list") {
+                    REQUIRE(s.iface.stats.tx_underrun_count == 1);
+                    REQUIRE(s.iface.stats.tx_bad_packets == 1);
+                    REQUIRE(s.xfer_list[0] == nullptr);
+                    REQUIRE(s.free_xfer_list[0] == xfer);
+                    REQUIRE(s.iface.free_xfer_mask == 0x3);
+                    REQUIRE(s.iface.timing.packet_count == 20);
+                }
+            }
+        }
+
+        WHEN("There are not enough data with underrun concealment by repeat") {
+            s.iface.flags |= FLAG_STREAM_TX_CONCEAL_REPEAT;
+            stream_tx_xfer_done(xfer);
+            stream_tx_xfer_done(xfer);
+
+            THEN("The available frames are sent and the last frame is repeated for the rest") {
+                const size_t sent = (2000 - 441 * 4) / 4;
+                REQUIRE(xfer->num_bytes == 441 * 4);
+                REQUIRE(memcmp(xfer->data_buffer, data.data() + 441 * 4, sent * 4) == 0);
+                for (size_t i = sent; i < 441; i++) {
+                    REQUIRE(memcmp(xfer->data_buffer + i * 4, data.data() + 441 * 4 + (sent - 1) * 4, 4) == 0);
+                }
+                REQUIRE(uac_ring_get_len(&s.iface.ringbuf) == 0);
+                REQUIRE(s.iface.stats.tx_underrun_count == 0);
+                REQUIRE(s.iface.stats.tx_concealed_count == 1);
+                REQUIRE(s.iface.stats.tx_concealed_frames == 441 - sent);
+                REQUIRE(s.xfer_list[0] == xfer);
+            }
+
+            AND_WHEN("The producer sends data again") {
+                REQUIRE(uac_ring_push(&s.iface.ringbuf, data.data(), data.size(), 0) == ESP_OK);
+                stream_tx_xfer_done(xfer);
+                THEN("The stream continues with the data without restart") {
+                    REQUIRE(memcmp(xfer->data_buffer, data.data(), 441 * 4) == 0);
+                    REQUIRE(s.iface.stats.tx_concealed_count == 1);
+                    REQUIRE(s.xfer_list[0] == xfer);
+                }
+            }
+        }
+
+        WHEN("The ring is empty with underrun concealment by silence") {
+            s.iface.flags |= FLAG_STREAM_TX_CONCEAL_SILENCE;
+            uac_ring_flush(&s.iface.ringbuf);
+            memset(xfer->data_buffer, 0xAA, xfer->data_buffer_size);
+            stream_tx_xfer_done(xfer);
+            THEN("Silence is sent") {
+                REQUIRE(xfer->num_bytes == 441 * 4);
+                const std::vector<uint8_t> silence(441 * 4, 0);
+                REQUIRE(memcmp(xfer->data_buffer, silence.data(), silence.size()) == 0);
+                REQUIRE(s.iface.stats.tx_concealed_frames == 441);
+                REQUIRE(s.xfer_list[0] == xfer);
+            }
+        }
+
+        WHEN("The stream is the speaker of a duplex pair") {
+            uac_duplex_t duplex {};
+            REQUIRE(uac_ring_init(&duplex.ref_ring, 441 * 4 + 10 * 4) == ESP_OK);
+            s.iface.duplex = &duplex;
+            // the transfer was submitted with the first samples
+            memcpy(xfer->data_buffer, data.data(), 441 * 4);
+            xfer->num_bytes = 441 * 4;
+            stream_tx_xfer_done(xfer);
+
+            THEN("Samples sent before the reference buffer is ready are counted as dropped") {
+                REQUIRE(uac_ring_get_len(&duplex.ref_ring) == 0);
+                REQUIRE(duplex.ref_dropped_frames == 441);
+            }
+
+            AND_WHEN("The reference buffer is ready") {
+                duplex.ref_ready = true;
+                duplex.ref_dropped_frames = 0;
+                s.iface.flags |= FLAG_STREAM_TX_CONCEAL_SILENCE;
+                stream_tx_xfer_done(xfer);
+                stream_tx_xfer_done(xfer);
+
+                THEN("The sent samples are recorded and those that do not fit are dropped") {
+                    const std::vector<uint8_t> ref = test_ring_read_all(&duplex.ref_ring);
+                    REQUIRE(ref.size() == 451 * 4);
+                    REQUIRE(memcmp(ref.data(), data.data(), ref.size()) == 0);
+                    REQUIRE(duplex.ref_dropped_frames == 441 - 10);
+                }
+            }
+            s.iface.duplex = nullptr;
+            uac_ring_deinit(&duplex.ref_ring);
+        }
+
+        WHEN("The transfer fails") {
+            xfer->status = USB_TRANSFER_STATUS_ERROR;
+            stream_tx_xfer_done(xfer);
+            THEN("Error is counted and the transfer returns to the free list") {
+                REQUIRE(s.iface.stats.xfer_errors == 1);
+                REQUIRE(s.free_xfer_list[0] == xfer);
+                REQUIRE(s.iface.free_xfer_mask == 0x3);
+            }
+        }
+    }
+
+    GIVEN("TX stream with PCM conversion from float mono to 16-bit stereo") {
+        test_stream s(1024, 8000, 4, 1, 1, 64, true);
+        test_pcm_setup(&s.iface.pcm, 4, true, 1, 2, false, {0, 0});
+        const float samples[8] = {0.5f, -0.5f, 0.25f, -0.25f, 0.0f, 0.125f, -1.0f, 0.75f};
+        REQUIRE(uac_ring_push(&s.iface.ringbuf, (const uint8_t *)samples, sizeof(samples), 0) == ESP_OK);
+        usb_transfer_t *xfer = s.claim_tx(0);
+        stream_tx_xfer_done(xfer);
+
+        THEN("The transfer holds the converted samples of one frame") {
+            REQUIRE(xfer->num_bytes == 8 * 4);
+            const int16_t *out = (const int16_t *)xfer->data_buffer;
+            for (int i = 0; i < 8; i++) {
+                REQUIRE(out[2 * i] == (int16_t)(samples[i] * 32768));
+                REQUIRE(out[2 * i + 1] == out[2 * i]);
+            }
+            REQUIRE(uac_ring_get_len(&s.iface.ringbuf) == 0);
+        }
+    }
+}
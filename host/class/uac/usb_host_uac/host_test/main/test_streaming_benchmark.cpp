@@ -0,0 +1,158 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <chrono>
+#include <functional>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "usb/usb_types_stack.h"
+#include "usb/uac_host.h"
+#include "uac_types_priv.h"
+#include "test_uac_helpers.hpp"
+
+/**
+ * Transfer callback benchmark
+ *
+ * Synthetic completed ISOC transfers are fed into stream_rx_xfer_done() or stream_tx_xfer_done(),
+ * while the application side of the ring buffer is emulated in the same loop.
+ * So only the hot path of the callbacks is measured: packet compaction, ring buffer copy, sample conversion and TX pacing.
+ */
+
+namespace {
+
+constexpr int benchmark_iterations = 20000;
+
+void print_result(const char *name, size_t bytes_per_urb, double seconds)
+{
+    printf("%s: %.1f MB/s, %.1f ns/URB\n",
+           name,
+           (double)bytes_per_urb * benchmark_iterations / seconds / 1e6,
+           seconds * 1e9 / benchmark_iterations);
+}
+
+/**
+ * @brief Run one URB completion benchmark_iterations times
+ *
+ * @param urb  Feeds one completed transfer and emulates the application side
+ * @return Time spent in seconds
+ */
+double run(const std::function<void()> &urb)
+{
+    usb_host_transfer_submit_IgnoreAndReturn(ESP_OK); // Transfers are re-submitted after each callback
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < benchmark_iterations; i++) {
+        urb();
+    }
+    const auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(stop - start).count();
+}
+
+/**
+ * @brief RX transfer of full packets, the application reads the ring buffer after each transfer
+ */
+void benchmark_rx(const char *name, test_stream &s, size_t packet_size, size_t app_frame_size)
+{
+    usb_transfer_t *xfer = s.xfers[0];
+    const std::vector<size_t> lengths(s.iface.packet_num, packet_size);
+    const std::vector<uint8_t> data(s.iface.packet_num * packet_size, 0x55);
+    std::vector<uint8_t> app(s.iface.ringbuf.size);
+    const size_t app_len = s.iface.packet_num * packet_size / s.iface.frame_size * app_frame_size;
+
+    const double seconds = run([&]() {
+        test_xfer_fill_rx(xfer, lengths, data.data());
+        stream_rx_xfer_done(xfer);
+        size_t read = 0;
+        uac_ring_pop(&s.iface.ringbuf, app.data(), app_len, &read, 0);
+        assert(read == app_len);
+    });
+    REQUIRE(s.iface.stats.rx_overflow_count == 0);
+    print_result(name, data.size(), seconds);
+}
+
+/**
+ * @brief TX transfer completions, the application writes the ring buffer before each transfer
+ */
+void benchmark_tx(const char *name, test_stream &s, size_t app_frame_size)
+{
+    usb_transfer_t *xfer = s.claim_tx(0);
+    const size_t frames = (size_t)s.iface.packet_num * s.alt.cur_sampling_freq / s.iface.packet_rate;
+    const std::vector<uint8_t> app(frames * app_frame_size, 0x55);
+
+    const double seconds = run([&]() {
+        uac_ring_push(&s.iface.ringbuf, app.data(), app.size(), 0);
+        xfer->status = USB_TRANSFER_STATUS_COMPLETED;
+        stream_tx_xfer_done(xfer);
+    });
+    REQUIRE(s.iface.stats.tx_underrun_count == 0);
+    print_result(name, frames * s.iface.frame_size, seconds);
+}
+
+size_t s_rx_bytes;
+
+void benchmark_rx_data_cb(uac_host_device_handle_t uac_device_handle, const uac_host_rx_span_t *spans, size_t num_spans, void *arg)
+{
+    for (size_t i = 0; i < num_spans; i++) {
+        s_rx_bytes += spans[i].len;
+    }
+}
+
+} // namespace
+
+TEST_CASE("Streaming throughput benchmark", "[.][benchmark]")
+{
+    SECTION("RX, ring buffer, 48 kHz 16-bit stereo, 8 packets") {
+        test_stream s(8192, 48000, 4, 1, 8, 196);
+        benchmark_rx("RX ring 48k/16/2", s, 192, 4);
+    }
+
+    SECTION("RX, ring buffer, 192 kHz 24-bit 8 channels, high-speed 8 packets") {
+        test_stream s(65536, 192000, 24, 1, 8, 24 * 25);
+        s.iface.packet_rate = s.alt.packet_rate = 8000;
+        benchmark_rx("RX ring 192k/24/8 HS", s, 24 * 24, 24);
+    }
+
+    SECTION("RX, PCM conversion 24-bit stereo to float") {
+        test_stream s(8192, 48000, 6, 1, 8, 294);
+        test_pcm_setup(&s.iface.pcm, 3, false, 2, 4, true, {0, 1});
+        benchmark_rx("RX convert S24_3 to float", s, 288, 8);
+    }
+
+    SECTION("RX, PCM conversion 16-bit stereo to mono mix") {
+        test_stream s(8192, 48000, 4, 1, 8, 196);
+        test_pcm_setup(&s.iface.pcm, 2, false, 2, 2, false, {UAC_HOST_PCM_CHANNEL_MIX});
+        benchmark_rx("RX convert stereo to mono", s, 192, 2);
+    }
+
+    SECTION("RX, zero-copy data callback") {
+        test_stream s(0, 48000, 4, 1, 8, 196);
+        std::vector<uac_host_rx_span_t> spans(8);
+        s.iface.rx_data_cb = benchmark_rx_data_cb;
+        s.iface.rx_spans = spans.data();
+        usb_transfer_t *xfer = s.xfers[0];
+        const std::vector<size_t> lengths(8, 192);
+        const std::vector<uint8_t> data(8 * 192, 0x55);
+        s_rx_bytes = 0;
+        const double seconds = run([&]() {
+            test_xfer_fill_rx(xfer, lengths, data.data());
+            stream_rx_xfer_done(xfer);
+        });
+        REQUIRE(s_rx_bytes == data.size() * benchmark_iterations);
+        print_result("RX zero-copy callback", data.size(), seconds);
+    }
+
+    SECTION("TX, ring buffer, 44.1 kHz 16-bit stereo, 10 packets") {
+        test_stream s(8192, 44100, 4, 1, 10, 180, true);
+        benchmark_tx("TX ring 44.1k/16/2", s, 4);
+    }
+
+    SECTION("TX, PCM conversion float to 16-bit stereo") {
+        test_stream s(8192, 48000, 4, 1, 8, 192, true);
+        test_pcm_setup(&s.iface.pcm, 4, true, 2, 2, false, {0, 1});
+        benchmark_tx("TX convert float to S16", s, 8);
+    }
+}
@@ -0,0 +1,199 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include "usb/usb_types_stack.h"
+#include "usb/uac_host.h"
+#include "uac_types_priv.h"
+
+extern "C" {
+#include "Mockusb_host.h"
+}
+
+/**
+ * @brief Allocate ISOC transfer with packets of equal requested size
+ *
+ * @param packet_num  Number of ISOC packets
+ * @param packet_size Requested size of each packet
+ * @param context     Transfer context, the interface
+ * @param callback    Transfer callback
+ * @return Transfer, free it with test_xfer_free()
+ */
+inline usb_transfer_t *test_xfer_alloc(int packet_num, size_t packet_size, void *context, usb_transfer_cb_t callback)
+{
+    const size_t data_size = packet_num * packet_size;
+    uint8_t *data_buffer = new uint8_t[data_size]();
+    const size_t allocation_size = sizeof(usb_transfer_t) + packet_num * sizeof(usb_isoc_packet_desc_t);
+    usb_transfer_t *xfer = static_cast<usb_transfer_t *>(operator new (allocation_size));
+    new (xfer) usb_transfer_t{
+        .data_buffer = data_buffer,
+        .data_buffer_size = data_size,
+        .num_bytes = static_cast<int>(data_size),
+        .actual_num_bytes = 0,
+        .flags = 0,
+        .device_handle = nullptr,
+        .bEndpointAddress = 0,
+        .status = USB_TRANSFER_STATUS_COMPLETED,
+        .timeout_ms = 0,
+        .callback = callback,
+        .context = context,
+        .num_isoc_packets = packet_num,
+    };
+    for (int i = 0; i < packet_num; i++) {
+        xfer->isoc_packet_desc[i].num_bytes = packet_size;
+        xfer->isoc_packet_desc[i].actual_num_bytes = 0;
+        xfer->isoc_packet_desc[i].status = USB_TRANSFER_STATUS_COMPLETED;
+    }
+    return xfer;
+}
+
+inline void test_xfer_free(usb_transfer_t *xfer)
+{
+    delete[] xfer->data_buffer;
+    operator delete (xfer);
+}
+
+/**
+ * @brief Fill completed RX transfer as the USB Host Library does
+ *
+ * Packet i receives lengths[i] bytes at its offset in the transfer buffer, taken from data.
+ *
+ * @param xfer     RX transfer
+ * @param lengths  Received bytes of each packet
+ * @param data     Received data of all packets, one after another
+ * @param bad      Index of a packet with error status, -1 for none
+ */
+inline void test_xfer_fill_rx(usb_transfer_t *xfer, const std::vector<size_t> &lengths, const uint8_t *data, int bad = -1)
+{
+    assert(lengths.size() == (size_t)xfer->num_isoc_packets);
+    size_t offset = 0;
+    size_t total = 0;
+    xfer->status = USB_TRANSFER_STATUS_COMPLETED;
+    for (int i = 0; i < xfer->num_isoc_packets; i++) {
+        usb_isoc_packet_desc_t *packet = &xfer->isoc_packet_desc[i];
+        assert(lengths[i] <= (size_t)packet->num_bytes);
+        memcpy(xfer->data_buffer + offset, data, lengths[i]);
+        data += lengths[i];
+        offset += packet->num_bytes;
+        packet->actual_num_bytes = lengths[i];
+        packet->status = (i == bad) ? USB_TRANSFER_STATUS_ERROR : USB_TRANSFER_STATUS_COMPLETED;
+        total += lengths[i];
+    }
+    xfer->actual_num_bytes = total;
+}
+
+/**
+ * @brief Active stream interface fed with synthetic transfers, without any device
+ *
+ * Only the members used by the transfer callbacks are set, the rest stays zero.
+ */
+struct test_stream {
+    uac_iface_t iface {};
+    uac_iface_alt_t alt {};
+    std::vector<usb_transfer_t *> xfers;
+    std::vector<usb_transfer_t *> xfer_list;
+    std::vector<usb_transfer_t *> free_xfer_list;
+
+    /**
+     * @param ring_size   Size of the ring buffer, 0 for none
+     * @param freq        Sampling frequency
+     * @param frame_size  Bytes of one sample of all channels on the bus
+     * @param xfer_num    Number of transfers
+     * @param packet_num  Packets per transfer
+     * @param packet_size Requested size of RX packets, maximum size of TX packets
+     * @param tx          TX stream, otherwise RX
+     */
+    test_stream(uint32_t ring_size, uint32_t freq, uint32_t frame_size, int xfer_num, int packet_num, uint32_t packet_size, bool tx = false)
+        : xfer_list(xfer_num), free_xfer_list(xfer_num)
+    {
+        if (ring_size && uac_ring_init(&iface.ringbuf, ring_size) != ESP_OK) {
+            throw std::bad_alloc();
+        }
+        alt.cur_sampling_freq = freq;
+        alt.ep_mps = packet_size;
+        alt.packet_rate = 1000;
+        iface.iface_alt = &alt;
+        iface.cur_alt = 0;
+        iface.state = UAC_INTERFACE_STATE_ACTIVE;
+        iface.frame_size = frame_size;
+        iface.packet_num = packet_num;
+        iface.packet_size = packet_size;
+        iface.packet_rate = alt.packet_rate;
+        iface.nominal_rate = ((uint64_t)freq << 16) / alt.packet_rate;
+        iface.ringbuf_threshold = ring_size;
+        iface.xfer_num = xfer_num;
+        iface.xfer_list = xfer_list.data();
+        iface.free_xfer_list = free_xfer_list.data();
+        for (int i = 0; i < xfer_num; i++) {
+            xfers.push_back(test_xfer_alloc(packet_num, packet_size, &iface, tx ? stream_tx_xfer_done : stream_rx_xfer_done));
+            // TX transfers start in the free list, as after stream start
+            if (tx) {
+                free_xfer_list[i] = xfers[i];
+                iface.free_xfer_mask |= 1UL << i;
+            } else {
+                xfer_list[i] = xfers[i];
+            }
+        }
+    }
+
+    ~test_stream()
+    {
+        for (usb_transfer_t *xfer : xfers) {
+            test_xfer_free(xfer);
+        }
+        if (iface.ringbuf.buf) {
+            uac_ring_deinit(&iface.ringbuf);
+        }
+    }
+
+    /**
+     * @brief Move free TX transfer to the submitted list, as the writer does
+     */
+    usb_transfer_t *claim_tx(int i)
+    {
+        assert(free_xfer_list[i]);
+        xfer_list[i] = free_xfer_list[i];
+        free_xfer_list[i] = nullptr;
+        iface.free_xfer_mask &= ~(1UL << i);
+        return xfer_list[i];
+    }
+};
+
+/**
+ * @brief PCM conversion setup, as uac_host_device_start() sets it for the given formats
+ *
+ * @param conv         Conversion to set up
+ * @param src_size     Bytes per source sample, 4 with src_float
+ * @param src_float    Source samples are float
+ * @param src_channels Number of source channels
+ * @param dst_size     Bytes per destination sample, 4 with dst_float
+ * @param dst_float    Destination samples are float
+ * @param map          Source channel of each destination channel or UAC_HOST_PCM_CHANNEL_MIX
+ */
+inline void test_pcm_setup(uac_pcm_conv_t *conv, uint8_t src_size, bool src_float, uint8_t src_channels,
+                           uint8_t dst_size, bool dst_float, const std::vector<uint8_t> &map)
+{
+    assert(map.size() <= UAC_HOST_PCM_CHANNELS_MAX);
+    memset(conv, 0, sizeof(uac_pcm_conv_t));
+    conv->enabled = true;
+    conv->src_size = src_size;
+    conv->src_float = src_float;
+    conv->src_channels = src_channels;
+    conv->dst_size = dst_size;
+    conv->dst_float = dst_float;
+    conv->dst_channels = map.size();
+    std::copy(map.begin(), map.end(), conv->map);
+    conv->src_frame_size = src_size * src_channels;
+    conv->dst_frame_size = dst_size * map.size();
+}
@@ -490,6 +490,24 @@ typedef struct {
     uint8_t tSamFreq[3 * UAC_FREQ_NUM_MAX];
 } __attribute__((packed)) uac_as_type_I_format_desc_t;
 
+/**
+ * @brief Standard AS Isochronous Audio Data or Synch Endpoint Descriptor
+ *
+ * Standard endpoint descriptor extended by bRefresh and bSynchAddress
+ *
+ * @see Table 4-20 and Table 4-22 of audio10.pdf
+ */
+typedef struct {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint8_t bEndpointAddress;
+    uint8_t bmAttributes;
+    uint16_t wMaxPacketSize;
+    uint8_t bInterval;
+    uint8_t bRefresh;
+    uint8_t bSynchAddress;
+} __attribute__((packed)) uac_as_std_ep_desc_t;
+
 /**
  * @brief Audio Class-Specific AS Isochronous Audio Data Endpoint Descriptor
  *
@@ -504,6 +522,265 @@ typedef struct {
     uint16_t wLockDelay;
 } __attribute__((packed)) uac_as_cs_ep_desc_t;
 
+/********************************* Refer audio20.pdf (UAC 2.0) ***************************************/
+
+#define UAC_VERSION_1                                 0x0100      // bcdADC of UAC 1.0 devices
+#define UAC_VERSION_2                                 0x0200      // bcdADC of UAC 2.0 devices
+
+/**
+ * @brief Audio Class-Specific AC Interface Descriptor Subtypes added or changed by UAC 2.0
+ *
+ * Header, terminals, mixer, selector and feature unit keep the subtypes of UAC 1.0
+ *
+ * @see Table A-9 of audio20.pdf
+ */
+typedef enum {
+    UAC2_AC_EFFECT_UNIT                               = 0x07,
+    UAC2_AC_PROCESSING_UNIT                           = 0x08,
+    UAC2_AC_EXTENSION_UNIT                            = 0x09,
+    UAC2_AC_CLOCK_SOURCE                              = 0x0A,
+    UAC2_AC_CLOCK_SELECTOR                            = 0x0B,
+    UAC2_AC_CLOCK_MULTIPLIER                          = 0x0C,
+    UAC2_AC_SAMPLE_RATE_CONVERTER                     = 0x0D
+} uac2_ac_descriptor_subtype_t;
+
+/**
+ * @brief Audio Class-Specific Request Codes of UAC 2.0, the direction is given by bmRequestType
+ *
+ * @see Table A-14 of audio20.pdf
+ */
+typedef enum {
+    UAC2_REQUEST_UNDEFINED                            = 0x00,
+    UAC2_CUR                                          = 0x01,
+    UAC2_RANGE                                        = 0x02,
+    UAC2_MEM                                          = 0x03
+} uac2_request_code_t;
+
+/**
+ * @brief Clock Source Control Selectors
+ *
+ * @see Table A-17 of audio20.pdf
+ */
+typedef enum {
+    UAC2_CS_CONTROL_UNDEFINED                         = 0x00,
+    UAC2_CS_SAM_FREQ_CONTROL                          = 0x01,
+    UAC2_CS_CLOCK_VALID_CONTROL                       = 0x02
+} uac2_cs_control_selector_t;
+
+/**
+ * @brief Clock Selector Control Selectors
+ *
+ * @see Table A-18 of audio20.pdf
+ */
+typedef enum {
+    UAC2_CX_CONTROL_UNDEFINED                         = 0x00,
+    UAC2_CX_CLOCK_SELECTOR_CONTROL                    = 0x01
+} uac2_cx_control_selector_t;
+
+/**
+ * @brief Access of a control in the bmControls bitmaps, 2 bits per control
+ *
+ * @see Section 4.1 of audio20.pdf
+ */
+typedef enum {
+    UAC2_CONTROL_NONE                                 = 0x00,
+    UAC2_CONTROL_READ_ONLY                            = 0x01,
+    UAC2_CONTROL_PROGRAMMABLE                         = 0x03
+} uac2_control_access_t;
+
+#define UAC2_CONTROL_ACCESS(bm, idx)                  (((bm) >> ((idx) * 2)) & 0x03)   // access of the control at index idx
+
+/**
+ * @brief Index of the controls in the bmControls bitmaps
+ *
+ * @see Table 4-6, Table 4-13 of audio20.pdf
+ */
+typedef enum {
+    UAC2_CS_CONTROL_IDX_SAM_FREQ                      = 0,
+    UAC2_CS_CONTROL_IDX_CLOCK_VALID                   = 1,
+    UAC2_CX_CONTROL_IDX_CLOCK_SELECTOR                = 0,
+    UAC2_FU_CONTROL_IDX_MUTE                          = 0,
+    UAC2_FU_CONTROL_IDX_VOLUME                        = 1
+} uac2_control_idx_t;
+
+/**
+ * @brief Clock Source Types in bmAttributes of the Clock Source Descriptor
+ *
+ * @see Table 4-6 of audio20.pdf
+ */
+typedef enum {
+    UAC2_CLOCK_TYPE_EXTERNAL                          = 0x00,
+    UAC2_CLOCK_TYPE_INTERNAL_FIXED                    = 0x01,
+    UAC2_CLOCK_TYPE_INTERNAL_VARIABLE                 = 0x02,
+    UAC2_CLOCK_TYPE_INTERNAL_PROGRAMMABLE             = 0x03
+} uac2_clock_type_t;
+
+/**
+ * @brief Audio Class-Specific AC Interface Header Descriptor of UAC 2.0
+ *
+ * @see Table 4-5 of audio20.pdf
+ */
+typedef struct {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint8_t bDescriptorSubtype;
+    uint16_t bcdADC;
+    uint8_t bCategory;
+    uint16_t wTotalLength;
+    uint8_t bmControls;
+} __attribute__((packed)) uac2_ac_header_desc_t;
+
+/**
+ * @brief Audio Class-Specific AC Clock Source Descriptor
+ *
+ * @see Table 4-6 of audio20.pdf
+ */
+typedef struct {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint8_t bDescriptorSubtype;
+    uint8_t bClockID;
+    uint8_t bmAttributes;
+    uint8_t bmControls;
+    uint8_t bAssocTerminal;
+    uint8_t iClockSource;
+} __attribute__((packed)) uac2_ac_clock_source_desc_t;
+
+/**
+ * @brief Audio Class-Specific AC Clock Selector Descriptor (bNrInPins=2)
+ *
+ * bmControls and iClockSelector follow the baCSourceID of bNrInPins
+ *
+ * @see Table 4-7 of audio20.pdf
+ */
+typedef struct {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint8_t bDescriptorSubtype;
+    uint8_t bClockID;
+    uint8_t bNrInPins;
+    uint8_t baCSourceID[2];
+    uint8_t bmControls;
+    uint8_t iClockSelector;
+} __attribute__((packed)) uac2_ac_clock_selector_desc_t;
+
+/**
+ * @brief Audio Class-Specific AC Clock Multiplier Descriptor
+ *
+ * @see Table 4-8 of audio20.pdf
+ */
+typedef struct {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint8_t bDescriptorSubtype;
+    uint8_t bClockID;
+    uint8_t bCSourceID;
+    uint8_t bmControls;
+    uint8_t iClockMultiplier;
+} __attribute__((packed)) uac2_ac_clock_multiplier_desc_t;
+
+/**
+ * @brief Audio Class-Specific AC Input Terminal Descriptor of UAC 2.0
+ *
+ * @see Table 4-9 of audio20.pdf
+ */
+typedef struct {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint8_t bDescriptorSubtype;
+    uint8_t bTerminalID;
+    uint16_t wTerminalType;
+    uint8_t bAssocTerminal;
+    uint8_t bCSourceID;
+    uint8_t bNrChannels;
+    uint32_t bmChannelConfig;
+    uint8_t iChannelNames;
+    uint16_t bmControls;
+    uint8_t iTerminal;
+} __attribute__((packed)) uac2_ac_input_terminal_desc_t;
+
+/**
+ * @brief Audio Class-Specific AC Output Terminal Descriptor of UAC 2.0
+ *
+ * @see Table 4-10 of audio20.pdf
+ */
+typedef struct {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint8_t bDescriptorSubtype;
+    uint8_t bTerminalID;
+    uint16_t wTerminalType;
+    uint8_t bAssocTerminal;
+    uint8_t bSourceID;
+    uint8_t bCSourceID;
+    uint16_t bmControls;
+    uint8_t iTerminal;
+} __attribute__((packed)) uac2_ac_output_terminal_desc_t;
+
+/**
+ * @brief Audio Class-Specific AC Feature Unit Descriptor of UAC 2.0 (ch=2)
+ *
+ * @see Table 4-13 of audio20.pdf
+ */
+typedef struct {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint8_t bDescriptorSubtype;
+    uint8_t bUnitID;
+    uint8_t bSourceID;
+    uint32_t bmaControls[3]; // 2 channels + channel 0
+    uint8_t iFeature;
+} __attribute__((packed)) uac2_ac_feature_unit_desc_t;
+
+/**
+ * @brief Audio Class-Specific AS General Descriptor of UAC 2.0
+ *
+ * @see Table 4-27 of audio20.pdf
+ */
+typedef struct {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint8_t bDescriptorSubtype;
+    uint8_t bTerminalLink;
+    uint8_t bmControls;
+    uint8_t bFormatType;
+    uint32_t bmFormats;         // bit (n - 1) is set for the Type I format n of uac_type_i_format_t
+    uint8_t bNrChannels;
+    uint32_t bmChannelConfig;
+    uint8_t iChannelNames;
+} __attribute__((packed)) uac2_as_general_desc_t;
+
+/**
+ * @brief Audio Class-Specific AS Type I Format Type Descriptor of UAC 2.0
+ *
+ * The sampling frequencies are reported by the clock source, not by the descriptor
+ *
+ * @see Table 2-2 of frmts20.pdf
+ */
+typedef struct {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint8_t bDescriptorSubtype;
+    uint8_t bFormatType;
+    uint8_t bSubslotSize;
+    uint8_t bBitResolution;
+} __attribute__((packed)) uac2_as_type_I_format_desc_t;
+
+/**
+ * @brief Audio Class-Specific AS Isochronous Audio Data Endpoint Descriptor of UAC 2.0
+ *
+ * @see Table 4-34 of audio20.pdf
+ */
+typedef struct {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint8_t bDescriptorSubtype;
+    uint8_t bmAttributes;
+    uint8_t bmControls;
+    uint8_t bLockDelayUnits;
+    uint16_t wLockDelay;
+} __attribute__((packed)) uac2_as_cs_ep_desc_t;
+
 /**
  * @brief Print UAC device full configuration descriptor
  *
@@ -511,6 +788,20 @@ typedef struct {
  */
 void print_uac_descriptors(const usb_config_desc_t *cfg_desc);
 
+/**
+ * @brief Find the feedback endpoint of an asynchronous audio data endpoint
+ *
+ * The feedback endpoint is the synch endpoint addressed by bSynchAddress of the data endpoint,
+ * or an endpoint with explicit feedback usage in the same alternate setting.
+ *
+ * @param[in] cfg_desc      Pointer to Configuration Descriptor
+ * @param[in] alt_desc      Interface descriptor of the alternate setting with the data endpoint
+ * @param[in] data_ep_desc  Audio data endpoint descriptor
+ * @return Feedback endpoint descriptor, NULL if the data endpoint is not asynchronous or has no feedback endpoint
+ */
+const usb_ep_desc_t *uac_find_feedback_ep_desc(const usb_config_desc_t *cfg_desc, const usb_intf_desc_t *alt_desc,
+                                               const usb_ep_desc_t *data_ep_desc);
+
 #ifdef __cplusplus
 }
 #endif //__cplusplus
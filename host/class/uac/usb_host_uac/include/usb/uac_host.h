@@ -9,6 +9,7 @@
 #include <wchar.h>
 #include <stdint.h>
 #include "esp_err.h"
+#include "freertos/FreeRTOS.h"
 #include "uac.h"
 
 #ifdef __cplusplus
@@ -31,9 +32,13 @@ extern "C" {
  * @brief Flags to control stream work flow
  *
  * FLAG_STREAM_SUSPEND_AFTER_START: do not start stream transfer during start, only claim interface and prepare memory
+ * FLAG_STREAM_TX_CONCEAL_SILENCE: TX only, keep all transfers in flight, the samples missing in the stream buffer are sent as silence
+ * FLAG_STREAM_TX_CONCEAL_REPEAT: TX only, keep all transfers in flight, the last sent frame is repeated for the missing samples
  * @note User should call uac_host_device_resume to start stream transfer when needed
 */
 #define FLAG_STREAM_SUSPEND_AFTER_START      (1 << 0)
+#define FLAG_STREAM_TX_CONCEAL_SILENCE       (1 << 1)
+#define FLAG_STREAM_TX_CONCEAL_REPEAT        (1 << 2)
 
 typedef struct uac_interface *uac_host_device_handle_t;    /*!< Logic Device Handle. Handle to a particular UAC interface */
 
@@ -78,17 +83,40 @@ typedef void (*uac_host_driver_event_cb_t)(uint8_t addr, uint8_t iface_num,
 typedef void (*uac_host_device_event_cb_t)(uac_host_device_handle_t uac_device_handle,
         const uac_host_device_event_t event, void *arg);
 
+/**
+ * @brief Received audio data of one ISOC packet
+*/
+typedef struct {
+    const uint8_t *data;                                /*!< Packet data in the transfer buffer */
+    uint32_t len;                                       /*!< Packet data size in bytes */
+} uac_host_rx_span_t;
+
+/**
+ * @brief USB UAC RX data callback, invoked for each completed transfer of the RX stream
+ *
+ * The spans point to the transfer buffer, they are valid only until the callback returns.
+ * The transfer is submitted again after the callback returns, it must process the data within
+ * the time of the other queued transfers, otherwise some packets are lost.
+ *
+ * @param[in] uac_device_handle     UAC device handle (UAC Interface)
+ * @param[in] spans                 Valid packets of the transfer in receive order
+ * @param[in] num_spans             Number of spans, it may be 0 if no packet was received
+ * @param[in] arg                   User argument
+*/
+typedef void (*uac_host_rx_data_cb_t)(uac_host_device_handle_t uac_device_handle,
+                                      const uac_host_rx_span_t *spans, size_t num_spans, void *arg);
+
 /**
  * @brief  USB UAC host class descriptor print callback
  *
  * @param[in] desc  Pointer to the USB configuration descriptor
- * @param[in] class  Class of the UAC device
+ * @param[in] class_code  Class of the UAC device
  * @param[in] subclass  Subclass of the UAC device
  * @param[in] protocol  Protocol of the UAC device
  *
  */
 typedef void (*print_class_descriptor_with_context_cb)(const usb_standard_desc_t *desc,
-        uint8_t class, uint8_t subclass, uint8_t protocol);
+        uint8_t class_code, uint8_t subclass, uint8_t protocol);
 
 /**
  * @brief Stream type
@@ -123,6 +151,7 @@ typedef struct {
     uint8_t format;                                  /*!< audio stream format, currently only support 1 - PCM */
     uint8_t channels;                                /*!< audio stream channels */
     uint8_t bit_resolution;                          /*!< audio stream bit resolution */
+    uint8_t subframe_size;                           /*!< audio stream bytes of one sample in the stream, may exceed bit_resolution / 8 (eg. 24 bits in 4 bytes) */
     uint8_t sample_freq_type;                        /*!< audio stream sample frequency type, 0 - continuous, 1,2,3 - discrete */
     union {
         uint32_t sample_freq[UAC_FREQ_NUM_MAX];      /*!< audio stream sample frequency, first N discrete sample frequency */
@@ -144,6 +173,8 @@ typedef struct {
     BaseType_t core_id;                     /*!< Select core on which background task will run or tskNO_AFFINITY  */
     uac_host_driver_event_cb_t callback;    /*!< Callback invoked when UAC driver event occurs. Must not be NULL. */
     void *callback_arg;                     /*!< User provided argument passed to callback */
+    bool shared_client;                     /*!< Register to the client of usb_host_shared_client component instead of an own USB Host client.
+                                                 Its task handles the events, so no background task is created and uac_host_handle_events is not used */
 } uac_host_driver_config_t;
 
 /**
@@ -153,12 +184,31 @@ typedef struct {
 typedef struct {
     uint8_t addr;                                       /*!< USB Address of connected physical device */
     uint8_t iface_num;                                  /*!< UAC Interface Number */
-    uint32_t buffer_size;                               /*!< Audio buffer size */
+    uint32_t buffer_size;                               /*!< Audio buffer size, may be 0 with rx_data_cb */
     uint32_t buffer_threshold;                          /*!< Audio buffer threshold */
     uac_host_device_event_cb_t callback;                /*!< Callback invoked when UAC device event occurs */
-    void *callback_arg;                                 /*!< User provided argument passed to callback */
+    void *callback_arg;                                 /*!< User provided argument passed to callback and rx_data_cb */
+    uac_host_rx_data_cb_t rx_data_cb;                   /*!< RX stream only: callback receiving the data of each transfer in place,
+                                                             the audio buffer and UAC_HOST_DEVICE_EVENT_RX_DONE are bypassed. NULL: data are buffered */
+    uint32_t staging_size;                              /*!< RX stream only: size of the staging buffer in internal RAM. 0: the audio buffer is in internal RAM.
+                                                             Otherwise the audio buffer is allocated in PSRAM, the transfers write the staging buffer and
+                                                             a mover task copies the staged data to the audio buffer in blocks of staging_size / 4 */
 } uac_host_device_config_t;
 
+#define UAC_HOST_PCM_CHANNELS_MAX           8           /*!< Maximum number of channels of PCM conversion */
+#define UAC_HOST_PCM_CHANNEL_MIX            0xFF        /*!< Channel map entry: average of all source channels */
+
+/**
+ * @brief Sample format of the audio buffer
+ */
+typedef enum {
+    UAC_HOST_PCM_FORMAT_DEVICE = 0,                      /*!< Samples in the format of the device, no sample conversion */
+    UAC_HOST_PCM_FORMAT_S16,                             /*!< Signed 16 bit samples */
+    UAC_HOST_PCM_FORMAT_S24_3,                           /*!< Signed 24 bit samples in 3 bytes */
+    UAC_HOST_PCM_FORMAT_S32,                             /*!< Signed 32 bit samples, shorter device samples are MSB aligned */
+    UAC_HOST_PCM_FORMAT_FLOAT,                           /*!< 32 bit float samples in range [-1.0, 1.0) */
+} uac_host_pcm_format_t;
+
 /**
  * @brief UAC stream configuration structure
  *
@@ -168,8 +218,91 @@ typedef struct {
     uint8_t bit_resolution;                              /*!< Audio bit resolution */
     uint32_t sample_freq;                                /*!< Audio sample resolution */
     uint16_t flags;                                      /*!< Control flags */
+    uint8_t xfer_num;                                    /*!< Number of ISOC transfers (URBs) queued, at most 32. 0: derived from latency_ms or CONFIG_UAC_NUM_ISOC_URBS */
+    uint8_t packets_per_xfer;                            /*!< Number of packets per transfer, one per endpoint interval (1 ms frame at full speed, 125 us microframe at high speed).
+                                                              0: derived from latency_ms or CONFIG_UAC_NUM_PACKETS_PER_URB */
+    uint16_t latency_ms;                                 /*!< Target latency of the queued transfers in ms, used for xfer_num and packets_per_xfer left 0.
+                                                              0: Kconfig defaults */
+    uac_host_pcm_format_t pcm_format;                    /*!< Sample format of the audio buffer, samples are converted during the copy between
+                                                              the audio buffer and the transfers. Not supported with rx_data_cb */
+    uint8_t pcm_channels;                                /*!< Number of channels of the audio buffer, 0: channels */
+    const uint8_t *channel_map;                          /*!< Source channel of each destination channel, or UAC_HOST_PCM_CHANNEL_MIX.
+                                                              pcm_channels entries for RX, channels entries for TX, copied on start.
+                                                              NULL: channel i is taken from source channel i modulo the number of source channels */
 } uac_host_stream_config_t;
 
+/**
+ * @brief UAC stream latency
+ *
+ * The end-to-end buffer latency of the stream is the sum of both parts.
+*/
+typedef struct {
+    uint32_t xfer_latency_ms;                            /*!< Latency of the transfers: all queued transfers for TX, one transfer for RX */
+    uint32_t buffer_latency_ms;                          /*!< Latency of the data currently in the stream buffer */
+} uac_host_stream_latency_t;
+
+#define UAC_HOST_STATS_FILL_BINS            8           /*!< Number of bins of the stream buffer fill histogram */
+
+/**
+ * @brief UAC stream statistics, reset when the stream is started
+ *
+*/
+typedef struct {
+    uint32_t rx_overflow_count;                          /*!< Number of RX transfers whose data did not fit in the stream buffer */
+    uint32_t rx_overflow_bytes;                          /*!< Number of RX bytes dropped, the end of the data that did not fit */
+    uint32_t rx_bad_packets;                             /*!< Number of RX packets dropped with error status */
+    uint32_t tx_underrun_count;                          /*!< Number of times the TX stream stopped a transfer for lack of data in the stream buffer */
+    uint32_t tx_concealed_count;                         /*!< Number of TX transfers completed by underrun concealment, FLAG_STREAM_TX_CONCEAL_* */
+    uint32_t tx_concealed_frames;                        /*!< Number of TX frames (samples of all channels) sent by underrun concealment */
+    uint32_t tx_bad_packets;                             /*!< Number of TX packets completed with error status */
+    uint32_t xfer_errors;                                /*!< Number of transfers failed with error status */
+    uint32_t fill_hist[UAC_HOST_STATS_FILL_BINS];        /*!< Stream buffer fill level after each transfer, bin i counts fill levels
+                                                              from i / UAC_HOST_STATS_FILL_BINS of the buffer size. Empty without stream buffer */
+} uac_host_stream_stats_t;
+
+/**
+ * @brief UAC stream timing, reset when the stream is started or resumed
+ *
+ * Streams started together by uac_host_device_start_group() are aligned by the difference of their start times.
+ * The relative drift of two streams is the difference of their drift_ppm.
+*/
+typedef struct {
+    int64_t start_time_us;                               /*!< Estimated esp_timer time of the first packet, 0 until the first transfer completes */
+    int64_t last_time_us;                                /*!< esp_timer time the last transfer completed */
+    uint64_t packet_count;                               /*!< Number of packets completed, one per endpoint interval */
+    uint64_t sample_count;                               /*!< Number of samples per channel transferred */
+    int32_t drift_ppm;                                   /*!< Samples transferred against the nominal sampling frequency, in ppm */
+} uac_host_stream_timing_t;
+
+typedef struct uac_duplex *uac_host_duplex_handle_t;      /*!< Handle of a microphone and speaker stream pair started by uac_host_duplex_start() */
+
+/**
+ * @brief Full-duplex stream pair configuration, eg. of a headset used with echo cancellation
+ *
+*/
+typedef struct {
+    uac_host_device_handle_t mic_handle;                 /*!< RX stream, read only by uac_host_duplex_read(). rx_data_cb is not supported */
+    uac_host_device_handle_t spk_handle;                 /*!< TX stream, written by the application as usual */
+    uac_host_stream_config_t mic_config;                 /*!< Microphone stream configuration */
+    uac_host_stream_config_t spk_config;                 /*!< Speaker stream configuration, same sample_freq as the microphone.
+                                                              FLAG_STREAM_TX_CONCEAL_SILENCE is added if no concealment is set */
+    uint32_t period_frames;                              /*!< Samples per channel of each block read by uac_host_duplex_read() */
+    uint32_t ref_periods;                                /*!< Capacity of the reference buffer in periods, 0: 4 */
+} uac_host_duplex_config_t;
+
+/**
+ * @brief Full-duplex stream pair alignment
+ *
+*/
+typedef struct {
+    bool aligned;                                        /*!< The offset is known, set by the first uac_host_duplex_read() */
+    int32_t start_offset_packets;                        /*!< First microphone packet minus first speaker packet, in USB frames or microframes */
+    int32_t start_offset_frames;                         /*!< Start offset in samples per channel: skipped reference samples if positive,
+                                                              skipped microphone samples if negative */
+    uint32_t mic_dropped_frames;                         /*!< Microphone samples lost by RX overflow, skipped in the reference too */
+    uint32_t ref_dropped_frames;                         /*!< Reference samples lost by a full reference buffer, skipped in the microphone too */
+} uac_host_duplex_stats_t;
+
 // ----------------------------- Public ---------------------------------------
 /**
  * @brief Install USB Host UAC Class driver
@@ -298,6 +431,8 @@ esp_err_t uac_host_handle_events(uint32_t timeout);
  * @brief Start a UAC stream with specific stream configuration (channels, bit resolution, sample frequency)
  *
  * @note set flags FLAG_STREAM_SUSPEND_AFTER_START to suspend stream after start
+ * @note Fewer packets per transfer lower the latency, fewer packets queued in total make audio dropouts more likely.
+ *       The resulting latency is returned by uac_host_device_get_latency()
  *
  * @param[in] uac_dev_handle  UAC device handle
  * @param[in] stream_config   Pointer to UAC stream configuration structure
@@ -311,6 +446,48 @@ esp_err_t uac_host_handle_events(uint32_t timeout);
  */
 esp_err_t uac_host_device_start(uac_host_device_handle_t uac_dev_handle, const uac_host_stream_config_t *stream_config);
 
+/**
+ * @brief Start several UAC streams together, eg. of a microphone array
+ *
+ * All interfaces are claimed and their alternate settings and sampling frequencies are set first,
+ * then the transfers of all streams are submitted right after each other, so they start in the same or adjacent frames.
+ *
+ * @note All streams must be stopped. On failure, the streams already started are stopped again
+ *
+ * @param[in] uac_dev_handles  Array of num UAC device handles
+ * @param[in] stream_configs   Array of num stream configurations, one for each device
+ * @param[in] num              Number of streams
+ * @return esp_err_t
+ * - ESP_OK on success
+ * - ESP_ERR_INVALID_ARG if a device handle or stream configuration is invalid
+ * - ESP_ERR_INVALID_STATE if a stream is already started
+ * - Other errors of uac_host_device_start()
+ */
+esp_err_t uac_host_device_start_group(const uac_host_device_handle_t *uac_dev_handles, const uac_host_stream_config_t *stream_configs, size_t num);
+
+/**
+ * @brief Change the sample frequency, channels or bit resolution of a started stream in place
+ *
+ * The stream is suspended, the alternate setting and sampling frequency are set again and the stream is resumed,
+ * without stopping it. The transfers are reused if their number and size fit the new stream, otherwise they are
+ * reallocated. The audio buffer is kept, the data of the previous format is flushed.
+ * A suspended stream stays suspended.
+ *
+ * @note xfer_num, packets_per_xfer, latency_ms and the PCM conversion are taken from the new configuration, flags are ignored
+ *
+ * @param[in]  uac_dev_handle  UAC device handle
+ * @param[in]  stream_config   Pointer to the new stream configuration
+ * @param[out] switch_us       Time of the switch in microseconds, may be NULL
+ * @return esp_err_t
+ * - ESP_OK on success
+ * - ESP_ERR_INVALID_ARG if the device handle or stream configuration is invalid
+ * - ESP_ERR_NOT_FOUND if the stream configuration is not supported, the stream is not changed
+ * - ESP_ERR_INVALID_STATE if the stream is not started
+ * - Other errors of uac_host_device_start(), the stream is stopped
+ */
+esp_err_t uac_host_device_reconfigure(uac_host_device_handle_t uac_dev_handle, const uac_host_stream_config_t *stream_config,
+                                      uint32_t *switch_us);
+
 /**
  * @brief Suspend a UAC stream
  *
@@ -356,6 +533,7 @@ esp_err_t uac_host_device_stop(uac_host_device_handle_t uac_dev_handle);
  * - ESP_OK on success
  * - ESP_ERR_INVALID_ARG if the device handle or data is invalid
  * - ESP_ERR_INVALID_STATE if the device is not in the right state
+ * - ESP_ERR_NOT_SUPPORTED if the data are passed to the RX data callback
  */
 esp_err_t uac_host_device_read(uac_host_device_handle_t uac_dev_handle, uint8_t *data, uint32_t size,
                                uint32_t *bytes_read, uint32_t timeout);
@@ -379,6 +557,167 @@ esp_err_t uac_host_device_read(uac_host_device_handle_t uac_dev_handle, uint8_t
 esp_err_t uac_host_device_write(uac_host_device_handle_t uac_dev_handle, uint8_t *data, uint32_t size,
                                 uint32_t timeout);
 
+/**
+ * @brief Get received data in UAC stream buffer without copying, only available after stream started
+ *
+ * @note The data stay valid and in the buffer until released by uac_host_device_read_release().
+ * At most the data up to the end of the internal ringbuffer are returned, the rest is returned by the next call.
+ *
+ * @param[in] uac_dev_handle  UAC device handle
+ * @param[out] data           Pointer to the received data
+ * @param[out] size           Number of bytes available at data
+ * @param[in] timeout         Timeout in ticks waiting for data. For milliseconds, please use 'pdMS_TO_TICKS()' macros
+ * @return esp_err_t
+ * - ESP_OK on success
+ * - ESP_ERR_INVALID_ARG if the device handle or data is invalid
+ * - ESP_ERR_INVALID_STATE if the device is not in the right state
+ * - ESP_ERR_TIMEOUT if no data was received before timeout
+ * - ESP_ERR_NOT_SUPPORTED if the data are passed to the RX data callback
+ */
+esp_err_t uac_host_device_read_acquire(uac_host_device_handle_t uac_dev_handle, uint8_t **data, uint32_t *size,
+                                       uint32_t timeout);
+
+/**
+ * @brief Release data obtained by uac_host_device_read_acquire(), the space is reused for new data
+ *
+ * @param[in] uac_dev_handle  UAC device handle
+ * @param[in] size            Number of bytes consumed, at most the acquired size
+ * @return esp_err_t
+ * - ESP_OK on success
+ * - ESP_ERR_INVALID_ARG if the device handle is invalid
+ * - ESP_ERR_INVALID_STATE if the device is not opened
+ * - ESP_ERR_INVALID_SIZE if the size is larger than the data in the buffer
+ */
+esp_err_t uac_host_device_read_release(uac_host_device_handle_t uac_dev_handle, uint32_t size);
+
+/**
+ * @brief Get free space in UAC stream buffer to write data without copying, only can be called after stream started
+ *
+ * @note At most the space up to the end of the internal ringbuffer is returned, the rest is returned by the next call.
+ *
+ * @param[in] uac_dev_handle  UAC device handle
+ * @param[out] data           Pointer to the free space
+ * @param[out] size           Number of bytes available at data
+ * @param[in] timeout         Timeout in ticks waiting for free space. For milliseconds, please use 'pdMS_TO_TICKS()' macros
+ * @return esp_err_t
+ * - ESP_OK on success
+ * - ESP_ERR_INVALID_ARG if the device handle or data is invalid
+ * - ESP_ERR_INVALID_STATE if the device is not in the right state
+ * - ESP_ERR_TIMEOUT if no space was freed before timeout
+ */
+esp_err_t uac_host_device_write_acquire(uac_host_device_handle_t uac_dev_handle, uint8_t **data, uint32_t *size,
+                                        uint32_t timeout);
+
+/**
+ * @brief Commit data written to the space obtained by uac_host_device_write_acquire(), the data are scheduled for sending
+ *
+ * @param[in] uac_dev_handle  UAC device handle
+ * @param[in] size            Number of bytes written, at most the acquired size
+ * @return esp_err_t
+ * - ESP_OK on success
+ * - ESP_ERR_INVALID_ARG if the device handle is invalid
+ * - ESP_ERR_INVALID_STATE if the device is not opened or not in the right state
+ * - ESP_ERR_INVALID_SIZE if the size is larger than the free space in the buffer
+ */
+esp_err_t uac_host_device_write_commit(uac_host_device_handle_t uac_dev_handle, uint32_t size);
+
+/**
+ * @brief Get the latency of an active or suspended UAC stream
+ *
+ * @param[in] uac_dev_handle  UAC device handle
+ * @param[out] latency        Pointer to the latency of the stream
+ * @return esp_err_t
+ * - ESP_OK on success
+ * - ESP_ERR_INVALID_ARG if the device handle or latency is invalid
+ * - ESP_ERR_INVALID_STATE if the stream is not started
+ */
+esp_err_t uac_host_device_get_latency(uac_host_device_handle_t uac_dev_handle, uac_host_stream_latency_t *latency);
+
+/**
+ * @brief Get statistics of the stream
+ *
+ * @param[in] uac_dev_handle  UAC device handle
+ * @param[out] stats          Stream statistics since the stream was started
+ * @return esp_err_t
+ * - ESP_OK on success
+ * - ESP_ERR_INVALID_ARG if the device handle or stats is invalid
+ */
+esp_err_t uac_host_device_get_stats(uac_host_device_handle_t uac_dev_handle, uac_host_stream_stats_t *stats);
+
+/**
+ * @brief Get timing of an active or suspended UAC stream
+ *
+ * @param[in] uac_dev_handle  UAC device handle
+ * @param[out] timing         Stream timing since the stream was started or resumed
+ * @return esp_err_t
+ * - ESP_OK on success
+ * - ESP_ERR_INVALID_ARG if the device handle or timing is invalid
+ * - ESP_ERR_INVALID_STATE if the stream is not started
+ */
+esp_err_t uac_host_device_get_timing(uac_host_device_handle_t uac_dev_handle, uac_host_stream_timing_t *timing);
+
+/**
+ * @brief Start a microphone and a speaker stream as a full-duplex pair, eg. for echo cancellation on a headset
+ *
+ * Both streams are started together by uac_host_device_start_group(). The samples sent by the speaker transfers
+ * are recorded as the echo reference. The offset of both streams is measured from the start of their first packets
+ * and compensated when reading, so uac_host_duplex_read() returns microphone and reference blocks
+ * of the same USB frames, and echo cancellation needs only a small fixed delay for the device.
+ *
+ * @note The microphone stream must not be read by other functions
+ *
+ * @param[in] config          Duplex configuration
+ * @param[out] duplex_handle  Handle of the started pair
+ * @return esp_err_t
+ * - ESP_OK on success
+ * - ESP_ERR_INVALID_ARG if the configuration is invalid or the sample frequencies differ
+ * - ESP_ERR_INVALID_STATE if the speaker is already in a pair
+ * - ESP_ERR_INVALID_SIZE if a period does not fit the microphone buffer
+ * - ESP_ERR_NO_MEM if memory allocation failed
+ * - Other errors of uac_host_device_start_group()
+ */
+esp_err_t uac_host_duplex_start(const uac_host_duplex_config_t *config, uac_host_duplex_handle_t *duplex_handle);
+
+/**
+ * @brief Stop both streams of the pair and free the pair
+ *
+ * @note Must not be called while uac_host_duplex_read() waits
+ *
+ * @param[in] duplex_handle  Handle of the pair
+ * @return esp_err_t
+ * - ESP_OK on success
+ * - ESP_ERR_INVALID_ARG if the handle is invalid
+ */
+esp_err_t uac_host_duplex_stop(uac_host_duplex_handle_t duplex_handle);
+
+/**
+ * @brief Read one period of microphone samples and the speaker samples sent in the same USB frames
+ *
+ * Nothing is read if either block is not complete before timeout, so the pair stays aligned.
+ *
+ * @param[in] duplex_handle  Handle of the pair
+ * @param[out] mic_data      period_frames microphone samples, in the format of the microphone buffer
+ * @param[out] ref_data      period_frames reference samples, in the format of the speaker transfers
+ * @param[in] timeout        Timeout in ticks. For milliseconds, please use 'pdMS_TO_TICKS()' macros
+ * @return esp_err_t
+ * - ESP_OK on success
+ * - ESP_ERR_INVALID_ARG if the handle or data is invalid
+ * - ESP_ERR_INVALID_STATE if a stream is not active
+ * - ESP_ERR_TIMEOUT if a block was not complete before timeout
+ */
+esp_err_t uac_host_duplex_read(uac_host_duplex_handle_t duplex_handle, uint8_t *mic_data, uint8_t *ref_data, uint32_t timeout);
+
+/**
+ * @brief Get the alignment of the pair
+ *
+ * @param[in] duplex_handle  Handle of the pair
+ * @param[out] stats         Alignment of the pair
+ * @return esp_err_t
+ * - ESP_OK on success
+ * - ESP_ERR_INVALID_ARG if the handle or stats is invalid
+ */
+esp_err_t uac_host_duplex_get_stats(uac_host_duplex_handle_t duplex_handle, uac_host_duplex_stats_t *stats);
+
 /**
  * @brief Mute or un-mute the UAC device
  * @param[in] uac_dev_handle  UAC device handle
@@ -0,0 +1,247 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "usb/uac_host.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Functions called from stream transfer callbacks, placed in IRAM if CONFIG_UAC_DATA_PATH_IN_IRAM is enabled
+#if CONFIG_UAC_DATA_PATH_IN_IRAM && !CONFIG_IDF_TARGET_LINUX
+#include "esp_attr.h"
+#define UAC_DATA_PATH_ATTR IRAM_ATTR
+#else
+#define UAC_DATA_PATH_ATTR
+#endif
+
+// Memory of the driver comes from usb_host_shared_client if it is in the build: accounted in the memory footprint,
+// and taken from the arenas of the static allocation mode if it is installed. From heap otherwise
+#if USB_HOST_SHARED_CLIENT_ENABLED
+#include "usb/usb_host_mem.h"
+#define UAC_CALLOC(category, n, size)                   usb_host_mem_calloc(USB_HOST_MEM_DRIVER_UAC, USB_HOST_MEM_##category, n, size, MALLOC_CAP_DEFAULT)
+#define UAC_ALIGNED_ALLOC(category, align, size, caps)  usb_host_mem_aligned_alloc(USB_HOST_MEM_DRIVER_UAC, USB_HOST_MEM_##category, align, size, caps)
+#define UAC_REALLOC(category, ptr, old_size, size)      usb_host_mem_realloc(USB_HOST_MEM_DRIVER_UAC, USB_HOST_MEM_##category, ptr, old_size, size, MALLOC_CAP_DEFAULT)
+#define UAC_FREE(category, ptr, size)                   usb_host_mem_free(USB_HOST_MEM_DRIVER_UAC, USB_HOST_MEM_##category, ptr, size)
+#else
+#define UAC_CALLOC(category, n, size)                   calloc(n, size)
+#define UAC_ALIGNED_ALLOC(category, align, size, caps)  heap_caps_aligned_alloc(align, size, caps)
+#define UAC_REALLOC(category, ptr, old_size, size)      ((void)(old_size), realloc(ptr, size))
+#define UAC_FREE(category, ptr, size)                   ((void)(size), free(ptr))
+#endif
+
+// Atomic access of plain members, so the private structures can be used from C++ host tests too
+#define UAC_ATOMIC_LOAD(x)                __atomic_load_n(&(x), __ATOMIC_SEQ_CST)
+#define UAC_ATOMIC_STORE(x, v)            __atomic_store_n(&(x), (v), __ATOMIC_SEQ_CST)
+#define UAC_ATOMIC_EXCHANGE(x, v)         __atomic_exchange_n(&(x), (v), __ATOMIC_SEQ_CST)
+#define UAC_ATOMIC_FETCH_OR(x, v)         __atomic_fetch_or(&(x), (v), __ATOMIC_SEQ_CST)
+#define UAC_ATOMIC_FETCH_AND(x, v)        __atomic_fetch_and(&(x), (v), __ATOMIC_SEQ_CST)
+
+/**
+ * @brief Lock-free single producer, single consumer ring of audio data
+ *
+ * For RX the producer is the transfer callback and the consumer is the application, for TX vice versa.
+ * Only the application side waits for the ring, the transfer callbacks never block.
+ * TX transfers are submitted both from the callback and from the writing task, their reads are serialized by tx_lock.
+ * Both positions run over [0, 2 * size), so a full ring is distinguished from an empty one without a spare byte.
+ */
+typedef struct {
+    uint8_t *buf;                              /*!< Ring storage */
+    uint32_t size;                             /*!< Ring capacity in bytes */
+    uint32_t wr;                               /*!< Write position, changed only by the producer */
+    uint32_t rd;                               /*!< Read position, changed only by the consumer */
+    bool waiting;                              /*!< A task waits for data or free space */
+    bool aborted;                              /*!< The ring is going to be deleted, waiting task must return */
+    SemaphoreHandle_t event;                   /*!< Given on write commit or read release if a task waits */
+} uac_ring_t;
+
+/**
+ * @brief PCM conversion between the device samples and the audio buffer
+ *
+ * For RX the source is the device and the destination the audio buffer, for TX vice versa.
+ * Samples are handled as MSB aligned 32 bit integers, so any integer size converts to any other.
+ */
+typedef struct {
+    bool enabled;                              /*!< Samples are converted, otherwise they are copied unchanged */
+    bool src_float;                            /*!< Source samples are float */
+    bool dst_float;                            /*!< Destination samples are float */
+    uint8_t src_size;                          /*!< Bytes per source sample */
+    uint8_t dst_size;                          /*!< Bytes per destination sample */
+    uint8_t src_channels;                      /*!< Number of source channels */
+    uint8_t dst_channels;                      /*!< Number of destination channels */
+    uint8_t map[UAC_HOST_PCM_CHANNELS_MAX];    /*!< Source channel of each destination channel or UAC_HOST_PCM_CHANNEL_MIX */
+    uint32_t src_frame_size;                   /*!< Bytes per source frame */
+    uint32_t dst_frame_size;                   /*!< Bytes per destination frame */
+} uac_pcm_conv_t;
+
+/**
+ * @brief Allocate the ring storage
+ *
+ * @param[in] ring  Pointer to the ring
+ * @param[in] size  Ring capacity in bytes
+ * @return ESP_OK or ESP_ERR_NO_MEM
+ */
+esp_err_t uac_ring_init(uac_ring_t *ring, uint32_t size);
+
+/**
+ * @brief Allocate the ring storage from memory with the given capabilities
+ *
+ * @param[in] ring   Pointer to the ring
+ * @param[in] size   Ring capacity in bytes
+ * @param[in] align  Alignment of the storage in bytes, power of two
+ * @param[in] caps   Memory capabilities of the storage, MALLOC_CAP_*
+ * @return ESP_OK or ESP_ERR_NO_MEM
+ */
+esp_err_t uac_ring_init_caps(uac_ring_t *ring, uint32_t size, size_t align, uint32_t caps);
+
+/**
+ * @brief Free the ring storage, the ring must not be used by any side
+ */
+void uac_ring_deinit(uac_ring_t *ring);
+
+static inline size_t uac_ring_get_len(uac_ring_t *ring)
+{
+    assert(ring->buf);
+    const uint32_t rd = UAC_ATOMIC_LOAD(ring->rd);
+    const uint32_t wr = UAC_ATOMIC_LOAD(ring->wr);
+    return wr >= rd ? wr - rd : wr + 2 * ring->size - rd;
+}
+
+static inline size_t uac_ring_get_free(uac_ring_t *ring)
+{
+    return ring->size - uac_ring_get_len(ring);
+}
+
+/**
+ * @brief Wait until the ring holds at least min_len bytes of data or of free space
+ *
+ * @param[in] ring          Pointer to the ring
+ * @param[in] data          true to wait for data, false to wait for free space
+ * @param[in] min_len       Number of bytes to wait for
+ * @param[in] ticks_to_wait Timeout in ticks
+ * @return esp_err_t
+ * - ESP_OK if the bytes are available
+ * - ESP_ERR_TIMEOUT if the bytes are not available before timeout
+ * - ESP_ERR_INVALID_STATE if the ring was aborted
+ */
+esp_err_t uac_ring_wait(uac_ring_t *ring, bool data, size_t min_len, TickType_t ticks_to_wait);
+
+/**
+ * @brief Return the waiting task and make all following waits fail, before the ring is deleted
+ */
+void uac_ring_abort(uac_ring_t *ring);
+
+/**
+ * @brief Get contiguous span of free space at the write position, producer only
+ *
+ * @param[in]  ring  Pointer to the ring
+ * @param[out] span  Start of the free space
+ * @return Number of free bytes at span, the rest of the free space starts at the beginning of the ring storage
+ */
+size_t uac_ring_write_acquire(uac_ring_t *ring, uint8_t **span);
+
+/**
+ * @brief Copy data to the free space, producer only
+ *
+ * The data become visible to the consumer with uac_ring_write_commit(), several copies can be committed at once.
+ *
+ * @param[in] ring    Pointer to the ring
+ * @param[in] offset  Offset from the write position, the number of bytes already copied but not committed
+ * @param[in] data    Data to copy
+ * @param[in] len     Number of bytes to copy, the caller must check there is enough free space
+ */
+void uac_ring_copy_in(uac_ring_t *ring, size_t offset, const uint8_t *data, size_t len);
+
+/**
+ * @brief Make len bytes copied to the free space visible to the consumer, producer only
+ */
+void uac_ring_write_commit(uac_ring_t *ring, size_t len);
+
+/**
+ * @brief Get contiguous span of data at the read position, consumer only
+ *
+ * @param[in]  ring  Pointer to the ring
+ * @param[out] span  Start of the data
+ * @return Number of bytes at span, the rest of the data starts at the beginning of the ring storage
+ */
+size_t uac_ring_read_acquire(uac_ring_t *ring, uint8_t **span);
+
+/**
+ * @brief Copy data from the read position, consumer only. The data stay in the ring until uac_ring_read_release()
+ */
+void uac_ring_copy_out(uac_ring_t *ring, uint8_t *data, size_t len);
+
+/**
+ * @brief Free len bytes at the read position, consumer only
+ */
+void uac_ring_read_release(uac_ring_t *ring, size_t len);
+
+/**
+ * @brief Drop all data, only when the other side of the ring is stopped
+ */
+void uac_ring_flush(uac_ring_t *ring);
+
+/**
+ * @brief Drop all data and restart at the beginning of the storage, only when both sides of the ring are stopped
+ */
+void uac_ring_reset(uac_ring_t *ring);
+
+/**
+ * @brief Wait for free space and copy all data to the ring, producer only
+ *
+ * @return ESP_OK, ESP_FAIL if the data do not fit before timeout or ESP_ERR_INVALID_STATE if the ring was aborted
+ */
+esp_err_t uac_ring_push(uac_ring_t *ring, const uint8_t *buf, size_t write_bytes, TickType_t xTicksToWait);
+
+/**
+ * @brief Wait for data and copy up to req_bytes from the ring, consumer only
+ *
+ * @return ESP_OK, ESP_FAIL if there are no data before timeout or ESP_ERR_INVALID_STATE if the ring was aborted
+ */
+esp_err_t uac_ring_pop(uac_ring_t *ring, uint8_t *buf, size_t req_bytes, size_t *read_bytes, TickType_t ticks_to_wait);
+
+/**
+ * @brief Convert whole frames, selecting or mixing the channels
+ *
+ * @param[in]  conv    Pointer to the conversion
+ * @param[out] dst     Destination frames
+ * @param[in]  src     Source frames
+ * @param[in]  frames  Number of frames
+ */
+void uac_pcm_convert(const uac_pcm_conv_t *conv, uint8_t *dst, const uint8_t *src, size_t frames);
+
+/**
+ * @brief Convert frames to the free space of the ring, producer only
+ *
+ * A frame crossing the end of the ring storage is converted through a temporary frame.
+ * The caller must check there is enough free space and commit the conversion with uac_ring_write_commit().
+ *
+ * @param[in] ring    Pointer to the ring
+ * @param[in] conv    Pointer to the conversion
+ * @param[in] src     Source frames
+ * @param[in] frames  Number of frames
+ */
+void uac_ring_convert_in(uac_ring_t *ring, const uac_pcm_conv_t *conv, const uint8_t *src, size_t frames);
+
+/**
+ * @brief Convert frames from the read position, consumer only. The data stay in the ring until uac_ring_read_release()
+ */
+void uac_ring_convert_out(uac_ring_t *ring, const uac_pcm_conv_t *conv, uint8_t *dst, size_t frames);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,100 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "esp_idf_version.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "uac_ring_priv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Staged data are moved by async memcpy if enabled, esp_cache_msync() was introduced in IDF v5.1
+#define UAC_STAGE_DMA       (CONFIG_UAC_STAGING_ASYNC_MEMCPY && ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0))
+
+// Alignment of the storage and of the moved blocks, suits the DMA and the cache lines
+#if UAC_STAGE_DMA
+#define UAC_STAGE_ALIGN     (64)
+#else
+#define UAC_STAGE_ALIGN     (4)
+#endif
+
+#define UAC_STAGE_ROUND_UP(x)   ((((x) + UAC_STAGE_ALIGN - 1) / UAC_STAGE_ALIGN) * UAC_STAGE_ALIGN)
+
+/**
+ * @brief Function called by the mover task after staged data were moved to the destination ring
+ */
+typedef void (*uac_stage_moved_cb_t)(void *arg);
+
+/**
+ * @brief Staging of RX data in internal RAM in front of a large ring, e.g. in PSRAM
+ *
+ * The transfer callbacks write the staging ring, which is fast and takes constant time.
+ * A low priority mover task moves the staged data to the destination ring in blocks, so only the mover waits for slow memory.
+ * The mover is the consumer of the staging ring and the producer of the destination ring.
+ * With DMA, moved blocks are multiples of UAC_STAGE_ALIGN and both rings are sized in multiples of it,
+ * so the read position of the staging ring and the write position of the destination ring stay aligned.
+ */
+typedef struct {
+    uac_ring_t ring;                           /*!< Staging ring in internal RAM, written by the transfer callbacks */
+    uac_ring_t *dst;                           /*!< Destination ring, read by the application */
+    size_t block;                              /*!< The mover is woken up when the staging ring holds this many bytes */
+    TaskHandle_t task;                         /*!< Mover task */
+    SemaphoreHandle_t lock;                    /*!< Held by the mover while moving, flushing waits for it */
+    SemaphoreHandle_t exited;                  /*!< Given by the mover task when it exits */
+    bool exit;                                 /*!< The mover task must exit */
+    uac_stage_moved_cb_t moved_cb;             /*!< Called from the mover task after each move */
+    void *moved_cb_arg;                        /*!< Argument of moved_cb */
+#if UAC_STAGE_DMA
+    void *mcp;                                 /*!< Async memcpy driver handle */
+    SemaphoreHandle_t copy_done;               /*!< Given from DMA ISR when a block was copied */
+#endif
+} uac_stage_t;
+
+/**
+ * @brief Allocate the staging ring in internal RAM and start the mover task
+ *
+ * @param[in] stage         Pointer to the staging, zeroed
+ * @param[in] size          Staging ring capacity in bytes, rounded up to UAC_STAGE_ALIGN
+ * @param[in] dst           Destination ring, capacity multiple of UAC_STAGE_ALIGN
+ * @param[in] moved_cb      Function called from the mover task after each move
+ * @param[in] moved_cb_arg  Argument of moved_cb
+ * @return ESP_OK, ESP_ERR_INVALID_ARG or ESP_ERR_NO_MEM
+ */
+esp_err_t uac_stage_init(uac_stage_t *stage, uint32_t size, uac_ring_t *dst, uac_stage_moved_cb_t moved_cb, void *moved_cb_arg);
+
+/**
+ * @brief Stop the mover task and free the staging ring. Does nothing if the staging was not initialized
+ */
+void uac_stage_deinit(uac_stage_t *stage);
+
+/**
+ * @brief Wake up the mover if a block is staged, transfer callbacks only, after the staging ring write was committed
+ */
+static inline void uac_stage_notify(uac_stage_t *stage)
+{
+    if (uac_ring_get_len(&stage->ring) >= stage->block) {
+        xTaskNotifyGive(stage->task);
+    }
+}
+
+/**
+ * @brief Drop all staged and moved data, only when the transfer callbacks do not write the staging ring
+ */
+void uac_stage_flush(uac_stage_t *stage);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,187 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/queue.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "usb/usb_host.h"
+#include "usb/uac_host.h"
+#include "uac_ring_priv.h"
+#include "uac_stage_priv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UAC_XFER_NUM_MAX                    (32)        // transfers of an interface, one bit each in free_xfer_mask
+#define UAC_TX_LAST_FRAME_MAX               (64)        // largest TX frame repeated by underrun concealment, larger ones are concealed by silence
+
+/**
+ * @brief Entity of the audio control topology: terminal, unit or clock, parsed once when the device is added
+ */
+typedef struct {
+    const uint8_t *desc;                            /*!< Entity descriptor in cs_ac_desc */
+    uint8_t id;                                     /*!< Terminal, unit or clock ID */
+    uint8_t subtype;                                /*!< Descriptor subtype */
+    uint8_t source;                                 /*!< Source of terminals and units, the first one of selector and mixer units. 0: none */
+    uint8_t sink;                                   /*!< First output terminal, feature, selector or mixer unit in descriptor order taking this entity as a source. 0: none */
+    uint8_t vol_ch_map;                             /*!< Feature unit: logical channels with volume control */
+    uint8_t mute_ch_map;                            /*!< Feature unit: logical channels with mute control */
+    bool vol_range_valid;                           /*!< Feature unit: volume range was requested from the device */
+    int16_t vol_min_db;                             /*!< Feature unit: volume min with 1/256 db step */
+    int16_t vol_max_db;                             /*!< Feature unit: volume max with 1/256 db step */
+    int16_t vol_res_db;                             /*!< Feature unit: volume resolution with 1/256 db step */
+} uac_entity_t;
+
+/**
+ * @brief UAC Device structure.
+ *
+ */
+typedef struct uac_host_device {
+    // dynamic values after device opening, should be protected by critical section
+    STAILQ_ENTRY(uac_host_device) tailq_entry;      /*!< UAC device queue */
+    uint8_t opened_cnt;                             /*!< Device opened counter */
+    // constant values after device opening
+    usb_device_handle_t dev_hdl;                    /*!< USB device handle */
+    uint8_t addr;                                   /*!< USB device address */
+    SemaphoreHandle_t device_busy;                  /*!< UAC device main mutex */
+    SemaphoreHandle_t ctrl_xfer_done;               /*!< Control transfer semaphore */
+    usb_transfer_t *ctrl_xfer;                      /*!< Pointer to control transfer buffer */
+    uint8_t ctrl_iface_num;                         /*!< Control interface number */
+    uint16_t bcdADC;                                /*!< UAC version, UAC_VERSION_1 or UAC_VERSION_2 */
+    uint8_t *cs_ac_desc;                            /*!< Class-Specific Audio Control Interface descriptor */
+    uac_entity_t *entities;                         /*!< Audio control topology, entities in descriptor order */
+    uint8_t entity_num;                             /*!< Number of entities */
+    uint8_t entity_alloc_num;                       /*!< Number of allocated entities, IDs which are not unique are skipped */
+    uint8_t entity_idx[256];                        /*!< Index + 1 in entities of each entity ID, 0 if there is no such entity */
+} uac_device_t;
+
+/**
+ * @brief UAC Interface state
+*/
+typedef enum {
+    UAC_INTERFACE_STATE_NOT_INITIALIZED = 0x00,     /*!< UAC Interface not initialized */
+    UAC_INTERFACE_STATE_IDLE,                       /*!< UAC Interface has been opened but not started */
+    UAC_INTERFACE_STATE_READY,                      /*!< UAC Interface has started but stream is suspended */
+    UAC_INTERFACE_STATE_ACTIVE,                     /*!< UAC Interface is streaming */
+    UAC_INTERFACE_STATE_SUSPENDING,                 /*!< UAC Interface is suspending */
+} uac_iface_state_t;
+
+/**
+ * @brief UAC Interface alternate setting parameters
+ */
+typedef struct uac_interface_alt {
+    // variable only change by app operation, protected by mutex
+    uint32_t cur_sampling_freq;                /*!< current sampling frequency */
+    // constant values after interface opening
+    uint8_t alt_idx;                           /*!< audio stream alternate setting number */
+    uint8_t ep_addr;                           /*!< audio stream endpoint number */
+    uint16_t ep_mps;                           /*!< audio stream endpoint max size */
+    uint8_t ep_attr;                           /*!< audio stream endpoint attributes */
+    uint8_t interval;                          /*!< audio stream endpoint interval */
+    uint32_t packet_rate;                      /*!< packets per second, from the endpoint interval and bus speed */
+    uint8_t fb_ep_addr;                        /*!< feedback endpoint number, 0 if the endpoint is not asynchronous */
+    uint16_t fb_ep_mps;                        /*!< feedback endpoint max size */
+    uint8_t connected_terminal;                /*!< connected terminal ID */
+    uint8_t feature_unit;                      /*!< connected feature unit ID */
+    uint8_t vol_ch_map;                        /*!< volume channel map */
+    uint8_t mute_ch_map;                       /*!< mute channel map */
+    bool freq_ctrl_supported;                  /*!< sampling frequency control supported */
+    uint8_t clock_source;                      /*!< UAC 2.0 clock source ID */
+    uint8_t clock_selector;                    /*!< UAC 2.0 programmable clock selector ID on the path to the clock source, 0 if none */
+    uint8_t clock_selector_pin;                /*!< UAC 2.0 clock selector input pin of the clock source */
+    uac_host_dev_alt_param_t dev_alt_param;    /*!< audio stream alternate setting parameters */
+} uac_iface_alt_t;
+
+/**
+ * @brief Full-duplex stream pair, the speaker transfer callback records the sent samples as echo reference
+ */
+typedef struct uac_duplex {
+    uac_host_device_handle_t mic_handle;       /*!< RX stream */
+    uac_host_device_handle_t spk_handle;       /*!< TX stream */
+    uac_ring_t ref_ring;                       /*!< Sent speaker samples in the format of the transfers, written by the speaker transfer callback */
+    bool ref_ready;                            /*!< ref_ring is allocated, the samples sent before are counted as dropped */
+    uint32_t ref_dropped_frames;               /*!< Reference samples not recorded, written only by the speaker transfer callback */
+    uint32_t period_frames;                    /*!< Samples per channel of each block */
+    uint32_t mic_frame_size;                   /*!< Bytes of one sample of all channels in the microphone buffer */
+    uint32_t ref_frame_size;                   /*!< Bytes of one sample of all channels in the reference */
+    uint32_t mic_skip;                         /*!< Microphone samples to skip before the next block */
+    uint32_t ref_skip;                         /*!< Reference samples to skip before the next block */
+    uint32_t mic_dropped_seen;                 /*!< Microphone samples lost by RX overflow, already added to ref_skip */
+    uint32_t ref_dropped_seen;                 /*!< Reference samples dropped, already added to mic_skip */
+    uac_host_duplex_stats_t stats;             /*!< Alignment of the pair */
+} uac_duplex_t;
+
+/**
+ * @brief UAC Interface structure in device to interact with. After UAC device opening keeps the interface configuration
+ *
+ */
+typedef struct uac_interface {
+    // dynamic values after interface opening, should be protected by critical section
+    STAILQ_ENTRY(uac_interface) tailq_entry;
+    usb_transfer_t **xfer_list;                /*!< Pointer to transfer list */
+    usb_transfer_t **free_xfer_list;           /*!< Pointer to free transfer list */
+    uint32_t free_xfer_mask;                   /*!< Bit i set if free_xfer_list[i] is set, changed in critical section */
+    // variable only change by app operation, protected by mutex
+    SemaphoreHandle_t state_mutex;             /*!< UAC device state mutex */
+    uac_iface_state_t state;                   /*!< Interface state */
+    uint32_t flags;                            /*!< Interface flags */
+    bool suspended;                            /*!< Stream was suspended by bus suspend, it is resumed on bus resume */
+    uint8_t cur_alt;                           /*!< Current alternate setting (-1) */
+    uint8_t cur_vol;                           /*!< volume % 0-100 */
+    // constant parameters after interface opening
+    uac_device_t *parent;                      /*!< Parent USB UAC device */
+    uint8_t xfer_num;                          /*!< Number of transfers */
+    uint8_t packet_num;                        /*!< packets per transfer */
+    uint32_t packet_size;                      /*!< size of each packet */
+    uint32_t frame_size;                       /*!< size of one sample of all channels */
+    uint32_t packet_rate;                      /*!< packets per second of the current alternate setting */
+    uint32_t nominal_rate;                     /*!< samples per packet at the sampling frequency, 16.16 fixed point */
+    uint32_t rate_remainder;                   /*!< fraction of a sample carried to the next TX packet, 1/packet_rate or 16.16 fixed point with feedback */
+    uint32_t fb_rate;                          /*!< samples per packet requested by the feedback endpoint, 16.16 fixed point, 0 if none */
+    usb_transfer_t *fb_xfer;                   /*!< feedback endpoint transfer, NULL if the endpoint is not asynchronous */
+    uac_host_device_event_cb_t user_cb;        /*!< Interface application callback */
+    void *user_cb_arg;                         /*!< Interface application callback arg */
+    uac_host_rx_data_cb_t rx_data_cb;          /*!< RX data callback, the ring buffer is not used if set */
+    uac_host_rx_span_t *rx_spans;              /*!< Spans passed to rx_data_cb, one per packet */
+    uint32_t rx_span_num;                      /*!< Number of allocated rx_spans, transfers with fewer packets can reuse them */
+    uac_ring_t ringbuf;                        /*!< Ring buffer for audio data */
+    uac_stage_t stage;                         /*!< RX staging in internal RAM in front of ringbuf in PSRAM, used if stage.task is set */
+    uac_pcm_conv_t pcm;                        /*!< Sample conversion between the transfers and the ring buffer */
+    uac_host_stream_stats_t stats;             /*!< Stream statistics, written only by the transfer callbacks */
+    uac_host_stream_timing_t timing;           /*!< Stream timing, written by the transfer callbacks in critical section */
+    uac_duplex_t *duplex;                      /*!< Duplex pair recording the samples sent by this TX stream, NULL if none */
+    portMUX_TYPE tx_lock;                      /*!< Serializes TX reads from the ring buffer */
+    uint8_t tx_last_frame[UAC_TX_LAST_FRAME_MAX]; /*!< Last sent TX frame, repeated by FLAG_STREAM_TX_CONCEAL_REPEAT, protected by tx_lock */
+    uint32_t ringbuf_threshold;                /*!< Ring buffer threshold */
+    uac_host_dev_info_t dev_info;              /*!< USB device parameters */
+    int16_t vol_min_db;                        /*!< volume min with 1/256 db step */
+    int16_t vol_max_db;                        /*!< volume max with 1/256 db step */
+    int16_t vol_res_db;                        /*!< volume resolution with 1/256 db step */
+    uac_iface_alt_t *iface_alt;                /*!< audio stream alternate setting */
+} uac_iface_t;
+
+/**
+ * @brief Completion callback of the audio stream IN transfers
+ *
+ * @param[in] in_xfer  Completed transfer, its context is the interface
+ */
+void stream_rx_xfer_done(usb_transfer_t *in_xfer);
+
+/**
+ * @brief Completion callback of the audio stream OUT transfers
+ *
+ * @param[in] out_xfer  Completed transfer, its context is the interface
+ */
+void stream_tx_xfer_done(usb_transfer_t *out_xfer);
+
+#ifdef __cplusplus
+}
+#endif
@@ -532,6 +532,274 @@ exit_rx:
     free(rx_buffer);
 }
 
+/**
+ * @brief record the rx stream data from microphone without copying it out of the stream buffer
+ */
+TEST_CASE("test uac rx reading zero copy", "[uac_host][rx]")
+{
+    uint8_t mic_iface_num = 0;
+    uint8_t spk_iface_num = 0;
+    uint8_t if_rx = false;
+    test_handle_dev_connection(&mic_iface_num, &if_rx);
+    if (!if_rx) {
+        spk_iface_num = mic_iface_num;
+        test_handle_dev_connection(&mic_iface_num, &if_rx);
+        TEST_ASSERT_EQUAL(if_rx, true);
+    } else {
+        test_handle_dev_connection(&spk_iface_num, &if_rx);
+        TEST_ASSERT_EQUAL(if_rx, false);
+    }
+
+    const uint32_t buffer_threshold = 4800;
+    const uint32_t buffer_size = 19200;
+
+    uac_host_device_handle_t uac_device_handle = NULL;
+    test_open_mic_device(mic_iface_num, buffer_size, buffer_threshold, &uac_device_handle);
+
+    uac_host_dev_alt_param_t iface_alt_params;
+    TEST_ASSERT_EQUAL(ESP_OK, uac_host_get_device_alt_param(uac_device_handle, 1, &iface_alt_params));
+    const uac_host_stream_config_t stream_config = {
+        .channels = iface_alt_params.channels,
+        .bit_resolution = iface_alt_params.bit_resolution,
+        .sample_freq = iface_alt_params.sample_freq[0],
+        .latency_ms = 4,
+    };
+    uint8_t *data = NULL;
+    uint32_t data_size = 0;
+    uac_host_stream_latency_t latency = {0};
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, uac_host_device_read_acquire(uac_device_handle, &data, &data_size, 0));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, uac_host_device_get_latency(uac_device_handle, &latency));
+    TEST_ASSERT_EQUAL(ESP_OK, uac_host_device_start(uac_device_handle, &stream_config));
+    // 4 ms split to 3 transfers: 1 packet each, 4 transfers queued
+    TEST_ASSERT_EQUAL(ESP_OK, uac_host_device_get_latency(uac_device_handle, &latency));
+    TEST_ASSERT_EQUAL(1, latency.xfer_latency_ms);
+
+    // got 5s data, then stop the stream
+    const uint32_t timeout = 5000;
+    const uint32_t bytes_per_ms = iface_alt_params.channels * iface_alt_params.bit_resolution / 8 * iface_alt_params.sample_freq[0] / 1000;
+    uint32_t rx_total = 0;
+    event_queue_t evt_queue = {0};
+    ESP_LOGI(TAG, "Start reading data from MIC without copy");
+    while (rx_total / bytes_per_ms < timeout) {
+        if (xQueueReceive(s_event_queue, &evt_queue, portMAX_DELAY)) {
+            TEST_ASSERT_EQUAL(UAC_DEVICE_EVENT, evt_queue.event_group);
+            TEST_ASSERT_EQUAL(UAC_HOST_DEVICE_EVENT_RX_DONE, evt_queue.device_evt.event);
+            // The data may wrap around the end of the buffer, so it takes up to two spans
+            while (uac_host_device_read_acquire(uac_device_handle, &data, &data_size, 0) == ESP_OK) {
+                TEST_ASSERT_NOT_NULL(data);
+                TEST_ASSERT_GREATER_THAN(0, data_size);
+                TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, uac_host_device_read_release(uac_device_handle, buffer_size + 1));
+                TEST_ASSERT_EQUAL(ESP_OK, uac_host_device_read_release(uac_device_handle, data_size));
+                rx_total += data_size;
+            }
+        }
+    }
+    ESP_LOGI(TAG, "Stop reading data from MIC");
+    uac_host_stream_stats_t stats = {0};
+    TEST_ASSERT_EQUAL(ESP_OK, uac_host_device_get_stats(uac_device_handle, &stats));
+    ESP_LOGI(TAG, "RX overflow %"PRIu32" times, %"PRIu32" bytes, %"PRIu32" bad packets",
+             stats.rx_overflow_count, stats.rx_overflow_bytes, stats.rx_bad_packets);
+    uint32_t fill_total = 0;
+    for (int i = 0; i < UAC_HOST_STATS_FILL_BINS; i++) {
+        ESP_LOGI(TAG, "Buffer fill %d/%d: %"PRIu32, i, UAC_HOST_STATS_FILL_BINS, stats.fill_hist[i]);
+        fill_total += stats.fill_hist[i];
+    }
+    // the fill level is counted once per transfer
+    TEST_ASSERT_GREATER_THAN(0, fill_total);
+    TEST_ASSERT_EQUAL(0, stats.tx_underrun_count);
+    TEST_ASSERT_EQUAL(ESP_OK, uac_host_device_close(uac_device_handle));
+}
+
+/**
+ * @brief record the rx stream data from microphone, converted to mono 32 bit float
+ */
+TEST_CASE("test uac rx reading with pcm conversion", "[uac_host][rx]")
+{
+    uint8_t mic_iface_num = 0;
+    uint8_t spk_iface_num = 0;
+    uint8_t if_rx = false;
+    test_handle_dev_connection(&mic_iface_num, &if_rx);
+    if (!if_rx) {
+        spk_iface_num = mic_iface_num;
+        test_handle_dev_connection(&mic_iface_num, &if_rx);
+        TEST_ASSERT_EQUAL(if_rx, true);
+    } else {
+        test_handle_dev_connection(&spk_iface_num, &if_rx);
+        TEST_ASSERT_EQUAL(if_rx, false);
+    }
+
+    const uint32_t buffer_threshold = 4800;
+    const uint32_t buffer_size = 19200;
+
+    uac_host_device_handle_t uac_device_handle = NULL;
+    test_open_mic_device(mic_iface_num, buffer_size, buffer_threshold, &uac_device_handle);
+
+    uac_host_dev_alt_param_t iface_alt_params;
+    TEST_ASSERT_EQUAL(ESP_OK, uac_host_get_device_alt_param(uac_device_handle, 1, &iface_alt_params));
+    const uint8_t bad_map[1] = { iface_alt_params.channels };
+    uac_host_stream_config_t stream_config = {
+        .channels = iface_alt_params.channels,
+        .bit_resolution = iface_alt_params.bit_resolution,
+        .sample_freq = iface_alt_params.sample_freq[0],
+        .pcm_format = UAC_HOST_PCM_FORMAT_FLOAT,
+        .pcm_channels = 1,
+        .channel_map = bad_map,
+    };
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, uac_host_device_start(uac_device_handle, &stream_config));
+    // all channels are mixed down to one
+    const uint8_t mix_map[1] = { UAC_HOST_PCM_CHANNEL_MIX };
+    stream_config.channel_map = mix_map;
+    TEST_ASSERT_EQUAL(ESP_OK, uac_host_device_start(uac_device_handle, &stream_config));
+
+    // got about 1s data, then stop the stream
+    const uint32_t bytes_per_ms = sizeof(float) * iface_alt_params.sample_freq[0] / 1000;
+    float *rx_buffer = (float *)calloc(1, buffer_threshold);
+    TEST_ASSERT_NOT_NULL(rx_buffer);
+    uint32_t rx_size = 0;
+    uint32_t rx_total = 0;
+    event_queue_t evt_queue = {0};
+    ESP_LOGI(TAG, "Start reading converted data from MIC");
+    while (rx_total / bytes_per_ms < 1000) {
+        if (xQueueReceive(s_event_queue, &evt_queue, portMAX_DELAY)) {
+            TEST_ASSERT_EQUAL(UAC_DEVICE_EVENT, evt_queue.event_group);
+            TEST_ASSERT_EQUAL(UAC_HOST_DEVICE_EVENT_RX_DONE, evt_queue.device_evt.event);
+            TEST_ASSERT_EQUAL(ESP_OK, uac_host_device_read(uac_device_handle, (uint8_t *)rx_buffer, buffer_threshold, &rx_size, 0));
+            TEST_ASSERT_EQUAL(0, rx_size % sizeof(float));
+            for (int i = 0; i < rx_size / sizeof(float); i++) {
+                TEST_ASSERT(rx_buffer[i] >= -1.0f && rx_buffer[i] < 1.0f);
+            }
+            rx_total += rx_size;
+        }
+    }
+    ESP_LOGI(TAG, "Stop reading data from MIC");
+    TEST_ASSERT_EQUAL(ESP_OK, uac_host_device_close(uac_device_handle));
+    free(rx_buffer);
+}
+
+static void test_rx_data_callback(uac_host_device_handle_t uac_device_handle, const uac_host_rx_span_t *spans, size_t num_spans, void *arg)
+{
+    uint32_t *rx_total = (uint32_t *)arg;
+    for (size_t i = 0; i < num_spans; i++) {
+        assert(spans[i].data && spans[i].len);
+        *rx_total += spans[i].len;
+    }
+}
+
+/**
+ * @brief receive the rx stream data from microphone in the transfer callback, bypassing the stream buffer
+ */
+TEST_CASE("test uac rx data callback", "[uac_host][rx]")
+{
+    uint8_t mic_iface_num = 0;
+    uint8_t spk_iface_num = 0;
+    uint8_t if_rx = false;
+    test_handle_dev_connection(&mic_iface_num, &if_rx);
+    if (!if_rx) {
+        spk_iface_num = mic_iface_num;
+        test_handle_dev_connection(&mic_iface_num, &if_rx);
+        TEST_ASSERT_EQUAL(if_rx, true);
+    } else {
+        test_handle_dev_connection(&spk_iface_num, &if_rx);
+        TEST_ASSERT_EQUAL(if_rx, false);
+    }
+
+    volatile uint32_t rx_total = 0;
+    uac_host_device_config_t dev_config = {
+        .addr = 1,
+        .iface_num = spk_iface_num,
+        .callback = uac_device_callback,
+        .callback_arg = (void *) &rx_total,
+        .rx_data_cb = test_rx_data_callback,
+    };
+    uac_host_device_handle_t uac_device_handle = NULL;
+    // only the RX stream can bypass the stream buffer
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, uac_host_device_open(&dev_config, &uac_device_handle));
+    dev_config.iface_num = mic_iface_num;
+    TEST_ASSERT_EQUAL(ESP_OK, uac_host_device_open(&dev_config, &uac_device_handle));
+
+    uac_host_dev_alt_param_t iface_alt_params;
+    TEST_ASSERT_EQUAL(ESP_OK, uac_host_get_device_alt_param(uac_device_handle, 1, &iface_alt_params));
+    const uac_host_stream_config_t stream_config = {
+        .channels = iface_alt_params.channels,
+        .bit_resolution = iface_alt_params.bit_resolution,
+        .sample_freq = iface_alt_params.sample_freq[0],
+        .packets_per_xfer = 1,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, uac_host_device_start(uac_device_handle, &stream_config));
+    uint8_t data[16];
+    uint32_t bytes_read = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, uac_host_device_read(uac_device_handle, data, sizeof(data), &bytes_read, 0));
+
+    // got about 1s data, then stop the stream
+    const uint32_t bytes_per_ms = iface_alt_params.channels * iface_alt_params.bit_resolution / 8 * iface_alt_params.sample_freq[0] / 1000;
+    ESP_LOGI(TAG, "Start receiving data from MIC in callback");
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    TEST_ASSERT_EQUAL(ESP_OK, uac_host_device_stop(uac_device_handle));
+    ESP_LOGI(TAG, "Received %"PRIu32" bytes from MIC", rx_total);
+    TEST_ASSERT_UINT32_WITHIN(100 * bytes_per_ms, 1000 * bytes_per_ms, rx_total);
+    TEST_ASSERT_EQUAL(ESP_OK, uac_host_device_close(uac_device_handle));
+}
+
+/**
+ * @brief start the microphone and speaker streams together and check the timing of the microphone stream
+ */
+TEST_CASE("test uac group start", "[uac_host][tx][rx]")
+{
+    uint8_t mic_iface_num = 0;
+    uint8_t spk_iface_num = 0;
+    uint8_t if_rx = false;
+    test_handle_dev_connection(&mic_iface_num, &if_rx);
+    if (!if_rx) {
+        spk_iface_num = mic_iface_num;
+        test_handle_dev_connection(&mic_iface_num, &if_rx);
+        TEST_ASSERT_EQUAL(if_rx, true);
+    } else {
+        test_handle_dev_connection(&spk_iface_num, &if_rx);
+        TEST_ASSERT_EQUAL(if_rx, false);
+    }
+
+    // the microphone data are counted in the callback, so no RX events are queued
+    volatile uint32_t rx_total = 0;
+    const uac_host_device_config_t mic_config = {
+        .addr = 1,
+        .iface_num = mic_iface_num,
+        .callback = uac_device_callback,
+        .callback_arg = (void *) &rx_total,
+        .rx_data_cb = test_rx_data_callback,
+    };
+    uac_host_device_handle_t handles[2] = { NULL };
+    TEST_ASSERT_EQUAL(ESP_OK, uac_host_device_open(&mic_config, &handles[0]));
+    test_open_spk_device(spk_iface_num, 19200, 4800, &handles[1]);
+
+    uac_host_stream_config_t stream_configs[2] = { 0 };
+    for (int i = 0; i < 2; i++) {
+        uac_host_dev_alt_param_t iface_alt_params;
+        TEST_ASSERT_EQUAL(ESP_OK, uac_host_get_device_alt_param(handles[i], 1, &iface_alt_params));
+        stream_configs[i].channels = iface_alt_params.channels;
+        stream_configs[i].bit_resolution = iface_alt_params.bit_resolution;
+        stream_configs[i].sample_freq = iface_alt_params.sample_freq[0];
+    }
+    uac_host_stream_timing_t timing = {0};
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, uac_host_device_get_timing(handles[0], &timing));
+    TEST_ASSERT_EQUAL(ESP_OK, uac_host_device_start_group(handles, stream_configs, 2));
+    // started streams can not be started again as a group
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, uac_host_device_start_group(handles, stream_configs, 1));
+
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    TEST_ASSERT_EQUAL(ESP_OK, uac_host_device_get_timing(handles[0], &timing));
+    ESP_LOGI(TAG, "MIC %"PRIu64" packets, %"PRIu64" samples since %"PRId64" us, drift %"PRId32" ppm",
+             timing.packet_count, timing.sample_count, timing.start_time_us, timing.drift_ppm);
+    TEST_ASSERT_GREATER_THAN(0, timing.start_time_us);
+    TEST_ASSERT_GREATER_OR_EQUAL(timing.start_time_us, timing.last_time_us);
+    TEST_ASSERT_UINT32_WITHIN(stream_configs[0].sample_freq / 10, stream_configs[0].sample_freq, timing.sample_count);
+    TEST_ASSERT_INT32_WITHIN(10000, 0, timing.drift_ppm);
+
+    for (int i = 0; i < 2; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, uac_host_device_stop(handles[i]));
+        TEST_ASSERT_EQUAL(ESP_OK, uac_host_device_close(handles[i]));
+    }
+}
+
 /**
  * @brief playback the wav sound to speaker, the wav will be down-sampled
  * if the device's sample frequency is not matched
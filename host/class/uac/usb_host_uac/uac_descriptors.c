@@ -49,6 +49,11 @@ static void print_ep_desc(const usb_ep_desc_t *ep_desc)
     printf("\t\tbmAttributes 0x%x\t%s\n", ep_desc->bmAttributes, ep_type_str);
     printf("\t\twMaxPacketSize %d\n", USB_EP_DESC_GET_MPS(ep_desc));
     printf("\t\tbInterval %d\n", ep_desc->bInterval);
+    if (ep_desc->bLength >= sizeof(uac_as_std_ep_desc_t)) {
+        const uac_as_std_ep_desc_t *as_ep_desc = (const uac_as_std_ep_desc_t *)ep_desc;
+        printf("\t\tbRefresh %d\n", as_ep_desc->bRefresh);
+        printf("\t\tbSynchAddress 0x%x\n", as_ep_desc->bSynchAddress);
+    }
 }
 
 static void usbh_print_intf_desc(const usb_intf_desc_t *intf_desc)
@@ -355,3 +360,35 @@ void print_uac_descriptors(const usb_config_desc_t *cfg_desc)
 {
     usb_print_config_descriptor_with_context(cfg_desc, print_uac_class_descriptors);
 }
+
+// ----------------------------------------------- Descriptor Parsing --------------------------------------------------
+
+const usb_ep_desc_t *uac_find_feedback_ep_desc(const usb_config_desc_t *cfg_desc, const usb_intf_desc_t *alt_desc,
+                                               const usb_ep_desc_t *data_ep_desc)
+{
+    if ((data_ep_desc->bmAttributes & USB_BM_ATTRIBUTES_SYNCTYPE_MASK) != USB_BM_ATTRIBUTES_SYNC_ASYNC) {
+        return NULL;
+    }
+    // UAC 1.0 links the synch endpoint by bSynchAddress, devices without it mark the endpoint by its usage type
+    uint8_t synch_addr = 0;
+    if (data_ep_desc->bLength >= sizeof(uac_as_std_ep_desc_t)) {
+        synch_addr = ((const uac_as_std_ep_desc_t *)data_ep_desc)->bSynchAddress;
+    }
+    // Offset of the alternate setting in the configuration descriptor
+    int offset = (const uint8_t *)alt_desc - (const uint8_t *)cfg_desc;
+    const usb_standard_desc_t *next_desc = usb_parse_next_descriptor((const usb_standard_desc_t *)alt_desc,
+                                           cfg_desc->wTotalLength, &offset);
+    // Only the endpoints of the same alternate setting
+    while (next_desc != NULL && next_desc->bDescriptorType != USB_B_DESCRIPTOR_TYPE_INTERFACE) {
+        if (next_desc->bDescriptorType == USB_B_DESCRIPTOR_TYPE_ENDPOINT) {
+            const usb_ep_desc_t *ep_desc = (const usb_ep_desc_t *)next_desc;
+            const bool is_feedback = synch_addr ? (ep_desc->bEndpointAddress == synch_addr) :
+                                     ((ep_desc->bmAttributes & USB_BM_ATTRIBUTES_USAGETYPE_MASK) == USB_BM_ATTRIBUTES_USAGE_FEEDBACK);
+            if (is_feedback && ep_desc != data_ep_desc && USB_EP_DESC_GET_EP_DIR(ep_desc)) {
+                return ep_desc;
+            }
+        }
+        next_desc = usb_parse_next_descriptor(next_desc, cfg_desc->wTotalLength, &offset);
+    }
+    return NULL;
+}
@@ -19,10 +19,22 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
-#include "freertos/ringbuf.h"
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_timer.h"
+#endif
 #include "usb/usb_host.h"
 #include "usb/uac_host.h"
 #include "usb/usb_types_ch9.h"
+#include "uac_ring_priv.h"
+#include "uac_types_priv.h"
+#if USB_HOST_SHARED_CLIENT_ENABLED
+#define USB_HOST_CLIENT_DRIVER  UAC
+#include "usb/usb_host_client_macros.h"
+#else
+#include "usb_host_client_fallback.h"
+#endif
 
 // UAC spinlock
 static portMUX_TYPE uac_lock = portMUX_INITIALIZER_UNLOCKED;
@@ -83,87 +95,6 @@ static const char *TAG = "uac-host";
 #define VOLUME_DB_MIN                       (-127.9961f)
 #define VOLUME_DB_MAX                       (127.9961f)
 
-/**
- * @brief UAC Device structure.
- *
- */
-typedef struct uac_host_device {
-    // dynamic values after device opening, should be protected by critical section
-    STAILQ_ENTRY(uac_host_device) tailq_entry;      /*!< UAC device queue */
-    uint8_t opened_cnt;                             /*!< Device opened counter */
-    // constant values after device opening
-    usb_device_handle_t dev_hdl;                    /*!< USB device handle */
-    uint8_t addr;                                   /*!< USB device address */
-    SemaphoreHandle_t device_busy;                  /*!< UAC device main mutex */
-    SemaphoreHandle_t ctrl_xfer_done;               /*!< Control transfer semaphore */
-    usb_transfer_t *ctrl_xfer;                      /*!< Pointer to control transfer buffer */
-    uint8_t ctrl_iface_num;                         /*!< Control interface number */
-    uint8_t *cs_ac_desc;                            /*!< Class-Specific Audio Control Interface descriptor */
-} uac_device_t;
-
-/**
- * @brief UAC Interface state
-*/
-typedef enum {
-    UAC_INTERFACE_STATE_NOT_INITIALIZED = 0x00,     /*!< UAC Interface not initialized */
-    UAC_INTERFACE_STATE_IDLE,                       /*!< UAC Interface has been opened but not started */
-    UAC_INTERFACE_STATE_READY,                      /*!< UAC Interface has started but stream is suspended */
-    UAC_INTERFACE_STATE_ACTIVE,                     /*!< UAC Interface is streaming */
-    UAC_INTERFACE_STATE_SUSPENDING,                 /*!< UAC Interface is suspending */
-} uac_iface_state_t;
-
-/**
- * @brief UAC Interface alternate setting parameters
- */
-typedef struct uac_interface_alt {
-    // variable only change by app operation, protected by mutex
-    uint32_t cur_sampling_freq;                /*!< current sampling frequency */
-    // constant values after interface opening
-    uint8_t alt_idx;                           /*!< audio stream alternate setting number */
-    uint8_t ep_addr;                           /*!< audio stream endpoint number */
-    uint16_t ep_mps;                           /*!< audio stream endpoint max size */
-    uint8_t ep_attr;                           /*!< audio stream endpoint attributes */
-    uint8_t interval;                          /*!< audio stream endpoint interval */
-    uint8_t connected_terminal;                /*!< connected terminal ID */
-    uint8_t feature_unit;                      /*!< connected feature unit ID */
-    uint8_t vol_ch_map;                        /*!< volume channel map */
-    uint8_t mute_ch_map;                       /*!< mute channel map */
-    bool freq_ctrl_supported;                  /*!< sampling frequency control supported */
-    uac_host_dev_alt_param_t dev_alt_param;    /*!< audio stream alternate setting parameters */
-} uac_iface_alt_t;
-
-/**
- * @brief UAC Interface structure in device to interact with. After UAC device opening keeps the interface configuration
- *
- */
-typedef struct uac_interface {
-    // dynamic values after interface opening, should be protected by critical section
-    STAILQ_ENTRY(uac_interface) tailq_entry;
-    usb_transfer_t **xfer_list;                /*!< Pointer to transfer list */
-    usb_transfer_t **free_xfer_list;           /*!< Pointer to free transfer list */
-    // variable only change by app operation, protected by mutex
-    SemaphoreHandle_t state_mutex;             /*!< UAC device state mutex */
-    uac_iface_state_t state;                   /*!< Interface state */
-    uint32_t flags;                            /*!< Interface flags */
-    uint8_t cur_alt;                           /*!< Current alternate setting (-1) */
-    uint8_t cur_vol;                           /*!< volume % 0-100 */
-    // constant parameters after interface opening
-    uac_device_t *parent;                      /*!< Parent USB UAC device */
-    uint8_t xfer_num;                          /*!< Number of transfers */
-    uint8_t packet_num;                        /*!< packets per transfer */
-    uint32_t packet_size;                      /*!< size of each packet */
-    uac_host_device_event_cb_t user_cb;        /*!< Interface application callback */
-    void *user_cb_arg;                         /*!< Interface application callback arg */
-    RingbufHandle_t ringbuf;                   /*!< Ring buffer for audio data */
-    uint32_t ringbuf_size;                     /*!< Ring buffer size */
-    uint32_t ringbuf_threshold;                /*!< Ring buffer threshold */
-    uac_host_dev_info_t dev_info;              /*!< USB device parameters */
-    int16_t vol_min_db;                        /*!< volume min with 1/256 db step */
-    int16_t vol_max_db;                        /*!< volume max with 1/256 db step */
-    int16_t vol_res_db;                        /*!< volume resolution with 1/256 db step */
-    uac_iface_alt_t *iface_alt;                /*!< audio stream alternate setting */
-} uac_iface_t;
-
 /**
  * @brief UAC driver default context
  *
@@ -176,6 +107,7 @@ typedef struct {
     volatile bool end_client_event_handling;                    /*!< Client event handling flag */
     // constant values after UAC Host initialization
     bool event_handling_started;                                /*!< Events handler started flag */
+    bool shared_client;                                         /*!< Registered to usb_host_shared_client, which handles the events */
     usb_host_client_handle_t client_handle;                     /*!< Client task handle */
     uac_host_driver_event_cb_t user_cb;                         /*!< User application callback */
     void *user_arg;                                             /*!< User application callback args */
@@ -202,6 +134,9 @@ static esp_err_t _uac_host_device_add(uint8_t addr, usb_device_handle_t dev_hdl,
 static esp_err_t _uac_host_device_delete(uac_device_t *uac_device);
 static esp_err_t uac_cs_request_set(uac_device_t *uac_device, const uac_cs_request_t *req);
 static esp_err_t uac_cs_request_set_ep_frequency(uac_iface_t *iface, uint8_t ep_addr, uint32_t freq);
+static esp_err_t uac2_cs_request_set_clock(uac_iface_t *iface);
+static esp_err_t uac2_cs_request_get_freq_range(uac_iface_t *iface, uac_iface_alt_t *iface_alt);
+static esp_err_t uac_host_interface_submit_tx(uac_iface_t *iface);
 
 // --------------------------- Utility Functions --------------------------------
 /**
@@ -230,72 +165,15 @@ static int16_t _volume_db_f_2_i16(float volume_db_f)
     return (int16_t)(volume_db_f * 256);
 }
 
-// --------------------------- Buffer Management --------------------------------
-static size_t _ring_buffer_get_len(RingbufHandle_t ringbuf_hdl)
-{
-    assert(ringbuf_hdl);
-    size_t size = 0;
-    vRingbufferGetInfo(ringbuf_hdl, NULL, NULL, NULL, NULL, &size);
-    return size;
-}
-
-static void _ring_buffer_flush(RingbufHandle_t ringbuf_hdl)
-{
-    assert(ringbuf_hdl);
-    size_t read_bytes = 0;
-    size_t uxItemsWaiting = 0;
-    vRingbufferGetInfo(ringbuf_hdl, NULL, NULL, NULL, NULL, &uxItemsWaiting);
-    uint8_t *buf_rcv = xRingbufferReceiveUpTo(ringbuf_hdl, &read_bytes, 0, uxItemsWaiting);
-
-    if (buf_rcv) {
-        vRingbufferReturnItem(ringbuf_hdl, (void *)(buf_rcv));
-    }
-
-    if (uxItemsWaiting > read_bytes) {
-        // read the second time to flush all data
-        vRingbufferGetInfo(ringbuf_hdl, NULL, NULL, NULL, NULL, &uxItemsWaiting);
-        buf_rcv = xRingbufferReceiveUpTo(ringbuf_hdl, &read_bytes, 0, uxItemsWaiting);
-        if (buf_rcv) {
-            vRingbufferReturnItem(ringbuf_hdl, (void *)(buf_rcv));
-        }
-    }
-}
-
-static esp_err_t _ring_buffer_push(RingbufHandle_t ringbuf_hdl, uint8_t *buf, size_t write_bytes, TickType_t xTicksToWait)
-{
-    assert(ringbuf_hdl && buf);
-    int res = xRingbufferSend(ringbuf_hdl, buf, write_bytes, xTicksToWait);
-
-    if (res != pdTRUE) {
-        ESP_LOGD(TAG, "buffer is too small, push failed");
-        return ESP_FAIL;
-    }
-    return ESP_OK;
-}
-
-static esp_err_t _ring_buffer_pop(RingbufHandle_t ringbuf_hdl, uint8_t *buf, size_t req_bytes, size_t *read_bytes, TickType_t ticks_to_wait)
+/**
+ * @brief Size of one frame in the ring buffer of the interface
+ */
+static inline uint32_t _uac_ring_frame_size(const uac_iface_t *iface)
 {
-    assert(ringbuf_hdl && buf && read_bytes);
-    uint8_t *buf_rcv = xRingbufferReceiveUpTo(ringbuf_hdl, read_bytes, ticks_to_wait, req_bytes);
-
-    if (!buf_rcv) {
-        return ESP_FAIL;
+    if (!iface->pcm.enabled) {
+        return iface->frame_size;
     }
-
-    memcpy(buf, buf_rcv, *read_bytes);
-    vRingbufferReturnItem(ringbuf_hdl, (void *)(buf_rcv));
-
-    size_t read_bytes2 = 0;
-    if (*read_bytes < req_bytes) {
-        buf_rcv = xRingbufferReceiveUpTo(ringbuf_hdl, &read_bytes2, 0, req_bytes - *read_bytes);
-        if (buf_rcv) {
-            memcpy(buf + *read_bytes, buf_rcv, read_bytes2);
-            *read_bytes += read_bytes2;
-            vRingbufferReturnItem(ringbuf_hdl, (void *)(buf_rcv));
-        }
-    }
-
-    return ESP_OK;
+    return iface->dev_info.type == UAC_STREAM_RX ? iface->pcm.dst_frame_size : iface->pcm.src_frame_size;
 }
 
 /**
@@ -492,7 +370,9 @@ static inline void uac_host_user_interface_callback(uac_iface_t *uac_iface, cons
     assert(uac_iface);
     // user callback should never block
     if (uac_iface->user_cb) {
+        CLIENT_TRACE(CALLBACK_ENTER, 0, 0, uac_iface);
         uac_iface->user_cb(uac_iface, event, uac_iface->user_cb_arg);
+        CLIENT_TRACE(CALLBACK_EXIT, 0, 0, uac_iface);
     }
 }
 
@@ -550,138 +430,253 @@ static inline esp_err_t uac_host_interface_unlock(uac_iface_t *iface)
     return (xSemaphoreGive(iface->state_mutex) ? ESP_OK : ESP_FAIL);
 }
 
-static uint8_t _uac_next_linked_uint_id(const uint8_t *desc, uint8_t unit_id, uint8_t **feat_desc)
+/**
+ * @brief Get the total length of the class-specific AC descriptors, the header layout depends on the UAC version
+ *
+ * @param[in] desc  Pointer to the class-specific AC header descriptor
+ * @return Total length of the header and the unit and terminal descriptors
+ */
+static size_t _uac_ac_total_length(const uint8_t *desc)
 {
-    *feat_desc = NULL;
-    if (!desc) {
-        return 0;
+    const uac_ac_header_desc_t *header_desc = (const uac_ac_header_desc_t *)desc;
+    if (header_desc->bcdADC >= UAC_VERSION_2) {
+        return ((const uac2_ac_header_desc_t *)desc)->wTotalLength;
     }
-    uac_ac_header_desc_t *header_desc = (uac_ac_header_desc_t *)desc;
-    const size_t total_length = header_desc->wTotalLength;
-    int uac_desc_offset = 0;
-    const uac_desc_header_t *uac_cs_desc = (const uac_desc_header_t *)header_desc;
-    while (uac_cs_desc) {
-        switch (uac_cs_desc->bDescriptorSubtype) {
-        case UAC_AC_HEADER:
-        case UAC_AC_INPUT_TERMINAL:
-            break;
-        case UAC_AC_OUTPUT_TERMINAL: {
-            const uac_ac_output_terminal_desc_t *output_terminal_desc = (const uac_ac_output_terminal_desc_t *)uac_cs_desc;
-            if (output_terminal_desc->bSourceID == unit_id) {
-                return output_terminal_desc->bTerminalID;
-            }
-            break;
-        }
-        case UAC_AC_FEATURE_UNIT: {
-            const uac_ac_feature_unit_desc_t *feature_unit_desc = (const uac_ac_feature_unit_desc_t *)uac_cs_desc;
-            if (feature_unit_desc->bSourceID == unit_id) {
-                *feat_desc = (uint8_t *)feature_unit_desc;
-                return feature_unit_desc->bUnitID;
+    return header_desc->wTotalLength;
+}
+
+/**
+ * @brief Get the entity of the audio control topology by its ID
+ *
+ * @param[in] uac_device  Pointer to UAC device structure
+ * @param[in] entity_id   Terminal, unit or clock ID
+ * @return Pointer to the entity, NULL if not found
+ */
+static uac_entity_t *_uac_topology_get(const uac_device_t *uac_device, uint8_t entity_id)
+{
+    const uint8_t idx = uac_device->entity_idx[entity_id];
+    return idx ? &uac_device->entities[idx - 1] : NULL;
+}
+
+/**
+ * @brief Parse the volume and mute controls of each channel of a feature unit
+ *
+ * @param[in]    bcdADC  UAC version
+ * @param[inout] entity  Feature unit entity
+ */
+static void _uac_topology_parse_feature_unit(uint16_t bcdADC, uac_entity_t *entity)
+{
+    const uac_ac_feature_unit_desc_t *feature_unit_desc = (const uac_ac_feature_unit_desc_t *)entity->desc;
+    if (bcdADC >= UAC_VERSION_2) {
+        // UAC 2.0 has 4 bytes of controls per channel, 2 bits per control
+        const uint8_t *bma_controls = entity->desc + 5;
+        for (size_t ch_num = 0; feature_unit_desc->bLength >= 6 && ch_num < (feature_unit_desc->bLength - 6) / 4 && ch_num < 8; ch_num++) {
+            const uint32_t controls = bma_controls[ch_num * 4] | (bma_controls[ch_num * 4 + 1] << 8);
+            if (UAC2_CONTROL_ACCESS(controls, UAC2_FU_CONTROL_IDX_VOLUME) == UAC2_CONTROL_PROGRAMMABLE) {
+                entity->vol_ch_map |= (1 << ch_num);
             }
-            break;
-        }
-        case UAC_AC_SELECTOR_UNIT: {
-            const uac_ac_selector_unit_desc_t *selector_unit_desc = (const uac_ac_selector_unit_desc_t *)uac_cs_desc;
-            for (int i = 0; i < selector_unit_desc->bNrInPins; i++) {
-                if (selector_unit_desc->baSourceID[i] == unit_id) {
-                    return selector_unit_desc->bUnitID;
-                }
+            if (UAC2_CONTROL_ACCESS(controls, UAC2_FU_CONTROL_IDX_MUTE) == UAC2_CONTROL_PROGRAMMABLE) {
+                entity->mute_ch_map |= (1 << ch_num);
             }
-            break;
         }
-        case UAC_AC_MIXER_UNIT: {
-            const uac_ac_mixer_unit_desc_t *mixer_unit_desc = (const uac_ac_mixer_unit_desc_t *)uac_cs_desc;
-            for (int i = 0; i < mixer_unit_desc->bNrInPins; i++) {
-                if (mixer_unit_desc->baSourceID[i] == unit_id) {
-                    return mixer_unit_desc->bUnitID;
-                }
-            }
-            break;
+        return;
+    }
+    if (!feature_unit_desc->bControlSize || feature_unit_desc->bLength < 7) {
+        return;
+    }
+    for (size_t ch_num = 0; ch_num < (feature_unit_desc->bLength - 7) / feature_unit_desc->bControlSize && ch_num < 8; ch_num++) {
+        if (feature_unit_desc->bmaControls[ch_num * feature_unit_desc->bControlSize] & UAC_FU_CONTROL_POS_VOLUME) {
+            entity->vol_ch_map |= (1 << ch_num);
         }
-        default:
-            ESP_LOGD(TAG, "UAC Unknown Descriptor Subtype %d", uac_cs_desc->bDescriptorSubtype);
-            break;
+        if (feature_unit_desc->bmaControls[ch_num * feature_unit_desc->bControlSize] & UAC_FU_CONTROL_POS_MUTE) {
+            entity->mute_ch_map |= (1 << ch_num);
         }
-        uac_cs_desc = (uac_desc_header_t *)GET_NEXT_DESC(uac_cs_desc, total_length, uac_desc_offset);
     }
-    return 0;
 }
 
-static uint8_t _uac_last_linked_uint_id(const uint8_t *desc, uint8_t unit_id, uint8_t **feat_desc)
+/**
+ * @brief Link an entity to its sink, the first unit or terminal in descriptor order taking it as a source
+ */
+static void _uac_topology_link(uac_device_t *uac_device, uint8_t source_id, uint8_t sink_id)
 {
-    *feat_desc = NULL;
-    if (!desc) {
-        return 0;
+    uac_entity_t *source = _uac_topology_get(uac_device, source_id);
+    if (source && !source->sink) {
+        source->sink = sink_id;
     }
-    uac_ac_header_desc_t *header_desc = (uac_ac_header_desc_t *)desc;
-    const size_t total_length = header_desc->wTotalLength;
+}
+
+/**
+ * @brief Build the audio control topology from the class-specific AC descriptors, once when the device is added
+ *
+ * Every terminal, unit and clock is indexed by its ID. Terminals and units on the audio path are linked
+ * to their first source and to their first sink, feature units get their volume and mute channel maps.
+ * The descriptors are not walked again while interfaces are added or controlled.
+ *
+ * @param[in] uac_device  Pointer to UAC device structure, cs_ac_desc is set
+ * @return ESP_OK or ESP_ERR_NO_MEM
+ */
+static esp_err_t _uac_topology_build(uac_device_t *uac_device)
+{
+    const uint8_t *header_desc = uac_device->cs_ac_desc;
+    const size_t total_length = _uac_ac_total_length(header_desc);
     int uac_desc_offset = 0;
+    size_t entity_num = 0;
+    // The ID of every entity follows the descriptor subtype
     const uac_desc_header_t *uac_cs_desc = (const uac_desc_header_t *)header_desc;
     while (uac_cs_desc) {
-        switch (uac_cs_desc->bDescriptorSubtype) {
-        case UAC_AC_HEADER:
-        case UAC_AC_INPUT_TERMINAL:
-            break;
-        case UAC_AC_OUTPUT_TERMINAL: {
-            const uac_ac_output_terminal_desc_t *output_terminal_desc = (const uac_ac_output_terminal_desc_t *)uac_cs_desc;
-            if (output_terminal_desc->bTerminalID == unit_id) {
-                return output_terminal_desc->bSourceID;
+        if (uac_cs_desc->bDescriptorSubtype != UAC_AC_HEADER && uac_cs_desc->bLength > 3 && ((const uint8_t *)uac_cs_desc)[3]) {
+            entity_num++;
+        }
+        uac_cs_desc = (const uac_desc_header_t *)GET_NEXT_DESC(uac_cs_desc, total_length, uac_desc_offset);
+    }
+    if (!entity_num) {
+        return ESP_OK;
+    }
+    uac_device->entities = UAC_CALLOC(DESCRIPTOR, entity_num, sizeof(uac_entity_t));
+    UAC_RETURN_ON_FALSE(uac_device->entities, ESP_ERR_NO_MEM, "Unable to allocate memory for UAC topology");
+    uac_device->entity_alloc_num = entity_num;
+
+    uac_desc_offset = 0;
+    uac_cs_desc = (const uac_desc_header_t *)header_desc;
+    while (uac_cs_desc && uac_device->entity_num < entity_num) {
+        const uint8_t *desc = (const uint8_t *)uac_cs_desc;
+        if (uac_cs_desc->bDescriptorSubtype != UAC_AC_HEADER && uac_cs_desc->bLength > 3 && desc[3]) {
+            if (uac_device->entity_idx[desc[3]]) {
+                ESP_LOGW(TAG, "UAC entity ID %d is not unique", desc[3]);
+            } else {
+                uac_entity_t *entity = &uac_device->entities[uac_device->entity_num++];
+                uac_device->entity_idx[desc[3]] = uac_device->entity_num;
+                entity->desc = desc;
+                entity->id = desc[3];
+                entity->subtype = uac_cs_desc->bDescriptorSubtype;
             }
-            break;
         }
-        case UAC_AC_FEATURE_UNIT: {
-            const uac_ac_feature_unit_desc_t *feature_unit_desc = (const uac_ac_feature_unit_desc_t *)uac_cs_desc;
-            if (feature_unit_desc->bUnitID == unit_id) {
-                *feat_desc = (uint8_t *)feature_unit_desc;
-                return feature_unit_desc->bSourceID;
+        uac_cs_desc = (const uac_desc_header_t *)GET_NEXT_DESC(uac_cs_desc, total_length, uac_desc_offset);
+    }
+
+    for (int i = 0; i < uac_device->entity_num; i++) {
+        uac_entity_t *entity = &uac_device->entities[i];
+        const uint8_t length = entity->desc[0];
+        switch (entity->subtype) {
+        case UAC_AC_OUTPUT_TERMINAL:
+            if (length > offsetof(uac_ac_output_terminal_desc_t, bSourceID)) {
+                entity->source = ((const uac_ac_output_terminal_desc_t *)entity->desc)->bSourceID;
+                _uac_topology_link(uac_device, entity->source, entity->id);
             }
             break;
-        }
-        case UAC_AC_SELECTOR_UNIT: {
-            const uac_ac_selector_unit_desc_t *selector_unit_desc = (const uac_ac_selector_unit_desc_t *)uac_cs_desc;
-            if (selector_unit_desc->bUnitID == unit_id) {
-                // for basic audio device, the first source should be microphone
-                return selector_unit_desc->baSourceID[0];
+        case UAC_AC_FEATURE_UNIT:
+            if (length > offsetof(uac_ac_feature_unit_desc_t, bSourceID)) {
+                entity->source = ((const uac_ac_feature_unit_desc_t *)entity->desc)->bSourceID;
+                _uac_topology_link(uac_device, entity->source, entity->id);
+                _uac_topology_parse_feature_unit(uac_device->bcdADC, entity);
             }
             break;
-        }
+        case UAC_AC_SELECTOR_UNIT:
         case UAC_AC_MIXER_UNIT: {
-            const uac_ac_mixer_unit_desc_t *mixer_unit_desc = (const uac_ac_mixer_unit_desc_t *)uac_cs_desc;
-            if (mixer_unit_desc->bUnitID == unit_id) {
-                return mixer_unit_desc->baSourceID[0];
+            // the layout of the source pins is the same for selector and mixer units
+            const uac_ac_selector_unit_desc_t *unit_desc = (const uac_ac_selector_unit_desc_t *)entity->desc;
+            if (length > offsetof(uac_ac_selector_unit_desc_t, bNrInPins) && unit_desc->bNrInPins &&
+                    length >= offsetof(uac_ac_selector_unit_desc_t, baSourceID) + unit_desc->bNrInPins) {
+                // for basic audio device, the first source should be microphone
+                entity->source = unit_desc->baSourceID[0];
+                for (int pin = 0; pin < unit_desc->bNrInPins; pin++) {
+                    _uac_topology_link(uac_device, unit_desc->baSourceID[pin], entity->id);
+                }
             }
             break;
         }
         default:
-            ESP_LOGD(TAG, "UAC Unknown Descriptor Subtype %d", uac_cs_desc->bDescriptorSubtype);
             break;
         }
-        uac_cs_desc = (uac_desc_header_t *)GET_NEXT_DESC(uac_cs_desc, total_length, uac_desc_offset);
     }
-    return 0;
+    ESP_LOGD(TAG, "UAC topology of %d entities", uac_device->entity_num);
+    return ESP_OK;
 }
 
-static uac_ac_feature_unit_desc_t *_uac_host_device_find_feature_unit(const uint8_t *header_desc, uint8_t terminal_id, bool if_input)
-{
-    if (!header_desc) {
-        return NULL;
+/**
+ * @brief Find the feature unit on the audio path of a terminal
+ *
+ * @param[in] uac_device   Pointer to UAC device structure
+ * @param[in] terminal_id  ID of the terminal connected to the stream
+ * @param[in] if_input     The terminal is an input terminal, the path is followed to its sinks, otherwise to its sources
+ * @return Feature unit entity, NULL if there is none
+ */
+static uac_entity_t *_uac_topology_find_feature_unit(const uac_device_t *uac_device, uint8_t terminal_id, bool if_input)
+{
+    uac_entity_t *entity = _uac_topology_get(uac_device, terminal_id);
+    // limit the path length, a malformed descriptor may link the units in a loop
+    for (int hops = 0; entity && hops < uac_device->entity_num; hops++) {
+        entity = _uac_topology_get(uac_device, if_input ? entity->sink : entity->source);
+        if (entity && entity->subtype == UAC_AC_FEATURE_UNIT) {
+            return entity;
+        }
     }
+    return NULL;
+}
 
-    uint8_t unit_id = terminal_id;
-    uac_ac_feature_unit_desc_t *feature_unit_desc = NULL;
-    if (if_input) {
-        while (feature_unit_desc == NULL && unit_id != 0) {
-            unit_id = _uac_next_linked_uint_id(header_desc, unit_id, (uint8_t **)&feature_unit_desc);
-            ESP_LOGD(TAG, "Input Terminal next linked unit ID %d", unit_id);
+/**
+ * @brief Find the UAC 2.0 clock source of the terminal connected to the stream
+ *
+ * The clock path is followed through clock multipliers and through the first input of clock selectors.
+ * A programmable clock selector is saved, so its input can be selected before streaming.
+ *
+ * @param[in] uac_device   Pointer to UAC device structure
+ * @param[in] terminal_id  ID of the terminal connected to the stream
+ * @param[out] iface_alt   Alternate setting receiving the clock source, clock selector and frequency control
+ * @return esp_err_t
+ * - ESP_OK if the clock source is found
+ * - ESP_ERR_NOT_FOUND if the terminal or clock source is missing
+ */
+static esp_err_t _uac2_find_clock_source(const uac_device_t *uac_device, uint8_t terminal_id, uac_iface_alt_t *iface_alt)
+{
+    const uac_entity_t *terminal_entity = _uac_topology_get(uac_device, terminal_id);
+    UAC_RETURN_ON_FALSE(terminal_entity, ESP_ERR_NOT_FOUND, "Terminal not found");
+    const uint8_t *terminal = terminal_entity->desc;
+    uint8_t clock_id = 0;
+    if (((const uac_desc_header_t *)terminal)->bDescriptorSubtype == UAC_AC_INPUT_TERMINAL) {
+        clock_id = ((const uac2_ac_input_terminal_desc_t *)terminal)->bCSourceID;
+    } else if (((const uac_desc_header_t *)terminal)->bDescriptorSubtype == UAC_AC_OUTPUT_TERMINAL) {
+        clock_id = ((const uac2_ac_output_terminal_desc_t *)terminal)->bCSourceID;
+    }
+
+    // limit the path length, a malformed descriptor may link the clocks in a loop
+    for (int hops = 0; hops < 8; hops++) {
+        const uac_entity_t *clock_entity = _uac_topology_get(uac_device, clock_id);
+        if (!clock_entity) {
+            break;
         }
-    } else {
-        while (feature_unit_desc == NULL && unit_id != 0) {
-            unit_id = _uac_last_linked_uint_id(header_desc, unit_id, (uint8_t **)&feature_unit_desc);
-            ESP_LOGD(TAG, "Output Terminal last linked unit ID %d", unit_id);
+        const uint8_t *clock = clock_entity->desc;
+        switch (((const uac_desc_header_t *)clock)->bDescriptorSubtype) {
+        case UAC2_AC_CLOCK_SOURCE: {
+            const uac2_ac_clock_source_desc_t *source_desc = (const uac2_ac_clock_source_desc_t *)clock;
+            iface_alt->clock_source = source_desc->bClockID;
+            iface_alt->freq_ctrl_supported = UAC2_CONTROL_ACCESS(source_desc->bmControls, UAC2_CS_CONTROL_IDX_SAM_FREQ) == UAC2_CONTROL_PROGRAMMABLE;
+            ESP_LOGD(TAG, "UAC Clock Source %d, Attributes 0x%02X, Controls 0x%02X", source_desc->bClockID,
+                     source_desc->bmAttributes, source_desc->bmControls);
+            return ESP_OK;
+        }
+        case UAC2_AC_CLOCK_SELECTOR: {
+            const uac2_ac_clock_selector_desc_t *selector_desc = (const uac2_ac_clock_selector_desc_t *)clock;
+            UAC_RETURN_ON_FALSE(selector_desc->bNrInPins && selector_desc->bLength >= 7 + selector_desc->bNrInPins,
+                                ESP_ERR_NOT_FOUND, "Invalid clock selector");
+            const uint8_t bm_controls = clock[5 + selector_desc->bNrInPins];
+            if (UAC2_CONTROL_ACCESS(bm_controls, UAC2_CX_CONTROL_IDX_CLOCK_SELECTOR) == UAC2_CONTROL_PROGRAMMABLE) {
+                iface_alt->clock_selector = selector_desc->bClockID;
+                iface_alt->clock_selector_pin = 1;
+            }
+            clock_id = selector_desc->baCSourceID[0];
+            break;
+        }
+        case UAC2_AC_CLOCK_MULTIPLIER:
+            clock_id = ((const uac2_ac_clock_multiplier_desc_t *)clock)->bCSourceID;
+            break;
+        default:
+            clock_id = 0;
+            break;
         }
     }
-
-    return feature_unit_desc;
+    ESP_LOGE(TAG, "Clock source of terminal %d not found", terminal_id);
+    return ESP_ERR_NOT_FOUND;
 }
 
 /**
@@ -694,10 +689,12 @@ static esp_err_t uac_host_interface_add(uac_device_t *uac_device, uint8_t iface_
 {
     esp_err_t ret;
     *p_uac_iface = NULL;
-    uac_iface_t *uac_iface = calloc(1, sizeof(uac_iface_t));
+    size_t iface_alt_size = 0;
+    uac_iface_t *uac_iface = UAC_CALLOC(CONTROL, 1, sizeof(uac_iface_t));
     UAC_RETURN_ON_FALSE(uac_iface, ESP_ERR_NO_MEM, "Unable to allocate memory");
     uac_iface->state_mutex = xSemaphoreCreateMutex();
     UAC_GOTO_ON_FALSE(uac_iface->state_mutex, ESP_ERR_NO_MEM, "Unable to create state mutex");
+    portMUX_INITIALIZE(&uac_iface->tx_lock);
     const usb_config_desc_t *config_desc = NULL;
     const usb_intf_desc_t *iface_desc = NULL;
     const usb_intf_desc_t *iface_alt_desc = NULL;
@@ -722,8 +719,10 @@ static esp_err_t uac_host_interface_add(uac_device_t *uac_device, uint8_t iface_
                  iface_alt_desc->bInterfaceNumber, iface_alt_desc->bAlternateSetting);
         iface_alt_idx++;
         // Allocate memory for the alternate setting
-        uac_iface->iface_alt = realloc(uac_iface->iface_alt, iface_alt_idx * sizeof(uac_iface_alt_t));
-        UAC_GOTO_ON_FALSE(uac_iface->iface_alt, ESP_ERR_NO_MEM, "Unable to allocate memory");
+        uac_iface_alt_t *iface_alts = UAC_REALLOC(DESCRIPTOR, uac_iface->iface_alt, iface_alt_size, iface_alt_idx * sizeof(uac_iface_alt_t));
+        UAC_GOTO_ON_FALSE(iface_alts, ESP_ERR_NO_MEM, "Unable to allocate memory");
+        uac_iface->iface_alt = iface_alts;
+        iface_alt_size = iface_alt_idx * sizeof(uac_iface_alt_t);
         uac_iface_alt_t *iface_alt = &uac_iface->iface_alt[iface_alt_idx - 1];
         memset(iface_alt, 0, sizeof(uac_iface_alt_t));
         iface_alt->alt_idx = iface_alt_desc->bAlternateSetting;
@@ -735,10 +734,30 @@ static esp_err_t uac_host_interface_add(uac_device_t *uac_device, uint8_t iface_
             switch (cs_desc->bDescriptorType) {
             case UAC_CS_INTERFACE: {
                 const uac_desc_header_t *uac_desc = (const uac_desc_header_t *)cs_desc;
-                if (uac_desc->bDescriptorSubtype == UAC_AS_GENERAL) {
+                if (uac_desc->bDescriptorSubtype == UAC_AS_GENERAL && uac_device->bcdADC >= UAC_VERSION_2) {
+                    // UAC 2.0 moves the channels to the general descriptor and the clock to the clock entities
+                    const uac2_as_general_desc_t *as_general_desc = (const uac2_as_general_desc_t *)uac_desc;
+                    iface_alt->dev_alt_param.format = as_general_desc->bmFormats ? __builtin_ctz(as_general_desc->bmFormats) + 1 : UAC_TYPE_I_UNDEFINED;
+                    iface_alt->dev_alt_param.channels = as_general_desc->bNrChannels;
+                    iface_alt->connected_terminal = as_general_desc->bTerminalLink;
+                    if (_uac2_find_clock_source(uac_device, iface_alt->connected_terminal, iface_alt) != ESP_OK) {
+                        ESP_LOGW(TAG, "UAC Interface %d->%d, no clock source", iface_desc->bInterfaceNumber, iface_alt->alt_idx);
+                    }
+                } else if (uac_desc->bDescriptorSubtype == UAC_AS_GENERAL) {
                     const uac_as_general_desc_t *as_general_desc = (const uac_as_general_desc_t *)uac_desc;
                     iface_alt->dev_alt_param.format = as_general_desc->wFormatTag;
                     iface_alt->connected_terminal = as_general_desc->bTerminalLink;
+                } else if (uac_desc->bDescriptorSubtype == UAC_AS_FORMAT_TYPE && uac_device->bcdADC >= UAC_VERSION_2) {
+                    // the sampling frequencies are requested from the clock source after the interface is added
+                    const uac2_as_type_I_format_desc_t *as_format_type_desc = (const uac2_as_type_I_format_desc_t *)uac_desc;
+                    if (as_format_type_desc->bFormatType != UAC_FORMAT_TYPE_I) {
+                        ESP_LOGE(TAG, "UAC Format Type %d", as_format_type_desc->bFormatType);
+                        UAC_GOTO_ON_FALSE(0, ESP_ERR_NOT_SUPPORTED, "UAC Format Type not supported");
+                    }
+                    iface_alt->dev_alt_param.bit_resolution = as_format_type_desc->bBitResolution;
+                    iface_alt->dev_alt_param.subframe_size = as_format_type_desc->bSubslotSize;
+                    ESP_LOGD(TAG, "UAC AS Format Type %d, Bit Resolution %d, Subslot Size %d", as_format_type_desc->bFormatType,
+                             as_format_type_desc->bBitResolution, as_format_type_desc->bSubslotSize);
                 } else if (uac_desc->bDescriptorSubtype == UAC_AS_FORMAT_TYPE) {
                     const uac_as_type_I_format_desc_t *as_format_type_desc = (const uac_as_type_I_format_desc_t *)uac_desc;
                     if (as_format_type_desc->bFormatType != UAC_FORMAT_TYPE_I) {
@@ -747,6 +766,7 @@ static esp_err_t uac_host_interface_add(uac_device_t *uac_device, uint8_t iface_
                     }
                     iface_alt->dev_alt_param.channels = as_format_type_desc->bNrChannels;
                     iface_alt->dev_alt_param.bit_resolution = as_format_type_desc->bBitResolution;
+                    iface_alt->dev_alt_param.subframe_size = as_format_type_desc->bSubframeSize;
                     iface_alt->dev_alt_param.sample_freq_type = as_format_type_desc->bSamFreqType;
                     if (as_format_type_desc->bSamFreqType == 0) {
                         iface_alt->dev_alt_param.sample_freq_lower = (as_format_type_desc->tSamFreq[2] << 16) | (as_format_type_desc->tSamFreq[1] << 8) | as_format_type_desc->tSamFreq[0];
@@ -768,26 +788,27 @@ static esp_err_t uac_host_interface_add(uac_device_t *uac_device, uint8_t iface_
             case USB_B_DESCRIPTOR_TYPE_ENDPOINT: {
                 ep_desc = (const usb_ep_desc_t *)cs_desc;
                 iface_alt->ep_addr = ep_desc->bEndpointAddress;
-                iface_alt->ep_mps = ep_desc->wMaxPacketSize;
+                iface_alt->ep_mps = USB_EP_DESC_GET_MPS(ep_desc);
+                if (ep_desc->wMaxPacketSize & ~USB_W_MAX_PACKET_SIZE_MPS_MASK) {
+                    ESP_LOGW(TAG, "UAC Endpoint 0x%02X, additional transactions per microframe not supported", ep_desc->bEndpointAddress);
+                }
                 iface_alt->ep_attr = ep_desc->bmAttributes;
                 iface_alt->interval = ep_desc->bInterval;
+                const usb_ep_desc_t *fb_ep_desc = uac_find_feedback_ep_desc(config_desc, iface_alt_desc, ep_desc);
+                if (fb_ep_desc && !(ep_desc->bEndpointAddress & UAC_EP_DIR_IN)) {
+                    iface_alt->fb_ep_addr = fb_ep_desc->bEndpointAddress;
+                    iface_alt->fb_ep_mps = USB_EP_DESC_GET_MPS(fb_ep_desc);
+                    ESP_LOGD(TAG, "UAC Feedback Endpoint 0x%02X, Max Packet Size %d", fb_ep_desc->bEndpointAddress, iface_alt->fb_ep_mps);
+                }
                 uac_iface->dev_info.type = (ep_desc->bEndpointAddress & UAC_EP_DIR_IN) ? UAC_STREAM_RX : UAC_STREAM_TX;
-                uac_ac_feature_unit_desc_t *feature_unit_desc = _uac_host_device_find_feature_unit((uint8_t *)uac_device->cs_ac_desc,
-                        iface_alt->connected_terminal, !(ep_desc->bEndpointAddress & UAC_EP_DIR_IN));
-                if (feature_unit_desc) {
-                    iface_alt->feature_unit = feature_unit_desc->bUnitID;
-                    uint8_t ch_num = 0;
-                    for (size_t i = 0; i < (feature_unit_desc->bLength - 7) / feature_unit_desc->bControlSize; i++) {
-                        if (feature_unit_desc->bmaControls[i * feature_unit_desc->bControlSize] & UAC_FU_CONTROL_POS_VOLUME) {
-                            iface_alt->vol_ch_map |= (1 << ch_num);
-                        }
-                        if (feature_unit_desc->bmaControls[i * feature_unit_desc->bControlSize] & UAC_FU_CONTROL_POS_MUTE) {
-                            iface_alt->mute_ch_map |= (1 << ch_num);
-                        }
-                        ch_num++;
-                    }
+                const uac_entity_t *feature_unit = _uac_topology_find_feature_unit(uac_device, iface_alt->connected_terminal,
+                                                   !(ep_desc->bEndpointAddress & UAC_EP_DIR_IN));
+                if (feature_unit) {
+                    iface_alt->feature_unit = feature_unit->id;
+                    iface_alt->vol_ch_map = feature_unit->vol_ch_map;
+                    iface_alt->mute_ch_map = feature_unit->mute_ch_map;
                     ESP_LOGD(TAG, "UAC %s Feature Unit ID %d, Volume Ch Map %02X, Mute Ch Map %02X", uac_iface->dev_info.type == UAC_STREAM_RX ? "RX" : "TX",
-                             feature_unit_desc->bUnitID, iface_alt->vol_ch_map, iface_alt->mute_ch_map);
+                             feature_unit->id, iface_alt->vol_ch_map, iface_alt->mute_ch_map);
                 }
                 ESP_LOGD(TAG, "UAC Endpoint 0x%02X, Max Packet Size %d, Attributes 0x%02X, Interval %d", ep_desc->bEndpointAddress, ep_desc->wMaxPacketSize, ep_desc->bmAttributes, ep_desc->bInterval);
                 break;
@@ -796,7 +817,10 @@ static esp_err_t uac_host_interface_add(uac_device_t *uac_device, uint8_t iface_
                 // we has got enough information to fill the uac_iface_alt_t, so we can break
                 const uac_as_cs_ep_desc_t *cs_ep_desc = (const uac_as_cs_ep_desc_t *)cs_desc;
                 if (cs_ep_desc->bDescriptorSubtype == UAC_EP_GENERAL) {
-                    iface_alt->freq_ctrl_supported = cs_ep_desc->bmAttributes & UAC_SAMPLING_FREQ_CONTROL;
+                    // UAC 2.0 controls the frequency by the clock source
+                    if (uac_device->bcdADC < UAC_VERSION_2) {
+                        iface_alt->freq_ctrl_supported = cs_ep_desc->bmAttributes & UAC_SAMPLING_FREQ_CONTROL;
+                    }
                     parse_continue = false;
                     ESP_LOGD(TAG, "UAC EP General, Attributes 0x%02X", cs_ep_desc->bmAttributes);
                     ESP_LOGD(TAG, "UAC EP Frequency Control %d", iface_alt->freq_ctrl_supported);
@@ -823,6 +847,12 @@ static esp_err_t uac_host_interface_add(uac_device_t *uac_device, uint8_t iface_
     usb_device_info_t dev_info;
     UAC_GOTO_ON_ERROR(usb_host_get_device_descriptor(uac_device->dev_hdl, &desc), "Unable to get device descriptor");
     UAC_GOTO_ON_ERROR(usb_host_device_info(uac_device->dev_hdl, &dev_info), "Unable to get USB device info");
+    // One packet every 2^(bInterval-1) frames at full speed or microframes at high speed
+    for (int i = 0; i < iface_alt_idx; i++) {
+        const uint32_t rate = dev_info.speed == USB_SPEED_HIGH ? 8000 : 1000;
+        const uint8_t interval = MIN(MAX(uac_iface->iface_alt[i].interval, 1), 16);
+        uac_iface->iface_alt[i].packet_rate = MAX(rate >> (interval - 1), 1);
+    }
     // VID, PID
     uac_iface->dev_info.VID = desc->idVendor;
     uac_iface->dev_info.PID = desc->idProduct;
@@ -843,8 +873,8 @@ fail:
     if (uac_iface && uac_iface->state_mutex) {
         vSemaphoreDelete(uac_iface->state_mutex);
     }
-    free(uac_iface->iface_alt);
-    free(uac_iface);
+    UAC_FREE(DESCRIPTOR, uac_iface->iface_alt, iface_alt_size);
+    UAC_FREE(CONTROL, uac_iface, sizeof(uac_iface_t));
     return ret;
 }
 
@@ -862,8 +892,8 @@ static esp_err_t uac_host_interface_delete(uac_iface_t *uac_iface)
     STAILQ_REMOVE(&s_uac_driver->uac_ifaces_tailq, uac_iface, uac_interface, tailq_entry);
     UAC_EXIT_CRITICAL();
     vSemaphoreDelete(uac_iface->state_mutex);
-    free(uac_iface->iface_alt);
-    free(uac_iface);
+    UAC_FREE(DESCRIPTOR, uac_iface->iface_alt, uac_iface->dev_info.iface_alt_num * sizeof(uac_iface_alt_t));
+    UAC_FREE(CONTROL, uac_iface, sizeof(uac_iface_t));
     return ESP_OK;
 }
 
@@ -932,11 +962,11 @@ static esp_err_t _uac_host_device_connected(uint8_t addr)
     usb_device_handle_t dev_hdl;
     const usb_config_desc_t *config_desc = NULL;
 
-    if (usb_host_device_open(s_uac_driver->client_handle, addr, &dev_hdl) == ESP_OK) {
+    if (CLIENT_DEVICE_OPEN(s_uac_driver->client_handle, addr, &dev_hdl) == ESP_OK) {
         if (usb_host_get_active_config_descriptor(dev_hdl, &config_desc) == ESP_OK) {
             is_uac_device = uac_interface_present(config_desc);
         }
-        UAC_RETURN_ON_ERROR(usb_host_device_close(s_uac_driver->client_handle, dev_hdl), "Unable to close USB device");
+        UAC_RETURN_ON_ERROR(CLIENT_DEVICE_CLOSE(s_uac_driver->client_handle, dev_hdl), "Unable to close USB device");
     }
 
     // Create UAC interfaces list in RAM, connected to the particular USB dev
@@ -1024,42 +1054,98 @@ static void client_event_cb(const usb_host_client_event_msg_t *event, void *arg)
 }
 
 /**
- * @brief UAC Host release Interface and free transfers, change state to IDLE
+ * @brief Free the transfers of the interface, none of them may be in flight
  *
  * @param[in] iface       Pointer to Interface structure,
- * @return esp_err_t
  */
-static esp_err_t uac_host_interface_release_and_free_transfer(uac_iface_t *iface)
+static void uac_host_interface_free_transfer(uac_iface_t *iface)
 {
-    UAC_RETURN_ON_INVALID_ARG(iface);
-    UAC_RETURN_ON_INVALID_ARG(iface->parent);
-
-    UAC_RETURN_ON_FALSE(is_interface_in_list(iface), ESP_ERR_NOT_FOUND, "Interface handle not found");
-    UAC_RETURN_ON_ERROR(usb_host_interface_release(s_uac_driver->client_handle, iface->parent->dev_hdl, iface->dev_info.iface_num), "Unable to release UAC Interface");
-
     if (iface->free_xfer_list) {
         for (int i = 0; i < iface->xfer_num; i++) {
             if (iface->free_xfer_list[i]) {
-                ESP_ERROR_CHECK(usb_host_transfer_free(iface->free_xfer_list[i]));
+                ESP_ERROR_CHECK(CLIENT_TRANSFER_FREE(iface->free_xfer_list[i]));
             }
         }
-        free(iface->free_xfer_list);
+        UAC_FREE(CONTROL, iface->free_xfer_list, iface->xfer_num * sizeof(usb_transfer_t *));
+        iface->free_xfer_list = NULL;
     }
+    UAC_ATOMIC_STORE(iface->free_xfer_mask, 0);
 
     if (iface->xfer_list) {
         for (int i = 0; i < iface->xfer_num; i++) {
             if (iface->xfer_list[i]) {
-                ESP_ERROR_CHECK(usb_host_transfer_free(iface->xfer_list[i]));
+                ESP_ERROR_CHECK(CLIENT_TRANSFER_FREE(iface->xfer_list[i]));
             }
         }
-        free(iface->xfer_list);
+        UAC_FREE(CONTROL, iface->xfer_list, iface->xfer_num * sizeof(usb_transfer_t *));
+        iface->xfer_list = NULL;
+    }
+
+    if (iface->fb_xfer) {
+        ESP_ERROR_CHECK(CLIENT_TRANSFER_FREE(iface->fb_xfer));
+        iface->fb_xfer = NULL;
     }
+    UAC_FREE(BUFFER, iface->rx_spans, iface->rx_span_num * sizeof(uac_host_rx_span_t));
+    iface->rx_spans = NULL;
+    iface->rx_span_num = 0;
+}
+
+/**
+ * @brief UAC Host release Interface and free transfers, change state to IDLE
+ *
+ * @param[in] iface       Pointer to Interface structure,
+ * @return esp_err_t
+ */
+static esp_err_t uac_host_interface_release_and_free_transfer(uac_iface_t *iface)
+{
+    UAC_RETURN_ON_INVALID_ARG(iface);
+    UAC_RETURN_ON_INVALID_ARG(iface->parent);
+
+    UAC_RETURN_ON_FALSE(is_interface_in_list(iface), ESP_ERR_NOT_FOUND, "Interface handle not found");
+    UAC_RETURN_ON_ERROR(usb_host_interface_release(s_uac_driver->client_handle, iface->parent->dev_hdl, iface->dev_info.iface_num), "Unable to release UAC Interface");
+    uac_host_interface_free_transfer(iface);
 
     // Change state
     iface->state = UAC_INTERFACE_STATE_IDLE;
     return ESP_OK;
 }
 
+/**
+ * @brief Allocate the transfers of the current alternate setting, all of them free
+ *
+ * @param[in] iface       Pointer to Interface structure, the transfer number and size must be set
+ * @return esp_err_t, on failure the allocated transfers are freed
+ */
+static esp_err_t uac_host_interface_alloc_transfer(uac_iface_t *iface)
+{
+    esp_err_t ret = ESP_OK;
+    // alloc a list of usb transfer
+    uint32_t packet_size = iface->iface_alt[iface->cur_alt].ep_mps;
+    iface->xfer_list = UAC_CALLOC(CONTROL, iface->xfer_num, sizeof(usb_transfer_t *));
+    UAC_GOTO_ON_FALSE(iface->xfer_list, ESP_ERR_NO_MEM, "Unable to allocate transfer list");
+    iface->free_xfer_list = UAC_CALLOC(CONTROL, iface->xfer_num, sizeof(usb_transfer_t *));
+    UAC_GOTO_ON_FALSE(iface->free_xfer_list, ESP_ERR_NO_MEM, "Unable to allocate free transfer list");
+    for (int i = 0; i < iface->xfer_num; i++) {
+        UAC_GOTO_ON_ERROR(CLIENT_TRANSFER_ALLOC(packet_size * iface->packet_num, iface->packet_num, &iface->free_xfer_list[i]),
+                          "Unable to allocate transfer buffer for EP IN");
+        UAC_ATOMIC_FETCH_OR(iface->free_xfer_mask, 1UL << i);
+    }
+    if (iface->iface_alt[iface->cur_alt].fb_ep_addr) {
+        UAC_GOTO_ON_ERROR(CLIENT_TRANSFER_ALLOC(iface->iface_alt[iface->cur_alt].fb_ep_mps, 1, &iface->fb_xfer),
+                          "Unable to allocate transfer buffer for feedback EP");
+    }
+    if (iface->rx_data_cb) {
+        iface->rx_spans = UAC_CALLOC(BUFFER, iface->packet_num, sizeof(uac_host_rx_span_t));
+        UAC_GOTO_ON_FALSE(iface->rx_spans, ESP_ERR_NO_MEM, "Unable to allocate RX spans");
+        iface->rx_span_num = iface->packet_num;
+    }
+    return ESP_OK;
+
+fail:
+    uac_host_interface_free_transfer(iface);
+    return ret;
+}
+
 /**
  * @brief UAC Host claim Interface and prepare transfer, change state to READY
  *
@@ -1073,33 +1159,163 @@ static esp_err_t uac_host_interface_claim_and_prepare_transfer(uac_iface_t *ifac
 
     UAC_RETURN_ON_ERROR(usb_host_interface_claim(s_uac_driver->client_handle, iface->parent->dev_hdl, iface->dev_info.iface_num,
                         iface->cur_alt + 1), "Unable to claim Interface");
-    // alloc a list of usb transfer
-    uint32_t packet_size = iface->iface_alt[iface->cur_alt].ep_mps;
-    iface->xfer_list = calloc(iface->xfer_num, sizeof(usb_transfer_t *));
-    UAC_GOTO_ON_FALSE(iface->xfer_list, ESP_ERR_NO_MEM, "Unable to allocate transfer list");
-    iface->free_xfer_list = calloc(iface->xfer_num, sizeof(usb_transfer_t *));
-    UAC_GOTO_ON_FALSE(iface->free_xfer_list, ESP_ERR_NO_MEM, "Unable to allocate free transfer list");
-    for (int i = 0; i < iface->xfer_num; i++) {
-        UAC_GOTO_ON_ERROR(usb_host_transfer_alloc(packet_size * iface->packet_num, iface->packet_num, &iface->free_xfer_list[i]),
-                          "Unable to allocate transfer buffer for EP IN");
-    }
+    UAC_GOTO_ON_ERROR(uac_host_interface_alloc_transfer(iface), "Unable to allocate transfers");
     // Change state
     iface->state = UAC_INTERFACE_STATE_READY;
     return ESP_OK;
 
 fail:
-    uac_host_interface_release_and_free_transfer(iface);
+    usb_host_interface_release(s_uac_driver->client_handle, iface->parent->dev_hdl, iface->dev_info.iface_num);
     return ret;
 }
 
+/**
+ * @brief Pass the received packets of the transfer to the RX data callback, without copying
+ *
+ * @param[in] iface    Pointer to Interface structure
+ * @param[in] in_xfer  Pointer to completed transfer
+ */
+static void UAC_DATA_PATH_ATTR stream_rx_deliver(uac_iface_t *iface, usb_transfer_t *in_xfer)
+{
+    size_t num_spans = 0;
+    size_t offset = 0;
+    for (int i = 0; i < in_xfer->num_isoc_packets; i++) {
+        const usb_isoc_packet_desc_t *packet = &in_xfer->isoc_packet_desc[i];
+        // packets are placed one after another by their requested size, received data may be shorter
+        const uint8_t *data = in_xfer->data_buffer + offset;
+        offset += packet->num_bytes;
+        if (packet->status != USB_TRANSFER_STATUS_COMPLETED) {
+            ESP_LOGD(TAG, "Bad RX Isoc packet %d status %d", i, packet->status);
+            iface->stats.rx_bad_packets++;
+            continue;
+        }
+        if (packet->actual_num_bytes) {
+            iface->rx_spans[num_spans].data = data;
+            iface->rx_spans[num_spans].len = packet->actual_num_bytes;
+            num_spans++;
+        }
+    }
+    CLIENT_TRACE(DELIVER, in_xfer->bEndpointAddress, in_xfer->actual_num_bytes, iface);
+    CLIENT_TRACE(CALLBACK_ENTER, in_xfer->bEndpointAddress, 0, iface);
+    iface->rx_data_cb((uac_host_device_handle_t)iface, iface->rx_spans, num_spans, iface->user_cb_arg);
+    CLIENT_TRACE(CALLBACK_EXIT, in_xfer->bEndpointAddress, 0, iface);
+}
+
+/**
+ * @brief Count the fill level of the ring buffer in the fill histogram, transfer callbacks only
+ *
+ * @param[in] iface  Pointer to Interface structure
+ */
+static inline void stream_stats_ring_fill(uac_iface_t *iface)
+{
+    const uint32_t bin = (uint64_t)uac_ring_get_len(&iface->ringbuf) * UAC_HOST_STATS_FILL_BINS / iface->ringbuf.size;
+    iface->stats.fill_hist[MIN(bin, UAC_HOST_STATS_FILL_BINS - 1)]++;
+}
+
+/**
+ * @brief Current time in microseconds, monotonic also on the linux target of host tests
+ */
+static inline int64_t stream_time_us(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return esp_timer_get_time();
+#endif
+}
+
+/**
+ * @brief Count the packets and samples of a completed transfer
+ *
+ * @param[in] iface  Pointer to Interface structure
+ * @param[in] xfer   Pointer to completed transfer
+ */
+static void UAC_DATA_PATH_ATTR stream_update_timing(uac_iface_t *iface, const usb_transfer_t *xfer)
+{
+    const int64_t now = stream_time_us();
+    UAC_ENTER_CRITICAL();
+    if (iface->timing.packet_count == 0) {
+        // the first packet of the transfer was on the bus one transfer duration earlier
+        iface->timing.start_time_us = now - (int64_t)xfer->num_isoc_packets * 1000000 / iface->packet_rate;
+    }
+    iface->timing.last_time_us = now;
+    iface->timing.packet_count += xfer->num_isoc_packets;
+    iface->timing.sample_count += xfer->actual_num_bytes / iface->frame_size;
+    UAC_EXIT_CRITICAL();
+}
+
+/**
+ * @brief Move the received data of all packets to the start of the transfer buffer
+ *
+ * The packets are placed one after another by their requested size, the received data may be shorter.
+ *
+ * @param[in] iface    Pointer to Interface structure
+ * @param[in] in_xfer  Pointer to completed transfer
+ * @return Number of received bytes at the start of the transfer buffer
+ */
+static size_t UAC_DATA_PATH_ATTR stream_rx_compact(uac_iface_t *iface, usb_transfer_t *in_xfer)
+{
+    size_t offset = 0;
+    size_t len = 0;
+    for (int i = 0; i < in_xfer->num_isoc_packets; i++) {
+        const usb_isoc_packet_desc_t *packet = &in_xfer->isoc_packet_desc[i];
+        const size_t packet_offset = offset;
+        offset += packet->num_bytes;
+        if (packet->status != USB_TRANSFER_STATUS_COMPLETED) {
+            ESP_LOGD(TAG, "Bad RX Isoc packet %d status %d", i, packet->status);
+            iface->stats.rx_bad_packets++;
+            continue;
+        }
+        // in UAC, the actual_num_bytes may less than requested_num_bytes
+        // eg. the packet_size is 64, but the endpoint size is 100
+        assert(packet->num_bytes >= packet->actual_num_bytes);
+        if (len != packet_offset) {
+            memmove(in_xfer->data_buffer + len, in_xfer->data_buffer + packet_offset, packet->actual_num_bytes);
+        }
+        len += packet->actual_num_bytes;
+    }
+    return len;
+}
+
+/**
+ * @brief Notify the user about the moved data of a staged RX stream, called from the mover task
+ *
+ * @param[in] arg  Pointer to Interface structure
+ */
+static void stream_rx_stage_moved(void *arg)
+{
+    uac_iface_t *iface = (uac_iface_t *)arg;
+    // if ringbuffer is reach the threshold or full, notify user to read out
+    if (uac_ring_get_len(&iface->ringbuf) >= MIN(iface->ringbuf_threshold, iface->ringbuf.size)) {
+        uac_host_user_interface_callback(iface, UAC_HOST_DEVICE_EVENT_RX_DONE);
+    }
+}
+
+/**
+ * @brief Drop the buffered data of a stream, only while the transfer callbacks do not write the buffer
+ *
+ * @param[in] iface  Pointer to Interface structure
+ */
+static void stream_ring_flush(uac_iface_t *iface)
+{
+    if (iface->stage.task) {
+        uac_stage_flush(&iface->stage);
+    } else if (iface->ringbuf.buf) {
+        uac_ring_flush(&iface->ringbuf);
+    }
+}
+
 /**
  * @brief UAC IN Transfer complete callback
  *
  * @param[in] transfer  Pointer to transfer data structure
  */
-static void stream_rx_xfer_done(usb_transfer_t *in_xfer)
+void UAC_DATA_PATH_ATTR stream_rx_xfer_done(usb_transfer_t *in_xfer)
 {
     assert(in_xfer);
+    CLIENT_TRACE_COMPLETE(in_xfer);
 
     uac_iface_t *iface = in_xfer->context;
     assert(iface);
@@ -1110,40 +1326,54 @@ static void stream_rx_xfer_done(usb_transfer_t *in_xfer)
 
     switch (in_xfer->status) {
     case USB_TRANSFER_STATUS_COMPLETED: {
+        stream_update_timing(iface, in_xfer);
+        if (iface->rx_data_cb) {
+            stream_rx_deliver(iface, in_xfer);
+            CLIENT_TRANSFER_SUBMIT(in_xfer);
+            return;
+        }
 
+        // with staging, data are written to the internal RAM staging ring and the mover notifies the user
+        const bool staged = iface->stage.task != NULL;
+        uac_ring_t *ring = staged ? &iface->stage.ring : &iface->ringbuf;
         // if ringbuffer will overflow, notify user to read data
-        size_t data_len = _ring_buffer_get_len(iface->ringbuf);
-        if (data_len + in_xfer->actual_num_bytes >= iface->ringbuf_size) {
+        if (!staged && uac_ring_get_len(ring) + in_xfer->actual_num_bytes >= ring->size) {
             uac_host_user_interface_callback(iface, UAC_HOST_DEVICE_EVENT_RX_DONE);
         }
 
-        // if ringbuffer overflow (happens if user not read in above callback), the data will be dropped
-        data_len = _ring_buffer_get_len(iface->ringbuf);
-        if (data_len + in_xfer->actual_num_bytes > iface->ringbuf_size) {
-            ESP_LOGD(TAG, "RX Ringbuffer overflow");
+        // move the received data of all packets together, then write them to ringbuffer at once
+        const size_t data_len = stream_rx_compact(iface, in_xfer);
+        // if ringbuffer overflow (happens if user not read in above callback), the data that do not fit are dropped
+        size_t copied;
+        if (iface->pcm.enabled) {
+            // received samples are converted on their way to the ringbuffer
+            const size_t frames = MIN(data_len / iface->frame_size, uac_ring_get_free(ring) / iface->pcm.dst_frame_size);
+            copied = frames * iface->frame_size;
+            uac_ring_convert_in(ring, &iface->pcm, in_xfer->data_buffer, frames);
+            uac_ring_write_commit(ring, frames * iface->pcm.dst_frame_size);
         } else {
-            // else push data to ringbuffer
-            for (int i = 0; i < in_xfer->num_isoc_packets; i++) {
-                if (in_xfer->isoc_packet_desc[i].status != USB_TRANSFER_STATUS_COMPLETED) {
-                    // copy data to ringbuffer
-                    ESP_LOGD(TAG, "Bad RX Isoc packet %d status %d", i, in_xfer->isoc_packet_desc[i].status);
-                    continue;
-                }
-                int requested_num_bytes = in_xfer->isoc_packet_desc[i].num_bytes;
-                int actual_num_bytes = in_xfer->isoc_packet_desc[i].actual_num_bytes;
-                // in UAC, the actual_num_bytes may less than requested_num_bytes
-                // eg. the packet_size is 64, but the endpoint size is 100
-                assert(requested_num_bytes >= actual_num_bytes);
-                // copy data to ringbuffer
-                _ring_buffer_push(iface->ringbuf, in_xfer->data_buffer + i * requested_num_bytes, actual_num_bytes, 0);
+            copied = MIN(data_len, uac_ring_get_free(ring));
+            if (copied < data_len && iface->frame_size) {
+                // keep the buffered stream aligned to whole samples
+                copied -= copied % iface->frame_size;
             }
+            uac_ring_copy_in(ring, 0, in_xfer->data_buffer, copied);
+            uac_ring_write_commit(ring, copied);
         }
+        if (copied < data_len) {
+            ESP_LOGD(TAG, "RX Ringbuffer overflow, %d bytes dropped", (int)(data_len - copied));
+            iface->stats.rx_overflow_count++;
+            iface->stats.rx_overflow_bytes += data_len - copied;
+        }
+        stream_stats_ring_fill(iface);
+        CLIENT_TRACE(DELIVER, in_xfer->bEndpointAddress, copied, iface);
         // Relaunch transfer
-        usb_host_transfer_submit(in_xfer);
+        CLIENT_TRANSFER_SUBMIT(in_xfer);
 
-        // if ringbuffer is reach the threshold, notify user to read out
-        data_len = _ring_buffer_get_len(iface->ringbuf);
-        if (data_len >= iface->ringbuf_threshold) {
+        if (staged) {
+            uac_stage_notify(&iface->stage);
+        } else if (uac_ring_get_len(ring) >= iface->ringbuf_threshold) {
+            // if ringbuffer is reach the threshold, notify user to read out
             uac_host_user_interface_callback(iface, UAC_HOST_DEVICE_EVENT_RX_DONE);
         }
 
@@ -1160,43 +1390,235 @@ static void stream_rx_xfer_done(usb_transfer_t *in_xfer)
     }
 
     ESP_LOGE(TAG, "Transfer failed, status %d", in_xfer->status);
+    iface->stats.xfer_errors++;
     // Notify user about transfer or any other error
     uac_host_user_interface_callback(iface, UAC_HOST_DEVICE_EVENT_TRANSFER_ERROR);
 }
 
-static void stream_tx_xfer_submit(usb_transfer_t *out_xfer)
+/**
+ * @brief Convert the value of feedback endpoint to samples per packet
+ *
+ * Full-speed devices send 10.14 fixed point in 3 bytes, high-speed devices 16.16 fixed point in 4 bytes.
+ * Some devices use the other format, so the format giving a rate within 1/8 of the nominal rate is used.
+ *
+ * @param[in] data     Feedback value, little endian
+ * @param[in] len      Length of the feedback value
+ * @param[in] nominal  Nominal samples per packet, 16.16 fixed point
+ * @return Samples per packet in 16.16 fixed point, 0 if the value is not valid
+ */
+static uint32_t UAC_DATA_PATH_ATTR _uac_feedback_to_rate(const uint8_t *data, size_t len, uint32_t nominal)
 {
-    uac_iface_t *iface = out_xfer->context;
-    assert(iface);
-
-    size_t data_len = _ring_buffer_get_len(iface->ringbuf);
-    if (data_len >= iface->packet_size * iface->packet_num) {
-        data_len = iface->packet_size * iface->packet_num;
-        size_t actual_num_bytes = 0;
-        _ring_buffer_pop(iface->ringbuf, out_xfer->data_buffer, data_len, &actual_num_bytes, 0);
-        assert(actual_num_bytes == data_len);
+    if (len < 3) {
+        return 0;
+    }
+    uint64_t value = data[0] | (data[1] << 8) | (data[2] << 16);
+    if (len >= 4) {
+        value |= (uint64_t)data[3] << 24;
+    }
+    // First try the format matching the length
+    const uint64_t rates[2] = {len == 3 ? value << 2 : value, len == 3 ? value : value << 2};
+    for (int i = 0; i < 2; i++) {
+        if (rates[i] >= nominal - nominal / 8 && rates[i] <= nominal + nominal / 8) {
+            return (uint32_t)rates[i];
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief UAC feedback IN Transfer complete callback
+ *
+ * @param[in] fb_xfer  Pointer to transfer data structure
+ */
+static void UAC_DATA_PATH_ATTR stream_fb_xfer_done(usb_transfer_t *fb_xfer)
+{
+    assert(fb_xfer);
+    CLIENT_TRACE_COMPLETE(fb_xfer);
+
+    uac_iface_t *iface = fb_xfer->context;
+    assert(iface);
+
+    // No more polling of suspended interface, the last rate is discarded on resume
+    if (iface->state != UAC_INTERFACE_STATE_ACTIVE) {
+        return;
+    }
+
+    switch (fb_xfer->status) {
+    case USB_TRANSFER_STATUS_COMPLETED:
+        if (fb_xfer->isoc_packet_desc[0].status == USB_TRANSFER_STATUS_COMPLETED) {
+            const uint32_t rate = _uac_feedback_to_rate(fb_xfer->data_buffer, fb_xfer->isoc_packet_desc[0].actual_num_bytes, iface->nominal_rate);
+            if (rate) {
+                UAC_ATOMIC_STORE(iface->fb_rate, rate);
+            }
+        }
+        CLIENT_TRANSFER_SUBMIT(fb_xfer);
+        return;
+    case USB_TRANSFER_STATUS_NO_DEVICE:
+    case USB_TRANSFER_STATUS_CANCELED:
+        return;
+    default:
+        // Keep the last feedback rate, the stream continues without feedback
+        ESP_LOGW(TAG, "Feedback transfer failed, status %d", fb_xfer->status);
+        return;
+    }
+}
+
+/**
+ * @brief Move the TX transfer to the free list, it is submitted again by the writer
+ *
+ * @param[in] iface     Pointer to Interface structure
+ * @param[in] out_xfer  Pointer to TX transfer
+ */
+static void UAC_DATA_PATH_ATTR stream_tx_xfer_park(uac_iface_t *iface, usb_transfer_t *out_xfer)
+{
+    UAC_ENTER_CRITICAL();
+    for (int i = 0; i < iface->xfer_num; i++) {
+        if (iface->xfer_list[i] == out_xfer) {
+            iface->free_xfer_list[i] = out_xfer;
+            iface->xfer_list[i] = NULL;
+            UAC_ATOMIC_FETCH_OR(iface->free_xfer_mask, 1UL << i);
+            break;
+        }
+    }
+    UAC_EXIT_CRITICAL();
+}
+
+/**
+ * @brief Fill the end of a TX transfer the ringbuffer could not fill, caller holds tx_lock
+ *
+ * With FLAG_STREAM_TX_CONCEAL_REPEAT and frames that fit tx_last_frame, the last sent frame is repeated, otherwise silence is sent.
+ *
+ * @param[in] iface  Pointer to Interface structure
+ * @param[in] data   Transfer data, offset bytes are filled from the ringbuffer
+ * @param[in] offset Number of bytes filled from the ringbuffer, whole frames
+ * @param[in] len    Number of bytes of the transfer
+ */
+static void UAC_DATA_PATH_ATTR stream_tx_conceal(uac_iface_t *iface, uint8_t *data, size_t offset, size_t len)
+{
+    const size_t frame_size = iface->frame_size;
+    if (!(iface->flags & FLAG_STREAM_TX_CONCEAL_REPEAT) || frame_size > UAC_TX_LAST_FRAME_MAX) {
+        memset(data + offset, 0, len - offset);
+        return;
+    }
+    const uint8_t *last = offset ? data + offset - frame_size : iface->tx_last_frame;
+    for (size_t pos = offset; pos < len; pos += frame_size) {
+        memcpy(data + pos, last, MIN(frame_size, len - pos));
+    }
+}
+
+/**
+ * @brief Fill the TX transfer from the ringbuffer and submit it, or move it to the free list if there is not enough data
+ *
+ * With FLAG_STREAM_TX_CONCEAL_*, the transfer is always submitted, the missing data are concealed.
+ *
+ * @param[in] out_xfer  Pointer to TX transfer
+ * @return true if the transfer is submitted
+ */
+static bool UAC_DATA_PATH_ATTR stream_tx_xfer_submit(usb_transfer_t *out_xfer)
+{
+    uac_iface_t *iface = out_xfer->context;
+    assert(iface);
+
+    uac_ring_t *ring = &iface->ringbuf;
+    const uint32_t fb_rate = UAC_ATOMIC_LOAD(iface->fb_rate);
+    const uint32_t sampling_freq = iface->iface_alt[iface->cur_alt].cur_sampling_freq;
+    const uint16_t ep_mps = iface->iface_alt[iface->cur_alt].ep_mps;
+    bool data_ready = false;
+    portENTER_CRITICAL(&iface->tx_lock);
+    // Each packet carries the whole samples due in its frame, the fraction is carried to the next packet
+    // eg. 44.1 kHz is sent as 9 packets of 44 samples and one packet of 45 samples
+    uint32_t remainder = iface->rate_remainder;
+    size_t data_len = 0;
+    for (int i = 0; i < iface->packet_num; i++) {
+        uint32_t samples;
+        if (fb_rate) {
+            remainder += fb_rate;
+            samples = remainder >> 16;
+            remainder &= 0xFFFF;
+        } else {
+            // exact for the nominal rate, one packet per endpoint interval
+            remainder += sampling_freq;
+            samples = remainder / iface->packet_rate;
+            remainder %= iface->packet_rate;
+        }
+        const uint32_t num_bytes = MIN(samples * iface->frame_size, ep_mps);
+        out_xfer->isoc_packet_desc[i].num_bytes = num_bytes;
+        data_len += num_bytes;
+    }
+    // with conversion, the ringbuffer holds the frames in the application format
+    const size_t frames = data_len / iface->frame_size;
+    const size_t ring_len = iface->pcm.enabled ? frames * iface->pcm.src_frame_size : data_len;
+    const size_t available = uac_ring_get_len(ring);
+    if (available >= ring_len) {
+        if (iface->pcm.enabled) {
+            uac_ring_convert_out(ring, &iface->pcm, out_xfer->data_buffer, frames);
+        } else {
+            uac_ring_copy_out(ring, out_xfer->data_buffer, data_len);
+        }
+        uac_ring_read_release(ring, ring_len);
+        data_ready = true;
+    } else if (iface->flags & (FLAG_STREAM_TX_CONCEAL_SILENCE | FLAG_STREAM_TX_CONCEAL_REPEAT)) {
+        // send the whole frames there are, the rest is concealed and the stream continues in its time
+        const size_t app_frame_size = iface->pcm.enabled ? iface->pcm.src_frame_size : iface->frame_size;
+        const size_t ring_frames = available / app_frame_size;
+        if (iface->pcm.enabled) {
+            uac_ring_convert_out(ring, &iface->pcm, out_xfer->data_buffer, ring_frames);
+        } else {
+            uac_ring_copy_out(ring, out_xfer->data_buffer, ring_frames * iface->frame_size);
+        }
+        uac_ring_read_release(ring, ring_frames * app_frame_size);
+        stream_tx_conceal(iface, out_xfer->data_buffer, ring_frames * iface->frame_size, data_len);
+        iface->stats.tx_concealed_count++;
+        iface->stats.tx_concealed_frames += frames - ring_frames;
+        data_ready = true;
+    }
+    if (data_ready) {
+        out_xfer->num_bytes = data_len;
+        iface->rate_remainder = remainder;
+        if ((iface->flags & FLAG_STREAM_TX_CONCEAL_REPEAT) && iface->frame_size <= UAC_TX_LAST_FRAME_MAX && frames) {
+            memcpy(iface->tx_last_frame, out_xfer->data_buffer + (frames - 1) * iface->frame_size, iface->frame_size);
+        }
+    }
+    portEXIT_CRITICAL(&iface->tx_lock);
+    if (data_ready) {
         // Relaunch transfer, as the pipe state may change
         // the transfer may fail eg. the device is disconnected or the pipe is suspended
         // the data in ringbuffer will be dropped without notify user
-        usb_host_transfer_submit(out_xfer);
-        data_len = _ring_buffer_get_len(iface->ringbuf);
-        if (data_len <= iface->ringbuf_threshold) {
+        CLIENT_TRANSFER_SUBMIT(out_xfer);
+        if (uac_ring_get_len(ring) <= iface->ringbuf_threshold) {
             // Notify user send done
             uac_host_user_interface_callback(iface, UAC_HOST_DEVICE_EVENT_TX_DONE);
         }
+        return true;
     } else {
         // add the transfer to free list
-        UAC_ENTER_CRITICAL();
-        for (int i = 0; i < iface->xfer_num; i++) {
-            if (iface->xfer_list[i] == out_xfer) {
-                iface->free_xfer_list[i] = out_xfer;
-                iface->xfer_list[i] = NULL;
-                break;
-            }
-        }
-        UAC_EXIT_CRITICAL();
+        stream_tx_xfer_park(iface, out_xfer);
         // Notify user send done
         uac_host_user_interface_callback(iface, UAC_HOST_DEVICE_EVENT_TX_DONE);
+        return false;
+    }
+}
+
+/**
+ * @brief Record the samples of a completed TX transfer as echo reference of the duplex pair
+ *
+ * @param[in] iface     Pointer to Interface structure
+ * @param[in] out_xfer  Pointer to completed TX transfer, its data are not overwritten yet
+ */
+static void UAC_DATA_PATH_ATTR stream_tx_record_ref(uac_iface_t *iface, const usb_transfer_t *out_xfer)
+{
+    uac_duplex_t *duplex = iface->duplex;
+    const size_t frames = out_xfer->num_bytes / iface->frame_size;
+    size_t recorded = 0;
+    if (UAC_ATOMIC_LOAD(duplex->ref_ready)) {
+        uac_ring_t *ring = &duplex->ref_ring;
+        recorded = MIN(frames, uac_ring_get_free(ring) / iface->frame_size);
+        uac_ring_copy_in(ring, 0, out_xfer->data_buffer, recorded * iface->frame_size);
+        uac_ring_write_commit(ring, recorded * iface->frame_size);
+    }
+    if (recorded < frames) {
+        // the reader skips the same number of microphone samples
+        UAC_ATOMIC_STORE(duplex->ref_dropped_frames, duplex->ref_dropped_frames + (uint32_t)(frames - recorded));
     }
 }
 
@@ -1205,9 +1627,10 @@ static void stream_tx_xfer_submit(usb_transfer_t *out_xfer)
  *
  * @param[in] transfer  Pointer to transfer data structure
  */
-static void stream_tx_xfer_done(usb_transfer_t *out_xfer)
+void UAC_DATA_PATH_ATTR stream_tx_xfer_done(usb_transfer_t *out_xfer)
 {
     assert(out_xfer);
+    CLIENT_TRACE_COMPLETE(out_xfer);
 
     uac_iface_t *iface = out_xfer->context;
     assert(iface);
@@ -1219,8 +1642,21 @@ static void stream_tx_xfer_done(usb_transfer_t *out_xfer)
 
     switch (out_xfer->status) {
     case USB_TRANSFER_STATUS_COMPLETED: {
-        // Submit the next transfer
-        stream_tx_xfer_submit(out_xfer);
+        stream_update_timing(iface, out_xfer);
+        if (iface->duplex) {
+            stream_tx_record_ref(iface, out_xfer);
+        }
+        for (int i = 0; i < out_xfer->num_isoc_packets; i++) {
+            if (out_xfer->isoc_packet_desc[i].status != USB_TRANSFER_STATUS_COMPLETED) {
+                iface->stats.tx_bad_packets++;
+            }
+        }
+        stream_stats_ring_fill(iface);
+        // Submit the next transfer, the stream runs short of data if it is not submitted
+        if (!stream_tx_xfer_submit(out_xfer)) {
+            ESP_LOGD(TAG, "TX Ringbuffer underrun");
+            iface->stats.tx_underrun_count++;
+        }
         return;
     }
     case USB_TRANSFER_STATUS_NO_DEVICE:
@@ -1230,19 +1666,12 @@ static void stream_tx_xfer_done(usb_transfer_t *out_xfer)
         return;
     default:
         // Any other error, add the transfer to free list
-        UAC_ENTER_CRITICAL();
-        for (int i = 0; i < iface->xfer_num; i++) {
-            if (iface->xfer_list[i] == out_xfer) {
-                iface->free_xfer_list[i] = out_xfer;
-                iface->xfer_list[i] = NULL;
-                break;
-            }
-        }
-        UAC_EXIT_CRITICAL();
+        stream_tx_xfer_park(iface, out_xfer);
         break;
     }
 
     ESP_LOGE(TAG, "Transfer failed, status %d", out_xfer->status);
+    iface->stats.xfer_errors++;
     // Notify user about transfer or any other error
     uac_host_user_interface_callback(iface, UAC_HOST_DEVICE_EVENT_TRANSFER_ERROR);
 }
@@ -1276,7 +1705,13 @@ static esp_err_t uac_host_interface_suspend(uac_iface_t *iface)
     UAC_RETURN_ON_ERROR(usb_host_endpoint_halt(iface->parent->dev_hdl, ep_addr), "Unable to HALT EP");
     UAC_RETURN_ON_ERROR(usb_host_endpoint_flush(iface->parent->dev_hdl, ep_addr), "Unable to FLUSH EP");
     usb_host_endpoint_clear(iface->parent->dev_hdl, ep_addr);
-    _ring_buffer_flush(iface->ringbuf);
+    if (iface->fb_xfer) {
+        uint8_t fb_ep_addr = iface->iface_alt[iface->cur_alt].fb_ep_addr;
+        UAC_RETURN_ON_ERROR(usb_host_endpoint_halt(iface->parent->dev_hdl, fb_ep_addr), "Unable to HALT feedback EP");
+        UAC_RETURN_ON_ERROR(usb_host_endpoint_flush(iface->parent->dev_hdl, fb_ep_addr), "Unable to FLUSH feedback EP");
+        usb_host_endpoint_clear(iface->parent->dev_hdl, fb_ep_addr);
+    }
+    stream_ring_flush(iface);
 
     // add all the transfer to free list
     UAC_ENTER_CRITICAL();
@@ -1284,6 +1719,7 @@ static esp_err_t uac_host_interface_suspend(uac_iface_t *iface)
         if (iface->xfer_list[i]) {
             iface->free_xfer_list[i] = iface->xfer_list[i];
             iface->xfer_list[i] = NULL;
+            UAC_ATOMIC_FETCH_OR(iface->free_xfer_mask, 1UL << i);
         }
     }
     UAC_EXIT_CRITICAL();
@@ -1294,12 +1730,12 @@ static esp_err_t uac_host_interface_suspend(uac_iface_t *iface)
 }
 
 /**
- * @brief Resume suspended interface, the interface will be in ACTIVE state
+ * @brief Set the alternate setting and sampling frequency of a suspended interface, before its transfers are submitted
  *
  * @param[in] iface       Pointer to Interface structure
  * @return esp_err_t
  */
-static esp_err_t uac_host_interface_resume(uac_iface_t *iface)
+static esp_err_t uac_host_interface_set_stream_alt(uac_iface_t *iface)
 {
     UAC_RETURN_ON_INVALID_ARG(iface);
     UAC_RETURN_ON_INVALID_ARG(iface->parent);
@@ -1312,12 +1748,30 @@ static esp_err_t uac_host_interface_resume(uac_iface_t *iface)
     USB_SETUP_PACKET_INIT_SET_INTERFACE(&request, iface->dev_info.iface_num, iface->cur_alt + 1);
     UAC_RETURN_ON_ERROR(uac_cs_request_set(iface->parent, (uac_cs_request_t *)&request), "Unable to set Interface alternate");
     ESP_LOGI(TAG, "Set Interface %d-%d", iface->dev_info.iface_num, iface->cur_alt + 1);
-    // Set endpoint frequency control
-    if (iface->iface_alt[iface->cur_alt].freq_ctrl_supported) {
+    // Set endpoint frequency control, UAC 2.0 sets the frequency of the clock source
+    if (iface->parent->bcdADC >= UAC_VERSION_2) {
+        UAC_RETURN_ON_ERROR(uac2_cs_request_set_clock(iface), "Unable to set clock");
+    } else if (iface->iface_alt[iface->cur_alt].freq_ctrl_supported) {
         ESP_LOGI(TAG, "Set EP %02X frequency %"PRIu32, iface->iface_alt[iface->cur_alt].ep_addr, iface->iface_alt[iface->cur_alt].cur_sampling_freq);
         UAC_RETURN_ON_ERROR(uac_cs_request_set_ep_frequency(iface, iface->iface_alt[iface->cur_alt].ep_addr,
                             iface->iface_alt[iface->cur_alt].cur_sampling_freq), "Unable to set endpoint frequency");
     }
+    return ESP_OK;
+}
+
+/**
+ * @brief Submit the stream transfers of a suspended interface, the interface will be in ACTIVE state
+ *
+ * No control transfers are issued, so the streams of several interfaces can be submitted right after each other.
+ *
+ * @param[in] iface       Pointer to Interface structure, the alternate setting must be set
+ * @return esp_err_t
+ */
+static esp_err_t uac_host_interface_submit_stream(uac_iface_t *iface)
+{
+    UAC_ENTER_CRITICAL();
+    memset(&iface->timing, 0, sizeof(iface->timing));
+    UAC_EXIT_CRITICAL();
     // for RX, we just submit all the transfers
     if (iface->dev_info.type == UAC_STREAM_RX) {
         assert(iface->iface_alt[iface->cur_alt].ep_addr & 0x80);
@@ -1336,7 +1790,8 @@ static esp_err_t uac_host_interface_resume(uac_iface_t *iface)
             }
             iface->xfer_list[i] = iface->free_xfer_list[i];
             iface->free_xfer_list[i] = NULL;
-            UAC_RETURN_ON_ERROR(usb_host_transfer_submit(iface->xfer_list[i]), "Unable to submit RX transfer");
+            UAC_ATOMIC_FETCH_AND(iface->free_xfer_mask, ~(1UL << i));
+            UAC_RETURN_ON_ERROR(CLIENT_TRANSFER_SUBMIT(iface->xfer_list[i]), "Unable to submit RX transfer");
         }
     } else if (iface->dev_info.type == UAC_STREAM_TX) {
         assert(!(iface->iface_alt[iface->cur_alt].ep_addr & 0x80));
@@ -1356,14 +1811,46 @@ static esp_err_t uac_host_interface_resume(uac_iface_t *iface)
             }
             iface->free_xfer_list[i]->num_bytes = iface->packet_num * iface->packet_size;
         }
+        iface->rate_remainder = 0;
+        memset(iface->tx_last_frame, 0, sizeof(iface->tx_last_frame));
+        UAC_ATOMIC_STORE(iface->fb_rate, 0);
+        // for asynchronous endpoint, poll the feedback endpoint for the rate the device consumes the samples
+        if (iface->fb_xfer) {
+            iface->fb_xfer->device_handle = iface->parent->dev_hdl;
+            iface->fb_xfer->callback = stream_fb_xfer_done;
+            iface->fb_xfer->context = iface;
+            iface->fb_xfer->timeout_ms = DEFAULT_ISOC_XFER_TIMEOUT_MS;
+            iface->fb_xfer->bEndpointAddress = iface->iface_alt[iface->cur_alt].fb_ep_addr;
+            iface->fb_xfer->num_bytes = iface->iface_alt[iface->cur_alt].fb_ep_mps;
+            iface->fb_xfer->isoc_packet_desc[0].num_bytes = iface->iface_alt[iface->cur_alt].fb_ep_mps;
+        }
     }
 
     // for TX, we check if data is available in the ringbuffer, if yes, we submit the transfer
     iface->state = UAC_INTERFACE_STATE_ACTIVE;
+    if (iface->fb_xfer && CLIENT_TRANSFER_SUBMIT(iface->fb_xfer) != ESP_OK) {
+        ESP_LOGW(TAG, "Unable to submit feedback transfer, stream at nominal rate");
+    }
+    // with underrun concealment, the transfers run from the start, the written data join them
+    if (iface->dev_info.type == UAC_STREAM_TX && (iface->flags & (FLAG_STREAM_TX_CONCEAL_SILENCE | FLAG_STREAM_TX_CONCEAL_REPEAT))) {
+        return uac_host_interface_submit_tx(iface);
+    }
 
     return ESP_OK;
 }
 
+/**
+ * @brief Resume suspended interface, the interface will be in ACTIVE state
+ *
+ * @param[in] iface       Pointer to Interface structure
+ * @return esp_err_t
+ */
+static esp_err_t uac_host_interface_resume(uac_iface_t *iface)
+{
+    UAC_RETURN_ON_ERROR(uac_host_interface_set_stream_alt(iface), "Unable to set stream alternate setting");
+    return uac_host_interface_submit_stream(iface);
+}
+
 /**
  * @brief Add UAC physical device to the list
  * @param[in] addr          USB device address
@@ -1377,7 +1864,7 @@ static esp_err_t _uac_host_device_add(uint8_t addr, usb_device_handle_t dev_hdl,
     assert(config_desc);
     esp_err_t ret;
     uac_device_t *uac_device;
-    UAC_GOTO_ON_FALSE(uac_device = calloc(1, sizeof(uac_device_t)), ESP_ERR_NO_MEM, "Unable to allocate memory for UAC Device");
+    UAC_GOTO_ON_FALSE(uac_device = UAC_CALLOC(CONTROL, 1, sizeof(uac_device_t)), ESP_ERR_NO_MEM, "Unable to allocate memory for UAC Device");
 
     uac_device->addr = addr;
     uac_device->dev_hdl = dev_hdl;
@@ -1405,16 +1892,19 @@ static esp_err_t _uac_host_device_add(uint8_t addr, usb_device_handle_t dev_hdl,
                 switch (uac_cs_desc->bDescriptorSubtype) {
                 case UAC_AC_HEADER: {
                     const uac_ac_header_desc_t *header_desc = (const uac_ac_header_desc_t *)uac_cs_desc;
-                    if (header_desc->bcdADC != 0x0100) {
+                    if (header_desc->bcdADC != UAC_VERSION_1 && header_desc->bcdADC != UAC_VERSION_2) {
                         ESP_LOGW(TAG, "UAC version 0x%04X not supported", header_desc->bcdADC);
-                        free(uac_device);
+                        UAC_FREE(CONTROL, uac_device, sizeof(uac_device_t));
                         return ESP_ERR_NOT_SUPPORTED;
                     }
-                    uint8_t *cs_ac_desc = calloc(header_desc->wTotalLength, sizeof(uint8_t));
+                    const size_t cs_ac_length = _uac_ac_total_length((const uint8_t *)header_desc);
+                    uint8_t *cs_ac_desc = UAC_CALLOC(DESCRIPTOR, cs_ac_length, sizeof(uint8_t));
                     UAC_GOTO_ON_FALSE(cs_ac_desc, ESP_ERR_NO_MEM, "Unable to allocate memory for UAC Control CS descriptor");
-                    memcpy(cs_ac_desc, uac_cs_desc, header_desc->wTotalLength);
+                    memcpy(cs_ac_desc, uac_cs_desc, cs_ac_length);
                     uac_device->cs_ac_desc = cs_ac_desc;
+                    uac_device->bcdADC = header_desc->bcdADC;
                     ESP_LOGD(TAG, "UAC version 0x%04X", header_desc->bcdADC);
+                    UAC_GOTO_ON_ERROR(_uac_topology_build(uac_device), "Unable to build UAC topology");
                     break;
                 }
                 default:
@@ -1437,7 +1927,7 @@ static esp_err_t _uac_host_device_add(uint8_t addr, usb_device_handle_t dev_hdl,
     UAC_GOTO_ON_FALSE(uac_device->device_busy =  xSemaphoreCreateMutex(), ESP_ERR_NO_MEM, "Unable to create mutex");
 
     // Allocate control transfer buffer
-    UAC_GOTO_ON_ERROR(usb_host_transfer_alloc(64, 0, &uac_device->ctrl_xfer), "Unable to allocate transfer buffer");
+    UAC_GOTO_ON_ERROR(CLIENT_TRANSFER_ALLOC(64, 0, &uac_device->ctrl_xfer), "Unable to allocate transfer buffer");
 
     UAC_GOTO_ON_FALSE_CRITICAL(s_uac_driver, ESP_ERR_INVALID_STATE);
     UAC_GOTO_ON_FALSE_CRITICAL(s_uac_driver->client_handle, ESP_ERR_INVALID_STATE);
@@ -1466,7 +1956,7 @@ static esp_err_t _uac_host_device_delete(uac_device_t *uac_device)
     UAC_RETURN_ON_INVALID_ARG(uac_device);
 
     if (uac_device->ctrl_xfer) {
-        UAC_RETURN_ON_ERROR(usb_host_transfer_free(uac_device->ctrl_xfer), "Unable to free transfer buffer for EP0");
+        UAC_RETURN_ON_ERROR(CLIENT_TRANSFER_FREE(uac_device->ctrl_xfer), "Unable to free transfer buffer for EP0");
     }
 
     if (uac_device->ctrl_xfer_done) {
@@ -1477,8 +1967,9 @@ static esp_err_t _uac_host_device_delete(uac_device_t *uac_device)
         vSemaphoreDelete(uac_device->device_busy);
     }
 
+    UAC_FREE(DESCRIPTOR, uac_device->entities, uac_device->entity_alloc_num * sizeof(uac_entity_t));
     if (uac_device->cs_ac_desc) {
-        free(uac_device->cs_ac_desc);
+        UAC_FREE(DESCRIPTOR, uac_device->cs_ac_desc, _uac_ac_total_length(uac_device->cs_ac_desc));
     }
 
     ESP_LOGD(TAG, "Remove addr %d device from list", uac_device->addr);
@@ -1487,7 +1978,7 @@ static esp_err_t _uac_host_device_delete(uac_device_t *uac_device)
     STAILQ_REMOVE(&s_uac_driver->uac_devices_tailq, uac_device, uac_host_device, tailq_entry);
     UAC_EXIT_CRITICAL();
 
-    free(uac_device);
+    UAC_FREE(CONTROL, uac_device, sizeof(uac_device_t));
     return ESP_OK;
 }
 
@@ -1521,6 +2012,7 @@ static inline void _uac_host_device_unlock(uac_device_t *uac_device)
 static void ctrl_xfer_done(usb_transfer_t *ctrl_xfer)
 {
     assert(ctrl_xfer);
+    CLIENT_TRACE_COMPLETE(ctrl_xfer);
     uac_device_t *uac_device = (uac_device_t *)ctrl_xfer->context;
     xSemaphoreGive(uac_device->ctrl_xfer_done);
 }
@@ -1545,7 +2037,7 @@ static esp_err_t uac_control_transfer(uac_device_t *uac_device, int len, uint32_
     ctrl_xfer->timeout_ms = timeout_ms;
     ctrl_xfer->num_bytes = len;
 
-    UAC_RETURN_ON_ERROR(usb_host_transfer_submit_control(s_uac_driver->client_handle, ctrl_xfer), "Unable to submit control transfer");
+    UAC_RETURN_ON_ERROR(CLIENT_TRANSFER_SUBMIT_CONTROL(s_uac_driver->client_handle, ctrl_xfer), "Unable to submit control transfer");
 
     BaseType_t received = xSemaphoreTake(uac_device->ctrl_xfer_done, pdMS_TO_TICKS(ctrl_xfer->timeout_ms));
 
@@ -1680,6 +2172,102 @@ static esp_err_t uac_cs_request_set_ep_frequency(uac_iface_t *iface, uint8_t ep_
     return uac_cs_request_set(iface->parent, &set_freq);
 }
 
+/**
+ * @brief UAC 2.0 class specific request - Select the clock source and set its frequency
+ * @param[in] iface       Pointer to UAC interface structure
+ * @return esp_err_t
+ */
+static esp_err_t uac2_cs_request_set_clock(uac_iface_t *iface)
+{
+    const uac_iface_alt_t *iface_alt = &iface->iface_alt[iface->cur_alt];
+    const uint8_t ctrl_iface_num = iface->parent->ctrl_iface_num;
+
+    if (iface_alt->clock_selector) {
+        uint8_t pin = iface_alt->clock_selector_pin;
+        const uac_cs_request_t set_selector = {
+            .bRequest = UAC2_CUR,
+            .wValue = UAC2_CX_CLOCK_SELECTOR_CONTROL << 8,
+            .wIndex = (iface_alt->clock_selector << 8) | (ctrl_iface_num & 0xff),
+            .wLength = 1,
+            .data = &pin
+        };
+        ESP_LOGI(TAG, "Set Clock Selector %d input %d", iface_alt->clock_selector, pin);
+        UAC_RETURN_ON_ERROR(uac_cs_request_set(iface->parent, &set_selector), "Unable to set clock selector");
+    }
+    if (!iface_alt->freq_ctrl_supported) {
+        return ESP_OK;
+    }
+
+    uint8_t tmp[4] = { 0, 0, 0, 0 };
+    const uac_cs_request_t set_freq = {
+        .bRequest = UAC2_CUR,
+        .wValue = UAC2_CS_SAM_FREQ_CONTROL << 8,
+        .wIndex = (iface_alt->clock_source << 8) | (ctrl_iface_num & 0xff),
+        .wLength = 4,
+        .data = tmp
+    };
+    tmp[0] = iface_alt->cur_sampling_freq & 0xff;
+    tmp[1] = (iface_alt->cur_sampling_freq >> 8) & 0xff;
+    tmp[2] = (iface_alt->cur_sampling_freq >> 16) & 0xff;
+    tmp[3] = (iface_alt->cur_sampling_freq >> 24) & 0xff;
+    ESP_LOGI(TAG, "Set Clock Source %d frequency %"PRIu32, iface_alt->clock_source, iface_alt->cur_sampling_freq);
+    return uac_cs_request_set(iface->parent, &set_freq);
+}
+
+/**
+ * @brief UAC 2.0 class specific request - Get the sampling frequencies of the clock source
+ *
+ * Subranges with equal MIN and MAX are discrete frequencies, otherwise the range from the lowest MIN
+ * to the highest MAX is reported as continuous
+ *
+ * @param[in] iface       Pointer to UAC interface structure
+ * @param[out] iface_alt  Alternate setting receiving the frequencies
+ * @return esp_err_t
+ */
+static esp_err_t uac2_cs_request_get_freq_range(uac_iface_t *iface, uac_iface_alt_t *iface_alt)
+{
+    UAC_RETURN_ON_FALSE(iface_alt->clock_source, ESP_ERR_NOT_SUPPORTED, "No clock source");
+    // wNumSubRanges followed by MIN, MAX and RES of 4 bytes each, longer responses are truncated
+    uint8_t tmp[2 + 12 * UAC_FREQ_NUM_MAX] = { 0 };
+    const size_t max_length = iface->parent->ctrl_xfer->data_buffer_size - USB_SETUP_PACKET_SIZE;
+    const uac_cs_request_t get_range = {
+        .bRequest = UAC2_RANGE,
+        .wValue = UAC2_CS_SAM_FREQ_CONTROL << 8,
+        .wIndex = (iface_alt->clock_source << 8) | (iface->parent->ctrl_iface_num & 0xff),
+        .wLength = MIN(sizeof(tmp), max_length),
+        .data = tmp
+    };
+
+    size_t actual_length = 0;
+    UAC_RETURN_ON_ERROR(uac_cs_request_get(iface->parent, &get_range, &actual_length), "Unable to get frequency range");
+    UAC_RETURN_ON_FALSE(actual_length >= 2 + 12, ESP_ERR_INVALID_RESPONSE, "Invalid frequency range");
+    const size_t num_ranges = MIN(tmp[0] | (tmp[1] << 8), (actual_length - 2) / 12);
+
+    bool discrete = true;
+    uint32_t lower = UINT32_MAX;
+    uint32_t upper = 0;
+    for (size_t i = 0; i < num_ranges; i++) {
+        const uint8_t *range = &tmp[2 + 12 * i];
+        const uint32_t min = range[0] | (range[1] << 8) | (range[2] << 16) | ((uint32_t)range[3] << 24);
+        const uint32_t max = range[4] | (range[5] << 8) | (range[6] << 16) | ((uint32_t)range[7] << 24);
+        discrete &= (min == max);
+        lower = MIN(lower, min);
+        upper = MAX(upper, max);
+        if (i < UAC_FREQ_NUM_MAX) {
+            iface_alt->dev_alt_param.sample_freq[i] = min;
+        }
+    }
+    if (discrete) {
+        iface_alt->dev_alt_param.sample_freq_type = MIN(num_ranges, UAC_FREQ_NUM_MAX);
+    } else {
+        iface_alt->dev_alt_param.sample_freq_type = 0;
+        iface_alt->dev_alt_param.sample_freq_lower = lower;
+        iface_alt->dev_alt_param.sample_freq_upper = upper;
+    }
+    ESP_LOGD(TAG, "UAC Clock Source %d, %d frequency ranges, %"PRIu32" - %"PRIu32, iface_alt->clock_source, (int)num_ranges, lower, upper);
+    return ESP_OK;
+}
+
 /**
  * @brief UAC class specific request - Set Volume
  * @param[in] iface       Pointer to UAC interface structure
@@ -1730,7 +2318,7 @@ static esp_err_t uac_cs_request_get_volume(uac_iface_t *iface, int16_t *volume_d
     esp_err_t ret = ESP_OK;
 
     uac_cs_request_t get_volume = {
-        .bRequest = UAC_GET_CUR,
+        .bRequest = iface->parent->bcdADC >= UAC_VERSION_2 ? UAC2_CUR : UAC_GET_CUR,
         .wIndex = (feature_unit << 8) | (ctrl_iface_num & 0xff),
         .wLength = 2,
         .data = tmp
@@ -1766,6 +2354,15 @@ static esp_err_t uac_cs_request_get_volume_range(uac_iface_t *iface, int16_t *vo
     uint8_t tmp[2] = { 0, 0 };
     int16_t volume_min, volume_max, volume_res = 0;
 
+    // the range is constant, it is requested once for each feature unit of the device
+    uac_entity_t *entity = _uac_topology_get(iface->parent, feature_unit);
+    if (entity && entity->vol_range_valid) {
+        *volume_min_db = entity->vol_min_db;
+        *volume_max_db = entity->vol_max_db;
+        *volume_res_db = entity->vol_res_db;
+        return ESP_OK;
+    }
+
     uac_cs_request_t get_volume = {
         .bRequest = UAC_GET_MIN,
         .wIndex = (feature_unit << 8) | (ctrl_iface_num & 0xff),
@@ -1782,6 +2379,22 @@ static esp_err_t uac_cs_request_get_volume_range(uac_iface_t *iface, int16_t *vo
     }
 
     size_t actual_length = 0;
+    if (iface->parent->bcdADC >= UAC_VERSION_2) {
+        // UAC 2.0 returns wNumSubRanges followed by MIN, MAX and RES of the first subrange
+        uint8_t range[8] = { 0 };
+        get_volume.bRequest = UAC2_RANGE;
+        get_volume.wLength = sizeof(range);
+        get_volume.data = range;
+        ret = uac_cs_request_get(iface->parent, &get_volume, &actual_length);
+        if (ret != ESP_OK || actual_length != get_volume.wLength) {
+            ESP_LOGE(TAG, "Failed to get volume range");
+            return ESP_FAIL;
+        }
+        volume_min = range[2] | (range[3] << 8);
+        volume_max = range[4] | (range[5] << 8);
+        volume_res = range[6] | (range[7] << 8);
+        goto done;
+    }
     ret = uac_cs_request_get(iface->parent, &get_volume, &actual_length);
     if (ret != ESP_OK || actual_length != get_volume.wLength) {
         ESP_LOGE(TAG, "Failed to get volume min");
@@ -1804,9 +2417,17 @@ static esp_err_t uac_cs_request_get_volume_range(uac_iface_t *iface, int16_t *vo
         return ESP_FAIL;
     }
     volume_res = tmp[0] | (tmp[1] << 8);
+
+done:
     *volume_min_db = volume_min;
     *volume_max_db = volume_max;
     *volume_res_db = volume_res;
+    if (entity) {
+        entity->vol_min_db = volume_min;
+        entity->vol_max_db = volume_max;
+        entity->vol_res_db = volume_res;
+        entity->vol_range_valid = true;
+    }
 
     ESP_LOGD(TAG, "Volume range: min %.4fdb (0x%04X), max %.4fdb (0x%04X), res %.4fdb (0x%04X)", _volume_db_i16_2_f(volume_min), volume_min,
              _volume_db_i16_2_f(volume_max), volume_max, _volume_db_i16_2_f(volume_res), volume_res);
@@ -1862,7 +2483,7 @@ static esp_err_t uac_cs_request_get_mute(uac_iface_t *iface, bool *mute)
     esp_err_t ret = ESP_OK;
 
     uac_cs_request_t get_mute = {
-        .bRequest = UAC_GET_CUR,
+        .bRequest = iface->parent->bcdADC >= UAC_VERSION_2 ? UAC2_CUR : UAC_GET_CUR,
         .wIndex = (feature_unit << 8) | (ctrl_iface_num & 0xff),
         .wLength = 1,
         .data = tmp
@@ -1888,6 +2509,91 @@ static esp_err_t uac_cs_request_get_mute(uac_iface_t *iface, bool *mute)
     return ret;
 }
 
+#if USB_HOST_SHARED_CLIENT_ENABLED
+/**
+ * @brief Suspend all active streams before bus suspend
+ *
+ * The streams set alternate setting 0 and return their transfers, as by uac_host_device_suspend().
+ * A stream is marked before it is suspended, so a stream that failed to suspend is resumed by uac_pm_resume().
+ *
+ * @param[in] arg  Argument, does not used
+ * @return esp_err_t
+ */
+static esp_err_t uac_pm_suspend(void *arg)
+{
+    esp_err_t ret = ESP_OK;
+    UAC_ENTER_CRITICAL();
+    uac_iface_t *iface = STAILQ_FIRST(&s_uac_driver->uac_ifaces_tailq);
+    while (iface != NULL && ret == ESP_OK) {
+        uac_iface_t *next = STAILQ_NEXT(iface, tailq_entry);
+        UAC_EXIT_CRITICAL();
+
+        ret = uac_host_interface_try_lock(iface, DEFAULT_CTRL_XFER_TIMEOUT_MS);
+        if (ret == ESP_OK) {
+            if (UAC_INTERFACE_STATE_ACTIVE == iface->state) {
+                iface->suspended = true;
+                ret = uac_host_interface_suspend(iface);
+            }
+            uac_host_interface_unlock(iface);
+        }
+        iface = next;
+
+        UAC_ENTER_CRITICAL();
+    }
+    UAC_EXIT_CRITICAL();
+    return ret;
+}
+
+/**
+ * @brief Resume streams suspended by uac_pm_suspend(), with their alternate setting and sampling frequency
+ *
+ * @param[in] arg  Argument, does not used
+ * @return esp_err_t
+ */
+static esp_err_t uac_pm_resume(void *arg)
+{
+    esp_err_t ret = ESP_OK;
+    UAC_ENTER_CRITICAL();
+    uac_iface_t *iface = STAILQ_FIRST(&s_uac_driver->uac_ifaces_tailq);
+    while (iface != NULL) {
+        uac_iface_t *next = STAILQ_NEXT(iface, tailq_entry);
+        UAC_EXIT_CRITICAL();
+
+        esp_err_t err = uac_host_interface_try_lock(iface, DEFAULT_CTRL_XFER_TIMEOUT_MS);
+        if (err == ESP_OK) {
+            if (iface->suspended && UAC_INTERFACE_STATE_READY == iface->state) {
+                err = uac_host_interface_resume(iface);
+            }
+            iface->suspended = false;
+            uac_host_interface_unlock(iface);
+        }
+        if (err != ESP_OK && ret == ESP_OK) {
+            ret = err;
+        }
+        iface = next;
+
+        UAC_ENTER_CRITICAL();
+    }
+    UAC_EXIT_CRITICAL();
+    return ret;
+}
+
+static const usb_host_pm_ops_t uac_pm_ops = {
+    .suspend = uac_pm_suspend,
+    .resume = uac_pm_resume,
+};
+#endif // USB_HOST_SHARED_CLIENT_ENABLED
+
+static esp_err_t client_deregister(uac_driver_t *driver)
+{
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    if (driver->shared_client) {
+        return usb_host_shared_client_deregister(client_event_cb, NULL);
+    }
+#endif
+    return usb_host_client_deregister(driver->client_handle);
+}
+
 esp_err_t uac_host_install(const uac_host_driver_config_t *config)
 {
     esp_err_t ret;
@@ -1895,18 +2601,22 @@ esp_err_t uac_host_install(const uac_host_driver_config_t *config)
     UAC_RETURN_ON_FALSE(!s_uac_driver, ESP_ERR_INVALID_STATE, "UAC Host driver is already installed");
     UAC_RETURN_ON_INVALID_ARG(config);
     UAC_RETURN_ON_INVALID_ARG(config->callback);
+#if !USB_HOST_SHARED_CLIENT_ENABLED
+    UAC_RETURN_ON_FALSE(!config->shared_client, ESP_ERR_NOT_SUPPORTED, "usb_host_shared_client component is not in the build");
+#endif
 
-    if (config->create_background_task) {
+    if (config->create_background_task && !config->shared_client) {
         UAC_RETURN_ON_FALSE(config->stack_size != 0, ESP_ERR_INVALID_ARG, "Wrong stack size value");
         UAC_RETURN_ON_FALSE(config->task_priority != 0, ESP_ERR_INVALID_ARG, "Wrong task priority value");
         UAC_RETURN_ON_FALSE(config->core_id < 2, ESP_ERR_INVALID_ARG, "Wrong core id value");
     }
 
-    uac_driver_t *driver = heap_caps_calloc(1, sizeof(uac_driver_t), MALLOC_CAP_DEFAULT);
+    uac_driver_t *driver = UAC_CALLOC(CONTROL, 1, sizeof(uac_driver_t));
     UAC_RETURN_ON_FALSE(driver, ESP_ERR_NO_MEM, "Unable to allocate memory");
 
     driver->user_cb = config->callback;
     driver->user_arg = config->callback_arg;
+    driver->shared_client = config->shared_client;
     driver->end_client_event_handling = false;
     driver->all_events_handled = xSemaphoreCreateBinary();
     UAC_GOTO_ON_FALSE(driver->all_events_handled, ESP_ERR_NO_MEM, "Unable to create semaphore");
@@ -1917,7 +2627,14 @@ esp_err_t uac_host_install(const uac_host_driver_config_t *config)
         .async.callback_arg = NULL,
         .max_num_event_msg = 16,
     };
-    UAC_GOTO_ON_ERROR(usb_host_client_register(&client_config, &driver->client_handle), "Unable to register USB Host client");
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    if (driver->shared_client) {
+        UAC_GOTO_ON_ERROR(usb_host_shared_client_register(client_event_cb, NULL, &driver->client_handle), "Unable to register to shared USB Host client");
+    } else
+#endif
+    {
+        UAC_GOTO_ON_ERROR(usb_host_client_register(&client_config, &driver->client_handle), "Unable to register USB Host client");
+    }
 
     UAC_ENTER_CRITICAL();
     s_uac_driver = driver;
@@ -1925,23 +2642,27 @@ esp_err_t uac_host_install(const uac_host_driver_config_t *config)
     STAILQ_INIT(&s_uac_driver->uac_ifaces_tailq);
     UAC_EXIT_CRITICAL();
 
-    if (config->create_background_task) {
+    if (config->create_background_task && !driver->shared_client) {
         BaseType_t task_created = xTaskCreatePinnedToCore(event_handler_task, "USB UAC Host", config->stack_size,
                                   NULL, config->task_priority, NULL, config->core_id);
         UAC_GOTO_ON_FALSE(task_created, ESP_ERR_NO_MEM, "Unable to create USB UAC Host task");
     }
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    // Only fails if the driver is registered already, which the check of s_uac_driver excludes
+    ESP_ERROR_CHECK(usb_host_pm_register(USB_HOST_PM_DRIVER_UAC, &uac_pm_ops, NULL));
+#endif
     ESP_LOGI(TAG, "Install Succeed, Version: %d.%d.%d", USB_HOST_UAC_VER_MAJOR, USB_HOST_UAC_VER_MINOR, USB_HOST_UAC_VER_PATCH);
     return ESP_OK;
 
 fail:
     s_uac_driver = NULL;
     if (driver->client_handle) {
-        usb_host_client_deregister(driver->client_handle);
+        client_deregister(driver);
     }
     if (driver->all_events_handled) {
         vSemaphoreDelete(driver->all_events_handled);
     }
-    free(driver);
+    UAC_FREE(CONTROL, driver, sizeof(uac_driver_t));
     return ret;
 }
 
@@ -1959,14 +2680,22 @@ esp_err_t uac_host_uninstall(void)
     s_uac_driver->end_client_event_handling = true;
     UAC_EXIT_CRITICAL();
 
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    // Fails if suspend or resume is in progress, its hooks use the driver
+    if (usb_host_pm_deregister(USB_HOST_PM_DRIVER_UAC) != ESP_OK) {
+        s_uac_driver->end_client_event_handling = false;
+        return ESP_ERR_INVALID_STATE;
+    }
+#endif
+
     if (s_uac_driver->event_handling_started) {
         ESP_ERROR_CHECK(usb_host_client_unblock(s_uac_driver->client_handle));
         // In case the event handling started, we must wait until it finishes
         xSemaphoreTake(s_uac_driver->all_events_handled, portMAX_DELAY);
     }
     vSemaphoreDelete(s_uac_driver->all_events_handled);
-    ESP_ERROR_CHECK(usb_host_client_deregister(s_uac_driver->client_handle));
-    free(s_uac_driver);
+    ESP_ERROR_CHECK(client_deregister(s_uac_driver));
+    UAC_FREE(CONTROL, s_uac_driver, sizeof(uac_driver_t));
     s_uac_driver = NULL;
     return ESP_OK;
 }
@@ -1980,8 +2709,10 @@ esp_err_t uac_host_device_open(const uac_host_device_config_t *config, uac_host_
     UAC_RETURN_ON_FALSE(s_uac_driver, ESP_ERR_INVALID_STATE, "UAC Driver is not installed");
     UAC_RETURN_ON_FALSE(config->addr, ESP_ERR_INVALID_ARG, "Invalid device address");
     UAC_RETURN_ON_FALSE(config->iface_num, ESP_ERR_INVALID_ARG, "Invalid interface number");
-    UAC_RETURN_ON_FALSE(config->buffer_size, ESP_ERR_INVALID_ARG, "Invalid buffer size");
-    UAC_RETURN_ON_FALSE(config->buffer_size > config->buffer_threshold, ESP_ERR_INVALID_ARG, "Invalid buffer threshold");
+    if (!config->rx_data_cb) {
+        UAC_RETURN_ON_FALSE(config->buffer_size, ESP_ERR_INVALID_ARG, "Invalid buffer size");
+        UAC_RETURN_ON_FALSE(config->buffer_size > config->buffer_threshold, ESP_ERR_INVALID_ARG, "Invalid buffer threshold");
+    }
 
     ESP_LOGD(TAG, "Open Device addr %d, iface %d", config->addr, config->iface_num);
     // Check if the logic device/interface is already added
@@ -1998,7 +2729,7 @@ esp_err_t uac_host_device_open(const uac_host_device_config_t *config, uac_host_
     bool new_device = false;
     usb_device_handle_t dev_hdl = NULL;
     if (!uac_device) {
-        UAC_GOTO_ON_ERROR(usb_host_device_open(s_uac_driver->client_handle, config->addr, &dev_hdl), "Unable to open USB device");
+        UAC_GOTO_ON_ERROR(CLIENT_DEVICE_OPEN(s_uac_driver->client_handle, config->addr, &dev_hdl), "Unable to open USB device");
         ESP_LOGD(TAG, "line %d, Open Device addr %d", __LINE__, config->addr);
         const usb_config_desc_t *config_desc;
         UAC_GOTO_ON_ERROR(usb_host_get_active_config_descriptor(dev_hdl, &config_desc), "Unable to get active config descriptor");
@@ -2013,10 +2744,21 @@ esp_err_t uac_host_device_open(const uac_host_device_config_t *config, uac_host_
     // Save UAC Interface callback
     uac_iface->user_cb = config->callback;
     uac_iface->user_cb_arg = config->callback_arg;
-    // create a ringbuffer for the incoming/outgoing data
-    uac_iface->ringbuf = xRingbufferCreate(config->buffer_size, RINGBUF_TYPE_BYTEBUF);
-    UAC_GOTO_ON_FALSE(uac_iface->ringbuf, ESP_ERR_NO_MEM, "Unable to create ringbuffer");
-    uac_iface->ringbuf_size = config->buffer_size;
+    if (config->rx_data_cb) {
+        // received data are passed to the user in place, no ringbuffer needed
+        UAC_GOTO_ON_FALSE(uac_iface->dev_info.type == UAC_STREAM_RX, ESP_ERR_INVALID_ARG, "RX data callback for TX stream");
+        uac_iface->rx_data_cb = config->rx_data_cb;
+    } else if (config->staging_size) {
+        // large ringbuffer in PSRAM, fed by the mover task from the staging ringbuffer in internal RAM
+        UAC_GOTO_ON_FALSE(uac_iface->dev_info.type == UAC_STREAM_RX, ESP_ERR_INVALID_ARG, "Staging for TX stream");
+        UAC_GOTO_ON_ERROR(uac_ring_init_caps(&uac_iface->ringbuf, UAC_STAGE_ROUND_UP(config->buffer_size), UAC_STAGE_ALIGN,
+                                             MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT), "Unable to create ringbuffer in PSRAM");
+        UAC_GOTO_ON_ERROR(uac_stage_init(&uac_iface->stage, config->staging_size, &uac_iface->ringbuf, stream_rx_stage_moved, uac_iface),
+                          "Unable to create staging ringbuffer");
+    } else {
+        // create a ringbuffer for the incoming/outgoing data
+        UAC_GOTO_ON_ERROR(uac_ring_init(&uac_iface->ringbuf, config->buffer_size), "Unable to create ringbuffer");
+    }
     // if the threshold is not set, set it to 25% of the buffer size
     uac_iface->ringbuf_threshold = config->buffer_threshold ? config->buffer_threshold : config->buffer_size / 4;
     uac_iface->state = UAC_INTERFACE_STATE_IDLE;
@@ -2025,6 +2767,15 @@ esp_err_t uac_host_device_open(const uac_host_device_config_t *config, uac_host_
     uac_device->opened_cnt++;
     UAC_EXIT_CRITICAL();
 
+    // UAC 2.0 sampling frequencies are reported by the clock source
+    if (uac_device->bcdADC >= UAC_VERSION_2) {
+        for (int i = 0; i < uac_iface->dev_info.iface_alt_num; i++) {
+            if (uac2_cs_request_get_freq_range(uac_iface, &uac_iface->iface_alt[i]) != ESP_OK) {
+                ESP_LOGW(TAG, "Failed to get sampling frequencies of alt %d", i + 1);
+            }
+        }
+    }
+
     // Get the current volume range if the device supports volume control
     if (uac_iface->iface_alt[uac_iface->cur_alt].feature_unit && uac_iface->iface_alt[uac_iface->cur_alt].vol_ch_map) {
         ret = uac_cs_request_get_volume_range(uac_iface, &uac_iface->vol_min_db, &uac_iface->vol_max_db, &uac_iface->vol_res_db);
@@ -2037,16 +2788,15 @@ esp_err_t uac_host_device_open(const uac_host_device_config_t *config, uac_host_
 
 fail:
     if (uac_iface) {
+        uac_stage_deinit(&uac_iface->stage);
+        uac_ring_deinit(&uac_iface->ringbuf);
         uac_host_interface_delete(uac_iface);
     }
     if (new_device) {
         _uac_host_device_delete(uac_device);
     }
     if (dev_hdl) {
-        usb_host_device_close(s_uac_driver->client_handle, dev_hdl);
-    }
-    if (uac_iface->ringbuf) {
-        vRingbufferDelete(uac_iface->ringbuf);
+        CLIENT_DEVICE_CLOSE(s_uac_driver->client_handle, dev_hdl);
     }
     return ret;
 }
@@ -2085,14 +2835,14 @@ esp_err_t uac_host_device_open_with_vid_pid(uint16_t vid, uint16_t pid, const ua
             ESP_LOGD(TAG, "Found Device VID 0x%04X, PID 0x%04X", vid, pid);
             return uac_host_device_open(&config_copy, uac_dev_handle);
         } else {
-            UAC_RETURN_ON_ERROR(usb_host_device_open(s_uac_driver->client_handle, dev_addr_list[i], &dev_hdl), "Unable to open USB device");
+            UAC_RETURN_ON_ERROR(CLIENT_DEVICE_OPEN(s_uac_driver->client_handle, dev_addr_list[i], &dev_hdl), "Unable to open USB device");
             UAC_RETURN_ON_ERROR(usb_host_get_device_descriptor(dev_hdl, &dev_desc), "Unable to get device descriptor");
             ESP_LOGD(TAG, "Found Device VID 0x%04X, PID 0x%04X", dev_desc->idVendor, dev_desc->idProduct);
             if (dev_desc->idVendor == vid && dev_desc->idProduct == pid) {
-                usb_host_device_close(s_uac_driver->client_handle, dev_hdl);
+                CLIENT_DEVICE_CLOSE(s_uac_driver->client_handle, dev_hdl);
                 return uac_host_device_open(&config_copy, uac_dev_handle);
             }
-            usb_host_device_close(s_uac_driver->client_handle, dev_hdl);
+            CLIENT_DEVICE_CLOSE(s_uac_driver->client_handle, dev_hdl);
         }
     }
 
@@ -2125,7 +2875,7 @@ esp_err_t uac_host_device_close(uac_host_device_handle_t uac_dev_handle)
     UAC_ENTER_CRITICAL();
     if (--uac_iface->parent->opened_cnt == 0) {
         UAC_EXIT_CRITICAL();
-        UAC_GOTO_ON_ERROR(usb_host_device_close(s_uac_driver->client_handle, uac_iface->parent->dev_hdl), "Unable to close USB device");
+        UAC_GOTO_ON_ERROR(CLIENT_DEVICE_CLOSE(s_uac_driver->client_handle, uac_iface->parent->dev_hdl), "Unable to close USB device");
         ESP_LOGD(TAG, "line %d, Close Device addr %d", __LINE__, uac_iface->parent->addr);
         UAC_GOTO_ON_ERROR(_uac_host_device_delete(uac_iface->parent), "Unable to delete UAC device");
         uac_iface->parent = NULL;
@@ -2135,23 +2885,18 @@ esp_err_t uac_host_device_close(uac_host_device_handle_t uac_dev_handle)
 
     // To delete the ringbuffer safely
     // We should unblock the task that is waiting for the ringbuffer
-    if (uac_iface->ringbuf) {
-        if (uac_iface->dev_info.type == UAC_STREAM_RX) {
-            // Unblock the task that is waiting for read from the ringbuffer
-            uint8_t dummy = 0;
-            xRingbufferSend(uac_iface->ringbuf, &dummy, sizeof(dummy), 0);
-        } else {
-            // Unblock the task that is waiting for the ringbuffer
-            _ring_buffer_flush(uac_iface->ringbuf);
-        }
+    // The mover task writes the ringbuffer, stop it first
+    uac_stage_deinit(&uac_iface->stage);
+    if (uac_iface->ringbuf.buf) {
+        uac_ring_abort(&uac_iface->ringbuf);
         // Unblock the low priority tasks waiting for the ringbuffer before deleting it
         vTaskDelay(pdMS_TO_TICKS(CONFIG_UAC_RINGBUF_SAFE_DELETE_WAITING_MS));
-        vRingbufferDelete(uac_iface->ringbuf);
-        uac_iface->ringbuf = NULL;
+        uac_ring_deinit(&uac_iface->ringbuf);
     }
 
     uac_iface->user_cb = NULL;
     uac_iface->user_cb_arg = NULL;
+    uac_iface->rx_data_cb = NULL;
     ESP_LOGD(TAG, "User Remove addr %d, iface %d from list", uac_iface->dev_info.addr, uac_iface->dev_info.iface_num);
     uac_host_interface_delete(uac_iface);
 
@@ -2165,6 +2910,7 @@ fail:
 esp_err_t uac_host_handle_events(uint32_t timeout)
 {
     UAC_RETURN_ON_FALSE(s_uac_driver != NULL, ESP_ERR_INVALID_STATE, "UAC Driver is not installed");
+    UAC_RETURN_ON_FALSE(!s_uac_driver->shared_client, ESP_ERR_INVALID_STATE, "Events are handled by the shared USB Host client");
     s_uac_driver->event_handling_started = true;
     esp_err_t ret = usb_host_client_handle_events(s_uac_driver->client_handle, timeout);
     UAC_ENTER_CRITICAL();
@@ -2194,15 +2940,15 @@ esp_err_t uac_host_printf_device_param(uac_host_device_handle_t uac_dev_handle)
     UAC_RETURN_ON_FALSE(iface, ESP_ERR_INVALID_STATE, "UAC Interface not found");
     uac_host_dev_info_t dev_info;
     UAC_RETURN_ON_ERROR(uac_host_get_device_info(uac_dev_handle, &dev_info), "Unable to get UAC device params");
-    printf("find UAC 1.0 %s device\n", dev_info.type == UAC_STREAM_TX ? "Speaker" : "Microphone");
+    printf("find UAC %s %s device\n", iface->parent->bcdADC >= UAC_VERSION_2 ? "2.0" : "1.0", dev_info.type == UAC_STREAM_TX ? "Speaker" : "Microphone");
     printf("interface number: %d\n", dev_info.iface_num);
     printf("total alt interfaces number: %d\n", dev_info.iface_alt_num);
 
     for (int i = 1; i <= dev_info.iface_alt_num; i++) {
         uac_host_dev_alt_param_t iface_alt_params;
         ESP_ERROR_CHECK(uac_host_get_device_alt_param(uac_dev_handle, i, &iface_alt_params));
-        printf("--------alt interface[%d]--------- \nchannels = %d \nbit_resolution = %d \nsample_freq: \n",
-               i, iface_alt_params.channels, iface_alt_params.bit_resolution);
+        printf("--------alt interface[%d]--------- \nchannels = %d \nbit_resolution = %d \nsubframe_size = %d \nsample_freq: \n",
+               i, iface_alt_params.channels, iface_alt_params.bit_resolution, iface_alt_params.subframe_size);
         if (iface_alt_params.sample_freq_type) {
             for (int j = 0; j < iface_alt_params.sample_freq_type; j++) {
                 printf("\t%" PRIu32 "\n", iface_alt_params.sample_freq[j]);
@@ -2217,68 +2963,200 @@ esp_err_t uac_host_printf_device_param(uac_host_device_handle_t uac_dev_handle)
 
 // ------------------------ USB UAC Host driver API ----------------------------
 
-esp_err_t uac_host_device_start(uac_host_device_handle_t uac_dev_handle, const uac_host_stream_config_t *stream_config)
+/**
+ * @brief Set the number of transfers and packets per transfer of the stream
+ *
+ * Settings left 0 are derived from the latency target. Without it, the Kconfig defaults are used.
+ * With only the latency target, the packets are split to CONFIG_UAC_NUM_ISOC_URBS transfers.
+ * At least 2 transfers are queued, so the stream continues while a transfer callback runs.
+ * The latency target is converted to packets at the packet rate of the current alternate setting.
+ *
+ * @param[in] iface          Pointer to Interface structure
+ * @param[in] stream_config  Pointer to UAC stream configuration structure
+ */
+static void uac_host_stream_xfer_config(uac_iface_t *iface, const uac_host_stream_config_t *stream_config)
 {
-    uac_iface_t *iface = get_iface_by_handle(uac_dev_handle);
+    uint32_t xfer_num = stream_config->xfer_num;
+    uint32_t packet_num = stream_config->packets_per_xfer;
+    const uint32_t latency = (uint64_t)stream_config->latency_ms * iface->packet_rate / 1000;
 
-    UAC_RETURN_ON_INVALID_ARG(iface);
-    UAC_RETURN_ON_INVALID_ARG(iface->parent);
-    UAC_RETURN_ON_FALSE(stream_config->bit_resolution, ESP_ERR_INVALID_ARG, "Invalid bit resolution");
-    UAC_RETURN_ON_FALSE(stream_config->channels, ESP_ERR_INVALID_ARG, "Invalid number of channels");
-    UAC_RETURN_ON_FALSE(stream_config->sample_freq, ESP_ERR_INVALID_ARG, "Invalid sample frequency");
+    if (latency && !packet_num) {
+        packet_num = MAX(1, latency / (xfer_num ? xfer_num : CONFIG_UAC_NUM_ISOC_URBS));
+    }
+    if (latency && !xfer_num) {
+        xfer_num = MAX(2, latency / packet_num);
+    }
+    iface->xfer_num = MIN(xfer_num ? xfer_num : CONFIG_UAC_NUM_ISOC_URBS, UAC_XFER_NUM_MAX);
+    iface->packet_num = MIN(packet_num ? packet_num : CONFIG_UAC_NUM_PACKETS_PER_URB, UINT8_MAX);
+    ESP_LOGD(TAG, "UAC Interface %d, %d transfers of %d packets", iface->dev_info.iface_num, iface->xfer_num, iface->packet_num);
+}
 
-    // get the mutex first to change the device/interface state
-    UAC_RETURN_ON_ERROR(uac_host_interface_try_lock(iface, DEFAULT_CTRL_XFER_TIMEOUT_MS), "Unable to lock UAC Interface");
-    if (UAC_INTERFACE_STATE_ACTIVE == iface->state || UAC_INTERFACE_STATE_READY == iface->state) {
-        uac_host_interface_unlock(iface);
+/**
+ * @brief Set the sample conversion between the device samples and the audio buffer
+ *
+ * @param[in] iface          Pointer to Interface structure, the frame size must be set
+ * @param[in] stream_config  Pointer to UAC stream configuration structure
+ * @param[in] subframe_size  Bytes per device sample
+ * @return esp_err_t
+ */
+static esp_err_t uac_host_stream_pcm_config(uac_iface_t *iface, const uac_host_stream_config_t *stream_config, uint8_t subframe_size)
+{
+    uac_pcm_conv_t *pcm = &iface->pcm;
+    const uint8_t app_channels = stream_config->pcm_channels ? stream_config->pcm_channels : stream_config->channels;
+    memset(pcm, 0, sizeof(uac_pcm_conv_t));
+    if (stream_config->pcm_format == UAC_HOST_PCM_FORMAT_DEVICE && app_channels == stream_config->channels &&
+            !stream_config->channel_map) {
         return ESP_OK;
     }
+    UAC_RETURN_ON_FALSE(!iface->rx_data_cb, ESP_ERR_INVALID_ARG, "PCM conversion with RX data callback");
+    UAC_RETURN_ON_FALSE(subframe_size >= 1 && subframe_size <= 4, ESP_ERR_NOT_SUPPORTED, "Unsupported subframe size");
+    UAC_RETURN_ON_FALSE(stream_config->channels <= UAC_HOST_PCM_CHANNELS_MAX && app_channels <= UAC_HOST_PCM_CHANNELS_MAX,
+                        ESP_ERR_NOT_SUPPORTED, "Too many channels for PCM conversion");
 
-    esp_err_t ret = ESP_OK;
-    bool iface_claimed = false;
-    UAC_GOTO_ON_FALSE((UAC_INTERFACE_STATE_IDLE == iface->state), ESP_ERR_INVALID_STATE, "Interface wrong state");
+    uint8_t app_size = subframe_size;
+    bool app_float = false;
+    switch (stream_config->pcm_format) {
+    case UAC_HOST_PCM_FORMAT_DEVICE:
+        break;
+    case UAC_HOST_PCM_FORMAT_S16:
+        app_size = 2;
+        break;
+    case UAC_HOST_PCM_FORMAT_S24_3:
+        app_size = 3;
+        break;
+    case UAC_HOST_PCM_FORMAT_S32:
+        app_size = 4;
+        break;
+    case UAC_HOST_PCM_FORMAT_FLOAT:
+        app_size = sizeof(float);
+        app_float = true;
+        break;
+    default:
+        ESP_LOGE(TAG, "Invalid PCM format %d", stream_config->pcm_format);
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    // check if any alt setting meets the channels, sample frequency and bit resolution requirements
-    // if not exist, return error. If exist, claim the interface and prepare transfer
-    iface->cur_alt = UINT8_MAX;
-    for (int i = 0; i < iface->dev_info.iface_alt_num; i++) {
+    const bool rx = (iface->dev_info.type == UAC_STREAM_RX);
+    pcm->src_size = rx ? subframe_size : app_size;
+    pcm->src_float = rx ? false : app_float;
+    pcm->src_channels = rx ? stream_config->channels : app_channels;
+    pcm->dst_size = rx ? app_size : subframe_size;
+    pcm->dst_float = rx ? app_float : false;
+    pcm->dst_channels = rx ? app_channels : stream_config->channels;
+    for (int ch = 0; ch < pcm->dst_channels; ch++) {
+        const uint8_t src_ch = stream_config->channel_map ? stream_config->channel_map[ch] : ch % pcm->src_channels;
+        UAC_RETURN_ON_FALSE(src_ch < pcm->src_channels || src_ch == UAC_HOST_PCM_CHANNEL_MIX, ESP_ERR_INVALID_ARG, "Invalid channel map");
+        pcm->map[ch] = src_ch;
+    }
+    pcm->src_frame_size = pcm->src_size * pcm->src_channels;
+    pcm->dst_frame_size = pcm->dst_size * pcm->dst_channels;
+    pcm->enabled = true;
+    ESP_LOGD(TAG, "UAC Interface %d, PCM conversion %d x %d bytes to %d x %d bytes", iface->dev_info.iface_num,
+             pcm->src_channels, pcm->src_size, pcm->dst_channels, pcm->dst_size);
+    return ESP_OK;
+}
+
+/**
+ * @brief Find the alternate setting matching the channels, bit resolution and sample frequency of the stream
+ *
+ * @param[in]  iface          Pointer to Interface structure
+ * @param[in]  stream_config  Pointer to UAC stream configuration structure
+ * @param[out] alt            Index of the alternate setting, its sampling frequency is set
+ * @return ESP_OK or ESP_ERR_NOT_FOUND
+ */
+static esp_err_t uac_host_stream_find_alt(uac_iface_t *iface, const uac_host_stream_config_t *stream_config, uint8_t *alt)
+{
+    uint8_t found = UINT8_MAX;
+    for (int i = 0; i < iface->dev_info.iface_alt_num; i++) {
         if (iface->iface_alt[i].dev_alt_param.channels == stream_config->channels &&
                 iface->iface_alt[i].dev_alt_param.bit_resolution == stream_config->bit_resolution) {
             // check if the sample frequency is in the list or in the range
             if (iface->iface_alt[i].dev_alt_param.sample_freq_type > 0) {
                 for (int j = 0; j < iface->iface_alt[i].dev_alt_param.sample_freq_type; j++) {
                     if (iface->iface_alt[i].dev_alt_param.sample_freq[j] == stream_config->sample_freq) {
-                        iface->cur_alt = i;
-                        iface->iface_alt[i].cur_sampling_freq = stream_config->sample_freq;
+                        found = i;
                         break;
                     }
                 }
             } else if (iface->iface_alt[i].dev_alt_param.sample_freq_lower <= stream_config->sample_freq &&
                        iface->iface_alt[i].dev_alt_param.sample_freq_upper >= stream_config->sample_freq) {
-                iface->cur_alt = i;
-                iface->iface_alt[i].cur_sampling_freq = stream_config->sample_freq;
+                found = i;
                 break;
             }
         }
     }
+    if (found == UINT8_MAX) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    iface->iface_alt[found].cur_sampling_freq = stream_config->sample_freq;
+    *alt = found;
+    return ESP_OK;
+}
 
-    UAC_GOTO_ON_FALSE(iface->cur_alt != UINT8_MAX, ESP_ERR_NOT_FOUND, "No suitable alt setting found");
-
+/**
+ * @brief Set the transfer, packet and sample parameters of the stream for the current alternate setting
+ *
+ * @param[in] iface          Pointer to Interface structure, the alternate setting must be selected
+ * @param[in] stream_config  Pointer to UAC stream configuration structure
+ * @return esp_err_t
+ */
+static esp_err_t uac_host_stream_param_config(uac_iface_t *iface, const uac_host_stream_config_t *stream_config)
+{
+    // samples are stored in subslots, eg. 24 bit samples in 4 bytes
+    const uac_iface_alt_t *iface_alt = &iface->iface_alt[iface->cur_alt];
+    const uint32_t subframe_size = iface_alt->dev_alt_param.subframe_size ? iface_alt->dev_alt_param.subframe_size
+                                   : stream_config->bit_resolution / 8;
+    iface->packet_rate = iface_alt->packet_rate;
     // enqueue multiple transfers to make sure the data is not lost
-    iface->xfer_num = CONFIG_UAC_NUM_ISOC_URBS;
-    iface->packet_num = CONFIG_UAC_NUM_PACKETS_PER_URB;
-    iface->packet_size = iface->iface_alt[iface->cur_alt].cur_sampling_freq * stream_config->channels * stream_config->bit_resolution / 8 / 1000;
-    iface->flags |= stream_config->flags;
+    uac_host_stream_xfer_config(iface, stream_config);
+    iface->frame_size = stream_config->channels * subframe_size;
+    iface->packet_size = iface_alt->cur_sampling_freq * iface->frame_size / iface->packet_rate;
+    iface->nominal_rate = ((uint64_t)iface_alt->cur_sampling_freq << 16) / iface->packet_rate;
     // if the packet size is not an integer, we need to add one more byte
-    if (iface->iface_alt[iface->cur_alt].cur_sampling_freq * stream_config->channels * stream_config->bit_resolution / 8 % 1000) {
+    if (iface_alt->cur_sampling_freq * iface->frame_size % iface->packet_rate) {
         ESP_LOGD(TAG, "packet_size %" PRIu32 " is not an integer, add one more byte", iface->packet_size);
         iface->packet_size++;
     }
-    assert(iface->packet_size <= iface->iface_alt[iface->cur_alt].ep_mps);
+    assert(iface->packet_size <= iface_alt->ep_mps);
+    UAC_RETURN_ON_ERROR(uac_host_stream_pcm_config(iface, stream_config, subframe_size), "Invalid PCM conversion");
+    return ESP_OK;
+}
+
+esp_err_t uac_host_device_start(uac_host_device_handle_t uac_dev_handle, const uac_host_stream_config_t *stream_config)
+{
+    uac_iface_t *iface = get_iface_by_handle(uac_dev_handle);
+
+    UAC_RETURN_ON_INVALID_ARG(iface);
+    UAC_RETURN_ON_INVALID_ARG(iface->parent);
+    UAC_RETURN_ON_FALSE(stream_config->bit_resolution, ESP_ERR_INVALID_ARG, "Invalid bit resolution");
+    UAC_RETURN_ON_FALSE(stream_config->channels, ESP_ERR_INVALID_ARG, "Invalid number of channels");
+    UAC_RETURN_ON_FALSE(stream_config->sample_freq, ESP_ERR_INVALID_ARG, "Invalid sample frequency");
+
+    // get the mutex first to change the device/interface state
+    UAC_RETURN_ON_ERROR(uac_host_interface_try_lock(iface, DEFAULT_CTRL_XFER_TIMEOUT_MS), "Unable to lock UAC Interface");
+    if (UAC_INTERFACE_STATE_ACTIVE == iface->state || UAC_INTERFACE_STATE_READY == iface->state) {
+        uac_host_interface_unlock(iface);
+        return ESP_OK;
+    }
+
+    esp_err_t ret = ESP_OK;
+    bool iface_claimed = false;
+    UAC_GOTO_ON_FALSE((UAC_INTERFACE_STATE_IDLE == iface->state), ESP_ERR_INVALID_STATE, "Interface wrong state");
+
+    // check if any alt setting meets the channels, sample frequency and bit resolution requirements
+    // if not exist, return error. If exist, claim the interface and prepare transfer
+    UAC_GOTO_ON_ERROR(uac_host_stream_find_alt(iface, stream_config, &iface->cur_alt), "No suitable alt setting found");
+    memset(&iface->stats, 0, sizeof(iface->stats));
+    // the concealment mode is set by each start
+    iface->flags &= ~(FLAG_STREAM_TX_CONCEAL_SILENCE | FLAG_STREAM_TX_CONCEAL_REPEAT);
+    iface->flags |= stream_config->flags;
+    UAC_GOTO_ON_ERROR(uac_host_stream_param_config(iface, stream_config), "Invalid stream configuration");
 
     // Claim Interface and prepare transfer
     UAC_GOTO_ON_ERROR(uac_host_interface_claim_and_prepare_transfer(iface), "Unable to claim Interface");
     iface_claimed = true;
+    ESP_LOGI(TAG, "UAC Interface %d, transfer latency %"PRIu32" ms", iface->dev_info.iface_num,
+             (iface->dev_info.type == UAC_STREAM_TX ? iface->xfer_num * iface->packet_num : iface->packet_num) * 1000 / iface->packet_rate);
 
     if (!(iface->flags & FLAG_STREAM_SUSPEND_AFTER_START)) {
         UAC_GOTO_ON_ERROR(uac_host_interface_resume(iface), "Unable to enable UAC Interface");
@@ -2294,6 +3172,160 @@ fail:
     return ret;
 }
 
+esp_err_t uac_host_device_start_group(const uac_host_device_handle_t *uac_dev_handles, const uac_host_stream_config_t *stream_configs, size_t num)
+{
+    UAC_RETURN_ON_INVALID_ARG(uac_dev_handles);
+    UAC_RETURN_ON_INVALID_ARG(stream_configs);
+    UAC_RETURN_ON_FALSE(num > 0 && num <= CONFIG_UAC_DEV_ADDR_LIST_MAX * 2, ESP_ERR_INVALID_ARG, "Invalid number of streams");
+    uac_iface_t *ifaces[CONFIG_UAC_DEV_ADDR_LIST_MAX * 2] = { NULL };
+    for (size_t i = 0; i < num; i++) {
+        ifaces[i] = get_iface_by_handle(uac_dev_handles[i]);
+        UAC_RETURN_ON_INVALID_ARG(ifaces[i]);
+    }
+
+    // claim all interfaces and prepare their transfers, streams stay suspended
+    esp_err_t ret = ESP_OK;
+    size_t started = 0;
+    size_t locked = 0;
+    for (; started < num; started++) {
+        UAC_GOTO_ON_FALSE(UAC_INTERFACE_STATE_IDLE == ifaces[started]->state, ESP_ERR_INVALID_STATE, "Interface wrong state");
+        uac_host_stream_config_t config = stream_configs[started];
+        config.flags |= FLAG_STREAM_SUSPEND_AFTER_START;
+        UAC_GOTO_ON_ERROR(uac_host_device_start(uac_dev_handles[started], &config), "Unable to start UAC Interface");
+    }
+
+    // all control transfers are done first, then the streams are submitted back to back
+    for (; locked < num; locked++) {
+        UAC_GOTO_ON_ERROR(uac_host_interface_try_lock(ifaces[locked], DEFAULT_CTRL_XFER_TIMEOUT_MS), "Unable to lock UAC Interface");
+        if (!(stream_configs[locked].flags & FLAG_STREAM_SUSPEND_AFTER_START)) {
+            ifaces[locked]->flags &= ~FLAG_STREAM_SUSPEND_AFTER_START;
+        }
+        UAC_GOTO_ON_ERROR(uac_host_interface_set_stream_alt(ifaces[locked]), "Unable to set stream alternate setting");
+    }
+    for (size_t i = 0; i < num; i++) {
+        UAC_GOTO_ON_ERROR(uac_host_interface_submit_stream(ifaces[i]), "Unable to enable UAC Interface");
+    }
+    for (size_t i = 0; i < num; i++) {
+        uac_host_interface_unlock(ifaces[i]);
+    }
+    return ESP_OK;
+
+fail:
+    for (size_t i = 0; i < locked; i++) {
+        uac_host_interface_unlock(ifaces[i]);
+    }
+    for (size_t i = 0; i < started; i++) {
+        uac_host_device_stop(uac_dev_handles[i]);
+    }
+    return ret;
+}
+
+/**
+ * @brief Check the free transfers of the interface fit the current stream parameters
+ *
+ * @param[in] iface          Pointer to Interface structure, all transfers must be free
+ * @param[in] xfer_num       Number of the allocated transfers
+ * @param[in] packet_num     Packets per allocated transfer
+ * @return true if the transfers can be reused
+ */
+static bool uac_host_interface_transfer_fits(const uac_iface_t *iface, uint32_t xfer_num, uint32_t packet_num)
+{
+    const uac_iface_alt_t *iface_alt = &iface->iface_alt[iface->cur_alt];
+    if (iface->xfer_num != xfer_num || iface->packet_num != packet_num || !iface->free_xfer_list[0]) {
+        return false;
+    }
+    // the transfers of all streams have the same size, so checking the first is enough
+    if (iface->free_xfer_list[0]->data_buffer_size < iface_alt->ep_mps * iface->packet_num) {
+        return false;
+    }
+    if (iface_alt->fb_ep_addr) {
+        return iface->fb_xfer && iface->fb_xfer->data_buffer_size >= iface_alt->fb_ep_mps;
+    }
+    return true;
+}
+
+esp_err_t uac_host_device_reconfigure(uac_host_device_handle_t uac_dev_handle, const uac_host_stream_config_t *stream_config,
+                                      uint32_t *switch_us)
+{
+    uac_iface_t *iface = get_iface_by_handle(uac_dev_handle);
+
+    UAC_RETURN_ON_INVALID_ARG(iface);
+    UAC_RETURN_ON_INVALID_ARG(iface->parent);
+    UAC_RETURN_ON_INVALID_ARG(stream_config);
+    UAC_RETURN_ON_FALSE(stream_config->bit_resolution, ESP_ERR_INVALID_ARG, "Invalid bit resolution");
+    UAC_RETURN_ON_FALSE(stream_config->channels, ESP_ERR_INVALID_ARG, "Invalid number of channels");
+    UAC_RETURN_ON_FALSE(stream_config->sample_freq, ESP_ERR_INVALID_ARG, "Invalid sample frequency");
+
+    UAC_RETURN_ON_ERROR(uac_host_interface_try_lock(iface, DEFAULT_CTRL_XFER_TIMEOUT_MS), "Unable to lock UAC Interface");
+    esp_err_t ret = ESP_OK;
+    const int64_t start_us = stream_time_us();
+    const bool was_active = (UAC_INTERFACE_STATE_ACTIVE == iface->state);
+    UAC_GOTO_ON_FALSE(was_active || UAC_INTERFACE_STATE_READY == iface->state, ESP_ERR_INVALID_STATE, "Interface wrong state");
+    // the stream is left as it is if no alt setting matches, after that it is stopped on failure
+    uint8_t alt;
+    bool claimed = true;
+    bool stop_on_fail = false;
+    UAC_GOTO_ON_ERROR(uac_host_stream_find_alt(iface, stream_config, &alt), "No suitable alt setting found");
+    stop_on_fail = true;
+
+    if (was_active) {
+        UAC_GOTO_ON_ERROR(uac_host_interface_suspend(iface), "Unable to disable UAC Interface");
+    } else {
+        stream_ring_flush(iface);
+    }
+    if (alt != iface->cur_alt) {
+        // USB Host opens the endpoints of the alternate setting when the interface is claimed, the transfers are kept meanwhile
+        UAC_GOTO_ON_ERROR(usb_host_interface_release(s_uac_driver->client_handle, iface->parent->dev_hdl, iface->dev_info.iface_num),
+                          "Unable to release UAC Interface");
+        claimed = false;
+        iface->cur_alt = alt;
+        UAC_GOTO_ON_ERROR(usb_host_interface_claim(s_uac_driver->client_handle, iface->parent->dev_hdl, iface->dev_info.iface_num,
+                          alt + 1), "Unable to claim Interface");
+        claimed = true;
+    }
+
+    const uint32_t xfer_num = iface->xfer_num;
+    const uint32_t packet_num = iface->packet_num;
+    UAC_GOTO_ON_ERROR(uac_host_stream_param_config(iface, stream_config), "Invalid stream configuration");
+    const bool reuse = uac_host_interface_transfer_fits(iface, xfer_num, packet_num);
+    if (!reuse) {
+        const uint32_t new_xfer_num = iface->xfer_num;
+        iface->xfer_num = xfer_num;
+        uac_host_interface_free_transfer(iface);
+        iface->xfer_num = new_xfer_num;
+        UAC_GOTO_ON_ERROR(uac_host_interface_alloc_transfer(iface), "Unable to allocate transfers");
+    } else if (iface->fb_xfer && !iface->iface_alt[iface->cur_alt].fb_ep_addr) {
+        ESP_ERROR_CHECK(CLIENT_TRANSFER_FREE(iface->fb_xfer));
+        iface->fb_xfer = NULL;
+    }
+
+    UAC_GOTO_ON_ERROR(uac_host_interface_set_stream_alt(iface), "Unable to set stream alternate setting");
+    if (was_active) {
+        UAC_GOTO_ON_ERROR(uac_host_interface_submit_stream(iface), "Unable to enable UAC Interface");
+    }
+    const uint32_t elapsed_us = stream_time_us() - start_us;
+    ESP_LOGI(TAG, "UAC Interface %d switched to %"PRIu32" Hz %d ch %d bit in %"PRIu32" us, transfers %s",
+             iface->dev_info.iface_num, stream_config->sample_freq, stream_config->channels, stream_config->bit_resolution,
+             elapsed_us, reuse ? "reused" : "reallocated");
+    if (switch_us) {
+        *switch_us = elapsed_us;
+    }
+    uac_host_interface_unlock(iface);
+    return ESP_OK;
+
+fail:
+    if (stop_on_fail && UAC_INTERFACE_STATE_READY == iface->state) {
+        if (claimed) {
+            uac_host_interface_release_and_free_transfer(iface);
+        } else {
+            uac_host_interface_free_transfer(iface);
+            iface->state = UAC_INTERFACE_STATE_IDLE;
+        }
+    }
+    uac_host_interface_unlock(iface);
+    return ret;
+}
+
 esp_err_t uac_host_device_suspend(uac_host_device_handle_t uac_dev_handle)
 {
     uac_iface_t *iface = get_iface_by_handle(uac_dev_handle);
@@ -2362,31 +3394,110 @@ fail:
     return ret;
 }
 
+/**
+ * @brief Check the interface is streaming
+ *
+ * @param[in] iface       Pointer to Interface structure
+ * @return esp_err_t
+ */
+static esp_err_t uac_host_interface_check_active(uac_iface_t *iface)
+{
+    UAC_RETURN_ON_ERROR(uac_host_interface_try_lock(iface, DEFAULT_CTRL_XFER_TIMEOUT_MS), "Unable to lock UAC Interface");
+    const bool active = (UAC_INTERFACE_STATE_ACTIVE == iface->state);
+    uac_host_interface_unlock(iface);
+    return active ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+/**
+ * @brief Submit the free TX transfers if there is data in the ringbuffer
+ *
+ * @param[in] iface       Pointer to Interface structure
+ * @return esp_err_t
+ */
+static esp_err_t uac_host_interface_submit_tx(uac_iface_t *iface)
+{
+    // The free transfers and the buffered data are checked without lock, usually one of them is missing
+    // with underrun concealment, the transfers are submitted without data too
+    const bool conceal = iface->flags & (FLAG_STREAM_TX_CONCEAL_SILENCE | FLAG_STREAM_TX_CONCEAL_REPEAT);
+    while (UAC_ATOMIC_LOAD(iface->free_xfer_mask) && (conceal || uac_ring_get_len(&iface->ringbuf))) {
+        UAC_ENTER_CRITICAL();
+        // if interface state changed to inactive during blocking write
+        // we need to return invalid state to safely exit the write function
+        UAC_RETURN_ON_FALSE_CRITICAL(UAC_INTERFACE_STATE_ACTIVE == iface->state, ESP_ERR_INVALID_STATE);
+        const uint32_t free_mask = UAC_ATOMIC_LOAD(iface->free_xfer_mask);
+        if (free_mask == 0) {
+            UAC_EXIT_CRITICAL();
+            break;
+        }
+        const int i = __builtin_ctz(free_mask);
+        usb_transfer_t *out_xfer = iface->free_xfer_list[i];
+        iface->xfer_list[i] = out_xfer;
+        iface->free_xfer_list[i] = NULL;
+        UAC_ATOMIC_FETCH_AND(iface->free_xfer_mask, ~(1UL << i));
+        out_xfer->status = USB_TRANSFER_STATUS_COMPLETED;
+        UAC_EXIT_CRITICAL();
+        // not enough data for a whole transfer, it is parked again until the next write
+        if (!stream_tx_xfer_submit(out_xfer)) {
+            break;
+        }
+    }
+    return ESP_OK;
+}
+
 esp_err_t uac_host_device_read(uac_host_device_handle_t uac_dev_handle, uint8_t *data, uint32_t size, uint32_t *bytes_read, uint32_t timeout)
 {
     uac_iface_t *iface = get_iface_by_handle(uac_dev_handle);
     UAC_RETURN_ON_INVALID_ARG(iface);
     UAC_RETURN_ON_INVALID_ARG(data);
     UAC_RETURN_ON_INVALID_ARG(bytes_read);
+    UAC_RETURN_ON_FALSE(!iface->rx_data_cb, ESP_ERR_NOT_SUPPORTED, "Data passed to RX data callback");
+    esp_err_t ret = uac_host_interface_check_active(iface);
+    if (ESP_OK != ret) {
+        return ret;
+    }
 
-    UAC_RETURN_ON_ERROR(uac_host_interface_try_lock(iface, DEFAULT_CTRL_XFER_TIMEOUT_MS), "Unable to lock UAC Interface");
-    if (UAC_INTERFACE_STATE_ACTIVE != iface->state) {
-        uac_host_interface_unlock(iface);
-        return ESP_ERR_INVALID_STATE;
+    size_t read_bytes = 0;
+    ret = uac_ring_pop(&iface->ringbuf, data, size, &read_bytes, timeout);
+    *bytes_read = read_bytes;
+
+    if (ESP_OK != ret) {
+        ESP_LOGD(TAG, "RX Ringbuffer read failed");
+        return ret;
     }
-    uac_host_interface_unlock(iface);
 
-    size_t data_len = _ring_buffer_get_len(iface->ringbuf);
-    if (data_len > size) {
-        data_len = size;
+    return ESP_OK;
+}
+
+esp_err_t uac_host_device_read_acquire(uac_host_device_handle_t uac_dev_handle, uint8_t **data, uint32_t *size, uint32_t timeout)
+{
+    uac_iface_t *iface = get_iface_by_handle(uac_dev_handle);
+    UAC_RETURN_ON_INVALID_ARG(iface);
+    UAC_RETURN_ON_INVALID_ARG(data);
+    UAC_RETURN_ON_INVALID_ARG(size);
+    *size = 0;
+    UAC_RETURN_ON_FALSE(!iface->rx_data_cb, ESP_ERR_NOT_SUPPORTED, "Data passed to RX data callback");
+    esp_err_t ret = uac_host_interface_check_active(iface);
+    if (ESP_OK != ret) {
+        return ret;
     }
-    esp_err_t ret = _ring_buffer_pop(iface->ringbuf, data, data_len, (size_t *)bytes_read, timeout);
 
+    ret = uac_ring_wait(&iface->ringbuf, true, 1, timeout);
     if (ESP_OK != ret) {
-        ESP_LOGD(TAG, "RX Ringbuffer read failed");
+        ESP_LOGD(TAG, "RX Ringbuffer acquire failed");
         return ret;
     }
+    *size = uac_ring_read_acquire(&iface->ringbuf, data);
+    return ESP_OK;
+}
+
+esp_err_t uac_host_device_read_release(uac_host_device_handle_t uac_dev_handle, uint32_t size)
+{
+    uac_iface_t *iface = get_iface_by_handle(uac_dev_handle);
+    UAC_RETURN_ON_INVALID_ARG(iface);
+    UAC_RETURN_ON_FALSE(iface->ringbuf.buf, ESP_ERR_INVALID_STATE, "Interface not opened");
+    UAC_RETURN_ON_FALSE(size <= uac_ring_get_len(&iface->ringbuf), ESP_ERR_INVALID_SIZE, "Release more than acquired");
 
+    uac_ring_read_release(&iface->ringbuf, size);
     return ESP_OK;
 }
 
@@ -2401,46 +3512,309 @@ esp_err_t uac_host_device_write(uac_host_device_handle_t uac_dev_handle, uint8_t
     // Data will not be sent to the device and dropped in any of the following cases:
     // 1. the pipe state changed to inactive during or after the ringbuffer write
     // 2. the pipe state changed to inactive during continuous transfer submit
+    esp_err_t ret = uac_host_interface_check_active(iface);
+    if (ESP_OK != ret) {
+        return ret;
+    }
+
+    ret = uac_ring_push(&iface->ringbuf, data, size, timeout);
+
+    if (ESP_OK != ret) {
+        ESP_LOGD(TAG, "TX Ringbuffer write failed");
+        return ret;
+    }
+
+    return uac_host_interface_submit_tx(iface);
+}
+
+esp_err_t uac_host_device_write_acquire(uac_host_device_handle_t uac_dev_handle, uint8_t **data, uint32_t *size, uint32_t timeout)
+{
+    uac_iface_t *iface = get_iface_by_handle(uac_dev_handle);
+    UAC_RETURN_ON_INVALID_ARG(iface);
+    UAC_RETURN_ON_INVALID_ARG(data);
+    UAC_RETURN_ON_INVALID_ARG(size);
+    *size = 0;
+    esp_err_t ret = uac_host_interface_check_active(iface);
+    if (ESP_OK != ret) {
+        return ret;
+    }
+
+    ret = uac_ring_wait(&iface->ringbuf, false, 1, timeout);
+    if (ESP_OK != ret) {
+        ESP_LOGD(TAG, "TX Ringbuffer acquire failed");
+        return ret;
+    }
+    *size = uac_ring_write_acquire(&iface->ringbuf, data);
+    return ESP_OK;
+}
+
+esp_err_t uac_host_device_write_commit(uac_host_device_handle_t uac_dev_handle, uint32_t size)
+{
+    uac_iface_t *iface = get_iface_by_handle(uac_dev_handle);
+    UAC_RETURN_ON_INVALID_ARG(iface);
+    UAC_RETURN_ON_FALSE(iface->ringbuf.buf, ESP_ERR_INVALID_STATE, "Interface not opened");
+    UAC_RETURN_ON_FALSE(size <= uac_ring_get_free(&iface->ringbuf), ESP_ERR_INVALID_SIZE, "Commit more than acquired");
+
+    uac_ring_write_commit(&iface->ringbuf, size);
+    return uac_host_interface_submit_tx(iface);
+}
+
+esp_err_t uac_host_device_get_latency(uac_host_device_handle_t uac_dev_handle, uac_host_stream_latency_t *latency)
+{
+    uac_iface_t *iface = get_iface_by_handle(uac_dev_handle);
+    UAC_RETURN_ON_INVALID_ARG(iface);
+    UAC_RETURN_ON_INVALID_ARG(latency);
+
     UAC_RETURN_ON_ERROR(uac_host_interface_try_lock(iface, DEFAULT_CTRL_XFER_TIMEOUT_MS), "Unable to lock UAC Interface");
-    if (UAC_INTERFACE_STATE_ACTIVE != iface->state) {
-        uac_host_interface_unlock(iface);
-        return ESP_ERR_INVALID_STATE;
+    esp_err_t ret = ESP_OK;
+    UAC_GOTO_ON_FALSE((UAC_INTERFACE_STATE_ACTIVE == iface->state || UAC_INTERFACE_STATE_READY == iface->state),
+                      ESP_ERR_INVALID_STATE, "Stream not started");
+    // TX data wait for all queued transfers, RX data are available when the transfer being filled completes
+    uint32_t packets = iface->packet_num;
+    if (iface->dev_info.type == UAC_STREAM_TX) {
+        packets *= iface->xfer_num;
     }
+    latency->xfer_latency_ms = packets * 1000 / iface->packet_rate;
+    const uint32_t bytes_per_s = iface->iface_alt[iface->cur_alt].cur_sampling_freq * _uac_ring_frame_size(iface);
+    latency->buffer_latency_ms = iface->ringbuf.buf ? (uint64_t)uac_ring_get_len(&iface->ringbuf) * 1000 / bytes_per_s : 0;
+
+fail:
     uac_host_interface_unlock(iface);
+    return ret;
+}
 
-    esp_err_t ret = _ring_buffer_push(iface->ringbuf, data, size, timeout);
+esp_err_t uac_host_device_get_stats(uac_host_device_handle_t uac_dev_handle, uac_host_stream_stats_t *stats)
+{
+    uac_iface_t *iface = get_iface_by_handle(uac_dev_handle);
+    UAC_RETURN_ON_INVALID_ARG(iface);
+    UAC_RETURN_ON_INVALID_ARG(stats);
 
+    UAC_ENTER_CRITICAL();
+    *stats = iface->stats;
+    UAC_EXIT_CRITICAL();
+    return ESP_OK;
+}
+
+esp_err_t uac_host_device_get_timing(uac_host_device_handle_t uac_dev_handle, uac_host_stream_timing_t *timing)
+{
+    uac_iface_t *iface = get_iface_by_handle(uac_dev_handle);
+    UAC_RETURN_ON_INVALID_ARG(iface);
+    UAC_RETURN_ON_INVALID_ARG(timing);
+
+    UAC_RETURN_ON_ERROR(uac_host_interface_try_lock(iface, DEFAULT_CTRL_XFER_TIMEOUT_MS), "Unable to lock UAC Interface");
+    esp_err_t ret = ESP_OK;
+    UAC_GOTO_ON_FALSE((UAC_INTERFACE_STATE_ACTIVE == iface->state || UAC_INTERFACE_STATE_READY == iface->state),
+                      ESP_ERR_INVALID_STATE, "Stream not started");
+    UAC_ENTER_CRITICAL();
+    *timing = iface->timing;
+    UAC_EXIT_CRITICAL();
+    // samples due at the nominal rate for the completed packets
+    const uint64_t nominal = timing->packet_count * iface->iface_alt[iface->cur_alt].cur_sampling_freq / iface->packet_rate;
+    timing->drift_ppm = nominal ? ((int64_t)timing->sample_count - (int64_t)nominal) * 1000000 / (int64_t)nominal : 0;
+
+fail:
+    uac_host_interface_unlock(iface);
+    return ret;
+}
+
+esp_err_t uac_host_duplex_start(const uac_host_duplex_config_t *config, uac_host_duplex_handle_t *duplex_handle)
+{
+    UAC_RETURN_ON_INVALID_ARG(config);
+    UAC_RETURN_ON_INVALID_ARG(duplex_handle);
+    uac_iface_t *mic = get_iface_by_handle(config->mic_handle);
+    uac_iface_t *spk = get_iface_by_handle(config->spk_handle);
+    UAC_RETURN_ON_INVALID_ARG(mic);
+    UAC_RETURN_ON_INVALID_ARG(spk);
+    UAC_RETURN_ON_FALSE(mic->dev_info.type == UAC_STREAM_RX && spk->dev_info.type == UAC_STREAM_TX, ESP_ERR_INVALID_ARG, "Invalid stream types");
+    UAC_RETURN_ON_FALSE(!mic->rx_data_cb, ESP_ERR_INVALID_ARG, "Data passed to RX data callback");
+    UAC_RETURN_ON_FALSE(config->mic_config.sample_freq == config->spk_config.sample_freq, ESP_ERR_INVALID_ARG, "Different sample frequencies");
+    UAC_RETURN_ON_FALSE(config->period_frames, ESP_ERR_INVALID_ARG, "Invalid period");
+    UAC_RETURN_ON_FALSE(!spk->duplex, ESP_ERR_INVALID_STATE, "Speaker already in a duplex pair");
+
+    uac_duplex_t *duplex = UAC_CALLOC(CONTROL, 1, sizeof(uac_duplex_t));
+    UAC_RETURN_ON_FALSE(duplex, ESP_ERR_NO_MEM, "Unable to allocate memory for UAC duplex");
+    duplex->mic_handle = config->mic_handle;
+    duplex->spk_handle = config->spk_handle;
+    duplex->period_frames = config->period_frames;
+
+    // the speaker must not stop on underrun, the reference has no gaps then
+    const uac_host_device_handle_t handles[2] = { config->mic_handle, config->spk_handle };
+    uac_host_stream_config_t stream_configs[2] = { config->mic_config, config->spk_config };
+    if (!(stream_configs[1].flags & (FLAG_STREAM_TX_CONCEAL_SILENCE | FLAG_STREAM_TX_CONCEAL_REPEAT))) {
+        stream_configs[1].flags |= FLAG_STREAM_TX_CONCEAL_SILENCE;
+    }
+    // samples sent until the reference ring is allocated are counted as dropped, and skipped in the microphone
+    spk->duplex = duplex;
+    esp_err_t ret = uac_host_device_start_group(handles, stream_configs, 2);
+    UAC_GOTO_ON_ERROR(ret, "Unable to start UAC duplex streams");
+    duplex->mic_frame_size = _uac_ring_frame_size(mic);
+    duplex->ref_frame_size = spk->frame_size;
+    UAC_GOTO_ON_FALSE(duplex->period_frames * duplex->mic_frame_size <= mic->ringbuf.size, ESP_ERR_INVALID_SIZE, "Period larger than the RX buffer");
+    const uint32_t ref_periods = config->ref_periods ? config->ref_periods : 4;
+    UAC_GOTO_ON_ERROR(uac_ring_init(&duplex->ref_ring, ref_periods * duplex->period_frames * duplex->ref_frame_size), "Unable to allocate reference buffer");
+    UAC_ATOMIC_STORE(duplex->ref_ready, true);
+
+    *duplex_handle = duplex;
+    return ESP_OK;
+
+fail:
+    uac_host_duplex_stop(duplex);
+    return ret;
+}
+
+esp_err_t uac_host_duplex_stop(uac_host_duplex_handle_t duplex_handle)
+{
+    uac_duplex_t *duplex = duplex_handle;
+    UAC_RETURN_ON_INVALID_ARG(duplex);
+    // an interface closed in the meantime is not in the list anymore
+    if (is_interface_in_list(duplex->mic_handle)) {
+        uac_host_device_stop(duplex->mic_handle);
+    }
+    if (is_interface_in_list(duplex->spk_handle)) {
+        uac_iface_t *spk = duplex->spk_handle;
+        uac_host_device_stop(duplex->spk_handle);
+        spk->duplex = NULL;
+    }
+    if (duplex->ref_ring.buf) {
+        uac_ring_deinit(&duplex->ref_ring);
+    }
+    UAC_FREE(CONTROL, duplex, sizeof(uac_duplex_t));
+    return ESP_OK;
+}
+
+/**
+ * @brief Skip the pending samples of one stream of the duplex pair and wait for a block
+ *
+ * @param[in] ring         Microphone buffer or reference ring
+ * @param[inout] skip      Samples to skip, the skipped ones are subtracted
+ * @param[in] frame_size   Bytes of one sample of all channels in the ring
+ * @param[in] len          Bytes of one block
+ * @param[inout] timeout   Timeout state of the read
+ * @param[inout] ticks     Remaining ticks of the read
+ * @return esp_err_t of uac_ring_wait()
+ */
+static esp_err_t uac_host_duplex_wait(uac_ring_t *ring, uint32_t *skip, uint32_t frame_size, size_t len,
+                                      TimeOut_t *timeout, TickType_t *ticks)
+{
+    while (true) {
+        const uint32_t skipped = MIN(*skip, uac_ring_get_len(ring) / frame_size);
+        uac_ring_read_release(ring, skipped * frame_size);
+        *skip -= skipped;
+        if (!*skip && uac_ring_get_len(ring) >= len) {
+            return ESP_OK;
+        }
+        if (xTaskCheckForTimeOut(timeout, ticks) == pdTRUE) {
+            return ESP_ERR_TIMEOUT;
+        }
+        esp_err_t ret = uac_ring_wait(ring, true, *skip ? frame_size : len, *ticks);
+        if (ESP_OK != ret) {
+            return ret;
+        }
+    }
+}
+
+/**
+ * @brief Measure the start offset of the duplex pair, once both streams completed their first transfer
+ *
+ * @param[in] duplex  Pointer to the duplex pair
+ * @param[in] mic     Microphone interface
+ * @param[in] spk     Speaker interface
+ */
+static void uac_host_duplex_align(uac_duplex_t *duplex, uac_iface_t *mic, uac_iface_t *spk)
+{
+    UAC_ENTER_CRITICAL();
+    const int64_t mic_start_us = mic->timing.start_time_us;
+    const int64_t spk_start_us = spk->timing.start_time_us;
+    UAC_EXIT_CRITICAL();
+    // both streams send one packet per endpoint interval, the start times are rounded to whole packets
+    const int64_t delta = (mic_start_us - spk_start_us) * mic->packet_rate;
+    const int32_t offset_packets = (int32_t)((delta + (delta >= 0 ? 500000 : -500000)) / 1000000);
+    const int32_t offset_frames = (int32_t)((int64_t)offset_packets * mic->iface_alt[mic->cur_alt].cur_sampling_freq / mic->packet_rate);
+    if (offset_frames > 0) {
+        // the speaker started first, its first samples have no microphone samples
+        duplex->ref_skip += offset_frames;
+    } else {
+        duplex->mic_skip += -offset_frames;
+    }
+    duplex->stats.start_offset_packets = offset_packets;
+    duplex->stats.start_offset_frames = offset_frames;
+    duplex->stats.aligned = true;
+    ESP_LOGD(TAG, "UAC duplex start offset %d packets, %d samples", (int)offset_packets, (int)offset_frames);
+}
+
+esp_err_t uac_host_duplex_read(uac_host_duplex_handle_t duplex_handle, uint8_t *mic_data, uint8_t *ref_data, uint32_t timeout)
+{
+    uac_duplex_t *duplex = duplex_handle;
+    UAC_RETURN_ON_INVALID_ARG(duplex);
+    UAC_RETURN_ON_INVALID_ARG(mic_data);
+    UAC_RETURN_ON_INVALID_ARG(ref_data);
+    uac_iface_t *mic = get_iface_by_handle(duplex->mic_handle);
+    uac_iface_t *spk = get_iface_by_handle(duplex->spk_handle);
+    UAC_RETURN_ON_INVALID_ARG(mic);
+    UAC_RETURN_ON_INVALID_ARG(spk);
+    esp_err_t ret = uac_host_interface_check_active(mic);
+    if (ESP_OK != ret) {
+        return ret;
+    }
+    ret = uac_host_interface_check_active(spk);
     if (ESP_OK != ret) {
-        ESP_LOGD(TAG, "TX Ringbuffer write failed");
         return ret;
     }
 
-    // We need to submit the transfer if there is free transfer in the list
-    for (int i = 0; i < iface->xfer_num; i++) {
-        UAC_ENTER_CRITICAL();
-        if (iface->free_xfer_list[i]) {
-            size_t data_len = _ring_buffer_get_len(iface->ringbuf);
-            if (data_len == 0) {
-                goto exit_critical;
-            }
-            // if interface state changed to inactive during blocking write
-            // we need to return invalid state to safely exit the write function
-            if (UAC_INTERFACE_STATE_ACTIVE != iface->state) {
-                ret = ESP_ERR_INVALID_STATE;
-                goto exit_critical;
-            }
-            iface->xfer_list[i] = iface->free_xfer_list[i];
-            iface->free_xfer_list[i] = NULL;
-            iface->xfer_list[i]->status = USB_TRANSFER_STATUS_COMPLETED;
-            UAC_EXIT_CRITICAL();
-            stream_tx_xfer_submit(iface->xfer_list[i]);
-            UAC_ENTER_CRITICAL();
+    TimeOut_t timeout_state;
+    TickType_t ticks = timeout;
+    vTaskSetTimeOutState(&timeout_state);
+    if (!duplex->stats.aligned) {
+        // the start times are set by the first transfer of each stream
+        ret = uac_ring_wait(&mic->ringbuf, true, 1, ticks);
+        if (ESP_OK == ret) {
+            xTaskCheckForTimeOut(&timeout_state, &ticks);
+            ret = uac_ring_wait(&duplex->ref_ring, true, 1, ticks);
         }
-exit_critical:
-        UAC_EXIT_CRITICAL();
+        if (ESP_OK != ret) {
+            return ret;
+        }
+        uac_host_duplex_align(duplex, mic, spk);
+    }
+
+    // samples lost on one side are skipped on the other side, so both stay in the same USB frames
+    const uint32_t mic_dropped = UAC_ATOMIC_LOAD(mic->stats.rx_overflow_bytes) / mic->frame_size;
+    const uint32_t ref_dropped = UAC_ATOMIC_LOAD(duplex->ref_dropped_frames);
+    duplex->ref_skip += mic_dropped - duplex->mic_dropped_seen;
+    duplex->mic_skip += ref_dropped - duplex->ref_dropped_seen;
+    duplex->mic_dropped_seen = mic_dropped;
+    duplex->ref_dropped_seen = ref_dropped;
+    duplex->stats.mic_dropped_frames = mic_dropped;
+    duplex->stats.ref_dropped_frames = ref_dropped;
+    const uint32_t common = MIN(duplex->mic_skip, duplex->ref_skip);
+    duplex->mic_skip -= common;
+    duplex->ref_skip -= common;
+
+    // both blocks are complete before either is read
+    const size_t mic_len = duplex->period_frames * duplex->mic_frame_size;
+    const size_t ref_len = duplex->period_frames * duplex->ref_frame_size;
+    ret = uac_host_duplex_wait(&mic->ringbuf, &duplex->mic_skip, duplex->mic_frame_size, mic_len, &timeout_state, &ticks);
+    if (ESP_OK == ret) {
+        ret = uac_host_duplex_wait(&duplex->ref_ring, &duplex->ref_skip, duplex->ref_frame_size, ref_len, &timeout_state, &ticks);
     }
+    if (ESP_OK != ret) {
+        ESP_LOGD(TAG, "UAC duplex read failed");
+        return ret;
+    }
+    uac_ring_copy_out(&mic->ringbuf, mic_data, mic_len);
+    uac_ring_read_release(&mic->ringbuf, mic_len);
+    uac_ring_copy_out(&duplex->ref_ring, ref_data, ref_len);
+    uac_ring_read_release(&duplex->ref_ring, ref_len);
+    return ESP_OK;
+}
 
-    return ret;
+esp_err_t uac_host_duplex_get_stats(uac_host_duplex_handle_t duplex_handle, uac_host_duplex_stats_t *stats)
+{
+    uac_duplex_t *duplex = duplex_handle;
+    UAC_RETURN_ON_INVALID_ARG(duplex);
+    UAC_RETURN_ON_INVALID_ARG(stats);
+    *stats = duplex->stats;
+    return ESP_OK;
 }
 
 esp_err_t uac_host_get_device_info(uac_host_device_handle_t uac_dev_handle, uac_host_dev_info_t *uac_dev_info)
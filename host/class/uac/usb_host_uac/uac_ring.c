@@ -0,0 +1,297 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "uac_ring_priv.h"
+
+static const char *TAG = "uac-host";
+
+// --------------------------- Buffer Management --------------------------------
+
+static inline uint32_t uac_ring_wrap(const uac_ring_t *ring, uint32_t pos, uint32_t wrap)
+{
+    while (pos >= wrap) {
+        pos -= wrap;
+    }
+    return pos;
+}
+
+esp_err_t uac_ring_init(uac_ring_t *ring, uint32_t size)
+{
+    return uac_ring_init_caps(ring, size, 4, MALLOC_CAP_DEFAULT);
+}
+
+esp_err_t uac_ring_init_caps(uac_ring_t *ring, uint32_t size, size_t align, uint32_t caps)
+{
+    ring->buf = UAC_ALIGNED_ALLOC(BUFFER, align, size, caps);
+    ring->event = xSemaphoreCreateBinary();
+    if (!ring->buf || !ring->event) {
+        UAC_FREE(BUFFER, ring->buf, size);
+        if (ring->event) {
+            vSemaphoreDelete(ring->event);
+        }
+        memset(ring, 0, sizeof(uac_ring_t));
+        return ESP_ERR_NO_MEM;
+    }
+    ring->size = size;
+    UAC_ATOMIC_STORE(ring->wr, 0);
+    UAC_ATOMIC_STORE(ring->rd, 0);
+    UAC_ATOMIC_STORE(ring->waiting, false);
+    UAC_ATOMIC_STORE(ring->aborted, false);
+    return ESP_OK;
+}
+
+void uac_ring_deinit(uac_ring_t *ring)
+{
+    UAC_FREE(BUFFER, ring->buf, ring->size);
+    if (ring->event) {
+        vSemaphoreDelete(ring->event);
+    }
+    memset(ring, 0, sizeof(uac_ring_t));
+}
+
+/**
+ * @brief Wake up the task waiting for the ring, if there is any
+ */
+static void UAC_DATA_PATH_ATTR uac_ring_notify(uac_ring_t *ring)
+{
+    if (UAC_ATOMIC_EXCHANGE(ring->waiting, false)) {
+        xSemaphoreGive(ring->event);
+    }
+}
+
+esp_err_t uac_ring_wait(uac_ring_t *ring, bool data, size_t min_len, TickType_t ticks_to_wait)
+{
+    TimeOut_t timeout;
+    vTaskSetTimeOutState(&timeout);
+    while (true) {
+        if ((data ? uac_ring_get_len(ring) : uac_ring_get_free(ring)) >= min_len) {
+            return ESP_OK;
+        }
+        if (UAC_ATOMIC_LOAD(ring->aborted)) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        if (xTaskCheckForTimeOut(&timeout, &ticks_to_wait) == pdTRUE) {
+            return ESP_ERR_TIMEOUT;
+        }
+        UAC_ATOMIC_STORE(ring->waiting, true);
+        // Check again, the other side may have updated its position before it could see the waiting flag
+        if ((data ? uac_ring_get_len(ring) : uac_ring_get_free(ring)) < min_len) {
+            xSemaphoreTake(ring->event, ticks_to_wait);
+        }
+    }
+}
+
+void uac_ring_abort(uac_ring_t *ring)
+{
+    UAC_ATOMIC_STORE(ring->aborted, true);
+    xSemaphoreGive(ring->event);
+}
+
+size_t UAC_DATA_PATH_ATTR uac_ring_write_acquire(uac_ring_t *ring, uint8_t **span)
+{
+    const uint32_t pos = uac_ring_wrap(ring, UAC_ATOMIC_LOAD(ring->wr), ring->size);
+    *span = ring->buf + pos;
+    return MIN(uac_ring_get_free(ring), ring->size - pos);
+}
+
+void UAC_DATA_PATH_ATTR uac_ring_copy_in(uac_ring_t *ring, size_t offset, const uint8_t *data, size_t len)
+{
+    const uint32_t pos = uac_ring_wrap(ring, UAC_ATOMIC_LOAD(ring->wr) + offset, ring->size);
+    const size_t first = MIN(len, ring->size - pos);
+    memcpy(ring->buf + pos, data, first);
+    memcpy(ring->buf, data + first, len - first);
+}
+
+void UAC_DATA_PATH_ATTR uac_ring_write_commit(uac_ring_t *ring, size_t len)
+{
+    assert(len <= uac_ring_get_free(ring));
+    UAC_ATOMIC_STORE(ring->wr, uac_ring_wrap(ring, UAC_ATOMIC_LOAD(ring->wr) + len, 2 * ring->size));
+    uac_ring_notify(ring);
+}
+
+size_t UAC_DATA_PATH_ATTR uac_ring_read_acquire(uac_ring_t *ring, uint8_t **span)
+{
+    const uint32_t pos = uac_ring_wrap(ring, UAC_ATOMIC_LOAD(ring->rd), ring->size);
+    *span = ring->buf + pos;
+    return MIN(uac_ring_get_len(ring), ring->size - pos);
+}
+
+void UAC_DATA_PATH_ATTR uac_ring_copy_out(uac_ring_t *ring, uint8_t *data, size_t len)
+{
+    const uint32_t pos = uac_ring_wrap(ring, UAC_ATOMIC_LOAD(ring->rd), ring->size);
+    const size_t first = MIN(len, ring->size - pos);
+    memcpy(data, ring->buf + pos, first);
+    memcpy(data + first, ring->buf, len - first);
+}
+
+void UAC_DATA_PATH_ATTR uac_ring_read_release(uac_ring_t *ring, size_t len)
+{
+    assert(len <= uac_ring_get_len(ring));
+    UAC_ATOMIC_STORE(ring->rd, uac_ring_wrap(ring, UAC_ATOMIC_LOAD(ring->rd) + len, 2 * ring->size));
+    uac_ring_notify(ring);
+}
+
+void uac_ring_flush(uac_ring_t *ring)
+{
+    assert(ring->buf);
+    UAC_ATOMIC_STORE(ring->rd, UAC_ATOMIC_LOAD(ring->wr));
+    uac_ring_notify(ring);
+}
+
+void uac_ring_reset(uac_ring_t *ring)
+{
+    assert(ring->buf);
+    UAC_ATOMIC_STORE(ring->wr, 0);
+    UAC_ATOMIC_STORE(ring->rd, 0);
+    uac_ring_notify(ring);
+}
+
+esp_err_t uac_ring_push(uac_ring_t *ring, const uint8_t *buf, size_t write_bytes, TickType_t xTicksToWait)
+{
+    assert(ring->buf && buf);
+    if (write_bytes > ring->size) {
+        ESP_LOGD(TAG, "buffer is too small, push failed");
+        return ESP_FAIL;
+    }
+    esp_err_t ret = uac_ring_wait(ring, false, write_bytes, xTicksToWait);
+    if (ret != ESP_OK) {
+        return ret == ESP_ERR_TIMEOUT ? ESP_FAIL : ret;
+    }
+    uac_ring_copy_in(ring, 0, buf, write_bytes);
+    uac_ring_write_commit(ring, write_bytes);
+    return ESP_OK;
+}
+
+esp_err_t uac_ring_pop(uac_ring_t *ring, uint8_t *buf, size_t req_bytes, size_t *read_bytes, TickType_t ticks_to_wait)
+{
+    assert(ring->buf && buf && read_bytes);
+    *read_bytes = 0;
+    esp_err_t ret = uac_ring_wait(ring, true, req_bytes ? 1 : 0, ticks_to_wait);
+    if (ret != ESP_OK) {
+        return ret == ESP_ERR_TIMEOUT ? ESP_FAIL : ret;
+    }
+    *read_bytes = MIN(req_bytes, uac_ring_get_len(ring));
+    uac_ring_copy_out(ring, buf, *read_bytes);
+    uac_ring_read_release(ring, *read_bytes);
+    return ESP_OK;
+}
+
+// --------------------------- PCM conversion ---------------------------------
+
+static inline int32_t _pcm_load(const uint8_t *src, uint8_t size, bool is_float)
+{
+    if (is_float) {
+        float sample;
+        memcpy(&sample, src, sizeof(sample));
+        // NaN ends up at the negative limit
+        if (!(sample > -1.0f)) {
+            return INT32_MIN;
+        }
+        return sample < 1.0f ? (int32_t)(sample * 2147483648.0f) : INT32_MAX;
+    }
+    uint32_t raw = 0;
+    for (int i = 0; i < size; i++) {
+        raw |= (uint32_t)src[i] << (8 * i);
+    }
+    return (int32_t)(raw << (32 - 8 * size));
+}
+
+static inline void _pcm_store(uint8_t *dst, int32_t sample, uint8_t size, bool is_float)
+{
+    if (is_float) {
+        const float value = sample / 2147483648.0f;
+        memcpy(dst, &value, sizeof(value));
+        return;
+    }
+    const uint32_t raw = (uint32_t)sample >> (32 - 8 * size);
+    for (int i = 0; i < size; i++) {
+        dst[i] = raw >> (8 * i);
+    }
+}
+
+void UAC_DATA_PATH_ATTR uac_pcm_convert(const uac_pcm_conv_t *conv, uint8_t *dst, const uint8_t *src, size_t frames)
+{
+    int32_t samples[UAC_HOST_PCM_CHANNELS_MAX];
+    for (size_t i = 0; i < frames; i++) {
+        int64_t sum = 0;
+        for (int ch = 0; ch < conv->src_channels; ch++) {
+            samples[ch] = _pcm_load(src + ch * conv->src_size, conv->src_size, conv->src_float);
+            sum += samples[ch];
+        }
+        const int32_t mix = sum / conv->src_channels;
+        for (int ch = 0; ch < conv->dst_channels; ch++) {
+            const uint8_t src_ch = conv->map[ch];
+            _pcm_store(dst + ch * conv->dst_size, src_ch == UAC_HOST_PCM_CHANNEL_MIX ? mix : samples[src_ch],
+                       conv->dst_size, conv->dst_float);
+        }
+        src += conv->src_frame_size;
+        dst += conv->dst_frame_size;
+    }
+}
+
+void UAC_DATA_PATH_ATTR uac_ring_convert_in(uac_ring_t *ring, const uac_pcm_conv_t *conv, const uint8_t *src, size_t frames)
+{
+    const uint32_t frame_size = conv->dst_frame_size;
+    uint32_t pos = uac_ring_wrap(ring, UAC_ATOMIC_LOAD(ring->wr), ring->size);
+    size_t num = MIN(frames, (ring->size - pos) / frame_size);
+    uac_pcm_convert(conv, ring->buf + pos, src, num);
+    src += num * conv->src_frame_size;
+    frames -= num;
+    pos += num * frame_size;
+    if (frames == 0) {
+        return;
+    }
+    if (pos < ring->size) {
+        uint8_t tmp[UAC_HOST_PCM_CHANNELS_MAX * sizeof(int32_t)];
+        const uint32_t first = ring->size - pos;
+        uac_pcm_convert(conv, tmp, src, 1);
+        memcpy(ring->buf + pos, tmp, first);
+        memcpy(ring->buf, tmp + first, frame_size - first);
+        src += conv->src_frame_size;
+        frames--;
+        pos = frame_size - first;
+    } else {
+        pos = 0;
+    }
+    uac_pcm_convert(conv, ring->buf + pos, src, frames);
+}
+
+void UAC_DATA_PATH_ATTR uac_ring_convert_out(uac_ring_t *ring, const uac_pcm_conv_t *conv, uint8_t *dst, size_t frames)
+{
+    const uint32_t frame_size = conv->src_frame_size;
+    uint32_t pos = uac_ring_wrap(ring, UAC_ATOMIC_LOAD(ring->rd), ring->size);
+    size_t num = MIN(frames, (ring->size - pos) / frame_size);
+    uac_pcm_convert(conv, dst, ring->buf + pos, num);
+    dst += num * conv->dst_frame_size;
+    frames -= num;
+    pos += num * frame_size;
+    if (frames == 0) {
+        return;
+    }
+    if (pos < ring->size) {
+        uint8_t tmp[UAC_HOST_PCM_CHANNELS_MAX * sizeof(int32_t)];
+        const uint32_t first = ring->size - pos;
+        memcpy(tmp, ring->buf + pos, first);
+        memcpy(tmp + first, ring->buf, frame_size - first);
+        uac_pcm_convert(conv, dst, tmp, 1);
+        dst += conv->dst_frame_size;
+        frames--;
+        pos = frame_size - first;
+    } else {
+        pos = 0;
+    }
+    uac_pcm_convert(conv, dst, ring->buf + pos, frames);
+}
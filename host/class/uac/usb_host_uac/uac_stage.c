@@ -0,0 +1,194 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/param.h>
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "uac_stage_priv.h"
+#if UAC_STAGE_DMA
+#include "esp_async_memcpy.h"
+#include "esp_cache.h"
+// Async memcpy handle was renamed in IDF v5.2. Transfer alignment fields were replaced in IDF v5.4
+#if (ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 2, 0))
+#define async_memcpy_handle_t async_memcpy_t
+#endif
+#define UAC_ASYNC_MEMCPY_HAS_TRANS_ALIGN (ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 4, 0))
+#endif
+
+static const char *TAG = "uac-stage";
+
+#define UAC_STAGE_COPY_TIMEOUT  (pdMS_TO_TICKS(100)) // Max time to wait for a DMA copy, it should be much faster
+
+// --------------------------- Block Copy --------------------------------
+
+#if UAC_STAGE_DMA
+static bool uac_stage_copy_done(async_memcpy_handle_t mcp, async_memcpy_event_t *event, void *cb_args)
+{
+    uac_stage_t *stage = (uac_stage_t *)cb_args;
+    BaseType_t high_task_woken = pdFALSE;
+    xSemaphoreGiveFromISR(stage->copy_done, &high_task_woken);
+    return high_task_woken == pdTRUE;
+}
+#endif
+
+/**
+ * @brief Copy one block from the staging ring to the destination ring, mover task only
+ *
+ * @param[in] stage  Pointer to the staging
+ * @param[in] dst    Destination in the destination ring
+ * @param[in] src    Source in the staging ring
+ * @param[in] len    Number of bytes, multiple of UAC_STAGE_ALIGN
+ */
+static void uac_stage_copy(uac_stage_t *stage, uint8_t *dst, uint8_t *src, size_t len)
+{
+#if UAC_STAGE_DMA
+    // The staged data may still be in cache on targets with cached internal RAM. Errors are ignored for non-cacheable memory
+    esp_cache_msync(src, len, ESP_CACHE_MSYNC_FLAG_DIR_C2M);
+    if (esp_async_memcpy((async_memcpy_handle_t)stage->mcp, dst, src, len, uac_stage_copy_done, stage) == ESP_OK) {
+        if (xSemaphoreTake(stage->copy_done, UAC_STAGE_COPY_TIMEOUT) != pdTRUE) {
+            ESP_LOGW(TAG, "Staging copy timeout");
+        }
+        // The destination was written by DMA, make sure that CPU does not read stale data from cache
+        esp_cache_msync(dst, len, ESP_CACHE_MSYNC_FLAG_DIR_M2C);
+        return;
+    }
+    // DMA is busy or the buffers are not suitable for DMA: Fallback to CPU copy.
+    // Write it back, so no dirty cache line overwrites a later DMA copy to the same place
+    memcpy(dst, src, len);
+    esp_cache_msync(dst, len, ESP_CACHE_MSYNC_FLAG_DIR_C2M);
+#else
+    memcpy(dst, src, len);
+#endif
+}
+
+/**
+ * @brief Move all staged data that fit to the destination ring, mover task only
+ *
+ * @param[in] stage  Pointer to the staging
+ * @return Number of moved bytes
+ */
+static size_t uac_stage_move(uac_stage_t *stage)
+{
+    uac_ring_t *src = &stage->ring;
+    size_t len = MIN(uac_ring_get_len(src), uac_ring_get_free(stage->dst));
+    len -= len % UAC_STAGE_ALIGN;
+    size_t moved = 0;
+    while (moved < len) {
+        uint8_t *src_span;
+        uint8_t *dst_span;
+        const size_t src_len = uac_ring_read_acquire(src, &src_span);
+        const size_t dst_len = uac_ring_write_acquire(stage->dst, &dst_span);
+        const size_t block = MIN(MIN(src_len, dst_len), len - moved);
+        uac_stage_copy(stage, dst_span, src_span, block);
+        uac_ring_write_commit(stage->dst, block);
+        uac_ring_read_release(src, block);
+        moved += block;
+    }
+    return moved;
+}
+
+static void uac_stage_task(void *arg)
+{
+    uac_stage_t *stage = (uac_stage_t *)arg;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (UAC_ATOMIC_LOAD(stage->exit)) {
+            break;
+        }
+        xSemaphoreTake(stage->lock, portMAX_DELAY);
+        const size_t moved = uac_stage_move(stage);
+        xSemaphoreGive(stage->lock);
+        if (moved || !uac_ring_get_free(stage->dst)) {
+            stage->moved_cb(stage->moved_cb_arg);
+        }
+    }
+    xSemaphoreGive(stage->exited);
+    vTaskDelete(NULL);
+}
+
+// --------------------------- Public API --------------------------------
+
+esp_err_t uac_stage_init(uac_stage_t *stage, uint32_t size, uac_ring_t *dst, uac_stage_moved_cb_t moved_cb, void *moved_cb_arg)
+{
+    ESP_RETURN_ON_FALSE(stage && size && dst && moved_cb, ESP_ERR_INVALID_ARG, TAG, "Invalid staging arguments");
+    ESP_RETURN_ON_FALSE(dst->size % UAC_STAGE_ALIGN == 0, ESP_ERR_INVALID_ARG, TAG, "Unaligned destination ring");
+    esp_err_t ret = ESP_OK;
+    size = UAC_STAGE_ROUND_UP(size);
+    stage->dst = dst;
+    // Moving in quarters of the staging ring leaves room for the transfers completing until the mover runs
+    stage->block = MAX(size / 4, UAC_STAGE_ALIGN);
+    stage->moved_cb = moved_cb;
+    stage->moved_cb_arg = moved_cb_arg;
+    UAC_ATOMIC_STORE(stage->exit, false);
+    ESP_GOTO_ON_ERROR(uac_ring_init_caps(&stage->ring, size, UAC_STAGE_ALIGN, MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA | MALLOC_CAP_8BIT),
+                      fail, TAG, "Not enough internal memory for staging ring");
+    stage->lock = xSemaphoreCreateMutex();
+    stage->exited = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(stage->lock && stage->exited, ESP_ERR_NO_MEM, fail, TAG, "Unable to create staging semaphores");
+#if UAC_STAGE_DMA
+    stage->copy_done = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(stage->copy_done, ESP_ERR_NO_MEM, fail, TAG, "Unable to create staging semaphores");
+    async_memcpy_config_t config = ASYNC_MEMCPY_DEFAULT_CONFIG();
+    config.backlog = 1;
+#if UAC_ASYNC_MEMCPY_HAS_TRANS_ALIGN
+    config.sram_trans_align = 4;
+    config.psram_trans_align = UAC_STAGE_ALIGN;
+#endif
+    async_memcpy_handle_t mcp = NULL;
+    ESP_GOTO_ON_ERROR(esp_async_memcpy_install(&config, &mcp), fail, TAG, "Could not install async memcpy");
+    stage->mcp = mcp;
+#endif
+    ESP_GOTO_ON_FALSE(xTaskCreate(uac_stage_task, "uac_stage", CONFIG_UAC_STAGING_TASK_STACK_SIZE, stage,
+                                  CONFIG_UAC_STAGING_TASK_PRIORITY, &stage->task) == pdPASS,
+                      ESP_ERR_NO_MEM, fail, TAG, "Unable to create staging task");
+    return ESP_OK;
+
+fail:
+    stage->task = NULL;
+    uac_stage_deinit(stage);
+    return ret;
+}
+
+void uac_stage_deinit(uac_stage_t *stage)
+{
+    if (stage->task) {
+        UAC_ATOMIC_STORE(stage->exit, true);
+        xTaskNotifyGive(stage->task);
+        xSemaphoreTake(stage->exited, portMAX_DELAY);
+    }
+#if UAC_STAGE_DMA
+    if (stage->mcp) {
+        esp_async_memcpy_uninstall((async_memcpy_handle_t)stage->mcp);
+    }
+    if (stage->copy_done) {
+        vSemaphoreDelete(stage->copy_done);
+    }
+#endif
+    if (stage->lock) {
+        vSemaphoreDelete(stage->lock);
+    }
+    if (stage->exited) {
+        vSemaphoreDelete(stage->exited);
+    }
+    uac_ring_deinit(&stage->ring);
+    memset(stage, 0, sizeof(uac_stage_t));
+}
+
+void uac_stage_flush(uac_stage_t *stage)
+{
+    xSemaphoreTake(stage->lock, portMAX_DELAY);
+    // Restart at the beginning, so the staging read position is aligned to the destination write position again
+    uac_ring_reset(&stage->ring);
+    uac_ring_flush(stage->dst);
+    xSemaphoreGive(stage->lock);
+}
@@ -14,19 +14,18 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
-#include "freertos/queue.h"
 
 #include "display.h"
-#include "jpeg_decoder.h"
+#include "esp_lcd_panel_io.h"
 #include "usb/usb_host.h"
 #include "usb/uvc_host.h"
+#include "usb/uvc_color_convert.h"
+#include "usb/uvc_mjpeg_display.h"
 
 #define FRAME_H_RES  480
 #define FRAME_V_RES  320
 #define FRAME_FORMAT UVC_VS_FORMAT_MJPEG
 #define FRAME_FPS    15
-#define DECODE_EVERY_XTH_FRAME 2        // Every 2nd frame will be decoded and send to display. This save CPU time
-#define DECODE_WORKING_BUFFER_SIZE 4000 // We must increase JPEG decoder working buffer size
 
 #if CONFIG_SPIRAM
 #define NUMBER_OF_FRAME_BUFFERS 3 // Number of frames from the camera
@@ -36,15 +35,13 @@
 
 //@todo make the LCD feature optional
 
-static uint16_t *fb = NULL; // Framebuffer for decoded data (to LCD)
+static uint16_t *fb = NULL; // Framebuffer for converted YUY2 data (to LCD)
 static const char *TAG = "example";
 static esp_lcd_panel_handle_t display_panel;
-static QueueHandle_t frame_q = NULL; // Queue of received frames that are passed to processing task
+static uvc_mjpeg_display_hdl_t mjpeg_display; // Decodes MJPEG frames while the previous frame is sent to LCD
 static SemaphoreHandle_t device_disconnected_sem;
 static uvc_host_stream_hdl_t stream;
 
-void yuy2_to_rgb565(const uint8_t *yuy2, uint16_t *rgb565, int width, int height);
-
 void stream_callback(const uvc_host_stream_event_data_t *event, void *user_ctx)
 {
     switch (event->type) {
@@ -76,76 +73,39 @@ bool frame_callback(const uvc_host_frame_t *frame, void *user_ctx)
     case UVC_VS_FORMAT_YUY2: {
         ESP_LOGD(TAG, "YUY2 frame %dx%d", frame->vs_format.h_res, frame->vs_format.v_res);
         if (fb) {
-            yuy2_to_rgb565(frame->data, fb, frame->vs_format.h_res, frame->vs_format.v_res);
+            const uvc_color_convert_config_t convert_config = {
+                .src = {
+                    .width = frame->vs_format.h_res,
+                    .height = frame->vs_format.v_res,
+                },
+            };
+            uvc_color_convert_yuy2_to_rgb565(frame->data, fb, &convert_config);
             esp_lcd_panel_draw_bitmap(display_panel, 0, 0, frame->vs_format.h_res, frame->vs_format.v_res, (const void *)fb);
         }
         frame_processed = true;
         break;
     }
-    case UVC_VS_FORMAT_H264:
-    case UVC_VS_FORMAT_H265:
-    case UVC_VS_FORMAT_MJPEG: {
-        // Attempt to put the new frame into the queue without checking if it is full.
-        // If successful, we save processing time since we avoid the overhead of a full check for every frame.
-        BaseType_t frame_put_to_queue = xQueueSendToBack(frame_q, &frame, 0);
-
-        // Adding the frame to our queue should never fail, because our frame_q has the same length as the UVC driver queue (NUMBER_OF_FRAME_BUFFERS)
-        assert(frame_put_to_queue == pdPASS);
+    case UVC_VS_FORMAT_MJPEG:
+        // The pipeline returns the frame to the driver as soon as it is decoded
+        frame_processed = (uvc_mjpeg_display_submit(mjpeg_display, stream, (uvc_host_frame_t *)frame) != ESP_OK);
         break;
-    }
     default:
         ESP_LOGI(TAG, "Unsupported format!");
+        frame_processed = true;
         break;
     }
     return frame_processed;
 }
 
-static void processing_task(void *pvParameters)
+static void mjpeg_draw(uvc_mjpeg_display_hdl_t display, const uint16_t *rgb565, unsigned width, unsigned height, void *user_ctx)
 {
-    uvc_host_frame_t *frame;
-    uint8_t *jpeg_working_buffer = malloc(DECODE_WORKING_BUFFER_SIZE);
-    assert(jpeg_working_buffer);
-
-    while (1) {
-        xQueueReceive(frame_q, &frame, portMAX_DELAY);
-        ESP_LOGD(TAG, "MJPEG frame %dx%d %d bytes", frame->vs_format.h_res, frame->vs_format.v_res, frame->data_len);
-
-        static int frame_i = 0;
-        if (fb && ((frame_i % DECODE_EVERY_XTH_FRAME) == 0)) {
-            frame_i = 0;
-            esp_jpeg_image_cfg_t jpeg_cfg = {
-                .indata = (uint8_t *)frame->data,
-                .indata_size = frame->data_len,
-                .outbuf = (uint8_t *)fb,
-                .outbuf_size = FRAME_H_RES * FRAME_V_RES * 2,
-                .out_format = JPEG_IMAGE_FORMAT_RGB565,
-                .out_scale = JPEG_IMAGE_SCALE_0,
-                .flags = {
-                    .swap_color_bytes = 0,
-                },
-                .advanced = {
-                    .working_buffer = jpeg_working_buffer,
-                    .working_buffer_size = DECODE_WORKING_BUFFER_SIZE,
-                },
-            };
-            esp_jpeg_image_output_t outimg;
-
-            if (ESP_OK == esp_jpeg_decode(&jpeg_cfg, &outimg)) {
-                esp_lcd_panel_draw_bitmap(display_panel, 0, 0, outimg.width, outimg.height, (const void *)fb);
-            } else {
-                ESP_LOGW(TAG, "Decoding failed");
-            }
-        } else {
-            ESP_LOGI(TAG, "Skipping decoding of received MJPEG frame");
-        }
-        frame_i++;
-
-        uvc_host_frame_return(stream, frame);
-    }
+    // Returns right after the transfer to LCD is queued, the buffer is released from on_color_trans_done
+    esp_lcd_panel_draw_bitmap(display_panel, 0, 0, width, height, (const void *)rgb565);
+}
 
-    // This code should never be reached. Leaving it here for completeness
-    free(jpeg_working_buffer);
-    vTaskDelete(NULL);
+static bool lcd_trans_done(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx)
+{
+    return uvc_mjpeg_display_draw_done_from_isr(mjpeg_display);
 }
 
 static void usb_lib_task(void *arg)
@@ -173,15 +133,40 @@ void app_main(void)
     };
     bsp_display_new(&config, &display_panel, &display_io);
 
-    //@todo does not work in PSRAM... :'(
-    fb = heap_caps_aligned_alloc(64, FRAME_H_RES * FRAME_V_RES * 2, MALLOC_CAP_INTERNAL);
-    if (fb == NULL) {
-        ESP_LOGW(TAG, "Insufficient memory for LCD frame buffer. LCD output disabled.");
+    if (FRAME_FORMAT == UVC_VS_FORMAT_YUY2) {
+        //@todo does not work in PSRAM... :'(
+        fb = heap_caps_aligned_alloc(64, FRAME_H_RES * FRAME_V_RES * 2, MALLOC_CAP_INTERNAL);
+        if (fb == NULL) {
+            ESP_LOGW(TAG, "Insufficient memory for LCD frame buffer. LCD output disabled.");
+        }
     }
 
-    frame_q = xQueueCreate(NUMBER_OF_FRAME_BUFFERS, sizeof (uvc_host_frame_t *));
+    // MJPEG decode-and-display pipeline. Hardware JPEG decoder is used on targets that have one
+    const uvc_mjpeg_display_config_t mjpeg_display_config = {
+        .draw_cb = mjpeg_draw,
+        .max_width = FRAME_H_RES,
+        .max_height = FRAME_V_RES,
+#if CONFIG_SPIRAM
+        .number_of_buffers = 2,
+        .buffer_heap_caps = MALLOC_CAP_SPIRAM,
+#else
+        .number_of_buffers = 1,
+        .buffer_heap_caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA,
+#endif
+        .task = {
+            .stack_size = 4 * 1024,
+            .priority = 2,
+            .core_id = tskNO_AFFINITY,
+        },
+    };
+    ESP_ERROR_CHECK(uvc_mjpeg_display_create(&mjpeg_display_config, &mjpeg_display));
+    const esp_lcd_panel_io_callbacks_t io_callbacks = {
+        .on_color_trans_done = lcd_trans_done,
+    };
+    ESP_ERROR_CHECK(esp_lcd_panel_io_register_event_callbacks(display_io, &io_callbacks, NULL));
+
     device_disconnected_sem = xSemaphoreCreateBinary();
-    assert(device_disconnected_sem && frame_q);
+    assert(device_disconnected_sem);
 
     // Install USB Host driver. Should only be called once in entire application
     ESP_LOGI(TAG, "Installing USB Host");
@@ -235,9 +220,6 @@ void app_main(void)
         },
     };
 
-    BaseType_t ret = xTaskCreate(processing_task, "frame_process", 4 * 1024, NULL, 2, NULL);
-    assert(ret == pdPASS);
-
     while (true) {
         ESP_LOGI(TAG, "Opening the stream...");
         esp_err_t err = uvc_host_stream_open(&uvc_stream_config, pdMS_TO_TICKS(5000), &stream);
@@ -0,0 +1,159 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include "test_benchmark.hpp"
+
+#include "usb/uvc_host.h"
+#include "uvc_descriptors_priv.h"
+
+#include "descriptors/anker_powerconf_c200.hpp"
+#include "descriptors/customer.hpp"
+#include "descriptors/customer_dual.hpp"
+#include "descriptors/dual_tusb.hpp"
+#include "descriptors/elp_h264.hpp"
+#include "descriptors/elp_h265.hpp"
+#include "descriptors/logitech_c270.hpp"
+#include "descriptors/logitech_streamcam.hpp"
+#include "descriptors/old.hpp"
+#include "descriptors/trust_webcam.hpp"
+
+/**
+ * Descriptor parsing benchmark
+ *
+ * Times what happens in uvc_host_stream_open() before the first USB transfer: building the descriptor index
+ * and looking up the requested format, the interface and its alternate setting. Every frame format of every camera
+ * in the corpus is looked up, so the numbers follow the size of real-world descriptors.
+ */
+
+namespace {
+
+struct corpus_entry {
+    const char *name;
+    const uint8_t *cfg_desc;
+};
+
+const corpus_entry corpus[] = {
+    {"Anker PowerConf C200", anker_powerconf_c200::cfg_desc},
+    {"Customer camera", customer_camera::cfg_desc},
+    {"Customer dual camera", customer_camera_dual::cfg_desc},
+    {"TinyUSB dual camera", dual_tusb::cfg_desc},
+    {"ELP H264", elp_h264::cfg_desc},
+    {"ELP H265", elp_h265::cfg_desc},
+    {"Logitech C270", logitech_c270::cfg_desc},
+    {"Logitech StreamCam", logitech_streamcam::cfg_desc},
+    {"Canyon CNE CWC2", old_cameras::CANYON_CNE_CWC2},
+    {"Logitech C980", old_cameras::Logitech_C980},
+    {"Trust webcam", trust_webcam::cfg_desc},
+};
+
+constexpr int benchmark_iterations = 1000;
+
+/**
+ * @brief Frame format to look up, with the UVC function that offers it
+ */
+struct lookup {
+    uint8_t uvc_index;
+    uvc_host_stream_format_t format;
+};
+
+/**
+ * @brief List all frame formats offered by the camera
+ */
+std::vector<lookup> list_lookups(const uvc_desc_index_t *index)
+{
+    std::vector<lookup> lookups;
+    for (size_t i = 0; i < index->num_intfs; i++) {
+        const uvc_desc_index_intf_t *intf = &index->intfs[i];
+        size_t list_size = 0;
+        REQUIRE(uvc_desc_index_get_frame_list(intf, nullptr, &list_size) == ESP_OK);
+        std::vector<uvc_host_frame_info_t> list(list_size);
+        REQUIRE(uvc_desc_index_get_frame_list(intf, list.data(), &list_size) == ESP_OK);
+        for (const uvc_host_frame_info_t &info : list) {
+            if (info.format == UVC_VS_FORMAT_UNDEFINED || info.default_interval == 0) {
+                continue;
+            }
+            lookups.push_back({
+                .uvc_index = intf->uvc_index,
+                .format = {info.h_res, info.v_res, 10000000.0f / info.default_interval, info.format},
+            });
+        }
+    }
+    return lookups;
+}
+
+void run_benchmark(const corpus_entry &entry)
+{
+    const usb_config_desc_t *cfg = reinterpret_cast<const usb_config_desc_t *>(entry.cfg_desc);
+
+    // Parse: Build and free the index. Results are checked after measurement, so the checks do not allocate
+    size_t parsed = 0;
+    test_benchmark_meter parse_meter;
+    parse_meter.start();
+    for (int i = 0; i < benchmark_iterations; i++) {
+        uvc_desc_index_t *index = nullptr;
+        if (uvc_desc_index_build(cfg, &index) == ESP_OK) {
+            parsed++;
+        }
+        uvc_desc_index_free(index);
+    }
+    parse_meter.stop();
+    REQUIRE(parsed == benchmark_iterations);
+
+    // Lookup: Everything format negotiation needs, for each frame format
+    uvc_desc_index_t *index = nullptr;
+    REQUIRE(uvc_desc_index_build(cfg, &index) == ESP_OK);
+    const std::vector<lookup> lookups = list_lookups(index);
+    size_t found = 0;
+    test_benchmark_meter lookup_meter;
+    lookup_meter.start();
+    for (int i = 0; i < benchmark_iterations; i++) {
+        for (const lookup &this_lookup : lookups) {
+            const uvc_desc_index_intf_t *vs_intf = nullptr;
+            if (uvc_desc_index_get_streaming_intf(index, this_lookup.uvc_index, &this_lookup.format, &vs_intf) != ESP_OK) {
+                continue;
+            }
+            const uvc_format_desc_t *format_desc = nullptr;
+            const uvc_frame_desc_t *frame_desc = nullptr;
+            const usb_intf_desc_t *intf_desc = nullptr;
+            const usb_ep_desc_t *ep_desc = nullptr;
+            if (uvc_desc_index_get_frame_format_by_format(vs_intf, &this_lookup.format, &format_desc, &frame_desc) == ESP_OK &&
+                    uvc_desc_index_get_intf_and_ep_by_bandwidth(index, vs_intf->bInterfaceNumber, 1024, 4096, UINT32_MAX, true,
+                            &intf_desc, &ep_desc) == ESP_OK) {
+                found++;
+            }
+        }
+    }
+    lookup_meter.stop();
+    const size_t index_intfs = index->num_intfs;
+    const size_t index_formats = index->num_formats;
+    uvc_desc_index_free(index);
+
+    REQUIRE(found == lookups.size() * benchmark_iterations);
+    REQUIRE(lookup_meter.allocs == 0); // Lookups use the index only
+
+    printf("%-22s %5u bytes, %zu VS intf, %2zu formats, %3zu frames: parse %7.0f ns, %zu alloc (%zu bytes), %5.1f M lookups/s\n",
+           entry.name,
+           cfg->wTotalLength,
+           index_intfs,
+           index_formats,
+           lookups.size(),
+           parse_meter.seconds() * 1e9 / benchmark_iterations,
+           parse_meter.allocs / benchmark_iterations,
+           parse_meter.alloc_bytes / benchmark_iterations,
+           lookups.empty() ? 0.0 : lookups.size() * benchmark_iterations / lookup_meter.seconds() / 1e6);
+}
+
+} // namespace
+
+TEST_CASE("Descriptor parsing benchmark", "[.][benchmark]")
+{
+    for (const corpus_entry &entry : corpus) {
+        run_benchmark(entry);
+    }
+}
@@ -50,4 +50,41 @@ SCENARIO("Camera descriptor parsing: Customer", "[customer][single]")
             }
         }
     }
+
+    GIVEN("Customer still image") {
+        const uvc_host_stream_format_t format = {640, 480, 25, UVC_VS_FORMAT_MJPEG};
+        uvc_desc_index_t *index = nullptr;
+        REQUIRE(ESP_OK == uvc_desc_index_build(cfg, &index));
+        const uvc_desc_index_intf_t *vs_intf = nullptr;
+        REQUIRE(ESP_OK == uvc_desc_index_get_streaming_intf(index, 0, &format, &vs_intf));
+        REQUIRE(vs_intf->bStillCaptureMethod == 2);
+        REQUIRE(vs_intf->still_ep_desc == nullptr);
+        unsigned h_res, v_res;
+        uint8_t bFrameIndex, bCompressionIndex;
+
+        SECTION("Largest still image") {
+            h_res = 0;
+            v_res = 0;
+            REQUIRE(ESP_OK == uvc_desc_index_get_still_frame(vs_intf, 1, &h_res, &v_res, &bFrameIndex, &bCompressionIndex));
+            REQUIRE(h_res == 1280);
+            REQUIRE(v_res == 720);
+            REQUIRE(bFrameIndex == 1);
+            REQUIRE(bCompressionIndex == 0);
+        }
+
+        SECTION("Requested still image") {
+            h_res = 480;
+            v_res = 320;
+            REQUIRE(ESP_OK == uvc_desc_index_get_still_frame(vs_intf, 1, &h_res, &v_res, &bFrameIndex, &bCompressionIndex));
+            REQUIRE(bFrameIndex == 4);
+        }
+
+        SECTION("Unsupported still image") {
+            h_res = 1920;
+            v_res = 1080;
+            REQUIRE(ESP_ERR_NOT_FOUND == uvc_desc_index_get_still_frame(vs_intf, 1, &h_res, &v_res, &bFrameIndex, &bCompressionIndex));
+            REQUIRE(ESP_ERR_NOT_FOUND == uvc_desc_index_get_still_frame(vs_intf, 2, &h_res, &v_res, &bFrameIndex, &bCompressionIndex));
+        }
+        uvc_desc_index_free(index);
+    }
 }
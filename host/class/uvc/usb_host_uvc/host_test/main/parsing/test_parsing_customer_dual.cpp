@@ -54,20 +54,22 @@ SCENARIO("Camera descriptor parsing: Customer dual", "[customer][dual]")
         for (uvc_host_stream_format_t this_format : formats) {
             // Here we are testing uvc_index = 1 and expected_interface = 3
             SECTION(std::to_string(this_format.h_res) + "x" + std::to_string(this_format.v_res) + "@" + std::to_string(this_format.fps)) {
-                uint8_t bInterfaceNumber = 0;
-                uint16_t bcdUVC = 0;
-                REQUIRE(ESP_OK == uvc_desc_get_streaming_interface_num(cfg, 1, &this_format, &bcdUVC, &bInterfaceNumber));
-                REQUIRE(bInterfaceNumber == 3);
+                uvc_desc_index_t *index = nullptr;
+                REQUIRE(ESP_OK == uvc_desc_index_build(cfg, &index));
+                const uvc_desc_index_intf_t *vs_intf = nullptr;
+                REQUIRE(ESP_OK == uvc_desc_index_get_streaming_intf(index, 1, &this_format, &vs_intf));
+                REQUIRE(vs_intf->bInterfaceNumber == 3);
                 const usb_intf_desc_t *intf_desc = nullptr;
                 const usb_ep_desc_t *ep_desc = nullptr;
-                REQUIRE(ESP_OK == uvc_desc_get_streaming_intf_and_ep(cfg, bInterfaceNumber, 1024, &intf_desc, &ep_desc));
+                REQUIRE(ESP_OK == uvc_desc_index_get_intf_and_ep_by_bandwidth(index, vs_intf->bInterfaceNumber, 1024, 4096, UINT32_MAX, true, &intf_desc, &ep_desc));
                 REQUIRE(intf_desc != nullptr);
                 REQUIRE(ep_desc != nullptr);
                 const uvc_format_desc_t *format_desc = nullptr;
                 const uvc_frame_desc_t *frame_desc = nullptr;
-                REQUIRE(ESP_OK == uvc_desc_get_frame_format_by_format(cfg, bInterfaceNumber, &this_format, &format_desc, &frame_desc));
+                REQUIRE(ESP_OK == uvc_desc_index_get_frame_format_by_format(vs_intf, &this_format, &format_desc, &frame_desc));
                 REQUIRE(format_desc != nullptr);
                 REQUIRE(frame_desc != nullptr);
+                uvc_desc_index_free(index);
             }
         }
     }
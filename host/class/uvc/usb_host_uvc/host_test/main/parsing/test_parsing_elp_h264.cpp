@@ -83,4 +83,28 @@ SCENARIO("Camera descriptor parsing: ELP h264", "[elp][h264]")
             }
         }
     }
+
+    GIVEN("ELP h264 Video Control units") {
+        uvc_desc_index_t *index = nullptr;
+        REQUIRE(ESP_OK == uvc_desc_index_build(cfg, &index));
+        const uvc_desc_index_intf_t *intf = uvc_desc_index_get_intf(index, 1);
+        REQUIRE(intf != nullptr);
+
+        THEN("The unit chain has no Encoding Unit") {
+            REQUIRE(intf->bTerminalLink == 5);
+            REQUIRE(intf->enc_unit_desc == nullptr);
+        }
+
+        THEN("Vendor extension units are found by GUID") {
+            const uint8_t guid[16] = {0x70, 0x33, 0xF0, 0x28, 0x11, 0x63, 0x2E, 0x4A, 0xBA, 0x2C, 0x68, 0x90, 0xEB, 0x33, 0x40, 0x16};
+            const uvc_extension_unit_desc_t *xu_desc = uvc_desc_index_get_xu(intf, guid);
+            REQUIRE(xu_desc != nullptr);
+            REQUIRE(xu_desc->bUnitID == 3);
+            REQUIRE(uvc_desc_xu_get_controls(xu_desc) == 0xFFFFFF);
+
+            const uint8_t uvcx_guid[16] = UVC_UVCX_GUID;
+            REQUIRE(uvc_desc_index_get_xu(intf, uvcx_guid) == nullptr);
+        }
+        uvc_desc_index_free(index);
+    }
 }
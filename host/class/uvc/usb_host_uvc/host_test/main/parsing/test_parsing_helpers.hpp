@@ -96,30 +96,35 @@
 /**
  * @brief Helper that check if required format is supported
  */
-#define REQUIRE_FORMAT_SUPPORTED(cfg, format, expected_intf_num)                                                           \
-    do {                                                                                                                   \
-        uint8_t bInterfaceNumber = 0;                                                                                      \
-        uint16_t bcdUVC = 0;                                                                                               \
-        REQUIRE(ESP_OK == uvc_desc_get_streaming_interface_num(cfg, 0, &format, &bcdUVC, &bInterfaceNumber));              \
-        REQUIRE(bInterfaceNumber == expected_intf_num);                                                                    \
-        const usb_intf_desc_t *intf_desc = nullptr;                                                                        \
-        const usb_ep_desc_t *ep_desc = nullptr;                                                                            \
-        REQUIRE(ESP_OK == uvc_desc_get_streaming_intf_and_ep(cfg, bInterfaceNumber, 1024, &intf_desc, &ep_desc));                \
-        REQUIRE(intf_desc != nullptr);                                                                                     \
-        REQUIRE(ep_desc != nullptr);                                                                                       \
-        const uvc_format_desc_t *format_desc = nullptr;                                                                    \
-        const uvc_frame_desc_t *frame_desc = nullptr;                                                                      \
-        REQUIRE(ESP_OK == uvc_desc_get_frame_format_by_format(cfg, bInterfaceNumber, &format, &format_desc, &frame_desc)); \
-        REQUIRE(format_desc != nullptr);                                                                                   \
-        REQUIRE(frame_desc != nullptr);                                                                                    \
+#define REQUIRE_FORMAT_SUPPORTED(cfg, format, expected_intf_num)                                                                   \
+    do {                                                                                                                           \
+        uvc_desc_index_t *index = nullptr;                                                                                         \
+        REQUIRE(ESP_OK == uvc_desc_index_build(cfg, &index));                                                                      \
+        const uvc_desc_index_intf_t *vs_intf = nullptr;                                                                            \
+        REQUIRE(ESP_OK == uvc_desc_index_get_streaming_intf(index, 0, &format, &vs_intf));                                         \
+        REQUIRE(vs_intf->bInterfaceNumber == expected_intf_num);                                                                   \
+        const usb_intf_desc_t *intf_desc = nullptr;                                                                                \
+        const usb_ep_desc_t *ep_desc = nullptr;                                                                                    \
+        REQUIRE(ESP_OK == uvc_desc_index_get_intf_and_ep_by_bandwidth(index, vs_intf->bInterfaceNumber, 1024, 4096, UINT32_MAX, true, \
+                &intf_desc, &ep_desc));                                                                                            \
+        REQUIRE(intf_desc != nullptr);                                                                                             \
+        REQUIRE(ep_desc != nullptr);                                                                                               \
+        const uvc_format_desc_t *format_desc = nullptr;                                                                            \
+        const uvc_frame_desc_t *frame_desc = nullptr;                                                                              \
+        REQUIRE(ESP_OK == uvc_desc_index_get_frame_format_by_format(vs_intf, &format, &format_desc, &frame_desc));                 \
+        REQUIRE(format_desc != nullptr);                                                                                           \
+        REQUIRE(frame_desc != nullptr);                                                                                            \
+        uvc_desc_index_free(index);                                                                                                \
     } while (0)
 
 /**
  * @brief Helper that check if required format is NOT supported
  */
-#define REQUIRE_FORMAT_NOT_SUPPORTED(cfg, format)                                                                        \
-    do {                                                                                                                 \
-        uint8_t bInterfaceNumber = 0;                                                                                    \
-        uint16_t bcdUVC = 0;                                                                                             \
-        REQUIRE_FALSE(ESP_OK == uvc_desc_get_streaming_interface_num(cfg, 0, &this_format, &bcdUVC, &bInterfaceNumber)); \
+#define REQUIRE_FORMAT_NOT_SUPPORTED(cfg, format)                                                    \
+    do {                                                                                             \
+        uvc_desc_index_t *index = nullptr;                                                           \
+        REQUIRE(ESP_OK == uvc_desc_index_build(cfg, &index));                                        \
+        const uvc_desc_index_intf_t *vs_intf = nullptr;                                              \
+        REQUIRE_FALSE(ESP_OK == uvc_desc_index_get_streaming_intf(index, 0, &format, &vs_intf));     \
+        uvc_desc_index_free(index);                                                                  \
     } while (0)
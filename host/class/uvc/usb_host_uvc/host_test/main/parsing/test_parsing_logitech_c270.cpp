@@ -100,3 +100,110 @@ SCENARIO("Camera descriptor parsing: Logitech C270", "[logitech][c270]")
         }
     }
 }
+
+SCENARIO("Alternate interface selection by bandwidth: Logitech C270", "[logitech][c270][bandwidth]")
+{
+    const usb_config_desc_t *cfg = (const usb_config_desc_t *)cfg_desc;
+    uvc_desc_index_t *index = nullptr;
+    REQUIRE(ESP_OK == uvc_desc_index_build(cfg, &index));
+    const usb_intf_desc_t *intf_desc = nullptr;
+    const usb_ep_desc_t *ep_desc = nullptr;
+    constexpr uint8_t bInterfaceNumber = 1;
+
+    GIVEN("Unlimited bandwidth") {
+        WHEN("600 bytes payload is requested") {
+            REQUIRE(ESP_OK == uvc_desc_index_get_intf_and_ep_by_bandwidth(index, bInterfaceNumber, 600, 4096, UINT32_MAX, true, &intf_desc, &ep_desc));
+            THEN("The smallest sufficient alternate is selected") {
+                REQUIRE(intf_desc->bAlternateSetting == 4); // 640 bytes
+                REQUIRE(uvc_desc_ep_bandwidth(ep_desc, true) == 640 * 8);
+            }
+        }
+
+        WHEN("2000 bytes payload is requested") {
+            REQUIRE(ESP_OK == uvc_desc_index_get_intf_and_ep_by_bandwidth(index, bInterfaceNumber, 2000, 4096, UINT32_MAX, true, &intf_desc, &ep_desc));
+            THEN("Alternate with multiple transactions per microframe is selected") {
+                REQUIRE(intf_desc->bAlternateSetting == 10); // 3 * 896 bytes
+            }
+        }
+
+        WHEN("2000 bytes payload is requested and IN FIFO holds 1024 bytes") {
+            REQUIRE(ESP_OK == uvc_desc_index_get_intf_and_ep_by_bandwidth(index, bInterfaceNumber, 2000, 1024, UINT32_MAX, true, &intf_desc, &ep_desc));
+            THEN("High-bandwidth alternates whose transactions do not fit in FIFO are skipped") {
+                REQUIRE(intf_desc->bAlternateSetting == 6); // 944 bytes
+                REQUIRE(uvc_desc_ep_payload(ep_desc) == 944);
+            }
+        }
+    }
+
+    GIVEN("Limited bandwidth") {
+        WHEN("600 bytes payload does not fit") {
+            REQUIRE(ESP_OK == uvc_desc_index_get_intf_and_ep_by_bandwidth(index, bInterfaceNumber, 600, 4096, 4000, true, &intf_desc, &ep_desc));
+            THEN("The largest fitting alternate is selected") {
+                REQUIRE(intf_desc->bAlternateSetting == 2); // 384 bytes
+            }
+        }
+
+        WHEN("No alternate fits") {
+            REQUIRE(ESP_ERR_NOT_FOUND == uvc_desc_index_get_intf_and_ep_by_bandwidth(index, bInterfaceNumber, 600, 4096, 100, true, &intf_desc, &ep_desc));
+        }
+    }
+    uvc_desc_index_free(index);
+}
+
+SCENARIO("Frame list from descriptor index: Logitech C270", "[logitech][c270][index]")
+{
+    const usb_config_desc_t *cfg = (const usb_config_desc_t *)cfg_desc;
+    uvc_desc_index_t *index = nullptr;
+    REQUIRE(ESP_OK == uvc_desc_index_build(cfg, &index));
+    const uvc_desc_index_intf_t *vs_intf = uvc_desc_index_get_intf(index, 1);
+    REQUIRE(vs_intf != nullptr);
+    REQUIRE(vs_intf->num_formats == 2);
+
+    GIVEN("No list") {
+        size_t list_size = 0;
+        REQUIRE(ESP_OK == uvc_desc_index_get_frame_list(vs_intf, nullptr, &list_size));
+        THEN("Total number of frames is returned") {
+            REQUIRE(list_size == 38); // 19 YUY2 and 19 MJPEG frames
+        }
+    }
+
+    GIVEN("List shorter than number of frames") {
+        uvc_host_frame_info_t list[3];
+        size_t list_size = 3;
+        REQUIRE(ESP_OK == uvc_desc_index_get_frame_list(vs_intf, list, &list_size));
+        THEN("The list is filled in order of descriptors") {
+            REQUIRE(list_size == 3);
+            REQUIRE(list[0].format == UVC_VS_FORMAT_YUY2);
+            REQUIRE(list[0].h_res == 640);
+            REQUIRE(list[0].v_res == 480);
+            REQUIRE(list[0].default_interval == 333333);
+            REQUIRE(list[0].interval_type == 6);
+            REQUIRE(list[0].interval[5] == 2000000);
+            REQUIRE(list[2].h_res == 176);
+            REQUIRE(list[2].v_res == 144);
+        }
+    }
+
+    GIVEN("Frame format by index") {
+        const uvc_format_desc_t *format_desc = nullptr;
+        const uvc_frame_desc_t *frame_desc = nullptr;
+        REQUIRE(ESP_OK == uvc_desc_index_get_frame_format_by_index(vs_intf, 2, 19, &format_desc, &frame_desc));
+        THEN("Last MJPEG frame is returned") {
+            REQUIRE(uvc_desc_parse_format(format_desc) == UVC_VS_FORMAT_MJPEG);
+            REQUIRE(frame_desc->wWidth == 1280);
+            REQUIRE(frame_desc->wHeight == 960);
+        }
+        REQUIRE(ESP_ERR_NOT_FOUND == uvc_desc_index_get_frame_format_by_index(vs_intf, 2, 20, &format_desc, &frame_desc));
+    }
+
+    GIVEN("Still image") {
+        unsigned h_res = 0;
+        unsigned v_res = 0;
+        uint8_t bFrameIndex, bCompressionIndex;
+        THEN("Method 1 has no Still Image Frame descriptor") {
+            REQUIRE(vs_intf->bStillCaptureMethod == 1);
+            REQUIRE(ESP_ERR_NOT_FOUND == uvc_desc_index_get_still_frame(vs_intf, 2, &h_res, &v_res, &bFrameIndex, &bCompressionIndex));
+        }
+    }
+    uvc_desc_index_free(index);
+}
@@ -0,0 +1,81 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "usb/uvc_host.h"
+#include "uvc_descriptors_priv.h"
+
+// ISOC camera with still image capture method 3: MJPEG 640x480@30 on ISOC endpoint 0x81 of alternate setting 1,
+// still images on Bulk endpoint 0x82, which is the only endpoint of alternate setting 0
+static const uint8_t isoc_method3_cfg_desc[] = {
+    0x09, 0x02, 0x9B, 0x00, 0x02, 0x01, 0x00, 0x80, 0xFA,
+    0x09, 0x04, 0x00, 0x00, 0x00, 0x0E, 0x01, 0x00, 0x00,
+    0x0D, 0x24, 0x01, 0x00, 0x01, 0x28, 0x00, 0x00, 0x6C, 0xDC, 0x02, 0x01, 0x01,
+    0x12, 0x24, 0x02, 0x01, 0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+    0x09, 0x24, 0x03, 0x02, 0x01, 0x01, 0x00, 0x01, 0x00,
+    0x09, 0x04, 0x01, 0x00, 0x01, 0x0E, 0x02, 0x00, 0x00,
+    0x0E, 0x24, 0x01, 0x01, 0x41, 0x00, 0x81, 0x00, 0x02, 0x03, 0x00, 0x00, 0x01, 0x00,
+    0x0B, 0x24, 0x06, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00,
+    0x1E, 0x24, 0x07, 0x01, 0x00, 0x80, 0x02, 0xE0, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01,
+    0x00, 0x60, 0x09, 0x00, 0x15, 0x16, 0x05, 0x00, 0x01, 0x15, 0x16, 0x05, 0x00,
+    0x0A, 0x24, 0x03, 0x82, 0x01, 0x80, 0x02, 0xE0, 0x01, 0x00,
+    0x07, 0x05, 0x82, 0x02, 0x00, 0x02, 0x00,
+    0x09, 0x04, 0x01, 0x01, 0x01, 0x0E, 0x02, 0x00, 0x00,
+    0x07, 0x05, 0x81, 0x05, 0x00, 0x02, 0x01,
+};
+
+// Bulk camera with still image capture method 3: the still image endpoint 0x81 is listed before the video endpoint 0x82
+static const uint8_t bulk_method3_cfg_desc[] = {
+    0x09, 0x02, 0x92, 0x00, 0x02, 0x01, 0x00, 0x80, 0xFA,
+    0x09, 0x04, 0x00, 0x00, 0x00, 0x0E, 0x01, 0x00, 0x00,
+    0x0D, 0x24, 0x01, 0x00, 0x01, 0x28, 0x00, 0x00, 0x6C, 0xDC, 0x02, 0x01, 0x01,
+    0x12, 0x24, 0x02, 0x01, 0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+    0x09, 0x24, 0x03, 0x02, 0x01, 0x01, 0x00, 0x01, 0x00,
+    0x09, 0x04, 0x01, 0x00, 0x02, 0x0E, 0x02, 0x00, 0x00,
+    0x0E, 0x24, 0x01, 0x01, 0x41, 0x00, 0x82, 0x00, 0x02, 0x03, 0x00, 0x00, 0x01, 0x00,
+    0x0B, 0x24, 0x06, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00,
+    0x1E, 0x24, 0x07, 0x01, 0x00, 0x80, 0x02, 0xE0, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01,
+    0x00, 0x60, 0x09, 0x00, 0x15, 0x16, 0x05, 0x00, 0x01, 0x15, 0x16, 0x05, 0x00,
+    0x0A, 0x24, 0x03, 0x81, 0x01, 0x80, 0x02, 0xE0, 0x01, 0x00,
+    0x07, 0x05, 0x81, 0x02, 0x00, 0x02, 0x00,
+    0x07, 0x05, 0x82, 0x02, 0x00, 0x02, 0x00,
+};
+
+static void require_method3_endpoints(const uint8_t *cfg_desc, uint8_t video_ep, uint8_t video_alt, uint8_t still_ep)
+{
+    const uvc_host_stream_format_t format = {640, 480, 30, UVC_VS_FORMAT_MJPEG};
+    uvc_desc_index_t *index = nullptr;
+    REQUIRE(ESP_OK == uvc_desc_index_build((const usb_config_desc_t *)cfg_desc, &index));
+    const uvc_desc_index_intf_t *vs_intf = nullptr;
+    REQUIRE(ESP_OK == uvc_desc_index_get_streaming_intf(index, 0, &format, &vs_intf));
+    REQUIRE(vs_intf->bInterfaceNumber == 1);
+    REQUIRE(vs_intf->bStillCaptureMethod == 3);
+
+    // Still image endpoint is taken from bEndpointAddress of Still Image Frame descriptor
+    REQUIRE(vs_intf->still_ep_desc != nullptr);
+    REQUIRE(vs_intf->still_ep_desc->bEndpointAddress == still_ep);
+    REQUIRE(USB_EP_DESC_GET_XFERTYPE(vs_intf->still_ep_desc) == USB_BM_ATTRIBUTES_XFER_BULK);
+
+    // The still image endpoint is never selected for video
+    const usb_intf_desc_t *intf_desc = nullptr;
+    const usb_ep_desc_t *ep_desc = nullptr;
+    REQUIRE(ESP_OK == uvc_desc_index_get_intf_and_ep_by_bandwidth(index, 1, 512, 4096, UINT32_MAX, true, &intf_desc, &ep_desc));
+    REQUIRE(intf_desc->bAlternateSetting == video_alt);
+    REQUIRE(ep_desc->bEndpointAddress == video_ep);
+    uvc_desc_index_free(index);
+}
+
+SCENARIO("Camera descriptor parsing: Still image capture method 3", "[still][single]")
+{
+    GIVEN("ISOC camera with Bulk still image endpoint in alternate setting 0") {
+        require_method3_endpoints(isoc_method3_cfg_desc, 0x81, 1, 0x82);
+    }
+
+    GIVEN("Bulk camera with still image endpoint listed before the video endpoint") {
+        require_method3_endpoints(bulk_method3_cfg_desc, 0x82, 0, 0x81);
+    }
+}
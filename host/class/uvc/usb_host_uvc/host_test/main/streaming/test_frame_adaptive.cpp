@@ -0,0 +1,112 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "usb/uvc_host.h"
+#include "uvc_types_priv.h"
+#include "uvc_frame_priv.h"
+
+/**
+ * @brief Receive a frame of given size in packets of 1000 bytes and end it
+ *
+ * @return Frame owned by the caller, must be returned with uvc_host_frame_return()
+ */
+static uvc_host_frame_t *receive_frame(uvc_stream_t *stream, const std::vector<uint8_t> &data, size_t frame_len)
+{
+    uvc_host_frame_t *frame = uvc_frame_get_empty(stream);
+    REQUIRE(frame != nullptr);
+    for (size_t offset = 0; offset < frame_len; offset += 1000) {
+        const size_t len = std::min<size_t>(1000, frame_len - offset);
+        REQUIRE(ESP_OK == uvc_frame_add_urb_data(stream, frame, nullptr, data.data() + offset, len));
+    }
+    REQUIRE(ESP_OK == uvc_frame_adaptive_end(stream, frame));
+    return frame;
+}
+
+SCENARIO("Adaptive frame buffer size", "[frame_adaptive]")
+{
+    constexpr size_t initial_size = 8 * 1024;
+    constexpr size_t max_size = 64 * 1024;
+    std::vector<uint8_t> data(max_size + 1);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = i * 7 + (i >> 8);
+    }
+
+    uvc_stream_t stream = {};
+    stream.constant.adaptive.enabled = true;
+    stream.constant.adaptive.percentile = 95;
+    stream.constant.adaptive.headroom_percent = 25;
+    uvc_frame_adaptive_set_max_size(&stream, max_size);
+    REQUIRE(ESP_OK == uvc_frame_allocate(&stream, 2, initial_size, 0));
+
+    GIVEN("Frame larger than its frame buffer") {
+        uvc_host_frame_t *frame = receive_frame(&stream, data, 20000);
+
+        THEN("The frame buffer grows and holds the whole frame") {
+            REQUIRE(frame->data_len == 20000);
+            REQUIRE(frame->data_buffer_len >= 20000 * 125 / 100);
+            REQUIRE(std::equal(data.begin(), data.begin() + 20000, frame->data));
+            REQUIRE(stream.stats.counters.frames_extended == 1);
+            REQUIRE(ESP_OK == uvc_host_frame_return(&stream, frame));
+        }
+
+        WHEN("The other frame buffer is taken") {
+            REQUIRE(ESP_OK == uvc_host_frame_return(&stream, frame));
+            uvc_host_frame_t *first = uvc_frame_get_empty(&stream); // The grown buffer
+            uvc_host_frame_t *second = uvc_frame_get_empty(&stream);
+            REQUIRE(second != nullptr);
+
+            THEN("It is resized to the size of recent frames") {
+                REQUIRE(second->data_buffer_len == first->data_buffer_len);
+                REQUIRE(stream.stats.counters.frame_buffers_resized == 1);
+            }
+            REQUIRE(ESP_OK == uvc_host_frame_return(&stream, first));
+            REQUIRE(ESP_OK == uvc_host_frame_return(&stream, second));
+        }
+
+        WHEN("Frames get much smaller") {
+            REQUIRE(ESP_OK == uvc_host_frame_return(&stream, frame));
+            for (int i = 0; i < UVC_FRAME_SIZE_HISTORY; i++) {
+                REQUIRE(ESP_OK == uvc_host_frame_return(&stream, receive_frame(&stream, data, 1000)));
+            }
+
+            THEN("Frame buffers shrink") {
+                for (unsigned i = 0; i < stream.constant.num_of_frames; i++) {
+                    REQUIRE(stream.constant.frames[i]->data_buffer_len <= initial_size);
+                }
+            }
+        }
+    }
+
+    GIVEN("Occasional large frame") {
+        for (int i = 0; i < UVC_FRAME_SIZE_HISTORY - 1; i++) {
+            REQUIRE(ESP_OK == uvc_host_frame_return(&stream, receive_frame(&stream, data, 4000)));
+        }
+        uvc_host_frame_t *frame = receive_frame(&stream, data, 30000);
+
+        THEN("The large frame is delivered, but the target follows the percentile") {
+            REQUIRE(std::equal(data.begin(), data.begin() + 30000, frame->data));
+            REQUIRE(stream.single_thread.frame_size.target < 30000);
+        }
+        REQUIRE(ESP_OK == uvc_host_frame_return(&stream, frame));
+    }
+
+    GIVEN("Frame larger than maximum frame size") {
+        uvc_host_frame_t *frame = uvc_frame_get_empty(&stream);
+        REQUIRE(frame != nullptr);
+        REQUIRE(ESP_OK == uvc_frame_add_urb_data(&stream, frame, nullptr, data.data(), max_size));
+
+        THEN("Data beyond maximum frame size are rejected") {
+            REQUIRE(ESP_ERR_INVALID_SIZE == uvc_frame_add_urb_data(&stream, frame, nullptr, data.data(), 1));
+        }
+        REQUIRE(ESP_OK == uvc_host_frame_return(&stream, frame)); // Extension chunks are freed
+    }
+
+    REQUIRE(uvc_frame_are_all_returned(&stream));
+    uvc_frame_free(&stream);
+}
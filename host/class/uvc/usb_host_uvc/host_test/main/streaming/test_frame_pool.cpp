@@ -0,0 +1,111 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "usb/uvc_host.h"
+#include "uvc_types_priv.h"
+#include "uvc_frame_priv.h"
+#include "uvc_frame_pool_priv.h"
+
+SCENARIO("Shared frame buffer pool", "[frame_pool]")
+{
+    constexpr size_t buffer_size = 1024;
+    const uvc_host_frame_pool_config_t pool_config = {
+        .number_of_buffers = 4,
+        .buffer_size = buffer_size,
+        .buffer_heap_caps = 0,
+    };
+    uvc_host_frame_pool_hdl_t pool = nullptr;
+    REQUIRE(ESP_OK == uvc_host_frame_pool_create(&pool_config, &pool));
+
+    // Stream A reserves 2 buffers and can hold up to 4 frames, stream B reserves 1 buffer and can hold up to 2 frames
+    uvc_stream_t stream_a = {};
+    uvc_stream_t stream_b = {};
+    REQUIRE(ESP_OK == uvc_frame_pool_attach(pool, &stream_a, 2));
+    REQUIRE(ESP_OK == uvc_frame_allocate(&stream_a, 4, 0, 0));
+    REQUIRE(ESP_OK == uvc_frame_pool_attach(pool, &stream_b, 1));
+    REQUIRE(ESP_OK == uvc_frame_allocate(&stream_b, 2, 0, 0));
+
+    GIVEN("Reservations of attached streams") {
+        uvc_stream_t stream_c = {};
+        THEN("Pool cannot be over-reserved") {
+            REQUIRE(ESP_ERR_NO_MEM == uvc_frame_pool_attach(pool, &stream_c, 2));
+        }
+        THEN("Pool with attached streams cannot be deleted") {
+            REQUIRE(ESP_ERR_INVALID_STATE == uvc_host_frame_pool_delete(pool));
+        }
+    }
+
+    GIVEN("Frames taken by stream A") {
+        uvc_host_frame_t *a_frames[3];
+        for (auto &frame : a_frames) {
+            frame = uvc_frame_get_empty(&stream_a);
+            REQUIRE(frame != nullptr);
+            REQUIRE(frame->data != nullptr);
+            REQUIRE(frame->data_buffer_len == buffer_size);
+        }
+
+        THEN("Reservation of stream B is kept") {
+            REQUIRE(uvc_frame_get_empty(&stream_a) == nullptr); // The last free buffer is reserved for stream B
+            uvc_host_frame_t *b_frame = uvc_frame_get_empty(&stream_b);
+            REQUIRE(b_frame != nullptr);
+            REQUIRE(uvc_frame_get_empty(&stream_b) == nullptr); // Pool is empty
+            REQUIRE(ESP_OK == uvc_host_frame_return(&stream_b, b_frame));
+            for (auto &frame : a_frames) {
+                REQUIRE(ESP_OK == uvc_host_frame_return(&stream_a, frame));
+            }
+        }
+
+        WHEN("Frames are returned") {
+            for (auto &frame : a_frames) {
+                REQUIRE(ESP_OK == uvc_host_frame_return(&stream_a, frame));
+                REQUIRE(frame->data == nullptr);
+            }
+            THEN("Stream B can take the shared buffers") {
+                uvc_host_frame_t *b_frames[2];
+                for (auto &frame : b_frames) {
+                    frame = uvc_frame_get_empty(&stream_b);
+                    REQUIRE(frame != nullptr);
+                }
+                REQUIRE(uvc_frame_get_empty(&stream_b) == nullptr); // Stream B has only 2 frames
+                for (auto &frame : b_frames) {
+                    REQUIRE(ESP_OK == uvc_host_frame_return(&stream_b, frame));
+                }
+            }
+            REQUIRE(uvc_frame_are_all_returned(&stream_a));
+        }
+    }
+
+    GIVEN("Frame returned twice") {
+        uvc_host_frame_t *frame = uvc_frame_get_empty(&stream_a);
+        REQUIRE(frame != nullptr);
+        REQUIRE(ESP_OK == uvc_host_frame_return(&stream_a, frame));
+        REQUIRE(ESP_FAIL == uvc_host_frame_return(&stream_a, frame));
+
+        THEN("Its buffer is given back to the pool only once") {
+            uvc_host_frame_t *a_frames[3];
+            for (auto &a_frame : a_frames) {
+                a_frame = uvc_frame_get_empty(&stream_a);
+                REQUIRE(a_frame != nullptr);
+            }
+            uvc_host_frame_t *b_frame = uvc_frame_get_empty(&stream_b);
+            REQUIRE(b_frame != nullptr);
+            REQUIRE(uvc_frame_get_empty(&stream_b) == nullptr); // Pool is empty
+            REQUIRE(ESP_OK == uvc_host_frame_return(&stream_b, b_frame));
+            for (auto &a_frame : a_frames) {
+                REQUIRE(ESP_OK == uvc_host_frame_return(&stream_a, a_frame));
+            }
+        }
+    }
+
+    REQUIRE(uvc_frame_are_all_returned(&stream_b));
+    uvc_frame_free(&stream_a);
+    uvc_frame_pool_detach(&stream_a);
+    uvc_frame_free(&stream_b);
+    uvc_frame_pool_detach(&stream_b);
+    REQUIRE(ESP_OK == uvc_host_frame_pool_delete(pool));
+}
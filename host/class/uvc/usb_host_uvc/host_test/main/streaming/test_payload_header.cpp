@@ -0,0 +1,64 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "usb/uvc_host.h"
+#include "uvc_payload_priv.h"
+
+SCENARIO("Payload header timestamps parsing", "[streaming][header]")
+{
+    uvc_host_frame_timestamp_t timestamp = {};
+
+    GIVEN("Payload header with PTS and SCR") {
+        const uint8_t header[] = {
+            12,                     // bHeaderLength
+            0x8C,                   // bmHeaderInfo: EoH, SCR, PTS
+            0x78, 0x56, 0x34, 0x12, // dwPresentationTime
+            0x21, 0x43, 0x65, 0x87, // SCR: Source Time Clock
+            0xFF, 0xFF,             // SCR: 1kHz SOF counter, only 11 bits are valid
+        };
+        uvc_payload_header_get_timestamps(reinterpret_cast<const uvc_payload_header_t *>(header), &timestamp);
+
+        THEN("PTS and SCR are parsed") {
+            REQUIRE(timestamp.pts_valid);
+            REQUIRE(timestamp.pts == 0x12345678);
+            REQUIRE(timestamp.scr_valid);
+            REQUIRE(timestamp.scr_stc == 0x87654321);
+            REQUIRE(timestamp.scr_sof == 0x07FF);
+        }
+    }
+
+    GIVEN("Payload header with SCR only") {
+        const uint8_t header[] = {
+            8,                      // bHeaderLength
+            0x88,                   // bmHeaderInfo: EoH, SCR
+            0x21, 0x43, 0x65, 0x87, // SCR: Source Time Clock
+            0x34, 0x02,             // SCR: 1kHz SOF counter
+        };
+        uvc_payload_header_get_timestamps(reinterpret_cast<const uvc_payload_header_t *>(header), &timestamp);
+
+        THEN("Only SCR is parsed") {
+            REQUIRE_FALSE(timestamp.pts_valid);
+            REQUIRE(timestamp.scr_valid);
+            REQUIRE(timestamp.scr_stc == 0x87654321);
+            REQUIRE(timestamp.scr_sof == 0x0234);
+        }
+    }
+
+    GIVEN("Payload header with PTS flag but too short") {
+        const uint8_t header[] = {
+            2,    // bHeaderLength
+            0x84, // bmHeaderInfo: EoH, PTS
+        };
+        uvc_payload_header_get_timestamps(reinterpret_cast<const uvc_payload_header_t *>(header), &timestamp);
+
+        THEN("Nothing is parsed") {
+            REQUIRE_FALSE(timestamp.pts_valid);
+            REQUIRE_FALSE(timestamp.scr_valid);
+        }
+    }
+}
@@ -5,6 +5,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <functional>
 #include <catch2/catch_test_macros.hpp>
 
@@ -81,6 +82,9 @@ void run_streaming_frame_reconstruction_scenario(void)
                 REQUIRE(frame->vs_format.v_res == stream.constant.vs_format.v_res);
                 REQUIRE(frame->vs_format.fps == stream.constant.vs_format.fps);
                 REQUIRE(frame->vs_format.format == stream.constant.vs_format.format);
+                REQUIRE(frame->timestamp.host_eof_us >= frame->timestamp.host_sof_us);
+                REQUIRE_FALSE(frame->timestamp.pts_valid); // Test headers do not contain PTS nor SCR
+                REQUIRE_FALSE(frame->timestamp.scr_valid);
 
                 std::vector<uint8_t> frame_data(frame->data, frame->data + frame->data_len);
                 std::vector<uint8_t> original_data(logo_jpg.begin(), logo_jpg.end());
@@ -100,6 +104,15 @@ void run_streaming_frame_reconstruction_scenario(void)
                         REQUIRE(frame_callback_called == 1);
                     }
 
+                    THEN("The frame is accounted in statistics") {
+                        uvc_host_stream_stats_t stats;
+                        REQUIRE(uvc_host_stream_get_stats(&stream, &stats) == ESP_OK);
+                        REQUIRE(stats.frames_delivered == 1);
+                        REQUIRE(stats.bytes_received == logo_jpg.size());
+                        REQUIRE(stats.frames_dropped.header_error == 0);
+                        REQUIRE(stats.frames_dropped.missing_eof == 0);
+                    }
+
                     AND_WHEN("Next frame is send") {
                         send_function_wrapper(transfer_size, &stream, std::span(logo_jpg), 1);
 
@@ -146,6 +159,13 @@ void run_streaming_frame_reconstruction_scenario(void)
                     REQUIRE(frame_callback_called == 0);
                 }
 
+                THEN("The frame is accounted as dropped only once") {
+                    uvc_host_stream_stats_t stats;
+                    REQUIRE(uvc_host_stream_get_stats(&stream, &stats) == ESP_OK);
+                    REQUIRE(stats.frames_delivered == 0);
+                    REQUIRE(stats.frames_dropped.header_error == 1);
+                }
+
                 AND_WHEN("Next frame is send") {
                     send_function_wrapper(1024, &stream, std::span(logo_jpg), 1);
 
@@ -173,6 +193,12 @@ void run_streaming_frame_reconstruction_scenario(void)
                 THEN("Buffer overflow event is generated") {
                     REQUIRE(event_type == UVC_HOST_FRAME_BUFFER_OVERFLOW);
                 }
+
+                THEN("The frame is accounted as dropped") {
+                    uvc_host_stream_stats_t stats;
+                    REQUIRE(uvc_host_stream_get_stats(&stream, &stats) == ESP_OK);
+                    REQUIRE(stats.frames_dropped.buffer_overflow == 1);
+                }
             }
 
             REQUIRE(uvc_frame_are_all_returned(&stream));
@@ -198,12 +224,206 @@ void run_streaming_frame_reconstruction_scenario(void)
                     REQUIRE(event_type == UVC_HOST_FRAME_BUFFER_UNDERFLOW);
                     REQUIRE_FALSE(uvc_frame_are_all_returned(&stream));
                 }
+
+                THEN("The frame is accounted as dropped") {
+                    uvc_host_stream_stats_t stats;
+                    REQUIRE(uvc_host_stream_get_stats(&stream, &stats) == ESP_OK);
+                    REQUIRE(stats.frames_dropped.buffer_underflow == 1);
+                }
             }
 
             REQUIRE(uvc_host_frame_return(&stream, temp_frame) == ESP_OK);
             REQUIRE(uvc_frame_are_all_returned(&stream));
             uvc_frame_free(&stream);
         }
+
+        AND_GIVEN("MJPEG validation is enabled") {
+            int frame_callback_called = 0;
+            frame_callback = [&](const uvc_host_frame_t *frame, void *user_ctx) -> bool {
+                frame_callback_called++;
+                REQUIRE(frame->data_len == logo_jpg.size());
+                return true;
+            };
+            stream.constant.mjpeg_validation = true;
+            REQUIRE(uvc_frame_allocate(&stream, 1, 100 * 1024, 0) == ESP_OK);
+
+            WHEN("The frame starts with SOI and ends with EOI") {
+                send_function_wrapper(1024, &stream, std::span(logo_jpg));
+                THEN("The frame callback is called") {
+                    REQUIRE(frame_callback_called == 1);
+                }
+            }
+
+            WHEN("The frame is padded after EOI") {
+                // Padding bytes may follow the EOI marker, e.g. to fill the last packet of the frame
+                std::vector<uint8_t> padded_jpg(logo_jpg.begin(), logo_jpg.end());
+                padded_jpg.insert(padded_jpg.end(), {0x00, 0x00, 0xFF, 0xFF, 0x00});
+                frame_callback = [&](const uvc_host_frame_t *frame, void *user_ctx) -> bool {
+                    frame_callback_called++;
+                    REQUIRE(frame->data_len == padded_jpg.size());
+                    return true;
+                };
+                send_function_wrapper(1024, &stream, std::span(padded_jpg));
+                THEN("The frame callback is called") {
+                    REQUIRE(frame_callback_called == 1);
+                }
+            }
+
+            WHEN("The frame is truncated") {
+                send_function_wrapper(1024, &stream, std::span(logo_jpg).first(logo_jpg.size() - 100));
+                THEN("The frame callback is not called") {
+                    REQUIRE(frame_callback_called == 0);
+                }
+
+                THEN("The frame is accounted as dropped") {
+                    uvc_host_stream_stats_t stats;
+                    REQUIRE(uvc_host_stream_get_stats(&stream, &stats) == ESP_OK);
+                    REQUIRE(stats.frames_dropped.mjpeg_invalid == 1);
+                }
+
+                AND_WHEN("Next frame is send") {
+                    send_function_wrapper(1024, &stream, std::span(logo_jpg), 1);
+
+                    THEN("The frame callback is called") {
+                        REQUIRE(frame_callback_called == 1);
+                    }
+                }
+            }
+
+            WHEN("The frame does not start with SOI") {
+                send_function_wrapper(1024, &stream, std::span(logo_jpg).subspan(100));
+                THEN("The frame is accounted as dropped") {
+                    uvc_host_stream_stats_t stats;
+                    REQUIRE(uvc_host_stream_get_stats(&stream, &stats) == ESP_OK);
+                    REQUIRE(frame_callback_called == 0);
+                    REQUIRE(stats.frames_dropped.mjpeg_invalid == 1);
+                }
+            }
+
+            REQUIRE(uvc_frame_are_all_returned(&stream));
+            uvc_frame_free(&stream);
+        }
+
+        AND_GIVEN("Frame decimation is set to 3") {
+            int frame_callback_called = 0;
+            frame_callback = [&](const uvc_host_frame_t *frame, void *user_ctx) -> bool {
+                frame_callback_called++;
+                REQUIRE(frame->data_len == logo_jpg.size());
+                return true;
+            };
+            stream.constant.frame_decimation = 3;
+            REQUIRE(uvc_frame_allocate(&stream, 1, 100 * 1024, 0) == ESP_OK);
+
+            WHEN("7 frames are send") {
+                for (int i = 0; i < 7; i++) {
+                    send_function_wrapper(1024, &stream, std::span(logo_jpg), i % 2);
+                }
+                THEN("Only 1st, 4th and 7th frame are delivered") {
+                    REQUIRE(frame_callback_called == 3);
+                }
+
+                THEN("Discarded frames are not accounted as dropped") {
+                    uvc_host_stream_stats_t stats;
+                    REQUIRE(uvc_host_stream_get_stats(&stream, &stats) == ESP_OK);
+                    REQUIRE(stats.frames_delivered == 3);
+                    REQUIRE(stats.frames_dropped.header_error == 0);
+                    REQUIRE(stats.frames_dropped.buffer_underflow == 0);
+                }
+            }
+
+            REQUIRE(uvc_frame_are_all_returned(&stream));
+            uvc_frame_free(&stream);
+        }
+
+        AND_GIVEN("H.264 stream with keyframe filter") {
+            // SPS + IDR slice and non-IDR slice, with Annex B start codes
+            std::vector<uint8_t> keyframe = {0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x1F, 0x00, 0x00, 0x00, 0x01, 0x65, 0x88};
+            std::vector<uint8_t> non_keyframe = {0x00, 0x00, 0x00, 0x01, 0x41, 0x9A};
+            keyframe.resize(3000, 0xAA);
+            non_keyframe.resize(3000, 0xAA);
+
+            std::vector<size_t> delivered_lengths;
+            frame_callback = [&](const uvc_host_frame_t *frame, void *user_ctx) -> bool {
+                delivered_lengths.push_back(frame->data_len);
+                REQUIRE(frame->data[4] == 0x67);
+                return true;
+            };
+            stream.constant.vs_format.format = UVC_VS_FORMAT_H264;
+            stream.constant.keyframes_only = true;
+            REQUIRE(uvc_frame_allocate(&stream, 1, 100 * 1024, 0) == ESP_OK);
+
+            WHEN("Keyframe and non-keyframes are send") {
+                send_function_wrapper(1024, &stream, std::span(non_keyframe), 0);
+                send_function_wrapper(1024, &stream, std::span(keyframe), 1);
+                send_function_wrapper(1024, &stream, std::span(non_keyframe), 0);
+
+                THEN("Only the keyframe is delivered") {
+                    REQUIRE(delivered_lengths.size() == 1);
+                    REQUIRE(delivered_lengths[0] == keyframe.size());
+                }
+            }
+
+            REQUIRE(uvc_frame_are_all_returned(&stream));
+            uvc_frame_free(&stream);
+        }
+
+        AND_GIVEN("H.264 stream with NAL index") {
+            // SPS with 4-byte start code, PPS with 3-byte start code and IDR slice followed by trailing zero bytes
+            std::vector<uint8_t> frame_data = {0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x1F, 0x00, 0x00, 0x01, 0x68, 0xCE, 0x3C};
+            std::vector<uint8_t> idr_start = {0x00, 0x00, 0x00, 0x01, 0x65};
+            frame_data.insert(frame_data.end(), idr_start.begin(), idr_start.end());
+            frame_data.resize(frame_data.size() + 100, 0xAA);
+            frame_data.resize(frame_data.size() + 2, 0x00);
+
+            std::vector<uvc_host_nal_unit_t> nal_units;
+            frame_callback = [&](const uvc_host_frame_t *frame, void *user_ctx) -> bool {
+                REQUIRE(frame->data_len == frame_data.size());
+                nal_units.assign(frame->nal_units, frame->nal_units + frame->num_nal_units);
+                return true;
+            };
+            stream.constant.vs_format.format = UVC_VS_FORMAT_H264;
+
+            WHEN("All NAL units fit in the index") {
+                stream.constant.nal_index_size = 4;
+                REQUIRE(uvc_frame_allocate(&stream, 1, 100 * 1024, 0) == ESP_OK);
+
+                // Small ISOC transfers split the start codes between packets
+                uint8_t frame_id = 0;
+                for (size_t transfer_size : {1024, 104, 112}) {
+                    nal_units.clear();
+                    send_function_wrapper(transfer_size, &stream, std::span(frame_data), frame_id++ % 2);
+
+                    THEN("NAL units are indexed with transfer size " + std::to_string(transfer_size)) {
+                        REQUIRE(nal_units.size() == 3);
+                        REQUIRE(nal_units[0].offset == 4);
+                        REQUIRE(nal_units[0].len == 4);
+                        REQUIRE(nal_units[0].type == 7);
+                        REQUIRE(nal_units[1].offset == 11);
+                        REQUIRE(nal_units[1].len == 3);
+                        REQUIRE(nal_units[1].type == 8);
+                        REQUIRE(nal_units[2].offset == 18);
+                        REQUIRE(nal_units[2].len == 101);
+                        REQUIRE(nal_units[2].type == 5);
+                    }
+                }
+            }
+
+            WHEN("The index is too small") {
+                stream.constant.nal_index_size = 2;
+                REQUIRE(uvc_frame_allocate(&stream, 1, 100 * 1024, 0) == ESP_OK);
+                send_function_wrapper(1024, &stream, std::span(frame_data));
+
+                THEN("Only the first NAL units are indexed") {
+                    REQUIRE(nal_units.size() == 2);
+                    REQUIRE(nal_units[1].offset == 11);
+                    REQUIRE(nal_units[1].len == 3);
+                    REQUIRE(nal_units[1].offset + nal_units[1].len < frame_data.size());
+                }
+            }
+
+            REQUIRE(uvc_frame_are_all_returned(&stream));
+            uvc_frame_free(&stream);
+        }
     }
 
     GIVEN("Streaming disabled") {
@@ -238,6 +458,141 @@ void run_streaming_frame_reconstruction_scenario(void)
     */
 }
 
+std::function<void(const uvc_host_frame_slice_t *, void *)> slice_callback; // Define a std::function to hold the lambda with captures
+
+void run_streaming_slice_scenario(void)
+{
+    constexpr int user_arg = 0x12345678;
+    uvc_stream_t stream = {}; // Define mock stream
+    stream.constant.cb_arg = (void *)&user_arg;
+    stream.single_thread.current_frame_id = 2; // Start with invalid frame ID
+    stream.dynamic.streaming = true;
+    stream.constant.slice_cb = [](const uvc_host_frame_slice_t *slice, void *user_ctx) {
+        return slice_callback(slice, user_ctx);
+    };
+
+    GIVEN("Slice buffer smaller than the frame") {
+        constexpr size_t slice_size = 1000;
+        std::vector<uint8_t> received_data;
+        int start_of_frame_count = 0;
+        int end_of_frame_count = 0;
+        bool frame_error = false;
+        slice_callback = [&](const uvc_host_frame_slice_t *slice, void *user_ctx) {
+            REQUIRE(user_ctx == stream.constant.cb_arg); // Sanity check
+            REQUIRE(slice->data_len <= slice_size);
+            if (slice->start_of_frame) {
+                start_of_frame_count++;
+                received_data.clear();
+            }
+            if (slice->end_of_frame) {
+                end_of_frame_count++;
+                frame_error = slice->frame_error;
+            }
+            received_data.insert(received_data.end(), slice->data, slice->data + slice->data_len);
+        };
+        REQUIRE(uvc_frame_allocate(&stream, 1, slice_size, 0) == ESP_OK);
+
+        WHEN("The frame data contain no errors") {
+            send_function_wrapper(1024, &stream, std::span(logo_jpg));
+
+            THEN("The frame is delivered in slices") {
+                std::vector<uint8_t> original_data(logo_jpg.begin(), logo_jpg.end());
+                REQUIRE(start_of_frame_count == 1);
+                REQUIRE(end_of_frame_count == 1);
+                REQUIRE_FALSE(frame_error);
+                REQUIRE(received_data == original_data);
+            }
+        }
+
+        WHEN("The frame contains error in SoF") {
+            send_function_wrapper(1024, &stream, std::span(logo_jpg), 0, true);
+
+            THEN("The last slice reports frame error") {
+                REQUIRE(end_of_frame_count == 1);
+                REQUIRE(frame_error);
+            }
+        }
+
+        REQUIRE(uvc_frame_are_all_returned(&stream));
+        uvc_frame_free(&stream);
+    }
+}
+
+void run_streaming_bulk_payload_scenario(void)
+{
+    constexpr int user_arg = 0x12345678;
+    uvc_stream_t stream = {}; // Define mock stream
+    stream.constant.cb_arg = (void *)&user_arg;
+    stream.single_thread.current_frame_id = 2; // Start with invalid frame ID
+    stream.dynamic.streaming = true;
+    stream.constant.frame_cb = [](const uvc_host_frame_t *frame, void *user_ctx) -> bool {
+        return frame_callback(frame, user_ctx);
+    };
+    stream_callback = [&](const uvc_host_stream_event_data_t *event, void *user_ctx) {
+        FAIL("Unexpected event " + std::to_string(event->type));
+    };
+
+    std::span<const uint8_t> expected_data;
+    int frame_callback_called = 0;
+    frame_callback = [&](const uvc_host_frame_t *frame, void *user_ctx) -> bool {
+        frame_callback_called++;
+        std::vector<uint8_t> frame_data(frame->data, frame->data + frame->data_len);
+        std::vector<uint8_t> original_data(expected_data.begin(), expected_data.end());
+        REQUIRE(frame_data == original_data);
+        return true;
+    };
+    REQUIRE(uvc_frame_allocate(&stream, 1, 100 * 1024, 0) == ESP_OK);
+
+    GIVEN("Device sends one header per frame") {
+        for (size_t transfer_size = 512; transfer_size <= 2048; transfer_size += 512) {
+            WHEN("Last data packet is aligned to transfer size, transfer_size = " + std::to_string(transfer_size)) {
+                // No zero-length packet is sent between the last data packet and EoF header
+                expected_data = std::span(logo_jpg).first(3 * transfer_size - HEADER_LEN);
+                test_streaming_bulk_send_frame(transfer_size, &stream, expected_data);
+
+                THEN("The frame callback is called with expected frame data") {
+                    REQUIRE(frame_callback_called == 1);
+                }
+
+                AND_WHEN("Next frame is send") {
+                    test_streaming_bulk_send_frame(transfer_size, &stream, expected_data, 1);
+
+                    THEN("The frame callback is called with expected frame data") {
+                        REQUIRE(frame_callback_called == 2);
+                    }
+                }
+            }
+        }
+    }
+
+    GIVEN("Device sends header in every payload") {
+        constexpr size_t payload_size = 2048;
+        stream.constant.dwMaxPayloadTransferSize = payload_size;
+        expected_data = std::span(logo_jpg);
+
+        for (size_t transfer_size = 512; transfer_size <= 8192; transfer_size += 512) {
+            WHEN("Payloads are sent without zero-length packets, transfer_size = " + std::to_string(transfer_size)) {
+                test_streaming_bulk_send_frame_per_payload(transfer_size, &stream, expected_data, payload_size);
+
+                THEN("The frame callback is called with expected frame data") {
+                    REQUIRE(frame_callback_called == 1);
+                }
+
+                AND_WHEN("Next frame is send") {
+                    test_streaming_bulk_send_frame_per_payload(transfer_size, &stream, expected_data, payload_size, 1);
+
+                    THEN("The frame callback is called with expected frame data") {
+                        REQUIRE(frame_callback_called == 2);
+                    }
+                }
+            }
+        }
+    }
+
+    REQUIRE(uvc_frame_are_all_returned(&stream));
+    uvc_frame_free(&stream);
+}
+
 SCENARIO("Bulk stream frame reconstruction", "[streaming][bulk]")
 {
     send_frame_function = test_streaming_bulk_send_frame;
@@ -258,3 +613,425 @@ SCENARIO("Isochronous stream frame reconstruction", "[streaming][isoc]")
     - Unaligned USB transfer sizes
     */
 }
+
+SCENARIO("Bulk stream slice delivery", "[streaming][bulk]")
+{
+    send_frame_function = test_streaming_bulk_send_frame;
+    run_streaming_slice_scenario();
+}
+
+SCENARIO("Isochronous stream slice delivery", "[streaming][isoc]")
+{
+    send_frame_function = test_streaming_isoc_send_frame;
+    run_streaming_slice_scenario();
+}
+
+SCENARIO("Isochronous stream fast pause", "[streaming][isoc]")
+{
+    uvc_stream_t stream = {}; // Define mock stream
+    stream.constant.bAlternateSetting = 1; // ISOC
+    stream.single_thread.current_frame_id = 2;
+    stream.dynamic.streaming = true;
+    stream.constant.vs_format.format = UVC_VS_FORMAT_MJPEG;
+    int frame_callback_called = 0;
+    stream.constant.cb_arg = &frame_callback_called;
+    stream.constant.frame_cb = [](const uvc_host_frame_t *frame, void *user_ctx) -> bool {
+        (*static_cast<int *>(user_ctx))++;
+        return true;
+    };
+    REQUIRE(uvc_frame_allocate(&stream, 1, 100 * 1024, 0) == ESP_OK);
+
+    GIVEN("Stream is fast paused") {
+        REQUIRE(uvc_host_stream_fast_pause(&stream) == ESP_OK);
+        test_streaming_isoc_send_frame(1024, &stream, std::span(logo_jpg), 0);
+
+        THEN("Received frames are dropped") {
+            REQUIRE(frame_callback_called == 0);
+            REQUIRE(uvc_frame_are_all_returned(&stream));
+        }
+
+        AND_WHEN("Stream is unpaused during a frame") {
+            REQUIRE(uvc_host_stream_fast_unpause(&stream) == ESP_OK);
+            test_streaming_isoc_send_frame(1024, &stream, std::span(logo_jpg), 0); // Rest of the frame in progress
+
+            THEN("The frame in progress is skipped, the next frame is delivered") {
+                REQUIRE(frame_callback_called == 0);
+                test_streaming_isoc_send_frame(1024, &stream, std::span(logo_jpg), 1);
+                REQUIRE(frame_callback_called == 1);
+            }
+        }
+    }
+
+    GIVEN("BULK stream") {
+        stream.constant.bAlternateSetting = 0;
+        THEN("Fast pause is not supported") {
+            REQUIRE(uvc_host_stream_fast_pause(&stream) == ESP_ERR_NOT_SUPPORTED);
+        }
+    }
+
+    GIVEN("Stream is not streaming") {
+        stream.dynamic.streaming = false;
+        THEN("Fast pause and unpause are rejected") {
+            REQUIRE(uvc_host_stream_fast_pause(&stream) == ESP_ERR_INVALID_STATE);
+            REQUIRE(uvc_host_stream_fast_unpause(&stream) == ESP_ERR_INVALID_STATE);
+        }
+    }
+
+    REQUIRE(uvc_frame_are_all_returned(&stream));
+    uvc_frame_free(&stream);
+}
+
+/**
+ * @brief ISOC packet of a hand-made URB
+ */
+struct isoc_packet {
+    usb_transfer_status_t status;
+    uint8_t frame_id;
+    bool end_of_frame;
+    bool error;
+    bool pts;         // Header contains PTS test_pts
+    size_t data_len;  // Payload data bytes, 0 for Zero Length Packet
+};
+
+constexpr uint32_t test_pts = 0x12345678;
+
+/**
+ * @brief Send one ISOC URB, payload data are taken from data at offset
+ */
+void send_isoc_urb(uvc_stream_t *stream, const std::vector<isoc_packet> &packets, std::span<const uint8_t> data, size_t &offset)
+{
+    constexpr size_t packet_size = 1024;
+    std::vector<uint8_t> data_buffer(packets.size() * packet_size);
+    usb_transfer_t *transfer = static_cast<usb_transfer_t *>(operator new (sizeof(usb_transfer_t) + packets.size() * sizeof(usb_isoc_packet_desc_t)));
+    new (transfer) usb_transfer_t{
+        .data_buffer = data_buffer.data(),
+        .data_buffer_size = data_buffer.size(),
+        .num_bytes = static_cast<int>(data_buffer.size()),
+        .actual_num_bytes = 0,
+        .flags = 0,
+        .device_handle = nullptr,
+        .bEndpointAddress = 0,
+        .status = USB_TRANSFER_STATUS_COMPLETED,
+        .timeout_ms = 0,
+        .callback = nullptr,
+        .context = stream,
+        .num_isoc_packets = static_cast<int>(packets.size()),
+    };
+
+    for (size_t i = 0; i < packets.size(); i++) {
+        const isoc_packet &packet = packets[i];
+        uint8_t *write_ptr = data_buffer.data() + i * packet_size;
+        transfer->isoc_packet_desc[i].num_bytes = packet_size;
+        transfer->isoc_packet_desc[i].status = packet.status;
+        transfer->isoc_packet_desc[i].actual_num_bytes = 0;
+        if (packet.status != USB_TRANSFER_STATUS_COMPLETED || (packet.data_len == 0 && !packet.end_of_frame)) {
+            continue; // Zero Length Packet
+        }
+        assert(packet.data_len <= packet_size - HEADER_LEN);
+        uvc_payload_header_t *header = reinterpret_cast<uvc_payload_header_t *>(write_ptr);
+        header->bHeaderLength = HEADER_LEN;
+        header->bmHeaderInfo.val = 0;
+        header->bmHeaderInfo.end_of_header = 1;
+        header->bmHeaderInfo.frame_id = packet.frame_id;
+        header->bmHeaderInfo.end_of_frame = packet.end_of_frame;
+        header->bmHeaderInfo.error = packet.error;
+        header->bmHeaderInfo.presentation_time = packet.pts;
+        if (packet.pts) {
+            memcpy(write_ptr + 2, &test_pts, sizeof(test_pts));
+        }
+        std::copy_n(data.begin() + offset, packet.data_len, write_ptr + HEADER_LEN);
+        offset += packet.data_len;
+        transfer->isoc_packet_desc[i].actual_num_bytes = HEADER_LEN + packet.data_len;
+    }
+
+    usb_host_transfer_submit_ExpectAndReturn(transfer, ESP_OK);
+    isoc_transfer_callback(transfer);
+    operator delete (transfer);
+}
+
+SCENARIO("Isochronous stream packet runs", "[streaming][isoc]")
+{
+    constexpr usb_transfer_status_t ok = USB_TRANSFER_STATUS_COMPLETED;
+    uvc_stream_t stream = {}; // Define mock stream
+    stream.single_thread.current_frame_id = 2;
+    stream.dynamic.streaming = true;
+    stream.constant.vs_format.format = UVC_VS_FORMAT_MJPEG;
+    static std::vector<std::vector<uint8_t>> frames;
+    static std::vector<uvc_host_frame_timestamp_t> timestamps;
+    frames.clear();
+    timestamps.clear();
+    stream.constant.frame_cb = [](const uvc_host_frame_t *frame, void *user_ctx) -> bool {
+        frames.emplace_back(frame->data, frame->data + frame->data_len);
+        timestamps.push_back(frame->timestamp);
+        return true;
+    };
+    REQUIRE(uvc_frame_allocate(&stream, 1, 100 * 1024, 0) == ESP_OK);
+    const std::span<const uint8_t> data(logo_jpg);
+    size_t offset = 0;
+    uvc_host_stream_stats_t stats;
+
+    WHEN("The frame contains Zero Length Packets and skipped packets") {
+        send_isoc_urb(&stream, {
+            {ok, 0, false, false, false, 500},
+            {ok, 0, false, false, false, 0},
+            {ok, 0, false, false, false, 500},
+            {USB_TRANSFER_STATUS_SKIPPED, 0, false, false, false, 0},
+            {ok, 0, false, false, false, 500},
+            {ok, 0, true, false, false, 100},
+            {ok, 0, false, false, false, 0},
+        }, data, offset);
+
+        THEN("The frame is delivered with all its data in order") {
+            REQUIRE(frames.size() == 1);
+            REQUIRE(frames[0] == std::vector<uint8_t>(data.begin(), data.begin() + 1600));
+            REQUIRE(uvc_host_stream_get_stats(&stream, &stats) == ESP_OK);
+            REQUIRE(stats.isoc_packets_skipped == 1);
+            REQUIRE(stats.bytes_received == 1600);
+        }
+    }
+
+    WHEN("A packet in the middle of the frame has USB error") {
+        send_isoc_urb(&stream, {
+            {ok, 0, false, false, false, 500},
+            {ok, 0, false, false, false, 500},
+            {USB_TRANSFER_STATUS_ERROR, 0, false, false, false, 0},
+            {ok, 0, false, false, false, 500},
+            {ok, 0, true, false, false, 100},
+        }, data, offset);
+
+        THEN("The frame is dropped and the next frame is delivered") {
+            REQUIRE(frames.empty());
+            REQUIRE(uvc_host_stream_get_stats(&stream, &stats) == ESP_OK);
+            REQUIRE(stats.frames_dropped.usb_error == 1);
+
+            offset = 0;
+            send_isoc_urb(&stream, {
+                {ok, 1, false, false, false, 500},
+                {ok, 1, true, false, false, 100},
+            }, data, offset);
+            REQUIRE(frames.size() == 1);
+            REQUIRE(frames[0] == std::vector<uint8_t>(data.begin(), data.begin() + 600));
+        }
+    }
+
+    WHEN("A packet in the middle of the frame has error bit set") {
+        send_isoc_urb(&stream, {
+            {ok, 0, false, false, false, 500},
+            {ok, 0, false, true, false, 500},
+            {ok, 0, false, false, false, 500},
+            {ok, 0, true, false, false, 100},
+        }, data, offset);
+
+        THEN("The frame is dropped") {
+            REQUIRE(frames.empty());
+            REQUIRE(uvc_host_stream_get_stats(&stream, &stats) == ESP_OK);
+            REQUIRE(stats.frames_dropped.header_error == 1);
+        }
+    }
+
+    WHEN("Payload headers contain PTS") {
+        send_isoc_urb(&stream, {
+            {ok, 0, false, false, true, 500},
+            {ok, 0, false, false, true, 500},
+            {ok, 0, false, false, true, 500},
+            {ok, 0, true, false, true, 100},
+        }, data, offset);
+
+        THEN("The frame carries the PTS") {
+            REQUIRE(frames.size() == 1);
+            REQUIRE(timestamps[0].pts_valid);
+            REQUIRE(timestamps[0].pts == test_pts);
+        }
+    }
+
+    WHEN("The next frame starts in the same URB") {
+        send_isoc_urb(&stream, {
+            {ok, 0, false, false, false, 500},
+            {ok, 0, true, false, false, 100},
+            {ok, 0, false, false, false, 0},
+            {ok, 1, false, false, false, 500},
+            {ok, 1, false, false, false, 500},
+            {ok, 1, true, false, false, 10},
+        }, data, offset);
+
+        THEN("Both frames are delivered") {
+            REQUIRE(frames.size() == 2);
+            REQUIRE(frames[0] == std::vector<uint8_t>(data.begin(), data.begin() + 600));
+            REQUIRE(frames[1] == std::vector<uint8_t>(data.begin() + 600, data.begin() + 1610));
+        }
+    }
+
+    REQUIRE(uvc_frame_are_all_returned(&stream));
+    uvc_frame_free(&stream);
+}
+
+SCENARIO("Isochronous stream corrupt frame delivery", "[streaming][isoc]")
+{
+    constexpr usb_transfer_status_t ok = USB_TRANSFER_STATUS_COMPLETED;
+    uvc_stream_t stream = {}; // Define mock stream
+    stream.single_thread.current_frame_id = 2;
+    stream.dynamic.streaming = true;
+    stream.constant.vs_format.format = UVC_VS_FORMAT_MJPEG;
+    stream.constant.corrupt_frames = true;
+    static std::vector<std::vector<uint8_t>> frames;
+    static std::vector<uint32_t> error_flags;
+    static std::vector<std::vector<uvc_host_frame_lost_range_t>> lost_ranges;
+    frames.clear();
+    error_flags.clear();
+    lost_ranges.clear();
+    stream.constant.frame_cb = [](const uvc_host_frame_t *frame, void *user_ctx) -> bool {
+        frames.emplace_back(frame->data, frame->data + frame->data_len);
+        error_flags.push_back(frame->error_flags);
+        lost_ranges.emplace_back(frame->lost_ranges, frame->lost_ranges + frame->num_lost_ranges);
+        return true;
+    };
+    REQUIRE(uvc_frame_allocate(&stream, 1, 100 * 1024, 0) == ESP_OK);
+    const std::span<const uint8_t> data(logo_jpg);
+    size_t offset = 0;
+    uvc_host_stream_stats_t stats;
+
+    WHEN("Packets in the middle of the frame have USB errors") {
+        send_isoc_urb(&stream, {
+            {ok, 0, false, false, false, 500},
+            {USB_TRANSFER_STATUS_ERROR, 0, false, false, false, 0},
+            {USB_TRANSFER_STATUS_OVERFLOW, 0, false, false, false, 0},
+            {ok, 0, false, false, false, 500},
+            {USB_TRANSFER_STATUS_ERROR, 0, false, false, false, 0},
+            {ok, 0, true, false, false, 100},
+        }, data, offset);
+
+        THEN("The frame is delivered with the received data and the lost ranges") {
+            REQUIRE(frames.size() == 1);
+            REQUIRE(frames[0] == std::vector<uint8_t>(data.begin(), data.begin() + 1100));
+            REQUIRE(error_flags[0] == UVC_HOST_FRAME_ERROR_USB);
+            REQUIRE(lost_ranges[0].size() == 2);
+            REQUIRE(lost_ranges[0][0].offset == 500);
+            REQUIRE(lost_ranges[0][0].len == 0);
+            REQUIRE(lost_ranges[0][0].lost_bytes == 2048); // Two adjacent packets are merged
+            REQUIRE(lost_ranges[0][1].offset == 1000);
+            REQUIRE(lost_ranges[0][1].lost_bytes == 1024);
+            REQUIRE(uvc_host_stream_get_stats(&stream, &stats) == ESP_OK);
+            REQUIRE(stats.frames_delivered == 1);
+            REQUIRE(stats.frames_corrupted == 1);
+            REQUIRE(stats.frames_dropped.usb_error == 0);
+
+            AND_WHEN("Next frame is send") {
+                offset = 0;
+                send_isoc_urb(&stream, {
+                    {ok, 1, false, false, false, 500},
+                    {ok, 1, true, false, false, 100},
+                }, data, offset);
+
+                THEN("The frame is delivered without error flags") {
+                    REQUIRE(frames.size() == 2);
+                    REQUIRE(error_flags[1] == 0);
+                    REQUIRE(lost_ranges[1].empty());
+                }
+            }
+        }
+    }
+
+    WHEN("A packet in the middle of the frame has error bit set") {
+        send_isoc_urb(&stream, {
+            {ok, 0, false, false, false, 500},
+            {ok, 0, false, true, false, 500},
+            {ok, 0, false, false, false, 500},
+            {ok, 0, true, false, false, 100},
+        }, data, offset);
+
+        THEN("The frame is delivered with all its data and the suspect range") {
+            REQUIRE(frames.size() == 1);
+            REQUIRE(frames[0] == std::vector<uint8_t>(data.begin(), data.begin() + 1600));
+            REQUIRE(error_flags[0] == UVC_HOST_FRAME_ERROR_HEADER);
+            REQUIRE(lost_ranges[0].size() == 1);
+            REQUIRE(lost_ranges[0][0].offset == 500);
+            REQUIRE(lost_ranges[0][0].len == 500);
+            REQUIRE(lost_ranges[0][0].lost_bytes == 0);
+        }
+    }
+
+    WHEN("More packets are lost than the frame can record") {
+        std::vector<isoc_packet> packets;
+        for (int i = 0; i < UVC_HOST_FRAME_LOST_RANGES + 2; i++) {
+            packets.push_back({ok, 0, false, false, false, 100});
+            packets.push_back({USB_TRANSFER_STATUS_ERROR, 0, false, false, false, 0});
+        }
+        packets.push_back({ok, 0, true, false, false, 100});
+        send_isoc_urb(&stream, packets, data, offset);
+
+        THEN("The last range covers the rest of the damage") {
+            REQUIRE(frames.size() == 1);
+            REQUIRE(lost_ranges[0].size() == UVC_HOST_FRAME_LOST_RANGES);
+            const uvc_host_frame_lost_range_t &last = lost_ranges[0].back();
+            REQUIRE(last.offset == (UVC_HOST_FRAME_LOST_RANGES) * 100);
+            REQUIRE(last.len == 2 * 100);
+            REQUIRE(last.lost_bytes == 3 * 1024);
+        }
+    }
+
+    WHEN("The stream is not MJPEG") {
+        stream.constant.vs_format.format = UVC_VS_FORMAT_H264;
+        send_isoc_urb(&stream, {
+            {ok, 0, false, false, false, 500},
+            {USB_TRANSFER_STATUS_ERROR, 0, false, false, false, 0},
+            {ok, 0, true, false, false, 100},
+        }, data, offset);
+
+        THEN("The corrupt frame is dropped") {
+            REQUIRE(frames.empty());
+            REQUIRE(uvc_host_stream_get_stats(&stream, &stats) == ESP_OK);
+            REQUIRE(stats.frames_dropped.usb_error == 1);
+        }
+    }
+
+    REQUIRE(uvc_frame_are_all_returned(&stream));
+    uvc_frame_free(&stream);
+}
+
+SCENARIO("Bulk stream payload boundaries", "[streaming][bulk]")
+{
+    run_streaming_bulk_payload_scenario();
+}
+
+SCENARIO("Frame buffer ownership", "[streaming][frame]")
+{
+    uvc_stream_t stream = {}; // Define mock stream
+    constexpr int num_of_frames = 3;
+    REQUIRE(uvc_frame_allocate(&stream, num_of_frames, 1024, 0) == ESP_OK);
+    REQUIRE(uvc_frame_are_all_returned(&stream));
+
+    GIVEN("All frames are taken by the driver") {
+        uvc_host_frame_t *frames[num_of_frames];
+        for (int i = 0; i < num_of_frames; i++) {
+            frames[i] = uvc_frame_get_empty(&stream);
+            REQUIRE(frames[i] != nullptr);
+        }
+        REQUIRE(frames[0] != frames[1]);
+        REQUIRE(frames[1] != frames[2]);
+        REQUIRE(uvc_frame_get_empty(&stream) == nullptr);
+        REQUIRE_FALSE(uvc_frame_are_all_returned(&stream));
+
+        WHEN("One frame is returned") {
+            REQUIRE(uvc_host_frame_return(&stream, frames[1]) == ESP_OK);
+            THEN("The same frame is taken next") {
+                REQUIRE(uvc_frame_get_empty(&stream) == frames[1]);
+                REQUIRE(uvc_frame_get_empty(&stream) == nullptr);
+                REQUIRE(uvc_host_frame_return(&stream, frames[1]) == ESP_OK);
+            }
+            AND_WHEN("The frame is returned twice") {
+                REQUIRE(uvc_host_frame_return(&stream, frames[1]) == ESP_FAIL);
+            }
+        }
+
+        for (int i = 0; i < num_of_frames; i++) {
+            uvc_host_frame_return(&stream, frames[i]); // Some of the frames might be returned already
+        }
+        REQUIRE(uvc_frame_are_all_returned(&stream));
+    }
+
+    GIVEN("Too many frame buffers") {
+        uvc_stream_t big_stream = {};
+        REQUIRE(uvc_frame_allocate(&big_stream, UVC_FRAME_MAX_BUFFERS + 1, 1024, 0) == ESP_ERR_INVALID_ARG);
+    }
+    uvc_frame_free(&stream);
+}
@@ -0,0 +1,281 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <catch2/catch_test_macros.hpp>
+
+#include "usb/usb_types_stack.h"
+#include "usb/uvc_host.h"
+#include "uvc_types_priv.h"
+#include "uvc_frame_priv.h"
+
+#include "images/test_logo_jpg.hpp"
+#include "test_streaming_helpers.hpp"
+
+/**
+ * URB trace replay benchmark
+ *
+ * Completed URBs are recorded once and then replayed into isoc_transfer_callback() or bulk_transfer_callback(),
+ * so only the reassembly hot path is measured.
+ *
+ * A trace captured from a real camera can be replayed by setting UVC_BENCHMARK_TRACE environment variable to path of the trace file.
+ * The trace file is a sequence of little-endian records, one record per URB:
+ * - uint8_t  isoc:        1 for ISOC URB, 0 for Bulk URB
+ * - uint16_t num_packets: Number of ISOC packets, 1 for Bulk URB
+ * - uint32_t stride:      ISOC: Packet size (MPS * mult). Bulk: URB size, so short transfers are recognized
+ * - uint32_t length[num_packets]: Number of received bytes of each packet
+ * - data: ISOC: num_packets * stride bytes, Bulk: length[0] bytes
+ * The trace must contain even number of frames, so Frame ID toggles when the trace is replayed repeatedly.
+ */
+
+namespace {
+
+struct urb_record {
+    bool isoc;
+    size_t stride;                       // ISOC: Distance between packets in data. Bulk: URB size
+    std::vector<size_t> packet_lengths;  // ISOC: Received bytes of each packet. Bulk: Received bytes of the URB
+    std::vector<uint8_t> data;
+};
+
+struct benchmark_result {
+    size_t bytes;
+    size_t packets;
+    int frames;
+    double seconds;
+};
+
+constexpr int benchmark_iterations = 200;
+
+/**
+ * @brief Record ISOC URBs of one frame. Each packet starts with a header
+ */
+void record_isoc_frame(std::vector<urb_record> &trace, std::span<const uint8_t> data, size_t stride, size_t packets_per_urb, uint8_t frame_id)
+{
+    const size_t packet_data_size = stride - HEADER_LEN;
+    size_t offset = 0;
+    bool eof_sent = false;
+    while (!eof_sent) {
+        urb_record urb = {.isoc = true, .stride = stride, .packet_lengths = {}, .data = std::vector<uint8_t>(stride * packets_per_urb)};
+        for (size_t i = 0; i < packets_per_urb; i++) {
+            size_t len = 0;
+            if (!eof_sent) {
+                const size_t chunk = std::min(packet_data_size, data.size() - offset);
+                uvc_payload_header_t *header = reinterpret_cast<uvc_payload_header_t *>(urb.data.data() + i * stride);
+                header->bHeaderLength = HEADER_LEN;
+                header->bmHeaderInfo.val = 0;
+                header->bmHeaderInfo.end_of_header = 1;
+                header->bmHeaderInfo.frame_id = frame_id;
+                header->bmHeaderInfo.end_of_frame = (offset + chunk == data.size());
+                std::copy_n(data.begin() + offset, chunk, urb.data.begin() + i * stride + HEADER_LEN);
+                offset += chunk;
+                eof_sent = header->bmHeaderInfo.end_of_frame;
+                len = HEADER_LEN + chunk;
+            }
+            urb.packet_lengths.push_back(len); // Packets after EoF are empty, as from a real camera
+        }
+        trace.push_back(std::move(urb));
+    }
+}
+
+/**
+ * @brief Record Bulk URBs of one frame. Each payload starts with a header
+ */
+void record_bulk_frame(std::vector<urb_record> &trace, std::span<const uint8_t> data, size_t payload_size, size_t urb_size, uint8_t frame_id)
+{
+    std::vector<uint8_t> stream_data;
+    for (size_t offset = 0; offset < data.size(); offset += payload_size - HEADER_LEN) {
+        auto chunk = data.subspan(offset, std::min(payload_size - HEADER_LEN, data.size() - offset));
+        uvc_payload_header_t header = {};
+        header.bHeaderLength = HEADER_LEN;
+        header.bmHeaderInfo.end_of_header = 1;
+        header.bmHeaderInfo.frame_id = frame_id;
+        header.bmHeaderInfo.end_of_frame = (offset + chunk.size() == data.size());
+        const uint8_t *header_bytes = reinterpret_cast<const uint8_t *>(&header);
+        stream_data.insert(stream_data.end(), header_bytes, header_bytes + sizeof(header));
+        stream_data.insert(stream_data.end(), HEADER_LEN - sizeof(header), 0);
+        stream_data.insert(stream_data.end(), chunk.begin(), chunk.end());
+
+        // Each payload starts in new URB
+        for (size_t urb_offset = 0; urb_offset < stream_data.size(); urb_offset += urb_size) {
+            const size_t len = std::min(urb_size, stream_data.size() - urb_offset);
+            urb_record urb = {.isoc = false, .stride = urb_size, .packet_lengths = {len}, .data = std::vector<uint8_t>(urb_size)};
+            std::copy_n(stream_data.begin() + urb_offset, len, urb.data.begin());
+            trace.push_back(std::move(urb));
+        }
+        stream_data.clear();
+    }
+}
+
+/**
+ * @brief Load URB trace from file. See format description above
+ */
+std::vector<urb_record> load_trace(const char *path)
+{
+    std::vector<urb_record> trace;
+    std::ifstream file(path, std::ios::binary);
+    REQUIRE(file.good());
+
+    auto read_le = [&file](size_t bytes) -> uint32_t {
+        uint32_t value = 0;
+        for (size_t i = 0; i < bytes; i++) {
+            value |= static_cast<uint32_t>(static_cast<uint8_t>(file.get())) << (8 * i);
+        }
+        return value;
+    };
+
+    while (file.peek() != EOF) {
+        urb_record urb = {};
+        urb.isoc = read_le(1);
+        const size_t num_packets = read_le(2);
+        urb.stride = read_le(4);
+        for (size_t i = 0; i < num_packets; i++) {
+            urb.packet_lengths.push_back(read_le(4));
+        }
+        REQUIRE((urb.isoc || urb.packet_lengths[0] <= urb.stride));
+        urb.data.resize(num_packets * urb.stride);
+        file.read(reinterpret_cast<char *>(urb.data.data()), urb.isoc ? urb.data.size() : urb.packet_lengths[0]);
+        REQUIRE(file.good());
+        trace.push_back(std::move(urb));
+    }
+    return trace;
+}
+
+/**
+ * @brief Replay the trace into the UVC driver and measure time spent in the transfer callbacks
+ */
+benchmark_result replay_trace(std::vector<urb_record> &trace, uint32_t dwMaxPayloadTransferSize)
+{
+    static int frames_received;
+    frames_received = 0;
+    uvc_stream_t stream = {};
+    stream.dynamic.streaming = true;
+    stream.single_thread.current_frame_id = 2;
+    stream.single_thread.next_bulk_packet = UVC_STREAM_BULK_PACKET_HEADER;
+    stream.constant.dwMaxPayloadTransferSize = dwMaxPayloadTransferSize;
+    stream.constant.vs_format.format = UVC_VS_FORMAT_MJPEG;
+    stream.constant.frame_cb = [](const uvc_host_frame_t *frame, void *user_ctx) -> bool {
+        frames_received++;
+        return true;
+    };
+    REQUIRE(uvc_frame_allocate(&stream, 2, 1024 * 1024, 0) == ESP_OK);
+
+    // Build USB transfers once, so the replay measures only the driver
+    std::vector<usb_transfer_t *> transfers;
+    size_t bytes = 0;
+    size_t packets = 0;
+    for (urb_record &urb : trace) {
+        const int num_isoc_packets = urb.isoc ? urb.packet_lengths.size() : 0;
+        usb_transfer_t *transfer = static_cast<usb_transfer_t *>(operator new (sizeof(usb_transfer_t) + num_isoc_packets * sizeof(usb_isoc_packet_desc_t)));
+        new (transfer) usb_transfer_t{
+            .data_buffer = urb.data.data(),
+            .data_buffer_size = urb.data.size(),
+            .num_bytes = static_cast<int>(urb.data.size()),
+            .actual_num_bytes = urb.isoc ? 0 : static_cast<int>(urb.packet_lengths[0]),
+            .flags = 0,
+            .device_handle = nullptr,
+            .bEndpointAddress = 0,
+            .status = USB_TRANSFER_STATUS_COMPLETED,
+            .timeout_ms = 0,
+            .callback = nullptr,
+            .context = &stream,
+            .num_isoc_packets = num_isoc_packets,
+        };
+        for (int i = 0; i < num_isoc_packets; i++) {
+            transfer->isoc_packet_desc[i].num_bytes = urb.stride;
+            transfer->isoc_packet_desc[i].actual_num_bytes = urb.packet_lengths[i];
+            transfer->isoc_packet_desc[i].status = USB_TRANSFER_STATUS_COMPLETED;
+        }
+        for (size_t len : urb.packet_lengths) {
+            bytes += len;
+        }
+        packets += urb.isoc ? urb.packet_lengths.size() : (urb.packet_lengths[0] + 511) / 512; // Bulk: Count 512 byte HS packets
+        transfers.push_back(transfer);
+    }
+
+    usb_host_transfer_submit_IgnoreAndReturn(ESP_OK); // Transfers are re-submitted after each callback
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < benchmark_iterations; i++) {
+        for (usb_transfer_t *transfer : transfers) {
+            if (transfer->num_isoc_packets > 0) {
+                isoc_transfer_callback(transfer);
+            } else {
+                bulk_transfer_callback(transfer);
+            }
+        }
+    }
+    const auto stop = std::chrono::steady_clock::now();
+
+    for (usb_transfer_t *transfer : transfers) {
+        operator delete (transfer);
+    }
+    REQUIRE(uvc_frame_are_all_returned(&stream));
+    uvc_frame_free(&stream);
+
+    return {
+        .bytes = bytes * benchmark_iterations,
+        .packets = packets * benchmark_iterations,
+        .frames = frames_received,
+        .seconds = std::chrono::duration<double>(stop - start).count(),
+    };
+}
+
+void print_result(const char *name, const benchmark_result &result)
+{
+    printf("%s: %.1f MB/s, %.1f ns/packet, %.0f ns/frame (%d frames)\n",
+           name,
+           result.bytes / result.seconds / 1e6,
+           result.seconds * 1e9 / result.packets,
+           result.frames ? result.seconds * 1e9 / result.frames : 0.0,
+           result.frames);
+}
+
+} // namespace
+
+TEST_CASE("Streaming throughput benchmark", "[.][benchmark]")
+{
+    SECTION("ISOC, High-speed high-bandwidth endpoint") {
+        std::vector<urb_record> trace;
+        record_isoc_frame(trace, std::span(logo_jpg), 3 * 1024, 32, 0);
+        record_isoc_frame(trace, std::span(logo_jpg), 3 * 1024, 32, 1);
+        const benchmark_result result = replay_trace(trace, 3 * 1024);
+        REQUIRE(result.frames == 2 * benchmark_iterations);
+        print_result("ISOC 3x1024", result);
+    }
+
+    SECTION("ISOC, Full-speed endpoint") {
+        std::vector<urb_record> trace;
+        record_isoc_frame(trace, std::span(logo_jpg), 1023, 32, 0);
+        record_isoc_frame(trace, std::span(logo_jpg), 1023, 32, 1);
+        const benchmark_result result = replay_trace(trace, 1023);
+        REQUIRE(result.frames == 2 * benchmark_iterations);
+        print_result("ISOC 1023", result);
+    }
+
+    SECTION("Bulk, header in every payload") {
+        std::vector<urb_record> trace;
+        record_bulk_frame(trace, std::span(logo_jpg), 16 * 1024, 16 * 1024, 0);
+        record_bulk_frame(trace, std::span(logo_jpg), 16 * 1024, 16 * 1024, 1);
+        const benchmark_result result = replay_trace(trace, 16 * 1024);
+        REQUIRE(result.frames == 2 * benchmark_iterations);
+        print_result("Bulk 16k payload", result);
+    }
+
+    SECTION("Recorded trace") {
+        const char *path = getenv("UVC_BENCHMARK_TRACE");
+        if (path == nullptr) {
+            SKIP("UVC_BENCHMARK_TRACE is not set");
+        }
+        std::vector<urb_record> trace = load_trace(path);
+        const char *payload = getenv("UVC_BENCHMARK_PAYLOAD_SIZE"); // Bulk only: dwMaxPayloadTransferSize of recorded stream
+        const benchmark_result result = replay_trace(trace, payload ? strtoul(payload, nullptr, 0) : 0);
+        print_result(path, result);
+    }
+}
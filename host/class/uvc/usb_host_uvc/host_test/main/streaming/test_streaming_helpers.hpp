@@ -10,6 +10,7 @@
 #include <span>
 #include <algorithm>
 #include <cstdint>
+#include <vector>
 
 #include "usb/usb_types_stack.h"
 #include "usb/usb_types_uvc.h"
@@ -103,6 +104,74 @@ inline void test_streaming_bulk_send_frame(size_t transfer_size, void *transfer_
     delete[] data_buffer;
 }
 
+/**
+ * @brief Send bulk frame to the UVC driver, each payload starts with a header
+ *
+ * Payloads of payload_size bytes are sent back to back without zero-length packets,
+ * so one USB transfer can contain end of one payload and header of the next one.
+ * Only the last payload contains EoF flag.
+ *
+ * @param transfer_size
+ * @param transfer_context
+ * @param data
+ * @param payload_size
+ * @param frame_id
+ */
+inline void test_streaming_bulk_send_frame_per_payload(size_t transfer_size, void *transfer_context, std::span<const uint8_t> data, size_t payload_size, uint8_t frame_id = 0)
+{
+    assert(payload_size > HEADER_LEN);
+    assert(!data.empty());
+
+    // Serialize all payloads into one byte stream
+    std::vector<uint8_t> stream_data;
+    for (size_t offset = 0; offset < data.size(); offset += payload_size - HEADER_LEN) {
+        auto chunk = data.subspan(offset, std::min(payload_size - HEADER_LEN, data.size() - offset));
+        uvc_payload_header_t header = {};
+        header.bHeaderLength = HEADER_LEN;
+        header.bmHeaderInfo.end_of_header = 1;
+        header.bmHeaderInfo.frame_id = frame_id;
+        header.bmHeaderInfo.end_of_frame = (offset + chunk.size() == data.size());
+        const uint8_t *header_bytes = reinterpret_cast<const uint8_t *>(&header);
+        stream_data.insert(stream_data.end(), header_bytes, header_bytes + sizeof(header));
+        stream_data.insert(stream_data.end(), HEADER_LEN - sizeof(header), 0);
+        stream_data.insert(stream_data.end(), chunk.begin(), chunk.end());
+    }
+
+    uint8_t *data_buffer = new uint8_t[transfer_size];
+    assert(data_buffer);
+    usb_transfer_t _transfer = {
+        .data_buffer = data_buffer,
+        .data_buffer_size = transfer_size,
+        .num_bytes = 0,
+        .actual_num_bytes = 0,
+        .flags = 0,
+        .device_handle = nullptr,
+        .bEndpointAddress = 0,
+        .status = USB_TRANSFER_STATUS_COMPLETED,
+        .timeout_ms = 0,
+        .callback = nullptr,
+        .context = transfer_context,
+        .num_isoc_packets = 0,
+    };
+    usb_transfer_t *transfer = &_transfer;
+
+    for (size_t offset = 0; offset < stream_data.size(); offset += transfer_size) {
+        const size_t chunk_size = std::min(transfer_size, stream_data.size() - offset);
+        std::copy_n(stream_data.begin() + offset, chunk_size, transfer->data_buffer);
+        transfer->actual_num_bytes = chunk_size;
+        usb_host_transfer_submit_ExpectAndReturn(transfer, ESP_OK); // Each must be re-submitted
+        bulk_transfer_callback(transfer);
+    }
+
+    // Last payload ended on transfer boundary: Send zero-length packet
+    if (stream_data.size() % transfer_size == 0) {
+        transfer->actual_num_bytes = 0;
+        usb_host_transfer_submit_ExpectAndReturn(transfer, ESP_OK);
+        bulk_transfer_callback(transfer);
+    }
+    delete[] data_buffer;
+}
+
 /**
  * @brief Send isoc frame to the UVC driver
  *
@@ -199,7 +268,7 @@ inline void test_streaming_isoc_send_frame(size_t transfer_size, void *transfer_
 
             transfer->actual_num_bytes += chunk.size(); // This is not actually checked by the UVC driver, leaving it here for completeness
             transfer->isoc_packet_desc[packet_idx].actual_num_bytes += chunk.size();
-            write_ptr += chunk.size();
+            write_ptr = transfer->data_buffer + (packet_idx + 1) * transfer->isoc_packet_desc[packet_idx].num_bytes; // Packets are placed num_bytes apart, even if they are not full
             offset += chunk.size();
             //printf("\tcreating packet %d bytes\n", transfer->isoc_packet_desc[packet_idx].actual_num_bytes);
         }
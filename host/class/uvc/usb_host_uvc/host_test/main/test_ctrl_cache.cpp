@@ -0,0 +1,51 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "usb/uvc_host.h"
+#include "uvc_types_priv.h"
+#include "uvc_ctrl_cache_priv.h"
+
+SCENARIO("Video Control range cache", "[ctrl_cache]")
+{
+    uvc_stream_t stream = {}; // Define mock stream
+    uvc_ctrl_cache_range_t range = {};
+
+    GIVEN("Empty cache") {
+        REQUIRE_FALSE(uvc_ctrl_cache_get(&stream, 2, UVC_PU_BRIGHTNESS_CONTROL, &range));
+    }
+
+    GIVEN("Cached ranges of Processing Unit") {
+        const uvc_ctrl_cache_range_t brightness = {0xFFC0, 0x0040, 0x0001, 0x0000};
+        const uvc_ctrl_cache_range_t gain = {0, 100, 1, 32};
+        REQUIRE(ESP_OK == uvc_ctrl_cache_put(&stream, 2, UVC_PU_BRIGHTNESS_CONTROL, &brightness));
+        REQUIRE(ESP_OK == uvc_ctrl_cache_put(&stream, 2, UVC_PU_GAIN_CONTROL, &gain));
+
+        THEN("Each control has its own range") {
+            REQUIRE(uvc_ctrl_cache_get(&stream, 2, UVC_PU_BRIGHTNESS_CONTROL, &range));
+            REQUIRE(range.min == 0xFFC0);
+            REQUIRE(range.max == 0x0040);
+            REQUIRE(uvc_ctrl_cache_get(&stream, 2, UVC_PU_GAIN_CONTROL, &range));
+            REQUIRE(range.max == 100);
+            REQUIRE(range.def == 32);
+        }
+
+        THEN("The same selector of another unit is not cached") {
+            REQUIRE_FALSE(uvc_ctrl_cache_get(&stream, 1, UVC_PU_BRIGHTNESS_CONTROL, &range));
+        }
+
+        THEN("Cached range is not replaced") {
+            const uvc_ctrl_cache_range_t other_gain = {0, 255, 1, 0};
+            REQUIRE(ESP_OK == uvc_ctrl_cache_put(&stream, 2, UVC_PU_GAIN_CONTROL, &other_gain));
+            REQUIRE(uvc_ctrl_cache_get(&stream, 2, UVC_PU_GAIN_CONTROL, &range));
+            REQUIRE(range.max == 100);
+        }
+
+        uvc_ctrl_cache_free(&stream);
+        REQUIRE_FALSE(uvc_ctrl_cache_get(&stream, 2, UVC_PU_GAIN_CONTROL, &range));
+    }
+}
@@ -0,0 +1,190 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <cstring>
+#include <catch2/catch_test_macros.hpp>
+
+#include "usb/uvc_host.h"
+#include "uvc_descriptors_priv.h"
+#include "uvc_encoding_priv.h"
+
+// UVC 1.5 camera: Input Terminal 1 -> Processing Unit 2 -> Encoding Unit 3 -> Output Terminal 4 -> VS interface 1
+// Encoding Unit supports average bitrate, peak bitrate, QP and sync frames. Only bitrate and sync frames are runtime controls
+static const uint8_t eu_cfg_desc[] = {
+    0x09, 0x02, 0x6B, 0x00, 0x02, 0x01, 0x00, 0x80, 0xFA,
+    0x09, 0x04, 0x00, 0x00, 0x00, 0x0E, 0x01, 0x00, 0x00,
+    0x0D, 0x24, 0x01, 0x50, 0x01, 0x42, 0x00, 0x00, 0x6C, 0xDC, 0x02, 0x01, 0x01,
+    0x12, 0x24, 0x02, 0x01, 0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+    0x0D, 0x24, 0x05, 0x02, 0x01, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x0D, 0x24, 0x07, 0x03, 0x02, 0x00, 0x03, 0x40, 0x07, 0x00, 0x40, 0x04, 0x00,
+    0x09, 0x24, 0x03, 0x04, 0x01, 0x01, 0x00, 0x03, 0x00,
+    0x09, 0x04, 0x01, 0x00, 0x00, 0x0E, 0x02, 0x00, 0x00,
+    0x0E, 0x24, 0x01, 0x00, 0x0E, 0x00, 0x81, 0x00, 0x04, 0x00, 0x00, 0x00, 0x01, 0x00,
+};
+
+// UVC 1.1 camera with UVCX extension unit 3, supporting controls 1 to 8, Picture Type and Bitrate Layers
+static const uint8_t uvcx_cfg_desc[] = {
+    0x09, 0x02, 0x79, 0x00, 0x02, 0x01, 0x00, 0x80, 0xFA,
+    0x09, 0x04, 0x00, 0x00, 0x00, 0x0E, 0x01, 0x00, 0x00,
+    0x0D, 0x24, 0x01, 0x10, 0x01, 0x50, 0x00, 0x00, 0x6C, 0xDC, 0x02, 0x01, 0x01,
+    0x12, 0x24, 0x02, 0x01, 0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+    0x0D, 0x24, 0x05, 0x02, 0x01, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x1B, 0x24, 0x06, 0x03, 0x41, 0x76, 0x9E, 0xA2, 0x04, 0xDE, 0xE3, 0x47, 0x8B, 0x2B, 0xF4, 0x34, 0x1A, 0xFF, 0x00, 0x3B,
+    0x0F, 0x01, 0x02, 0x02, 0xFF, 0x21, 0x00,
+    0x09, 0x24, 0x03, 0x04, 0x01, 0x01, 0x00, 0x03, 0x00,
+    0x09, 0x04, 0x01, 0x00, 0x00, 0x0E, 0x02, 0x00, 0x00,
+    0x0E, 0x24, 0x01, 0x00, 0x0E, 0x00, 0x81, 0x00, 0x04, 0x00, 0x00, 0x00, 0x01, 0x00,
+};
+
+static uint32_t le(const uint8_t *data, size_t num_bytes)
+{
+    uint32_t value = 0;
+    for (size_t i = 0; i < num_bytes; i++) {
+        value |= (uint32_t)data[i] << (8 * i);
+    }
+    return value;
+}
+
+static uvc_host_enc_info_t get_info(const uint8_t *cfg_desc)
+{
+    uvc_desc_index_t *index = nullptr;
+    REQUIRE(ESP_OK == uvc_desc_index_build((const usb_config_desc_t *)cfg_desc, &index));
+    const uvc_desc_index_intf_t *intf = uvc_desc_index_get_intf(index, 1);
+    REQUIRE(intf != nullptr);
+    uvc_host_enc_info_t info;
+    uvc_enc_get_info(intf, &info);
+    uvc_desc_index_free(index);
+    return info;
+}
+
+SCENARIO("Encoder controls of Encoding Unit", "[encoding]")
+{
+    const uvc_host_enc_info_t info = get_info(eu_cfg_desc);
+    uvc_enc_reqs_t reqs;
+
+    GIVEN("Encoding Unit in the unit chain of the stream") {
+        REQUIRE(info.type == UVC_HOST_ENC_UNIT);
+        REQUIRE(info.bUnitID == 3);
+        REQUIRE(info.bmControls == 0x0740);
+        REQUIRE(info.bmControlsRuntime == 0x0440);
+    }
+
+    WHEN("Bitrate is set and IDR frame is requested while streaming") {
+        uvc_host_enc_params_t params = {};
+        params.flags = UVC_HOST_ENC_SET_BITRATE | UVC_HOST_ENC_FORCE_IDR;
+        params.average_bitrate = 2000000;
+        REQUIRE(ESP_OK == uvc_enc_build_reqs(&info, &params, true, &reqs));
+
+        THEN("Bitrate is sent before the sync frame, which is read and written back to keep the GOP") {
+            REQUIRE(reqs.num_reqs == 3);
+            REQUIRE(reqs.reqs[0].bRequest == UVC_SET_CUR);
+            REQUIRE(reqs.reqs[0].bUnitID == 3);
+            REQUIRE(reqs.reqs[0].bSelector == UVC_EU_AVERAGE_BITRATE_CONTROL);
+            REQUIRE(reqs.reqs[0].wLength == 4);
+            REQUIRE(le(reqs.reqs[0].data, 4) == 2000000);
+            REQUIRE(reqs.reqs[1].bRequest == UVC_GET_CUR);
+            REQUIRE(reqs.reqs[1].bSelector == UVC_EU_SYNC_REF_FRAME_CONTROL);
+            REQUIRE(reqs.reqs[2].bRequest == UVC_SET_CUR);
+            REQUIRE(reqs.reqs[2].bSelector == UVC_EU_SYNC_REF_FRAME_CONTROL);
+            REQUIRE(reqs.reqs[2].data == reqs.reqs[1].data);
+        }
+    }
+
+    WHEN("GOP is set together with IDR request") {
+        uvc_host_enc_params_t params = {};
+        params.flags = UVC_HOST_ENC_SET_GOP | UVC_HOST_ENC_FORCE_IDR;
+        params.gop_ms = 2000;
+        REQUIRE(ESP_OK == uvc_enc_build_reqs(&info, &params, true, &reqs));
+
+        THEN("One Synchronization request sets the sync frame interval") {
+            REQUIRE(reqs.num_reqs == 1);
+            REQUIRE(reqs.reqs[0].bRequest == UVC_SET_CUR);
+            REQUIRE(reqs.reqs[0].wLength == 4);
+            REQUIRE(reqs.reqs[0].data[0] == UVC_EU_SYNC_FRAME_IDR_WITH_PARAMS);
+            REQUIRE(le(&reqs.reqs[0].data[1], 2) == 2000);
+            REQUIRE(reqs.reqs[0].data[3] == 0);
+        }
+    }
+
+    WHEN("QP and peak bitrate are set") {
+        uvc_host_enc_params_t params = {};
+        params.flags = UVC_HOST_ENC_SET_QP;
+        params.qp_i = 26;
+        params.qp_p = 28;
+        params.qp_b = 30;
+
+        THEN("They can be set only when not streaming") {
+            REQUIRE(ESP_ERR_INVALID_STATE == uvc_enc_build_reqs(&info, &params, true, &reqs));
+            REQUIRE(ESP_OK == uvc_enc_build_reqs(&info, &params, false, &reqs));
+            REQUIRE(reqs.num_reqs == 1);
+            REQUIRE(reqs.reqs[0].bSelector == UVC_EU_QUANTIZATION_PARAMS_CONTROL);
+            REQUIRE(reqs.reqs[0].wLength == 6);
+            REQUIRE(le(&reqs.reqs[0].data[0], 2) == 26);
+            REQUIRE(le(&reqs.reqs[0].data[2], 2) == 28);
+            REQUIRE(le(&reqs.reqs[0].data[4], 2) == 30);
+
+            params.flags = UVC_HOST_ENC_SET_BITRATE;
+            params.average_bitrate = 1000000;
+            params.peak_bitrate = 1500000;
+            REQUIRE(ESP_ERR_INVALID_STATE == uvc_enc_build_reqs(&info, &params, true, &reqs));
+            REQUIRE(ESP_OK == uvc_enc_build_reqs(&info, &params, false, &reqs));
+            REQUIRE(reqs.num_reqs == 2);
+            REQUIRE(reqs.reqs[1].bSelector == UVC_EU_PEAK_BIT_RATE_CONTROL);
+            REQUIRE(le(reqs.reqs[1].data, 4) == 1500000);
+        }
+    }
+
+    WHEN("No parameter is selected") {
+        uvc_host_enc_params_t params = {};
+        REQUIRE(ESP_ERR_INVALID_ARG == uvc_enc_build_reqs(&info, &params, false, &reqs));
+    }
+}
+
+SCENARIO("Encoder controls of UVCX extension unit", "[encoding]")
+{
+    const uvc_host_enc_info_t info = get_info(uvcx_cfg_desc);
+    uvc_enc_reqs_t reqs;
+
+    GIVEN("UVCX extension unit without Encoding Unit") {
+        REQUIRE(info.type == UVC_HOST_ENC_UVCX);
+        REQUIRE(info.bUnitID == 3);
+        REQUIRE(info.bmControls == 0x21FF);
+    }
+
+    WHEN("Bitrate is set and IDR frame is requested") {
+        uvc_host_enc_params_t params = {};
+        params.flags = UVC_HOST_ENC_SET_BITRATE | UVC_HOST_ENC_FORCE_IDR;
+        params.average_bitrate = 3000000;
+        REQUIRE(ESP_OK == uvc_enc_build_reqs(&info, &params, true, &reqs));
+
+        THEN("Bitrate Layers and Picture Type controls are set for all layers") {
+            REQUIRE(reqs.num_reqs == 2);
+            REQUIRE(reqs.reqs[0].bSelector == UVC_UVCX_BITRATE_LAYERS);
+            REQUIRE(reqs.reqs[0].wLength == 10);
+            REQUIRE(le(&reqs.reqs[0].data[0], 2) == 0);
+            REQUIRE(le(&reqs.reqs[0].data[2], 4) == 3000000); // Peak bitrate follows average bitrate
+            REQUIRE(le(&reqs.reqs[0].data[6], 4) == 3000000);
+            REQUIRE(reqs.reqs[1].bSelector == UVC_UVCX_PICTURE_TYPE_CONTROL);
+            REQUIRE(le(&reqs.reqs[1].data[2], 2) == UVC_UVCX_PICTURE_TYPE_IDR_FULL);
+        }
+    }
+
+    WHEN("GOP is set") {
+        uvc_host_enc_params_t params = {};
+        params.flags = UVC_HOST_ENC_SET_GOP;
+        params.gop_ms = 1000;
+        REQUIRE(ESP_ERR_NOT_SUPPORTED == uvc_enc_build_reqs(&info, &params, false, &reqs));
+    }
+}
+
+SCENARIO("Encoder controls of stream without encoder", "[encoding]")
+{
+    const uvc_host_enc_info_t info = {};
+    uvc_host_enc_params_t params = {};
+    params.flags = UVC_HOST_ENC_FORCE_IDR;
+    uvc_enc_reqs_t reqs;
+    REQUIRE(ESP_ERR_NOT_SUPPORTED == uvc_enc_build_reqs(&info, &params, false, &reqs));
+}
@@ -0,0 +1,97 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "usb/uvc_host.h"
+#include "uvc_negotiation_cache_priv.h"
+
+static uvc_host_negotiation_cache_entry_t test_cache_entry(uint16_t pid, unsigned h_res)
+{
+    uvc_host_negotiation_cache_entry_t entry = {};
+    entry.idVendor = 0x046D;
+    entry.idProduct = pid;
+    entry.bcdDevice = 0x0100;
+    entry.bInterfaceNumber = 1;
+    entry.vs_format = {
+        .h_res = h_res,
+        .v_res = 480,
+        .fps = 30,
+        .format = UVC_VS_FORMAT_MJPEG,
+    };
+    entry.vs_ctrl.dwMaxPayloadTransferSize = 3072;
+    return entry;
+}
+
+SCENARIO("Format negotiation cache", "[negotiation]")
+{
+    GIVEN("Cache is disabled") {
+        REQUIRE(uvc_negotiation_cache_init(0) == ESP_OK);
+        const uvc_host_negotiation_cache_entry_t entry = test_cache_entry(0x0825, 640);
+        size_t num_entries = 1;
+        REQUIRE(uvc_host_negotiation_cache_import(&entry, 1) == ESP_ERR_INVALID_STATE);
+        REQUIRE(uvc_host_negotiation_cache_export(nullptr, &num_entries) == ESP_ERR_INVALID_ARG);
+        REQUIRE(uvc_host_negotiation_cache_clear() == ESP_ERR_INVALID_STATE);
+        uvc_negotiation_cache_deinit();
+    }
+
+    GIVEN("Cache with 2 entries") {
+        REQUIRE(uvc_negotiation_cache_init(2) == ESP_OK);
+        REQUIRE(uvc_negotiation_cache_init(2) == ESP_ERR_INVALID_STATE); // Already initialized
+        uvc_host_negotiation_cache_entry_t exported[3];
+        size_t num_entries = 3;
+
+        WHEN("Entries are imported") {
+            const uvc_host_negotiation_cache_entry_t entries[] = {
+                test_cache_entry(0x0825, 640),
+                test_cache_entry(0x0825, 1280),
+            };
+            REQUIRE(uvc_host_negotiation_cache_import(entries, 2) == ESP_OK);
+
+            THEN("They can be exported") {
+                REQUIRE(uvc_host_negotiation_cache_export(exported, &num_entries) == ESP_OK);
+                REQUIRE(num_entries == 2);
+                REQUIRE(exported[0].vs_format.h_res == 640);
+                REQUIRE(exported[1].vs_format.h_res == 1280);
+                REQUIRE(exported[1].vs_ctrl.dwMaxPayloadTransferSize == 3072);
+            }
+
+            AND_WHEN("Entry with the same key is imported") {
+                uvc_host_negotiation_cache_entry_t updated = test_cache_entry(0x0825, 640);
+                updated.vs_ctrl.dwMaxPayloadTransferSize = 1024;
+                REQUIRE(uvc_host_negotiation_cache_import(&updated, 1) == ESP_OK);
+
+                THEN("The entry is replaced") {
+                    REQUIRE(uvc_host_negotiation_cache_export(exported, &num_entries) == ESP_OK);
+                    REQUIRE(num_entries == 2);
+                    REQUIRE(exported[0].vs_ctrl.dwMaxPayloadTransferSize == 1024);
+                }
+            }
+
+            AND_WHEN("Entry with new key is imported to full cache") {
+                const uvc_host_negotiation_cache_entry_t entry = test_cache_entry(0x0826, 640);
+                REQUIRE(uvc_host_negotiation_cache_import(&entry, 1) == ESP_OK);
+
+                THEN("Least recently used entry is replaced") {
+                    REQUIRE(uvc_host_negotiation_cache_export(exported, &num_entries) == ESP_OK);
+                    REQUIRE(num_entries == 2);
+                    REQUIRE(exported[0].idProduct == 0x0826);
+                    REQUIRE(exported[1].vs_format.h_res == 1280);
+                }
+            }
+
+            AND_WHEN("The cache is cleared") {
+                REQUIRE(uvc_host_negotiation_cache_clear() == ESP_OK);
+
+                THEN("No entries are exported") {
+                    REQUIRE(uvc_host_negotiation_cache_export(exported, &num_entries) == ESP_OK);
+                    REQUIRE(num_entries == 0);
+                }
+            }
+        }
+        uvc_negotiation_cache_deinit();
+    }
+}
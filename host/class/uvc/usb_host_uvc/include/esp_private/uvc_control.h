@@ -48,6 +48,51 @@ esp_err_t uvc_host_usb_ctrl(uvc_host_stream_hdl_t stream_hdl, uint8_t bmRequestT
  */
 esp_err_t uvc_host_stream_control_negotiate(uvc_host_stream_hdl_t stream_hdl, const uvc_host_stream_format_t *vs_format, uvc_vs_ctrl_t *vs_result_ret);
 
+/**
+ * @brief Commit result of a previous negotiation again
+ *
+ * Used on resume from bus suspend: the device kept its configuration, so probing is not needed
+ *
+ * @param      stream_hdl UVC stream
+ * @param[in]  vs_format  Video Stream format of the result
+ * @param[in]  vs_result  Result of a previous format negotiation
+ * @return
+ *     - ESP_OK: Format committed
+ *     - ESP_ERR_INVALID_ARG: stream_hdl, vs_format or vs_result is NULL
+ *     - Else: USB Control transfer error, e.g. the device rejected the result
+ */
+esp_err_t uvc_host_stream_control_recommit(uvc_host_stream_hdl_t stream_hdl, const uvc_host_stream_format_t *vs_format, const uvc_vs_ctrl_t *vs_result);
+
+/**
+ * @brief Negotiate still image format
+ *
+ * Still image of the currently committed video format is probed and committed
+ *
+ * @param      stream_hdl        UVC stream
+ * @param[in]  bFormatIndex      Format index of the video stream
+ * @param[in]  bFrameIndex       Index of still image size pattern, from 1
+ * @param[in]  bCompressionIndex Index of still image compression pattern, 0 if not used
+ * @param[out] still_result_ret  Negotiation result
+ * @return
+ *     - ESP_OK: Still image format negotiated and committed
+ *     - ESP_ERR_INVALID_ARG: stream_hdl or still_result_ret is NULL
+ *     - ESP_ERR_NOT_FOUND: The device did not accept requested still image format
+ *     - Else: USB Control transfer error
+ */
+esp_err_t uvc_host_still_control_negotiate(uvc_host_stream_hdl_t stream_hdl, uint8_t bFormatIndex, uint8_t bFrameIndex, uint8_t bCompressionIndex, uvc_vs_still_ctrl_t *still_result_ret);
+
+/**
+ * @brief Set Still Image Trigger control
+ *
+ * @param     stream_hdl UVC stream
+ * @param[in] trigger    Trigger value
+ * @return
+ *     - ESP_OK: Trigger set
+ *     - ESP_ERR_INVALID_ARG: stream_hdl is NULL
+ *     - Else: USB Control transfer error
+ */
+esp_err_t uvc_host_still_control_trigger(uvc_host_stream_hdl_t stream_hdl, enum uvc_vs_still_trigger trigger);
+
 #ifdef __cplusplus
 }
 #endif
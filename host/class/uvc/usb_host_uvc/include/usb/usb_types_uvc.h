@@ -53,6 +53,143 @@ enum uvc_vs_ctrl_selector {
     UVC_VS_SYNC_DELAY_CONTROL = 0x09
 };
 
+/**
+ * @brief Camera Terminal control selector
+ *
+ * @see USB UVC specification ver 1.5, table A.12
+ */
+enum uvc_ct_ctrl_selector {
+    UVC_CT_CONTROL_UNDEFINED = 0x00,
+    UVC_CT_SCANNING_MODE_CONTROL = 0x01,
+    UVC_CT_AE_MODE_CONTROL = 0x02,
+    UVC_CT_AE_PRIORITY_CONTROL = 0x03,
+    UVC_CT_EXPOSURE_TIME_ABSOLUTE_CONTROL = 0x04,
+    UVC_CT_EXPOSURE_TIME_RELATIVE_CONTROL = 0x05,
+    UVC_CT_FOCUS_ABSOLUTE_CONTROL = 0x06,
+    UVC_CT_FOCUS_RELATIVE_CONTROL = 0x07,
+    UVC_CT_FOCUS_AUTO_CONTROL = 0x08,
+    UVC_CT_IRIS_ABSOLUTE_CONTROL = 0x09,
+    UVC_CT_IRIS_RELATIVE_CONTROL = 0x0A,
+    UVC_CT_ZOOM_ABSOLUTE_CONTROL = 0x0B,
+    UVC_CT_ZOOM_RELATIVE_CONTROL = 0x0C,
+    UVC_CT_PANTILT_ABSOLUTE_CONTROL = 0x0D,
+    UVC_CT_PANTILT_RELATIVE_CONTROL = 0x0E,
+    UVC_CT_ROLL_ABSOLUTE_CONTROL = 0x0F,
+    UVC_CT_ROLL_RELATIVE_CONTROL = 0x10,
+    UVC_CT_PRIVACY_CONTROL = 0x11,
+    UVC_CT_FOCUS_SIMPLE_CONTROL = 0x12,
+    UVC_CT_WINDOW_CONTROL = 0x13,
+    UVC_CT_REGION_OF_INTEREST_CONTROL = 0x14
+};
+
+/**
+ * @brief Processing Unit control selector
+ *
+ * @see USB UVC specification ver 1.5, table A.13
+ */
+enum uvc_pu_ctrl_selector {
+    UVC_PU_CONTROL_UNDEFINED = 0x00,
+    UVC_PU_BACKLIGHT_COMPENSATION_CONTROL = 0x01,
+    UVC_PU_BRIGHTNESS_CONTROL = 0x02,
+    UVC_PU_CONTRAST_CONTROL = 0x03,
+    UVC_PU_GAIN_CONTROL = 0x04,
+    UVC_PU_POWER_LINE_FREQUENCY_CONTROL = 0x05,
+    UVC_PU_HUE_CONTROL = 0x06,
+    UVC_PU_SATURATION_CONTROL = 0x07,
+    UVC_PU_SHARPNESS_CONTROL = 0x08,
+    UVC_PU_GAMMA_CONTROL = 0x09,
+    UVC_PU_WHITE_BALANCE_TEMPERATURE_CONTROL = 0x0A,
+    UVC_PU_WHITE_BALANCE_TEMPERATURE_AUTO_CONTROL = 0x0B,
+    UVC_PU_WHITE_BALANCE_COMPONENT_CONTROL = 0x0C,
+    UVC_PU_WHITE_BALANCE_COMPONENT_AUTO_CONTROL = 0x0D,
+    UVC_PU_DIGITAL_MULTIPLIER_CONTROL = 0x0E,
+    UVC_PU_DIGITAL_MULTIPLIER_LIMIT_CONTROL = 0x0F,
+    UVC_PU_HUE_AUTO_CONTROL = 0x10,
+    UVC_PU_ANALOG_VIDEO_STANDARD_CONTROL = 0x11,
+    UVC_PU_ANALOG_LOCK_STATUS_CONTROL = 0x12,
+    UVC_PU_CONTRAST_AUTO_CONTROL = 0x13
+};
+
+/**
+ * @brief Encoding Unit control selector
+ *
+ * Bit (selector - 1) of bmControls in Encoding Unit descriptor indicates support of the control
+ *
+ * @see USB UVC specification ver 1.5, table A.14
+ */
+enum uvc_eu_ctrl_selector {
+    UVC_EU_CONTROL_UNDEFINED = 0x00,
+    UVC_EU_SELECT_LAYER_CONTROL = 0x01,
+    UVC_EU_PROFILE_TOOLSET_CONTROL = 0x02,
+    UVC_EU_VIDEO_RESOLUTION_CONTROL = 0x03,
+    UVC_EU_MIN_FRAME_INTERVAL_CONTROL = 0x04,
+    UVC_EU_SLICE_MODE_CONTROL = 0x05,
+    UVC_EU_RATE_CONTROL_MODE_CONTROL = 0x06,
+    UVC_EU_AVERAGE_BITRATE_CONTROL = 0x07,
+    UVC_EU_CPB_SIZE_CONTROL = 0x08,
+    UVC_EU_PEAK_BIT_RATE_CONTROL = 0x09,
+    UVC_EU_QUANTIZATION_PARAMS_CONTROL = 0x0A,
+    UVC_EU_SYNC_REF_FRAME_CONTROL = 0x0B,
+    UVC_EU_LTR_BUFFER_CONTROL = 0x0C,
+    UVC_EU_LTR_PICTURE_CONTROL = 0x0D,
+    UVC_EU_LTR_VALIDATION_CONTROL = 0x0E,
+    UVC_EU_LEVEL_IDC_LIMIT_CONTROL = 0x0F,
+    UVC_EU_SEI_PAYLOADTYPE_CONTROL = 0x10,
+    UVC_EU_QP_RANGE_CONTROL = 0x11,
+    UVC_EU_PRIORITY_CONTROL = 0x12,
+    UVC_EU_START_OR_STOP_LAYER_CONTROL = 0x13,
+    UVC_EU_ERROR_RESILIENCY_CONTROL = 0x14
+};
+
+/**
+ * @brief Synchronization frame type of Encoding Unit Synchronization and Long-Term Reference Frame control
+ *
+ * @see USB UVC specification ver 1.5, section 4.2.2.4.11
+ */
+enum uvc_eu_sync_frame_type {
+    UVC_EU_SYNC_FRAME_RESERVED = 0x00,
+    UVC_EU_SYNC_FRAME_IDR = 0x01,             // IDR frame
+    UVC_EU_SYNC_FRAME_IDR_WITH_PARAMS = 0x02, // IDR frame preceded by SPS and PPS (VPS, SPS and PPS for H.265)
+    UVC_EU_SYNC_FRAME_NON_IDR_INTRA = 0x03    // Random access intra frame, not IDR
+};
+
+/**
+ * @brief H.264 extension unit (UVCX) of UVC 1.1 cameras
+ *
+ * Cameras predating Encoding Unit of UVC 1.5 expose H.264 encoder controls in this extension unit.
+ * GUID {A29E7641-DE04-47E3-8B2B-F4341AFF003B}, in the byte order of guidExtensionCode.
+ *
+ * @see USB Device Class Definition for Video Devices: H.264 Payload 1.0, section 3.3
+ */
+#define UVC_UVCX_GUID {0x41, 0x76, 0x9E, 0xA2, 0x04, 0xDE, 0xE3, 0x47, 0x8B, 0x2B, 0xF4, 0x34, 0x1A, 0xFF, 0x00, 0x3B}
+
+enum uvc_uvcx_ctrl_selector {
+    UVC_UVCX_VIDEO_CONFIG_PROBE = 0x01,
+    UVC_UVCX_VIDEO_CONFIG_COMMIT = 0x02,
+    UVC_UVCX_RATE_CONTROL_MODE = 0x03,
+    UVC_UVCX_TEMPORAL_SCALE_MODE = 0x04,
+    UVC_UVCX_SPATIAL_SCALE_MODE = 0x05,
+    UVC_UVCX_SNR_SCALE_MODE = 0x06,
+    UVC_UVCX_LTR_BUFFER_SIZE_CONTROL = 0x07,
+    UVC_UVCX_LTR_PICTURE_CONTROL = 0x08,
+    UVC_UVCX_PICTURE_TYPE_CONTROL = 0x09,
+    UVC_UVCX_VERSION = 0x0A,
+    UVC_UVCX_ENCODER_RESET = 0x0B,
+    UVC_UVCX_FRAMERATE_CONFIG = 0x0C,
+    UVC_UVCX_VIDEO_ADVANCE_CONFIG = 0x0D,
+    UVC_UVCX_BITRATE_LAYERS = 0x0E,
+    UVC_UVCX_QP_STEPS_LAYERS = 0x0F
+};
+
+/**
+ * @brief Picture type of UVCX Picture Type control
+ */
+enum uvc_uvcx_picture_type {
+    UVC_UVCX_PICTURE_TYPE_I_FRAME = 0x0000,
+    UVC_UVCX_PICTURE_TYPE_IDR = 0x0001,
+    UVC_UVCX_PICTURE_TYPE_IDR_FULL = 0x0002 // IDR frame with new SPS and PPS
+};
+
 /**
  * @brief VideoControl interface descriptor subtype
  *
@@ -124,6 +261,32 @@ typedef struct {
 } USB_DESC_ATTR uvc_vs_ctrl_t;
 ESP_STATIC_ASSERT(sizeof(uvc_vs_ctrl_t) == 48, "Size of uvc_vs_ctrl_t incorrect");
 
+/**
+ * @brief Video Still Probe and Commit Controls
+ *
+ * @see USB UVC specification ver 1.5, table 4-77
+ */
+typedef struct {
+    uint8_t  bFormatIndex;
+    uint8_t  bFrameIndex;
+    uint8_t  bCompressionIndex;
+    uint32_t dwMaxVideoFrameSize;
+    uint32_t dwMaxPayloadTransferSize;
+} USB_DESC_ATTR uvc_vs_still_ctrl_t;
+ESP_STATIC_ASSERT(sizeof(uvc_vs_still_ctrl_t) == 11, "Size of uvc_vs_still_ctrl_t incorrect");
+
+/**
+ * @brief Still Image Trigger Control values
+ *
+ * @see USB UVC specification ver 1.5, table 4-79
+ */
+enum uvc_vs_still_trigger {
+    UVC_VS_STILL_TRIGGER_NORMAL = 0x00,        // Normal operation
+    UVC_VS_STILL_TRIGGER_TRANSMIT = 0x01,      // Transmit still image
+    UVC_VS_STILL_TRIGGER_TRANSMIT_BULK = 0x02, // Transmit still image via dedicated bulk pipe
+    UVC_VS_STILL_TRIGGER_ABORT = 0x03,         // Abort still image transmission
+};
+
 /**
  * @brief Video Frame Descriptor
  *
@@ -314,6 +477,41 @@ typedef struct {
     uint8_t  bmVideoStandards;
 } USB_DESC_ATTR uvc_processing_unit_desc_t;
 
+/**
+ * @brief Extension Unit Descriptor
+ *
+ * baSourceID is followed by bControlSize, bmControls of bControlSize bytes and iExtension
+ *
+ * @see USB UVC specification ver 1.5, table 3-10
+ */
+typedef struct {
+    uint8_t  bLength;
+    uint8_t  bDescriptorType;
+    uint8_t  bDescriptorSubType;
+    uint8_t  bUnitID;
+    uint8_t  guidExtensionCode[16];
+    uint8_t  bNumControls;
+    uint8_t  bNrInPins;
+    uint8_t  baSourceID[];  // This field is an array with size bNrInPins
+} USB_DESC_ATTR uvc_extension_unit_desc_t;
+
+/**
+ * @brief Encoding Unit Descriptor
+ *
+ * @see USB UVC specification ver 1.5, table 3-11
+ */
+typedef struct {
+    uint8_t  bLength;
+    uint8_t  bDescriptorType;
+    uint8_t  bDescriptorSubType;
+    uint8_t  bUnitID;
+    uint8_t  bSourceID;
+    uint8_t  iEncoding;
+    uint8_t  bControlSize;          // Must == 3
+    uint8_t  bmControls[3];         // Controls supported by the Encoding Unit
+    uint8_t  bmControlsRuntime[3];  // Controls that can be changed while streaming
+} USB_DESC_ATTR uvc_encoding_unit_desc_t;
+
 /**
  * @brief Video Streaming Interface Input Header Descriptor
  *
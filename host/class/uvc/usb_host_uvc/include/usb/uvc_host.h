@@ -20,6 +20,7 @@ extern "C" {
 #endif
 
 typedef struct uvc_host_stream_s *uvc_host_stream_hdl_t;
+typedef struct uvc_host_frame_pool_s *uvc_host_frame_pool_hdl_t;
 
 /**
  * @brief Configuration structure of USB Host UVC driver
@@ -30,6 +31,10 @@ typedef struct {
     int xCoreID;                   /**< Core affinity of the driver's task */
     bool create_background_task;   /**< When set to true, background task handling usb events is created.
                                         Otherwise user has to periodically call uvc_host_handle_events function */
+    size_t negotiation_cache_size; /**< Number of entries in format negotiation cache. 0: Cache disabled.
+                                        Cached results are committed directly on next stream open, skipping the full probe/commit negotiation */
+    bool shared_client;            /**< Register to the client of usb_host_shared_client component instead of an own USB Host client.
+                                        Its task handles the events, so no driver's task is created and uvc_host_handle_events is not used */
 } uvc_host_driver_config_t;
 
 /**
@@ -82,6 +87,87 @@ typedef struct {
     enum uvc_host_stream_format format; /**< Frame coding format */
 } uvc_host_stream_format_t;
 
+#define UVC_HOST_FRAME_INTERVALS_MAX (8) // Maximum number of discrete frame intervals reported in uvc_host_frame_info_t
+
+/**
+ * @brief Frame format offered by the camera
+ *
+ * Frame intervals are in 100 ns units. Use 10000000 / interval to get FPS.
+ */
+typedef struct {
+    enum uvc_host_stream_format format; /**< Frame coding format */
+    unsigned h_res;                     /**< Horizontal resolution */
+    unsigned v_res;                     /**< Vertical resolution */
+    uint32_t default_interval;          /**< Default frame interval */
+    uint8_t interval_type;              /**< 0: Continuous frame interval, 1..UVC_HOST_FRAME_INTERVALS_MAX: Number of discrete frame intervals */
+    union {
+        struct {
+            uint32_t interval_min;      /**< Shortest frame interval. interval_type == 0 */
+            uint32_t interval_max;      /**< Longest frame interval. interval_type == 0 */
+            uint32_t interval_step;     /**< Frame interval granularity. interval_type == 0 */
+        };
+        uint32_t interval[UVC_HOST_FRAME_INTERVALS_MAX]; /**< Discrete frame intervals. interval_type > 0 */
+    };
+} uvc_host_frame_info_t;
+
+/**
+ * @brief Segment of frame data
+ *
+ * Used only in zero-copy mode. The segment points directly into buffer of a USB transfer (URB)
+ */
+typedef struct {
+    const uint8_t *data; /**< Segment data */
+    size_t len;          /**< Segment data length in bytes */
+} uvc_host_frame_segment_t;
+
+/**
+ * @brief Timestamps of Video Stream frame
+ *
+ * Device timestamps are taken from payload headers, host timestamps are taken from esp_timer
+ *
+ * @see USB UVC specification ver 1.5, table 2-6
+ */
+typedef struct {
+    bool pts_valid;      /**< The device sent Presentation Time Stamp for this frame */
+    bool scr_valid;      /**< The device sent Source Clock Reference for this frame */
+    uint32_t pts;        /**< Presentation Time Stamp in device clock units */
+    uint32_t scr_stc;    /**< Source Time Clock of last Source Clock Reference received in this frame, in device clock units */
+    uint16_t scr_sof;    /**< USB bus SOF counter (11 bits) of last Source Clock Reference received in this frame */
+    int64_t host_sof_us; /**< Host time of Start of Frame reception in microseconds */
+    int64_t host_eof_us; /**< Host time of End of Frame reception in microseconds */
+} uvc_host_frame_timestamp_t;
+
+/**
+ * @brief NAL unit of H.264 or H.265 frame
+ *
+ * Position of NAL unit in Annex B byte stream of the frame, found by start codes (00 00 01) during frame reassembly
+ */
+typedef struct {
+    size_t offset; /**< Offset of NAL unit header from start of frame data. Start code is not included */
+    size_t len;    /**< NAL unit length in bytes, including NAL unit header. Start code and trailing zero bytes are not included */
+    uint8_t type;  /**< nal_unit_type from NAL unit header */
+} uvc_host_nal_unit_t;
+
+// Maximum number of damaged ranges recorded in uvc_host_frame_t
+#define UVC_HOST_FRAME_LOST_RANGES (8)
+
+// Error flags of uvc_host_frame_t
+#define UVC_HOST_FRAME_ERROR_USB    (1U << 0) /**< Packets of the frame were lost in USB transfer errors */
+#define UVC_HOST_FRAME_ERROR_HEADER (1U << 1) /**< The device set Error bit in payload headers of the frame */
+
+/**
+ * @brief Damaged range of corrupt frame
+ *
+ * Frame data in [offset; offset + len) may be damaged, up to lost_bytes of data that belong in the range were lost.
+ * Adjacent damage is merged. When all UVC_HOST_FRAME_LOST_RANGES ranges are used, the last range grows to cover further damage.
+ * JPEG decoders with restart markers can conceal the damage by resynchronizing at the first restart marker behind the range.
+ */
+typedef struct {
+    size_t offset;     /**< Offset of the range in frame data. In zero-copy mode, counts from start of the first segment across all segments */
+    size_t len;        /**< Length of received data that may be corrupted. 0 if data were only lost */
+    size_t lost_bytes; /**< Upper bound of lost data: Sizes of the lost packets, including their payload headers */
+} uvc_host_frame_lost_range_t;
+
 /**
  * @brief Video Stream frame
  *
@@ -89,11 +175,50 @@ typedef struct {
  */
 typedef struct {
     const uvc_host_stream_format_t vs_format; /**< Format of this frame buffer */
-    size_t data_buffer_len;                   /**< Max data length supported by this frame buffer */
+    size_t data_buffer_len;                   /**< Max data length supported by this frame buffer. 0 in zero-copy mode */
     size_t data_len;                          /**< Data length of currently store frame */
-    uint8_t *data;                            /**< Frame data */
+    uint8_t *data;                            /**< Frame data. NULL in zero-copy mode */
+    size_t num_segments;                      /**< Zero-copy mode only: Number of frame data segments */
+    const uvc_host_frame_segment_t *segments; /**< Zero-copy mode only: Frame data segments in order of reception */
+    uvc_host_frame_timestamp_t timestamp;     /**< Device and host timestamps of this frame */
+    size_t num_nal_units;                     /**< NAL index only: Number of indexed NAL units */
+    const uvc_host_nal_unit_t *nal_units;     /**< NAL index only: NAL units in order of appearance. In zero-copy mode, offsets count
+                                                   from start of the first segment across all segments. If the frame has more NAL units
+                                                   than advanced.nal_index_size, the data behind the last indexed NAL unit are not indexed */
+    uint32_t error_flags;                     /**< Corrupt frame delivery only: UVC_HOST_FRAME_ERROR_* flags. 0 for intact frame */
+    size_t num_lost_ranges;                   /**< Corrupt frame delivery only: Number of damaged ranges */
+    const uvc_host_frame_lost_range_t *lost_ranges; /**< Corrupt frame delivery only: Damaged ranges in order of frame data */
 } uvc_host_frame_t;
 
+// Number of buckets in frame latency histogram of uvc_host_stream_stats_t
+#define UVC_HOST_STATS_LATENCY_BUCKETS (8)
+
+/**
+ * @brief Video Stream statistics
+ *
+ * The counters are accumulated since the stream was opened or since last uvc_host_stream_reset_stats() call
+ */
+typedef struct {
+    uint32_t frames_delivered;         /**< Number of frames passed to frame callback */
+    struct {
+        uint32_t usb_error;            /**< USB transfer error while receiving the frame */
+        uint32_t header_error;         /**< Error bit set in payload header by the device */
+        uint32_t buffer_underflow;     /**< No free frame buffer at Start of Frame */
+        uint32_t buffer_overflow;      /**< Frame did not fit in frame buffer */
+        uint32_t missing_eof;          /**< New frame started before End of Frame was received */
+        uint32_t mjpeg_invalid;        /**< MJPEG validation only: Frame does not start with SOI or does not end with EOI marker */
+    } frames_dropped;                  /**< Number of dropped frames by cause */
+    uint32_t isoc_packets_skipped;     /**< ISOC only: Number of packets skipped or timed out by USB Host Library */
+    uint32_t frames_extended;          /**< Adaptive frame size only: Number of frames that did not fit in frame buffer, its buffer grew */
+    uint32_t frame_buffers_resized;    /**< Adaptive frame size only: Number of empty frame buffers resized to recent frame sizes */
+    uint32_t frames_corrupted;         /**< Corrupt frame delivery only: Number of delivered frames with error_flags. Included in frames_delivered */
+    uint64_t bytes_received;           /**< Number of received payload bytes, excluding payload headers */
+    uint32_t bytes_per_second;         /**< Average payload throughput since the statistics were reset */
+    uint32_t latency_max_us;           /**< Maximum latency between Start of Frame reception and frame callback in microseconds */
+    uint32_t latency_histogram[UVC_HOST_STATS_LATENCY_BUCKETS]; /**< Histogram of latency between Start of Frame reception and frame callback.
+                                                                     Bucket 0: < 1 ms, bucket i: <2^(i-1); 2^i) ms, last bucket: >= 64 ms */
+} uvc_host_stream_stats_t;
+
 /**
  * @brief Stream event callback type
  *
@@ -114,30 +239,139 @@ typedef void (*uvc_host_stream_callback_t)(const uvc_host_stream_event_data_t *e
  */
 typedef bool (*uvc_host_frame_callback_t)(const uvc_host_frame_t *frame, void *user_ctx);
 
+/**
+ * @brief Slice of Video Stream frame
+ *
+ * In slice mode, frame data are passed to user in slices as they are received, instead of full frames
+ */
+typedef struct {
+    const uint8_t *data;  /**< Slice data. Valid only during slice callback */
+    size_t data_len;      /**< Slice data length in bytes */
+    bool start_of_frame;  /**< This is the first slice of a frame. Slices of previous frame without end_of_frame must be discarded */
+    bool end_of_frame;    /**< This is the last slice of a frame */
+    bool frame_error;     /**< Valid with end_of_frame: The frame is corrupted, all its slices must be discarded */
+    bool pts_valid;       /**< The device sent Presentation Time Stamp for this frame */
+    uint32_t pts;         /**< Presentation Time Stamp in device clock units */
+} uvc_host_frame_slice_t;
+
+/**
+ * @brief Slice callback type
+ *
+ * The slice data are valid only during this callback. The callback is called from USB Host context, it must not block.
+ *
+ * @param[in] slice    Received frame slice
+ * @param[in] user_ctx User's argument passed to open function
+ */
+typedef void (*uvc_host_slice_callback_t)(const uvc_host_frame_slice_t *slice, void *user_ctx);
+
 /**
  * @brief Configuration structure of UVC device
  */
 typedef struct {
     uvc_host_stream_callback_t event_cb;  /**< Stream's event callback function. Can be NULL */
     uvc_host_frame_callback_t frame_cb;   /**< Stream's frame callback function */
+    uvc_host_slice_callback_t slice_cb;   /**< Stream's slice callback function. Can be NULL.
+                                               If set, frame data are passed in slices of up to frame_size bytes and frame_cb is not called.
+                                               Cannot be used with zero_copy or staging_buffer_size */
     void *user_ctx;                       /**< User's argument that will be passed to the callbacks */
     struct {
         uint16_t vid;                     /**< Device's Vendor ID. Set to 0 for any */
         uint16_t pid;                     /**< Device's Product ID. Set to 0 for any */
         uint8_t uvc_stream_index;         /**< Index of UVC function you want to use. Set to 0 to use first available UVC function */
+        uvc_host_stream_hdl_t sibling;    /**< NULL: The device is found by vid and pid.
+                                               Else: Open another UVC function of the device of this open stream, vid and pid are ignored.
+                                               Streams of one device always share its descriptors and control transfer, this selects the device explicitly */
     } usb;
     uvc_host_stream_format_t vs_format;   /**< Video Stream format. Resolution, FPS and encoding */
     struct {
-        int number_of_frame_buffers; /**< Number of frame buffers. These can be very large as they must hold the full frame.*/
+        unsigned frame_decimation;        /**< 0 or 1: Deliver all frames. N: Deliver every Nth frame, the others are discarded without being copied */
+        bool keyframes_only;              /**< H.264 and H.265 only: Deliver only frames that start with IDR/IRAP slice or parameter sets.
+                                               The other frames are discarded without being copied. In slice mode, they are reported with frame_error */
+        bool corrupt_frames;              /**< MJPEG ISOC streams only: Frames with packets lost in USB transfer errors or with Error bit in payload header
+                                               are delivered with error_flags and lost_ranges instead of being dropped. Frames that cannot be reassembled
+                                               (buffer overflow, missing End of Frame, failed mjpeg_validation) are still dropped. Cannot be used with slice_cb */
+    } delivery;
+    struct {
+        int number_of_frame_buffers; /**< Number of frame buffers, 1 to 32. These can be very large as they must hold the full frame.*/
         size_t frame_size;           /**< 0: Use dwMaxVideoFrameSize from format negotiation result (might be too large).
                                           (0; SIZE_MAX>: Use user provide frame size. */
         uint32_t frame_heap_caps;    /**< Memory capabilities for frame buffers. Directly passed to heap_caps_malloc() */
-        int number_of_urbs;          /**< Number of URBs for this stream. Triple buffering scheme is recommended */
+        int number_of_urbs;          /**< Number of URBs for this stream. Triple buffering scheme is recommended.
+                                          0: Derived automatically, 3 URBs or enough URBs to hold all frame buffers in zero-copy mode */
         size_t urb_size;             /**< Size in bytes of 1 URB, 10kB should be enough for start.
-                                          Larger value results in less frequent interrupts at the cost of memory consumption */
+                                          Larger value results in less frequent interrupts at the cost of memory consumption.
+                                          ISOC URBs are rounded up to whole milliseconds of service intervals (8 microframes in High-speed).
+                                          0: Derived automatically from the endpoint and negotiated format, Bulk URBs are further adapted at stream start */
+        bool zero_copy;              /**< Zero-copy mode: Frame data are not copied to frame buffers, the frame is passed to user as a list of segments
+                                          pointing directly into URBs. The URBs are held by the frame until it is returned to the driver.
+                                          number_of_urbs must be large enough to hold all frame buffers (max 32 URBs), frame_size and frame_heap_caps are ignored */
+        size_t staging_buffer_size;  /**< 0: Frame data are copied directly to frame buffers.
+                                          (0; SIZE_MAX>: Frame data are first copied to staging buffer of this size in internal RAM and then moved
+                                          to frame buffers by async memcpy (DMA). Recommended for frame buffers in PSRAM. Cannot be used with zero_copy */
+        struct {
+            size_t stack_size;        /**< 0: Payloads are processed and callbacks are called from USB Host client task.
+                                           (0; SIZE_MAX>: Stack size of dedicated processing task of this stream. Cannot be used with zero_copy */
+            unsigned priority;        /**< Priority of the processing task */
+            int core_id;              /**< Core affinity of the processing task. Set to tskNO_AFFINITY to run on any core */
+            int number_of_spare_urbs; /**< Spare URBs are submitted as soon as a URB completes, while the completed URB waits for processing.
+                                           Allocated on top of number_of_urbs */
+        } processing_task;
+        bool mjpeg_validation;        /**< MJPEG streams only: Drop frames that do not start with SOI or do not end with EOI marker, e.g. truncated by lost packets.
+                                           In slice mode, such frames are reported with frame_error */
+        size_t nal_index_size;        /**< H.264 and H.265 streams only: 0: NAL units are not indexed.
+                                           (0; SIZE_MAX>: Maximum number of NAL units indexed in each frame, see nal_units in uvc_host_frame_t.
+                                           Cannot be used with slice_cb */
+        uvc_host_frame_pool_hdl_t frame_pool; /**< NULL: The stream allocates its own frame buffers.
+                                                   Else: Frame data are stored in buffers of this shared pool, frame_size and frame_heap_caps are ignored
+                                                   and number_of_frame_buffers is the maximum number of pool buffers held by this stream. Cannot be used with zero_copy */
+        int frame_pool_reserved;      /**< Number of pool buffers reserved for this stream, other streams cannot take them. 0 to number_of_frame_buffers */
+        struct {
+            bool enabled;             /**< Frame buffers start at frame_size (0: 1/4 of dwMaxVideoFrameSize) and follow sizes of received frames.
+                                           Data that do not fit are stored in extension chunks, the frame buffer grows at End of Frame.
+                                           Frames larger than both dwMaxVideoFrameSize and frame_size are dropped.
+                                           Cannot be used with zero_copy, staging_buffer_size, frame_pool or slice_cb */
+            uint8_t percentile;       /**< Frame buffers are resized to this percentile of sizes of last 32 frames, 1 to 100. 0: 95 */
+            uint8_t headroom_percent; /**< Headroom added to the percentile, in percent. 0: 25 */
+        } adaptive_frame_size;
     } advanced;
 } uvc_host_stream_config_t;
 
+/**
+ * @brief Configuration of shared frame buffer pool
+ */
+typedef struct {
+    int number_of_buffers;     /**< Number of frame buffers in the pool */
+    size_t buffer_size;        /**< Size of one frame buffer in bytes. Must hold the largest frame of all streams that use the pool */
+    uint32_t buffer_heap_caps; /**< Memory capabilities for frame buffers. Directly passed to heap_caps_aligned_alloc() */
+} uvc_host_frame_pool_config_t;
+
+/**
+ * @brief Create shared frame buffer pool
+ *
+ * Several streams can take frame buffers from one pool, see `advanced.frame_pool` in uvc_host_stream_config_t.
+ * A stream takes a buffer at start of each frame and releases it when the frame is returned,
+ * so the pool is sized by the number of frames held concurrently by all streams.
+ *
+ * @param[in]  pool_config  Pool configuration
+ * @param[out] pool_hdl_ret Pool handle
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: pool_config or pool_hdl_ret is NULL or invalid pool_config
+ *     - ESP_ERR_NO_MEM: Not enough memory for the pool
+ */
+esp_err_t uvc_host_frame_pool_create(const uvc_host_frame_pool_config_t *pool_config, uvc_host_frame_pool_hdl_t *pool_hdl_ret);
+
+/**
+ * @brief Delete shared frame buffer pool
+ *
+ * @param[in] pool_hdl Pool handle
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: pool_hdl is NULL
+ *     - ESP_ERR_INVALID_STATE: Some streams that use the pool are still open
+ */
+esp_err_t uvc_host_frame_pool_delete(uvc_host_frame_pool_hdl_t pool_hdl);
+
 /**
  * @brief Install UVC driver
  *
@@ -172,7 +406,7 @@ esp_err_t uvc_host_uninstall(void);
  * @param[in]  timeout  Timeout in FreeRTOS tick
  * @return
  *     - ESP_OK: All events handled
- *     - ESP_ERR_INVALID_STATE: UVC driver not installed
+ *     - ESP_ERR_INVALID_STATE: UVC driver not installed, or installed with shared_client
  *     - ESP_ERR_TIMEOUT: No events handled within the timeout
  *     - ESP_FAIL: Event handling finished, driver uninstalled. You do not have to call this function further
  */
@@ -219,6 +453,56 @@ esp_err_t uvc_host_stream_start(uvc_host_stream_hdl_t stream_hdl);
  */
 esp_err_t uvc_host_stream_stop(uvc_host_stream_hdl_t stream_hdl);
 
+/**
+ * @brief Pause frame delivery of ISOC stream, without stopping it
+ *
+ * The alternate interface stays selected and URBs keep running, received data are dropped without being parsed.
+ * The frame being received is discarded. Unlike uvc_host_stream_stop(), no CTRL request is sent,
+ * so uvc_host_stream_fast_unpause() delivers the next complete frame without renegotiation.
+ * Periodic bandwidth stays reserved and the camera keeps streaming meanwhile.
+ *
+ * @param[in] stream_hdl UVC handle obtained from uvc_host_stream_open()
+ * @return
+ *     - ESP_OK: Success - received data are dropped
+ *     - ESP_ERR_INVALID_ARG: stream_hdl is NULL
+ *     - ESP_ERR_INVALID_STATE: Stream is not streaming
+ *     - ESP_ERR_NOT_SUPPORTED: BULK stream, it must be stopped by uvc_host_stream_stop()
+ */
+esp_err_t uvc_host_stream_fast_pause(uvc_host_stream_hdl_t stream_hdl);
+
+/**
+ * @brief Resume frame delivery paused by uvc_host_stream_fast_pause()
+ *
+ * The frame in progress is skipped, the first delivered frame is the next one that starts after this call.
+ *
+ * @param[in] stream_hdl UVC handle obtained from uvc_host_stream_open()
+ * @return
+ *     - ESP_OK: Success - frames are delivered
+ *     - ESP_ERR_INVALID_ARG: stream_hdl is NULL
+ *     - ESP_ERR_INVALID_STATE: Stream is not streaming
+ */
+esp_err_t uvc_host_stream_fast_unpause(uvc_host_stream_hdl_t stream_hdl);
+
+/**
+ * @brief Select new format of an open UVC stream
+ *
+ * The stream is stopped, new format is negotiated with the device and the stream is started again, if it was streaming.
+ * URBs and frame buffers are kept. Frame buffers are re-allocated only if they cannot hold frames of the new format
+ * (and frame_size was 0 at stream open), in that case all frames must be returned to the driver.
+ * On error, the stream is left stopped.
+ *
+ * @param[in] stream_hdl UVC handle obtained from uvc_host_stream_open()
+ * @param[in] vs_format  New Video Stream format
+ * @return
+ *     - ESP_OK: Success - new format is used
+ *     - ESP_ERR_INVALID_ARG: stream_hdl or vs_format is NULL
+ *     - ESP_ERR_NOT_FOUND: The device does not offer requested format
+ *     - ESP_ERR_INVALID_STATE: Frame buffers must be re-allocated, but some frames were not returned
+ *     - ESP_ERR_NO_MEM: Not enough memory for larger frame buffers. Previous format is kept
+ *     - Else: USB lib error
+ */
+esp_err_t uvc_host_stream_format_select(uvc_host_stream_hdl_t stream_hdl, const uvc_host_stream_format_t *vs_format);
+
 /**
  * @brief Close UVC device and release its resources
  *
@@ -235,9 +519,10 @@ esp_err_t uvc_host_stream_close(uvc_host_stream_hdl_t stream_hdl);
  *
  * Must not call this function if the frame callback returns true.
  * Must call this function after the frame is processed if the frame callback returns false.
+ * In zero-copy mode, the URBs referenced by this frame are re-submitted by this call.
  *
  * @param[in] stream_hdl UVC handle obtained from uvc_host_stream_open()
- * @param[in] frame      Frame obtained from frame callback
+ * @param[in] frame      Frame obtained from frame callback or still image callback
  * @return
  *     - ESP_OK: Success - The frame was returned to the driver
  *     - ESP_INVALID_ARG: frame or stream_hdl is NULL
@@ -245,6 +530,335 @@ esp_err_t uvc_host_stream_close(uvc_host_stream_hdl_t stream_hdl);
  */
 esp_err_t uvc_host_frame_return(uvc_host_stream_hdl_t stream_hdl, uvc_host_frame_t *frame);
 
+/**
+ * @brief Configuration of still image capture
+ *
+ * Still images are received into their own buffer pool and passed to still_cb, so the video stream can stay at low resolution
+ */
+typedef struct {
+    uvc_host_frame_callback_t still_cb; /**< Still image callback. Return value has the same meaning as in frame callback */
+    unsigned h_res;                     /**< Horizontal resolution of still images. 0 together with v_res: Largest still image offered by the format */
+    unsigned v_res;                     /**< Vertical resolution of still images */
+    int number_of_buffers;              /**< Number of still image buffers, 1 to 32 */
+    size_t buffer_size;                 /**< 0: Use dwMaxVideoFrameSize from still image negotiation.
+                                             (0; SIZE_MAX>: Use user provided buffer size */
+    uint32_t buffer_heap_caps;          /**< Memory capabilities for still image buffers. Directly passed to heap_caps_malloc() */
+} uvc_host_still_config_t;
+
+/**
+ * @brief Configure still image capture
+ *
+ * Still image format is negotiated (VS_STILL_PROBE and VS_STILL_COMMIT) for the current format of the stream
+ * and still image buffers are allocated. Previous configuration is replaced.
+ * Only still image capture method 2 (still image on video endpoint) and method 3 (dedicated Bulk still image endpoint) are supported.
+ * Must be called again after uvc_host_stream_format_select().
+ *
+ * @param[in] stream_hdl   UVC handle obtained from uvc_host_stream_open()
+ * @param[in] still_config Still image configuration. NULL: Disable still image capture and free still image buffers
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: stream_hdl is NULL or invalid still_config
+ *     - ESP_ERR_INVALID_STATE: The stream is streaming or some still images were not returned
+ *     - ESP_ERR_NOT_SUPPORTED: The device does not support still image capture method 2 or 3
+ *     - ESP_ERR_NOT_FOUND: Current format does not offer requested still image size
+ *     - ESP_ERR_NO_MEM: Not enough memory for still image buffers
+ *     - Else: USB lib error
+ */
+esp_err_t uvc_host_stream_still_config(uvc_host_stream_hdl_t stream_hdl, const uvc_host_still_config_t *still_config);
+
+/**
+ * @brief Trigger still image capture
+ *
+ * The still image is passed to still_cb. Still images are returned to the driver by uvc_host_frame_return().
+ *
+ * @param[in] stream_hdl UVC handle obtained from uvc_host_stream_open()
+ * @return
+ *     - ESP_OK: Still image capture triggered
+ *     - ESP_ERR_INVALID_ARG: stream_hdl is NULL
+ *     - ESP_ERR_INVALID_STATE: Still image capture is not configured, the stream is not streaming or previous still image is being received
+ *     - Else: USB lib error
+ */
+esp_err_t uvc_host_stream_still_trigger(uvc_host_stream_hdl_t stream_hdl);
+
+/**
+ * @brief Video Control request
+ *
+ * Request to a control of Unit or Terminal of the Video Control interface, e.g. Brightness of Processing Unit
+ * or Exposure Time of Camera Terminal. Unit IDs are listed in Video Control interface descriptors.
+ */
+typedef struct {
+    uint8_t bRequest;   /**< Request code, enum uvc_req_code */
+    uint8_t bUnitID;    /**< ID of Unit or Terminal */
+    uint8_t bSelector;  /**< Control selector, e.g. UVC_PU_BRIGHTNESS_CONTROL */
+    uint16_t wLength;   /**< Length of control data in bytes */
+    uint8_t *data;      /**< Control data. Sent in SET requests, received in GET requests */
+    esp_err_t status;   /**< Result of this request. Set by the driver before the completion callback */
+} uvc_host_ctrl_req_t;
+
+/**
+ * @brief Completion callback of Video Control requests
+ *
+ * Called from USB Host client task
+ *
+ * @param[in] reqs     Requests as passed to uvc_host_ctrl_submit(), with status of each request
+ * @param[in] num_reqs Number of requests
+ * @param[in] user_arg User's argument
+ */
+typedef void (*uvc_host_ctrl_callback_t)(uvc_host_ctrl_req_t *reqs, size_t num_reqs, void *user_arg);
+
+/**
+ * @brief Submit Video Control requests without blocking
+ *
+ * The requests are sent on EP0 back to back, in order. Failed request does not stop the following requests.
+ * ctrl_cb is called once, after the last request is finished.
+ *
+ * @param[in] stream_hdl UVC handle obtained from uvc_host_stream_open()
+ * @param[in] reqs       Requests. The array and its data must stay valid until ctrl_cb is called
+ * @param[in] num_reqs   Number of requests
+ * @param[in] ctrl_cb    Completion callback
+ * @param[in] user_arg   User's argument passed to ctrl_cb
+ * @return
+ *     - ESP_OK: Requests submitted
+ *     - ESP_ERR_INVALID_ARG: stream_hdl, reqs or ctrl_cb is NULL, num_reqs is 0 or data of a request is NULL
+ *     - ESP_ERR_NO_MEM: Not enough memory for the requests
+ *     - Else: USB lib error
+ */
+esp_err_t uvc_host_ctrl_submit(uvc_host_stream_hdl_t stream_hdl, uvc_host_ctrl_req_t *reqs, size_t num_reqs, uvc_host_ctrl_callback_t ctrl_cb, void *user_arg);
+
+/**
+ * @brief Range of Video Control
+ */
+typedef struct {
+    int32_t min; /**< GET_MIN */
+    int32_t max; /**< GET_MAX */
+    int32_t res; /**< GET_RES */
+    int32_t def; /**< GET_DEF */
+} uvc_host_ctrl_range_t;
+
+/**
+ * @brief Get range of Video Control
+ *
+ * The range is requested from the device (GET_MIN, GET_MAX, GET_RES and GET_DEF) on first call
+ * and returned from cache on following calls. The cache is kept until the stream is closed.
+ *
+ * @param[in]  stream_hdl UVC handle obtained from uvc_host_stream_open()
+ * @param[in]  bUnitID    ID of Unit or Terminal
+ * @param[in]  bSelector  Control selector
+ * @param[in]  wLength    Length of control data in bytes, 1 to 4
+ * @param[in]  is_signed  Control data are signed, e.g. Brightness
+ * @param[out] range_ret  Range of the control
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: stream_hdl or range_ret is NULL or invalid wLength
+ *     - ESP_ERR_NO_MEM: Not enough memory for cache entry
+ *     - Else: USB Control transfer error
+ */
+esp_err_t uvc_host_ctrl_get_range(uvc_host_stream_hdl_t stream_hdl, uint8_t bUnitID, uint8_t bSelector, uint16_t wLength, bool is_signed, uvc_host_ctrl_range_t *range_ret);
+
+/**
+ * @brief Find Extension Unit of the UVC function of a stream
+ *
+ * Vendor controls of the Extension Unit are sent by uvc_host_ctrl_submit() with the returned unit ID.
+ *
+ * @param[in]  stream_hdl        UVC handle obtained from uvc_host_stream_open()
+ * @param[in]  guidExtensionCode GUID of the Extension Unit, in the byte order of the descriptor
+ * @param[out] bUnitID_ret       ID of the Extension Unit
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: NULL argument
+ *     - ESP_ERR_NOT_FOUND: The UVC function has no such Extension Unit
+ */
+esp_err_t uvc_host_ctrl_find_xu(uvc_host_stream_hdl_t stream_hdl, const uint8_t guidExtensionCode[16], uint8_t *bUnitID_ret);
+
+/**
+ * @brief Encoder controls of H.264 and H.265 stream
+ */
+typedef enum {
+    UVC_HOST_ENC_NONE = 0,  /**< The stream has no encoder controls */
+    UVC_HOST_ENC_UNIT,      /**< Encoding Unit of UVC 1.5 */
+    UVC_HOST_ENC_UVCX,      /**< H.264 extension unit (UVCX) of UVC 1.1 cameras. GOP and QP cannot be set */
+} uvc_host_enc_type_t;
+
+/**
+ * @brief Encoder of a stream
+ */
+typedef struct {
+    uvc_host_enc_type_t type;   /**< Encoder controls */
+    uint8_t bUnitID;            /**< ID of Encoding Unit or UVCX extension unit */
+    uint32_t bmControls;        /**< Supported controls, bit (selector - 1), e.g. UVC_EU_AVERAGE_BITRATE_CONTROL */
+    uint32_t bmControlsRuntime; /**< Controls that can be changed while streaming. All controls for UVCX */
+} uvc_host_enc_info_t;
+
+#define UVC_HOST_ENC_SET_BITRATE (1 << 0) /**< Set average_bitrate and peak_bitrate */
+#define UVC_HOST_ENC_FORCE_IDR   (1 << 1) /**< Request IDR frame */
+#define UVC_HOST_ENC_SET_GOP     (1 << 2) /**< Set gop_ms. Encoding Unit also sends an IDR frame */
+#define UVC_HOST_ENC_SET_QP      (1 << 3) /**< Set qp_i, qp_p and qp_b */
+
+/**
+ * @brief Encoder parameters
+ *
+ * Only parameters selected in flags are sent to the camera. Bitrate and QP are sent before the IDR request,
+ * so the IDR frame is encoded with the new parameters.
+ */
+typedef struct {
+    uint32_t flags;             /**< UVC_HOST_ENC_SET_BITRATE, UVC_HOST_ENC_FORCE_IDR, UVC_HOST_ENC_SET_GOP and UVC_HOST_ENC_SET_QP */
+    uint32_t average_bitrate;   /**< Average bitrate in bits per second */
+    uint32_t peak_bitrate;      /**< Peak bitrate in bits per second. 0: Encoding Unit keeps its peak bitrate, UVCX uses average_bitrate */
+    uint16_t gop_ms;            /**< Time between IDR frames in milliseconds. 0: IDR frames only on request */
+    uint16_t qp_i;              /**< Quantization parameter of I frames */
+    uint16_t qp_p;              /**< Quantization parameter of P frames */
+    uint16_t qp_b;              /**< Quantization parameter of B frames */
+} uvc_host_enc_params_t;
+
+/**
+ * @brief Completion callback of asynchronous encoder parameters
+ *
+ * Called from USB Host client task
+ *
+ * @param[in] stream_hdl UVC handle the parameters were applied to
+ * @param[in] status     ESP_OK if the camera accepted all parameters, else result of the first failed request
+ * @param[in] user_arg   User's argument
+ */
+typedef void (*uvc_host_enc_callback_t)(uvc_host_stream_hdl_t stream_hdl, esp_err_t status, void *user_arg);
+
+/**
+ * @brief Get encoder of H.264 or H.265 stream
+ *
+ * Encoding Unit is found in the unit chain of the stream. Cameras without it are checked for the UVCX extension unit.
+ *
+ * @param[in]  stream_hdl UVC handle obtained from uvc_host_stream_open()
+ * @param[out] info_ret   Encoder of the stream. type is UVC_HOST_ENC_NONE if the stream has no encoder controls
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: stream_hdl or info_ret is NULL
+ */
+esp_err_t uvc_host_enc_get_info(uvc_host_stream_hdl_t stream_hdl, uvc_host_enc_info_t *info_ret);
+
+/**
+ * @brief Apply encoder parameters
+ *
+ * Blocks until the camera acknowledged all parameters. Can be called while streaming,
+ * for adapting the bitrate of the camera to the network.
+ *
+ * @param[in] stream_hdl UVC handle obtained from uvc_host_stream_open()
+ * @param[in] params     Encoder parameters
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: stream_hdl or params is NULL or no flag is set
+ *     - ESP_ERR_NOT_SUPPORTED: The encoder does not support a selected parameter
+ *     - ESP_ERR_INVALID_STATE: A selected parameter cannot be changed while streaming
+ *     - Else: USB Control transfer error
+ */
+esp_err_t uvc_host_enc_apply(uvc_host_stream_hdl_t stream_hdl, const uvc_host_enc_params_t *params);
+
+/**
+ * @brief Apply encoder parameters without blocking
+ *
+ * The requests are sent as one batch of Video Control requests, see uvc_host_ctrl_submit().
+ * params are copied, they need not stay valid.
+ *
+ * @param[in] stream_hdl UVC handle obtained from uvc_host_stream_open()
+ * @param[in] params     Encoder parameters
+ * @param[in] enc_cb     Completion callback
+ * @param[in] user_arg   User's argument passed to enc_cb
+ * @return
+ *     - ESP_OK: Requests submitted
+ *     - ESP_ERR_INVALID_ARG: stream_hdl, params or enc_cb is NULL or no flag is set
+ *     - ESP_ERR_NOT_SUPPORTED: The encoder does not support a selected parameter
+ *     - ESP_ERR_INVALID_STATE: A selected parameter cannot be changed while streaming
+ *     - ESP_ERR_NO_MEM: Not enough memory for the requests
+ *     - Else: USB lib error
+ */
+esp_err_t uvc_host_enc_apply_async(uvc_host_stream_hdl_t stream_hdl, const uvc_host_enc_params_t *params, uvc_host_enc_callback_t enc_cb, void *user_arg);
+
+/**
+ * @brief Get statistics of UVC stream
+ *
+ * Can be called from any task, also while streaming.
+ *
+ * @param[in]  stream_hdl UVC handle obtained from uvc_host_stream_open()
+ * @param[out] stats_ret  Stream statistics
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: stream_hdl or stats_ret is NULL
+ */
+esp_err_t uvc_host_stream_get_stats(uvc_host_stream_hdl_t stream_hdl, uvc_host_stream_stats_t *stats_ret);
+
+/**
+ * @brief Reset statistics of UVC stream
+ *
+ * @param[in] stream_hdl UVC handle obtained from uvc_host_stream_open()
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: stream_hdl is NULL
+ */
+esp_err_t uvc_host_stream_reset_stats(uvc_host_stream_hdl_t stream_hdl);
+
+/**
+ * @brief Get list of frame formats offered by the Video Streaming interface of the stream
+ *
+ * Frame formats are read from descriptor index built at stream open, no USB transfer is issued.
+ * Only formats supported by this driver are listed.
+ *
+ * @param[in]    stream_hdl UVC handle obtained from uvc_host_stream_open()
+ * @param[out]   list       Array of frame formats to be filled. Can be NULL
+ * @param[inout] list_size  In: Size of the list array. Out: Number of frame formats.
+ *                          If list is NULL, total number of frame formats is returned
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: stream_hdl or list_size is NULL
+ */
+esp_err_t uvc_host_get_frame_list(uvc_host_stream_hdl_t stream_hdl, uvc_host_frame_info_t *list, size_t *list_size);
+
+/**
+ * @brief Entry of format negotiation cache
+ *
+ * Entries can be exported, stored in non-volatile memory (e.g. as NVS blob) and imported after reboot.
+ */
+typedef struct {
+    uint16_t idVendor;                  /**< Vendor ID of the device */
+    uint16_t idProduct;                 /**< Product ID of the device */
+    uint16_t bcdDevice;                 /**< Device release number. Firmware update of the camera invalidates the entry */
+    uint8_t  bInterfaceNumber;          /**< Video Streaming interface number */
+    uvc_host_stream_format_t vs_format; /**< Requested format */
+    uvc_vs_ctrl_t vs_ctrl;              /**< Committed Video Stream control parameters */
+} uvc_host_negotiation_cache_entry_t;
+
+/**
+ * @brief Export entries of format negotiation cache
+ *
+ * @param[out]   entries     Array of entries to be filled
+ * @param[inout] num_entries In: Size of the entries array. Out: Number of exported entries
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: entries or num_entries is NULL
+ *     - ESP_ERR_INVALID_STATE: UVC driver is not installed or the cache is disabled
+ */
+esp_err_t uvc_host_negotiation_cache_export(uvc_host_negotiation_cache_entry_t *entries, size_t *num_entries);
+
+/**
+ * @brief Import entries to format negotiation cache
+ *
+ * Entries with the same key (device and format) are replaced. If the cache is full, least recently used entries are replaced.
+ *
+ * @param[in] entries     Array of entries
+ * @param[in] num_entries Number of entries
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: entries is NULL
+ *     - ESP_ERR_INVALID_STATE: UVC driver is not installed or the cache is disabled
+ */
+esp_err_t uvc_host_negotiation_cache_import(const uvc_host_negotiation_cache_entry_t *entries, size_t num_entries);
+
+/**
+ * @brief Remove all entries from format negotiation cache
+ *
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_STATE: UVC driver is not installed or the cache is disabled
+ */
+esp_err_t uvc_host_negotiation_cache_clear(void);
+
 /**
  * @brief Print device's descriptors
  *
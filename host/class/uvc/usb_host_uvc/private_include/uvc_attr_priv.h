@@ -0,0 +1,17 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "sdkconfig.h"
+
+// Functions called from transfer callbacks of video streams, placed in IRAM if CONFIG_UVC_DATA_PATH_IN_IRAM is enabled
+#if CONFIG_UVC_DATA_PATH_IN_IRAM && !CONFIG_IDF_TARGET_LINUX
+#include "esp_attr.h"
+#define UVC_DATA_PATH_ATTR IRAM_ATTR
+#else
+#define UVC_DATA_PATH_ATTR
+#endif
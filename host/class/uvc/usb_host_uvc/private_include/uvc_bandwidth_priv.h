@@ -0,0 +1,50 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "usb/usb_types_ch9.h"
+#include "uvc_types_priv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Periodic bandwidth planner
+ *
+ * All ISOC streams share periodic bandwidth of the root port. Each stream reserves bandwidth of its selected alternate interface,
+ * so streams opened later can still find an alternate that fits in the remaining bandwidth.
+ */
+
+/**
+ * @brief Select streaming alternate interface and reserve its bandwidth
+ *
+ * The alternate with the lowest bandwidth that still satisfies dwMaxPayloadTransferSize is selected.
+ * If no such alternate fits in the remaining bandwidth, the largest alternate that fits is selected and the stream is marked as degraded.
+ * Previous reservation of this stream is replaced.
+ *
+ * @param[in]  uvc_stream               UVC stream
+ * @param[in]  dwMaxPayloadTransferSize Payload size from format negotiation
+ * @param[out] intf_desc_ret            Selected interface descriptor
+ * @param[out] ep_desc_ret              Selected endpoint descriptor
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_NOT_FOUND: No alternate interface fits in the remaining bandwidth
+ */
+esp_err_t uvc_bandwidth_reserve(uvc_stream_t *uvc_stream, uint32_t dwMaxPayloadTransferSize,
+                                const usb_intf_desc_t **intf_desc_ret, const usb_ep_desc_t **ep_desc_ret);
+
+/**
+ * @brief Release bandwidth reserved by the stream
+ *
+ * @param[in] uvc_stream UVC stream
+ */
+void uvc_bandwidth_release(uvc_stream_t *uvc_stream);
+
+#ifdef __cplusplus
+}
+#endif
@@ -15,8 +15,18 @@ extern portMUX_TYPE uvc_lock;
 #define UVC_ENTER_CRITICAL()              portENTER_CRITICAL(&uvc_lock)
 #define UVC_EXIT_CRITICAL()               portEXIT_CRITICAL(&uvc_lock)
 
+// Per-stream lock. Protects members of one stream, so streams do not contend with each other
+#define UVC_STREAM_ENTER_CRITICAL(stream) portENTER_CRITICAL(&(stream)->constant.lock)
+#define UVC_STREAM_EXIT_CRITICAL(stream)  portEXIT_CRITICAL(&(stream)->constant.lock)
+
 #define UVC_ATOMIC_LOAD(x)                __atomic_load_n(&x, __ATOMIC_SEQ_CST)
+#define UVC_ATOMIC_STORE(x, v)            __atomic_store_n(&(x), (v), __ATOMIC_SEQ_CST)
 #define UVC_ATOMIC_SET_IF_NULL(x, new_x)  ({ \
                                               __typeof__(x) expected = NULL; \
                                               __atomic_compare_exchange_n(&(x), &expected, (new_x), false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); \
                                           })
+#define UVC_ATOMIC_FETCH_OR(x, v)         __atomic_fetch_or(&(x), (v), __ATOMIC_SEQ_CST)
+#define UVC_ATOMIC_FETCH_ADD(x, v)        __atomic_fetch_add(&(x), (v), __ATOMIC_SEQ_CST)
+#define UVC_ATOMIC_FETCH_SUB(x, v)        __atomic_fetch_sub(&(x), (v), __ATOMIC_SEQ_CST)
+#define UVC_ATOMIC_COMPARE_EXCHANGE(x, expected, desired) \
+                                          __atomic_compare_exchange_n(&(x), &(expected), (desired), false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
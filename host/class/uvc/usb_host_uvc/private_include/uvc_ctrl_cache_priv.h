@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include "usb/uvc_host.h"
+#include "uvc_types_priv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Video Control range cache
+ *
+ * Stores GET_MIN, GET_MAX, GET_RES and GET_DEF of Unit and Terminal controls per stream.
+ * The ranges do not change while the device is connected, so they are requested from the device only once.
+ * Values are stored raw, as received in little-endian order.
+ */
+
+/**
+ * @brief Raw range of Video Control, as received from the device
+ */
+typedef struct {
+    uint32_t min;
+    uint32_t max;
+    uint32_t res;
+    uint32_t def;
+} uvc_ctrl_cache_range_t;
+
+/**
+ * @brief Find cached range
+ *
+ * @param[in]  uvc_stream UVC stream
+ * @param[in]  bUnitID    ID of Unit or Terminal
+ * @param[in]  bSelector  Control selector
+ * @param[out] range_ret  Cached raw range
+ * @return true if the range was found in the cache
+ */
+bool uvc_ctrl_cache_get(uvc_stream_t *uvc_stream, uint8_t bUnitID, uint8_t bSelector, uvc_ctrl_cache_range_t *range_ret);
+
+/**
+ * @brief Store range
+ *
+ * Range that is already cached is not replaced
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] bUnitID    ID of Unit or Terminal
+ * @param[in] bSelector  Control selector
+ * @param[in] range      Raw range
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_NO_MEM: Not enough memory for cache entry
+ */
+esp_err_t uvc_ctrl_cache_put(uvc_stream_t *uvc_stream, uint8_t bUnitID, uint8_t bSelector, const uvc_ctrl_cache_range_t *range);
+
+/**
+ * @brief Free all cached ranges of a stream
+ *
+ * @param[in] uvc_stream UVC stream
+ */
+void uvc_ctrl_cache_free(uvc_stream_t *uvc_stream);
+
+#ifdef __cplusplus
+}
+#endif
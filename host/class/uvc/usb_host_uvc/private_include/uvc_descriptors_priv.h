@@ -9,6 +9,8 @@
 // In this file we want to have clean interface for descriptor parsing
 // So we include only files with USB specification definitions
 // This interface is also used in host_tests
+#include <stdbool.h>
+#include <stddef.h>
 #include "usb/usb_types_ch9.h"
 #include "usb/usb_types_uvc.h"
 
@@ -27,54 +29,245 @@ extern "C" {
  */
 int uvc_desc_parse_format(const uvc_format_desc_t *format_desc);
 
-esp_err_t uvc_desc_get_streaming_interface_num(
-    const usb_config_desc_t *cfg_desc,
+/**
+ * @brief Get periodic bandwidth reserved by an endpoint
+ *
+ * @param[in] ep_desc    Endpoint descriptor
+ * @param[in] high_speed The device is connected in High-speed
+ * @return Bandwidth in bytes per millisecond. 0 for non-ISOC endpoints
+ */
+uint32_t uvc_desc_ep_bandwidth(const usb_ep_desc_t *ep_desc, bool high_speed);
+
+/**
+ * @brief Get payload an endpoint delivers in one service interval
+ *
+ * @param[in] ep_desc Endpoint descriptor
+ * @return MPS multiplied by number of transactions per microframe of high-bandwidth endpoints
+ */
+uint32_t uvc_desc_ep_payload(const usb_ep_desc_t *ep_desc);
+
+/**
+ * Descriptor index
+ *
+ * Configuration descriptor is walked only once, when the stream is opened. All following lookups use the index.
+ * The index references descriptors in the configuration descriptor, so it is valid only while the device is opened.
+ */
+
+/**
+ * @brief Format with its frames
+ */
+typedef struct {
+    const uvc_format_desc_t *format_desc;  // Format descriptor
+    int format;                            // Parsed format, enum uvc_host_stream_format
+    uint8_t num_frames;                    // Number of frame descriptors of this format
+    const uvc_frame_desc_t **frames;       // Frame descriptors in order of appearance, usually ordered by bFrameIndex
+    const uvc_still_image_frame_desc_t *still_desc; // Still Image Frame descriptor of this format. NULL if the format has none
+} uvc_desc_index_format_t;
+
+/**
+ * @brief Alternate setting of Video Streaming interface
+ */
+typedef struct {
+    const usb_intf_desc_t *intf_desc;      // Interface descriptor
+    const usb_ep_desc_t *ep_desc;          // Video endpoint descriptor. NULL for zero-bandwidth alternate setting, the still image endpoint is not included
+} uvc_desc_index_alt_t;
+
+/**
+ * @brief Video Streaming interface
+ */
+typedef struct {
+    uint8_t bInterfaceNumber;              // Interface number
+    uint8_t uvc_index;                     // Index of UVC function this interface belongs to
+    uint16_t bcdUVC;                       // Version of UVC specs of the UVC function
+    uint8_t bControlInterface;             // Video Control interface of the UVC function. Needed for Unit and Terminal control requests
+    const uvc_vc_header_desc_t *vc_header_desc; // Video Control interface header of the UVC function. NULL if the function has none
+    uint16_t vc_total_length;              // Length of class-specific Video Control descriptors from vc_header_desc, bounded by the configuration
+    uint8_t bTerminalLink;                 // Output Terminal the video of this interface comes from, from VS Input Header
+    const uvc_encoding_unit_desc_t *enc_unit_desc; // Encoding Unit in the unit chain of bTerminalLink. NULL if the chain has none
+    uint8_t bStillCaptureMethod;           // Still image capture method from VS Input Header, 0 if still images are not supported
+    const usb_ep_desc_t *still_ep_desc;    // Method 3 only: Bulk still image endpoint, bEndpointAddress of Still Image Frame descriptor
+    uint8_t num_formats;                   // Number of formats
+    const uvc_desc_index_format_t *formats; // Formats in order of appearance, usually ordered by bFormatIndex
+} uvc_desc_index_intf_t;
+
+/**
+ * @brief Index of UVC descriptors in configuration descriptor
+ */
+typedef struct {
+    size_t num_intfs;                      // Number of Video Streaming interfaces
+    uvc_desc_index_intf_t *intfs;          // Video Streaming interfaces
+    size_t num_alts;                       // Number of alternate settings of all Video Streaming interfaces
+    uvc_desc_index_alt_t *alts;            // Alternate settings of all Video Streaming interfaces
+    size_t num_formats;                    // Number of formats of all Video Streaming interfaces
+    uvc_desc_index_format_t *formats;      // Formats of all Video Streaming interfaces
+    size_t alloc_size;                     // Size of the index block in bytes
+} uvc_desc_index_t;
+
+/**
+ * @brief Build descriptor index
+ *
+ * @param[in]  cfg_desc  Configuration descriptor
+ * @param[out] index_ret Descriptor index. Must be freed by uvc_desc_index_free()
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: cfg_desc or index_ret is NULL
+ *     - ESP_ERR_NO_MEM: Not enough memory for the index
+ */
+esp_err_t uvc_desc_index_build(const usb_config_desc_t *cfg_desc, uvc_desc_index_t **index_ret);
+
+/**
+ * @brief Free descriptor index
+ *
+ * @param[in] index Descriptor index
+ */
+void uvc_desc_index_free(uvc_desc_index_t *index);
+
+/**
+ * @brief Get Video Streaming interface by its number
+ *
+ * @param[in] index            Descriptor index
+ * @param[in] bInterfaceNumber Interface number
+ * @return Video Streaming interface or NULL if not found
+ */
+const uvc_desc_index_intf_t *uvc_desc_index_get_intf(const uvc_desc_index_t *index, uint8_t bInterfaceNumber);
+
+/**
+ * @brief Get Video Streaming interface that offers requested format
+ *
+ * @param[in]  index     Descriptor index
+ * @param[in]  uvc_index Index of UVC function
+ * @param[in]  vs_format Requested format
+ * @param[out] intf_ret  Video Streaming interface
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: index, vs_format or intf_ret is NULL
+ *     - ESP_ERR_NOT_FOUND: No interface of the UVC function offers the format
+ */
+esp_err_t uvc_desc_index_get_streaming_intf(
+    const uvc_desc_index_t *index,
     uint8_t uvc_index,
     const uvc_host_stream_format_t *vs_format,
-    uint16_t *bcdUVC,
-    uint8_t *bInterfaceNumber);
+    const uvc_desc_index_intf_t **intf_ret);
 
 /**
- * @brief Get Streaming Interface and Endpoint descriptors
- *
- * We go through all alternate interfaces and pick the one that offers endpoint with MPS that:
- * * Is lower than or equal to dwMaxPayloadTransferSize
- * * Has as few as possible extra transactions per microframe (HS only)
+ * @brief Get Streaming Interface and Endpoint descriptors with the lowest sufficient bandwidth
  *
- * @note The caller is responsible for dwMaxPayloadTransferSize fitting in the IN FIFO
+ * We go through all alternate interfaces that fit in max_payload and max_bandwidth and pick:
+ * * The one with the lowest bandwidth whose payload per service interval (MPS * mult) is at least dwMaxPayloadTransferSize
+ * * If there is no such alternate, the one with the largest payload per service interval
  *
- * @param[in] cfg_desc                 Configuration descriptor
+ * @param[in] index                    Descriptor index
  * @param[in] bInterfaceNumber         Index of Streaming interface
- * @param[in] dwMaxPayloadTransferSize Maximum requested MPS
+ * @param[in] dwMaxPayloadTransferSize Payload size from format negotiation
+ * @param[in] max_payload              Maximum payload per service interval that fits in the IN FIFO
+ * @param[in] max_bandwidth            Available periodic bandwidth in bytes per millisecond
+ * @param[in] high_speed               The device is connected in High-speed
  * @param[out] intf_desc_ret           Interface descriptor
  * @param[out] ep_desc_ret             Endpoint descriptor
  * @return
  *     - ESP_OK: Success
- *     - ESP_ERR_INVALID_ARG: cfg_desc, intf_desc_ret or ep_desc_ret is NULL
- *     - ESP_ERR_NOT_FOUND: Could not find interface with required parameters
+ *     - ESP_ERR_INVALID_ARG: index, intf_desc_ret or ep_desc_ret is NULL
+ *     - ESP_ERR_NOT_FOUND: No alternate interface fits in max_payload and max_bandwidth
  */
-esp_err_t uvc_desc_get_streaming_intf_and_ep(
-    const usb_config_desc_t *cfg_desc,
+esp_err_t uvc_desc_index_get_intf_and_ep_by_bandwidth(
+    const uvc_desc_index_t *index,
     uint8_t bInterfaceNumber,
-    uint16_t dwMaxPayloadTransferSize,
+    uint32_t dwMaxPayloadTransferSize,
+    uint32_t max_payload,
+    uint32_t max_bandwidth,
+    bool high_speed,
     const usb_intf_desc_t **intf_desc_ret,
     const usb_ep_desc_t **ep_desc_ret);
 
-esp_err_t uvc_desc_get_frame_format_by_index(
-    const usb_config_desc_t *cfg_desc,
-    uint8_t bInterfaceNumber,
+/**
+ * @brief Get Format and Frame descriptors by their indexes
+ *
+ * @param[in]  intf            Video Streaming interface
+ * @param[in]  bFormatIndex    Format index, from 1
+ * @param[in]  bFrameIndex     Frame index, from 1
+ * @param[out] format_desc_ret Format descriptor
+ * @param[out] frame_desc_ret  Frame descriptor
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: Invalid index or NULL argument
+ *     - ESP_ERR_NOT_FOUND: Format or frame not found
+ */
+esp_err_t uvc_desc_index_get_frame_format_by_index(
+    const uvc_desc_index_intf_t *intf,
     uint8_t bFormatIndex,
     uint8_t bFrameIndex,
     const uvc_format_desc_t **format_desc_ret,
     const uvc_frame_desc_t **frame_desc_ret);
 
-esp_err_t uvc_desc_get_frame_format_by_format(
-    const usb_config_desc_t *cfg_desc,
-    uint8_t bInterfaceNumber,
+/**
+ * @brief Get Format and Frame descriptors that match requested format
+ *
+ * @param[in]  intf            Video Streaming interface
+ * @param[in]  vs_format       Requested format
+ * @param[out] format_desc_ret Format descriptor. Can be NULL
+ * @param[out] frame_desc_ret  Frame descriptor. Can be NULL
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: intf or vs_format is NULL
+ *     - ESP_ERR_NOT_FOUND: The interface does not offer requested format
+ */
+esp_err_t uvc_desc_index_get_frame_format_by_format(
+    const uvc_desc_index_intf_t *intf,
     const uvc_host_stream_format_t *vs_format,
     const uvc_format_desc_t **format_desc_ret,
     const uvc_frame_desc_t **frame_desc_ret);
 
+/**
+ * @brief Get still image size offered by a format
+ *
+ * @param[in]    intf                  Video Streaming interface
+ * @param[in]    bFormatIndex          Format index, from 1
+ * @param[inout] h_res                 In: Requested horizontal resolution, 0 for the largest still image. Out: Found resolution
+ * @param[inout] v_res                 In: Requested vertical resolution, 0 for the largest still image. Out: Found resolution
+ * @param[out]   bFrameIndex_ret       Index of the image size pattern, from 1
+ * @param[out]   bCompressionIndex_ret Index of the first compression pattern, from 1. 0 if no compression pattern is offered
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: NULL argument
+ *     - ESP_ERR_NOT_FOUND: The format has no Still Image Frame descriptor or it does not offer requested size
+ */
+esp_err_t uvc_desc_index_get_still_frame(
+    const uvc_desc_index_intf_t *intf,
+    uint8_t bFormatIndex,
+    unsigned *h_res,
+    unsigned *v_res,
+    uint8_t *bFrameIndex_ret,
+    uint8_t *bCompressionIndex_ret);
+
+/**
+ * @brief Get list of frame formats offered by Video Streaming interface
+ *
+ * @param[in]    intf      Video Streaming interface
+ * @param[out]   list      Array of frame formats to be filled. Can be NULL
+ * @param[inout] list_size In: Size of the list array. Out: Number of filled frame formats, or total number if list is NULL
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: intf or list_size is NULL
+ */
+esp_err_t uvc_desc_index_get_frame_list(const uvc_desc_index_intf_t *intf, uvc_host_frame_info_t *list, size_t *list_size);
+
+/**
+ * @brief Get Extension Unit of the UVC function of Video Streaming interface
+ *
+ * @param[in] intf              Video Streaming interface
+ * @param[in] guidExtensionCode GUID of the extension unit, in the byte order of the descriptor
+ * @return Extension Unit descriptor or NULL if the UVC function has no such unit
+ */
+const uvc_extension_unit_desc_t *uvc_desc_index_get_xu(const uvc_desc_index_intf_t *intf, const uint8_t guidExtensionCode[16]);
+
+/**
+ * @brief Get bmControls of Extension Unit
+ *
+ * @param[in] xu_desc Extension Unit descriptor
+ * @return Bitmap of supported controls, bit (selector - 1). First 4 bytes of bmControls only
+ */
+uint32_t uvc_desc_xu_get_controls(const uvc_extension_unit_desc_t *xu_desc);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,64 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include "usb/uvc_host.h"
+#include "uvc_descriptors_priv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Encoder controls
+ *
+ * Encoder parameters are translated to Video Control requests of Encoding Unit or UVCX extension unit.
+ * The requests are sent blocking or as one asynchronous batch.
+ */
+
+#define UVC_ENC_REQS_MAX      (5)  // Bitrate, peak bitrate, QP and IDR as GET_CUR and SET_CUR
+#define UVC_ENC_DATA_SIZE     (32) // Control data of all requests
+
+/**
+ * @brief Video Control requests of encoder parameters
+ */
+typedef struct {
+    uvc_host_ctrl_req_t reqs[UVC_ENC_REQS_MAX]; // Requests in order of sending
+    size_t num_reqs;                            // Number of requests
+    uint8_t data[UVC_ENC_DATA_SIZE];            // Control data referenced by the requests
+} uvc_enc_reqs_t;
+
+/**
+ * @brief Get encoder of Video Streaming interface
+ *
+ * @param[in]  intf     Video Streaming interface
+ * @param[out] info_ret Encoder. type is UVC_HOST_ENC_NONE if the interface has no encoder controls
+ */
+void uvc_enc_get_info(const uvc_desc_index_intf_t *intf, uvc_host_enc_info_t *info_ret);
+
+/**
+ * @brief Build Video Control requests of encoder parameters
+ *
+ * IDR request of Encoding Unit without new GOP reads current Synchronization control and writes it back
+ * from the same data, so the GOP of the camera is kept.
+ *
+ * @param[in]  info      Encoder
+ * @param[in]  params    Encoder parameters
+ * @param[in]  streaming The stream is streaming, only runtime controls can be changed
+ * @param[out] reqs_ret  Requests. data of the requests point into reqs_ret, it must not be copied
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: No flag is set
+ *     - ESP_ERR_NOT_SUPPORTED: The encoder does not support a selected parameter
+ *     - ESP_ERR_INVALID_STATE: A selected parameter cannot be changed while streaming
+ */
+esp_err_t uvc_enc_build_reqs(const uvc_host_enc_info_t *info, const uvc_host_enc_params_t *params, bool streaming, uvc_enc_reqs_t *reqs_ret);
+
+#ifdef __cplusplus
+}
+#endif
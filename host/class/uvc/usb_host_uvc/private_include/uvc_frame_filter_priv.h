@@ -0,0 +1,51 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "uvc_types_priv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Frame delivery filters
+ *
+ * Frames that are not wanted by the user are discarded during reassembly, before their data are copied to frame buffer:
+ * - Decimation: Only every Nth frame is delivered. Discarded frames do not take a frame buffer
+ * - Keyframes only (H.264 and H.265): Frames are classified by the first slice NAL unit
+ */
+
+/**
+ * @brief Apply delivery filters at Start of Frame
+ *
+ * Must be called for every new frame, so the decimation can count the frames.
+ *
+ * @param[in] uvc_stream UVC stream
+ * @return true if this frame must be discarded
+ */
+bool uvc_frame_filter_sof(uvc_stream_t *uvc_stream);
+
+/**
+ * @brief Apply delivery filters to frame data
+ *
+ * Called before the data are added to the frame.
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] data       Pointer to data
+ * @param[in] data_len   Data length in bytes
+ * @return true if this frame must be discarded
+ */
+bool uvc_frame_filter_data(uvc_stream_t *uvc_stream, const uint8_t *data, size_t data_len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,74 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "usb/uvc_host.h"
+#include "uvc_types_priv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Shared frame buffer pool
+ *
+ * Streams that use the pool keep their own frame objects, only frame data buffers are taken from the pool.
+ * A data buffer is taken at Start of Frame and given back when the frame is returned to the driver.
+ *
+ * Each stream can reserve buffers that other streams cannot take, up to its maximum (number_of_frame_buffers).
+ * Buffers above the reservation are shared on first come, first served basis.
+ */
+
+/**
+ * @brief Attach stream to the pool
+ *
+ * @param[in] pool       Frame buffer pool
+ * @param[in] uvc_stream UVC stream
+ * @param[in] reserved   Number of buffers reserved for this stream
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_NO_MEM: Not enough unreserved buffers in the pool
+ */
+esp_err_t uvc_frame_pool_attach(uvc_host_frame_pool_hdl_t pool, uvc_stream_t *uvc_stream, unsigned reserved);
+
+/**
+ * @brief Detach stream from its pool
+ *
+ * @attention All frames of the stream must be returned
+ * @param[in] uvc_stream UVC stream. Nothing is done if the stream is not attached
+ */
+void uvc_frame_pool_detach(uvc_stream_t *uvc_stream);
+
+/**
+ * @brief Get size of pool buffers
+ *
+ * @param[in] pool Frame buffer pool
+ * @return Size of one buffer in bytes
+ */
+size_t uvc_frame_pool_buffer_size(uvc_host_frame_pool_hdl_t pool);
+
+/**
+ * @brief Take data buffer from the pool
+ *
+ * Can be called from USB transfer callback
+ *
+ * @param[in] uvc_stream UVC stream
+ * @return Data buffer or NULL if the stream reached its maximum or no unreserved buffer is free
+ */
+uint8_t *uvc_frame_pool_take(uvc_stream_t *uvc_stream);
+
+/**
+ * @brief Give data buffer back to the pool
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] data       Data buffer taken by uvc_frame_pool_take()
+ */
+void uvc_frame_pool_give(uvc_stream_t *uvc_stream, uint8_t *data);
+
+#ifdef __cplusplus
+}
+#endif
@@ -9,6 +9,8 @@
 #include "usb/uvc_host.h"
 #include "uvc_types_priv.h"
 
+#define UVC_FRAME_MAX_BUFFERS (32) // Ownership of frame buffers is tracked in a 32-bit mask
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -17,7 +19,7 @@ extern "C" {
  * @brief Allocate frame buffers for UVC stream
  *
  * @param[in] uvc_stream UVC stream handle
- * @param[in] nb_of_fb   Number of frame buffers to allocate
+ * @param[in] nb_of_fb   Number of frame buffers to allocate, 1 to UVC_FRAME_MAX_BUFFERS
  * @param[in] fb_size    Size of 1 frame buffer in bytes
  * @param[in] fb_caps    Memory capabilities of memory for frame buffers
  * @return
@@ -48,6 +50,8 @@ bool uvc_frame_are_all_returned(uvc_stream_t *uvc_stream);
 /**
  * @brief Get empty frame buffer
  *
+ * Lock-free, can be called from USB transfer callback while the user returns frames from other tasks.
+ *
  * @param[in] uvc_stream UVC stream
  * @return Pointer to empty frame buffer. Can be NULL if not frame buffer is available.
  */
@@ -66,14 +70,146 @@ uvc_host_frame_t *uvc_frame_get_empty(uvc_stream_t *uvc_stream);
  */
 esp_err_t uvc_frame_add_data(uvc_host_frame_t *frame, const uint8_t *data, size_t data_len);
 
+/**
+ * @brief Add data from USB transfer to the frame buffer
+ *
+ * In copy mode, the data are copied to the frame buffer with uvc_frame_add_data().
+ * In zero-copy mode, only a new segment is added to the frame and the transfer is referenced by the frame.
+ * In slice mode, full frame buffer is passed to the user as a slice and the rest of data is written from its beginning.
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] frame      Frame buffer
+ * @param[in] transfer   USB transfer that holds the data
+ * @param[in] data       Pointer to data inside of the transfer's data buffer
+ * @param[in] data_len   Data length in bytes
+ * @return
+ *     - ESP_OK: Data added to the frame buffer
+ *     - ESP_ERR_INVALID_ARG: frame or data is NULL
+ *     - ESP_ERR_INVALID_SIZE: Frame buffer overflow
+ */
+esp_err_t uvc_frame_add_urb_data(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame, usb_transfer_t *transfer, const uint8_t *data, size_t data_len);
+
+/**
+ * @brief Check JPEG markers of a frame
+ *
+ * The markers are tracked while the data are added to the frame, so this works in all frame modes.
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] frame      Frame buffer. Can be NULL
+ * @return true if MJPEG validation is disabled, frame is NULL or the frame starts with SOI and ends with EOI marker
+ */
+bool uvc_frame_mjpeg_is_valid(const uvc_stream_t *uvc_stream, const uvc_host_frame_t *frame);
+
+/**
+ * @brief Record damage of the current frame
+ *
+ * Corrupt frame delivery only. The damage starts at the current end of frame data, so data that may be corrupted
+ * must be added after this call. The frame is delivered with the error flag and the damaged range.
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] frame      Frame buffer, can be NULL
+ * @param[in] error      UVC_HOST_FRAME_ERROR_* flag
+ * @param[in] len        Length of data that may be corrupted, added next
+ * @param[in] lost_bytes Upper bound of lost data
+ * @return false if corrupt frame delivery is disabled for this stream, frame is NULL or the frame is skipped: The frame must be skipped
+ */
+bool uvc_frame_add_error(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame, uint32_t error, size_t len, size_t lost_bytes);
+
+/**
+ * @brief Set maximum frame size of adaptive frame size mode
+ *
+ * Size of extension chunks is derived from the maximum frame size and the history of frame sizes is cleared.
+ * Must be called only when not streaming.
+ *
+ * @param[in] uvc_stream     UVC stream
+ * @param[in] max_frame_size Frames larger than this are dropped
+ */
+void uvc_frame_adaptive_set_max_size(uvc_stream_t *uvc_stream, size_t max_frame_size);
+
+/**
+ * @brief End frame in adaptive frame size mode
+ *
+ * Must be called at End of Frame of a frame that is not skipped, before uvc_frame_finish().
+ * Frame size is recorded and extension chunks are merged into the frame buffer, which grows to hold the whole frame.
+ * Does nothing if adaptive frame size is disabled.
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] frame      Frame buffer, can be NULL
+ * @return
+ *     - ESP_OK: The frame is complete in its frame buffer
+ *     - ESP_ERR_NO_MEM: Frame buffer could not grow, the frame must be dropped
+ */
+esp_err_t uvc_frame_adaptive_end(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame);
+
+/**
+ * @brief Finish frame reconstruction
+ *
+ * Must be called at End of Frame, before the frame is passed to the user.
+ * If staging is used, this function waits until all frame data are copied to the frame buffer.
+ * Timestamps of current frame are copied to the frame buffer.
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] frame      Frame buffer
+ */
+void uvc_frame_finish(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame);
+
+/**
+ * @brief Pass the last slice of a frame to the user
+ *
+ * Slice mode only. Must be called at End of Frame, after uvc_frame_finish().
+ *
+ * @param[in] uvc_stream  UVC stream
+ * @param[in] frame       Frame buffer
+ * @param[in] frame_error The frame is corrupted
+ */
+void uvc_frame_slice_end(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame, bool frame_error);
+
 /**
  * @brief Reset a frame buffer
  *
  * All data in the frame buffer will be lost.
+ * In zero-copy mode, all URBs referenced by this frame are released.
  *
- * @param[in] frame Frame buffer
+ * @param[in] uvc_stream UVC stream
+ * @param[in] frame      Frame buffer
+ */
+void uvc_frame_reset(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame);
+
+/**
+ * @brief Acquire USB transfer for processing
+ *
+ * Must be called from transfer callback before the transfer data are processed.
+ * In zero-copy mode, this prevents the transfer from being re-submitted while its data are being processed.
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] transfer   Completed USB transfer
+ */
+void uvc_frame_urb_acquire(uvc_stream_t *uvc_stream, usb_transfer_t *transfer);
+
+/**
+ * @brief Finish processing of USB transfer
+ *
+ * Must be called from transfer callback after the transfer data were processed.
+ * The transfer is re-submitted if streaming is on and (zero-copy mode only) no frame references it.
+ *
+ * In zero-copy mode, if the current frame references all URBs of this stream, no URB would be left for reception.
+ * In this case the current frame is discarded and UVC_HOST_FRAME_BUFFER_OVERFLOW event is generated.
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] transfer   Completed USB transfer
+ */
+void uvc_frame_urb_done(uvc_stream_t *uvc_stream, usb_transfer_t *transfer);
+
+/**
+ * @brief Check whether the USB transfer can be submitted
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] index      Index of the transfer in uvc_stream->constant.xfers
+ * @return
+ *     - true:  The transfer is not referenced by any frame
+ *     - false: The transfer is referenced by a frame (zero-copy mode only)
  */
-void uvc_frame_reset(uvc_host_frame_t *frame);
+bool uvc_frame_urb_is_free(uvc_stream_t *uvc_stream, unsigned index);
 
 #ifdef __cplusplus
 }
@@ -10,6 +10,7 @@
 #include "esp_idf_version.h"
 
 // @todo fix the hard-coded number here: Should be taken from HAL FIFO config in future versions of esp-idf
+// IN FIFO must hold all transactions of one (micro)frame, so it limits MPS * mult of high-bandwidth endpoints too
 #if (CONFIG_IDF_TARGET_ESP32P4)
 #define MAX_MPS_IN 4096
 #else
@@ -21,3 +22,18 @@
 #if !(ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 4) && ESP_IDF_VERSION != ESP_IDF_VERSION_VAL(5, 2, 0))
 #define USB_EP_DESC_GET_MULT(desc_ptr) (((desc_ptr)->wMaxPacketSize & 0x1800) >> 11)
 #endif
+
+// esp_cache_msync() was introduced in IDF v5.1
+#define UVC_HAS_ESP_CACHE (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0))
+
+// Async memcpy handle was renamed in IDF v5.2. Transfer alignment fields were replaced in IDF v5.4
+#if (ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 2, 0))
+#define async_memcpy_handle_t async_memcpy_t
+#endif
+#define UVC_ASYNC_MEMCPY_HAS_TRANS_ALIGN (ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 4, 0))
+
+// High-speed support (USB_SPEED_HIGH) was introduced in IDF v5.3
+#define UVC_HAS_USB_SPEED_HIGH (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0))
+
+// Root port suspend and resume, with device suspended and resumed client events, were introduced in IDF v6.0
+#define UVC_HAS_ROOT_PORT_SUSPEND (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(6, 0, 0))
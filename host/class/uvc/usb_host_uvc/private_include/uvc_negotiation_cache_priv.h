@@ -0,0 +1,69 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include "usb/uvc_host.h"
+#include "uvc_types_priv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Format negotiation cache
+ *
+ * Stores committed Video Stream control parameters per device and format.
+ * On next negotiation of the same format, the cached parameters are committed directly.
+ */
+
+/**
+ * @brief Initialize format negotiation cache
+ *
+ * @param[in] num_entries Number of cache entries. 0 disables the cache
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_NO_MEM: Not enough memory for the cache
+ *     - ESP_ERR_INVALID_STATE: The cache is already initialized
+ */
+esp_err_t uvc_negotiation_cache_init(size_t num_entries);
+
+/**
+ * @brief Deinitialize format negotiation cache
+ */
+void uvc_negotiation_cache_deinit(void);
+
+/**
+ * @brief Find cached negotiation result
+ *
+ * @param[in]  uvc_stream   UVC stream
+ * @param[in]  vs_format    Requested format
+ * @param[out] vs_ctrl_ret  Cached Video Stream control parameters
+ * @return true if the result was found in the cache
+ */
+bool uvc_negotiation_cache_get(const uvc_stream_t *uvc_stream, const uvc_host_stream_format_t *vs_format, uvc_vs_ctrl_t *vs_ctrl_ret);
+
+/**
+ * @brief Store negotiation result
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] vs_format  Requested format
+ * @param[in] vs_ctrl    Committed Video Stream control parameters
+ */
+void uvc_negotiation_cache_put(const uvc_stream_t *uvc_stream, const uvc_host_stream_format_t *vs_format, const uvc_vs_ctrl_t *vs_ctrl);
+
+/**
+ * @brief Remove negotiation result, e.g. after the device rejected it
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] vs_format  Requested format
+ */
+void uvc_negotiation_cache_remove(const uvc_stream_t *uvc_stream, const uvc_host_stream_format_t *vs_format);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,84 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "usb/usb_types_uvc.h"
+#include "usb/uvc_host.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Get Presentation Time Stamp from payload header
+ *
+ * @see USB UVC specification ver 1.5, table 2-6
+ *
+ * @param[in]  header Payload header
+ * @param[out] pts    Presentation Time Stamp in device clock units
+ * @return
+ *     - true:  The header contains PTS
+ *     - false: The header does not contain PTS
+ */
+static inline bool uvc_payload_header_get_pts(const uvc_payload_header_t *header, uint32_t *pts)
+{
+    if (!header->bmHeaderInfo.presentation_time || header->bHeaderLength < 6) {
+        return false;
+    }
+    const uint8_t *field = (const uint8_t *)header + 2; // dwPresentationTime follows bmHeaderInfo
+    *pts = field[0] | (field[1] << 8) | (field[2] << 16) | ((uint32_t)field[3] << 24);
+    return true;
+}
+
+/**
+ * @brief Get Source Clock Reference from payload header
+ *
+ * @see USB UVC specification ver 1.5, table 2-6
+ *
+ * @param[in]  header Payload header
+ * @param[out] stc    Source Time Clock in device clock units
+ * @param[out] sof    USB bus SOF counter, 11 bits
+ * @return
+ *     - true:  The header contains SCR
+ *     - false: The header does not contain SCR
+ */
+static inline bool uvc_payload_header_get_scr(const uvc_payload_header_t *header, uint32_t *stc, uint16_t *sof)
+{
+    const size_t offset = header->bmHeaderInfo.presentation_time ? 6 : 2; // SCR follows PTS, if present
+    if (!header->bmHeaderInfo.source_clock_reference || header->bHeaderLength < offset + 6) {
+        return false;
+    }
+    const uint8_t *field = (const uint8_t *)header + offset;
+    *stc = field[0] | (field[1] << 8) | (field[2] << 16) | ((uint32_t)field[3] << 24);
+    *sof = (field[4] | (field[5] << 8)) & 0x07FF;
+    return true;
+}
+
+/**
+ * @brief Update frame timestamps from payload header
+ *
+ * PTS is the same in all payloads of one frame. SCR can differ, the last received SCR is kept.
+ *
+ * @param[in]    header    Payload header
+ * @param[inout] timestamp Timestamps of current frame
+ */
+static inline void uvc_payload_header_get_timestamps(const uvc_payload_header_t *header, uvc_host_frame_timestamp_t *timestamp)
+{
+    if (uvc_payload_header_get_pts(header, &timestamp->pts)) {
+        timestamp->pts_valid = true;
+    }
+    if (uvc_payload_header_get_scr(header, &timestamp->scr_stc, &timestamp->scr_sof)) {
+        timestamp->scr_valid = true;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,98 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "usb/usb_host.h"
+#include "usb/uvc_host.h"
+#include "uvc_types_priv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Dedicated processing task of UVC stream
+ *
+ * By default, payloads are parsed and user's callbacks are called from the USB Host client task,
+ * which is shared by all streams and all other USB Host clients.
+ * With processing task, the URB callback only queues the completed URB and submits a spare URB,
+ * so the endpoint is kept busy while the payload is processed in a task with user defined priority and core affinity.
+ */
+
+/**
+ * @brief Create processing task of UVC stream
+ *
+ * Must be called before the URBs are allocated: URB completion callback depends on it.
+ *
+ * @param[in] uvc_stream     UVC stream
+ * @param[in] stream_config  Stream configuration
+ * @param[in] num_of_urbs    Total number of URBs of this stream, including spare URBs
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_INVALID_ARG: Invalid number of spare URBs
+ *     - ESP_ERR_NO_MEM: Not enough memory for the task or its queues
+ */
+esp_err_t uvc_processing_init(uvc_stream_t *uvc_stream, const uvc_host_stream_config_t *stream_config, unsigned num_of_urbs);
+
+/**
+ * @brief Delete processing task of UVC stream
+ *
+ * Waits until the task finishes processing of already queued URBs. Does nothing if the processing task is not used.
+ *
+ * @attention The caller must ensure that the stream is not streaming
+ * @param[in] uvc_stream UVC stream
+ */
+void uvc_processing_deinit(uvc_stream_t *uvc_stream);
+
+/**
+ * @brief Wait until no URB of the stream is submitted or processed
+ *
+ * URBs are not cancelled when the stream is paused, they complete and are dropped by the processing task.
+ * Must be called before the stream is marked as streaming again, otherwise the completed URBs would be submitted again.
+ *
+ * @param[in] uvc_stream UVC stream
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_TIMEOUT: URBs of previous streaming did not finish
+ */
+esp_err_t uvc_processing_wait_idle(uvc_stream_t *uvc_stream);
+
+/**
+ * @brief Submit URBs of the stream
+ *
+ * Only URBs that are not spare are submitted, the rest is kept for URB callback.
+ * All URBs must be idle, see uvc_processing_wait_idle().
+ *
+ * @param[in] uvc_stream UVC stream
+ * @return
+ *     - ESP_OK: Success
+ *     - Error from usb_host_transfer_submit()
+ */
+esp_err_t uvc_processing_start(uvc_stream_t *uvc_stream);
+
+/**
+ * @brief URB callback of streams with processing task
+ *
+ * Called from USB Host client task. Queues the URB for the processing task.
+ *
+ * @param[in] transfer Completed URB
+ */
+void uvc_processing_transfer_cb(usb_transfer_t *transfer);
+
+/**
+ * @brief Processing of URB data is finished
+ *
+ * Called from the processing task. The URB is re-submitted or kept as spare.
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] transfer   Processed URB
+ */
+void uvc_processing_urb_done(uvc_stream_t *uvc_stream, usb_transfer_t *transfer);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,84 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "usb/uvc_host.h"
+#include "uvc_types_priv.h"
+
+// Alignment of staging slots and frame buffers. Covers cache line size and DMA alignment requirements of all targets
+#define UVC_STAGING_ALIGN (64)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Staging of frame data in internal RAM
+ *
+ * Frame data are first copied to a small ring of slots in internal RAM. Once a slot is full,
+ * it is moved to the frame buffer by async memcpy (DMA). This way, the CPU does not write to PSRAM directly.
+ */
+
+/**
+ * @brief Initialize staging ring for UVC stream
+ *
+ * @param[in] uvc_stream   UVC stream
+ * @param[in] staging_size Size of the staging ring in bytes
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_NO_MEM: Not enough memory for the staging ring
+ *     - ESP_ERR_NOT_SUPPORTED: Async memcpy is not supported on this target
+ *     - ESP_ERR_INVALID_ARG: Staging size is too small
+ */
+esp_err_t uvc_staging_init(uvc_stream_t *uvc_stream, size_t staging_size);
+
+/**
+ * @brief Deinitialize staging ring
+ *
+ * @attention The caller must ensure that the stream is not streaming
+ * @param[in] uvc_stream UVC stream
+ */
+void uvc_staging_deinit(uvc_stream_t *uvc_stream);
+
+/**
+ * @brief Add data to the frame buffer through staging ring
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] frame      Frame buffer
+ * @param[in] data       Pointer to data
+ * @param[in] data_len   Data length in bytes
+ * @return
+ *     - ESP_OK: Data added to the staging ring
+ *     - ESP_ERR_INVALID_ARG: frame or data is NULL
+ *     - ESP_ERR_INVALID_SIZE: Frame buffer overflow
+ *     - ESP_ERR_TIMEOUT: No free staging slot
+ */
+esp_err_t uvc_staging_add_data(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame, const uint8_t *data, size_t data_len);
+
+/**
+ * @brief Move all staged data to the frame buffer and wait for the copy to finish
+ *
+ * After this call, the frame buffer contains all the data and can be passed to the user.
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] frame      Frame buffer
+ */
+void uvc_staging_flush(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame);
+
+/**
+ * @brief Discard staged data of a frame buffer
+ *
+ * Waits for ongoing copies to this frame buffer to finish. Does nothing if the frame is not being staged.
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] frame      Frame buffer
+ */
+void uvc_staging_discard(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,117 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "usb/uvc_host.h"
+#include "uvc_types_priv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Causes of dropped frames
+ */
+typedef enum {
+    UVC_STATS_DROP_USB_ERROR = 0,
+    UVC_STATS_DROP_HEADER_ERROR,
+    UVC_STATS_DROP_BUFFER_UNDERFLOW,
+    UVC_STATS_DROP_BUFFER_OVERFLOW,
+    UVC_STATS_DROP_MISSING_EOF,
+    UVC_STATS_DROP_MJPEG_INVALID,
+} uvc_stats_drop_t;
+
+/**
+ * @brief Get current host time
+ *
+ * @return Time in microseconds
+ */
+int64_t uvc_stats_time_us(void);
+
+/**
+ * @brief Reset statistics of UVC stream
+ *
+ * @param[in] uvc_stream UVC stream
+ */
+void uvc_stats_reset(uvc_stream_t *uvc_stream);
+
+/**
+ * @brief Record Start of Frame reception time
+ *
+ * Timestamps of previous frame are cleared.
+ *
+ * @param[in] uvc_stream UVC stream
+ */
+void uvc_stats_sof(uvc_stream_t *uvc_stream);
+
+/**
+ * @brief Account a dropped frame
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] cause      Cause of the drop
+ */
+void uvc_stats_frame_dropped(uvc_stream_t *uvc_stream, uvc_stats_drop_t cause);
+
+/**
+ * @brief Account a frame that is about to be passed to frame callback
+ *
+ * Latency is measured from the last uvc_stats_sof() call.
+ *
+ * @param[in] uvc_stream UVC stream
+ */
+void uvc_stats_frame_delivered(uvc_stream_t *uvc_stream);
+
+/**
+ * @brief Account a delivered frame with error flags
+ *
+ * Corrupt frame delivery only. The frame is also accounted by uvc_stats_frame_delivered().
+ *
+ * @param[in] uvc_stream UVC stream
+ */
+void uvc_stats_frame_corrupted(uvc_stream_t *uvc_stream);
+
+/**
+ * @brief Account a frame that was completed in extension chunks
+ *
+ * Adaptive frame size only.
+ *
+ * @param[in] uvc_stream UVC stream
+ */
+void uvc_stats_frame_extended(uvc_stream_t *uvc_stream);
+
+/**
+ * @brief Account a resized frame buffer
+ *
+ * Adaptive frame size only.
+ *
+ * @param[in] uvc_stream UVC stream
+ */
+void uvc_stats_frame_resized(uvc_stream_t *uvc_stream);
+
+/**
+ * @brief Account data of one processed USB transfer
+ *
+ * @param[in] uvc_stream      UVC stream
+ * @param[in] payload_bytes   Number of received payload bytes, excluding payload headers
+ * @param[in] skipped_packets Number of skipped or timed out ISOC packets
+ */
+void uvc_stats_transfer_done(uvc_stream_t *uvc_stream, size_t payload_bytes, unsigned skipped_packets);
+
+/**
+ * @brief Skip the rest of current frame
+ *
+ * The drop is accounted only once per frame and only if there is a frame being received.
+ * Errors in between frames are not counted as dropped frames.
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] cause      Cause of the skip
+ */
+void uvc_stats_skip_frame(uvc_stream_t *uvc_stream, uvc_stats_drop_t cause);
+
+#ifdef __cplusplus
+}
+#endif
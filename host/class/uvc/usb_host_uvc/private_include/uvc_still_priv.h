@@ -0,0 +1,120 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include "usb/usb_types_uvc.h"
+#include "usb/uvc_host.h"
+#include "uvc_types_priv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Still image capture
+ *
+ * Still images are received into a dedicated buffer pool, separate from frame buffers of the video stream.
+ * - Method 2: Still image is sent on the video endpoint, its payload headers have the still_image bit set.
+ *   The payloads are passed here from isoc_transfer_callback() and bulk_transfer_callback()
+ * - Method 3: Still image is sent on dedicated Bulk still image endpoint, which is serviced by one URB owned by this module
+ */
+
+/**
+ * @brief Free still image capture resources
+ *
+ * @attention The caller must ensure that no still image URB is in flight
+ * @param[in] uvc_stream UVC stream
+ */
+void uvc_still_free(uvc_stream_t *uvc_stream);
+
+/**
+ * @brief Check whether the payload belongs to a still image received on the video endpoint
+ *
+ * @param[in] uvc_stream     UVC stream
+ * @param[in] payload_header Payload header
+ * @return true if the payload must be processed by uvc_still_header_process(), uvc_still_data_process() and uvc_still_payload_end()
+ */
+bool uvc_still_is_still_payload(const uvc_stream_t *uvc_stream, const uvc_payload_header_t *payload_header);
+
+/**
+ * @brief Process payload header of still image
+ *
+ * Start of still image is detected from Frame ID toggle. The video frame that follows the still image starts regardless of its Frame ID.
+ *
+ * @param[in] uvc_stream     UVC stream
+ * @param[in] payload_header Payload header
+ */
+void uvc_still_header_process(uvc_stream_t *uvc_stream, const uvc_payload_header_t *payload_header);
+
+/**
+ * @brief Add payload data to current still image
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] data       Pointer to data
+ * @param[in] data_len   Data length in bytes
+ */
+void uvc_still_data_process(uvc_stream_t *uvc_stream, const uint8_t *data, size_t data_len);
+
+/**
+ * @brief End current still image payload
+ *
+ * If the payload carried EoF flag, the still image is passed to the user.
+ *
+ * @param[in] uvc_stream UVC stream
+ */
+void uvc_still_payload_end(uvc_stream_t *uvc_stream);
+
+/**
+ * @brief Check whether the frame is a still image buffer of this stream
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] frame      Frame buffer
+ * @return true if the frame belongs to the still image buffer pool
+ */
+bool uvc_still_owns_frame(const uvc_stream_t *uvc_stream, const uvc_host_frame_t *frame);
+
+/**
+ * @brief Return still image buffer to the pool
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] frame      Still image buffer
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_FAIL: The still image was already returned
+ */
+esp_err_t uvc_still_frame_return(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame);
+
+/**
+ * @brief Check whether all still image buffers are returned
+ *
+ * @param[in] uvc_stream UVC stream
+ * @return true if all still image buffers are empty or still image capture is not configured
+ */
+bool uvc_still_are_all_returned(uvc_stream_t *uvc_stream);
+
+/**
+ * @brief Reset still image reception
+ *
+ * Partially received still image is returned to the pool. Called when streaming starts, no URB is in flight.
+ *
+ * @param[in] uvc_stream UVC stream
+ */
+void uvc_still_reset(uvc_stream_t *uvc_stream);
+
+/**
+ * @brief Stop still image reception
+ *
+ * Method 3 only: The still image URB is retired by halting the Bulk still image endpoint.
+ *
+ * @param[in] uvc_stream UVC stream
+ */
+void uvc_still_stop(uvc_stream_t *uvc_stream);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,44 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdlib.h>
+#include "esp_heap_caps.h"
+#include "usb/usb_host.h"
+
+#if USB_HOST_SHARED_CLIENT_ENABLED
+#include "usb/usb_host_mem.h"
+#include "usb/usb_host_transfer_pool.h"
+#include "usb/usb_host_trace.h"
+// Transfers come from the transfer pool of usb_host_shared_client if it is installed, from heap otherwise, and are accounted in the memory footprint
+#define UVC_TRANSFER_ALLOC(size, num_isoc, xfer)   usb_host_mem_transfer_alloc(USB_HOST_MEM_DRIVER_UVC, size, num_isoc, xfer)
+#define UVC_TRANSFER_FREE(xfer)                    usb_host_mem_transfer_free(USB_HOST_MEM_DRIVER_UVC, xfer)
+// Frame buffers, descriptors and driver structures are accounted in the memory footprint,
+// and taken from the arenas of the static allocation mode if it is installed. From heap otherwise
+#define UVC_MALLOC(category, size, caps)                    usb_host_mem_malloc(USB_HOST_MEM_DRIVER_UVC, USB_HOST_MEM_##category, size, caps)
+#define UVC_CALLOC(category, n, size)                       usb_host_mem_calloc(USB_HOST_MEM_DRIVER_UVC, USB_HOST_MEM_##category, n, size, MALLOC_CAP_DEFAULT)
+#define UVC_ALIGNED_ALLOC(category, align, size, caps)      usb_host_mem_aligned_alloc(USB_HOST_MEM_DRIVER_UVC, USB_HOST_MEM_##category, align, size, caps)
+#define UVC_REALLOC(category, ptr, old_size, size, caps)    usb_host_mem_realloc(USB_HOST_MEM_DRIVER_UVC, USB_HOST_MEM_##category, ptr, old_size, size, caps)
+#define UVC_FREE(category, ptr, size)                       usb_host_mem_free(USB_HOST_MEM_DRIVER_UVC, USB_HOST_MEM_##category, ptr, size)
+// Transfer and callback events are recorded if CONFIG_USB_HOST_TRACE is enabled, otherwise the macros are empty
+#define UVC_TRANSFER_SUBMIT(xfer)                  usb_host_trace_transfer_submit(USB_HOST_TRACE_DRIVER_UVC, xfer)
+#define UVC_TRANSFER_SUBMIT_CONTROL(client, xfer)  usb_host_trace_transfer_submit_control(USB_HOST_TRACE_DRIVER_UVC, client, xfer)
+#define UVC_TRACE(event, ep, len, id)              USB_HOST_TRACE(USB_HOST_TRACE_DRIVER_UVC, USB_HOST_TRACE_EVENT_##event, ep, len, 0, id)
+#define UVC_TRACE_COMPLETE(xfer)                   USB_HOST_TRACE_COMPLETE(USB_HOST_TRACE_DRIVER_UVC, xfer)
+#else
+#define UVC_TRANSFER_ALLOC                         usb_host_transfer_alloc
+#define UVC_TRANSFER_FREE                          usb_host_transfer_free
+#define UVC_TRANSFER_SUBMIT                        usb_host_transfer_submit
+#define UVC_TRANSFER_SUBMIT_CONTROL                usb_host_transfer_submit_control
+#define UVC_TRACE(event, ep, len, id)              ((void)0)
+#define UVC_TRACE_COMPLETE(xfer)                   ((void)0)
+#define UVC_MALLOC(category, size, caps)                    heap_caps_malloc(size, caps)
+#define UVC_CALLOC(category, n, size)                       calloc(n, size)
+#define UVC_ALIGNED_ALLOC(category, align, size, caps)      heap_caps_aligned_alloc(align, size, caps)
+#define UVC_REALLOC(category, ptr, old_size, size, caps)    ((void)(old_size), heap_caps_realloc(ptr, size, caps))
+#define UVC_FREE(category, ptr, size)                       ((void)(size), free(ptr))
+#endif
@@ -12,21 +12,53 @@
 
 #include "usb/usb_host.h"
 #include "usb/uvc_host.h"
+#include "uvc_descriptors_priv.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 
 typedef struct uvc_host_stream_s uvc_stream_t;
+typedef struct uvc_device_s uvc_device_t;
+typedef struct uvc_staging_s uvc_staging_t;
+typedef struct uvc_processing_s uvc_processing_t;
+typedef struct uvc_still_s uvc_still_t;
+
+#define UVC_FRAME_SIZE_HISTORY (32) // Adaptive frame size only: Number of recent frame sizes the buffer size is derived from
+
+/**
+ * @brief Sizes of recently received frames
+ */
+typedef struct {
+    uint32_t sizes[UVC_FRAME_SIZE_HISTORY]; // Sizes of recently received frames, ring buffer
+    unsigned count;                         // Number of valid entries in sizes
+    unsigned next;                          // Index of the next entry to be written
+    size_t target;                          // Frame buffers are resized to this size when they are taken. 0: Not known yet
+} uvc_frame_size_history_t;
 
 /**
  * @brief Enum for simple state machine of Bulk frame data processing
  */
 typedef enum {
-    UVC_STREAM_BULK_PACKET_SOF = 0,
-    UVC_STREAM_BULK_PACKET_DATA,
-    UVC_STREAM_BULK_PACKET_EOF,
+    UVC_STREAM_BULK_PACKET_HEADER = 0, // Next byte is start of payload header
+    UVC_STREAM_BULK_PACKET_DATA,       // Next byte is payload data
 } uvc_stream_bulk_packet_type_t;
 
+/**
+ * @brief USB device shared by all streams of its UVC functions
+ *
+ * Members are written only when the device is opened, except num_streams
+ */
+struct uvc_device_s {
+    SLIST_ENTRY(uvc_device_s) list_entry;
+    usb_device_handle_t dev_hdl;          // USB device handle
+    unsigned num_streams;                 // Number of open streams of this device. Protected by open/close mutex of the driver
+    uvc_desc_index_t *desc_index;         // Index of descriptors of this device
+    bool high_speed;                      // The device is connected in High-speed
+    usb_transfer_t *ctrl_transfer;        // CTRL (endpoint 0) transfer of this device
+    SemaphoreHandle_t ctrl_mutex;         // Serializes CTRL transfers of all streams of this device
+};
+
 struct uvc_host_stream_s {
     SLIST_ENTRY(uvc_host_stream_s) list_entry;
 
@@ -34,9 +66,26 @@ struct uvc_host_stream_s {
         // UVC driver related members
         uvc_host_stream_callback_t stream_cb; // User's callback for stream events
         uvc_host_frame_callback_t frame_cb;   // User's frame callback
+        uvc_host_slice_callback_t slice_cb;   // User's slice callback. If set, frames are delivered in slices
         void *cb_arg;                         // Common argument for user's callbacks
-        uvc_host_stream_format_t vs_format;   // Format of the video stream (Runtime format change of opened stream is not supported)
-        QueueHandle_t empty_fb_queue;         // Queue of empty framebuffers
+        uvc_host_stream_format_t vs_format;   // Format of the video stream. Changed by uvc_host_stream_format_select() only when not streaming
+        portMUX_TYPE lock;                    // Lock of this stream. Protects dynamic members, URB references and statistics
+        uvc_host_frame_t **frames;            // All frame buffers of this stream
+        unsigned num_of_frames;               // Number of frame buffers
+        uint32_t empty_frames;                // Bit mask of empty frame buffers, owned by the driver. Accessed atomically
+        bool frame_size_auto;                 // Frame buffer size follows dwMaxVideoFrameSize of the selected format
+        uint32_t frame_heap_caps;             // Memory capabilities of frame buffers. Needed for frame buffer re-allocation
+        struct {
+            bool enabled;                     // Frame buffers are resized to sizes of received frames, overflowing data go to extension chunks
+            uint8_t percentile;               // Frame buffers are resized to this percentile of recent frame sizes
+            uint8_t headroom_percent;         // Headroom added to the percentile
+            size_t frame_size;                // User provided frame size. Lower limit of max_size
+            size_t max_size;                  // Frames larger than this are dropped. Updated only when not streaming
+            size_t chunk_size;                // Size of one extension chunk. Updated only when not streaming
+        } adaptive;                           // Adaptive frame size
+        uvc_host_frame_pool_hdl_t frame_pool; // Shared pool of frame data buffers. NULL if the stream has its own frame buffers
+        unsigned frame_pool_reserved;         // Number of pool buffers reserved for this stream
+        unsigned frame_pool_in_use;           // Number of pool buffers held by this stream. Protected by lock of the pool
 
         // Constant USB descriptor values
         uint16_t bcdUVC;                      // Version of UVC specs this device implements
@@ -45,19 +94,57 @@ struct uvc_host_stream_s {
         uint8_t  bEndpointAddress;            // Streaming endpoint address. Needed for BULK Stream stop
 
         // USB host related members
-        usb_device_handle_t dev_hdl;          // USB device handle
+        uvc_device_t *device;                 // USB device shared with other streams of the same device
+        usb_device_handle_t dev_hdl;          // USB device handle. Copy of device->dev_hdl
         unsigned num_of_xfers;                // Number of USB transfers
         usb_transfer_t **xfers;               // Pointer to array of USB transfers. Accessible only by the UVC driver
+        unsigned xfers_alloc_num;             // Number of entries allocated in xfers and urb_refs
+        bool zero_copy;                       // Zero-copy mode: Frames reference data in URBs instead of copying them
+        bool mjpeg_validation;                // MJPEG only: Frames are checked for SOI and EOI markers before they are passed to the user
+        bool corrupt_frames;                  // MJPEG ISOC only: Frames with lost or corrupted data are delivered with error flags
+        unsigned frame_decimation;            // Only every Nth frame is delivered. 0 and 1 deliver all frames
+        bool keyframes_only;                  // H.264 and H.265 only: Frames that are not keyframes are discarded
+        size_t nal_index_size;                // H.264 and H.265 only: Maximum number of NAL units indexed in each frame. 0 if NAL index is disabled
+        uint8_t *urb_refs;                    // Zero-copy only: Reference counters of URBs. Content is protected by critical section
+        uvc_staging_t *staging;               // Internal RAM staging ring of frame data. NULL if staging is not used
+        uvc_processing_t *processing;         // Dedicated payload processing task. NULL if payloads are processed in USB Host client task
+        uvc_still_t *still;                   // Still image capture. NULL if still image capture is not configured. Changed only when not streaming
+        unsigned ctrl_pending;                // Number of batches of asynchronous Video Control requests in flight. Accessed atomically
+        const usb_ep_desc_t *ep_desc;         // Streaming endpoint descriptor. Needed for URB re-allocation
+        uvc_desc_index_t *desc_index;         // Index of descriptors of this device. Copy of device->desc_index
+        const uvc_desc_index_intf_t *vs_intf; // Indexed descriptors of bInterfaceNumber
+        bool high_speed;                      // The device is connected in High-speed. Copy of device->high_speed
+        uint32_t bandwidth;                   // Periodic bandwidth reserved by this stream in bytes per millisecond. Protected by critical section
+        bool bandwidth_degraded;              // Selected alternate interface offers lower payload than requested. Protected by critical section
+        bool urb_auto_size;                   // URB size is auto-tuned at stream start from measured fill levels
+        uint32_t dwMaxPayloadTransferSize;    // Committed payload size. Bulk only: Used for payload boundary detection. Updated only when not streaming
+        uvc_vs_ctrl_t vs_committed;           // Result of the last committed negotiation. Updated only when not streaming
+        bool suspended;                       // Streaming was stopped by bus suspend, it is started again on resume. Protected by open_close_mutex
     } constant; // Constant members do no change after installation thus do not require a critical section
 
     struct {
         uvc_host_frame_t *current_frame;      // Frame that is being written to
         bool streaming;                       // Flag whether stream is on/off
+        bool discarding;                      // Fast pause: URBs keep running, received data are dropped
+        SLIST_HEAD(uvc_ctrl_ranges, uvc_ctrl_range_s) ctrl_ranges; // Cached ranges of Video Controls
     } dynamic; // Dynamic members require a critical section
 
     struct {
         uvc_stream_bulk_packet_type_t next_bulk_packet; // Bulk only: next expected packet
+        size_t payload_remaining;                       // Bulk only: Number of bytes left in current payload
+        bool payload_eof;                               // Bulk only: Header of current payload contains EoF flag
+        bool still_payload;                             // Bulk only: Current payload belongs to still image
         bool skip_current_frame;                        // Flag to skip current frame. An error has occurred in the stream
         uint8_t current_frame_id;                       // Frame ID can be only 0 or 1. But we also allow setting it to invalid value = 2.
+        size_t urb_fill_max;                            // Bulk only: Max number of bytes received in one URB since stream start
+        uvc_host_frame_timestamp_t timestamp;           // Timestamps of current frame
+        unsigned decimation_count;                      // Number of frames since last delivered frame, modulo frame_decimation
+        bool keyframe_pending;                          // Keyframe filter: Type of current frame is not known yet
+        uvc_frame_size_history_t frame_size;            // Adaptive frame size only: Observed frame sizes
     } single_thread; // Single thread members are only accessed from 1 thread, so they do not need protection
+
+    struct {
+        uvc_host_stream_stats_t counters;     // Stream statistics. bytes_per_second is computed on read
+        int64_t reset_timestamp;              // Time of last statistics reset in microseconds
+    } stats; // Statistics are written from USB callbacks and read by user, they require a critical section
 };
@@ -0,0 +1,79 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_check.h"
+
+#include "uvc_bandwidth_priv.h"
+#include "uvc_descriptors_priv.h"
+#include "uvc_types_priv.h"
+#include "uvc_check_priv.h"
+#include "uvc_critical_priv.h"
+#include "uvc_idf_version_priv.h"
+
+static const char *TAG = "uvc-bandwidth";
+
+// Periodic bandwidth of the root port in bytes per millisecond.
+// USB 2.0 specification allows 90% of Full-speed frame and 80% of High-speed microframe for periodic transfers
+#define UVC_PERIODIC_BUDGET_FS (1500 * 90 / 100)
+#define UVC_PERIODIC_BUDGET_HS (7500 * 8 * 80 / 100)
+
+static uint32_t uvc_bandwidth_fs_used = 0; // Bandwidth reserved by Full-speed streams
+static uint32_t uvc_bandwidth_hs_used = 0; // Bandwidth reserved by High-speed streams
+
+esp_err_t uvc_bandwidth_reserve(uvc_stream_t *uvc_stream, uint32_t dwMaxPayloadTransferSize,
+                                const usb_intf_desc_t **intf_desc_ret, const usb_ep_desc_t **ep_desc_ret)
+{
+    UVC_CHECK(uvc_stream && intf_desc_ret && ep_desc_ret, ESP_ERR_INVALID_ARG);
+    const bool high_speed = uvc_stream->constant.high_speed;
+    uint32_t *used = high_speed ? &uvc_bandwidth_hs_used : &uvc_bandwidth_fs_used;
+    const uint32_t budget = high_speed ? UVC_PERIODIC_BUDGET_HS : UVC_PERIODIC_BUDGET_FS;
+
+    // Bandwidth reserved by this stream is available for the new selection
+    UVC_ENTER_CRITICAL();
+    const uint32_t available = budget - *used + uvc_stream->constant.bandwidth;
+    UVC_EXIT_CRITICAL();
+
+    const usb_intf_desc_t *intf_desc;
+    const usb_ep_desc_t *ep_desc;
+    ESP_RETURN_ON_ERROR(
+        uvc_desc_index_get_intf_and_ep_by_bandwidth(uvc_stream->constant.desc_index, uvc_stream->constant.bInterfaceNumber, dwMaxPayloadTransferSize,
+                MAX_MPS_IN, available, high_speed, &intf_desc, &ep_desc),
+        TAG, "No alternate of interface %d fits in remaining bandwidth %"PRIu32" B/ms", uvc_stream->constant.bInterfaceNumber, available);
+
+    const uint32_t bandwidth = uvc_desc_ep_bandwidth(ep_desc, high_speed);
+    const uint32_t payload = uvc_desc_ep_payload(ep_desc);
+    const bool is_isoc = (USB_EP_DESC_GET_XFERTYPE(ep_desc) == USB_BM_ATTRIBUTES_XFER_ISOC);
+
+    UVC_ENTER_CRITICAL();
+    *used = *used - uvc_stream->constant.bandwidth + bandwidth;
+    uvc_stream->constant.bandwidth = bandwidth;
+    uvc_stream->constant.bandwidth_degraded = is_isoc && (payload < dwMaxPayloadTransferSize);
+    UVC_EXIT_CRITICAL();
+
+    if (uvc_stream->constant.bandwidth_degraded) {
+        ESP_LOGW(TAG, "Interface %d-%d: %"PRIu32" B payload is lower than requested %"PRIu32" B",
+                 intf_desc->bInterfaceNumber, intf_desc->bAlternateSetting, payload, dwMaxPayloadTransferSize);
+    }
+    ESP_LOGD(TAG, "Interface %d-%d reserved %"PRIu32" B/ms", intf_desc->bInterfaceNumber, intf_desc->bAlternateSetting, bandwidth);
+    *intf_desc_ret = intf_desc;
+    *ep_desc_ret = ep_desc;
+    return ESP_OK;
+}
+
+void uvc_bandwidth_release(uvc_stream_t *uvc_stream)
+{
+    if (!uvc_stream) {
+        return;
+    }
+    uint32_t *used = uvc_stream->constant.high_speed ? &uvc_bandwidth_hs_used : &uvc_bandwidth_fs_used;
+    UVC_ENTER_CRITICAL();
+    *used -= uvc_stream->constant.bandwidth;
+    uvc_stream->constant.bandwidth = 0;
+    uvc_stream->constant.bandwidth_degraded = false;
+    UVC_EXIT_CRITICAL();
+}
@@ -5,7 +5,9 @@
  */
 
 #include <stdbool.h>
+#include <stdint.h> // For SIZE_MAX
 #include <string.h> // For memcpy
+#include <sys/param.h> // For MIN
 
 #include "esp_log.h"
 
@@ -13,10 +15,212 @@
 #include "uvc_types_priv.h"
 #include "uvc_check_priv.h"
 #include "uvc_frame_priv.h"
+#include "uvc_stats_priv.h"
+#include "uvc_frame_filter_priv.h"
+#include "uvc_payload_priv.h"
+#include "uvc_still_priv.h"
 #include "uvc_critical_priv.h"
+#include "uvc_processing_priv.h"
+#include "uvc_transfer_priv.h"
+#include "uvc_attr_priv.h"
 
 static const char *TAG = "uvc-bulk";
 
+/**
+ * @brief Check whether the data start with a valid UVC payload header
+ *
+ * @param[in] data     Pointer to data
+ * @param[in] data_len Data length in bytes
+ * @return true if the data start with a payload header
+ */
+static inline bool uvc_bulk_is_header(const uint8_t *data, size_t data_len)
+{
+    const uvc_payload_header_t *payload_header = (const uvc_payload_header_t *)data;
+    return (data_len >= 2) &&
+           (payload_header->bHeaderLength >= 2) &&
+           (payload_header->bHeaderLength <= data_len) &&
+           payload_header->bmHeaderInfo.end_of_header;
+}
+
+/**
+ * @brief Finish current frame and pass it to the user
+ *
+ * @param[in] uvc_stream UVC stream
+ */
+static void UVC_DATA_PATH_ATTR uvc_bulk_frame_end(uvc_stream_t *uvc_stream)
+{
+    if (!uvc_frame_mjpeg_is_valid(uvc_stream, UVC_ATOMIC_LOAD(uvc_stream->dynamic.current_frame))) {
+        uvc_stats_skip_frame(uvc_stream, UVC_STATS_DROP_MJPEG_INVALID);
+    }
+    if (!uvc_stream->single_thread.skip_current_frame &&
+            uvc_frame_adaptive_end(uvc_stream, UVC_ATOMIC_LOAD(uvc_stream->dynamic.current_frame)) != ESP_OK) {
+        uvc_stats_skip_frame(uvc_stream, UVC_STATS_DROP_BUFFER_OVERFLOW); // Frame buffer could not grow
+    }
+
+    // Get the current frame being processed and clear it from the stream,
+    // so no more data is written to this frame after the end of frame
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream); // Enter critical section to safely check and modify the stream state.
+    uvc_host_frame_t *this_frame = uvc_stream->dynamic.current_frame;
+    uvc_stream->dynamic.current_frame = NULL;
+
+    // Determine if we should invoke the frame callback:
+    // Only invoke the callback if streaming is active, a frame callback exists,
+    // and we have a valid frame to pass to the user.
+    const bool invoke_fb_callback = (uvc_stream->dynamic.streaming && uvc_stream->constant.frame_cb && this_frame && !uvc_stream->single_thread.skip_current_frame);
+    const bool invoke_slice_callback = (uvc_stream->dynamic.streaming && uvc_stream->constant.slice_cb && this_frame);
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+
+    // Next payload header starts a new frame regardless of its Frame ID
+    uvc_stream->single_thread.current_frame_id = 2;
+
+    bool return_frame = true; // Default to returning the frame in case streaming has been stopped
+    uvc_frame_finish(uvc_stream, this_frame);
+    if (invoke_slice_callback) {
+        // Slice mode: Pass the rest of the frame to the user. Corrupted frame is also reported, the user must discard its slices
+        if (!uvc_stream->single_thread.skip_current_frame) {
+            uvc_stats_frame_delivered(uvc_stream);
+        }
+        uvc_frame_slice_end(uvc_stream, this_frame, uvc_stream->single_thread.skip_current_frame);
+    }
+    if (invoke_fb_callback) {
+        uvc_stats_frame_delivered(uvc_stream);
+        memcpy((uvc_host_stream_format_t *)&this_frame->vs_format, &uvc_stream->constant.vs_format, sizeof(uvc_host_stream_format_t));
+
+        // Call the user's frame callback. If the callback returns false,
+        // we do not return the frame to the empty queue (i.e., the user wants to keep it for processing)
+        UVC_TRACE(DELIVER, uvc_stream->constant.bEndpointAddress, this_frame->data_len, this_frame);
+        UVC_TRACE(CALLBACK_ENTER, uvc_stream->constant.bEndpointAddress, 0, this_frame);
+        return_frame = uvc_stream->constant.frame_cb(this_frame, uvc_stream->constant.cb_arg);
+        UVC_TRACE(CALLBACK_EXIT, uvc_stream->constant.bEndpointAddress, 0, this_frame);
+    }
+    if (return_frame && this_frame) {
+        // If the user has processed the frame (or the stream is stopped), return it to the empty frame queue
+        uvc_host_frame_return(uvc_stream, this_frame);
+    }
+}
+
+/**
+ * @brief Process payload header
+ *
+ * Detects start of new frame from Frame ID toggle and checks the error flag.
+ *
+ * @param[in] uvc_stream     UVC stream
+ * @param[in] payload_header Payload header
+ */
+static void UVC_DATA_PATH_ATTR uvc_bulk_header_process(uvc_stream_t *uvc_stream, const uvc_payload_header_t *payload_header)
+{
+    const bool start_of_frame = (uvc_stream->single_thread.current_frame_id != payload_header->bmHeaderInfo.frame_id);
+    if (start_of_frame) {
+        // We detected start of new frame. Update Frame ID and start fetching this frame
+        const bool last_frame_skipped = uvc_stream->single_thread.skip_current_frame;
+        uvc_stream->single_thread.current_frame_id   = payload_header->bmHeaderInfo.frame_id;
+        uvc_stream->single_thread.skip_current_frame = false; // Error flag is checked below
+        uvc_stats_sof(uvc_stream);
+        const bool discard_frame = uvc_frame_filter_sof(uvc_stream);
+
+        // Get free frame buffer for this new frame
+        UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+        const bool need_new_frame = (uvc_stream->dynamic.streaming && !uvc_stream->dynamic.current_frame);
+        if (need_new_frame && discard_frame) {
+            // Filtered frame is discarded without taking a frame buffer
+            UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+            uvc_stream->single_thread.skip_current_frame = true;
+        } else if (need_new_frame) {
+            UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+            uvc_stream->dynamic.current_frame = uvc_frame_get_empty(uvc_stream);
+            if (uvc_stream->dynamic.current_frame == NULL) {
+                // There is no free frame buffer now, skipping this frame
+                uvc_stream->single_thread.skip_current_frame = true;
+                uvc_stats_frame_dropped(uvc_stream, UVC_STATS_DROP_BUFFER_UNDERFLOW);
+
+                // Inform the user about the underflow
+                uvc_host_stream_callback_t stream_cb = uvc_stream->constant.stream_cb;
+                if (stream_cb) {
+                    const uvc_host_stream_event_data_t event = {
+                        .type = UVC_HOST_FRAME_BUFFER_UNDERFLOW,
+                    };
+                    stream_cb(&event, uvc_stream->constant.cb_arg);
+                }
+            }
+        } else {
+            // We received SoF but current_frame is not NULL: We missed EoF - reset the frame buffer
+            uvc_host_frame_t *current_frame = uvc_stream->dynamic.current_frame;
+            UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+            if (!last_frame_skipped) {
+                uvc_stats_frame_dropped(uvc_stream, UVC_STATS_DROP_MISSING_EOF);
+            }
+            uvc_frame_reset(uvc_stream, current_frame);
+            uvc_stream->single_thread.skip_current_frame = discard_frame;
+        }
+    }
+
+    // Check for error flag
+    if (payload_header->bmHeaderInfo.error) {
+        uvc_stats_skip_frame(uvc_stream, UVC_STATS_DROP_HEADER_ERROR);
+    }
+    uvc_payload_header_get_timestamps(payload_header, &uvc_stream->single_thread.timestamp);
+    uvc_stream->single_thread.payload_eof = payload_header->bmHeaderInfo.end_of_frame;
+}
+
+/**
+ * @brief Add payload data to current frame
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] transfer   USB transfer that holds the data
+ * @param[in] data       Pointer to data
+ * @param[in] data_len   Data length in bytes
+ */
+static void UVC_DATA_PATH_ATTR uvc_bulk_data_process(uvc_stream_t *uvc_stream, usb_transfer_t *transfer, const uint8_t *data, size_t data_len)
+{
+    if (uvc_stream->single_thread.still_payload) {
+        uvc_still_data_process(uvc_stream, data, data_len);
+        return;
+    }
+    if (uvc_stream->single_thread.skip_current_frame) {
+        return;
+    }
+    if (uvc_frame_filter_data(uvc_stream, data, data_len)) {
+        uvc_stream->single_thread.skip_current_frame = true; // Not a keyframe
+        return;
+    }
+    uvc_host_frame_t *current_frame = UVC_ATOMIC_LOAD(uvc_stream->dynamic.current_frame);
+    esp_err_t ret = uvc_frame_add_urb_data(uvc_stream, current_frame, transfer, data, data_len);
+    if (ret != ESP_OK) {
+        // Frame buffer overflow
+        uvc_stats_skip_frame(uvc_stream, UVC_STATS_DROP_BUFFER_OVERFLOW);
+
+        // Inform the user about the overflow
+        uvc_host_stream_callback_t stream_cb = uvc_stream->constant.stream_cb;
+        if (stream_cb) {
+            const uvc_host_stream_event_data_t event = {
+                .type = UVC_HOST_FRAME_BUFFER_OVERFLOW,
+            };
+            stream_cb(&event, uvc_stream->constant.cb_arg);
+        }
+    }
+}
+
+/**
+ * @brief End current payload
+ *
+ * If the payload carried EoF flag, the frame is passed to the user. Next received byte is a payload header.
+ *
+ * @param[in] uvc_stream UVC stream
+ */
+static void UVC_DATA_PATH_ATTR uvc_bulk_payload_end(uvc_stream_t *uvc_stream)
+{
+    uvc_stream->single_thread.next_bulk_packet = UVC_STREAM_BULK_PACKET_HEADER;
+    if (uvc_stream->single_thread.still_payload) {
+        uvc_stream->single_thread.still_payload = false;
+        uvc_still_payload_end(uvc_stream);
+        return;
+    }
+    if (uvc_stream->single_thread.payload_eof) {
+        uvc_stream->single_thread.payload_eof = false;
+        uvc_bulk_frame_end(uvc_stream);
+    }
+}
+
 /**
  * @brief Callback function for handling Bulk USB transfers from a UVC camera.
  *
@@ -25,33 +229,40 @@ static const char *TAG = "uvc-bulk";
  *
  * - **CRC Included**: Ensures no errors in frame data.
  * - **ACK Mechanism**: Missed packets are retransmitted, ensuring reliable data delivery.
- * - **Packet Headers**: Not all packets contain headers; the end of a transfer is indicated by a short packet
- *   (less than the maximum packet size), and the next packet usually contains a header.
+ * - **Payload Headers**: Every payload transfer starts with a header. The payload ends with a short packet
+ *   or when it reaches dwMaxPayloadTransferSize, so one USB transfer can contain end of one payload
+ *   and start of the next one.
  *
- * To process these packets, a state machine is implemented to track the next expected Bulk packet type:
- * - Start of Frame (SoF), usually followed by data packets in the same transfer
- * - Data packets (no header)
- * - End of Frame (EoF)
+ * Some devices send one header per frame, others one header per payload. Both are handled by tracking
+ * the payload boundaries:
+ * - Header: Start of payload. New frame is detected from Frame ID toggle, the EoF flag is remembered
+ * - Data: Rest of the payload, up to dwMaxPayloadTransferSize
+ * - When the payload ends, the frame is finished if its header contained the EoF flag
  *
  * The function handles USB transfer statuses, manages frame buffers, and invokes user-defined callbacks for
  * completed frames.
  *
  * @param[in] transfer Pointer to the completed USB transfer structure.
  */
-void bulk_transfer_callback(usb_transfer_t *transfer)
+void UVC_DATA_PATH_ATTR bulk_transfer_callback(usb_transfer_t *transfer)
 {
     ESP_LOGD(TAG, "%s", __FUNCTION__);
+    if (transfer->callback != uvc_processing_transfer_cb) {
+        UVC_TRACE_COMPLETE(transfer); // Else recorded on completion, before the processing task
+    }
     uvc_stream_t *uvc_stream = (uvc_stream_t *)transfer->context;
 
     // Check USB transfer status
     switch (transfer->status) {
     case USB_TRANSFER_STATUS_COMPLETED:
         break;
-    case USB_TRANSFER_STATUS_NO_DEVICE:
-    case USB_TRANSFER_STATUS_CANCELED:
     case USB_TRANSFER_STATUS_ERROR:
     case USB_TRANSFER_STATUS_OVERFLOW:
     case USB_TRANSFER_STATUS_STALL:
+        uvc_stats_skip_frame(uvc_stream, UVC_STATS_DROP_USB_ERROR);
+        __attribute__((fallthrough));
+    case USB_TRANSFER_STATUS_NO_DEVICE:
+    case USB_TRANSFER_STATUS_CANCELED:
         // On Bulk errors we stop the stream
         //@todo Stall, error and overflow errors should be propagated to the user
         ESP_ERROR_CHECK(uvc_host_stream_pause(uvc_stream)); // This should never fail
@@ -65,128 +276,69 @@ void bulk_transfer_callback(usb_transfer_t *transfer)
     if (!UVC_ATOMIC_LOAD(uvc_stream->dynamic.streaming)) {
         return; // If the streaming was turned off, we don't have to do anything
     }
+    uvc_frame_urb_acquire(uvc_stream, transfer);
+    if (transfer->actual_num_bytes > uvc_stream->single_thread.urb_fill_max) {
+        uvc_stream->single_thread.urb_fill_max = transfer->actual_num_bytes; // Used for URB auto sizing
+    }
 
-    // In BULK implementation, 'payload' is a constant pointer to constant data,
-    // meaning both the pointer and the data it points to cannot be changed.
-    // This contrasts with the ISOC implementation, where 'payload' is a variable
-    // pointer and is increased after every ISOC packet processing
-    const uint8_t *const payload = transfer->data_buffer;
-    const uint8_t *payload_data  = payload;
-    size_t payload_data_len      = transfer->actual_num_bytes;
-
-    // Note for developers:
-    // The order of SoF, Data, and EoF handling is intentional and represents a workaround for detecting EoF in the Bulk stream.
-    // Normally, a complete Sample transfer includes two short packets: one marking the last data packet and another with the EoF header.
-    // However, if the last data packet has a size equal to the Maximum Packet Size (MPS), there is no zero-length packet between the data and the EoF header.
-    // Consequently, it becomes impossible to distinguish between the last data packet and the EoF header.
-    // To address this, the hack discards all frames whose last data packet has the MPS size.
-    switch (uvc_stream->single_thread.next_bulk_packet) {
-    case UVC_STREAM_BULK_PACKET_EOF: {
-        const uvc_payload_header_t *payload_header = (const uvc_payload_header_t *)payload;
-        uvc_stream->single_thread.next_bulk_packet = UVC_STREAM_BULK_PACKET_SOF;
-
-        if (payload_header->bmHeaderInfo.end_of_frame) {
-            assert(payload_header->bmHeaderInfo.frame_id == uvc_stream->single_thread.current_frame_id);
-            if (payload_header->bmHeaderInfo.error) {
-                uvc_stream->single_thread.skip_current_frame = true;
-            }
+    const uint8_t *payload_data = transfer->data_buffer;
+    size_t payload_data_len     = transfer->actual_num_bytes;
+    size_t payload_bytes        = 0; // Statistics: Payload bytes received in this transfer
+    const bool short_transfer   = (transfer->actual_num_bytes < transfer->data_buffer_size);
 
-            // Get the current frame being processed and clear it from the stream,
-            // so no more data is written to this frame after the end of frame
-            UVC_ENTER_CRITICAL(); // Enter critical section to safely check and modify the stream state.
-            uvc_host_frame_t *this_frame = uvc_stream->dynamic.current_frame;
-            uvc_stream->dynamic.current_frame = NULL;
-
-            // Determine if we should invoke the frame callback:
-            // Only invoke the callback if streaming is active, a frame callback exists,
-            // and we have a valid frame to pass to the user.
-            const bool invoke_fb_callback = (uvc_stream->dynamic.streaming && uvc_stream->constant.frame_cb && this_frame && !uvc_stream->single_thread.skip_current_frame);
-            UVC_EXIT_CRITICAL();
-
-            bool return_frame = true; // Default to returning the frame in case streaming has been stopped
-            if (invoke_fb_callback) {
-                memcpy((uvc_host_stream_format_t *)&this_frame->vs_format, &uvc_stream->constant.vs_format, sizeof(uvc_host_stream_format_t));
-
-                // Call the user's frame callback. If the callback returns false,
-                // we do not return the frame to the empty queue (i.e., the user wants to keep it for processing)
-                return_frame = uvc_stream->constant.frame_cb(this_frame, uvc_stream->constant.cb_arg);
-            }
-            if (return_frame) {
-                // If the user has processed the frame (or the stream is stopped), return it to the empty frame queue
-                uvc_host_frame_return(uvc_stream, this_frame);
-            }
-            break;
+    // Devices with one header per frame may send data that end on MPS boundary without a zero-length packet.
+    // The EoF header then arrives as a standalone short transfer while we still expect payload data.
+    // Recognize it by its length, flags and Frame ID, so the frame is not discarded.
+    if (uvc_stream->single_thread.next_bulk_packet == UVC_STREAM_BULK_PACKET_DATA && short_transfer &&
+            uvc_bulk_is_header(payload_data, payload_data_len)) {
+        const uvc_payload_header_t *payload_header = (const uvc_payload_header_t *)payload_data;
+        if (payload_header->bHeaderLength == payload_data_len &&
+                payload_header->bmHeaderInfo.end_of_frame &&
+                payload_header->bmHeaderInfo.frame_id == uvc_stream->single_thread.current_frame_id) {
+            uvc_stream->single_thread.next_bulk_packet = UVC_STREAM_BULK_PACKET_HEADER; // Previous payload has ended, parse the header below
         }
-
-        __attribute__((fallthrough));  // Fall through! This is not EoF but SoF!
     }
-    case UVC_STREAM_BULK_PACKET_SOF: {
-        const uvc_payload_header_t *payload_header = (const uvc_payload_header_t *)payload;
-        assert(!payload_header->bmHeaderInfo.end_of_frame);
-
-        // We detected start of new frame. Update Frame ID and start fetching this frame
-        uvc_stream->single_thread.current_frame_id   = payload_header->bmHeaderInfo.frame_id;
-        uvc_stream->single_thread.skip_current_frame = payload_header->bmHeaderInfo.error; // Check for error flag
 
-        // Get free frame buffer for this new frame
-        UVC_ENTER_CRITICAL();
-        const bool need_new_frame = (uvc_stream->dynamic.streaming && !uvc_stream->dynamic.current_frame);
-        if (need_new_frame) {
-            UVC_EXIT_CRITICAL();
-            uvc_stream->dynamic.current_frame = uvc_frame_get_empty(uvc_stream);
-            if (uvc_stream->dynamic.current_frame == NULL) {
-                // There is no free frame buffer now, skipping this frame
-                uvc_stream->single_thread.skip_current_frame = true;
-
-                // Inform the user about the underflow
-                uvc_host_stream_callback_t stream_cb = uvc_stream->constant.stream_cb;
-                if (stream_cb) {
-                    const uvc_host_stream_event_data_t event = {
-                        .type = UVC_HOST_FRAME_BUFFER_UNDERFLOW,
-                    };
-                    stream_cb(&event, uvc_stream->constant.cb_arg);
-                }
+    while (payload_data_len > 0) {
+        if (uvc_stream->single_thread.next_bulk_packet == UVC_STREAM_BULK_PACKET_HEADER) {
+            if (!uvc_bulk_is_header(payload_data, payload_data_len)) {
+                // We lost track of payload boundaries. Drop this frame and wait for a transfer that starts with a header
+                uvc_stats_skip_frame(uvc_stream, UVC_STATS_DROP_HEADER_ERROR);
+                break;
+            }
+            const uvc_payload_header_t *payload_header = (const uvc_payload_header_t *)payload_data;
+            uvc_stream->single_thread.still_payload = uvc_still_is_still_payload(uvc_stream, payload_header);
+            if (uvc_stream->single_thread.still_payload) {
+                uvc_still_header_process(uvc_stream, payload_header);
+            } else {
+                uvc_bulk_header_process(uvc_stream, payload_header);
             }
-        } else {
-            // We received SoF but current_frame is not NULL: We missed EoF - reset the frame buffer
-            uvc_frame_reset(uvc_stream->dynamic.current_frame);
-            UVC_EXIT_CRITICAL();
-        }
 
-        payload_data     += payload_header->bHeaderLength; // Pointer arithmetic!
-        payload_data_len -= payload_header->bHeaderLength;
-        uvc_stream->single_thread.next_bulk_packet = UVC_STREAM_BULK_PACKET_DATA;
-        __attribute__((fallthrough));  // Fall through! There can be data after SoF!
-    }
-    case UVC_STREAM_BULK_PACKET_DATA: {
-        // We got short packet in data section, next packet is EoF
-        if (transfer->data_buffer_size > transfer->actual_num_bytes) {
-            uvc_stream->single_thread.next_bulk_packet = UVC_STREAM_BULK_PACKET_EOF;
+            const uint32_t payload_size = uvc_stream->constant.dwMaxPayloadTransferSize;
+            uvc_stream->single_thread.payload_remaining = (payload_size > payload_header->bHeaderLength) ? (payload_size - payload_header->bHeaderLength) : SIZE_MAX;
+            uvc_stream->single_thread.next_bulk_packet = UVC_STREAM_BULK_PACKET_DATA;
+            payload_data     += payload_header->bHeaderLength; // Pointer arithmetic!
+            payload_data_len -= payload_header->bHeaderLength;
         }
-        // Add received data to frame buffer
-        if (!uvc_stream->single_thread.skip_current_frame) {
-            uvc_host_frame_t *current_frame = UVC_ATOMIC_LOAD(uvc_stream->dynamic.current_frame);
-            esp_err_t ret = uvc_frame_add_data(current_frame, payload_data, payload_data_len);
-            if (ret != ESP_OK) {
-                // Frame buffer overflow
-                uvc_stream->single_thread.skip_current_frame = true;
 
-                // Inform the user about the overflow
-                uvc_host_stream_callback_t stream_cb = uvc_stream->constant.stream_cb;
-                if (stream_cb) {
-                    const uvc_host_stream_event_data_t event = {
-                        .type = UVC_HOST_FRAME_BUFFER_OVERFLOW,
-                    };
-                    stream_cb(&event, uvc_stream->constant.cb_arg);
-                }
-            }
+        // Add received data to frame buffer
+        const size_t chunk = MIN(payload_data_len, uvc_stream->single_thread.payload_remaining);
+        uvc_bulk_data_process(uvc_stream, transfer, payload_data, chunk);
+        payload_bytes    += chunk;
+        payload_data     += chunk; // Pointer arithmetic!
+        payload_data_len -= chunk;
+        uvc_stream->single_thread.payload_remaining -= chunk;
+        if (uvc_stream->single_thread.payload_remaining == 0) {
+            // Payload reached dwMaxPayloadTransferSize, the rest of this transfer belongs to next payload
+            uvc_bulk_payload_end(uvc_stream);
         }
-        break;
-    }
-    default: abort();
     }
 
-    if (UVC_ATOMIC_LOAD(uvc_stream->dynamic.streaming)) {
-        usb_host_transfer_submit(transfer); // Restart the transfer
+    // Short packet terminates the payload
+    if (short_transfer && uvc_stream->single_thread.next_bulk_packet == UVC_STREAM_BULK_PACKET_DATA) {
+        uvc_bulk_payload_end(uvc_stream);
     }
+
+    uvc_stats_transfer_done(uvc_stream, payload_bytes, 0);
+    uvc_frame_urb_done(uvc_stream, transfer); // Restart the transfer
 }
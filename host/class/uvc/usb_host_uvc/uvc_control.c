@@ -6,6 +6,7 @@
 // This file will contain all Class-Specific request from USB UVC specification chapter 4
 
 #include <string.h> // For memset
+#include <inttypes.h>
 
 #include "esp_check.h"
 
@@ -14,6 +15,7 @@
 #include "usb/usb_types_uvc.h"
 #include "uvc_types_priv.h"
 #include "uvc_descriptors_priv.h"
+#include "uvc_negotiation_cache_priv.h"
 #include "uvc_check_priv.h"
 
 static const char *TAG = "uvc-control";
@@ -34,8 +36,6 @@ static esp_err_t uvc_host_stream_control(uvc_host_stream_hdl_t stream_hdl, uvc_v
     uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
     uint8_t bmRequestType, bRequest;
     uint16_t wValue, wIndex, wLength;
-    const usb_config_desc_t *cfg_desc;
-    ESP_ERROR_CHECK(usb_host_get_active_config_descriptor(uvc_stream->constant.dev_hdl, &cfg_desc));
     esp_err_t ret = ESP_OK;
     const bool set = (req_code == UVC_SET_CUR) ? true : false;
 
@@ -53,7 +53,7 @@ static esp_err_t uvc_host_stream_control(uvc_host_stream_hdl_t stream_hdl, uvc_v
         const uvc_frame_desc_t *frame_desc;
 
         ESP_RETURN_ON_ERROR(
-            uvc_desc_get_frame_format_by_format(cfg_desc, uvc_stream->constant.bInterfaceNumber, vs_format, &format_desc, &frame_desc),
+            uvc_desc_index_get_frame_format_by_format(uvc_stream->constant.vs_intf, vs_format, &format_desc, &frame_desc),
             TAG, "Could not find format that matches required format");
         UVC_CHECK(format_desc && frame_desc, ESP_ERR_NOT_FOUND);
 
@@ -72,7 +72,7 @@ static esp_err_t uvc_host_stream_control(uvc_host_stream_hdl_t stream_hdl, uvc_v
         const uvc_format_desc_t *format_desc = NULL;
         const uvc_frame_desc_t *frame_desc = NULL;
         ESP_RETURN_ON_ERROR(
-            uvc_desc_get_frame_format_by_index(cfg_desc, uvc_stream->constant.bInterfaceNumber, vs_control->bFormatIndex, vs_control->bFrameIndex, &format_desc, &frame_desc),
+            uvc_desc_index_get_frame_format_by_index(uvc_stream->constant.vs_intf, vs_control->bFormatIndex, vs_control->bFrameIndex, &format_desc, &frame_desc),
             TAG, "Could not find requested frame format");
 
         vs_format->format = uvc_desc_parse_format(format_desc);
@@ -129,6 +129,20 @@ esp_err_t uvc_host_stream_control_negotiate(uvc_host_stream_hdl_t stream_hdl, co
     esp_err_t ret = ESP_ERR_NOT_FOUND;
     uvc_vs_ctrl_t vs_result = {0};
 
+    // Fast path: Commit cached result of previous negotiation of the same format
+    if (uvc_negotiation_cache_get(stream_hdl, vs_format, &vs_result)) {
+        if (uvc_host_stream_control_commit(stream_hdl, &vs_result, vs_format) == ESP_OK) {
+            ESP_LOGD(TAG, "Committed cached format negotiation result");
+            if (vs_result_ret) {
+                memcpy(vs_result_ret, &vs_result, sizeof(uvc_vs_ctrl_t));
+            }
+            return ESP_OK;
+        }
+        // The device rejected cached result, e.g. after firmware update. Negotiate from scratch
+        ESP_LOGD(TAG, "Cached format negotiation result rejected");
+        uvc_negotiation_cache_remove(stream_hdl, vs_format);
+    }
+
     // Try 2x. Some camera may return error on first try
     uvc_host_stream_format_t set_format, fake_format;
     for (int i = 0; i < 2; i++) {
@@ -152,6 +166,9 @@ esp_err_t uvc_host_stream_control_negotiate(uvc_host_stream_hdl_t stream_hdl, co
 
     // Commit the negotiated format
     ret = uvc_host_stream_control_commit(stream_hdl, &vs_result, vs_format);
+    if (ret == ESP_OK && uvc_is_vs_format_equal(&set_format, vs_format)) {
+        uvc_negotiation_cache_put(stream_hdl, vs_format, &vs_result);
+    }
 
     // Pass the result to user
     if (vs_result_ret) {
@@ -160,3 +177,66 @@ esp_err_t uvc_host_stream_control_negotiate(uvc_host_stream_hdl_t stream_hdl, co
 
     return ret;
 }
+
+esp_err_t uvc_host_stream_control_recommit(uvc_host_stream_hdl_t stream_hdl, const uvc_host_stream_format_t *vs_format, const uvc_vs_ctrl_t *vs_result)
+{
+    UVC_CHECK(stream_hdl && vs_format && vs_result, ESP_ERR_INVALID_ARG);
+    uvc_vs_ctrl_t vs_control = *vs_result;
+    return uvc_host_stream_control_commit(stream_hdl, &vs_control, vs_format);
+}
+
+/**
+ * @brief Issue Video Still Probe or Commit control request
+ *
+ * @param[in]    stream_hdl    UVC stream
+ * @param[inout] still_control Still control parameters
+ * @param[in]    req_code      UVC_SET_CUR or UVC_GET_CUR
+ * @param[in]    commit        Commit control, otherwise Probe control
+ * @return Error from uvc_host_usb_ctrl()
+ */
+static esp_err_t uvc_host_still_control(uvc_host_stream_hdl_t stream_hdl, uvc_vs_still_ctrl_t *still_control, enum uvc_req_code req_code, bool commit)
+{
+    uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
+    const bool set = (req_code == UVC_SET_CUR) ? true : false;
+    uint8_t bmRequestType = USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIP_INTERFACE;
+    bmRequestType |= set ? USB_BM_REQUEST_TYPE_DIR_OUT : USB_BM_REQUEST_TYPE_DIR_IN;
+    return uvc_host_usb_ctrl(stream_hdl, bmRequestType, (uint8_t)req_code,
+                             (commit ? UVC_VS_STILL_COMMIT_CONTROL : UVC_VS_STILL_PROBE_CONTROL) << 8,
+                             uvc_stream->constant.bInterfaceNumber,
+                             sizeof(uvc_vs_still_ctrl_t), (uint8_t *)still_control);
+}
+
+esp_err_t uvc_host_still_control_negotiate(uvc_host_stream_hdl_t stream_hdl, uint8_t bFormatIndex, uint8_t bFrameIndex, uint8_t bCompressionIndex, uvc_vs_still_ctrl_t *still_result_ret)
+{
+    UVC_CHECK(stream_hdl && still_result_ret, ESP_ERR_INVALID_ARG);
+
+    // The device fills in dwMaxVideoFrameSize and dwMaxPayloadTransferSize of the probed still image
+    // see USB UVC specification ver 1.5, chapter 4.3.1.1.3
+    uvc_vs_still_ctrl_t still_control = {
+        .bFormatIndex = bFormatIndex,
+        .bFrameIndex = bFrameIndex,
+        .bCompressionIndex = bCompressionIndex,
+    };
+    ESP_RETURN_ON_ERROR(uvc_host_still_control(stream_hdl, &still_control, UVC_SET_CUR, false), TAG, "Still probe set failed");
+    ESP_RETURN_ON_ERROR(uvc_host_still_control(stream_hdl, &still_control, UVC_GET_CUR, false), TAG, "Still probe get failed");
+    UVC_CHECK(still_control.bFormatIndex == bFormatIndex && still_control.bFrameIndex == bFrameIndex, ESP_ERR_NOT_FOUND);
+    ESP_RETURN_ON_ERROR(uvc_host_still_control(stream_hdl, &still_control, UVC_SET_CUR, true), TAG, "Still commit failed");
+
+    ESP_LOGD(TAG, "Still image negotiation: format %d, frame %d, max size %"PRIu32", max payload %"PRIu32,
+             still_control.bFormatIndex, still_control.bFrameIndex, still_control.dwMaxVideoFrameSize, still_control.dwMaxPayloadTransferSize);
+    memcpy(still_result_ret, &still_control, sizeof(uvc_vs_still_ctrl_t));
+    return ESP_OK;
+}
+
+esp_err_t uvc_host_still_control_trigger(uvc_host_stream_hdl_t stream_hdl, enum uvc_vs_still_trigger trigger)
+{
+    UVC_CHECK(stream_hdl, ESP_ERR_INVALID_ARG);
+    uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
+    uint8_t bTrigger = (uint8_t)trigger;
+    return uvc_host_usb_ctrl(stream_hdl,
+                             USB_BM_REQUEST_TYPE_DIR_OUT | USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIP_INTERFACE,
+                             UVC_SET_CUR,
+                             UVC_VS_STILL_IMAGE_TRIGGER_CONTROL << 8,
+                             uvc_stream->constant.bInterfaceNumber,
+                             sizeof(bTrigger), &bTrigger);
+}
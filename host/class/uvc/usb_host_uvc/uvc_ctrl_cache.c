@@ -0,0 +1,145 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <sys/queue.h>
+
+#include "esp_check.h"
+#include "usb/usb_types_ch9.h"
+#include "usb/usb_types_uvc.h"
+
+#include "uvc_control.h"
+#include "uvc_ctrl_cache_priv.h"
+#include "uvc_types_priv.h"
+#include "uvc_check_priv.h"
+#include "uvc_critical_priv.h"
+#include "uvc_transfer_priv.h"
+
+static const char *TAG = "uvc-ctrl-cache";
+
+struct uvc_ctrl_range_s {
+    SLIST_ENTRY(uvc_ctrl_range_s) list_entry;
+    uint8_t bUnitID;
+    uint8_t bSelector;
+    uvc_ctrl_cache_range_t range;
+};
+
+/**
+ * @brief Find cache entry
+ *
+ * Must be called from critical section
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] bUnitID    ID of Unit or Terminal
+ * @param[in] bSelector  Control selector
+ * @return Cache entry or NULL if not found
+ */
+static struct uvc_ctrl_range_s *uvc_ctrl_cache_find(uvc_stream_t *uvc_stream, uint8_t bUnitID, uint8_t bSelector)
+{
+    struct uvc_ctrl_range_s *entry;
+    SLIST_FOREACH(entry, &uvc_stream->dynamic.ctrl_ranges, list_entry) {
+        if (entry->bUnitID == bUnitID && entry->bSelector == bSelector) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+bool uvc_ctrl_cache_get(uvc_stream_t *uvc_stream, uint8_t bUnitID, uint8_t bSelector, uvc_ctrl_cache_range_t *range_ret)
+{
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    const struct uvc_ctrl_range_s *entry = uvc_ctrl_cache_find(uvc_stream, bUnitID, bSelector);
+    if (entry) {
+        *range_ret = entry->range;
+    }
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+    return entry != NULL;
+}
+
+esp_err_t uvc_ctrl_cache_put(uvc_stream_t *uvc_stream, uint8_t bUnitID, uint8_t bSelector, const uvc_ctrl_cache_range_t *range)
+{
+    struct uvc_ctrl_range_s *new_entry = UVC_CALLOC(CONTROL, 1, sizeof(struct uvc_ctrl_range_s));
+    UVC_CHECK(new_entry, ESP_ERR_NO_MEM);
+    new_entry->bUnitID = bUnitID;
+    new_entry->bSelector = bSelector;
+    new_entry->range = *range;
+
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    const bool cached = (uvc_ctrl_cache_find(uvc_stream, bUnitID, bSelector) != NULL); // Another task could have cached it meanwhile
+    if (!cached) {
+        SLIST_INSERT_HEAD(&uvc_stream->dynamic.ctrl_ranges, new_entry, list_entry);
+    }
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+
+    if (cached) {
+        UVC_FREE(CONTROL, new_entry, sizeof(struct uvc_ctrl_range_s));
+    }
+    return ESP_OK;
+}
+
+void uvc_ctrl_cache_free(uvc_stream_t *uvc_stream)
+{
+    while (!SLIST_EMPTY(&uvc_stream->dynamic.ctrl_ranges)) {
+        struct uvc_ctrl_range_s *entry = SLIST_FIRST(&uvc_stream->dynamic.ctrl_ranges);
+        SLIST_REMOVE_HEAD(&uvc_stream->dynamic.ctrl_ranges, list_entry);
+        UVC_FREE(CONTROL, entry, sizeof(struct uvc_ctrl_range_s));
+    }
+}
+
+/**
+ * @brief Convert raw little-endian control value to integer
+ *
+ * @param[in] raw       Raw value
+ * @param[in] wLength   Length of control data in bytes, 1 to 4
+ * @param[in] is_signed Sign-extend the value
+ * @return Control value
+ */
+static int32_t uvc_ctrl_value(uint32_t raw, uint16_t wLength, bool is_signed)
+{
+    const unsigned shift = 32 - 8 * wLength;
+    if (is_signed) {
+        return (int32_t)(raw << shift) >> shift;
+    }
+    return (int32_t)raw;
+}
+
+esp_err_t uvc_host_ctrl_get_range(uvc_host_stream_hdl_t stream_hdl, uint8_t bUnitID, uint8_t bSelector, uint16_t wLength, bool is_signed, uvc_host_ctrl_range_t *range_ret)
+{
+    UVC_CHECK(stream_hdl && range_ret, ESP_ERR_INVALID_ARG);
+    UVC_CHECK(wLength >= 1 && wLength <= sizeof(uint32_t), ESP_ERR_INVALID_ARG);
+    uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
+
+    uvc_ctrl_cache_range_t range;
+    if (!uvc_ctrl_cache_get(uvc_stream, bUnitID, bSelector, &range)) {
+        // Cache miss: Request the range from the device
+        const uint8_t bmRequestType = USB_BM_REQUEST_TYPE_DIR_IN | USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIP_INTERFACE;
+        const uint16_t wValue = bSelector << 8;
+        const uint16_t wIndex = (bUnitID << 8) | uvc_stream->constant.vs_intf->bControlInterface;
+        const struct {
+            enum uvc_req_code req_code;
+            uint32_t *value;
+        } requests[] = {
+            {UVC_GET_MIN, &range.min},
+            {UVC_GET_MAX, &range.max},
+            {UVC_GET_RES, &range.res},
+            {UVC_GET_DEF, &range.def},
+        };
+        for (size_t i = 0; i < sizeof(requests) / sizeof(requests[0]); i++) {
+            uint8_t data[sizeof(uint32_t)] = {0};
+            ESP_RETURN_ON_ERROR(
+                uvc_host_usb_ctrl(stream_hdl, bmRequestType, requests[i].req_code, wValue, wIndex, wLength, data),
+                TAG, "Could not get range of control %d of unit %d", bSelector, bUnitID);
+            *requests[i].value = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+        }
+        ESP_RETURN_ON_ERROR(uvc_ctrl_cache_put(uvc_stream, bUnitID, bSelector, &range), TAG, "Could not cache range");
+    }
+
+    range_ret->min = uvc_ctrl_value(range.min, wLength, is_signed);
+    range_ret->max = uvc_ctrl_value(range.max, wLength, is_signed);
+    range_ret->res = uvc_ctrl_value(range.res, wLength, is_signed);
+    range_ret->def = uvc_ctrl_value(range.def, wLength, is_signed);
+    return ESP_OK;
+}
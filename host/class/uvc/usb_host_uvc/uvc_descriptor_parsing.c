@@ -5,80 +5,38 @@
  */
 
 #include <inttypes.h>
-#include <string.h> // strncmp for guid format parsing
+#include <string.h> // strncmp for guid format parsing, memcmp for extension unit GUID
+#include <stddef.h> // For offsetof
 #include <math.h>   // fabs for float comparison
+#include <stdlib.h> // For calloc
+#include <sys/param.h> // For MIN
 #include "usb/usb_helpers.h"
 #include "usb/uvc_host.h"
 #include "uvc_check_priv.h"
 #include "uvc_descriptors_priv.h"
+#include "uvc_transfer_priv.h"
 
 #define FLOAT_EQUAL(a, b) (fabs(a - b) < 0.0001f) // For comparing float values with acceptable difference (epsilon value)
 
-static const uvc_vs_input_header_desc_t *uvc_desc_get_streaming_input_header(const usb_config_desc_t *cfg_desc, uint8_t bInterfaceNumber)
+uint32_t uvc_desc_ep_bandwidth(const usb_ep_desc_t *ep_desc, bool high_speed)
 {
-    UVC_CHECK(cfg_desc, NULL);
+    UVC_CHECK(ep_desc, 0);
+    if (USB_EP_DESC_GET_XFERTYPE(ep_desc) != USB_BM_ATTRIBUTES_XFER_ISOC) {
+        return 0; // Only ISOC endpoints reserve periodic bandwidth
+    }
 
-    // Find Interface with alternate settings = 0. All Video Streaming descriptors should be after this descriptor.
-    int offset = 0;
-    const usb_intf_desc_t *intf_desc = usb_parse_interface_descriptor(cfg_desc, bInterfaceNumber, 0, &offset);
-    UVC_CHECK(intf_desc, NULL);
-    UVC_CHECK(intf_desc->bInterfaceClass == USB_CLASS_VIDEO, NULL);
-    UVC_CHECK(intf_desc->bInterfaceSubClass == UVC_SC_VIDEOSTREAMING, NULL);
-
-    // Find Video Input Header Descriptor
-    const usb_standard_desc_t *std_desc = usb_parse_next_descriptor_of_type((const usb_standard_desc_t *)intf_desc, cfg_desc->wTotalLength, UVC_CS_INTERFACE, &offset);
-    const uvc_vs_input_header_desc_t *input_header = (uvc_vs_input_header_desc_t *)std_desc;
-    UVC_CHECK(input_header, NULL);
-    UVC_CHECK(input_header->bDescriptorSubType == UVC_VS_DESC_SUBTYPE_INPUT_HEADER, NULL);
-    return input_header;
+    // ISOC endpoints are serviced every 2^(bInterval-1) (micro)frames
+    const uint32_t services_per_ms = high_speed ? 8 : 1;
+    const uint8_t interval_exp = (ep_desc->bInterval > 0) ? (ep_desc->bInterval - 1) : 0;
+    const uint32_t bytes_per_service = uvc_desc_ep_payload(ep_desc);
+    return (bytes_per_service * services_per_ms) >> interval_exp;
 }
 
-esp_err_t uvc_desc_get_streaming_intf_and_ep(
-    const usb_config_desc_t *cfg_desc,
-    uint8_t bInterfaceNumber,
-    uint16_t dwMaxPayloadTransferSize,
-    const usb_intf_desc_t **intf_desc_ret,
-    const usb_ep_desc_t **ep_desc_ret)
+uint32_t uvc_desc_ep_payload(const usb_ep_desc_t *ep_desc)
 {
-    UVC_CHECK(cfg_desc && intf_desc_ret && ep_desc_ret, ESP_ERR_INVALID_ARG);
-
-    const usb_intf_desc_t *intf_desc = NULL;
-    const usb_ep_desc_t *ep_desc = NULL;
-    int offset = 0;
-
-    const uint8_t num_of_alternate = usb_parse_interface_number_of_alternate(cfg_desc, bInterfaceNumber);
-    uint16_t last_mps = 0; // Looking for maximum MPS: init to zero
-    uint8_t last_mult = UINT8_MAX; // Looking for minimum: init to max
-    for (int i = 0; i <= num_of_alternate; i++) {
-        // Check Interface desc
-        intf_desc = usb_parse_interface_descriptor(cfg_desc, bInterfaceNumber, i, &offset);
-        UVC_CHECK(intf_desc, ESP_ERR_NOT_FOUND);
-        UVC_CHECK(intf_desc->bInterfaceClass == USB_CLASS_VIDEO, ESP_ERR_NOT_FOUND);
-        UVC_CHECK(intf_desc->bInterfaceSubClass == UVC_SC_VIDEOSTREAMING, ESP_ERR_NOT_FOUND);
-        if (intf_desc->bNumEndpoints == 0 && i == 0) {
-            continue; // This is Alternate setting 0 for ISOC cameras.
-        }
-        UVC_CHECK(intf_desc->bNumEndpoints == 1, ESP_ERR_NOT_FOUND); // Only 1 endpoint is expected
-
-        // Check EP desc
-        ep_desc = usb_parse_endpoint_descriptor_by_index(intf_desc, 0, cfg_desc->wTotalLength, &offset);
-        UVC_CHECK(ep_desc, ESP_ERR_NOT_FOUND);
-
-        // Here we look for an interface that offers the largest MPS with minimum multiple transactions in a microframe
-        // and that is not bigger that max. requests MPS
-        const uint16_t current_mps = USB_EP_DESC_GET_MPS(ep_desc);
-        const uint8_t current_mult = USB_EP_DESC_GET_MULT(ep_desc);
-        if (current_mps >= last_mps && current_mult <= last_mult && current_mps <= dwMaxPayloadTransferSize) {
-            last_mps = current_mps;
-            last_mult = current_mult;
-            *ep_desc_ret = ep_desc;
-            *intf_desc_ret = intf_desc;
-        } else {
-            break;
-        }
-    }
-
-    return ESP_OK;
+    UVC_CHECK(ep_desc, 0);
+    // High-bandwidth endpoints deliver up to 3 transactions of MPS in one microframe
+    return USB_EP_DESC_GET_MPS(ep_desc) * (USB_EP_DESC_GET_MULT(ep_desc) + 1);
 }
 
 /**
@@ -227,85 +185,273 @@ static bool uvc_desc_format_is_equal(const uvc_frame_desc_t *frame_desc, const u
     return false;
 }
 
-esp_err_t uvc_desc_get_frame_format_by_format(
-    const usb_config_desc_t *cfg_desc,
-    uint8_t bInterfaceNumber,
-    const uvc_host_stream_format_t *vs_format,
-    const uvc_format_desc_t **format_desc_ret,
-    const uvc_frame_desc_t **frame_desc_ret)
+/**
+ * @brief Find Terminal or Unit of UVC function by its ID
+ *
+ * @param[in] intf Video Streaming interface of the UVC function
+ * @param[in] bID  ID of the Terminal or Unit
+ * @return Terminal or Unit descriptor or NULL if not found
+ */
+static const usb_standard_desc_t *uvc_desc_vc_find_entity(const uvc_desc_index_intf_t *intf, uint8_t bID)
 {
-    UVC_CHECK(cfg_desc && vs_format, ESP_ERR_INVALID_ARG);
-
-    const uvc_vs_input_header_desc_t *input_header = uvc_desc_get_streaming_input_header(cfg_desc, bInterfaceNumber);
-    UVC_CHECK(input_header, ESP_ERR_NOT_FOUND);
-
-    // Find requested Format descriptors
-    esp_err_t ret = ESP_ERR_NOT_FOUND;
-    int format_offset = 0;
-    const usb_standard_desc_t *current_desc = (const usb_standard_desc_t *) input_header;
-    while ((current_desc = usb_parse_next_descriptor_of_type(current_desc, input_header->wTotalLength, UVC_CS_INTERFACE, &format_offset))) {
-        if (uvc_desc_is_format_desc(current_desc)) {
-            const uvc_format_desc_t *this_format = (const uvc_format_desc_t *)(current_desc);
-            if (vs_format->format == uvc_desc_parse_format(this_format)) {
-                if (format_desc_ret) {
-                    *format_desc_ret = this_format;
+    int offset = 0;
+    const usb_standard_desc_t *desc = (const usb_standard_desc_t *)intf->vc_header_desc;
+    while ((desc = usb_parse_next_descriptor(desc, intf->vc_total_length, &offset))) {
+        const uint8_t *raw = (const uint8_t *)desc;
+        // bTerminalID and bUnitID are at the same offset in all Terminal and Unit descriptors
+        if (desc->bDescriptorType == UVC_CS_INTERFACE && desc->bLength > 3 && raw[3] == bID) {
+            return desc;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Get the first source of Terminal or Unit
+ *
+ * @param[in] desc Terminal or Unit descriptor
+ * @return ID of the source. 0 if the entity has no source, e.g. Input Terminal
+ */
+static uint8_t uvc_desc_vc_source_id(const usb_standard_desc_t *desc)
+{
+    size_t source_offset;
+    switch (((const uvc_vc_header_desc_t *)desc)->bDescriptorSubType) {
+    case UVC_VC_DESC_SUBTYPE_OUTPUT_TERMINAL:
+        source_offset = offsetof(uvc_output_terminal_desc_t, bSourceID);
+        break;
+    case UVC_VC_DESC_SUBTYPE_SELECTOR_UNIT:
+        source_offset = offsetof(uvc_selector_unit_desc_t, baSourceID1);
+        break;
+    case UVC_VC_DESC_SUBTYPE_PROCESSING_UNIT:
+        source_offset = offsetof(uvc_processing_unit_desc_t, bSourceID);
+        break;
+    case UVC_VC_DESC_SUBTYPE_ENCODING_UNIT:
+        source_offset = offsetof(uvc_encoding_unit_desc_t, bSourceID);
+        break;
+    case UVC_VC_DESC_SUBTYPE_EXTENSION_UNIT:
+        source_offset = offsetof(uvc_extension_unit_desc_t, baSourceID);
+        break;
+    default:
+        return 0;
+    }
+    return (desc->bLength > source_offset) ? ((const uint8_t *)desc)[source_offset] : 0;
+}
+
+/**
+ * @brief Find Encoding Unit that encodes the video of Video Streaming interface
+ *
+ * The unit chain is followed from the Output Terminal linked to the interface towards the Input Terminal.
+ * Selector and Extension Units are followed through their first input pin.
+ *
+ * @param[in] intf Video Streaming interface
+ * @return Encoding Unit descriptor or NULL if the chain has none
+ */
+static const uvc_encoding_unit_desc_t *uvc_desc_find_enc_unit(const uvc_desc_index_intf_t *intf)
+{
+    if (!intf->vc_header_desc) {
+        return NULL;
+    }
+    uint8_t bID = intf->bTerminalLink;
+    for (int hops = 0; bID != 0 && hops < 16; hops++) { // Limit the walk, so a unit loop in broken descriptors ends
+        const usb_standard_desc_t *desc = uvc_desc_vc_find_entity(intf, bID);
+        if (!desc) {
+            break;
+        }
+        if (((const uvc_vc_header_desc_t *)desc)->bDescriptorSubType == UVC_VC_DESC_SUBTYPE_ENCODING_UNIT &&
+                desc->bLength >= sizeof(uvc_encoding_unit_desc_t)) {
+            return (const uvc_encoding_unit_desc_t *)desc;
+        }
+        bID = uvc_desc_vc_source_id(desc);
+    }
+    return NULL;
+}
+
+esp_err_t uvc_desc_index_build(const usb_config_desc_t *cfg_desc, uvc_desc_index_t **index_ret)
+{
+    UVC_CHECK(cfg_desc && index_ret, ESP_ERR_INVALID_ARG);
+
+    // 1. Get upper bound of number of index entries, so we can allocate the index in one block
+    size_t max_intfs = 0;
+    size_t max_cs_descs = 0;
+    int offset = 0;
+    const usb_standard_desc_t *desc = (const usb_standard_desc_t *)cfg_desc;
+    while ((desc = usb_parse_next_descriptor(desc, cfg_desc->wTotalLength, &offset))) {
+        if (desc->bDescriptorType == USB_B_DESCRIPTOR_TYPE_INTERFACE) {
+            max_intfs++;
+        } else if (desc->bDescriptorType == UVC_CS_INTERFACE) {
+            max_cs_descs++;
+        }
+    }
+
+    const size_t alloc_size = sizeof(uvc_desc_index_t) +
+                              max_intfs * (sizeof(uvc_desc_index_intf_t) + sizeof(uvc_desc_index_alt_t)) +
+                              max_cs_descs * (sizeof(uvc_desc_index_format_t) + sizeof(uvc_frame_desc_t *));
+    uvc_desc_index_t *index = UVC_CALLOC(DESCRIPTOR, 1, alloc_size);
+    UVC_CHECK(index, ESP_ERR_NO_MEM);
+    index->alloc_size = alloc_size;
+    index->intfs   = (uvc_desc_index_intf_t *)(index + 1);
+    index->alts    = (uvc_desc_index_alt_t *)(index->intfs + max_intfs);
+    index->formats = (uvc_desc_index_format_t *)(index->alts + max_intfs);
+    const uvc_frame_desc_t **frames = (const uvc_frame_desc_t **)(index->formats + max_cs_descs);
+    size_t num_frames = 0;
+
+    // 2. Walk the configuration descriptor once and fill the index
+    int uvc_index = -1;                    // Index of current UVC function
+    uint16_t bcdUVC = 0;                   // UVC version of current UVC function
+    uint8_t bControlInterface = 0;         // Video Control interface of current UVC function
+    const uvc_vc_header_desc_t *vc_header_desc = NULL; // Video Control interface header of current UVC function
+    uint16_t vc_total_length = 0;          // Length of class-specific Video Control descriptors of current UVC function
+    bool in_vc = false;                    // Current interface is Video Control interface
+    bool in_vs_alt0 = false;               // Current interface is alternate setting 0 of Video Streaming interface
+    uvc_desc_index_intf_t *intf = NULL;    // Current Video Streaming interface
+    uvc_desc_index_alt_t *alt = NULL;      // Current alternate setting of Video Streaming interface
+    uvc_desc_index_format_t *format = NULL; // Current format of Video Streaming interface
+    uint8_t still_ep_addr = 0;             // Method 3 Bulk still image endpoint of current Video Streaming interface, 0 if none
+    offset = 0;
+    desc = (const usb_standard_desc_t *)cfg_desc;
+    while ((desc = usb_parse_next_descriptor(desc, cfg_desc->wTotalLength, &offset))) {
+        switch (desc->bDescriptorType) {
+        case USB_B_DESCRIPTOR_TYPE_INTERFACE: {
+            const usb_intf_desc_t *intf_desc = (const usb_intf_desc_t *)desc;
+            const bool is_video = (intf_desc->bInterfaceClass == USB_CLASS_VIDEO);
+            in_vc = is_video && (intf_desc->bInterfaceSubClass == UVC_SC_VIDEOCONTROL);
+            in_vs_alt0 = false;
+            alt = NULL;
+            format = NULL;
+            if (in_vc && intf_desc->bAlternateSetting == 0) {
+                // Each UVC function has exactly one Video Control interface
+                uvc_index++;
+                bcdUVC = 0;
+                bControlInterface = intf_desc->bInterfaceNumber;
+                vc_header_desc = NULL;
+                vc_total_length = 0;
+            }
+            if (!is_video || intf_desc->bInterfaceSubClass != UVC_SC_VIDEOSTREAMING || uvc_index < 0) {
+                intf = NULL;
+                break;
+            }
+
+            intf = (uvc_desc_index_intf_t *)uvc_desc_index_get_intf(index, intf_desc->bInterfaceNumber);
+            if (!intf) {
+                intf = &index->intfs[index->num_intfs++];
+                intf->bInterfaceNumber = intf_desc->bInterfaceNumber;
+                intf->uvc_index = uvc_index;
+                intf->bcdUVC = bcdUVC;
+                intf->bControlInterface = bControlInterface;
+                intf->vc_header_desc = vc_header_desc;
+                intf->vc_total_length = vc_total_length;
+                still_ep_addr = 0;
+            }
+            alt = &index->alts[index->num_alts++];
+            alt->intf_desc = intf_desc;
+            in_vs_alt0 = (intf_desc->bAlternateSetting == 0);
+            break;
+        }
+        case USB_B_DESCRIPTOR_TYPE_ENDPOINT: {
+            const usb_ep_desc_t *ep_desc = (const usb_ep_desc_t *)desc;
+            if (!alt) {
+                break;
+            }
+            // Endpoints follow the class-specific descriptors of alternate setting 0, so the still image endpoint is known here
+            if (still_ep_addr && ep_desc->bEndpointAddress == still_ep_addr) {
+                if (!intf->still_ep_desc) {
+                    intf->still_ep_desc = ep_desc; // Still image capture method 3 adds Bulk still image endpoint
                 }
-                // We found required Format Descriptor
-                // Now we look for correct Frame Descriptors which should be directly after Format
-                while ((current_desc = usb_parse_next_descriptor_of_type(current_desc, input_header->wTotalLength, UVC_CS_INTERFACE, &format_offset))) {
-                    uvc_frame_desc_t *this_frame = (uvc_frame_desc_t *)current_desc;
-                    if (uvc_desc_format_is_equal(this_frame, vs_format)) {
-                        if (frame_desc_ret) {
-                            *frame_desc_ret = this_frame;
-                        }
-                        ret = ESP_OK;
-                        break;
-                    }
+            } else if (!alt->ep_desc) {
+                alt->ep_desc = ep_desc; // Video Streaming interface has one video endpoint
+            }
+            break;
+        }
+        case UVC_CS_INTERFACE:
+            if (in_vc && ((const uvc_vc_header_desc_t *)desc)->bDescriptorSubType == UVC_VC_DESC_SUBTYPE_HEADER) {
+                vc_header_desc = (const uvc_vc_header_desc_t *)desc;
+                bcdUVC = vc_header_desc->bcdUVC;
+                vc_total_length = MIN(vc_header_desc->wTotalLength, cfg_desc->wTotalLength - offset);
+            } else if (in_vs_alt0 && ((const uvc_vs_input_header_desc_t *)desc)->bDescriptorSubType == UVC_VS_DESC_SUBTYPE_INPUT_HEADER) {
+                intf->bStillCaptureMethod = ((const uvc_vs_input_header_desc_t *)desc)->bStillCaptureMethod;
+                intf->bTerminalLink = ((const uvc_vs_input_header_desc_t *)desc)->bTerminalLink;
+            } else if (in_vs_alt0 && uvc_desc_is_format_desc(desc)) {
+                // Format descriptors of one interface are listed contiguously, followed by their frame descriptors
+                format = &index->formats[index->num_formats++];
+                format->format_desc = (const uvc_format_desc_t *)desc;
+                format->format = uvc_desc_parse_format(format->format_desc);
+                format->frames = &frames[num_frames];
+                if (intf->num_formats == 0) {
+                    intf->formats = format;
+                }
+                intf->num_formats++;
+            } else if (in_vs_alt0 && format && uvc_desc_is_frame_desc(desc)) {
+                frames[num_frames++] = (const uvc_frame_desc_t *)desc;
+                format->num_frames++;
+            } else if (in_vs_alt0 && format && ((const uvc_still_image_frame_desc_t *)desc)->bDescriptorSubType == UVC_VS_DESC_SUBTYPE_STILL_IMAGE_FRAME) {
+                format->still_desc = (const uvc_still_image_frame_desc_t *)desc; // Follows frame descriptors of its format
+                if (format->still_desc->bEndpointAddress) {
+                    still_ep_addr = format->still_desc->bEndpointAddress; // Method 3 only, 0 for method 2
                 }
-                break;
             }
+            break;
+        default:
+            break;
         }
     }
-    return ret;
+
+    // 3. Resolve Encoding Units, once all Video Control descriptors are known
+    for (size_t i = 0; i < index->num_intfs; i++) {
+        index->intfs[i].enc_unit_desc = uvc_desc_find_enc_unit(&index->intfs[i]);
+    }
+
+    *index_ret = index;
+    return ESP_OK;
 }
 
-static inline bool uvc_desc_is_format_supported(
-    const usb_config_desc_t *cfg_desc,
-    uint8_t bInterfaceNumber,
-    const uvc_host_stream_format_t *vs_format)
+void uvc_desc_index_free(uvc_desc_index_t *index)
 {
-    return (ESP_OK == uvc_desc_get_frame_format_by_format(cfg_desc, bInterfaceNumber, vs_format, NULL, NULL));
+    if (index) {
+        UVC_FREE(DESCRIPTOR, index, index->alloc_size); // The index is allocated in one block
+    }
 }
 
-static const uvc_vc_header_desc_t *uvc_desc_get_control_interface_header(const usb_config_desc_t *cfg_desc, unsigned uvc_idx)
+const uvc_desc_index_intf_t *uvc_desc_index_get_intf(const uvc_desc_index_t *index, uint8_t bInterfaceNumber)
 {
-    UVC_CHECK(cfg_desc, NULL);
+    UVC_CHECK(index, NULL);
+    for (size_t i = 0; i < index->num_intfs; i++) {
+        if (index->intfs[i].bInterfaceNumber == bInterfaceNumber) {
+            return &index->intfs[i];
+        }
+    }
+    return NULL;
+}
 
-    // Find IAD UVC descriptor with desired index
-    const uvc_vc_header_desc_t *header_desc_ret = NULL;
-    int offset = 0;
-    int uvc_iad_idx = 0;
-    const usb_standard_desc_t *current_desc = (const usb_standard_desc_t *)cfg_desc;
-    while ((current_desc = usb_parse_next_descriptor_of_type(current_desc, cfg_desc->wTotalLength, USB_B_DESCRIPTOR_TYPE_INTERFACE_ASSOCIATION, &offset))) {
-        const usb_iad_desc_t *iad_desc = (usb_iad_desc_t *)current_desc;
-        if (iad_desc->bFunctionClass == USB_CLASS_VIDEO && iad_desc->bFunctionSubClass == UVC_SC_VIDEO_INTERFACE_COLLECTION) {
-            if (uvc_idx == uvc_iad_idx) {
-                // This is the IAD that we are looking for. Find its first Video Control interface header descriptor
-                header_desc_ret = (const uvc_vc_header_desc_t *)usb_parse_next_descriptor_of_type(current_desc, cfg_desc->wTotalLength, UVC_CS_INTERFACE, &offset);
-                UVC_CHECK(header_desc_ret->bDescriptorSubType == UVC_VC_DESC_SUBTYPE_HEADER, NULL);
-                break;
-            } else {
-                // The user requires next UVC function
-                uvc_iad_idx++;
+esp_err_t uvc_desc_index_get_frame_format_by_format(
+    const uvc_desc_index_intf_t *intf,
+    const uvc_host_stream_format_t *vs_format,
+    const uvc_format_desc_t **format_desc_ret,
+    const uvc_frame_desc_t **frame_desc_ret)
+{
+    UVC_CHECK(intf && vs_format, ESP_ERR_INVALID_ARG);
+
+    for (int i = 0; i < intf->num_formats; i++) {
+        const uvc_desc_index_format_t *format = &intf->formats[i];
+        if (format->format != vs_format->format) {
+            continue;
+        }
+        for (int j = 0; j < format->num_frames; j++) {
+            if (uvc_desc_format_is_equal(format->frames[j], vs_format)) {
+                if (format_desc_ret) {
+                    *format_desc_ret = format->format_desc;
+                }
+                if (frame_desc_ret) {
+                    *frame_desc_ret = format->frames[j];
+                }
+                return ESP_OK;
             }
         }
     }
-    return header_desc_ret;
+    return ESP_ERR_NOT_FOUND;
 }
 
-esp_err_t uvc_desc_get_frame_format_by_index(
-    const usb_config_desc_t *cfg_desc,
-    uint8_t bInterfaceNumber,
+esp_err_t uvc_desc_index_get_frame_format_by_index(
+    const uvc_desc_index_intf_t *intf,
     uint8_t bFormatIndex,
     uint8_t bFrameIndex,
     const uvc_format_desc_t **format_desc_ret,
@@ -313,65 +459,253 @@ esp_err_t uvc_desc_get_frame_format_by_index(
 {
     UVC_CHECK(bFormatIndex > 0, ESP_ERR_INVALID_ARG); // Formats are indexed from 1
     UVC_CHECK(bFrameIndex > 0, ESP_ERR_INVALID_ARG); // Frames are indexed from 1
-    UVC_CHECK(format_desc_ret && frame_desc_ret && cfg_desc, ESP_ERR_INVALID_ARG);
-
-    const uvc_vs_input_header_desc_t *input_header = uvc_desc_get_streaming_input_header(cfg_desc, bInterfaceNumber);
-    UVC_CHECK(input_header, ESP_ERR_NOT_FOUND);
-    UVC_CHECK(input_header->bNumFormats >= bFormatIndex, ESP_ERR_NOT_FOUND);
-
-    // Find requested Format and Frame descriptors
-    esp_err_t ret = ESP_ERR_NOT_FOUND;
-    int format_offset = 0;
-    const usb_standard_desc_t *current_desc = (const usb_standard_desc_t *) input_header;
-    while ((current_desc = usb_parse_next_descriptor_of_type(current_desc, input_header->wTotalLength, UVC_CS_INTERFACE, &format_offset))) {
-        const uvc_format_desc_t *this_format = (const uvc_format_desc_t *)current_desc;
-        if (uvc_desc_is_format_desc(current_desc)) {
-            if (this_format->bFormatIndex == bFormatIndex) {
-                UVC_CHECK(this_format->bNumFrameDescriptors >= bFrameIndex, ESP_ERR_NOT_FOUND);
-                *format_desc_ret = (const uvc_format_desc_t *)this_format;
-                // We found required Format Descriptor
-                // Now we look for correct Frame Descriptors which should be directly after Format
-                while ((current_desc = usb_parse_next_descriptor_of_type(current_desc, input_header->wTotalLength, UVC_CS_INTERFACE, &format_offset))) {
-                    uvc_frame_desc_t *this_frame = (uvc_frame_desc_t *)current_desc;
-                    if (this_frame->bFrameIndex == bFrameIndex) {
-                        *frame_desc_ret = this_frame;
-                        ret = ESP_OK;
-                        break;
-                    }
-                }
-                break;
+    UVC_CHECK(intf && format_desc_ret && frame_desc_ret, ESP_ERR_INVALID_ARG);
+
+    // Descriptors are usually listed in order of their indexes, so we try direct access first
+    const uvc_desc_index_format_t *format = NULL;
+    if (bFormatIndex <= intf->num_formats && intf->formats[bFormatIndex - 1].format_desc->bFormatIndex == bFormatIndex) {
+        format = &intf->formats[bFormatIndex - 1];
+    } else {
+        for (int i = 0; i < intf->num_formats && !format; i++) {
+            if (intf->formats[i].format_desc->bFormatIndex == bFormatIndex) {
+                format = &intf->formats[i];
             }
         }
     }
-    return ret;
+    UVC_CHECK(format, ESP_ERR_NOT_FOUND);
+
+    const uvc_frame_desc_t *frame_desc = NULL;
+    if (bFrameIndex <= format->num_frames && format->frames[bFrameIndex - 1]->bFrameIndex == bFrameIndex) {
+        frame_desc = format->frames[bFrameIndex - 1];
+    } else {
+        for (int i = 0; i < format->num_frames && !frame_desc; i++) {
+            if (format->frames[i]->bFrameIndex == bFrameIndex) {
+                frame_desc = format->frames[i];
+            }
+        }
+    }
+    UVC_CHECK(frame_desc, ESP_ERR_NOT_FOUND);
+
+    *format_desc_ret = format->format_desc;
+    *frame_desc_ret = frame_desc;
+    return ESP_OK;
 }
 
-esp_err_t uvc_desc_get_streaming_interface_num(
-    const usb_config_desc_t *cfg_desc,
+esp_err_t uvc_desc_index_get_streaming_intf(
+    const uvc_desc_index_t *index,
     uint8_t uvc_index,
     const uvc_host_stream_format_t *vs_format,
-    uint16_t *bcdUVC,
-    uint8_t *bInterfaceNumber)
+    const uvc_desc_index_intf_t **intf_ret)
+{
+    UVC_CHECK(index && vs_format && intf_ret, ESP_ERR_INVALID_ARG);
+
+    // Find video streaming interface of requested UVC function that offers the requested format
+    for (size_t i = 0; i < index->num_intfs; i++) {
+        const uvc_desc_index_intf_t *intf = &index->intfs[i];
+        if (intf->uvc_index == uvc_index && uvc_desc_index_get_frame_format_by_format(intf, vs_format, NULL, NULL) == ESP_OK) {
+            *intf_ret = intf;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t uvc_desc_index_get_intf_and_ep_by_bandwidth(
+    const uvc_desc_index_t *index,
+    uint8_t bInterfaceNumber,
+    uint32_t dwMaxPayloadTransferSize,
+    uint32_t max_payload,
+    uint32_t max_bandwidth,
+    bool high_speed,
+    const usb_intf_desc_t **intf_desc_ret,
+    const usb_ep_desc_t **ep_desc_ret)
 {
-    UVC_CHECK(cfg_desc && vs_format && bcdUVC && bInterfaceNumber, ESP_ERR_INVALID_ARG);
+    UVC_CHECK(index && intf_desc_ret && ep_desc_ret, ESP_ERR_INVALID_ARG);
+
+    const uvc_desc_index_alt_t *best_alt = NULL;
+    uint32_t best_payload = 0;
+    uint32_t best_bandwidth = UINT32_MAX;
+    bool best_satisfies = false;
+
+    for (size_t i = 0; i < index->num_alts; i++) {
+        const uvc_desc_index_alt_t *alt = &index->alts[i];
+        if (alt->intf_desc->bInterfaceNumber != bInterfaceNumber || !alt->ep_desc) {
+            continue; // Alternate setting 0 of ISOC cameras has no video endpoint, only the still image endpoint of method 3
+        }
+
+        const usb_ep_desc_t *ep_desc = alt->ep_desc;
+        const uint32_t bandwidth = uvc_desc_ep_bandwidth(ep_desc, high_speed);
+        const uint32_t payload = uvc_desc_ep_payload(ep_desc);
+        if (payload > max_payload || bandwidth > max_bandwidth) {
+            continue; // All transactions of one (micro)frame must fit in FIFO, the alternate must fit in remaining bandwidth
+        }
+
+        // Prefer the alternate that satisfies the payload size with lowest bandwidth.
+        // If there is no such alternate, take the largest payload that fits
+        const bool satisfies = (payload >= dwMaxPayloadTransferSize);
+        bool is_better;
+        if (satisfies != best_satisfies) {
+            is_better = satisfies;
+        } else if (satisfies) {
+            is_better = (bandwidth < best_bandwidth);
+        } else {
+            is_better = (payload > best_payload) || (payload == best_payload && bandwidth < best_bandwidth);
+        }
+        if (!best_alt || is_better) {
+            best_alt = alt;
+            best_payload = payload;
+            best_bandwidth = bandwidth;
+            best_satisfies = satisfies;
+        }
+    }
 
-    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    UVC_CHECK(best_alt, ESP_ERR_NOT_FOUND);
+    *intf_desc_ret = best_alt->intf_desc;
+    *ep_desc_ret = best_alt->ep_desc;
+    return ESP_OK;
+}
 
-    // Get Interface header with uvc_index
-    const uvc_vc_header_desc_t *vc_header_desc = uvc_desc_get_control_interface_header(cfg_desc, uvc_index);
-    if (!vc_header_desc) {
-        return ESP_ERR_NOT_FOUND;
+esp_err_t uvc_desc_index_get_frame_list(const uvc_desc_index_intf_t *intf, uvc_host_frame_info_t *list, size_t *list_size)
+{
+    UVC_CHECK(intf && list_size, ESP_ERR_INVALID_ARG);
+    size_t count = 0;
+    for (uint8_t f = 0; f < intf->num_formats; f++) {
+        const uvc_desc_index_format_t *format = &intf->formats[f];
+        if (format->format == UVC_VS_FORMAT_UNDEFINED) {
+            continue; // Format not supported by this driver
+        }
+        for (uint8_t i = 0; i < format->num_frames; i++, count++) {
+            if (!list || count >= *list_size) {
+                continue; // Only count the frames
+            }
+            const uvc_frame_desc_t *frame_desc = format->frames[i];
+            uvc_host_frame_info_t *info = &list[count];
+            memset(info, 0, sizeof(uvc_host_frame_info_t));
+            info->format = format->format;
+            info->h_res  = frame_desc->wWidth;
+            info->v_res  = frame_desc->wHeight;
+
+            uint8_t bFrameIntervalType;
+            if (frame_desc->bDescriptorSubType == UVC_VS_DESC_SUBTYPE_FRAME_FRAME_BASED) {
+                info->default_interval = frame_desc->frame_based.dwDefaultFrameInterval;
+                bFrameIntervalType = frame_desc->frame_based.bFrameIntervalType;
+                if (bFrameIntervalType == 0) {
+                    info->interval_min  = frame_desc->frame_based.dwMinFrameInterval;
+                    info->interval_max  = frame_desc->frame_based.dwMaxFrameInterval;
+                    info->interval_step = frame_desc->frame_based.dwFrameIntervalStep;
+                } else {
+                    bFrameIntervalType = MIN(bFrameIntervalType, UVC_HOST_FRAME_INTERVALS_MAX);
+                    for (int j = 0; j < bFrameIntervalType; j++) {
+                        info->interval[j] = frame_desc->frame_based.dwFrameInterval[j];
+                    }
+                }
+            } else {
+                info->default_interval = frame_desc->mjpeg_uncompressed.dwDefaultFrameInterval;
+                bFrameIntervalType = frame_desc->mjpeg_uncompressed.bFrameIntervalType;
+                if (bFrameIntervalType == 0) {
+                    info->interval_min  = frame_desc->mjpeg_uncompressed.dwMinFrameInterval;
+                    info->interval_max  = frame_desc->mjpeg_uncompressed.dwMaxFrameInterval;
+                    info->interval_step = frame_desc->mjpeg_uncompressed.dwFrameIntervalStep;
+                } else {
+                    bFrameIntervalType = MIN(bFrameIntervalType, UVC_HOST_FRAME_INTERVALS_MAX);
+                    for (int j = 0; j < bFrameIntervalType; j++) {
+                        info->interval[j] = frame_desc->mjpeg_uncompressed.dwFrameInterval[j];
+                    }
+                }
+            }
+            info->interval_type = bFrameIntervalType;
+        }
+    }
+
+    if (list) {
+        *list_size = MIN(*list_size, count);
+    } else {
+        *list_size = count;
     }
-    *bcdUVC = vc_header_desc->bcdUVC;
-
-    // Find video streaming interface that offers the requested format
-    for (int streaming_if = 0; streaming_if < vc_header_desc->bInCollection; streaming_if++) {
-        uint8_t current_bInterfaceNumber = vc_header_desc->baInterfaceNr[streaming_if];
-        if (uvc_desc_is_format_supported(cfg_desc, current_bInterfaceNumber, vs_format)) {
-            *bInterfaceNumber = current_bInterfaceNumber;
-            ret = ESP_OK;
+    return ESP_OK;
+}
+
+esp_err_t uvc_desc_index_get_still_frame(
+    const uvc_desc_index_intf_t *intf,
+    uint8_t bFormatIndex,
+    unsigned *h_res,
+    unsigned *v_res,
+    uint8_t *bFrameIndex_ret,
+    uint8_t *bCompressionIndex_ret)
+{
+    UVC_CHECK(intf && h_res && v_res && bFrameIndex_ret && bCompressionIndex_ret, ESP_ERR_INVALID_ARG);
+
+    const uvc_still_image_frame_desc_t *still_desc = NULL;
+    for (uint8_t f = 0; f < intf->num_formats; f++) {
+        if (intf->formats[f].format_desc->bFormatIndex == bFormatIndex) {
+            still_desc = intf->formats[f].still_desc;
             break;
         }
     }
-    return ret;
+    UVC_CHECK(still_desc, ESP_ERR_NOT_FOUND);
+
+    // Image size patterns are followed by compression patterns, see USB UVC specification ver 1.5, table 3-18
+    const uint8_t *raw = (const uint8_t *)still_desc;
+    const size_t patterns_offset = offsetof(uvc_still_image_frame_desc_t, wWidth);
+    const size_t num_patterns = MIN(still_desc->bNumImageSizePatterns, (still_desc->bLength - patterns_offset) / 4);
+    uint8_t found_index = 0;
+    uint32_t found_area = 0;
+    for (size_t i = 0; i < num_patterns; i++) {
+        const uint16_t width  = raw[patterns_offset + 4 * i] | (raw[patterns_offset + 4 * i + 1] << 8);
+        const uint16_t height = raw[patterns_offset + 4 * i + 2] | (raw[patterns_offset + 4 * i + 3] << 8);
+        const bool largest = (*h_res == 0 && *v_res == 0 && (uint32_t)width * height > found_area);
+        if (largest || (width == *h_res && height == *v_res)) {
+            found_index = i + 1;
+            found_area = (uint32_t)width * height;
+            if (!largest) {
+                break;
+            }
+        }
+    }
+    UVC_CHECK(found_index != 0, ESP_ERR_NOT_FOUND);
+
+    const size_t compression_offset = patterns_offset + 4 * num_patterns;
+    const uint8_t *found_pattern = raw + patterns_offset + 4 * (found_index - 1);
+    *h_res = found_pattern[0] | (found_pattern[1] << 8);
+    *v_res = found_pattern[2] | (found_pattern[3] << 8);
+    *bFrameIndex_ret = found_index;
+    *bCompressionIndex_ret = (compression_offset < still_desc->bLength && raw[compression_offset] > 0) ? 1 : 0;
+    return ESP_OK;
+}
+
+const uvc_extension_unit_desc_t *uvc_desc_index_get_xu(const uvc_desc_index_intf_t *intf, const uint8_t guidExtensionCode[16])
+{
+    UVC_CHECK(intf && guidExtensionCode, NULL);
+    if (!intf->vc_header_desc) {
+        return NULL;
+    }
+    int offset = 0;
+    const usb_standard_desc_t *desc = (const usb_standard_desc_t *)intf->vc_header_desc;
+    while ((desc = usb_parse_next_descriptor(desc, intf->vc_total_length, &offset))) {
+        const uvc_extension_unit_desc_t *xu_desc = (const uvc_extension_unit_desc_t *)desc;
+        if (desc->bDescriptorType == UVC_CS_INTERFACE &&
+                xu_desc->bDescriptorSubType == UVC_VC_DESC_SUBTYPE_EXTENSION_UNIT &&
+                desc->bLength >= sizeof(uvc_extension_unit_desc_t) &&
+                memcmp(xu_desc->guidExtensionCode, guidExtensionCode, sizeof(xu_desc->guidExtensionCode)) == 0) {
+            return xu_desc;
+        }
+    }
+    return NULL;
+}
+
+uint32_t uvc_desc_xu_get_controls(const uvc_extension_unit_desc_t *xu_desc)
+{
+    UVC_CHECK(xu_desc, 0);
+    // bControlSize follows baSourceID, see USB UVC specification ver 1.5, table 3-10
+    const uint8_t *raw = (const uint8_t *)xu_desc;
+    const size_t size_offset = sizeof(uvc_extension_unit_desc_t) + xu_desc->bNrInPins;
+    if (size_offset >= xu_desc->bLength) {
+        return 0;
+    }
+    const size_t num_bytes = MIN(MIN(raw[size_offset], sizeof(uint32_t)), xu_desc->bLength - size_offset - 1);
+    uint32_t bmControls = 0;
+    for (size_t i = 0; i < num_bytes; i++) {
+        bmControls |= (uint32_t)raw[size_offset + 1 + i] << (8 * i);
+    }
+    return bmControls;
 }
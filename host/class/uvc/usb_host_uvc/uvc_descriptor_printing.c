@@ -163,6 +163,27 @@ static void print_vc_processing_unit_desc(const usb_standard_desc_t *_desc)
     printf("\tbmVideoStandards 0x%X\n", desc->bmVideoStandards);
 }
 
+static void print_vc_encoding_unit_desc(const usb_standard_desc_t *_desc)
+{
+    const uvc_encoding_unit_desc_t *desc = (const uvc_encoding_unit_desc_t *) _desc;
+    printf("\t*** Encoding Unit Descriptor ***\n");
+    printf("\tbLength %u\n", desc->bLength);
+    printf("\tbDescriptorType 0x%02X\n", desc->bDescriptorType);
+    printf("\tbDescriptorSubType 0x%02X\n", desc->bDescriptorSubType);
+    printf("\tbUnitID %u\n", desc->bUnitID);
+    printf("\tbSourceID %u\n", desc->bSourceID);
+    printf("\tiEncoding %u\n", desc->iEncoding);
+    printf("\tbControlSize %u\n", desc->bControlSize);
+    printf("\tbmControls 0x%X 0x%X 0x%X\n",
+           desc->bmControls[0],
+           desc->bmControls[1],
+           desc->bmControls[2]);
+    printf("\tbmControlsRuntime 0x%X 0x%X 0x%X\n",
+           desc->bmControlsRuntime[0],
+           desc->bmControlsRuntime[1],
+           desc->bmControlsRuntime[2]);
+}
+
 static void print_vs_format_mjpeg_desc(const usb_standard_desc_t *_desc)
 {
     const uvc_format_desc_t *desc = (const uvc_format_desc_t *) _desc;
@@ -332,7 +353,11 @@ static void print_class_specific_desc(const usb_standard_desc_t *_desc)
         }
         print_vs_format_mjpeg_desc(_desc);
         break;
-    case UVC_VS_DESC_SUBTYPE_FRAME_MJPEG:
+    case UVC_VS_DESC_SUBTYPE_FRAME_MJPEG: // same as UVC_VC_DESC_SUBTYPE_ENCODING_UNIT
+        if (interface_sub_class == UVC_SC_VIDEOCONTROL) {
+            print_vc_encoding_unit_desc(_desc);
+            return;
+        }
         print_vs_frame_mjpeg_desc(_desc);
         break;
     case UVC_VS_DESC_SUBTYPE_FORMAT_FRAME_BASED:
@@ -0,0 +1,321 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <assert.h>
+#include <string.h> // For memset
+
+#include "esp_check.h"
+#include "usb/usb_types_ch9.h"
+#include "usb/usb_types_uvc.h"
+#include "usb/uvc_host.h"
+
+#include "uvc_control.h"
+#include "uvc_encoding_priv.h"
+#include "uvc_descriptors_priv.h"
+#include "uvc_types_priv.h"
+#include "uvc_check_priv.h"
+#include "uvc_critical_priv.h"
+#include "uvc_transfer_priv.h"
+
+static const char *TAG = "uvc-encoding";
+
+static const uint8_t uvcx_guid[16] = UVC_UVCX_GUID;
+
+void uvc_enc_get_info(const uvc_desc_index_intf_t *intf, uvc_host_enc_info_t *info_ret)
+{
+    memset(info_ret, 0, sizeof(uvc_host_enc_info_t));
+    const uvc_encoding_unit_desc_t *eu_desc = intf->enc_unit_desc;
+    if (eu_desc) {
+        info_ret->type = UVC_HOST_ENC_UNIT;
+        info_ret->bUnitID = eu_desc->bUnitID;
+        info_ret->bmControls = eu_desc->bmControls[0] | (eu_desc->bmControls[1] << 8) | (eu_desc->bmControls[2] << 16);
+        info_ret->bmControlsRuntime = eu_desc->bmControlsRuntime[0] | (eu_desc->bmControlsRuntime[1] << 8) | (eu_desc->bmControlsRuntime[2] << 16);
+        return;
+    }
+
+    // Cameras predating UVC 1.5 expose the encoder in UVCX extension unit, whose controls can be changed while streaming
+    const uvc_extension_unit_desc_t *xu_desc = uvc_desc_index_get_xu(intf, uvcx_guid);
+    if (xu_desc) {
+        info_ret->type = UVC_HOST_ENC_UVCX;
+        info_ret->bUnitID = xu_desc->bUnitID;
+        info_ret->bmControls = uvc_desc_xu_get_controls(xu_desc);
+        info_ret->bmControlsRuntime = info_ret->bmControls;
+    }
+}
+
+/**
+ * @brief Check that the encoder supports a control
+ *
+ * @param[in] info      Encoder
+ * @param[in] bSelector Control selector
+ * @param[in] streaming The stream is streaming
+ * @return
+ *     - ESP_OK: The control can be set
+ *     - ESP_ERR_NOT_SUPPORTED: The encoder does not support the control
+ *     - ESP_ERR_INVALID_STATE: The control cannot be changed while streaming
+ */
+static esp_err_t uvc_enc_check_control(const uvc_host_enc_info_t *info, uint8_t bSelector, bool streaming)
+{
+    const uint32_t bit = 1UL << (bSelector - 1);
+    ESP_RETURN_ON_FALSE(info->bmControls & bit, ESP_ERR_NOT_SUPPORTED, TAG, "Control %d of unit %d not supported", bSelector, info->bUnitID);
+    ESP_RETURN_ON_FALSE(!streaming || (info->bmControlsRuntime & bit), ESP_ERR_INVALID_STATE, TAG, "Control %d of unit %d cannot be changed while streaming", bSelector, info->bUnitID);
+    return ESP_OK;
+}
+
+/**
+ * @brief Append request
+ *
+ * @param[inout] reqs      Requests
+ * @param[inout] data_used Bytes of reqs->data used by previous requests
+ * @param[in]    info      Encoder
+ * @param[in]    bRequest  Request code
+ * @param[in]    bSelector Control selector
+ * @param[in]    wLength   Length of control data
+ * @param[in]    data      Control data shared with previous request. NULL: New zeroed data
+ * @return Control data of the request
+ */
+static uint8_t *uvc_enc_add_req(uvc_enc_reqs_t *reqs, size_t *data_used, const uvc_host_enc_info_t *info,
+                                uint8_t bRequest, uint8_t bSelector, uint16_t wLength, uint8_t *data)
+{
+    assert(reqs->num_reqs < UVC_ENC_REQS_MAX);
+    if (!data) {
+        assert(*data_used + wLength <= UVC_ENC_DATA_SIZE);
+        data = &reqs->data[*data_used];
+        *data_used += wLength;
+    }
+    reqs->reqs[reqs->num_reqs++] = (uvc_host_ctrl_req_t) {
+        .bRequest = bRequest,
+        .bUnitID = info->bUnitID,
+        .bSelector = bSelector,
+        .wLength = wLength,
+        .data = data,
+        .status = ESP_OK,
+    };
+    return data;
+}
+
+/**
+ * @brief Write little-endian value
+ *
+ * @param[out] data      Destination
+ * @param[in]  value     Value
+ * @param[in]  num_bytes Bytes to write, 1 to 4
+ */
+static void uvc_enc_put_le(uint8_t *data, uint32_t value, size_t num_bytes)
+{
+    for (size_t i = 0; i < num_bytes; i++) {
+        data[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+/**
+ * @brief Build requests of Encoding Unit of UVC 1.5
+ *
+ * @see USB UVC specification ver 1.5, section 4.2.2.4
+ */
+static esp_err_t uvc_enc_build_unit_reqs(const uvc_host_enc_info_t *info, const uvc_host_enc_params_t *params, bool streaming, uvc_enc_reqs_t *reqs)
+{
+    const uint32_t flags = params->flags;
+    // Check all controls first, so no request is built for parameters the camera would partly reject
+    if (flags & UVC_HOST_ENC_SET_BITRATE) {
+        ESP_RETURN_ON_ERROR(uvc_enc_check_control(info, UVC_EU_AVERAGE_BITRATE_CONTROL, streaming), TAG, "Bitrate");
+        if (params->peak_bitrate) {
+            ESP_RETURN_ON_ERROR(uvc_enc_check_control(info, UVC_EU_PEAK_BIT_RATE_CONTROL, streaming), TAG, "Peak bitrate");
+        }
+    }
+    if (flags & UVC_HOST_ENC_SET_QP) {
+        ESP_RETURN_ON_ERROR(uvc_enc_check_control(info, UVC_EU_QUANTIZATION_PARAMS_CONTROL, streaming), TAG, "QP");
+    }
+    if (flags & (UVC_HOST_ENC_FORCE_IDR | UVC_HOST_ENC_SET_GOP)) {
+        ESP_RETURN_ON_ERROR(uvc_enc_check_control(info, UVC_EU_SYNC_REF_FRAME_CONTROL, streaming), TAG, "IDR");
+    }
+
+    size_t data_used = 0;
+    uint8_t *data;
+    if (flags & UVC_HOST_ENC_SET_BITRATE) {
+        data = uvc_enc_add_req(reqs, &data_used, info, UVC_SET_CUR, UVC_EU_AVERAGE_BITRATE_CONTROL, 4, NULL);
+        uvc_enc_put_le(data, params->average_bitrate, 4); // dwAverageBitRate
+        if (params->peak_bitrate) {
+            data = uvc_enc_add_req(reqs, &data_used, info, UVC_SET_CUR, UVC_EU_PEAK_BIT_RATE_CONTROL, 4, NULL);
+            uvc_enc_put_le(data, params->peak_bitrate, 4); // dwPeakBitRate
+        }
+    }
+    if (flags & UVC_HOST_ENC_SET_QP) {
+        data = uvc_enc_add_req(reqs, &data_used, info, UVC_SET_CUR, UVC_EU_QUANTIZATION_PARAMS_CONTROL, 6, NULL);
+        uvc_enc_put_le(&data[0], params->qp_i, 2); // wQpPrime_I
+        uvc_enc_put_le(&data[2], params->qp_p, 2); // wQpPrime_P
+        uvc_enc_put_le(&data[4], params->qp_b, 2); // wQpPrime_B
+    }
+
+    // Setting Synchronization control makes the encoder send a sync frame now and then every wSyncFrameInterval
+    if (flags & UVC_HOST_ENC_SET_GOP) {
+        data = uvc_enc_add_req(reqs, &data_used, info, UVC_SET_CUR, UVC_EU_SYNC_REF_FRAME_CONTROL, 4, NULL);
+        data[0] = UVC_EU_SYNC_FRAME_IDR_WITH_PARAMS; // bSyncFrameType
+        uvc_enc_put_le(&data[1], params->gop_ms, 2); // wSyncFrameInterval
+        data[3] = 0;                                 // bGradualDecoderRefresh
+    } else if (flags & UVC_HOST_ENC_FORCE_IDR) {
+        // The camera's sync frame type and interval are read into the data the SET request sends, so its GOP is kept
+        data = uvc_enc_add_req(reqs, &data_used, info, UVC_GET_CUR, UVC_EU_SYNC_REF_FRAME_CONTROL, 4, NULL);
+        uvc_enc_add_req(reqs, &data_used, info, UVC_SET_CUR, UVC_EU_SYNC_REF_FRAME_CONTROL, 4, data);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Build requests of UVCX extension unit
+ *
+ * @see USB Device Class Definition for Video Devices: H.264 Payload 1.0, section 3.3
+ */
+static esp_err_t uvc_enc_build_uvcx_reqs(const uvc_host_enc_info_t *info, const uvc_host_enc_params_t *params, bool streaming, uvc_enc_reqs_t *reqs)
+{
+    const uint32_t flags = params->flags;
+    // GOP and QP are part of UVCX video configuration, which is probed and committed only before streaming
+    ESP_RETURN_ON_FALSE(!(flags & (UVC_HOST_ENC_SET_GOP | UVC_HOST_ENC_SET_QP)), ESP_ERR_NOT_SUPPORTED, TAG, "GOP and QP not supported by UVCX");
+    if (flags & UVC_HOST_ENC_SET_BITRATE) {
+        ESP_RETURN_ON_ERROR(uvc_enc_check_control(info, UVC_UVCX_BITRATE_LAYERS, streaming), TAG, "Bitrate");
+    }
+    if (flags & UVC_HOST_ENC_FORCE_IDR) {
+        ESP_RETURN_ON_ERROR(uvc_enc_check_control(info, UVC_UVCX_PICTURE_TYPE_CONTROL, streaming), TAG, "IDR");
+    }
+
+    size_t data_used = 0;
+    uint8_t *data;
+    if (flags & UVC_HOST_ENC_SET_BITRATE) {
+        data = uvc_enc_add_req(reqs, &data_used, info, UVC_SET_CUR, UVC_UVCX_BITRATE_LAYERS, 10, NULL);
+        uvc_enc_put_le(&data[0], 0, 2); // wLayerID: All layers
+        uvc_enc_put_le(&data[2], params->peak_bitrate ? params->peak_bitrate : params->average_bitrate, 4); // dwPeakBitrate
+        uvc_enc_put_le(&data[6], params->average_bitrate, 4); // dwAverageBitrate
+    }
+    if (flags & UVC_HOST_ENC_FORCE_IDR) {
+        data = uvc_enc_add_req(reqs, &data_used, info, UVC_SET_CUR, UVC_UVCX_PICTURE_TYPE_CONTROL, 4, NULL);
+        uvc_enc_put_le(&data[0], 0, 2); // wLayerID: All layers
+        uvc_enc_put_le(&data[2], UVC_UVCX_PICTURE_TYPE_IDR_FULL, 2); // wPicType
+    }
+    return ESP_OK;
+}
+
+esp_err_t uvc_enc_build_reqs(const uvc_host_enc_info_t *info, const uvc_host_enc_params_t *params, bool streaming, uvc_enc_reqs_t *reqs_ret)
+{
+    UVC_CHECK(info && params && reqs_ret && params->flags != 0, ESP_ERR_INVALID_ARG);
+    memset(reqs_ret, 0, sizeof(uvc_enc_reqs_t));
+    switch (info->type) {
+    case UVC_HOST_ENC_UNIT:
+        return uvc_enc_build_unit_reqs(info, params, streaming, reqs_ret);
+    case UVC_HOST_ENC_UVCX:
+        return uvc_enc_build_uvcx_reqs(info, params, streaming, reqs_ret);
+    default:
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+}
+
+esp_err_t uvc_host_ctrl_find_xu(uvc_host_stream_hdl_t stream_hdl, const uint8_t guidExtensionCode[16], uint8_t *bUnitID_ret)
+{
+    UVC_CHECK(stream_hdl && guidExtensionCode && bUnitID_ret, ESP_ERR_INVALID_ARG);
+    uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
+    const uvc_extension_unit_desc_t *xu_desc = uvc_desc_index_get_xu(uvc_stream->constant.vs_intf, guidExtensionCode);
+    UVC_CHECK(xu_desc, ESP_ERR_NOT_FOUND);
+    *bUnitID_ret = xu_desc->bUnitID;
+    return ESP_OK;
+}
+
+esp_err_t uvc_host_enc_get_info(uvc_host_stream_hdl_t stream_hdl, uvc_host_enc_info_t *info_ret)
+{
+    UVC_CHECK(stream_hdl && info_ret, ESP_ERR_INVALID_ARG);
+    uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
+    uvc_enc_get_info(uvc_stream->constant.vs_intf, info_ret);
+    return ESP_OK;
+}
+
+/**
+ * @brief Build requests of encoder parameters for a stream
+ *
+ * @param[in]  uvc_stream UVC stream
+ * @param[in]  params     Encoder parameters
+ * @param[out] reqs_ret   Requests
+ * @return See uvc_enc_build_reqs()
+ */
+static esp_err_t uvc_enc_build_stream_reqs(uvc_stream_t *uvc_stream, const uvc_host_enc_params_t *params, uvc_enc_reqs_t *reqs_ret)
+{
+    uvc_host_enc_info_t info;
+    uvc_enc_get_info(uvc_stream->constant.vs_intf, &info);
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    const bool streaming = uvc_stream->dynamic.streaming;
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+    return uvc_enc_build_reqs(&info, params, streaming, reqs_ret);
+}
+
+esp_err_t uvc_host_enc_apply(uvc_host_stream_hdl_t stream_hdl, const uvc_host_enc_params_t *params)
+{
+    UVC_CHECK(stream_hdl && params, ESP_ERR_INVALID_ARG);
+    uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
+    uvc_enc_reqs_t reqs;
+    ESP_RETURN_ON_ERROR(uvc_enc_build_stream_reqs(uvc_stream, params, &reqs), TAG, "Could not apply encoder parameters");
+
+    for (size_t i = 0; i < reqs.num_reqs; i++) {
+        const uvc_host_ctrl_req_t *req = &reqs.reqs[i];
+        const bool get = (req->bRequest & USB_BM_REQUEST_TYPE_DIR_IN); // Request codes of GET requests have the highest bit set
+        const uint8_t bmRequestType = USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIP_INTERFACE |
+                                      (get ? USB_BM_REQUEST_TYPE_DIR_IN : USB_BM_REQUEST_TYPE_DIR_OUT);
+        const uint16_t wIndex = (req->bUnitID << 8) | uvc_stream->constant.vs_intf->bControlInterface;
+        ESP_RETURN_ON_ERROR(
+            uvc_host_usb_ctrl(stream_hdl, bmRequestType, req->bRequest, req->bSelector << 8, wIndex, req->wLength, req->data),
+            TAG, "Encoder control %d of unit %d failed", req->bSelector, req->bUnitID);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Asynchronous encoder parameters
+ *
+ * Owns the requests until the batch is finished
+ */
+typedef struct {
+    uvc_enc_reqs_t reqs;              // Requests and their data
+    uvc_host_stream_hdl_t stream_hdl; // Stream the parameters are applied to
+    uvc_host_enc_callback_t enc_cb;   // User's completion callback
+    void *user_arg;                   // User's argument
+} uvc_enc_async_t;
+
+/**
+ * @brief Completion callback of the batch of encoder requests
+ *
+ * @param[in] reqs     Finished requests
+ * @param[in] num_reqs Number of requests
+ * @param[in] user_arg Asynchronous encoder parameters
+ */
+static void uvc_enc_ctrl_cb(uvc_host_ctrl_req_t *reqs, size_t num_reqs, void *user_arg)
+{
+    uvc_enc_async_t *enc_async = (uvc_enc_async_t *)user_arg;
+    esp_err_t status = ESP_OK;
+    for (size_t i = 0; i < num_reqs && status == ESP_OK; i++) {
+        status = reqs[i].status;
+    }
+    enc_async->enc_cb(enc_async->stream_hdl, status, enc_async->user_arg);
+    UVC_FREE(CONTROL, enc_async, sizeof(uvc_enc_async_t));
+}
+
+esp_err_t uvc_host_enc_apply_async(uvc_host_stream_hdl_t stream_hdl, const uvc_host_enc_params_t *params, uvc_host_enc_callback_t enc_cb, void *user_arg)
+{
+    UVC_CHECK(stream_hdl && params && enc_cb, ESP_ERR_INVALID_ARG);
+    uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
+    uvc_enc_async_t *enc_async = UVC_CALLOC(CONTROL, 1, sizeof(uvc_enc_async_t));
+    UVC_CHECK(enc_async, ESP_ERR_NO_MEM);
+
+    // Failed GET_CUR of IDR request leaves zeroed data, whose reserved sync frame type the camera rejects in the SET_CUR
+    esp_err_t ret;
+    ESP_GOTO_ON_ERROR(uvc_enc_build_stream_reqs(uvc_stream, params, &enc_async->reqs), err, TAG, "Could not apply encoder parameters");
+    enc_async->stream_hdl = stream_hdl;
+    enc_async->enc_cb = enc_cb;
+    enc_async->user_arg = user_arg;
+    ESP_GOTO_ON_ERROR(
+        uvc_host_ctrl_submit(stream_hdl, enc_async->reqs.reqs, enc_async->reqs.num_reqs, uvc_enc_ctrl_cb, enc_async),
+        err, TAG, "Could not submit encoder requests");
+    return ESP_OK;
+
+err:
+    UVC_FREE(CONTROL, enc_async, sizeof(uvc_enc_async_t));
+    return ret;
+}
@@ -4,8 +4,9 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
-#include <string.h> // For memcpy
+#include <string.h> // For memcpy and memchr
 #include <inttypes.h>
+#include <sys/param.h> // For MIN
 
 #include "esp_check.h"
 #include "esp_heap_caps.h"
@@ -13,54 +14,432 @@
 #include "usb/uvc_host.h"
 #include "uvc_frame_priv.h"
 #include "uvc_types_priv.h"
+#include "uvc_still_priv.h"
+#include "uvc_frame_pool_priv.h"
 #include "uvc_check_priv.h"
+#include "uvc_critical_priv.h"
+#include "uvc_transfer_priv.h"
+#include "uvc_staging_priv.h"
+#include "uvc_processing_priv.h"
+#include "uvc_stats_priv.h"
+#include "uvc_attr_priv.h"
 
 #include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
 
 static const char *TAG = "uvc-frame";
 
-esp_err_t uvc_host_frame_return(uvc_host_stream_hdl_t stream_hdl, uvc_host_frame_t *frame)
+#define UVC_MJPEG_SOI (0xFFD8) // JPEG Start of Image marker
+#define UVC_MJPEG_EOI (0xFFD9) // JPEG End of Image marker
+
+#define UVC_FRAME_EXT_CHUNKS       (16)   // Adaptive frame size: Maximum number of extension chunks of one frame
+#define UVC_FRAME_SIZE_GRANULARITY (4096) // Adaptive frame size: Frame buffer sizes are rounded up to multiple of this
+
+/**
+ * @brief Frame buffer object
+ *
+ * Public part of the frame is the first member, so pointer to this object can be passed to user as uvc_host_frame_t
+ */
+typedef struct {
+    uvc_host_frame_t frame;             // Public part of the frame. Must be the first member
+    size_t data_alloc_size;             // Allocated size of the data buffer, rounded up with staging buffer. 0 in frame pool mode
+    uvc_host_frame_segment_t *segments; // Zero-copy only: Storage of frame segments
+    size_t max_segments;                // Zero-copy only: Capacity of the segments storage
+    uint32_t urb_mask;                  // Zero-copy only: Bit mask of URBs referenced by this frame
+    bool slice_started;                 // Slice mode only: First slice of this frame was passed to user
+    uint16_t mjpeg_head;                // MJPEG validation only: First 2 bytes of the frame
+    uint16_t mjpeg_tail;                // MJPEG validation only: Last 2 bytes of the frame before trailing 0x00/0xFF padding
+    uint8_t mjpeg_last;                 // MJPEG validation only: Last byte of the frame
+    uint8_t mjpeg_head_len;             // MJPEG validation only: Number of valid bytes in mjpeg_head
+    uvc_host_nal_unit_t *nal_units;     // NAL index only: Storage of indexed NAL units
+    size_t nal_scanned;                 // NAL index only: Number of frame bytes scanned for start codes
+    size_t nal_zeros;                   // NAL index only: Number of zero bytes at the end of scanned data
+    bool nal_header_pending;            // NAL index only: Next byte is NAL unit header
+    bool nal_open;                      // NAL index only: Length of the last indexed NAL unit is not known yet
+    uvc_host_frame_lost_range_t lost_ranges[UVC_HOST_FRAME_LOST_RANGES]; // Corrupt frame delivery only: Storage of damaged ranges
+    uint8_t *ext_chunks[UVC_FRAME_EXT_CHUNKS]; // Adaptive frame size only: Data that did not fit in the frame buffer
+    unsigned num_ext_chunks;            // Adaptive frame size only: Number of allocated extension chunks
+    uint8_t index;                      // Index of this frame in stream's frame array
+} uvc_frame_t;
+
+/**
+ * @brief Get index of the transfer in stream's transfer array
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] transfer   USB transfer
+ * @return Index of the transfer
+ */
+static unsigned UVC_DATA_PATH_ATTR uvc_frame_urb_index(const uvc_stream_t *uvc_stream, const usb_transfer_t *transfer)
+{
+    for (unsigned i = 0; i < uvc_stream->constant.num_of_xfers; i++) {
+        if (uvc_stream->constant.xfers[i] == transfer) {
+            return i;
+        }
+    }
+    abort(); // The transfer must belong to this stream
+}
+
+/**
+ * @brief Release URBs and submit those that are no longer referenced
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] urb_mask   Bit mask of URBs to release
+ */
+static void UVC_DATA_PATH_ATTR uvc_frame_urbs_release(uvc_stream_t *uvc_stream, uint32_t urb_mask)
+{
+    uint32_t submit_mask = 0;
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    const bool streaming = uvc_stream->dynamic.streaming;
+    for (unsigned i = 0; i < uvc_stream->constant.num_of_xfers; i++) {
+        if (urb_mask & (1UL << i)) {
+            assert(uvc_stream->constant.urb_refs[i] > 0);
+            uvc_stream->constant.urb_refs[i]--;
+            if (uvc_stream->constant.urb_refs[i] == 0 && streaming) {
+                submit_mask |= (1UL << i);
+            }
+        }
+    }
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+
+    for (unsigned i = 0; i < uvc_stream->constant.num_of_xfers; i++) {
+        if (submit_mask & (1UL << i)) {
+            UVC_TRANSFER_SUBMIT(uvc_stream->constant.xfers[i]);
+        }
+    }
+}
+
+/**
+ * @brief Pass content of the frame buffer to the user as a slice
+ *
+ * The frame buffer is emptied after the slice callback returns.
+ *
+ * @param[in] uvc_stream   UVC stream
+ * @param[in] frame        Frame buffer
+ * @param[in] end_of_frame This is the last slice of the frame
+ * @param[in] frame_error  The frame is corrupted
+ */
+static void UVC_DATA_PATH_ATTR uvc_frame_slice_deliver(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame, bool end_of_frame, bool frame_error)
+{
+    uvc_frame_t *this_fb = (uvc_frame_t *)frame;
+    const uvc_host_frame_slice_t slice = {
+        .data = frame->data,
+        .data_len = frame->data_len,
+        .start_of_frame = !this_fb->slice_started,
+        .end_of_frame = end_of_frame,
+        .frame_error = frame_error,
+        .pts_valid = uvc_stream->single_thread.timestamp.pts_valid,
+        .pts = uvc_stream->single_thread.timestamp.pts,
+    };
+    this_fb->slice_started = true;
+    UVC_TRACE(DELIVER, uvc_stream->constant.bEndpointAddress, slice.data_len, this_fb);
+    UVC_TRACE(CALLBACK_ENTER, uvc_stream->constant.bEndpointAddress, 0, this_fb);
+    uvc_stream->constant.slice_cb(&slice, uvc_stream->constant.cb_arg);
+    UVC_TRACE(CALLBACK_EXIT, uvc_stream->constant.bEndpointAddress, 0, this_fb);
+    frame->data_len = 0;
+}
+
+/**
+ * @brief Add data to the frame buffer in slice mode
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] frame      Frame buffer
+ * @param[in] data       Pointer to data
+ * @param[in] data_len   Data length in bytes
+ * @return
+ *     - ESP_OK: Data added to the frame buffer
+ *     - ESP_ERR_INVALID_ARG: frame or data is NULL
+ */
+static esp_err_t UVC_DATA_PATH_ATTR uvc_frame_add_slice_data(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame, const uint8_t *data, size_t data_len)
+{
+    if (data_len == 0) {
+        return ESP_OK; // Fast return in case of zero data
+    }
+    UVC_CHECK(frame && data, ESP_ERR_INVALID_ARG);
+
+    while (data_len > 0) {
+        // Full slices are passed to the user lazily, so the last slice can be marked with end_of_frame
+        if (frame->data_len == frame->data_buffer_len) {
+            uvc_frame_slice_deliver(uvc_stream, frame, false, false);
+        }
+        const size_t chunk = MIN(data_len, frame->data_buffer_len - frame->data_len);
+        memcpy(frame->data + frame->data_len, data, chunk);
+        frame->data_len += chunk;
+        data += chunk;
+        data_len -= chunk;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Free extension chunks of the frame
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] this_fb    Frame buffer
+ */
+static void uvc_frame_ext_free(uvc_stream_t *uvc_stream, uvc_frame_t *this_fb)
+{
+    for (unsigned i = 0; i < this_fb->num_ext_chunks; i++) {
+        UVC_FREE(BUFFER, this_fb->ext_chunks[i], uvc_stream->constant.adaptive.chunk_size);
+        this_fb->ext_chunks[i] = NULL;
+    }
+    this_fb->num_ext_chunks = 0;
+}
+
+/**
+ * @brief Add data to the frame buffer in adaptive frame size mode
+ *
+ * Data that do not fit in the frame buffer are stored in extension chunks, allocated as needed.
+ * The chunks are merged into the frame buffer by uvc_frame_adaptive_end().
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] frame      Frame buffer
+ * @param[in] data       Pointer to data
+ * @param[in] data_len   Data length in bytes
+ * @return
+ *     - ESP_OK: Data added to the frame
+ *     - ESP_ERR_INVALID_ARG: frame or data is NULL
+ *     - ESP_ERR_INVALID_SIZE: Frame is larger than maximum frame size
+ *     - ESP_ERR_NO_MEM: Not enough memory for extension chunk
+ */
+static esp_err_t UVC_DATA_PATH_ATTR uvc_frame_add_adaptive_data(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame, const uint8_t *data, size_t data_len)
+{
+    if (data_len == 0) {
+        return ESP_OK; // Fast return in case of zero data
+    }
+    UVC_CHECK(frame && data, ESP_ERR_INVALID_ARG);
+    UVC_CHECK(frame->data_len + data_len <= MAX(frame->data_buffer_len, uvc_stream->constant.adaptive.max_size), ESP_ERR_INVALID_SIZE);
+
+    // Fast path: The data fit in the frame buffer
+    if (frame->data_len + data_len <= frame->data_buffer_len) {
+        memcpy(frame->data + frame->data_len, data, data_len);
+        frame->data_len += data_len;
+        return ESP_OK;
+    }
+
+    uvc_frame_t *this_fb = (uvc_frame_t *)frame;
+    if (frame->data_len < frame->data_buffer_len) {
+        const size_t chunk = frame->data_buffer_len - frame->data_len;
+        memcpy(frame->data + frame->data_len, data, chunk);
+        frame->data_len += chunk;
+        data += chunk;
+        data_len -= chunk;
+    }
+    const size_t chunk_size = uvc_stream->constant.adaptive.chunk_size;
+    while (data_len > 0) {
+        const size_t ext_offset = frame->data_len - frame->data_buffer_len;
+        const unsigned index = ext_offset / chunk_size;
+        UVC_CHECK(index < UVC_FRAME_EXT_CHUNKS, ESP_ERR_INVALID_SIZE);
+        if (index == this_fb->num_ext_chunks) {
+            this_fb->ext_chunks[index] = UVC_MALLOC(BUFFER, chunk_size, uvc_stream->constant.frame_heap_caps);
+            UVC_CHECK(this_fb->ext_chunks[index], ESP_ERR_NO_MEM);
+            this_fb->num_ext_chunks++;
+        }
+        const size_t offset = ext_offset % chunk_size;
+        const size_t chunk = MIN(data_len, chunk_size - offset);
+        memcpy(this_fb->ext_chunks[index] + offset, data, chunk);
+        frame->data_len += chunk;
+        data += chunk;
+        data_len -= chunk;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Record size of received frame and update target size of frame buffers
+ *
+ * The target is the configured percentile of recent frame sizes plus headroom, limited by maximum frame size.
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] frame_len  Size of received frame in bytes
+ */
+static void UVC_DATA_PATH_ATTR uvc_frame_size_record(uvc_stream_t *uvc_stream, size_t frame_len)
+{
+    uvc_frame_size_history_t *history = &uvc_stream->single_thread.frame_size;
+    history->sizes[history->next] = frame_len;
+    history->next = (history->next + 1) % UVC_FRAME_SIZE_HISTORY;
+    if (history->count < UVC_FRAME_SIZE_HISTORY) {
+        history->count++;
+    }
+
+    // Insertion sort of a copy, the history is short
+    uint32_t sorted[UVC_FRAME_SIZE_HISTORY];
+    for (unsigned i = 0; i < history->count; i++) {
+        unsigned j = i;
+        for (; j > 0 && sorted[j - 1] > history->sizes[i]; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = history->sizes[i];
+    }
+    const unsigned rank = (history->count * uvc_stream->constant.adaptive.percentile + 99) / 100; // Nearest-rank percentile
+    const size_t percentile_size = sorted[rank > 0 ? rank - 1 : 0];
+    const size_t target = percentile_size + percentile_size * uvc_stream->constant.adaptive.headroom_percent / 100;
+    history->target = MIN(usb_round_up_to_mps(target, UVC_FRAME_SIZE_GRANULARITY), uvc_stream->constant.adaptive.max_size);
+}
+
+void uvc_frame_adaptive_set_max_size(uvc_stream_t *uvc_stream, size_t max_frame_size)
+{
+    // Extension chunks of a frame can hold the biggest frame even if its frame buffer is tiny
+    const size_t chunk_size = (max_frame_size + UVC_FRAME_EXT_CHUNKS - 1) / UVC_FRAME_EXT_CHUNKS;
+    uvc_stream->constant.adaptive.max_size = max_frame_size;
+    uvc_stream->constant.adaptive.chunk_size = usb_round_up_to_mps(MAX(chunk_size, 1), UVC_FRAME_SIZE_GRANULARITY);
+    memset(&uvc_stream->single_thread.frame_size, 0, sizeof(uvc_stream->single_thread.frame_size));
+}
+
+esp_err_t UVC_DATA_PATH_ATTR uvc_frame_adaptive_end(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame)
+{
+    if (!uvc_stream->constant.adaptive.enabled || !frame) {
+        return ESP_OK;
+    }
+    uvc_frame_size_record(uvc_stream, frame->data_len);
+    uvc_frame_t *this_fb = (uvc_frame_t *)frame;
+    if (this_fb->num_ext_chunks == 0) {
+        return ESP_OK;
+    }
+
+    // Grow the frame buffer, so it holds this frame and the next ones, and move the extension chunks behind its content
+    const size_t new_size = MAX(uvc_stream->single_thread.frame_size.target, frame->data_len);
+    uint8_t *new_data = UVC_REALLOC(BUFFER, frame->data, this_fb->data_alloc_size, new_size, uvc_stream->constant.frame_heap_caps);
+    if (!new_data) {
+        uvc_frame_ext_free(uvc_stream, this_fb);
+        return ESP_ERR_NO_MEM;
+    }
+    const size_t chunk_size = uvc_stream->constant.adaptive.chunk_size;
+    size_t offset = frame->data_buffer_len;
+    for (unsigned i = 0; i < this_fb->num_ext_chunks; i++) {
+        const size_t chunk = MIN(frame->data_len - offset, chunk_size);
+        memcpy(new_data + offset, this_fb->ext_chunks[i], chunk);
+        offset += chunk;
+    }
+    uvc_frame_ext_free(uvc_stream, this_fb);
+    frame->data = new_data;
+    frame->data_buffer_len = new_size;
+    this_fb->data_alloc_size = new_size;
+    uvc_stats_frame_extended(uvc_stream);
+    return ESP_OK;
+}
+
+/**
+ * @brief Resize empty frame buffer to target size of adaptive frame size mode
+ *
+ * Buffers smaller than the target grow, buffers bigger than twice the target shrink.
+ * The old buffer is kept if the new one cannot be allocated.
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] frame      Empty frame buffer owned by the driver
+ */
+static void UVC_DATA_PATH_ATTR uvc_frame_adaptive_resize(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame)
+{
+    const size_t target = uvc_stream->single_thread.frame_size.target;
+    if (target == 0 || (frame->data_buffer_len >= target && frame->data_buffer_len <= target * 2)) {
+        return;
+    }
+    uvc_frame_t *this_fb = (uvc_frame_t *)frame;
+    uint8_t *new_data = UVC_MALLOC(BUFFER, target, uvc_stream->constant.frame_heap_caps);
+    if (new_data) {
+        UVC_FREE(BUFFER, frame->data, this_fb->data_alloc_size);
+        frame->data = new_data;
+        frame->data_buffer_len = target;
+        this_fb->data_alloc_size = target;
+        uvc_stats_frame_resized(uvc_stream);
+    }
+}
+
+esp_err_t UVC_DATA_PATH_ATTR uvc_host_frame_return(uvc_host_stream_hdl_t stream_hdl, uvc_host_frame_t *frame)
 {
     UVC_CHECK(stream_hdl && frame, ESP_ERR_INVALID_ARG);
     uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
-    uvc_frame_reset(frame);
-    BaseType_t result = xQueueSend(uvc_stream->constant.empty_fb_queue, &frame, 0);
-    UVC_CHECK(pdPASS == result, ESP_FAIL);
+    if (uvc_still_owns_frame(uvc_stream, frame)) {
+        return uvc_still_frame_return(uvc_stream, frame);
+    }
+    // A frame returned twice may already be filled again by the driver and its buffer owned by another stream
+    const uint32_t frame_bit = 1UL << ((uvc_frame_t *)frame)->index;
+    UVC_CHECK(!(UVC_ATOMIC_LOAD(uvc_stream->constant.empty_frames) & frame_bit), ESP_FAIL);
+    uvc_frame_reset(uvc_stream, frame);
+    if (uvc_stream->constant.frame_pool && frame->data) {
+        // Data buffer goes back to the shared pool, the frame object stays with this stream
+        uvc_frame_pool_give(uvc_stream, frame->data);
+        frame->data = NULL;
+        frame->data_buffer_len = 0;
+    }
+    // The frame is handed to the driver after it was reset
+    UVC_ATOMIC_FETCH_OR(uvc_stream->constant.empty_frames, frame_bit);
     return ESP_OK;
 }
 
 esp_err_t uvc_frame_allocate(uvc_stream_t *uvc_stream, int nb_of_fb, size_t fb_size, uint32_t fb_caps)
 {
     UVC_CHECK(uvc_stream, ESP_ERR_INVALID_ARG);
+    UVC_CHECK(nb_of_fb > 0 && nb_of_fb <= UVC_FRAME_MAX_BUFFERS, ESP_ERR_INVALID_ARG);
     esp_err_t ret;
 
+    // In zero-copy mode, each ISOC packet (or Bulk transfer) of every URB can be one segment of a frame
+    size_t max_segments = 0;
+    if (uvc_stream->constant.zero_copy) {
+        UVC_CHECK(uvc_stream->constant.num_of_xfers > 0, ESP_ERR_INVALID_ARG);
+        const int num_isoc_packets = uvc_stream->constant.xfers[0]->num_isoc_packets;
+        max_segments = uvc_stream->constant.num_of_xfers * (num_isoc_packets > 0 ? num_isoc_packets : 1);
+    }
+
     // We will be passing the frame buffers by reference
-    uvc_stream->constant.empty_fb_queue = xQueueCreate(nb_of_fb, sizeof(uvc_host_frame_t *));
-    UVC_CHECK(uvc_stream->constant.empty_fb_queue, ESP_ERR_NO_MEM);
+    uvc_stream->constant.frames = UVC_CALLOC(CONTROL, nb_of_fb, sizeof(uvc_host_frame_t *));
+    UVC_CHECK(uvc_stream->constant.frames, ESP_ERR_NO_MEM);
+    uvc_stream->constant.num_of_frames = nb_of_fb;
+    uvc_stream->constant.empty_frames = 0;
     for (int i = 0; i < nb_of_fb; i++) {
         // Allocate the frame buffer
-        uvc_host_frame_t *this_fb = malloc(sizeof(uvc_host_frame_t));
+        uvc_frame_t *this_fb = UVC_CALLOC(CONTROL, 1, sizeof(uvc_frame_t));
         if (fb_caps == 0) {
             fb_caps = MALLOC_CAP_DEFAULT; // In case the user did not fill the config, set it to default
         }
-        uint8_t *this_data = heap_caps_malloc(fb_size, fb_caps);
-        if (this_data == NULL || this_fb == NULL) {
-            free(this_fb);
-            free(this_data);
+        uint8_t *this_data = NULL;
+        size_t this_data_size = 0;
+        uvc_host_frame_segment_t *this_segments = NULL;
+        uvc_host_nal_unit_t *this_nal_units = NULL;
+        if (uvc_stream->constant.nal_index_size) {
+            this_nal_units = UVC_MALLOC(BUFFER, uvc_stream->constant.nal_index_size * sizeof(uvc_host_nal_unit_t), MALLOC_CAP_DEFAULT);
+        }
+        if (uvc_stream->constant.zero_copy) {
+            this_segments = UVC_MALLOC(BUFFER, max_segments * sizeof(uvc_host_frame_segment_t), MALLOC_CAP_DEFAULT);
+        } else if (uvc_stream->constant.frame_pool) {
+            // Data buffer is taken from the shared pool at Start of Frame
+        } else if (uvc_stream->constant.staging) {
+            // Staged data are copied by DMA in blocks, the buffer must be aligned and its size rounded up
+            this_data_size = usb_round_up_to_mps(fb_size, UVC_STAGING_ALIGN);
+            this_data = UVC_ALIGNED_ALLOC(BUFFER, UVC_STAGING_ALIGN, this_data_size, fb_caps);
+        } else {
+            this_data_size = fb_size;
+            this_data = UVC_MALLOC(BUFFER, this_data_size, fb_caps);
+        }
+        if ((this_data == NULL && this_segments == NULL && !uvc_stream->constant.frame_pool) || this_fb == NULL ||
+                (this_nal_units == NULL && uvc_stream->constant.nal_index_size)) {
+            UVC_FREE(CONTROL, this_fb, sizeof(uvc_frame_t));
+            UVC_FREE(BUFFER, this_data, this_data_size);
+            UVC_FREE(BUFFER, this_segments, max_segments * sizeof(uvc_host_frame_segment_t));
+            UVC_FREE(BUFFER, this_nal_units, uvc_stream->constant.nal_index_size * sizeof(uvc_host_nal_unit_t));
             ret = ESP_ERR_NO_MEM;
             ESP_LOGE(TAG, "Not enough memory for frame buffers %zu", fb_size);
             goto err;
         }
 
         // Set members to default
-        this_fb->data = this_data;
-        this_fb->data_buffer_len = fb_size;
-        this_fb->data_len = 0;
+        this_fb->frame.data = this_data;
+        this_fb->frame.data_buffer_len = this_data ? fb_size : 0;
+        this_fb->data_alloc_size = this_data_size;
+        this_fb->frame.data_len = 0;
+        this_fb->frame.segments = this_segments;
+        this_fb->frame.num_segments = 0;
+        this_fb->segments = this_segments;
+        this_fb->max_segments = max_segments;
+        this_fb->frame.nal_units = this_nal_units;
+        this_fb->frame.num_nal_units = 0;
+        this_fb->nal_units = this_nal_units;
+        this_fb->frame.lost_ranges = this_fb->lost_ranges;
+        this_fb->frame.num_lost_ranges = 0;
+        this_fb->frame.error_flags = 0;
+        this_fb->index = i;
 
-        // Add the frame to Queue of empty frames
-        const BaseType_t result = xQueueSend(uvc_stream->constant.empty_fb_queue, &this_fb, 0);
-        assert(pdPASS == result);
+        // The frame is empty, owned by the driver
+        uvc_stream->constant.frames[i] = &this_fb->frame;
+        uvc_stream->constant.empty_frames |= 1UL << i;
     }
     return ESP_OK;
 
@@ -71,43 +450,71 @@ err:
 
 void uvc_frame_free(uvc_stream_t *uvc_stream)
 {
-    if (!uvc_stream || !uvc_stream->constant.empty_fb_queue) {
+    if (!uvc_stream || !uvc_stream->constant.frames) {
         return;
     }
 
-    // Free all Frame Buffers and the Queue itself
-    uvc_host_frame_t *this_fb;
-    while (xQueueReceive(uvc_stream->constant.empty_fb_queue, &this_fb, 0) == pdPASS) {
-        free(this_fb->data);
-        free(this_fb);
+    // Free all Frame Buffers and the array itself
+    for (unsigned i = 0; i < uvc_stream->constant.num_of_frames; i++) {
+        uvc_frame_t *this_fb = (uvc_frame_t *)uvc_stream->constant.frames[i];
+        if (this_fb) {
+            // Buffers of the shared frame pool are freed by the pool
+            if (!uvc_stream->constant.frame_pool) {
+                UVC_FREE(BUFFER, this_fb->frame.data, this_fb->data_alloc_size);
+            }
+            UVC_FREE(BUFFER, this_fb->segments, this_fb->max_segments * sizeof(uvc_host_frame_segment_t));
+            UVC_FREE(BUFFER, this_fb->nal_units, uvc_stream->constant.nal_index_size * sizeof(uvc_host_nal_unit_t));
+            uvc_frame_ext_free(uvc_stream, this_fb);
+            UVC_FREE(CONTROL, this_fb, sizeof(uvc_frame_t));
+        }
     }
-    vQueueDelete(uvc_stream->constant.empty_fb_queue);
-    uvc_stream->constant.empty_fb_queue = NULL;
+    UVC_FREE(CONTROL, uvc_stream->constant.frames, uvc_stream->constant.num_of_frames * sizeof(uvc_host_frame_t *));
+    uvc_stream->constant.frames = NULL;
+    uvc_stream->constant.num_of_frames = 0;
+    uvc_stream->constant.empty_frames = 0;
 }
 
 bool uvc_frame_are_all_returned(uvc_stream_t *uvc_stream)
 {
     UVC_CHECK(uvc_stream, false);
-    UVC_CHECK(uvc_stream->constant.empty_fb_queue, false);
+    UVC_CHECK(uvc_stream->constant.frames, false);
 
     // In case the user returns 'false' from uvc_host_frame_callback_t, he must return the frame buffers with uvc_host_frame_return()
-    // Here we check whether all allocated frame buffers are in the 'empty_fb_queue'
-    const UBaseType_t uxSpacesAvailable = uxQueueSpacesAvailable(uvc_stream->constant.empty_fb_queue);
-    return (uxSpacesAvailable == 0);
+    // Here we check whether all allocated frame buffers are marked as empty
+    const uint32_t all_frames_mask = (uvc_stream->constant.num_of_frames >= 32) ? UINT32_MAX : ((1UL << uvc_stream->constant.num_of_frames) - 1);
+    return (UVC_ATOMIC_LOAD(uvc_stream->constant.empty_frames) == all_frames_mask);
 }
 
-uvc_host_frame_t *uvc_frame_get_empty(uvc_stream_t *uvc_stream)
+UVC_DATA_PATH_ATTR uvc_host_frame_t *uvc_frame_get_empty(uvc_stream_t *uvc_stream)
 {
     UVC_CHECK(uvc_stream, NULL);
-    uvc_host_frame_t *this_fb;
-    if (xQueueReceive(uvc_stream->constant.empty_fb_queue, &this_fb, 0) == pdPASS) {
-        return this_fb;
-    } else {
-        return NULL;
+
+    // Take ownership of the lowest empty frame. Frames can be returned concurrently, so retry until the mask is updated
+    uint32_t empty_frames = UVC_ATOMIC_LOAD(uvc_stream->constant.empty_frames);
+    uint32_t remaining;
+    do {
+        if (empty_frames == 0) {
+            return NULL;
+        }
+        remaining = empty_frames & (empty_frames - 1); // Clear the lowest set bit
+    } while (!UVC_ATOMIC_COMPARE_EXCHANGE(uvc_stream->constant.empty_frames, empty_frames, remaining));
+    uvc_host_frame_t *frame = uvc_stream->constant.frames[__builtin_ctz(empty_frames)];
+
+    if (uvc_stream->constant.frame_pool) {
+        frame->data = uvc_frame_pool_take(uvc_stream);
+        if (!frame->data) {
+            // No buffer in the shared pool, give the frame back
+            UVC_ATOMIC_FETCH_OR(uvc_stream->constant.empty_frames, 1UL << ((uvc_frame_t *)frame)->index);
+            return NULL;
+        }
+        frame->data_buffer_len = uvc_frame_pool_buffer_size(uvc_stream->constant.frame_pool);
+    } else if (uvc_stream->constant.adaptive.enabled) {
+        uvc_frame_adaptive_resize(uvc_stream, frame);
     }
+    return frame;
 }
 
-esp_err_t uvc_frame_add_data(uvc_host_frame_t *frame, const uint8_t *data, size_t data_len)
+esp_err_t UVC_DATA_PATH_ATTR uvc_frame_add_data(uvc_host_frame_t *frame, const uint8_t *data, size_t data_len)
 {
     if (data_len == 0) {
         return ESP_OK; // Fast return in case of zero data
@@ -120,8 +527,289 @@ esp_err_t uvc_frame_add_data(uvc_host_frame_t *frame, const uint8_t *data, size_
     return ESP_OK;
 }
 
-void uvc_frame_reset(uvc_host_frame_t *frame)
+/**
+ * @brief Track first 2 bytes of the frame and last 2 bytes before padding for MJPEG validation
+ *
+ * Some cameras pad MJPEG frames after EOI marker with 0x00 or 0xFF bytes, the padding is skipped.
+ * The EOI marker ends with 0xD9, so the last byte that is not padding is the end of EOI of a complete frame.
+ *
+ * @param[in] this_fb  Frame buffer
+ * @param[in] data     Pointer to data that are added to the frame
+ * @param[in] data_len Data length in bytes
+ */
+static void UVC_DATA_PATH_ATTR uvc_frame_mjpeg_track(uvc_frame_t *this_fb, const uint8_t *data, size_t data_len)
+{
+    for (size_t i = 0; i < data_len && this_fb->mjpeg_head_len < 2; i++) {
+        this_fb->mjpeg_head = (this_fb->mjpeg_head << 8) | data[i];
+        this_fb->mjpeg_head_len++;
+    }
+    size_t end = data_len;
+    while (end > 0 && (data[end - 1] == 0x00 || data[end - 1] == 0xFF)) {
+        end--;
+    }
+    if (end > 0) {
+        const uint8_t prev = (end >= 2) ? data[end - 2] : this_fb->mjpeg_last;
+        this_fb->mjpeg_tail = (prev << 8) | data[end - 1];
+    }
+    if (data_len > 0) {
+        this_fb->mjpeg_last = data[data_len - 1];
+    }
+}
+
+bool UVC_DATA_PATH_ATTR uvc_frame_mjpeg_is_valid(const uvc_stream_t *uvc_stream, const uvc_host_frame_t *frame)
+{
+    if (!uvc_stream->constant.mjpeg_validation || uvc_stream->constant.vs_format.format != UVC_VS_FORMAT_MJPEG || !frame) {
+        return true;
+    }
+    const uvc_frame_t *this_fb = (const uvc_frame_t *)frame;
+    return this_fb->mjpeg_head_len == 2 && this_fb->mjpeg_head == UVC_MJPEG_SOI && this_fb->mjpeg_tail == UVC_MJPEG_EOI;
+}
+
+bool UVC_DATA_PATH_ATTR uvc_frame_add_error(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame, uint32_t error, size_t len, size_t lost_bytes)
+{
+    if (!uvc_stream->constant.corrupt_frames || uvc_stream->constant.vs_format.format != UVC_VS_FORMAT_MJPEG ||
+            !frame || uvc_stream->single_thread.skip_current_frame) {
+        return false;
+    }
+    uvc_frame_t *this_fb = (uvc_frame_t *)frame;
+    frame->error_flags |= error;
+
+    // Damage adjacent to the last range or behind the last storage entry extends the last range
+    const size_t offset = frame->data_len;
+    if (frame->num_lost_ranges > 0) {
+        uvc_host_frame_lost_range_t *last = &this_fb->lost_ranges[frame->num_lost_ranges - 1];
+        if (last->offset + last->len == offset || frame->num_lost_ranges == UVC_HOST_FRAME_LOST_RANGES) {
+            last->len = offset + len - last->offset;
+            last->lost_bytes += lost_bytes;
+            return true;
+        }
+    }
+    this_fb->lost_ranges[frame->num_lost_ranges++] = (uvc_host_frame_lost_range_t) {
+        .offset = offset,
+        .len = len,
+        .lost_bytes = lost_bytes,
+    };
+    return true;
+}
+
+/**
+ * @brief Set length of the last indexed NAL unit, if it is not known yet
+ *
+ * @param[in] this_fb Frame buffer
+ * @param[in] end     Offset of the first byte behind the NAL unit
+ */
+static void UVC_DATA_PATH_ATTR uvc_frame_nal_close(uvc_frame_t *this_fb, size_t end)
+{
+    if (this_fb->nal_open) {
+        uvc_host_nal_unit_t *nal = &this_fb->nal_units[this_fb->frame.num_nal_units - 1];
+        nal->len = end - nal->offset;
+        this_fb->nal_open = false;
+    }
+}
+
+/**
+ * @brief Index NAL units of H.264 or H.265 frame
+ *
+ * Start codes split between two calls are found too: Zero bytes at the end of data and pending NAL unit header
+ * are carried over to the next call.
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] this_fb    Frame buffer
+ * @param[in] data       Pointer to data that are added to the frame
+ * @param[in] data_len   Data length in bytes
+ */
+static void UVC_DATA_PATH_ATTR uvc_frame_nal_track(const uvc_stream_t *uvc_stream, uvc_frame_t *this_fb, const uint8_t *data, size_t data_len)
+{
+    const size_t base = this_fb->nal_scanned;
+    this_fb->nal_scanned += data_len;
+
+    size_t i = 0;
+    while (i < data_len) {
+        if (this_fb->nal_header_pending) {
+            this_fb->nal_header_pending = false;
+            if (this_fb->frame.num_nal_units < uvc_stream->constant.nal_index_size) {
+                uvc_host_nal_unit_t *nal = &this_fb->nal_units[this_fb->frame.num_nal_units++];
+                nal->offset = base + i;
+                nal->len = 0;
+                nal->type = (uvc_stream->constant.vs_format.format == UVC_VS_FORMAT_H264) ? (data[i] & 0x1F) : ((data[i] >> 1) & 0x3F);
+                this_fb->nal_open = true;
+            }
+            i++;
+            continue;
+        }
+
+        // Start code ends with 0x01 byte, preceded by at least 2 zero bytes
+        const uint8_t *one = memchr(data + i, 0x01, data_len - i);
+        const size_t end = one ? (size_t)(one - data) : data_len;
+        size_t zeros = 0;
+        while (end - zeros > i && data[end - zeros - 1] == 0) {
+            zeros++;
+        }
+        if (end - zeros == i) {
+            zeros += this_fb->nal_zeros; // The zero bytes continue from previous data
+        }
+        if (!one) {
+            this_fb->nal_zeros = zeros;
+            return;
+        }
+        if (zeros >= 2) {
+            uvc_frame_nal_close(this_fb, base + end - zeros);
+            this_fb->nal_header_pending = true;
+        }
+        this_fb->nal_zeros = 0;
+        i = end + 1;
+    }
+}
+
+esp_err_t UVC_DATA_PATH_ATTR uvc_frame_add_urb_data(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame, usb_transfer_t *transfer, const uint8_t *data, size_t data_len)
+{
+    if (uvc_stream->constant.mjpeg_validation && uvc_stream->constant.vs_format.format == UVC_VS_FORMAT_MJPEG && frame && data) {
+        uvc_frame_mjpeg_track((uvc_frame_t *)frame, data, data_len);
+    }
+    const enum uvc_host_stream_format format = uvc_stream->constant.vs_format.format;
+    if (uvc_stream->constant.nal_index_size && (format == UVC_VS_FORMAT_H264 || format == UVC_VS_FORMAT_H265) && frame && data) {
+        uvc_frame_nal_track(uvc_stream, (uvc_frame_t *)frame, data, data_len);
+    }
+    if (uvc_stream->constant.staging) {
+        return uvc_staging_add_data(uvc_stream, frame, data, data_len);
+    }
+    if (uvc_stream->constant.slice_cb) {
+        return uvc_frame_add_slice_data(uvc_stream, frame, data, data_len);
+    }
+    if (uvc_stream->constant.adaptive.enabled) {
+        return uvc_frame_add_adaptive_data(uvc_stream, frame, data, data_len);
+    }
+    if (!uvc_stream->constant.zero_copy) {
+        return uvc_frame_add_data(frame, data, data_len);
+    }
+
+    if (data_len == 0) {
+        return ESP_OK; // Fast return in case of zero data
+    }
+    UVC_CHECK(frame && data && transfer, ESP_ERR_INVALID_ARG);
+    uvc_frame_t *this_fb = (uvc_frame_t *)frame;
+    UVC_CHECK(frame->num_segments < this_fb->max_segments, ESP_ERR_INVALID_SIZE);
+
+    // Reference the URB, so it is not re-submitted until this frame is returned
+    const unsigned index = uvc_frame_urb_index(uvc_stream, transfer);
+    const uint32_t urb_bit = 1UL << index;
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    if (!(this_fb->urb_mask & urb_bit)) {
+        this_fb->urb_mask |= urb_bit;
+        uvc_stream->constant.urb_refs[index]++;
+    }
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+
+    this_fb->segments[frame->num_segments].data = data;
+    this_fb->segments[frame->num_segments].len  = data_len;
+    frame->num_segments++;
+    frame->data_len += data_len;
+    return ESP_OK;
+}
+
+void UVC_DATA_PATH_ATTR uvc_frame_finish(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame)
+{
+    if (frame) {
+        uvc_staging_flush(uvc_stream, frame);
+        uvc_frame_t *this_fb = (uvc_frame_t *)frame;
+        uvc_frame_nal_close(this_fb, this_fb->nal_scanned - this_fb->nal_zeros);
+        frame->timestamp = uvc_stream->single_thread.timestamp;
+        frame->timestamp.host_eof_us = uvc_stats_time_us();
+    }
+}
+
+void UVC_DATA_PATH_ATTR uvc_frame_slice_end(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame, bool frame_error)
+{
+    if (frame && uvc_stream->constant.slice_cb) {
+        uvc_frame_slice_deliver(uvc_stream, frame, true, frame_error);
+    }
+}
+
+void UVC_DATA_PATH_ATTR uvc_frame_reset(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame)
 {
     assert(frame);
+    uvc_staging_discard(uvc_stream, frame);
     frame->data_len = 0;
+    ((uvc_frame_t *)frame)->slice_started = false;
+    ((uvc_frame_t *)frame)->mjpeg_head_len = 0;
+    ((uvc_frame_t *)frame)->mjpeg_tail = 0;
+    ((uvc_frame_t *)frame)->mjpeg_last = 0;
+    frame->num_nal_units = 0;
+    frame->num_lost_ranges = 0;
+    frame->error_flags = 0;
+    ((uvc_frame_t *)frame)->nal_scanned = 0;
+    ((uvc_frame_t *)frame)->nal_zeros = 0;
+    ((uvc_frame_t *)frame)->nal_header_pending = false;
+    ((uvc_frame_t *)frame)->nal_open = false;
+    uvc_frame_ext_free(uvc_stream, (uvc_frame_t *)frame);
+    if (uvc_stream->constant.zero_copy) {
+        uvc_frame_t *this_fb = (uvc_frame_t *)frame;
+        UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+        const uint32_t urb_mask = this_fb->urb_mask;
+        this_fb->urb_mask = 0;
+        UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+        frame->num_segments = 0;
+        uvc_frame_urbs_release(uvc_stream, urb_mask);
+    }
+}
+
+void UVC_DATA_PATH_ATTR uvc_frame_urb_acquire(uvc_stream_t *uvc_stream, usb_transfer_t *transfer)
+{
+    if (!uvc_stream->constant.zero_copy) {
+        return;
+    }
+    const unsigned index = uvc_frame_urb_index(uvc_stream, transfer);
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    uvc_stream->constant.urb_refs[index]++;
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+}
+
+void UVC_DATA_PATH_ATTR uvc_frame_urb_done(uvc_stream_t *uvc_stream, usb_transfer_t *transfer)
+{
+    if (uvc_stream->constant.processing) {
+        uvc_processing_urb_done(uvc_stream, transfer); // Re-submit the transfer or keep it as spare
+        return;
+    }
+    if (!uvc_stream->constant.zero_copy) {
+        if (UVC_ATOMIC_LOAD(uvc_stream->dynamic.streaming)) {
+            UVC_TRANSFER_SUBMIT(transfer); // Restart the transfer
+        }
+        return;
+    }
+
+    // Check whether the current frame does not hold all the URBs. In that case, the frame could never be finished
+    const uint32_t all_urbs_mask = (uvc_stream->constant.num_of_xfers >= 32) ? UINT32_MAX : ((1UL << uvc_stream->constant.num_of_xfers) - 1);
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    uvc_frame_t *current_frame = (uvc_frame_t *)uvc_stream->dynamic.current_frame;
+    const bool urbs_exhausted = (current_frame && current_frame->urb_mask == all_urbs_mask);
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+
+    if (urbs_exhausted) {
+        // Discard the current frame so its URBs can be re-submitted
+        uvc_frame_reset(uvc_stream, &current_frame->frame);
+        uvc_stream->single_thread.skip_current_frame = true;
+
+        // Inform the user about the overflow
+        uvc_host_stream_callback_t stream_cb = uvc_stream->constant.stream_cb;
+        if (stream_cb) {
+            const uvc_host_stream_event_data_t event = {
+                .type = UVC_HOST_FRAME_BUFFER_OVERFLOW,
+            };
+            stream_cb(&event, uvc_stream->constant.cb_arg);
+        }
+    }
+
+    // Release the URB acquired by the transfer callback
+    uvc_frame_urbs_release(uvc_stream, 1UL << uvc_frame_urb_index(uvc_stream, transfer));
+}
+
+bool uvc_frame_urb_is_free(uvc_stream_t *uvc_stream, unsigned index)
+{
+    if (!uvc_stream->constant.zero_copy) {
+        return true;
+    }
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    const bool is_free = (uvc_stream->constant.urb_refs[index] == 0);
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+    return is_free;
 }
@@ -0,0 +1,89 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "usb/uvc_host.h"
+#include "uvc_frame_filter_priv.h"
+#include "uvc_types_priv.h"
+#include "uvc_attr_priv.h"
+
+/**
+ * @brief Classification of a NAL unit for keyframe filter
+ */
+typedef enum {
+    UVC_NAL_OTHER = 0, // NAL unit does not decide the frame type, e.g. AUD or SEI
+    UVC_NAL_KEY,       // IDR/IRAP slice or parameter sets, which are sent only with keyframes
+    UVC_NAL_NON_KEY,   // Slice of a frame that is not a keyframe
+} uvc_nal_class_t;
+
+/**
+ * @brief Classify NAL unit by its header
+ *
+ * @param[in] format     Stream format, H.264 or H.265
+ * @param[in] nal_header First byte of NAL unit header
+ * @return NAL unit class
+ */
+static uvc_nal_class_t UVC_DATA_PATH_ATTR uvc_frame_filter_nal_class(enum uvc_host_stream_format format, uint8_t nal_header)
+{
+    if (format == UVC_VS_FORMAT_H264) {
+        const uint8_t type = nal_header & 0x1F;
+        if (type == 5 || type == 7 || type == 8) { // IDR slice, SPS, PPS
+            return UVC_NAL_KEY;
+        }
+        if (type >= 1 && type <= 4) { // Non-IDR slice and its partitions
+            return UVC_NAL_NON_KEY;
+        }
+    } else {
+        const uint8_t type = (nal_header >> 1) & 0x3F;
+        if ((type >= 16 && type <= 23) || (type >= 32 && type <= 34)) { // IRAP slices, VPS, SPS, PPS
+            return UVC_NAL_KEY;
+        }
+        if (type <= 9) { // Non-IRAP slices
+            return UVC_NAL_NON_KEY;
+        }
+    }
+    return UVC_NAL_OTHER;
+}
+
+bool UVC_DATA_PATH_ATTR uvc_frame_filter_sof(uvc_stream_t *uvc_stream)
+{
+    const enum uvc_host_stream_format format = uvc_stream->constant.vs_format.format;
+    uvc_stream->single_thread.keyframe_pending = uvc_stream->constant.keyframes_only &&
+                                                 (format == UVC_VS_FORMAT_H264 || format == UVC_VS_FORMAT_H265);
+
+    const unsigned decimation = uvc_stream->constant.frame_decimation;
+    if (decimation <= 1) {
+        return false;
+    }
+    const bool deliver = (uvc_stream->single_thread.decimation_count == 0);
+    uvc_stream->single_thread.decimation_count = (uvc_stream->single_thread.decimation_count + 1) % decimation;
+    return !deliver;
+}
+
+bool UVC_DATA_PATH_ATTR uvc_frame_filter_data(uvc_stream_t *uvc_stream, const uint8_t *data, size_t data_len)
+{
+    if (!uvc_stream->single_thread.keyframe_pending) {
+        return false; // Fast path: The frame type is already known or the filter is disabled
+    }
+
+    // Find Annex B start codes (00 00 01) and classify the NAL units behind them.
+    // Start codes split between two packets are not detected, the decision is then made by the next NAL unit
+    for (size_t i = 0; i + 3 < data_len; i++) {
+        if (data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1) {
+            continue;
+        }
+        const uvc_nal_class_t nal_class = uvc_frame_filter_nal_class(uvc_stream->constant.vs_format.format, data[i + 3]);
+        if (nal_class != UVC_NAL_OTHER) {
+            uvc_stream->single_thread.keyframe_pending = false;
+            return (nal_class == UVC_NAL_NON_KEY);
+        }
+        i += 2;
+    }
+    return false; // Undecided frames are delivered
+}
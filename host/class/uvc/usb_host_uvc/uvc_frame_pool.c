@@ -0,0 +1,163 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "usb/usb_host.h" // For usb_round_up_to_mps
+#include "usb/uvc_host.h"
+#include "uvc_frame_pool_priv.h"
+#include "uvc_staging_priv.h"
+#include "uvc_types_priv.h"
+#include "uvc_check_priv.h"
+#include "uvc_attr_priv.h"
+#include "uvc_transfer_priv.h"
+
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "uvc-frame-pool";
+
+struct uvc_host_frame_pool_s {
+    portMUX_TYPE lock;           // Protects all members below and frame_pool_in_use of attached streams
+    size_t buffer_size;          // Size of one buffer
+    unsigned num_buffers;        // Number of buffers in the pool
+    uint8_t **buffers;           // All buffers of the pool
+    uint8_t **free_buffers;      // Stack of free buffers
+    unsigned num_free;           // Number of free buffers
+    unsigned reserved_unused;    // Reserved buffers that are not taken by their streams, other streams cannot take them
+    unsigned num_streams;        // Number of attached streams
+};
+
+/**
+ * @brief Free allocated buffers of the pool and the pool itself
+ *
+ * @param[in] pool Frame pool
+ */
+static void uvc_frame_pool_free(struct uvc_host_frame_pool_s *pool)
+{
+    const size_t buffer_size = usb_round_up_to_mps(pool->buffer_size, UVC_STAGING_ALIGN);
+    for (unsigned i = 0; i < pool->num_buffers; i++) {
+        UVC_FREE(BUFFER, pool->buffers[i], buffer_size);
+    }
+    // The pool is allocated with room for pointers to all requested buffers, twice
+    const size_t requested_buffers = pool->free_buffers - pool->buffers;
+    UVC_FREE(CONTROL, pool, sizeof(struct uvc_host_frame_pool_s) + 2 * requested_buffers * sizeof(uint8_t *));
+}
+
+esp_err_t uvc_host_frame_pool_create(const uvc_host_frame_pool_config_t *pool_config, uvc_host_frame_pool_hdl_t *pool_hdl_ret)
+{
+    UVC_CHECK(pool_config && pool_hdl_ret, ESP_ERR_INVALID_ARG);
+    UVC_CHECK(pool_config->number_of_buffers > 0 && pool_config->buffer_size > 0, ESP_ERR_INVALID_ARG);
+    esp_err_t ret;
+
+    const unsigned num_buffers = pool_config->number_of_buffers;
+    struct uvc_host_frame_pool_s *pool = UVC_CALLOC(CONTROL, 1, sizeof(struct uvc_host_frame_pool_s) + 2 * num_buffers * sizeof(uint8_t *));
+    UVC_CHECK(pool, ESP_ERR_NO_MEM);
+    portMUX_INITIALIZE(&pool->lock);
+    pool->buffers = (uint8_t **)(pool + 1);
+    pool->free_buffers = pool->buffers + num_buffers;
+    pool->buffer_size = pool_config->buffer_size;
+
+    // The buffers are aligned and rounded up, so they can be used by streams with staging buffer
+    const uint32_t caps = pool_config->buffer_heap_caps ? pool_config->buffer_heap_caps : MALLOC_CAP_DEFAULT;
+    for (unsigned i = 0; i < num_buffers; i++) {
+        pool->buffers[i] = UVC_ALIGNED_ALLOC(BUFFER, UVC_STAGING_ALIGN, usb_round_up_to_mps(pool->buffer_size, UVC_STAGING_ALIGN), caps);
+        ESP_GOTO_ON_FALSE(pool->buffers[i], ESP_ERR_NO_MEM, err, TAG, "Not enough memory for frame buffers %zu", pool->buffer_size);
+        pool->free_buffers[i] = pool->buffers[i];
+        pool->num_buffers++;
+    }
+    pool->num_free = num_buffers;
+    *pool_hdl_ret = pool;
+    return ESP_OK;
+
+err:
+    uvc_frame_pool_free(pool);
+    return ret;
+}
+
+esp_err_t uvc_host_frame_pool_delete(uvc_host_frame_pool_hdl_t pool_hdl)
+{
+    UVC_CHECK(pool_hdl, ESP_ERR_INVALID_ARG);
+    struct uvc_host_frame_pool_s *pool = pool_hdl;
+
+    portENTER_CRITICAL(&pool->lock);
+    const unsigned num_streams = pool->num_streams;
+    portEXIT_CRITICAL(&pool->lock);
+    UVC_CHECK(num_streams == 0, ESP_ERR_INVALID_STATE);
+
+    uvc_frame_pool_free(pool);
+    return ESP_OK;
+}
+
+esp_err_t uvc_frame_pool_attach(uvc_host_frame_pool_hdl_t pool, uvc_stream_t *uvc_stream, unsigned reserved)
+{
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&pool->lock);
+    if (pool->num_free - pool->reserved_unused < reserved) {
+        ret = ESP_ERR_NO_MEM; // The reservation would take buffers held or reserved by other streams
+    } else {
+        pool->reserved_unused += reserved;
+        pool->num_streams++;
+        uvc_stream->constant.frame_pool = pool;
+        uvc_stream->constant.frame_pool_reserved = reserved;
+        uvc_stream->constant.frame_pool_in_use = 0;
+    }
+    portEXIT_CRITICAL(&pool->lock);
+    return ret;
+}
+
+void uvc_frame_pool_detach(uvc_stream_t *uvc_stream)
+{
+    struct uvc_host_frame_pool_s *pool = uvc_stream->constant.frame_pool;
+    if (!pool) {
+        return;
+    }
+    assert(uvc_stream->constant.frame_pool_in_use == 0);
+    portENTER_CRITICAL(&pool->lock);
+    pool->reserved_unused -= uvc_stream->constant.frame_pool_reserved;
+    pool->num_streams--;
+    portEXIT_CRITICAL(&pool->lock);
+    uvc_stream->constant.frame_pool = NULL;
+}
+
+size_t uvc_frame_pool_buffer_size(uvc_host_frame_pool_hdl_t pool)
+{
+    return pool->buffer_size;
+}
+
+UVC_DATA_PATH_ATTR uint8_t *uvc_frame_pool_take(uvc_stream_t *uvc_stream)
+{
+    struct uvc_host_frame_pool_s *pool = uvc_stream->constant.frame_pool;
+    uint8_t *data = NULL;
+    portENTER_CRITICAL(&pool->lock);
+    const bool within_reservation = (uvc_stream->constant.frame_pool_in_use < uvc_stream->constant.frame_pool_reserved);
+    if (within_reservation) {
+        // Reserved buffers are always free: num_free >= reserved_unused
+        pool->reserved_unused--;
+    }
+    if (within_reservation || pool->num_free > pool->reserved_unused) {
+        data = pool->free_buffers[--pool->num_free];
+        uvc_stream->constant.frame_pool_in_use++;
+    }
+    portEXIT_CRITICAL(&pool->lock);
+    return data;
+}
+
+void UVC_DATA_PATH_ATTR uvc_frame_pool_give(uvc_stream_t *uvc_stream, uint8_t *data)
+{
+    struct uvc_host_frame_pool_s *pool = uvc_stream->constant.frame_pool;
+    portENTER_CRITICAL(&pool->lock);
+    assert(uvc_stream->constant.frame_pool_in_use > 0);
+    uvc_stream->constant.frame_pool_in_use--;
+    if (uvc_stream->constant.frame_pool_in_use < uvc_stream->constant.frame_pool_reserved) {
+        pool->reserved_unused++; // The buffer goes back to this stream's reservation
+    }
+    pool->free_buffers[pool->num_free++] = data;
+    portEXIT_CRITICAL(&pool->lock);
+}
@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/queue.h>
+#include <sys/param.h> // For MIN, MAX
 
 #include "esp_log.h"
 #include "esp_check.h"
@@ -20,9 +21,18 @@
 #include "uvc_stream.h"
 #include "uvc_types_priv.h"
 #include "uvc_frame_priv.h"
+#include "uvc_frame_pool_priv.h"
+#include "uvc_staging_priv.h"
+#include "uvc_processing_priv.h"
+#include "uvc_still_priv.h"
+#include "uvc_ctrl_cache_priv.h"
+#include "uvc_stats_priv.h"
+#include "uvc_bandwidth_priv.h"
+#include "uvc_negotiation_cache_priv.h"
 #include "uvc_descriptors_priv.h"
 #include "uvc_check_priv.h"
 #include "uvc_critical_priv.h"
+#include "uvc_transfer_priv.h"
 #include "uvc_idf_version_priv.h"
 
 #include "freertos/FreeRTOS.h"
@@ -30,6 +40,12 @@
 #include "freertos/semphr.h"
 #include "freertos/queue.h"
 #include "freertos/event_groups.h"
+#if USB_HOST_SHARED_CLIENT_ENABLED
+#define USB_HOST_CLIENT_DRIVER  UVC
+#include "usb/usb_host_client_macros.h"
+#else
+#include "usb_host_client_fallback.h"
+#endif
 
 static const char *TAG = "uvc";
 
@@ -41,6 +57,12 @@ portMUX_TYPE uvc_lock = portMUX_INITIALIZER_UNLOCKED;
 #define UVC_TEARDOWN          BIT1 // UVC is being uninstalled
 #define UVC_TEARDOWN_COMPLETE BIT2 // UVC uninstall finished
 
+// Automatic URB sizing
+#define UVC_AUTO_URB_PERIOD_US   (2000)      // Target time to fill 1 ISOC URB. Determines the interrupt rate
+#define UVC_AUTO_URB_MAX_SIZE    (32 * 1024) // Upper limit of the URB size
+#define UVC_AUTO_URB_NUM         (3)         // Triple buffering
+#define UVC_AUTO_URB_NUM_MAX     (32)        // Upper limit of URB count. Zero-copy mode can track up to 32 URBs
+
 // Transfer callbacks
 static void ctrl_xfer_cb(usb_transfer_t *transfer);
 void isoc_transfer_callback(usb_transfer_t *transfer);
@@ -51,13 +73,23 @@ typedef struct {
     usb_host_client_handle_t usb_client_hdl; /*!< USB Host handle reused for all UVC devices in the system */
     SemaphoreHandle_t open_close_mutex;      /*!< Protects list of opened devices from concurrent access */
     EventGroupHandle_t driver_status;        /*!< Holds status of the driver */
-    usb_transfer_t *ctrl_transfer;           /*!< CTRL (endpoint 0) transfer */
-    SemaphoreHandle_t ctrl_mutex;            /*!< CTRL mutex */
     SLIST_HEAD(list_dev, uvc_host_stream_s) uvc_stream_list;   /*!< List of open streams */
+    SLIST_HEAD(list_usb_dev, uvc_device_s) uvc_device_list;    /*!< List of open USB devices, shared by their streams. Protected by open_close_mutex */
+    bool shared_client;                      /*!< Registered to usb_host_shared_client, which handles the events */
 } uvc_host_driver_t;
 
 static uvc_host_driver_t *p_uvc_host_driver = NULL;
 
+#if USB_HOST_SHARED_CLIENT_ENABLED
+// Bus suspend and resume hooks
+static esp_err_t uvc_pm_suspend(void *arg);
+static esp_err_t uvc_pm_resume(void *arg);
+static const usb_host_pm_ops_t uvc_pm_ops = {
+    .suspend = uvc_pm_suspend,
+    .resume = uvc_pm_resume,
+};
+#endif
+
 /**
  * @brief USB Host Client event callback
  *
@@ -93,6 +125,12 @@ static void usb_event_cb(const usb_host_client_event_msg_t *event_msg, void *arg
         }
         break;
     }
+#if UVC_HAS_ROOT_PORT_SUSPEND
+    case USB_HOST_CLIENT_EVENT_DEV_SUSPENDED:
+    case USB_HOST_CLIENT_EVENT_DEV_RESUMED:
+        // Streams are stopped and started by the suspend and resume hooks
+        break;
+#endif
     default:
         assert(false);
         break;
@@ -104,6 +142,7 @@ esp_err_t uvc_host_handle_events(unsigned long timeout)
     static bool called = false;
     uvc_host_driver_t *uvc_obj = UVC_ATOMIC_LOAD(p_uvc_host_driver); // Make local copy of the driver's handle
     UVC_CHECK(uvc_obj, ESP_ERR_INVALID_STATE);
+    UVC_CHECK(!uvc_obj->shared_client, ESP_ERR_INVALID_STATE);
 
     // We use this static variable so we don't have to call FreeRTOS API in every handling call
     if (!called) {
@@ -148,16 +187,40 @@ static void uvc_transfers_free(uvc_stream_t *uvc_stream)
 {
     assert(uvc_stream);
     for (unsigned i = 0; i < uvc_stream->constant.num_of_xfers; i++) {
-        usb_host_transfer_free(uvc_stream->constant.xfers[i]);
+        UVC_TRANSFER_FREE(uvc_stream->constant.xfers[i]);
     }
-    free(uvc_stream->constant.xfers);
+    UVC_FREE(CONTROL, uvc_stream->constant.xfers, uvc_stream->constant.xfers_alloc_num * sizeof(usb_transfer_t *));
+    UVC_FREE(CONTROL, uvc_stream->constant.urb_refs, uvc_stream->constant.xfers_alloc_num * sizeof(uint8_t));
+    uvc_stream->constant.xfers_alloc_num = 0;
+    uvc_stream->constant.xfers = NULL;
+    uvc_stream->constant.urb_refs = NULL;
+    uvc_stream->constant.num_of_xfers = 0;
+}
+
+/**
+ * @brief Get number of ISOC packets the endpoint delivers in 1 millisecond
+ *
+ * ISOC endpoints are serviced every 2^(bInterval-1) (micro)frames, one ISOC packet is one service interval.
+ * High-speed endpoints with bInterval 1-3 are serviced more than once in the 8 microframes of 1 millisecond.
+ *
+ * @param[in] uvc_stream Pointer to UVC stream
+ * @param[in] ep_desc    Descriptor of the streaming endpoint
+ * @return Number of ISOC packets in 1 millisecond, at least 1
+ */
+static unsigned uvc_isoc_packets_per_ms(const uvc_stream_t *uvc_stream, const usb_ep_desc_t *ep_desc)
+{
+    const unsigned microframes_per_ms = uvc_stream->constant.high_speed ? 8 : 1;
+    const unsigned interval_exp = (ep_desc->bInterval > 0) ? (ep_desc->bInterval - 1) : 0;
+    return MAX(1, microframes_per_ms >> interval_exp);
 }
 
 /**
  * @brief Allocate UVC transfers
  *
  * This function can allocate more memory than the caller requested.
- * The requested size is rounded up to integer multiple of MPS.
+ * - ISOC: The requested size is rounded up to ISOC packets of all transactions in one service interval (MPS * mult),
+ *   whose number is a multiple of packets in 1 millisecond. URBs then span whole 8 microframe blocks in High-speed
+ * - Bulk: The requested size is rounded up to integer multiple of MPS
  *
  * @param[in] uvc_stream       Pointer to UVC stream
  * @param[in] num_of_transfers Number of USB transfers allocated for this stream
@@ -179,9 +242,12 @@ static esp_err_t uvc_transfers_allocate(uvc_stream_t *uvc_stream, unsigned num_o
 
     if (is_isoc) {
         // Multiply MPS by number of transactions in microframe: This is the minimum size we can request in IN transfer
-        max_packet_size *= (USB_EP_DESC_GET_MULT(ep_desc) + 1);
-        // Divide the transfer data buffer into ISOC packets
+        max_packet_size = uvc_desc_ep_payload(ep_desc);
+        // Divide the transfer data buffer into ISOC packets, one per service interval, in whole milliseconds
+        const unsigned packets_per_ms = uvc_isoc_packets_per_ms(uvc_stream, ep_desc);
         num_isoc_packets = usb_round_up_to_mps(transfer_size, max_packet_size) / max_packet_size;
+        num_isoc_packets = usb_round_up_to_mps(num_isoc_packets, packets_per_ms);
+        transfer_size = num_isoc_packets * max_packet_size;
     }
 
     // Make sure that we allocate size integer multiple of MPS buffer: This is required for all IN transfers
@@ -191,13 +257,20 @@ static esp_err_t uvc_transfers_allocate(uvc_stream_t *uvc_stream, unsigned num_o
              num_of_transfers, transfer_size, num_isoc_packets, max_packet_size);
 
     // Allocate array of transfers
-    uvc_stream->constant.xfers = malloc(num_of_transfers * sizeof(usb_transfer_t *));
+    uvc_stream->constant.xfers = UVC_MALLOC(CONTROL, num_of_transfers * sizeof(usb_transfer_t *), MALLOC_CAP_DEFAULT);
     UVC_CHECK(uvc_stream->constant.xfers, ESP_ERR_NO_MEM);
+    uvc_stream->constant.xfers_alloc_num = num_of_transfers;
+
+    // In zero-copy mode, the URBs can be referenced by frames
+    if (uvc_stream->constant.zero_copy) {
+        uvc_stream->constant.urb_refs = UVC_CALLOC(CONTROL, num_of_transfers, sizeof(uint8_t));
+        ESP_GOTO_ON_FALSE(uvc_stream->constant.urb_refs, ESP_ERR_NO_MEM, err, TAG,);
+    }
 
     // Allocate and init all the transfers
     for (unsigned i = 0; i < num_of_transfers; i++) {
         ESP_GOTO_ON_ERROR(
-            usb_host_transfer_alloc(transfer_size, num_isoc_packets, &uvc_stream->constant.xfers[i]),
+            UVC_TRANSFER_ALLOC(transfer_size, num_isoc_packets, &uvc_stream->constant.xfers[i]),
             err, TAG, "Could not allocate USB transfers");
 
         uvc_stream->constant.num_of_xfers++;
@@ -207,14 +280,17 @@ static esp_err_t uvc_transfers_allocate(uvc_stream_t *uvc_stream, unsigned num_o
         this_transfer->timeout_ms = 1000;
         this_transfer->bEndpointAddress = ep_desc->bEndpointAddress;
 
+        if (uvc_stream->constant.processing) {
+            this_transfer->callback = uvc_processing_transfer_cb; // Payload is processed in the processing task
+        } else {
+            this_transfer->callback = is_isoc ? isoc_transfer_callback : bulk_transfer_callback;
+        }
         if (is_isoc) {
-            this_transfer->callback = isoc_transfer_callback;
             this_transfer->num_bytes = num_isoc_packets * max_packet_size;
             for (unsigned j = 0; j < num_isoc_packets; j++) {
                 this_transfer->isoc_packet_desc[j].num_bytes = max_packet_size;
             }
         } else {
-            this_transfer->callback = bulk_transfer_callback;
             this_transfer->num_bytes = transfer_size;
         }
     }
@@ -225,6 +301,270 @@ err:
     return ret;
 }
 
+/**
+ * @brief Derive URB size and count from the streaming endpoint and negotiated format
+ *
+ * Only parameters set to 0 by the user are derived.
+ * - ISOC: The URB holds as many packets (MPS * mult) as the endpoint delivers in UVC_AUTO_URB_PERIOD_US, in whole milliseconds
+ * - Bulk: The URB holds one dwMaxPayloadTransferSize
+ * - Zero-copy: The URBs must hold all frame buffers plus one URB for reception
+ *
+ * @param[in]    uvc_stream  Pointer to UVC stream
+ * @param[in]    ep_desc     Descriptor of the streaming endpoint
+ * @param[in]    vs_result   Result of format negotiation
+ * @param[in]    nb_of_fb    Number of frame buffers
+ * @param[in]    fb_size     Size of 1 frame buffer in bytes
+ * @param[inout] num_of_urbs Number of URBs
+ * @param[inout] urb_size    Size of 1 URB in bytes
+ */
+static void uvc_transfers_auto_size(uvc_stream_t *uvc_stream, const usb_ep_desc_t *ep_desc, const uvc_vs_ctrl_t *vs_result,
+                                    int nb_of_fb, size_t fb_size, unsigned *num_of_urbs, size_t *urb_size)
+{
+    const bool is_isoc = (USB_EP_DESC_GET_XFERTYPE(ep_desc) == USB_BM_ATTRIBUTES_XFER_ISOC);
+    const uint16_t mps = USB_EP_DESC_GET_MPS(ep_desc);
+
+    if (*urb_size == 0) {
+        if (is_isoc) {
+            // ISOC endpoints are serviced every 2^(bInterval-1) (micro)frames
+            unsigned interval_us = 1000;
+#if UVC_HAS_USB_SPEED_HIGH
+            if (uvc_stream->constant.high_speed) {
+                interval_us = 125;
+            }
+#endif
+            interval_us <<= (ep_desc->bInterval > 0 ? ep_desc->bInterval - 1 : 0);
+            const size_t packet_size = uvc_desc_ep_payload(ep_desc);
+            const unsigned packets_per_ms = uvc_isoc_packets_per_ms(uvc_stream, ep_desc);
+            // Whole milliseconds of packets, within the size limit if at least 1 millisecond fits
+            unsigned num_packets = MAX(1, UVC_AUTO_URB_PERIOD_US / interval_us);
+            num_packets = MIN(num_packets, UVC_AUTO_URB_MAX_SIZE / packet_size);
+            num_packets = MAX(packets_per_ms, num_packets / packets_per_ms * packets_per_ms);
+            *urb_size = num_packets * packet_size;
+        } else {
+            const size_t payload_size = vs_result->dwMaxPayloadTransferSize ? vs_result->dwMaxPayloadTransferSize : UVC_AUTO_URB_MAX_SIZE;
+            *urb_size = usb_round_up_to_mps(MIN(payload_size, UVC_AUTO_URB_MAX_SIZE), mps);
+        }
+        uvc_stream->constant.urb_auto_size = !is_isoc && !uvc_stream->constant.zero_copy;
+    }
+
+    if (*num_of_urbs == 0) {
+        if (uvc_stream->constant.zero_copy) {
+            const size_t urbs_per_frame = (fb_size + *urb_size - 1) / *urb_size;
+            *num_of_urbs = MIN(UVC_AUTO_URB_NUM_MAX, nb_of_fb * urbs_per_frame + 1);
+        } else {
+            *num_of_urbs = UVC_AUTO_URB_NUM;
+        }
+    }
+    ESP_LOGD(TAG, "URB auto sizing: %u URBs, %zu bytes each", *num_of_urbs, *urb_size);
+}
+
+/**
+ * @brief Re-allocate auto-sized URBs according to fill levels measured in last streaming session
+ *
+ * Bulk only: URBs that were never filled to half are shrunk to save RAM,
+ * URBs that were completely filled are grown to lower the interrupt rate.
+ *
+ * @note There can be no transfers in flight, at the moment of calling this function.
+ * @param[in] uvc_stream Pointer to UVC stream
+ * @return
+ *     - ESP_OK:         Success, URBs were re-allocated or no change was needed
+ *     - ESP_ERR_NO_MEM: Not enough memory for transfers allocation
+ */
+static esp_err_t uvc_transfers_auto_resize(uvc_stream_t *uvc_stream)
+{
+    const size_t fill_max = uvc_stream->single_thread.urb_fill_max;
+    uvc_stream->single_thread.urb_fill_max = 0; // Start new measurement
+    if (!uvc_stream->constant.urb_auto_size || fill_max == 0 || uvc_stream->constant.num_of_xfers == 0) {
+        return ESP_OK;
+    }
+
+    const uint16_t mps = USB_EP_DESC_GET_MPS(uvc_stream->constant.ep_desc);
+    const size_t current_size = uvc_stream->constant.xfers[0]->data_buffer_size;
+    size_t new_size = current_size;
+    if (fill_max >= current_size) {
+        new_size = MIN(current_size * 2, UVC_AUTO_URB_MAX_SIZE);
+    } else if (usb_round_up_to_mps(fill_max, mps) * 2 <= current_size) {
+        new_size = usb_round_up_to_mps(fill_max, mps);
+    }
+    new_size = usb_round_up_to_mps(new_size, mps);
+    if (new_size == current_size) {
+        return ESP_OK;
+    }
+
+    ESP_LOGD(TAG, "URB auto sizing: %zu -> %zu bytes, measured fill %zu bytes", current_size, new_size, fill_max);
+    const unsigned num_of_xfers = uvc_stream->constant.num_of_xfers;
+    uvc_transfers_free(uvc_stream);
+    if (uvc_transfers_allocate(uvc_stream, num_of_xfers, new_size, uvc_stream->constant.ep_desc) != ESP_OK) {
+        // Try to get back to the original size
+        ESP_RETURN_ON_ERROR(
+            uvc_transfers_allocate(uvc_stream, num_of_xfers, current_size, uvc_stream->constant.ep_desc),
+            TAG, "Could not re-allocate USB transfers");
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Select ISOC alternate interface for payload size
+ *
+ * When a different alternate interface is selected, the interface is re-claimed and the URBs are re-allocated for the new endpoint.
+ *
+ * @note There can be no transfers in flight, at the moment of calling this function.
+ * @param[in] uvc_stream               Pointer to UVC stream
+ * @param[in] dwMaxPayloadTransferSize Payload size from format negotiation
+ * @return
+ *     - ESP_OK: Success, the stream uses the selected interface or no other interface fits in the remaining bandwidth
+ *     - Else: Could not claim the new interface or re-allocate URBs
+ */
+static esp_err_t uvc_interface_reselect(uvc_stream_t *uvc_stream, uint32_t dwMaxPayloadTransferSize)
+{
+    if (uvc_stream->constant.zero_copy && !uvc_frame_are_all_returned(uvc_stream)) {
+        return ESP_OK; // Frames held by the user reference the URBs, we cannot re-allocate them now
+    }
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(p_uvc_host_driver->open_close_mutex, portMAX_DELAY);
+    const usb_intf_desc_t *intf_desc;
+    const usb_ep_desc_t *ep_desc;
+    if (uvc_bandwidth_reserve(uvc_stream, dwMaxPayloadTransferSize, &intf_desc, &ep_desc) != ESP_OK ||
+            intf_desc->bAlternateSetting == uvc_stream->constant.bAlternateSetting) {
+        goto done; // Same alternate interface was selected, keep using it
+    }
+
+    ESP_LOGI(TAG, "Switching interface %d from alternate %d to %d",
+             uvc_stream->constant.bInterfaceNumber, uvc_stream->constant.bAlternateSetting, intf_desc->bAlternateSetting);
+    ESP_GOTO_ON_ERROR(
+        usb_host_interface_release(p_uvc_host_driver->usb_client_hdl, uvc_stream->constant.dev_hdl, uvc_stream->constant.bInterfaceNumber),
+        done, TAG, "Could not release interface");
+    ESP_GOTO_ON_ERROR(
+        usb_host_interface_claim(p_uvc_host_driver->usb_client_hdl, uvc_stream->constant.dev_hdl, intf_desc->bInterfaceNumber, intf_desc->bAlternateSetting),
+        done, TAG, "Could not claim interface %d-%d", intf_desc->bInterfaceNumber, intf_desc->bAlternateSetting);
+    uvc_stream->constant.bAlternateSetting = intf_desc->bAlternateSetting;
+    uvc_stream->constant.bEndpointAddress = ep_desc->bEndpointAddress;
+    uvc_stream->constant.ep_desc = ep_desc;
+
+    // Keep number and size of the URBs, only their packets are changed to new MPS
+    const unsigned num_of_xfers = uvc_stream->constant.num_of_xfers;
+    const size_t transfer_size = uvc_stream->constant.xfers[0]->data_buffer_size;
+    uvc_transfers_free(uvc_stream);
+    ESP_GOTO_ON_ERROR(
+        uvc_transfers_allocate(uvc_stream, num_of_xfers, transfer_size, ep_desc),
+        done, TAG, "Could not re-allocate USB transfers");
+
+done:
+    xSemaphoreGive(p_uvc_host_driver->open_close_mutex);
+    return ret;
+}
+
+/**
+ * @brief Switch degraded stream to an alternate interface that satisfies its payload size
+ *
+ * The stream could not get sufficient bandwidth when it was opened, but other streams might have released it in the meantime.
+ *
+ * @note There can be no transfers in flight, at the moment of calling this function.
+ * @param[in] uvc_stream               Pointer to UVC stream
+ * @param[in] dwMaxPayloadTransferSize Payload size from format negotiation
+ * @return
+ *     - ESP_OK: Success, the stream was upgraded or no upgrade was possible
+ *     - Else: Could not claim the new interface or re-allocate URBs
+ */
+static esp_err_t uvc_bandwidth_rebalance(uvc_stream_t *uvc_stream, uint32_t dwMaxPayloadTransferSize)
+{
+    if (!UVC_ATOMIC_LOAD(uvc_stream->constant.bandwidth_degraded)) {
+        return ESP_OK;
+    }
+    return uvc_interface_reselect(uvc_stream, dwMaxPayloadTransferSize);
+}
+
+/**
+ * @brief Release USB device object
+ *
+ * The USB device is closed when its last stream releases it.
+ * Must be called with open/close mutex taken.
+ *
+ * @param[in] device USB device object, can be NULL
+ */
+static void uvc_usb_device_release(uvc_device_t *device)
+{
+    if (!device) {
+        return;
+    }
+    assert(device->num_streams > 0);
+    if (--device->num_streams > 0) {
+        return; // Other streams still use the device
+    }
+    SLIST_REMOVE(&p_uvc_host_driver->uvc_device_list, device, uvc_device_s, list_entry);
+    xSemaphoreTake(device->ctrl_mutex, portMAX_DELAY); // Wait for CTRL transfer in flight
+    xSemaphoreGive(device->ctrl_mutex);
+    vSemaphoreDelete(device->ctrl_mutex);
+    vSemaphoreDelete((SemaphoreHandle_t)device->ctrl_transfer->context);
+    UVC_TRANSFER_FREE(device->ctrl_transfer);
+    uvc_desc_index_free(device->desc_index);
+    // We don't check the error code of usb_host_device_close, as the close might fail, if someone else is still using the device (not all interfaces are released)
+    CLIENT_DEVICE_CLOSE(p_uvc_host_driver->usb_client_hdl, device->dev_hdl); // Gracefully continue on error
+    UVC_FREE(CONTROL, device, sizeof(uvc_device_t));
+}
+
+/**
+ * @brief Create USB device object for opened USB device
+ *
+ * The object is shared by all streams of this device: They use its descriptor index and CTRL transfer.
+ * Must be called with open/close mutex taken.
+ *
+ * @param[in]  dev_hdl    Opened USB device. It is closed when the last stream releases the object
+ * @param[out] device_ret USB device object with no streams
+ * @return
+ *     - ESP_OK: Success
+ *     - ESP_ERR_NO_MEM: Not enough memory
+ *     - Else: Device info or descriptors could not be read
+ */
+static esp_err_t uvc_usb_device_create(usb_device_handle_t dev_hdl, uvc_device_t **device_ret)
+{
+    esp_err_t ret;
+    uvc_device_t *device = UVC_CALLOC(CONTROL, 1, sizeof(uvc_device_t));
+    SemaphoreHandle_t ctrl_mutex = xSemaphoreCreateMutex();
+    SemaphoreHandle_t ctrl_sem = xSemaphoreCreateBinary();
+    usb_transfer_t *ctrl_xfer = NULL;
+    UVC_TRANSFER_ALLOC(64, 0, &ctrl_xfer); // Worst case HS MPS
+    ESP_GOTO_ON_FALSE(device && ctrl_mutex && ctrl_sem && ctrl_xfer, ESP_ERR_NO_MEM, err, TAG, "Not enough memory for USB device");
+
+#if UVC_HAS_USB_SPEED_HIGH
+    // Device speed is needed for bandwidth planning
+    usb_device_info_t dev_info;
+    ESP_GOTO_ON_ERROR(usb_host_device_info(dev_hdl, &dev_info), err, TAG, "Could not get device info");
+    device->high_speed = (dev_info.speed == USB_SPEED_HIGH);
+#endif
+
+    // Walk the configuration descriptor only once, all following lookups of all streams use the index
+    const usb_config_desc_t *cfg_desc;
+    ESP_GOTO_ON_ERROR(usb_host_get_active_config_descriptor(dev_hdl, &cfg_desc), err, TAG, "Could not get configuration descriptor");
+    ESP_GOTO_ON_ERROR(uvc_desc_index_build(cfg_desc, &device->desc_index), err, TAG, "Could not index descriptors");
+
+    ctrl_xfer->device_handle = dev_hdl;
+    ctrl_xfer->context = ctrl_sem;
+    ctrl_xfer->bEndpointAddress = 0;
+    ctrl_xfer->timeout_ms = 5000;
+    ctrl_xfer->callback = ctrl_xfer_cb;
+    device->dev_hdl = dev_hdl;
+    device->ctrl_transfer = ctrl_xfer;
+    device->ctrl_mutex = ctrl_mutex;
+    SLIST_INSERT_HEAD(&p_uvc_host_driver->uvc_device_list, device, list_entry);
+    *device_ret = device;
+    return ESP_OK;
+
+err:
+    UVC_FREE(CONTROL, device, sizeof(uvc_device_t));
+    if (ctrl_mutex) {
+        vSemaphoreDelete(ctrl_mutex);
+    }
+    if (ctrl_sem) {
+        vSemaphoreDelete(ctrl_sem);
+    }
+    if (ctrl_xfer) {
+        UVC_TRANSFER_FREE(ctrl_xfer);
+    }
+    return ret;
+}
+
 /**
  * @brief Helper function that releases resources claimed by UVC device
  *
@@ -236,52 +576,66 @@ err:
 static void uvc_device_remove(uvc_stream_t *uvc_stream)
 {
     assert(uvc_stream);
+    uvc_processing_deinit(uvc_stream); // The task could still process URBs of the stream
     uvc_transfers_free(uvc_stream);
     uvc_frame_free(uvc_stream);
-    // We don't check the error code of usb_host_device_close, as the close might fail, if someone else is still using the device (not all interfaces are released)
-    usb_host_device_close(p_uvc_host_driver->usb_client_hdl, uvc_stream->constant.dev_hdl); // Gracefully continue on error
-    free(uvc_stream);
+    uvc_frame_pool_detach(uvc_stream);
+    uvc_still_free(uvc_stream);
+    uvc_ctrl_cache_free(uvc_stream);
+    uvc_staging_deinit(uvc_stream);
+    uvc_bandwidth_release(uvc_stream);
+    uvc_usb_device_release(uvc_stream->constant.device);
+    UVC_FREE(CONTROL, uvc_stream, sizeof(uvc_stream_t));
 }
 
 /**
  * @brief Open USB device with requested VID/PID
  *
  * This function has two regular return paths:
- * 1. USB device with matching VID/PID is already opened by this driver: allocate new UVC device on top of the already opened USB device.
+ * 1. USB device with matching VID/PID is already opened by this driver, or the sibling stream is given:
+ *    allocate new UVC stream on top of the already opened USB device, sharing its device object.
  * 2. USB device with matching VID/PID is NOT opened by this driver yet: poll USB connected devices until it is found.
  *
  * @note This function will block for timeout_ticks, if the device is not enumerated at the moment of calling this function.
  * @param[in]  vid           Vendor ID
  * @param[in]  pid           Product ID
+ * @param[in]  sibling       Open stream of the requested USB device. NULL: The device is found by VID/PID
  * @param[in]  timeout_ticks Connection timeout in FreeRTOS ticks
  * @param[out] dev           UVC device
  * @return
  *     - ESP_OK: Success - device opened
  *     - ESP_ERR_NOT_FOUND: Device not found in given timeout
+ *     - ESP_ERR_NO_MEM: Not enough memory
  */
-static esp_err_t uvc_find_and_open_usb_device(uint16_t vid, uint16_t pid, TickType_t timeout_ticks, uvc_stream_t **dev)
+static esp_err_t uvc_find_and_open_usb_device(uint16_t vid, uint16_t pid, const uvc_stream_t *sibling, TickType_t timeout_ticks, uvc_stream_t **dev)
 {
     assert(p_uvc_host_driver);
     assert(dev);
 
-    *dev = calloc(1, sizeof(uvc_stream_t));
+    *dev = UVC_CALLOC(CONTROL, 1, sizeof(uvc_stream_t));
     if (*dev == NULL) {
         return ESP_ERR_NO_MEM;
     }
+    portMUX_INITIALIZE(&(*dev)->constant.lock);
 
-    // First, check list of already opened UVC devices
+    // First, check list of already opened USB devices
     ESP_LOGD(TAG, "Checking list of opened USB devices");
-    uvc_stream_t *uvc_stream;
-    SLIST_FOREACH(uvc_stream, &p_uvc_host_driver->uvc_stream_list, list_entry) {
-        const usb_device_desc_t *device_desc;
-        ESP_ERROR_CHECK(usb_host_get_device_descriptor(uvc_stream->constant.dev_hdl, &device_desc));
-        if ((vid == device_desc->idVendor || vid == UVC_HOST_ANY_VID) &&
-                (pid == device_desc->idProduct || pid == UVC_HOST_ANY_PID)) {
-            // Return path 1:
-            (*dev)->constant.dev_hdl = uvc_stream->constant.dev_hdl;
-            return ESP_OK;
+    uvc_device_t *device = NULL;
+    if (sibling) {
+        device = sibling->constant.device;
+    } else {
+        SLIST_FOREACH(device, &p_uvc_host_driver->uvc_device_list, list_entry) {
+            const usb_device_desc_t *device_desc;
+            ESP_ERROR_CHECK(usb_host_get_device_descriptor(device->dev_hdl, &device_desc));
+            if ((vid == device_desc->idVendor || vid == UVC_HOST_ANY_VID) &&
+                    (pid == device_desc->idProduct || pid == UVC_HOST_ANY_PID)) {
+                break;
+            }
         }
     }
+    if (device) {
+        goto found; // Return path 1
+    }
 
     // Second, poll connected devices until new device is connected or timeout
     TickType_t timeout = timeout_ticks;
@@ -298,7 +652,7 @@ static esp_err_t uvc_find_and_open_usb_device(uint16_t vid, uint16_t pid, TickTy
         for (int i = 0; i < num_of_devices; i++) {
             usb_device_handle_t current_device;
             // Open USB device
-            if (usb_host_device_open(p_uvc_host_driver->usb_client_hdl, dev_addr_list[i], &current_device) != ESP_OK) {
+            if (CLIENT_DEVICE_OPEN(p_uvc_host_driver->usb_client_hdl, dev_addr_list[i], &current_device) != ESP_OK) {
                 continue; // In case we failed to open this device, continue with next one in the list
             }
             assert(current_device);
@@ -307,61 +661,80 @@ static esp_err_t uvc_find_and_open_usb_device(uint16_t vid, uint16_t pid, TickTy
             if ((vid == device_desc->idVendor || vid == UVC_HOST_ANY_VID) &&
                     (pid == device_desc->idProduct || pid == UVC_HOST_ANY_PID)) {
                 // Return path 2:
-                (*dev)->constant.dev_hdl = current_device;
-                return ESP_OK;
+                const esp_err_t ret = uvc_usb_device_create(current_device, &device);
+                if (ret != ESP_OK) {
+                    CLIENT_DEVICE_CLOSE(p_uvc_host_driver->usb_client_hdl, current_device);
+                    UVC_FREE(CONTROL, *dev, sizeof(uvc_stream_t));
+                    *dev = NULL;
+                    return ret;
+                }
+                goto found;
             }
-            usb_host_device_close(p_uvc_host_driver->usb_client_hdl, current_device);
+            CLIENT_DEVICE_CLOSE(p_uvc_host_driver->usb_client_hdl, current_device);
         }
         vTaskDelay(pdMS_TO_TICKS(50));
     } while (xTaskCheckForTimeOut(&connection_timeout, &timeout) == pdFALSE);
 
     // Timeout was reached, clean-up
-    free(*dev);
+    UVC_FREE(CONTROL, *dev, sizeof(uvc_stream_t));
     *dev = NULL;
     return ESP_ERR_NOT_FOUND;
+
+found:
+    device->num_streams++;
+    (*dev)->constant.device = device;
+    (*dev)->constant.dev_hdl = device->dev_hdl;
+    (*dev)->constant.desc_index = device->desc_index;
+    (*dev)->constant.high_speed = device->high_speed;
+    return ESP_OK;
 }
 
 static esp_err_t uvc_find_streaming_intf(uvc_stream_t *uvc_stream, uint8_t uvc_index, const uvc_host_stream_format_t *vs_format)
 {
     UVC_CHECK(uvc_stream && vs_format, ESP_ERR_INVALID_ARG);
 
-    const usb_config_desc_t *cfg_desc;
-    ESP_ERROR_CHECK(usb_host_get_active_config_descriptor(uvc_stream->constant.dev_hdl, &cfg_desc));
-
     // Find UVC USB function with desired index
-    uint16_t bcdUVC = 0;
-    uint8_t bInterfaceNumber = 0;
-
+    const uvc_desc_index_intf_t *vs_intf;
     ESP_RETURN_ON_ERROR(
-        uvc_desc_get_streaming_interface_num(cfg_desc, uvc_index, vs_format, &bcdUVC, &bInterfaceNumber),
+        uvc_desc_index_get_streaming_intf(uvc_stream->constant.desc_index, uvc_index, vs_format, &vs_intf),
         TAG, "Could not find frame format %dx%d@%2.1fFPS",
         vs_format->h_res, vs_format->v_res, vs_format->fps);
 
+    // Streams of one device share its descriptor index and CTRL transfer, but each one needs its own streaming interface
+    const uvc_stream_t *other_stream;
+    SLIST_FOREACH(other_stream, &p_uvc_host_driver->uvc_stream_list, list_entry) {
+        if (other_stream->constant.device == uvc_stream->constant.device && other_stream->constant.bInterfaceNumber == vs_intf->bInterfaceNumber) {
+            ESP_LOGE(TAG, "Streaming interface %d is already used by another stream", vs_intf->bInterfaceNumber);
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+
     // Here we only save the interface number that can meet our format requirement
     // bAlternateSetting and bEndpointAddress are saved during interface claim
-    uvc_stream->constant.bInterfaceNumber = bInterfaceNumber;
-    uvc_stream->constant.bcdUVC = bcdUVC;
+    uvc_stream->constant.bInterfaceNumber = vs_intf->bInterfaceNumber;
+    uvc_stream->constant.bcdUVC = vs_intf->bcdUVC;
+    uvc_stream->constant.vs_intf = vs_intf;
     return ESP_OK;
 }
 
 /**
  * @brief Claim streaming interface
  *
- * @param[in]  uvc_stream       UVC stream handle
- * @param[out] ep_desc_ret      Pointer of associated streaming endpoint
+ * The alternate interface is selected by the bandwidth planner
+ *
+ * @param[in]  uvc_stream               UVC stream handle
+ * @param[in]  dwMaxPayloadTransferSize Payload size from format negotiation
+ * @param[out] ep_desc_ret              Pointer of associated streaming endpoint
  * @return
  *     - ESP_OK: Success - interface claimed
  *     - Else: Error
  */
-static esp_err_t uvc_claim_interface(uvc_stream_t *uvc_stream, const usb_ep_desc_t **ep_desc_ret)
+static esp_err_t uvc_claim_interface(uvc_stream_t *uvc_stream, uint32_t dwMaxPayloadTransferSize, const usb_ep_desc_t **ep_desc_ret)
 {
     const usb_intf_desc_t *intf_desc;
     const usb_ep_desc_t *ep_desc;
-    const usb_config_desc_t *cfg_desc;
-    ESP_ERROR_CHECK(usb_host_get_active_config_descriptor(uvc_stream->constant.dev_hdl, &cfg_desc));
-
     ESP_RETURN_ON_ERROR(
-        uvc_desc_get_streaming_intf_and_ep(cfg_desc, uvc_stream->constant.bInterfaceNumber, MAX_MPS_IN, &intf_desc, &ep_desc),
+        uvc_bandwidth_reserve(uvc_stream, dwMaxPayloadTransferSize, &intf_desc, &ep_desc),
         TAG, "Could not find Streaming interface %d", uvc_stream->constant.bInterfaceNumber);
 
     // Save all required parameters
@@ -372,6 +745,16 @@ static esp_err_t uvc_claim_interface(uvc_stream_t *uvc_stream, const usb_ep_desc
     return usb_host_interface_claim(p_uvc_host_driver->usb_client_hdl, uvc_stream->constant.dev_hdl, intf_desc->bInterfaceNumber, intf_desc->bAlternateSetting);
 }
 
+static esp_err_t client_deregister(uvc_host_driver_t *uvc_obj)
+{
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    if (uvc_obj->shared_client) {
+        return usb_host_shared_client_deregister(usb_event_cb, NULL);
+    }
+#endif
+    return usb_host_client_deregister(uvc_obj->usb_client_hdl);
+}
+
 esp_err_t uvc_host_install(const uvc_host_driver_config_t *driver_config)
 {
     UVC_CHECK(!UVC_ATOMIC_LOAD(p_uvc_host_driver), ESP_ERR_INVALID_STATE);
@@ -386,30 +769,35 @@ esp_err_t uvc_host_install(const uvc_host_driver_config_t *driver_config)
     if (driver_config == NULL) {
         driver_config = &default_driver_config;
     }
+#if !USB_HOST_SHARED_CLIENT_ENABLED
+    UVC_CHECK(!driver_config->shared_client, ESP_ERR_NOT_SUPPORTED);
+#endif
+    const bool create_task = driver_config->create_background_task && !driver_config->shared_client;
 
     // Allocate all we need for this driver
     esp_err_t ret;
-    uvc_host_driver_t *uvc_obj = heap_caps_calloc(1, sizeof(uvc_host_driver_t), MALLOC_CAP_DEFAULT);
+    uvc_host_driver_t *uvc_obj = UVC_CALLOC(CONTROL, 1, sizeof(uvc_host_driver_t));
     EventGroupHandle_t driver_status = xEventGroupCreate();
     SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
-    SemaphoreHandle_t ctrl_mutex = xSemaphoreCreateMutex();
-    SemaphoreHandle_t ctrl_sem = xSemaphoreCreateBinary();
-    usb_transfer_t *ctrl_xfer = NULL;
-    usb_host_transfer_alloc(64, 0, &ctrl_xfer); // Worst case HS MPS
     TaskHandle_t driver_task_h = NULL;
+    bool cache_initialized = false;
 
-    if (driver_config->create_background_task) {
+    if (create_task) {
         xTaskCreatePinnedToCore(
             uvc_client_task, "USB-UVC", driver_config->driver_task_stack_size, NULL,
             driver_config->driver_task_priority, &driver_task_h, driver_config->xCoreID);
     }
 
-    if (uvc_obj == NULL || (driver_task_h == NULL && driver_config->create_background_task) || driver_status == NULL ||
-            mutex == NULL || ctrl_mutex == NULL || ctrl_xfer == NULL || ctrl_sem == NULL) {
+    if (uvc_obj == NULL || (driver_task_h == NULL && create_task) || driver_status == NULL ||
+            mutex == NULL) {
         ret = ESP_ERR_NO_MEM;
         goto err;
     }
 
+    // Format negotiation cache is optional
+    ESP_GOTO_ON_ERROR(uvc_negotiation_cache_init(driver_config->negotiation_cache_size), err, TAG, "Could not initialize negotiation cache");
+    cache_initialized = true;
+
     // Register USB Host client
     usb_host_client_handle_t usb_client = NULL;
     const usb_host_client_config_t client_config = {
@@ -418,19 +806,22 @@ esp_err_t uvc_host_install(const uvc_host_driver_config_t *driver_config)
         .async.client_event_callback = usb_event_cb,
         .async.callback_arg = NULL
     };
-    ESP_GOTO_ON_ERROR(usb_host_client_register(&client_config, &usb_client), err, TAG, "Failed to register USB host client");
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    if (driver_config->shared_client) {
+        ESP_GOTO_ON_ERROR(usb_host_shared_client_register(usb_event_cb, NULL, &usb_client), err, TAG, "Failed to register to shared USB host client");
+    } else
+#endif
+    {
+        ESP_GOTO_ON_ERROR(usb_host_client_register(&client_config, &usb_client), err, TAG, "Failed to register USB host client");
+    }
 
     // Initialize UVC driver structure
     SLIST_INIT(&(uvc_obj->uvc_stream_list));
+    SLIST_INIT(&(uvc_obj->uvc_device_list));
     uvc_obj->driver_status = driver_status;
     uvc_obj->open_close_mutex = mutex;
     uvc_obj->usb_client_hdl = usb_client;
-    uvc_obj->ctrl_mutex = ctrl_mutex;
-    uvc_obj->ctrl_transfer = ctrl_xfer;
-    uvc_obj->ctrl_transfer->context = ctrl_sem;
-    uvc_obj->ctrl_transfer->bEndpointAddress = 0;
-    uvc_obj->ctrl_transfer->timeout_ms = 5000;
-    uvc_obj->ctrl_transfer->callback = ctrl_xfer_cb;
+    uvc_obj->shared_client = driver_config->shared_client;
 
     // Between 1st call of this function and following section, another task might try to install this driver:
     // Make sure that there is only one instance of this driver in the system
@@ -438,6 +829,10 @@ esp_err_t uvc_host_install(const uvc_host_driver_config_t *driver_config)
         ret = ESP_ERR_INVALID_STATE;
         goto client_err;
     }
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    // Only fails if the driver is registered already, which the check above excludes
+    ESP_ERROR_CHECK(usb_host_pm_register(USB_HOST_PM_DRIVER_UVC, &uvc_pm_ops, NULL));
+#endif
 
     // Everything OK: Start UVC-Driver task and return
     if (driver_task_h) {
@@ -446,9 +841,12 @@ esp_err_t uvc_host_install(const uvc_host_driver_config_t *driver_config)
     return ESP_OK;
 
 client_err:
-    usb_host_client_deregister(usb_client);
+    client_deregister(uvc_obj);
 err: // Clean-up
-    free(uvc_obj);
+    if (cache_initialized) {
+        uvc_negotiation_cache_deinit();
+    }
+    UVC_FREE(CONTROL, uvc_obj, sizeof(uvc_host_driver_t));
     if (driver_status) {
         vEventGroupDelete(driver_status);
     }
@@ -458,15 +856,6 @@ err: // Clean-up
     if (mutex) {
         vSemaphoreDelete(mutex);
     }
-    if (ctrl_mutex) {
-        vSemaphoreDelete(ctrl_mutex);
-    }
-    if (ctrl_xfer) {
-        usb_host_transfer_free(ctrl_xfer);
-    }
-    if (ctrl_sem) {
-        vSemaphoreDelete(ctrl_sem);
-    }
     return ret;
 }
 
@@ -476,8 +865,12 @@ esp_err_t uvc_host_uninstall()
     uvc_host_driver_t *uvc_obj = UVC_ATOMIC_LOAD(p_uvc_host_driver); // Save Driver's handle to temporary handle
     UVC_CHECK(uvc_obj, ESP_ERR_INVALID_STATE);
 
-    xSemaphoreTake(uvc_obj->open_close_mutex, portMAX_DELAY); // Wait for all open/close calls to finish
-    xSemaphoreTake(uvc_obj->ctrl_mutex, portMAX_DELAY); // Wait for all CTRL transfers to finish
+    xSemaphoreTake(uvc_obj->open_close_mutex, portMAX_DELAY); // Wait for all open/close calls to finish. CTRL transfers belong to open devices
+
+#if USB_HOST_SHARED_CLIENT_ENABLED
+    // Fails if a suspend hook is waiting for open_close_mutex. Otherwise no hook can run from this point
+    ESP_GOTO_ON_ERROR(usb_host_pm_deregister(USB_HOST_PM_DRIVER_UVC), unblock, TAG, "Bus suspend or resume in progress");
+#endif
 
     UVC_ENTER_CRITICAL();
     if (SLIST_EMPTY(&uvc_obj->uvc_stream_list)) { // Check that device list is empty (all devices closed)
@@ -485,6 +878,9 @@ esp_err_t uvc_host_uninstall()
     } else {
         ret = ESP_ERR_INVALID_STATE;
         UVC_EXIT_CRITICAL();
+#if USB_HOST_SHARED_CLIENT_ENABLED
+        usb_host_pm_register(USB_HOST_PM_DRIVER_UVC, &uvc_pm_ops, NULL);
+#endif
         goto unblock;
     }
     UVC_EXIT_CRITICAL();
@@ -500,22 +896,18 @@ esp_err_t uvc_host_uninstall()
     }
 
     ESP_LOGD(TAG, "Deregistering client");
-    ESP_ERROR_CHECK(usb_host_client_deregister(uvc_obj->usb_client_hdl));
+    ESP_ERROR_CHECK(client_deregister(uvc_obj));
 
     // Free remaining resources and return
     vEventGroupDelete(uvc_obj->driver_status);
     xSemaphoreGive(uvc_obj->open_close_mutex);
     vSemaphoreDelete(uvc_obj->open_close_mutex);
-    xSemaphoreGive(uvc_obj->ctrl_mutex);
-    vSemaphoreDelete(uvc_obj->ctrl_mutex);
-    vSemaphoreDelete(uvc_obj->ctrl_transfer->context);
-    usb_host_transfer_free(uvc_obj->ctrl_transfer);
-    free(uvc_obj);
+    uvc_negotiation_cache_deinit();
+    UVC_FREE(CONTROL, uvc_obj, sizeof(uvc_host_driver_t));
     return ESP_OK;
 
 unblock:
     xSemaphoreGive(uvc_obj->open_close_mutex);
-    xSemaphoreGive(uvc_obj->ctrl_mutex);
     return ret;
 }
 
@@ -529,12 +921,66 @@ esp_err_t uvc_host_stream_open(const uvc_host_stream_config_t *stream_config, in
     uvc_stream_t *uvc_stream;
     xSemaphoreTake(p_uvc_host_driver->open_close_mutex, portMAX_DELAY);
 
+    // Sibling stream must be open, its USB device is shared with the new stream
+    const uvc_stream_t *sibling = (const uvc_stream_t *)stream_config->usb.sibling;
+    if (sibling) {
+        const uvc_stream_t *open_stream;
+        SLIST_FOREACH(open_stream, &p_uvc_host_driver->uvc_stream_list, list_entry) {
+            if (open_stream == sibling) {
+                break;
+            }
+        }
+        ESP_GOTO_ON_FALSE(open_stream, ESP_ERR_INVALID_ARG, not_found, TAG, "Sibling stream is not open");
+    }
+
     // Find underlying USB device
-    ret = uvc_find_and_open_usb_device(stream_config->usb.vid, stream_config->usb.pid, timeout, &uvc_stream);
+    ret = uvc_find_and_open_usb_device(stream_config->usb.vid, stream_config->usb.pid, sibling, timeout, &uvc_stream);
     if (ESP_OK != ret) {
         goto not_found;
     }
 
+    // Zero-copy frames reference data in URBs, there is nothing to stage
+    ESP_GOTO_ON_FALSE(!(stream_config->advanced.zero_copy && stream_config->advanced.staging_buffer_size),
+                      ESP_ERR_INVALID_ARG, claim_err, TAG, "Zero-copy mode cannot be used with staging buffer");
+
+    // Slices are copied out of frame buffer, which is not the case in zero-copy and staging modes
+    ESP_GOTO_ON_FALSE(!(stream_config->slice_cb && (stream_config->advanced.zero_copy || stream_config->advanced.staging_buffer_size)),
+                      ESP_ERR_INVALID_ARG, claim_err, TAG, "Slice mode cannot be used with zero-copy mode or staging buffer");
+
+    // NAL index offsets count from start of frame, slices are passed to user before the frame is complete
+    ESP_GOTO_ON_FALSE(!(stream_config->slice_cb && stream_config->advanced.nal_index_size),
+                      ESP_ERR_INVALID_ARG, claim_err, TAG, "Slice mode cannot be used with NAL index");
+    uvc_stream->constant.nal_index_size = stream_config->advanced.nal_index_size;
+
+    // Damaged ranges are reported with the complete frame, slices are passed to user before the damage is known
+    ESP_GOTO_ON_FALSE(!(stream_config->slice_cb && stream_config->delivery.corrupt_frames),
+                      ESP_ERR_INVALID_ARG, claim_err, TAG, "Slice mode cannot be used with corrupt frame delivery");
+
+    // URBs referenced by frames are tracked in 32bit mask
+    if (stream_config->advanced.zero_copy) {
+        ESP_GOTO_ON_FALSE(stream_config->advanced.number_of_urbs <= 32, ESP_ERR_INVALID_ARG, claim_err, TAG, "Zero-copy mode supports up to 32 URBs");
+        uvc_stream->constant.zero_copy = true;
+    }
+
+    // URBs held by zero-copy frames are re-submitted when the frame is returned, they cannot be kept as spare
+    ESP_GOTO_ON_FALSE(!(stream_config->advanced.zero_copy && stream_config->advanced.processing_task.stack_size),
+                      ESP_ERR_INVALID_ARG, claim_err, TAG, "Zero-copy mode cannot be used with processing task");
+
+    // Zero-copy frames have no data buffers to take from the pool
+    ESP_GOTO_ON_FALSE(!(stream_config->advanced.zero_copy && stream_config->advanced.frame_pool),
+                      ESP_ERR_INVALID_ARG, claim_err, TAG, "Zero-copy mode cannot be used with frame buffer pool");
+
+    // Adaptive frame buffers are copied to and re-allocated by the driver, pool buffers have fixed size
+    ESP_GOTO_ON_FALSE(!(stream_config->advanced.adaptive_frame_size.enabled &&
+                        (stream_config->advanced.zero_copy || stream_config->advanced.staging_buffer_size ||
+                         stream_config->advanced.frame_pool || stream_config->slice_cb)),
+                      ESP_ERR_INVALID_ARG, claim_err, TAG, "Adaptive frame size can be used only with frame buffers of the stream in copy mode");
+    ESP_GOTO_ON_FALSE(stream_config->advanced.adaptive_frame_size.percentile <= 100,
+                      ESP_ERR_INVALID_ARG, claim_err, TAG, "Invalid percentile of adaptive frame size");
+    ESP_GOTO_ON_FALSE(stream_config->advanced.frame_pool_reserved >= 0 &&
+                      stream_config->advanced.frame_pool_reserved <= stream_config->advanced.number_of_frame_buffers,
+                      ESP_ERR_INVALID_ARG, claim_err, TAG, "Invalid number of reserved pool buffers");
+
     // Find the streaming interface
     ESP_GOTO_ON_ERROR(
         uvc_find_streaming_intf(uvc_stream, stream_config->usb.uvc_stream_index, &stream_config->vs_format),
@@ -549,23 +995,53 @@ esp_err_t uvc_host_stream_open(const uvc_host_stream_config_t *stream_config, in
     // Claim Video Streaming interface
     const usb_ep_desc_t *ep_desc;
     ESP_GOTO_ON_ERROR(
-        uvc_claim_interface(uvc_stream, &ep_desc),
+        uvc_claim_interface(uvc_stream, vs_result.dwMaxPayloadTransferSize, &ep_desc),
         claim_err, TAG, "Could not claim Streaming interface");
     ESP_LOGD(TAG, "Claimed interface index %d with MPS %d", uvc_stream->constant.bInterfaceNumber, USB_EP_DESC_GET_MPS(ep_desc));
 
-    // Allocate USB transfers
-    ESP_GOTO_ON_ERROR(
-        uvc_transfers_allocate(uvc_stream, stream_config->advanced.number_of_urbs, stream_config->advanced.urb_size, ep_desc),
-        err, TAG,);
+    uvc_stream->constant.ep_desc = ep_desc;
+    uvc_stream->constant.dwMaxPayloadTransferSize = vs_result.dwMaxPayloadTransferSize;
 
     // Allocate Frame buffers
     size_t frame_buffer_size;
-    if (stream_config->advanced.frame_size != 0) {
+    if (stream_config->advanced.frame_pool) {
+        frame_buffer_size = uvc_frame_pool_buffer_size(stream_config->advanced.frame_pool); // Frame data are stored in pool buffers
+    } else if (stream_config->advanced.frame_size != 0) {
         frame_buffer_size = stream_config->advanced.frame_size; // If user provided custom frame size, use it
+    } else if (stream_config->advanced.adaptive_frame_size.enabled) {
+        frame_buffer_size = vs_result.dwMaxVideoFrameSize / 4; // Buffers grow to sizes of received frames
     } else {
         frame_buffer_size = vs_result.dwMaxVideoFrameSize; // Use value from frame format negotiation
     };
 
+    // Allocate USB transfers
+    unsigned num_of_urbs = stream_config->advanced.number_of_urbs;
+    size_t urb_size = stream_config->advanced.urb_size;
+    uvc_transfers_auto_size(uvc_stream, ep_desc, &vs_result, stream_config->advanced.number_of_frame_buffers, frame_buffer_size, &num_of_urbs, &urb_size);
+
+    // Processing task must exist before the URBs are allocated, it replaces their callback
+    if (stream_config->advanced.processing_task.stack_size) {
+        num_of_urbs += stream_config->advanced.processing_task.number_of_spare_urbs;
+        ESP_GOTO_ON_ERROR(
+            uvc_processing_init(uvc_stream, stream_config, num_of_urbs),
+            err, TAG, "Could not create processing task");
+    }
+    ESP_GOTO_ON_ERROR(
+        uvc_transfers_allocate(uvc_stream, num_of_urbs, urb_size, ep_desc),
+        err, TAG,);
+
+    // Staging ring must be ready before frame buffers are allocated: It changes their alignment
+    if (stream_config->advanced.staging_buffer_size) {
+        ESP_GOTO_ON_ERROR(
+            uvc_staging_init(uvc_stream, stream_config->advanced.staging_buffer_size),
+            err, TAG, "Could not initialize staging buffer");
+    }
+
+    if (stream_config->advanced.frame_pool) {
+        ESP_GOTO_ON_ERROR(
+            uvc_frame_pool_attach(stream_config->advanced.frame_pool, uvc_stream, stream_config->advanced.frame_pool_reserved),
+            err, TAG, "Could not reserve frame buffers in the pool");
+    }
     ESP_GOTO_ON_ERROR(
         uvc_frame_allocate(
             uvc_stream,
@@ -577,8 +1053,26 @@ esp_err_t uvc_host_stream_open(const uvc_host_stream_config_t *stream_config, in
     // Save info
     memcpy((uvc_host_stream_format_t *)&uvc_stream->constant.vs_format, &stream_config->vs_format, sizeof(uvc_host_stream_format_t));
     uvc_stream->constant.stream_cb = stream_config->event_cb;
-    uvc_stream->constant.frame_cb = stream_config->frame_cb;
+    uvc_stream->constant.frame_cb = stream_config->slice_cb ? NULL : stream_config->frame_cb; // Slice callback replaces frame callback
+    uvc_stream->constant.slice_cb = stream_config->slice_cb;
+    uvc_stream->constant.mjpeg_validation = stream_config->advanced.mjpeg_validation;
+    uvc_stream->constant.frame_decimation = stream_config->delivery.frame_decimation;
+    uvc_stream->constant.keyframes_only = stream_config->delivery.keyframes_only;
+    uvc_stream->constant.corrupt_frames = stream_config->delivery.corrupt_frames;
     uvc_stream->constant.cb_arg = stream_config->user_ctx;
+    uvc_stream->constant.frame_size_auto = (stream_config->advanced.frame_size == 0) && !stream_config->advanced.frame_pool &&
+                                           !stream_config->advanced.adaptive_frame_size.enabled;
+    uvc_stream->constant.frame_heap_caps = stream_config->advanced.frame_heap_caps;
+    if (stream_config->advanced.adaptive_frame_size.enabled) {
+        const uint8_t percentile = stream_config->advanced.adaptive_frame_size.percentile;
+        const uint8_t headroom = stream_config->advanced.adaptive_frame_size.headroom_percent;
+        uvc_stream->constant.adaptive.enabled = true;
+        uvc_stream->constant.adaptive.percentile = percentile ? percentile : 95;
+        uvc_stream->constant.adaptive.headroom_percent = headroom ? headroom : 25;
+        uvc_stream->constant.adaptive.frame_size = stream_config->advanced.frame_size;
+        uvc_frame_adaptive_set_max_size(uvc_stream, MAX(frame_buffer_size, vs_result.dwMaxVideoFrameSize));
+    }
+    uvc_stats_reset(uvc_stream);
 
     // Everything OK, add the device into list
     UVC_ENTER_CRITICAL();
@@ -629,15 +1123,25 @@ esp_err_t uvc_host_stream_close(uvc_host_stream_hdl_t stream_hdl)
     }
 
     // @todo create a function that will wait for all frames to be returned
-    if (!uvc_frame_are_all_returned(uvc_stream)) {
+    if (!uvc_frame_are_all_returned(uvc_stream) || !uvc_still_are_all_returned(uvc_stream)) {
         vTaskDelay(pdMS_TO_TICKS(70)); // Wait 70ms so the user can return all frames
-        if (!uvc_frame_are_all_returned(uvc_stream)) {
+        if (!uvc_frame_are_all_returned(uvc_stream) || !uvc_still_are_all_returned(uvc_stream)) {
             ESP_LOGW(TAG, "Not all frames are returned, cannot close!");
             ret = ESP_ERR_INVALID_STATE;
             goto exit;
         }
     }
 
+    // Asynchronous Video Control requests reference the stream until their completion callback
+    if (UVC_ATOMIC_LOAD(uvc_stream->constant.ctrl_pending) != 0) {
+        vTaskDelay(pdMS_TO_TICKS(70));
+        if (UVC_ATOMIC_LOAD(uvc_stream->constant.ctrl_pending) != 0) {
+            ESP_LOGW(TAG, "Video Control requests in flight, cannot close!");
+            ret = ESP_ERR_INVALID_STATE;
+            goto exit;
+        }
+    }
+
     // Release all interfaces
     ESP_ERROR_CHECK(usb_host_interface_release(p_uvc_host_driver->usb_client_hdl, uvc_stream->constant.dev_hdl, uvc_stream->constant.bInterfaceNumber));
 
@@ -681,19 +1185,31 @@ static esp_err_t uvc_clear_endpoint_feature(uvc_host_stream_hdl_t stream_hdl)
                NULL);
 }
 
-esp_err_t uvc_host_stream_start(uvc_host_stream_hdl_t stream_hdl)
+/**
+ * @brief Start UVC stream with already committed format
+ *
+ * @param[in] uvc_stream Pointer to UVC stream
+ * @param[in] vs_result  Result of format negotiation
+ * @return
+ *     - ESP_OK: Success - streaming started
+ *     - Else: USB lib error
+ */
+static esp_err_t uvc_stream_start_committed(uvc_stream_t *uvc_stream, const uvc_vs_ctrl_t *vs_result)
 {
-    UVC_CHECK(stream_hdl, ESP_ERR_INVALID_ARG);
-    UVC_CHECK(UVC_ATOMIC_LOAD(stream_hdl->dynamic.streaming) == false, ESP_ERR_INVALID_STATE);
+    uvc_host_stream_hdl_t stream_hdl = (uvc_host_stream_hdl_t)uvc_stream;
+    vTaskDelay(pdMS_TO_TICKS(10)); // Some cameras need delay between format Commit and SetInterface
+    uvc_stream->constant.dwMaxPayloadTransferSize = vs_result->dwMaxPayloadTransferSize;
+    uvc_stream->constant.vs_committed = *vs_result;
 
-    uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
+    // Streams opened with insufficient bandwidth get a better alternate interface, if other streams released their bandwidth
+    ESP_RETURN_ON_ERROR(
+        uvc_bandwidth_rebalance(uvc_stream, vs_result->dwMaxPayloadTransferSize),
+        TAG, "Could not rebalance bandwidth");
 
-    // 1. Negotiate the frame format
-    // @see USB UVC specification ver 1.5, figure 4-1
+    // Auto-sized URBs are adapted to fill levels from last streaming session. No URBs are in flight now
     ESP_RETURN_ON_ERROR(
-        uvc_host_stream_control_negotiate(uvc_stream, &uvc_stream->constant.vs_format, NULL),
-        TAG, "Failed to negotiate requested Video Stream format");
-    vTaskDelay(pdMS_TO_TICKS(10)); // Some cameras need delay between format Commit and SetInterface
+        uvc_transfers_auto_resize(uvc_stream),
+        TAG, "Could not resize USB transfers");
 
     // 2. Send command to the camera to start streaming: ISOC only
     if (uvc_stream->constant.bAlternateSetting != 0) {
@@ -710,6 +1226,22 @@ esp_err_t uvc_host_stream_start(uvc_host_stream_hdl_t stream_hdl)
     return ESP_OK;
 }
 
+esp_err_t uvc_host_stream_start(uvc_host_stream_hdl_t stream_hdl)
+{
+    UVC_CHECK(stream_hdl, ESP_ERR_INVALID_ARG);
+    UVC_CHECK(UVC_ATOMIC_LOAD(stream_hdl->dynamic.streaming) == false, ESP_ERR_INVALID_STATE);
+
+    uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
+
+    // 1. Negotiate the frame format
+    // @see USB UVC specification ver 1.5, figure 4-1
+    uvc_vs_ctrl_t vs_result;
+    ESP_RETURN_ON_ERROR(
+        uvc_host_stream_control_negotiate(uvc_stream, &uvc_stream->constant.vs_format, &vs_result),
+        TAG, "Failed to negotiate requested Video Stream format");
+    return uvc_stream_start_committed(uvc_stream, &vs_result);
+}
+
 esp_err_t uvc_host_stream_stop(uvc_host_stream_hdl_t stream_hdl)
 {
     UVC_CHECK(stream_hdl, ESP_ERR_INVALID_ARG);
@@ -719,6 +1251,7 @@ esp_err_t uvc_host_stream_stop(uvc_host_stream_hdl_t stream_hdl)
 
     //@todo this is not a clean solution
     vTaskDelay(pdMS_TO_TICKS(50)); // Wait for all transfers to finish
+    uvc_still_stop(uvc_stream);
 
     if (uvc_stream->constant.bAlternateSetting != 0) { // if (is_isoc_stream)
         // ISOC streams are stopped by setting alternate interface 0
@@ -729,6 +1262,63 @@ esp_err_t uvc_host_stream_stop(uvc_host_stream_hdl_t stream_hdl)
     }
 }
 
+esp_err_t uvc_host_stream_format_select(uvc_host_stream_hdl_t stream_hdl, const uvc_host_stream_format_t *vs_format)
+{
+    UVC_CHECK(stream_hdl && vs_format, ESP_ERR_INVALID_ARG);
+    uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
+
+    // Check the format in descriptor index first, so the stream is not interrupted for unsupported format
+    ESP_RETURN_ON_ERROR(
+        uvc_desc_index_get_frame_format_by_format(uvc_stream->constant.vs_intf, vs_format, NULL, NULL),
+        TAG, "Requested format is not offered by the device");
+
+    const bool was_streaming = UVC_ATOMIC_LOAD(uvc_stream->dynamic.streaming);
+    if (was_streaming) {
+        ESP_RETURN_ON_ERROR(uvc_host_stream_stop(stream_hdl), TAG, "Could not stop the stream");
+    }
+
+    uvc_vs_ctrl_t vs_result;
+    ESP_RETURN_ON_ERROR(
+        uvc_host_stream_control_negotiate(uvc_stream, vs_format, &vs_result),
+        TAG, "Failed to negotiate requested Video Stream format");
+
+    // Frame buffers are kept if they can hold the new frames. Zero-copy frames and slices do not depend on frame size
+    const bool frames_too_small = uvc_stream->constant.frame_size_auto && !uvc_stream->constant.zero_copy && !uvc_stream->constant.slice_cb &&
+                                  uvc_stream->constant.frames[0]->data_buffer_len < vs_result.dwMaxVideoFrameSize;
+    if (frames_too_small) {
+        UVC_CHECK(uvc_frame_are_all_returned(uvc_stream), ESP_ERR_INVALID_STATE);
+        const int nb_of_fb = uvc_stream->constant.num_of_frames;
+        const size_t old_size = uvc_stream->constant.frames[0]->data_buffer_len;
+        uvc_frame_free(uvc_stream);
+        if (uvc_frame_allocate(uvc_stream, nb_of_fb, vs_result.dwMaxVideoFrameSize, uvc_stream->constant.frame_heap_caps) != ESP_OK) {
+            // Keep the previous format, it is committed again at next stream start
+            ESP_RETURN_ON_ERROR(
+                uvc_frame_allocate(uvc_stream, nb_of_fb, old_size, uvc_stream->constant.frame_heap_caps),
+                TAG, "Could not re-allocate frame buffers");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    // Adaptive frame buffers follow sizes of the new frames, only the limit changes
+    if (uvc_stream->constant.adaptive.enabled) {
+        uvc_frame_adaptive_set_max_size(uvc_stream, MAX(uvc_stream->constant.adaptive.frame_size, vs_result.dwMaxVideoFrameSize));
+    }
+
+    // ISOC: Payload size of the new format might be satisfied by a different alternate interface
+    if (uvc_stream->constant.bAlternateSetting != 0) {
+        ESP_RETURN_ON_ERROR(
+            uvc_interface_reselect(uvc_stream, vs_result.dwMaxPayloadTransferSize),
+            TAG, "Could not select interface for new format");
+    }
+
+    uvc_stream->constant.vs_format = *vs_format;
+    uvc_stream->constant.dwMaxPayloadTransferSize = vs_result.dwMaxPayloadTransferSize;
+    if (was_streaming) {
+        return uvc_stream_start_committed(uvc_stream, &vs_result);
+    }
+    return ESP_OK;
+}
+
 esp_err_t uvc_host_stream_pause(uvc_host_stream_hdl_t stream_hdl)
 {
     UVC_CHECK(stream_hdl, ESP_ERR_INVALID_ARG);
@@ -736,12 +1326,12 @@ esp_err_t uvc_host_stream_pause(uvc_host_stream_hdl_t stream_hdl)
 
     // We do not cancel the ongoing transfers here, it is not supported by USB Host Library
     // By setting uvc_stream->dynamic.streaming = false; no frame callbacks will be called and the transfer can gracefully finish
-    UVC_ENTER_CRITICAL();
-    UVC_CHECK_FROM_CRIT(uvc_stream->dynamic.streaming, ESP_OK); // Return immediately if already paused
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    UVC_CHECK_FROM_STREAM_CRIT(uvc_stream, uvc_stream->dynamic.streaming, ESP_OK); // Return immediately if already paused
     uvc_stream->dynamic.streaming = false;
     uvc_host_frame_t *current_frame = uvc_stream->dynamic.current_frame;
     uvc_stream->dynamic.current_frame = NULL;
-    UVC_EXIT_CRITICAL();
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
 
     if (current_frame) {
         uvc_host_frame_return(uvc_stream, current_frame);
@@ -755,19 +1345,37 @@ esp_err_t uvc_host_stream_unpause(uvc_host_stream_hdl_t stream_hdl)
     UVC_CHECK(stream_hdl, ESP_ERR_INVALID_ARG);
     uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
     esp_err_t ret = ESP_OK;
+    UVC_CHECK(!UVC_ATOMIC_LOAD(uvc_stream->dynamic.streaming), ESP_ERR_INVALID_STATE);
 
-    UVC_ENTER_CRITICAL();
-    UVC_CHECK_FROM_CRIT(!uvc_stream->dynamic.streaming, ESP_ERR_INVALID_STATE);
+    // URBs are not cancelled by pause. Wait until all of them completed and were dropped by the processing task, so none is submitted twice
+    if (uvc_stream->constant.processing) {
+        ESP_RETURN_ON_ERROR(uvc_processing_wait_idle(uvc_stream), TAG, "Transfers of previous streaming did not finish");
+    }
+
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    UVC_CHECK_FROM_STREAM_CRIT(uvc_stream, !uvc_stream->dynamic.streaming, ESP_ERR_INVALID_STATE);
     uvc_stream->dynamic.streaming = true;
+    uvc_stream->dynamic.discarding = false;
     // Start of Frame is detected when received FrameID != current_frame_id
     // We set current_frame_id to illegal value (FrameID can be 0 or 1) so we catch SoF of the very first frame
     uvc_stream->single_thread.current_frame_id = 2;
-    uvc_stream->single_thread.next_bulk_packet = UVC_STREAM_BULK_PACKET_SOF;
-    UVC_EXIT_CRITICAL();
+    uvc_stream->single_thread.next_bulk_packet = UVC_STREAM_BULK_PACKET_HEADER;
+    uvc_stream->single_thread.payload_eof = false;
+    uvc_stream->single_thread.still_payload = false;
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+    uvc_still_reset(uvc_stream);
+
+    if (uvc_stream->constant.processing) {
+        ESP_GOTO_ON_ERROR(uvc_processing_start(uvc_stream), stop_stream, TAG, "Could not submit transfers");
+        return ret;
+    }
 
     for (int i = 0; i < uvc_stream->constant.num_of_xfers; i++) {
+        if (!uvc_frame_urb_is_free(uvc_stream, i)) {
+            continue; // Zero-copy: This URB is still held by a frame. It will be submitted once the frame is returned
+        }
         ESP_GOTO_ON_ERROR(
-            usb_host_transfer_submit(uvc_stream->constant.xfers[i]),
+            UVC_TRANSFER_SUBMIT(uvc_stream->constant.xfers[i]),
             stop_stream, TAG, "Could not submit transfer %d", i);
     }
     return ret;
@@ -777,8 +1385,101 @@ stop_stream:
     return ret;
 }
 
+esp_err_t uvc_host_stream_fast_pause(uvc_host_stream_hdl_t stream_hdl)
+{
+    UVC_CHECK(stream_hdl, ESP_ERR_INVALID_ARG);
+    uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
+    UVC_CHECK(uvc_stream->constant.bAlternateSetting != 0, ESP_ERR_NOT_SUPPORTED); // BULK payloads span transfers, they cannot be dropped blindly
+
+    // The transfer callback returns the frame being received, it is the only writer of the frame
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    UVC_CHECK_FROM_STREAM_CRIT(uvc_stream, uvc_stream->dynamic.streaming, ESP_ERR_INVALID_STATE);
+    uvc_stream->dynamic.discarding = true;
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+    return ESP_OK;
+}
+
+esp_err_t uvc_host_stream_fast_unpause(uvc_host_stream_hdl_t stream_hdl)
+{
+    UVC_CHECK(stream_hdl, ESP_ERR_INVALID_ARG);
+    uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
+
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    UVC_CHECK_FROM_STREAM_CRIT(uvc_stream, uvc_stream->dynamic.streaming, ESP_ERR_INVALID_STATE);
+    uvc_stream->dynamic.discarding = false;
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+    return ESP_OK;
+}
+
+#if USB_HOST_SHARED_CLIENT_ENABLED
+/**
+ * @brief Stop all streaming streams before bus suspend
+ *
+ * Devices stay open and their formats committed. A stream is marked before it is stopped,
+ * so a stream that failed to stop is started again by uvc_pm_resume().
+ */
+static esp_err_t uvc_pm_suspend(void *arg)
+{
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(p_uvc_host_driver->open_close_mutex, portMAX_DELAY);
+    uvc_stream_t *uvc_stream;
+    SLIST_FOREACH(uvc_stream, &p_uvc_host_driver->uvc_stream_list, list_entry) {
+        if (!UVC_ATOMIC_LOAD(uvc_stream->dynamic.streaming)) {
+            continue;
+        }
+        uvc_stream->constant.suspended = true;
+        ESP_GOTO_ON_ERROR(
+            uvc_host_stream_stop(uvc_stream),
+            unlock, TAG, "Could not stop stream of interface %d", uvc_stream->constant.bInterfaceNumber);
+    }
+unlock:
+    xSemaphoreGive(p_uvc_host_driver->open_close_mutex);
+    return ret;
+}
+
+/**
+ * @brief Start streams stopped by uvc_pm_suspend()
+ *
+ * The device keeps its configuration during suspend: the last negotiation result is committed again without probing.
+ * Only if the device rejects it, the format is negotiated again.
+ */
+static esp_err_t uvc_pm_resume(void *arg)
+{
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(p_uvc_host_driver->open_close_mutex, portMAX_DELAY);
+    uvc_stream_t *uvc_stream;
+    SLIST_FOREACH(uvc_stream, &p_uvc_host_driver->uvc_stream_list, list_entry) {
+        if (!uvc_stream->constant.suspended) {
+            continue;
+        }
+        uvc_stream->constant.suspended = false;
+        if (UVC_ATOMIC_LOAD(uvc_stream->dynamic.streaming)) {
+            continue; // Started by the user meanwhile
+        }
+
+        uvc_vs_ctrl_t vs_result = uvc_stream->constant.vs_committed;
+        esp_err_t err = uvc_host_stream_control_recommit(uvc_stream, &uvc_stream->constant.vs_format, &vs_result);
+        if (err != ESP_OK) {
+            err = uvc_host_stream_control_negotiate(uvc_stream, &uvc_stream->constant.vs_format, &vs_result);
+        }
+        if (err == ESP_OK) {
+            err = uvc_stream_start_committed(uvc_stream, &vs_result);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Could not resume stream of interface %d", uvc_stream->constant.bInterfaceNumber);
+            if (ret == ESP_OK) {
+                ret = err;
+            }
+        }
+    }
+    xSemaphoreGive(p_uvc_host_driver->open_close_mutex);
+    return ret;
+}
+#endif // USB_HOST_SHARED_CLIENT_ENABLED
+
 static void ctrl_xfer_cb(usb_transfer_t *transfer)
 {
+    UVC_TRACE_COMPLETE(transfer);
     ESP_LOGD(TAG, "ctrl xfer cb");
     assert(transfer->context);
     xSemaphoreGive((SemaphoreHandle_t)transfer->context);
@@ -788,19 +1489,20 @@ esp_err_t uvc_host_usb_ctrl(uvc_host_stream_hdl_t stream_hdl, uint8_t bmRequestT
 {
     UVC_CHECK(stream_hdl, ESP_ERR_INVALID_ARG);
     uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
+    uvc_device_t *device = uvc_stream->constant.device;
     if (wLength > 0) {
         UVC_CHECK(data, ESP_ERR_INVALID_ARG);
     }
-    UVC_CHECK(p_uvc_host_driver->ctrl_transfer->data_buffer_size >= wLength, ESP_ERR_INVALID_SIZE);
+    UVC_CHECK(device->ctrl_transfer->data_buffer_size >= wLength, ESP_ERR_INVALID_SIZE);
 
     esp_err_t ret;
 
     // Take Mutex and fill the CTRL request
-    BaseType_t taken = xSemaphoreTake(p_uvc_host_driver->ctrl_mutex, pdMS_TO_TICKS(5000));
+    BaseType_t taken = xSemaphoreTake(device->ctrl_mutex, pdMS_TO_TICKS(5000));
     if (!taken) {
         return ESP_ERR_TIMEOUT;
     }
-    usb_setup_packet_t *req = (usb_setup_packet_t *)(p_uvc_host_driver->ctrl_transfer->data_buffer);
+    usb_setup_packet_t *req = (usb_setup_packet_t *)(device->ctrl_transfer->data_buffer);
     uint8_t *start_of_data = (uint8_t *)req + sizeof(usb_setup_packet_t);
     req->bmRequestType = bmRequestType;
     req->bRequest = bRequest;
@@ -808,9 +1510,7 @@ esp_err_t uvc_host_usb_ctrl(uvc_host_stream_hdl_t stream_hdl, uint8_t bmRequestT
     req->wIndex = wIndex;
     req->wLength = wLength;
 
-    // Bind the transfer and the device
-    p_uvc_host_driver->ctrl_transfer->device_handle = uvc_stream->constant.dev_hdl;
-    p_uvc_host_driver->ctrl_transfer->num_bytes = wLength + sizeof(usb_setup_packet_t);
+    device->ctrl_transfer->num_bytes = wLength + sizeof(usb_setup_packet_t);
 
     // For IN transfers we must transfer data ownership to the driver
     const bool in_transfer = bmRequestType & USB_BM_REQUEST_TYPE_DIR_IN;
@@ -819,13 +1519,13 @@ esp_err_t uvc_host_usb_ctrl(uvc_host_stream_hdl_t stream_hdl, uint8_t bmRequestT
     }
 
     ESP_GOTO_ON_ERROR(
-        usb_host_transfer_submit_control(p_uvc_host_driver->usb_client_hdl, p_uvc_host_driver->ctrl_transfer),
+        UVC_TRANSFER_SUBMIT_CONTROL(p_uvc_host_driver->usb_client_hdl, device->ctrl_transfer),
         unblock, TAG, "CTRL transfer failed");
 
-    taken = xSemaphoreTake((SemaphoreHandle_t)p_uvc_host_driver->ctrl_transfer->context, pdMS_TO_TICKS(5000)); // This is a fixed timeout. Every device should be able to respond to CTRL transfer in 5 seconds
+    taken = xSemaphoreTake((SemaphoreHandle_t)device->ctrl_transfer->context, pdMS_TO_TICKS(5000)); // This is a fixed timeout. Every device should be able to respond to CTRL transfer in 5 seconds
     ESP_GOTO_ON_FALSE(taken, ESP_ERR_TIMEOUT, unblock, TAG, "CTRL timeout");
-    ESP_GOTO_ON_FALSE(p_uvc_host_driver->ctrl_transfer->status == USB_TRANSFER_STATUS_COMPLETED, ESP_ERR_INVALID_RESPONSE, unblock, TAG, "Control transfer error");
-    ESP_GOTO_ON_FALSE(p_uvc_host_driver->ctrl_transfer->actual_num_bytes == p_uvc_host_driver->ctrl_transfer->num_bytes, ESP_ERR_INVALID_RESPONSE, unblock, TAG, "Incorrect number of bytes transferred");
+    ESP_GOTO_ON_FALSE(device->ctrl_transfer->status == USB_TRANSFER_STATUS_COMPLETED, ESP_ERR_INVALID_RESPONSE, unblock, TAG, "Control transfer error");
+    ESP_GOTO_ON_FALSE(device->ctrl_transfer->actual_num_bytes == device->ctrl_transfer->num_bytes, ESP_ERR_INVALID_RESPONSE, unblock, TAG, "Incorrect number of bytes transferred");
 
     // For OUT transfers, we must transfer data ownership to user
     if (in_transfer) {
@@ -834,6 +1534,143 @@ esp_err_t uvc_host_usb_ctrl(uvc_host_stream_hdl_t stream_hdl, uint8_t bmRequestT
     ret = ESP_OK;
 
 unblock:
-    xSemaphoreGive(p_uvc_host_driver->ctrl_mutex);
+    xSemaphoreGive(device->ctrl_mutex);
     return ret;
 }
+
+/**
+ * @brief Batch of asynchronous Video Control requests
+ *
+ * The batch owns one CTRL transfer, which is re-submitted from its callback for each request
+ */
+typedef struct {
+    uvc_stream_t *uvc_stream;         // Stream the requests belong to
+    usb_transfer_t *xfer;             // CTRL transfer of this batch
+    uvc_host_ctrl_req_t *reqs;        // User's requests
+    size_t num_reqs;                  // Number of requests
+    size_t current;                   // Index of request in flight
+    uvc_host_ctrl_callback_t ctrl_cb; // User's completion callback
+    void *user_arg;                   // User's argument
+} uvc_ctrl_batch_t;
+
+/**
+ * @brief Submit current request of the batch
+ *
+ * @param[in] batch Batch of requests
+ * @return
+ *     - ESP_OK: Request submitted
+ *     - Else: USB lib error
+ */
+static esp_err_t uvc_ctrl_batch_submit(uvc_ctrl_batch_t *batch)
+{
+    const uvc_host_ctrl_req_t *ctrl_req = &batch->reqs[batch->current];
+    usb_setup_packet_t *req = (usb_setup_packet_t *)batch->xfer->data_buffer;
+    const bool set = !(ctrl_req->bRequest & USB_BM_REQUEST_TYPE_DIR_IN); // Request codes of GET requests have the highest bit set
+    req->bmRequestType = USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIP_INTERFACE;
+    req->bmRequestType |= set ? USB_BM_REQUEST_TYPE_DIR_OUT : USB_BM_REQUEST_TYPE_DIR_IN;
+    req->bRequest = ctrl_req->bRequest;
+    req->wValue = ctrl_req->bSelector << 8;
+    req->wIndex = (ctrl_req->bUnitID << 8) | batch->uvc_stream->constant.vs_intf->bControlInterface;
+    req->wLength = ctrl_req->wLength;
+    if (set) {
+        memcpy((uint8_t *)req + sizeof(usb_setup_packet_t), ctrl_req->data, ctrl_req->wLength);
+    }
+    batch->xfer->num_bytes = ctrl_req->wLength + sizeof(usb_setup_packet_t);
+    return UVC_TRANSFER_SUBMIT_CONTROL(p_uvc_host_driver->usb_client_hdl, batch->xfer);
+}
+
+/**
+ * @brief Free the batch and decrement number of batches in flight
+ *
+ * @param[in] batch Batch of requests
+ */
+static void uvc_ctrl_batch_free(uvc_ctrl_batch_t *batch)
+{
+    uvc_stream_t *uvc_stream = batch->uvc_stream;
+    UVC_TRANSFER_FREE(batch->xfer);
+    UVC_FREE(CONTROL, batch, sizeof(uvc_ctrl_batch_t));
+    UVC_ATOMIC_FETCH_SUB(uvc_stream->constant.ctrl_pending, 1);
+}
+
+/**
+ * @brief CTRL transfer callback of asynchronous Video Control requests
+ *
+ * Status of finished request is stored and next request of the batch is submitted.
+ * After the last request, user's completion callback is called and the batch is freed.
+ *
+ * @param[in] transfer Completed CTRL transfer
+ */
+static void uvc_ctrl_batch_xfer_cb(usb_transfer_t *transfer)
+{
+    UVC_TRACE_COMPLETE(transfer);
+    uvc_ctrl_batch_t *batch = (uvc_ctrl_batch_t *)transfer->context;
+    uvc_host_ctrl_req_t *ctrl_req = &batch->reqs[batch->current];
+    if (transfer->status != USB_TRANSFER_STATUS_COMPLETED || transfer->actual_num_bytes != transfer->num_bytes) {
+        ctrl_req->status = ESP_ERR_INVALID_RESPONSE;
+    } else {
+        if (ctrl_req->bRequest & USB_BM_REQUEST_TYPE_DIR_IN) {
+            memcpy(ctrl_req->data, transfer->data_buffer + sizeof(usb_setup_packet_t), ctrl_req->wLength);
+        }
+        ctrl_req->status = ESP_OK;
+    }
+
+    // Submit following requests back to back. Requests that cannot be submitted fail with the submission error
+    while (++batch->current < batch->num_reqs) {
+        const esp_err_t ret = uvc_ctrl_batch_submit(batch);
+        if (ret == ESP_OK) {
+            return;
+        }
+        batch->reqs[batch->current].status = ret;
+    }
+
+    batch->ctrl_cb(batch->reqs, batch->num_reqs, batch->user_arg);
+    uvc_ctrl_batch_free(batch);
+}
+
+esp_err_t uvc_host_ctrl_submit(uvc_host_stream_hdl_t stream_hdl, uvc_host_ctrl_req_t *reqs, size_t num_reqs, uvc_host_ctrl_callback_t ctrl_cb, void *user_arg)
+{
+    UVC_CHECK(stream_hdl && reqs && num_reqs > 0 && ctrl_cb, ESP_ERR_INVALID_ARG);
+    uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
+    uint16_t max_length = 0;
+    for (size_t i = 0; i < num_reqs; i++) {
+        UVC_CHECK(reqs[i].wLength == 0 || reqs[i].data, ESP_ERR_INVALID_ARG);
+        max_length = MAX(max_length, reqs[i].wLength);
+    }
+
+    // Each batch has its own CTRL transfer, so batches of different tasks do not wait for each other
+    esp_err_t ret;
+    uvc_ctrl_batch_t *batch = UVC_CALLOC(CONTROL, 1, sizeof(uvc_ctrl_batch_t));
+    UVC_CHECK(batch, ESP_ERR_NO_MEM);
+    ESP_GOTO_ON_ERROR(
+        UVC_TRANSFER_ALLOC(sizeof(usb_setup_packet_t) + max_length, 0, &batch->xfer),
+        err, TAG, "Could not allocate CTRL transfer");
+    batch->uvc_stream = uvc_stream;
+    batch->reqs = reqs;
+    batch->num_reqs = num_reqs;
+    batch->ctrl_cb = ctrl_cb;
+    batch->user_arg = user_arg;
+    batch->xfer->device_handle = uvc_stream->constant.dev_hdl;
+    batch->xfer->bEndpointAddress = 0;
+    batch->xfer->timeout_ms = 5000;
+    batch->xfer->callback = uvc_ctrl_batch_xfer_cb;
+    batch->xfer->context = batch;
+
+    UVC_ATOMIC_FETCH_ADD(uvc_stream->constant.ctrl_pending, 1);
+    ret = uvc_ctrl_batch_submit(batch);
+    if (ret != ESP_OK) {
+        uvc_ctrl_batch_free(batch);
+        return ret;
+    }
+    return ESP_OK;
+
+err:
+    UVC_FREE(CONTROL, batch, sizeof(uvc_ctrl_batch_t));
+    return ret;
+}
+
+esp_err_t uvc_host_get_frame_list(uvc_host_stream_hdl_t stream_hdl, uvc_host_frame_info_t *list, size_t *list_size)
+{
+    UVC_CHECK(stream_hdl && list_size, ESP_ERR_INVALID_ARG);
+    uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
+    return uvc_desc_index_get_frame_list(uvc_stream->constant.vs_intf, list, list_size);
+}
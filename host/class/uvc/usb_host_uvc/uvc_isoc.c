@@ -13,10 +13,130 @@
 #include "uvc_types_priv.h"
 #include "uvc_check_priv.h"
 #include "uvc_frame_priv.h"
+#include "uvc_stats_priv.h"
+#include "uvc_frame_filter_priv.h"
+#include "uvc_payload_priv.h"
+#include "uvc_still_priv.h"
 #include "uvc_critical_priv.h"
+#include "uvc_processing_priv.h"
+#include "uvc_transfer_priv.h"
+#include "uvc_attr_priv.h"
 
 static const char *TAG = "uvc-isoc";
 
+// Payload header bits that end the fast path: Frame ID, End of Frame, Still Image and Error
+#define ISOC_BURST_HEADER_MASK (0x01 | 0x02 | 0x20 | 0x40)
+
+/**
+ * @brief Handle frame buffer overflow: Skip current frame and inform the user
+ *
+ * @param[in] uvc_stream Pointer to UVC stream
+ */
+static void UVC_DATA_PATH_ATTR isoc_frame_overflow(uvc_stream_t *uvc_stream)
+{
+    uvc_stats_skip_frame(uvc_stream, UVC_STATS_DROP_BUFFER_OVERFLOW);
+
+    uvc_host_stream_callback_t stream_cb = uvc_stream->constant.stream_cb;
+    if (stream_cb) {
+        const uvc_host_stream_event_data_t event = {
+            .type = UVC_HOST_FRAME_BUFFER_OVERFLOW,
+        };
+        stream_cb(&event, uvc_stream->constant.cb_arg);
+    }
+}
+
+/**
+ * @brief Add a run of data packets that continue the current frame
+ *
+ * At steady state nearly all packets of a URB are data of the frame being received. Such packets are validated
+ * by one compare of their header and added without the per-packet status and frame boundary processing.
+ * Zero Length Packets are skipped. The run ends before the first packet that needs the full processing:
+ * USB error, Frame ID toggle, End of Frame, Still Image or Error bit.
+ *
+ * @param[in]    uvc_stream    Pointer to UVC stream
+ * @param[in]    transfer      Completed transfer
+ * @param[in]    first_packet  Index of the first packet of the run
+ * @param[inout] payload       In: Payload of first_packet. Out: Payload of the first packet behind the run
+ * @param[inout] payload_bytes Statistics: Payload bytes received in this transfer
+ * @return Number of processed packets
+ */
+static int UVC_DATA_PATH_ATTR isoc_transfer_burst(uvc_stream_t *uvc_stream, usb_transfer_t *transfer, int first_packet, const uint8_t **payload, size_t *payload_bytes)
+{
+    if (uvc_stream->single_thread.skip_current_frame || uvc_stream->single_thread.keyframe_pending) {
+        return 0; // Corrupted frame or keyframe detection: Slow path only
+    }
+
+    // Only Frame ID of the current frame may be set. Invalid Frame ID 2 never matches
+    const uint8_t header_info = uvc_stream->single_thread.current_frame_id;
+    const uvc_payload_header_t *last_header = NULL;
+    int i = first_packet;
+    for (; i < transfer->num_isoc_packets; i++) {
+        const usb_isoc_packet_desc_t *isoc_desc = &transfer->isoc_packet_desc[i];
+        if (isoc_desc->status != USB_TRANSFER_STATUS_COMPLETED) {
+            break;
+        }
+        if (isoc_desc->actual_num_bytes == 0) {
+            *payload += isoc_desc->num_bytes; // Zero Length Packet, e.g. after End of Frame
+            continue;
+        }
+        const uvc_payload_header_t *payload_header = (const uvc_payload_header_t *)(*payload);
+        uvc_host_frame_t *current_frame = UVC_ATOMIC_LOAD(uvc_stream->dynamic.current_frame);
+        if (!current_frame || (payload_header->bmHeaderInfo.val & ISOC_BURST_HEADER_MASK) != header_info) {
+            break;
+        }
+        if (!last_header) {
+            uvc_payload_header_get_timestamps(payload_header, &uvc_stream->single_thread.timestamp); // PTS is the same in all payloads
+        }
+        last_header = payload_header;
+
+        const size_t payload_data_len = isoc_desc->actual_num_bytes - payload_header->bHeaderLength;
+        *payload_bytes += payload_data_len;
+        const esp_err_t ret = uvc_frame_add_urb_data(uvc_stream, current_frame, transfer, *payload + payload_header->bHeaderLength, payload_data_len);
+        *payload += isoc_desc->num_bytes;
+        if (ret != ESP_OK) {
+            isoc_frame_overflow(uvc_stream);
+            i++;
+            break;
+        }
+    }
+    if (last_header) {
+        uvc_payload_header_get_timestamps(last_header, &uvc_stream->single_thread.timestamp); // The last received SCR is kept
+    }
+    return i - first_packet;
+}
+
+/**
+ * @brief Drop received data of fast paused stream
+ *
+ * Frame ID is followed, so the frame in progress at unpause is skipped up to its End of Frame
+ * and the first delivered frame is complete.
+ *
+ * @param[in] uvc_stream Pointer to UVC stream
+ * @param[in] transfer   Completed transfer
+ */
+static void UVC_DATA_PATH_ATTR isoc_transfer_discard(uvc_stream_t *uvc_stream, const usb_transfer_t *transfer)
+{
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    uvc_host_frame_t *current_frame = uvc_stream->dynamic.current_frame;
+    uvc_stream->dynamic.current_frame = NULL;
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+    if (current_frame) {
+        uvc_host_frame_return(uvc_stream, current_frame);
+    }
+    uvc_stream->single_thread.skip_current_frame = true;
+
+    const uint8_t *payload = transfer->data_buffer;
+    for (int i = 0; i < transfer->num_isoc_packets; i++) {
+        const usb_isoc_packet_desc_t *isoc_desc = &transfer->isoc_packet_desc[i];
+        const uvc_payload_header_t *payload_header = (const uvc_payload_header_t *)payload;
+        if (isoc_desc->status == USB_TRANSFER_STATUS_COMPLETED && isoc_desc->actual_num_bytes != 0 &&
+                !uvc_still_is_still_payload(uvc_stream, payload_header)) {
+            uvc_stream->single_thread.current_frame_id = payload_header->bmHeaderInfo.frame_id;
+        }
+        payload += isoc_desc->num_bytes;
+    }
+}
+
 /**
  * @brief Callback function for handling Isochronous USB transfers from a UVC camera.
  *
@@ -30,6 +150,8 @@ static const char *TAG = "uvc-isoc";
  *   - **No ACK**: Packets can be missed.
  *   - **Packet Header**: Each packet includes a header used to detect errors, missed packets, and other issues.
  *
+ * Runs of packets that continue the current frame are added by a fast path, see isoc_transfer_burst().
+ *
  * The callback performs the following tasks:
  * 1. Checks the status of each isochronous packet and handles various USB transfer statuses (e.g., completed,
  *    error, device disconnected).
@@ -39,9 +161,12 @@ static const char *TAG = "uvc-isoc";
  *
  * @param[in] transfer Pointer to the completed USB transfer structure.
  */
-void isoc_transfer_callback(usb_transfer_t *transfer)
+void UVC_DATA_PATH_ATTR isoc_transfer_callback(usb_transfer_t *transfer)
 {
     ESP_LOGD(TAG, "%s", __FUNCTION__);
+    if (transfer->callback != uvc_processing_transfer_cb) {
+        UVC_TRACE_COMPLETE(transfer); // Else recorded on completion, before the processing task
+    }
     uvc_stream_t *uvc_stream = (uvc_stream_t *)transfer->context;
 
     // USB_TRANSFER_STATUS_NO_DEVICE is set in transfer->status.
@@ -54,8 +179,21 @@ void isoc_transfer_callback(usb_transfer_t *transfer)
         return; // If the streaming was turned off, we don't have to do anything
     }
 
+    uvc_frame_urb_acquire(uvc_stream, transfer);
+    if (UVC_ATOMIC_LOAD(uvc_stream->dynamic.discarding)) {
+        isoc_transfer_discard(uvc_stream, transfer);
+        uvc_frame_urb_done(uvc_stream, transfer); // Keep the transfer running
+        return;
+    }
     const uint8_t *payload = transfer->data_buffer;
+    size_t payload_bytes = 0;     // Statistics: Payload bytes received in this transfer
+    unsigned skipped_packets = 0; // Statistics: Packets skipped by USB Host Library
     for (int i = 0; i < transfer->num_isoc_packets; i++) {
+        // Fast path: Data packets of the current frame. The packets that follow are processed below
+        i += isoc_transfer_burst(uvc_stream, transfer, i, &payload, &payload_bytes);
+        if (i == transfer->num_isoc_packets) {
+            break;
+        }
         usb_isoc_packet_desc_t *isoc_desc = &transfer->isoc_packet_desc[i];
 
         // Check USB status
@@ -65,16 +203,19 @@ void isoc_transfer_callback(usb_transfer_t *transfer)
         case USB_TRANSFER_STATUS_NO_DEVICE:
         case USB_TRANSFER_STATUS_CANCELED:
             ESP_ERROR_CHECK(uvc_host_stream_pause(uvc_stream)); // This should never fail
-            return; // No need to process the rest
+            goto transfer_done; // No need to process the rest
         case USB_TRANSFER_STATUS_ERROR:
         case USB_TRANSFER_STATUS_OVERFLOW:
         case USB_TRANSFER_STATUS_STALL:
             ESP_LOGW(TAG, "usb err %d", isoc_desc->status);
-            uvc_stream->single_thread.skip_current_frame = true;
+            if (!uvc_frame_add_error(uvc_stream, UVC_ATOMIC_LOAD(uvc_stream->dynamic.current_frame), UVC_HOST_FRAME_ERROR_USB, 0, isoc_desc->num_bytes)) {
+                uvc_stats_skip_frame(uvc_stream, UVC_STATS_DROP_USB_ERROR);
+            }
             goto next_isoc_packet; // Data corrupted
 
         case USB_TRANSFER_STATUS_TIMED_OUT:
         case USB_TRANSFER_STATUS_SKIPPED:
+            skipped_packets++;
             goto next_isoc_packet; // Skipped and timed out ISOC transfers are not an issue
         default:
             assert(false);
@@ -85,23 +226,40 @@ void isoc_transfer_callback(usb_transfer_t *transfer)
             goto next_isoc_packet;
         }
 
-        // Check for start of new frame
+        // Method 2 still images are interleaved with video frames, they are received into still image buffers
         const uvc_payload_header_t *payload_header = (const uvc_payload_header_t *)payload;
+        if (uvc_still_is_still_payload(uvc_stream, payload_header)) {
+            uvc_still_header_process(uvc_stream, payload_header);
+            uvc_still_data_process(uvc_stream, payload + payload_header->bHeaderLength, isoc_desc->actual_num_bytes - payload_header->bHeaderLength);
+            uvc_still_payload_end(uvc_stream);
+            payload_bytes += isoc_desc->actual_num_bytes - payload_header->bHeaderLength;
+            goto next_isoc_packet;
+        }
+
+        // Check for start of new frame
         const bool start_of_frame = (uvc_stream->single_thread.current_frame_id != payload_header->bmHeaderInfo.frame_id);
         if (start_of_frame) {
             // We detected start of new frame. Update Frame ID and start fetching this frame
+            const bool last_frame_skipped = uvc_stream->single_thread.skip_current_frame;
             uvc_stream->single_thread.current_frame_id   = payload_header->bmHeaderInfo.frame_id;
-            uvc_stream->single_thread.skip_current_frame = payload_header->bmHeaderInfo.error;
+            uvc_stream->single_thread.skip_current_frame = false; // Error flag is checked below
+            uvc_stats_sof(uvc_stream);
+            const bool discard_frame = uvc_frame_filter_sof(uvc_stream);
 
             // Get free frame buffer for this new frame
-            UVC_ENTER_CRITICAL();
+            UVC_STREAM_ENTER_CRITICAL(uvc_stream);
             const bool need_new_frame = (uvc_stream->dynamic.streaming && !uvc_stream->dynamic.current_frame);
-            if (need_new_frame) {
-                UVC_EXIT_CRITICAL();
+            if (need_new_frame && discard_frame) {
+                // Filtered frame is discarded without taking a frame buffer
+                UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+                uvc_stream->single_thread.skip_current_frame = true;
+            } else if (need_new_frame) {
+                UVC_STREAM_EXIT_CRITICAL(uvc_stream);
                 uvc_stream->dynamic.current_frame = uvc_frame_get_empty(uvc_stream);
                 if (uvc_stream->dynamic.current_frame == NULL) {
                     // There is no free frame buffer now, skipping this frame
                     uvc_stream->single_thread.skip_current_frame = true;
+                    uvc_stats_frame_dropped(uvc_stream, UVC_STATS_DROP_BUFFER_UNDERFLOW);
 
                     // Inform the user about the underflow
                     uvc_host_stream_callback_t stream_cb = uvc_stream->constant.stream_cb;
@@ -115,35 +273,39 @@ void isoc_transfer_callback(usb_transfer_t *transfer)
                 }
             } else {
                 // We received SoF but current_frame is not NULL: We missed EoF - reset the frame buffer
-                uvc_frame_reset(uvc_stream->dynamic.current_frame);
-                UVC_EXIT_CRITICAL();
+                uvc_host_frame_t *current_frame = uvc_stream->dynamic.current_frame;
+                UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+                if (!last_frame_skipped) {
+                    uvc_stats_frame_dropped(uvc_stream, UVC_STATS_DROP_MISSING_EOF);
+                }
+                uvc_frame_reset(uvc_stream, current_frame);
+                uvc_stream->single_thread.skip_current_frame = discard_frame;
             }
         }
 
-        // Check for error flag
-        if (payload_header->bmHeaderInfo.error) {
-            uvc_stream->single_thread.skip_current_frame = true;
+        // Check for error flag. Corrupt frame delivery keeps the data, they are marked as damaged
+        if (payload_header->bmHeaderInfo.error &&
+                !uvc_frame_add_error(uvc_stream, UVC_ATOMIC_LOAD(uvc_stream->dynamic.current_frame), UVC_HOST_FRAME_ERROR_HEADER,
+                                     isoc_desc->actual_num_bytes - payload_header->bHeaderLength, 0)) {
+            uvc_stats_skip_frame(uvc_stream, UVC_STATS_DROP_HEADER_ERROR);
         }
+        uvc_payload_header_get_timestamps(payload_header, &uvc_stream->single_thread.timestamp);
 
         // Add received data to frame buffer
+        payload_bytes += isoc_desc->actual_num_bytes - payload_header->bHeaderLength;
         if (!uvc_stream->single_thread.skip_current_frame) {
             const uint8_t *payload_data = payload + payload_header->bHeaderLength;
             const size_t payload_data_len = isoc_desc->actual_num_bytes - payload_header->bHeaderLength;
             uvc_host_frame_t *current_frame = UVC_ATOMIC_LOAD(uvc_stream->dynamic.current_frame);
 
-            esp_err_t ret = uvc_frame_add_data(current_frame, payload_data, payload_data_len);
+            esp_err_t ret = ESP_OK;
+            if (uvc_frame_filter_data(uvc_stream, payload_data, payload_data_len)) {
+                uvc_stream->single_thread.skip_current_frame = true; // Not a keyframe. End of Frame must still be processed
+            } else {
+                ret = uvc_frame_add_urb_data(uvc_stream, current_frame, transfer, payload_data, payload_data_len);
+            }
             if (ret != ESP_OK) {
-                // Frame buffer overflow, skip this frame
-                uvc_stream->single_thread.skip_current_frame = true;
-
-                // Inform the user about the overflow
-                uvc_host_stream_callback_t stream_cb = uvc_stream->constant.stream_cb;
-                if (stream_cb) {
-                    const uvc_host_stream_event_data_t event = {
-                        .type = UVC_HOST_FRAME_BUFFER_OVERFLOW,
-                    };
-                    stream_cb(&event, uvc_stream->constant.cb_arg);
-                }
+                isoc_frame_overflow(uvc_stream);
                 goto next_isoc_packet;
             }
         }
@@ -151,9 +313,16 @@ void isoc_transfer_callback(usb_transfer_t *transfer)
         // End of Frame. Pass the frame to user
         if (payload_header->bmHeaderInfo.end_of_frame) {
             bool return_frame = true; // In case streaming is stopped ATM, we must return the frame
+            if (!uvc_frame_mjpeg_is_valid(uvc_stream, UVC_ATOMIC_LOAD(uvc_stream->dynamic.current_frame))) {
+                uvc_stats_skip_frame(uvc_stream, UVC_STATS_DROP_MJPEG_INVALID);
+            }
+            if (!uvc_stream->single_thread.skip_current_frame &&
+                    uvc_frame_adaptive_end(uvc_stream, UVC_ATOMIC_LOAD(uvc_stream->dynamic.current_frame)) != ESP_OK) {
+                uvc_stats_skip_frame(uvc_stream, UVC_STATS_DROP_BUFFER_OVERFLOW); // Frame buffer could not grow
+            }
 
             // Check if the user did not stop the stream in the meantime
-            UVC_ENTER_CRITICAL();
+            UVC_STREAM_ENTER_CRITICAL(uvc_stream);
             uvc_host_frame_t *this_frame = uvc_stream->dynamic.current_frame;
             uvc_stream->dynamic.current_frame = NULL; // Stop writing more data to this frame
 
@@ -161,11 +330,27 @@ void isoc_transfer_callback(usb_transfer_t *transfer)
             // Only invoke the callback if streaming is active, a frame callback exists,
             // and we have a valid frame to pass to the user.
             const bool invoke_fb_callback = (uvc_stream->dynamic.streaming && uvc_stream->constant.frame_cb && this_frame && !uvc_stream->single_thread.skip_current_frame);
-            UVC_EXIT_CRITICAL();
+            const bool invoke_slice_callback = (uvc_stream->dynamic.streaming && uvc_stream->constant.slice_cb && this_frame);
+            UVC_STREAM_EXIT_CRITICAL(uvc_stream);
 
+            uvc_frame_finish(uvc_stream, this_frame);
+            if (invoke_slice_callback) {
+                // Slice mode: Pass the rest of the frame to the user. Corrupted frame is also reported, the user must discard its slices
+                if (!uvc_stream->single_thread.skip_current_frame) {
+                    uvc_stats_frame_delivered(uvc_stream);
+                }
+                uvc_frame_slice_end(uvc_stream, this_frame, uvc_stream->single_thread.skip_current_frame);
+            }
             if (invoke_fb_callback) {
+                uvc_stats_frame_delivered(uvc_stream);
+                if (this_frame->error_flags) {
+                    uvc_stats_frame_corrupted(uvc_stream);
+                }
                 memcpy((uvc_host_stream_format_t *)&this_frame->vs_format, &uvc_stream->constant.vs_format, sizeof(uvc_host_stream_format_t));
+                UVC_TRACE(DELIVER, uvc_stream->constant.bEndpointAddress, this_frame->data_len, this_frame);
+                UVC_TRACE(CALLBACK_ENTER, uvc_stream->constant.bEndpointAddress, 0, this_frame);
                 return_frame = uvc_stream->constant.frame_cb(this_frame, uvc_stream->constant.cb_arg);
+                UVC_TRACE(CALLBACK_EXIT, uvc_stream->constant.bEndpointAddress, 0, this_frame);
             }
             if (return_frame) {
                 // The user has processed the frame in his callback, return it back to empty queue
@@ -177,7 +362,7 @@ next_isoc_packet:
         continue;
     }
 
-    if (UVC_ATOMIC_LOAD(uvc_stream->dynamic.streaming)) {
-        usb_host_transfer_submit(transfer); // Restart the transfer
-    }
+transfer_done:
+    uvc_stats_transfer_done(uvc_stream, payload_bytes, skipped_packets);
+    uvc_frame_urb_done(uvc_stream, transfer); // Restart the transfer
 }
@@ -0,0 +1,221 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h> // For memcpy
+
+#include "esp_check.h"
+#include "usb/usb_host.h"
+
+#include "uvc_negotiation_cache_priv.h"
+#include "uvc_types_priv.h"
+#include "uvc_check_priv.h"
+#include "uvc_critical_priv.h"
+#include "uvc_transfer_priv.h"
+
+typedef struct {
+    uvc_host_negotiation_cache_entry_t entry;
+    uint32_t last_used;                // Sequence number of last use. 0: Entry is empty
+} uvc_negotiation_cache_slot_t;
+
+static uvc_negotiation_cache_slot_t *uvc_cache_slots = NULL; // Protected by critical section
+static size_t uvc_cache_num_slots = 0;
+static uint32_t uvc_cache_sequence = 0;
+
+static inline bool uvc_cache_key_equal(const uvc_host_negotiation_cache_entry_t *a, const uvc_host_negotiation_cache_entry_t *b)
+{
+    return a->idVendor == b->idVendor &&
+           a->idProduct == b->idProduct &&
+           a->bcdDevice == b->bcdDevice &&
+           a->bInterfaceNumber == b->bInterfaceNumber &&
+           a->vs_format.h_res == b->vs_format.h_res &&
+           a->vs_format.v_res == b->vs_format.v_res &&
+           a->vs_format.fps == b->vs_format.fps &&
+           a->vs_format.format == b->vs_format.format;
+}
+
+/**
+ * @brief Fill cache key of a stream and format
+ *
+ * @param[in]  uvc_stream UVC stream
+ * @param[in]  vs_format  Requested format
+ * @param[out] key        Entry with filled key
+ * @return true if the key was filled
+ */
+static bool uvc_cache_key_fill(const uvc_stream_t *uvc_stream, const uvc_host_stream_format_t *vs_format, uvc_host_negotiation_cache_entry_t *key)
+{
+    const usb_device_desc_t *device_desc;
+    if (usb_host_get_device_descriptor(uvc_stream->constant.dev_hdl, &device_desc) != ESP_OK) {
+        return false;
+    }
+    memset(key, 0, sizeof(uvc_host_negotiation_cache_entry_t));
+    key->idVendor = device_desc->idVendor;
+    key->idProduct = device_desc->idProduct;
+    key->bcdDevice = device_desc->bcdDevice;
+    key->bInterfaceNumber = uvc_stream->constant.bInterfaceNumber;
+    memcpy(&key->vs_format, vs_format, sizeof(uvc_host_stream_format_t));
+    return true;
+}
+
+/**
+ * @brief Find slot for an entry
+ *
+ * Must be called from critical section
+ *
+ * @param[in] key         Entry key
+ * @param[in] allow_evict Return empty or least recently used slot if the key is not cached
+ * @return Slot or NULL if not found
+ */
+static uvc_negotiation_cache_slot_t *uvc_cache_find(const uvc_host_negotiation_cache_entry_t *key, bool allow_evict)
+{
+    uvc_negotiation_cache_slot_t *lru = NULL;
+    for (size_t i = 0; i < uvc_cache_num_slots; i++) {
+        uvc_negotiation_cache_slot_t *slot = &uvc_cache_slots[i];
+        if (slot->last_used != 0 && uvc_cache_key_equal(&slot->entry, key)) {
+            return slot;
+        }
+        if (!lru || slot->last_used < lru->last_used) {
+            lru = slot;
+        }
+    }
+    return allow_evict ? lru : NULL;
+}
+
+/**
+ * @brief Store an entry
+ *
+ * Must be called from critical section
+ *
+ * @param[in] entry Entry to store
+ */
+static void uvc_cache_store(const uvc_host_negotiation_cache_entry_t *entry)
+{
+    uvc_negotiation_cache_slot_t *slot = uvc_cache_find(entry, true);
+    if (slot) {
+        memcpy(&slot->entry, entry, sizeof(uvc_host_negotiation_cache_entry_t));
+        slot->last_used = ++uvc_cache_sequence;
+    }
+}
+
+esp_err_t uvc_negotiation_cache_init(size_t num_entries)
+{
+    if (num_entries == 0) {
+        return ESP_OK;
+    }
+    uvc_negotiation_cache_slot_t *slots = UVC_CALLOC(CONTROL, num_entries, sizeof(uvc_negotiation_cache_slot_t));
+    UVC_CHECK(slots, ESP_ERR_NO_MEM);
+
+    UVC_ENTER_CRITICAL();
+    if (uvc_cache_slots) {
+        UVC_EXIT_CRITICAL();
+        UVC_FREE(CONTROL, slots, num_entries * sizeof(uvc_negotiation_cache_slot_t));
+        return ESP_ERR_INVALID_STATE;
+    }
+    uvc_cache_slots = slots;
+    uvc_cache_num_slots = num_entries;
+    uvc_cache_sequence = 0;
+    UVC_EXIT_CRITICAL();
+    return ESP_OK;
+}
+
+void uvc_negotiation_cache_deinit(void)
+{
+    UVC_ENTER_CRITICAL();
+    uvc_negotiation_cache_slot_t *slots = uvc_cache_slots;
+    const size_t num_slots = uvc_cache_num_slots;
+    uvc_cache_slots = NULL;
+    uvc_cache_num_slots = 0;
+    UVC_EXIT_CRITICAL();
+    UVC_FREE(CONTROL, slots, num_slots * sizeof(uvc_negotiation_cache_slot_t));
+}
+
+bool uvc_negotiation_cache_get(const uvc_stream_t *uvc_stream, const uvc_host_stream_format_t *vs_format, uvc_vs_ctrl_t *vs_ctrl_ret)
+{
+    uvc_host_negotiation_cache_entry_t key;
+    if (!UVC_ATOMIC_LOAD(uvc_cache_slots) || !uvc_cache_key_fill(uvc_stream, vs_format, &key)) {
+        return false;
+    }
+
+    UVC_ENTER_CRITICAL();
+    uvc_negotiation_cache_slot_t *slot = uvc_cache_find(&key, false);
+    if (slot) {
+        memcpy(vs_ctrl_ret, &slot->entry.vs_ctrl, sizeof(uvc_vs_ctrl_t));
+        slot->last_used = ++uvc_cache_sequence;
+    }
+    UVC_EXIT_CRITICAL();
+    return slot != NULL;
+}
+
+void uvc_negotiation_cache_put(const uvc_stream_t *uvc_stream, const uvc_host_stream_format_t *vs_format, const uvc_vs_ctrl_t *vs_ctrl)
+{
+    uvc_host_negotiation_cache_entry_t entry;
+    if (!UVC_ATOMIC_LOAD(uvc_cache_slots) || !uvc_cache_key_fill(uvc_stream, vs_format, &entry)) {
+        return;
+    }
+    memcpy(&entry.vs_ctrl, vs_ctrl, sizeof(uvc_vs_ctrl_t));
+
+    UVC_ENTER_CRITICAL();
+    uvc_cache_store(&entry);
+    UVC_EXIT_CRITICAL();
+}
+
+void uvc_negotiation_cache_remove(const uvc_stream_t *uvc_stream, const uvc_host_stream_format_t *vs_format)
+{
+    uvc_host_negotiation_cache_entry_t key;
+    if (!UVC_ATOMIC_LOAD(uvc_cache_slots) || !uvc_cache_key_fill(uvc_stream, vs_format, &key)) {
+        return;
+    }
+
+    UVC_ENTER_CRITICAL();
+    uvc_negotiation_cache_slot_t *slot = uvc_cache_find(&key, false);
+    if (slot) {
+        slot->last_used = 0;
+    }
+    UVC_EXIT_CRITICAL();
+}
+
+esp_err_t uvc_host_negotiation_cache_export(uvc_host_negotiation_cache_entry_t *entries, size_t *num_entries)
+{
+    UVC_CHECK(entries && num_entries, ESP_ERR_INVALID_ARG);
+    size_t exported = 0;
+
+    UVC_ENTER_CRITICAL();
+    UVC_CHECK_FROM_CRIT(uvc_cache_slots, ESP_ERR_INVALID_STATE);
+    for (size_t i = 0; i < uvc_cache_num_slots && exported < *num_entries; i++) {
+        if (uvc_cache_slots[i].last_used != 0) {
+            memcpy(&entries[exported++], &uvc_cache_slots[i].entry, sizeof(uvc_host_negotiation_cache_entry_t));
+        }
+    }
+    UVC_EXIT_CRITICAL();
+
+    *num_entries = exported;
+    return ESP_OK;
+}
+
+esp_err_t uvc_host_negotiation_cache_import(const uvc_host_negotiation_cache_entry_t *entries, size_t num_entries)
+{
+    UVC_CHECK(entries || num_entries == 0, ESP_ERR_INVALID_ARG);
+
+    UVC_ENTER_CRITICAL();
+    UVC_CHECK_FROM_CRIT(uvc_cache_slots, ESP_ERR_INVALID_STATE);
+    for (size_t i = 0; i < num_entries; i++) {
+        uvc_cache_store(&entries[i]);
+    }
+    UVC_EXIT_CRITICAL();
+    return ESP_OK;
+}
+
+esp_err_t uvc_host_negotiation_cache_clear(void)
+{
+    UVC_ENTER_CRITICAL();
+    UVC_CHECK_FROM_CRIT(uvc_cache_slots, ESP_ERR_INVALID_STATE);
+    for (size_t i = 0; i < uvc_cache_num_slots; i++) {
+        uvc_cache_slots[i].last_used = 0;
+    }
+    uvc_cache_sequence = 0;
+    UVC_EXIT_CRITICAL();
+    return ESP_OK;
+}
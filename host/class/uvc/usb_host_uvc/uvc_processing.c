@@ -0,0 +1,217 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h> // For calloc, free
+
+#include "esp_check.h"
+#include "esp_log.h"
+
+#include "usb/usb_host.h"
+#include "usb/uvc_host.h"
+#include "uvc_processing_priv.h"
+#include "uvc_types_priv.h"
+#include "uvc_check_priv.h"
+#include "uvc_critical_priv.h"
+#include "uvc_transfer_priv.h"
+#include "uvc_attr_priv.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "uvc-processing";
+
+#define UVC_PROCESSING_IDLE_TIMEOUT_MS (500) // Maximum time to wait for the URBs of previous streaming
+
+// Payload processing functions, implemented in uvc_isoc.c and uvc_bulk.c
+void isoc_transfer_callback(usb_transfer_t *transfer);
+void bulk_transfer_callback(usb_transfer_t *transfer);
+
+struct uvc_processing_s {
+    TaskHandle_t task;                  // Processing task
+    QueueHandle_t done_urbs;            // Completed URBs waiting for processing. NULL item stops the task
+    QueueHandle_t spare_urbs;           // URBs that are neither submitted nor processed
+    SemaphoreHandle_t task_exited;      // Given by the processing task right before it deletes itself
+    unsigned num_of_spare_urbs;         // Number of URBs that are not submitted at stream start
+    unsigned urbs_in_flight;            // Number of currently submitted URBs. Accessed atomically
+    unsigned urbs_in_processing;        // Number of completed URBs queued for or in processing. Accessed atomically
+};
+
+static void uvc_processing_task(void *arg)
+{
+    uvc_processing_t *processing = (uvc_processing_t *)arg;
+    usb_transfer_t *transfer;
+    while (1) {
+        xQueueReceive(processing->done_urbs, &transfer, portMAX_DELAY);
+        if (transfer == NULL) {
+            break; // Deinit request
+        }
+        // Only ISOC URBs are divided into packets
+        if (transfer->num_isoc_packets > 0) {
+            isoc_transfer_callback(transfer);
+        } else {
+            bulk_transfer_callback(transfer);
+        }
+        UVC_ATOMIC_FETCH_SUB(processing->urbs_in_processing, 1);
+    }
+    xSemaphoreGive(processing->task_exited);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Submit a URB and account for it
+ *
+ * @param[in] processing Processing task context
+ * @param[in] transfer   URB to submit
+ * @return Error from usb_host_transfer_submit()
+ */
+static esp_err_t UVC_DATA_PATH_ATTR uvc_processing_submit(uvc_processing_t *processing, usb_transfer_t *transfer)
+{
+    UVC_ATOMIC_FETCH_ADD(processing->urbs_in_flight, 1);
+    const esp_err_t ret = UVC_TRANSFER_SUBMIT(transfer);
+    if (ret != ESP_OK) {
+        UVC_ATOMIC_FETCH_SUB(processing->urbs_in_flight, 1);
+    }
+    return ret;
+}
+
+/**
+ * @brief Submit one spare URB, if there is any
+ *
+ * @param[in] processing Processing task context
+ */
+static void uvc_processing_submit_spare(uvc_processing_t *processing)
+{
+    usb_transfer_t *spare;
+    if (xQueueReceive(processing->spare_urbs, &spare, 0) != pdTRUE) {
+        return;
+    }
+    if (uvc_processing_submit(processing, spare) != ESP_OK) {
+        xQueueSend(processing->spare_urbs, &spare, 0); // Cannot fail, the URB was just taken from the queue
+    }
+}
+
+esp_err_t uvc_processing_init(uvc_stream_t *uvc_stream, const uvc_host_stream_config_t *stream_config, unsigned num_of_urbs)
+{
+    UVC_CHECK(uvc_stream && stream_config, ESP_ERR_INVALID_ARG);
+    const unsigned num_of_spare_urbs = stream_config->advanced.processing_task.number_of_spare_urbs;
+    UVC_CHECK(num_of_spare_urbs < num_of_urbs, ESP_ERR_INVALID_ARG); // At least one URB must be submitted at stream start
+
+    esp_err_t ret;
+    uvc_processing_t *processing = UVC_CALLOC(CONTROL, 1, sizeof(uvc_processing_t));
+    UVC_CHECK(processing, ESP_ERR_NO_MEM);
+    processing->num_of_spare_urbs = num_of_spare_urbs;
+
+    // Both queues can hold all URBs of this stream (plus the deinit request), so sending to them never blocks
+    processing->done_urbs = xQueueCreate(num_of_urbs + 1, sizeof(usb_transfer_t *));
+    processing->spare_urbs = xQueueCreate(num_of_urbs, sizeof(usb_transfer_t *));
+    processing->task_exited = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(processing->done_urbs && processing->spare_urbs && processing->task_exited,
+                      ESP_ERR_NO_MEM, err, TAG, "Not enough memory for processing queues");
+
+    ESP_GOTO_ON_FALSE(
+        xTaskCreatePinnedToCore(uvc_processing_task, "uvc_proc",
+                                stream_config->advanced.processing_task.stack_size,
+                                processing,
+                                stream_config->advanced.processing_task.priority,
+                                &processing->task,
+                                stream_config->advanced.processing_task.core_id) == pdPASS,
+        ESP_ERR_NO_MEM, err, TAG, "Could not create processing task");
+
+    uvc_stream->constant.processing = processing;
+    return ESP_OK;
+
+err:
+    if (processing->done_urbs) {
+        vQueueDelete(processing->done_urbs);
+    }
+    if (processing->spare_urbs) {
+        vQueueDelete(processing->spare_urbs);
+    }
+    if (processing->task_exited) {
+        vSemaphoreDelete(processing->task_exited);
+    }
+    UVC_FREE(CONTROL, processing, sizeof(uvc_processing_t));
+    return ret;
+}
+
+void uvc_processing_deinit(uvc_stream_t *uvc_stream)
+{
+    if (!uvc_stream || !uvc_stream->constant.processing) {
+        return;
+    }
+    uvc_processing_t *processing = uvc_stream->constant.processing;
+
+    // URBs that are already queued are processed before the task exits
+    usb_transfer_t *stop_request = NULL;
+    xQueueSend(processing->done_urbs, &stop_request, portMAX_DELAY);
+    xSemaphoreTake(processing->task_exited, portMAX_DELAY);
+
+    vQueueDelete(processing->done_urbs);
+    vQueueDelete(processing->spare_urbs);
+    vSemaphoreDelete(processing->task_exited);
+    UVC_FREE(CONTROL, processing, sizeof(uvc_processing_t));
+    uvc_stream->constant.processing = NULL;
+}
+
+esp_err_t uvc_processing_wait_idle(uvc_stream_t *uvc_stream)
+{
+    uvc_processing_t *processing = uvc_stream->constant.processing;
+    const TickType_t wait_start = xTaskGetTickCount();
+    while (UVC_ATOMIC_LOAD(processing->urbs_in_flight) != 0 || UVC_ATOMIC_LOAD(processing->urbs_in_processing) != 0) {
+        if (xTaskGetTickCount() - wait_start > pdMS_TO_TICKS(UVC_PROCESSING_IDLE_TIMEOUT_MS)) {
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(1);
+    }
+    return ESP_OK;
+}
+
+esp_err_t uvc_processing_start(uvc_stream_t *uvc_stream)
+{
+    uvc_processing_t *processing = uvc_stream->constant.processing;
+    const unsigned num_of_submitted = uvc_stream->constant.num_of_xfers - processing->num_of_spare_urbs;
+
+    // The URBs could have been re-allocated since last start, so the spare queue is filled again
+    xQueueReset(processing->spare_urbs);
+    for (unsigned i = num_of_submitted; i < uvc_stream->constant.num_of_xfers; i++) {
+        xQueueSend(processing->spare_urbs, &uvc_stream->constant.xfers[i], 0);
+    }
+    for (unsigned i = 0; i < num_of_submitted; i++) {
+        ESP_RETURN_ON_ERROR(
+            uvc_processing_submit(processing, uvc_stream->constant.xfers[i]),
+            TAG, "Could not submit transfer %d", i);
+    }
+    return ESP_OK;
+}
+
+void UVC_DATA_PATH_ATTR uvc_processing_transfer_cb(usb_transfer_t *transfer)
+{
+    UVC_TRACE_COMPLETE(transfer);
+    uvc_stream_t *uvc_stream = (uvc_stream_t *)transfer->context;
+    uvc_processing_t *processing = uvc_stream->constant.processing;
+    UVC_ATOMIC_FETCH_ADD(processing->urbs_in_processing, 1); // Before the URB leaves flight, so uvc_processing_start() never sees it in neither state
+    UVC_ATOMIC_FETCH_SUB(processing->urbs_in_flight, 1);
+
+    // Keep the endpoint busy while the completed URB waits for processing
+    if (UVC_ATOMIC_LOAD(uvc_stream->dynamic.streaming)) {
+        uvc_processing_submit_spare(processing);
+    }
+    xQueueSend(processing->done_urbs, &transfer, 0); // Cannot fail, the queue can hold all URBs
+}
+
+void UVC_DATA_PATH_ATTR uvc_processing_urb_done(uvc_stream_t *uvc_stream, usb_transfer_t *transfer)
+{
+    uvc_processing_t *processing = uvc_stream->constant.processing;
+    xQueueSend(processing->spare_urbs, &transfer, 0); // Cannot fail, the queue can hold all URBs
+
+    // If no spare URB was available when this URB completed, fewer URBs are in flight than at stream start
+    const unsigned num_of_submitted = uvc_stream->constant.num_of_xfers - processing->num_of_spare_urbs;
+    if (UVC_ATOMIC_LOAD(uvc_stream->dynamic.streaming) && UVC_ATOMIC_LOAD(processing->urbs_in_flight) < num_of_submitted) {
+        uvc_processing_submit_spare(processing);
+    }
+}
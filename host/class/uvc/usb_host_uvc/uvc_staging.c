@@ -0,0 +1,236 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h> // For memcpy
+#include <sys/param.h> // For MIN
+
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "soc/soc_caps.h"
+
+#include "usb/uvc_host.h"
+#include "uvc_staging_priv.h"
+#include "uvc_types_priv.h"
+#include "uvc_check_priv.h"
+#include "uvc_idf_version_priv.h"
+#include "uvc_attr_priv.h"
+#include "uvc_transfer_priv.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#if SOC_ASYNC_MEMCPY_SUPPORTED
+#include "esp_async_memcpy.h"
+#if UVC_HAS_ESP_CACHE
+#include "esp_cache.h"
+#endif
+
+static const char *TAG = "uvc-staging";
+
+#define UVC_STAGING_SLOTS     (4)   // Number of slots in the staging ring
+#define UVC_STAGING_TIMEOUT   (pdMS_TO_TICKS(100)) // Max time to wait for a free slot. The DMA copy should be much faster
+
+#define UVC_ROUND_UP(x, align) ((((x) + (align) - 1) / (align)) * (align))
+
+struct uvc_staging_s {
+    async_memcpy_handle_t mcp;       // Async memcpy driver handle
+    SemaphoreHandle_t free_slots;    // Counting semaphore of free slots. Given from DMA ISR
+    uint8_t *slots;                  // Internal RAM storage of all slots
+    size_t slot_size;                // Size of 1 slot in bytes. Integer multiple of UVC_STAGING_ALIGN
+    unsigned slot_idx;               // Index of slot that is being filled
+    size_t slot_fill;                // Number of bytes in currently filled slot
+    size_t slot_frame_offset;        // Offset in frame buffer where the currently filled slot will be copied
+    uvc_host_frame_t *frame;         // Frame buffer that is being staged. NULL if no frame is staged
+};
+
+static bool UVC_DATA_PATH_ATTR uvc_staging_copy_done(async_memcpy_handle_t mcp, async_memcpy_event_t *event, void *cb_args)
+{
+    uvc_staging_t *staging = (uvc_staging_t *)cb_args;
+    BaseType_t high_task_woken = pdFALSE;
+    xSemaphoreGiveFromISR(staging->free_slots, &high_task_woken);
+    return high_task_woken == pdTRUE;
+}
+
+/**
+ * @brief Copy one staging slot to the frame buffer
+ *
+ * @param[in] staging Staging ring
+ * @param[in] len     Number of bytes to copy. Integer multiple of UVC_STAGING_ALIGN
+ */
+static void UVC_DATA_PATH_ATTR uvc_staging_slot_submit(uvc_staging_t *staging, size_t len)
+{
+    uint8_t *src = staging->slots + staging->slot_idx * staging->slot_size;
+    uint8_t *dst = staging->frame->data + staging->slot_frame_offset;
+    if (esp_async_memcpy(staging->mcp, dst, src, len, uvc_staging_copy_done, staging) != ESP_OK) {
+        // DMA is busy or the buffers are not suitable for DMA: Fallback to CPU copy
+        memcpy(dst, src, len);
+        xSemaphoreGive(staging->free_slots);
+    }
+
+    staging->slot_idx = (staging->slot_idx + 1) % UVC_STAGING_SLOTS;
+    staging->slot_frame_offset += staging->slot_size;
+    staging->slot_fill = 0;
+}
+
+/**
+ * @brief Wait until all slots are copied to the frame buffer
+ *
+ * @param[in] staging Staging ring
+ */
+static void uvc_staging_wait_all(uvc_staging_t *staging)
+{
+    int taken = 0;
+    for (int i = 0; i < UVC_STAGING_SLOTS; i++) {
+        if (xSemaphoreTake(staging->free_slots, UVC_STAGING_TIMEOUT) == pdTRUE) {
+            taken++;
+        } else {
+            ESP_LOGW(TAG, "Staging copy timeout");
+        }
+    }
+    for (int i = 0; i < taken; i++) {
+        xSemaphoreGive(staging->free_slots);
+    }
+}
+
+esp_err_t uvc_staging_init(uvc_stream_t *uvc_stream, size_t staging_size)
+{
+    UVC_CHECK(uvc_stream, ESP_ERR_INVALID_ARG);
+    const size_t slot_size = (staging_size / UVC_STAGING_SLOTS / UVC_STAGING_ALIGN) * UVC_STAGING_ALIGN;
+    UVC_CHECK(slot_size > 0, ESP_ERR_INVALID_ARG);
+
+    esp_err_t ret;
+    uvc_staging_t *staging = UVC_CALLOC(CONTROL, 1, sizeof(uvc_staging_t));
+    UVC_CHECK(staging, ESP_ERR_NO_MEM);
+    staging->slot_size = slot_size;
+    staging->slots = UVC_ALIGNED_ALLOC(BUFFER, UVC_STAGING_ALIGN, slot_size * UVC_STAGING_SLOTS, MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+    staging->free_slots = xSemaphoreCreateCounting(UVC_STAGING_SLOTS, UVC_STAGING_SLOTS);
+    ESP_GOTO_ON_FALSE(staging->slots && staging->free_slots, ESP_ERR_NO_MEM, err, TAG, "Not enough memory for staging ring");
+
+    async_memcpy_config_t config = ASYNC_MEMCPY_DEFAULT_CONFIG();
+    config.backlog = UVC_STAGING_SLOTS;
+#if UVC_ASYNC_MEMCPY_HAS_TRANS_ALIGN
+    config.sram_trans_align = 4;
+    config.psram_trans_align = UVC_STAGING_ALIGN;
+#endif
+    ESP_GOTO_ON_ERROR(esp_async_memcpy_install(&config, &staging->mcp), err, TAG, "Could not install async memcpy");
+
+    uvc_stream->constant.staging = staging;
+    return ESP_OK;
+
+err:
+    if (staging->free_slots) {
+        vSemaphoreDelete(staging->free_slots);
+    }
+    UVC_FREE(BUFFER, staging->slots, staging->slot_size * UVC_STAGING_SLOTS);
+    UVC_FREE(CONTROL, staging, sizeof(uvc_staging_t));
+    return ret;
+}
+
+void uvc_staging_deinit(uvc_stream_t *uvc_stream)
+{
+    if (!uvc_stream || !uvc_stream->constant.staging) {
+        return;
+    }
+    uvc_staging_t *staging = uvc_stream->constant.staging;
+    uvc_staging_wait_all(staging);
+    esp_async_memcpy_uninstall(staging->mcp);
+    vSemaphoreDelete(staging->free_slots);
+    UVC_FREE(BUFFER, staging->slots, staging->slot_size * UVC_STAGING_SLOTS);
+    UVC_FREE(CONTROL, staging, sizeof(uvc_staging_t));
+    uvc_stream->constant.staging = NULL;
+}
+
+esp_err_t UVC_DATA_PATH_ATTR uvc_staging_add_data(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame, const uint8_t *data, size_t data_len)
+{
+    if (data_len == 0) {
+        return ESP_OK; // Fast return in case of zero data
+    }
+    UVC_CHECK(frame && data, ESP_ERR_INVALID_ARG);
+    UVC_CHECK(frame->data_len + data_len <= frame->data_buffer_len, ESP_ERR_INVALID_SIZE);
+    uvc_staging_t *staging = uvc_stream->constant.staging;
+
+    if (staging->frame != frame) {
+        // New frame is staged, start from its beginning
+        staging->frame = frame;
+        staging->slot_fill = 0;
+        staging->slot_frame_offset = frame->data_len;
+    }
+
+    while (data_len > 0) {
+        if (staging->slot_fill == 0) {
+            // We are about to use new slot: Wait until its previous content is copied out
+            UVC_CHECK(xSemaphoreTake(staging->free_slots, UVC_STAGING_TIMEOUT) == pdTRUE, ESP_ERR_TIMEOUT);
+        }
+        uint8_t *slot = staging->slots + staging->slot_idx * staging->slot_size;
+        const size_t chunk = MIN(data_len, staging->slot_size - staging->slot_fill);
+        memcpy(slot + staging->slot_fill, data, chunk);
+        staging->slot_fill += chunk;
+        frame->data_len += chunk;
+        data += chunk;
+        data_len -= chunk;
+
+        if (staging->slot_fill == staging->slot_size) {
+            uvc_staging_slot_submit(staging, staging->slot_size);
+        }
+    }
+    return ESP_OK;
+}
+
+void uvc_staging_flush(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame)
+{
+    uvc_staging_t *staging = uvc_stream->constant.staging;
+    if (!staging || staging->frame != frame) {
+        return;
+    }
+
+    // Copy the partially filled slot. Frame buffers are allocated with size rounded up to UVC_STAGING_ALIGN
+    if (staging->slot_fill > 0) {
+        uvc_staging_slot_submit(staging, UVC_ROUND_UP(staging->slot_fill, UVC_STAGING_ALIGN));
+    }
+    uvc_staging_wait_all(staging);
+    staging->frame = NULL;
+
+#if UVC_HAS_ESP_CACHE
+    // The frame buffer was written by DMA, make sure that CPU does not read stale data from cache
+    esp_cache_msync(frame->data, UVC_ROUND_UP(frame->data_len, UVC_STAGING_ALIGN), ESP_CACHE_MSYNC_FLAG_DIR_M2C); // Ignore error for non-cacheable memory
+#endif
+}
+
+void uvc_staging_discard(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame)
+{
+    uvc_staging_t *staging = uvc_stream->constant.staging;
+    if (!staging || staging->frame != frame) {
+        return;
+    }
+
+    // Release the partially filled slot and wait for ongoing copies to this frame
+    if (staging->slot_fill > 0) {
+        staging->slot_fill = 0;
+        xSemaphoreGive(staging->free_slots);
+    }
+    uvc_staging_wait_all(staging);
+    staging->frame = NULL;
+}
+
+#else // SOC_ASYNC_MEMCPY_SUPPORTED
+
+esp_err_t uvc_staging_init(uvc_stream_t *uvc_stream, size_t staging_size)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void uvc_staging_deinit(uvc_stream_t *uvc_stream) {}
+
+esp_err_t UVC_DATA_PATH_ATTR uvc_staging_add_data(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame, const uint8_t *data, size_t data_len)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void uvc_staging_flush(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame) {}
+
+void uvc_staging_discard(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame) {}
+
+#endif // SOC_ASYNC_MEMCPY_SUPPORTED
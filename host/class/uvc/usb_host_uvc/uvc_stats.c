@@ -0,0 +1,164 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h> // For memset
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+#include "usb/uvc_host.h"
+#include "uvc_stats_priv.h"
+#include "uvc_types_priv.h"
+#include "uvc_check_priv.h"
+#include "uvc_critical_priv.h"
+#include "uvc_attr_priv.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include "esp_timer.h"
+#endif
+
+int64_t UVC_DATA_PATH_ATTR uvc_stats_time_us(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return esp_timer_get_time();
+#endif
+}
+
+/**
+ * @brief Get latency histogram bucket
+ *
+ * Bucket 0: < 1 ms, bucket i: <2^(i-1); 2^i) ms, last bucket: everything above
+ *
+ * @param[in] latency_us Latency in microseconds
+ * @return Index of histogram bucket
+ */
+static unsigned UVC_DATA_PATH_ATTR uvc_stats_latency_bucket(uint32_t latency_us)
+{
+    unsigned bucket = 0;
+    uint32_t latency_ms = latency_us / 1000;
+    while (latency_ms > 0 && bucket < UVC_HOST_STATS_LATENCY_BUCKETS - 1) {
+        latency_ms >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void uvc_stats_reset(uvc_stream_t *uvc_stream)
+{
+    const int64_t now = uvc_stats_time_us();
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    memset(&uvc_stream->stats.counters, 0, sizeof(uvc_host_stream_stats_t));
+    uvc_stream->stats.reset_timestamp = now;
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+}
+
+void UVC_DATA_PATH_ATTR uvc_stats_sof(uvc_stream_t *uvc_stream)
+{
+    memset(&uvc_stream->single_thread.timestamp, 0, sizeof(uvc_host_frame_timestamp_t));
+    uvc_stream->single_thread.timestamp.host_sof_us = uvc_stats_time_us();
+}
+
+void UVC_DATA_PATH_ATTR uvc_stats_frame_dropped(uvc_stream_t *uvc_stream, uvc_stats_drop_t cause)
+{
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    switch (cause) {
+    case UVC_STATS_DROP_USB_ERROR:        uvc_stream->stats.counters.frames_dropped.usb_error++;        break;
+    case UVC_STATS_DROP_HEADER_ERROR:     uvc_stream->stats.counters.frames_dropped.header_error++;     break;
+    case UVC_STATS_DROP_BUFFER_UNDERFLOW: uvc_stream->stats.counters.frames_dropped.buffer_underflow++; break;
+    case UVC_STATS_DROP_BUFFER_OVERFLOW:  uvc_stream->stats.counters.frames_dropped.buffer_overflow++;  break;
+    case UVC_STATS_DROP_MISSING_EOF:      uvc_stream->stats.counters.frames_dropped.missing_eof++;      break;
+    case UVC_STATS_DROP_MJPEG_INVALID:    uvc_stream->stats.counters.frames_dropped.mjpeg_invalid++;    break;
+    default: break;
+    }
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+}
+
+void UVC_DATA_PATH_ATTR uvc_stats_frame_delivered(uvc_stream_t *uvc_stream)
+{
+    int64_t latency = uvc_stats_time_us() - uvc_stream->single_thread.timestamp.host_sof_us;
+    if (latency < 0) {
+        latency = 0;
+    } else if (latency > UINT32_MAX) {
+        latency = UINT32_MAX;
+    }
+    const uint32_t latency_us = (uint32_t)latency;
+    const unsigned bucket = uvc_stats_latency_bucket(latency_us);
+
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    uvc_stream->stats.counters.frames_delivered++;
+    uvc_stream->stats.counters.latency_histogram[bucket]++;
+    if (latency_us > uvc_stream->stats.counters.latency_max_us) {
+        uvc_stream->stats.counters.latency_max_us = latency_us;
+    }
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+}
+
+void UVC_DATA_PATH_ATTR uvc_stats_frame_corrupted(uvc_stream_t *uvc_stream)
+{
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    uvc_stream->stats.counters.frames_corrupted++;
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+}
+
+void UVC_DATA_PATH_ATTR uvc_stats_frame_extended(uvc_stream_t *uvc_stream)
+{
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    uvc_stream->stats.counters.frames_extended++;
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+}
+
+void UVC_DATA_PATH_ATTR uvc_stats_frame_resized(uvc_stream_t *uvc_stream)
+{
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    uvc_stream->stats.counters.frame_buffers_resized++;
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+}
+
+void UVC_DATA_PATH_ATTR uvc_stats_transfer_done(uvc_stream_t *uvc_stream, size_t payload_bytes, unsigned skipped_packets)
+{
+    if (payload_bytes == 0 && skipped_packets == 0) {
+        return; // Nothing to account, do not enter critical section
+    }
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    uvc_stream->stats.counters.bytes_received += payload_bytes;
+    uvc_stream->stats.counters.isoc_packets_skipped += skipped_packets;
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+}
+
+void UVC_DATA_PATH_ATTR uvc_stats_skip_frame(uvc_stream_t *uvc_stream, uvc_stats_drop_t cause)
+{
+    if (!uvc_stream->single_thread.skip_current_frame && UVC_ATOMIC_LOAD(uvc_stream->dynamic.current_frame)) {
+        uvc_stats_frame_dropped(uvc_stream, cause);
+    }
+    uvc_stream->single_thread.skip_current_frame = true;
+}
+
+esp_err_t uvc_host_stream_get_stats(uvc_host_stream_hdl_t stream_hdl, uvc_host_stream_stats_t *stats_ret)
+{
+    UVC_CHECK(stream_hdl && stats_ret, ESP_ERR_INVALID_ARG);
+    uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
+
+    const int64_t now = uvc_stats_time_us();
+    UVC_STREAM_ENTER_CRITICAL(uvc_stream);
+    memcpy(stats_ret, &uvc_stream->stats.counters, sizeof(uvc_host_stream_stats_t));
+    const int64_t elapsed_us = now - uvc_stream->stats.reset_timestamp;
+    UVC_STREAM_EXIT_CRITICAL(uvc_stream);
+
+    stats_ret->bytes_per_second = (elapsed_us > 0) ? (uint32_t)(stats_ret->bytes_received * 1000000 / elapsed_us) : 0;
+    return ESP_OK;
+}
+
+esp_err_t uvc_host_stream_reset_stats(uvc_host_stream_hdl_t stream_hdl)
+{
+    UVC_CHECK(stream_hdl, ESP_ERR_INVALID_ARG);
+    uvc_stats_reset((uvc_stream_t *)stream_hdl);
+    return ESP_OK;
+}
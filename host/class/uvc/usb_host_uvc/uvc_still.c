@@ -0,0 +1,446 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdint.h> // For SIZE_MAX, UINT32_MAX
+#include <stdlib.h> // For calloc, free
+#include <string.h> // For memcpy, memset
+#include <sys/param.h> // For MIN
+
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "usb/usb_host.h"
+#include "usb/uvc_host.h"
+#include "uvc_control.h"
+#include "uvc_still_priv.h"
+#include "uvc_types_priv.h"
+#include "uvc_descriptors_priv.h"
+#include "uvc_payload_priv.h"
+#include "uvc_stats_priv.h"
+#include "uvc_check_priv.h"
+#include "uvc_critical_priv.h"
+#include "uvc_transfer_priv.h"
+#include "uvc_attr_priv.h"
+
+static const char *TAG = "uvc-still";
+
+#define UVC_STILL_URB_SIZE     (16 * 1024) // Size of Bulk still image URB. Rounded up to MPS
+#define UVC_STILL_MAX_BUFFERS  (32)        // Empty still image buffers are tracked in 32bit mask
+
+struct uvc_still_s {
+    uvc_host_frame_callback_t still_cb;   // User's still image callback
+    uvc_host_stream_format_t vs_format;   // Format of still images. fps is 0
+    uvc_host_stream_format_t video_format; // Video format the still image was negotiated for
+    uint8_t method;                       // Still image capture method, 2 or 3
+    uvc_host_frame_t *frames;             // Still image buffers
+    unsigned num_of_frames;               // Number of still image buffers
+    unsigned alloc_frames;                // Number of entries allocated in frames
+    uint32_t empty_frames;                // Bit mask of empty still image buffers, owned by the driver. Accessed atomically
+    bool capturing;                       // Method 3 only: Still image URB is in flight. Accessed atomically
+
+    // Method 3 only
+    usb_transfer_t *xfer;                 // URB of Bulk still image endpoint
+    uint32_t dwMaxPayloadTransferSize;    // Committed still image payload size. Used for payload boundary detection
+    size_t payload_remaining;             // Number of bytes left in current payload
+    bool payload_header_next;             // Next received byte is start of payload header
+
+    // Reassembly. Accessed only from the task that processes still image payloads
+    uvc_host_frame_t *current_frame;      // Still image that is being written to
+    uint8_t current_frame_id;             // Frame ID of current still image. Invalid value 2 catches the first payload
+    bool skip_current_frame;              // An error has occurred in current still image
+    bool payload_eof;                     // Header of current payload contains EoF flag
+};
+
+/**
+ * @brief Take ownership of empty still image buffer
+ *
+ * @param[in] still Still image context
+ * @return Still image buffer or NULL if all buffers are owned by the user
+ */
+static UVC_DATA_PATH_ATTR uvc_host_frame_t *uvc_still_get_empty(uvc_still_t *still)
+{
+    uint32_t empty_frames = UVC_ATOMIC_LOAD(still->empty_frames);
+    uint32_t remaining;
+    do {
+        if (empty_frames == 0) {
+            return NULL;
+        }
+        remaining = empty_frames & (empty_frames - 1); // Clear the lowest set bit
+    } while (!UVC_ATOMIC_COMPARE_EXCHANGE(still->empty_frames, empty_frames, remaining));
+    return &still->frames[__builtin_ctz(empty_frames)];
+}
+
+/**
+ * @brief Start new still image
+ *
+ * @param[in] still Still image context
+ */
+static void UVC_DATA_PATH_ATTR uvc_still_frame_start(uvc_still_t *still)
+{
+    if (still->current_frame) {
+        // New still image started before End of Frame, reuse the buffer
+        still->current_frame->data_len = 0;
+    } else {
+        still->current_frame = uvc_still_get_empty(still);
+    }
+    still->skip_current_frame = (still->current_frame == NULL);
+    if (still->current_frame) {
+        memset(&still->current_frame->timestamp, 0, sizeof(uvc_host_frame_timestamp_t));
+        still->current_frame->timestamp.host_sof_us = uvc_stats_time_us();
+    } else {
+        ESP_LOGW(TAG, "No free still image buffer");
+    }
+}
+
+/**
+ * @brief Process payload header of still image
+ *
+ * @param[in] still          Still image context
+ * @param[in] payload_header Payload header
+ */
+static void UVC_DATA_PATH_ATTR uvc_still_header_parse(uvc_still_t *still, const uvc_payload_header_t *payload_header)
+{
+    if (still->current_frame_id != payload_header->bmHeaderInfo.frame_id) {
+        still->current_frame_id = payload_header->bmHeaderInfo.frame_id;
+        uvc_still_frame_start(still);
+    }
+    if (payload_header->bmHeaderInfo.error) {
+        still->skip_current_frame = true;
+    }
+    if (still->current_frame) {
+        uvc_payload_header_get_timestamps(payload_header, &still->current_frame->timestamp);
+    }
+    still->payload_eof = payload_header->bmHeaderInfo.end_of_frame;
+}
+
+/**
+ * @brief Add payload data to current still image
+ *
+ * @param[in] still    Still image context
+ * @param[in] data     Pointer to data
+ * @param[in] data_len Data length in bytes
+ */
+static void UVC_DATA_PATH_ATTR uvc_still_data_add(uvc_still_t *still, const uint8_t *data, size_t data_len)
+{
+    uvc_host_frame_t *frame = still->current_frame;
+    if (still->skip_current_frame || !frame || data_len == 0) {
+        return;
+    }
+    if (frame->data_len + data_len > frame->data_buffer_len) {
+        ESP_LOGW(TAG, "Still image buffer overflow");
+        still->skip_current_frame = true;
+        return;
+    }
+    memcpy(frame->data + frame->data_len, data, data_len);
+    frame->data_len += data_len;
+}
+
+/**
+ * @brief Pass current still image to the user, if it is complete
+ *
+ * @param[in] uvc_stream UVC stream
+ * @param[in] still      Still image context
+ * @return true if End of Frame was reached
+ */
+static bool UVC_DATA_PATH_ATTR uvc_still_end(uvc_stream_t *uvc_stream, uvc_still_t *still)
+{
+    if (!still->payload_eof) {
+        return false;
+    }
+    still->payload_eof = false;
+    uvc_host_frame_t *this_frame = still->current_frame;
+    still->current_frame = NULL;
+    still->current_frame_id = 2; // Next still image starts regardless of its Frame ID
+    if (!this_frame) {
+        return true;
+    }
+
+    bool return_frame = true;
+    if (!still->skip_current_frame && UVC_ATOMIC_LOAD(uvc_stream->dynamic.streaming) && still->still_cb) {
+        this_frame->timestamp.host_eof_us = uvc_stats_time_us();
+        memcpy((uvc_host_stream_format_t *)&this_frame->vs_format, &still->vs_format, sizeof(uvc_host_stream_format_t));
+        return_frame = still->still_cb(this_frame, uvc_stream->constant.cb_arg);
+    }
+    if (return_frame) {
+        uvc_still_frame_return(uvc_stream, this_frame);
+    }
+    return true;
+}
+
+/**
+ * @brief Callback of Bulk still image URB. Method 3 only
+ *
+ * Payloads are delimited in the same way as on Bulk video endpoint: By short packet or by dwMaxPayloadTransferSize.
+ * The URB is re-submitted until End of Frame is received.
+ *
+ * @param[in] transfer Completed URB
+ */
+static void UVC_DATA_PATH_ATTR uvc_still_transfer_callback(usb_transfer_t *transfer)
+{
+    UVC_TRACE_COMPLETE(transfer);
+    uvc_stream_t *uvc_stream = (uvc_stream_t *)transfer->context;
+    uvc_still_t *still = uvc_stream->constant.still;
+
+    if (transfer->status != USB_TRANSFER_STATUS_COMPLETED || !UVC_ATOMIC_LOAD(uvc_stream->dynamic.streaming)) {
+        still->skip_current_frame = true;
+        UVC_ATOMIC_STORE(still->capturing, false);
+        return;
+    }
+
+    const uint8_t *data = transfer->data_buffer;
+    size_t data_len = transfer->actual_num_bytes;
+    bool end_of_frame = false;
+    while (data_len > 0 && !end_of_frame) {
+        if (still->payload_header_next) {
+            const uvc_payload_header_t *payload_header = (const uvc_payload_header_t *)data;
+            if (data_len < 2 || payload_header->bHeaderLength < 2 || payload_header->bHeaderLength > data_len || !payload_header->bmHeaderInfo.end_of_header) {
+                still->skip_current_frame = true; // Lost track of payload boundaries
+                break;
+            }
+            uvc_still_header_parse(still, payload_header);
+            still->payload_remaining = (still->dwMaxPayloadTransferSize > payload_header->bHeaderLength) ?
+                                       (still->dwMaxPayloadTransferSize - payload_header->bHeaderLength) : SIZE_MAX;
+            still->payload_header_next = false;
+            data     += payload_header->bHeaderLength;
+            data_len -= payload_header->bHeaderLength;
+        }
+
+        const size_t chunk = MIN(data_len, still->payload_remaining);
+        uvc_still_data_add(still, data, chunk);
+        data     += chunk;
+        data_len -= chunk;
+        still->payload_remaining -= chunk;
+        if (still->payload_remaining == 0) {
+            still->payload_header_next = true;
+            end_of_frame = uvc_still_end(uvc_stream, still);
+        }
+    }
+
+    // Short packet terminates the payload
+    if (!end_of_frame && !still->payload_header_next && transfer->actual_num_bytes < transfer->num_bytes) {
+        still->payload_header_next = true;
+        end_of_frame = uvc_still_end(uvc_stream, still);
+    }
+
+    if (end_of_frame || UVC_TRANSFER_SUBMIT(transfer) != ESP_OK) {
+        UVC_ATOMIC_STORE(still->capturing, false);
+    }
+}
+
+void uvc_still_free(uvc_stream_t *uvc_stream)
+{
+    if (!uvc_stream || !uvc_stream->constant.still) {
+        return;
+    }
+    uvc_still_t *still = uvc_stream->constant.still;
+    for (unsigned i = 0; i < still->num_of_frames; i++) {
+        UVC_FREE(BUFFER, still->frames[i].data, still->frames[i].data_buffer_len);
+    }
+    UVC_FREE(CONTROL, still->frames, still->alloc_frames * sizeof(uvc_host_frame_t));
+    if (still->xfer) {
+        UVC_TRANSFER_FREE(still->xfer);
+    }
+    UVC_FREE(CONTROL, still, sizeof(uvc_still_t));
+    uvc_stream->constant.still = NULL;
+}
+
+bool UVC_DATA_PATH_ATTR uvc_still_is_still_payload(const uvc_stream_t *uvc_stream, const uvc_payload_header_t *payload_header)
+{
+    const uvc_still_t *still = uvc_stream->constant.still;
+    return still && still->method == 2 && payload_header->bmHeaderInfo.still_image;
+}
+
+void UVC_DATA_PATH_ATTR uvc_still_header_process(uvc_stream_t *uvc_stream, const uvc_payload_header_t *payload_header)
+{
+    uvc_still_header_parse(uvc_stream->constant.still, payload_header);
+    uvc_stream->single_thread.current_frame_id = 2; // Video frame that follows the still image starts regardless of its Frame ID
+}
+
+void UVC_DATA_PATH_ATTR uvc_still_data_process(uvc_stream_t *uvc_stream, const uint8_t *data, size_t data_len)
+{
+    uvc_still_data_add(uvc_stream->constant.still, data, data_len);
+}
+
+void UVC_DATA_PATH_ATTR uvc_still_payload_end(uvc_stream_t *uvc_stream)
+{
+    uvc_still_end(uvc_stream, uvc_stream->constant.still);
+}
+
+bool UVC_DATA_PATH_ATTR uvc_still_owns_frame(const uvc_stream_t *uvc_stream, const uvc_host_frame_t *frame)
+{
+    const uvc_still_t *still = uvc_stream->constant.still;
+    return still && frame >= still->frames && frame < still->frames + still->num_of_frames;
+}
+
+esp_err_t UVC_DATA_PATH_ATTR uvc_still_frame_return(uvc_stream_t *uvc_stream, uvc_host_frame_t *frame)
+{
+    uvc_still_t *still = uvc_stream->constant.still;
+    frame->data_len = 0;
+    const uint32_t frame_bit = 1UL << (frame - still->frames);
+    const uint32_t empty_frames = UVC_ATOMIC_FETCH_OR(still->empty_frames, frame_bit);
+    UVC_CHECK(!(empty_frames & frame_bit), ESP_FAIL); // The still image was already returned
+    return ESP_OK;
+}
+
+bool uvc_still_are_all_returned(uvc_stream_t *uvc_stream)
+{
+    uvc_still_t *still = uvc_stream->constant.still;
+    if (!still) {
+        return true;
+    }
+    const uint32_t all_frames_mask = (still->num_of_frames >= 32) ? UINT32_MAX : ((1UL << still->num_of_frames) - 1);
+    return (UVC_ATOMIC_LOAD(still->empty_frames) == all_frames_mask);
+}
+
+void uvc_still_reset(uvc_stream_t *uvc_stream)
+{
+    uvc_still_t *still = uvc_stream->constant.still;
+    if (!still || UVC_ATOMIC_LOAD(still->capturing)) {
+        return; // Method 3: Still image URB in flight owns the reassembly state
+    }
+    if (still->current_frame) {
+        uvc_still_frame_return(uvc_stream, still->current_frame);
+        still->current_frame = NULL;
+    }
+    still->current_frame_id = 2;
+    still->skip_current_frame = false;
+    still->payload_eof = false;
+    still->payload_header_next = true;
+}
+
+void uvc_still_stop(uvc_stream_t *uvc_stream)
+{
+    uvc_still_t *still = uvc_stream->constant.still;
+    if (!still || !still->xfer || !UVC_ATOMIC_LOAD(still->capturing)) {
+        return;
+    }
+    // Bulk transfers cannot be cancelled, the endpoint is halted and flushed instead
+    const uint8_t bEndpointAddress = still->xfer->bEndpointAddress;
+    usb_host_endpoint_halt(uvc_stream->constant.dev_hdl, bEndpointAddress);
+    usb_host_endpoint_flush(uvc_stream->constant.dev_hdl, bEndpointAddress);
+    usb_host_endpoint_clear(uvc_stream->constant.dev_hdl, bEndpointAddress);
+}
+
+esp_err_t uvc_host_stream_still_config(uvc_host_stream_hdl_t stream_hdl, const uvc_host_still_config_t *still_config)
+{
+    UVC_CHECK(stream_hdl, ESP_ERR_INVALID_ARG);
+    uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
+    UVC_CHECK(!UVC_ATOMIC_LOAD(uvc_stream->dynamic.streaming), ESP_ERR_INVALID_STATE);
+    UVC_CHECK(!uvc_stream->constant.still || !UVC_ATOMIC_LOAD(uvc_stream->constant.still->capturing), ESP_ERR_INVALID_STATE);
+    UVC_CHECK(uvc_still_are_all_returned(uvc_stream), ESP_ERR_INVALID_STATE);
+    uvc_still_free(uvc_stream);
+    if (!still_config) {
+        return ESP_OK; // Still image capture disabled
+    }
+    UVC_CHECK(still_config->still_cb, ESP_ERR_INVALID_ARG);
+    UVC_CHECK(still_config->number_of_buffers > 0 && still_config->number_of_buffers <= UVC_STILL_MAX_BUFFERS, ESP_ERR_INVALID_ARG);
+
+    // Method 1 still images are regular video frames, there is nothing to configure
+    const uvc_desc_index_intf_t *vs_intf = uvc_stream->constant.vs_intf;
+    const uint8_t method = vs_intf->bStillCaptureMethod;
+    UVC_CHECK(method == 2 || method == 3, ESP_ERR_NOT_SUPPORTED);
+    UVC_CHECK(method == 2 || (vs_intf->still_ep_desc && USB_EP_DESC_GET_XFERTYPE(vs_intf->still_ep_desc) == USB_BM_ATTRIBUTES_XFER_BULK), ESP_ERR_NOT_SUPPORTED);
+
+    // Still image size patterns are listed in Still Image Frame descriptor of the current format
+    const uvc_format_desc_t *format_desc;
+    ESP_RETURN_ON_ERROR(
+        uvc_desc_index_get_frame_format_by_format(vs_intf, &uvc_stream->constant.vs_format, &format_desc, NULL),
+        TAG, "Could not find current format");
+    unsigned h_res = still_config->h_res;
+    unsigned v_res = still_config->v_res;
+    uint8_t bFrameIndex, bCompressionIndex;
+    ESP_RETURN_ON_ERROR(
+        uvc_desc_index_get_still_frame(vs_intf, format_desc->bFormatIndex, &h_res, &v_res, &bFrameIndex, &bCompressionIndex),
+        TAG, "Still image %ux%u is not offered", still_config->h_res, still_config->v_res);
+
+    uvc_vs_still_ctrl_t still_result;
+    ESP_RETURN_ON_ERROR(
+        uvc_host_still_control_negotiate(stream_hdl, format_desc->bFormatIndex, bFrameIndex, bCompressionIndex, &still_result),
+        TAG, "Failed to negotiate still image format");
+
+    // Allocate the still image context and its buffers
+    esp_err_t ret = ESP_OK;
+    uvc_still_t *still = UVC_CALLOC(CONTROL, 1, sizeof(uvc_still_t));
+    UVC_CHECK(still, ESP_ERR_NO_MEM);
+    uvc_stream->constant.still = still;
+    still->still_cb = still_config->still_cb;
+    still->method = method;
+    still->vs_format.format = uvc_stream->constant.vs_format.format;
+    still->vs_format.h_res = h_res;
+    still->vs_format.v_res = v_res;
+    still->video_format = uvc_stream->constant.vs_format;
+    still->dwMaxPayloadTransferSize = still_result.dwMaxPayloadTransferSize;
+    still->current_frame_id = 2;
+    still->payload_header_next = true;
+
+    const size_t buffer_size = still_config->buffer_size ? still_config->buffer_size : still_result.dwMaxVideoFrameSize;
+    const uint32_t buffer_caps = still_config->buffer_heap_caps ? still_config->buffer_heap_caps : MALLOC_CAP_DEFAULT;
+    still->frames = UVC_CALLOC(CONTROL, still_config->number_of_buffers, sizeof(uvc_host_frame_t));
+    ESP_GOTO_ON_FALSE(still->frames, ESP_ERR_NO_MEM, err, TAG, "Not enough memory for still image buffers");
+    still->alloc_frames = still_config->number_of_buffers;
+    for (int i = 0; i < still_config->number_of_buffers; i++) {
+        still->frames[i].data = UVC_MALLOC(BUFFER, buffer_size, buffer_caps);
+        ESP_GOTO_ON_FALSE(still->frames[i].data, ESP_ERR_NO_MEM, err, TAG, "Not enough memory for still image buffers %zu", buffer_size);
+        still->frames[i].data_buffer_len = buffer_size;
+        still->num_of_frames++;
+        still->empty_frames |= 1UL << i;
+    }
+
+    // Method 3: One URB services the Bulk still image endpoint
+    if (method == 3) {
+        const usb_ep_desc_t *ep_desc = vs_intf->still_ep_desc;
+        const size_t urb_size = usb_round_up_to_mps(UVC_STILL_URB_SIZE, USB_EP_DESC_GET_MPS(ep_desc));
+        ESP_GOTO_ON_ERROR(UVC_TRANSFER_ALLOC(urb_size, 0, &still->xfer), err, TAG, "Could not allocate still image URB");
+        still->xfer->device_handle = uvc_stream->constant.dev_hdl;
+        still->xfer->bEndpointAddress = ep_desc->bEndpointAddress;
+        still->xfer->callback = uvc_still_transfer_callback;
+        still->xfer->context = uvc_stream;
+        still->xfer->timeout_ms = 1000;
+        still->xfer->num_bytes = urb_size;
+    }
+
+    ESP_LOGD(TAG, "Still image %ux%u, method %d, %u buffers of %zu bytes", h_res, v_res, method, still->num_of_frames, buffer_size);
+    return ESP_OK;
+
+err:
+    uvc_still_free(uvc_stream);
+    return ret;
+}
+
+esp_err_t uvc_host_stream_still_trigger(uvc_host_stream_hdl_t stream_hdl)
+{
+    UVC_CHECK(stream_hdl, ESP_ERR_INVALID_ARG);
+    uvc_stream_t *uvc_stream = (uvc_stream_t *)stream_hdl;
+    uvc_still_t *still = uvc_stream->constant.still;
+    UVC_CHECK(still && UVC_ATOMIC_LOAD(uvc_stream->dynamic.streaming), ESP_ERR_INVALID_STATE);
+
+    // Still image was negotiated for the video format at configuration time
+    const uvc_host_stream_format_t *vs_format = &uvc_stream->constant.vs_format;
+    UVC_CHECK(vs_format->format == still->video_format.format &&
+              vs_format->h_res == still->video_format.h_res &&
+              vs_format->v_res == still->video_format.v_res, ESP_ERR_INVALID_STATE);
+
+    if (still->method == 2) {
+        return uvc_host_still_control_trigger(stream_hdl, UVC_VS_STILL_TRIGGER_TRANSMIT);
+    }
+
+    // Method 3: Only one still image can be received at a time
+    bool capturing = false;
+    UVC_CHECK(UVC_ATOMIC_COMPARE_EXCHANGE(still->capturing, capturing, true), ESP_ERR_INVALID_STATE);
+    still->payload_header_next = true;
+    esp_err_t ret;
+    ESP_GOTO_ON_ERROR(UVC_TRANSFER_SUBMIT(still->xfer), err, TAG, "Could not submit still image URB");
+    ret = uvc_host_still_control_trigger(stream_hdl, UVC_VS_STILL_TRIGGER_TRANSMIT_BULK);
+    if (ret != ESP_OK) {
+        uvc_still_stop(uvc_stream); // Retire the URB, its callback clears the capturing flag
+    }
+    return ret;
+
+err:
+    UVC_ATOMIC_STORE(still->capturing, false);
+    return ret;
+}
@@ -0,0 +1,165 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "usb/uvc_host.h"
+#include "usb/uac_host.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct uvc_av_capture_s *uvc_av_capture_hdl_t;
+
+/**
+ * @brief Type of captured buffer
+ */
+typedef enum {
+    UVC_AV_BUFFER_VIDEO = 0,                /**< Video frame of the UVC stream */
+    UVC_AV_BUFFER_AUDIO,                    /**< Chunk of PCM samples of the UAC stream */
+} uvc_av_buffer_type_t;
+
+/**
+ * @brief Captured buffer
+ *
+ * Presentation time of both streams is esp_timer time in microseconds, so buffers of both streams can be muxed as they come
+ */
+typedef struct {
+    uvc_av_buffer_type_t type;              /**< Video frame or audio chunk */
+    int64_t pts_us;                         /**< Presentation time: video: Start of Frame reception, audio: first sample */
+    const uint8_t *data;                    /**< Frame data or PCM samples in the format of the device. NULL for zero-copy frames */
+    size_t len;                             /**< Data length in bytes */
+    const uvc_host_frame_t *frame;          /**< Video only: The frame, e.g. for its format or segments in zero-copy mode */
+    uint32_t samples;                       /**< Audio only: Number of samples per channel */
+} uvc_av_buffer_t;
+
+/**
+ * @brief Buffer callback type
+ *
+ * Called from the delivery task with each buffer of both streams in order of presentation time.
+ * The buffer is released when the callback returns: the frame goes back to the UVC driver, the audio chunk is reused.
+ *
+ * @param[in] av       A/V capture handle
+ * @param[in] buffer   Captured buffer
+ * @param[in] user_ctx User's argument
+ */
+typedef void (*uvc_av_capture_buffer_cb_t)(uvc_av_capture_hdl_t av, const uvc_av_buffer_t *buffer, void *user_ctx);
+
+/**
+ * @brief Configuration of synchronized A/V capture
+ */
+typedef struct {
+    const uvc_host_stream_config_t *video;      /**< Video stream. frame_cb and user_ctx are replaced, slice_cb must be NULL */
+    const uac_host_device_config_t *audio;      /**< Audio RX interface of the same device, opened by VID and PID of the video stream.
+                                                     addr is used if they are 0. rx_data_cb is replaced, callback gets callback_arg */
+    const uac_host_stream_config_t *audio_stream; /**< Audio stream format. PCM conversion is not supported */
+    uvc_av_capture_buffer_cb_t buffer_cb;       /**< Buffer callback, must not be NULL */
+    void *user_ctx;                             /**< User's argument passed to buffer_cb */
+    uint32_t audio_chunk_ms;                    /**< Duration of one audio chunk. 0: 20 ms */
+    int audio_chunks;                           /**< Number of audio chunks. 0: 8 */
+    uint32_t max_skew_ms;                       /**< Longest delay of a buffer behind the other stream. A buffer is delivered when
+                                                     the other stream passes its presentation time, or after this delay. 0: 100 ms */
+    int32_t audio_offset_us;                    /**< Added to presentation time of audio, for constant latency of the device's audio path */
+    struct {
+        size_t stack_size;                      /**< Stack size of the delivery task. 0: 4096 bytes */
+        unsigned priority;                      /**< Priority of the delivery task. 0: 2 */
+        BaseType_t core_id;                     /**< Core of the delivery task or tskNO_AFFINITY */
+    } task;
+} uvc_av_capture_config_t;
+
+/**
+ * @brief Statistics of A/V capture
+ *
+ * The counters are accumulated since the capture was opened or since last uvc_av_capture_reset_stats() call
+ */
+typedef struct {
+    uint32_t video_frames;                  /**< Number of video frames delivered */
+    uint32_t audio_chunks;                  /**< Number of audio chunks delivered */
+    uint32_t video_frames_dropped;          /**< Number of video frames dropped, the delivery task was behind */
+    uint32_t audio_bytes_dropped;           /**< Number of audio bytes dropped, all chunks were waiting for delivery */
+    uint32_t late_buffers;                  /**< Number of buffers delivered after a buffer of later presentation time, beyond max_skew_ms */
+    uint32_t audio_resyncs;                 /**< Number of times audio time was realigned to esp_timer, after lost packets or clock drift */
+} uvc_av_capture_stats_t;
+
+/**
+ * @brief Open video and audio streams of one device
+ *
+ * @param[in]  config  Configuration
+ * @param[in]  timeout Timeout of waiting for the video device in FreeRTOS ticks
+ * @param[out] av_ret  A/V capture handle
+ * @return
+ *   - ESP_OK:                 Opened
+ *   - ESP_ERR_INVALID_ARG:    Invalid configuration
+ *   - ESP_ERR_NOT_SUPPORTED:  The audio interface has no alternate setting of the requested format
+ *   - ESP_ERR_NO_MEM:         Not enough memory
+ *   - Other:                  Error of uvc_host_stream_open() or uac_host_device_open()
+ */
+esp_err_t uvc_av_capture_open(const uvc_av_capture_config_t *config, int timeout, uvc_av_capture_hdl_t *av_ret);
+
+/**
+ * @brief Close both streams
+ *
+ * Buffers waiting for delivery are released.
+ *
+ * @param[in] av A/V capture handle
+ * @return
+ *   - ESP_OK:                 Closed
+ *   - ESP_ERR_INVALID_ARG:    av is NULL
+ */
+esp_err_t uvc_av_capture_close(uvc_av_capture_hdl_t av);
+
+/**
+ * @brief Start both streams
+ *
+ * Audio is started first, so the first video frame is never delivered before the audio of its time.
+ *
+ * @param[in] av A/V capture handle
+ * @return
+ *   - ESP_OK:                 Started
+ *   - ESP_ERR_INVALID_ARG:    av is NULL
+ *   - Other:                  Error of uac_host_device_start() or uvc_host_stream_start()
+ */
+esp_err_t uvc_av_capture_start(uvc_av_capture_hdl_t av);
+
+/**
+ * @brief Stop both streams
+ *
+ * @param[in] av A/V capture handle
+ * @return
+ *   - ESP_OK:                 Stopped
+ *   - ESP_ERR_INVALID_ARG:    av is NULL
+ */
+esp_err_t uvc_av_capture_stop(uvc_av_capture_hdl_t av);
+
+/**
+ * @brief Get statistics of A/V capture
+ *
+ * @param[in]  av        A/V capture handle
+ * @param[out] stats_ret Statistics
+ * @return
+ *   - ESP_OK:                 Success
+ *   - ESP_ERR_INVALID_ARG:    NULL argument
+ */
+esp_err_t uvc_av_capture_get_stats(uvc_av_capture_hdl_t av, uvc_av_capture_stats_t *stats_ret);
+
+/**
+ * @brief Reset statistics of A/V capture
+ *
+ * @param[in] av A/V capture handle
+ * @return
+ *   - ESP_OK:                 Success
+ *   - ESP_ERR_INVALID_ARG:    av is NULL
+ */
+esp_err_t uvc_av_capture_reset_stats(uvc_av_capture_hdl_t av);
+
+#ifdef __cplusplus
+}
+#endif
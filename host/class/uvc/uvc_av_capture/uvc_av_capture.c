@@ -0,0 +1,452 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "usb/uvc_av_capture.h"
+
+#define AUDIO_CHUNKS_MAX        (32)
+#define AUDIO_RESYNC_US         (4000)  // Audio time is realigned when it differs from arrival time by more than this
+
+static const char *TAG = "uvc_av_capture";
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    uint32_t samples;
+    int64_t pts_us;
+} audio_chunk_t;
+
+typedef struct {
+    uvc_host_frame_t *frame;
+    int64_t pts_us;
+} video_msg_t;
+
+typedef struct uvc_av_capture_s {
+    uvc_av_capture_config_t config;
+    uvc_host_stream_config_t video_config;
+    uac_host_device_config_t audio_config;
+    uac_host_stream_config_t audio_stream;
+    uvc_host_stream_hdl_t video;
+    uac_host_device_handle_t audio;
+    QueueHandle_t video_q;                  // Frames waiting for delivery
+    QueueHandle_t audio_q;                  // Full chunks waiting for delivery
+    QueueHandle_t free_chunks;
+    audio_chunk_t chunks[AUDIO_CHUNKS_MAX];
+    size_t chunk_size;
+    TaskHandle_t task;
+    SemaphoreHandle_t task_done;
+    volatile bool stop_task;
+
+    // Audio time, accessed only from RX data callback and while the audio stream is stopped
+    struct {
+        uint32_t frame_bytes;               // Bytes of one sample of all channels
+        audio_chunk_t *chunk;               // Chunk being filled
+        uint64_t samples;                   // Samples received since start
+        uint64_t anchor_samples;            // Sample aligned to anchor_us
+        int64_t anchor_us;                  // 0: Not aligned yet
+    } audio_time;
+
+    portMUX_TYPE stats_lock;
+    uvc_av_capture_stats_t stats;
+} uvc_av_capture_t;
+
+static inline int64_t audio_sample_time(const uvc_av_capture_t *av, uint64_t sample)
+{
+    return av->audio_time.anchor_us + (int64_t)(sample - av->audio_time.anchor_samples) * 1000000 / av->audio_stream.sample_freq;
+}
+
+static void audio_rx(uac_host_device_handle_t handle, const uac_host_rx_span_t *spans, size_t num_spans, void *arg)
+{
+    uvc_av_capture_t *av = (uvc_av_capture_t *)arg;
+    const uint32_t frame_bytes = av->audio_time.frame_bytes;
+    size_t len = 0;
+    for (size_t i = 0; i < num_spans; i++) {
+        len += spans[i].len;
+    }
+    if (len == 0) {
+        return;
+    }
+
+    // Samples are counted on the device clock, aligned to esp_timer by arrival time of the first sample of each transfer.
+    // Scheduling jitter of the callback is ignored, lost packets and clock drift move the alignment
+    const int64_t arrival_us = esp_timer_get_time() - (int64_t)(len / frame_bytes) * 1000000 / av->audio_stream.sample_freq;
+    const int64_t expected_us = audio_sample_time(av, av->audio_time.samples);
+    if (av->audio_time.anchor_us == 0 || llabs(arrival_us - expected_us) > AUDIO_RESYNC_US) {
+        if (av->audio_time.anchor_us != 0) {
+            portENTER_CRITICAL(&av->stats_lock);
+            av->stats.audio_resyncs++;
+            portEXIT_CRITICAL(&av->stats_lock);
+        }
+        av->audio_time.anchor_us = arrival_us;
+        av->audio_time.anchor_samples = av->audio_time.samples;
+    }
+
+    uint32_t dropped = 0;
+    for (size_t i = 0; i < num_spans; i++) {
+        const uint8_t *data = spans[i].data;
+        size_t remaining = spans[i].len;
+        while (remaining) {
+            audio_chunk_t *chunk = av->audio_time.chunk;
+            if (chunk == NULL) {
+                if (xQueueReceive(av->free_chunks, &chunk, 0) != pdTRUE) {
+                    dropped += remaining;
+                    av->audio_time.samples += remaining / frame_bytes;
+                    break;
+                }
+                chunk->len = 0;
+                chunk->pts_us = audio_sample_time(av, av->audio_time.samples) + av->config.audio_offset_us;
+                av->audio_time.chunk = chunk;
+            }
+            const size_t copy = MIN(remaining, av->chunk_size - chunk->len);
+            memcpy(chunk->data + chunk->len, data, copy);
+            chunk->len += copy;
+            data += copy;
+            remaining -= copy;
+            av->audio_time.samples += copy / frame_bytes;
+            if (chunk->len == av->chunk_size) {
+                chunk->samples = chunk->len / frame_bytes;
+                xQueueSend(av->audio_q, &chunk, 0); // Never full, it holds all chunks
+                av->audio_time.chunk = NULL;
+                xTaskNotifyGive(av->task);
+            }
+        }
+    }
+    if (dropped) {
+        portENTER_CRITICAL(&av->stats_lock);
+        av->stats.audio_bytes_dropped += dropped;
+        portEXIT_CRITICAL(&av->stats_lock);
+    }
+}
+
+static bool video_frame(const uvc_host_frame_t *frame, void *user_ctx)
+{
+    uvc_av_capture_t *av = (uvc_av_capture_t *)user_ctx;
+    const video_msg_t msg = {
+        .frame = (uvc_host_frame_t *)frame,
+        .pts_us = frame->timestamp.host_sof_us,
+    };
+    if (xQueueSend(av->video_q, &msg, 0) != pdTRUE) {
+        portENTER_CRITICAL(&av->stats_lock);
+        av->stats.video_frames_dropped++;
+        portEXIT_CRITICAL(&av->stats_lock);
+        return true;
+    }
+    xTaskNotifyGive(av->task);
+    return false;
+}
+
+static void video_event(const uvc_host_stream_event_data_t *event, void *user_ctx)
+{
+    const uvc_av_capture_t *av = (const uvc_av_capture_t *)user_ctx;
+    if (av->config.video->event_cb) {
+        av->config.video->event_cb(event, av->config.video->user_ctx);
+    }
+}
+
+static void audio_event(uac_host_device_handle_t handle, const uac_host_device_event_t event, void *arg)
+{
+    const uvc_av_capture_t *av = (const uvc_av_capture_t *)arg;
+    if (av->config.audio->callback) {
+        av->config.audio->callback(handle, event, av->config.audio->callback_arg);
+    }
+}
+
+static void deliver_video(uvc_av_capture_t *av, const video_msg_t *msg)
+{
+    const uvc_av_buffer_t buffer = {
+        .type = UVC_AV_BUFFER_VIDEO,
+        .pts_us = msg->pts_us,
+        .data = msg->frame->data,
+        .len = msg->frame->data_len,
+        .frame = msg->frame,
+    };
+    av->config.buffer_cb(av, &buffer, av->config.user_ctx);
+    uvc_host_frame_return(av->video, msg->frame);
+}
+
+static void deliver_audio(uvc_av_capture_t *av, audio_chunk_t *chunk)
+{
+    const uvc_av_buffer_t buffer = {
+        .type = UVC_AV_BUFFER_AUDIO,
+        .pts_us = chunk->pts_us,
+        .data = chunk->data,
+        .len = chunk->len,
+        .samples = chunk->samples,
+    };
+    av->config.buffer_cb(av, &buffer, av->config.user_ctx);
+    xQueueSend(av->free_chunks, &chunk, 0);
+}
+
+/**
+ * @brief Merge both streams in order of presentation time
+ *
+ * Each stream is in order by itself. The oldest head of the two is delivered once the other stream has
+ * a buffer too, or when max_skew_ms passed since its presentation time.
+ */
+static void delivery_task(void *arg)
+{
+    uvc_av_capture_t *av = (uvc_av_capture_t *)arg;
+    const int64_t max_skew_us = (int64_t)av->config.max_skew_ms * 1000;
+    int64_t last_pts_us = INT64_MIN;
+
+    while (!av->stop_task) {
+        video_msg_t video;
+        audio_chunk_t *chunk;
+        const bool has_video = xQueuePeek(av->video_q, &video, 0) == pdTRUE;
+        const bool has_audio = xQueuePeek(av->audio_q, &chunk, 0) == pdTRUE;
+        if (!has_video && !has_audio) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        bool video_first;
+        if (has_video && has_audio) {
+            video_first = video.pts_us <= chunk->pts_us;
+        } else {
+            const int64_t pts_us = has_video ? video.pts_us : chunk->pts_us;
+            const int64_t wait_us = pts_us + max_skew_us - esp_timer_get_time();
+            if (wait_us > 0) {
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_us / 1000) + 1);
+                continue;
+            }
+            video_first = has_video;
+        }
+
+        const int64_t pts_us = video_first ? video.pts_us : chunk->pts_us;
+        portENTER_CRITICAL(&av->stats_lock);
+        if (pts_us < last_pts_us) {
+            av->stats.late_buffers++;
+        }
+        if (video_first) {
+            av->stats.video_frames++;
+        } else {
+            av->stats.audio_chunks++;
+        }
+        portEXIT_CRITICAL(&av->stats_lock);
+        last_pts_us = MAX(last_pts_us, pts_us);
+
+        if (video_first) {
+            xQueueReceive(av->video_q, &video, 0);
+            deliver_video(av, &video);
+        } else {
+            xQueueReceive(av->audio_q, &chunk, 0);
+            deliver_audio(av, chunk);
+        }
+    }
+
+    xSemaphoreGive(av->task_done);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t audio_frame_bytes(uvc_av_capture_t *av)
+{
+    uac_host_dev_info_t info;
+    ESP_RETURN_ON_ERROR(uac_host_get_device_info(av->audio, &info), TAG, "Audio device info failed");
+    ESP_RETURN_ON_FALSE(info.type == UAC_STREAM_RX, ESP_ERR_INVALID_ARG, TAG, "Audio interface is not RX");
+    for (uint8_t alt = 1; alt <= info.iface_alt_num; alt++) {
+        uac_host_dev_alt_param_t param;
+        if (uac_host_get_device_alt_param(av->audio, alt, &param) == ESP_OK &&
+                param.channels == av->audio_stream.channels && param.bit_resolution == av->audio_stream.bit_resolution) {
+            av->audio_time.frame_bytes = param.channels * param.subframe_size;
+            return ESP_OK;
+        }
+    }
+    ESP_LOGE(TAG, "No audio alternate setting of %u channels, %u bits", av->audio_stream.channels, av->audio_stream.bit_resolution);
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static esp_err_t audio_chunks_allocate(uvc_av_capture_t *av)
+{
+    const uint32_t samples = (uint64_t)av->audio_stream.sample_freq * av->config.audio_chunk_ms / 1000;
+    av->chunk_size = MAX(samples, 1) * av->audio_time.frame_bytes;
+    for (int i = 0; i < av->config.audio_chunks; i++) {
+        audio_chunk_t *chunk = &av->chunks[i];
+        chunk->data = malloc(av->chunk_size);
+        ESP_RETURN_ON_FALSE(chunk->data, ESP_ERR_NO_MEM, TAG, "Not enough memory for audio chunks");
+        xQueueSend(av->free_chunks, &chunk, 0);
+    }
+    return ESP_OK;
+}
+
+static void av_free(uvc_av_capture_t *av)
+{
+    if (av->video) {
+        uvc_host_stream_close(av->video);
+    }
+    if (av->audio) {
+        uac_host_device_close(av->audio);
+    }
+    for (int i = 0; i < AUDIO_CHUNKS_MAX; i++) {
+        free(av->chunks[i].data);
+    }
+    if (av->video_q) {
+        vQueueDelete(av->video_q);
+    }
+    if (av->audio_q) {
+        vQueueDelete(av->audio_q);
+    }
+    if (av->free_chunks) {
+        vQueueDelete(av->free_chunks);
+    }
+    if (av->task_done) {
+        vSemaphoreDelete(av->task_done);
+    }
+    free(av);
+}
+
+esp_err_t uvc_av_capture_open(const uvc_av_capture_config_t *config, int timeout, uvc_av_capture_hdl_t *av_ret)
+{
+    esp_err_t ret;
+    ESP_RETURN_ON_FALSE(config && av_ret && config->video && config->audio && config->audio_stream && config->buffer_cb,
+                        ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(!config->video->slice_cb, ESP_ERR_INVALID_ARG, TAG, "Slice mode is not supported");
+    ESP_RETURN_ON_FALSE(config->audio_stream->pcm_format == UAC_HOST_PCM_FORMAT_DEVICE && config->audio_stream->sample_freq,
+                        ESP_ERR_INVALID_ARG, TAG, "Invalid audio stream format");
+    ESP_RETURN_ON_FALSE(config->audio_chunks >= 0 && config->audio_chunks <= AUDIO_CHUNKS_MAX,
+                        ESP_ERR_INVALID_ARG, TAG, "Invalid number of audio chunks");
+
+    uvc_av_capture_t *av = calloc(1, sizeof(uvc_av_capture_t));
+    ESP_RETURN_ON_FALSE(av, ESP_ERR_NO_MEM, TAG, "Not enough memory");
+    av->config = *config;
+    if (av->config.audio_chunk_ms == 0) {
+        av->config.audio_chunk_ms = 20;
+    }
+    if (av->config.audio_chunks == 0) {
+        av->config.audio_chunks = 8;
+    }
+    if (av->config.max_skew_ms == 0) {
+        av->config.max_skew_ms = 100;
+    }
+    if (av->config.task.stack_size == 0) {
+        av->config.task.stack_size = 4096;
+    }
+    if (av->config.task.priority == 0) {
+        av->config.task.priority = 2;
+    }
+    portMUX_INITIALIZE(&av->stats_lock);
+
+    const int number_of_frames = MAX(config->video->advanced.number_of_frame_buffers, 1);
+    av->video_q = xQueueCreate(number_of_frames, sizeof(video_msg_t));
+    av->audio_q = xQueueCreate(av->config.audio_chunks, sizeof(audio_chunk_t *));
+    av->free_chunks = xQueueCreate(av->config.audio_chunks, sizeof(audio_chunk_t *));
+    av->task_done = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(av->video_q && av->audio_q && av->free_chunks && av->task_done, ESP_ERR_NO_MEM, fail, TAG, "Not enough memory");
+
+    // The task is created first, callbacks of both streams notify it
+    ESP_GOTO_ON_FALSE(xTaskCreatePinnedToCore(delivery_task, "uvc_av_capture", av->config.task.stack_size, av,
+                                              av->config.task.priority, &av->task, av->config.task.core_id) == pdPASS,
+                      ESP_ERR_NO_MEM, fail, TAG, "Not enough memory for task");
+
+    av->video_config = *config->video;
+    av->video_config.event_cb = video_event;
+    av->video_config.frame_cb = video_frame;
+    av->video_config.user_ctx = av;
+    ESP_GOTO_ON_ERROR(uvc_host_stream_open(&av->video_config, timeout, &av->video), fail, TAG, "Video stream open failed");
+
+    av->audio_config = *config->audio;
+    av->audio_config.callback = audio_event;
+    av->audio_config.callback_arg = av;
+    av->audio_config.rx_data_cb = audio_rx;
+    av->audio_config.buffer_size = 0;
+    av->audio_stream = *config->audio_stream;
+    const uint16_t vid = config->video->usb.vid;
+    const uint16_t pid = config->video->usb.pid;
+    if (vid && pid) {
+        ret = uac_host_device_open_with_vid_pid(vid, pid, &av->audio_config, &av->audio);
+    } else {
+        ret = uac_host_device_open(&av->audio_config, &av->audio);
+    }
+    ESP_GOTO_ON_ERROR(ret, fail, TAG, "Audio device open failed");
+    ESP_GOTO_ON_ERROR(audio_frame_bytes(av), fail, TAG, "Audio format not supported");
+    ESP_GOTO_ON_ERROR(audio_chunks_allocate(av), fail, TAG, "Audio chunks allocation failed");
+
+    *av_ret = av;
+    return ESP_OK;
+
+fail:
+    if (av->task) {
+        av->stop_task = true;
+        xTaskNotifyGive(av->task);
+        xSemaphoreTake(av->task_done, portMAX_DELAY);
+    }
+    av_free(av);
+    return ret;
+}
+
+esp_err_t uvc_av_capture_close(uvc_av_capture_hdl_t av)
+{
+    ESP_RETURN_ON_FALSE(av, ESP_ERR_INVALID_ARG, TAG, "av can't be NULL");
+    uvc_av_capture_stop(av);
+
+    av->stop_task = true;
+    xTaskNotifyGive(av->task);
+    xSemaphoreTake(av->task_done, portMAX_DELAY);
+
+    // Frames waiting for delivery go back to the driver before the stream is closed
+    video_msg_t video;
+    while (xQueueReceive(av->video_q, &video, 0) == pdTRUE) {
+        uvc_host_frame_return(av->video, video.frame);
+    }
+    av_free(av);
+    return ESP_OK;
+}
+
+esp_err_t uvc_av_capture_start(uvc_av_capture_hdl_t av)
+{
+    ESP_RETURN_ON_FALSE(av, ESP_ERR_INVALID_ARG, TAG, "av can't be NULL");
+    av->audio_time.samples = 0;
+    av->audio_time.anchor_samples = 0;
+    av->audio_time.anchor_us = 0;
+    ESP_RETURN_ON_ERROR(uac_host_device_start(av->audio, &av->audio_stream), TAG, "Audio stream start failed");
+    const esp_err_t ret = uvc_host_stream_start(av->video);
+    if (ret != ESP_OK) {
+        uac_host_device_stop(av->audio);
+        ESP_LOGE(TAG, "Video stream start failed");
+    }
+    return ret;
+}
+
+esp_err_t uvc_av_capture_stop(uvc_av_capture_hdl_t av)
+{
+    ESP_RETURN_ON_FALSE(av, ESP_ERR_INVALID_ARG, TAG, "av can't be NULL");
+    uvc_host_stream_stop(av->video);
+    uac_host_device_stop(av->audio);
+
+    // The partial chunk is dropped, time of the next start begins with a new chunk
+    if (av->audio_time.chunk) {
+        xQueueSend(av->free_chunks, &av->audio_time.chunk, 0);
+        av->audio_time.chunk = NULL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t uvc_av_capture_get_stats(uvc_av_capture_hdl_t av, uvc_av_capture_stats_t *stats_ret)
+{
+    ESP_RETURN_ON_FALSE(av && stats_ret, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    portENTER_CRITICAL(&av->stats_lock);
+    *stats_ret = av->stats;
+    portEXIT_CRITICAL(&av->stats_lock);
+    return ESP_OK;
+}
+
+esp_err_t uvc_av_capture_reset_stats(uvc_av_capture_hdl_t av)
+{
+    ESP_RETURN_ON_FALSE(av, ESP_ERR_INVALID_ARG, TAG, "av can't be NULL");
+    portENTER_CRITICAL(&av->stats_lock);
+    memset(&av->stats, 0, sizeof(av->stats));
+    portEXIT_CRITICAL(&av->stats_lock);
+    return ESP_OK;
+}
@@ -0,0 +1,182 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <cstdlib>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "usb/uvc_color_convert.h"
+
+static uint8_t clamp(int value)
+{
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+// Per-pixel formula of the original camera_display example
+static uint16_t reference_pixel(const std::vector<uint8_t> &yuy2, unsigned width, unsigned x, unsigned y)
+{
+    const size_t pair = (y * width + (x & ~1u)) * 2;
+    const int c = yuy2[pair + (x & 1) * 2] - 16;
+    const int d = yuy2[pair + 1] - 128;
+    const int e = yuy2[pair + 3] - 128;
+    const int r = clamp((298 * c + 409 * e + 128) >> 8);
+    const int g = clamp((298 * c - 100 * d - 208 * e + 128) >> 8);
+    const int b = clamp((298 * c + 516 * d + 128) >> 8);
+    return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+}
+
+static std::vector<uint8_t> test_frame(unsigned width, unsigned height)
+{
+    std::vector<uint8_t> yuy2(width * height * 2);
+    srand(1);
+    for (auto &byte : yuy2) {
+        byte = rand();
+    }
+    // All combinations of U and V with extreme Y values, covering the whole range of the saturation tables
+    for (size_t i = 0; i < 256 * 256 && i * 4 + 3 < yuy2.size(); i++) {
+        yuy2[i * 4 + 0] = (i & 1) ? 255 : 0;
+        yuy2[i * 4 + 1] = i & 0xFF;
+        yuy2[i * 4 + 2] = (i & 1) ? 0 : 255;
+        yuy2[i * 4 + 3] = i >> 8;
+    }
+    return yuy2;
+}
+
+SCENARIO("YUY2 to RGB565 conversion", "[yuy2]")
+{
+    const unsigned width = 640;
+    const unsigned height = 480;
+    const std::vector<uint8_t> yuy2 = test_frame(width, height);
+
+    GIVEN("Whole frame") {
+        std::vector<uint16_t> rgb565(width * height);
+        uvc_color_convert_config_t config = {};
+        config.src.width = width;
+        config.src.height = height;
+
+        THEN("Output matches the reference formula") {
+            REQUIRE(ESP_OK == uvc_color_convert_yuy2_to_rgb565(yuy2.data(), rgb565.data(), &config));
+            for (unsigned y = 0; y < height; y++) {
+                for (unsigned x = 0; x < width; x++) {
+                    REQUIRE(rgb565[y * width + x] == reference_pixel(yuy2, width, x, y));
+                }
+            }
+        }
+
+        THEN("Swapped output is big-endian") {
+            config.swap_bytes = true;
+            REQUIRE(ESP_OK == uvc_color_convert_yuy2_to_rgb565(yuy2.data(), rgb565.data(), &config));
+            for (unsigned i = 0; i < width * height; i += 97) {
+                const uint16_t px = reference_pixel(yuy2, width, i % width, i / width);
+                REQUIRE(rgb565[i] == (uint16_t)((px >> 8) | (px << 8)));
+            }
+        }
+    }
+
+    GIVEN("Crop rectangle at odd column") {
+        const unsigned crop_x = 101, crop_y = 33, crop_width = 201, crop_height = 100;
+        const unsigned stride = 256;
+        std::vector<uint16_t> rgb565(stride * crop_height, 0xDEAD);
+        uvc_color_convert_config_t config = {};
+        config.src.width = width;
+        config.src.height = height;
+        config.crop.x = crop_x;
+        config.crop.y = crop_y;
+        config.crop.width = crop_width;
+        config.crop.height = crop_height;
+        config.dst.stride = stride;
+
+        THEN("Output is the rectangle, pixels beyond the output width are not written") {
+            REQUIRE(ESP_OK == uvc_color_convert_yuy2_to_rgb565(yuy2.data(), rgb565.data(), &config));
+            for (unsigned y = 0; y < crop_height; y++) {
+                for (unsigned x = 0; x < crop_width; x++) {
+                    REQUIRE(rgb565[y * stride + x] == reference_pixel(yuy2, width, crop_x + x, crop_y + y));
+                }
+                REQUIRE(rgb565[y * stride + crop_width] == 0xDEAD);
+            }
+        }
+    }
+
+    GIVEN("Frame scaled to half") {
+        std::vector<uint16_t> rgb565(width / 2 * height / 2);
+        uvc_color_convert_config_t config = {};
+        config.src.width = width;
+        config.src.height = height;
+        config.dst.width = width / 2;
+        config.dst.height = height / 2;
+
+        THEN("Each output pixel is the source pixel at its center") {
+            REQUIRE(ESP_OK == uvc_color_convert_yuy2_to_rgb565(yuy2.data(), rgb565.data(), &config));
+            for (unsigned y = 0; y < height / 2; y++) {
+                for (unsigned x = 0; x < width / 2; x++) {
+                    REQUIRE(rgb565[y * width / 2 + x] == reference_pixel(yuy2, width, x * 2 + 1, y * 2 + 1));
+                }
+            }
+        }
+    }
+
+    GIVEN("Conversion in strips") {
+        std::vector<uint16_t> frame(width * height);
+        std::vector<uint16_t> strip_a(width * 64), strip_b(width * 64);
+        uint16_t *const strips[2] = {strip_a.data(), strip_b.data()};
+        uvc_color_convert_config_t config = {};
+        config.src.width = width;
+        config.src.height = height;
+        REQUIRE(ESP_OK == uvc_color_convert_yuy2_to_rgb565(yuy2.data(), frame.data(), &config));
+
+        struct strip_ctx_t {
+            const std::vector<uint16_t> *frame;
+            const uint16_t *last_strip;
+            unsigned next_line;
+        } ctx = {&frame, nullptr, 0};
+        auto strip_cb = [](const uint16_t *strip, unsigned first_line, unsigned num_lines, void *user_ctx) -> esp_err_t {
+            auto *ctx = static_cast<strip_ctx_t *>(user_ctx);
+            if (first_line != ctx->next_line || strip == ctx->last_strip) {
+                return ESP_FAIL;
+            }
+            for (unsigned i = 0; i < num_lines * width; i++) {
+                if (strip[i] != (*ctx->frame)[first_line * width + i]) {
+                    return ESP_FAIL;
+                }
+            }
+            ctx->last_strip = strip;
+            ctx->next_line += num_lines;
+            return ESP_OK;
+        };
+
+        THEN("Strips alternate between buffers and cover the frame") {
+            REQUIRE(ESP_OK == uvc_color_convert_yuy2_to_rgb565_strips(yuy2.data(), strips, 50, &config, strip_cb, &ctx));
+            REQUIRE(ctx.next_line == height);
+        }
+
+        THEN("Error of strip callback stops the conversion") {
+            ctx.next_line = 1;
+            REQUIRE(ESP_FAIL == uvc_color_convert_yuy2_to_rgb565_strips(yuy2.data(), strips, 50, &config, strip_cb, &ctx));
+        }
+
+        THEN("Lines out of the output are rejected") {
+            REQUIRE(ESP_OK == uvc_color_convert_yuy2_to_rgb565_lines(yuy2.data(), strip_a.data(), &config, height - 1, 1));
+            REQUIRE(ESP_ERR_INVALID_ARG == uvc_color_convert_yuy2_to_rgb565_lines(yuy2.data(), strip_a.data(), &config, height - 1, 2));
+        }
+    }
+
+    GIVEN("Invalid configuration") {
+        std::vector<uint16_t> rgb565(width * height);
+        uvc_color_convert_config_t config = {};
+        config.src.width = width - 1; // Odd width
+        config.src.height = height;
+        REQUIRE(ESP_ERR_INVALID_ARG == uvc_color_convert_yuy2_to_rgb565(yuy2.data(), rgb565.data(), &config));
+
+        config.src.width = width;
+        config.crop.x = 600;
+        config.crop.width = 41;
+        REQUIRE(ESP_ERR_INVALID_ARG == uvc_color_convert_yuy2_to_rgb565(yuy2.data(), rgb565.data(), &config));
+
+        config.crop.width = 40;
+        config.dst.stride = 39;
+        REQUIRE(ESP_ERR_INVALID_ARG == uvc_color_convert_yuy2_to_rgb565(yuy2.data(), rgb565.data(), &config));
+    }
+}
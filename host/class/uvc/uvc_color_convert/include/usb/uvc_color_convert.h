@@ -0,0 +1,105 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Configuration of YUY2 to RGB565 conversion
+ *
+ * The source rectangle is cropped from the YUY2 frame and scaled to the output size by nearest neighbour,
+ * in the same pass as the color conversion.
+ */
+typedef struct {
+    struct {
+        unsigned width;                 /**< Width of YUY2 frame in pixels, must be even */
+        unsigned height;                /**< Height of YUY2 frame in pixels */
+    } src;
+    struct {
+        unsigned x;                     /**< Left edge of the source rectangle */
+        unsigned y;                     /**< Top edge of the source rectangle */
+        unsigned width;                 /**< Width of the source rectangle. 0: Whole frame */
+        unsigned height;                /**< Height of the source rectangle. 0: Whole frame */
+    } crop;
+    struct {
+        unsigned width;                 /**< Width of the output in pixels. 0: Width of the source rectangle */
+        unsigned height;                /**< Height of the output in pixels. 0: Height of the source rectangle */
+        unsigned stride;                /**< Pixels from one output line to the next, e.g. to draw into part of a larger frame buffer. 0: Output width */
+    } dst;
+    bool swap_bytes;                    /**< Output RGB565 big-endian, as expected by most SPI and I80 LCD panels */
+} uvc_color_convert_config_t;
+
+/**
+ * @brief Strip callback of uvc_color_convert_yuy2_to_rgb565_strips()
+ *
+ * The callback sends the strip to display, e.g. by esp_lcd_panel_draw_bitmap(). The next strip is converted into
+ * the other buffer while this one is being sent, the callback must return only after the strip of its previous call was sent.
+ *
+ * @param[in] strip      Converted lines
+ * @param[in] first_line Output line of the first line in the strip
+ * @param[in] num_lines  Number of lines in the strip
+ * @param[in] user_ctx   User's argument
+ * @return ESP_OK to continue, error to stop the conversion
+ */
+typedef esp_err_t (*uvc_color_strip_callback_t)(const uint16_t *strip, unsigned first_line, unsigned num_lines, void *user_ctx);
+
+/**
+ * @brief Convert YUY2 frame to RGB565
+ *
+ * @param[in]  yuy2   YUY2 frame
+ * @param[out] rgb565 Output buffer of dst.height lines of dst.stride pixels
+ * @param[in]  config Conversion configuration
+ * @return
+ *   - ESP_OK:                 Converted
+ *   - ESP_ERR_INVALID_ARG:    NULL argument or invalid configuration
+ */
+esp_err_t uvc_color_convert_yuy2_to_rgb565(const uint8_t *yuy2, uint16_t *rgb565, const uvc_color_convert_config_t *config);
+
+/**
+ * @brief Convert part of the output lines of YUY2 frame to RGB565
+ *
+ * Converts output lines first_line to first_line + num_lines - 1 into the beginning of rgb565,
+ * e.g. into a small DMA capable buffer sent to LCD before the next lines are converted.
+ *
+ * @param[in]  yuy2       YUY2 frame
+ * @param[out] rgb565     Output buffer of num_lines lines of dst.stride pixels
+ * @param[in]  config     Conversion configuration
+ * @param[in]  first_line First output line
+ * @param[in]  num_lines  Number of output lines
+ * @return
+ *   - ESP_OK:                 Converted
+ *   - ESP_ERR_INVALID_ARG:    NULL argument, invalid configuration or lines out of the output
+ */
+esp_err_t uvc_color_convert_yuy2_to_rgb565_lines(const uint8_t *yuy2, uint16_t *rgb565, const uvc_color_convert_config_t *config,
+                                                 unsigned first_line, unsigned num_lines);
+
+/**
+ * @brief Convert YUY2 frame to RGB565 in strips, alternating between two strip buffers
+ *
+ * @param[in] yuy2        YUY2 frame
+ * @param[in] strip_buf   Two buffers of strip_lines lines of dst.stride pixels, e.g. DMA capable buffers in internal RAM
+ * @param[in] strip_lines Number of output lines in one strip, the last strip can be shorter
+ * @param[in] config      Conversion configuration
+ * @param[in] strip_cb    Called with each converted strip
+ * @param[in] user_ctx    User's argument passed to strip_cb
+ * @return
+ *   - ESP_OK:                 Converted
+ *   - ESP_ERR_INVALID_ARG:    NULL argument or invalid configuration
+ *   - Other:                  Error returned by strip_cb
+ */
+esp_err_t uvc_color_convert_yuy2_to_rgb565_strips(const uint8_t *yuy2, uint16_t *const strip_buf[2], unsigned strip_lines,
+                                                  const uvc_color_convert_config_t *config, uvc_color_strip_callback_t strip_cb, void *user_ctx);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,208 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_check.h"
+#include "usb/uvc_color_convert.h"
+
+#if CONFIG_IDF_TARGET_LINUX
+#define CONVERT_ATTR
+#define TABLE_ATTR
+#else
+#include "esp_attr.h"
+// Kernels and tables are in internal RAM, so the conversion does not compete with frame buffers in PSRAM for the cache
+#define CONVERT_ATTR IRAM_ATTR
+#define TABLE_ATTR   DRAM_ATTR
+#endif
+
+static const char *TAG = "uvc_color";
+
+/*
+ * BT.601 limited range, fixed point with 8 fractional bits:
+ *   R = clamp((298 * (Y - 16) + 409 * (V - 128) + 128) >> 8)
+ *   G = clamp((298 * (Y - 16) - 100 * (U - 128) - 208 * (V - 128) + 128) >> 8)
+ *   B = clamp((298 * (Y - 16) + 516 * (U - 128) + 128) >> 8)
+ *
+ * All multiplications are table lookups. Y table is offset by SAT_OFFSET, so the sum is always a valid index
+ * into saturation tables, which clamp and place the channel into its RGB565 bits at once.
+ */
+#define SAT_OFFSET  (288)   // -(minimum of the sum >> 8) rounded up
+#define SAT_SIZE    (832)   // SAT_OFFSET + maximum of the sum >> 8 + 1, rounded up
+
+#define CLAMP(c)    ((c) < 0 ? 0 : ((c) > 255 ? 255 : (c)))
+#define SAT_R(i)    ((CLAMP((i) - SAT_OFFSET) >> 3) << 11)
+#define SAT_G(i)    ((CLAMP((i) - SAT_OFFSET) >> 2) << 5)
+#define SAT_B(i)    (CLAMP((i) - SAT_OFFSET) >> 3)
+#define LUT_Y(i)    (298 * ((i) - 16) + 128 + (SAT_OFFSET << 8))
+#define LUT_RV(i)   (409 * ((i) - 128))
+#define LUT_GU(i)   (-100 * ((i) - 128))
+#define LUT_GV(i)   (-208 * ((i) - 128))
+#define LUT_BU(i)   (516 * ((i) - 128))
+
+#define REP4(M, i)   M(i), M((i) + 1), M((i) + 2), M((i) + 3)
+#define REP16(M, i)  REP4(M, i), REP4(M, (i) + 4), REP4(M, (i) + 8), REP4(M, (i) + 12)
+#define REP64(M, i)  REP16(M, i), REP16(M, (i) + 16), REP16(M, (i) + 32), REP16(M, (i) + 48)
+#define REP256(M, i) REP64(M, i), REP64(M, (i) + 64), REP64(M, (i) + 128), REP64(M, (i) + 192)
+#define REP832(M)    REP256(M, 0), REP256(M, 256), REP256(M, 512), REP64(M, 768)
+
+static const TABLE_ATTR int32_t s_lut_y[256] = { REP256(LUT_Y, 0) };
+static const TABLE_ATTR int32_t s_lut_rv[256] = { REP256(LUT_RV, 0) };
+static const TABLE_ATTR int32_t s_lut_gu[256] = { REP256(LUT_GU, 0) };
+static const TABLE_ATTR int32_t s_lut_gv[256] = { REP256(LUT_GV, 0) };
+static const TABLE_ATTR int32_t s_lut_bu[256] = { REP256(LUT_BU, 0) };
+static const TABLE_ATTR uint16_t s_sat_r[SAT_SIZE] = { REP832(SAT_R) };
+static const TABLE_ATTR uint16_t s_sat_g[SAT_SIZE] = { REP832(SAT_G) };
+static const TABLE_ATTR uint16_t s_sat_b[SAT_SIZE] = { REP832(SAT_B) };
+
+/**
+ * @brief Conversion configuration with defaults resolved
+ */
+typedef struct {
+    unsigned src_width;
+    unsigned crop_x;
+    unsigned crop_y;
+    unsigned dst_width;
+    unsigned dst_height;
+    unsigned dst_stride;
+    uint32_t x_step;        // Source pixels per output pixel, 16.16 fixed point
+    uint32_t y_step;        // Source lines per output line, 16.16 fixed point
+    bool scaled_x;          // Output pixels are not one-to-one copies of source pixel pairs
+    bool swap_bytes;
+} convert_t;
+
+static inline __attribute__((always_inline)) uint16_t pixel(int32_t y, int32_t rv, int32_t guv, int32_t bu, bool swap_bytes)
+{
+    const uint16_t px = s_sat_r[(y + rv) >> 8] | s_sat_g[(y + guv) >> 8] | s_sat_b[(y + bu) >> 8];
+    return swap_bytes ? __builtin_bswap16(px) : px;
+}
+
+/**
+ * @brief Convert one line without horizontal scaling, src points to a pixel pair Y0 U Y1 V
+ */
+static inline __attribute__((always_inline)) void convert_line(const uint8_t *src, uint16_t *dst, unsigned width, bool swap_bytes)
+{
+    // Both pixels of a pair share U and V, their contributions are looked up once per pair
+    unsigned x = 0;
+    for (; x + 1 < width; x += 2, src += 4) {
+        const int32_t rv = s_lut_rv[src[3]];
+        const int32_t guv = s_lut_gu[src[1]] + s_lut_gv[src[3]];
+        const int32_t bu = s_lut_bu[src[1]];
+        dst[x] = pixel(s_lut_y[src[0]], rv, guv, bu, swap_bytes);
+        dst[x + 1] = pixel(s_lut_y[src[2]], rv, guv, bu, swap_bytes);
+    }
+    if (x < width) {
+        dst[x] = pixel(s_lut_y[src[0]], s_lut_rv[src[3]], s_lut_gu[src[1]] + s_lut_gv[src[3]], s_lut_bu[src[1]], swap_bytes);
+    }
+}
+
+/**
+ * @brief Convert one line with nearest neighbour horizontal scaling, src points to the source line
+ */
+static inline __attribute__((always_inline)) void convert_line_scaled(const uint8_t *src, uint16_t *dst, const convert_t *c, bool swap_bytes)
+{
+    // Sample at the center of each output pixel
+    uint32_t sx_fp = (c->crop_x << 16) + c->x_step / 2;
+    for (unsigned x = 0; x < c->dst_width; x++, sx_fp += c->x_step) {
+        const unsigned sx = sx_fp >> 16;
+        const uint8_t *pair = src + (sx & ~1u) * 2;
+        dst[x] = pixel(s_lut_y[pair[(sx & 1) * 2]], s_lut_rv[pair[3]], s_lut_gu[pair[1]] + s_lut_gv[pair[3]], s_lut_bu[pair[1]], swap_bytes);
+    }
+}
+
+static inline __attribute__((always_inline)) void convert_lines_impl(const uint8_t *yuy2, uint16_t *rgb565, const convert_t *c,
+                                                                     unsigned first_line, unsigned num_lines, bool swap_bytes)
+{
+    for (unsigned line = first_line; line < first_line + num_lines; line++, rgb565 += c->dst_stride) {
+        const unsigned sy = c->crop_y + ((line * c->y_step + c->y_step / 2) >> 16);
+        const uint8_t *src = yuy2 + (size_t)sy * c->src_width * 2;
+        if (c->scaled_x) {
+            convert_line_scaled(src, rgb565, c, swap_bytes);
+        } else {
+            convert_line(src + c->crop_x * 2, rgb565, c->dst_width, swap_bytes);
+        }
+    }
+}
+
+static void CONVERT_ATTR convert_lines(const uint8_t *yuy2, uint16_t *rgb565, const convert_t *c, unsigned first_line, unsigned num_lines)
+{
+    // Byte order is fixed per call, each variant gets its own loop without a branch per pixel
+    if (c->swap_bytes) {
+        convert_lines_impl(yuy2, rgb565, c, first_line, num_lines, true);
+    } else {
+        convert_lines_impl(yuy2, rgb565, c, first_line, num_lines, false);
+    }
+}
+
+static esp_err_t convert_init(const uvc_color_convert_config_t *config, convert_t *c)
+{
+    ESP_RETURN_ON_FALSE(config, ESP_ERR_INVALID_ARG, TAG, "Config can't be NULL");
+    ESP_RETURN_ON_FALSE(config->src.width > 0 && config->src.width % 2 == 0 && config->src.width <= UINT16_MAX &&
+                        config->src.height > 0 && config->src.height <= UINT16_MAX,
+                        ESP_ERR_INVALID_ARG, TAG, "Invalid frame size %ux%u", config->src.width, config->src.height);
+
+    const unsigned crop_width = config->crop.width ? config->crop.width : config->src.width;
+    const unsigned crop_height = config->crop.height ? config->crop.height : config->src.height;
+    ESP_RETURN_ON_FALSE(config->crop.x < config->src.width && crop_width <= config->src.width - config->crop.x &&
+                        config->crop.y < config->src.height && crop_height <= config->src.height - config->crop.y,
+                        ESP_ERR_INVALID_ARG, TAG, "Crop rectangle out of the frame");
+
+    c->src_width = config->src.width;
+    c->crop_x = config->crop.x;
+    c->crop_y = config->crop.y;
+    c->dst_width = config->dst.width ? config->dst.width : crop_width;
+    c->dst_height = config->dst.height ? config->dst.height : crop_height;
+    c->dst_stride = config->dst.stride ? config->dst.stride : c->dst_width;
+    ESP_RETURN_ON_FALSE(c->dst_width <= UINT16_MAX && c->dst_height <= UINT16_MAX && c->dst_stride >= c->dst_width,
+                        ESP_ERR_INVALID_ARG, TAG, "Invalid output size");
+    c->x_step = ((uint64_t)crop_width << 16) / c->dst_width;
+    c->y_step = ((uint64_t)crop_height << 16) / c->dst_height;
+    c->scaled_x = (c->dst_width != crop_width) || (c->crop_x % 2);
+    c->swap_bytes = config->swap_bytes;
+    return ESP_OK;
+}
+
+esp_err_t uvc_color_convert_yuy2_to_rgb565(const uint8_t *yuy2, uint16_t *rgb565, const uvc_color_convert_config_t *config)
+{
+    ESP_RETURN_ON_FALSE(yuy2 && rgb565, ESP_ERR_INVALID_ARG, TAG, "Buffers can't be NULL");
+    convert_t c;
+    ESP_RETURN_ON_ERROR(convert_init(config, &c), TAG, "Invalid configuration");
+    convert_lines(yuy2, rgb565, &c, 0, c.dst_height);
+    return ESP_OK;
+}
+
+esp_err_t uvc_color_convert_yuy2_to_rgb565_lines(const uint8_t *yuy2, uint16_t *rgb565, const uvc_color_convert_config_t *config,
+                                                 unsigned first_line, unsigned num_lines)
+{
+    ESP_RETURN_ON_FALSE(yuy2 && rgb565, ESP_ERR_INVALID_ARG, TAG, "Buffers can't be NULL");
+    convert_t c;
+    ESP_RETURN_ON_ERROR(convert_init(config, &c), TAG, "Invalid configuration");
+    ESP_RETURN_ON_FALSE(first_line < c.dst_height && num_lines <= c.dst_height - first_line,
+                        ESP_ERR_INVALID_ARG, TAG, "Lines out of the output");
+    convert_lines(yuy2, rgb565, &c, first_line, num_lines);
+    return ESP_OK;
+}
+
+esp_err_t uvc_color_convert_yuy2_to_rgb565_strips(const uint8_t *yuy2, uint16_t *const strip_buf[2], unsigned strip_lines,
+                                                  const uvc_color_convert_config_t *config, uvc_color_strip_callback_t strip_cb, void *user_ctx)
+{
+    ESP_RETURN_ON_FALSE(yuy2 && strip_buf && strip_buf[0] && strip_buf[1] && strip_lines > 0 && strip_cb,
+                        ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    convert_t c;
+    ESP_RETURN_ON_ERROR(convert_init(config, &c), TAG, "Invalid configuration");
+
+    int buf_idx = 0;
+    for (unsigned first_line = 0; first_line < c.dst_height; first_line += strip_lines, buf_idx ^= 1) {
+        const unsigned num_lines = (c.dst_height - first_line < strip_lines) ? c.dst_height - first_line : strip_lines;
+        convert_lines(yuy2, strip_buf[buf_idx], &c, first_line, num_lines);
+        const esp_err_t ret = strip_cb(strip_buf[buf_idx], first_line, num_lines, user_ctx);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,165 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "usb/uvc_host.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct uvc_mjpeg_display_s *uvc_mjpeg_display_hdl_t;
+
+/**
+ * @brief Draw callback type
+ *
+ * Called from the decoding task with each decoded frame. The callback starts sending the frame to the display,
+ * e.g. by esp_lcd_panel_draw_bitmap(), and returns. The next frame is decoded into another buffer meanwhile.
+ * The buffer is released by uvc_mjpeg_display_draw_done() or uvc_mjpeg_display_draw_done_from_isr(),
+ * in the order of draw callbacks, or when the callback returns with draw_blocking.
+ *
+ * @param[in] display  Display pipeline handle
+ * @param[in] rgb565   Decoded frame
+ * @param[in] width    Width of the decoded frame. Hardware decoder: Rounded up to multiple of 16
+ * @param[in] height   Height of the decoded frame
+ * @param[in] user_ctx User's argument
+ */
+typedef void (*uvc_mjpeg_display_draw_cb_t)(uvc_mjpeg_display_hdl_t display, const uint16_t *rgb565, unsigned width, unsigned height, void *user_ctx);
+
+/**
+ * @brief Configuration of MJPEG decode-and-display pipeline
+ */
+typedef struct {
+    uvc_mjpeg_display_draw_cb_t draw_cb;    /**< Draw callback, must not be NULL */
+    void *user_ctx;                         /**< User's argument passed to draw_cb */
+    unsigned max_width;                     /**< Maximum width of decoded frames */
+    unsigned max_height;                    /**< Maximum height of decoded frames */
+    int number_of_buffers;                  /**< Number of decode output buffers, 1 to 4. 0: 2, the next frame is decoded while the previous one is drawn */
+    uint32_t buffer_heap_caps;              /**< Software decoder only: Memory capabilities for output buffers. 0: MALLOC_CAP_DEFAULT.
+                                                 Hardware decoder allocates its output buffers by jpeg_alloc_decoder_mem() */
+    bool swap_bytes;                        /**< Output RGB565 big-endian, as expected by most SPI and I80 LCD panels */
+    bool draw_blocking;                     /**< draw_cb returns after the frame was sent, its buffer is released on return */
+    bool software_decoder;                  /**< Use software decoder even if hardware JPEG decoder is available */
+    struct {
+        size_t stack_size;                  /**< Stack size of the decoding task. 0: 4096 bytes */
+        unsigned priority;                  /**< Priority of the decoding task. 0: 2 */
+        BaseType_t core_id;                 /**< Core of the decoding task or tskNO_AFFINITY */
+    } task;
+} uvc_mjpeg_display_config_t;
+
+/**
+ * @brief Statistics of the pipeline
+ *
+ * The counters are accumulated since the pipeline was created or since last uvc_mjpeg_display_reset_stats() call
+ */
+typedef struct {
+    uint32_t frames_drawn;                  /**< Number of decoded frames passed to draw callback */
+    uint32_t frames_dropped;                /**< Number of frames replaced by a newer frame before decoding */
+    uint32_t decode_errors;                 /**< Number of frames that could not be decoded */
+    uint32_t decode_time_avg_us;            /**< Average decoding time in microseconds */
+    uint32_t decode_time_max_us;            /**< Maximum decoding time in microseconds */
+    uint32_t latency_avg_us;                /**< Average time from End of Frame reception to draw callback in microseconds */
+    uint32_t latency_max_us;                /**< Maximum time from End of Frame reception to draw callback in microseconds */
+    bool hardware_decoder;                  /**< Frames are decoded by hardware JPEG decoder */
+} uvc_mjpeg_display_stats_t;
+
+/**
+ * @brief Create MJPEG decode-and-display pipeline
+ *
+ * The pipeline decodes MJPEG frames in its own task, by hardware JPEG decoder when the target has one,
+ * else by software decoder. Only the newest submitted frame waits for decoding, older frames are returned
+ * to the UVC driver right away, so the displayed frame is as recent as possible.
+ *
+ * @param[in]  config      Configuration
+ * @param[out] display_ret Display pipeline handle
+ * @return
+ *   - ESP_OK:                 Created
+ *   - ESP_ERR_INVALID_ARG:    Invalid configuration
+ *   - ESP_ERR_NO_MEM:         Not enough memory
+ *   - Other:                  Hardware JPEG decoder could not be created
+ */
+esp_err_t uvc_mjpeg_display_create(const uvc_mjpeg_display_config_t *config, uvc_mjpeg_display_hdl_t *display_ret);
+
+/**
+ * @brief Delete the pipeline
+ *
+ * Frames must not be submitted during and after this call, stop the stream first.
+ * A frame waiting for decoding is returned to the UVC driver.
+ *
+ * @param[in] display Display pipeline handle
+ * @return
+ *   - ESP_OK:                 Deleted
+ *   - ESP_ERR_INVALID_ARG:    display is NULL
+ */
+esp_err_t uvc_mjpeg_display_delete(uvc_mjpeg_display_hdl_t display);
+
+/**
+ * @brief Submit MJPEG frame for decoding
+ *
+ * Called from frame callback of the UVC stream. On success, the pipeline owns the frame and returns it
+ * to the driver by uvc_host_frame_return() as soon as it is decoded, so frame callback must return false:
+ *
+ * \code{.c}
+ * return uvc_mjpeg_display_submit(display, stream, frame) != ESP_OK;
+ * \endcode
+ *
+ * @param[in] display Display pipeline handle
+ * @param[in] stream  Stream of the frame
+ * @param[in] frame   MJPEG frame
+ * @return
+ *   - ESP_OK:                 The pipeline owns the frame
+ *   - ESP_ERR_INVALID_ARG:    NULL argument or the frame is not MJPEG
+ *   - ESP_ERR_NOT_SUPPORTED:  Zero-copy frame
+ *   - ESP_ERR_TIMEOUT:        The frame could not be queued
+ */
+esp_err_t uvc_mjpeg_display_submit(uvc_mjpeg_display_hdl_t display, uvc_host_stream_hdl_t stream, uvc_host_frame_t *frame);
+
+/**
+ * @brief Release the oldest buffer passed to draw callback
+ *
+ * @param[in] display Display pipeline handle
+ */
+void uvc_mjpeg_display_draw_done(uvc_mjpeg_display_hdl_t display);
+
+/**
+ * @brief Release the oldest buffer passed to draw callback, from ISR
+ *
+ * E.g. from on_color_trans_done callback of esp_lcd panel IO.
+ *
+ * @param[in] display Display pipeline handle
+ * @return true if a higher priority task was woken
+ */
+bool uvc_mjpeg_display_draw_done_from_isr(uvc_mjpeg_display_hdl_t display);
+
+/**
+ * @brief Get statistics of the pipeline
+ *
+ * @param[in]  display   Display pipeline handle
+ * @param[out] stats_ret Statistics
+ * @return
+ *   - ESP_OK:                 Success
+ *   - ESP_ERR_INVALID_ARG:    NULL argument
+ */
+esp_err_t uvc_mjpeg_display_get_stats(uvc_mjpeg_display_hdl_t display, uvc_mjpeg_display_stats_t *stats_ret);
+
+/**
+ * @brief Reset statistics of the pipeline
+ *
+ * @param[in] display Display pipeline handle
+ * @return
+ *   - ESP_OK:                 Success
+ *   - ESP_ERR_INVALID_ARG:    display is NULL
+ */
+esp_err_t uvc_mjpeg_display_reset_stats(uvc_mjpeg_display_hdl_t display);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,358 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_idf_version.h"
+#include "esp_timer.h"
+#include "soc/soc_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "jpeg_decoder.h"
+#include "usb/uvc_mjpeg_display.h"
+
+#if SOC_JPEG_CODEC_SUPPORTED && ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0)
+#define MJPEG_HW_DECODER 1
+#include "driver/jpeg_decode.h"
+#endif
+
+#define BUFFERS_MAX             (4)
+#define WORKING_BUFFER_SIZE     (4000)  // Software decoder: Larger than default of esp_jpeg, for default Huffman tables of MJPEG
+#define BUFFER_TIMEOUT_MS       (1000)  // Draw of the oldest buffer did not finish, the display is likely stuck
+#define ALIGN_UP(x, a)          (((x) + (a) - 1) / (a) * (a))
+
+static const char *TAG = "uvc_mjpeg_display";
+
+typedef struct {
+    uvc_host_stream_hdl_t stream;
+    uvc_host_frame_t *frame;                    // NULL: Stop the decoding task
+} frame_msg_t;
+
+typedef struct uvc_mjpeg_display_s {
+    uvc_mjpeg_display_config_t config;
+    QueueHandle_t frame_q;                      // Newest submitted frame
+    SemaphoreHandle_t free_buffers;             // Counts buffers not held by display
+    SemaphoreHandle_t task_done;
+    uint16_t *buffers[BUFFERS_MAX];             // Used in round robin, display releases them in the same order
+    size_t buffer_size;
+    uint8_t *working_buffer;                    // Software decoder only
+#if MJPEG_HW_DECODER
+    jpeg_decoder_handle_t hw_decoder;           // NULL: Software decoder
+#endif
+    portMUX_TYPE stats_lock;
+    uvc_mjpeg_display_stats_t stats;
+    uint64_t decode_time_sum_us;
+    uint64_t latency_sum_us;
+} uvc_mjpeg_display_t;
+
+static bool decode_software(uvc_mjpeg_display_t *display, const uvc_host_frame_t *frame, uint16_t *buffer, unsigned *width, unsigned *height)
+{
+    esp_jpeg_image_cfg_t jpeg_cfg = {
+        .indata = frame->data,
+        .indata_size = frame->data_len,
+        .outbuf = (uint8_t *)buffer,
+        .outbuf_size = display->buffer_size,
+        .out_format = JPEG_IMAGE_FORMAT_RGB565,
+        .out_scale = JPEG_IMAGE_SCALE_0,
+        .flags = {
+            .swap_color_bytes = display->config.swap_bytes,
+        },
+        .advanced = {
+            .working_buffer = display->working_buffer,
+            .working_buffer_size = WORKING_BUFFER_SIZE,
+        },
+    };
+    esp_jpeg_image_output_t outimg;
+    if (esp_jpeg_decode(&jpeg_cfg, &outimg) != ESP_OK) {
+        return false;
+    }
+    *width = outimg.width;
+    *height = outimg.height;
+    return true;
+}
+
+#if MJPEG_HW_DECODER
+static bool decode_hardware(uvc_mjpeg_display_t *display, const uvc_host_frame_t *frame, uint16_t *buffer, unsigned *width, unsigned *height)
+{
+    jpeg_decode_picture_info_t info;
+    if (jpeg_decoder_get_info(frame->data, frame->data_len, &info) != ESP_OK ||
+            ALIGN_UP(info.width, 16) * ALIGN_UP(info.height, 16) * 2 > display->buffer_size) {
+        return false;
+    }
+    const jpeg_decode_cfg_t decode_cfg = {
+        .output_format = JPEG_DECODE_OUT_FORMAT_RGB565,
+        .rgb_order = JPEG_DEC_RGB_ELEMENT_ORDER_BGR,
+        .conv_std = JPEG_YUV_RGB_CONV_STD_BT601,
+    };
+    uint32_t out_size;
+    if (jpeg_decoder_process(display->hw_decoder, &decode_cfg, frame->data, frame->data_len,
+                             (uint8_t *)buffer, display->buffer_size, &out_size) != ESP_OK) {
+        return false;
+    }
+    *width = ALIGN_UP(info.width, 16);
+    *height = info.height;
+    if (display->config.swap_bytes) {
+        // The hardware decoder outputs little-endian RGB565 only
+        for (size_t i = 0; i < (size_t)*width * *height; i++) {
+            buffer[i] = __builtin_bswap16(buffer[i]);
+        }
+    }
+    return true;
+}
+#endif
+
+static void decoding_task(void *arg)
+{
+    uvc_mjpeg_display_t *display = (uvc_mjpeg_display_t *)arg;
+    const int number_of_buffers = display->config.number_of_buffers;
+    int buffer_idx = 0;
+
+    while (true) {
+        // Wait for a free buffer first, frames submitted meanwhile replace each other, the newest one is decoded
+        if (xSemaphoreTake(display->free_buffers, pdMS_TO_TICKS(BUFFER_TIMEOUT_MS)) != pdTRUE) {
+            ESP_LOGW(TAG, "No buffer released by display for %d ms", BUFFER_TIMEOUT_MS);
+            continue;
+        }
+        frame_msg_t msg;
+        xQueueReceive(display->frame_q, &msg, portMAX_DELAY);
+        if (msg.frame == NULL) {
+            break;
+        }
+
+        uint16_t *buffer = display->buffers[buffer_idx];
+        unsigned width = 0, height = 0;
+        const int64_t start_us = esp_timer_get_time();
+#if MJPEG_HW_DECODER
+        const bool decoded = display->hw_decoder ? decode_hardware(display, msg.frame, buffer, &width, &height)
+                             : decode_software(display, msg.frame, buffer, &width, &height);
+#else
+        const bool decoded = decode_software(display, msg.frame, buffer, &width, &height);
+#endif
+        const int64_t end_us = esp_timer_get_time();
+        const int64_t eof_us = msg.frame->timestamp.host_eof_us;
+
+        // The frame buffer goes back to the driver before draw, it can receive the next frame while this one is drawn
+        uvc_host_frame_return(msg.stream, msg.frame);
+
+        if (!decoded) {
+            portENTER_CRITICAL(&display->stats_lock);
+            display->stats.decode_errors++;
+            portEXIT_CRITICAL(&display->stats_lock);
+            xSemaphoreGive(display->free_buffers);
+            continue;
+        }
+
+        const uint32_t decode_time_us = end_us - start_us;
+        const uint32_t latency_us = end_us - eof_us;
+        portENTER_CRITICAL(&display->stats_lock);
+        display->stats.frames_drawn++;
+        display->decode_time_sum_us += decode_time_us;
+        display->latency_sum_us += latency_us;
+        if (decode_time_us > display->stats.decode_time_max_us) {
+            display->stats.decode_time_max_us = decode_time_us;
+        }
+        if (latency_us > display->stats.latency_max_us) {
+            display->stats.latency_max_us = latency_us;
+        }
+        portEXIT_CRITICAL(&display->stats_lock);
+
+        display->config.draw_cb(display, buffer, width, height, display->config.user_ctx);
+        if (display->config.draw_blocking) {
+            xSemaphoreGive(display->free_buffers);
+        }
+        buffer_idx = (buffer_idx + 1) % number_of_buffers;
+    }
+
+    xSemaphoreGive(display->task_done);
+    vTaskDelete(NULL);
+}
+
+static void display_free(uvc_mjpeg_display_t *display)
+{
+    for (int i = 0; i < BUFFERS_MAX; i++) {
+        free(display->buffers[i]);
+    }
+#if MJPEG_HW_DECODER
+    if (display->hw_decoder) {
+        jpeg_del_decoder_engine(display->hw_decoder);
+    }
+#endif
+    free(display->working_buffer);
+    if (display->frame_q) {
+        vQueueDelete(display->frame_q);
+    }
+    if (display->free_buffers) {
+        vSemaphoreDelete(display->free_buffers);
+    }
+    if (display->task_done) {
+        vSemaphoreDelete(display->task_done);
+    }
+    free(display);
+}
+
+static esp_err_t buffers_allocate(uvc_mjpeg_display_t *display)
+{
+    const uvc_mjpeg_display_config_t *config = &display->config;
+#if MJPEG_HW_DECODER
+    if (!config->software_decoder) {
+        const jpeg_decode_engine_cfg_t engine_cfg = {
+            .intr_priority = 0,
+            .timeout_ms = 100,
+        };
+        ESP_RETURN_ON_ERROR(jpeg_new_decoder_engine(&engine_cfg, &display->hw_decoder), TAG, "Hardware JPEG decoder failed");
+
+        // Hardware decoder writes whole MCUs
+        const jpeg_decode_memory_alloc_cfg_t mem_cfg = {
+            .buffer_direction = JPEG_DEC_ALLOC_OUTPUT_BUFFER,
+        };
+        const size_t size = ALIGN_UP(config->max_width, 16) * ALIGN_UP(config->max_height, 16) * 2;
+        for (int i = 0; i < config->number_of_buffers; i++) {
+            display->buffers[i] = jpeg_alloc_decoder_mem(size, &mem_cfg, &display->buffer_size);
+            ESP_RETURN_ON_FALSE(display->buffers[i], ESP_ERR_NO_MEM, TAG, "Not enough memory for buffers");
+        }
+        return ESP_OK;
+    }
+#endif
+    display->buffer_size = config->max_width * config->max_height * 2;
+    const uint32_t caps = config->buffer_heap_caps ? config->buffer_heap_caps : MALLOC_CAP_DEFAULT;
+    for (int i = 0; i < config->number_of_buffers; i++) {
+        display->buffers[i] = heap_caps_aligned_alloc(64, display->buffer_size, caps);
+        ESP_RETURN_ON_FALSE(display->buffers[i], ESP_ERR_NO_MEM, TAG, "Not enough memory for buffers");
+    }
+    display->working_buffer = heap_caps_malloc(WORKING_BUFFER_SIZE, MALLOC_CAP_INTERNAL);
+    ESP_RETURN_ON_FALSE(display->working_buffer, ESP_ERR_NO_MEM, TAG, "Not enough memory for working buffer");
+    return ESP_OK;
+}
+
+esp_err_t uvc_mjpeg_display_create(const uvc_mjpeg_display_config_t *config, uvc_mjpeg_display_hdl_t *display_ret)
+{
+    esp_err_t ret;
+    ESP_RETURN_ON_FALSE(config && display_ret && config->draw_cb, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(config->max_width > 0 && config->max_height > 0, ESP_ERR_INVALID_ARG, TAG, "Invalid frame size");
+    ESP_RETURN_ON_FALSE(config->number_of_buffers >= 0 && config->number_of_buffers <= BUFFERS_MAX,
+                        ESP_ERR_INVALID_ARG, TAG, "Invalid number of buffers");
+
+    uvc_mjpeg_display_t *display = calloc(1, sizeof(uvc_mjpeg_display_t));
+    ESP_RETURN_ON_FALSE(display, ESP_ERR_NO_MEM, TAG, "Not enough memory");
+    display->config = *config;
+    if (display->config.number_of_buffers == 0) {
+        display->config.number_of_buffers = 2;
+    }
+    if (display->config.task.stack_size == 0) {
+        display->config.task.stack_size = 4096;
+    }
+    if (display->config.task.priority == 0) {
+        display->config.task.priority = 2;
+    }
+    portMUX_INITIALIZE(&display->stats_lock);
+
+    display->frame_q = xQueueCreate(1, sizeof(frame_msg_t));
+    display->free_buffers = xSemaphoreCreateCounting(display->config.number_of_buffers, display->config.number_of_buffers);
+    display->task_done = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(display->frame_q && display->free_buffers && display->task_done, ESP_ERR_NO_MEM, fail, TAG, "Not enough memory");
+    ESP_GOTO_ON_ERROR(buffers_allocate(display), fail, TAG, "Buffers allocation failed");
+#if MJPEG_HW_DECODER
+    display->stats.hardware_decoder = display->hw_decoder != NULL;
+#endif
+
+    ESP_GOTO_ON_FALSE(xTaskCreatePinnedToCore(decoding_task, "mjpeg_display", display->config.task.stack_size, display,
+                                              display->config.task.priority, NULL, display->config.task.core_id) == pdPASS,
+                      ESP_ERR_NO_MEM, fail, TAG, "Not enough memory for task");
+    ESP_LOGD(TAG, "Created with %s decoder", display->stats.hardware_decoder ? "hardware" : "software");
+    *display_ret = display;
+    return ESP_OK;
+
+fail:
+    display_free(display);
+    return ret;
+}
+
+esp_err_t uvc_mjpeg_display_delete(uvc_mjpeg_display_hdl_t display)
+{
+    ESP_RETURN_ON_FALSE(display, ESP_ERR_INVALID_ARG, TAG, "display can't be NULL");
+
+    // The frame waiting for decoding goes back to the driver, then the stop message takes its place
+    frame_msg_t msg;
+    if (xQueueReceive(display->frame_q, &msg, 0) == pdTRUE) {
+        uvc_host_frame_return(msg.stream, msg.frame);
+    }
+    msg.frame = NULL;
+    xQueueSend(display->frame_q, &msg, portMAX_DELAY);
+    xSemaphoreGive(display->free_buffers); // The task may wait for a buffer held by display
+    xSemaphoreTake(display->task_done, portMAX_DELAY);
+
+    display_free(display);
+    return ESP_OK;
+}
+
+esp_err_t uvc_mjpeg_display_submit(uvc_mjpeg_display_hdl_t display, uvc_host_stream_hdl_t stream, uvc_host_frame_t *frame)
+{
+    ESP_RETURN_ON_FALSE(display && stream && frame, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(frame->vs_format.format == UVC_VS_FORMAT_MJPEG, ESP_ERR_INVALID_ARG, TAG, "Frame is not MJPEG");
+    ESP_RETURN_ON_FALSE(frame->data, ESP_ERR_NOT_SUPPORTED, TAG, "Zero-copy frames are not supported");
+
+    const frame_msg_t msg = {
+        .stream = stream,
+        .frame = frame,
+    };
+    if (xQueueSend(display->frame_q, &msg, 0) == pdTRUE) {
+        return ESP_OK;
+    }
+
+    // The decoder is busy, the waiting frame is replaced by this newer one
+    frame_msg_t old;
+    if (xQueueReceive(display->frame_q, &old, 0) == pdTRUE) {
+        uvc_host_frame_return(old.stream, old.frame);
+        portENTER_CRITICAL(&display->stats_lock);
+        display->stats.frames_dropped++;
+        portEXIT_CRITICAL(&display->stats_lock);
+    }
+    return xQueueSend(display->frame_q, &msg, 0) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+void uvc_mjpeg_display_draw_done(uvc_mjpeg_display_hdl_t display)
+{
+    xSemaphoreGive(display->free_buffers);
+}
+
+bool uvc_mjpeg_display_draw_done_from_isr(uvc_mjpeg_display_hdl_t display)
+{
+    BaseType_t task_woken = pdFALSE;
+    xSemaphoreGiveFromISR(display->free_buffers, &task_woken);
+    return task_woken == pdTRUE;
+}
+
+esp_err_t uvc_mjpeg_display_get_stats(uvc_mjpeg_display_hdl_t display, uvc_mjpeg_display_stats_t *stats_ret)
+{
+    ESP_RETURN_ON_FALSE(display && stats_ret, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    portENTER_CRITICAL(&display->stats_lock);
+    *stats_ret = display->stats;
+    if (display->stats.frames_drawn) {
+        stats_ret->decode_time_avg_us = display->decode_time_sum_us / display->stats.frames_drawn;
+        stats_ret->latency_avg_us = display->latency_sum_us / display->stats.frames_drawn;
+    }
+    portEXIT_CRITICAL(&display->stats_lock);
+    return ESP_OK;
+}
+
+esp_err_t uvc_mjpeg_display_reset_stats(uvc_mjpeg_display_hdl_t display)
+{
+    ESP_RETURN_ON_FALSE(display, ESP_ERR_INVALID_ARG, TAG, "display can't be NULL");
+    portENTER_CRITICAL(&display->stats_lock);
+    const bool hardware_decoder = display->stats.hardware_decoder;
+    memset(&display->stats, 0, sizeof(display->stats));
+    display->stats.hardware_decoder = hardware_decoder;
+    display->decode_time_sum_us = 0;
+    display->latency_sum_us = 0;
+    portEXIT_CRITICAL(&display->stats_lock);
+    return ESP_OK;
+}
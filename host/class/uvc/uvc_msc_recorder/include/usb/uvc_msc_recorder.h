@@ -0,0 +1,161 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "usb/uvc_host.h"
+#include "usb/msc_host.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct uvc_msc_recorder_s *uvc_msc_recorder_hdl_t;
+
+#define UVC_MSC_RECORD_MAGIC    (0x52435655) // "UVCR" in little-endian
+#define UVC_MSC_RECORD_VERSION  (1)
+
+/**
+ * @brief Header of one record, at the start of its first sector
+ *
+ * Each frame is one record of whole sectors: the header sector, then the frame data.
+ * The frame is the first frame_len bytes of sectors following the header sector, the rest of the last sector is padding.
+ * The recording ends with a record of frame_len 0, or at a header with different magic, session or sequence,
+ * when the recording was interrupted. All fields are little-endian.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;                 /**< UVC_MSC_RECORD_MAGIC */
+    uint16_t version;               /**< UVC_MSC_RECORD_VERSION */
+    uint16_t header_len;            /**< Length of this header in bytes */
+    uint32_t session;               /**< Random number, the same in all records of one recording */
+    uint32_t sequence;              /**< Record number, from 0 */
+    uint32_t frame_len;             /**< Frame data length in bytes. 0: End of recording */
+    uint32_t record_sectors;        /**< Number of sectors of this record, including the header sector */
+    uint8_t format;                 /**< enum uvc_host_stream_format */
+    uint8_t pts_valid;              /**< pts is valid */
+    uint16_t h_res;                 /**< Horizontal resolution */
+    uint16_t v_res;                 /**< Vertical resolution */
+    uint16_t reserved;
+    uint32_t pts;                   /**< Presentation Time Stamp in device clock units */
+    int64_t host_eof_us;            /**< Host time of End of Frame reception in microseconds */
+} uvc_msc_record_header_t;
+
+/**
+ * @brief Configuration of UVC-to-MSC recorder
+ *
+ * The recorder writes to a contiguous range of sectors, e.g. a partition, the whole Logical Unit
+ * or a file preallocated contiguously by FatFS f_expand()
+ */
+typedef struct {
+    msc_host_device_handle_t device;    /**< MSC device. Its worker of asynchronous requests must be enabled */
+    uint8_t lun;                        /**< Logical Unit */
+    uint64_t start_sector;              /**< First sector of the recording */
+    uint64_t num_sectors;               /**< Number of sectors of the recording. 0: Up to the end of the Logical Unit */
+    int frames_in_flight;               /**< Maximum number of frames being written. Each frame queues up to 3 asynchronous requests,
+                                             async_io.queue_size of the device must be at least 3 * frames_in_flight. 0: 2 */
+} uvc_msc_recorder_config_t;
+
+/**
+ * @brief Statistics of the recorder
+ *
+ * The counters are accumulated since the recorder was created or since last uvc_msc_recorder_reset_stats() call
+ */
+typedef struct {
+    uint32_t frames_written;            /**< Number of frames written to the device */
+    uint32_t frames_dropped;            /**< Number of frames not recorded, because all frames_in_flight were being written */
+    uint32_t tail_copies;               /**< Number of frames whose last partial sector was copied, because the frame buffer was full */
+    uint32_t write_errors;              /**< Number of failed writes. The recording stops after the first one */
+    uint64_t bytes_written;             /**< Frame data written in bytes, without headers and padding */
+    uint64_t sectors_used;              /**< Sectors of the recording used so far, including headers and padding */
+    uint32_t write_latency_avg_us;      /**< Average time from End of Frame reception to write completion in microseconds */
+    uint32_t write_latency_max_us;      /**< Maximum time from End of Frame reception to write completion in microseconds */
+} uvc_msc_recorder_stats_t;
+
+/**
+ * @brief Create UVC-to-MSC recorder
+ *
+ * Frames are written by asynchronous requests of the MSC driver, straight from the frame buffers:
+ * frame buffers in DMA capable memory, aligned to the cache line, are transferred without any copy.
+ * Only the header sector of each record is prepared by the recorder.
+ *
+ * @param[in]  config       Configuration
+ * @param[out] recorder_ret Recorder handle
+ * @return
+ *   - ESP_OK:                 Created
+ *   - ESP_ERR_INVALID_ARG:    Invalid configuration
+ *   - ESP_ERR_INVALID_SIZE:   The sectors are out of the Logical Unit
+ *   - ESP_ERR_NO_MEM:         Not enough memory
+ *   - Other:                  Information of the Logical Unit could not be read
+ */
+esp_err_t uvc_msc_recorder_create(const uvc_msc_recorder_config_t *config, uvc_msc_recorder_hdl_t *recorder_ret);
+
+/**
+ * @brief Finish the recording and delete the recorder
+ *
+ * Frames must not be submitted during and after this call. Waits until the frames being written are written
+ * and returned to the UVC driver, then writes the end record.
+ *
+ * @param[in] recorder Recorder handle
+ * @return
+ *   - ESP_OK:                 All frames and the end record were written
+ *   - ESP_ERR_INVALID_ARG:    recorder is NULL
+ *   - Other:                  Error of the first failed write, the recorder is deleted anyway
+ */
+esp_err_t uvc_msc_recorder_delete(uvc_msc_recorder_hdl_t recorder);
+
+/**
+ * @brief Submit frame for recording
+ *
+ * Called from frame callback of the UVC stream. On success, the recorder owns the frame and returns it
+ * to the driver by uvc_host_frame_return() as soon as it is written, so frame callback must return false:
+ *
+ * \code{.c}
+ * return uvc_msc_recorder_submit(recorder, stream, frame) != ESP_OK;
+ * \endcode
+ *
+ * @param[in] recorder Recorder handle
+ * @param[in] stream   Stream of the frame
+ * @param[in] frame    Frame
+ * @return
+ *   - ESP_OK:                 The recorder owns the frame
+ *   - ESP_ERR_INVALID_ARG:    NULL argument
+ *   - ESP_ERR_NOT_SUPPORTED:  Zero-copy frame
+ *   - ESP_ERR_TIMEOUT:        All frames_in_flight are being written, the frame is dropped
+ *   - ESP_ERR_INVALID_SIZE:   The frame does not fit in the remaining sectors
+ *   - ESP_ERR_INVALID_STATE:  A previous write failed, the recording is stopped
+ *   - ESP_ERR_NO_MEM:         Queue of asynchronous requests is full, the recording is stopped
+ */
+esp_err_t uvc_msc_recorder_submit(uvc_msc_recorder_hdl_t recorder, uvc_host_stream_hdl_t stream, uvc_host_frame_t *frame);
+
+/**
+ * @brief Get statistics of the recorder
+ *
+ * @param[in]  recorder  Recorder handle
+ * @param[out] stats_ret Statistics
+ * @return
+ *   - ESP_OK:                 Success
+ *   - ESP_ERR_INVALID_ARG:    NULL argument
+ */
+esp_err_t uvc_msc_recorder_get_stats(uvc_msc_recorder_hdl_t recorder, uvc_msc_recorder_stats_t *stats_ret);
+
+/**
+ * @brief Reset statistics of the recorder
+ *
+ * sectors_used is the position of the recording, it is not reset.
+ *
+ * @param[in] recorder Recorder handle
+ * @return
+ *   - ESP_OK:                 Success
+ *   - ESP_ERR_INVALID_ARG:    recorder is NULL
+ */
+esp_err_t uvc_msc_recorder_reset_stats(uvc_msc_recorder_hdl_t recorder);
+
+#ifdef __cplusplus
+}
+#endif
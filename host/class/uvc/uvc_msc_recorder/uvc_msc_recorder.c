@@ -0,0 +1,357 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "usb/uvc_msc_recorder.h"
+
+#define FRAMES_IN_FLIGHT_MAX    (8)
+#define SECTOR_BUFFER_ALIGNMENT (64)    // Cache line of all targets, sector buffers are transferred without copy
+
+static const char *TAG = "uvc_msc_recorder";
+
+typedef struct uvc_msc_recorder_s uvc_msc_recorder_t;
+
+// One frame being written
+typedef struct {
+    uvc_msc_recorder_t *recorder;
+    uvc_host_stream_hdl_t stream;
+    uvc_host_frame_t *frame;
+    uint8_t *sectors;                           // Header sector, then tail sector
+    int pending;                                // Requests in flight + 1 while the frame is being submitted
+    esp_err_t result;                           // First error of the requests
+    size_t frame_len;
+    int64_t eof_us;
+} write_slot_t;
+
+struct uvc_msc_recorder_s {
+    uvc_msc_recorder_config_t config;
+    uint32_t sector_size;
+    uint32_t session;
+    QueueHandle_t free_slots;                   // Slots not being written
+    write_slot_t slots[FRAMES_IN_FLIGHT_MAX];
+    SemaphoreHandle_t barrier_done;
+    esp_err_t barrier_result;
+    portMUX_TYPE lock;                          // Protects everything below and pending of the slots
+    uint64_t next_sector;                       // Relative to start_sector
+    uint32_t sequence;
+    esp_err_t error;                            // First failed write, the recording is stopped
+    uvc_msc_recorder_stats_t stats;
+    uint64_t latency_sum_us;
+};
+
+static void slot_finish(write_slot_t *slot)
+{
+    uvc_msc_recorder_t *recorder = slot->recorder;
+    uvc_host_frame_return(slot->stream, slot->frame);
+
+    const uint32_t latency_us = esp_timer_get_time() - slot->eof_us;
+    portENTER_CRITICAL(&recorder->lock);
+    if (slot->result == ESP_OK) {
+        recorder->stats.frames_written++;
+        recorder->stats.bytes_written += slot->frame_len;
+        recorder->latency_sum_us += latency_us;
+        if (latency_us > recorder->stats.write_latency_max_us) {
+            recorder->stats.write_latency_max_us = latency_us;
+        }
+    } else {
+        recorder->stats.write_errors++;
+        if (recorder->error == ESP_OK) {
+            recorder->error = slot->result;
+        }
+    }
+    portEXIT_CRITICAL(&recorder->lock);
+    xQueueSend(recorder->free_slots, &slot, 0);
+}
+
+static void slot_release(write_slot_t *slot, esp_err_t result)
+{
+    uvc_msc_recorder_t *recorder = slot->recorder;
+    portENTER_CRITICAL(&recorder->lock);
+    if (result != ESP_OK && slot->result == ESP_OK) {
+        slot->result = result;
+    }
+    const bool last = (--slot->pending == 0);
+    portEXIT_CRITICAL(&recorder->lock);
+    if (last) {
+        slot_finish(slot);
+    }
+}
+
+/**
+ * @brief Completion callback of the requests of one frame, called from the worker task of the MSC device
+ */
+static void write_done(msc_host_device_handle_t device, esp_err_t result, void *arg)
+{
+    slot_release((write_slot_t *)arg, result);
+}
+
+static esp_err_t slot_queue_write(write_slot_t *slot, uint64_t sector, uint32_t num_sectors, const void *data)
+{
+    uvc_msc_recorder_t *recorder = slot->recorder;
+    portENTER_CRITICAL(&recorder->lock);
+    slot->pending++; // The request may complete before msc_host_write_sector_async() returns
+    portEXIT_CRITICAL(&recorder->lock);
+    const esp_err_t ret = msc_host_write_sector_async(recorder->config.device, recorder->config.lun, sector, num_sectors,
+                                                      data, write_done, slot);
+    if (ret != ESP_OK) {
+        portENTER_CRITICAL(&recorder->lock);
+        slot->pending--; // Never the last reference, the submitter holds one
+        portEXIT_CRITICAL(&recorder->lock);
+    }
+    return ret;
+}
+
+static void barrier_done(msc_host_device_handle_t device, esp_err_t result, void *arg)
+{
+    uvc_msc_recorder_t *recorder = (uvc_msc_recorder_t *)arg;
+    recorder->barrier_result = result;
+    xSemaphoreGive(recorder->barrier_done);
+}
+
+static void recorder_free(uvc_msc_recorder_t *recorder)
+{
+    for (int i = 0; i < FRAMES_IN_FLIGHT_MAX; i++) {
+        free(recorder->slots[i].sectors);
+    }
+    if (recorder->free_slots) {
+        vQueueDelete(recorder->free_slots);
+    }
+    if (recorder->barrier_done) {
+        vSemaphoreDelete(recorder->barrier_done);
+    }
+    free(recorder);
+}
+
+esp_err_t uvc_msc_recorder_create(const uvc_msc_recorder_config_t *config, uvc_msc_recorder_hdl_t *recorder_ret)
+{
+    esp_err_t ret;
+    ESP_RETURN_ON_FALSE(config && recorder_ret && config->device, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(config->frames_in_flight >= 0 && config->frames_in_flight <= FRAMES_IN_FLIGHT_MAX,
+                        ESP_ERR_INVALID_ARG, TAG, "Invalid number of frames in flight");
+
+    msc_host_device_info_t info;
+    ESP_RETURN_ON_ERROR(msc_host_get_lun_info(config->device, config->lun, &info), TAG, "Logical Unit info failed");
+    ESP_RETURN_ON_FALSE(info.sector_count && info.sector_size, ESP_ERR_INVALID_ARG, TAG, "No medium in the Logical Unit");
+    ESP_RETURN_ON_FALSE(config->start_sector < info.sector_count, ESP_ERR_INVALID_SIZE, TAG, "Start sector out of the Logical Unit");
+    const uint64_t num_sectors = config->num_sectors ? config->num_sectors : info.sector_count - config->start_sector;
+    ESP_RETURN_ON_FALSE(num_sectors >= 2 && num_sectors <= info.sector_count - config->start_sector,
+                        ESP_ERR_INVALID_SIZE, TAG, "Sectors out of the Logical Unit");
+
+    uvc_msc_recorder_t *recorder = calloc(1, sizeof(uvc_msc_recorder_t));
+    ESP_RETURN_ON_FALSE(recorder, ESP_ERR_NO_MEM, TAG, "Not enough memory");
+    recorder->config = *config;
+    recorder->config.num_sectors = num_sectors;
+    if (recorder->config.frames_in_flight == 0) {
+        recorder->config.frames_in_flight = 2;
+    }
+    recorder->sector_size = info.sector_size;
+    recorder->session = esp_random();
+    portMUX_INITIALIZE(&recorder->lock);
+
+    recorder->free_slots = xQueueCreate(recorder->config.frames_in_flight, sizeof(write_slot_t *));
+    recorder->barrier_done = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(recorder->free_slots && recorder->barrier_done, ESP_ERR_NO_MEM, fail, TAG, "Not enough memory");
+    for (int i = 0; i < recorder->config.frames_in_flight; i++) {
+        write_slot_t *slot = &recorder->slots[i];
+        slot->recorder = recorder;
+        slot->sectors = heap_caps_aligned_alloc(SECTOR_BUFFER_ALIGNMENT, 2 * info.sector_size, MALLOC_CAP_DMA);
+        ESP_GOTO_ON_FALSE(slot->sectors, ESP_ERR_NO_MEM, fail, TAG, "Not enough memory for sector buffers");
+        xQueueSend(recorder->free_slots, &slot, 0);
+    }
+
+    ESP_LOGD(TAG, "Recording to sectors %"PRIu64"..%"PRIu64" of %"PRIu32" bytes", config->start_sector,
+             config->start_sector + num_sectors - 1, info.sector_size);
+    *recorder_ret = recorder;
+    return ESP_OK;
+
+fail:
+    recorder_free(recorder);
+    return ret;
+}
+
+esp_err_t uvc_msc_recorder_delete(uvc_msc_recorder_hdl_t recorder)
+{
+    ESP_RETURN_ON_FALSE(recorder, ESP_ERR_INVALID_ARG, TAG, "recorder can't be NULL");
+
+    // Wait until all frames are written and returned
+    write_slot_t *slot = NULL;
+    for (int i = 0; i < recorder->config.frames_in_flight; i++) {
+        xQueueReceive(recorder->free_slots, &slot, portMAX_DELAY);
+    }
+
+    // The end record is written to the sector reserved behind the last record
+    esp_err_t ret = recorder->error;
+    if (ret == ESP_OK) {
+        memset(slot->sectors, 0, recorder->sector_size);
+        const uvc_msc_record_header_t header = {
+            .magic = UVC_MSC_RECORD_MAGIC,
+            .version = UVC_MSC_RECORD_VERSION,
+            .header_len = sizeof(uvc_msc_record_header_t),
+            .session = recorder->session,
+            .sequence = recorder->sequence,
+            .frame_len = 0,
+            .record_sectors = 1,
+        };
+        memcpy(slot->sectors, &header, sizeof(header));
+        ret = msc_host_write_sector_async(recorder->config.device, recorder->config.lun,
+                                          recorder->config.start_sector + recorder->next_sector, 1, slot->sectors, NULL, NULL);
+    }
+
+    // The barrier also clears the error state of the worker, the device can be used after a failed recording
+    if (msc_host_io_barrier(recorder->config.device, barrier_done, recorder) == ESP_OK) {
+        xSemaphoreTake(recorder->barrier_done, portMAX_DELAY);
+        if (ret == ESP_OK) {
+            ret = recorder->barrier_result;
+        }
+    }
+
+    recorder_free(recorder);
+    return ret;
+}
+
+esp_err_t uvc_msc_recorder_submit(uvc_msc_recorder_hdl_t recorder, uvc_host_stream_hdl_t stream, uvc_host_frame_t *frame)
+{
+    ESP_RETURN_ON_FALSE(recorder && stream && frame, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(frame->data, ESP_ERR_NOT_SUPPORTED, TAG, "Zero-copy frames are not supported");
+    if (recorder->error != ESP_OK) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    write_slot_t *slot;
+    if (xQueueReceive(recorder->free_slots, &slot, 0) != pdTRUE) {
+        portENTER_CRITICAL(&recorder->lock);
+        recorder->stats.frames_dropped++;
+        portEXIT_CRITICAL(&recorder->lock);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    // Whole sectors are written from the frame buffer. The padding of the last sector is read from behind the frame,
+    // only a full frame buffer needs its partial last sector copied.
+    const uint32_t sector_size = recorder->sector_size;
+    const size_t frame_len = frame->data_len;
+    const size_t padded_len = (frame_len + sector_size - 1) / sector_size * sector_size;
+    const uint32_t direct_sectors = (padded_len <= frame->data_buffer_len) ? padded_len / sector_size : frame_len / sector_size;
+    const size_t tail_len = frame_len - (size_t)direct_sectors * sector_size;
+    const uint32_t record_sectors = 1 + direct_sectors + (tail_len ? 1 : 0);
+
+    // One sector behind the last record is kept for the end record
+    portENTER_CRITICAL(&recorder->lock);
+    const bool fits = recorder->next_sector + record_sectors < recorder->config.num_sectors;
+    const uint64_t sector = recorder->config.start_sector + recorder->next_sector;
+    const uint32_t sequence = recorder->sequence;
+    if (fits) {
+        recorder->next_sector += record_sectors;
+        recorder->sequence++;
+        recorder->stats.sectors_used = recorder->next_sector;
+        if (tail_len) {
+            recorder->stats.tail_copies++;
+        }
+    }
+    portEXIT_CRITICAL(&recorder->lock);
+    if (!fits) {
+        xQueueSend(recorder->free_slots, &slot, 0);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    slot->stream = stream;
+    slot->frame = frame;
+    slot->frame_len = frame_len;
+    slot->eof_us = frame->timestamp.host_eof_us;
+    slot->result = ESP_OK;
+    slot->pending = 1;
+
+    uint8_t *header_sector = slot->sectors;
+    uint8_t *tail_sector = slot->sectors + sector_size;
+    const uvc_msc_record_header_t header = {
+        .magic = UVC_MSC_RECORD_MAGIC,
+        .version = UVC_MSC_RECORD_VERSION,
+        .header_len = sizeof(uvc_msc_record_header_t),
+        .session = recorder->session,
+        .sequence = sequence,
+        .frame_len = frame_len,
+        .record_sectors = record_sectors,
+        .format = frame->vs_format.format,
+        .pts_valid = frame->timestamp.pts_valid,
+        .h_res = frame->vs_format.h_res,
+        .v_res = frame->vs_format.v_res,
+        .pts = frame->timestamp.pts,
+        .host_eof_us = frame->timestamp.host_eof_us,
+    };
+    memset(header_sector, 0, sector_size);
+    memcpy(header_sector, &header, sizeof(header));
+    if (tail_len) {
+        memcpy(tail_sector, frame->data + (size_t)direct_sectors * sector_size, tail_len);
+        memset(tail_sector + tail_len, 0, sector_size - tail_len);
+    }
+
+    // The header is written last, a record with valid header is complete even if the recording is interrupted.
+    // Requests after a failed one are cancelled by the MSC worker, so no header follows missing data.
+    int queued = 0;
+    esp_err_t ret = ESP_OK;
+    if (direct_sectors) {
+        ret = slot_queue_write(slot, sector + 1, direct_sectors, frame->data);
+        queued += (ret == ESP_OK);
+    }
+    if (ret == ESP_OK && tail_len) {
+        ret = slot_queue_write(slot, sector + 1 + direct_sectors, 1, tail_sector);
+        queued += (ret == ESP_OK);
+    }
+    if (ret == ESP_OK) {
+        ret = slot_queue_write(slot, sector, 1, header_sector);
+        queued += (ret == ESP_OK);
+    }
+
+    if (ret != ESP_OK) {
+        // The record is never completed, following records would not be found behind it
+        ESP_LOGE(TAG, "Write of frame %"PRIu32" could not be queued (0x%x), recording stopped", sequence, ret);
+        portENTER_CRITICAL(&recorder->lock);
+        if (recorder->error == ESP_OK) {
+            recorder->error = ret;
+        }
+        portEXIT_CRITICAL(&recorder->lock);
+        if (queued == 0) {
+            // Nothing references the frame, the caller keeps it
+            xQueueSend(recorder->free_slots, &slot, 0);
+            return ret;
+        }
+    }
+    slot_release(slot, ret); // Queued requests hold the frame, it is returned after the last one
+    return ESP_OK;
+}
+
+esp_err_t uvc_msc_recorder_get_stats(uvc_msc_recorder_hdl_t recorder, uvc_msc_recorder_stats_t *stats_ret)
+{
+    ESP_RETURN_ON_FALSE(recorder && stats_ret, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    portENTER_CRITICAL(&recorder->lock);
+    *stats_ret = recorder->stats;
+    if (recorder->stats.frames_written) {
+        stats_ret->write_latency_avg_us = recorder->latency_sum_us / recorder->stats.frames_written;
+    }
+    portEXIT_CRITICAL(&recorder->lock);
+    return ESP_OK;
+}
+
+esp_err_t uvc_msc_recorder_reset_stats(uvc_msc_recorder_hdl_t recorder)
+{
+    ESP_RETURN_ON_FALSE(recorder, ESP_ERR_INVALID_ARG, TAG, "recorder can't be NULL");
+    portENTER_CRITICAL(&recorder->lock);
+    memset(&recorder->stats, 0, sizeof(recorder->stats));
+    recorder->stats.sectors_used = recorder->next_sector;
+    recorder->latency_sum_us = 0;
+    portEXIT_CRITICAL(&recorder->lock);
+    return ESP_OK;
+}
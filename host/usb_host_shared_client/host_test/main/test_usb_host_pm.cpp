@@ -0,0 +1,249 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "usb/usb_host.h"
+#include "usb/usb_host_sim.h"
+#include "usb/usb_host_pm.h"
+#include "test_sim_helpers.hpp"
+
+#define TEST_TRANSFERS_NUM (2)
+
+/**
+ * @brief Class driver keeping its transfers in flight on one endpoint
+ *
+ * Completed transfers are submitted again while the driver is streaming. Suspend stops the endpoint and waits
+ * for the canceled transfers, resume submits all transfers that are not in flight.
+ */
+struct test_driver {
+    usb_host_pm_driver_t id;
+    const char *name;
+    uint8_t ep;
+    test_sim *sim = nullptr;
+    std::vector<std::string> *calls = nullptr;
+    usb_device_handle_t dev_hdl = nullptr;
+    std::vector<usb_transfer_t *> transfers;
+    std::vector<usb_transfer_t *> idle;
+    bool streaming = false;
+    int in_flight = 0;
+    uint32_t completed = 0;
+    uint32_t canceled = 0;
+    esp_err_t suspend_ret = ESP_OK;             // Error returned by suspend hook, before anything is stopped
+
+    static void transfer_cb(usb_transfer_t *transfer)
+    {
+        test_driver *driver = static_cast<test_driver *>(transfer->context);
+        driver->in_flight--;
+        if (transfer->status == USB_TRANSFER_STATUS_COMPLETED) {
+            driver->completed++;
+        } else if (transfer->status == USB_TRANSFER_STATUS_CANCELED) {
+            driver->canceled++;
+        }
+        if (driver->streaming && usb_host_transfer_submit(transfer) == ESP_OK) {
+            driver->in_flight++;
+        } else {
+            driver->idle.push_back(transfer);
+        }
+    }
+
+    void start()
+    {
+        streaming = true;
+        for (usb_transfer_t *transfer : idle) {
+            REQUIRE(ESP_OK == usb_host_transfer_submit(transfer));
+            in_flight++;
+        }
+        idle.clear();
+    }
+
+    void stop()
+    {
+        streaming = false;
+        REQUIRE(ESP_OK == usb_host_endpoint_halt(dev_hdl, ep));
+        REQUIRE(ESP_OK == usb_host_endpoint_flush(dev_hdl, ep));
+        REQUIRE(ESP_OK == usb_host_endpoint_clear(dev_hdl, ep));
+
+        // Canceled transfers are delivered right after flush, transfers completed just before flush after completion latency
+        sim->handle_events();
+        for (int i = 0; i < 10 && in_flight > 0; i++) {
+            usb_host_sim_advance(1000);
+            sim->handle_events();
+        }
+    }
+
+    static esp_err_t suspend(void *arg)
+    {
+        test_driver *driver = static_cast<test_driver *>(arg);
+        driver->calls->push_back(std::string("suspend ") + driver->name);
+        if (driver->suspend_ret != ESP_OK) {
+            return driver->suspend_ret;
+        }
+        driver->stop();
+        return driver->in_flight == 0 ? ESP_OK : ESP_ERR_INVALID_STATE;
+    }
+
+    static esp_err_t resume(void *arg)
+    {
+        test_driver *driver = static_cast<test_driver *>(arg);
+        driver->calls->push_back(std::string("resume ") + driver->name);
+        driver->start();
+        return ESP_OK;
+    }
+};
+
+static const usb_host_pm_ops_t test_pm_ops = {
+    .suspend = test_driver::suspend,
+    .resume = test_driver::resume,
+};
+
+static usb_host_pm_stats_t test_pm_stats()
+{
+    usb_host_pm_stats_t stats;
+    REQUIRE(ESP_OK == usb_host_pm_get_stats(&stats));
+    return stats;
+}
+
+static void test_drivers_run(test_sim &sim, uint32_t time_us)
+{
+    usb_host_sim_run(time_us, [](void *arg) {
+        static_cast<test_sim *>(arg)->handle_events();
+    }, &sim);
+}
+
+SCENARIO("Coordinated suspend and resume of class drivers", "[pm]")
+{
+    usb_host_sim_config_t config = USB_HOST_SIM_CONFIG_DEFAULT();
+    config.speed = USB_SPEED_FULL;
+    test_sim sim(config);
+    usb_host_sim_device_hdl_t dev = sim.connect(test_cfg_desc_fs, USB_SPEED_FULL);
+    usb_device_handle_t dev_hdl;
+    REQUIRE(ESP_OK == usb_host_device_open(sim.client, usb_host_sim_device_get_addr(dev), &dev_hdl));
+    REQUIRE(ESP_OK == usb_host_interface_claim(sim.client, dev_hdl, 0, 0));
+
+    std::vector<std::string> calls;
+    test_driver drivers[] = {
+        {USB_HOST_PM_DRIVER_CDC_ACM, "CDC-ACM", test_ep_bulk_in},
+        {USB_HOST_PM_DRIVER_HID, "HID", test_ep_int_in},
+        {USB_HOST_PM_DRIVER_APP, "APP", test_ep_bulk_out},
+    };
+    uint32_t packets[3] = {};
+    for (int i = 0; i < 3; i++) {
+        test_driver &driver = drivers[i];
+        REQUIRE(ESP_OK == usb_host_sim_endpoint_set_cb(dev, driver.ep, test_ep_always_ready, &packets[i]));
+        driver.sim = &sim;
+        driver.calls = &calls;
+        driver.dev_hdl = dev_hdl;
+        for (int j = 0; j < TEST_TRANSFERS_NUM; j++) {
+            usb_transfer_t *transfer = sim.alloc(dev_hdl, driver.ep, 64);
+            transfer->callback = test_driver::transfer_cb;
+            transfer->context = &driver;
+            driver.transfers.push_back(transfer);
+            driver.idle.push_back(transfer);
+        }
+        REQUIRE(ESP_OK == usb_host_pm_register(driver.id, &test_pm_ops, &driver));
+        driver.start();
+    }
+    test_drivers_run(sim, 10 * 1000);
+    const usb_host_pm_stats_t stats_before = test_pm_stats();
+    REQUIRE_FALSE(stats_before.suspended);
+
+    GIVEN("Transfers in flight on all endpoints") {
+        for (test_driver &driver : drivers) {
+            REQUIRE(driver.in_flight == TEST_TRANSFERS_NUM);
+            REQUIRE(driver.completed > 0);
+        }
+
+        WHEN("Bus is suspended") {
+            REQUIRE(ESP_OK == usb_host_pm_suspend());
+
+            THEN("All drivers stopped their transfers, in the order of drivers") {
+                REQUIRE(calls == std::vector<std::string> {"suspend CDC-ACM", "suspend HID", "suspend APP"});
+                const usb_host_pm_stats_t stats = test_pm_stats();
+                REQUIRE(stats.suspended);
+                REQUIRE(stats.suspends == stats_before.suspends + 1);
+                REQUIRE(stats.suspend_failures == stats_before.suspend_failures);
+#if USB_HOST_PM_ROOT_PORT_SUSPEND
+                usb_host_sim_stats_t sim_stats;
+                REQUIRE(ESP_OK == usb_host_sim_get_stats(&sim_stats));
+                REQUIRE(sim_stats.suspended);
+#endif
+
+                uint32_t completed[3];
+                for (int i = 0; i < 3; i++) {
+                    REQUIRE(drivers[i].in_flight == 0);
+                    REQUIRE(drivers[i].canceled > 0);
+                    completed[i] = drivers[i].completed;
+                }
+                test_drivers_run(sim, 10 * 1000);
+                for (int i = 0; i < 3; i++) {
+                    REQUIRE(drivers[i].completed == completed[i]);
+                }
+            }
+
+            AND_WHEN("Bus is resumed") {
+                uint32_t completed[3];
+                for (int i = 0; i < 3; i++) {
+                    completed[i] = drivers[i].completed;
+                }
+                calls.clear();
+                REQUIRE(ESP_OK == usb_host_pm_resume());
+
+                THEN("Each driver restarted its transfers, in the reverse order of suspend") {
+                    REQUIRE(calls == std::vector<std::string> {"resume APP", "resume HID", "resume CDC-ACM"});
+                    REQUIRE_FALSE(test_pm_stats().suspended);
+                    test_drivers_run(sim, 10 * 1000);
+                    for (int i = 0; i < 3; i++) {
+                        REQUIRE(drivers[i].in_flight == TEST_TRANSFERS_NUM);
+                        REQUIRE(drivers[i].completed > completed[i]);
+                    }
+                }
+            }
+        }
+    }
+
+    GIVEN("Driver failing to suspend") {
+        drivers[1].suspend_ret = ESP_ERR_TIMEOUT;
+        REQUIRE(ESP_ERR_TIMEOUT == usb_host_pm_suspend());
+
+        THEN("Drivers suspended so far are resumed and the bus stays active") {
+            // The failing driver is resumed too, the driver after it was not touched
+            REQUIRE(calls == std::vector<std::string> {"suspend CDC-ACM", "suspend HID", "resume HID", "resume CDC-ACM"});
+            const usb_host_pm_stats_t stats = test_pm_stats();
+            REQUIRE_FALSE(stats.suspended);
+            REQUIRE(stats.suspends == stats_before.suspends);
+            REQUIRE(stats.suspend_failures == stats_before.suspend_failures + 1);
+            REQUIRE(ESP_ERR_INVALID_STATE == usb_host_pm_resume());
+
+            uint32_t completed[3];
+            for (int i = 0; i < 3; i++) {
+                completed[i] = drivers[i].completed;
+            }
+            test_drivers_run(sim, 10 * 1000);
+            for (int i = 0; i < 3; i++) {
+                REQUIRE(drivers[i].in_flight == TEST_TRANSFERS_NUM);
+                REQUIRE(drivers[i].completed > completed[i]);
+            }
+        }
+    }
+
+    // Leave the bus active and the drivers deregistered for the next test
+    if (test_pm_stats().suspended) {
+        REQUIRE(ESP_OK == usb_host_pm_resume());
+    }
+    for (test_driver &driver : drivers) {
+        REQUIRE(ESP_OK == usb_host_pm_deregister(driver.id));
+        driver.stop();
+        REQUIRE(driver.in_flight == 0);
+        for (usb_transfer_t *transfer : driver.transfers) {
+            REQUIRE(ESP_OK == usb_host_transfer_free(transfer));
+        }
+    }
+    REQUIRE(ESP_OK == usb_host_interface_release(sim.client, dev_hdl, 0));
+    REQUIRE(ESP_OK == usb_host_device_close(sim.client, dev_hdl));
+}
@@ -0,0 +1,50 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/**
+ * @brief USB Host Library calls of the host class drivers built with the shared client
+ *
+ * Define USB_HOST_CLIENT_DRIVER to the driver of usb_host_mem_driver_t without its prefix, e.g. CDC_ACM,
+ * then include this header. Drivers built without usb_host_shared_client include usb_host_client_fallback.h
+ * of their private includes instead, which defines the same macros calling the USB Host Library directly.
+ */
+
+#include "esp_heap_caps.h"
+#include "usb/usb_host_shared_client.h"
+#include "usb/usb_host_mem.h"
+#include "usb/usb_host_pm.h"
+#include "usb/usb_host_transfer_pool.h"
+#include "usb/usb_host_trace.h"
+
+#ifndef USB_HOST_CLIENT_DRIVER
+#error "USB_HOST_CLIENT_DRIVER must be defined before including usb_host_client_macros.h"
+#endif
+
+#define USB_HOST_CLIENT_CONCAT_(a, b)   a##b
+#define USB_HOST_CLIENT_CONCAT(a, b)    USB_HOST_CLIENT_CONCAT_(a, b)
+#define USB_HOST_CLIENT_MEM_DRIVER      USB_HOST_CLIENT_CONCAT(USB_HOST_MEM_DRIVER_, USB_HOST_CLIENT_DRIVER)
+#define USB_HOST_CLIENT_TRACE_DRIVER    USB_HOST_CLIENT_CONCAT(USB_HOST_TRACE_DRIVER_, USB_HOST_CLIENT_DRIVER)
+
+// Drivers sharing the client open the same device, the shared client counts the opens
+#define CLIENT_DEVICE_OPEN      usb_host_shared_client_device_open
+#define CLIENT_DEVICE_CLOSE     usb_host_shared_client_device_close
+// Transfers come from the transfer pool if it is installed, from heap otherwise, and are accounted in the memory footprint
+#define CLIENT_TRANSFER_ALLOC(size, num_isoc, xfer) usb_host_mem_transfer_alloc(USB_HOST_CLIENT_MEM_DRIVER, size, num_isoc, xfer)
+#define CLIENT_TRANSFER_FREE(xfer)                  usb_host_mem_transfer_free(USB_HOST_CLIENT_MEM_DRIVER, xfer)
+// Transfer and callback events are recorded if CONFIG_USB_HOST_TRACE is enabled, otherwise the macros are empty
+#define CLIENT_TRANSFER_SUBMIT(xfer)                    usb_host_trace_transfer_submit(USB_HOST_CLIENT_TRACE_DRIVER, xfer)
+#define CLIENT_TRANSFER_SUBMIT_CONTROL(client, xfer)    usb_host_trace_transfer_submit_control(USB_HOST_CLIENT_TRACE_DRIVER, client, xfer)
+#define CLIENT_TRACE(event, ep, len, id)    USB_HOST_TRACE(USB_HOST_CLIENT_TRACE_DRIVER, USB_HOST_TRACE_EVENT_##event, ep, len, 0, id)
+#define CLIENT_TRACE_COMPLETE(xfer)         USB_HOST_TRACE_COMPLETE(USB_HOST_CLIENT_TRACE_DRIVER, xfer)
+// Driver structures are accounted in the memory footprint, and taken from the arenas of the static allocation mode if it is installed
+#define CLIENT_MALLOC(category, size)       usb_host_mem_malloc(USB_HOST_CLIENT_MEM_DRIVER, USB_HOST_MEM_##category, size, MALLOC_CAP_DEFAULT)
+#define CLIENT_CALLOC(category, n, size)    usb_host_mem_calloc(USB_HOST_CLIENT_MEM_DRIVER, USB_HOST_MEM_##category, n, size, MALLOC_CAP_DEFAULT)
+#define CLIENT_FREE(category, ptr, size)    usb_host_mem_free(USB_HOST_CLIENT_MEM_DRIVER, USB_HOST_MEM_##category, ptr, size)
+// Memory allocated by others, e.g. FreeRTOS ring buffers, is only accounted in the memory footprint
+#define CLIENT_MEM_ALLOC(category, size)    usb_host_mem_alloc_record(USB_HOST_CLIENT_MEM_DRIVER, USB_HOST_MEM_##category, size)
+#define CLIENT_MEM_FREE(category, size)     usb_host_mem_free_record(USB_HOST_CLIENT_MEM_DRIVER, USB_HOST_MEM_##category, size)
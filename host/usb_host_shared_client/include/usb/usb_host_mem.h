@@ -0,0 +1,226 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_err.h"
+#include "usb/usb_host.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Drivers whose memory is accounted, in the order of usb_host_transfer_pool_user_t
+ */
+typedef enum {
+    USB_HOST_MEM_DRIVER_CDC_ACM = 0,
+    USB_HOST_MEM_DRIVER_HID,
+    USB_HOST_MEM_DRIVER_MSC,
+    USB_HOST_MEM_DRIVER_UAC,
+    USB_HOST_MEM_DRIVER_UVC,
+    USB_HOST_MEM_DRIVER_APP,                    /**< Application and other drivers */
+    USB_HOST_MEM_DRIVER_MAX,
+} usb_host_mem_driver_t;
+
+/**
+ * @brief Categories of accounted memory
+ */
+typedef enum {
+    USB_HOST_MEM_TRANSFER = 0,                  /**< USB transfers with their data buffers and isochronous packet descriptors */
+    USB_HOST_MEM_BUFFER,                        /**< Frame buffers, audio rings, RX rings, report queues and disk caches */
+    USB_HOST_MEM_DESCRIPTOR,                    /**< Copies of descriptors and structures parsed from them */
+    USB_HOST_MEM_CONTROL,                       /**< Driver, device, interface and stream structures */
+    USB_HOST_MEM_CATEGORY_MAX,
+} usb_host_mem_category_t;
+
+/**
+ * @brief Memory footprint of one driver
+ */
+typedef struct {
+    size_t bytes[USB_HOST_MEM_CATEGORY_MAX];    /**< Bytes currently allocated in each category */
+    size_t total;                               /**< Bytes currently allocated in all categories */
+    size_t peak;                                /**< Highest total since boot */
+    uint32_t allocs;                            /**< Number of allocations since boot */
+    uint32_t frees;                             /**< Number of frees since boot, allocs - frees blocks are allocated */
+} usb_host_mem_footprint_t;
+
+/**
+ * @brief Memory arenas of the static allocation mode
+ */
+typedef struct {
+    void *arena;                                /**< Memory of all categories, must be internal DMA capable RAM */
+    size_t arena_size;                          /**< Size of arena in bytes */
+    void *buffer_arena;                         /**< Memory of buffers without DMA or internal RAM requirement, e.g. in PSRAM. NULL: arena is used */
+    size_t buffer_arena_size;                   /**< Size of buffer_arena in bytes */
+} usb_host_mem_static_config_t;
+
+/**
+ * @brief Usage of the memory arenas
+ */
+typedef struct {
+    size_t free_bytes;                          /**< Free bytes of the arena */
+    size_t min_free_bytes;                      /**< Lowest free bytes since the arena was installed */
+    size_t largest_free_block;                  /**< Largest block which can be allocated now */
+    size_t buffer_free_bytes;                   /**< Free bytes of the buffer arena, 0 if there is none */
+    size_t buffer_min_free_bytes;               /**< Lowest free bytes of the buffer arena */
+    size_t buffer_largest_free_block;           /**< Largest block of the buffer arena which can be allocated now */
+    uint32_t failures;                          /**< Allocations which did not fit in the arenas */
+} usb_host_mem_static_info_t;
+
+/**
+ * @brief Install the static allocation mode
+ *
+ * Class drivers built with usb_host_shared_client component take their structures, descriptors and buffers
+ * from the arenas instead of heap, until the mode is uninstalled. An allocation that does not fit fails, there is
+ * no fallback to heap. Transfers come from the transfer pool, which must be installed before, without heap_fallback.
+ * Install the mode before the class drivers, so no memory of the drivers is in heap.
+ *
+ * The arenas are managed by a constant time allocator of ESP-IDF heap, so allocations on the data path,
+ * e.g. adaptive UVC frame buffers, have deterministic latency.
+ *
+ * @param[in] config Arenas, provided by the application and not used by it until the mode is uninstalled
+ * @return
+ *   - ESP_OK:                 Static allocation mode installed
+ *   - ESP_ERR_INVALID_ARG:    config is NULL or arena is NULL or too small
+ *   - ESP_ERR_INVALID_STATE:  Already installed or the transfer pool is not installed
+ */
+esp_err_t usb_host_mem_static_install(const usb_host_mem_static_config_t *config);
+
+/**
+ * @brief Uninstall the static allocation mode
+ *
+ * @return
+ *   - ESP_OK:                 Uninstalled, the arenas can be reused by the application
+ *   - ESP_ERR_INVALID_STATE:  Not installed or memory of the arenas is still allocated
+ */
+esp_err_t usb_host_mem_static_uninstall(void);
+
+/**
+ * @brief Get usage of the memory arenas
+ *
+ * @param[out] info Usage of the arenas
+ * @return
+ *   - ESP_OK:                 Usage copied
+ *   - ESP_ERR_INVALID_ARG:    info is NULL
+ *   - ESP_ERR_INVALID_STATE:  Static allocation mode is not installed
+ */
+esp_err_t usb_host_mem_static_get_info(usb_host_mem_static_info_t *info);
+
+/**
+ * @brief Allocate and account memory of a driver
+ *
+ * The memory comes from the arenas in static allocation mode, from heap with the capabilities otherwise.
+ *
+ * @param[in] driver   Driver holding the memory
+ * @param[in] category Category of the memory
+ * @param[in] size     Size in bytes
+ * @param[in] caps     Heap capabilities, MALLOC_CAP_DMA or MALLOC_CAP_INTERNAL select the arena in static allocation mode
+ * @return Allocated memory, NULL if out of memory
+ */
+void *usb_host_mem_malloc(usb_host_mem_driver_t driver, usb_host_mem_category_t category, size_t size, uint32_t caps);
+
+/**
+ * @brief Allocate, zero and account memory of a driver, as usb_host_mem_malloc()
+ */
+void *usb_host_mem_calloc(usb_host_mem_driver_t driver, usb_host_mem_category_t category, size_t n, size_t size, uint32_t caps);
+
+/**
+ * @brief Allocate aligned memory of a driver, as usb_host_mem_malloc()
+ *
+ * @param[in] alignment Alignment in bytes, power of two
+ */
+void *usb_host_mem_aligned_alloc(usb_host_mem_driver_t driver, usb_host_mem_category_t category, size_t alignment, size_t size, uint32_t caps);
+
+/**
+ * @brief Resize memory of a driver, as usb_host_mem_malloc()
+ *
+ * @param[in] ptr      Memory to resize, can be NULL
+ * @param[in] old_size Size of ptr as allocated
+ * @param[in] size     New size in bytes
+ * @return Resized memory, NULL if out of memory and ptr is kept
+ */
+void *usb_host_mem_realloc(usb_host_mem_driver_t driver, usb_host_mem_category_t category, void *ptr, size_t old_size, size_t size, uint32_t caps);
+
+/**
+ * @brief Free memory allocated by usb_host_mem_malloc() and the other allocation functions
+ *
+ * @param[in] driver   Driver holding the memory
+ * @param[in] category Category of the memory
+ * @param[in] ptr      Memory, can be NULL
+ * @param[in] size     Size of ptr as allocated
+ */
+void usb_host_mem_free(usb_host_mem_driver_t driver, usb_host_mem_category_t category, void *ptr, size_t size);
+
+/**
+ * @brief Account an allocation of a driver
+ *
+ * Class drivers built with usb_host_shared_client component allocate by usb_host_mem_malloc() and the other
+ * allocation functions, which account the memory. Use this function for memory allocated elsewhere,
+ * e.g. allocations of the application accounted with USB_HOST_MEM_DRIVER_APP.
+ *
+ * @param[in] driver   Driver holding the memory
+ * @param[in] category Category of the memory
+ * @param[in] size     Allocated bytes
+ */
+void usb_host_mem_alloc_record(usb_host_mem_driver_t driver, usb_host_mem_category_t category, size_t size);
+
+/**
+ * @brief Account a free of a driver, with the size accounted by usb_host_mem_alloc_record()
+ *
+ * @param[in] driver   Driver holding the memory
+ * @param[in] category Category of the memory
+ * @param[in] size     Freed bytes
+ */
+void usb_host_mem_free_record(usb_host_mem_driver_t driver, usb_host_mem_category_t category, size_t size);
+
+/**
+ * @brief Allocate a transfer from the transfer pool and account it
+ *
+ * @param[in]  driver           Driver holding the transfer, charged in the transfer pool too
+ * @param[in]  data_buffer_size Size of the data buffer in bytes
+ * @param[in]  num_isoc_packets Number of isochronous packets
+ * @param[out] transfer         Allocated transfer
+ * @return Errors of usb_host_transfer_pool_alloc()
+ */
+esp_err_t usb_host_mem_transfer_alloc(usb_host_mem_driver_t driver, size_t data_buffer_size, int num_isoc_packets, usb_transfer_t **transfer);
+
+/**
+ * @brief Free a transfer allocated by usb_host_mem_transfer_alloc()
+ *
+ * @param[in] driver   Driver holding the transfer
+ * @param[in] transfer Transfer, can be NULL
+ * @return Errors of usb_host_transfer_pool_free()
+ */
+esp_err_t usb_host_mem_transfer_free(usb_host_mem_driver_t driver, usb_transfer_t *transfer);
+
+/**
+ * @brief Get the memory footprint of a driver
+ *
+ * @param[in]  driver    Driver
+ * @param[out] footprint Footprint
+ * @return
+ *   - ESP_OK:                 Footprint copied
+ *   - ESP_ERR_INVALID_ARG:    Invalid driver or footprint is NULL
+ */
+esp_err_t usb_host_mem_get_footprint(usb_host_mem_driver_t driver, usb_host_mem_footprint_t *footprint);
+
+/**
+ * @brief Write a table of the footprints of all drivers and their sum
+ *
+ * @param[in] stream Output stream, e.g. stdout
+ * @return
+ *   - ESP_OK:                 Report written
+ *   - ESP_ERR_INVALID_ARG:    stream is NULL
+ */
+esp_err_t usb_host_mem_report(FILE *stream);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,128 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_idf_version.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief The USB Host Library can suspend and resume the root port
+ *
+ * With older ESP-IDF, usb_host_pm_suspend() only quiesces the class drivers: the bus keeps sending SOFs
+ * and the devices stay active, but no transfers are in flight.
+ */
+#define USB_HOST_PM_ROOT_PORT_SUSPEND   (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(6, 0, 0))
+
+/**
+ * @brief Drivers taking part in suspend and resume, in the order of usb_host_mem_driver_t
+ */
+typedef enum {
+    USB_HOST_PM_DRIVER_CDC_ACM = 0,
+    USB_HOST_PM_DRIVER_HID,
+    USB_HOST_PM_DRIVER_MSC,
+    USB_HOST_PM_DRIVER_UAC,
+    USB_HOST_PM_DRIVER_UVC,
+    USB_HOST_PM_DRIVER_APP,                     /**< Application and other drivers */
+    USB_HOST_PM_DRIVER_MAX,
+} usb_host_pm_driver_t;
+
+/**
+ * @brief Suspend and resume hooks of a driver
+ */
+typedef struct {
+    esp_err_t (*suspend)(void *arg);            /**< Stop all transfers of the driver, keeping its devices open and configured.
+                                                     Resume is called also after a failed suspend, to restart what was stopped */
+    esp_err_t (*resume)(void *arg);             /**< Restore the state before suspend and submit the transfers again */
+} usb_host_pm_ops_t;
+
+/**
+ * @brief Suspend and resume statistics
+ */
+typedef struct {
+    uint32_t suspends;                          /**< Number of successful suspends */
+    uint32_t suspend_failures;                  /**< Number of suspends rolled back, because a driver or the root port failed */
+    uint32_t last_suspend_us;                   /**< Time of the last suspend, from the first driver hook to the suspended root port */
+    uint32_t last_resume_us;                    /**< Time of the last resume, from resume signaling to the last driver hook */
+    uint32_t max_resume_us;                     /**< Longest resume since boot */
+    bool suspended;                             /**< The bus is suspended now */
+} usb_host_pm_stats_t;
+
+/**
+ * @brief Register suspend and resume hooks of a driver
+ *
+ * Class drivers built with usb_host_shared_client component register their hooks when installed
+ * and deregister them when uninstalled. A driver registered while the bus is suspended is not resumed.
+ *
+ * @param[in] driver  Driver
+ * @param[in] ops     Hooks, must stay valid until deregistered
+ * @param[in] arg     Argument of the hooks
+ * @return
+ *   - ESP_OK:                 Registered
+ *   - ESP_ERR_INVALID_ARG:    Invalid driver or ops without hooks
+ *   - ESP_ERR_INVALID_STATE:  The driver is already registered
+ */
+esp_err_t usb_host_pm_register(usb_host_pm_driver_t driver, const usb_host_pm_ops_t *ops, void *arg);
+
+/**
+ * @brief Deregister suspend and resume hooks of a driver
+ *
+ * @param[in] driver  Driver
+ * @return
+ *   - ESP_OK:                 Deregistered
+ *   - ESP_ERR_INVALID_ARG:    Invalid driver
+ *   - ESP_ERR_INVALID_STATE:  Suspend or resume is in progress
+ */
+esp_err_t usb_host_pm_deregister(usb_host_pm_driver_t driver);
+
+/**
+ * @brief Suspend the USB bus
+ *
+ * All registered drivers stop their transfers, in the order of usb_host_pm_driver_t, then the root port is suspended.
+ * Devices stay open, configured and enumerated. If a driver or the root port fails, the drivers suspended
+ * so far are resumed again and the error is returned.
+ *
+ * @note Must not be called from a callback of a class driver or from the task handling the USB Host events
+ * @return
+ *   - ESP_OK:                 Bus suspended
+ *   - ESP_ERR_INVALID_STATE:  Already suspended, or suspend or resume is in progress
+ *   - Else:                   Error of a driver hook or of the root port, nothing is suspended
+ */
+esp_err_t usb_host_pm_suspend(void);
+
+/**
+ * @brief Resume the USB bus
+ *
+ * The root port signals resume, then all registered drivers restore their alternate settings and committed formats
+ * and submit their transfers again, in the reverse order of suspend. All drivers are resumed, also if one of them fails.
+ *
+ * @note Must not be called from a callback of a class driver or from the task handling the USB Host events
+ * @return
+ *   - ESP_OK:                 Bus resumed
+ *   - ESP_ERR_INVALID_STATE:  Not suspended, or suspend or resume is in progress
+ *   - Else:                   Error of the root port or of the first failing driver hook
+ */
+esp_err_t usb_host_pm_resume(void);
+
+/**
+ * @brief Get suspend and resume statistics
+ *
+ * @param[out] stats Statistics
+ * @return
+ *   - ESP_OK:                 Statistics returned
+ *   - ESP_ERR_INVALID_ARG:    stats is NULL
+ */
+esp_err_t usb_host_pm_get_stats(usb_host_pm_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,129 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+#include "usb/usb_host.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Configuration of the shared USB Host client
+ */
+typedef struct {
+    bool create_background_task;    /**< When set to true, background task handling USB events is created.
+                                         Otherwise user has to periodically call usb_host_shared_client_handle_events() */
+    size_t task_priority;           /**< Task priority of created background task */
+    size_t stack_size;              /**< Stack size of created background task. Callbacks of all registered drivers run in it */
+    BaseType_t core_id;             /**< Select core on which background task will run or tskNO_AFFINITY */
+    int max_num_event_msg;          /**< Client event queue length, shared by all registered drivers. 0: Default of 16 */
+} usb_host_shared_client_config_t;
+
+/**
+ * @brief Install the shared USB Host client
+ *
+ * Class drivers installed with their shared client option register to this client instead of their own.
+ * The events of all of them, device connections and transfer completions, are handled in one task,
+ * which saves a task with its stack and context switches per driver.
+ *
+ * @note The USB Host Library must be installed before this call.
+ *
+ * @param[in] config Configuration
+ * @return
+ *   - ESP_OK:                 Installed
+ *   - ESP_ERR_INVALID_ARG:    Invalid configuration
+ *   - ESP_ERR_INVALID_STATE:  Already installed
+ *   - ESP_ERR_NO_MEM:         Not enough memory
+ */
+esp_err_t usb_host_shared_client_install(const usb_host_shared_client_config_t *config);
+
+/**
+ * @brief Uninstall the shared USB Host client
+ *
+ * @return
+ *   - ESP_OK:                 Uninstalled
+ *   - ESP_ERR_INVALID_STATE:  Not installed, or drivers are still registered
+ */
+esp_err_t usb_host_shared_client_uninstall(void);
+
+/**
+ * @brief Handle events of the shared USB Host client
+ *
+ * If the client was installed with create_background_task=false configuration,
+ * application needs to handle USB Host events itself.
+ *
+ * @param[in] timeout  Timeout in FreeRTOS tick
+ * @return
+ *   - ESP_OK:                 All events handled
+ *   - ESP_ERR_TIMEOUT:        No events handled within the timeout
+ *   - ESP_ERR_INVALID_STATE:  Not installed
+ *   - ESP_FAIL:               Event handling finished, client uninstalled. You do not have to call this function further
+ */
+esp_err_t usb_host_shared_client_handle_events(TickType_t timeout);
+
+/**
+ * @brief Register a class driver to the shared client
+ *
+ * Client events are passed to the callbacks of all registered drivers, in the order of registration.
+ * The callback must not deregister its own driver.
+ *
+ * @param[in]  event_cb       Client event callback of the driver
+ * @param[in]  arg            Argument of the callback
+ * @param[out] client_hdl_ret Shared client handle, for opening devices, claiming interfaces and control transfers
+ * @return
+ *   - ESP_OK:                 Registered
+ *   - ESP_ERR_INVALID_ARG:    event_cb or client_hdl_ret is NULL
+ *   - ESP_ERR_INVALID_STATE:  Shared client is not installed
+ *   - ESP_ERR_NO_MEM:         Not enough memory
+ */
+esp_err_t usb_host_shared_client_register(usb_host_client_event_cb_t event_cb, void *arg, usb_host_client_handle_t *client_hdl_ret);
+
+/**
+ * @brief Deregister a class driver from the shared client
+ *
+ * Waits until the current event dispatch finishes, so the callback is not called after this returns.
+ *
+ * @param[in] event_cb  Callback passed to usb_host_shared_client_register()
+ * @param[in] arg       Argument passed to usb_host_shared_client_register()
+ * @return
+ *   - ESP_OK:                 Deregistered
+ *   - ESP_ERR_NOT_FOUND:      Driver is not registered
+ */
+esp_err_t usb_host_shared_client_deregister(usb_host_client_event_cb_t event_cb, void *arg);
+
+/**
+ * @brief Open a device, usb_host_device_open() replacement for class drivers
+ *
+ * A client can open a device only once. With the shared client several drivers, e.g. UVC and UAC of one
+ * webcam, open the same device, so the opens are counted and the device is closed by the last close.
+ * Other clients are passed through to usb_host_device_open().
+ *
+ * @param[in]  client_hdl  Client handle
+ * @param[in]  dev_addr    Device address
+ * @param[out] dev_hdl_ret Device handle
+ * @return See usb_host_device_open()
+ */
+esp_err_t usb_host_shared_client_device_open(usb_host_client_handle_t client_hdl, uint8_t dev_addr, usb_device_handle_t *dev_hdl_ret);
+
+/**
+ * @brief Close a device, usb_host_device_close() replacement for class drivers
+ *
+ * @param[in] client_hdl  Client handle
+ * @param[in] dev_hdl     Device handle
+ * @return See usb_host_device_close()
+ */
+esp_err_t usb_host_shared_client_device_close(usb_host_client_handle_t client_hdl, usb_device_handle_t dev_hdl);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,136 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "usb/usb_host.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define USB_HOST_TRACE_MAGIC    (0x54425355)    /**< "USBT", first word of the dump */
+#define USB_HOST_TRACE_VERSION  (1)
+
+/**
+ * @brief Drivers recording trace events
+ */
+typedef enum {
+    USB_HOST_TRACE_DRIVER_CDC_ACM = 0,
+    USB_HOST_TRACE_DRIVER_HID,
+    USB_HOST_TRACE_DRIVER_MSC,
+    USB_HOST_TRACE_DRIVER_UAC,
+    USB_HOST_TRACE_DRIVER_UVC,
+    USB_HOST_TRACE_DRIVER_APP,                  /**< Application and other drivers */
+} usb_host_trace_driver_t;
+
+/**
+ * @brief Trace events
+ */
+typedef enum {
+    USB_HOST_TRACE_EVENT_SUBMIT = 0,            /**< Transfer submitted. length: Bytes to transfer */
+    USB_HOST_TRACE_EVENT_COMPLETE,              /**< Transfer completed. length: Actual bytes, status: usb_transfer_status_t */
+    USB_HOST_TRACE_EVENT_CALLBACK_ENTER,        /**< User callback called */
+    USB_HOST_TRACE_EVENT_CALLBACK_EXIT,         /**< User callback returned */
+    USB_HOST_TRACE_EVENT_DELIVER,               /**< Frame, report or data delivered to the user. length: Its size */
+} usb_host_trace_event_t;
+
+/**
+ * @brief Trace record, as stored in the dump
+ */
+typedef struct {
+    uint32_t seq;           /**< Sequence number + 1, 0 while the record is written */
+    uint32_t timestamp;     /**< esp_timer time in microseconds, low 32 bits */
+    uint32_t id;            /**< Transfer address or driver object, correlates submit and completion */
+    uint32_t length;        /**< Length in bytes */
+    uint8_t event;          /**< usb_host_trace_event_t */
+    uint8_t driver;         /**< usb_host_trace_driver_t */
+    uint8_t endpoint;       /**< Endpoint address */
+    uint8_t status;         /**< Transfer status */
+} usb_host_trace_record_t;
+
+/**
+ * @brief Header of the dump, followed by num_records records from the oldest
+ */
+typedef struct {
+    uint32_t magic;         /**< USB_HOST_TRACE_MAGIC */
+    uint16_t version;       /**< USB_HOST_TRACE_VERSION */
+    uint16_t record_size;   /**< sizeof(usb_host_trace_record_t) */
+    uint32_t num_records;   /**< Number of records in the dump, fewer follow if recording continued during the dump */
+    uint32_t overwritten;   /**< Records lost since clear, the buffer wrapped around */
+} usb_host_trace_header_t;
+
+/**
+ * @brief Record a trace event
+ *
+ * Lock-free, can be called from any task on any core. Use trace macros below, they compile to nothing
+ * when CONFIG_USB_HOST_TRACE is disabled.
+ */
+void usb_host_trace_record(usb_host_trace_driver_t driver, usb_host_trace_event_t event, uint8_t endpoint,
+                           uint32_t length, uint8_t status, uint32_t id);
+
+/**
+ * @brief Start or stop recording, recording is started at boot
+ *
+ * @param[in] enable Record events
+ */
+void usb_host_trace_enable(bool enable);
+
+/**
+ * @brief Discard all recorded events
+ */
+void usb_host_trace_clear(void);
+
+/**
+ * @brief Write the trace buffer to a stream
+ *
+ * Stop recording before dumping, records written during the dump may be skipped.
+ *
+ * @param[in] stream Stream, e.g. file on SD card or SPIFFS
+ * @param[in] hex    Print the dump in hex lines prefixed by "USBT:", so it can be captured from console log
+ * @return
+ *   - ESP_OK:                 Dumped
+ *   - ESP_ERR_INVALID_ARG:    stream is NULL
+ *   - ESP_FAIL:               Write to the stream failed
+ */
+esp_err_t usb_host_trace_dump(FILE *stream, bool hex);
+
+#if CONFIG_USB_HOST_TRACE
+#define USB_HOST_TRACE(driver, event, endpoint, length, status, id) \
+    usb_host_trace_record(driver, event, endpoint, length, status, (uint32_t)(uintptr_t)(id))
+#else
+#define USB_HOST_TRACE(driver, event, endpoint, length, status, id) ((void)0)
+#endif
+
+#define USB_HOST_TRACE_COMPLETE(driver, transfer) \
+    USB_HOST_TRACE(driver, USB_HOST_TRACE_EVENT_COMPLETE, (transfer)->bEndpointAddress, (transfer)->actual_num_bytes, (transfer)->status, transfer)
+
+/**
+ * @brief usb_host_transfer_submit() with a submit event
+ */
+static inline esp_err_t usb_host_trace_transfer_submit(usb_host_trace_driver_t driver, usb_transfer_t *transfer)
+{
+    USB_HOST_TRACE(driver, USB_HOST_TRACE_EVENT_SUBMIT, transfer->bEndpointAddress, transfer->num_bytes, 0, transfer);
+    return usb_host_transfer_submit(transfer);
+}
+
+/**
+ * @brief usb_host_transfer_submit_control() with a submit event
+ */
+static inline esp_err_t usb_host_trace_transfer_submit_control(usb_host_trace_driver_t driver, usb_host_client_handle_t client_hdl, usb_transfer_t *transfer)
+{
+    USB_HOST_TRACE(driver, USB_HOST_TRACE_EVENT_SUBMIT, 0, transfer->num_bytes, 0, transfer);
+    return usb_host_transfer_submit_control(client_hdl, transfer);
+}
+
+#ifdef __cplusplus
+}
+#endif
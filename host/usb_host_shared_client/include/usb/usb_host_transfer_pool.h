@@ -0,0 +1,140 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "usb/usb_host.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define USB_HOST_TRANSFER_POOL_CLASSES_MAX  (8)     /**< Maximum number of size classes */
+
+/**
+ * @brief Users of the transfer pool, each with its own quota
+ */
+typedef enum {
+    USB_HOST_TRANSFER_POOL_USER_CDC_ACM = 0,
+    USB_HOST_TRANSFER_POOL_USER_HID,
+    USB_HOST_TRANSFER_POOL_USER_MSC,
+    USB_HOST_TRANSFER_POOL_USER_UAC,
+    USB_HOST_TRANSFER_POOL_USER_UVC,
+    USB_HOST_TRANSFER_POOL_USER_APP,                /**< Application and other drivers */
+    USB_HOST_TRANSFER_POOL_USER_MAX,
+} usb_host_transfer_pool_user_t;
+
+/**
+ * @brief Size class of the transfer pool
+ */
+typedef struct {
+    size_t data_buffer_size;        /**< Data buffer size of the transfers in this class */
+    int num_isoc_packets;           /**< Number of isochronous packet descriptors, 0 for control, bulk and interrupt transfers */
+    int num_transfers;              /**< Number of transfers preallocated in this class */
+} usb_host_transfer_pool_class_t;
+
+/**
+ * @brief Configuration of the transfer pool
+ */
+typedef struct {
+    usb_host_transfer_pool_class_t classes[USB_HOST_TRANSFER_POOL_CLASSES_MAX]; /**< Size classes, unused entries have num_transfers 0 */
+    size_t quota[USB_HOST_TRANSFER_POOL_USER_MAX];  /**< Maximum bytes of pool data buffers held by each user. 0: No limit */
+    bool heap_fallback;             /**< Allocate from heap when no pooled transfer fits or the quota is used up, instead of failing */
+} usb_host_transfer_pool_config_t;
+
+/**
+ * @brief Statistics of the transfer pool
+ */
+typedef struct {
+    int in_use[USB_HOST_TRANSFER_POOL_CLASSES_MAX];     /**< Transfers of each class currently allocated */
+    int peak[USB_HOST_TRANSFER_POOL_CLASSES_MAX];       /**< Highest number of allocated transfers of each class */
+    size_t user_bytes[USB_HOST_TRANSFER_POOL_USER_MAX]; /**< Bytes of pool data buffers held by each user */
+    uint32_t heap_fallbacks;        /**< Transfers allocated from heap */
+    uint32_t failures;              /**< Allocations failed, the pool was exhausted or the quota used up */
+} usb_host_transfer_pool_stats_t;
+
+/**
+ * @brief Install the transfer pool
+ *
+ * All transfers are allocated here, in DMA capable memory, and are never freed until uninstall.
+ * Devices connecting and disconnecting reuse them, so the heap does not fragment and the time to open a device
+ * does not depend on the heap state.
+ *
+ * Class drivers built with usb_host_shared_client component allocate their transfers from the pool,
+ * if it is installed. A request takes a free transfer of the smallest class which fits its data buffer size
+ * and has exactly its number of isochronous packets.
+ *
+ * @param[in] config Configuration
+ * @return
+ *   - ESP_OK:                 Installed
+ *   - ESP_ERR_INVALID_ARG:    Invalid configuration
+ *   - ESP_ERR_INVALID_STATE:  Already installed
+ *   - ESP_ERR_NO_MEM:         Not enough memory for the transfers
+ */
+esp_err_t usb_host_transfer_pool_install(const usb_host_transfer_pool_config_t *config);
+
+/**
+ * @brief Uninstall the transfer pool and free its transfers
+ *
+ * @return
+ *   - ESP_OK:                 Uninstalled
+ *   - ESP_ERR_INVALID_STATE:  Not installed, or transfers are still allocated
+ */
+esp_err_t usb_host_transfer_pool_uninstall(void);
+
+/**
+ * @brief Allocate a transfer, usb_host_transfer_alloc() replacement
+ *
+ * The transfer is reset as a newly allocated one, except for the content of its data buffer.
+ * If the pool is not installed, the transfer is allocated by usb_host_transfer_alloc().
+ *
+ * @param[in]  user             User charged for the transfer
+ * @param[in]  data_buffer_size Size of the data buffer in bytes
+ * @param[in]  num_isoc_packets Number of isochronous packets
+ * @param[out] transfer         Allocated transfer
+ * @return
+ *   - ESP_OK:                 Allocated
+ *   - ESP_ERR_INVALID_ARG:    Invalid argument
+ *   - ESP_ERR_NO_MEM:         No free transfer fits, or the quota of the user is used up, and heap_fallback is not set
+ */
+esp_err_t usb_host_transfer_pool_alloc(usb_host_transfer_pool_user_t user, size_t data_buffer_size, int num_isoc_packets, usb_transfer_t **transfer);
+
+/**
+ * @brief Free a transfer, usb_host_transfer_free() replacement
+ *
+ * Pooled transfers return to the pool, other transfers are freed by usb_host_transfer_free().
+ *
+ * @param[in] transfer Transfer, can be NULL
+ * @return
+ *   - ESP_OK:                 Freed
+ */
+esp_err_t usb_host_transfer_pool_free(usb_transfer_t *transfer);
+
+/**
+ * @brief Get statistics of the transfer pool
+ *
+ * @param[out] stats Statistics
+ * @return
+ *   - ESP_OK:                 Statistics copied
+ *   - ESP_ERR_INVALID_ARG:    stats is NULL
+ *   - ESP_ERR_INVALID_STATE:  Not installed
+ */
+esp_err_t usb_host_transfer_pool_get_stats(usb_host_transfer_pool_stats_t *stats);
+
+/**
+ * @brief Check that all transfers come from the pool
+ *
+ * @return true if the pool is installed without heap_fallback
+ */
+bool usb_host_transfer_pool_is_static(void);
+
+#ifdef __cplusplus
+}
+#endif
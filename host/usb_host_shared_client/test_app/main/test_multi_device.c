@@ -0,0 +1,498 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "usb/usb_host.h"
+#include "usb/usb_host_shared_client.h"
+#include "usb/cdc_acm_host.h"
+#include "usb/msc_host.h"
+#include "usb/uvc_host.h"
+
+/*
+ * Devices behind one hub share the bandwidth of the root port. Each device runs its own workload:
+ * - UVC: MJPEG stream
+ * - MSC: Sequential read with two requests in flight
+ * - CDC-ACM: Loopback of chunks, each chunk is sent after the echo of the previous one
+ *
+ * Devices are added one by one. After each addition, all running devices are measured for
+ * CONFIG_MULTI_DEVICE_PHASE_MS and one row of the scaling table is printed.
+ */
+
+#define PHASE_MS            CONFIG_MULTI_DEVICE_PHASE_MS
+#define CONNECT_TIMEOUT_MS  CONFIG_MULTI_DEVICE_CONNECT_TIMEOUT_MS
+#define CDC_CHUNK_SIZE      CONFIG_MULTI_DEVICE_CDC_CHUNK_SIZE
+#define MSC_READ_SIZE       CONFIG_MULTI_DEVICE_MSC_READ_SIZE
+#define MSC_READS_IN_FLIGHT (2)
+#define RESULT_PREFIX       "multi_device_result: "     // Parsed by pytest_multi_device.py
+
+/**
+ * @brief Measurement of one device in one phase
+ */
+typedef struct {
+    uint64_t bytes;             // Received payload bytes
+    uint32_t frames;            // UVC only: Delivered frames
+    uint32_t frames_dropped;    // UVC only: Dropped frames
+    uint32_t latency_count;     // Number of latency samples, 0: Only latency_max_us is measured
+    uint64_t latency_sum_us;
+    uint32_t latency_max_us;    // UVC: Start of frame to frame callback. MSC: Read request. CDC: Chunk round trip
+} workload_result_t;
+
+/**
+ * @brief Workload of one device
+ */
+typedef struct {
+    const char *name;
+    esp_err_t (*start)(void);                   // Open the device and start the workload. Error: Device skipped
+    void (*reset)(void);                        // Reset the counters
+    void (*sample)(workload_result_t *result);  // Read the counters since reset
+    void (*stop)(void);                         // Stop the workload and close the device
+} workload_t;
+
+static portMUX_TYPE counters_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void latency_add(workload_result_t *counters, uint32_t latency_us)
+{
+    counters->latency_count++;
+    counters->latency_sum_us += latency_us;
+    if (latency_us > counters->latency_max_us) {
+        counters->latency_max_us = latency_us;
+    }
+}
+
+// ----------------------------------------------- UVC -----------------------------------------------------------------
+
+static uvc_host_stream_hdl_t uvc_stream;
+
+static bool uvc_frame_cb(const uvc_host_frame_t *frame, void *user_ctx)
+{
+    return true; // Only the statistics of the driver are measured, the frame is returned right away
+}
+
+static esp_err_t uvc_start(void)
+{
+    const uvc_host_stream_config_t stream_config = {
+        .frame_cb = uvc_frame_cb,
+        .usb = {
+            .vid = 0,
+            .pid = 0,
+            .uvc_stream_index = 0,
+        },
+        .vs_format = {
+            .h_res = CONFIG_MULTI_DEVICE_UVC_WIDTH,
+            .v_res = CONFIG_MULTI_DEVICE_UVC_HEIGHT,
+            .fps = CONFIG_MULTI_DEVICE_UVC_FPS,
+            .format = UVC_VS_FORMAT_MJPEG,
+        },
+        .advanced = {
+            .number_of_frame_buffers = 2,
+            .frame_size = CONFIG_MULTI_DEVICE_UVC_FRAME_SIZE,
+            .frame_heap_caps = MALLOC_CAP_DEFAULT,
+        },
+    };
+    esp_err_t ret = uvc_host_stream_open(&stream_config, pdMS_TO_TICKS(CONNECT_TIMEOUT_MS), &uvc_stream);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = uvc_host_stream_start(uvc_stream);
+    if (ret != ESP_OK) {
+        uvc_host_stream_close(uvc_stream);
+    }
+    return ret;
+}
+
+static void uvc_reset(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, uvc_host_stream_reset_stats(uvc_stream));
+}
+
+static void uvc_sample(workload_result_t *result)
+{
+    uvc_host_stream_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, uvc_host_stream_get_stats(uvc_stream, &stats));
+    result->bytes = stats.bytes_received;
+    result->frames = stats.frames_delivered;
+    result->frames_dropped = stats.frames_dropped.usb_error + stats.frames_dropped.header_error +
+                             stats.frames_dropped.buffer_underflow + stats.frames_dropped.buffer_overflow +
+                             stats.frames_dropped.missing_eof + stats.frames_dropped.mjpeg_invalid;
+    result->latency_max_us = stats.latency_max_us;
+}
+
+static void uvc_stop(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, uvc_host_stream_stop(uvc_stream));
+    TEST_ASSERT_EQUAL(ESP_OK, uvc_host_stream_close(uvc_stream));
+    uvc_stream = NULL;
+}
+
+// ----------------------------------------------- MSC -----------------------------------------------------------------
+
+typedef struct {
+    uint8_t *buf;
+    int64_t submit_us;
+} msc_read_t;
+
+static struct {
+    QueueHandle_t connected;                    // Address of connected MSC device
+    msc_host_device_handle_t device;
+    uint64_t sector_count;
+    uint32_t sectors_per_read;
+    uint64_t next_sector;
+    msc_read_t reads[MSC_READS_IN_FLIGHT];
+    volatile bool stopping;
+    SemaphoreHandle_t read_done;                // Given by each read finished during stop
+    workload_result_t counters;
+} msc;
+
+static void msc_event_cb(const msc_host_event_t *event, void *arg)
+{
+    if (event->event == MSC_DEVICE_CONNECTED) {
+        xQueueSend(msc.connected, &event->device.address, 0);
+    }
+}
+
+static void msc_read_cb(msc_host_device_handle_t device, esp_err_t result, void *arg);
+
+static esp_err_t msc_read_submit(msc_read_t *read)
+{
+    if (msc.next_sector + msc.sectors_per_read > msc.sector_count) {
+        msc.next_sector = 0; // Sequential read wraps at the end of the drive
+    }
+    const uint64_t sector = msc.next_sector;
+    msc.next_sector += msc.sectors_per_read;
+    read->submit_us = esp_timer_get_time();
+    return msc_host_read_sector_async(msc.device, 0, sector, msc.sectors_per_read, read->buf, msc_read_cb, read);
+}
+
+static void msc_read_cb(msc_host_device_handle_t device, esp_err_t result, void *arg)
+{
+    msc_read_t *read = (msc_read_t *)arg;
+    if (result == ESP_OK) {
+        const uint32_t latency_us = esp_timer_get_time() - read->submit_us;
+        portENTER_CRITICAL(&counters_lock);
+        msc.counters.bytes += MSC_READ_SIZE;
+        latency_add(&msc.counters, latency_us);
+        portEXIT_CRITICAL(&counters_lock);
+    }
+    if (msc.stopping || result != ESP_OK || msc_read_submit(read) != ESP_OK) {
+        xSemaphoreGive(msc.read_done);
+    }
+}
+
+static esp_err_t msc_start(void)
+{
+    uint8_t address;
+    if (xQueueReceive(msc.connected, &address, pdMS_TO_TICKS(CONNECT_TIMEOUT_MS)) != pdTRUE) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, msc_host_install_device(address, &msc.device));
+    msc_host_device_info_t info;
+    TEST_ASSERT_EQUAL(ESP_OK, msc_host_get_device_info(msc.device, &info));
+    TEST_ASSERT_GREATER_THAN(0, info.sector_count);
+    TEST_ASSERT_EQUAL(0, MSC_READ_SIZE % info.sector_size);
+    msc.sector_count = info.sector_count;
+    msc.sectors_per_read = MSC_READ_SIZE / info.sector_size;
+    msc.next_sector = 0;
+    msc.stopping = false;
+
+    for (int i = 0; i < MSC_READS_IN_FLIGHT; i++) {
+        msc.reads[i].buf = heap_caps_malloc(MSC_READ_SIZE, MALLOC_CAP_DMA);
+        TEST_ASSERT_NOT_NULL(msc.reads[i].buf);
+    }
+    for (int i = 0; i < MSC_READS_IN_FLIGHT; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, msc_read_submit(&msc.reads[i]));
+    }
+    return ESP_OK;
+}
+
+static void msc_reset(void)
+{
+    portENTER_CRITICAL(&counters_lock);
+    memset(&msc.counters, 0, sizeof(msc.counters));
+    portEXIT_CRITICAL(&counters_lock);
+}
+
+static void msc_sample(workload_result_t *result)
+{
+    portENTER_CRITICAL(&counters_lock);
+    *result = msc.counters;
+    portEXIT_CRITICAL(&counters_lock);
+}
+
+static void msc_stop(void)
+{
+    msc.stopping = true;
+    for (int i = 0; i < MSC_READS_IN_FLIGHT; i++) {
+        TEST_ASSERT_EQUAL(pdTRUE, xSemaphoreTake(msc.read_done, pdMS_TO_TICKS(5000)));
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, msc_host_uninstall_device(msc.device));
+    msc.device = NULL;
+    for (int i = 0; i < MSC_READS_IN_FLIGHT; i++) {
+        free(msc.reads[i].buf);
+        msc.reads[i].buf = NULL;
+    }
+}
+
+// --------------------------------------------- CDC-ACM ---------------------------------------------------------------
+
+static struct {
+    cdc_acm_dev_hdl_t dev;
+    TaskHandle_t task;
+    SemaphoreHandle_t echoed;                   // Given when the echo of the current chunk is received
+    volatile size_t rx_len;                     // Received bytes of the current chunk
+    volatile bool stopping;
+    TaskHandle_t stop_waiter;
+    workload_result_t counters;
+} cdc;
+
+static bool cdc_data_cb(const uint8_t *data, size_t data_len, void *user_arg)
+{
+    cdc.rx_len += data_len;
+    if (cdc.rx_len >= CDC_CHUNK_SIZE) {
+        xSemaphoreGive(cdc.echoed);
+    }
+    return true;
+}
+
+static void cdc_loopback_task(void *arg)
+{
+    static uint8_t chunk[CDC_CHUNK_SIZE];
+    for (size_t i = 0; i < sizeof(chunk); i++) {
+        chunk[i] = i;
+    }
+
+    while (!cdc.stopping) {
+        cdc.rx_len = 0;
+        const int64_t start_us = esp_timer_get_time();
+        if (cdc_acm_host_data_tx_blocking(cdc.dev, chunk, sizeof(chunk), 1000) != ESP_OK ||
+                xSemaphoreTake(cdc.echoed, pdMS_TO_TICKS(1000)) != pdTRUE) {
+            printf("CDC-ACM loopback timeout\n");
+            continue;
+        }
+        const uint32_t latency_us = esp_timer_get_time() - start_us;
+        portENTER_CRITICAL(&counters_lock);
+        cdc.counters.bytes += cdc.rx_len;
+        latency_add(&cdc.counters, latency_us);
+        portEXIT_CRITICAL(&counters_lock);
+    }
+    xTaskNotifyGive(cdc.stop_waiter);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t cdc_start(void)
+{
+    const cdc_acm_host_device_config_t dev_config = {
+        .connection_timeout_ms = CONNECT_TIMEOUT_MS,
+        .out_buffer_size = CDC_CHUNK_SIZE,
+        .in_buffer_size = CDC_CHUNK_SIZE,
+        .data_cb = cdc_data_cb,
+    };
+    esp_err_t ret = cdc_acm_host_open(CONFIG_MULTI_DEVICE_CDC_VID, CONFIG_MULTI_DEVICE_CDC_PID, 0, &dev_config, &cdc.dev);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    cdc.stopping = false;
+    TEST_ASSERT_EQUAL(pdTRUE, xTaskCreate(cdc_loopback_task, "cdc_loopback", 4096, NULL, 4, &cdc.task));
+    return ESP_OK;
+}
+
+static void cdc_reset(void)
+{
+    portENTER_CRITICAL(&counters_lock);
+    memset(&cdc.counters, 0, sizeof(cdc.counters));
+    portEXIT_CRITICAL(&counters_lock);
+}
+
+static void cdc_sample(workload_result_t *result)
+{
+    portENTER_CRITICAL(&counters_lock);
+    *result = cdc.counters;
+    portEXIT_CRITICAL(&counters_lock);
+}
+
+static void cdc_stop(void)
+{
+    cdc.stop_waiter = xTaskGetCurrentTaskHandle();
+    cdc.stopping = true;
+    TEST_ASSERT_NOT_EQUAL(0, ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(3000)));
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_close(cdc.dev));
+    cdc.dev = NULL;
+}
+
+// --------------------------------------------- USB Host --------------------------------------------------------------
+
+static void usb_lib_task(void *arg)
+{
+    const usb_host_config_t host_config = {
+        .intr_flags = ESP_INTR_FLAG_LEVEL1,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, usb_host_install(&host_config));
+    xTaskNotifyGive(arg);
+
+    bool all_clients_gone = false;
+    bool all_dev_free = false;
+    while (!all_clients_gone || !all_dev_free) {
+        uint32_t event_flags;
+        usb_host_lib_handle_events(portMAX_DELAY, &event_flags);
+        if (event_flags & USB_HOST_LIB_EVENT_FLAGS_NO_CLIENTS) {
+            usb_host_device_free_all();
+            all_clients_gone = true;
+        }
+        if (event_flags & USB_HOST_LIB_EVENT_FLAGS_ALL_FREE) {
+            all_dev_free = true;
+        }
+    }
+
+    vTaskDelay(10); // Short delay to allow clients clean-up
+    TEST_ASSERT_EQUAL(ESP_OK, usb_host_uninstall());
+    xTaskNotifyGive(arg);
+    vTaskDelete(NULL);
+}
+
+static void drivers_install(void)
+{
+    TEST_ASSERT_EQUAL(pdTRUE, xTaskCreatePinnedToCore(usb_lib_task, "usb_events", 4096, xTaskGetCurrentTaskHandle(), 10, NULL, 0));
+    TEST_ASSERT_NOT_EQUAL(0, ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000)));
+
+    // One task handles the events of all drivers, as in applications running several devices
+    const usb_host_shared_client_config_t shared_client_config = {
+        .create_background_task = true,
+        .task_priority = 5,
+        .stack_size = 4096,
+        .core_id = 0,
+        .max_num_event_msg = 32,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, usb_host_shared_client_install(&shared_client_config));
+
+    const uvc_host_driver_config_t uvc_config = {
+        .shared_client = true,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, uvc_host_install(&uvc_config));
+
+    msc.connected = xQueueCreate(2, sizeof(uint8_t));
+    msc.read_done = xSemaphoreCreateCounting(MSC_READS_IN_FLIGHT, 0);
+    TEST_ASSERT_NOT_NULL(msc.connected);
+    TEST_ASSERT_NOT_NULL(msc.read_done);
+    const msc_host_driver_config_t msc_config = {
+        .callback = msc_event_cb,
+        .max_transfer_size = MSC_READ_SIZE,
+        .async_io = {
+            .queue_size = MSC_READS_IN_FLIGHT,
+            .stack_size = 4096,
+            .task_priority = 5,
+            .core_id = tskNO_AFFINITY,
+        },
+        .shared_client = true,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, msc_host_install(&msc_config));
+
+    cdc.echoed = xSemaphoreCreateBinary();
+    TEST_ASSERT_NOT_NULL(cdc.echoed);
+    const cdc_acm_host_driver_config_t cdc_config = {
+        .shared_client = true,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_install(&cdc_config));
+}
+
+static void drivers_uninstall(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, cdc_acm_host_uninstall());
+    TEST_ASSERT_EQUAL(ESP_OK, msc_host_uninstall());
+    TEST_ASSERT_EQUAL(ESP_OK, uvc_host_uninstall());
+    TEST_ASSERT_EQUAL(ESP_OK, usb_host_shared_client_uninstall());
+    TEST_ASSERT_NOT_EQUAL(0, ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(5000))); // USB Host uninstalled
+
+    vQueueDelete(msc.connected);
+    vSemaphoreDelete(msc.read_done);
+    vSemaphoreDelete(cdc.echoed);
+    vTaskDelay(20); // Short delay to allow tasks to be cleaned up
+}
+
+// ---------------------------------------------- Test -----------------------------------------------------------------
+
+static void print_row(const char *devices, const workload_t **running, size_t num_running, const workload_result_t *results, int64_t elapsed_us)
+{
+    const double seconds = elapsed_us / 1e6;
+    double total_mbps = 0;
+    char json[512];
+    int len = snprintf(json, sizeof(json), "{\"devices\": \"%s\"", devices);
+
+    printf("| %-12s |", devices);
+    for (size_t i = 0; i < num_running; i++) {
+        const workload_result_t *r = &results[i];
+        const double mbps = r->bytes / seconds / 1e6;
+        const double latency_avg_ms = r->latency_count ? (double)r->latency_sum_us / r->latency_count / 1000 : 0;
+        const double latency_max_ms = r->latency_max_us / 1000.0;
+        total_mbps += mbps;
+        printf(" %s %7.3f MB/s, latency avg %6.2f max %7.2f ms", running[i]->name, mbps, latency_avg_ms, latency_max_ms);
+        len += snprintf(json + len, sizeof(json) - len, ", \"%s\": {\"mbps\": %.3f, \"latency_avg_ms\": %.2f, \"latency_max_ms\": %.2f",
+                        running[i]->name, mbps, latency_avg_ms, latency_max_ms);
+        if (r->frames || r->frames_dropped) {
+            const double fps = r->frames / seconds;
+            const double drop_percent = 100.0 * r->frames_dropped / (r->frames + r->frames_dropped);
+            printf(", %5.1f fps, %5.1f %% dropped", fps, drop_percent);
+            len += snprintf(json + len, sizeof(json) - len, ", \"fps\": %.1f, \"drop_percent\": %.1f", fps, drop_percent);
+        }
+        printf(" |");
+        len += snprintf(json + len, sizeof(json) - len, "}");
+    }
+    printf(" total %7.3f MB/s |\n", total_mbps);
+    snprintf(json + len, sizeof(json) - len, ", \"total_mbps\": %.3f}", total_mbps);
+    printf(RESULT_PREFIX "%s\n", json);
+}
+
+TEST_CASE("multi_device_scaling", "[multi_device]")
+{
+    static const workload_t workloads[] = {
+        { "UVC", uvc_start, uvc_reset, uvc_sample, uvc_stop },
+        { "MSC", msc_start, msc_reset, msc_sample, msc_stop },
+        { "CDC", cdc_start, cdc_reset, cdc_sample, cdc_stop },
+    };
+    const size_t num_workloads = sizeof(workloads) / sizeof(workloads[0]);
+    const workload_t *running[sizeof(workloads) / sizeof(workloads[0])];
+    workload_result_t results[sizeof(workloads) / sizeof(workloads[0])];
+    size_t num_running = 0;
+    char devices[32] = "";
+
+    drivers_install();
+    printf("Scaling table, %d ms per phase\n", PHASE_MS);
+    for (size_t i = 0; i < num_workloads; i++) {
+        const esp_err_t ret = workloads[i].start();
+        if (ret != ESP_OK) {
+            printf("%s device not connected (%s), skipped\n", workloads[i].name, esp_err_to_name(ret));
+            continue;
+        }
+        running[num_running++] = &workloads[i];
+        snprintf(devices + strlen(devices), sizeof(devices) - strlen(devices), "%s%s", strlen(devices) ? "+" : "", workloads[i].name);
+
+        // Measure all running devices together
+        for (size_t j = 0; j < num_running; j++) {
+            running[j]->reset();
+        }
+        const int64_t start_us = esp_timer_get_time();
+        vTaskDelay(pdMS_TO_TICKS(PHASE_MS));
+        for (size_t j = 0; j < num_running; j++) {
+            memset(&results[j], 0, sizeof(results[j]));
+            running[j]->sample(&results[j]);
+        }
+        print_row(devices, running, num_running, results, esp_timer_get_time() - start_us);
+    }
+
+    for (size_t i = 0; i < num_running; i++) {
+        running[i]->stop();
+    }
+    drivers_uninstall();
+    TEST_ASSERT_GREATER_THAN_MESSAGE(0, num_running, "No device connected");
+}
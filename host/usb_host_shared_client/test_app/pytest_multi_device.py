@@ -0,0 +1,67 @@
+# SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: Apache-2.0
+
+import json
+import os
+from typing import Dict
+
+import pytest
+from pytest_embedded_idf.dut import IdfDut
+
+RESULT_PREFIX = 'multi_device_result: '  # RESULT_PREFIX of the test app
+PHASE_TIMEOUT = 60
+
+RESULTS_FILE = os.environ.get('MULTI_DEVICE_RESULTS', 'multi_device_results.json')
+BASELINE_FILE = os.environ.get('MULTI_DEVICE_BASELINE')     # Results of a previous run, e.g. before a driver change
+TOLERANCE = float(os.environ.get('MULTI_DEVICE_TOLERANCE', '0.2'))
+
+
+def compare_with_baseline(results: Dict[str, dict], baseline: Dict[str, dict]) -> None:
+    '''
+    Fail if the throughput of a device dropped by more than TOLERANCE in a phase that also ran in the baseline
+    '''
+    regressions = []
+    for devices, phase in results.items():
+        for name, base in baseline.get(devices, {}).items():
+            if not isinstance(base, dict) or name not in phase:
+                continue
+            if phase[name]['mbps'] < base['mbps'] * (1 - TOLERANCE):
+                regressions.append(f'{devices} {name}: {phase[name]["mbps"]} MB/s, baseline {base["mbps"]} MB/s')
+    assert not regressions, 'Throughput regression:\n' + '\n'.join(regressions)
+
+
+@pytest.mark.esp32s2
+@pytest.mark.esp32s3
+@pytest.mark.esp32p4
+@pytest.mark.usb_host_hub
+def test_usb_host_multi_device(dut: IdfDut) -> None:
+    '''
+    Running the test locally:
+    1. Connect a hub with a UVC camera, an MSC drive and a CDC-ACM loopback device to the USB Host port
+    2. Build and flash the test app, e.g. `idf.py -C host/usb_host_shared_client/test_app build`
+    3. Run `pytest --target esp32s3 -m usb_host_hub`, optionally with MULTI_DEVICE_BASELINE set to results of a previous run
+
+    Steps:
+    1. Run the scaling test on the DUT, it adds the connected devices one by one
+    2. Collect one result per phase and store them in RESULTS_FILE
+    3. Compare the results with the baseline
+    '''
+    dut.expect_exact('Press ENTER to see the list of tests.')
+    dut.write('[multi_device]')
+
+    results = {}
+    while True:
+        line = dut.expect(rf'({RESULT_PREFIX}.*|\d+ Tests \d+ Failures \d+ Ignored)', timeout=PHASE_TIMEOUT).group(1).decode()
+        if not line.startswith(RESULT_PREFIX):
+            break
+        phase = json.loads(line[len(RESULT_PREFIX):])
+        results[phase.pop('devices')] = phase
+        print(f'{dut.target} multi device: {phase}')
+    assert results, 'No device connected'
+    assert line.split()[2] == '0', 'Test case failed'
+
+    with open(RESULTS_FILE, 'w') as f:
+        json.dump({dut.target: results}, f, indent=2)
+    if BASELINE_FILE:
+        with open(BASELINE_FILE) as f:
+            compare_with_baseline(results, json.load(f).get(dut.target, {}))
@@ -0,0 +1,126 @@
+#!/usr/bin/env python
+#
+# SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""
+Convert a dump of usb_host_trace_dump() to a trace in Chrome JSON format, which is opened by https://ui.perfetto.dev
+and chrome://tracing.
+
+The input is a binary dump, or a console log with the hex lines of usb_host_trace_dump(stream, true).
+Each driver is a process, each endpoint a track with transfers from submit to completion. User callbacks
+are slices on the callbacks track, delivered frames and reports are instant events.
+
+Example:
+    usb_host_trace_to_perfetto.py monitor.log trace.json
+"""
+
+import argparse
+import json
+import struct
+from typing import Dict, Iterator, List, Tuple
+
+MAGIC = 0x54425355  # "USBT"
+VERSION = 1
+HEADER = '<IHHII'
+RECORD = '<IIIIBBBB'
+
+DRIVERS = ['CDC-ACM', 'HID', 'MSC', 'UAC', 'UVC', 'App']
+EVENT_SUBMIT, EVENT_COMPLETE, EVENT_CALLBACK_ENTER, EVENT_CALLBACK_EXIT, EVENT_DELIVER = range(5)
+STATUS = ['COMPLETED', 'ERROR', 'TIMED_OUT', 'CANCELED', 'STALL', 'OVERFLOW', 'SKIPPED', 'NO_DEVICE']
+CALLBACK_TID = 0x100
+
+
+def read_dump(path: str) -> bytes:
+    with open(path, 'rb') as f:
+        data = f.read()
+    if len(data) >= 4 and struct.unpack_from('<I', data)[0] == MAGIC:
+        return data
+    # Console log: the dump is in lines prefixed by USBT:, possibly after a log prefix
+    hex_data = []
+    for line in data.decode('utf-8', errors='replace').splitlines():
+        pos = line.find('USBT:')
+        if pos >= 0:
+            hex_data.append(line[pos + 5:].strip())
+    return bytes.fromhex(''.join(hex_data))
+
+
+def parse_records(data: bytes) -> Tuple[int, List[Tuple[int, ...]]]:
+    if len(data) < struct.calcsize(HEADER):
+        raise ValueError('no trace dump found')
+    magic, version, record_size, num_records, overwritten = struct.unpack_from(HEADER, data)
+    if magic != MAGIC or version != VERSION or record_size != struct.calcsize(RECORD):
+        raise ValueError('unsupported trace dump: magic {:#x}, version {}, record size {}'.format(magic, version, record_size))
+    offset = struct.calcsize(HEADER)
+    records = []
+    # The header count is an upper bound, when recording continued during the dump
+    while len(records) < num_records and offset + record_size <= len(data):
+        records.append(struct.unpack_from(RECORD, data, offset))
+        offset += record_size
+    return overwritten, records
+
+
+def unwrap_timestamps(records: List[Tuple[int, ...]]) -> Iterator[Tuple[int, Tuple[int, ...]]]:
+    # Timestamps are the low 32 bits of esp_timer, they wrap around every 71 minutes
+    base = 0
+    last = None
+    for record in records:
+        timestamp = record[1]
+        if last is not None and timestamp + (1 << 31) < last:
+            base += 1 << 32
+        last = timestamp
+        yield base + timestamp, record
+
+
+def convert(records: List[Tuple[int, ...]]) -> List[Dict]:
+    events = []
+    seen_tracks = set()
+
+    def track(pid: int, tid: int, name: str) -> None:
+        if (pid, tid) not in seen_tracks:
+            seen_tracks.add((pid, tid))
+            events.append({'ph': 'M', 'name': 'thread_name', 'pid': pid, 'tid': tid, 'args': {'name': name}})
+
+    for pid, name in enumerate(DRIVERS):
+        events.append({'ph': 'M', 'name': 'process_name', 'pid': pid, 'args': {'name': name}})
+
+    for timestamp, (_seq, _ts, xfer_id, length, event, driver, endpoint, status) in unwrap_timestamps(records):
+        ep_name = 'EP {:#04x}'.format(endpoint)
+        common = {'ts': timestamp, 'pid': driver}
+        if event in (EVENT_SUBMIT, EVENT_COMPLETE):
+            track(driver, endpoint, ep_name)
+            # Async slices with the transfer address as id, transfers in flight on one endpoint overlap
+            slice_event = dict(common, tid=endpoint, cat='transfer', name=ep_name, id='{:#x}'.format(xfer_id))
+            if event == EVENT_SUBMIT:
+                slice_event.update(ph='b', args={'length': length})
+            else:
+                status_name = STATUS[status] if status < len(STATUS) else str(status)
+                slice_event.update(ph='e', args={'actual_length': length, 'status': status_name})
+            events.append(slice_event)
+        elif event in (EVENT_CALLBACK_ENTER, EVENT_CALLBACK_EXIT):
+            track(driver, CALLBACK_TID, 'callbacks')
+            events.append(dict(common, tid=CALLBACK_TID, name='callback {}'.format(ep_name),
+                               ph='B' if event == EVENT_CALLBACK_ENTER else 'E'))
+        elif event == EVENT_DELIVER:
+            track(driver, CALLBACK_TID, 'callbacks')
+            events.append(dict(common, tid=CALLBACK_TID, ph='i', s='t', name='deliver',
+                               args={'length': length, 'endpoint': ep_name}))
+    return events
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('input', help='Binary dump or console log')
+    parser.add_argument('output', help='Trace in Chrome JSON format')
+    args = parser.parse_args()
+
+    overwritten, records = parse_records(read_dump(args.input))
+    events = convert(records)
+    with open(args.output, 'w') as f:
+        json.dump({'traceEvents': events, 'displayTimeUnit': 'ns'}, f)
+    print('{}: {} records, {} overwritten before the dump'.format(args.output, len(records), overwritten))
+
+
+if __name__ == '__main__':
+    main()
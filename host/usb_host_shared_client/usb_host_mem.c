@@ -0,0 +1,337 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/param.h>
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "multi_heap.h"
+#include "freertos/FreeRTOS.h"
+#include "usb/usb_host.h"
+#include "usb/usb_host_mem.h"
+#include "usb/usb_host_transfer_pool.h"
+
+_Static_assert((int)USB_HOST_MEM_DRIVER_MAX == (int)USB_HOST_TRANSFER_POOL_USER_MAX, "Drivers charge the transfer pool user of the same index");
+
+static const char *TAG = "usb_host_mem";
+
+static const char *const s_driver_names[USB_HOST_MEM_DRIVER_MAX] = {"CDC-ACM", "HID", "MSC", "UAC", "UVC", "APP"};
+
+static portMUX_TYPE mem_lock = portMUX_INITIALIZER_UNLOCKED;
+static usb_host_mem_footprint_t s_footprints[USB_HOST_MEM_DRIVER_MAX];
+
+typedef struct {
+    multi_heap_handle_t heap;    // NULL if the arena is not used
+    const uint8_t *start;
+    size_t size;
+    portMUX_TYPE lock;           // Lock of the heap in the arena
+} mem_arena_t;
+
+// Installed before the class drivers and uninstalled after them, the allocation functions read it without lock
+static struct {
+    bool installed;
+    mem_arena_t arena;
+    mem_arena_t buffer_arena;
+    uint32_t failures;           // Protected by mem_lock
+} s_static;
+
+/**
+ * @brief Bytes held by a transfer, as allocated by usb_host_transfer_alloc()
+ */
+static size_t transfer_size(size_t data_buffer_size, int num_isoc_packets)
+{
+    return sizeof(usb_transfer_t) + num_isoc_packets * sizeof(usb_isoc_packet_desc_t) + data_buffer_size;
+}
+
+void usb_host_mem_alloc_record(usb_host_mem_driver_t driver, usb_host_mem_category_t category, size_t size)
+{
+    assert(driver < USB_HOST_MEM_DRIVER_MAX && category < USB_HOST_MEM_CATEGORY_MAX);
+    portENTER_CRITICAL_SAFE(&mem_lock);
+    usb_host_mem_footprint_t *footprint = &s_footprints[driver];
+    footprint->bytes[category] += size;
+    footprint->total += size;
+    if (footprint->total > footprint->peak) {
+        footprint->peak = footprint->total;
+    }
+    footprint->allocs++;
+    portEXIT_CRITICAL_SAFE(&mem_lock);
+}
+
+void usb_host_mem_free_record(usb_host_mem_driver_t driver, usb_host_mem_category_t category, size_t size)
+{
+    assert(driver < USB_HOST_MEM_DRIVER_MAX && category < USB_HOST_MEM_CATEGORY_MAX);
+    portENTER_CRITICAL_SAFE(&mem_lock);
+    usb_host_mem_footprint_t *footprint = &s_footprints[driver];
+    // A free not matching the allocation must not wrap around, the counters would be useless afterwards
+    assert(footprint->bytes[category] >= size);
+    footprint->bytes[category] -= size;
+    footprint->total -= size;
+    footprint->frees++;
+    portEXIT_CRITICAL_SAFE(&mem_lock);
+}
+
+static esp_err_t arena_init(mem_arena_t *arena, void *start, size_t size)
+{
+    portMUX_INITIALIZE(&arena->lock);
+    arena->heap = multi_heap_register(start, size);
+    ESP_RETURN_ON_FALSE(arena->heap, ESP_ERR_INVALID_ARG, TAG, "Arena of %u bytes is too small", (unsigned)size);
+    multi_heap_set_lock(arena->heap, &arena->lock);
+    arena->start = start;
+    arena->size = size;
+    return ESP_OK;
+}
+
+esp_err_t usb_host_mem_static_install(const usb_host_mem_static_config_t *config)
+{
+    ESP_RETURN_ON_FALSE(config && config->arena && config->arena_size, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(!s_static.installed, ESP_ERR_INVALID_STATE, TAG, "Already installed");
+    ESP_RETURN_ON_FALSE(usb_host_transfer_pool_is_static(), ESP_ERR_INVALID_STATE, TAG, "Transfer pool without heap fallback is required");
+
+    memset(&s_static, 0, sizeof(s_static));
+    ESP_RETURN_ON_ERROR(arena_init(&s_static.arena, config->arena, config->arena_size), TAG, "Invalid arena");
+    if (config->buffer_arena && config->buffer_arena_size) {
+        if (arena_init(&s_static.buffer_arena, config->buffer_arena, config->buffer_arena_size) != ESP_OK) {
+            memset(&s_static, 0, sizeof(s_static));
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    s_static.installed = true;
+    return ESP_OK;
+}
+
+esp_err_t usb_host_mem_static_uninstall(void)
+{
+    ESP_RETURN_ON_FALSE(s_static.installed, ESP_ERR_INVALID_STATE, TAG, "Not installed");
+    multi_heap_info_t info;
+    multi_heap_get_info(s_static.arena.heap, &info);
+    size_t allocated_blocks = info.allocated_blocks;
+    if (s_static.buffer_arena.heap) {
+        multi_heap_get_info(s_static.buffer_arena.heap, &info);
+        allocated_blocks += info.allocated_blocks;
+    }
+    ESP_RETURN_ON_FALSE(allocated_blocks == 0, ESP_ERR_INVALID_STATE, TAG, "%u blocks are still allocated", (unsigned)allocated_blocks);
+    memset(&s_static, 0, sizeof(s_static));
+    return ESP_OK;
+}
+
+esp_err_t usb_host_mem_static_get_info(usb_host_mem_static_info_t *info)
+{
+    ESP_RETURN_ON_FALSE(info, ESP_ERR_INVALID_ARG, TAG, "info can't be NULL");
+    ESP_RETURN_ON_FALSE(s_static.installed, ESP_ERR_INVALID_STATE, TAG, "Not installed");
+    memset(info, 0, sizeof(usb_host_mem_static_info_t));
+    multi_heap_info_t heap_info;
+    multi_heap_get_info(s_static.arena.heap, &heap_info);
+    info->free_bytes = heap_info.total_free_bytes;
+    info->min_free_bytes = heap_info.minimum_free_bytes;
+    info->largest_free_block = heap_info.largest_free_block;
+    if (s_static.buffer_arena.heap) {
+        multi_heap_get_info(s_static.buffer_arena.heap, &heap_info);
+        info->buffer_free_bytes = heap_info.total_free_bytes;
+        info->buffer_min_free_bytes = heap_info.minimum_free_bytes;
+        info->buffer_largest_free_block = heap_info.largest_free_block;
+    }
+    portENTER_CRITICAL(&mem_lock);
+    info->failures = s_static.failures;
+    portEXIT_CRITICAL(&mem_lock);
+    return ESP_OK;
+}
+
+/**
+ * @brief Arena of a new allocation, NULL if the static allocation mode is not installed
+ *
+ * Buffers go to the buffer arena, unless they need DMA capable or internal memory.
+ */
+static mem_arena_t *arena_select(usb_host_mem_category_t category, uint32_t caps)
+{
+    if (!s_static.installed) {
+        return NULL;
+    }
+    if (category == USB_HOST_MEM_BUFFER && s_static.buffer_arena.heap && !(caps & (MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL))) {
+        return &s_static.buffer_arena;
+    }
+    return &s_static.arena;
+}
+
+/**
+ * @brief Arena holding the memory, NULL if it is in heap
+ *
+ * Memory allocated before the static allocation mode was installed stays in heap.
+ */
+static mem_arena_t *arena_of(const void *ptr)
+{
+    mem_arena_t *arenas[] = { &s_static.arena, &s_static.buffer_arena };
+    for (int i = 0; i < 2; i++) {
+        if (arenas[i]->heap && (const uint8_t *)ptr >= arenas[i]->start && (const uint8_t *)ptr < arenas[i]->start + arenas[i]->size) {
+            return arenas[i];
+        }
+    }
+    return NULL;
+}
+
+static void *raw_alloc(mem_arena_t *arena, size_t alignment, size_t size, uint32_t caps)
+{
+    if (!arena) {
+        caps = caps ? caps : MALLOC_CAP_DEFAULT;
+        return alignment ? heap_caps_aligned_alloc(alignment, size, caps) : heap_caps_malloc(size, caps);
+    }
+    void *ptr = alignment ? multi_heap_aligned_alloc(arena->heap, size, alignment) : multi_heap_malloc(arena->heap, size);
+    if (!ptr) {
+        portENTER_CRITICAL_SAFE(&mem_lock);
+        s_static.failures++;
+        portEXIT_CRITICAL_SAFE(&mem_lock);
+    }
+    return ptr;
+}
+
+static void raw_free(void *ptr)
+{
+    mem_arena_t *arena = arena_of(ptr);
+    if (arena) {
+        multi_heap_free(arena->heap, ptr);
+    } else {
+        free(ptr);
+    }
+}
+
+void *usb_host_mem_aligned_alloc(usb_host_mem_driver_t driver, usb_host_mem_category_t category, size_t alignment, size_t size, uint32_t caps)
+{
+    void *ptr = raw_alloc(arena_select(category, caps), alignment, size, caps);
+    if (ptr) {
+        usb_host_mem_alloc_record(driver, category, size);
+    }
+    return ptr;
+}
+
+void *usb_host_mem_malloc(usb_host_mem_driver_t driver, usb_host_mem_category_t category, size_t size, uint32_t caps)
+{
+    return usb_host_mem_aligned_alloc(driver, category, 0, size, caps);
+}
+
+void *usb_host_mem_calloc(usb_host_mem_driver_t driver, usb_host_mem_category_t category, size_t n, size_t size, uint32_t caps)
+{
+    if (size && n > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *ptr = usb_host_mem_aligned_alloc(driver, category, 0, n * size, caps);
+    if (ptr) {
+        memset(ptr, 0, n * size);
+    }
+    return ptr;
+}
+
+void *usb_host_mem_realloc(usb_host_mem_driver_t driver, usb_host_mem_category_t category, void *ptr, size_t old_size, size_t size, uint32_t caps)
+{
+    if (!ptr) {
+        return usb_host_mem_malloc(driver, category, size, caps);
+    }
+    mem_arena_t *from = arena_of(ptr);
+    mem_arena_t *to = arena_select(category, caps);
+    void *new_ptr;
+    if (from == to) {
+        new_ptr = to ? multi_heap_realloc(to->heap, ptr, size) : heap_caps_realloc(ptr, size, caps ? caps : MALLOC_CAP_DEFAULT);
+        if (!new_ptr && to) {
+            portENTER_CRITICAL_SAFE(&mem_lock);
+            s_static.failures++;
+            portEXIT_CRITICAL_SAFE(&mem_lock);
+        }
+    } else {
+        // Memory allocated in heap before the static allocation mode was installed moves to the arena
+        new_ptr = raw_alloc(to, 0, size, caps);
+        if (new_ptr) {
+            memcpy(new_ptr, ptr, MIN(old_size, size));
+            raw_free(ptr);
+        }
+    }
+    if (new_ptr) {
+        usb_host_mem_free_record(driver, category, old_size);
+        usb_host_mem_alloc_record(driver, category, size);
+    }
+    return new_ptr;
+}
+
+void usb_host_mem_free(usb_host_mem_driver_t driver, usb_host_mem_category_t category, void *ptr, size_t size)
+{
+    if (!ptr) {
+        return;
+    }
+    usb_host_mem_free_record(driver, category, size);
+    raw_free(ptr);
+}
+
+esp_err_t usb_host_mem_transfer_alloc(usb_host_mem_driver_t driver, size_t data_buffer_size, int num_isoc_packets, usb_transfer_t **transfer)
+{
+    ESP_RETURN_ON_FALSE(driver < USB_HOST_MEM_DRIVER_MAX, ESP_ERR_INVALID_ARG, TAG, "Invalid driver");
+    esp_err_t ret = usb_host_transfer_pool_alloc((usb_host_transfer_pool_user_t)driver, data_buffer_size, num_isoc_packets, transfer);
+    if (ret == ESP_OK) {
+        usb_host_mem_alloc_record(driver, USB_HOST_MEM_TRANSFER, transfer_size(data_buffer_size, num_isoc_packets));
+    }
+    return ret;
+}
+
+esp_err_t usb_host_mem_transfer_free(usb_host_mem_driver_t driver, usb_transfer_t *transfer)
+{
+    if (transfer == NULL) {
+        return ESP_OK;
+    }
+    // The pool gives the transfer back the size of its class on free, the requested size is read before
+    const size_t size = transfer_size(transfer->data_buffer_size, transfer->num_isoc_packets);
+    esp_err_t ret = usb_host_transfer_pool_free(transfer);
+    if (ret == ESP_OK) {
+        usb_host_mem_free_record(driver, USB_HOST_MEM_TRANSFER, size);
+    }
+    return ret;
+}
+
+esp_err_t usb_host_mem_get_footprint(usb_host_mem_driver_t driver, usb_host_mem_footprint_t *footprint)
+{
+    ESP_RETURN_ON_FALSE(driver < USB_HOST_MEM_DRIVER_MAX && footprint, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    portENTER_CRITICAL(&mem_lock);
+    *footprint = s_footprints[driver];
+    portEXIT_CRITICAL(&mem_lock);
+    return ESP_OK;
+}
+
+esp_err_t usb_host_mem_report(FILE *stream)
+{
+    ESP_RETURN_ON_FALSE(stream, ESP_ERR_INVALID_ARG, TAG, "stream can't be NULL");
+    usb_host_mem_footprint_t footprints[USB_HOST_MEM_DRIVER_MAX];
+    portENTER_CRITICAL(&mem_lock);
+    memcpy(footprints, s_footprints, sizeof(footprints));
+    portEXIT_CRITICAL(&mem_lock);
+
+    usb_host_mem_footprint_t sum = {0};
+    fprintf(stream, "%-8s %10s %10s %10s %10s %10s %10s %8s\n", "Driver", "Transfers", "Buffers", "Descs", "Control", "Total", "Peak", "Blocks");
+    for (int d = 0; d < USB_HOST_MEM_DRIVER_MAX; d++) {
+        const usb_host_mem_footprint_t *fp = &footprints[d];
+        fprintf(stream, "%-8s %10u %10u %10u %10u %10u %10u %8u\n", s_driver_names[d],
+                (unsigned)fp->bytes[USB_HOST_MEM_TRANSFER], (unsigned)fp->bytes[USB_HOST_MEM_BUFFER],
+                (unsigned)fp->bytes[USB_HOST_MEM_DESCRIPTOR], (unsigned)fp->bytes[USB_HOST_MEM_CONTROL],
+                (unsigned)fp->total, (unsigned)fp->peak, (unsigned)(fp->allocs - fp->frees));
+        for (int c = 0; c < USB_HOST_MEM_CATEGORY_MAX; c++) {
+            sum.bytes[c] += fp->bytes[c];
+        }
+        sum.total += fp->total;
+        sum.allocs += fp->allocs;
+        sum.frees += fp->frees;
+    }
+    // Peaks of the drivers are not simultaneous, their sum is not reported
+    fprintf(stream, "%-8s %10u %10u %10u %10u %10u %10s %8u\n", "All",
+            (unsigned)sum.bytes[USB_HOST_MEM_TRANSFER], (unsigned)sum.bytes[USB_HOST_MEM_BUFFER],
+            (unsigned)sum.bytes[USB_HOST_MEM_DESCRIPTOR], (unsigned)sum.bytes[USB_HOST_MEM_CONTROL],
+            (unsigned)sum.total, "-", (unsigned)(sum.allocs - sum.frees));
+    usb_host_mem_static_info_t info;
+    if (s_static.installed && usb_host_mem_static_get_info(&info) == ESP_OK) {
+        fprintf(stream, "Arena: %u free, %u min free, %u largest block, %u failures\n",
+                (unsigned)info.free_bytes, (unsigned)info.min_free_bytes, (unsigned)info.largest_free_block, (unsigned)info.failures);
+        if (s_static.buffer_arena.heap) {
+            fprintf(stream, "Buffer arena: %u free, %u min free, %u largest block\n",
+                    (unsigned)info.buffer_free_bytes, (unsigned)info.buffer_min_free_bytes, (unsigned)info.buffer_largest_free_block);
+        }
+    }
+    fflush(stream);
+    return ESP_OK;
+}
@@ -0,0 +1,195 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "usb/usb_host.h"
+#include "usb/usb_host_mem.h"
+#include "usb/usb_host_pm.h"
+
+_Static_assert((int)USB_HOST_PM_DRIVER_MAX == (int)USB_HOST_MEM_DRIVER_MAX, "Drivers have the same index in all shared client modules");
+
+// USB 2.0 specification, 7.1.7.7: Devices get 10 ms of resume recovery time before the first transaction
+#define RESUME_RECOVERY_MS   (10)
+
+static const char *TAG = "usb_host_pm";
+
+typedef struct {
+    const usb_host_pm_ops_t *ops;               // NULL if the driver is not registered
+    void *arg;
+    bool suspended;                             // Suspend hook of the driver was called, resume hook is due
+} pm_member_t;
+
+static portMUX_TYPE pm_lock = portMUX_INITIALIZER_UNLOCKED;
+static struct {
+    pm_member_t members[USB_HOST_PM_DRIVER_MAX];
+    bool busy;                                  // Suspend or resume is in progress, no driver is deregistered
+    usb_host_pm_stats_t stats;
+} s_pm;
+
+/**
+ * @brief Take the members for suspend or resume
+ *
+ * @param[in] suspended Expected state of the bus
+ * @return true if the members were taken
+ */
+static bool pm_take(bool suspended)
+{
+    bool taken = false;
+    portENTER_CRITICAL(&pm_lock);
+    if (!s_pm.busy && s_pm.stats.suspended == suspended) {
+        s_pm.busy = true;
+        taken = true;
+    }
+    portEXIT_CRITICAL(&pm_lock);
+    return taken;
+}
+
+static void pm_give(bool suspended)
+{
+    portENTER_CRITICAL(&pm_lock);
+    s_pm.stats.suspended = suspended;
+    s_pm.busy = false;
+    portEXIT_CRITICAL(&pm_lock);
+}
+
+/**
+ * @brief Resume all suspended drivers, in the reverse order of suspend
+ *
+ * @return ESP_OK or error of the first failing driver
+ */
+static esp_err_t pm_drivers_resume(void)
+{
+    esp_err_t ret = ESP_OK;
+    for (int i = USB_HOST_PM_DRIVER_MAX - 1; i >= 0; i--) {
+        pm_member_t *member = &s_pm.members[i];
+        if (!member->suspended) {
+            continue;
+        }
+        member->suspended = false;
+        const esp_err_t err = member->ops->resume(member->arg);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Driver %d resume failed: %s", i, esp_err_to_name(err));
+            if (ret == ESP_OK) {
+                ret = err;
+            }
+        }
+    }
+    return ret;
+}
+
+esp_err_t usb_host_pm_register(usb_host_pm_driver_t driver, const usb_host_pm_ops_t *ops, void *arg)
+{
+    ESP_RETURN_ON_FALSE(driver < USB_HOST_PM_DRIVER_MAX && ops && ops->suspend && ops->resume, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&pm_lock);
+    if (s_pm.members[driver].ops) {
+        ret = ESP_ERR_INVALID_STATE;
+    } else {
+        s_pm.members[driver] = (pm_member_t) {
+            .ops = ops,
+            .arg = arg,
+        };
+    }
+    portEXIT_CRITICAL(&pm_lock);
+    return ret;
+}
+
+esp_err_t usb_host_pm_deregister(usb_host_pm_driver_t driver)
+{
+    ESP_RETURN_ON_FALSE(driver < USB_HOST_PM_DRIVER_MAX, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&pm_lock);
+    if (s_pm.busy) {
+        ret = ESP_ERR_INVALID_STATE;
+    } else {
+        // A driver uninstalled while the bus is suspended has no devices left to resume
+        s_pm.members[driver] = (pm_member_t) {
+            .ops = NULL,
+        };
+    }
+    portEXIT_CRITICAL(&pm_lock);
+    return ret;
+}
+
+esp_err_t usb_host_pm_suspend(void)
+{
+    ESP_RETURN_ON_FALSE(pm_take(false), ESP_ERR_INVALID_STATE, TAG, "Bus is suspended or busy");
+    const int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = ESP_OK;
+
+    for (int i = 0; i < USB_HOST_PM_DRIVER_MAX; i++) {
+        pm_member_t *member = &s_pm.members[i];
+        if (!member->ops) {
+            continue;
+        }
+        // A failing driver is resumed too, its resume hook restores what its suspend hook stopped
+        member->suspended = true;
+        ESP_GOTO_ON_ERROR(member->ops->suspend(member->arg), rollback, TAG, "Driver %d suspend failed", i);
+    }
+
+#if USB_HOST_PM_ROOT_PORT_SUSPEND
+    // No transfers are in flight, the root port stops sending SOFs and the devices enter suspend after 3 ms of idle bus
+    ESP_GOTO_ON_ERROR(usb_host_lib_root_port_suspend(), rollback, TAG, "Root port suspend failed");
+#endif
+
+    portENTER_CRITICAL(&pm_lock);
+    s_pm.stats.suspends++;
+    s_pm.stats.last_suspend_us = (uint32_t)(esp_timer_get_time() - start_us);
+    portEXIT_CRITICAL(&pm_lock);
+    pm_give(true);
+    return ESP_OK;
+
+rollback:
+    pm_drivers_resume();
+    portENTER_CRITICAL(&pm_lock);
+    s_pm.stats.suspend_failures++;
+    portEXIT_CRITICAL(&pm_lock);
+    pm_give(false);
+    return ret;
+}
+
+esp_err_t usb_host_pm_resume(void)
+{
+    ESP_RETURN_ON_FALSE(pm_take(true), ESP_ERR_INVALID_STATE, TAG, "Bus is not suspended or busy");
+    const int64_t start_us = esp_timer_get_time();
+
+#if USB_HOST_PM_ROOT_PORT_SUSPEND
+    const esp_err_t port_ret = usb_host_lib_root_port_resume();
+    if (port_ret != ESP_OK) {
+        ESP_LOGE(TAG, "Root port resume failed: %s", esp_err_to_name(port_ret));
+        pm_give(true); // The drivers stay suspended, resume can be retried
+        return port_ret;
+    }
+    // The current tick can be almost over, so one more tick guarantees the full recovery time
+    vTaskDelay(pdMS_TO_TICKS(RESUME_RECOVERY_MS) + 1);
+#endif
+
+    const esp_err_t ret = pm_drivers_resume();
+
+    const uint32_t resume_us = (uint32_t)(esp_timer_get_time() - start_us);
+    portENTER_CRITICAL(&pm_lock);
+    s_pm.stats.last_resume_us = resume_us;
+    if (resume_us > s_pm.stats.max_resume_us) {
+        s_pm.stats.max_resume_us = resume_us;
+    }
+    portEXIT_CRITICAL(&pm_lock);
+    pm_give(false);
+    return ret;
+}
+
+esp_err_t usb_host_pm_get_stats(usb_host_pm_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    portENTER_CRITICAL(&pm_lock);
+    *stats = s_pm.stats;
+    portEXIT_CRITICAL(&pm_lock);
+    return ESP_OK;
+}
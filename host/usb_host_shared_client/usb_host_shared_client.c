@@ -0,0 +1,305 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/queue.h>
+#include "esp_log.h"
+#include "esp_check.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "usb/usb_host.h"
+#include "usb/usb_host_shared_client.h"
+
+#define DEFAULT_MAX_NUM_EVENT_MSG   (16)
+
+static const char *TAG = "usb_shared_client";
+
+typedef struct shared_client_member {
+    SLIST_ENTRY(shared_client_member) list_entry;
+    usb_host_client_event_cb_t event_cb;
+    void *arg;
+} shared_client_member_t;
+
+typedef struct shared_client_device {
+    SLIST_ENTRY(shared_client_device) list_entry;
+    usb_device_handle_t dev_hdl;
+    uint8_t dev_addr;
+    unsigned open_count;                        // Number of drivers which opened the device
+} shared_client_device_t;
+
+typedef struct {
+    usb_host_client_handle_t client_hdl;
+    SemaphoreHandle_t mutex;                    // Recursive, protects the lists. Held during event dispatch
+    SemaphoreHandle_t all_events_handled;
+    volatile bool event_handling_started;
+    volatile bool end_client_event_handling;
+    SLIST_HEAD(, shared_client_member) members;
+    SLIST_HEAD(, shared_client_device) devices;
+} shared_client_t;
+
+static portMUX_TYPE shared_client_lock = portMUX_INITIALIZER_UNLOCKED;
+static shared_client_t *s_shared_client = NULL;
+
+static void client_event_cb(const usb_host_client_event_msg_t *event_msg, void *arg)
+{
+    shared_client_t *client = (shared_client_t *)arg;
+    shared_client_member_t *member;
+
+    xSemaphoreTakeRecursive(client->mutex, portMAX_DELAY);
+    SLIST_FOREACH(member, &client->members, list_entry) {
+        member->event_cb(event_msg, member->arg);
+    }
+    xSemaphoreGiveRecursive(client->mutex);
+}
+
+/**
+ * @brief USB Client Event handler
+ *
+ * Handle events of all registered class drivers
+ *
+ * @param[in] arg   Argument, not used
+ */
+static void event_handler_task(void *arg)
+{
+    ESP_LOGD(TAG, "USB shared client handling start");
+    while (usb_host_shared_client_handle_events(portMAX_DELAY) == ESP_OK) {
+    }
+    ESP_LOGD(TAG, "USB shared client handling stop");
+    vTaskDelete(NULL);
+}
+
+esp_err_t usb_host_shared_client_install(const usb_host_shared_client_config_t *config)
+{
+    esp_err_t ret;
+
+    ESP_RETURN_ON_FALSE(config, ESP_ERR_INVALID_ARG, TAG, "Config can't be NULL");
+    if (config->create_background_task) {
+        ESP_RETURN_ON_FALSE(config->stack_size != 0, ESP_ERR_INVALID_ARG, TAG, "Stack size can't be 0");
+        ESP_RETURN_ON_FALSE(config->task_priority != 0, ESP_ERR_INVALID_ARG, TAG, "Task priority can't be 0");
+    }
+    ESP_RETURN_ON_FALSE(config->max_num_event_msg >= 0, ESP_ERR_INVALID_ARG, TAG, "Invalid event queue length");
+    ESP_RETURN_ON_FALSE(!s_shared_client, ESP_ERR_INVALID_STATE, TAG, "Already installed");
+
+    shared_client_t *client = calloc(1, sizeof(shared_client_t));
+    ESP_RETURN_ON_FALSE(client, ESP_ERR_NO_MEM, TAG, "Not enough memory");
+    SLIST_INIT(&client->members);
+    SLIST_INIT(&client->devices);
+    client->mutex = xSemaphoreCreateRecursiveMutex();
+    client->all_events_handled = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(client->mutex && client->all_events_handled, ESP_ERR_NO_MEM, fail, TAG, "Not enough memory");
+
+    const usb_host_client_config_t client_config = {
+        .is_synchronous = false,
+        .max_num_event_msg = config->max_num_event_msg ? config->max_num_event_msg : DEFAULT_MAX_NUM_EVENT_MSG,
+        .async.client_event_callback = client_event_cb,
+        .async.callback_arg = client,
+    };
+    ESP_GOTO_ON_ERROR(usb_host_client_register(&client_config, &client->client_hdl), fail, TAG, "Failed to register USB host client");
+
+    portENTER_CRITICAL(&shared_client_lock);
+    if (s_shared_client) {
+        portEXIT_CRITICAL(&shared_client_lock);
+        ret = ESP_ERR_INVALID_STATE;
+        goto fail;
+    }
+    s_shared_client = client;
+    portEXIT_CRITICAL(&shared_client_lock);
+
+    if (config->create_background_task) {
+        BaseType_t task_created = xTaskCreatePinnedToCore(
+                                      event_handler_task,
+                                      "USB shared client",
+                                      config->stack_size,
+                                      NULL,
+                                      config->task_priority,
+                                      NULL,
+                                      config->core_id);
+        if (task_created != pdPASS) {
+            s_shared_client = NULL;
+            ret = ESP_ERR_NO_MEM;
+            goto fail;
+        }
+    }
+    return ESP_OK;
+
+fail:
+    if (client->client_hdl) {
+        usb_host_client_deregister(client->client_hdl);
+    }
+    if (client->all_events_handled) {
+        vSemaphoreDelete(client->all_events_handled);
+    }
+    if (client->mutex) {
+        vSemaphoreDelete(client->mutex);
+    }
+    free(client);
+    return ret;
+}
+
+esp_err_t usb_host_shared_client_uninstall(void)
+{
+    shared_client_t *client = s_shared_client;
+    ESP_RETURN_ON_FALSE(client, ESP_ERR_INVALID_STATE, TAG, "Not installed");
+
+    xSemaphoreTakeRecursive(client->mutex, portMAX_DELAY);
+    const bool in_use = !SLIST_EMPTY(&client->members) || !SLIST_EMPTY(&client->devices);
+    if (!in_use) {
+        portENTER_CRITICAL(&shared_client_lock);
+        client->end_client_event_handling = true;
+        portEXIT_CRITICAL(&shared_client_lock);
+    }
+    xSemaphoreGiveRecursive(client->mutex);
+    ESP_RETURN_ON_FALSE(!in_use, ESP_ERR_INVALID_STATE, TAG, "Drivers are still registered");
+
+    if (client->event_handling_started) {
+        ESP_ERROR_CHECK(usb_host_client_unblock(client->client_hdl));
+        // In case the event handling started, we must wait until it finishes
+        xSemaphoreTake(client->all_events_handled, portMAX_DELAY);
+    }
+    ESP_ERROR_CHECK(usb_host_client_deregister(client->client_hdl));
+    s_shared_client = NULL;
+    vSemaphoreDelete(client->all_events_handled);
+    vSemaphoreDelete(client->mutex);
+    free(client);
+    return ESP_OK;
+}
+
+esp_err_t usb_host_shared_client_handle_events(TickType_t timeout)
+{
+    shared_client_t *client = s_shared_client;
+    ESP_RETURN_ON_FALSE(client, ESP_ERR_INVALID_STATE, TAG, "Not installed");
+
+    client->event_handling_started = true;
+    esp_err_t ret = usb_host_client_handle_events(client->client_hdl, timeout);
+    if (client->end_client_event_handling) {
+        xSemaphoreGive(client->all_events_handled);
+        return ESP_FAIL;
+    }
+    return ret;
+}
+
+esp_err_t usb_host_shared_client_register(usb_host_client_event_cb_t event_cb, void *arg, usb_host_client_handle_t *client_hdl_ret)
+{
+    ESP_RETURN_ON_FALSE(event_cb && client_hdl_ret, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    shared_client_t *client = s_shared_client;
+    ESP_RETURN_ON_FALSE(client && !client->end_client_event_handling, ESP_ERR_INVALID_STATE, TAG, "Not installed");
+
+    shared_client_member_t *member = calloc(1, sizeof(shared_client_member_t));
+    ESP_RETURN_ON_FALSE(member, ESP_ERR_NO_MEM, TAG, "Not enough memory");
+    member->event_cb = event_cb;
+    member->arg = arg;
+
+    // Append, so the drivers get the events in the order of registration
+    xSemaphoreTakeRecursive(client->mutex, portMAX_DELAY);
+    shared_client_member_t *last = SLIST_FIRST(&client->members);
+    if (last) {
+        while (SLIST_NEXT(last, list_entry)) {
+            last = SLIST_NEXT(last, list_entry);
+        }
+        SLIST_INSERT_AFTER(last, member, list_entry);
+    } else {
+        SLIST_INSERT_HEAD(&client->members, member, list_entry);
+    }
+    xSemaphoreGiveRecursive(client->mutex);
+
+    *client_hdl_ret = client->client_hdl;
+    return ESP_OK;
+}
+
+esp_err_t usb_host_shared_client_deregister(usb_host_client_event_cb_t event_cb, void *arg)
+{
+    shared_client_t *client = s_shared_client;
+    ESP_RETURN_ON_FALSE(client, ESP_ERR_NOT_FOUND, TAG, "Not installed");
+
+    shared_client_member_t *member;
+    xSemaphoreTakeRecursive(client->mutex, portMAX_DELAY);
+    SLIST_FOREACH(member, &client->members, list_entry) {
+        if (member->event_cb == event_cb && member->arg == arg) {
+            SLIST_REMOVE(&client->members, member, shared_client_member, list_entry);
+            break;
+        }
+    }
+    xSemaphoreGiveRecursive(client->mutex);
+
+    ESP_RETURN_ON_FALSE(member, ESP_ERR_NOT_FOUND, TAG, "Driver not registered");
+    free(member);
+    return ESP_OK;
+}
+
+esp_err_t usb_host_shared_client_device_open(usb_host_client_handle_t client_hdl, uint8_t dev_addr, usb_device_handle_t *dev_hdl_ret)
+{
+    shared_client_t *client = s_shared_client;
+    if (!client || client_hdl != client->client_hdl) {
+        return usb_host_device_open(client_hdl, dev_addr, dev_hdl_ret);
+    }
+
+    esp_err_t ret = ESP_OK;
+    shared_client_device_t *device;
+    xSemaphoreTakeRecursive(client->mutex, portMAX_DELAY);
+    SLIST_FOREACH(device, &client->devices, list_entry) {
+        if (device->dev_addr == dev_addr) {
+            break;
+        }
+    }
+    if (device) {
+        device->open_count++;
+        *dev_hdl_ret = device->dev_hdl;
+        goto exit;
+    }
+
+    device = calloc(1, sizeof(shared_client_device_t));
+    ESP_GOTO_ON_FALSE(device, ESP_ERR_NO_MEM, exit, TAG, "Not enough memory");
+    ret = usb_host_device_open(client_hdl, dev_addr, &device->dev_hdl);
+    if (ret != ESP_OK) {
+        free(device);
+        goto exit;
+    }
+    device->dev_addr = dev_addr;
+    device->open_count = 1;
+    SLIST_INSERT_HEAD(&client->devices, device, list_entry);
+    *dev_hdl_ret = device->dev_hdl;
+
+exit:
+    xSemaphoreGiveRecursive(client->mutex);
+    return ret;
+}
+
+esp_err_t usb_host_shared_client_device_close(usb_host_client_handle_t client_hdl, usb_device_handle_t dev_hdl)
+{
+    shared_client_t *client = s_shared_client;
+    if (!client || client_hdl != client->client_hdl) {
+        return usb_host_device_close(client_hdl, dev_hdl);
+    }
+
+    esp_err_t ret = ESP_OK;
+    shared_client_device_t *device;
+    xSemaphoreTakeRecursive(client->mutex, portMAX_DELAY);
+    SLIST_FOREACH(device, &client->devices, list_entry) {
+        if (device->dev_hdl == dev_hdl) {
+            break;
+        }
+    }
+    if (!device) {
+        ret = usb_host_device_close(client_hdl, dev_hdl);
+    } else {
+        if (device->open_count > 0) {
+            device->open_count--;
+        }
+        if (device->open_count == 0) {
+            // The last driver closes the device. The close fails while interfaces are claimed,
+            // then the device stays open and is closed by the next call
+            ret = usb_host_device_close(client_hdl, dev_hdl);
+            if (ret == ESP_OK) {
+                SLIST_REMOVE(&client->devices, device, shared_client_device, list_entry);
+                free(device);
+            }
+        }
+    }
+    xSemaphoreGiveRecursive(client->mutex);
+    return ret;
+}
@@ -0,0 +1,127 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "usb/usb_host_trace.h"
+
+#define TRACE_RECORDS   CONFIG_USB_HOST_TRACE_BUFFER_RECORDS
+#define TRACE_MASK      (TRACE_RECORDS - 1)
+
+_Static_assert((TRACE_RECORDS & TRACE_MASK) == 0, "CONFIG_USB_HOST_TRACE_BUFFER_RECORDS must be a power of two");
+_Static_assert(sizeof(usb_host_trace_record_t) == 20, "Trace record layout is used by the host tool");
+
+static const char *TAG = "usb_host_trace";
+
+static usb_host_trace_record_t s_records[TRACE_RECORDS];
+static atomic_uint_fast32_t s_write_idx;        // Index of the next record, wraps around the buffer
+static atomic_uint_fast32_t s_clear_idx;        // Index of the first record after the last clear
+static atomic_bool s_enabled = true;
+
+void usb_host_trace_record(usb_host_trace_driver_t driver, usb_host_trace_event_t event, uint8_t endpoint,
+                           uint32_t length, uint8_t status, uint32_t id)
+{
+    if (!atomic_load_explicit(&s_enabled, memory_order_relaxed)) {
+        return;
+    }
+    const uint32_t idx = atomic_fetch_add_explicit(&s_write_idx, 1, memory_order_relaxed);
+    usb_host_trace_record_t *record = &s_records[idx & TRACE_MASK];
+
+    // Sequence number 0 marks the record as being written, the reader skips it
+    __atomic_store_n(&record->seq, 0, __ATOMIC_RELAXED);
+    atomic_thread_fence(memory_order_release);
+    record->timestamp = (uint32_t)esp_timer_get_time();
+    record->id = id;
+    record->length = length;
+    record->event = event;
+    record->driver = driver;
+    record->endpoint = endpoint;
+    record->status = status;
+    __atomic_store_n(&record->seq, idx + 1, __ATOMIC_RELEASE);
+}
+
+void usb_host_trace_enable(bool enable)
+{
+    atomic_store(&s_enabled, enable);
+}
+
+void usb_host_trace_clear(void)
+{
+    atomic_store(&s_clear_idx, atomic_load(&s_write_idx));
+}
+
+/**
+ * @brief Copy a record, if it was not overwritten or being written
+ */
+static bool record_read(uint32_t idx, usb_host_trace_record_t *out)
+{
+    const usb_host_trace_record_t *record = &s_records[idx & TRACE_MASK];
+    if (__atomic_load_n(&record->seq, __ATOMIC_ACQUIRE) != idx + 1) {
+        return false;
+    }
+    *out = *record;
+    atomic_thread_fence(memory_order_acquire);
+    return __atomic_load_n(&record->seq, __ATOMIC_RELAXED) == idx + 1;
+}
+
+static bool dump_write(FILE *stream, bool hex, const void *data, size_t size)
+{
+    if (!hex) {
+        return fwrite(data, 1, size, stream) == size;
+    }
+    const uint8_t *bytes = data;
+    if (fputs("USBT:", stream) < 0) {
+        return false;
+    }
+    for (size_t i = 0; i < size; i++) {
+        if (fprintf(stream, "%02x", bytes[i]) < 0) {
+            return false;
+        }
+    }
+    return fputc('\n', stream) != EOF;
+}
+
+esp_err_t usb_host_trace_dump(FILE *stream, bool hex)
+{
+    ESP_RETURN_ON_FALSE(stream, ESP_ERR_INVALID_ARG, TAG, "stream can't be NULL");
+
+    const uint32_t end = atomic_load(&s_write_idx);
+    const uint32_t clear = atomic_load(&s_clear_idx);
+    uint32_t start = clear;
+    uint32_t overwritten = 0;
+    if (end - clear > TRACE_RECORDS) {
+        start = end - TRACE_RECORDS;
+        overwritten = start - clear;
+    }
+
+    // Count the readable records first, the header precedes them
+    uint32_t num_records = 0;
+    usb_host_trace_record_t record;
+    for (uint32_t idx = start; idx != end; idx++) {
+        num_records += record_read(idx, &record);
+    }
+
+    const usb_host_trace_header_t header = {
+        .magic = USB_HOST_TRACE_MAGIC,
+        .version = USB_HOST_TRACE_VERSION,
+        .record_size = sizeof(usb_host_trace_record_t),
+        .num_records = num_records,
+        .overwritten = overwritten,
+    };
+    ESP_RETURN_ON_FALSE(dump_write(stream, hex, &header, sizeof(header)), ESP_FAIL, TAG, "Write failed");
+    for (uint32_t idx = start; idx != end && num_records > 0; idx++) {
+        if (record_read(idx, &record)) {
+            ESP_RETURN_ON_FALSE(dump_write(stream, hex, &record, sizeof(record)), ESP_FAIL, TAG, "Write failed");
+            num_records--;
+        }
+    }
+    fflush(stream);
+    return ESP_OK;
+}
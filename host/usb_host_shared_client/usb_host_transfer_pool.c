@@ -0,0 +1,276 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_check.h"
+#include "freertos/FreeRTOS.h"
+#include "usb/usb_host.h"
+#include "usb/usb_host_transfer_pool.h"
+
+#define ENTRY_FREE  (-1)
+
+static const char *TAG = "usb_xfer_pool";
+
+typedef struct {
+    usb_transfer_t *xfer;
+    uint8_t *data_buffer;                       // Original data buffer, restored on free
+    int user;                                   // User holding the transfer or ENTRY_FREE
+} pool_entry_t;
+
+typedef struct {
+    usb_host_transfer_pool_class_t cfg;
+    pool_entry_t *entries;
+    int in_use;
+    int peak;
+} pool_class_t;
+
+typedef struct {
+    pool_class_t classes[USB_HOST_TRANSFER_POOL_CLASSES_MAX];   // Sorted by number of isoc packets and size
+    int num_classes;
+    size_t quota[USB_HOST_TRANSFER_POOL_USER_MAX];
+    size_t user_bytes[USB_HOST_TRANSFER_POOL_USER_MAX];
+    bool heap_fallback;
+    uint32_t heap_fallbacks;
+    uint32_t failures;
+} transfer_pool_t;
+
+static portMUX_TYPE pool_lock = portMUX_INITIALIZER_UNLOCKED;
+static transfer_pool_t *s_pool = NULL;
+
+static int class_compare(const void *a, const void *b)
+{
+    const usb_host_transfer_pool_class_t *ca = a;
+    const usb_host_transfer_pool_class_t *cb = b;
+    if (ca->num_isoc_packets != cb->num_isoc_packets) {
+        return ca->num_isoc_packets - cb->num_isoc_packets;
+    }
+    return (ca->data_buffer_size > cb->data_buffer_size) - (ca->data_buffer_size < cb->data_buffer_size);
+}
+
+/**
+ * @brief Give the transfer the size of the request
+ *
+ * data_buffer_size and num_isoc_packets are const to protect transfers in flight. The transfer is idle here,
+ * drivers see the size they requested, e.g. to detect short packets. Class size is restored on free.
+ */
+static void transfer_reset(usb_transfer_t *xfer, uint8_t *data_buffer, size_t data_buffer_size, int num_isoc_packets)
+{
+    *(uint8_t **)&xfer->data_buffer = data_buffer;
+    *(size_t *)&xfer->data_buffer_size = data_buffer_size;
+    *(int *)&xfer->num_isoc_packets = num_isoc_packets;
+    xfer->num_bytes = 0;
+    xfer->actual_num_bytes = 0;
+    xfer->flags = 0;
+    xfer->device_handle = NULL;
+    xfer->bEndpointAddress = 0;
+    xfer->status = USB_TRANSFER_STATUS_COMPLETED;
+    xfer->timeout_ms = 0;
+    xfer->callback = NULL;
+    xfer->context = NULL;
+    memset(xfer->isoc_packet_desc, 0, num_isoc_packets * sizeof(usb_isoc_packet_desc_t));
+}
+
+static void pool_free_memory(transfer_pool_t *pool)
+{
+    for (int c = 0; c < pool->num_classes; c++) {
+        pool_class_t *cls = &pool->classes[c];
+        if (!cls->entries) {
+            continue;
+        }
+        for (int i = 0; i < cls->cfg.num_transfers; i++) {
+            if (cls->entries[i].xfer) {
+                usb_host_transfer_free(cls->entries[i].xfer);
+            }
+        }
+        free(cls->entries);
+    }
+    free(pool);
+}
+
+esp_err_t usb_host_transfer_pool_install(const usb_host_transfer_pool_config_t *config)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(config, ESP_ERR_INVALID_ARG, TAG, "Config can't be NULL");
+    ESP_RETURN_ON_FALSE(!s_pool, ESP_ERR_INVALID_STATE, TAG, "Already installed");
+
+    transfer_pool_t *pool = calloc(1, sizeof(transfer_pool_t));
+    ESP_RETURN_ON_FALSE(pool, ESP_ERR_NO_MEM, TAG, "Not enough memory");
+    memcpy(pool->quota, config->quota, sizeof(pool->quota));
+    pool->heap_fallback = config->heap_fallback;
+
+    usb_host_transfer_pool_class_t classes[USB_HOST_TRANSFER_POOL_CLASSES_MAX];
+    for (int c = 0; c < USB_HOST_TRANSFER_POOL_CLASSES_MAX; c++) {
+        const usb_host_transfer_pool_class_t *cfg = &config->classes[c];
+        if (cfg->num_transfers == 0) {
+            continue;
+        }
+        ESP_GOTO_ON_FALSE(cfg->num_transfers > 0 && cfg->num_isoc_packets >= 0, ESP_ERR_INVALID_ARG, fail, TAG, "Invalid class %d", c);
+        classes[pool->num_classes++] = *cfg;
+    }
+    qsort(classes, pool->num_classes, sizeof(classes[0]), class_compare);
+
+    for (int c = 0; c < pool->num_classes; c++) {
+        pool_class_t *cls = &pool->classes[c];
+        cls->cfg = classes[c];
+        cls->entries = calloc(cls->cfg.num_transfers, sizeof(pool_entry_t));
+        ESP_GOTO_ON_FALSE(cls->entries, ESP_ERR_NO_MEM, fail, TAG, "Not enough memory");
+        for (int i = 0; i < cls->cfg.num_transfers; i++) {
+            ESP_GOTO_ON_ERROR(usb_host_transfer_alloc(cls->cfg.data_buffer_size, cls->cfg.num_isoc_packets, &cls->entries[i].xfer),
+                              fail, TAG, "Not enough memory for transfers");
+            cls->entries[i].data_buffer = cls->entries[i].xfer->data_buffer;
+            cls->entries[i].user = ENTRY_FREE;
+        }
+    }
+
+    portENTER_CRITICAL(&pool_lock);
+    if (s_pool) {
+        portEXIT_CRITICAL(&pool_lock);
+        ret = ESP_ERR_INVALID_STATE;
+        goto fail;
+    }
+    s_pool = pool;
+    portEXIT_CRITICAL(&pool_lock);
+    return ESP_OK;
+
+fail:
+    pool_free_memory(pool);
+    return ret;
+}
+
+esp_err_t usb_host_transfer_pool_uninstall(void)
+{
+    portENTER_CRITICAL(&pool_lock);
+    transfer_pool_t *pool = s_pool;
+    bool in_use = false;
+    for (int c = 0; pool && c < pool->num_classes; c++) {
+        in_use |= pool->classes[c].in_use > 0;
+    }
+    if (pool && !in_use) {
+        s_pool = NULL;
+    }
+    portEXIT_CRITICAL(&pool_lock);
+
+    ESP_RETURN_ON_FALSE(pool, ESP_ERR_INVALID_STATE, TAG, "Not installed");
+    ESP_RETURN_ON_FALSE(!in_use, ESP_ERR_INVALID_STATE, TAG, "Transfers are still allocated");
+    pool_free_memory(pool);
+    return ESP_OK;
+}
+
+esp_err_t usb_host_transfer_pool_alloc(usb_host_transfer_pool_user_t user, size_t data_buffer_size, int num_isoc_packets, usb_transfer_t **transfer)
+{
+    ESP_RETURN_ON_FALSE(user >= 0 && user < USB_HOST_TRANSFER_POOL_USER_MAX && num_isoc_packets >= 0 && transfer,
+                        ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+
+    pool_entry_t *entry = NULL;
+    pool_class_t *cls = NULL;
+    portENTER_CRITICAL(&pool_lock);
+    transfer_pool_t *pool = s_pool;
+    if (!pool) {
+        portEXIT_CRITICAL(&pool_lock);
+        return usb_host_transfer_alloc(data_buffer_size, num_isoc_packets, transfer);
+    }
+    for (int c = 0; c < pool->num_classes && !entry; c++) {
+        cls = &pool->classes[c];
+        if (cls->cfg.num_isoc_packets != num_isoc_packets || cls->cfg.data_buffer_size < data_buffer_size ||
+                cls->in_use == cls->cfg.num_transfers) {
+            continue;
+        }
+        if (pool->quota[user] && pool->user_bytes[user] + cls->cfg.data_buffer_size > pool->quota[user]) {
+            break; // Larger classes would exceed the quota too
+        }
+        for (int i = 0; i < cls->cfg.num_transfers; i++) {
+            if (cls->entries[i].user == ENTRY_FREE) {
+                entry = &cls->entries[i];
+                break;
+            }
+        }
+    }
+    if (entry) {
+        entry->user = user;
+        pool->user_bytes[user] += cls->cfg.data_buffer_size;
+        if (++cls->in_use > cls->peak) {
+            cls->peak = cls->in_use;
+        }
+    } else if (pool->heap_fallback) {
+        pool->heap_fallbacks++;
+    } else {
+        pool->failures++;
+    }
+    const bool heap_fallback = pool->heap_fallback;
+    portEXIT_CRITICAL(&pool_lock);
+
+    if (entry) {
+        transfer_reset(entry->xfer, entry->data_buffer, data_buffer_size, num_isoc_packets);
+        *transfer = entry->xfer;
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_FALSE(heap_fallback, ESP_ERR_NO_MEM, TAG, "No pooled transfer of %u bytes, %d isoc packets for user %d",
+                        (unsigned)data_buffer_size, num_isoc_packets, user);
+    return usb_host_transfer_alloc(data_buffer_size, num_isoc_packets, transfer);
+}
+
+esp_err_t usb_host_transfer_pool_free(usb_transfer_t *transfer)
+{
+    if (transfer == NULL) {
+        return ESP_OK;
+    }
+
+    portENTER_CRITICAL(&pool_lock);
+    transfer_pool_t *pool = s_pool;
+    for (int c = 0; pool && c < pool->num_classes; c++) {
+        pool_class_t *cls = &pool->classes[c];
+        for (int i = 0; i < cls->cfg.num_transfers; i++) {
+            pool_entry_t *entry = &cls->entries[i];
+            if (entry->xfer != transfer) {
+                continue;
+            }
+            if (entry->user != ENTRY_FREE) {
+                // Back to the class size before the entry is free, so the transfer fits any request of its class
+                transfer_reset(transfer, entry->data_buffer, cls->cfg.data_buffer_size, cls->cfg.num_isoc_packets);
+                pool->user_bytes[entry->user] -= cls->cfg.data_buffer_size;
+                entry->user = ENTRY_FREE;
+                cls->in_use--;
+            }
+            portEXIT_CRITICAL(&pool_lock);
+            return ESP_OK;
+        }
+    }
+    portEXIT_CRITICAL(&pool_lock);
+    return usb_host_transfer_free(transfer);
+}
+
+esp_err_t usb_host_transfer_pool_get_stats(usb_host_transfer_pool_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "stats can't be NULL");
+    memset(stats, 0, sizeof(usb_host_transfer_pool_stats_t));
+
+    portENTER_CRITICAL(&pool_lock);
+    transfer_pool_t *pool = s_pool;
+    if (pool) {
+        for (int c = 0; c < pool->num_classes; c++) {
+            stats->in_use[c] = pool->classes[c].in_use;
+            stats->peak[c] = pool->classes[c].peak;
+        }
+        memcpy(stats->user_bytes, pool->user_bytes, sizeof(stats->user_bytes));
+        stats->heap_fallbacks = pool->heap_fallbacks;
+        stats->failures = pool->failures;
+    }
+    portEXIT_CRITICAL(&pool_lock);
+    ESP_RETURN_ON_FALSE(pool, ESP_ERR_INVALID_STATE, TAG, "Not installed");
+    return ESP_OK;
+}
+
+bool usb_host_transfer_pool_is_static(void)
+{
+    portENTER_CRITICAL(&pool_lock);
+    const bool is_static = s_pool && !s_pool->heap_fallback;
+    portEXIT_CRITICAL(&pool_lock);
+    return is_static;
+}
@@ -0,0 +1,154 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "usb/usb_host.h"
+#include "usb/usb_host_sim.h"
+
+/**
+ * Test device:
+ * - Interface 0: Bulk IN 0x81, Bulk OUT 0x01, Interrupt IN 0x83 (8 B, polled every 1 ms)
+ * - Interface 1: Alternate 0 without endpoints, alternate 1 with ISOC IN 0x82
+ *
+ * Full-speed: 64 B bulk and 192 B ISOC packets every frame.
+ * High-speed: 512 B bulk and high-bandwidth 3 * 1024 B ISOC packets every microframe.
+ */
+constexpr uint8_t test_ep_bulk_in = 0x81;
+constexpr uint8_t test_ep_bulk_out = 0x01;
+constexpr uint8_t test_ep_int_in = 0x83;
+constexpr uint8_t test_ep_isoc_in = 0x82;
+
+const uint8_t test_cfg_desc_fs[] = {
+    0x09, 0x02, 0x40, 0x00, 0x02, 0x01, 0x00, 0x80, 0x32,
+    0x09, 0x04, 0x00, 0x00, 0x03, 0xFF, 0x00, 0x00, 0x00,
+    0x07, 0x05, 0x81, 0x02, 0x40, 0x00, 0x00,
+    0x07, 0x05, 0x01, 0x02, 0x40, 0x00, 0x00,
+    0x07, 0x05, 0x83, 0x03, 0x08, 0x00, 0x01,
+    0x09, 0x04, 0x01, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00,
+    0x09, 0x04, 0x01, 0x01, 0x01, 0xFF, 0x00, 0x00, 0x00,
+    0x07, 0x05, 0x82, 0x05, 0xC0, 0x00, 0x01,
+};
+
+const uint8_t test_cfg_desc_hs[] = {
+    0x09, 0x02, 0x40, 0x00, 0x02, 0x01, 0x00, 0x80, 0x32,
+    0x09, 0x04, 0x00, 0x00, 0x03, 0xFF, 0x00, 0x00, 0x00,
+    0x07, 0x05, 0x81, 0x02, 0x00, 0x02, 0x00,
+    0x07, 0x05, 0x01, 0x02, 0x00, 0x02, 0x00,
+    0x07, 0x05, 0x83, 0x03, 0x08, 0x00, 0x04,
+    0x09, 0x04, 0x01, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00,
+    0x09, 0x04, 0x01, 0x01, 0x01, 0xFF, 0x00, 0x00, 0x00,
+    0x07, 0x05, 0x82, 0x05, 0x00, 0x14, 0x01,
+};
+
+const usb_device_desc_t test_dev_desc = {
+    .bLength = USB_DEVICE_DESC_SIZE,
+    .bDescriptorType = USB_B_DESCRIPTOR_TYPE_DEVICE,
+    .bcdUSB = 0x0200,
+    .bDeviceClass = 0xFF,
+    .bDeviceSubClass = 0,
+    .bDeviceProtocol = 0,
+    .bMaxPacketSize0 = 64,
+    .idVendor = 0x303A,
+    .idProduct = 0x4002,
+    .bcdDevice = 0x0100,
+    .iManufacturer = 0,
+    .iProduct = 0,
+    .iSerialNumber = 0,
+    .bNumConfigurations = 1,
+};
+
+/**
+ * @brief Installed simulator with one registered client
+ *
+ * Client events and completed transfers are collected in vectors.
+ */
+struct test_sim {
+    usb_host_client_handle_t client = nullptr;
+    std::vector<usb_host_client_event_msg_t> events;
+    std::vector<usb_transfer_t *> completed;
+
+    explicit test_sim(const usb_host_sim_config_t &config)
+    {
+        REQUIRE(ESP_OK == usb_host_sim_install(&config));
+        usb_host_client_config_t client_config = {};
+        client_config.max_num_event_msg = 5;
+        client_config.async.client_event_callback = client_event_cb;
+        client_config.async.callback_arg = this;
+        REQUIRE(ESP_OK == usb_host_client_register(&client_config, &client));
+    }
+
+    ~test_sim()
+    {
+        usb_host_client_deregister(client);
+        usb_host_sim_uninstall();
+    }
+
+    static void client_event_cb(const usb_host_client_event_msg_t *event_msg, void *arg)
+    {
+        static_cast<test_sim *>(arg)->events.push_back(*event_msg);
+    }
+
+    static void transfer_cb(usb_transfer_t *transfer)
+    {
+        static_cast<test_sim *>(transfer->context)->completed.push_back(transfer);
+    }
+
+    /**
+     * @brief Handle all client events and completed transfers
+     */
+    void handle_events()
+    {
+        while (usb_host_client_handle_events(client, 0) == ESP_OK) {
+        }
+    }
+
+    usb_host_sim_device_hdl_t connect(const uint8_t *cfg_desc, usb_speed_t speed,
+                                      usb_host_sim_ctrl_cb_t ctrl_cb = nullptr, void *ctrl_arg = nullptr)
+    {
+        const usb_host_sim_device_config_t dev_config = {
+            .dev_desc = &test_dev_desc,
+            .config_desc = reinterpret_cast<const usb_config_desc_t *>(cfg_desc),
+            .speed = speed,
+            .ctrl_cb = ctrl_cb,
+            .ctrl_arg = ctrl_arg,
+        };
+        usb_host_sim_device_hdl_t dev = nullptr;
+        REQUIRE(ESP_OK == usb_host_sim_device_connect(&dev_config, &dev));
+        return dev;
+    }
+
+    usb_transfer_t *alloc(usb_device_handle_t dev_hdl, uint8_t ep, size_t size, int num_isoc_packets = 0)
+    {
+        usb_transfer_t *transfer = nullptr;
+        REQUIRE(ESP_OK == usb_host_transfer_alloc(size, num_isoc_packets, &transfer));
+        transfer->device_handle = dev_hdl;
+        transfer->bEndpointAddress = ep;
+        transfer->callback = transfer_cb;
+        transfer->context = this;
+        transfer->num_bytes = size;
+        return transfer;
+    }
+};
+
+/**
+ * @brief Device endpoint that always has full packets, filled with the low byte of the packet counter
+ */
+inline int test_ep_always_ready(usb_host_sim_device_hdl_t dev, uint8_t bEndpointAddress, uint8_t *data, size_t length,
+                                uint64_t time_us, void *arg)
+{
+    auto *counter = static_cast<uint32_t *>(arg);
+    if (data) {
+        std::fill(data, data + length, static_cast<uint8_t>(*counter));
+    }
+    (*counter)++;
+    return length;
+}
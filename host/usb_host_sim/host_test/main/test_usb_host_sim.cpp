@@ -0,0 +1,341 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+
+#include "usb/usb_host.h"
+#include "usb/usb_host_sim.h"
+#include "test_sim_helpers.hpp"
+
+static usb_host_sim_config_t test_config(usb_speed_t speed)
+{
+    usb_host_sim_config_t config = USB_HOST_SIM_CONFIG_DEFAULT();
+    config.speed = speed;
+    return config;
+}
+
+SCENARIO("Device connection and disconnection", "[sim][hotplug]")
+{
+    test_sim sim(test_config(USB_SPEED_FULL));
+    usb_host_sim_device_hdl_t dev = sim.connect(test_cfg_desc_fs, USB_SPEED_FULL);
+
+    WHEN("Client handles events") {
+        sim.handle_events();
+        THEN("New device event is delivered with address of the device") {
+            REQUIRE(sim.events.size() == 1);
+            REQUIRE(sim.events[0].event == USB_HOST_CLIENT_EVENT_NEW_DEV);
+            REQUIRE(sim.events[0].new_dev.address == usb_host_sim_device_get_addr(dev));
+
+            uint8_t addrs[4];
+            int num_devs = 0;
+            REQUIRE(ESP_OK == usb_host_device_addr_list_fill(4, addrs, &num_devs));
+            REQUIRE(num_devs == 1);
+            REQUIRE(addrs[0] == usb_host_sim_device_get_addr(dev));
+        }
+    }
+
+    WHEN("Opened device is disconnected with transfer in flight") {
+        usb_device_handle_t dev_hdl;
+        REQUIRE(ESP_OK == usb_host_device_open(sim.client, usb_host_sim_device_get_addr(dev), &dev_hdl));
+        REQUIRE(ESP_OK == usb_host_interface_claim(sim.client, dev_hdl, 0, 0));
+        usb_transfer_t *transfer = sim.alloc(dev_hdl, test_ep_bulk_in, 64);
+        REQUIRE(ESP_OK == usb_host_transfer_submit(transfer));
+        REQUIRE(ESP_OK == usb_host_sim_device_disconnect(dev));
+        sim.handle_events();
+
+        THEN("Transfer completes with no device status and device gone event is delivered") {
+            REQUIRE(sim.completed.size() == 1);
+            REQUIRE(transfer->status == USB_TRANSFER_STATUS_NO_DEVICE);
+            REQUIRE(sim.events.back().event == USB_HOST_CLIENT_EVENT_DEV_GONE);
+            REQUIRE(sim.events.back().dev_gone.dev_hdl == dev_hdl);
+            REQUIRE(ESP_ERR_INVALID_STATE == usb_host_transfer_submit(transfer));
+        }
+        REQUIRE(ESP_OK == usb_host_transfer_free(transfer));
+        REQUIRE(ESP_OK == usb_host_device_close(sim.client, dev_hdl));
+    }
+}
+
+SCENARIO("Control transfers", "[sim][ctrl]")
+{
+    GIVEN("Control transfers completing inside submit") {
+        test_sim sim(test_config(USB_SPEED_FULL));
+        usb_host_sim_device_hdl_t dev = sim.connect(test_cfg_desc_fs, USB_SPEED_FULL);
+        usb_device_handle_t dev_hdl;
+        REQUIRE(ESP_OK == usb_host_device_open(sim.client, usb_host_sim_device_get_addr(dev), &dev_hdl));
+        usb_transfer_t *transfer = sim.alloc(dev_hdl, 0, 64 + sizeof(usb_setup_packet_t));
+
+        WHEN("Configuration descriptor is requested") {
+            USB_SETUP_PACKET_INIT_GET_CONFIG_DESC((usb_setup_packet_t *)transfer->data_buffer, 0, 64);
+            transfer->num_bytes = 64 + sizeof(usb_setup_packet_t);
+            REQUIRE(ESP_OK == usb_host_transfer_submit_control(sim.client, transfer));
+            THEN("Callback was called before submit returned, with the descriptor") {
+                REQUIRE(sim.completed.size() == 1);
+                REQUIRE(transfer->status == USB_TRANSFER_STATUS_COMPLETED);
+                REQUIRE(transfer->actual_num_bytes == sizeof(usb_setup_packet_t) + sizeof(test_cfg_desc_fs));
+                REQUIRE(memcmp(transfer->data_buffer + sizeof(usb_setup_packet_t), test_cfg_desc_fs, sizeof(test_cfg_desc_fs)) == 0);
+            }
+        }
+
+        WHEN("Class request is sent to device without control callback") {
+            usb_setup_packet_t *setup = (usb_setup_packet_t *)transfer->data_buffer;
+            setup->bmRequestType = USB_BM_REQUEST_TYPE_DIR_OUT | USB_BM_REQUEST_TYPE_TYPE_CLASS | USB_BM_REQUEST_TYPE_RECIP_INTERFACE;
+            setup->bRequest = 0x22;
+            setup->wValue = 0;
+            setup->wIndex = 0;
+            setup->wLength = 0;
+            transfer->num_bytes = sizeof(usb_setup_packet_t);
+            REQUIRE(ESP_OK == usb_host_transfer_submit_control(sim.client, transfer));
+            THEN("The request is stalled") {
+                REQUIRE(transfer->status == USB_TRANSFER_STATUS_STALL);
+            }
+        }
+        REQUIRE(ESP_OK == usb_host_transfer_free(transfer));
+        REQUIRE(ESP_OK == usb_host_device_close(sim.client, dev_hdl));
+    }
+
+    GIVEN("Control transfers on the bus") {
+        usb_host_sim_config_t config = test_config(USB_SPEED_FULL);
+        config.control_on_bus = true;
+        test_sim sim(config);
+        usb_host_sim_device_hdl_t dev = sim.connect(test_cfg_desc_fs, USB_SPEED_FULL);
+        usb_device_handle_t dev_hdl;
+        REQUIRE(ESP_OK == usb_host_device_open(sim.client, usb_host_sim_device_get_addr(dev), &dev_hdl));
+        usb_transfer_t *transfer = sim.alloc(dev_hdl, 0, sizeof(usb_device_desc_t) + sizeof(usb_setup_packet_t));
+        USB_SETUP_PACKET_INIT_GET_DEVICE_DESC((usb_setup_packet_t *)transfer->data_buffer);
+        REQUIRE(ESP_OK == usb_host_transfer_submit_control(sim.client, transfer));
+
+        THEN("Transfer completes only after simulated time advanced") {
+            sim.handle_events();
+            REQUIRE(sim.completed.empty());
+            usb_host_sim_advance(3000);
+            sim.handle_events();
+            REQUIRE(sim.completed.size() == 1);
+            REQUIRE(memcmp(transfer->data_buffer + sizeof(usb_setup_packet_t), &test_dev_desc, sizeof(usb_device_desc_t)) == 0);
+        }
+        REQUIRE(ESP_OK == usb_host_transfer_free(transfer));
+        REQUIRE(ESP_OK == usb_host_device_close(sim.client, dev_hdl));
+    }
+}
+
+SCENARIO("Bulk timing model", "[sim][bulk]")
+{
+    test_sim sim(test_config(USB_SPEED_FULL));
+    usb_host_sim_device_hdl_t dev = sim.connect(test_cfg_desc_fs, USB_SPEED_FULL);
+    usb_device_handle_t dev_hdl;
+    REQUIRE(ESP_OK == usb_host_device_open(sim.client, usb_host_sim_device_get_addr(dev), &dev_hdl));
+    REQUIRE(ESP_OK == usb_host_interface_claim(sim.client, dev_hdl, 0, 0));
+    uint32_t packets = 0;
+    REQUIRE(ESP_OK == usb_host_sim_endpoint_set_cb(dev, test_ep_bulk_in, test_ep_always_ready, &packets));
+
+    WHEN("One short transfer is submitted") {
+        usb_transfer_t *transfer = sim.alloc(dev_hdl, test_ep_bulk_in, 64);
+        REQUIRE(ESP_OK == usb_host_transfer_submit(transfer));
+        usb_host_sim_advance(2000);
+        sim.handle_events();
+        THEN("Completion waits for submit latency, the next frame and completion latency") {
+            REQUIRE(sim.completed.empty()); // Transferred in frame 1, completion latency ends after 2050 us
+            usb_host_sim_advance(1000);
+            sim.handle_events();
+            REQUIRE(sim.completed.size() == 1);
+            REQUIRE(transfer->actual_num_bytes == 64);
+
+            usb_host_sim_ep_stats_t stats;
+            REQUIRE(ESP_OK == usb_host_sim_endpoint_get_stats(dev, test_ep_bulk_in, &stats));
+            REQUIRE(stats.transfers == 1);
+            REQUIRE(stats.latency_max_us == 3000);
+        }
+        REQUIRE(ESP_OK == usb_host_transfer_free(transfer));
+    }
+
+    WHEN("Transfers are resubmitted for 100 ms") {
+        std::vector<usb_transfer_t *> transfers;
+        for (int i = 0; i < 2; i++) {
+            transfers.push_back(sim.alloc(dev_hdl, test_ep_bulk_in, 4096));
+            REQUIRE(ESP_OK == usb_host_transfer_submit(transfers.back()));
+        }
+        struct pump_ctx {
+            test_sim *sim;
+        } ctx = {&sim};
+        usb_host_sim_run(100 * 1000, [](void *arg) {
+            test_sim *s = static_cast<pump_ctx *>(arg)->sim;
+            s->handle_events();
+            for (usb_transfer_t *t : s->completed) {
+                usb_host_transfer_submit(t);
+            }
+            s->completed.clear();
+        }, &ctx);
+
+        THEN("Throughput is limited by 19 bulk packets per Full-speed frame") {
+            usb_host_sim_ep_stats_t stats;
+            REQUIRE(ESP_OK == usb_host_sim_endpoint_get_stats(dev, test_ep_bulk_in, &stats));
+            REQUIRE(stats.bytes <= 100 * 1216);
+            REQUIRE(stats.bytes >= 90 * 1216);
+        }
+        REQUIRE(ESP_OK == usb_host_endpoint_halt(dev_hdl, test_ep_bulk_in));
+        REQUIRE(ESP_OK == usb_host_endpoint_flush(dev_hdl, test_ep_bulk_in));
+        REQUIRE(ESP_OK == usb_host_endpoint_clear(dev_hdl, test_ep_bulk_in));
+        sim.handle_events();
+        for (usb_transfer_t *t : transfers) {
+            REQUIRE(ESP_OK == usb_host_transfer_free(t));
+        }
+    }
+    REQUIRE(ESP_OK == usb_host_interface_release(sim.client, dev_hdl, 0));
+    REQUIRE(ESP_OK == usb_host_device_close(sim.client, dev_hdl));
+}
+
+SCENARIO("Periodic timing model", "[sim][isoc][intr]")
+{
+    GIVEN("High-speed device with high-bandwidth ISOC endpoint") {
+        test_sim sim(test_config(USB_SPEED_HIGH));
+        usb_host_sim_device_hdl_t dev = sim.connect(test_cfg_desc_hs, USB_SPEED_HIGH);
+        usb_device_handle_t dev_hdl;
+        REQUIRE(ESP_OK == usb_host_device_open(sim.client, usb_host_sim_device_get_addr(dev), &dev_hdl));
+        REQUIRE(ESP_OK == usb_host_interface_claim(sim.client, dev_hdl, 1, 1));
+        uint32_t packets = 0;
+        REQUIRE(ESP_OK == usb_host_sim_endpoint_set_cb(dev, test_ep_isoc_in, test_ep_always_ready, &packets));
+
+        WHEN("No transfer is submitted") {
+            usb_host_sim_advance(1000);
+            THEN("Packets sent by the device are lost") {
+                usb_host_sim_ep_stats_t stats;
+                REQUIRE(ESP_OK == usb_host_sim_endpoint_get_stats(dev, test_ep_isoc_in, &stats));
+                REQUIRE(stats.packets_lost == 8);
+            }
+        }
+
+        WHEN("Transfer of 8 packets is submitted") {
+            usb_transfer_t *transfer = sim.alloc(dev_hdl, test_ep_isoc_in, 8 * 3072, 8);
+            for (int i = 0; i < 8; i++) {
+                transfer->isoc_packet_desc[i].num_bytes = 3072;
+            }
+            REQUIRE(ESP_OK == usb_host_transfer_submit(transfer));
+            usb_host_sim_advance(1500);
+            sim.handle_events();
+            THEN("All transactions of each microframe are received in one packet") {
+                REQUIRE(sim.completed.size() == 1);
+                REQUIRE(transfer->actual_num_bytes == 8 * 3072);
+                for (int i = 0; i < 8; i++) {
+                    REQUIRE(transfer->isoc_packet_desc[i].actual_num_bytes == 3072);
+                    REQUIRE(transfer->isoc_packet_desc[i].status == USB_TRANSFER_STATUS_COMPLETED);
+                }
+                // The first microframe is missed due to submit latency
+                REQUIRE(transfer->data_buffer[0] == 1);
+            }
+            REQUIRE(ESP_OK == usb_host_transfer_free(transfer));
+        }
+        REQUIRE(ESP_OK == usb_host_interface_release(sim.client, dev_hdl, 1));
+        REQUIRE(ESP_OK == usb_host_device_close(sim.client, dev_hdl));
+    }
+
+    GIVEN("Full-speed interrupt endpoint without data") {
+        test_sim sim(test_config(USB_SPEED_FULL));
+        usb_host_sim_device_hdl_t dev = sim.connect(test_cfg_desc_fs, USB_SPEED_FULL);
+        usb_device_handle_t dev_hdl;
+        REQUIRE(ESP_OK == usb_host_device_open(sim.client, usb_host_sim_device_get_addr(dev), &dev_hdl));
+        REQUIRE(ESP_OK == usb_host_interface_claim(sim.client, dev_hdl, 0, 0));
+        usb_transfer_t *transfer = sim.alloc(dev_hdl, test_ep_int_in, 8);
+        REQUIRE(ESP_OK == usb_host_transfer_submit(transfer));
+        usb_host_sim_advance(10 * 1000);
+        sim.handle_events();
+
+        THEN("The endpoint is NAKed every frame until the device has data") {
+            usb_host_sim_ep_stats_t stats;
+            REQUIRE(ESP_OK == usb_host_sim_endpoint_get_stats(dev, test_ep_int_in, &stats));
+            REQUIRE(sim.completed.empty());
+            REQUIRE(stats.naks == 9);
+
+            uint32_t packets = 0;
+            REQUIRE(ESP_OK == usb_host_sim_endpoint_set_cb(dev, test_ep_int_in, test_ep_always_ready, &packets));
+            usb_host_sim_advance(2000);
+            sim.handle_events();
+            REQUIRE(sim.completed.size() == 1);
+            REQUIRE(transfer->actual_num_bytes == 8);
+        }
+        REQUIRE(ESP_OK == usb_host_transfer_free(transfer));
+        REQUIRE(ESP_OK == usb_host_interface_release(sim.client, dev_hdl, 0));
+        REQUIRE(ESP_OK == usb_host_device_close(sim.client, dev_hdl));
+    }
+}
+
+SCENARIO("Recorded device playback", "[sim][playback]")
+{
+    test_sim sim(test_config(USB_SPEED_FULL));
+    usb_host_sim_device_hdl_t dev = sim.connect(test_cfg_desc_fs, USB_SPEED_FULL);
+    usb_device_handle_t dev_hdl;
+    REQUIRE(ESP_OK == usb_host_device_open(sim.client, usb_host_sim_device_get_addr(dev), &dev_hdl));
+    REQUIRE(ESP_OK == usb_host_interface_claim(sim.client, dev_hdl, 0, 0));
+
+    GIVEN("Recording of 3 bulk packets, 5 ms apart") {
+        const char *path = "test_recording.bin";
+        const uint8_t records[] = {
+            0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 'a', 'b', 'c',
+            0x88, 0x13, 0x00, 0x00, 0x02, 0x00, 0x00, 'd', 'e',
+            0x10, 0x27, 0x00, 0x00, 0x01, 0x00, 0x00, 'f',
+        };
+        FILE *file = fopen(path, "wb");
+        REQUIRE(file);
+        REQUIRE(fwrite(records, 1, sizeof(records), file) == sizeof(records));
+        fclose(file);
+        usb_host_sim_packet_t *packets = nullptr;
+        size_t num_packets = 0;
+        REQUIRE(ESP_OK == usb_host_sim_recording_load(path, &packets, &num_packets));
+        remove(path);
+        REQUIRE(num_packets == 3);
+        REQUIRE(packets[1].time_us == 5000);
+        REQUIRE(ESP_OK == usb_host_sim_endpoint_playback(dev, test_ep_bulk_in, packets, num_packets, false));
+
+        WHEN("Transfers are submitted for 12 ms") {
+            std::vector<std::vector<uint8_t>> received;
+            std::vector<uint64_t> times;
+            usb_transfer_t *transfer = sim.alloc(dev_hdl, test_ep_bulk_in, 64);
+            REQUIRE(ESP_OK == usb_host_transfer_submit(transfer));
+            for (int ms = 0; ms < 12; ms++) {
+                usb_host_sim_advance(1000);
+                sim.handle_events();
+                if (!sim.completed.empty()) {
+                    received.emplace_back(transfer->data_buffer, transfer->data_buffer + transfer->actual_num_bytes);
+                    times.push_back(usb_host_sim_get_time_us());
+                    sim.completed.clear();
+                    REQUIRE(ESP_OK == usb_host_transfer_submit(transfer));
+                }
+            }
+            THEN("Packets are received in order, not before their recorded time") {
+                REQUIRE(received == std::vector<std::vector<uint8_t>> {{'a', 'b', 'c'}, {'d', 'e'}, {'f'}});
+                REQUIRE(times[1] > 5000);
+                REQUIRE(times[2] > 10000);
+            }
+            REQUIRE(ESP_OK == usb_host_endpoint_halt(dev_hdl, test_ep_bulk_in));
+            REQUIRE(ESP_OK == usb_host_endpoint_flush(dev_hdl, test_ep_bulk_in));
+            sim.handle_events();
+            REQUIRE(ESP_OK == usb_host_transfer_free(transfer));
+        }
+        usb_host_sim_recording_free(packets, num_packets);
+    }
+    REQUIRE(ESP_OK == usb_host_interface_release(sim.client, dev_hdl, 0));
+    REQUIRE(ESP_OK == usb_host_device_close(sim.client, dev_hdl));
+}
+
+SCENARIO("Transfer allocation statistics", "[sim][alloc]")
+{
+    test_sim sim(test_config(USB_SPEED_FULL));
+    usb_transfer_t *a = nullptr;
+    usb_transfer_t *b = nullptr;
+    REQUIRE(ESP_OK == usb_host_transfer_alloc(512, 0, &a));
+    REQUIRE(ESP_OK == usb_host_transfer_alloc(1024, 4, &b));
+    REQUIRE(ESP_OK == usb_host_transfer_free(a));
+
+    usb_host_sim_stats_t stats;
+    REQUIRE(ESP_OK == usb_host_sim_get_stats(&stats));
+    REQUIRE(stats.transfer_allocs == 2);
+    REQUIRE(stats.transfers_allocated == 1);
+    REQUIRE(stats.transfers_peak == 2);
+    REQUIRE(stats.transfer_bytes == 1024);
+    REQUIRE(stats.transfer_bytes_peak == 1536);
+    REQUIRE(ESP_OK == usb_host_transfer_free(b));
+}
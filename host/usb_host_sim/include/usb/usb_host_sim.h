@@ -0,0 +1,326 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "usb/usb_host.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define USB_HOST_SIM_DEVICES_MAX    (8)     /**< Maximum number of connected devices */
+#define USB_HOST_SIM_CLIENTS_MAX    (8)     /**< Maximum number of registered clients */
+#define USB_HOST_SIM_ENDPOINTS_MAX  (16)    /**< Maximum number of non-control endpoints of one device */
+#define USB_HOST_SIM_NAK            (-1)    /**< Endpoint callback return value: The device NAKs this packet */
+
+typedef struct usb_host_sim_device_s *usb_host_sim_device_hdl_t;
+
+/**
+ * @brief Endpoint callback, called for every packet of the endpoint on the bus
+ *
+ * IN endpoints fill data with up to length bytes sent by the device, OUT endpoints consume length bytes sent by the host.
+ * ISOC IN endpoints are called in every service interval, also when no transfer is submitted: The packet is then lost,
+ * as on a real bus.
+ *
+ * @param[in] dev              Simulated device
+ * @param[in] bEndpointAddress Endpoint address
+ * @param[inout] data          IN: Buffer to fill. OUT: Data sent by the host. NULL for ISOC IN packets without transfer
+ * @param[in] length           IN: Maximum packet size of the service interval. OUT: Bytes sent by the host
+ * @param[in] time_us          Simulated bus time of the packet in microseconds
+ * @param[in] arg              User argument
+ * @return Number of bytes sent (IN) or accepted (OUT), USB_HOST_SIM_NAK if the device is not ready
+ */
+typedef int (*usb_host_sim_ep_cb_t)(usb_host_sim_device_hdl_t dev, uint8_t bEndpointAddress, uint8_t *data, size_t length,
+                                    uint64_t time_us, void *arg);
+
+/**
+ * @brief Control request callback
+ *
+ * @param[in] dev     Simulated device
+ * @param[in] setup   Setup packet
+ * @param[inout] data IN: Buffer of wLength bytes to fill. OUT: Data stage sent by the host
+ * @param[inout] length IN: Bytes returned by the device, wLength on entry. OUT: wLength
+ * @param[in] arg     User argument
+ * @return
+ *   - ESP_OK:                 Request is acknowledged
+ *   - ESP_ERR_NOT_SUPPORTED:  Request is handled by the simulator: Standard requests are answered from the descriptors,
+ *                             other requests are stalled
+ *   - Else:                   Request is stalled
+ */
+typedef esp_err_t (*usb_host_sim_ctrl_cb_t)(usb_host_sim_device_hdl_t dev, const usb_setup_packet_t *setup, uint8_t *data,
+        size_t *length, void *arg);
+
+/**
+ * @brief Timing model of the simulated bus
+ *
+ * Time is simulated and advances only in usb_host_sim_advance() and usb_host_sim_run(). Periodic (ISOC, interrupt) packets
+ * are scheduled first in every (micro)frame, control and bulk packets take the rest of the frame budget.
+ */
+typedef struct {
+    usb_speed_t speed;                  /**< Speed of the root port, frames of 1 ms (Full-speed) or microframes of 125 us (High-speed) */
+    uint32_t frame_bytes;               /**< Bytes transferred in one (micro)frame. 0: 1216 for Full-speed, 6656 for High-speed,
+                                             e.g. 19 bulk packets of 64 B or 13 of 512 B */
+    uint32_t submit_latency_us;         /**< Time from submit until the transfer can be scheduled on the bus */
+    uint32_t completion_latency_us;     /**< Time from the end of the transfer on the bus until its completion can be handled,
+                                             models interrupt and task wake-up latency */
+    uint32_t control_us;                /**< Bus time of setup and status stage of one control transfer */
+    bool control_on_bus;                /**< Control transfers are scheduled on the bus and complete in usb_host_client_handle_events().
+                                             By default they complete inside usb_host_transfer_submit_control(), so drivers waiting
+                                             for them can run without background task */
+} usb_host_sim_config_t;
+
+#define USB_HOST_SIM_CONFIG_DEFAULT() { \
+    .speed = USB_SPEED_FULL,            \
+    .frame_bytes = 0,                   \
+    .submit_latency_us = 20,            \
+    .completion_latency_us = 50,        \
+    .control_us = 100,                  \
+    .control_on_bus = false,            \
+}
+
+/**
+ * @brief Description of a simulated device
+ *
+ * Descriptors are referenced, they must be valid while the device is connected.
+ */
+typedef struct {
+    const usb_device_desc_t *dev_desc;  /**< Device descriptor */
+    const usb_config_desc_t *config_desc; /**< Active configuration descriptor */
+    usb_speed_t speed;                  /**< Device speed, reported by usb_host_device_info() */
+    usb_host_sim_ctrl_cb_t ctrl_cb;     /**< Control request callback. NULL: Simulator handles all requests */
+    void *ctrl_arg;                     /**< Argument of ctrl_cb */
+} usb_host_sim_device_config_t;
+
+/**
+ * @brief Statistics of one endpoint
+ */
+typedef struct {
+    uint64_t bytes;                     /**< Bytes transferred */
+    uint32_t transfers;                 /**< Transfers completed */
+    uint32_t packets;                   /**< Packets transferred */
+    uint32_t naks;                      /**< Packets NAKed by the device */
+    uint32_t packets_lost;              /**< ISOC IN packets sent by the device while no transfer was submitted */
+    uint64_t latency_sum_us;            /**< Sum of times from submit to callback */
+    uint32_t latency_max_us;            /**< Longest time from submit to callback */
+} usb_host_sim_ep_stats_t;
+
+/**
+ * @brief Statistics of the simulator
+ */
+typedef struct {
+    uint64_t time_us;                   /**< Simulated time */
+    uint32_t transfers_allocated;       /**< Transfers currently allocated */
+    uint32_t transfers_peak;            /**< Highest number of allocated transfers */
+    size_t transfer_bytes;              /**< Bytes of data buffers of allocated transfers */
+    size_t transfer_bytes_peak;         /**< Highest bytes of data buffers of allocated transfers */
+    uint32_t transfer_allocs;           /**< Calls of usb_host_transfer_alloc() */
+    uint32_t frames_overcommitted;      /**< (Micro)frames whose periodic packets did not fit in frame_bytes */
+    bool suspended;                     /**< Root port is suspended */
+} usb_host_sim_stats_t;
+
+/**
+ * @brief Recorded packet of an endpoint
+ */
+typedef struct {
+    uint32_t time_us;                   /**< Bus time from start of playback, when the device has the packet ready */
+    uint16_t length;                    /**< Length of the packet */
+    usb_transfer_status_t status;       /**< Status of the packet, e.g. USB_TRANSFER_STATUS_ERROR for corrupted ISOC packet */
+    const uint8_t *data;                /**< Data of the packet. NULL: Zeros */
+} usb_host_sim_packet_t;
+
+/**
+ * @brief Install the simulator
+ *
+ * The USB Host Library functions of the CMock usb component are stubbed by the simulator, so class drivers
+ * run on Linux against simulated devices. The simulator is not a mock: Calls are not expected or verified.
+ *
+ * @param[in] config Timing model, NULL for defaults
+ * @return
+ *   - ESP_OK:                 Installed
+ *   - ESP_ERR_INVALID_STATE:  Already installed
+ *   - ESP_ERR_NO_MEM:         Not enough memory
+ */
+esp_err_t usb_host_sim_install(const usb_host_sim_config_t *config);
+
+/**
+ * @brief Uninstall the simulator
+ *
+ * Remaining devices are removed without events. Transfers still allocated by drivers are leaked and counted in statistics.
+ *
+ * @return
+ *   - ESP_OK:                 Uninstalled
+ *   - ESP_ERR_INVALID_STATE:  Not installed
+ */
+esp_err_t usb_host_sim_uninstall(void);
+
+/**
+ * @brief Connect a simulated device
+ *
+ * New device event is delivered to all registered clients in usb_host_client_handle_events().
+ *
+ * @param[in] config     Device
+ * @param[out] dev_ret   Device handle, also the usb_device_handle_t of opened device
+ * @return
+ *   - ESP_OK:                 Connected
+ *   - ESP_ERR_INVALID_ARG:    Invalid configuration
+ *   - ESP_ERR_INVALID_STATE:  Not installed
+ *   - ESP_ERR_NO_MEM:         USB_HOST_SIM_DEVICES_MAX devices connected or not enough memory
+ */
+esp_err_t usb_host_sim_device_connect(const usb_host_sim_device_config_t *config, usb_host_sim_device_hdl_t *dev_ret);
+
+/**
+ * @brief Disconnect a simulated device
+ *
+ * Transfers in flight complete with USB_TRANSFER_STATUS_NO_DEVICE and device gone event is delivered to the clients
+ * that opened the device. The device is freed when all clients have closed it.
+ *
+ * @param[in] dev Device
+ * @return
+ *   - ESP_OK:                 Disconnected
+ *   - ESP_ERR_INVALID_ARG:    dev is NULL or already disconnected
+ */
+esp_err_t usb_host_sim_device_disconnect(usb_host_sim_device_hdl_t dev);
+
+/**
+ * @brief Get address of a simulated device
+ *
+ * @param[in] dev Device
+ * @return Device address, 0 for NULL
+ */
+uint8_t usb_host_sim_device_get_addr(usb_host_sim_device_hdl_t dev);
+
+/**
+ * @brief Set callback of an endpoint
+ *
+ * Endpoints without callback NAK all packets. The endpoint must be in the configuration descriptor.
+ *
+ * @param[in] dev              Device
+ * @param[in] bEndpointAddress Endpoint address
+ * @param[in] cb               Callback, NULL to remove
+ * @param[in] arg              Argument of the callback
+ * @return
+ *   - ESP_OK:                 Set
+ *   - ESP_ERR_INVALID_ARG:    dev is NULL
+ *   - ESP_ERR_NOT_FOUND:      Endpoint is not in the configuration descriptor
+ */
+esp_err_t usb_host_sim_endpoint_set_cb(usb_host_sim_device_hdl_t dev, uint8_t bEndpointAddress, usb_host_sim_ep_cb_t cb, void *arg);
+
+/**
+ * @brief Play recorded packets on an IN endpoint
+ *
+ * Replaces the endpoint callback. A packet is sent once the bus time from the start of playback reaches its time_us,
+ * before that, Bulk and interrupt endpoints NAK and ISOC endpoints send zero-length packets.
+ * The packets are referenced, they must be valid during playback.
+ *
+ * @param[in] dev              Device
+ * @param[in] bEndpointAddress IN endpoint address
+ * @param[in] packets          Recorded packets, sorted by time
+ * @param[in] num_packets      Number of packets
+ * @param[in] loop             Restart playback after the last packet, with time shifted by the time of the last packet
+ * @return
+ *   - ESP_OK:                 Playback started
+ *   - ESP_ERR_INVALID_ARG:    Invalid argument or OUT endpoint
+ *   - ESP_ERR_NOT_FOUND:      Endpoint is not in the configuration descriptor
+ */
+esp_err_t usb_host_sim_endpoint_playback(usb_host_sim_device_hdl_t dev, uint8_t bEndpointAddress,
+        const usb_host_sim_packet_t *packets, size_t num_packets, bool loop);
+
+/**
+ * @brief Load a recording of packets from file
+ *
+ * The file is a sequence of little-endian records, one record per packet:
+ * - uint32_t time_us: Bus time from start of the recording
+ * - uint16_t length:  Length of the packet
+ * - uint8_t  status:  usb_transfer_status_t
+ * - data:             length bytes
+ *
+ * @param[in] path             Path to the recording
+ * @param[out] packets_ret     Packets, free them with usb_host_sim_recording_free()
+ * @param[out] num_packets_ret Number of packets
+ * @return
+ *   - ESP_OK:                 Loaded
+ *   - ESP_ERR_INVALID_ARG:    Invalid argument
+ *   - ESP_ERR_NOT_FOUND:      File cannot be opened
+ *   - ESP_ERR_INVALID_SIZE:   File is truncated
+ *   - ESP_ERR_NO_MEM:         Not enough memory
+ */
+esp_err_t usb_host_sim_recording_load(const char *path, usb_host_sim_packet_t **packets_ret, size_t *num_packets_ret);
+
+/**
+ * @brief Free a recording loaded by usb_host_sim_recording_load()
+ *
+ * @param[in] packets     Packets
+ * @param[in] num_packets Number of packets
+ */
+void usb_host_sim_recording_free(usb_host_sim_packet_t *packets, size_t num_packets);
+
+/**
+ * @brief Advance simulated time
+ *
+ * Packets of all (micro)frames in the time are transferred, completed transfers become ready for the clients.
+ * Transfer callbacks and client events are called in usb_host_client_handle_events() of their client,
+ * e.g. from handle events function of a class driver installed without background task.
+ *
+ * @param[in] time_us Time to advance in microseconds, rounded up to whole (micro)frames
+ */
+void usb_host_sim_advance(uint32_t time_us);
+
+/**
+ * @brief Pump called after every (micro)frame by usb_host_sim_run()
+ *
+ * @param[in] arg User argument
+ */
+typedef void (*usb_host_sim_pump_t)(void *arg);
+
+/**
+ * @brief Advance simulated time frame by frame and handle events after every (micro)frame
+ *
+ * @param[in] time_us Time to run in microseconds, rounded up to whole (micro)frames
+ * @param[in] pump    Called after every (micro)frame, e.g. to call class driver handle events function. NULL: Events of all
+ *                    clients are handled by usb_host_client_handle_events()
+ * @param[in] arg     Argument of pump
+ */
+void usb_host_sim_run(uint32_t time_us, usb_host_sim_pump_t pump, void *arg);
+
+/**
+ * @brief Get simulated time
+ *
+ * @return Time in microseconds since install
+ */
+uint64_t usb_host_sim_get_time_us(void);
+
+/**
+ * @brief Get statistics of an endpoint
+ *
+ * @param[in] dev              Device
+ * @param[in] bEndpointAddress Endpoint address, 0 for the default control pipe
+ * @param[out] stats           Statistics
+ * @return
+ *   - ESP_OK:                 Success
+ *   - ESP_ERR_INVALID_ARG:    Invalid argument
+ *   - ESP_ERR_NOT_FOUND:      Endpoint is not in the configuration descriptor
+ */
+esp_err_t usb_host_sim_endpoint_get_stats(usb_host_sim_device_hdl_t dev, uint8_t bEndpointAddress, usb_host_sim_ep_stats_t *stats);
+
+/**
+ * @brief Get statistics of the simulator
+ *
+ * @param[out] stats Statistics
+ * @return
+ *   - ESP_OK:                 Success
+ *   - ESP_ERR_INVALID_ARG:    stats is NULL
+ *   - ESP_ERR_INVALID_STATE:  Not installed
+ */
+esp_err_t usb_host_sim_get_stats(usb_host_sim_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,1333 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/queue.h>
+#include <sys/param.h> // For MIN, MAX
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_idf_version.h"
+#include "usb/usb_host.h"
+#include "usb/usb_host_sim.h"
+#include "Mockusb_host.h"
+
+static const char *TAG = "usb_host_sim";
+
+#define SIM_FRAME_US_FS         (1000)
+#define SIM_FRAME_US_HS         (125)
+#define SIM_FRAME_BYTES_FS      (1216)
+#define SIM_FRAME_BYTES_HS      (6656)
+#define SIM_CLIENT_EVENTS_MAX   (16)
+#define SIM_SETUP_SIZE          (sizeof(usb_setup_packet_t))
+#define SIM_ROOT_PORT_SUSPEND   (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(6, 0, 0))
+
+typedef struct sim_ep_s sim_ep_t;
+typedef struct sim_client_s sim_client_t;
+
+/**
+ * @brief Transfer allocated by the simulator
+ *
+ * The transfer must be the last member, it ends with flexible array of ISOC packet descriptors.
+ */
+typedef struct sim_xfer_s {
+    TAILQ_ENTRY(sim_xfer_s) tailq;              // Entry of endpoint queue, done list or client ready list
+    sim_ep_t *ep;                               // Endpoint of the transfer in flight
+    sim_client_t *client;                       // Client receiving the completion
+    uint64_t submit_us;                         // Time of submit
+    uint64_t ready_us;                          // Time from which the transfer can be scheduled
+    uint64_t complete_us;                       // Time from which the completion can be handled
+    size_t offset;                              // Bytes transferred so far
+    int packet_idx;                             // ISOC: Next packet
+    bool in_flight;
+    bool zlp_sent;                              // OUT: Zero-length packet after the last full packet was sent
+    usb_transfer_t xfer;
+} sim_xfer_t;
+
+TAILQ_HEAD(sim_xfer_list, sim_xfer_s);
+
+struct sim_ep_s {
+    const usb_ep_desc_t *desc;                  // Descriptor of the claimed alternate, NULL for the default control pipe
+    usb_host_sim_device_hdl_t dev;
+    sim_client_t *client;                       // Client that claimed the interface of the endpoint
+    uint8_t addr;
+    uint8_t bInterfaceNumber;
+    bool halted;
+    bool nak_in_frame;                          // Bulk: NAKed in the current frame, do not poll it again
+    usb_host_sim_ep_cb_t cb;
+    void *cb_arg;
+    const usb_host_sim_packet_t *packets;       // Playback
+    size_t num_packets;
+    size_t packet_idx;
+    uint64_t playback_start_us;
+    bool playback_loop;
+    struct sim_xfer_list queue;                 // Transfers in flight, in submit order
+    usb_host_sim_ep_stats_t stats;
+};
+
+struct usb_host_sim_device_s {
+    usb_host_sim_device_config_t cfg;
+    uint8_t addr;
+    bool connected;
+    uint32_t open_mask;                         // Clients that opened the device
+    int in_flight;                              // Transfers not yet delivered to clients
+    sim_ep_t ep0;
+    sim_ep_t eps[USB_HOST_SIM_ENDPOINTS_MAX];
+    int num_eps;
+    uint8_t cur_alt[USB_HOST_SIM_ENDPOINTS_MAX]; // Alternate setting selected by SET_INTERFACE, per interface number
+};
+
+struct sim_client_s {
+    bool used;
+    usb_host_client_config_t cfg;
+    struct sim_xfer_list ready;                 // Completed transfers, callbacks are called in handle events
+    usb_host_client_event_msg_t events[SIM_CLIENT_EVENTS_MAX];
+    int event_head;
+    int num_events;
+};
+
+typedef struct {
+    usb_host_sim_config_t cfg;
+    uint32_t frame_us;
+    uint64_t frame;                             // Index of the next (micro)frame
+    uint64_t now_us;                            // Start of the next (micro)frame
+    usb_host_sim_device_hdl_t devs[USB_HOST_SIM_DEVICES_MAX];
+    sim_client_t clients[USB_HOST_SIM_CLIENTS_MAX];
+    struct sim_xfer_list done;                  // Completed transfers waiting for completion latency
+    uint8_t next_addr;
+    int bulk_rr;                                // Round robin index of bulk scheduling
+    bool suspended;                             // Root port is suspended, no packets are sent
+    usb_host_sim_stats_t stats;
+} usb_host_sim_t;
+
+static pthread_mutex_t sim_lock;
+static usb_host_sim_t *s_sim = NULL;
+
+#define SIM_ENTER() pthread_mutex_lock(&sim_lock)
+#define SIM_EXIT()  pthread_mutex_unlock(&sim_lock)
+#define XFER_OBJ(transfer) ((sim_xfer_t *)((uint8_t *)(transfer) - offsetof(sim_xfer_t, xfer)))
+#define CLIENT_HDL(client) ((usb_host_client_handle_t)(client))
+#define CLIENT_OBJ(hdl)    ((sim_client_t *)(hdl))
+#define DEV_HDL(dev)       ((usb_device_handle_t)(dev))
+#define DEV_OBJ(hdl)       ((usb_host_sim_device_hdl_t)(hdl))
+
+// ---------------------------------------------------------------- Descriptors ----------------------------------------
+
+/**
+ * @brief Walk the configuration descriptor
+ *
+ * @param[in] config_desc Configuration descriptor
+ * @param[inout] offset   Offset of the current descriptor, moved to the next one
+ * @return Next descriptor, NULL at the end
+ */
+static const usb_standard_desc_t *sim_desc_next(const usb_config_desc_t *config_desc, int *offset)
+{
+    const uint8_t *p = (const uint8_t *)config_desc;
+    const usb_standard_desc_t *desc = (const usb_standard_desc_t *)(p + *offset);
+    if (desc->bLength == 0) {
+        return NULL; // Malformed descriptor, stop walking
+    }
+    *offset += desc->bLength;
+    if (*offset + 2 > config_desc->wTotalLength) {
+        return NULL;
+    }
+    desc = (const usb_standard_desc_t *)(p + *offset);
+    return (*offset + desc->bLength <= config_desc->wTotalLength) ? desc : NULL;
+}
+
+static sim_ep_t *sim_ep_find(usb_host_sim_device_hdl_t dev, uint8_t bEndpointAddress)
+{
+    if ((bEndpointAddress & 0x7F) == 0) {
+        return &dev->ep0;
+    }
+    for (int i = 0; i < dev->num_eps; i++) {
+        if (dev->eps[i].addr == bEndpointAddress) {
+            return &dev->eps[i];
+        }
+    }
+    return NULL;
+}
+
+static void sim_ep_init(sim_ep_t *ep, usb_host_sim_device_hdl_t dev, uint8_t addr, const usb_ep_desc_t *desc, uint8_t bInterfaceNumber)
+{
+    memset(ep, 0, sizeof(sim_ep_t));
+    ep->dev = dev;
+    ep->addr = addr;
+    ep->desc = desc;
+    ep->bInterfaceNumber = bInterfaceNumber;
+    TAILQ_INIT(&ep->queue);
+}
+
+/**
+ * @brief Register all endpoints of the configuration, each with the descriptor of its first alternate
+ */
+static esp_err_t sim_device_parse_eps(usb_host_sim_device_hdl_t dev)
+{
+    const usb_config_desc_t *config_desc = dev->cfg.config_desc;
+    int offset = 0;
+    uint8_t bInterfaceNumber = 0;
+    for (const usb_standard_desc_t *desc = sim_desc_next(config_desc, &offset); desc; desc = sim_desc_next(config_desc, &offset)) {
+        if (desc->bDescriptorType == USB_B_DESCRIPTOR_TYPE_INTERFACE) {
+            bInterfaceNumber = ((const usb_intf_desc_t *)desc)->bInterfaceNumber;
+        } else if (desc->bDescriptorType == USB_B_DESCRIPTOR_TYPE_ENDPOINT) {
+            const usb_ep_desc_t *ep_desc = (const usb_ep_desc_t *)desc;
+            if (sim_ep_find(dev, ep_desc->bEndpointAddress)) {
+                continue; // Registered by previous alternate
+            }
+            ESP_RETURN_ON_FALSE(dev->num_eps < USB_HOST_SIM_ENDPOINTS_MAX, ESP_ERR_NO_MEM, TAG, "Too many endpoints");
+            sim_ep_init(&dev->eps[dev->num_eps++], dev, ep_desc->bEndpointAddress, ep_desc, bInterfaceNumber);
+        }
+    }
+    return ESP_OK;
+}
+
+// ---------------------------------------------------------------- Completion -----------------------------------------
+
+/**
+ * @brief Finish transfer, its completion is handled after completion latency
+ */
+static void sim_xfer_complete(sim_xfer_t *obj, usb_transfer_status_t status, uint64_t end_us)
+{
+    sim_ep_t *ep = obj->ep;
+    usb_transfer_t *transfer = &obj->xfer;
+    if (transfer->num_isoc_packets == 0) {
+        transfer->actual_num_bytes = obj->offset;
+    }
+    transfer->status = status;
+    obj->complete_us = end_us + s_sim->cfg.completion_latency_us;
+    TAILQ_REMOVE(&ep->queue, obj, tailq);
+    TAILQ_INSERT_TAIL(&s_sim->done, obj, tailq);
+    ep->stats.transfers++;
+    ep->stats.bytes += transfer->actual_num_bytes;
+}
+
+/**
+ * @brief Move transfers whose completion latency elapsed to their clients
+ */
+static void sim_done_release(void)
+{
+    sim_xfer_t *obj;
+    while ((obj = TAILQ_FIRST(&s_sim->done)) && obj->complete_us <= s_sim->now_us) {
+        TAILQ_REMOVE(&s_sim->done, obj, tailq);
+        TAILQ_INSERT_TAIL(&obj->client->ready, obj, tailq);
+    }
+}
+
+static void sim_ep_cancel_all(sim_ep_t *ep, usb_transfer_status_t status)
+{
+    sim_xfer_t *obj;
+    while ((obj = TAILQ_FIRST(&ep->queue))) {
+        if (obj->xfer.num_isoc_packets > 0) {
+            // Packets that were not transferred yet get the status too
+            for (int i = obj->packet_idx; i < obj->xfer.num_isoc_packets; i++) {
+                obj->xfer.isoc_packet_desc[i].actual_num_bytes = 0;
+                obj->xfer.isoc_packet_desc[i].status = status;
+            }
+        }
+        sim_xfer_complete(obj, status, s_sim->now_us);
+        obj->complete_us = s_sim->now_us;
+    }
+}
+
+static void sim_client_push_event(sim_client_t *client, const usb_host_client_event_msg_t *msg)
+{
+    if (client->num_events == SIM_CLIENT_EVENTS_MAX) {
+        ESP_LOGW(TAG, "Client event queue full, event dropped");
+        return;
+    }
+    client->events[(client->event_head + client->num_events) % SIM_CLIENT_EVENTS_MAX] = *msg;
+    client->num_events++;
+}
+
+static void sim_device_try_free(usb_host_sim_device_hdl_t dev)
+{
+    if (dev->connected || dev->open_mask || dev->in_flight) {
+        return;
+    }
+    for (int i = 0; i < USB_HOST_SIM_DEVICES_MAX; i++) {
+        if (s_sim->devs[i] == dev) {
+            s_sim->devs[i] = NULL;
+        }
+    }
+    free(dev);
+}
+
+// ---------------------------------------------------------------- Device side ----------------------------------------
+
+/**
+ * @brief Get IN packet from the device
+ *
+ * @param[in] ep       Endpoint
+ * @param[out] data    Buffer, NULL to drop the packet
+ * @param[in] length   Maximum length of the packet
+ * @param[out] status  Status of the packet
+ * @return Bytes of the packet or USB_HOST_SIM_NAK
+ */
+static int sim_ep_in(sim_ep_t *ep, uint8_t *data, size_t length, usb_transfer_status_t *status)
+{
+    *status = USB_TRANSFER_STATUS_COMPLETED;
+    if (ep->packets) {
+        if (ep->packet_idx == ep->num_packets) {
+            return USB_HOST_SIM_NAK; // Playback finished
+        }
+        const usb_host_sim_packet_t *pkt = &ep->packets[ep->packet_idx];
+        if (s_sim->now_us < ep->playback_start_us + pkt->time_us) {
+            return USB_HOST_SIM_NAK; // The device does not have the packet yet
+        }
+        const size_t len = MIN(length, pkt->length);
+        if (data) {
+            if (pkt->data) {
+                memcpy(data, pkt->data, len);
+            } else {
+                memset(data, 0, len);
+            }
+        }
+        *status = pkt->status;
+        if (++ep->packet_idx == ep->num_packets && ep->playback_loop) {
+            ep->packet_idx = 0;
+            ep->playback_start_us += ep->packets[ep->num_packets - 1].time_us;
+        }
+        return len;
+    }
+    if (ep->cb) {
+        const int ret = ep->cb(ep->dev, ep->addr, data, length, s_sim->now_us, ep->cb_arg);
+        return (ret == USB_HOST_SIM_NAK) ? USB_HOST_SIM_NAK : (int)MIN((size_t)MAX(ret, 0), length);
+    }
+    return USB_HOST_SIM_NAK;
+}
+
+static int sim_ep_out(sim_ep_t *ep, uint8_t *data, size_t length)
+{
+    if (ep->cb) {
+        return ep->cb(ep->dev, ep->addr, data, length, s_sim->now_us, ep->cb_arg);
+    }
+    return USB_HOST_SIM_NAK;
+}
+
+/**
+ * @brief Answer control request
+ *
+ * @param[in] dev      Device
+ * @param[inout] obj   Control transfer, setup packet followed by data stage
+ * @return Transfer status
+ */
+static usb_transfer_status_t sim_control_process(usb_host_sim_device_hdl_t dev, sim_xfer_t *obj)
+{
+    usb_transfer_t *transfer = &obj->xfer;
+    const usb_setup_packet_t *setup = (const usb_setup_packet_t *)transfer->data_buffer;
+    uint8_t *data = transfer->data_buffer + SIM_SETUP_SIZE;
+    const bool in = (setup->bmRequestType & USB_BM_REQUEST_TYPE_DIR_IN);
+    size_t length = MIN(setup->wLength, transfer->num_bytes - SIM_SETUP_SIZE);
+    obj->offset = SIM_SETUP_SIZE;
+
+    if (dev->cfg.ctrl_cb) {
+        const esp_err_t ret = dev->cfg.ctrl_cb(dev, setup, data, &length, dev->cfg.ctrl_arg);
+        if (ret == ESP_OK) {
+            obj->offset += in ? MIN(length, setup->wLength) : setup->wLength;
+            return USB_TRANSFER_STATUS_COMPLETED;
+        } else if (ret != ESP_ERR_NOT_SUPPORTED) {
+            return USB_TRANSFER_STATUS_STALL;
+        }
+    }
+
+    if ((setup->bmRequestType & USB_BM_REQUEST_TYPE_TYPE_MASK) != USB_BM_REQUEST_TYPE_TYPE_STANDARD) {
+        return USB_TRANSFER_STATUS_STALL; // Class and vendor requests must be answered by ctrl_cb
+    }
+    const void *src = NULL;
+    size_t src_len = 0;
+    uint8_t value;
+    switch (setup->bRequest) {
+    case USB_B_REQUEST_GET_DESCRIPTOR:
+        if ((setup->wValue >> 8) == USB_B_DESCRIPTOR_TYPE_DEVICE) {
+            src = dev->cfg.dev_desc;
+            src_len = sizeof(usb_device_desc_t);
+        } else if ((setup->wValue >> 8) == USB_B_DESCRIPTOR_TYPE_CONFIGURATION) {
+            src = dev->cfg.config_desc;
+            src_len = dev->cfg.config_desc->wTotalLength;
+        } else {
+            return USB_TRANSFER_STATUS_STALL; // Strings and other descriptors are not simulated
+        }
+        break;
+    case USB_B_REQUEST_GET_STATUS:
+        memset(data, 0, MIN(length, 2));
+        obj->offset += MIN(length, 2);
+        return USB_TRANSFER_STATUS_COMPLETED;
+    case USB_B_REQUEST_GET_CONFIGURATION:
+        value = dev->cfg.config_desc->bConfigurationValue;
+        src = &value;
+        src_len = 1;
+        break;
+    case USB_B_REQUEST_GET_INTERFACE:
+        value = (setup->wIndex < USB_HOST_SIM_ENDPOINTS_MAX) ? dev->cur_alt[setup->wIndex] : 0;
+        src = &value;
+        src_len = 1;
+        break;
+    case USB_B_REQUEST_SET_INTERFACE:
+        if (setup->wIndex < USB_HOST_SIM_ENDPOINTS_MAX) {
+            dev->cur_alt[setup->wIndex] = setup->wValue;
+        }
+        return USB_TRANSFER_STATUS_COMPLETED;
+    case USB_B_REQUEST_SET_CONFIGURATION:
+    case USB_B_REQUEST_SET_FEATURE:
+    case USB_B_REQUEST_CLEAR_FEATURE:
+        return USB_TRANSFER_STATUS_COMPLETED;
+    default:
+        return USB_TRANSFER_STATUS_STALL;
+    }
+    const size_t len = MIN(length, src_len);
+    memcpy(data, src, len);
+    obj->offset += len;
+    return USB_TRANSFER_STATUS_COMPLETED;
+}
+
+// ---------------------------------------------------------------- Bus scheduling -------------------------------------
+
+static inline bool sim_ep_is_isoc(const sim_ep_t *ep)
+{
+    return ep->desc && USB_EP_DESC_GET_XFERTYPE(ep->desc) == USB_BM_ATTRIBUTES_XFER_ISOC;
+}
+
+static inline bool sim_ep_is_int(const sim_ep_t *ep)
+{
+    return ep->desc && USB_EP_DESC_GET_XFERTYPE(ep->desc) == USB_BM_ATTRIBUTES_XFER_INT;
+}
+
+/**
+ * @brief Get payload of one service interval: MPS * transactions per microframe of high-bandwidth endpoints
+ */
+static inline size_t sim_ep_payload(const sim_ep_t *ep)
+{
+    const size_t mps = USB_EP_DESC_GET_MPS(ep->desc);
+    return mps * (((ep->desc->wMaxPacketSize >> 11) & 0x3) + 1);
+}
+
+/**
+ * @brief Get service interval of a periodic endpoint in (micro)frames
+ */
+static uint32_t sim_ep_interval(const sim_ep_t *ep)
+{
+    const uint8_t bInterval = MAX(ep->desc->bInterval, 1);
+    if (!sim_ep_is_isoc(ep) && s_sim->cfg.speed != USB_SPEED_HIGH) {
+        return bInterval; // Full-speed interrupt endpoints are polled every bInterval frames
+    }
+    return 1UL << MIN(bInterval - 1, 15);
+}
+
+/**
+ * @brief Head transfer of the endpoint that can be scheduled now
+ */
+static sim_xfer_t *sim_ep_head(sim_ep_t *ep)
+{
+    sim_xfer_t *obj = TAILQ_FIRST(&ep->queue);
+    if (ep->halted || !obj || obj->ready_us > s_sim->now_us) {
+        return NULL;
+    }
+    return obj;
+}
+
+/**
+ * @brief Transfer one ISOC packet of a service interval
+ *
+ * @return Bytes on the bus
+ */
+static size_t sim_isoc_service(sim_ep_t *ep, uint64_t end_us)
+{
+    const bool in = (ep->addr & USB_B_ENDPOINT_ADDRESS_EP_DIR_MASK);
+    const size_t payload = sim_ep_payload(ep);
+    sim_xfer_t *obj = sim_ep_head(ep);
+    usb_transfer_status_t status;
+    if (!obj) {
+        // The device sends the packet anyway, nobody receives it
+        if (in && sim_ep_in(ep, NULL, payload, &status) > 0) {
+            ep->stats.packets_lost++;
+        }
+        return 0;
+    }
+
+    usb_transfer_t *transfer = &obj->xfer;
+    usb_isoc_packet_desc_t *packet = &transfer->isoc_packet_desc[obj->packet_idx];
+    const size_t length = MIN((size_t)packet->num_bytes, payload);
+    int ret;
+    if (in) {
+        ret = sim_ep_in(ep, transfer->data_buffer + obj->offset, length, &status);
+    } else {
+        ret = sim_ep_out(ep, transfer->data_buffer + obj->offset, length);
+        status = USB_TRANSFER_STATUS_COMPLETED;
+    }
+    if (ret == USB_HOST_SIM_NAK) {
+        ret = in ? 0 : length; // ISOC has no handshake: IN gets zero-length packet, OUT data are sent anyway
+    }
+    packet->actual_num_bytes = ret;
+    packet->status = status;
+    transfer->actual_num_bytes += ret;
+    obj->offset += packet->num_bytes;
+    ep->stats.packets++;
+    if (++obj->packet_idx == transfer->num_isoc_packets) {
+        sim_xfer_complete(obj, USB_TRANSFER_STATUS_COMPLETED, end_us);
+    }
+    return ret;
+}
+
+/**
+ * @brief Transfer one packet of an interrupt or bulk endpoint
+ *
+ * @param[in] ep        Endpoint
+ * @param[in] mps       Maximum packet size
+ * @param[in] end_us    End of the current (micro)frame
+ * @return Bytes on the bus, 0 if the packet was NAKed
+ */
+static size_t sim_packet_service(sim_ep_t *ep, size_t mps, uint64_t end_us)
+{
+    const bool in = (ep->addr & USB_B_ENDPOINT_ADDRESS_EP_DIR_MASK);
+    sim_xfer_t *obj = sim_ep_head(ep);
+    usb_transfer_t *transfer = &obj->xfer;
+    const size_t remaining = transfer->num_bytes - obj->offset;
+    const size_t length = MIN(remaining, mps);
+    usb_transfer_status_t status = USB_TRANSFER_STATUS_COMPLETED;
+    int ret;
+    if (in) {
+        ret = sim_ep_in(ep, transfer->data_buffer + obj->offset, length, &status);
+    } else {
+        ret = sim_ep_out(ep, transfer->data_buffer + obj->offset, length);
+        ret = (ret == USB_HOST_SIM_NAK) ? USB_HOST_SIM_NAK : (int)length;
+    }
+    if (ret == USB_HOST_SIM_NAK) {
+        ep->stats.naks++;
+        ep->nak_in_frame = true;
+        return 0;
+    }
+
+    ep->stats.packets++;
+    obj->offset += ret;
+    bool done;
+    if (in) {
+        // IN transfer ends with short packet or when the buffer is full
+        done = ((size_t)ret < mps) || (obj->offset >= (size_t)transfer->num_bytes);
+    } else if (obj->offset < (size_t)transfer->num_bytes) {
+        done = false;
+    } else if ((transfer->flags & USB_TRANSFER_FLAG_ZERO_PACK) && length == mps && transfer->num_bytes > 0 && !obj->zlp_sent) {
+        obj->zlp_sent = true; // Zero-length packet follows in the next poll
+        done = false;
+    } else {
+        done = true;
+    }
+    if (done || status != USB_TRANSFER_STATUS_COMPLETED) {
+        sim_xfer_complete(obj, status, end_us);
+    }
+    return MAX(ret, 1); // Zero-length packet takes bus time too
+}
+
+static void sim_control_service(usb_host_sim_device_hdl_t dev, sim_xfer_t *obj, uint64_t end_us)
+{
+    const usb_transfer_status_t status = sim_control_process(dev, obj);
+    dev->ep0.stats.packets++;
+    sim_xfer_complete(obj, status, end_us + s_sim->cfg.control_us);
+}
+
+/**
+ * @brief Transfer all packets of one (micro)frame
+ */
+static void sim_frame(void)
+{
+    const uint64_t end_us = s_sim->now_us + s_sim->frame_us;
+    int64_t budget = s_sim->cfg.frame_bytes;
+    if (s_sim->suspended) {
+        // No SOFs and no packets, only the time passes
+        s_sim->frame++;
+        s_sim->now_us = end_us;
+        sim_done_release();
+        return;
+    }
+
+    // Periodic endpoints first
+    for (int d = 0; d < USB_HOST_SIM_DEVICES_MAX; d++) {
+        usb_host_sim_device_hdl_t dev = s_sim->devs[d];
+        if (!dev || !dev->connected) {
+            continue;
+        }
+        for (int i = 0; i < dev->num_eps; i++) {
+            sim_ep_t *ep = &dev->eps[i];
+            ep->nak_in_frame = false;
+            if (!(sim_ep_is_isoc(ep) || sim_ep_is_int(ep)) || (s_sim->frame % sim_ep_interval(ep)) != 0) {
+                continue;
+            }
+            if (sim_ep_is_isoc(ep)) {
+                budget -= sim_isoc_service(ep, end_us);
+            } else if (sim_ep_head(ep)) {
+                budget -= sim_packet_service(ep, sim_ep_payload(ep), end_us);
+            }
+        }
+    }
+    if (budget < 0) {
+        s_sim->stats.frames_overcommitted++;
+    }
+
+    // Control transfers, one per device and frame
+    for (int d = 0; d < USB_HOST_SIM_DEVICES_MAX && budget > 0; d++) {
+        usb_host_sim_device_hdl_t dev = s_sim->devs[d];
+        sim_xfer_t *obj = (dev && dev->connected) ? sim_ep_head(&dev->ep0) : NULL;
+        if (obj) {
+            budget -= obj->xfer.num_bytes;
+            sim_control_service(dev, obj, end_us);
+        }
+    }
+
+    // Bulk endpoints share the rest of the frame, one packet per endpoint in round robin
+    bool progress = true;
+    while (budget > 0 && progress) {
+        progress = false;
+        for (int n = 0; n < USB_HOST_SIM_DEVICES_MAX * USB_HOST_SIM_ENDPOINTS_MAX && budget > 0; n++) {
+            const int idx = (s_sim->bulk_rr + n) % (USB_HOST_SIM_DEVICES_MAX * USB_HOST_SIM_ENDPOINTS_MAX);
+            usb_host_sim_device_hdl_t dev = s_sim->devs[idx / USB_HOST_SIM_ENDPOINTS_MAX];
+            if (!dev || !dev->connected || idx % USB_HOST_SIM_ENDPOINTS_MAX >= dev->num_eps) {
+                continue;
+            }
+            sim_ep_t *ep = &dev->eps[idx % USB_HOST_SIM_ENDPOINTS_MAX];
+            if (!ep->desc || USB_EP_DESC_GET_XFERTYPE(ep->desc) != USB_BM_ATTRIBUTES_XFER_BULK || ep->nak_in_frame || !sim_ep_head(ep)) {
+                continue;
+            }
+            const size_t mps = USB_EP_DESC_GET_MPS(ep->desc);
+            if ((int64_t)mps > budget && TAILQ_FIRST(&ep->queue)->xfer.num_bytes - TAILQ_FIRST(&ep->queue)->offset >= mps) {
+                budget = 0; // Full packet does not fit in this frame
+                break;
+            }
+            const size_t bytes = sim_packet_service(ep, mps, end_us);
+            if (bytes) {
+                budget -= bytes;
+                progress = true;
+            }
+        }
+        s_sim->bulk_rr = (s_sim->bulk_rr + 1) % (USB_HOST_SIM_DEVICES_MAX * USB_HOST_SIM_ENDPOINTS_MAX);
+    }
+
+    s_sim->frame++;
+    s_sim->now_us = end_us;
+    sim_done_release();
+}
+
+// ---------------------------------------------------------------- Client events --------------------------------------
+
+/**
+ * @brief Call client event callbacks and transfer callbacks of completed transfers
+ *
+ * @return true if anything was handled
+ */
+static bool sim_client_handle(sim_client_t *client)
+{
+    bool handled = false;
+    SIM_ENTER();
+    while (client->num_events > 0) {
+        const usb_host_client_event_msg_t msg = client->events[client->event_head];
+        client->event_head = (client->event_head + 1) % SIM_CLIENT_EVENTS_MAX;
+        client->num_events--;
+        usb_host_client_event_cb_t cb = client->cfg.async.client_event_callback;
+        void *arg = client->cfg.async.callback_arg;
+        SIM_EXIT();
+        if (cb) {
+            cb(&msg, arg);
+        }
+        handled = true;
+        SIM_ENTER();
+    }
+
+    sim_xfer_t *obj;
+    while ((obj = TAILQ_FIRST(&client->ready))) {
+        TAILQ_REMOVE(&client->ready, obj, tailq);
+        sim_ep_t *ep = obj->ep;
+        const uint32_t latency = s_sim->now_us - obj->submit_us;
+        ep->stats.latency_sum_us += latency;
+        ep->stats.latency_max_us = MAX(ep->stats.latency_max_us, latency);
+        usb_host_sim_device_hdl_t dev = ep->dev;
+        obj->in_flight = false;
+        obj->ep = NULL;
+        dev->in_flight--;
+        SIM_EXIT();
+        obj->xfer.callback(&obj->xfer);
+        handled = true;
+        SIM_ENTER();
+        sim_device_try_free(dev);
+    }
+    SIM_EXIT();
+    return handled;
+}
+
+// ---------------------------------------------------------------- USB Host Library stubs -----------------------------
+
+static esp_err_t stub_install(const usb_host_config_t *config, int cmock_num_calls)
+{
+    return ESP_OK;
+}
+
+static esp_err_t stub_uninstall(int cmock_num_calls)
+{
+    return ESP_OK;
+}
+
+static esp_err_t stub_lib_handle_events(TickType_t timeout_ticks, uint32_t *event_flags_ret, int cmock_num_calls)
+{
+    uint32_t flags = USB_HOST_LIB_EVENT_FLAGS_NO_CLIENTS | USB_HOST_LIB_EVENT_FLAGS_ALL_FREE;
+    SIM_ENTER();
+    for (int i = 0; i < USB_HOST_SIM_CLIENTS_MAX; i++) {
+        if (s_sim->clients[i].used) {
+            flags &= ~USB_HOST_LIB_EVENT_FLAGS_NO_CLIENTS;
+        }
+    }
+    for (int i = 0; i < USB_HOST_SIM_DEVICES_MAX; i++) {
+        if (s_sim->devs[i] && s_sim->devs[i]->open_mask) {
+            flags &= ~USB_HOST_LIB_EVENT_FLAGS_ALL_FREE;
+        }
+    }
+    SIM_EXIT();
+    if (event_flags_ret) {
+        *event_flags_ret = flags;
+    }
+    return ESP_ERR_TIMEOUT;
+}
+
+static esp_err_t stub_lib_unblock(int cmock_num_calls)
+{
+    return ESP_OK;
+}
+
+static esp_err_t stub_device_free_all(int cmock_num_calls)
+{
+    return ESP_OK;
+}
+
+static esp_err_t stub_client_register(const usb_host_client_config_t *client_config, usb_host_client_handle_t *client_hdl_ret, int cmock_num_calls)
+{
+    ESP_RETURN_ON_FALSE(client_config && client_hdl_ret, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    SIM_ENTER();
+    for (int i = 0; i < USB_HOST_SIM_CLIENTS_MAX; i++) {
+        sim_client_t *client = &s_sim->clients[i];
+        if (!client->used) {
+            memset(client, 0, sizeof(sim_client_t));
+            client->used = true;
+            client->cfg = *client_config;
+            TAILQ_INIT(&client->ready);
+            *client_hdl_ret = CLIENT_HDL(client);
+            ret = ESP_OK;
+            break;
+        }
+    }
+    SIM_EXIT();
+    return ret;
+}
+
+static esp_err_t stub_client_deregister(usb_host_client_handle_t client_hdl, int cmock_num_calls)
+{
+    sim_client_t *client = CLIENT_OBJ(client_hdl);
+    ESP_RETURN_ON_FALSE(client && client->used, ESP_ERR_INVALID_ARG, TAG, "Invalid client");
+    const uint32_t mask = 1UL << (client - s_sim->clients);
+    esp_err_t ret = ESP_OK;
+    SIM_ENTER();
+    for (int i = 0; i < USB_HOST_SIM_DEVICES_MAX; i++) {
+        if (s_sim->devs[i] && (s_sim->devs[i]->open_mask & mask)) {
+            ret = ESP_ERR_INVALID_STATE; // Client has opened devices
+        }
+    }
+    if (ret == ESP_OK) {
+        client->used = false;
+    }
+    SIM_EXIT();
+    return ret;
+}
+
+static esp_err_t stub_client_handle_events(usb_host_client_handle_t client_hdl, TickType_t timeout_ticks, int cmock_num_calls)
+{
+    sim_client_t *client = CLIENT_OBJ(client_hdl);
+    ESP_RETURN_ON_FALSE(client && client->used, ESP_ERR_INVALID_ARG, TAG, "Invalid client");
+    // Simulated time does not advance while waiting here, so the call never blocks
+    return sim_client_handle(client) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+static esp_err_t stub_client_unblock(usb_host_client_handle_t client_hdl, int cmock_num_calls)
+{
+    return ESP_OK;
+}
+
+static esp_err_t stub_device_open(usb_host_client_handle_t client_hdl, uint8_t dev_addr, usb_device_handle_t *dev_hdl_ret, int cmock_num_calls)
+{
+    sim_client_t *client = CLIENT_OBJ(client_hdl);
+    ESP_RETURN_ON_FALSE(client && dev_hdl_ret, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    SIM_ENTER();
+    for (int i = 0; i < USB_HOST_SIM_DEVICES_MAX; i++) {
+        usb_host_sim_device_hdl_t dev = s_sim->devs[i];
+        if (dev && dev->connected && dev->addr == dev_addr) {
+            dev->open_mask |= 1UL << (client - s_sim->clients);
+            *dev_hdl_ret = DEV_HDL(dev);
+            ret = ESP_OK;
+            break;
+        }
+    }
+    SIM_EXIT();
+    return ret;
+}
+
+static esp_err_t stub_device_close(usb_host_client_handle_t client_hdl, usb_device_handle_t dev_hdl, int cmock_num_calls)
+{
+    sim_client_t *client = CLIENT_OBJ(client_hdl);
+    usb_host_sim_device_hdl_t dev = DEV_OBJ(dev_hdl);
+    ESP_RETURN_ON_FALSE(client && dev, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    const uint32_t mask = 1UL << (client - s_sim->clients);
+    esp_err_t ret = ESP_OK;
+    SIM_ENTER();
+    if (!(dev->open_mask & mask)) {
+        ret = ESP_ERR_INVALID_STATE;
+    } else {
+        dev->open_mask &= ~mask;
+        for (int i = 0; i < dev->num_eps; i++) {
+            if (dev->eps[i].client == client) {
+                dev->eps[i].client = NULL; // Interfaces of the client are released
+            }
+        }
+        sim_device_try_free(dev);
+    }
+    SIM_EXIT();
+    return ret;
+}
+
+static esp_err_t stub_device_addr_list_fill(int list_len, uint8_t *dev_addr_list, int *num_dev_ret, int cmock_num_calls)
+{
+    ESP_RETURN_ON_FALSE(dev_addr_list && num_dev_ret, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    int num = 0;
+    SIM_ENTER();
+    for (int i = 0; i < USB_HOST_SIM_DEVICES_MAX && num < list_len; i++) {
+        if (s_sim->devs[i] && s_sim->devs[i]->connected) {
+            dev_addr_list[num++] = s_sim->devs[i]->addr;
+        }
+    }
+    SIM_EXIT();
+    *num_dev_ret = num;
+    return ESP_OK;
+}
+
+static esp_err_t stub_device_info(usb_device_handle_t dev_hdl, usb_device_info_t *dev_info, int cmock_num_calls)
+{
+    usb_host_sim_device_hdl_t dev = DEV_OBJ(dev_hdl);
+    ESP_RETURN_ON_FALSE(dev && dev_info, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    memset(dev_info, 0, sizeof(usb_device_info_t));
+    dev_info->speed = dev->cfg.speed;
+    dev_info->dev_addr = dev->addr;
+    dev_info->bMaxPacketSize0 = dev->cfg.dev_desc->bMaxPacketSize0;
+    dev_info->bConfigurationValue = dev->cfg.config_desc->bConfigurationValue;
+    return ESP_OK;
+}
+
+static esp_err_t stub_get_device_descriptor(usb_device_handle_t dev_hdl, const usb_device_desc_t **device_desc, int cmock_num_calls)
+{
+    usb_host_sim_device_hdl_t dev = DEV_OBJ(dev_hdl);
+    ESP_RETURN_ON_FALSE(dev && device_desc, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    *device_desc = dev->cfg.dev_desc;
+    return ESP_OK;
+}
+
+static esp_err_t stub_get_active_config_descriptor(usb_device_handle_t dev_hdl, const usb_config_desc_t **config_desc, int cmock_num_calls)
+{
+    usb_host_sim_device_hdl_t dev = DEV_OBJ(dev_hdl);
+    ESP_RETURN_ON_FALSE(dev && config_desc, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    *config_desc = dev->cfg.config_desc;
+    return ESP_OK;
+}
+
+static esp_err_t stub_interface_claim(usb_host_client_handle_t client_hdl, usb_device_handle_t dev_hdl, uint8_t bInterfaceNumber,
+                                      uint8_t bAlternateSetting, int cmock_num_calls)
+{
+    sim_client_t *client = CLIENT_OBJ(client_hdl);
+    usb_host_sim_device_hdl_t dev = DEV_OBJ(dev_hdl);
+    ESP_RETURN_ON_FALSE(client && dev, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    SIM_ENTER();
+    const usb_config_desc_t *config_desc = dev->cfg.config_desc;
+    int offset = 0;
+    bool in_intf = false;
+    for (const usb_standard_desc_t *desc = sim_desc_next(config_desc, &offset); desc; desc = sim_desc_next(config_desc, &offset)) {
+        if (desc->bDescriptorType == USB_B_DESCRIPTOR_TYPE_INTERFACE) {
+            const usb_intf_desc_t *intf_desc = (const usb_intf_desc_t *)desc;
+            in_intf = (intf_desc->bInterfaceNumber == bInterfaceNumber && intf_desc->bAlternateSetting == bAlternateSetting);
+            ret = in_intf ? ESP_OK : ret;
+        } else if (in_intf && desc->bDescriptorType == USB_B_DESCRIPTOR_TYPE_ENDPOINT) {
+            // Endpoints of the claimed alternate take its descriptor
+            const usb_ep_desc_t *ep_desc = (const usb_ep_desc_t *)desc;
+            sim_ep_t *ep = sim_ep_find(dev, ep_desc->bEndpointAddress);
+            ep->desc = ep_desc;
+            ep->client = client;
+            ep->bInterfaceNumber = bInterfaceNumber;
+        }
+    }
+    SIM_EXIT();
+    return ret;
+}
+
+static esp_err_t stub_interface_release(usb_host_client_handle_t client_hdl, usb_device_handle_t dev_hdl, uint8_t bInterfaceNumber, int cmock_num_calls)
+{
+    sim_client_t *client = CLIENT_OBJ(client_hdl);
+    usb_host_sim_device_hdl_t dev = DEV_OBJ(dev_hdl);
+    ESP_RETURN_ON_FALSE(client && dev, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    esp_err_t ret = ESP_OK;
+    SIM_ENTER();
+    for (int i = 0; i < dev->num_eps; i++) {
+        sim_ep_t *ep = &dev->eps[i];
+        if (ep->client == client && ep->bInterfaceNumber == bInterfaceNumber && !TAILQ_EMPTY(&ep->queue)) {
+            ret = ESP_ERR_INVALID_STATE; // Transfers are still in flight
+        }
+    }
+    for (int i = 0; i < dev->num_eps && ret == ESP_OK; i++) {
+        sim_ep_t *ep = &dev->eps[i];
+        if (ep->client == client && ep->bInterfaceNumber == bInterfaceNumber) {
+            ep->client = NULL;
+        }
+    }
+    SIM_EXIT();
+    return ret;
+}
+
+static esp_err_t stub_endpoint_halt(usb_device_handle_t dev_hdl, uint8_t bEndpointAddress, int cmock_num_calls)
+{
+    usb_host_sim_device_hdl_t dev = DEV_OBJ(dev_hdl);
+    ESP_RETURN_ON_FALSE(dev, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    SIM_ENTER();
+    sim_ep_t *ep = sim_ep_find(dev, bEndpointAddress);
+    if (ep) {
+        ep->halted = true;
+    }
+    SIM_EXIT();
+    return ep ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+static esp_err_t stub_endpoint_flush(usb_device_handle_t dev_hdl, uint8_t bEndpointAddress, int cmock_num_calls)
+{
+    usb_host_sim_device_hdl_t dev = DEV_OBJ(dev_hdl);
+    ESP_RETURN_ON_FALSE(dev, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    esp_err_t ret = ESP_OK;
+    SIM_ENTER();
+    sim_ep_t *ep = sim_ep_find(dev, bEndpointAddress);
+    if (!ep) {
+        ret = ESP_ERR_NOT_FOUND;
+    } else if (!ep->halted) {
+        ret = ESP_ERR_INVALID_STATE; // Endpoint must be halted before flush
+    } else {
+        sim_ep_cancel_all(ep, USB_TRANSFER_STATUS_CANCELED);
+        sim_done_release();
+    }
+    SIM_EXIT();
+    return ret;
+}
+
+static esp_err_t stub_endpoint_clear(usb_device_handle_t dev_hdl, uint8_t bEndpointAddress, int cmock_num_calls)
+{
+    usb_host_sim_device_hdl_t dev = DEV_OBJ(dev_hdl);
+    ESP_RETURN_ON_FALSE(dev, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    SIM_ENTER();
+    sim_ep_t *ep = sim_ep_find(dev, bEndpointAddress);
+    if (ep) {
+        ep->halted = false;
+    }
+    SIM_EXIT();
+    return ep ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+static esp_err_t stub_transfer_alloc(size_t data_buffer_size, int num_isoc_packets, usb_transfer_t **transfer, int cmock_num_calls)
+{
+    ESP_RETURN_ON_FALSE(transfer && num_isoc_packets >= 0, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    uint8_t *data_buffer = calloc(1, MAX(data_buffer_size, 1));
+    sim_xfer_t *obj = calloc(1, sizeof(sim_xfer_t) + num_isoc_packets * sizeof(usb_isoc_packet_desc_t));
+    if (!data_buffer || !obj) {
+        free(data_buffer);
+        free(obj);
+        return ESP_ERR_NO_MEM;
+    }
+    // Size and packet count of the transfer are const, they are set once here
+    const usb_transfer_t init = {
+        .data_buffer = data_buffer,
+        .data_buffer_size = data_buffer_size,
+        .num_isoc_packets = num_isoc_packets,
+    };
+    memcpy(&obj->xfer, &init, sizeof(usb_transfer_t));
+
+    SIM_ENTER();
+    usb_host_sim_stats_t *stats = &s_sim->stats;
+    stats->transfer_allocs++;
+    stats->transfers_allocated++;
+    stats->transfer_bytes += data_buffer_size;
+    stats->transfers_peak = MAX(stats->transfers_peak, stats->transfers_allocated);
+    stats->transfer_bytes_peak = MAX(stats->transfer_bytes_peak, stats->transfer_bytes);
+    SIM_EXIT();
+    *transfer = &obj->xfer;
+    return ESP_OK;
+}
+
+static esp_err_t stub_transfer_free(usb_transfer_t *transfer, int cmock_num_calls)
+{
+    if (!transfer) {
+        return ESP_OK;
+    }
+    sim_xfer_t *obj = XFER_OBJ(transfer);
+    ESP_RETURN_ON_FALSE(!obj->in_flight, ESP_ERR_INVALID_STATE, TAG, "Transfer is in flight");
+    SIM_ENTER();
+    s_sim->stats.transfers_allocated--;
+    s_sim->stats.transfer_bytes -= transfer->data_buffer_size;
+    SIM_EXIT();
+    free(transfer->data_buffer);
+    free(obj);
+    return ESP_OK;
+}
+
+/**
+ * @brief Queue transfer on its endpoint
+ */
+static esp_err_t sim_xfer_queue(sim_ep_t *ep, sim_client_t *client, sim_xfer_t *obj)
+{
+    usb_transfer_t *transfer = &obj->xfer;
+    ESP_RETURN_ON_FALSE(ep->dev->connected, ESP_ERR_INVALID_STATE, TAG, "Device is gone");
+    ESP_RETURN_ON_FALSE(!s_sim->suspended, ESP_ERR_INVALID_STATE, TAG, "Root port is suspended");
+    ESP_RETURN_ON_FALSE(!ep->halted, ESP_ERR_INVALID_STATE, TAG, "Endpoint 0x%02X is halted", ep->addr);
+    ESP_RETURN_ON_FALSE(client, ESP_ERR_NOT_FOUND, TAG, "Interface of endpoint 0x%02X is not claimed", ep->addr);
+    ESP_RETURN_ON_FALSE(transfer->num_bytes >= 0 && (size_t)transfer->num_bytes <= transfer->data_buffer_size, ESP_ERR_INVALID_ARG, TAG, "Invalid num_bytes");
+    obj->ep = ep;
+    obj->client = client;
+    obj->submit_us = s_sim->now_us;
+    obj->ready_us = s_sim->now_us + s_sim->cfg.submit_latency_us;
+    obj->offset = 0;
+    obj->packet_idx = 0;
+    obj->zlp_sent = false;
+    obj->in_flight = true;
+    transfer->actual_num_bytes = 0;
+    TAILQ_INSERT_TAIL(&ep->queue, obj, tailq);
+    ep->dev->in_flight++;
+    return ESP_OK;
+}
+
+static esp_err_t stub_transfer_submit(usb_transfer_t *transfer, int cmock_num_calls)
+{
+    ESP_RETURN_ON_FALSE(transfer && transfer->device_handle && transfer->callback, ESP_ERR_INVALID_ARG, TAG, "Invalid transfer");
+    sim_xfer_t *obj = XFER_OBJ(transfer);
+    ESP_RETURN_ON_FALSE(!obj->in_flight, ESP_ERR_NOT_FINISHED, TAG, "Transfer is in flight");
+    usb_host_sim_device_hdl_t dev = DEV_OBJ(transfer->device_handle);
+    esp_err_t ret;
+    SIM_ENTER();
+    sim_ep_t *ep = sim_ep_find(dev, transfer->bEndpointAddress);
+    if (!ep || ep == &dev->ep0) {
+        ret = ESP_ERR_NOT_FOUND;
+    } else {
+        ret = sim_xfer_queue(ep, ep->client, obj);
+    }
+    SIM_EXIT();
+    return ret;
+}
+
+static esp_err_t stub_transfer_submit_control(usb_host_client_handle_t client_hdl, usb_transfer_t *transfer, int cmock_num_calls)
+{
+    sim_client_t *client = CLIENT_OBJ(client_hdl);
+    ESP_RETURN_ON_FALSE(client && transfer && transfer->device_handle && transfer->callback, ESP_ERR_INVALID_ARG, TAG, "Invalid transfer");
+    ESP_RETURN_ON_FALSE(transfer->num_bytes >= (int)SIM_SETUP_SIZE, ESP_ERR_INVALID_ARG, TAG, "No setup packet");
+    sim_xfer_t *obj = XFER_OBJ(transfer);
+    ESP_RETURN_ON_FALSE(!obj->in_flight, ESP_ERR_NOT_FINISHED, TAG, "Transfer is in flight");
+    usb_host_sim_device_hdl_t dev = DEV_OBJ(transfer->device_handle);
+    SIM_ENTER();
+    esp_err_t ret = sim_xfer_queue(&dev->ep0, client, obj);
+    if (ret != ESP_OK || s_sim->cfg.control_on_bus) {
+        SIM_EXIT();
+        return ret;
+    }
+
+    // Complete the control transfer right away, the callback is called before submit returns
+    TAILQ_REMOVE(&dev->ep0.queue, obj, tailq);
+    const usb_transfer_status_t status = sim_control_process(dev, obj);
+    transfer->actual_num_bytes = obj->offset;
+    transfer->status = status;
+    dev->ep0.stats.transfers++;
+    dev->ep0.stats.packets++;
+    dev->ep0.stats.bytes += obj->offset;
+    obj->in_flight = false;
+    obj->ep = NULL;
+    dev->in_flight--;
+    SIM_EXIT();
+    transfer->callback(transfer);
+    return ESP_OK;
+}
+
+#if SIM_ROOT_PORT_SUSPEND
+static esp_err_t stub_root_port_suspend(int cmock_num_calls)
+{
+    esp_err_t ret = ESP_OK;
+    SIM_ENTER();
+    // Root port is suspended only with all pipes idle
+    for (int d = 0; d < USB_HOST_SIM_DEVICES_MAX && ret == ESP_OK; d++) {
+        usb_host_sim_device_hdl_t dev = s_sim->devs[d];
+        for (int i = 0; dev && i < dev->num_eps; i++) {
+            if (!TAILQ_EMPTY(&dev->eps[i].queue)) {
+                ret = ESP_ERR_INVALID_STATE;
+                break;
+            }
+        }
+        if (dev && !TAILQ_EMPTY(&dev->ep0.queue)) {
+            ret = ESP_ERR_INVALID_STATE;
+        }
+    }
+    if (ret == ESP_OK) {
+        s_sim->suspended = true;
+    }
+    SIM_EXIT();
+    return ret;
+}
+
+static esp_err_t stub_root_port_resume(int cmock_num_calls)
+{
+    SIM_ENTER();
+    const bool suspended = s_sim->suspended;
+    s_sim->suspended = false;
+    SIM_EXIT();
+    return suspended ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+#endif // SIM_ROOT_PORT_SUSPEND
+
+static void sim_stubs_set(bool enable)
+{
+    usb_host_install_Stub(enable ? stub_install : NULL);
+    usb_host_uninstall_Stub(enable ? stub_uninstall : NULL);
+    usb_host_lib_handle_events_Stub(enable ? stub_lib_handle_events : NULL);
+    usb_host_lib_unblock_Stub(enable ? stub_lib_unblock : NULL);
+    usb_host_device_free_all_Stub(enable ? stub_device_free_all : NULL);
+    usb_host_client_register_Stub(enable ? stub_client_register : NULL);
+    usb_host_client_deregister_Stub(enable ? stub_client_deregister : NULL);
+    usb_host_client_handle_events_Stub(enable ? stub_client_handle_events : NULL);
+    usb_host_client_unblock_Stub(enable ? stub_client_unblock : NULL);
+    usb_host_device_open_Stub(enable ? stub_device_open : NULL);
+    usb_host_device_close_Stub(enable ? stub_device_close : NULL);
+    usb_host_device_addr_list_fill_Stub(enable ? stub_device_addr_list_fill : NULL);
+    usb_host_device_info_Stub(enable ? stub_device_info : NULL);
+    usb_host_get_device_descriptor_Stub(enable ? stub_get_device_descriptor : NULL);
+    usb_host_get_active_config_descriptor_Stub(enable ? stub_get_active_config_descriptor : NULL);
+    usb_host_interface_claim_Stub(enable ? stub_interface_claim : NULL);
+    usb_host_interface_release_Stub(enable ? stub_interface_release : NULL);
+    usb_host_endpoint_halt_Stub(enable ? stub_endpoint_halt : NULL);
+    usb_host_endpoint_flush_Stub(enable ? stub_endpoint_flush : NULL);
+    usb_host_endpoint_clear_Stub(enable ? stub_endpoint_clear : NULL);
+    usb_host_transfer_alloc_Stub(enable ? stub_transfer_alloc : NULL);
+    usb_host_transfer_free_Stub(enable ? stub_transfer_free : NULL);
+    usb_host_transfer_submit_Stub(enable ? stub_transfer_submit : NULL);
+    usb_host_transfer_submit_control_Stub(enable ? stub_transfer_submit_control : NULL);
+#if SIM_ROOT_PORT_SUSPEND
+    usb_host_lib_root_port_suspend_Stub(enable ? stub_root_port_suspend : NULL);
+    usb_host_lib_root_port_resume_Stub(enable ? stub_root_port_resume : NULL);
+#endif
+}
+
+// ---------------------------------------------------------------- Public API -----------------------------------------
+
+esp_err_t usb_host_sim_install(const usb_host_sim_config_t *config)
+{
+    ESP_RETURN_ON_FALSE(!s_sim, ESP_ERR_INVALID_STATE, TAG, "Already installed");
+    usb_host_sim_t *sim = calloc(1, sizeof(usb_host_sim_t));
+    ESP_RETURN_ON_FALSE(sim, ESP_ERR_NO_MEM, TAG, "Not enough memory");
+    const usb_host_sim_config_t default_config = USB_HOST_SIM_CONFIG_DEFAULT();
+    sim->cfg = config ? *config : default_config;
+    const bool high_speed = (sim->cfg.speed == USB_SPEED_HIGH);
+    sim->frame_us = high_speed ? SIM_FRAME_US_HS : SIM_FRAME_US_FS;
+    if (sim->cfg.frame_bytes == 0) {
+        sim->cfg.frame_bytes = high_speed ? SIM_FRAME_BYTES_HS : SIM_FRAME_BYTES_FS;
+    }
+    sim->next_addr = 1;
+    TAILQ_INIT(&sim->done);
+
+    // Device and endpoint callbacks can call the simulator API
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&sim_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    s_sim = sim;
+    sim_stubs_set(true);
+    return ESP_OK;
+}
+
+esp_err_t usb_host_sim_uninstall(void)
+{
+    ESP_RETURN_ON_FALSE(s_sim, ESP_ERR_INVALID_STATE, TAG, "Not installed");
+    sim_stubs_set(false);
+    if (s_sim->stats.transfers_allocated) {
+        ESP_LOGW(TAG, "%"PRIu32" transfers were not freed", s_sim->stats.transfers_allocated);
+    }
+    for (int i = 0; i < USB_HOST_SIM_DEVICES_MAX; i++) {
+        free(s_sim->devs[i]);
+    }
+    free(s_sim);
+    s_sim = NULL;
+    pthread_mutex_destroy(&sim_lock);
+    return ESP_OK;
+}
+
+esp_err_t usb_host_sim_device_connect(const usb_host_sim_device_config_t *config, usb_host_sim_device_hdl_t *dev_ret)
+{
+    ESP_RETURN_ON_FALSE(config && config->dev_desc && config->config_desc && dev_ret, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(s_sim, ESP_ERR_INVALID_STATE, TAG, "Not installed");
+    usb_host_sim_device_hdl_t dev = calloc(1, sizeof(struct usb_host_sim_device_s));
+    ESP_RETURN_ON_FALSE(dev, ESP_ERR_NO_MEM, TAG, "Not enough memory");
+    dev->cfg = *config;
+    sim_ep_init(&dev->ep0, dev, 0, NULL, 0);
+    esp_err_t ret = sim_device_parse_eps(dev);
+    if (ret != ESP_OK) {
+        free(dev);
+        return ret;
+    }
+
+    ret = ESP_ERR_NO_MEM;
+    SIM_ENTER();
+    for (int i = 0; i < USB_HOST_SIM_DEVICES_MAX; i++) {
+        if (!s_sim->devs[i]) {
+            s_sim->devs[i] = dev;
+            dev->addr = s_sim->next_addr++;
+            dev->connected = true;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    if (ret == ESP_OK) {
+        const usb_host_client_event_msg_t msg = {
+            .event = USB_HOST_CLIENT_EVENT_NEW_DEV,
+            .new_dev.address = dev->addr,
+        };
+        for (int i = 0; i < USB_HOST_SIM_CLIENTS_MAX; i++) {
+            if (s_sim->clients[i].used) {
+                sim_client_push_event(&s_sim->clients[i], &msg);
+            }
+        }
+    }
+    SIM_EXIT();
+    if (ret != ESP_OK) {
+        free(dev);
+        return ret;
+    }
+    *dev_ret = dev;
+    return ESP_OK;
+}
+
+esp_err_t usb_host_sim_device_disconnect(usb_host_sim_device_hdl_t dev)
+{
+    ESP_RETURN_ON_FALSE(dev && dev->connected, ESP_ERR_INVALID_ARG, TAG, "Invalid device");
+    SIM_ENTER();
+    dev->connected = false;
+    sim_ep_cancel_all(&dev->ep0, USB_TRANSFER_STATUS_NO_DEVICE);
+    for (int i = 0; i < dev->num_eps; i++) {
+        sim_ep_cancel_all(&dev->eps[i], USB_TRANSFER_STATUS_NO_DEVICE);
+    }
+    sim_done_release();
+    const usb_host_client_event_msg_t msg = {
+        .event = USB_HOST_CLIENT_EVENT_DEV_GONE,
+        .dev_gone.dev_hdl = DEV_HDL(dev),
+    };
+    for (int i = 0; i < USB_HOST_SIM_CLIENTS_MAX; i++) {
+        if (s_sim->clients[i].used && (dev->open_mask & (1UL << i))) {
+            sim_client_push_event(&s_sim->clients[i], &msg);
+        }
+    }
+    sim_device_try_free(dev);
+    SIM_EXIT();
+    return ESP_OK;
+}
+
+uint8_t usb_host_sim_device_get_addr(usb_host_sim_device_hdl_t dev)
+{
+    return dev ? dev->addr : 0;
+}
+
+esp_err_t usb_host_sim_endpoint_set_cb(usb_host_sim_device_hdl_t dev, uint8_t bEndpointAddress, usb_host_sim_ep_cb_t cb, void *arg)
+{
+    ESP_RETURN_ON_FALSE(dev, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    SIM_ENTER();
+    sim_ep_t *ep = sim_ep_find(dev, bEndpointAddress);
+    if (ep && ep != &dev->ep0) {
+        ep->cb = cb;
+        ep->cb_arg = arg;
+        ep->packets = NULL;
+    }
+    SIM_EXIT();
+    return (ep && ep != &dev->ep0) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t usb_host_sim_endpoint_playback(usb_host_sim_device_hdl_t dev, uint8_t bEndpointAddress,
+        const usb_host_sim_packet_t *packets, size_t num_packets, bool loop)
+{
+    ESP_RETURN_ON_FALSE(dev && packets && num_packets > 0, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(bEndpointAddress & USB_B_ENDPOINT_ADDRESS_EP_DIR_MASK, ESP_ERR_INVALID_ARG, TAG, "Playback is for IN endpoints");
+    SIM_ENTER();
+    sim_ep_t *ep = sim_ep_find(dev, bEndpointAddress);
+    if (ep && ep != &dev->ep0) {
+        ep->cb = NULL;
+        ep->packets = packets;
+        ep->num_packets = num_packets;
+        ep->packet_idx = 0;
+        ep->playback_loop = loop;
+        ep->playback_start_us = s_sim->now_us;
+    }
+    SIM_EXIT();
+    return (ep && ep != &dev->ep0) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+void usb_host_sim_advance(uint32_t time_us)
+{
+    SIM_ENTER();
+    const uint64_t end_us = s_sim->now_us + time_us;
+    while (s_sim->now_us < end_us) {
+        sim_frame();
+    }
+    SIM_EXIT();
+}
+
+void usb_host_sim_run(uint32_t time_us, usb_host_sim_pump_t pump, void *arg)
+{
+    const uint64_t end_us = usb_host_sim_get_time_us() + time_us;
+    while (usb_host_sim_get_time_us() < end_us) {
+        usb_host_sim_advance(1); // One (micro)frame
+        if (pump) {
+            pump(arg);
+            continue;
+        }
+        for (int i = 0; i < USB_HOST_SIM_CLIENTS_MAX; i++) {
+            if (s_sim->clients[i].used) {
+                sim_client_handle(&s_sim->clients[i]);
+            }
+        }
+    }
+}
+
+uint64_t usb_host_sim_get_time_us(void)
+{
+    SIM_ENTER();
+    const uint64_t now_us = s_sim ? s_sim->now_us : 0;
+    SIM_EXIT();
+    return now_us;
+}
+
+esp_err_t usb_host_sim_endpoint_get_stats(usb_host_sim_device_hdl_t dev, uint8_t bEndpointAddress, usb_host_sim_ep_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(dev && stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    SIM_ENTER();
+    sim_ep_t *ep = sim_ep_find(dev, bEndpointAddress);
+    if (ep) {
+        *stats = ep->stats;
+    }
+    SIM_EXIT();
+    return ep ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t usb_host_sim_get_stats(usb_host_sim_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    ESP_RETURN_ON_FALSE(s_sim, ESP_ERR_INVALID_STATE, TAG, "Not installed");
+    SIM_ENTER();
+    *stats = s_sim->stats;
+    stats->time_us = s_sim->now_us;
+    stats->suspended = s_sim->suspended;
+    SIM_EXIT();
+    return ESP_OK;
+}
@@ -0,0 +1,85 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_check.h"
+#include "usb/usb_host_sim.h"
+
+static const char *TAG = "usb_host_sim";
+
+static bool read_le(FILE *file, size_t bytes, uint32_t *value)
+{
+    uint8_t buf[4];
+    if (fread(buf, 1, bytes, file) != bytes) {
+        return false;
+    }
+    *value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        *value |= (uint32_t)buf[i] << (8 * i);
+    }
+    return true;
+}
+
+esp_err_t usb_host_sim_recording_load(const char *path, usb_host_sim_packet_t **packets_ret, size_t *num_packets_ret)
+{
+    ESP_RETURN_ON_FALSE(path && packets_ret && num_packets_ret, ESP_ERR_INVALID_ARG, TAG, "Invalid argument");
+    FILE *file = fopen(path, "rb");
+    ESP_RETURN_ON_FALSE(file, ESP_ERR_NOT_FOUND, TAG, "Cannot open %s", path);
+
+    esp_err_t ret = ESP_OK;
+    usb_host_sim_packet_t *packets = NULL;
+    size_t num_packets = 0;
+    size_t capacity = 0;
+    uint32_t time_us;
+    while (read_le(file, 4, &time_us)) {
+        uint32_t length, status;
+        ESP_GOTO_ON_FALSE(read_le(file, 2, &length) && read_le(file, 1, &status), ESP_ERR_INVALID_SIZE, err, TAG, "Truncated record %zu", num_packets);
+        if (num_packets == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            usb_host_sim_packet_t *grown = realloc(packets, capacity * sizeof(usb_host_sim_packet_t));
+            ESP_GOTO_ON_FALSE(grown, ESP_ERR_NO_MEM, err, TAG, "Not enough memory");
+            packets = grown;
+        }
+        uint8_t *data = NULL;
+        if (length) {
+            data = malloc(length);
+            ESP_GOTO_ON_FALSE(data, ESP_ERR_NO_MEM, err, TAG, "Not enough memory");
+            if (fread(data, 1, length, file) != length) {
+                free(data);
+                ESP_GOTO_ON_FALSE(false, ESP_ERR_INVALID_SIZE, err, TAG, "Truncated data of record %zu", num_packets);
+            }
+        }
+        packets[num_packets++] = (usb_host_sim_packet_t) {
+            .time_us = time_us,
+            .length = length,
+            .status = (usb_transfer_status_t)status,
+            .data = data,
+        };
+    }
+    fclose(file);
+    *packets_ret = packets;
+    *num_packets_ret = num_packets;
+    return ESP_OK;
+
+err:
+    fclose(file);
+    usb_host_sim_recording_free(packets, num_packets);
+    return ret;
+}
+
+void usb_host_sim_recording_free(usb_host_sim_packet_t *packets, size_t num_packets)
+{
+    if (!packets) {
+        return;
+    }
+    for (size_t i = 0; i < num_packets; i++) {
+        free((void *)packets[i].data);
+    }
+    free(packets);
+}